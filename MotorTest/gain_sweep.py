@@ -0,0 +1,424 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Gain-Sweep Tracking Benchmark
+-----------------------------
+swing_test.py as a benchmark: every combination of --kp, --kd, --freq and
+--amp-deg swings on the motors of --ids, in MIT mode on the real-time loop
+(rt_loop.py). With N motors, N configurations run at once, one per motor,
+so a sweep takes 1/N of the time (--same runs each one on every motor).
+Each cycle is pipelined as in motor_cycle.py: all commands out back to
+back, then all replies.
+
+Commands and feedback are timed by the kernel (SO_TIMESTAMPING): a command
+at the echo of its frame, a reply when it was received. Both use the
+adapter's clock when its driver hands it over (gs_usb with hardware
+timestamps), otherwise the kernel's software stamps. For each motor and
+configuration the report has:
+
+  - the tracking error (feedback - the command it answered), rms and max
+  - the gain and phase lag of the measured swing against the commanded
+    one, from least-squares sine fits at the swing frequency; positions
+    are placed at their reply's stamp, so the lag includes the reply path
+  - the achieved loop rate and jitter from the command stamps, overruns,
+    missed replies and the command -> reply round trip
+
+A swing ramps in over --settle seconds, rounded up to whole periods, which
+are left out of the figures, then runs --periods periods and ends at zero.
+Start with the motors near zero: the first command is position 0.
+
+--results appends one JSON line per motor and configuration, tagged with
+--tag (a firmware or host build, say). --summary prints a results file;
+--compare puts two tags side by side:
+
+    sudo python3 gain_sweep.py can0 --ids 1-4 --kp 20,40,80 --kd 1,1.5 --freq 0.5,2 --amp-deg 30,90 \\
+        --rate 500 --fifo 80 --cpu 3 --tag fw-1.4 --results sweep.jsonl
+    python3 gain_sweep.py --summary sweep.jsonl
+    python3 gain_sweep.py --compare sweep.jsonl fw-1.3 fw-1.4
+"""
+
+import argparse
+import itertools
+import json
+import math
+import select
+import signal
+import socket
+import struct
+import time
+from collections import namedtuple
+
+from latency_bench import interface_info
+from motor_cycle import CAN_EFF_FLAG, CAN_EFF_MASK, CAN_FRAME, HOST_ID, MotorCycle, robostride
+from motor_scan import parse_ids
+from rt_loop import RtLoop, make_realtime
+
+SO_TIMESTAMPING = getattr(socket, "SO_TIMESTAMPING", 37)
+SOF_TIMESTAMPING_RX_HARDWARE = 1 << 2
+SOF_TIMESTAMPING_RX_SOFTWARE = 1 << 3
+SOF_TIMESTAMPING_SOFTWARE = 1 << 4
+SOF_TIMESTAMPING_RAW_HARDWARE = 1 << 6
+CAN_RAW_RECV_OWN_MSGS = getattr(socket, "CAN_RAW_RECV_OWN_MSGS", 4)
+MSG_CONFIRM = getattr(socket, "MSG_CONFIRM", 0x800)   # set on the echo of a frame this socket sent
+TIMESPEC3 = struct.Struct("=qqqqqq")                  # software, legacy, raw hardware
+TYPE_MASK = 0x1F << 24
+TYPE_WRITE = 18
+RUN_MODE = 0x7005                                     # 0: MIT (operation control)
+
+Config = namedtuple('Config', 'kp kd freq amp_deg')
+# One cycle of one motor: scheduled time (s), command (rad), host send time, command and reply
+# stamps as (hw, sw) ns, measured position, velocity and torque; the reply fields are None when it was missed
+Sample = namedtuple('Sample', 't pos_cmd host_ns cmd_stamp fb_stamp pos vel torque')
+
+
+def floats(text):
+    return [float(v) for v in text.split(',')]
+
+
+class StampedCycle(MotorCycle):
+    """MotorCycle that also returns the kernel stamps of each command's echo and each reply."""
+
+    def __init__(self, interface, motors, host_id=HOST_ID):
+        super().__init__(interface, motors, host_id)
+        self.sock.setsockopt(socket.SOL_SOCKET, SO_TIMESTAMPING,
+                             SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE
+                             | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE)
+        self.sock.setsockopt(socket.SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, 1)
+        # Type 2 to us, and type 1 (our commands' echoes; another host's commands lack MSG_CONFIRM)
+        feedback_id = robostride.build_ext_id(self.host_id, 0, robostride.TYPE_FEEDBACK)
+        self.sock.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_FILTER, struct.pack(
+            "=IIII", feedback_id | CAN_EFF_FLAG, TYPE_MASK | 0xFF | CAN_EFF_FLAG,
+            robostride.TYPE_OP_CONTROL << 24 | CAN_EFF_FLAG, TYPE_MASK | CAN_EFF_FLAG))
+        self.cmsg_space = socket.CMSG_SPACE(TIMESPEC3.size)
+
+    def _recv(self):
+        """(can_id, data, echo, (hw_ns, sw_ns)) of the next frame, or None when there is none."""
+        try:
+            raw, ancdata, flags, _ = self.sock.recvmsg(CAN_FRAME.size, self.cmsg_space)
+        except BlockingIOError:
+            return None
+        hw = sw = None
+        for level, kind, payload in ancdata:
+            if level == socket.SOL_SOCKET and kind == SO_TIMESTAMPING and len(payload) >= TIMESPEC3.size:
+                s0, n0, _, _, s2, n2 = TIMESPEC3.unpack_from(payload)
+                sw = s0 * 1_000_000_000 + n0 or None
+                hw = s2 * 1_000_000_000 + n2 or None
+        can_id, _, data = CAN_FRAME.unpack(raw)
+        return can_id & CAN_EFF_MASK, data, bool(flags & MSG_CONFIRM), (hw, sw)
+
+    def _drain(self):
+        while True:
+            got = self._recv()
+            if got is None:
+                return
+            if not got[2] and got[0] >> 24 == robostride.TYPE_FEEDBACK:
+                self.late += 1
+
+    def write_run_mode(self, mode=0):
+        """Type 18 run_mode to every motor; the replies are not waited for."""
+        data = struct.pack('<HHB3x', RUN_MODE, 0, mode)
+        for mid in self.ids:
+            self._send(robostride.build_ext_id(mid, self.host_id, TYPE_WRITE), data)
+
+    def stamped_cycle(self, commands, timeout):
+        """As cycle(), but motor ID -> (command stamp, reply stamp, Feedback); stamps are (hw_ns, sw_ns)."""
+        self._drain()
+        ids = [mid for mid in self.ids if mid in commands]
+        for can_id, data in robostride.pack_op_control_batch([self.lims[mid] for mid in ids], ids,
+                                                             [commands[mid] for mid in ids]):
+            self._send(can_id, data)
+
+        deadline = time.perf_counter() + timeout
+        sent = {}
+        out = {}
+        pending = set(ids)
+        while pending or len(sent) < len(ids):
+            remaining = deadline - time.perf_counter()
+            if remaining <= 0 or not select.select([self.sock], [], [], remaining)[0]:
+                break
+            while (got := self._recv()) is not None:
+                can_id, data, echo, stamp = got
+                if echo:
+                    sent.setdefault(can_id & 0xFF, stamp)
+                    continue
+                mid = (can_id >> 8) & 0xFF
+                if mid in pending:
+                    out[mid] = (stamp, robostride.decode_feedback(self.lims[mid], can_id, data))
+                    pending.discard(mid)
+        self.cycles += 1
+        self.missed += len(pending)
+        return {mid: (sent.get(mid, (None, None)), stamp, fb) for mid, (stamp, fb) in out.items()}
+
+
+def assignments(configs, motors, same=False):
+    """Rounds of motor ID -> Config: one configuration per motor at a time, or each on every motor."""
+    if same:
+        return [{mid: cfg for mid in motors} for cfg in configs]
+    n = len(motors)
+    return [dict(zip(motors, configs[i:i + n])) for i in range(0, len(configs), n)]
+
+
+def swing_plan(cfg, settle, periods):
+    """(ramp seconds, end seconds) of one swing: both whole periods, so it starts and ends at zero."""
+    ramp = math.ceil(settle * cfg.freq - 1e-9) / cfg.freq
+    return ramp, ramp + periods / cfg.freq
+
+
+def run_round(cycle, plan, rate, settle, periods, timeout):
+    """Swings each motor of plan (motor ID -> Config) at once.
+
+    Returns motor ID -> [Sample], the loop, and whether the round ran to its end (not Ctrl+C)."""
+    spans = {mid: swing_plan(cfg, settle, periods) for mid, cfg in plan.items()}
+    duration = max(end for _, end in spans.values())
+    samples = {mid: [] for mid in plan}
+    finished = []
+    loop = RtLoop(rate)
+    signal.signal(signal.SIGINT, lambda s, f: loop.stop())
+
+    def step(n, t):
+        commands = {}
+        targets = {}
+        for mid, cfg in plan.items():
+            ramp, end = spans[mid]
+            amp = math.radians(cfg.amp_deg) * (min(1.0, t / ramp) if ramp else 1.0) if t < end else 0.0
+            w = 2 * math.pi * cfg.freq
+            targets[mid] = amp * math.sin(w * t)
+            commands[mid] = (targets[mid], amp * w * math.cos(w * t), 0.0, cfg.kp, cfg.kd)
+        host_ns = time.monotonic_ns()
+        replies = cycle.stamped_cycle(commands, timeout)
+        for mid, cmd in targets.items():
+            cmd_stamp, fb_stamp, fb = replies.get(mid, ((None, None), None, None))
+            samples[mid].append(Sample(t, cmd, host_ns, cmd_stamp, fb_stamp, fb and fb.pos,
+                                       fb and fb.vel, fb and fb.torque))
+        if t >= duration:
+            finished.append(t)
+            loop.stop()
+
+    loop.run(step)
+    return samples, loop, bool(finished)
+
+
+def fit_sine(times, values, freq):
+    """Least-squares a*sin(wt) + b*cos(wt) + c; returns (amplitude, phase in rad) of amp*sin(wt + phase)."""
+    w = 2 * math.pi * freq
+    rows = [(math.sin(w * t), math.cos(w * t), 1.0) for t in times]
+    m = [[sum(r[i] * r[j] for r in rows) for j in range(3)] for i in range(3)]
+    v = [sum(r[i] * x for r, x in zip(rows, values)) for i in range(3)]
+
+    def det(a):
+        return (a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1]) - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+                + a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]))
+
+    d = det(m)
+    if abs(d) < 1e-12:
+        return None
+    a, b = ([[v[r] if c == k else m[r][c] for c in range(3)] for r in range(3)] for k in (0, 1))
+    a, b = det(a) / d, det(b) / d
+    return math.hypot(a, b), math.atan2(b, a)
+
+
+def _percentile(ordered, p):
+    return ordered[min(len(ordered) - 1, int(len(ordered) * p / 100.0))]
+
+
+def analyse(samples, cfg, settle, periods):
+    """The figures of one motor's swing, from the cycles after its ramp; None when no reply came back."""
+    ramp, end = swing_plan(cfg, settle, periods)
+    window = [s for s in samples if ramp <= s.t < end]
+    got = [s for s in window if s.pos is not None]
+    if len(got) < 3:
+        return None
+    # One clock for the run: the adapter's when every stamp has it, else the kernel's, else the host's send time
+    if all(s.cmd_stamp[0] and s.fb_stamp[0] for s in got):
+        clock, pick = "hw", 0
+    elif all(s.cmd_stamp[1] and s.fb_stamp[1] for s in got):
+        clock, pick = "sw", 1
+    else:
+        clock, pick = "host", None
+    if pick is None:
+        t_cmd = [s.host_ns for s in got]
+        t_fb = t_cmd
+        rtt = []
+    else:
+        t_cmd = [s.cmd_stamp[pick] for s in got]
+        t_fb = [s.fb_stamp[pick] for s in got]
+        rtt = sorted((f - c) / 1e3 for c, f in zip(t_cmd, t_fb))
+    t0 = t_cmd[0]
+    # The fits run on the scheduled time base, shifted by each frame's offset from its schedule
+    base = got[0].t
+    cmd_fit = fit_sine([base + (c - t0) / 1e9 for c in t_cmd], [s.pos_cmd for s in got], cfg.freq)
+    act_fit = fit_sine([base + (f - t0) / 1e9 for f in t_fb], [s.pos for s in got], cfg.freq)
+    err = [math.degrees(s.pos - s.pos_cmd) for s in got]
+    periods_us = [(b - a) / 1e3 for a, b in zip(t_cmd, t_cmd[1:])]
+    mean_us = sum(periods_us) / len(periods_us)
+    out = {
+        "clock": clock,
+        "cycles": len(window),
+        "missed": len(window) - len(got),
+        "rms_err_deg": round(math.sqrt(sum(e * e for e in err) / len(err)), 3),
+        "max_err_deg": round(max(abs(e) for e in err), 3),
+        "gain": None,
+        "phase_lag_deg": None,
+        "lag_ms": None,
+        "loop_hz": round(1e6 / mean_us, 2) if mean_us > 0 else None,
+        "jitter_us": round(math.sqrt(sum((p - mean_us) ** 2 for p in periods_us) / len(periods_us)), 1),
+        "rtt_us": {f"p{p:g}": round(_percentile(rtt, p), 1) for p in (50, 99)} if rtt else None,
+    }
+    if cmd_fit and act_fit and cmd_fit[0] > 0:
+        lag = math.degrees(cmd_fit[1] - act_fit[1])
+        lag = (lag + 180.0) % 360.0 - 180.0
+        out.update(gain=round(act_fit[0] / cmd_fit[0], 4), phase_lag_deg=round(lag, 2),
+                   lag_ms=round(lag / 360.0 / cfg.freq * 1000.0, 2))
+    return out
+
+
+def run(args):
+    driver, bitrate = interface_info(args.interface)
+    configs = [Config(*c) for c in itertools.product(args.kp, args.kd, args.freq, args.amp_deg)]
+    rounds = assignments(configs, args.ids, args.same)
+    seconds = sum(max(swing_plan(c, args.settle, args.periods)[1] for c in plan.values()) for plan in rounds)
+    print(f"🌊 {len(configs)} configurations on {len(args.ids)} motors: {len(rounds)} rounds, "
+          f"about {seconds:.0f} s at {args.rate:g} Hz")
+    cycle = StampedCycle(args.interface, {mid: args.model for mid in args.ids}, args.host_id)
+    timeout = min(args.timeout, 0.8 / args.rate)
+    results = []
+    try:
+        cycle.enable()
+        cycle.write_run_mode(0)
+        time.sleep(0.5)
+        for problem in make_realtime(args.fifo, args.cpu):
+            print(f"⚠️  Not applied: {problem}")
+        for i, plan in enumerate(rounds, 1):
+            samples, loop, finished = run_round(cycle, plan, args.rate, args.settle, args.periods, timeout)
+            for mid, cfg in plan.items():
+                figures = analyse(samples[mid], cfg, args.settle, args.periods)
+                r = {
+                    "tag": args.tag,
+                    "adapter": args.adapter or driver or "unknown",
+                    "interface": args.interface,
+                    "bitrate": bitrate,
+                    "motor_id": mid,
+                    "model": args.model,
+                    "kp": cfg.kp, "kd": cfg.kd, "freq_hz": cfg.freq, "amp_deg": cfg.amp_deg,
+                    "rate_hz": args.rate,
+                    "overruns": loop.overruns,   # of the round, shared by its motors
+                    "time": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+                }
+                r.update(figures or {"missed": len(samples[mid]), "cycles": len(samples[mid])})
+                results.append(r)
+                print_result(r, f"[{i}/{len(rounds)}] ")
+            if not finished:
+                print("🛑 Interrupted")
+                break
+    finally:
+        try:
+            cycle.cycle({mid: (0.0, 0.0, 0.0, 0.0, 0.0) for mid in args.ids})   # limp
+            cycle.stop()
+        except OSError:
+            pass
+        cycle.close()
+    return results
+
+
+def print_result(r, prefix=""):
+    head = f"{prefix}ID {r['motor_id']:3d} kp {r['kp']:g} kd {r['kd']:g} {r['freq_hz']:g} Hz ±{r['amp_deg']:g}°"
+    if "rms_err_deg" not in r:
+        print(f"  {head}: ❌ no replies")
+        return
+    lag = f"lag {r['phase_lag_deg']:+.1f}° ({r['lag_ms']:.1f} ms), gain {r['gain']:.3f}" \
+        if r["gain"] is not None else "no fit"
+    print(f"  {head}: err rms {r['rms_err_deg']:.2f}° max {r['max_err_deg']:.2f}°, {lag}, "
+          f"loop {r['loop_hz']:.1f} Hz ±{r['jitter_us']:.0f} us, {r['missed']} missed [{r['clock']}]")
+
+
+def load(path):
+    with open(path) as f:
+        return [json.loads(line) for line in f if line.strip()]
+
+
+def _key(r):
+    return r["motor_id"], r["kp"], r["kd"], r["freq_hz"], r["amp_deg"]
+
+
+def summary(path):
+    print(f"{'TAG':<12} {'ID':>3} {'KP':>6} {'KD':>5} {'HZ':>5} {'AMP':>5} {'RMS°':>7} {'MAX°':>7} "
+          f"{'LAG°':>7} {'LAG ms':>7} {'GAIN':>6} {'LOOP Hz':>8} {'JIT us':>7} {'MISS':>5} CLOCK")
+    for r in load(path):
+        if "rms_err_deg" not in r:
+            print(f"{r.get('tag') or '-':<12} {r['motor_id']:>3} no replies")
+            continue
+        nan = float('nan')
+        print(f"{r.get('tag') or '-':<12} {r['motor_id']:>3} {r['kp']:>6g} {r['kd']:>5g} {r['freq_hz']:>5g} "
+              f"{r['amp_deg']:>5g} {r['rms_err_deg']:>7.2f} {r['max_err_deg']:>7.2f} "
+              f"{r['phase_lag_deg'] if r['gain'] is not None else nan:>7.1f} "
+              f"{r['lag_ms'] if r['gain'] is not None else nan:>7.1f} {r['gain'] or nan:>6.3f} "
+              f"{r['loop_hz'] or nan:>8.1f} {r['jitter_us']:>7.0f} {r['missed']:>5} {r['clock']}")
+
+
+def compare(path, base, new):
+    """The configurations both tags ran, with the change in error, lag and loop rate (new - base)."""
+    runs = load(path)
+    # The last run of each configuration under a tag counts
+    old = {_key(r): r for r in runs if r.get("tag") == base and "rms_err_deg" in r}
+    cur = {_key(r): r for r in runs if r.get("tag") == new and "rms_err_deg" in r}
+    shared = sorted(set(old) & set(cur))
+    if not shared:
+        print(f"No configuration ran under both {base!r} and {new!r}")
+        return
+    print(f"{new} vs {base}: {len(shared)} configurations")
+    print(f"{'ID':>3} {'KP':>6} {'KD':>5} {'HZ':>5} {'AMP':>5} {'ΔRMS°':>8} {'ΔMAX°':>8} {'ΔLAG ms':>8} "
+          f"{'ΔLOOP Hz':>9} {'ΔJIT us':>8}")
+
+    def delta(a, b, key):
+        return b[key] - a[key] if a.get(key) is not None and b.get(key) is not None else float('nan')
+
+    for k in shared:
+        a, b = old[k], cur[k]
+        print(f"{k[0]:>3} {k[1]:>6g} {k[2]:>5g} {k[3]:>5g} {k[4]:>5g} {delta(a, b, 'rms_err_deg'):>+8.2f} "
+              f"{delta(a, b, 'max_err_deg'):>+8.2f} {delta(a, b, 'lag_ms'):>+8.2f} "
+              f"{delta(a, b, 'loop_hz'):>+9.1f} {delta(a, b, 'jitter_us'):>+8.0f}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Gain/frequency/amplitude sweep of RoboStride sine tracking")
+    parser.add_argument("interface", nargs="?")
+    parser.add_argument("--ids", type=parse_ids, help="motor IDs, e.g. 1-4")
+    parser.add_argument("--model", default="RS02", choices=["RS02", "RS03", "RS04"])
+    parser.add_argument("--host-id", type=lambda s: int(s, 0), default=HOST_ID)
+    parser.add_argument("--kp", type=floats, default=[40.0])
+    parser.add_argument("--kd", type=floats, default=[1.5])
+    parser.add_argument("--freq", type=floats, default=[0.5], help="swing frequencies in Hz")
+    parser.add_argument("--amp-deg", type=floats, default=[90.0], help="swing amplitudes in degrees")
+    parser.add_argument("--same", action="store_true", help="run each configuration on every motor")
+    parser.add_argument("--periods", type=int, default=3, help="measured periods per swing")
+    parser.add_argument("--settle", type=float, default=1.0, help="ramp-in seconds, not measured")
+    parser.add_argument("--rate", type=float, default=200.0, help="loop rate in Hz")
+    parser.add_argument("--timeout", type=float, default=0.004, help="reply deadline per cycle (s)")
+    parser.add_argument("--fifo", type=int, metavar="PRIO", help="run under SCHED_FIFO at this priority (1-99)")
+    parser.add_argument("--cpu", type=int, help="pin the loop to this CPU")
+    parser.add_argument("--tag", help="label of the build under test, for --compare")
+    parser.add_argument("--adapter", help="label for the results (default: the interface's driver)")
+    parser.add_argument("--results", help="append one JSON line per motor and configuration to this file")
+    parser.add_argument("--summary", metavar="FILE", help="print every result of a results file and exit")
+    parser.add_argument("--compare", nargs=3, metavar=("FILE", "BASE_TAG", "NEW_TAG"),
+                        help="compare two tags of a results file and exit")
+    args = parser.parse_args()
+
+    if args.summary:
+        summary(args.summary)
+        return
+    if args.compare:
+        compare(*args.compare)
+        return
+    if args.interface is None or not args.ids:
+        parser.error("interface and --ids are required")
+    results = run(args)
+    if args.results and results:
+        with open(args.results, "a") as f:
+            for r in results:
+                f.write(json.dumps(r) + "\n")
+        print(f"  {len(results)} results appended to {args.results}")
+
+
+if __name__ == "__main__":
+    main()
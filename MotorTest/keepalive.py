@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+RoboStride CAN_TIMEOUT Keep-Alive
+---------------------------------
+A motor with CAN_TIMEOUT set (20000 = 1 s) stops when no frame reaches it
+for that long, which a tool paused at an input() prompt easily trips.
+KeepAlive watches the bus on its own raw socket. SocketCAN loops back every
+frame the other sockets of this host send, so it sees the commands of any
+tool or SDK, and the frames of other hosts too. It sends a motor a
+keep-alive only when nothing was addressed to that motor for --timeout
+minus --margin. A motor under a command stream therefore costs nothing,
+and an idle one one frame (and its reply) per period.
+
+The keep-alive is a type 0 (get_device_id) request, which changes nothing
+on the motor. With --replay it is instead a copy of the last type 1
+(operation control) frame seen for the motor, for firmware that only counts
+commands; until one is seen, type 0 is sent.
+
+    sudo python3 keepalive.py can0 --ids 1-4 --timeout 1.0
+"""
+
+import argparse
+import select
+import socket
+import struct
+import sys
+import threading
+import time
+
+from motor_scan import CAN_EFF_FLAG, CAN_EFF_MASK, CAN_FRAME, HOST_ID, TYPE_GET_ID, parse_ids
+
+TYPE_OP_CONTROL = 1
+CAN_TIMEOUT_UNITS_PER_S = 20000   # the CAN_TIMEOUT parameter counts 50 us steps
+DEFAULT_TIMEOUT = 1.0
+DEFAULT_MARGIN = 0.25             # of the timeout
+RETRY_S = 0.005                   # after a keep-alive the TX queue refused
+
+
+def can_timeout_s(value):
+    """Seconds of a CAN_TIMEOUT parameter value; 0 means the watchdog is off."""
+    return value / CAN_TIMEOUT_UNITS_PER_S
+
+
+class KeepAlive:
+    """Keeps the motors in `motors` inside their CAN_TIMEOUT with as few extra frames as possible."""
+
+    def __init__(self, interface, motors, timeout=DEFAULT_TIMEOUT, margin=DEFAULT_MARGIN,
+                 host_id=HOST_ID, replay=False):
+        self.interface = interface
+        self.host_id = host_id & 0xFF
+        self.replay = replay
+        self.lock = threading.Lock()
+        self.idle = {}        # motor ID -> seconds without a frame before a keep-alive
+        self.last = {}        # motor ID -> monotonic time of the last frame to it
+        self.command = {}     # motor ID -> last type 1 frame seen (--replay)
+        self.seen = 0         # frames to the motors, ours excluded
+        self.sent = 0         # keep-alives
+        self.sock = None
+        for mid in motors:
+            self.watch(mid, timeout, margin)
+        self.sock = socket.socket(socket.AF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+        self._set_filter()
+        self.sock.bind((interface,))
+        self.sock.setblocking(False)
+        self.running = False
+        self.thread = None
+
+    def watch(self, motor_id, timeout=DEFAULT_TIMEOUT, margin=DEFAULT_MARGIN):
+        """Adds a motor, or changes its timeout; a timeout of 0 (watchdog off) forgets it."""
+        with self.lock:
+            if timeout <= 0:
+                self.idle.pop(motor_id, None)
+            else:
+                self.idle[motor_id] = timeout * (1.0 - margin)
+                self.last.setdefault(motor_id, time.monotonic())
+        if self.sock is not None:
+            self._set_filter()
+
+    def forget(self, motor_id):
+        self.watch(motor_id, 0)
+
+    def _set_filter(self):
+        # Extended frames addressed to a watched motor: its ID in bits 0-7 (replies carry the host's)
+        with self.lock:
+            ids = sorted(self.idle)
+        filters = b"".join(struct.pack("=II", mid | CAN_EFF_FLAG, 0xFF | CAN_EFF_FLAG) for mid in ids)
+        # An empty filter list receives nothing
+        self.sock.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_FILTER, filters)
+
+    def start(self):
+        if self.thread is None:
+            self.running = True
+            self.thread = threading.Thread(target=self._run, name="keepalive", daemon=True)
+            self.thread.start()
+        return self
+
+    def stop(self):
+        self.running = False
+        if self.thread is not None:
+            self.thread.join(timeout=1.0)
+            self.thread = None
+        self.sock.close()
+
+    def _frame(self, mid):
+        if self.replay and mid in self.command:
+            return self.command[mid]
+        return CAN_FRAME.pack((TYPE_GET_ID << 24 | self.host_id << 8 | mid) | CAN_EFF_FLAG, 8, bytes(8))
+
+    def _drain(self):
+        while True:
+            try:
+                raw = self.sock.recv(CAN_FRAME.size)
+            except BlockingIOError:
+                return
+            can_id = CAN_FRAME.unpack(raw)[0] & CAN_EFF_MASK
+            mid = can_id & 0xFF
+            with self.lock:
+                if mid in self.idle:
+                    self.last[mid] = time.monotonic()
+                    self.seen += 1
+                    if can_id >> 24 == TYPE_OP_CONTROL:
+                        self.command[mid] = raw
+
+    def _run(self):
+        while self.running:
+            now = time.monotonic()
+            with self.lock:
+                due = [mid for mid, idle in self.idle.items() if now - self.last[mid] >= idle]
+                nxt = min((self.last[mid] + idle for mid, idle in self.idle.items()), default=now + 0.1)
+            for mid in due:
+                try:
+                    self.sock.send(self._frame(mid))
+                except OSError:
+                    # A full TX queue: the bus is busy, try again shortly
+                    with self.lock:
+                        self.last[mid] = now - self.idle.get(mid, 0.0) + RETRY_S
+                    continue
+                with self.lock:
+                    self.last[mid] = now
+                    self.sent += 1
+            # Woken by traffic to re-arm the deadline, at the latest when the next motor is due
+            wait = 0.0 if due else min(max(nxt - now, 0.0), 0.1)
+            if select.select([self.sock], [], [], wait)[0]:
+                self._drain()
+
+    def stats(self):
+        with self.lock:
+            return {'motors': sorted(self.idle), 'seen': self.seen, 'sent': self.sent}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Keep RoboStride motors inside their CAN_TIMEOUT")
+    parser.add_argument("interface")
+    parser.add_argument("--ids", type=parse_ids, required=True, help="motor IDs, e.g. 1-4,7")
+    parser.add_argument("--timeout", type=float, default=DEFAULT_TIMEOUT,
+                        help="CAN_TIMEOUT in seconds (the parameter / 20000)")
+    parser.add_argument("--margin", type=float, default=DEFAULT_MARGIN,
+                        help="share of the timeout a keep-alive goes out before it runs out")
+    parser.add_argument("--host-id", type=lambda s: int(s, 0), default=HOST_ID)
+    parser.add_argument("--replay", action="store_true", help="resend the last type 1 frame instead of type 0")
+    args = parser.parse_args()
+
+    keepalive = KeepAlive(args.interface, args.ids, args.timeout, args.margin, args.host_id, args.replay).start()
+    print(f"💓 Keeping {len(args.ids)} motor(s) alive on {args.interface}, Ctrl-C to stop")
+    try:
+        while True:
+            time.sleep(1.0)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        keepalive.stop()
+    st = keepalive.stats()
+    print(f"\n{st['seen']} frames seen, {st['sent']} keep-alives sent")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
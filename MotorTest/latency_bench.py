@@ -0,0 +1,310 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Round-Trip Latency Benchmark
+----------------------------
+Fires RoboStride requests at one motor at a fixed rate and measures, per
+request, how long the answer took, from kernel timestamps (SO_TIMESTAMPNS):
+
+  - wire:  TX echo -> reply. The echo of our own frame (CAN_RAW_RECV_OWN_MSGS)
+           is stamped when the adapter reports the frame sent, so this is the
+           motor's turnaround plus the adapter's RX path.
+  - host:  send() -> reply. Adds our TX path through the driver and USB.
+
+Requests are type 1 (operation control with zero gains and torque: the motor
+stays limp and answers with type 2) or type 0 (device ID, answered with
+type 0; the motor needs no enable). A reply that has not come back by the
+next request (or --timeout) counts as lost.
+
+Each run prints p50/p99/p99.9 and a log-scale histogram, and with --results
+appends a JSON line tagged with the adapter (driver name by default) and the
+interface's bitrate. --summary prints every run of a results file side by side:
+
+    sudo python3 latency_bench.py can0 127 --type 1 --rate 500 --count 5000 --results latency.jsonl
+    sudo python3 latency_bench.py can1 127 --adapter pcan --results latency.jsonl
+    python3 latency_bench.py --summary latency.jsonl
+"""
+
+import argparse
+import json
+import os
+import select
+import socket
+import struct
+import subprocess
+import sys
+import time
+
+from rt_loop import sleep_until
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'nativeCAN'))
+import robostride  # noqa: E402
+
+HOST_ID = 0xFD
+TYPE_GET_ID = 0              # the reply is type 0 too, with 0xFE in bits 0-7
+
+CAN_FRAME = struct.Struct("=IB3x8s")
+CAN_EFF_FLAG = 0x80000000
+CAN_EFF_MASK = 0x1FFFFFFF
+SO_TIMESTAMPNS = getattr(socket, "SO_TIMESTAMPNS", 35)
+CAN_RAW_RECV_OWN_MSGS = getattr(socket, "CAN_RAW_RECV_OWN_MSGS", 4)
+MSG_CONFIRM = getattr(socket, "MSG_CONFIRM", 0x800)   # set on the echo of a frame this socket sent
+TIMESPEC = struct.Struct("=qq")
+TYPE_MASK = 0x1F << 24
+
+PERCENTILES = (50, 99, 99.9)
+# Histogram bucket edges in us, roughly logarithmic
+BUCKETS = (50, 100, 200, 300, 500, 750, 1000, 1500, 2000, 3000, 5000, 10000, 20000)
+
+
+def interface_info(interface):
+    """(driver name, bitrate) of a SocketCAN interface; None for what cannot be found."""
+    driver = None
+    try:
+        driver = os.path.basename(os.readlink(f"/sys/class/net/{interface}/device/driver"))
+    except OSError:
+        pass
+    bitrate = None
+    try:
+        out = subprocess.run(["ip", "-details", "-json", "link", "show", "dev", interface],
+                             capture_output=True, text=True, check=True).stdout
+        bitrate = json.loads(out)[0]["linkinfo"]["info_data"]["bittiming"]["bitrate"]
+    except (OSError, subprocess.CalledProcessError, ValueError, LookupError, TypeError):
+        pass
+    return driver, bitrate
+
+
+class LatencyProbe:
+    """One request at a time to one motor, on a raw socket that sees its own frames."""
+
+    def __init__(self, interface, motor_id, req_type=1, model="RS02", host_id=HOST_ID):
+        self.motor_id = motor_id & 0xFF
+        self.host_id = host_id & 0xFF
+        self.req_type = req_type
+        self.sock = socket.socket(socket.AF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+        self.sock.setsockopt(socket.SOL_SOCKET, SO_TIMESTAMPNS, 1)
+        self.sock.setsockopt(socket.SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, 1)
+        if req_type == 1:
+            lim = robostride.limits(model)
+            self.request = robostride.pack_op_control(lim, self.motor_id, 0.0, 0.0, 0.0, 0.0, 0.0)
+            reply_type = robostride.TYPE_FEEDBACK
+        else:
+            self.request = (robostride.build_ext_id(self.motor_id, self.host_id, TYPE_GET_ID), bytes(8))
+            reply_type = TYPE_GET_ID
+        # Our own requests (motor ID in bits 0-7) and the motor's replies (motor ID in bits 8-15)
+        self.reply_id = reply_type << 24 | self.motor_id << 8
+        filters = struct.pack("=IIII",
+                              (self.request[0] & (TYPE_MASK | 0xFF)) | CAN_EFF_FLAG, TYPE_MASK | 0xFF | CAN_EFF_FLAG,
+                              self.reply_id | CAN_EFF_FLAG, TYPE_MASK | 0xFF00 | CAN_EFF_FLAG)
+        self.sock.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_FILTER, filters)
+        self.sock.bind((interface,))
+        self.sock.setblocking(False)
+        self.frame = CAN_FRAME.pack(self.request[0] | CAN_EFF_FLAG, 8, self.request[1])
+
+    def close(self):
+        self.sock.close()
+
+    def enable(self):
+        if self.req_type == 1:
+            self.sock.send(CAN_FRAME.pack(robostride.build_ext_id(self.motor_id, self.host_id, robostride.TYPE_ENABLE)
+                                          | CAN_EFF_FLAG, 8, bytes(8)))
+
+    def stop(self):
+        if self.req_type == 1:
+            self.sock.send(CAN_FRAME.pack(robostride.build_ext_id(self.motor_id, self.host_id, robostride.TYPE_STOP)
+                                          | CAN_EFF_FLAG, 8, bytes(8)))
+
+    def _recv(self):
+        """(kind, kernel ns) of the next frame: 'echo' for ours, 'reply' for the motor's; None when empty."""
+        try:
+            raw, ancdata, flags, _ = self.sock.recvmsg(CAN_FRAME.size, socket.CMSG_SPACE(TIMESPEC.size))
+        except BlockingIOError:
+            return None
+        stamp = None
+        for level, kind, data in ancdata:
+            if level == socket.SOL_SOCKET and kind == SO_TIMESTAMPNS:
+                sec, nsec = TIMESPEC.unpack(data[:TIMESPEC.size])
+                stamp = sec * 1_000_000_000 + nsec
+        can_id = CAN_FRAME.unpack(raw)[0] & CAN_EFF_MASK
+        if flags & MSG_CONFIRM:
+            return "echo", stamp
+        if (can_id & (TYPE_MASK | 0xFF00)) == self.reply_id:
+            return "reply", stamp
+        return "other", stamp
+
+    def drain(self):
+        """Discards what is left from the previous request; returns how many replies that was."""
+        late = 0
+        while True:
+            got = self._recv()
+            if got is None:
+                return late
+            late += got[0] == "reply"
+
+    def once(self, timeout):
+        """One request. Returns (host_ns, wire_ns), either None when its stamp is missing, or None when lost."""
+        sent = time.time_ns()             # same clock as the kernel's SO_TIMESTAMPNS (CLOCK_REALTIME)
+        self.sock.send(self.frame)
+        end = time.monotonic() + timeout
+        echo = None
+        while True:
+            remaining = end - time.monotonic()
+            if remaining <= 0 or not select.select([self.sock], [], [], remaining)[0]:
+                return None
+            while True:
+                got = self._recv()
+                if got is None:
+                    break
+                kind, stamp = got
+                if kind == "echo" and echo is None:
+                    echo = stamp
+                elif kind == "reply":
+                    host = stamp - sent if stamp else None
+                    wire = stamp - echo if stamp and echo else None
+                    return host, wire
+
+
+def _percentile(ordered, p):
+    return ordered[min(len(ordered) - 1, int(len(ordered) * p / 100.0))]
+
+
+def stats(samples_ns):
+    if not samples_ns:
+        return None
+    us = sorted(s / 1e3 for s in samples_ns)
+    out = {f"p{p:g}": round(_percentile(us, p), 1) for p in PERCENTILES}
+    out["min"] = round(us[0], 1)
+    out["max"] = round(us[-1], 1)
+    counts = [0] * (len(BUCKETS) + 1)
+    for v in us:
+        i = 0
+        while i < len(BUCKETS) and v >= BUCKETS[i]:
+            i += 1
+        counts[i] += 1
+    out["histogram"] = counts
+    return out
+
+
+def histogram_lines(counts, width=40):
+    edges = ["0"] + [str(b) for b in BUCKETS]
+    top = max(counts) or 1
+    lines = []
+    for i, n in enumerate(counts):
+        if not n:
+            continue
+        label = f"{edges[i]}-{edges[i + 1]}" if i < len(BUCKETS) else f">{BUCKETS[-1]}"
+        lines.append(f"    {label:>12} us  {n:7d}  {'#' * max(1, n * width // top)}")
+    return lines
+
+
+def run(args):
+    driver, bitrate = interface_info(args.interface)
+    probe = LatencyProbe(args.interface, args.motor_id, args.type, args.model, args.host_id)
+    period_ns = int(1e9 / args.rate)
+    timeout = min(args.timeout, 0.9 / args.rate)
+    host, wire = [], []
+    lost = late = 0
+    try:
+        probe.enable()
+        time.sleep(0.1)
+        probe.drain()
+        deadline = time.monotonic_ns() + period_ns
+        for _ in range(args.count):
+            sleep_until(deadline)
+            deadline += period_ns
+            late += probe.drain()
+            result = probe.once(timeout)
+            if result is None:
+                lost += 1
+                continue
+            if result[0] is not None:
+                host.append(result[0])
+            if result[1] is not None:
+                wire.append(result[1])
+        late += probe.drain()
+    finally:
+        try:
+            probe.stop()
+        except OSError:
+            pass
+        probe.close()
+
+    return {
+        "adapter": args.adapter or driver or "unknown",
+        "interface": args.interface,
+        "bitrate": bitrate,
+        "type": args.type,
+        "motor_id": args.motor_id,
+        "rate_hz": args.rate,
+        "sent": args.count,
+        "received": args.count - lost,
+        "lost": lost,
+        "late": late,              # replies that came after their request timed out
+        "host_us": stats(host),
+        "wire_us": stats(wire),
+        "time": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+    }
+
+
+def print_run(r):
+    rate = f"{r['bitrate'] // 1000} kbit/s" if r["bitrate"] else "bitrate unknown"
+    print(f"⏱️  {r['adapter']} on {r['interface']} ({rate}), type {r['type']} to motor {r['motor_id']} "
+          f"at {r['rate_hz']:g} Hz")
+    print(f"  {r['received']}/{r['sent']} answered, {r['lost']} lost, {r['late']} late")
+    for key, label in (("wire_us", "wire (TX echo -> reply)"), ("host_us", "host (send -> reply)")):
+        s = r[key]
+        if s is None:
+            print(f"  {label}: no samples")
+            continue
+        print(f"  {label}: " + "  ".join(f"p{p:g} {s[f'p{p:g}']:.1f}" for p in PERCENTILES)
+              + f"  max {s['max']:.1f} us")
+        for line in histogram_lines(s["histogram"]):
+            print(line)
+
+
+def summary(path):
+    with open(path) as f:
+        runs = [json.loads(line) for line in f if line.strip()]
+    print(f"{'ADAPTER':<14} {'BITRATE':>8} {'TYPE':>4} {'RATE':>6} {'LOSS %':>7} "
+          f"{'WIRE p50':>9} {'p99':>8} {'p99.9':>8} {'HOST p50':>9} {'p99':>8} {'p99.9':>8}  TIME")
+    for r in runs:
+        cells = []
+        for key in ("wire_us", "host_us"):
+            s = r.get(key) or {}
+            cells += [f"{s.get(f'p{p:g}', float('nan')):>{9 if p == 50 else 8}.1f}" for p in PERCENTILES]
+        bitrate = f"{r['bitrate'] // 1000}k" if r.get("bitrate") else "?"
+        loss = 100.0 * r["lost"] / r["sent"] if r["sent"] else 0.0
+        print(f"{r['adapter']:<14} {bitrate:>8} {r['type']:>4} {r['rate_hz']:>6g} {loss:>7.2f} "
+              + " ".join(cells) + f"  {r['time']}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="RoboStride request -> reply latency through a CAN adapter")
+    parser.add_argument("interface", nargs="?")
+    parser.add_argument("motor_id", nargs="?", type=lambda s: int(s, 0))
+    parser.add_argument("--type", type=int, default=1, choices=[0, 1], help="Request type: 1 op control, 0 device ID")
+    parser.add_argument("--model", default="RS02", choices=["RS02", "RS03", "RS04"])
+    parser.add_argument("--host-id", type=lambda s: int(s, 0), default=HOST_ID)
+    parser.add_argument("--rate", type=float, default=200.0, help="Requests per second")
+    parser.add_argument("--count", type=int, default=2000)
+    parser.add_argument("--timeout", type=float, default=0.02, help="Seconds before a request counts as lost")
+    parser.add_argument("--adapter", help="Label for the results (default: the interface's driver)")
+    parser.add_argument("--results", help="Append the run as a JSON line to this file")
+    parser.add_argument("--summary", metavar="FILE", help="Print every run of a results file and exit")
+    args = parser.parse_args()
+
+    if args.summary:
+        summary(args.summary)
+        return
+    if args.interface is None or args.motor_id is None:
+        parser.error("interface and motor_id are required")
+    result = run(args)
+    print_run(result)
+    if args.results:
+        with open(args.results, "a") as f:
+            f.write(json.dumps(result) + "\n")
+        print(f"  appended to {args.results}")
+
+
+if __name__ == "__main__":
+    main()
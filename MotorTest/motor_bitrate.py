@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+RoboStride Bus Bitrate Migration
+--------------------------------
+Moves every motor on a bus to a new bitrate and the adapter with them:
+
+1. Scans the bus at its current bitrate (motor_scan) and notes each motor's
+   ID and MCU ID.
+2. Sends type 23 (set_baud_rate) to each one and checks its type-0 ack.
+3. A motor applies the new rate only after it is powered up again, so the
+   motors are power-cycled: by --power-cycle, a command such as a PDU relay
+   script, or by hand at the prompt.
+4. Sets the SocketCAN interface to the new bitrate (`ip link`). The gs_usb
+   driver hands the bit timing to the TritonCAN adapter when it comes up.
+5. Scans again until every MCU ID of step 1 answers under its old motor ID
+   or --timeout runs out.
+
+If a motor fails to ack or to reappear, the migration is rolled back. The
+motors that did come up at the new rate get type 23 with the old one, the
+interface goes back to the old bitrate, and after another power-cycle the
+bus is scanned to confirm every motor is back. With --config and --bus, a
+finished migration also sets the bus's bitrate in that td_can_bridges config.
+
+    sudo python3 motor_bitrate.py can0 1000000 --dry-run
+    sudo python3 motor_bitrate.py can0 1000000 --power-cycle "./pdu.sh cycle 2" \
+        --config ../untested--pythoncan/config/example_multibus.yaml --bus motor_bus
+"""
+
+import argparse
+import os
+import shlex
+import subprocess
+import sys
+import time
+
+from motor_scan import DEFAULT_IDS, HOST_ID, MotorScan, bitrate_of, parse_ids
+
+TYPE_SET_BAUD = 23
+# Byte 6 of the type-23 payload; bytes 0-5 are the fixed 01..06 of the RoboStride manual
+BAUD_CODES = {1_000_000: 1, 500_000: 2, 250_000: 3, 125_000: 4}
+DEFAULT_TIMEOUT = 10.0
+RESCAN_INTERVAL = 0.5
+
+
+def set_baud_payload(bitrate):
+    return bytes([1, 2, 3, 4, 5, 6, BAUD_CODES[bitrate], 0])
+
+
+def set_interface_bitrate(interface, bitrate):
+    for cmd in (["ip", "link", "set", interface, "down"],
+                ["ip", "link", "set", interface, "type", "can", "bitrate", str(bitrate)],
+                ["ip", "link", "set", interface, "up"]):
+        subprocess.run(cmd, check=True)
+
+
+def power_cycle(command):
+    if command:
+        print(f"🔌 Power-cycling: {command}")
+        subprocess.run(shlex.split(command), check=True)
+    else:
+        input("🔌 Power-cycle the motors now, then press Enter... ")
+
+
+def mcu_map(found):
+    """motor ID -> MCU ID, the first one of a conflicting ID."""
+    return {mid: sorted(mcu_ids)[0] for mid, mcu_ids in found.items()}
+
+
+class BitrateMigration:
+    def __init__(self, interface, host_id=HOST_ID, ids=DEFAULT_IDS, timeout=DEFAULT_TIMEOUT,
+                 power_cycle_cmd=None):
+        self.interface = interface
+        self.host_id = host_id
+        self.ids = list(ids)
+        self.timeout = timeout
+        self.power_cycle_cmd = power_cycle_cmd
+
+    def _scanner(self):
+        return MotorScan(self.interface, self.host_id)
+
+    def scan(self, bitrate):
+        scanner = self._scanner()
+        try:
+            return scanner.scan(self.ids, bitrate=bitrate)
+        finally:
+            scanner.close()
+
+    def set_baud(self, motors, bitrate, current):
+        """Type 23 to each motor; the motor IDs that acked."""
+        scanner = self._scanner()
+        try:
+            acks = scanner.burst(sorted(motors), TYPE_SET_BAUD, set_baud_payload(bitrate), bitrate=current)
+        finally:
+            scanner.close()
+        return set(acks) & set(motors)
+
+    def wait_for(self, expected, bitrate):
+        """Rescans until every expected motor ID answers with its MCU ID; the motors seen."""
+        deadline = time.monotonic() + self.timeout
+        while True:
+            seen = mcu_map(self.scan(bitrate))
+            missing = [mid for mid, mcu in expected.items() if seen.get(mid) != mcu]
+            if not missing or time.monotonic() >= deadline:
+                return seen
+            time.sleep(RESCAN_INTERVAL)
+
+    def run(self, target, current):
+        found = self.scan(current)
+        if not found:
+            print(f"❌ No motors answered on {self.interface} at {current} bit/s")
+            return False
+        conflicts = [mid for mid, mcu_ids in found.items() if len(mcu_ids) > 1]
+        if conflicts:
+            print(f"❌ ID conflict on {', '.join(map(str, conflicts))}: fix the IDs first")
+            return False
+        motors = mcu_map(found)
+        print(f"🔎 {len(motors)} motor(s) at {current} bit/s: {', '.join(map(str, sorted(motors)))}")
+
+        acked = self.set_baud(motors, target, current)
+        if acked != set(motors):
+            # Nothing has taken effect before a power-cycle: undo the motors that did ack
+            print(f"❌ No set_baud_rate ack from {', '.join(map(str, sorted(set(motors) - acked)))}")
+            if acked:
+                self.set_baud(acked, current, current)
+            return False
+        print(f"✅ All {len(acked)} motor(s) acked {target} bit/s")
+
+        power_cycle(self.power_cycle_cmd)
+        set_interface_bitrate(self.interface, target)
+        seen = self.wait_for(motors, target)
+        missing = sorted(mid for mid, mcu in motors.items() if seen.get(mid) != mcu)
+        if not missing:
+            print(f"✅ All {len(motors)} motor(s) back at {target} bit/s")
+            return True
+
+        print(f"❌ Not back at {target} bit/s: {', '.join(map(str, missing))}. Rolling back to {current} bit/s")
+        moved = {mid: mcu for mid, mcu in motors.items() if seen.get(mid) == mcu}
+        if moved:
+            self.set_baud(moved, current, target)
+        set_interface_bitrate(self.interface, current)
+        power_cycle(self.power_cycle_cmd)
+        seen = self.wait_for(motors, current)
+        lost = sorted(mid for mid, mcu in motors.items() if seen.get(mid) != mcu)
+        if lost:
+            print(f"⚠️  Still missing at {current} bit/s: {', '.join(map(str, lost))}")
+        else:
+            print(f"↩️  All {len(motors)} motor(s) back at {current} bit/s")
+        return False
+
+
+def write_bitrate(path, bus_name, bitrate):
+    import yaml
+
+    with open(path) as f:
+        cfg = yaml.safe_load(f)
+    for bus in cfg.get('buses', []):
+        if bus.get('name') == bus_name or bus.get('interface') == bus_name:
+            bus['bitrate'] = bitrate
+            break
+    else:
+        raise SystemExit(f"No bus matches name/interface: {bus_name}")
+    with open(path, 'w') as f:
+        f.write(yaml.safe_dump(cfg, sort_keys=False))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Move every RoboStride motor on a bus to a new bitrate")
+    parser.add_argument("interface")
+    parser.add_argument("bitrate", type=int, choices=sorted(BAUD_CODES))
+    parser.add_argument("--ids", type=parse_ids, default=list(DEFAULT_IDS), help="motor IDs to probe, e.g. 1-127")
+    parser.add_argument("--host-id", type=lambda s: int(s, 0), default=HOST_ID)
+    parser.add_argument("--current", type=int, help="current bitrate (default: read from the interface)")
+    parser.add_argument("--power-cycle", help="command that power-cycles the motors (default: prompt)")
+    parser.add_argument("--timeout", type=float, default=DEFAULT_TIMEOUT,
+                        help="seconds to wait for the motors after a power-cycle")
+    parser.add_argument("--dry-run", action="store_true", help="scan and print the plan only")
+    parser.add_argument("--config", help="td_can_bridges YAML config whose bus bitrate to update")
+    parser.add_argument("--bus", help="bus name or interface in --config (default: the interface)")
+    args = parser.parse_args()
+
+    if os.geteuid() != 0 and not args.dry_run:
+        print("⚠️  Reconfiguring the interface needs root", file=sys.stderr)
+    current = args.current or bitrate_of(args.interface, default=None)
+    if current is None:
+        raise SystemExit(f"Cannot read the bitrate of {args.interface}: pass --current")
+    if current == args.bitrate:
+        print(f"{args.interface} already runs at {current} bit/s")
+        return 0
+
+    migration = BitrateMigration(args.interface, args.host_id, args.ids, args.timeout, args.power_cycle)
+    if args.dry_run:
+        motors = mcu_map(migration.scan(current))
+        print(f"🔎 {len(motors)} motor(s) at {current} bit/s would move to {args.bitrate} bit/s:")
+        for mid, mcu in sorted(motors.items()):
+            print(f"  ID {mid:3d} (0x{mid:02X})  MCU {mcu}")
+        return 0 if motors else 1
+
+    if not migration.run(args.bitrate, current):
+        return 1
+    if args.config:
+        write_bitrate(args.config, args.bus or args.interface, args.bitrate)
+        print(f"Updated {args.config}: bitrate {args.bitrate}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Pipelined Multi-Motor Cycle
+---------------------------
+One control cycle for N RoboStride motors on a raw SocketCAN socket: all N
+type-1 (operation control) frames go out back to back, then the N type-2
+replies are collected against a single deadline and matched by the motor ID
+in bits 8-15 of the extended identifier. A cycle costs about one round trip
+plus N frame times on the wire, instead of N round trips as with
+write_operation_frame / read_operation_frame per motor.
+
+Packing comes from nativeCAN/robostride.py, the codec the firmware shares.
+
+Demo (limp hold, zero gains), pipelined vs one motor at a time:
+    sudo python3 motor_cycle.py can0 1 2 3 --model RS02 --cycles 500
+"""
+
+import argparse
+import errno
+import os
+import select
+import socket
+import struct
+import sys
+import time
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'nativeCAN'))
+import robostride  # noqa: E402
+
+HOST_ID = 0xFD               # the RoboStride default host ID, where feedback is addressed
+REPLY_TIMEOUT = 0.005        # one deadline for every reply of a cycle
+TX_RETRIES = 20
+
+CAN_FRAME = struct.Struct("=IB3x8s")
+CAN_EFF_FLAG = 0x80000000
+CAN_EFF_MASK = 0x1FFFFFFF
+
+
+class MotorCycle:
+    """Sends every motor's command and collects every reply, once per cycle()."""
+
+    def __init__(self, interface, motors, host_id=HOST_ID):
+        """motors maps motor ID -> model ('RS02', 'RS03', 'RS04')."""
+        self.host_id = host_id & 0xFF
+        self.ids = list(motors)
+        self.lims = {mid: robostride.limits(model) for mid, model in motors.items()}
+        self.sock = socket.socket(socket.AF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+        # Only type-2 frames addressed to us: comm type in bits 24-28, host ID in bits 0-7
+        feedback_id = robostride.build_ext_id(self.host_id, 0, robostride.TYPE_FEEDBACK) | CAN_EFF_FLAG
+        mask = (0x1F << 24) | 0xFF | CAN_EFF_FLAG
+        self.sock.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_FILTER, struct.pack("=II", feedback_id, mask))
+        self.sock.bind((interface,))
+        self.sock.setblocking(False)
+        self.cycles = 0
+        self.missed = 0          # replies that did not arrive by the deadline
+        self.late = 0            # replies found at the start of a cycle (after a deadline), dropped
+
+    def close(self):
+        self.sock.close()
+
+    def _send(self, can_id, data):
+        frame = CAN_FRAME.pack(can_id | CAN_EFF_FLAG, 8, data)
+        # A burst of N can fill the interface's TX queue (txqueuelen); give it a moment to drain
+        for _ in range(TX_RETRIES):
+            try:
+                self.sock.send(frame)
+                return
+            except (BlockingIOError, OSError) as e:
+                if not isinstance(e, BlockingIOError) and e.errno != errno.ENOBUFS:
+                    raise
+                time.sleep(50e-6)
+        raise OSError(errno.ENOBUFS, f"TX queue full, frame 0x{can_id:08X} not sent")
+
+    def _drain(self):
+        """Throws away replies from earlier cycles so they cannot be matched to this one."""
+        while True:
+            try:
+                self.sock.recv(CAN_FRAME.size)
+                self.late += 1
+            except BlockingIOError:
+                return
+
+    def enable(self):
+        """Type 3 to every motor (host ID in the type-specific bits); the replies are not waited for."""
+        for mid in self.ids:
+            self._send(robostride.build_ext_id(mid, self.host_id, robostride.TYPE_ENABLE), bytes(8))
+
+    def stop(self):
+        """Type 4 to every motor."""
+        for mid in self.ids:
+            self._send(robostride.build_ext_id(mid, self.host_id, robostride.TYPE_STOP), bytes(8))
+
+    def cycle(self, commands, timeout=REPLY_TIMEOUT):
+        """commands maps motor ID -> (pos, vel, torque, kp, kd). Returns motor ID -> robostride.Feedback
+        for every reply by the deadline; a motor that did not answer is missing from the result."""
+        self._drain()
+        ids = [mid for mid in self.ids if mid in commands]
+        frames = robostride.pack_op_control_batch([self.lims[mid] for mid in ids], ids,
+                                                  [commands[mid] for mid in ids])
+        for can_id, data in frames:
+            self._send(can_id, data)
+
+        deadline = time.perf_counter() + timeout
+        pending = set(ids)
+        out = {}
+        while pending:
+            remaining = deadline - time.perf_counter()
+            if remaining <= 0 or not select.select([self.sock], [], [], remaining)[0]:
+                break
+            while True:
+                try:
+                    raw = self.sock.recv(CAN_FRAME.size)
+                except BlockingIOError:
+                    break
+                can_id, _, data = CAN_FRAME.unpack(raw)
+                can_id &= CAN_EFF_MASK
+                mid = (can_id >> 8) & 0xFF
+                if mid in pending:
+                    out[mid] = robostride.decode_feedback(self.lims[mid], can_id, data)
+                    pending.discard(mid)
+        self.cycles += 1
+        self.missed += len(pending)
+        return out
+
+
+def _bench(cycle, commands, cycles, sequential):
+    times = []
+    missed0 = cycle.missed
+    for _ in range(cycles):
+        t0 = time.perf_counter()
+        if sequential:
+            # The per-motor pattern: one full round trip each
+            for mid, cmd in commands.items():
+                cycle.cycle({mid: cmd})
+        else:
+            cycle.cycle(commands)
+        times.append((time.perf_counter() - t0) * 1e6)
+        time.sleep(0.002)
+    times.sort()
+    return times[len(times) // 2], times[int(len(times) * 0.99)], cycle.missed - missed0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pipelined N-motor command/feedback cycle")
+    parser.add_argument("interface")
+    parser.add_argument("motor_ids", nargs="+", type=lambda s: int(s, 0))
+    parser.add_argument("--model", default="RS02", choices=["RS02", "RS03", "RS04"])
+    parser.add_argument("--host-id", type=lambda s: int(s, 0), default=HOST_ID)
+    parser.add_argument("--cycles", type=int, default=500)
+    args = parser.parse_args()
+
+    cycle = MotorCycle(args.interface, {mid: args.model for mid in args.motor_ids}, args.host_id)
+    try:
+        cycle.enable()
+        time.sleep(0.1)
+        # Zero gains and zero torque: the motors stay limp while we time the bus
+        commands = {mid: (0.0, 0.0, 0.0, 0.0, 0.0) for mid in args.motor_ids}
+        print(f"⏱️  {len(commands)} motors, {args.cycles} cycles each way")
+        for label, sequential in (("pipelined", False), ("one at a time", True)):
+            p50, p99, missed = _bench(cycle, commands, args.cycles, sequential)
+            print(f"  {label:<14} p50 {p50:7.0f} us   p99 {p99:7.0f} us   {missed} replies missed")
+    finally:
+        try:
+            cycle.stop()
+        except OSError:
+            pass
+        cycle.close()
+
+
+if __name__ == "__main__":
+    main()
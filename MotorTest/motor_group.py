@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+RoboStride Group Commands
+-------------------------
+Enables, stops or zeroes a set of motors at once. Every motor's type 3/4/6
+frame goes out back to back, well inside one control cycle, and the type 2
+replies are collected on one raw socket as they arrive. So a whole-robot
+transition takes about one round trip rather than one per motor. A motor
+counts as confirmed once a type 2 frame comes back from it after its
+command and shows the expected mode: run after enable, reset after stop,
+either after set zero. Motors still unconfirmed at the deadline are the
+stragglers. With --retries they get their frame again, spread over the
+deadline.
+
+With active reporting (type 24) on, a report sent just before the command
+can arrive after it; the mode check keeps that from confirming an enable or
+a stop, but not a set zero.
+
+    sudo python3 motor_group.py can0 enable --ids 1-12
+    sudo python3 motor_group.py can0 stop --ids 1-12 --clear-faults --timeout 0.05
+"""
+
+import argparse
+import errno
+import select
+import socket
+import struct
+import sys
+import time
+from collections import namedtuple
+
+from motor_scan import CAN_EFF_FLAG, CAN_EFF_MASK, CAN_FRAME, HOST_ID, TYPE_MASK, parse_ids, robostride
+
+TYPE_ENABLE = robostride.TYPE_ENABLE
+TYPE_STOP = robostride.TYPE_STOP
+TYPE_SET_ZERO = 6
+MODE_RESET, MODE_CALI, MODE_RUN = 0, 1, 2
+MODE_NAMES = {MODE_RESET: "reset", MODE_CALI: "cali", MODE_RUN: "run"}
+DEFAULT_TIMEOUT = 0.1
+
+# op -> (comm type, data byte 0, mode that confirms it; None: any)
+OPS = {
+    'enable': (TYPE_ENABLE, 0, MODE_RUN),
+    'stop': (TYPE_STOP, 0, MODE_RESET),
+    'zero': (TYPE_SET_ZERO, 1, None),
+}
+
+GroupResult = namedtuple('GroupResult', 'op confirmed stragglers wrong_mode burst_s seconds')
+# confirmed: motor ID -> (seconds from the burst's start, Feedback); wrong_mode: motor ID -> last Feedback
+
+
+class MotorGroup:
+    """Group commands to `motors` on a raw socket that sees only the type 2 frames addressed to host_id."""
+
+    def __init__(self, interface, motors, host_id=HOST_ID, model='RS02'):
+        self.interface = interface
+        self.motors = list(dict.fromkeys(motors))
+        self.host_id = host_id & 0xFF
+        self.lim = robostride.limits(model)
+        self.sock = socket.socket(socket.AF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+        self.sock.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_FILTER,
+                             struct.pack("=II", robostride.TYPE_FEEDBACK << 24 | self.host_id | CAN_EFF_FLAG,
+                                         TYPE_MASK | 0xFF | CAN_EFF_FLAG))
+        self.sock.bind((interface,))
+        self.sock.setblocking(False)
+
+    def close(self):
+        self.sock.close()
+
+    def enable(self, timeout=DEFAULT_TIMEOUT, retries=0):
+        return self.command('enable', timeout, retries)
+
+    def stop(self, clear_faults=False, timeout=DEFAULT_TIMEOUT, retries=0):
+        return self.command('stop', timeout, retries, data0=1 if clear_faults else 0)
+
+    def set_zero(self, timeout=DEFAULT_TIMEOUT, retries=0):
+        return self.command('zero', timeout, retries)
+
+    def command(self, op, timeout=DEFAULT_TIMEOUT, retries=0, data0=None):
+        """Sends `op` to every motor back to back; returns when all confirmed or after `timeout`."""
+        comm_type, default0, expect = OPS[op]
+        data = bytes([default0 if data0 is None else data0]) + bytes(7)
+        self._drain()
+        pending = set(self.motors)
+        confirmed, wrong_mode = {}, {}
+        start = time.perf_counter()
+        self._burst(comm_type, data, self.motors)
+        burst_s = time.perf_counter() - start
+        deadline = start + timeout
+        resend_every = timeout / (retries + 1)
+        resend_at = start + resend_every
+        while pending:
+            now = time.perf_counter()
+            if now >= deadline:
+                break
+            if retries and now >= resend_at:
+                self._burst(comm_type, data, sorted(pending))
+                resend_at += resend_every
+                retries -= 1
+            wait = min(deadline, resend_at) if retries else deadline
+            if not select.select([self.sock], [], [], max(0.0, wait - now))[0]:
+                continue
+            for can_id, payload in self._recv_all():
+                fb = robostride.decode_feedback(self.lim, can_id, payload)
+                if fb.motor_id not in pending:
+                    continue
+                if expect is not None and fb.mode != expect:
+                    wrong_mode[fb.motor_id] = fb
+                    continue
+                pending.discard(fb.motor_id)
+                wrong_mode.pop(fb.motor_id, None)
+                confirmed[fb.motor_id] = (time.perf_counter() - start, fb)
+        return GroupResult(op, confirmed, sorted(pending), wrong_mode, burst_s, time.perf_counter() - start)
+
+    def _burst(self, comm_type, data, motors):
+        frames = [CAN_FRAME.pack(robostride.build_ext_id(mid & 0xFF, self.host_id, comm_type) | CAN_EFF_FLAG, 8, data)
+                  for mid in motors]
+        for frame in frames:
+            while True:
+                try:
+                    self.sock.send(frame)
+                    break
+                except (BlockingIOError, OSError) as e:
+                    if not isinstance(e, BlockingIOError) and e.errno != errno.ENOBUFS:
+                        raise
+                    time.sleep(50e-6)  # TX queue full: the deadline still bounds the call
+
+    def _recv_all(self):
+        while True:
+            try:
+                raw = self.sock.recv(CAN_FRAME.size)
+            except BlockingIOError:
+                return
+            can_id, _, payload = CAN_FRAME.unpack(raw)
+            yield can_id & CAN_EFF_MASK, payload
+
+    def _drain(self):
+        for _ in self._recv_all():
+            pass  # replies to earlier commands must not confirm this one
+
+
+def report(result):
+    """Lines for a terminal: the confirmations by latency, then the stragglers."""
+    n = len(result.confirmed) + len(result.stragglers)
+    lines = [f"{result.op}: {len(result.confirmed)}/{n} confirmed in {result.seconds * 1000:.1f} ms "
+             f"(burst {result.burst_s * 1e6:.0f} us)"]
+    for mid, (t, fb) in sorted(result.confirmed.items(), key=lambda item: item[1][0]):
+        fault = f"  ⚠️  fault 0x{fb.fault:02X}" if fb.fault else ""
+        lines.append(f"  ID {mid:3d}  {t * 1000:6.2f} ms  {MODE_NAMES.get(fb.mode, fb.mode)}  "
+                     f"pos {fb.pos:+.3f} rad{fault}")
+    for mid in result.stragglers:
+        fb = result.wrong_mode.get(mid)
+        why = f"answered in mode {MODE_NAMES.get(fb.mode, fb.mode)}" if fb else "no answer"
+        lines.append(f"  ID {mid:3d}  ❌ {why}")
+    return lines
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Enable, stop or zero a set of RoboStride motors at once")
+    parser.add_argument("interface")
+    parser.add_argument("op", choices=sorted(OPS))
+    parser.add_argument("--ids", type=parse_ids, required=True, help="motor IDs, e.g. 1-12")
+    parser.add_argument("--host-id", type=lambda s: int(s, 0), default=HOST_ID)
+    parser.add_argument("--model", default='RS02', help="for the position in the report")
+    parser.add_argument("--timeout", type=float, default=DEFAULT_TIMEOUT, help="seconds until the stragglers are reported")
+    parser.add_argument("--retries", type=int, default=0, help="resends to the stragglers within --timeout")
+    parser.add_argument("--clear-faults", action="store_true", help="stop: also clear the motors' faults")
+    args = parser.parse_args()
+
+    group = MotorGroup(args.interface, args.ids, args.host_id, args.model)
+    try:
+        if args.op == 'stop':
+            result = group.stop(args.clear_faults, args.timeout, args.retries)
+        else:
+            result = group.command(args.op, args.timeout, args.retries)
+    finally:
+        group.close()
+    print("\n".join(report(result)))
+    return 1 if result.stragglers else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -6,7 +6,10 @@ RoboStride All-Inclusive Command Hub (RS-02 Edition)
 A terminal-based tool for exploring motor functionality, testing commands,
 and debugging the RoboStride RS-02 motor.
 
-Usage: sudo python3 motor_hub.py [motor_id] [interface]
+Usage: sudo python3 motor_hub.py [motor_id] [interface] [mit_rate_hz]
+
+Without a motor_id (or with "scan") the bus is scanned first (motor_scan.py)
+and the motor found is used; 127 when none answers.
 """
 
 import sys
@@ -16,6 +19,10 @@ import struct
 import threading
 import math
 import signal
+import select
+import termios
+import tty
+from collections import deque
 
 # --- 1. Environment Setup ---
 # Add the SDK path (assuming running from python/ directory)
@@ -32,6 +39,10 @@ except ImportError as e:
     print("   Please ensure you are running this from the 'python/' directory.")
     sys.exit(1)
 
+from keepalive import KeepAlive
+from motor_scan import MotorScan, parse_ids
+from motor_group import MotorGroup, report
+
 # --- 2. RS-02 Parameter Patch (Crucial for correct physics) ---
 RS02_PARAMS = {
     "rs-02": {
@@ -53,13 +64,148 @@ table.MODEL_MIT_KD_TABLE["rs-02"]       = RS02_PARAMS["rs-02"]["kd"]
 # Create a dictionary of all available parameters from the SDK for easy menu selection
 PARAM_MAP = {k: v for k, v in vars(ParameterType).items() if not k.startswith('__')}
 
+# --- 4. MIT Control Loop ---
+# The RS-02 drops to a fault when MIT commands stop arriving (CAN watchdog), so the
+# command stream runs in its own fixed-rate thread and the UI only edits the setpoint.
+MIT_RATE_HZ = 500
+SPIN_S = 0.0005      # busy-wait the last 0.5 ms before each deadline; sleep() alone overshoots
+
+
+class MitSetpoint:
+    """Shared MIT command: written by the UI, read once per tick by the control thread."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.pos = 0.0     # rad
+        self.vel = 0.0     # rad/s
+        self.kp = 0.0
+        self.kd = 0.0
+        self.torque = 0.0  # Nm, feed-forward
+
+    def set(self, **values):
+        with self.lock:
+            for key, value in values.items():
+                setattr(self, key, value)
+
+    def get(self):
+        with self.lock:
+            return self.pos, self.vel, self.kp, self.kd, self.torque
+
+
+class MitLoop(threading.Thread):
+    """Sends the setpoint at rate_hz on absolute deadlines and keeps the latest feedback."""
+
+    def __init__(self, bus, motor_name, setpoint, rate_hz=MIT_RATE_HZ):
+        super().__init__(name="mit-loop", daemon=True)
+        self.bus = bus
+        self.motor_name = motor_name
+        self.setpoint = setpoint
+        self.period = 1.0 / rate_hz
+        self.running = True
+        self.lock = threading.Lock()
+        self.feedback = None           # (pos, vel, torque, temp) of the last reply
+        self.errors = 0
+        self.last_error = None
+        self.overruns = 0              # ticks that started a whole period late
+        self.ticks = deque(maxlen=max(2, int(rate_hz)))  # start times over the last second
+
+    def run(self):
+        # A real-time priority keeps the scheduler from parking us past a deadline (needs root)
+        try:
+            os.sched_setscheduler(0, os.SCHED_FIFO, os.sched_param(50))
+        except (AttributeError, PermissionError, OSError):
+            pass
+        deadline = time.perf_counter()
+        while self.running:
+            now = time.perf_counter()
+            if now - deadline > self.period:
+                # Missed a whole period: count it and re-phase instead of sending a burst
+                self.overruns += 1
+                deadline = now
+            with self.lock:
+                self.ticks.append(now)
+            pos, vel, kp, kd, torque = self.setpoint.get()
+            try:
+                self.bus.write_operation_frame(self.motor_name, pos, kp, kd, vel, torque)
+                fb = self.bus.read_operation_frame(self.motor_name)
+                with self.lock:
+                    self.feedback = fb
+            except Exception as e:
+                self.errors += 1
+                self.last_error = str(e)
+
+            deadline += self.period
+            remaining = deadline - time.perf_counter()
+            if remaining > SPIN_S:
+                time.sleep(remaining - SPIN_S)
+            while time.perf_counter() < deadline:
+                pass
+
+    def stop(self):
+        self.running = False
+        if self.is_alive() and threading.current_thread() is not self:
+            self.join(timeout=1.0)
+
+    def stats(self):
+        """Achieved rate (Hz) and period jitter (RMS and worst deviation, us) over the last second."""
+        with self.lock:
+            ticks = list(self.ticks)
+            fb = self.feedback
+        if len(ticks) < 2:
+            return 0.0, 0.0, 0.0, fb
+        periods = [b - a for a, b in zip(ticks, ticks[1:])]
+        hz = len(periods) / (ticks[-1] - ticks[0])
+        devs = [p - self.period for p in periods]
+        rms = math.sqrt(sum(d * d for d in devs) / len(devs))
+        worst = max(abs(d) for d in devs)
+        return hz, rms * 1e6, worst * 1e6, fb
+
+
+class LineInput:
+    """Non-blocking line editor on a raw terminal: poll() returns a finished line or None."""
+
+    def __init__(self):
+        self.fd = sys.stdin.fileno()
+        self.saved = None
+        self.buf = ""
+
+    def __enter__(self):
+        if os.isatty(self.fd):
+            self.saved = termios.tcgetattr(self.fd)
+            tty.setcbreak(self.fd)
+        return self
+
+    def __exit__(self, *exc):
+        if self.saved is not None:
+            termios.tcsetattr(self.fd, termios.TCSADRAIN, self.saved)
+
+    def poll(self, timeout):
+        ready, _, _ = select.select([self.fd], [], [], timeout)
+        if not ready:
+            return None
+        ch = os.read(self.fd, 1).decode(errors="ignore")
+        if ch in ("\n", "\r"):
+            line, self.buf = self.buf, ""
+            return line
+        if ch in ("\x7f", "\b"):
+            self.buf = self.buf[:-1]
+        elif ch == "":
+            return "q"     # stdin closed
+        elif ch.isprintable():
+            self.buf += ch
+        return None
+
 class MotorHub:
-    def __init__(self, motor_id=127, interface='can0'):
+    def __init__(self, motor_id=127, interface='can0', mit_rate_hz=MIT_RATE_HZ):
         self.motor_id = motor_id
         self.motor_name = f"motor_{motor_id}"
         self.interface = interface
+        self.mit_rate_hz = mit_rate_hz
+        self.mit_loop = None
+        self.keepalive = None
         self.bus = None
         self.connected = False
+        self.scanned = []  # motor IDs of the last scan, for the group commands
         
     def connect(self):
         print(f"\n🔌 Connecting to Motor ID {self.motor_id} on {self.interface}...")
@@ -69,11 +215,23 @@ class MotorHub:
             self.bus.connect(handshake=True)
             self.connected = True
             print("✅ Connected successfully.")
+            # Menus wait on input(): keep the motor inside CAN_TIMEOUT while nothing else is sent
+            try:
+                self.keepalive = KeepAlive(self.interface, [self.motor_id]).start()
+            except OSError as e:
+                print(f"⚠️ No CAN_TIMEOUT keep-alive: {e}")
         except Exception as e:
             print(f"❌ Connection failed: {e}")
             self.connected = False
 
     def disconnect(self):
+        # The MIT thread must not keep writing to a bus that is going away
+        if self.mit_loop:
+            self.mit_loop.stop()
+            self.mit_loop = None
+        if self.keepalive:
+            self.keepalive.stop()
+            self.keepalive = None
         if self.bus:
             print("\n🔌 Disconnecting...")
             try:
@@ -92,6 +250,33 @@ class MotorHub:
 
     # --- COMMAND IMPLEMENTATIONS ---
 
+    def cmd_scan(self):
+        """Type-0 scan of the bus; picks the motor found, or asks when there are several."""
+        scanner = MotorScan(self.interface)
+        try:
+            found = scanner.scan()
+        finally:
+            scanner.close()
+        if not found:
+            print(f"🔎 No motor answered on {self.interface}.")
+            return False
+        print(f"🔎 {len(found)} motor(s) on {self.interface}:")
+        for mid, mcu_ids in sorted(found.items()):
+            note = "  ⚠️  ID conflict" if len(mcu_ids) > 1 else ""
+            print(f"  ID {mid:3d}  MCU {', '.join(sorted(mcu_ids))}{note}")
+        self.scanned = sorted(found)
+        mid = next(iter(found))
+        if len(found) > 1:
+            try:
+                mid = int(input(f"Motor ID to use [{min(found)}]: ") or min(found))
+            except ValueError:
+                mid = min(found)
+        if self.connected and mid != self.motor_id:
+            self.disconnect()
+        self.motor_id = mid
+        self.motor_name = f"motor_{mid}"
+        return True
+
     def cmd_enable(self):
         if not self._check_connection(): return
         print(f"Sending ENABLE command to ID {self.motor_id}...")
@@ -114,6 +299,31 @@ class MotorHub:
             self.bus.transmit(CommunicationType.SET_ZERO_POSITION, self.bus.host_id, self.motor_id)
             print("✅ Zero position set.")
 
+    def cmd_group(self):
+        """Enable, stop or zero every scanned motor in one burst (motor_group.py); reports the stragglers."""
+        default = self.scanned or [self.motor_id]
+        text = input(f"Motor IDs [{','.join(map(str, default))}]: ").strip()
+        try:
+            ids = parse_ids(text) if text else default
+        except ValueError:
+            print("Invalid IDs.")
+            return
+        op = input("Command: (e)nable, (s)top, (c)lear faults and stop, (z)ero: ").strip().lower()
+        if op == 'z' and input("   Redefine the current positions as 0.0 rad? (y/n): ").lower() != 'y':
+            return
+        group = MotorGroup(self.interface, ids)
+        try:
+            if op == 'e': result = group.enable()
+            elif op == 's': result = group.stop()
+            elif op == 'c': result = group.stop(clear_faults=True)
+            elif op == 'z': result = group.set_zero()
+            else:
+                print("Invalid selection.")
+                return
+        finally:
+            group.close()
+        print("\n".join(report(result)))
+
     def cmd_clear_faults(self):
         if not self._check_connection(): return
         print(f"Sending CLEAR_FAULTS command...")
@@ -203,68 +413,77 @@ class MotorHub:
         if not self._check_connection(): return
         print("\n🎮 --- MIT CONTROL MODE ---")
         print("This mode gives you direct control over Pos, Vel, Kp, Kd, Torque.")
-        print("Steps:")
-        print("  1. Switching motor to MIT Mode (Mode 0)")
-        print("  2. Entering interactive loop")
-        print("  3. Type 'q' to exit loop")
-        
+        print(f"Commands stream at {self.mit_rate_hz} Hz from a background thread;")
+        print("typing only changes the setpoint, so the motor never misses a frame.")
+        print("\nCommands (Enter to apply):")
+        print("  'k <val>'  -> Set Stiffness (Kp) (0-500) [Start low! e.g. 5]")
+        print("  'd <val>'  -> Set Damping (Kd) (0-5)     [e.g. 0.5]")
+        print("  'p <val>'  -> Set Position (deg)         [e.g. 90]")
+        print("  'v <val>'  -> Set Velocity (rad/s)")
+        print("  't <val>'  -> Set Feed-forward Torque (Nm)")
+        print("  'z'        -> Zero all gains (Limp)")
+        print("  'q'        -> Exit\n")
+
+        setpoint = MitSetpoint()
+        message = ""
         try:
             self.bus.write(self.motor_name, ParameterType.MODE, 0)
             time.sleep(0.2)
             self.bus.enable(self.motor_name)
-            
-            kp = 0.0
-            kd = 0.0
-            pos = 0.0
-            
-            print("\nReady. Commands:")
-            print("  'k <val>'  -> Set Stiffness (Kp) (0-500) [Start low! e.g. 5]")
-            print("  'd <val>'  -> Set Damping (Kd) (0-5)     [e.g. 0.5]")
-            print("  'p <val>'  -> Set Position (deg)         [e.g. 90]")
-            print("  'z'        -> Zero all gains (Limp)")
-            
-            while True:
-                # Send frame
-                self.bus.write_operation_frame(self.motor_name, pos, kp, kd, 0.0, 0.0)
-                # Read feedback
-                p_fb, v_fb, t_fb, temp = self.bus.read_operation_frame(self.motor_name)
-                
-                # Print Status
-                status = f"\rStatus: Pos={math.degrees(p_fb):6.1f}° | Trq={t_fb:5.2f}Nm | Cmd: P={math.degrees(pos):.1f}° Kp={kp} Kd={kd}   "
-                sys.stdout.write(status)
-                sys.stdout.flush()
-                
-                # Non-blocking input would be ideal, but for simplicity in this hub
-                # we will use blocking input. This means the motor "holds" last command 
-                # while you type.
-                # To keep the watchdog happy, we'll use a small trick: 
-                # A background thread sending heartbeats could be used, 
-                # but let's just use simple prompt for this educational tool.
-                
-                # Actually, for safety in MIT mode, we must keep sending. 
-                # We will break the live update to ask for input.
-                print("\n")
-                user_in = input("Command > ").strip().lower()
-                
-                if user_in == 'q': break
-                elif user_in == 'z': 
-                    kp, kd = 0.0, 0.0
-                    print("Gains zeroed.")
-                elif user_in.startswith('k '):
-                    try: kp = float(user_in.split()[1])
-                    except: print("Bad value")
-                elif user_in.startswith('d '):
-                    try: kd = float(user_in.split()[1])
-                    except: print("Bad value")
-                elif user_in.startswith('p '):
-                    try: pos = math.radians(float(user_in.split()[1]))
-                    except: print("Bad value")
-                
+
+            self.mit_loop = MitLoop(self.bus, self.motor_name, setpoint, self.mit_rate_hz)
+            self.mit_loop.start()
+            fields = {'k': 'kp', 'd': 'kd', 'p': 'pos', 'v': 'vel', 't': 'torque'}
+
+            print("\n")  # status and prompt lines, redrawn in place
+            with LineInput() as ui:
+                next_draw = 0.0
+                while True:
+                    line = ui.poll(0.02)
+                    if line is not None:
+                        cmd = line.strip().lower().split()
+                        if cmd == ['q']:
+                            break
+                        elif cmd == ['z']:
+                            setpoint.set(kp=0.0, kd=0.0)
+                            message = "Gains zeroed."
+                        elif len(cmd) == 2 and cmd[0] in fields:
+                            try:
+                                val = float(cmd[1])
+                                setpoint.set(**{fields[cmd[0]]: math.radians(val) if cmd[0] == 'p' else val})
+                                message = f"{fields[cmd[0]]} = {val}"
+                            except ValueError:
+                                message = "Bad value"
+                        elif cmd:
+                            message = f"Unknown command: {line.strip()}"
+
+                    if time.perf_counter() >= next_draw or line is not None:
+                        next_draw = time.perf_counter() + 0.1
+                        hz, jitter_rms, jitter_max, fb = self.mit_loop.stats()
+                        pos, vel, kp, kd, torque = setpoint.get()
+                        if fb:
+                            p_fb, v_fb, t_fb, temp = fb
+                            state = f"Pos={math.degrees(p_fb):6.1f}° Vel={v_fb:5.2f} Trq={t_fb:5.2f}Nm {temp:4.1f}°C"
+                        else:
+                            state = "no feedback yet"
+                        loop = (f"{hz:5.1f}/{self.mit_rate_hz} Hz, jitter {jitter_rms:4.0f} us rms "
+                                f"{jitter_max:5.0f} max, {self.mit_loop.overruns} late, {self.mit_loop.errors} err")
+                        cmd_txt = f"Cmd: P={math.degrees(pos):.1f}° V={vel:.2f} Kp={kp} Kd={kd} T={torque}"
+                        sys.stdout.write(f"\x1b[2A\r\x1b[K{state} | {loop}\n\r\x1b[K{cmd_txt}  {message}"
+                                         f"\n\r\x1b[KCommand > {ui.buf}")
+                        sys.stdout.flush()
+
         except KeyboardInterrupt:
             pass
         except Exception as e:
-            print(f"Error: {e}")
-        
+            print(f"\nError: {e}")
+        finally:
+            if self.mit_loop:
+                self.mit_loop.stop()
+                if self.mit_loop.last_error:
+                    print(f"\nLast control-loop error: {self.mit_loop.last_error}")
+                self.mit_loop = None
+
         # Cleanup
         try:
             self.bus.write_operation_frame(self.motor_name, 0, 0, 0, 0, 0)
@@ -335,6 +554,8 @@ class MotorHub:
             print("10. MIT Control (Pos + Stiffness)")
             print("11. Velocity Control")
             print("--- SYSTEM ---")
+            print("12. Scan Bus for Motors")
+            print("13. Group Command (all scanned motors)")
             print("0.  Exit")
             print("-"*40)
             
@@ -351,6 +572,8 @@ class MotorHub:
             elif choice == '9': self.cmd_save_config()
             elif choice == '10': self.cmd_control_mit()
             elif choice == '11': self.cmd_control_velocity()
+            elif choice == '12': self.cmd_scan()
+            elif choice == '13': self.cmd_group()
             elif choice == '0': 
                 self.disconnect()
                 print("Goodbye!")
@@ -363,7 +586,7 @@ class MotorHub:
 
 def main():
     # Handle arguments: python motor_hub.py [ID] [Interface]
-    mid = 127
+    mid = None
     iface = 'can0'
     
     if len(sys.argv) > 1:
@@ -371,8 +594,17 @@ def main():
         except: pass
     if len(sys.argv) > 2:
         iface = sys.argv[2]
-        
-    hub = MotorHub(mid, iface)
+    rate = MIT_RATE_HZ
+    if len(sys.argv) > 3:
+        try: rate = int(sys.argv[3])
+        except: pass
+
+    hub = MotorHub(127 if mid is None else mid, iface, rate)
+    if mid is None:
+        try:
+            hub.cmd_scan()
+        except OSError as e:
+            print(f"⚠️  Scan failed ({e}); using motor ID 127.")
     
     # Handle Ctrl+C gracefully
     signal.signal(signal.SIGINT, lambda s, f: (hub.disconnect(), sys.exit(0)))
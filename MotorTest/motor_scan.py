@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+RoboStride Bus Scan
+-------------------
+Finds the RoboStride motors on a bus in one pipelined pass: a type-0
+(get_device_id) request goes to every motor ID of the range, paced so that
+requests and replies together stay under --load of the bitrate, while the
+replies are collected on the same raw socket as they arrive. Each reply
+carries the motor ID in bits 8-15 and the motor's 64-bit MCU ID as its
+payload; two different MCU IDs behind one motor ID are reported as a
+conflict. 127 IDs at 1 Mbit/s and the default 50 % load take about 80 ms
+of requests plus the reply window.
+
+With --config and --bus the motors are written to a td_can_bridges config,
+one RS02_Feedback rx_frames entry per motor (the td_can_register layout,
+its MCU ID kept as metadata):
+
+    sudo python3 motor_scan.py can0
+    sudo python3 motor_scan.py can0 --ids 1-32 --config ../untested--pythoncan/config/example_multibus.yaml --bus motor_bus
+"""
+
+import argparse
+import errno
+import os
+import select
+import socket
+import struct
+import sys
+import time
+
+from rt_loop import sleep_until
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'nativeCAN'))
+import robostride  # noqa: E402
+
+HOST_ID = 0xFD
+TYPE_GET_ID = 0              # the reply is type 0 too, with 0xFE in bits 0-7
+REPLY_ID_TAG = 0xFE
+DEFAULT_IDS = range(1, 128)
+DEFAULT_LOAD = 0.5
+REPLY_WINDOW = 0.02          # after the last request
+FRAME_BITS = 160             # extended 8-byte data frame with worst-case stuffing
+TX_RETRIES = 20
+
+CAN_FRAME = struct.Struct("=IB3x8s")
+CAN_EFF_FLAG = 0x80000000
+CAN_EFF_MASK = 0x1FFFFFFF
+TYPE_MASK = 0x1F << 24
+FEEDBACK_MASK = TYPE_MASK | 0xFF00    # type 2 of one motor, whatever host ID it is addressed to
+
+
+def bitrate_of(interface, default=1_000_000):
+    """Nominal bitrate from `ip -details link`; default when it cannot be read."""
+    try:
+        from latency_bench import interface_info
+        return interface_info(interface)[1] or default
+    except Exception:
+        return default
+
+
+class MotorScan:
+    """Type-0 requests across an ID range on a raw socket that sees only the replies."""
+
+    def __init__(self, interface, host_id=HOST_ID):
+        self.interface = interface
+        self.host_id = host_id & 0xFF
+        self.sock = socket.socket(socket.AF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+        # Type 0 with 0xFE in bits 0-7: replies only, not our own or another host's requests
+        self.sock.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_FILTER,
+                             struct.pack("=II", REPLY_ID_TAG | CAN_EFF_FLAG, TYPE_MASK | 0xFF | CAN_EFF_FLAG))
+        self.sock.bind((interface,))
+        self.sock.setblocking(False)
+
+    def close(self):
+        self.sock.close()
+
+    def _send(self, frame):
+        for _ in range(TX_RETRIES):
+            try:
+                self.sock.send(frame)
+                return True
+            except (BlockingIOError, OSError) as e:
+                if not isinstance(e, BlockingIOError) and e.errno != errno.ENOBUFS:
+                    raise
+                time.sleep(50e-6)
+        return False
+
+    def _collect(self, found):
+        while True:
+            try:
+                raw = self.sock.recv(CAN_FRAME.size)
+            except BlockingIOError:
+                return
+            can_id, _, data = CAN_FRAME.unpack(raw)
+            mid = ((can_id & CAN_EFF_MASK) >> 8) & 0xFF
+            found.setdefault(mid, set()).add(data.hex().upper())
+
+    def scan(self, ids=DEFAULT_IDS, load=DEFAULT_LOAD, bitrate=None, window=REPLY_WINDOW):
+        """motor ID -> set of MCU IDs (hex) that answered; more than one is an ID conflict."""
+        return self.burst(ids, TYPE_GET_ID, bytes(8), load, bitrate, window)
+
+    def burst(self, ids, comm_type, data, load=DEFAULT_LOAD, bitrate=None, window=REPLY_WINDOW):
+        """Sends comm_type with data to every ID, paced, and collects the type-0 replies as scan() does.
+
+        Types 0, 7, 23 and 25 are all answered with the type-0 device ID frame."""
+        bitrate = bitrate or bitrate_of(self.interface)
+        # Each request draws one reply: the pair may use `load` of the bus
+        gap_ns = int(2 * FRAME_BITS / bitrate / load * 1e9)
+        found = {}
+        unsent = 0
+        deadline = time.monotonic_ns()
+        for mid in ids:
+            if mid in (self.host_id, REPLY_ID_TAG):
+                continue  # our own ID, and the tag our filter takes for a reply
+            can_id = robostride.build_ext_id(mid & 0xFF, self.host_id, comm_type)
+            if not self._send(CAN_FRAME.pack(can_id | CAN_EFF_FLAG, 8, data)):
+                unsent += 1
+            self._collect(found)
+            deadline += gap_ns
+            sleep_until(deadline)
+        end = time.perf_counter() + window
+        while (remaining := end - time.perf_counter()) > 0:
+            if select.select([self.sock], [], [], remaining)[0]:
+                self._collect(found)
+        if unsent:
+            print(f"⚠️  {unsent} requests not sent: TX queue full", file=sys.stderr)
+        return found
+
+
+def parse_ids(text):
+    """'1-32,40,0x7F' -> [1, ..., 32, 40, 127]."""
+    ids = []
+    for part in text.split(','):
+        lo, sep, hi = part.strip().partition('-')
+        ids += range(int(lo, 0), int(hi, 0) + 1) if sep else [int(lo, 0)]
+    return ids
+
+
+def register_entries(found, topic_prefix="/td/rs02"):
+    """rx_frames entries of the motors found, as td_can_register writes a device."""
+    entries = {}
+    for mid, mcu_ids in sorted(found.items()):
+        entries[f"rs02_{mid}.RS02_Feedback"] = {
+            'dbc_message': 'RS02_Feedback',
+            'topic': f"{topic_prefix.rstrip('/')}/{mid}/rs02_feedback",
+            'publish': 'frame',
+            'can_id': robostride.TYPE_FEEDBACK << 24 | mid << 8,
+            'id_mask': FEEDBACK_MASK,
+            'mcu_id': sorted(mcu_ids)[0],
+        }
+    return entries
+
+
+def write_config(path, bus_name, entries):
+    import yaml
+
+    with open(path) as f:
+        cfg = yaml.safe_load(f)
+    for bus in cfg.get('buses', []):
+        if bus.get('name') == bus_name or bus.get('interface') == bus_name:
+            bus.setdefault('rx_frames', {}).update(entries)
+            break
+    else:
+        raise SystemExit(f"No bus matches name/interface: {bus_name}")
+    with open(path, 'w') as f:
+        f.write(yaml.safe_dump(cfg, sort_keys=False))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Find the RoboStride motors on a bus")
+    parser.add_argument("interface")
+    parser.add_argument("--ids", type=parse_ids, default=list(DEFAULT_IDS), help="motor IDs to probe, e.g. 1-127")
+    parser.add_argument("--host-id", type=lambda s: int(s, 0), default=HOST_ID)
+    parser.add_argument("--load", type=float, default=DEFAULT_LOAD, help="share of the bitrate the scan may use")
+    parser.add_argument("--bitrate", type=int, help="default: read from the interface")
+    parser.add_argument("--window", type=float, default=REPLY_WINDOW, help="seconds to wait after the last request")
+    parser.add_argument("--config", help="td_can_bridges YAML config to add the motors to")
+    parser.add_argument("--bus", help="bus name or interface in --config (default: the scanned interface)")
+    parser.add_argument("--topic-prefix", default="/td/rs02")
+    args = parser.parse_args()
+
+    scanner = MotorScan(args.interface, args.host_id)
+    try:
+        t0 = time.perf_counter()
+        found = scanner.scan(args.ids, args.load, args.bitrate, args.window)
+        elapsed = time.perf_counter() - t0
+    finally:
+        scanner.close()
+
+    print(f"🔎 {len(args.ids)} IDs on {args.interface} in {elapsed * 1000:.0f} ms: {len(found)} motor(s)")
+    for mid, mcu_ids in sorted(found.items()):
+        note = "  ⚠️  ID conflict" if len(mcu_ids) > 1 else ""
+        print(f"  ID {mid:3d} (0x{mid:02X})  MCU {', '.join(sorted(mcu_ids))}{note}")
+    if args.config and found:
+        entries = register_entries(found, args.topic_prefix)
+        write_config(args.config, args.bus or args.interface, entries)
+        print(f"Updated {args.config}: {', '.join(entries)}")
+    return 0 if found else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
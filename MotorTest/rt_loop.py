@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Real-Time Loop Runner
+---------------------
+Runs a control step on absolute deadlines of CLOCK_MONOTONIC, so the period
+never drifts with how long the step (Python + CAN round trip) took.
+
+  - clock_nanosleep(TIMER_ABSTIME) to each deadline (libc through ctypes),
+    falling back to time.sleep() where it is missing
+  - optional SCHED_FIFO priority and CPU pinning (both need root / CAP_SYS_NICE)
+  - overrun detection: a step that ends past the next deadline is counted and
+    the missed deadlines are skipped, never run back to back
+  - a per-cycle timing trace (CSV) for the report below
+
+Report from a trace:  python3 rt_loop.py swing_trace.csv [--freq 0.5]
+"""
+
+import argparse
+import csv
+import ctypes
+import ctypes.util
+import math
+import os
+import time
+
+CLOCK_MONOTONIC = 1
+TIMER_ABSTIME = 1
+
+TRACE_FIELDS = ["cycle", "deadline_ns", "wake_ns", "end_ns", "overrun"]
+
+
+class _Timespec(ctypes.Structure):
+    _fields_ = [("tv_sec", ctypes.c_long), ("tv_nsec", ctypes.c_long)]
+
+
+def _load_clock_nanosleep():
+    try:
+        libc = ctypes.CDLL(ctypes.util.find_library("c") or "libc.so.6", use_errno=True)
+        fn = libc.clock_nanosleep
+    except (OSError, AttributeError):
+        return None
+    fn.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.POINTER(_Timespec), ctypes.POINTER(_Timespec)]
+    fn.restype = ctypes.c_int
+    return fn
+
+
+_clock_nanosleep = _load_clock_nanosleep()
+
+
+def sleep_until(deadline_ns):
+    """Sleeps until CLOCK_MONOTONIC reaches deadline_ns (time.monotonic_ns() uses the same clock)."""
+    if _clock_nanosleep is None:
+        remaining = deadline_ns - time.monotonic_ns()
+        if remaining > 0:
+            time.sleep(remaining / 1e9)
+        return
+    ts = _Timespec(deadline_ns // 1_000_000_000, deadline_ns % 1_000_000_000)
+    # Returns EINTR on a signal; the deadline is absolute, so just go back to sleep
+    while _clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, ctypes.byref(ts), None) == 4:
+        pass
+
+
+def make_realtime(priority=None, cpu=None):
+    """Applies SCHED_FIFO at priority and pins to cpu; returns what could not be applied."""
+    problems = []
+    if cpu is not None:
+        try:
+            os.sched_setaffinity(0, {cpu})
+        except OSError as e:
+            problems.append(f"CPU pinning to {cpu}: {e}")
+    if priority is not None:
+        try:
+            os.sched_setscheduler(0, os.SCHED_FIFO, os.sched_param(priority))
+        except (AttributeError, OSError) as e:
+            problems.append(f"SCHED_FIFO {priority}: {e}")
+    return problems
+
+
+class RtLoop:
+    """Calls step(cycle, t) every period; t is the cycle's scheduled time in seconds from the start.
+
+    step may return a sequence of values for the trace's extra columns (trace_fields).
+    """
+
+    def __init__(self, rate_hz, trace_path=None, trace_fields=()):
+        self.period_ns = int(round(1e9 / rate_hz))
+        self.trace_path = trace_path
+        self.trace_fields = list(trace_fields)
+        self.running = False
+        self.cycles = 0
+        self.overruns = 0        # steps that ended after the next deadline
+        self.skipped = 0         # deadlines dropped to get back in phase
+
+    def stop(self):
+        self.running = False
+
+    def run(self, step):
+        trace = None
+        writer = None
+        if self.trace_path:
+            trace = open(self.trace_path, "w", newline="")
+            trace.write(f"# period_ns={self.period_ns}\n")
+            writer = csv.writer(trace)
+            writer.writerow(TRACE_FIELDS + self.trace_fields)
+        self.running = True
+        start = time.monotonic_ns() + self.period_ns   # first deadline one period out
+        deadline = start
+        try:
+            while self.running:
+                sleep_until(deadline)
+                wake = time.monotonic_ns()
+                extra = step(self.cycles, (deadline - start) / 1e9)
+                end = time.monotonic_ns()
+
+                next_deadline = deadline + self.period_ns
+                overrun = end > next_deadline
+                if overrun:
+                    self.overruns += 1
+                    # Resume on the first deadline still ahead, keeping the phase
+                    missed = (end - next_deadline) // self.period_ns + 1
+                    self.skipped += missed
+                    next_deadline += missed * self.period_ns
+                if writer:
+                    writer.writerow([self.cycles, deadline, wake, end, int(overrun)] + list(extra or ()))
+                self.cycles += 1
+                deadline = next_deadline
+        finally:
+            if trace:
+                trace.close()
+
+
+# --- Report ---
+
+def _percentile(ordered, p):
+    return ordered[min(len(ordered) - 1, int(len(ordered) * p / 100.0))]
+
+
+def load_trace(path):
+    """Returns (period_ns, rows) of a trace; rows hold ints for timing and floats for the step's columns."""
+    with open(path, newline="") as f:
+        header = f.readline()
+        period_ns = int(header.split("=", 1)[1]) if header.startswith("# period_ns=") else None
+        if period_ns is None:
+            f.seek(0)
+        rows = [{k: int(v) if k in TRACE_FIELDS else float(v) for k, v in row.items() if v not in ("", None)}
+                for row in csv.DictReader(f)]
+    return period_ns, rows
+
+
+def _swing_freq(times, values):
+    """Frequency of a sine from its upward zero crossings (linearly interpolated)."""
+    ups = []
+    for (t0, v0), (t1, v1) in zip(zip(times, values), zip(times[1:], values[1:])):
+        if v0 < 0 <= v1 and v1 != v0:
+            ups.append(t0 + (t1 - t0) * (-v0) / (v1 - v0))
+    if len(ups) < 2:
+        return None
+    return (len(ups) - 1) / (ups[-1] - ups[0])
+
+
+def report(path, freq=None):
+    period_ns, rows = load_trace(path)
+    if not rows:
+        return f"{path}: empty trace"
+    periods = [(b["wake_ns"] - a["wake_ns"]) / 1e3 for a, b in zip(rows, rows[1:])]
+    latency = sorted((r["wake_ns"] - r["deadline_ns"]) / 1e3 for r in rows)
+    exec_us = sorted((r["end_ns"] - r["wake_ns"]) / 1e3 for r in rows)
+    span = (rows[-1]["deadline_ns"] - rows[0]["deadline_ns"]) / 1e9
+    overruns = sum(r["overrun"] for r in rows)
+    out = [f"Trace: {path} ({len(rows)} cycles, {span:.2f} s)"]
+    if period_ns:
+        out.append(f"  Period:        {period_ns / 1e3:.0f} us requested ({1e9 / period_ns:.1f} Hz)")
+    if periods:
+        mean = sum(periods) / len(periods)
+        sd = math.sqrt(sum((p - mean) ** 2 for p in periods) / len(periods))
+        out.append(f"  Achieved:      {mean:.1f} us mean ({1e6 / mean:.2f} Hz), jitter {sd:.1f} us rms, "
+                   f"{min(periods):.0f}..{max(periods):.0f} us")
+    out.append("  Wake latency:  " + ", ".join(f"p{p:g} {_percentile(latency, p):.1f}" for p in (50, 99, 99.9))
+               + f", max {latency[-1]:.1f} us")
+    out.append("  Step time:     " + ", ".join(f"p{p:g} {_percentile(exec_us, p):.1f}" for p in (50, 99, 99.9))
+               + f", max {exec_us[-1]:.1f} us")
+    out.append(f"  Overruns:      {overruns} ({100.0 * overruns / len(rows):.2f}% of cycles)")
+    times = [(r["deadline_ns"] - rows[0]["deadline_ns"]) / 1e9 for r in rows]
+    for key, label in (("pos_cmd", "commanded"), ("pos_act", "measured")):
+        if key in rows[0]:
+            f_meas = _swing_freq(times, [r[key] for r in rows])
+            if f_meas is not None:
+                line = f"  Swing ({label}): {f_meas:.4f} Hz"
+                if freq:
+                    line += f" ({100.0 * (f_meas - freq) / freq:+.2f}% vs {freq} Hz)"
+                out.append(line)
+    return "\n".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Timing report from an RtLoop trace")
+    parser.add_argument("trace", help="CSV written by RtLoop (e.g. swing_trace.csv)")
+    parser.add_argument("--freq", type=float, help="Expected swing frequency (Hz) to compare against")
+    args = parser.parse_args()
+    print(report(args.trace, args.freq))
+
+
+if __name__ == "__main__":
+    main()
@@ -1,17 +1,29 @@
 import sys
+import os
 import time
 import math
 import signal
+import argparse
+
+from rt_loop import RtLoop, make_realtime, report
 
 # Adjust path to find the SDK
 sys.path.append('./seeed-projects/robstride_control/RobStride_Control-e0a01d38335972c2fa1dd1e15bb222c4e15e866b/python')
 from robstride_dynamics import RobstrideBus, Motor, ParameterType
 
+# Shared-memory signal store of the bridge package, for the live plot (stdlib only)
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'untested--pythoncan', 'td_can_bridges'))
+
 # --- CONFIGURATION ---
+# One hand-picked swing; gain_sweep.py sweeps gains, frequencies and amplitudes over several motors
 MOTOR_ID = 127          # Target Motor ID
 INTERFACE = 'can0'      # CAN Interface
 SWING_FREQ = 0.5        # Frequency in Hz (0.5 = 2 seconds per full swing)
 SWING_AMP_DEG = 90.0    # Amplitude in degrees (Swings +/- 90 deg)
+LOOP_HZ = 50            # Control loop rate, on absolute deadlines
+TRACE_FILE = 'swing_trace.csv'  # Per-cycle timing trace; `python3 rt_loop.py swing_trace.csv` reports on it
+TELEMETRY_STORE = '/dev/shm/td_can_swing_test'  # --telemetry: watch with scripts/signal_store_plot.py --path ...
+TELEMETRY_SIGNALS = ["pos_cmd", "pos_act", "vel_act", "trq_act", "temp"]
 
 # RS02 Motor Limits (Crucial for correct scaling)
 # These values define how the 16-bit CAN integers map to real-world floats
@@ -33,7 +45,19 @@ table.MODEL_MIT_TORQUE_TABLE["rs-02"]   = RS02_PARAMS["rs-02"]["torque"]
 table.MODEL_MIT_KP_TABLE["rs-02"]       = RS02_PARAMS["rs-02"]["kp"]
 table.MODEL_MIT_KD_TABLE["rs-02"]       = RS02_PARAMS["rs-02"]["kd"]
 
+def parse_args():
+    parser = argparse.ArgumentParser(description="RS-02 sine swing on a real-time loop")
+    parser.add_argument("--rate", type=float, default=LOOP_HZ, help="Loop rate in Hz")
+    parser.add_argument("--fifo", type=int, metavar="PRIO", help="Run under SCHED_FIFO at this priority (1-99)")
+    parser.add_argument("--cpu", type=int, help="Pin the loop to this CPU")
+    parser.add_argument("--trace", default=TRACE_FILE, help="Timing trace CSV ('' for none)")
+    parser.add_argument("--telemetry", type=int, nargs="?", const=4096, default=0, metavar="SAMPLES",
+                        help=f"Publish every cycle to {TELEMETRY_STORE} with this much history, for the live plot")
+    return parser.parse_args()
+
+
 def main():
+    args = parse_args()
     print(f"🤖 Connecting to Motor {MOTOR_ID} on {INTERFACE}...")
     
     # Define Motor
@@ -44,6 +68,19 @@ def main():
     bus = RobstrideBus(INTERFACE, motors, {})
     bus.connect(handshake=True)
 
+    loop = RtLoop(args.rate, args.trace or None, trace_fields=["pos_cmd", "pos_act", "vel_act", "trq_act"])
+    store = None
+    publish = None
+    if args.telemetry:
+        from signal_store import SignalStore
+        # One ring entry per signal per cycle; the plot runs in its own process and never blocks us
+        store = SignalStore.for_signals(TELEMETRY_STORE, "swing_test", {"Swing": TELEMETRY_SIGNALS}, args.telemetry)
+        publish = store.writer("Swing")
+        print(f"📈 Telemetry in {TELEMETRY_STORE}: "
+              f"python3 ../untested--pythoncan/scripts/signal_store_plot.py --path {TELEMETRY_STORE}")
+    # Ctrl+C stops the loop at the end of a cycle, so the trace ends on a whole row
+    signal.signal(signal.SIGINT, lambda s, f: loop.stop())
+
     try:
         # 1. Setup: Enable and Switch to MIT Mode
         print("⚡ Enabling and switching to MIT Mode (Mode 0)...")
@@ -55,17 +92,20 @@ def main():
         # Kp=40 is stiff enough to move, but soft enough to be safe
         kp = 40.0 
         kd = 1.5
+
+        for problem in make_realtime(args.fifo, args.cpu):
+            print(f"⚠️  Not applied: {problem}")
         
-        print(f"\n🌊 Starting Swing: ±{SWING_AMP_DEG}° at {SWING_FREQ}Hz")
+        print(f"\n🌊 Starting Swing: ±{SWING_AMP_DEG}° at {SWING_FREQ}Hz, loop {args.rate:g}Hz")
         print("   Press Ctrl+C to stop safely.\n")
-        print(f"{'TIME':<8} | {'POS (deg)':<10} | {'VEL (rad/s)':<12} | {'TRQ (Nm)':<10} | {'TEMP':<6}")
-        print("-" * 60)
+        print(f"{'TIME':<8} | {'POS (deg)':<10} | {'VEL (rad/s)':<12} | {'TRQ (Nm)':<10} | {'TEMP':<6} | OVERRUNS")
+        print("-" * 72)
 
-        start_time = time.time()
-        
-        while True:
+        print_every = max(1, int(args.rate / 10))  # status at ~10 Hz, whatever the loop rate
+
+        def step(cycle, t):
             # --- A. Calculate Trajectory ---
-            t = time.time() - start_time
+            # t is the cycle's deadline, not when it woke up: the sine keeps exact time
             
             # Sine Wave: Amp * sin(2 * pi * freq * t)
             # Result is in Radians
@@ -89,18 +129,19 @@ def main():
             # --- C. Read Telemetry (Read) ---
             # The motor replies to every write with a status frame
             p_act, v_act, t_act, temp = bus.read_operation_frame(motor_name)
+            if publish:
+                publish({"pos_cmd": target_pos_rad, "pos_act": p_act, "vel_act": v_act,
+                         "trq_act": t_act, "temp": temp}, time.time())
             
             # --- D. Print Status ---
-            # Convert act pos to degrees for readability
-            p_deg = math.degrees(p_act)
-            
-            # Print overwriting the same line (or new line if you prefer logs)
-            # Using \r to keep the terminal clean, remove it to log history
-            sys.stdout.write(f"\r{t:6.2f}s | {p_deg:8.1f}°  | {v_act:10.2f}   | {t_act:8.2f}   | {temp:4.1f}°C")
-            sys.stdout.flush()
+            if cycle % print_every == 0:
+                p_deg = math.degrees(p_act)
+                sys.stdout.write(f"\r{t:6.2f}s | {p_deg:8.1f}°  | {v_act:10.2f}   | {t_act:8.2f}   | {temp:4.1f}°C | {loop.overruns}")
+                sys.stdout.flush()
+            return target_pos_rad, p_act, v_act, t_act
 
-            # Loop at ~50Hz (20ms)
-            time.sleep(0.02)
+        loop.run(step)
+        print("\n\n🛑 Stopping...")
 
     except KeyboardInterrupt:
         print("\n\n🛑 Stopping...")
@@ -120,6 +161,10 @@ def main():
             pass
         bus.disconnect()
         print("👋 Motor Disabled.")
+        if store:
+            store.close()
+        if args.trace and os.path.exists(args.trace):
+            print("\n" + report(args.trace, SWING_FREQ))
 
 if __name__ == "__main__":
     main()
@@ -0,0 +1,167 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_twai_onchip.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+// The on-chip TWAI controllers, at two levels.
+//
+// Each controller is a handle: its node, a TX ring, ISR callbacks and counters.
+// triton_twai_reconfigure() programs modes, timing and the acceptance filter while it is stopped,
+// so the USB bridge, which reprograms the bus on every start from the host, keeps the node where
+// it can. The bridge opens every controller (three on the P4), each as a gs_usb channel.
+//
+// On top of controller 0, the ESP32-C3 apps' layer: a timestamped RX ring drained by one task that
+// hands every frame to the registered sinks, blocking transmit and bus-off recovery. Pins and
+// bitrate come from the "Triton TWAI" menu unless the app overrides them.
+
+// triton_twai_frame_t.id flags, as in SocketCAN
+#define TRITON_TWAI_FLAG_EXT 0x80000000u
+#define TRITON_TWAI_FLAG_RTR 0x40000000u
+#define TRITON_TWAI_ID_MASK  0x1FFFFFFFu
+
+#define TRITON_TWAI_MAX_SINKS 4
+
+typedef struct {
+    int64_t time_us;    // esp_timer time, taken in the RX interrupt
+    uint32_t id;        // 11 or 29 bits, with TRITON_TWAI_FLAG_*
+    uint8_t dlc;
+    uint8_t data[8];
+} triton_twai_frame_t;
+
+/**
+ * A consumer of received frames. Every callback runs in the RX task, one
+ * sink after another in registration order, so a sink needs no lock for
+ * state only it touches; a slow sink delays the ones after it and, once the
+ * ring fills, costs frames.
+ */
+typedef struct {
+    void (*on_frame)(const triton_twai_frame_t *frame, void *ctx);
+    void (*on_tick)(int64_t now_us, void *ctx); // optional, about every CONFIG_TRITON_TWAI_TICK_MS
+    void *ctx;
+} triton_twai_sink_t;
+
+typedef struct {
+    int tx_gpio;
+    int rx_gpio;
+    uint32_t bitrate;
+    bool listen_only;   // triton_twai_start() only; a handle takes its modes from triton_twai_reconfigure()
+} triton_twai_config_t;
+
+#define TRITON_TWAI_CONFIG_DEFAULT() { \
+    .tx_gpio = CONFIG_TRITON_TWAI_TX_GPIO, \
+    .rx_gpio = CONFIG_TRITON_TWAI_RX_GPIO, \
+    .bitrate = CONFIG_TRITON_TWAI_BITRATE, \
+    .listen_only = false, \
+}
+
+// Controllers wired to a transceiver, 0 to TRITON_TWAI_CONTROLLERS - 1
+#define TRITON_TWAI_CONTROLLERS CONFIG_TRITON_TWAI_CONTROLLERS
+
+// The menu's settings for the given controller: TRITON_TWAI_CONFIG_DEFAULT() with its pins
+static inline triton_twai_config_t triton_twai_config_for(int controller)
+{
+    triton_twai_config_t config = TRITON_TWAI_CONFIG_DEFAULT();
+#if TRITON_TWAI_CONTROLLERS > 1
+    if (controller == 1) {
+        config.tx_gpio = CONFIG_TRITON_TWAI1_TX_GPIO;
+        config.rx_gpio = CONFIG_TRITON_TWAI1_RX_GPIO;
+    }
+#endif
+#if TRITON_TWAI_CONTROLLERS > 2
+    if (controller == 2) {
+        config.tx_gpio = CONFIG_TRITON_TWAI2_TX_GPIO;
+        config.rx_gpio = CONFIG_TRITON_TWAI2_RX_GPIO;
+    }
+#endif
+    (void)controller;
+    return config;
+}
+
+typedef struct {
+    uint32_t rx_frames;
+    uint32_t rx_overruns;   // frames the RX ring had no room for; triton_twai_get_stats() only
+    uint32_t tx_frames;     // sent successfully
+    uint32_t tx_failed;     // given up by the controller
+    uint32_t tx_full;       // triton_twai_transmit() timed out; triton_twai_get_stats() only
+    uint32_t bit_errors, stuff_errors, form_errors, ack_errors, arb_lost;
+    uint32_t bus_off;       // times the node went bus-off
+    uint32_t state;         // twai_error_state_t
+} triton_twai_stats_t;
+
+// --- Controllers ---
+
+typedef struct triton_twai_ctrl triton_twai_ctrl_t;
+
+// triton_twai_reconfigure() modes
+#define TRITON_TWAI_MODE_LISTEN_ONLY (1u << 0) // never acknowledges or transmits
+#define TRITON_TWAI_MODE_LOOPBACK    (1u << 1) // receives its own frames and needs no other node to acknowledge
+#define TRITON_TWAI_MODE_ONE_SHOT    (1u << 2) // a frame that fails is not retried
+
+/**
+ * A controller's events. Every callback runs in the TWAI ISR, from IRAM
+ * with CONFIG_TRITON_TWAI_ISR_CACHE_SAFE, so it must be IRAM_ATTR and
+ * touch nothing in flash. Each returns whether it woke a higher priority
+ * task. Any of them may be NULL.
+ */
+typedef struct {
+    bool (*on_rx)(triton_twai_ctrl_t *ctrl, const twai_frame_t *frame, void *ctx); // buffer holds 8 bytes
+    bool (*on_tx_done)(triton_twai_ctrl_t *ctrl, uint32_t seq, bool ok, void *ctx); // in submit order
+    bool (*on_state)(triton_twai_ctrl_t *ctrl, twai_error_state_t state, void *ctx);
+    bool (*on_error)(triton_twai_ctrl_t *ctrl, twai_error_flags_t flags, void *ctx);
+    void *ctx;
+} triton_twai_callbacks_t;
+
+// The handle of a controller, with its pins and bitrate (NULL: triton_twai_config_for()) and
+// callbacks, both copied. No node yet: triton_twai_reconfigure() creates it. Once per controller.
+esp_err_t triton_twai_ctrl_open(int controller, const triton_twai_config_t *config,
+                                const triton_twai_callbacks_t *cbs, triton_twai_ctrl_t **out);
+
+// Programs a stopped controller for its next triton_twai_ctrl_enable(): TRITON_TWAI_MODE_* modes,
+// timing (NULL: as the node has it, the config's bitrate on a new one) and acceptance filter
+// (NULL: as the node has it, every frame on a new one). The node is kept when its modes are
+// those asked for and recreated when they are not; a new node takes its interrupt on the calling
+// core. *kept (may be NULL) tells which.
+esp_err_t triton_twai_reconfigure(triton_twai_ctrl_t *ctrl, uint32_t modes, const twai_timing_advanced_config_t *timing,
+                                  const twai_mask_filter_config_t *filter, bool *kept);
+
+// Starts the node. If it fails, the node is deleted, and the next triton_twai_reconfigure()
+// starts from a fresh one.
+esp_err_t triton_twai_ctrl_enable(triton_twai_ctrl_t *ctrl);
+
+// Stops the node. Frames still queued in it would go out at the next enable, and a node that is
+// bus-off or recovering can't be disabled, so either deletes it instead; no callbacks follow.
+void triton_twai_ctrl_disable(triton_twai_ctrl_t *ctrl);
+
+// Queues a frame on an enabled controller, copying its header and up to 8 data bytes, and sets
+// *seq (may be NULL) to the number on_tx_done will report it by. Never waits: ESP_ERR_NO_MEM when
+// the TX ring is full. One caller at a time; the ISR may run alongside.
+esp_err_t triton_twai_ctrl_submit(triton_twai_ctrl_t *ctrl, const twai_frame_t *frame, uint32_t *seq);
+
+// The node's error state and counters; ESP_ERR_INVALID_STATE while it has none
+esp_err_t triton_twai_ctrl_get_status(triton_twai_ctrl_t *ctrl, twai_node_status_t *out);
+
+// Starts recovery from bus-off. Not from the ISR.
+esp_err_t triton_twai_ctrl_recover(triton_twai_ctrl_t *ctrl);
+
+// A copy of the controller's counters; rx_overruns and tx_full stay 0
+void triton_twai_ctrl_get_stats(triton_twai_ctrl_t *ctrl, triton_twai_stats_t *out);
+
+// --- Apps, on controller 0 ---
+
+// Adds a sink. Only before triton_twai_start(); the sink is copied.
+esp_err_t triton_twai_add_sink(const triton_twai_sink_t *sink);
+
+// Opens controller 0, creates and enables its node and starts the RX task. Once only, and not
+// alongside triton_twai_ctrl_open(0, ...).
+esp_err_t triton_twai_start(const triton_twai_config_t *config);
+
+// Queues a frame. Waits up to timeout for a free TX slot and again for another sender to finish;
+// from the esp_timer task or any other context that must not block, pass 0. Callable from
+// several tasks.
+esp_err_t triton_twai_transmit(uint32_t id, uint8_t dlc, const uint8_t *data, TickType_t timeout);
+
+// A copy of the counters; each is updated atomically on its own, not as a set
+void triton_twai_get_stats(triton_twai_stats_t *out);
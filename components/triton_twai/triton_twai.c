@@ -0,0 +1,389 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_twai.h"
+#include "esp_twai_onchip.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "triton_twai.h"
+
+static const char *TAG = "TRITON_TWAI";
+
+#define TX_QUEUE_LEN CONFIG_TRITON_TWAI_TX_QUEUE_LEN
+
+struct triton_twai_ctrl {
+    int index;
+    bool open;
+    bool enabled;
+    triton_twai_config_t config;
+    triton_twai_callbacks_t cbs;
+    twai_node_handle_t node; // NULL until triton_twai_reconfigure()
+    uint32_t modes;          // the node was created with
+    // TX ring: the driver holds a pointer to each queued frame until on_tx_done. Slots are taken
+    // in order and completed in the same order, so tx_head - tx_done are in use.
+    twai_frame_t tx_pool[TX_QUEUE_LEN];
+    uint8_t tx_data[TX_QUEUE_LEN][8];
+    uint32_t tx_seq[TX_QUEUE_LEN]; // the seq of the frame in each slot
+    uint32_t tx_slot;              // the next slot, by the submitter
+    uint32_t tx_head;              // the seq of the next frame, by the submitter
+    volatile uint32_t tx_done;     // every frame before it is done, by the ISR
+    triton_twai_stats_t stats;
+};
+
+static struct triton_twai_ctrl ctrls[TRITON_TWAI_CONTROLLERS];
+
+// The apps' layer, on controller 0
+static triton_twai_ctrl_t *app; // once triton_twai_start() has run
+static QueueHandle_t rx_queue;
+static triton_twai_sink_t sinks[TRITON_TWAI_MAX_SINKS];
+static int sink_count;
+// tx_free counts the free slots of the controller's TX ring, tx_lock serialises submitters
+static SemaphoreHandle_t tx_lock;
+static SemaphoreHandle_t tx_free;
+static uint32_t rx_overruns, tx_full;
+static volatile bool bus_off_pending;
+
+static inline void count(uint32_t *counter, uint32_t n)
+{
+    __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+// --- Controllers ---
+
+static IRAM_ATTR bool on_rx_done(twai_node_handle_t handle, const twai_rx_done_event_data_t *edata, void *arg)
+{
+    struct triton_twai_ctrl *ctrl = arg;
+    uint8_t data[8] = {0};
+    twai_frame_t frame = { .buffer = data, .buffer_len = sizeof(data) };
+    if (twai_node_receive_from_isr(handle, &frame) != ESP_OK) return false;
+    count(&ctrl->stats.rx_frames, 1);
+    return ctrl->cbs.on_rx && ctrl->cbs.on_rx(ctrl, &frame, ctrl->cbs.ctx);
+}
+
+static IRAM_ATTR bool on_tx_done(twai_node_handle_t handle, const twai_tx_done_event_data_t *edata, void *arg)
+{
+    struct triton_twai_ctrl *ctrl = arg;
+    uint32_t seq = ctrl->tx_seq[edata->done_tx_frame - ctrl->tx_pool];
+    ctrl->tx_done = seq + 1;
+    count(edata->is_tx_success ? &ctrl->stats.tx_frames : &ctrl->stats.tx_failed, 1);
+    return ctrl->cbs.on_tx_done && ctrl->cbs.on_tx_done(ctrl, seq, edata->is_tx_success, ctrl->cbs.ctx);
+}
+
+static IRAM_ATTR bool on_error(twai_node_handle_t handle, const twai_error_event_data_t *edata, void *arg)
+{
+    struct triton_twai_ctrl *ctrl = arg;
+    twai_error_flags_t e = edata->err_flags;
+    count(&ctrl->stats.bit_errors, e.bit_err);
+    count(&ctrl->stats.stuff_errors, e.stuff_err);
+    count(&ctrl->stats.form_errors, e.form_err);
+    count(&ctrl->stats.ack_errors, e.ack_err);
+    count(&ctrl->stats.arb_lost, e.arb_lost);
+    return ctrl->cbs.on_error && ctrl->cbs.on_error(ctrl, e, ctrl->cbs.ctx);
+}
+
+static IRAM_ATTR bool on_state_change(twai_node_handle_t handle, const twai_state_change_event_data_t *edata,
+                                      void *arg)
+{
+    struct triton_twai_ctrl *ctrl = arg;
+    ctrl->stats.state = edata->new_sta;
+    if (edata->new_sta == TWAI_ERROR_BUS_OFF) count(&ctrl->stats.bus_off, 1);
+    return ctrl->cbs.on_state && ctrl->cbs.on_state(ctrl, edata->new_sta, ctrl->cbs.ctx);
+}
+
+// The driver's node settings for a config: its pins, bitrate and listen-only, the default clock
+// and tx_queue_depth frames in flight
+static twai_onchip_node_config_t node_config_for(const triton_twai_config_t *config, uint32_t tx_queue_depth)
+{
+    return (twai_onchip_node_config_t){
+        .io_cfg = { .tx = config->tx_gpio, .rx = config->rx_gpio, .quanta_clk_out = -1, .bus_off_indicator = -1 },
+        .clk_src = TWAI_CLK_SRC_DEFAULT,
+        .bit_timing = { .bitrate = config->bitrate },
+        .tx_queue_depth = tx_queue_depth,
+        .flags.enable_listen_only = config->listen_only,
+    };
+}
+
+static void node_delete(struct triton_twai_ctrl *ctrl)
+{
+    if (!ctrl->node) return;
+    twai_node_disable(ctrl->node);
+    twai_node_delete(ctrl->node);
+    ctrl->node = NULL;
+    ctrl->enabled = false;
+    ctrl->tx_done = ctrl->tx_head; // its queue went with it, uncompleted
+}
+
+static esp_err_t node_create(struct triton_twai_ctrl *ctrl, uint32_t modes)
+{
+    // The driver takes whichever controller is free; the pins, through the GPIO matrix, are what
+    // tie the node to this controller's transceiver
+    triton_twai_config_t config = ctrl->config;
+    config.listen_only = (modes & TRITON_TWAI_MODE_LISTEN_ONLY) != 0;
+    twai_onchip_node_config_t node_config = node_config_for(&config, TX_QUEUE_LEN);
+    // Retry until sent, as the legacy driver did, unless one-shot
+    node_config.fail_retry_cnt = (modes & TRITON_TWAI_MODE_ONE_SHOT) ? 0 : -1;
+    node_config.flags.enable_self_test = (modes & TRITON_TWAI_MODE_LOOPBACK) != 0;
+    node_config.flags.enable_loopback = (modes & TRITON_TWAI_MODE_LOOPBACK) != 0;
+    const twai_event_callbacks_t cbs = {
+        .on_rx_done = on_rx_done,
+        .on_tx_done = on_tx_done,
+        .on_error = on_error,
+        .on_state_change = on_state_change,
+    };
+    esp_err_t err = twai_new_node_onchip(&node_config, &ctrl->node);
+    if (err != ESP_OK) {
+        ctrl->node = NULL;
+        return err;
+    }
+    err = twai_node_register_event_callbacks(ctrl->node, &cbs, ctrl);
+    if (err != ESP_OK) {
+        node_delete(ctrl);
+        return err;
+    }
+    ctrl->modes = modes;
+    return ESP_OK;
+}
+
+esp_err_t triton_twai_ctrl_open(int controller, const triton_twai_config_t *config,
+                                const triton_twai_callbacks_t *cbs, triton_twai_ctrl_t **out)
+{
+    if (controller < 0 || controller >= TRITON_TWAI_CONTROLLERS) return ESP_ERR_INVALID_ARG;
+    struct triton_twai_ctrl *ctrl = &ctrls[controller];
+    if (ctrl->open) return ESP_ERR_INVALID_STATE;
+    ctrl->index = controller;
+    ctrl->config = config ? *config : triton_twai_config_for(controller);
+    if (cbs) ctrl->cbs = *cbs;
+    ctrl->open = true;
+    *out = ctrl;
+    return ESP_OK;
+}
+
+esp_err_t triton_twai_reconfigure(triton_twai_ctrl_t *ctrl, uint32_t modes, const twai_timing_advanced_config_t *timing,
+                                  const twai_mask_filter_config_t *filter, bool *kept)
+{
+    if (ctrl->enabled) return ESP_ERR_INVALID_STATE;
+    bool keep = ctrl->node && ctrl->modes == modes;
+    if (kept) *kept = keep;
+    if (!keep) {
+        node_delete(ctrl);
+        esp_err_t err = node_create(ctrl, modes);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "TWAI%d: failed to create node: %s", ctrl->index, esp_err_to_name(err));
+            return err;
+        }
+    }
+    // A disabled node takes new timing and a new acceptance filter in place
+    esp_err_t err = timing ? twai_node_reconfig_timing(ctrl->node, timing, NULL) : ESP_OK;
+    if (err == ESP_OK && filter) err = twai_node_config_mask_filter(ctrl->node, 0, filter);
+    return err;
+}
+
+esp_err_t triton_twai_ctrl_enable(triton_twai_ctrl_t *ctrl)
+{
+    if (!ctrl->node || ctrl->enabled) return ESP_ERR_INVALID_STATE;
+    esp_err_t err = twai_node_enable(ctrl->node);
+    if (err != ESP_OK) {
+        node_delete(ctrl);
+        return err;
+    }
+    ctrl->enabled = true;
+    return ESP_OK;
+}
+
+void triton_twai_ctrl_disable(triton_twai_ctrl_t *ctrl)
+{
+    if (!ctrl->enabled) return;
+    if (ctrl->tx_head != ctrl->tx_done || twai_node_disable(ctrl->node) != ESP_OK) node_delete(ctrl);
+    ctrl->enabled = false;
+}
+
+esp_err_t triton_twai_ctrl_submit(triton_twai_ctrl_t *ctrl, const twai_frame_t *frame, uint32_t *seq)
+{
+    if (!ctrl->enabled) return ESP_ERR_INVALID_STATE;
+    if (frame->buffer_len > sizeof(ctrl->tx_data[0])) return ESP_ERR_INVALID_ARG;
+    if (ctrl->tx_head - ctrl->tx_done >= TX_QUEUE_LEN) return ESP_ERR_NO_MEM;
+
+    uint32_t slot = ctrl->tx_slot;
+    twai_frame_t *msg = &ctrl->tx_pool[slot];
+    *msg = *frame;
+    if (frame->buffer_len) memcpy(ctrl->tx_data[slot], frame->buffer, frame->buffer_len);
+    msg->buffer = ctrl->tx_data[slot];
+    ctrl->tx_seq[slot] = ctrl->tx_head;
+    // Counted before the driver has it: the frame can be done before twai_node_transmit() returns
+    uint32_t sent = ctrl->tx_head++;
+    ctrl->tx_slot = (slot + 1) % TX_QUEUE_LEN;
+    esp_err_t err = twai_node_transmit(ctrl->node, msg, 0); // a slot was free, so the driver queue has room
+    if (err != ESP_OK) {
+        ctrl->tx_head = sent;
+        ctrl->tx_slot = slot;
+        return err;
+    }
+    if (seq) *seq = sent;
+    return ESP_OK;
+}
+
+esp_err_t triton_twai_ctrl_get_status(triton_twai_ctrl_t *ctrl, twai_node_status_t *out)
+{
+    if (!ctrl->node) return ESP_ERR_INVALID_STATE;
+    return twai_node_get_info(ctrl->node, out, NULL);
+}
+
+esp_err_t triton_twai_ctrl_recover(triton_twai_ctrl_t *ctrl)
+{
+    if (!ctrl->enabled) return ESP_ERR_INVALID_STATE;
+    return twai_node_recover(ctrl->node);
+}
+
+void triton_twai_ctrl_get_stats(triton_twai_ctrl_t *ctrl, triton_twai_stats_t *out)
+{
+    *out = ctrl->stats;
+}
+
+// --- Apps, on controller 0 ---
+
+static IRAM_ATTR bool app_on_rx(triton_twai_ctrl_t *ctrl, const twai_frame_t *frame, void *ctx)
+{
+    triton_twai_frame_t f;
+    f.time_us = esp_timer_get_time();
+    f.id = frame->header.id | (frame->header.ide ? TRITON_TWAI_FLAG_EXT : 0) |
+           (frame->header.rtr ? TRITON_TWAI_FLAG_RTR : 0);
+    f.dlc = frame->header.dlc > 8 ? 8 : frame->header.dlc;
+    memcpy(f.data, frame->buffer, sizeof(f.data));
+    BaseType_t woken = pdFALSE;
+    if (xQueueSendFromISR(rx_queue, &f, &woken) != pdTRUE) count(&rx_overruns, 1);
+    return woken == pdTRUE;
+}
+
+static IRAM_ATTR bool app_on_tx_done(triton_twai_ctrl_t *ctrl, uint32_t seq, bool ok, void *ctx)
+{
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(tx_free, &woken);
+    return woken == pdTRUE;
+}
+
+static IRAM_ATTR bool app_on_state(triton_twai_ctrl_t *ctrl, twai_error_state_t state, void *ctx)
+{
+    if (state == TWAI_ERROR_BUS_OFF) bus_off_pending = true; // recovered from the RX task; not allowed in the ISR
+    return false;
+}
+
+static void rx_task(void *arg)
+{
+    (void)arg;
+    const int64_t tick_us = CONFIG_TRITON_TWAI_TICK_MS * 1000LL;
+    int64_t next_tick = esp_timer_get_time() + tick_us;
+
+    while (true) {
+        int64_t now = esp_timer_get_time();
+        if (now >= next_tick) {
+#if CONFIG_TRITON_TWAI_AUTO_RECOVER
+            if (bus_off_pending) {
+                bus_off_pending = false;
+                ESP_LOGW(TAG, "Bus-off, recovering");
+                triton_twai_ctrl_recover(app);
+            }
+#endif
+            for (int i = 0; i < sink_count; i++) {
+                if (sinks[i].on_tick) sinks[i].on_tick(now, sinks[i].ctx);
+            }
+            next_tick += tick_us;
+            if (next_tick <= now) next_tick = now + tick_us; // fell behind: skip, don't burst
+        }
+
+        triton_twai_frame_t f;
+        if (xQueueReceive(rx_queue, &f, pdMS_TO_TICKS((next_tick - now) / 1000) + 1) != pdTRUE) continue;
+        for (int i = 0; i < sink_count; i++) {
+            sinks[i].on_frame(&f, sinks[i].ctx);
+        }
+    }
+}
+
+esp_err_t triton_twai_add_sink(const triton_twai_sink_t *sink)
+{
+    if (app || sink->on_frame == NULL) return ESP_ERR_INVALID_STATE;
+    if (sink_count >= TRITON_TWAI_MAX_SINKS) return ESP_ERR_NO_MEM;
+    sinks[sink_count++] = *sink;
+    return ESP_OK;
+}
+
+esp_err_t triton_twai_start(const triton_twai_config_t *config)
+{
+    if (app) return ESP_ERR_INVALID_STATE;
+
+    rx_queue = xQueueCreate(CONFIG_TRITON_TWAI_RX_QUEUE_LEN, sizeof(triton_twai_frame_t));
+    tx_lock = xSemaphoreCreateMutex();
+    tx_free = xSemaphoreCreateCounting(TX_QUEUE_LEN, TX_QUEUE_LEN);
+    if (rx_queue == NULL || tx_lock == NULL || tx_free == NULL) return ESP_ERR_NO_MEM;
+
+    const triton_twai_callbacks_t cbs = {
+        .on_rx = app_on_rx,
+        .on_tx_done = app_on_tx_done,
+        .on_state = app_on_state,
+    };
+    triton_twai_ctrl_t *ctrl;
+    esp_err_t err = triton_twai_ctrl_open(0, config, &cbs, &ctrl);
+    // One-shot, as the apps' node has always been: a frame that fails is counted, not retried
+    uint32_t modes = TRITON_TWAI_MODE_ONE_SHOT | (config->listen_only ? TRITON_TWAI_MODE_LISTEN_ONLY : 0);
+    if (err == ESP_OK) err = triton_twai_reconfigure(ctrl, modes, NULL, NULL, NULL);
+    if (err == ESP_OK) err = triton_twai_ctrl_enable(ctrl);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start TWAI node: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    app = ctrl;
+    if (xTaskCreate(rx_task, "twai_rx", 4096, NULL, CONFIG_TRITON_TWAI_RX_TASK_PRIO, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "TWAI started at %lu bit/s on TX=%d, RX=%d%s", (unsigned long)config->bitrate,
+             config->tx_gpio, config->rx_gpio, config->listen_only ? ", listen-only" : "");
+    return ESP_OK;
+}
+
+esp_err_t triton_twai_transmit(uint32_t id, uint8_t dlc, const uint8_t *data, TickType_t timeout)
+{
+    if (!app) return ESP_ERR_INVALID_STATE;
+    if (dlc > 8) return ESP_ERR_INVALID_ARG;
+    if (xSemaphoreTake(tx_free, timeout) != pdTRUE) {
+        count(&tx_full, 1);
+        return ESP_ERR_TIMEOUT;
+    }
+    if (xSemaphoreTake(tx_lock, timeout) != pdTRUE) {
+        xSemaphoreGive(tx_free);
+        count(&tx_full, 1);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    bool rtr = id & TRITON_TWAI_FLAG_RTR;
+    twai_frame_t msg = {
+        .header = {
+            .id = id & TRITON_TWAI_ID_MASK,
+            .ide = (id & TRITON_TWAI_FLAG_EXT) != 0,
+            .rtr = rtr,
+            .dlc = dlc,
+        },
+        .buffer = (uint8_t *)data,
+        .buffer_len = rtr ? 0 : dlc,
+    };
+    esp_err_t err = triton_twai_ctrl_submit(app, &msg, NULL);
+    xSemaphoreGive(tx_lock);
+
+    if (err != ESP_OK) xSemaphoreGive(tx_free);
+    return err;
+}
+
+void triton_twai_get_stats(triton_twai_stats_t *out)
+{
+    if (!app) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    uint32_t overruns = rx_overruns; // first: every overrun is in rx_frames by then
+    triton_twai_ctrl_get_stats(app, out);
+    out->rx_overruns = overruns;
+    out->rx_frames -= overruns; // the ones the RX ring took
+    out->tx_full = tx_full;
+}
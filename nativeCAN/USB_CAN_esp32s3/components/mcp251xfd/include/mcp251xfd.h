@@ -0,0 +1,117 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "driver/spi_master.h"
+#include "freertos/FreeRTOS.h"
+
+// Minimal MCP2518FD (MCP251xFD family) driver: one TX FIFO, one RX FIFO, TEF for TX completion.
+// All calls go over SPI, so nothing here may be used from an ISR.
+
+#define MCP251XFD_MAX_DATA 64
+#define MCP251XFD_TX_DEPTH 8 // TX FIFO slots; the TEF holds as many completions
+#ifndef MCP251XFD_MAX_DEVICES
+#define MCP251XFD_MAX_DEVICES 2 // statically allocated; mcp251xfd_init() fails with ESP_ERR_NO_MEM past it
+#endif
+
+// mcp251xfd_frame_t.flags
+#define MCP251XFD_FLAG_EXTD (1u << 0)
+#define MCP251XFD_FLAG_RTR (1u << 1)
+#define MCP251XFD_FLAG_FD (1u << 2)
+#define MCP251XFD_FLAG_BRS (1u << 3)
+#define MCP251XFD_FLAG_ESI (1u << 4)
+
+typedef struct mcp251xfd *mcp251xfd_handle_t;
+
+typedef struct {
+    spi_host_device_t host; // bus already initialized by the caller (shared by all chips on it)
+    gpio_num_t cs_io;
+    gpio_num_t int_io;      // active-low INT
+    int spi_clock_hz;       // at most 0.85 * SYSCLK / 2
+    uint32_t osc_hz;        // 20 or 40 MHz, used as SYSCLK (PLL off)
+} mcp251xfd_config_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t flags;
+    uint8_t dlc;            // DLC code 0..15 (len via mcp251xfd_dlc_to_len)
+    uint8_t data[MCP251XFD_MAX_DATA];
+    uint32_t seq;           // TX: returned by mcp251xfd_read_tef()
+    uint32_t timestamp_us;  // RX / TEF: 1 MHz time base counter
+} mcp251xfd_frame_t;
+
+// Register values, not minus one. tseg1 = prop_seg + phase_seg1.
+typedef struct { uint32_t brp, tseg1, tseg2, sjw; } mcp251xfd_timing_t;
+
+typedef enum {
+    MCP251XFD_MODE_NORMAL_CAN20 = 6,
+    MCP251XFD_MODE_NORMAL_FD = 0,
+    MCP251XFD_MODE_LISTEN_ONLY = 3,
+    MCP251XFD_MODE_INT_LOOPBACK = 2,
+    MCP251XFD_MODE_EXT_LOOPBACK = 5,
+} mcp251xfd_mode_t;
+
+// mcp251xfd_events_t.flags
+#define MCP251XFD_EV_RX (1u << 0)
+#define MCP251XFD_EV_TEF (1u << 1)
+#define MCP251XFD_EV_RX_OVERFLOW (1u << 2)
+#define MCP251XFD_EV_ERR_STATE (1u << 3) // TEC/REC crossed a warning/passive/bus-off limit
+#define MCP251XFD_EV_SYS_ERR (1u << 4)
+#define MCP251XFD_EV_BUS_ERR (1u << 5)   // invalid message (CRC, form, stuff, ...)
+
+// MCP251XFD_ST_*: C1TREC status bits
+#define MCP251XFD_ST_WARN (1u << 16)
+#define MCP251XFD_ST_RX_WARN (1u << 17)
+#define MCP251XFD_ST_TX_WARN (1u << 18)
+#define MCP251XFD_ST_RX_PASSIVE (1u << 19)
+#define MCP251XFD_ST_TX_PASSIVE (1u << 20)
+#define MCP251XFD_ST_BUS_OFF (1u << 21)
+
+typedef struct {
+    uint32_t flags;
+    uint8_t tec;
+    uint8_t rec;
+    uint32_t status; // MCP251XFD_ST_*
+} mcp251xfd_events_t;
+
+static inline uint8_t mcp251xfd_dlc_to_len(uint8_t dlc) {
+    static const uint8_t len[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+    return len[dlc & 0xF];
+}
+
+static inline uint8_t mcp251xfd_len_to_dlc(uint8_t len) {
+    if (len <= 8) return len;
+    if (len <= 12) return 9;
+    if (len <= 16) return 10;
+    if (len <= 20) return 11;
+    if (len <= 24) return 12;
+    if (len <= 32) return 13;
+    if (len <= 48) return 14;
+    return 15;
+}
+
+// Resets the chip, lays out FIFO RAM and leaves it in configuration mode
+esp_err_t mcp251xfd_init(const mcp251xfd_config_t *config, TaskHandle_t int_task, mcp251xfd_handle_t *out);
+// data may be NULL for classic CAN
+esp_err_t mcp251xfd_start(mcp251xfd_handle_t mcp, const mcp251xfd_timing_t *nominal,
+                          const mcp251xfd_timing_t *data, mcp251xfd_mode_t mode);
+// Frames get a single transmission attempt (no retransmission on error or lost arbitration).
+// Takes effect with the next mcp251xfd_start().
+void mcp251xfd_set_one_shot(mcp251xfd_handle_t mcp, bool one_shot);
+// Back to configuration mode; pending TX is aborted and all FIFOs are emptied
+esp_err_t mcp251xfd_stop(mcp251xfd_handle_t mcp);
+
+// ESP_ERR_TIMEOUT when the TX FIFO is full
+esp_err_t mcp251xfd_transmit(mcp251xfd_handle_t mcp, const mcp251xfd_frame_t *frame);
+// ESP_ERR_NOT_FOUND when the FIFO is empty
+esp_err_t mcp251xfd_receive(mcp251xfd_handle_t mcp, mcp251xfd_frame_t *frame);
+esp_err_t mcp251xfd_read_tef(mcp251xfd_handle_t mcp, uint32_t *seq, uint32_t *timestamp_us);
+
+// Reads and clears pending interrupt causes plus the error counters
+esp_err_t mcp251xfd_read_events(mcp251xfd_handle_t mcp, mcp251xfd_events_t *events);
+// true while the INT line is still asserted
+bool mcp251xfd_int_pending(mcp251xfd_handle_t mcp);
+uint32_t mcp251xfd_sysclk_hz(mcp251xfd_handle_t mcp);
+// esp_timer_get_time() of the last INT falling edge, taken in the ISR
+uint32_t mcp251xfd_int_time_us(mcp251xfd_handle_t mcp);
@@ -0,0 +1,414 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "mcp251xfd.h"
+
+static const char *TAG = "MCP251XFD";
+
+// SPI instructions (4-bit opcode + 12-bit address)
+#define INS_RESET 0x0
+#define INS_WRITE 0x2
+#define INS_READ 0x3
+
+// Registers
+#define REG_CON 0x000
+#define REG_NBTCFG 0x004
+#define REG_DBTCFG 0x008
+#define REG_TDC 0x00C
+#define REG_TSCON 0x014
+#define REG_INT 0x01C
+#define REG_TREC 0x034
+#define REG_TEFCON 0x040
+#define REG_TEFSTA 0x044
+#define REG_TEFUA 0x048
+#define REG_FIFOCON(m) (0x050 + 12 * (m))
+#define REG_FIFOSTA(m) (0x054 + 12 * (m))
+#define REG_FIFOUA(m) (0x058 + 12 * (m))
+#define REG_FLTCON0 0x1D0
+#define REG_FLTOBJ0 0x1F0
+#define REG_MASK0 0x1F4
+#define REG_OSC 0xE00
+#define REG_ECCCON 0xE0C
+#define RAM_START 0x400
+
+// C1CON
+#define CON_RTXAT (1u << 16) // retransmission attempts limited by FIFOCON.TXAT
+#define CON_STEF (1u << 19)
+#define CON_OPMOD_SHIFT 21
+#define CON_REQOP_SHIFT 24
+#define CON_MODE_CONFIG 4
+// C1INT flags (enables are the same bits << 16)
+#define INT_RXIF (1u << 1)
+#define INT_TEFIF (1u << 4)
+#define INT_RXOVIF (1u << 11)
+#define INT_SERRIF (1u << 12)
+#define INT_CERRIF (1u << 13)
+#define INT_IVMIF (1u << 15)
+// FIFOCON / TEFCON
+#define FIFO_NOT_EMPTY_IE (1u << 0)
+#define FIFO_RXOVIE (1u << 3)
+#define FIFO_TSEN (1u << 5)
+#define FIFO_TXEN (1u << 7)
+#define FIFO_FRESET (1u << 10)
+#define FIFO_TXAT_UNLIMITED (3u << 21)
+#define FIFO_FSIZE(n) (((uint32_t)(n) - 1) << 24)
+#define FIFO_PLSIZE_64 (7u << 29)
+#define FIFO_UINC 0x01 // byte 1 of FIFOCON/TEFCON
+#define FIFO_TXREQ 0x02
+// FIFOSTA / TEFSTA
+#define STA_NOT_EMPTY (1u << 0) // RX: not empty, TX: not full
+#define STA_RXOVIF (1u << 3)
+// OSC
+#define OSC_OSCRDY (1u << 10)
+
+// RAM layout (2 KB): TEF, then TX FIFO 1, then RX FIFO 2, all with 64-byte payloads
+#define TEF_DEPTH MCP251XFD_TX_DEPTH
+#define TX_FIFO 1
+#define TX_DEPTH MCP251XFD_TX_DEPTH
+#define RX_FIFO 2
+#define RX_DEPTH 16
+#define TEF_OBJ_SIZE 12
+#define TX_OBJ_SIZE (8 + MCP251XFD_MAX_DATA)
+#define RX_OBJ_SIZE (12 + MCP251XFD_MAX_DATA)
+_Static_assert(TEF_DEPTH * TEF_OBJ_SIZE + TX_DEPTH * TX_OBJ_SIZE + RX_DEPTH * RX_OBJ_SIZE <= 2048,
+               "MCP251xFD message RAM overflow");
+
+// Message object header bits (T1/R1)
+#define OBJ_IDE (1u << 4)
+#define OBJ_RTR (1u << 5)
+#define OBJ_BRS (1u << 6)
+#define OBJ_FDF (1u << 7)
+#define OBJ_ESI (1u << 8)
+#define OBJ_SEQ_SHIFT 9
+
+#define XFER_MAX (2 + RX_OBJ_SIZE)
+
+struct mcp251xfd {
+    mcp251xfd_config_t config;
+    spi_device_handle_t spi;
+    SemaphoreHandle_t lock; // the RX/event task and the TX task share the device
+    TaskHandle_t int_task;
+    volatile uint32_t int_time_us; // esp_timer time of the last INT edge
+    uint8_t *tx_buf; // DMA capable
+    uint8_t *rx_buf;
+    bool one_shot; // applied by setup_fifos()
+    bool used;
+    StaticSemaphore_t lock_buf;
+};
+
+// No heap: a fixed pool of devices and their SPI buffers, in DMA-capable internal RAM
+static struct mcp251xfd devices[MCP251XFD_MAX_DEVICES];
+DMA_ATTR static uint8_t xfer_bufs[MCP251XFD_MAX_DEVICES][2][(XFER_MAX + 3) & ~3];
+
+static esp_err_t xfer(struct mcp251xfd *mcp, uint8_t ins, uint16_t addr, const void *out, void *in, size_t len) {
+    if (len + 2 > XFER_MAX) return ESP_ERR_INVALID_SIZE;
+    xSemaphoreTake(mcp->lock, portMAX_DELAY);
+    mcp->tx_buf[0] = (uint8_t)((ins << 4) | ((addr >> 8) & 0x0F));
+    mcp->tx_buf[1] = (uint8_t)addr;
+    if (out) memcpy(mcp->tx_buf + 2, out, len);
+    else memset(mcp->tx_buf + 2, 0, len);
+    spi_transaction_t t = {
+        .length = (len + 2) * 8,
+        .tx_buffer = mcp->tx_buf,
+        .rx_buffer = mcp->rx_buf,
+    };
+    esp_err_t err = spi_device_polling_transmit(mcp->spi, &t);
+    if (err == ESP_OK && in) memcpy(in, mcp->rx_buf + 2, len);
+    xSemaphoreGive(mcp->lock);
+    return err;
+}
+
+// Registers are little-endian on the wire, like the ESP32
+static esp_err_t read32(struct mcp251xfd *mcp, uint16_t addr, uint32_t *val) {
+    return xfer(mcp, INS_READ, addr, NULL, val, 4);
+}
+
+static esp_err_t write32(struct mcp251xfd *mcp, uint16_t addr, uint32_t val) {
+    return xfer(mcp, INS_WRITE, addr, &val, NULL, 4);
+}
+
+static esp_err_t write8(struct mcp251xfd *mcp, uint16_t addr, uint8_t val) {
+    return xfer(mcp, INS_WRITE, addr, &val, NULL, 1);
+}
+
+static esp_err_t set_mode(struct mcp251xfd *mcp, uint32_t mode) {
+    uint32_t con;
+    esp_err_t err = read32(mcp, REG_CON, &con);
+    if (err != ESP_OK) return err;
+    con = (con & ~(7u << CON_REQOP_SHIFT)) | (mode << CON_REQOP_SHIFT);
+    if ((err = write32(mcp, REG_CON, con)) != ESP_OK) return err;
+    // Mode changes wait for the bus to go idle (at most one frame)
+    for (int i = 0; i < 20; i++) {
+        if ((err = read32(mcp, REG_CON, &con)) != ESP_OK) return err;
+        if (((con >> CON_OPMOD_SHIFT) & 7) == mode) return ESP_OK;
+        vTaskDelay(1);
+    }
+    ESP_LOGE(TAG, "Mode %lu request timed out (CON %08lx)", mode, con);
+    return ESP_ERR_TIMEOUT;
+}
+
+static void IRAM_ATTR int_isr(void *arg) {
+    struct mcp251xfd *mcp = arg;
+    BaseType_t woken = pdFALSE;
+    mcp->int_time_us = (uint32_t)esp_timer_get_time();
+    if (mcp->int_task) vTaskNotifyGiveFromISR(mcp->int_task, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+
+static esp_err_t setup_fifos(struct mcp251xfd *mcp) {
+    esp_err_t err;
+    // 1 us time base, for RX and TEF timestamps
+    if ((err = write32(mcp, REG_TSCON, (1u << 16) | (mcp->config.osc_hz / 1000000 - 1))) != ESP_OK) return err;
+    if ((err = write32(mcp, REG_TEFCON, FIFO_FSIZE(TEF_DEPTH) | FIFO_TSEN | FIFO_NOT_EMPTY_IE)) != ESP_OK) return err;
+    // One-shot: RTXAT with TXAT 0, a single attempt per frame
+    uint32_t con;
+    if ((err = read32(mcp, REG_CON, &con)) != ESP_OK) return err;
+    con = mcp->one_shot ? con | CON_RTXAT : con & ~CON_RTXAT;
+    if ((err = write32(mcp, REG_CON, con)) != ESP_OK) return err;
+    if ((err = write32(mcp, REG_FIFOCON(TX_FIFO), FIFO_FSIZE(TX_DEPTH) | FIFO_PLSIZE_64 | FIFO_TXEN |
+                       (mcp->one_shot ? 0 : FIFO_TXAT_UNLIMITED))) != ESP_OK) return err;
+    if ((err = write32(mcp, REG_FIFOCON(RX_FIFO), FIFO_FSIZE(RX_DEPTH) | FIFO_PLSIZE_64 | FIFO_TSEN |
+                       FIFO_RXOVIE | FIFO_NOT_EMPTY_IE)) != ESP_OK) return err;
+    // Filter 0 accepts everything into the RX FIFO
+    if ((err = write32(mcp, REG_FLTOBJ0, 0)) != ESP_OK) return err;
+    if ((err = write32(mcp, REG_MASK0, 0)) != ESP_OK) return err;
+    if ((err = write8(mcp, REG_FLTCON0, 0x80 | RX_FIFO)) != ESP_OK) return err;
+    uint32_t ie = INT_RXIF | INT_TEFIF | INT_RXOVIF | INT_SERRIF | INT_CERRIF | INT_IVMIF;
+    return write32(mcp, REG_INT, ie << 16);
+}
+
+esp_err_t mcp251xfd_init(const mcp251xfd_config_t *config, TaskHandle_t int_task, mcp251xfd_handle_t *out) {
+    if (config->osc_hz != 20000000 && config->osc_hz != 40000000) return ESP_ERR_INVALID_ARG;
+    size_t slot = 0;
+    while (slot < MCP251XFD_MAX_DEVICES && devices[slot].used) slot++;
+    if (slot == MCP251XFD_MAX_DEVICES) return ESP_ERR_NO_MEM;
+    struct mcp251xfd *mcp = &devices[slot];
+    memset(mcp, 0, sizeof(*mcp));
+    mcp->used = true;
+    mcp->config = *config;
+    mcp->int_task = int_task;
+    mcp->lock = xSemaphoreCreateMutexStatic(&mcp->lock_buf);
+    mcp->tx_buf = xfer_bufs[slot][0];
+    mcp->rx_buf = xfer_bufs[slot][1];
+    esp_err_t err;
+
+    spi_device_interface_config_t dev = {
+        .mode = 0,
+        .clock_speed_hz = config->spi_clock_hz,
+        .spics_io_num = config->cs_io,
+        .queue_size = 1,
+    };
+    if ((err = spi_bus_add_device(config->host, &dev, &mcp->spi)) != ESP_OK) goto fail;
+
+    // The chip may still be running from before an ESP reset: RESET is only safe in configuration mode
+    set_mode(mcp, CON_MODE_CONFIG);
+    xfer(mcp, INS_RESET, 0, NULL, NULL, 0);
+    vTaskDelay(1);
+    uint32_t osc = 0;
+    for (int i = 0; i < 10 && !(osc & OSC_OSCRDY); i++) {
+        read32(mcp, REG_OSC, &osc);
+        vTaskDelay(1);
+    }
+    if (!(osc & OSC_OSCRDY)) {
+        ESP_LOGE(TAG, "Oscillator not ready (OSC %08lx), check wiring", osc);
+        err = ESP_ERR_NOT_FOUND;
+        goto fail;
+    }
+    uint32_t con = 0;
+    read32(mcp, REG_CON, &con);
+    if (((con >> CON_OPMOD_SHIFT) & 7) != CON_MODE_CONFIG) {
+        ESP_LOGE(TAG, "Not in configuration mode after reset (CON %08lx)", con);
+        err = ESP_ERR_INVALID_STATE;
+        goto fail;
+    }
+    // Store TX events so completions (and their echoes) come back in order; ECC on message RAM
+    if ((err = write32(mcp, REG_CON, con | CON_STEF)) != ESP_OK) goto fail;
+    if ((err = write32(mcp, REG_ECCCON, 1)) != ESP_OK) goto fail;
+    if ((err = setup_fifos(mcp)) != ESP_OK) goto fail;
+
+    gpio_config_t io = {
+        .pin_bit_mask = 1ULL << config->int_io,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    gpio_config(&io);
+    gpio_install_isr_service(ESP_INTR_FLAG_IRAM); // ESP_ERR_INVALID_STATE if already installed
+    if ((err = gpio_isr_handler_add(config->int_io, int_isr, mcp)) != ESP_OK) goto fail;
+
+    ESP_LOGI(TAG, "MCP251xFD ready (CS %d, INT %d, %lu Hz osc)", config->cs_io, config->int_io, config->osc_hz);
+    *out = mcp;
+    return ESP_OK;
+
+fail:
+    if (mcp->spi) spi_bus_remove_device(mcp->spi);
+    vSemaphoreDelete(mcp->lock);
+    mcp->used = false;
+    return err;
+}
+
+esp_err_t mcp251xfd_start(mcp251xfd_handle_t mcp, const mcp251xfd_timing_t *nominal,
+                          const mcp251xfd_timing_t *data, mcp251xfd_mode_t mode) {
+    esp_err_t err = mcp251xfd_stop(mcp);
+    if (err != ESP_OK) return err;
+    if (nominal->brp < 1 || nominal->brp > 256 || nominal->tseg1 < 2 || nominal->tseg1 > 256 ||
+        nominal->tseg2 < 1 || nominal->tseg2 > 128 || nominal->sjw < 1 || nominal->sjw > 128) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t nbt = ((nominal->brp - 1) << 24) | ((nominal->tseg1 - 1) << 16) |
+                   ((nominal->tseg2 - 1) << 8) | (nominal->sjw - 1);
+    if ((err = write32(mcp, REG_NBTCFG, nbt)) != ESP_OK) return err;
+    if (data) {
+        if (data->brp < 1 || data->brp > 256 || data->tseg1 < 1 || data->tseg1 > 32 ||
+            data->tseg2 < 1 || data->tseg2 > 16 || data->sjw < 1 || data->sjw > 16) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        uint32_t dbt = ((data->brp - 1) << 24) | ((data->tseg1 - 1) << 16) |
+                       ((data->tseg2 - 1) << 8) | (data->sjw - 1);
+        if ((err = write32(mcp, REG_DBTCFG, dbt)) != ESP_OK) return err;
+        // Automatic transmitter delay compensation, offset at the data sample point
+        uint32_t tdco = data->brp * data->tseg1;
+        if (tdco > 63) tdco = 63;
+        if ((err = write32(mcp, REG_TDC, (2u << 16) | (tdco << 8))) != ESP_OK) return err;
+    }
+    return set_mode(mcp, mode);
+}
+
+void mcp251xfd_set_one_shot(mcp251xfd_handle_t mcp, bool one_shot) {
+    mcp->one_shot = one_shot;
+}
+
+esp_err_t mcp251xfd_stop(mcp251xfd_handle_t mcp) {
+    esp_err_t err = set_mode(mcp, CON_MODE_CONFIG);
+    if (err != ESP_OK) return err;
+    // Configuration mode resets the FIFOs and TEF; restore their layout
+    return setup_fifos(mcp);
+}
+
+static uint32_t id_to_obj(uint32_t id, bool extd) {
+    // SID[10:0] in bits 0..10, EID[17:0] in bits 11..28
+    if (!extd) return id & 0x7FF;
+    return ((id >> 18) & 0x7FF) | ((id & 0x3FFFF) << 11);
+}
+
+static uint32_t obj_to_id(uint32_t obj, bool extd) {
+    if (!extd) return obj & 0x7FF;
+    return ((obj & 0x7FF) << 18) | ((obj >> 11) & 0x3FFFF);
+}
+
+esp_err_t mcp251xfd_transmit(mcp251xfd_handle_t mcp, const mcp251xfd_frame_t *frame) {
+    uint32_t sta, ua;
+    esp_err_t err;
+    if ((err = read32(mcp, REG_FIFOSTA(TX_FIFO), &sta)) != ESP_OK) return err;
+    if (!(sta & STA_NOT_EMPTY)) return ESP_ERR_TIMEOUT;
+    if ((err = read32(mcp, REG_FIFOUA(TX_FIFO), &ua)) != ESP_OK) return err;
+
+    uint8_t obj[TX_OBJ_SIZE];
+    bool extd = frame->flags & MCP251XFD_FLAG_EXTD;
+    uint32_t t0 = id_to_obj(frame->id, extd);
+    uint32_t t1 = (frame->dlc & 0xF) | (frame->seq << OBJ_SEQ_SHIFT);
+    if (extd) t1 |= OBJ_IDE;
+    if (frame->flags & MCP251XFD_FLAG_RTR) t1 |= OBJ_RTR;
+    if (frame->flags & MCP251XFD_FLAG_FD) t1 |= OBJ_FDF;
+    if (frame->flags & MCP251XFD_FLAG_BRS) t1 |= OBJ_BRS;
+    if (frame->flags & MCP251XFD_FLAG_ESI) t1 |= OBJ_ESI;
+    memcpy(obj, &t0, 4);
+    memcpy(obj + 4, &t1, 4);
+    uint8_t len = mcp251xfd_dlc_to_len(frame->dlc);
+    memcpy(obj + 8, frame->data, len);
+    size_t size = 8 + ((len + 3) & ~3u); // RAM is written in whole words
+    memset(obj + 8 + len, 0, size - 8 - len);
+
+    if ((err = xfer(mcp, INS_WRITE, RAM_START + (ua & 0xFFF), obj, NULL, size)) != ESP_OK) return err;
+    return write8(mcp, REG_FIFOCON(TX_FIFO) + 1, FIFO_UINC | FIFO_TXREQ);
+}
+
+esp_err_t mcp251xfd_receive(mcp251xfd_handle_t mcp, mcp251xfd_frame_t *frame) {
+    uint32_t sta, ua;
+    esp_err_t err;
+    if ((err = read32(mcp, REG_FIFOSTA(RX_FIFO), &sta)) != ESP_OK) return err;
+    if (!(sta & STA_NOT_EMPTY)) return ESP_ERR_NOT_FOUND;
+    if ((err = read32(mcp, REG_FIFOUA(RX_FIFO), &ua)) != ESP_OK) return err;
+
+    // Header, timestamp and the first 8 data bytes in one go: all a classic frame needs
+    uint8_t obj[RX_OBJ_SIZE];
+    uint16_t addr = RAM_START + (ua & 0xFFF);
+    if ((err = xfer(mcp, INS_READ, addr, NULL, obj, 12 + 8)) != ESP_OK) return err;
+    uint32_t r0, r1, ts;
+    memcpy(&r0, obj, 4);
+    memcpy(&r1, obj + 4, 4);
+    memcpy(&ts, obj + 8, 4);
+    frame->dlc = r1 & 0xF;
+    uint8_t len = mcp251xfd_dlc_to_len(frame->dlc);
+    if (len > 8 && (err = xfer(mcp, INS_READ, addr + 20, NULL, obj + 20, (len - 8 + 3) & ~3u)) != ESP_OK) return err;
+
+    bool extd = r1 & OBJ_IDE;
+    frame->id = obj_to_id(r0, extd);
+    frame->flags = (extd ? MCP251XFD_FLAG_EXTD : 0) | ((r1 & OBJ_RTR) ? MCP251XFD_FLAG_RTR : 0) |
+                   ((r1 & OBJ_FDF) ? MCP251XFD_FLAG_FD : 0) | ((r1 & OBJ_BRS) ? MCP251XFD_FLAG_BRS : 0) |
+                   ((r1 & OBJ_ESI) ? MCP251XFD_FLAG_ESI : 0);
+    frame->timestamp_us = ts;
+    frame->seq = 0;
+    memcpy(frame->data, obj + 12, len);
+    return write8(mcp, REG_FIFOCON(RX_FIFO) + 1, FIFO_UINC);
+}
+
+esp_err_t mcp251xfd_read_tef(mcp251xfd_handle_t mcp, uint32_t *seq, uint32_t *timestamp_us) {
+    uint32_t sta, ua;
+    esp_err_t err;
+    if ((err = read32(mcp, REG_TEFSTA, &sta)) != ESP_OK) return err;
+    if (!(sta & STA_NOT_EMPTY)) return ESP_ERR_NOT_FOUND;
+    if ((err = read32(mcp, REG_TEFUA, &ua)) != ESP_OK) return err;
+    uint32_t obj[3];
+    if ((err = xfer(mcp, INS_READ, RAM_START + (ua & 0xFFF), NULL, obj, sizeof(obj))) != ESP_OK) return err;
+    *seq = obj[1] >> OBJ_SEQ_SHIFT;
+    *timestamp_us = obj[2];
+    return write8(mcp, REG_TEFCON + 1, FIFO_UINC);
+}
+
+esp_err_t mcp251xfd_read_events(mcp251xfd_handle_t mcp, mcp251xfd_events_t *events) {
+    uint32_t intf, trec;
+    esp_err_t err;
+    if ((err = read32(mcp, REG_INT, &intf)) != ESP_OK) return err;
+    if ((err = read32(mcp, REG_TREC, &trec)) != ESP_OK) return err;
+
+    events->flags = 0;
+    if (intf & INT_RXIF) events->flags |= MCP251XFD_EV_RX;
+    if (intf & INT_TEFIF) events->flags |= MCP251XFD_EV_TEF;
+    if (intf & INT_RXOVIF) {
+        events->flags |= MCP251XFD_EV_RX_OVERFLOW;
+        uint32_t sta;
+        if (read32(mcp, REG_FIFOSTA(RX_FIFO), &sta) == ESP_OK) write32(mcp, REG_FIFOSTA(RX_FIFO), sta & ~STA_RXOVIF);
+    }
+    if (intf & INT_CERRIF) events->flags |= MCP251XFD_EV_ERR_STATE;
+    if (intf & INT_SERRIF) events->flags |= MCP251XFD_EV_SYS_ERR;
+    if (intf & INT_IVMIF) events->flags |= MCP251XFD_EV_BUS_ERR;
+
+    // Clear the latched causes (writing 0 clears, RXIF/TEFIF follow their FIFOs)
+    uint16_t clear = (uint16_t)(intf & (INT_SERRIF | INT_CERRIF | INT_IVMIF));
+    if (clear) {
+        uint16_t val = (uint16_t)~clear;
+        xfer(mcp, INS_WRITE, REG_INT, &val, NULL, 2);
+    }
+    events->rec = trec & 0xFF;
+    events->tec = (trec >> 8) & 0xFF;
+    events->status = trec & (MCP251XFD_ST_WARN | MCP251XFD_ST_RX_WARN | MCP251XFD_ST_TX_WARN |
+                             MCP251XFD_ST_RX_PASSIVE | MCP251XFD_ST_TX_PASSIVE | MCP251XFD_ST_BUS_OFF);
+    return ESP_OK;
+}
+
+bool mcp251xfd_int_pending(mcp251xfd_handle_t mcp) {
+    return gpio_get_level(mcp->config.int_io) == 0;
+}
+
+uint32_t mcp251xfd_sysclk_hz(mcp251xfd_handle_t mcp) {
+    return mcp->config.osc_hz;
+}
+
+uint32_t mcp251xfd_int_time_us(mcp251xfd_handle_t mcp) {
+    return mcp->int_time_us;
+}
@@ -0,0 +1,238 @@
+import argparse
+import os
+import sys
+
+import yaml
+
+# Regenerates the RoboStride codecs from docs/device_can/robostride/*/metadata.yaml:
+#   include/robostride_models.h   limits, command types and fault bits for the firmware
+#   include/robostride_codecs.h   per-model pack/decode inlines with the scales as constants
+#   nativeCAN/robostride_models.py           the same tables for the host tools
+#   untested--pythoncan/.../robostride_models.py   and for td_can_bridges
+#   untested--pythoncan/.../robostride.dbc   every model's frames, for CanBusService
+# All outputs are committed, so a build needs neither Python nor PyYAML. Run it after editing a
+# metadata file; --check fails if the outputs are stale.
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+REPO = os.path.normpath(os.path.join(HERE, '..', '..', '..', '..'))
+DOCS = os.path.join(REPO, 'docs', 'device_can', 'robostride')
+C_OUT = os.path.join(HERE, 'include', 'robostride_models.h')
+CODECS_OUT = os.path.join(HERE, 'include', 'robostride_codecs.h')
+PY_OUT = os.path.join(REPO, 'nativeCAN', 'robostride_models.py')
+PKG_PY_OUT = os.path.join(REPO, 'untested--pythoncan', 'td_can_bridges', 'robostride_models.py')
+DBC_OUT = os.path.join(REPO, 'untested--pythoncan', 'td_can_bridges', 'schemas', 'robostride.dbc')
+
+# control_limits key -> field name in rs_limits_t / robostride.Limits
+FIELDS = [('position_rad', 'p'), ('velocity_rad_s', 'v'), ('torque_nm', 't'), ('kp', 'kp'), ('kd', 'kd')]
+
+BANNER = "Generated by nativeCAN/USB_CAN_esp32s3/components/robostride/gen_models.py from " \
+         "docs/device_can/robostride/*/metadata.yaml. Do not edit."
+
+def c_name(identifier):
+    return identifier.upper().replace('-', '_').replace(' ', '_')
+
+def merge(table, key, value, what, path):
+    if table.setdefault(key, value) != value:
+        raise SystemExit(f"{path}: {what} {key} is '{value}', another model has '{table[key]}'")
+
+def load_protocol(meta, path, types, mit, faults):
+    """Command types, MIT commands and fault bits; the models share them, so they must agree."""
+    for proto in meta.get('protocols') or []:
+        if proto.get('name') == 'robostride_private':
+            for cmd in proto.get('command_types') or []:
+                merge(types, int(cmd['type']), c_name(cmd['identifier']), 'command type', path)
+            for fault in proto.get('faults') or []:
+                for bit, name in (fault.get('bits') or {}).items():
+                    merge(faults, int(bit), c_name(name), f"fault bit of {fault['source']:#x}", path)
+        elif proto.get('name') == 'mit':
+            for cmd in proto.get('commands') or []:
+                merge(mit, int(cmd['id']), c_name(cmd['name']), 'MIT command', path)
+
+def load_models():
+    models = []
+    types, mit, faults = {}, {}, {}
+    for name in sorted(os.listdir(DOCS)):
+        path = os.path.join(DOCS, name, 'metadata.yaml')
+        if not os.path.isfile(path):
+            continue
+        with open(path) as f:
+            meta = yaml.safe_load(f)
+        load_protocol(meta, path, types, mit, faults)
+        lim = meta.get('control_limits')
+        if lim is None:
+            continue
+        ranges = []
+        for key, _ in FIELDS:
+            lo, hi = (float(x) for x in lim[key])
+            if not hi > lo:
+                raise SystemExit(f"{path}: {key} range [{lo}, {hi}] is empty")
+            ranges.append((lo, hi))
+        models.append((meta['model'], ranges, float(lim['temperature_scale_c'])))
+    if not models:
+        raise SystemExit(f"no control_limits found under {DOCS}")
+    return models, sorted(types.items()), sorted(mit.items()), sorted(faults.items())
+
+def c_float(x):
+    return f"{x!r}f"
+
+def render_c(models, types, mit, faults):
+    out = [f"// {BANNER}", "#pragma once", ""]
+    out.append("typedef enum {")
+    out += [f"    RS_MODEL_{m}," for m, _, _ in models]
+    out += ["    RS_MODEL_COUNT,", "} rs_model_t;", ""]
+    for m, ranges, temp in models:
+        args = ", ".join(f"RS_RANGE({c_float(lo)}, {c_float(hi)})" for lo, hi in ranges)
+        out.append(f"#define {m}_LIMITS {{ {args}, {c_float(temp)} }}")
+    out.append("")
+    out.append("#define RS_MODEL_LIMITS { \\")
+    out += [f"    [RS_MODEL_{m}] = {m}_LIMITS, \\" for m, _, _ in models]
+    out += ["}", ""]
+    out.append("// Private protocol communication types (bits 24..28 of the extended ID)")
+    out += [f"#define RS_TYPE_{name} {t}" for t, name in types]
+    out += ["", "// MIT protocol commands"]
+    out += [f"#define RS_MIT_{name} {i}" for i, name in mit]
+    out += ["", "// Fault bits of parameter 0x3022"]
+    out += [f"#define RS_FAULT_{name} (1u << {bit})" for bit, name in faults]
+    out.append("")
+    return "\n".join(out)
+
+def render_codecs(models):
+    # Included at the end of robostride.h. With the limits a constant object the compiler folds each
+    # scale into the code, so these cost what a hand-written codec for one model would.
+    out = [f"// {BANNER}", "#pragma once", ""]
+    for m, _, _ in models:
+        x = m.lower()
+        out += [
+            f"static const rs_limits_t {x}_limits = {m}_LIMITS;",
+            "",
+            f"static inline uint32_t {x}_pack_op_control(uint8_t motor_id, float pos, float vel, float torque, float kp,",
+            f"                                           float kd, uint8_t data[8]) {{",
+            f"    return rs_pack_op_control(&{x}_limits, motor_id, pos, vel, torque, kp, kd, data);",
+            "}",
+            "",
+            f"static inline void {x}_decode_feedback(uint32_t id, const uint8_t data[8], rs_feedback_t *fb) {{",
+            f"    rs_decode_feedback(&{x}_limits, id, data, fb);",
+            "}",
+            "",
+            f"static inline void {x}_pack_mit(float pos, float vel, float kp, float kd, float torque, uint8_t data[8]) {{",
+            f"    rs_pack_mit(&{x}_limits, pos, vel, kp, kd, torque, data);",
+            "}",
+            "",
+            f"static inline void {x}_decode_mit_feedback(const uint8_t data[8], rs_feedback_t *fb) {{",
+            f"    rs_decode_mit_feedback(&{x}_limits, data, fb);",
+            "}",
+            "",
+        ]
+    return "\n".join(out)
+
+def render_py(models, types, mit, faults):
+    out = [f"# {BANNER}", "", "# model -> ((lo, hi) for position, velocity, torque, kp, kd), temperature scale", "MODELS = {"]
+    for m, ranges, temp in models:
+        out.append(f"    {m!r}: ({', '.join(f'({lo!r}, {hi!r})' for lo, hi in ranges)}, {temp!r}),")
+    out += ["}", ""]
+    for name, title, table, value in (
+        ("TYPES", "private protocol communication types", types, "{}"),
+        ("MIT_COMMANDS", "MIT protocol commands", mit, "{}"),
+        ("FAULTS", "fault bit masks of parameter 0x3022", faults, "1 << {}"),
+    ):
+        out += [f"# {title}", f"{name} = {{"]
+        out += [f"    {n.lower()!r}: {value.format(k)}," for k, n in table]
+        out += ["}", ""]
+    return "\n".join(out)
+
+DBC_HEADER = """VERSION ""
+
+NS_ :
+    NS_DESC_
+    CM_
+    BA_DEF_
+    BA_
+    VAL_
+    CAT_DEF_
+    CAT_
+    FILTER
+    BA_DEF_DEF_
+    EV_DATA_
+    ENVVAR_DATA_
+    SGTYPE_
+    SGTYPE_VAL_
+    BA_DEF_SGTYPE_
+    BA_SGTYPE_
+    SIG_TYPE_REF_
+    VAL_TABLE_
+    SIG_GROUP_
+    SIG_VALTYPE_
+    SIGTYPE_VALTYPE_
+    BO_TX_BU_
+    BA_DEF_REL_
+    BA_REL_
+    BA_DEF_DEF_REL_
+    BU_SG_REL_
+    BU_EV_REL_
+    BU_BO_REL_
+    SG_MUL_VAL_
+
+BS_:
+"""
+
+def dbc_num(x):
+    return f"{x:.15f}".rstrip("0").rstrip(".")  # as motors.dbc writes its scales
+
+def dbc_signal(node, name, start, bits, lo, hi, unit):
+    scale = (hi - lo) / ((1 << bits) - 1)
+    return f' SG_ {name:<15}: {start}|{bits}@0+ ({dbc_num(scale)},{dbc_num(lo)}) [{dbc_num(lo)}|{dbc_num(hi)}] "{unit}" {node}'
+
+def render_dbc(models, types):
+    type_of = {name: t for t, name in types}
+    out = [DBC_HEADER, "BU_: " + " ".join(m for m, _, _ in models), ""]
+    notes = [f'CM_ "{BANNER} The low ID byte only keeps the models\' frames distinct: bind the '
+             f'private protocol messages with id_mask 0x1F000000 (and can_id for one motor).";']
+    for k, (m, ranges, temp) in enumerate(models):
+        pos, vel, torque, kp, kd = (
+            (name, lo, hi, unit) for (lo, hi), (name, unit) in
+            zip(ranges, (("position_rad", "rad"), ("velocity_rads", "rad/s"), ("torque_Nm", "Nm"), ("kp", ""), ("kd", "")))
+        )
+        ext = lambda t: 0x80000000 | type_of[t] << 24 | k  # cantools marks extended IDs with bit 31
+        op, fb, cmd, reply = ext("MOTION_CONTROL"), ext("FEEDBACK"), 0x100 + k, 0x110 + k
+        out.append(f"BO_ {op} {m}_OpControl: 8 {m}")
+        out += [dbc_signal(m, n, 7 + 16 * i, 16, lo, hi, u) for i, (n, lo, hi, u) in enumerate((pos, vel, kp, kd))]
+        out += ["", f"BO_ {fb} {m}_Feedback: 8 {m}"]
+        out += [dbc_signal(m, n, 7 + 16 * i, 16, lo, hi, u) for i, (n, lo, hi, u) in enumerate((pos, vel, torque))]
+        out.append(f' SG_ {"temperature_C":<15}: 55|16@0+ ({dbc_num(temp)},0) [0|{dbc_num(65535 * temp)}] "C" {m}')
+        out += ["", f"BO_ {cmd} {m}_MitCommand: 8 {m}",
+                dbc_signal(m, pos[0], 7, 16, *pos[1:]),
+                dbc_signal(m, vel[0], 23, 12, *vel[1:]),
+                dbc_signal(m, kp[0], 27, 12, *kp[1:]),
+                dbc_signal(m, kd[0], 47, 12, *kd[1:]),
+                dbc_signal(m, torque[0], 51, 12, *torque[1:]),
+                "", f"BO_ {reply} {m}_MitFeedback: 8 {m}",
+                f' SG_ {"motor_id":<15}: 7|8@0+ (1,0) [0|255] "" {m}',
+                dbc_signal(m, pos[0], 15, 16, *pos[1:]),
+                dbc_signal(m, vel[0], 31, 12, *vel[1:]),
+                dbc_signal(m, torque[0], 35, 12, *torque[1:]), ""]
+        notes += [f'CM_ BO_ {op} "Type 1 operation control; the feed-forward torque is in ID bits 8..23.";',
+                  f'CM_ BO_ {fb} "Type 2 feedback; fault and mode bits in ID bits 16..23, motor ID in bits 8..15.";',
+                  f'CM_ BO_ {cmd} "MIT command 3 on the standard ID of the motor; speed, Kp, Kd and torque in 12 bits.";',
+                  f'CM_ BO_ {reply} "MIT response 1.";']
+    return "\n".join(out + notes) + "\n"
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Generate the RoboStride model tables")
+    parser.add_argument('--check', action='store_true', help="only check that the outputs are up to date")
+    args = parser.parse_args()
+
+    models, types, mit, faults = load_models()
+    stale = []
+    for path, text in ((C_OUT, render_c(models, types, mit, faults)), (CODECS_OUT, render_codecs(models)),
+                       (PY_OUT, render_py(models, types, mit, faults)),
+                       (PKG_PY_OUT, render_py(models, types, mit, faults)), (DBC_OUT, render_dbc(models, types))):
+        old = open(path).read() if os.path.exists(path) else None
+        if old == text:
+            continue
+        stale.append(path)
+        if not args.check:
+            with open(path, 'w') as f:
+                f.write(text)
+    for path in stale:
+        print(f"{'stale' if args.check else 'wrote'}: {os.path.relpath(path, REPO)}")
+    sys.exit(1 if args.check and stale else 0)
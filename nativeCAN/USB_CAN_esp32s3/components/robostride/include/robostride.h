@@ -0,0 +1,158 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// RobStride codec for the private protocol (operation-control mode) and MIT mode, shared by the
+// bridge and twai_motor_demo. nativeCAN/robostride.py is the same codec for the host tools.
+// Extended 29-bit identifier:
+//   bits  0..7   : motor CAN_ID (commands) / host CAN_ID (feedback)
+//   bits  8..23  : type-specific data (type 1: feed-forward torque, type 2: motor ID + status)
+//   bits 24..28  : communication type
+
+// A field's range and its scales to and from the 16-bit code, folded at compile time so that
+// packing costs a multiply per field and no divide (the C3 has no FPU).
+typedef struct {
+    float min;
+    float enc; // 65535 / (max - min)
+    float dec; // (max - min) / 65535
+} rs_range_t;
+
+typedef struct {
+    rs_range_t p, v, t, kp, kd; // rad, rad/s, N·m, Kp, Kd
+    float temp_scale;           // °C per feedback temperature LSB
+} rs_limits_t;
+
+#define RS_RANGE(lo, hi) { (lo), 65535.0f / ((hi) - (lo)), ((hi) - (lo)) / 65535.0f }
+
+// RS02_LIMITS, RS03_LIMITS, RS04_LIMITS, rs_model_t, RS_MODEL_LIMITS and the RS_TYPE_*, RS_MIT_*
+// and RS_FAULT_* codes, from the model metadata
+#include "robostride_models.h"
+
+#define RS_TYPE_OP_CONTROL RS_TYPE_MOTION_CONTROL
+
+typedef struct {
+    uint8_t motor_id;
+    uint8_t fault; // bits 16..21: under-voltage, over-current, over-temp, encoder, HALL, uncalibrated
+    uint8_t mode;  // 0 reset, 1 calibration, 2 run
+    float pos;     // rad
+    float vel;     // rad/s
+    float torque;  // N·m
+    float temp;    // °C
+} rs_feedback_t;
+
+typedef struct {
+    float pos;    // rad
+    float vel;    // rad/s
+    float torque; // N·m, feed-forward
+    float kp;
+    float kd;
+} rs_command_t;
+
+// A whole type-1 frame: the 29-bit extended ID and the payload
+typedef struct {
+    uint32_t id;
+    uint8_t data[8];
+} rs_frame_t;
+
+// Truncates like the manual's float_to_uint; out-of-range values clamp to the ends.
+static inline uint16_t rs_encode(const rs_range_t *r, float x) {
+    float u = (x - r->min) * r->enc;
+    if (u <= 0.0f) return 0;
+    if (u >= 65535.0f) return 65535;
+    return (uint16_t)u;
+}
+
+static inline float rs_decode(const rs_range_t *r, uint16_t u) {
+    return (float)u * r->dec + r->min;
+}
+
+// The MIT layout packs most fields in 12 bits. Rescale the 16-bit code in integers instead of
+// keeping a second set of scales. Going down is round(c * 4095 / 65535), with the divide by 65535
+// done as (y + (y >> 16) + 1) >> 16, which is exact for these y. Going up is bit replication
+// (0 -> 0, 4095 -> 65535), within one 16-bit LSB of c * 65535 / 4095.
+static inline uint16_t rs_code12(uint16_t c16) {
+    uint32_t y = (uint32_t)c16 * 4095u + 32767u;
+    return (uint16_t)((y + (y >> 16) + 1u) >> 16);
+}
+
+static inline uint16_t rs_code16(uint16_t c12) {
+    return (uint16_t)(c12 << 4 | c12 >> 8);
+}
+
+static inline uint32_t rs_build_ext_id(uint8_t motor_id, uint16_t data, uint8_t type) {
+    return (uint32_t)motor_id | ((uint32_t)data << 8) | ((uint32_t)(type & 0x1F) << 24);
+}
+
+static inline uint8_t rs_ext_id_type(uint32_t id) {
+    return (id >> 24) & 0x1F;
+}
+
+static inline void rs_put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)(v & 0xFF);
+}
+
+static inline uint16_t rs_get16(const uint8_t *p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+// Type 1: torque rides in the identifier, position/speed/Kp/Kd are big-endian in the payload
+static inline uint32_t rs_pack_op_control(const rs_limits_t *l, uint8_t motor_id, float pos, float vel,
+                                          float torque, float kp, float kd, uint8_t data[8]) {
+    rs_put16(&data[0], rs_encode(&l->p, pos));
+    rs_put16(&data[2], rs_encode(&l->v, vel));
+    rs_put16(&data[4], rs_encode(&l->kp, kp));
+    rs_put16(&data[6], rs_encode(&l->kd, kd));
+    return rs_build_ext_id(motor_id, rs_encode(&l->t, torque), RS_TYPE_OP_CONTROL);
+}
+
+// Type 1 for n motors in one call: frames[i] commands motor_ids[i] with cmds[i], scaled with lims[i].
+// One limits pointer per motor, so a limb can mix models.
+static inline void rs_pack_op_control_batch(size_t n, const rs_limits_t *const lims[], const uint8_t motor_ids[],
+                                            const rs_command_t cmds[], rs_frame_t frames[]) {
+    for (size_t i = 0; i < n; i++) {
+        const rs_command_t *c = &cmds[i];
+        frames[i].id = rs_pack_op_control(lims[i], motor_ids[i], c->pos, c->vel, c->torque, c->kp, c->kd,
+                                          frames[i].data);
+    }
+}
+
+// Type 2. The caller has checked rs_ext_id_type(id) == RS_TYPE_FEEDBACK.
+static inline void rs_decode_feedback(const rs_limits_t *l, uint32_t id, const uint8_t data[8], rs_feedback_t *fb) {
+    fb->motor_id = (id >> 8) & 0xFF;
+    fb->fault = (id >> 16) & 0x3F;
+    fb->mode = (id >> 22) & 0x3;
+    fb->pos = rs_decode(&l->p, rs_get16(&data[0]));
+    fb->vel = rs_decode(&l->v, rs_get16(&data[2]));
+    fb->torque = rs_decode(&l->t, rs_get16(&data[4]));
+    fb->temp = (float)rs_get16(&data[6]) * l->temp_scale;
+}
+
+// MIT command 3 (standard frame, ID = motor CAN_ID): position 16 bits, speed/Kp/Kd/torque 12 bits
+static inline void rs_pack_mit(const rs_limits_t *l, float pos, float vel, float kp, float kd, float torque,
+                               uint8_t data[8]) {
+    uint16_t v = rs_code12(rs_encode(&l->v, vel));
+    uint16_t kp12 = rs_code12(rs_encode(&l->kp, kp));
+    uint16_t kd12 = rs_code12(rs_encode(&l->kd, kd));
+    uint16_t t = rs_code12(rs_encode(&l->t, torque));
+    rs_put16(&data[0], rs_encode(&l->p, pos));
+    data[2] = (uint8_t)(v >> 4);
+    data[3] = (uint8_t)((v & 0xF) << 4 | kp12 >> 8);
+    data[4] = (uint8_t)(kp12 & 0xFF);
+    data[5] = (uint8_t)(kd12 >> 4);
+    data[6] = (uint8_t)((kd12 & 0xF) << 4 | t >> 8);
+    data[7] = (uint8_t)(t & 0xFF);
+}
+
+// MIT response 1: motor ID, position 16 bits, speed/torque 12 bits. Only motor_id, pos, vel and
+// torque are filled in.
+static inline void rs_decode_mit_feedback(const rs_limits_t *l, const uint8_t data[8], rs_feedback_t *fb) {
+    fb->motor_id = data[0];
+    fb->pos = rs_decode(&l->p, rs_get16(&data[1]));
+    fb->vel = rs_decode(&l->v, rs_code16((uint16_t)(data[3] << 4 | data[4] >> 4)));
+    fb->torque = rs_decode(&l->t, rs_code16((uint16_t)((data[4] & 0xF) << 8 | data[5])));
+}
+
+// rs02_pack_op_control(), rs03_decode_feedback(), ...: the codecs above with one model's limits
+// folded in as constants; use these when the model is known at compile time
+#include "robostride_codecs.h"
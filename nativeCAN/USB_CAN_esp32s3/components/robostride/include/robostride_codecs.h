@@ -0,0 +1,59 @@
+// Generated by nativeCAN/USB_CAN_esp32s3/components/robostride/gen_models.py from docs/device_can/robostride/*/metadata.yaml. Do not edit.
+#pragma once
+
+static const rs_limits_t rs02_limits = RS02_LIMITS;
+
+static inline uint32_t rs02_pack_op_control(uint8_t motor_id, float pos, float vel, float torque, float kp,
+                                           float kd, uint8_t data[8]) {
+    return rs_pack_op_control(&rs02_limits, motor_id, pos, vel, torque, kp, kd, data);
+}
+
+static inline void rs02_decode_feedback(uint32_t id, const uint8_t data[8], rs_feedback_t *fb) {
+    rs_decode_feedback(&rs02_limits, id, data, fb);
+}
+
+static inline void rs02_pack_mit(float pos, float vel, float kp, float kd, float torque, uint8_t data[8]) {
+    rs_pack_mit(&rs02_limits, pos, vel, kp, kd, torque, data);
+}
+
+static inline void rs02_decode_mit_feedback(const uint8_t data[8], rs_feedback_t *fb) {
+    rs_decode_mit_feedback(&rs02_limits, data, fb);
+}
+
+static const rs_limits_t rs03_limits = RS03_LIMITS;
+
+static inline uint32_t rs03_pack_op_control(uint8_t motor_id, float pos, float vel, float torque, float kp,
+                                           float kd, uint8_t data[8]) {
+    return rs_pack_op_control(&rs03_limits, motor_id, pos, vel, torque, kp, kd, data);
+}
+
+static inline void rs03_decode_feedback(uint32_t id, const uint8_t data[8], rs_feedback_t *fb) {
+    rs_decode_feedback(&rs03_limits, id, data, fb);
+}
+
+static inline void rs03_pack_mit(float pos, float vel, float kp, float kd, float torque, uint8_t data[8]) {
+    rs_pack_mit(&rs03_limits, pos, vel, kp, kd, torque, data);
+}
+
+static inline void rs03_decode_mit_feedback(const uint8_t data[8], rs_feedback_t *fb) {
+    rs_decode_mit_feedback(&rs03_limits, data, fb);
+}
+
+static const rs_limits_t rs04_limits = RS04_LIMITS;
+
+static inline uint32_t rs04_pack_op_control(uint8_t motor_id, float pos, float vel, float torque, float kp,
+                                           float kd, uint8_t data[8]) {
+    return rs_pack_op_control(&rs04_limits, motor_id, pos, vel, torque, kp, kd, data);
+}
+
+static inline void rs04_decode_feedback(uint32_t id, const uint8_t data[8], rs_feedback_t *fb) {
+    rs_decode_feedback(&rs04_limits, id, data, fb);
+}
+
+static inline void rs04_pack_mit(float pos, float vel, float kp, float kd, float torque, uint8_t data[8]) {
+    rs_pack_mit(&rs04_limits, pos, vel, kp, kd, torque, data);
+}
+
+static inline void rs04_decode_mit_feedback(const uint8_t data[8], rs_feedback_t *fb) {
+    rs_decode_mit_feedback(&rs04_limits, data, fb);
+}
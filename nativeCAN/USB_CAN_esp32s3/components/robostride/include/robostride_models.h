@@ -0,0 +1,56 @@
+// Generated by nativeCAN/USB_CAN_esp32s3/components/robostride/gen_models.py from docs/device_can/robostride/*/metadata.yaml. Do not edit.
+#pragma once
+
+typedef enum {
+    RS_MODEL_RS02,
+    RS_MODEL_RS03,
+    RS_MODEL_RS04,
+    RS_MODEL_COUNT,
+} rs_model_t;
+
+#define RS02_LIMITS { RS_RANGE(-12.57f, 12.57f), RS_RANGE(-44.0f, 44.0f), RS_RANGE(-17.0f, 17.0f), RS_RANGE(0.0f, 500.0f), RS_RANGE(0.0f, 5.0f), 0.1f }
+#define RS03_LIMITS { RS_RANGE(-12.57f, 12.57f), RS_RANGE(-20.0f, 20.0f), RS_RANGE(-60.0f, 60.0f), RS_RANGE(0.0f, 5000.0f), RS_RANGE(0.0f, 100.0f), 0.1f }
+#define RS04_LIMITS { RS_RANGE(-12.57f, 12.57f), RS_RANGE(-15.0f, 15.0f), RS_RANGE(-120.0f, 120.0f), RS_RANGE(0.0f, 5000.0f), RS_RANGE(0.0f, 100.0f), 0.1f }
+
+#define RS_MODEL_LIMITS { \
+    [RS_MODEL_RS02] = RS02_LIMITS, \
+    [RS_MODEL_RS03] = RS03_LIMITS, \
+    [RS_MODEL_RS04] = RS04_LIMITS, \
+}
+
+// Private protocol communication types (bits 24..28 of the extended ID)
+#define RS_TYPE_GET_DEVICE_ID 0
+#define RS_TYPE_MOTION_CONTROL 1
+#define RS_TYPE_FEEDBACK 2
+#define RS_TYPE_ENABLE 3
+#define RS_TYPE_STOP 4
+#define RS_TYPE_SET_MECHANICAL_ZERO 6
+#define RS_TYPE_SET_CAN_ID 7
+#define RS_TYPE_READ_PARAMETER 17
+#define RS_TYPE_WRITE_PARAMETER 18
+#define RS_TYPE_FAULT_FEEDBACK 21
+#define RS_TYPE_SAVE_PARAMETERS 22
+#define RS_TYPE_SET_BAUD_RATE 23
+#define RS_TYPE_ENABLE_ACTIVE_REPORTING 24
+#define RS_TYPE_SET_PROTOCOL 25
+
+// MIT protocol commands
+#define RS_MIT_ENABLE_MOTOR 1
+#define RS_MIT_STOP_MOTOR 2
+#define RS_MIT_MOTION_CONTROL_DYNAMIC 3
+#define RS_MIT_SET_ZERO_NON_POSITION 4
+#define RS_MIT_CLEAR_ERRORS 5
+#define RS_MIT_SET_OPERATION_MODE 6
+#define RS_MIT_MODIFY_MOTOR_CAN_ID 7
+#define RS_MIT_CHANGE_PROTOCOL 8
+#define RS_MIT_MODIFY_HOST_CAN_ID 9
+#define RS_MIT_POSITION_CONTROL 10
+#define RS_MIT_VELOCITY_CONTROL 11
+
+// Fault bits of parameter 0x3022
+#define RS_FAULT_MOTOR_OVER_TEMPERATURE (1u << 0)
+#define RS_FAULT_DRIVER_CHIP_FAULT (1u << 1)
+#define RS_FAULT_UNDER_VOLTAGE (1u << 2)
+#define RS_FAULT_OVER_VOLTAGE (1u << 3)
+#define RS_FAULT_ENCODER_NOT_CALIBRATED (1u << 7)
+#define RS_FAULT_IQ_OVERLOAD (1u << 14)
@@ -1,12 +1,226 @@
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
 #define GS_USB_BREQ_HOST_FORMAT 0
 #define GS_USB_BREQ_BITTIMING 1
 #define GS_USB_BREQ_MODE 2
 #define GS_USB_BREQ_BT_CONST 4
 #define GS_USB_BREQ_DEVICE_CONFIG 5
+#define GS_USB_BREQ_TIMESTAMP 6
+#define GS_USB_BREQ_DATA_BITTIMING 10
+#define GS_USB_BREQ_BT_CONST_EXT 11
+#define GS_USB_BREQ_GET_STATE 14
 #define GS_CAN_MODE_RESET 0
 #define GS_CAN_MODE_START 1
+
+// gs_device_bt_const.feature / gs_device_mode.flags
+#define GS_CAN_FEATURE_LISTEN_ONLY (1u << 0)
+#define GS_CAN_FEATURE_LOOP_BACK (1u << 1)
+#define GS_CAN_FEATURE_TRIPLE_SAMPLE (1u << 2)
+#define GS_CAN_FEATURE_ONE_SHOT (1u << 3)
+#define GS_CAN_FEATURE_HW_TIMESTAMP (1u << 4)
+#define GS_CAN_FEATURE_FD (1u << 8)
+#define GS_CAN_FEATURE_BT_CONST_EXT (1u << 10) // data phase limits in gs_device_bt_const_extended
+#define GS_CAN_FEATURE_BERR_REPORTING (1u << 12)
+#define GS_CAN_FEATURE_GET_STATE (1u << 13)
+#define GS_CAN_MODE_LISTEN_ONLY (1u << 0)
+#define GS_CAN_MODE_LOOP_BACK (1u << 1)
+#define GS_CAN_MODE_TRIPLE_SAMPLE (1u << 2)
+#define GS_CAN_MODE_ONE_SHOT (1u << 3)
+#define GS_CAN_MODE_HW_TIMESTAMP (1u << 4)
+#define GS_CAN_MODE_FD (1u << 8)
+#define GS_CAN_MODE_BERR_REPORTING (1u << 12)
+
+// gs_host_frame.flags
+#define GS_CAN_FLAG_OVERFLOW (1u << 0)
+#define GS_CAN_FLAG_FD (1u << 1) // gs_host_frame_canfd layout, can_dlc is a CAN FD DLC code
+#define GS_CAN_FLAG_BRS (1u << 2)
+#define GS_CAN_FLAG_ESI (1u << 3)
+
+// gs_device_state.state
+#define GS_CAN_STATE_ERROR_ACTIVE 0
+#define GS_CAN_STATE_ERROR_WARNING 1
+#define GS_CAN_STATE_ERROR_PASSIVE 2
+#define GS_CAN_STATE_BUS_OFF 3
+#define GS_CAN_STATE_STOPPED 4
+
+// SocketCAN error frame encoding (linux/can/error.h), sent as RX frames with echo_id 0xFFFFFFFF
+#define CAN_ERR_FLAG 0x20000000U
+#define CAN_ERR_DLC 8
+#define CAN_ERR_LOSTARB 0x00000002U
+#define CAN_ERR_CRTL 0x00000004U
+#define CAN_ERR_PROT 0x00000008U
+#define CAN_ERR_BUSOFF 0x00000040U
+#define CAN_ERR_BUSERROR 0x00000080U
+#define CAN_ERR_RESTARTED 0x00000100U
+#define CAN_ERR_CNT 0x00000200U
+// data[1]
+#define CAN_ERR_CRTL_RX_OVERFLOW 0x01
+#define CAN_ERR_CRTL_RX_WARNING 0x04
+#define CAN_ERR_CRTL_TX_WARNING 0x08
+#define CAN_ERR_CRTL_RX_PASSIVE 0x10
+#define CAN_ERR_CRTL_TX_PASSIVE 0x20
+#define CAN_ERR_CRTL_ACTIVE 0x40
+
+// Triton vendor extensions (outside the range used by the Linux gs_usb driver)
+#define GS_USB_BREQ_TRITON_USB_BATCH 0x40
+// gs_triton_usb_batch.flags. ADAPTIVE: max_frames is a ceiling and flush_us the longest hold. The
+// device sizes each batch from the arrival rate and flushes at once while traffic is sparse
+#define GS_TRITON_USB_BATCH_ADAPTIVE (1u << 0)
+#define GS_USB_BREQ_TRITON_FILTER 0x41
+#define GS_USB_BREQ_TRITON_STATS 0x42
+#define GS_TRITON_STATS_VERSION 11
+#define GS_USB_BREQ_TRITON_RX_POLICY 0x43
+// gs_triton_rx_policy.policy: what to give up when the host stops reading
+#define GS_TRITON_RX_DROP_NEWEST 0
+#define GS_TRITON_RX_DROP_OLDEST 1
+#define GS_TRITON_RX_LATEST_PER_ID 2
+#define GS_TRITON_SW_FILTERS 8
+#define GS_USB_BREQ_TRITON_CYCLIC 0x44
+#define GS_TRITON_CYCLIC_SLOTS 16
+#define GS_TRITON_CYCLIC_MIN_PERIOD_US 100
+// gs_triton_cyclic.flags
+#define GS_TRITON_CYCLIC_ENABLE (1u << 0)
+#define GS_TRITON_CYCLIC_DATA_ONLY (1u << 1) // replace can_dlc/frame_flags/data of a running slot, keep its schedule
+#define GS_USB_BREQ_TRITON_SERVO 0x45          // OUT gs_triton_servo_config, IN gs_triton_servo_state
+#define GS_USB_BREQ_TRITON_SERVO_SETPOINT 0x46 // OUT gs_triton_servo_setpoint
+#define GS_TRITON_SERVO_MOTORS 8
+#define GS_TRITON_SERVO_MIN_RATE_HZ 50
+#define GS_TRITON_SERVO_MAX_RATE_HZ 2000
+// gs_triton_servo_config.flags
+#define GS_TRITON_SERVO_ENABLE (1u << 0)
+#define GS_TRITON_SERVO_CONSUME_FEEDBACK (1u << 1) // keep the motors' type-2 frames off the RX stream
+// gs_triton_servo_state.motor[].status
+#define GS_TRITON_SERVO_FB_VALID (1u << 0)  // at least one feedback frame since the loop started
+#define GS_TRITON_SERVO_FB_STALE (1u << 1)  // none within timeout_ms
+#define GS_TRITON_SERVO_HOLDING (1u << 2)   // setpoint stream timed out: holding the last position
+// RobStride commands for many motors in one transfer: OUT gs_triton_motor_cmd. The device packs one
+// type-1 operation-control frame per entry and sends it once, right away, on the entry's channel.
+#define GS_USB_BREQ_TRITON_MOTOR_CMD 0x50
+#define GS_TRITON_MOTOR_CMD_MAX 32
+// gs_triton_motor_target fixed point: value = field / scale
+#define GS_TRITON_MOTOR_POS_SCALE 2048   // rad, +-16
+#define GS_TRITON_MOTOR_VEL_SCALE 512    // rad/s, +-64
+#define GS_TRITON_MOTOR_TORQUE_SCALE 256 // N·m, +-128
+#define GS_TRITON_MOTOR_KP_SCALE 8       // 0..8191
+#define GS_TRITON_MOTOR_KD_SCALE 512     // 0..128
+// Echo endpoint (CONFIG_TRITON_ECHO_EP): OUT gs_triton_echo_ep moves everything from echo_queue (TX
+// echoes, batch acks, error frames) off 0x81 onto the bulk IN endpoint of a second vendor interface,
+// in the same wire format. Set while every channel is stopped; every enumeration reverts to 0x81,
+// the only endpoint gs_usb reads.
+#define GS_USB_BREQ_TRITON_ECHO_EP 0x51
+// Per-frame pipeline trace (CONFIG_TRITON_TRACE): OUT gs_triton_trace_config samples one frame in
+// every (0 stops) and clears the event ring; IN gs_triton_trace takes the oldest unread events
+#define GS_USB_BREQ_TRITON_TRACE 0x52
+#define GS_TRITON_TRACE_READ 60
+// gs_triton_trace_event.stage: time_us is the stage, frame_us the frame's timestamp_us unless noted
+#define GS_TRITON_TRACE_RX_RING 0 // in the channel ring: time_us - frame_us is the RX ISR or task
+#define GS_TRITON_TRACE_RX_FIFO 1 // written to the USB IN FIFO
+#define GS_TRITON_TRACE_USB_IN 2  // IN transfer that follows complete; frame_us: its flush, channel 0xFF
+#define GS_TRITON_TRACE_TX_DONE 3 // host frame sent; frame_us: handed to the controller
+#define GS_TRITON_TRACE_TX_ECHO 4 // its echo in the IN FIFO; frame_us: TX done, the echo's timestamp
+// Frame trace (CONFIG_TRITON_FRAME_TRACE): a record of every frame at the stages chosen, for
+// frame-level debugging at full rate. OUT gs_triton_ftrace_config sets the stages per channel (0
+// stops) and clears the record ring; IN gs_triton_ftrace takes the oldest unread records, as many
+// as wLength has room for
+#define GS_USB_BREQ_TRITON_FRAME_TRACE 0x54
+#define GS_TRITON_FTRACE_READ 240
+// gs_triton_ftrace_record.stage; gs_triton_ftrace_config.stages takes a bit per stage
+#define GS_TRITON_FTRACE_RX 0        // into the channel ring; time_us: RX timestamp, status 1: ring full, dropped
+#define GS_TRITON_FTRACE_TX_SUBMIT 1 // handed to the controller; time_us: taken from the host, status: esp_err_t
+#define GS_TRITON_FTRACE_TX_DONE 2   // sent or failed (flags GS_CAN_FLAG_TRITON_TX_*); time_us: completion
+// What this build supports, for hosts to pick their fast paths without checking firmware versions:
+// IN gs_triton_caps. Firmware older than the request stalls it and speaks gs_usb only.
+#define GS_USB_BREQ_TRITON_CAPS 0x53
+#define GS_TRITON_CAPS_VERSION 1
+// gs_triton_caps.features: the request is served (or the option built in)
+#define GS_TRITON_CAP_USB_BATCH (1u << 0)
+#define GS_TRITON_CAP_USB_BATCH_ADAPTIVE (1u << 1)
+#define GS_TRITON_CAP_PACKED (1u << 2)
+#define GS_TRITON_CAP_ECHO_EP (1u << 3)        // CONFIG_TRITON_ECHO_EP
+#define GS_TRITON_CAP_CLOCK (1u << 4)
+#define GS_TRITON_CAP_TX_DEADLINE (1u << 5)    // also the per-frame deadline of packed TX records
+#define GS_TRITON_CAP_FILTER (1u << 6)
+#define GS_TRITON_CAP_RX_POLICY (1u << 7)
+#define GS_TRITON_CAP_DECIMATE (1u << 8)
+#define GS_TRITON_CAP_MAILBOX (1u << 9)
+#define GS_TRITON_CAP_CYCLIC (1u << 10)
+#define GS_TRITON_CAP_GATEWAY (1u << 11)
+#define GS_TRITON_CAP_SERVO (1u << 12)
+#define GS_TRITON_CAP_MOTOR_CMD (1u << 13)
+#define GS_TRITON_CAP_SELFTEST (1u << 14)
+#define GS_TRITON_CAP_AUTOSTART (1u << 15)
+#define GS_TRITON_CAP_TASKS (1u << 16)
+#define GS_TRITON_CAP_TRACE (1u << 17)           // CONFIG_TRITON_TRACE
+#define GS_TRITON_CAP_STAGE_PROFILING (1u << 18) // CONFIG_TRITON_STAGE_PROFILING: the v4 histograms are filled
+#define GS_TRITON_CAP_RX_SPILL (1u << 19)        // CONFIG_TRITON_RX_SPILL_FRAMES
+#define GS_TRITON_CAP_LOG_CDC (1u << 20)         // CONFIG_TRITON_LOG_CDC
+#define GS_TRITON_CAP_SPI_LINK (1u << 21)        // CONFIG_TRITON_SPI_LINK: packed only, no USB endpoints
+#define GS_TRITON_CAP_USB_REATTACH (1u << 22)    // channels keep running across a USB re-enumeration
+#define GS_TRITON_CAP_FRAME_TRACE (1u << 23)     // CONFIG_TRITON_FRAME_TRACE
+// Packed wire format for userspace hosts (libtritoncan). Set while every channel is stopped; the
+// bulk endpoints then carry gs_triton_packed_block / _tx_block streams instead of gs_host_frame.
+#define GS_USB_BREQ_TRITON_PACKED 0x47
+#define GS_TRITON_PACKED_MAGIC 0x5443 // "CT" on the wire
+#define GS_TRITON_PACKED_BLOCK_MAX 1024
+// gs_triton_packed_record.chan_type: channel in bits 0..3, record type in bits 4..7
+#define GS_TRITON_REC_FRAME 0  // RX frame (error frames carry CAN_ERR_FLAG in can_id), or host TX
+#define GS_TRITON_REC_TX_ACK 1 // device -> host: can_id = batch_id, data = gs_triton_packed_ack
+// SPI host link (CONFIG_TRITON_SPI_LINK), in place of USB. The host is SPI master and clocks
+// full-duplex transactions of the build's block size. Each starts with gs_triton_spi_hdr in both
+// directions, then ctrl_len bytes of control, then data_len bytes of packed stream: blocks of
+// gs_triton_packed_block to the host, gs_triton_packed_tx_block to the device. crc is CRC-32 (zlib)
+// of the header, crc itself as 0, and all that follows up to the end of the data; a transaction
+// that fails it is ignored whole.
+#define GS_TRITON_SPI_MAGIC_HOST 0x5348 // "HS" on the wire
+#define GS_TRITON_SPI_MAGIC_DEV 0x5344  // "DS"
+#define GS_TRITON_SPI_VERSION 1
+#define GS_TRITON_SPI_MORE (1u << 0) // device: frames left over for the next transaction
+// Loopback self-test: OUT gs_triton_selftest_config arms it, IN reads gs_triton_selftest_result.
+// The armed test takes effect on the next GS_CAN_MODE_START of channel 0.
+#define GS_USB_BREQ_TRITON_SELFTEST 0x48
+#define GS_TRITON_SELFTEST_MAX_RATE 100000
+// gs_triton_selftest_config.flags / gs_triton_selftest_result.flags
+#define GS_TRITON_SELFTEST_ENABLE (1u << 0)
+#define GS_TRITON_SELFTEST_RUNNING (1u << 1) // result only: can0 is running in TWAI_MODE_NO_ACK
+// Boot-time autostart, per channel (wValue): OUT gs_triton_autostart stores the bit timing in NVS,
+// IN reads it back. A stored channel starts at power-up without waiting for the host and holds its
+// frames until the host's first GS_CAN_MODE_START. brp = 0 on OUT stores the channel's current
+// GS_USB_BREQ_BITTIMING.
+#define GS_USB_BREQ_TRITON_AUTOSTART 0x49
+// gs_triton_autostart.flags
+#define GS_TRITON_AUTOSTART_ENABLE (1u << 0)
+#define GS_TRITON_AUTOSTART_ACTIVE (1u << 1) // IN only: running on the stored timing, no host start yet
+#define GS_USB_BREQ_TRITON_DECIMATE 0x4A // per channel (wValue): OUT/IN gs_triton_decimate
+#define GS_TRITON_DECIMATE_RULES 16
+// gs_triton_decimate_rule.mode, applied per CAN ID: the first frame of an ID always passes
+#define GS_TRITON_DECIMATE_EVERY_N 0   // param: forward one frame in param
+#define GS_TRITON_DECIMATE_INTERVAL 1  // param: at most one frame per param us
+#define GS_TRITON_DECIMATE_ON_CHANGE 2 // forward only when DLC or payload differ from the last forwarded
+#define GS_USB_BREQ_TRITON_CLOCK 0x4B // IN gs_triton_clock: the host times the request for offset/drift
+#define GS_USB_BREQ_TRITON_GATEWAY 0x4C // OUT gs_triton_gateway_rule, IN with wValue = slot
+#define GS_USB_BREQ_TRITON_TX_DEADLINE 0x4D // per channel (wValue): OUT/IN gs_triton_tx_deadline
+#define GS_TRITON_TX_DEADLINE_RULES 16
+#define GS_USB_BREQ_TRITON_TASKS 0x4E // IN gs_triton_tasks: FreeRTOS run time and stack of every task
+#define GS_TRITON_TASKS_MAX 32
+#define GS_TRITON_TASK_ANY_CORE 0xFF
+// Latest frame per CAN ID, per channel (wValue): OUT gs_triton_mailbox_config sets the IDs, IN reads
+// gs_triton_mailbox, the newest frame of every one of them, in one transfer
+#define GS_USB_BREQ_TRITON_MAILBOX 0x4F
+#define GS_TRITON_MAILBOX_IDS 32
+// gs_triton_mailbox_config.flags
+#define GS_TRITON_MAILBOX_CONSUME (1u << 0) // mailbox IDs are not streamed to the host
+#define GS_TRITON_GATEWAY_RULES 16
+// gs_triton_gateway_rule.flags
+#define GS_TRITON_GATEWAY_ENABLE (1u << 0)
+#define GS_TRITON_GATEWAY_CONSUME (1u << 1) // routed frames are not delivered to the host
+// Latency histograms: bucket i counts values in [2^i, 2^(i+1)) us, bucket 0 also 0 us and the
+// last bucket everything from 2^15 us up
+#define GS_TRITON_HIST_BUCKETS 16
+// Echo flag: the frame was not sent (bus-off, driver stopped). The kernel driver ignores it.
+#define GS_CAN_FLAG_TRITON_TX_FAILED (1u << 7)
+// Echo flag, with TX_FAILED: the frame passed its deadline before it reached the controller
+#define GS_CAN_FLAG_TRITON_TX_EXPIRED (1u << 6)
 #pragma pack(push, 1)
 struct gs_host_config { uint32_t byte_order; };
 struct gs_device_config { 
@@ -27,9 +241,330 @@ struct gs_device_bt_const {
     uint32_t sjw_max; 
     uint32_t brp_min; uint32_t brp_max; uint32_t brp_inc; 
 };
+// Same leading fields as gs_device_bt_const, so BT_CONST can be served from it
+struct gs_device_bt_const_extended {
+    uint32_t feature;
+    uint32_t fclk_can;
+    uint32_t tseg1_min; uint32_t tseg1_max;
+    uint32_t tseg2_min; uint32_t tseg2_max;
+    uint32_t sjw_max;
+    uint32_t brp_min; uint32_t brp_max; uint32_t brp_inc;
+    uint32_t dtseg1_min; uint32_t dtseg1_max;
+    uint32_t dtseg2_min; uint32_t dtseg2_max;
+    uint32_t dsjw_max;
+    uint32_t dbrp_min; uint32_t dbrp_max; uint32_t dbrp_inc;
+};
 struct gs_device_mode { uint32_t mode; uint32_t flags; };
+struct gs_device_state { uint32_t state; uint32_t rxerr; uint32_t txerr; };
+// max_frames <= 1 keeps one frame per bulk transfer (what the kernel driver expects). flags is
+// optional: a host that writes only the first 8 bytes gets fixed batches
+struct gs_triton_usb_batch { uint32_t max_frames; uint32_t flush_us; uint32_t flags; };
+struct gs_triton_rx_policy { uint32_t policy; };
+// hw_*: raw TWAI acceptance registers (see twai_filter_config_t), applied on the next GS_CAN_MODE_START.
+// Ignored on MCP2518FD channels, which accept everything in hardware.
+// sw: can_id/mask pairs in gs_host_frame.can_id format (bit 31 = extended), checked per RX frame.
+// sw_count = 0 accepts every frame that passed the hardware filter.
+struct gs_triton_filter {
+    uint32_t hw_code; uint32_t hw_mask; uint32_t hw_single;
+    uint32_t sw_count;
+    struct { uint32_t can_id; uint32_t mask; } sw[GS_TRITON_SW_FILTERS];
+};
+// One periodic TX table entry. The frame goes out on channel every period_us, at device times
+// t with t % period_us == phase_us (the GS_USB_BREQ_TIMESTAMP clock, extended to 64 bits), so
+// entries with the same period keep a fixed offset. OUT writes slot, IN with wValue = slot reads it.
+struct gs_triton_cyclic {
+    uint32_t slot; uint32_t flags; uint32_t period_us; uint32_t phase_us;
+    uint32_t can_id; uint8_t can_dlc; uint8_t channel; uint8_t frame_flags; uint8_t reserved; // GS_CAN_FLAG_FD/BRS
+    uint8_t data[64];
+};
+// RS02 servo loop: the device sends a type-1 operation-control frame to every motor at rate_hz
+// and interpolates between the setpoints the host streams (nominally every setpoint_period_us).
+struct gs_triton_servo_config {
+    uint32_t flags; uint8_t channel; uint8_t host_id; uint8_t motor_count; uint8_t reserved;
+    uint32_t rate_hz; uint32_t setpoint_period_us; uint32_t timeout_ms;
+    uint8_t motor_id[GS_TRITON_SERVO_MOTORS];
+};
+struct gs_triton_servo_target { float pos; float vel; float torque; float kp; float kd; }; // rad, rad/s, N·m
+struct gs_triton_servo_setpoint {
+    uint32_t seq;
+    struct gs_triton_servo_target motor[GS_TRITON_SERVO_MOTORS]; // only the first motor_count are read
+};
+// model is an rs_model_t (0 RS02, 1 RS03, 2 RS04): its limits scale, and clamp, the values
+struct gs_triton_motor_target {
+    uint8_t channel; uint8_t motor_id; uint8_t model; uint8_t reserved;
+    int16_t pos; int16_t vel; int16_t torque; uint16_t kp; uint16_t kd;
+};
+struct gs_triton_motor_cmd {
+    uint32_t motor_count;
+    struct gs_triton_motor_target motor[GS_TRITON_MOTOR_CMD_MAX]; // only the first motor_count are read
+};
+struct gs_triton_servo_state {
+    uint32_t seq;          // last setpoint taken by the loop
+    uint32_t timestamp_us; // device clock at snapshot
+    // commands: frames sent by the loop and by GS_USB_BREQ_TRITON_MOTOR_CMD
+    uint32_t commands; uint32_t commands_failed; uint32_t feedback_frames; uint32_t setpoint_timeouts;
+    struct {
+        float pos; float vel; float torque; float temp; // decoded type-2 feedback
+        uint8_t status; uint8_t fault; uint8_t mode; uint8_t reserved; // GS_TRITON_SERVO_FB_*, RS02 fault bits/mode
+        uint32_t age_us;   // since that feedback frame
+    } motor[GS_TRITON_SERVO_MOTORS];
+};
+struct gs_triton_packed { uint32_t enable; };
+struct gs_triton_echo_ep { uint32_t enable; uint32_t endpoint; }; // endpoint: its address, 0 when not built in
+struct gs_triton_trace_config { uint32_t every; };
+struct gs_triton_trace_event {
+    uint32_t time_us; uint32_t frame_us; uint32_t can_id; // can_id in gs_host_frame format
+    uint8_t channel; uint8_t stage; uint16_t seq;          // seq: event number, low 16 bits
+};
+struct gs_triton_trace {
+    uint32_t time_us; // device clock at the read
+    uint32_t count;   // events that follow; the transfer is cut after them
+    uint32_t lost;    // overwritten before a read took them, since the trace started
+    uint32_t every;
+    struct gs_triton_trace_event event[GS_TRITON_TRACE_READ];
+};
+struct gs_triton_ftrace_config {
+    uint32_t stages;   // bit (1 << GS_TRITON_FTRACE_*) per stage recorded, 0 stops
+    uint32_t channels; // bit per channel traced
+};
+struct gs_triton_ftrace_record {
+    uint32_t time_us; uint32_t can_id;                      // can_id in gs_host_frame format
+    uint8_t channel; uint8_t stage; uint8_t flags; uint8_t dlc; // flags: gs_host_frame flags
+    uint16_t seq; uint16_t status;                          // seq: record number, low 16 bits
+};
+struct gs_triton_ftrace {
+    uint32_t time_us; // device clock at the read
+    uint32_t count;   // records that follow; the transfer is cut after them
+    uint32_t lost;    // overwritten before a read took them, since the trace started
+    uint32_t stages;
+    struct gs_triton_ftrace_record record[GS_TRITON_FTRACE_READ];
+};
+// Appended to only, with version bumped; size is the number of bytes the device filled in. Sizes are
+// in bytes, the rest counts.
+struct gs_triton_caps {
+    uint32_t version; uint32_t size; uint32_t features; // GS_TRITON_CAP_*
+    uint32_t channels; uint32_t fd_channels;            // fd_channels: a bit per channel with GS_CAN_FEATURE_FD
+    uint32_t usb_in_fifo; uint32_t usb_out_fifo; uint32_t usb_ep_size; // usb_ep_size: bytes per usbd transfer
+    uint32_t usb_batch_max_frames; uint32_t packed_block_max; uint32_t spi_block; // spi_block: 0 without the SPI link
+    uint32_t rx_ring_len; uint32_t rx_spill_frames; uint32_t tx_queue_len; // per channel, tx_queue_len on channel 0
+    uint32_t sw_filters; uint32_t cyclic_slots; uint32_t decimate_rules; uint32_t gateway_rules;
+    uint32_t tx_deadline_rules; uint32_t mailbox_ids; uint32_t servo_motors; uint32_t motor_cmd_max;
+    uint32_t stats_version;
+};
+// Device -> host: a block header then variable-length records, length bytes in total. Record time is
+// timestamp_us + delta_us; a record that would not fit the signed 16-bit delta starts a new block.
+struct gs_triton_packed_block { uint16_t magic; uint16_t length; uint32_t timestamp_us; };
+struct gs_triton_packed_record {
+    uint8_t len; uint8_t flags; uint8_t chan_type; int16_t delta_us; // len: payload bytes (0..64), flags: GS_CAN_FLAG_*
+    uint32_t can_id;                                                  // gs_host_frame format
+    // followed by len payload bytes
+};
+// Host -> device: count GS_TRITON_REC_FRAME records, answered by a single GS_TRITON_REC_TX_ACK once
+// every frame of the batch has been sent or failed. delta_us, read unsigned, is the frame's deadline:
+// it expires that many us after reaching the device (0: the channel's gs_triton_tx_deadline rules).
+struct gs_triton_packed_tx_block { uint16_t magic; uint16_t count; uint32_t batch_id; };
+struct gs_triton_packed_ack { uint16_t sent; uint16_t failed; };
+// seq: numbers the host's stream payloads; the device takes them in order only and sets ack to the
+// next one it expects, so the host resends from there. credit: stream bytes the device can take
+// after that payload. The device's own seq counts its transactions.
+struct gs_triton_spi_hdr {
+    uint16_t magic; uint8_t version; uint8_t seq;
+    uint8_t ack; uint8_t flags;            // ack, credit, block: device only; flags: GS_TRITON_SPI_*
+    uint16_t ctrl_len; uint16_t data_len;
+    uint16_t credit; uint16_t block;       // block: transaction size of the build
+    uint16_t reserved; uint32_t crc;
+};
+// Host: one control request per transaction, the fields of a USB SETUP packet, then wLength bytes
+// for OUT. The reply comes in a later transaction, with IN data after it. A request that reuses the
+// last tag is a resend: it is answered again, not run twice.
+struct gs_triton_spi_ctrl {
+    uint8_t bmRequestType; uint8_t bRequest; uint8_t tag; uint8_t reserved;
+    uint16_t wValue; uint16_t wLength;
+};
+struct gs_triton_spi_reply {
+    uint8_t bRequest; uint8_t tag; uint8_t status; uint8_t reserved; // status 0: done, 1: stalled
+    uint16_t length; uint16_t reserved2;
+};
+// Generated traffic: IDs can_id .. can_id + id_count - 1 in turn (bit 31 = extended), a pseudo-random
+// DLC in dlc_min..dlc_max, the sequence number in the first data bytes. rate_pps = 0 runs no generator:
+// host frames are still looped back.
+struct gs_triton_selftest_config {
+    uint32_t flags; uint32_t rate_pps;
+    uint32_t can_id; uint32_t id_count;
+    uint8_t dlc_min; uint8_t dlc_max; uint8_t reserved[2];
+};
+// Rules are {can_id, mask} in gs_host_frame.can_id format, as in gs_triton_filter; the first match decides
+struct gs_triton_decimate_rule { uint32_t can_id; uint32_t mask; uint32_t mode; uint32_t param; };
+struct gs_triton_decimate {
+    uint32_t rule_count;
+    struct gs_triton_decimate_rule rule[GS_TRITON_DECIMATE_RULES];
+};
+// Host frames whose ID matches a rule ({can_id, mask} as in gs_triton_filter, the first match decides)
+// expire max_age_us after they reach the device (max_age_us = 0: never) and are failed with
+// GS_CAN_FLAG_TRITON_TX_EXPIRED instead of being handed to the controller. inflight_max > 0 caps the
+// frames queued in the controller, so that a backlog waits in the device's OUT buffer, where it expires.
+struct gs_triton_tx_deadline_rule { uint32_t can_id; uint32_t mask; uint32_t max_age_us; };
+struct gs_triton_tx_deadline {
+    uint32_t rule_count; uint32_t inflight_max;
+    struct gs_triton_tx_deadline_rule rule[GS_TRITON_TX_DEADLINE_RULES];
+};
+// IDs are exact, in gs_host_frame.can_id format (EFF/RTR flags included). Writing the set empties every
+// slot. A frame counts whatever the RX filter and decimation do with it.
+struct gs_triton_mailbox_config {
+    uint32_t id_count; uint32_t flags;
+    uint32_t can_id[GS_TRITON_MAILBOX_IDS];
+};
+struct gs_triton_mailbox_slot {
+    uint32_t can_id;
+    uint32_t count;        // frames received since the set was written; 0: no frame yet, the rest is 0
+    uint32_t timestamp_us; // of the frame, as gs_host_frame.timestamp_us
+    uint8_t can_dlc; uint8_t flags; uint8_t reserved[2]; // flags: GS_CAN_FLAG_FD / BRS / ESI
+    uint8_t data[8];       // CAN FD: the first 8 bytes
+};
+struct gs_triton_mailbox {
+    uint32_t time_us;      // esp_timer when the snapshot was taken
+    uint32_t id_count; uint32_t flags;
+    struct gs_triton_mailbox_slot slot[GS_TRITON_MAILBOX_IDS];
+};
+// Device-wide CPU use. Counters are cumulative and wrap, so the host takes differences between two
+// reads: a task's runtime_us over the time_us elapsed is its share of one core. runtime_us includes
+// the interrupts taken while the task ran; isr_cycles are those of channel 0's TWAI callbacks, on the
+// CAN core. task_count is 0 without CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS.
+struct gs_triton_task {
+    char name[16];        // NUL-terminated
+    uint32_t runtime_us;
+    uint32_t stack_free;  // bytes of stack never touched so far
+    uint8_t core;         // 0, 1 or GS_TRITON_TASK_ANY_CORE
+    uint8_t priority;     // current
+    uint8_t state;        // eTaskState: 0 running, 1 ready, 2 blocked, 3 suspended
+    uint8_t reserved;
+};
+struct gs_triton_tasks {
+    uint32_t time_us;     // esp_timer at the snapshot, the clock of runtime_us
+    uint32_t task_count;
+    uint32_t isr_cycles; uint32_t isr_count;
+    uint32_t cpu_mhz;     // CPU cycles per us
+    struct gs_triton_task task[GS_TRITON_TASKS_MAX];
+    // Memory, bytes: .data + .bss of the image, and the free internal heap at the end of boot, now
+    // and at its lowest ever. heap_free below heap_boot_free: something allocated after boot.
+    uint32_t static_dram; uint32_t heap_boot_free; uint32_t heap_free; uint32_t heap_min_free;
+};
+// Full 64-bit esp_timer, sampled when the SETUP packet is handled; frame timestamps are its low 32 bits
+struct gs_triton_clock { uint64_t time_us; };
+// Frames on src_channel matching can_id/mask (gs_host_frame.can_id format) are sent on dst_channel as
+// (id & ~rewrite_mask) | (rewrite_id & rewrite_mask). Several rules may route the same frame.
+struct gs_triton_gateway_rule {
+    uint32_t slot; uint32_t flags;
+    uint8_t src_channel; uint8_t dst_channel; uint8_t reserved[2];
+    uint32_t can_id; uint32_t mask;
+    uint32_t rewrite_id; uint32_t rewrite_mask;
+    // IN only, since the rule was written. dropped: dst stopped, TX full or classic-only; failed: on the bus
+    uint32_t matched; uint32_t sent; uint32_t dropped; uint32_t failed;
+};
+// Classic CAN only: an FD channel comes up at its nominal rate and the host restarts it with GS_CAN_MODE_FD
+struct gs_triton_autostart {
+    uint32_t flags;
+    struct gs_device_bittiming bt;
+};
+// Everything covers the run since the last start of can0 with the test armed
+struct gs_triton_selftest_result {
+    uint32_t flags; uint32_t elapsed_ms;
+    uint32_t tx_pps; uint32_t rx_pps;   // generated / received, averaged over the run
+    uint32_t generated;                 // handed to the controller
+    uint32_t tx_failed;                 // not sent (bus error, bus-off)
+    uint32_t tx_skipped;                // behind the requested rate: the TX path was full
+    uint32_t received;                  // generated frames that came back by self-reception
+    uint32_t lost;                      // generated frames that never came back
+    uint32_t rx_min_us; uint32_t rx_avg_us; uint32_t rx_max_us;    // submit -> self-RX in can_rx_task
+    uint32_t usb_min_us; uint32_t usb_avg_us; uint32_t usb_max_us; // submit -> USB IN FIFO
+    uint32_t usb_frames;
+    uint32_t rx_hist[GS_TRITON_HIST_BUCKETS];
+    uint32_t usb_hist[GS_TRITON_HIST_BUCKETS];
+};
 struct gs_host_frame { 
     uint32_t echo_id; uint32_t can_id; uint8_t can_dlc; 
     uint8_t channel; uint8_t flags; uint8_t reserved; uint8_t data[8]; 
+    uint32_t timestamp_us; // only on the wire (device -> host) with GS_CAN_MODE_HW_TIMESTAMP
+};
+// Frames with GS_CAN_FLAG_FD. Host -> device frames use this size on channels started with GS_CAN_MODE_FD.
+struct gs_host_frame_canfd {
+    uint32_t echo_id; uint32_t can_id; uint8_t can_dlc;
+    uint8_t channel; uint8_t flags; uint8_t reserved; uint8_t data[64];
+    uint32_t timestamp_us;
+};
+// Counters are cumulative since boot (take deltas on the host). latency_* cover the window since
+// the previous GS_USB_BREQ_TRITON_STATS read and restart on each read. New fields are appended
+// only, with version bumped; size is the number of bytes the device filled in.
+struct gs_triton_stats {
+    uint32_t version; uint32_t size; uint32_t uptime_ms;
+    uint32_t rx_frames; uint32_t rx_filtered; uint32_t rx_dropped; // dropped: rx ring full
+    uint32_t tx_frames; uint32_t tx_failed;
+    uint32_t echo_dropped; uint32_t err_frames; uint32_t err_dropped; // echo_queue sends that failed
+    uint32_t rx_ring_hwm; uint32_t echo_queue_hwm; uint32_t tx_inflight_hwm;
+    uint32_t usb_transfers; uint32_t usb_write_stalls; // stalls: frames waiting, FIFO full
+    uint32_t bus_state; uint32_t tec; uint32_t rec;
+    uint32_t bus_errors; uint32_t bus_off_count; uint32_t arb_lost; uint32_t rx_missed; uint32_t rx_overrun;
+    uint32_t latency_min_us; uint32_t latency_avg_us; uint32_t latency_max_us; uint32_t latency_samples; // RX sample -> USB FIFO
+    // v2
+    uint32_t rx_evicted; // dropped from the ring by DROP_OLDEST / LATEST_PER_ID
+    // v3
+    uint32_t cyclic_frames; uint32_t cyclic_missed; // missed: period skipped (late, TX full) or send failed
+    uint32_t cyclic_late_max_us; // worst start delay behind schedule, restarted on each read
+    // v4: pipeline stage histograms (GS_TRITON_HIST_BUCKETS log2 buckets), cumulative. *_cycles are
+    // CPU cycles inside one task, the rest us on the esp_timer clock. All zero without
+    // CONFIG_TRITON_STAGE_PROFILING. hist_usb_in and hist_tx_wake are device-wide.
+    uint32_t hist_rx_wake[GS_TRITON_HIST_BUCKETS];    // INT edge -> RX task (MCP2518FD channels only)
+    uint32_t hist_rx_cycles[GS_TRITON_HIST_BUCKETS];  // RX task: frame read -> published in the ring
+    uint32_t hist_rx_dwell[GS_TRITON_HIST_BUCKETS];   // RX sample -> USB IN FIFO, as latency_*
+    uint32_t hist_usb_in[GS_TRITON_HIST_BUCKETS];     // FIFO flush -> IN transfer complete
+    uint32_t hist_tx_wake[GS_TRITON_HIST_BUCKETS];    // OUT data callback -> can_tx_task running
+    uint32_t hist_tx_cycles[GS_TRITON_HIST_BUCKETS];  // TX: host frame -> handed to the controller
+    uint32_t hist_tx_done[GS_TRITON_HIST_BUCKETS];    // handed to the controller -> TX complete
+    uint32_t hist_echo_dwell[GS_TRITON_HIST_BUCKETS]; // TX complete -> echo in the USB IN FIFO
+    // v5: channel starts (GS_CAN_MODE_START and autostart); fast: reconfigured without reinstalling a driver
+    uint32_t reconfig_count; uint32_t reconfig_fast;
+    uint32_t reconfig_last_us; uint32_t reconfig_max_us; // stop -> reconfigure -> started
+    // v6: GS_USB_BREQ_TRITON_DECIMATE. untracked: matched a rule but passed, the per-ID table was full
+    uint32_t rx_decimated; uint32_t decimate_untracked;
+    // v7: host frames failed past their deadline (GS_USB_BREQ_TRITON_TX_DEADLINE), also in tx_failed
+    uint32_t tx_expired;
+    // v8: can0's TX priority queue. queued: frames that waited in it, reordered: sent ahead of an
+    // older frame there, hwm: its deepest fill
+    uint32_t tx_prio_queued; uint32_t tx_reordered; uint32_t tx_prio_hwm;
+    // v9: the PSRAM RX tier (CONFIG_TRITON_RX_SPILL_FRAMES). spilled: frames moved there from the full
+    // ring, bursts: times it started filling from empty, hwm: its deepest fill. All zero without it
+    uint32_t rx_spilled; uint32_t rx_spill_bursts; uint32_t rx_spill_hwm;
+    // v10: USB IN batches (USB_BATCH mode, device-wide) by why they were flushed: full (max_frames,
+    // the adaptive target or the FIFO), deadline (flush_us), sparse (adaptive: traffic paused or
+    // too thin to batch) or busy (adaptive: an IN transfer was in flight and takes them next).
+    // batch_target and arrival_gap_us are the adaptive controller's current state
+    uint32_t usb_flush_full; uint32_t usb_flush_deadline; uint32_t usb_flush_sparse; uint32_t usb_flush_busy;
+    uint32_t usb_batch_target; uint32_t usb_arrival_gap_us;
+    // v11: USB re-enumeration with the channels left running. sessions_lost: unmounts and bus resets
+    // that ended a host session, suspends: USB suspends (the session stays), gap_*_ms: session end
+    // -> a channel taken over by the next host (all device-wide). resumed: takeovers of this channel
+    // without a restart, echo_stale: completions of frames sent for an earlier session, not echoed
+    uint32_t usb_sessions_lost; uint32_t usb_suspends; uint32_t usb_gap_last_ms; uint32_t usb_gap_max_ms;
+    uint32_t usb_resumed; uint32_t tx_echo_stale;
 };
 #pragma pack(pop)
+
+// Wire sizes: host -> device frames never carry a timestamp
+#define GS_HOST_FRAME_SIZE offsetof(struct gs_host_frame, timestamp_us)
+#define GS_HOST_FRAME_TS_SIZE sizeof(struct gs_host_frame)
+#define GS_HOST_FRAME_CANFD_SIZE offsetof(struct gs_host_frame_canfd, timestamp_us)
+#define GS_HOST_FRAME_CANFD_TS_SIZE sizeof(struct gs_host_frame_canfd)
+#define GS_HOST_FRAME_HDR_SIZE offsetof(struct gs_host_frame, data) // up to and including reserved
+
+// CAN FD DLC code to payload length (can_fd_dlc2len() in Linux)
+static inline uint8_t gs_can_fd_dlc2len(uint8_t dlc) {
+    static const uint8_t len[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+    return len[dlc & 0xF];
+}
+
+// Smallest DLC code whose length holds len bytes
+static inline uint8_t gs_can_fd_len2dlc(uint8_t len) {
+    uint8_t dlc = 0;
+    while (dlc < 15 && gs_can_fd_dlc2len(dlc) < len) dlc++;
+    return dlc;
+}
@@ -1,264 +1,3859 @@
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
-#include "driver/twai.h"
+#include "esp_twai.h"
+#include "esp_twai_onchip.h"
 #include "driver/gpio.h"
 #include "tusb.h"
 #include "gs_usb.h"
 #include "esp_private/usb_phy.h" 
 #include "esp_attr.h" 
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_cpu.h"
+#include "esp_ipc.h"
+#include "esp_clk_tree.h"
+#include "esp_mac.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "driver/spi_master.h"
+#include "driver/spi_slave.h"
+#include "freertos/stream_buffer.h"
+#include "hal/gpio_ll.h"
+#include "esp_rom_crc.h"
+#include "mcp251xfd.h"
+#include "robostride.h"
+#include "triton_core.h"
+#include "triton_twai.h"
 
-#define TX_PIN GPIO_NUM_4
-#define RX_PIN GPIO_NUM_5
 #define USB_VID 0x1D50 
 #define USB_PID 0x606F 
 
-// Set to 1 only for bench debugging. 0 for Production.
-#define DEBUG_ALL_FRAMES 0
+// Keep USB (tud_task, IN forwarding) on one core and the TWAI interrupts plus the CAN tasks
+// on the other, so USB work never delays RX. Set to 0 to let the scheduler float them. Each TWAI
+// controller's interrupt and event task can be moved off CAN_CORE in the menu (twai_cores).
+#define PIN_TASKS_TO_CORES 1
+#define USB_CORE 0
+#define CAN_CORE 1
+#if PIN_TASKS_TO_CORES
+#define CAN_TASK_CORE CAN_CORE
+#define USB_TASK_CORE USB_CORE
+#else
+#define CAN_TASK_CORE tskNO_AFFINITY
+#define USB_TASK_CORE tskNO_AFFINITY
+#endif
+
+// Queue depths, FIFO sizes and task settings below come from the Kconfig tuning menu (README 3.V).
+// The periodic tasks and tud_task preempt the CAN tasks; the log task runs below them all.
+#define CAN_TASK_PRIORITY CONFIG_TRITON_CAN_TASK_PRIORITY
+#define CONTROL_TASK_PRIORITY CONFIG_TRITON_CONTROL_TASK_PRIORITY
+#define TASK_STACK_SIZE CONFIG_TRITON_TASK_STACK_SIZE
+
+// USB IN batching. The Linux gs_usb driver reads exactly one frame per bulk transfer,
+// so packing several frames into one transfer is only done once a host opts in with
+// GS_USB_BREQ_TRITON_USB_BATCH. A batch is flushed when full or when USB_BATCH_FLUSH_US expires.
+#define USB_BATCH_MAX_FRAMES (CFG_TUD_VENDOR_TX_BUFSIZE / GS_HOST_FRAME_SIZE)
+#define USB_BATCH_FLUSH_US CONFIG_TRITON_USB_BATCH_FLUSH_US
+// GS_TRITON_USB_BATCH_ADAPTIVE: the arrival gap is averaged over about this many wake-ups (a
+// power of two), and a batch is flushed once no frame came for this many average gaps
+#define USB_ADAPT_WEIGHT 8
+#define USB_ADAPT_PAUSE 2
+
+// Frames handed to a channel but not yet echoed; further host frames stay in the OUT FIFO.
+#define TX_QUEUE_LEN CONFIG_TRITON_TX_QUEUE_LEN // power of two, for SELFTEST_TRACK_LEN
+#if TX_QUEUE_LEN & (TX_QUEUE_LEN - 1)
+#error "CONFIG_TRITON_TX_QUEUE_LEN must be a power of two"
+#endif
+
+// The TWAI callbacks run in the ISR. RX goes from there straight into the ring; what needs a
+// task (echoes, which take the TX lock, error frames, bus-off recovery, gateway sends) goes to the
+// controller's can_event_task through its event queue: one entry per TX completion, at most one
+// pending for state and bus errors, and up to TWAI_GATEWAY_DEFER routed frames.
+#define TWAI_GATEWAY_DEFER 16
+#define TWAI_EVENT_QUEUE_LEN (TX_QUEUE_LEN + 1 + TWAI_GATEWAY_DEFER)
+
+// The on-chip TWAI controllers come first, channels 0..TWAI_CHANNELS - 1 (one on the S3, up to
+// three on the P4, from the triton_twai menu). CONFIG_TRITON_MCP251XFD_CHANNELS adds MCP2518FD
+// chips on SPI after them. Channels are addressed by gs_host_frame.channel and the request wValue.
+#define TWAI_CHANNELS TRITON_TWAI_CONTROLLERS
+#define MCP_CHANNELS CONFIG_TRITON_MCP251XFD_CHANNELS
+#define TRITON_CHANNELS (TWAI_CHANNELS + MCP_CHANNELS)
+#define MCP_SPI_HOST SPI2_HOST
 
 static const char *TAG = "GS_USB";
-static bool is_can_started = false;
 static usb_phy_handle_t phy_handle = NULL;
-static QueueHandle_t can_to_usb_queue;
+static struct gs_host_frame twai_rx_slots[TWAI_CHANNELS][RX_RING_LEN] __attribute__((aligned(RX_RING_ALIGN)));
+#if MCP_CHANNELS
+static struct gs_host_frame_canfd mcp_rx_slots[MCP_CHANNELS][RX_RING_LEN] __attribute__((aligned(RX_RING_ALIGN)));
+#endif
+
+// Frames per channel in the PSRAM RX tier (struct rx_spill in triton_core.h), when there is one
+#if CONFIG_TRITON_RX_SPILL_FRAMES
+#define RX_SPILL_FRAMES CONFIG_TRITON_RX_SPILL_FRAMES
+#if RX_SPILL_FRAMES & (RX_SPILL_FRAMES - 1)
+#error "CONFIG_TRITON_RX_SPILL_FRAMES must be a power of two"
+#endif
+#endif
+
+// The settings a channel's controller runs with, for a host start that asks for the same again
+struct channel_run {
+    struct gs_device_bittiming bt, dbt;
+    uint32_t ctrl_mode;
+    bool fd;
+    uint32_t hw_code, hw_mask; // a TWAI channel's acceptance filter registers
+    bool hw_single;
+};
+
+struct can_channel {
+    struct rx_ring rx_ring;
+    struct rx_spill rx_spill;        // can_forward_task only; no slots without PSRAM
+    // Cumulative counters, served to the host by GS_USB_BREQ_TRITON_STATS. The usb_* fields and
+    // echo_queue_hwm are device-wide and only kept in channel 0's block.
+    struct gs_triton_stats stats;
+    struct gs_triton_filter rx_filter;
+    struct gs_triton_decimate decimate;
+    struct rx_decim decim;           // RX task only
+    volatile uint32_t decim_gen;     // bumped by each rule write
+    struct rx_mailbox mailbox;       // written by the RX task, read by the USB task
+    QueueHandle_t tx_inflight_queue; // handed to the controller, not yet echoed (oldest first)
+    SemaphoreHandle_t tx_lock;       // orders transmit with the in-flight queue
+    uint64_t latency_sum_us;         // window for stats.latency_*, restarted on each host read
+    uint32_t rx_lost_reported;
+    uint32_t trace_count;            // frames since the last traced one (CONFIG_TRITON_TRACE)
+    volatile uint8_t ftrace_stages;  // GS_TRITON_FTRACE_* stages recorded (CONFIG_TRITON_FRAME_TRACE)
+    uint8_t index;
+    bool started;
+    bool berr_reporting;
+    bool fd;                         // started with GS_CAN_MODE_FD: host frames are gs_host_frame_canfd
+    bool holding;                    // autostarted or detached: frames stay in the ring until the host starts the channel
+    bool detached;                   // holding since its host went away (USB unmount or bus reset)
+    uint32_t ctrl_mode;              // GS_CAN_MODE_LISTEN_ONLY / LOOP_BACK / ONE_SHOT / TRIPLE_SAMPLE of the session
+    struct channel_run run;          // what the controller was last started with
+    struct gs_triton_tx_deadline tx_deadline;
+    mcp251xfd_handle_t mcp;          // NULL on the TWAI channels and on an MCP channel whose chip did not answer
+    TaskHandle_t task;               // MCP interrupt task
+};
+static struct can_channel channels[TRITON_CHANNELS];
+
+static inline IRAM_ATTR bool channel_is_twai(const struct can_channel *c) {
+    return c->index < TWAI_CHANNELS;
+}
+
+// Echoes and error frames of all channels: drained before the rings so they never wait behind RX bursts
+static QueueHandle_t echo_queue;
+// Bytes per IN frame: GS_HOST_FRAME_TS_SIZE once the host starts with GS_CAN_MODE_HW_TIMESTAMP
+static uint32_t usb_frame_size = GS_HOST_FRAME_SIZE;
 
-// Stats
-static volatile uint32_t rx_pps = 0;
-static volatile uint32_t tx_pps = 0;
 static volatile uint32_t last_can_id = 0;
+static volatile uint32_t batch_count = 0;
+static volatile uint32_t batch_frames = 0;
+static volatile uint32_t batch_max = 0;
+static volatile uint32_t echo_count = 0;
+static volatile uint32_t echo_wait_us = 0;
+static volatile uint32_t echo_wait_max_us = 0;
+static volatile uint32_t usb_flush_us = 0; // first flush since the last IN completion, 0: none
+static volatile bool usb_in_busy = false;    // a flushed IN transfer has not completed yet
+static volatile uint32_t usb_in_done = 0;    // IN transfers completed on 0x81
+static volatile uint32_t tx_wake_us = 0;   // first OUT callback since can_tx_task last woke
+
+// Arrival time of the host OUT stream, for TX deadlines: tud_vendor_rx_cb appends a mark per OUT
+// transfer, at the stream offset the FIFO then reaches; can_tx_task retires them as it reads. A
+// full ring drops new marks, which makes the frames behind them look younger, never older.
+#define OUT_MARKS 32
+static struct {
+    struct { uint32_t end; uint32_t time_us; } mark[OUT_MARKS]; // end: stream offset after the transfer
+    uint32_t head, tail; // head: USB task, tail: can_tx_task
+    uint32_t read;       // stream bytes out_fill() has read
+} out_marks;
+static TaskHandle_t fwd_task_handle = NULL;
+static TaskHandle_t tx_task_handle = NULL;
+static esp_timer_handle_t batch_timer = NULL;
+static esp_timer_handle_t stats_timer = NULL;
+
+// Periodic TX table (GS_USB_BREQ_TRITON_CYCLIC). Only can_cyclic_task touches cyclic_table;
+// the USB side posts changes into cyclic_post and notifies it.
+#define CYCLIC_ECHO_ID 0xFFFFFFFE // in-flight marker: completion is counted, nothing goes to the host
+struct cyclic_entry {
+    struct gs_triton_cyclic config;
+    int64_t next_us; // next deadline on the esp_timer clock
+};
+static struct cyclic_entry cyclic_table[GS_TRITON_CYCLIC_SLOTS];
+static struct gs_triton_cyclic cyclic_post[GS_TRITON_CYCLIC_SLOTS];
+static uint32_t cyclic_post_mask = 0;
+static portMUX_TYPE cyclic_mux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t cyclic_task_handle = NULL;
+static esp_timer_handle_t cyclic_timer = NULL;
+
+// RS02 servo loop (GS_USB_BREQ_TRITON_SERVO). can_servo_task owns the interpolation; the USB side
+// posts config and setpoints and the RX tasks post feedback, all under servo_mux.
+#define SERVO_ECHO_ID 0xFFFFFFFD
+struct servo_feedback {
+    uint32_t id;
+    uint8_t data[8];
+    int64_t time_us; // 0: nothing received yet
+};
+static struct gs_triton_servo_config servo_config;      // running loop, read by the RX hook
+static struct gs_triton_servo_config servo_config_post;
+static struct gs_triton_servo_setpoint servo_setpoint_post;
+static bool servo_config_posted = false;
+static bool servo_setpoint_posted = false;
+static struct gs_triton_motor_cmd motor_cmd_post;      // GS_USB_BREQ_TRITON_MOTOR_CMD, sent by can_servo_task
+static bool motor_cmd_posted = false;
+static struct servo_feedback servo_fb[GS_TRITON_SERVO_MOTORS];
+static volatile uint32_t servo_seq = 0;
+static volatile bool servo_holding = false;
+static volatile uint32_t servo_commands = 0;
+static volatile uint32_t servo_commands_failed = 0;
+static volatile uint32_t servo_feedback_frames = 0;
+static volatile uint32_t servo_timeouts = 0;
+static portMUX_TYPE servo_mux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t servo_task_handle = NULL;
+static esp_timer_handle_t servo_timer = NULL;
+
+// Packed wire format (GS_USB_BREQ_TRITON_PACKED). Host TX batches are tracked in packed_batches:
+// each frame carries PACKED_ECHO_BASE | index as its echo_id, and the batch is acknowledged once
+// it is sealed (all records read) and nothing is outstanding.
+#define PACKED_ECHO_BASE 0xFFFE0000
+#define PACKED_ECHO_MASK 0xFFFF0000
+#define PACKED_ACK_ECHO_ID 0xFFFFFFFC // echo_queue entry that becomes a GS_TRITON_REC_TX_ACK record
+#define PACKED_BATCHES 16
+struct packed_batch {
+    uint32_t batch_id;
+    uint16_t outstanding; // handed to a controller, not completed yet
+    uint16_t sent;
+    uint16_t failed;
+    bool sealed;
+    bool in_use;
+};
+static struct packed_batch packed_batches[PACKED_BATCHES];
+static portMUX_TYPE packed_mux = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool packed_mode = false;
+
+// Echo endpoint (GS_USB_BREQ_TRITON_ECHO_EP): while echo_ep is set, echo_queue goes to the IN
+// endpoint of the second vendor interface (TinyUSB instance ECHO_ITF) instead of 0x81
+#if CONFIG_TRITON_ECHO_EP
+#define ECHO_ITF 1
+#define ECHO_ITF_COUNT 1
+#define ECHO_ITF_DESC_LEN 16 // interface + endpoint descriptor
+#if CONFIG_TRITON_LOG_CDC
+#define ECHO_EP_ADDR 0x84
+#else
+#define ECHO_EP_ADDR 0x82
+#endif
+#else
+#define ECHO_ITF_COUNT 0
+#define ECHO_ITF_DESC_LEN 0
+#define ECHO_EP_ADDR 0
+#endif
+static volatile bool echo_ep = false;
+
+// USB host sessions. A session ends on unmount, or on a mount that follows an earlier one (a hub or
+// bus reset re-enumerates without an unmount). usb_session tags each host frame's echo header in
+// its reserved byte, so a new host never gets the echoes of frames the last one sent. The channels
+// stay up; can_forward_task detaches them and the next host takes them over.
+static volatile uint8_t usb_session = 0;
+static volatile bool usb_detach_pending = false;
+static bool usb_session_live = false;  // USB task only
+static int64_t usb_gap_start_us = 0;   // when the last session ended
+
+// CAN-to-CAN gateway (GS_USB_BREQ_TRITON_GATEWAY). The RX paths route frames straight into the
+// destination controller (a TWAI channel's through its can_event_task, since a send can wait on
+// the TX lock); a routed frame's echo_id is GATEWAY_ECHO_BASE | slot, so its completion lands on the
+// rule. matched is written by the source's RX path, dropped by whoever sends, sent/failed by the
+// destination's completion task.
+#define GATEWAY_ECHO_BASE 0xFFFD0000
+static struct gs_triton_gateway_rule gateway_table[GS_TRITON_GATEWAY_RULES];
+static volatile uint32_t gateway_src_mask = 0; // channels with an enabled rule
+
+// Loopback self-test (GS_USB_BREQ_TRITON_SELFTEST). The armed config is taken when channel 0 starts:
+// the TWAI node then runs in self-test mode (no ACK needed) with loopback, so every frame it sends
+// comes back. can_selftest_task generates the traffic and the RX callback matches each loopback
+// against selftest_track, oldest first. Matched frames are stamped with their submit time in the
+// RX ring, so the forwarder's latency sample is the whole submit -> USB path.
+#define SELFTEST_ECHO_ID 0xFFFFFFFB
+#define SELFTEST_TICK_US 1000
+#define SELFTEST_TRACK_LEN TX_QUEUE_LEN // power of two
+#define RX_FLAG_SELFTEST (1u << 6) // ring slot only: cleared before the frame goes to the host
+struct selftest_sent {
+    uint32_t can_id;
+    uint32_t time_us;
+};
+static struct gs_triton_selftest_config selftest_config; // armed, read at the next start
+static struct gs_triton_selftest_config selftest_run;    // running
+static volatile bool selftest_running = false;
+static struct selftest_sent selftest_track[SELFTEST_TRACK_LEN];
+static uint32_t selftest_track_head = 0, selftest_track_tail = 0;
+static struct gs_triton_selftest_result selftest_result;
+static uint64_t selftest_rx_sum_us = 0, selftest_usb_sum_us = 0;
+static int64_t selftest_start_us = 0, selftest_end_us = 0;
+static portMUX_TYPE selftest_mux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t selftest_task_handle = NULL;
+static esp_timer_handle_t selftest_timer = NULL;
+
+// Boot-time autostart (GS_USB_BREQ_TRITON_AUTOSTART), one NVS blob per channel. The USB side only
+// records a change; can_forward_task writes it to flash, so a slow erase never stalls tud_task.
+#define AUTOSTART_NVS_NAMESPACE "triton"
+static struct gs_triton_autostart autostart[TRITON_CHANNELS];
+static volatile uint32_t autostart_save_mask = 0;
+
+// Deferred log (TLOGI/TLOGW/TLOGE). A call only claims a slot of log_ring and stores the format
+// pointer and raw arguments; log_task formats and prints them later, at the lowest priority, to
+// UART0 and with CONFIG_TRITON_LOG_CDC also to a CDC-ACM interface. Multi-producer and lock-free
+// (a Vyukov ring: each slot's seq says whose turn it is), so it is safe from any task on either
+// core. A full ring drops the message and counts it.
+// Arguments must be 32-bit words: integers, or pointers to strings that outlive the call
+// (literals, esp_err_to_name()), at most TLOG_MAX_ARGS of them.
+#define LOG_RING_LEN 256 // power of two
+#define TLOG_MAX_ARGS 6
+#define LOG_NOTIFY_STATS (1u << 0)
+#define LOG_LINE_MAX 256
+struct log_record {
+    volatile uint32_t seq;
+    uint32_t time_ms;
+    const char *fmt;
+    uint8_t level;
+    uint8_t nargs;
+    uint32_t args[TLOG_MAX_ARGS];
+};
+static struct log_record log_ring[LOG_RING_LEN];
+static uint32_t log_head = 0; // next slot to claim, CAS by the producers
+static uint32_t log_tail = 0; // log_task only
+static uint32_t log_dropped = 0;
+static TaskHandle_t log_task_handle = NULL;
+
+#define TLOG_NARGS(...) TLOG_NARGS_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define TLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+#define TLOG(level, fmt, ...) tlog_write(level, TLOG_NARGS(__VA_ARGS__), fmt, ##__VA_ARGS__)
+#define TLOGE(fmt, ...) TLOG(ESP_LOG_ERROR, fmt, ##__VA_ARGS__)
+#define TLOGW(fmt, ...) TLOG(ESP_LOG_WARN, fmt, ##__VA_ARGS__)
+#define TLOGI(fmt, ...) TLOG(ESP_LOG_INFO, fmt, ##__VA_ARGS__)
+
+static void tlog_write(uint8_t level, uint32_t nargs, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+static void tlog_write(uint8_t level, uint32_t nargs, const char *fmt, ...) {
+    uint32_t pos = __atomic_load_n(&log_head, __ATOMIC_RELAXED);
+    struct log_record *r;
+    while (1) {
+        r = &log_ring[pos & (LOG_RING_LEN - 1)];
+        int32_t turn = (int32_t)(__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) - pos);
+        if (turn < 0) { __atomic_fetch_add(&log_dropped, 1, __ATOMIC_RELAXED); return; } // log_task is a whole ring behind
+        if (turn == 0 && __atomic_compare_exchange_n(&log_head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+        if (turn > 0) pos = __atomic_load_n(&log_head, __ATOMIC_RELAXED); // another producer got there first
+    }
+    r->time_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    r->fmt = fmt;
+    r->level = level;
+    r->nargs = nargs;
+    va_list ap;
+    va_start(ap, fmt);
+    for (uint32_t i = 0; i < nargs; i++) r->args[i] = va_arg(ap, uint32_t);
+    va_end(ap);
+    __atomic_store_n(&r->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+// Wake the forwarder: new frame queued, IN transfer done, mode request or batch deadline
+static inline IRAM_ATTR void fwd_notify(void) {
+    if (fwd_task_handle) xTaskNotifyGive(fwd_task_handle);
+}
+
+static bool cyclic_submit(const struct gs_triton_cyclic *entry) {
+    if (entry->slot >= GS_TRITON_CYCLIC_SLOTS) return false;
+    if ((entry->flags & GS_TRITON_CYCLIC_ENABLE) && !(entry->flags & GS_TRITON_CYCLIC_DATA_ONLY)) {
+        if (entry->channel >= TRITON_CHANNELS || entry->period_us < GS_TRITON_CYCLIC_MIN_PERIOD_US ||
+            entry->phase_us >= entry->period_us) return false;
+    }
+    portENTER_CRITICAL(&cyclic_mux);
+    cyclic_post[entry->slot] = *entry;
+    cyclic_post_mask |= 1u << entry->slot;
+    portEXIT_CRITICAL(&cyclic_mux);
+    if (cyclic_task_handle) xTaskNotifyGive(cyclic_task_handle);
+    return true;
+}
+
+static bool servo_submit_config(const struct gs_triton_servo_config *config) {
+    if (config->flags & GS_TRITON_SERVO_ENABLE) {
+        if (config->channel >= TRITON_CHANNELS || config->motor_count < 1 ||
+            config->motor_count > GS_TRITON_SERVO_MOTORS || config->rate_hz < GS_TRITON_SERVO_MIN_RATE_HZ ||
+            config->rate_hz > GS_TRITON_SERVO_MAX_RATE_HZ || config->setpoint_period_us == 0 ||
+            config->timeout_ms == 0) return false;
+    }
+    portENTER_CRITICAL(&servo_mux);
+    servo_config_post = *config;
+    servo_config_posted = true;
+    portEXIT_CRITICAL(&servo_mux);
+    if (servo_task_handle) xTaskNotifyGive(servo_task_handle);
+    return true;
+}
+
+// Taken by the loop on its next tick; a newer setpoint simply replaces one not yet taken
+static void servo_submit_setpoint(const struct gs_triton_servo_setpoint *setpoint) {
+    portENTER_CRITICAL(&servo_mux);
+    servo_setpoint_post = *setpoint;
+    servo_setpoint_posted = true;
+    portEXIT_CRITICAL(&servo_mux);
+}
+
+// A newer command replaces one the task has not sent yet, as a setpoint does
+static bool motor_cmd_submit(const struct gs_triton_motor_cmd *cmd) {
+    if (cmd->motor_count > GS_TRITON_MOTOR_CMD_MAX) return false;
+    for (uint32_t i = 0; i < cmd->motor_count; i++) {
+        if (cmd->motor[i].channel >= TRITON_CHANNELS || cmd->motor[i].model >= RS_MODEL_COUNT) return false;
+    }
+    portENTER_CRITICAL(&servo_mux);
+    motor_cmd_post.motor_count = cmd->motor_count;
+    memcpy(motor_cmd_post.motor, cmd->motor, cmd->motor_count * sizeof(cmd->motor[0]));
+    motor_cmd_posted = true;
+    portEXIT_CRITICAL(&servo_mux);
+    if (servo_task_handle) xTaskNotifyGive(servo_task_handle);
+    return true;
+}
+
+static void servo_snapshot(struct gs_triton_servo_state *state) {
+    struct servo_feedback fb[GS_TRITON_SERVO_MOTORS];
+    portENTER_CRITICAL(&servo_mux);
+    uint32_t motors = (servo_config.flags & GS_TRITON_SERVO_ENABLE) ? servo_config.motor_count : 0;
+    uint32_t timeout_us = servo_config.timeout_ms * 1000;
+    memcpy(fb, servo_fb, sizeof(fb));
+    portEXIT_CRITICAL(&servo_mux);
+
+    int64_t now = esp_timer_get_time();
+    memset(state, 0, sizeof(*state));
+    state->seq = servo_seq;
+    state->timestamp_us = (uint32_t)now;
+    state->commands = servo_commands;
+    state->commands_failed = servo_commands_failed;
+    state->feedback_frames = servo_feedback_frames;
+    state->setpoint_timeouts = servo_timeouts;
+    for (uint32_t i = 0; i < motors; i++) {
+        if (servo_holding) state->motor[i].status |= GS_TRITON_SERVO_HOLDING;
+        if (!fb[i].time_us) continue;
+        rs_feedback_t decoded;
+        rs02_decode_feedback(fb[i].id, fb[i].data, &decoded);
+        state->motor[i].pos = decoded.pos;
+        state->motor[i].vel = decoded.vel;
+        state->motor[i].torque = decoded.torque;
+        state->motor[i].temp = decoded.temp;
+        state->motor[i].fault = decoded.fault;
+        state->motor[i].mode = decoded.mode;
+        state->motor[i].age_us = (uint32_t)(now - fb[i].time_us);
+        state->motor[i].status |= GS_TRITON_SERVO_FB_VALID;
+        if (state->motor[i].age_us > timeout_us) state->motor[i].status |= GS_TRITON_SERVO_FB_STALE;
+    }
+}
+
+static inline IRAM_ATTR void hist_add(uint32_t *hist, uint32_t v) {
+    uint32_t b = v ? 31 - __builtin_clz(v) : 0;
+    hist[b < GS_TRITON_HIST_BUCKETS ? b : GS_TRITON_HIST_BUCKETS - 1]++;
+}
+
+// CPU time in the TWAI callbacks (GS_USB_BREQ_TRITON_TASKS). A controller's callbacks run on its
+// core and those of one core don't nest, so plain increments into the core's own slot do.
+static struct { uint32_t cycles; uint32_t count; } isr_time[portNUM_PROCESSORS];
+
+static inline IRAM_ATTR void isr_account(uint32_t t0) {
+    uint32_t core = esp_cpu_get_core_id();
+    isr_time[core].cycles += esp_cpu_get_cycle_count() - t0;
+    isr_time[core].count++;
+}
+
+// Pipeline stage histograms (STATS v4). Cycle counts are per core, so a STAGE_CYCLES() pair always
+// stays inside one task; stages that cross cores use the esp_timer clock.
+#if CONFIG_TRITON_STAGE_PROFILING
+#define STAGE_CYCLES() esp_cpu_get_cycle_count()
+#define STAGE_SAMPLE(hist, v) hist_add(hist, v)
+static inline void stage_mark(volatile uint32_t *mark) {
+    if (!*mark) *mark = (uint32_t)esp_timer_get_time() | 1; // never 0
+}
+static inline void stage_close(volatile uint32_t *mark, uint32_t *hist) {
+    if (!*mark) return;
+    hist_add(hist, (uint32_t)esp_timer_get_time() - *mark);
+    *mark = 0;
+}
+#else
+#define STAGE_CYCLES() 0
+#define STAGE_SAMPLE(hist, v) do { (void)sizeof(v); } while (0) // not evaluated
+static inline void stage_mark(volatile uint32_t *mark) { }
+static inline void stage_close(volatile uint32_t *mark, uint32_t *hist) { }
+#endif
+
+// Per-frame trace (GS_USB_BREQ_TRITON_TRACE). One frame in trace_every per channel carries
+// RX_FLAG_TRACE in its ring slot (or echo) and logs an event at each stage it passes. Producers on
+// both cores and in the RX ISR claim a slot with one atomic add and publish it by storing seq last;
+// the reader (USB task) takes an event only while seq matches its number, so a slot that is being
+// written or was overwritten during the copy is left or counted lost.
+#define RX_FLAG_TRACE (1u << 5) // ring slot and echo only: cleared before the frame goes to the host
+#if CONFIG_TRITON_TRACE
+#define TRACE_RING 512 // power of two
+static struct gs_triton_trace_event trace_ring[TRACE_RING];
+static uint32_t trace_head;       // next event number
+static uint32_t trace_tail;       // USB task only
+static uint32_t trace_lost;       // USB task only
+static volatile uint32_t trace_every = 0;
+static volatile bool trace_fifo_pending = false; // a traced frame went into the FIFO since the last flush
+static volatile uint32_t trace_flush_us = 0;     // flush of such a batch, 0: none waiting for its IN
+static inline IRAM_ATTR uint8_t trace_sample(struct can_channel *c) {
+    uint32_t every = trace_every;
+    if (!every || ++c->trace_count < every) return 0;
+    c->trace_count = 0;
+    return RX_FLAG_TRACE;
+}
+static IRAM_ATTR void trace_put(uint8_t stage, uint8_t channel, uint32_t can_id, uint32_t frame_us, uint32_t time_us) {
+    uint32_t n = __atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED);
+    struct gs_triton_trace_event *e = &trace_ring[n % TRACE_RING];
+    __atomic_store_n(&e->seq, (uint16_t)(n - 1), __ATOMIC_RELAXED); // not n while being written
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e->time_us = time_us;
+    e->frame_us = frame_us;
+    e->can_id = can_id;
+    e->channel = channel;
+    e->stage = stage;
+    __atomic_store_n(&e->seq, (uint16_t)n, __ATOMIC_RELEASE);
+}
+static void trace_reset(uint32_t every) {
+    trace_every = 0;
+    for (uint32_t i = 0; i < TRITON_CHANNELS; i++) channels[i].trace_count = 0;
+    trace_tail = __atomic_load_n(&trace_head, __ATOMIC_ACQUIRE);
+    trace_lost = 0;
+    trace_flush_us = 0;
+    trace_fifo_pending = false;
+    trace_every = every;
+}
+static void trace_read(struct gs_triton_trace *out) {
+    uint32_t head = __atomic_load_n(&trace_head, __ATOMIC_ACQUIRE);
+    if (head - trace_tail > TRACE_RING) {
+        trace_lost += head - trace_tail - TRACE_RING;
+        trace_tail = head - TRACE_RING;
+    }
+    out->count = 0;
+    while (trace_tail != head && out->count < GS_TRITON_TRACE_READ) {
+        const struct gs_triton_trace_event *e = &trace_ring[trace_tail % TRACE_RING];
+        if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) != (uint16_t)trace_tail) break; // still being written
+        out->event[out->count] = *e;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != (uint16_t)trace_tail) trace_lost++; // overwritten
+        else out->count++;
+        trace_tail++;
+    }
+    out->lost = trace_lost;
+    out->every = trace_every;
+    out->time_us = (uint32_t)esp_timer_get_time();
+}
+static inline IRAM_ATTR void trace_fifo(uint8_t stage, uint8_t channel, uint32_t can_id, uint32_t frame_us,
+                                        uint32_t now) {
+    trace_put(stage, channel, can_id, frame_us, now);
+    trace_fifo_pending = true;
+}
+static inline void trace_flushed(void) {
+    if (!trace_fifo_pending) return;
+    trace_fifo_pending = false;
+    if (!trace_flush_us) trace_flush_us = (uint32_t)esp_timer_get_time() | 1; // never 0
+}
+static inline void trace_in_done(void) {
+    uint32_t flush_us = trace_flush_us;
+    if (!flush_us) return;
+    trace_flush_us = 0;
+    trace_put(GS_TRITON_TRACE_USB_IN, 0xFF, 0, flush_us, (uint32_t)esp_timer_get_time());
+}
+#define TRACE_SAMPLE(c) trace_sample(c)
+#else
+#define TRACE_SAMPLE(c) 0
+static inline void trace_put(uint8_t stage, uint8_t channel, uint32_t can_id, uint32_t frame_us, uint32_t time_us) { }
+static inline void trace_fifo(uint8_t stage, uint8_t channel, uint32_t can_id, uint32_t frame_us, uint32_t now) { }
+static inline void trace_flushed(void) { }
+static inline void trace_in_done(void) { }
+#endif
+
+// Frame trace (GS_USB_BREQ_TRITON_FRAME_TRACE): a 16-byte record of every frame of the chosen
+// channels at each chosen stage, read back by the host over EP0. Ring slots are claimed and
+// published as in trace_put(). A record takes the time its stage already has, so it costs one
+// atomic add and a few stores, and a stage that is off costs a load and a branch.
+#define FTRACE_FLAGS (GS_CAN_FLAG_OVERFLOW | GS_CAN_FLAG_FD | GS_CAN_FLAG_BRS | GS_CAN_FLAG_ESI | \
+                      GS_CAN_FLAG_TRITON_TX_FAILED | GS_CAN_FLAG_TRITON_TX_EXPIRED) // not RX_FLAG_*
+#if CONFIG_TRITON_FRAME_TRACE
+#define FTRACE_RING CONFIG_TRITON_FRAME_TRACE_RECORDS
+#if FTRACE_RING & (FTRACE_RING - 1)
+#error "CONFIG_TRITON_FRAME_TRACE_RECORDS must be a power of two"
+#endif
+static struct gs_triton_ftrace_record ftrace_ring[FTRACE_RING];
+static uint32_t ftrace_head;       // next record number
+static uint32_t ftrace_tail;       // USB task only
+static uint32_t ftrace_lost;       // USB task only
+static uint32_t ftrace_stages;     // as last set, for the reader
+static IRAM_ATTR void ftrace_put(uint8_t channel, uint8_t stage, uint32_t can_id, uint8_t dlc, uint8_t flags,
+                                 uint16_t status, uint32_t time_us) {
+    uint32_t n = __atomic_fetch_add(&ftrace_head, 1, __ATOMIC_RELAXED);
+    struct gs_triton_ftrace_record *r = &ftrace_ring[n % FTRACE_RING];
+    __atomic_store_n(&r->seq, (uint16_t)(n - 1), __ATOMIC_RELAXED); // not n while being written
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r->time_us = time_us;
+    r->can_id = can_id;
+    r->channel = channel;
+    r->stage = stage;
+    r->flags = flags & FTRACE_FLAGS;
+    r->dlc = dlc;
+    r->status = status;
+    __atomic_store_n(&r->seq, (uint16_t)n, __ATOMIC_RELEASE);
+}
+static inline IRAM_ATTR void ftrace(const struct can_channel *c, uint8_t stage, uint32_t can_id, uint8_t dlc,
+                                    uint8_t flags, uint16_t status, uint32_t time_us) {
+    if (c->ftrace_stages & (1u << stage)) ftrace_put(c->index, stage, can_id, dlc, flags, status, time_us);
+}
+static void ftrace_reset(const struct gs_triton_ftrace_config *config) {
+    for (uint32_t i = 0; i < TRITON_CHANNELS; i++) channels[i].ftrace_stages = 0;
+    ftrace_tail = __atomic_load_n(&ftrace_head, __ATOMIC_ACQUIRE);
+    ftrace_lost = 0;
+    ftrace_stages = config->stages;
+    for (uint32_t i = 0; i < TRITON_CHANNELS; i++) {
+        if (config->channels & (1u << i)) channels[i].ftrace_stages = (uint8_t)config->stages;
+    }
+}
+static void ftrace_read(struct gs_triton_ftrace *out, uint32_t max) {
+    uint32_t head = __atomic_load_n(&ftrace_head, __ATOMIC_ACQUIRE);
+    if (head - ftrace_tail > FTRACE_RING) {
+        ftrace_lost += head - ftrace_tail - FTRACE_RING;
+        ftrace_tail = head - FTRACE_RING;
+    }
+    if (max > GS_TRITON_FTRACE_READ) max = GS_TRITON_FTRACE_READ;
+    out->count = 0;
+    while (ftrace_tail != head && out->count < max) {
+        const struct gs_triton_ftrace_record *r = &ftrace_ring[ftrace_tail % FTRACE_RING];
+        if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != (uint16_t)ftrace_tail) break; // still being written
+        out->record[out->count] = *r;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&r->seq, __ATOMIC_RELAXED) != (uint16_t)ftrace_tail) ftrace_lost++; // overwritten
+        else out->count++;
+        ftrace_tail++;
+    }
+    out->lost = ftrace_lost;
+    out->stages = ftrace_stages;
+    out->time_us = (uint32_t)esp_timer_get_time();
+}
+#else
+static inline void ftrace(const struct can_channel *c, uint8_t stage, uint32_t can_id, uint8_t dlc, uint8_t flags,
+                          uint16_t status, uint32_t time_us) { }
+#endif
+
+// Writes one gateway slot. The rule is disabled while it is rewritten, so an RX task sees either
+// the old or the new one (a frame in flight may still complete on the old slot's counters).
+static bool gateway_submit(const struct gs_triton_gateway_rule *rule) {
+    if (rule->slot >= GS_TRITON_GATEWAY_RULES) return false;
+    bool enable = rule->flags & GS_TRITON_GATEWAY_ENABLE;
+    if (enable && (rule->src_channel >= TRITON_CHANNELS || rule->dst_channel >= TRITON_CHANNELS ||
+                   rule->src_channel == rule->dst_channel)) return false;
+    struct gs_triton_gateway_rule *r = &gateway_table[rule->slot];
+    r->flags = 0;
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < GS_TRITON_GATEWAY_RULES; i++) {
+        if (gateway_table[i].flags & GS_TRITON_GATEWAY_ENABLE) mask |= 1u << gateway_table[i].src_channel;
+    }
+    gateway_src_mask = mask;
+    *r = *rule;
+    r->flags = 0;
+    r->matched = r->sent = r->dropped = r->failed = 0;
+    if (!enable) return true;
+    r->flags = rule->flags & (GS_TRITON_GATEWAY_ENABLE | GS_TRITON_GATEWAY_CONSUME);
+    gateway_src_mask = mask | 1u << r->src_channel;
+    TLOGI("Gateway %lu: CAN%u %08lx/%08lx -> CAN%u%s", r->slot, r->src_channel, r->can_id, r->mask,
+          r->dst_channel, (r->flags & GS_TRITON_GATEWAY_CONSUME) ? ", consumed" : "");
+    return true;
+}
+
+static bool selftest_arm(const struct gs_triton_selftest_config *config) {
+    if (config->flags & GS_TRITON_SELFTEST_ENABLE) {
+        uint32_t ids = config->id_count ? config->id_count : 1;
+        uint32_t last = (config->can_id & 0x1FFFFFFF) + ids - 1;
+        if (config->rate_pps > GS_TRITON_SELFTEST_MAX_RATE || config->dlc_min > config->dlc_max ||
+            config->dlc_max > 8 || last > ((config->can_id & 0x80000000) ? 0x1FFFFFFF : 0x7FF)) return false;
+    }
+    portENTER_CRITICAL(&selftest_mux);
+    selftest_config = *config;
+    if (selftest_config.id_count == 0) selftest_config.id_count = 1;
+    portEXIT_CRITICAL(&selftest_mux);
+    return true;
+}
+
+// Channel 0 came up in self-test mode: a new run, everything counted from here
+static void selftest_begin(void) {
+    portENTER_CRITICAL(&selftest_mux);
+    selftest_run = selftest_config;
+    memset(&selftest_result, 0, sizeof(selftest_result));
+    selftest_rx_sum_us = selftest_usb_sum_us = 0;
+    selftest_track_head = selftest_track_tail = 0;
+    selftest_start_us = esp_timer_get_time();
+    selftest_running = true;
+    portEXIT_CRITICAL(&selftest_mux);
+    if (selftest_run.rate_pps) esp_timer_start_periodic(selftest_timer, SELFTEST_TICK_US);
+}
+
+static void selftest_end(void) {
+    esp_timer_stop(selftest_timer);
+    portENTER_CRITICAL(&selftest_mux);
+    selftest_running = false;
+    selftest_end_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&selftest_mux);
+}
+
+// Oldest first: a match further in means the frames before it never came back. Frames that match
+// nothing (host frames, other nodes) are left alone. Rewrites *ts to the submit time on a match.
+// Called from the TWAI RX callback, in the ISR.
+static IRAM_ATTR bool selftest_match(uint32_t can_id, uint32_t *ts) {
+    bool found = false;
+    portENTER_CRITICAL_ISR(&selftest_mux);
+    for (uint32_t i = selftest_track_tail; i != selftest_track_head; i++) {
+        const struct selftest_sent *sent = &selftest_track[i & (SELFTEST_TRACK_LEN - 1)];
+        if (sent->can_id != can_id) continue;
+        uint32_t lat = *ts - sent->time_us;
+        struct gs_triton_selftest_result *r = &selftest_result;
+        if (r->received == 0 || lat < r->rx_min_us) r->rx_min_us = lat;
+        if (lat > r->rx_max_us) r->rx_max_us = lat;
+        selftest_rx_sum_us += lat;
+        hist_add(r->rx_hist, lat);
+        r->received++;
+        r->lost += i - selftest_track_tail;
+        selftest_track_tail = i + 1;
+        *ts = sent->time_us;
+        found = true;
+        break;
+    }
+    portEXIT_CRITICAL_ISR(&selftest_mux);
+    return found;
+}
+
+// Forwarder side: a self-test frame just went into the USB FIFO
+static void selftest_usb_sample(uint32_t lat) {
+    portENTER_CRITICAL(&selftest_mux);
+    struct gs_triton_selftest_result *r = &selftest_result;
+    if (r->usb_frames == 0 || lat < r->usb_min_us) r->usb_min_us = lat;
+    if (lat > r->usb_max_us) r->usb_max_us = lat;
+    selftest_usb_sum_us += lat;
+    hist_add(r->usb_hist, lat);
+    r->usb_frames++;
+    portEXIT_CRITICAL(&selftest_mux);
+}
+
+static void selftest_snapshot(struct gs_triton_selftest_result *result) {
+    portENTER_CRITICAL(&selftest_mux);
+    *result = selftest_result;
+    uint64_t rx_sum = selftest_rx_sum_us, usb_sum = selftest_usb_sum_us;
+    int64_t elapsed = (selftest_running ? esp_timer_get_time() : selftest_end_us) - selftest_start_us;
+    bool running = selftest_running, armed = selftest_config.flags & GS_TRITON_SELFTEST_ENABLE;
+    portEXIT_CRITICAL(&selftest_mux);
+
+    if (selftest_start_us == 0) elapsed = 0; // no run yet
+    result->flags = (armed ? GS_TRITON_SELFTEST_ENABLE : 0) | (running ? GS_TRITON_SELFTEST_RUNNING : 0);
+    result->elapsed_ms = (uint32_t)(elapsed / 1000);
+    if (elapsed > 0) {
+        result->tx_pps = (uint32_t)((uint64_t)result->generated * 1000000 / elapsed);
+        result->rx_pps = (uint32_t)((uint64_t)result->received * 1000000 / elapsed);
+    }
+    result->rx_avg_us = result->received ? (uint32_t)(rx_sum / result->received) : 0;
+    result->usb_avg_us = result->usb_frames ? (uint32_t)(usb_sum / result->usb_frames) : 0;
+}
+
+// Called by the RX paths for every frame: type-2 feedback from a loop motor is kept for the next
+// snapshot, and swallowed when the host asked for GS_TRITON_SERVO_CONSUME_FEEDBACK. The TWAI
+// channels call it from the ISR.
+static IRAM_ATTR bool servo_take_feedback(const struct can_channel *c, uint32_t can_id, const uint8_t *data,
+                                          uint8_t dlc) {
+    if (!(can_id & 0x80000000) || dlc < 8) return false;
+    uint32_t id = can_id & 0x1FFFFFFF;
+    if (rs_ext_id_type(id) != RS_TYPE_FEEDBACK) return false;
+    bool consumed = false;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL_SAFE(&servo_mux);
+    if ((servo_config.flags & GS_TRITON_SERVO_ENABLE) && servo_config.channel == c->index &&
+        (id & 0xFF) == servo_config.host_id) {
+        for (uint32_t i = 0; i < servo_config.motor_count; i++) {
+            if (servo_config.motor_id[i] != ((id >> 8) & 0xFF)) continue;
+            servo_fb[i].id = id;
+            memcpy(servo_fb[i].data, data, 8);
+            servo_fb[i].time_us = now;
+            servo_feedback_frames++;
+            consumed = servo_config.flags & GS_TRITON_SERVO_CONSUME_FEEDBACK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&servo_mux);
+    return consumed;
+}
 
 #define MAGIC_FLAG 0xFFFFFFFF
 
-DMA_ATTR __attribute__((aligned(4))) static struct gs_device_bittiming pending_bt;
-DMA_ATTR __attribute__((aligned(4))) static struct gs_device_mode pending_mode;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_device_bittiming pending_bt[TRITON_CHANNELS];
+DMA_ATTR __attribute__((aligned(4))) static struct gs_device_bittiming pending_dbt[TRITON_CHANNELS];
+DMA_ATTR __attribute__((aligned(4))) static struct gs_device_mode pending_mode[TRITON_CHANNELS];
 DMA_ATTR __attribute__((aligned(4))) static struct gs_host_config pending_host_config; 
+DMA_ATTR __attribute__((aligned(4))) static uint32_t timestamp_now;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_clock clock_now;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_device_state dev_state;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_stats stats_snapshot;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_tasks task_stats;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_filter pending_filter;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_cyclic pending_cyclic;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_servo_config pending_servo_config;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_servo_setpoint pending_servo_setpoint;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_servo_state servo_state;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_motor_cmd pending_motor_cmd;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_packed pending_packed;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_echo_ep pending_echo_ep;
+#if CONFIG_TRITON_TRACE
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_trace_config pending_trace;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_trace trace_snapshot;
+#endif
+#if CONFIG_TRITON_FRAME_TRACE
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_ftrace_config pending_ftrace;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_ftrace ftrace_snapshot;
+#endif
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_selftest_config pending_selftest;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_selftest_result selftest_state;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_autostart pending_autostart;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_decimate pending_decimate;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_tx_deadline pending_tx_deadline;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_gateway_rule pending_gateway;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_mailbox_config pending_mailbox;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_mailbox mailbox_snapshot;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_rx_policy rx_policy = {
+    .policy = GS_TRITON_RX_DROP_NEWEST
+};
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_usb_batch usb_batch = {
+    .max_frames = 1, .flush_us = USB_BATCH_FLUSH_US
+};
+// Adaptive batching, can_forward_task only: gap_us16 is the average time between staged RX frames
+// in 1/16 us, last_us when frames were last staged
+static struct { uint32_t gap_us16; int64_t last_us; } usb_adapt;
 DMA_ATTR __attribute__((aligned(4))) static struct gs_device_config dconf = {
-    .icount = 0, .sw_version = 2, .hw_version = 1
+    .icount = TRITON_CHANNELS - 1, .sw_version = 2, .hw_version = 1
 };
-DMA_ATTR __attribute__((aligned(4))) static struct gs_device_bt_const bt_const = { 
-    .fclk_can = 80000000, .tseg1_max = 16, .tseg2_max = 8, .sjw_max = 4, .brp_max = 128, .brp_inc = 1 
+DMA_ATTR __attribute__((aligned(4))) static struct gs_triton_caps caps;
+DMA_ATTR __attribute__((aligned(4))) static struct gs_device_bt_const_extended bt_const[TRITON_CHANNELS] = {
+    [0] = {
+        .feature = GS_CAN_FEATURE_LISTEN_ONLY | GS_CAN_FEATURE_LOOP_BACK | GS_CAN_FEATURE_TRIPLE_SAMPLE |
+                   GS_CAN_FEATURE_ONE_SHOT | GS_CAN_FEATURE_HW_TIMESTAMP | GS_CAN_FEATURE_BERR_REPORTING |
+                   GS_CAN_FEATURE_GET_STATE,
+        .fclk_can = 80000000, .tseg1_max = 16, .tseg2_max = 8, .sjw_max = 4, .brp_max = 128, .brp_inc = 1
+    }
 };
 
+// Per-ID decimation (GS_USB_BREQ_TRITON_DECIMATE). Returns true when the frame is suppressed.
+static IRAM_ATTR bool rx_decimate(struct can_channel *c, uint32_t can_id, uint8_t dlc, const uint8_t *data,
+                                  uint32_t len, uint32_t ts) {
+    switch (rx_decim_apply(&c->decim, &c->decimate, c->decim_gen, can_id, dlc, data, len, ts)) {
+        case RX_DECIM_DROP: c->stats.rx_decimated++; return true;
+        case RX_DECIM_UNTRACKED: c->stats.decimate_untracked++; return false;
+        default: return false;
+    }
+}
+
+static bool any_channel_started(void) {
+    for (uint32_t ch = 0; ch < TRITON_CHANNELS; ch++) {
+        if (channels[ch].started) return true;
+    }
+    return false;
+}
+
+// GS_USB_BREQ_TRITON_CAPS, from the build options and the channels' BT_CONST. The SPI link starts
+// neither the echo endpoint nor the log TTY.
+static void caps_fill(struct gs_triton_caps *c) {
+    memset(c, 0, sizeof(*c));
+    c->version = GS_TRITON_CAPS_VERSION;
+    c->size = sizeof(*c);
+    c->features = GS_TRITON_CAP_PACKED | GS_TRITON_CAP_CLOCK | GS_TRITON_CAP_TX_DEADLINE | GS_TRITON_CAP_FILTER |
+                  GS_TRITON_CAP_RX_POLICY | GS_TRITON_CAP_DECIMATE | GS_TRITON_CAP_MAILBOX | GS_TRITON_CAP_CYCLIC |
+                  GS_TRITON_CAP_GATEWAY | GS_TRITON_CAP_SERVO | GS_TRITON_CAP_MOTOR_CMD | GS_TRITON_CAP_SELFTEST |
+                  GS_TRITON_CAP_AUTOSTART | GS_TRITON_CAP_TASKS;
+#if CONFIG_TRITON_SPI_LINK
+    c->features |= GS_TRITON_CAP_SPI_LINK;
+    c->spi_block = CONFIG_TRITON_SPI_LINK_BLOCK;
+#else
+    c->features |= GS_TRITON_CAP_USB_BATCH | GS_TRITON_CAP_USB_BATCH_ADAPTIVE | GS_TRITON_CAP_USB_REATTACH;
+    if (ECHO_EP_ADDR) c->features |= GS_TRITON_CAP_ECHO_EP;
+#if CONFIG_TRITON_LOG_CDC
+    c->features |= GS_TRITON_CAP_LOG_CDC;
+#endif
+#endif
+#if CONFIG_TRITON_TRACE
+    c->features |= GS_TRITON_CAP_TRACE;
+#endif
+#if CONFIG_TRITON_FRAME_TRACE
+    c->features |= GS_TRITON_CAP_FRAME_TRACE;
+#endif
+#if CONFIG_TRITON_STAGE_PROFILING
+    c->features |= GS_TRITON_CAP_STAGE_PROFILING;
+#endif
+#if CONFIG_TRITON_RX_SPILL_FRAMES
+    c->features |= GS_TRITON_CAP_RX_SPILL;
+    c->rx_spill_frames = RX_SPILL_FRAMES;
+#endif
+    c->channels = TRITON_CHANNELS;
+    for (uint32_t ch = 0; ch < TRITON_CHANNELS; ch++) {
+        if (bt_const[ch].feature & GS_CAN_FEATURE_FD) c->fd_channels |= 1u << ch;
+    }
+    c->usb_in_fifo = CFG_TUD_VENDOR_TX_BUFSIZE;
+    c->usb_out_fifo = CFG_TUD_VENDOR_RX_BUFSIZE;
+    c->usb_ep_size = CFG_TUD_VENDOR_EPSIZE;
+    c->usb_batch_max_frames = USB_BATCH_MAX_FRAMES;
+    c->packed_block_max = GS_TRITON_PACKED_BLOCK_MAX;
+    c->rx_ring_len = RX_RING_LEN;
+    c->tx_queue_len = TX_QUEUE_LEN;
+    c->sw_filters = GS_TRITON_SW_FILTERS;
+    c->cyclic_slots = GS_TRITON_CYCLIC_SLOTS;
+    c->decimate_rules = GS_TRITON_DECIMATE_RULES;
+    c->gateway_rules = GS_TRITON_GATEWAY_RULES;
+    c->tx_deadline_rules = GS_TRITON_TX_DEADLINE_RULES;
+    c->mailbox_ids = GS_TRITON_MAILBOX_IDS;
+    c->servo_motors = GS_TRITON_SERVO_MOTORS;
+    c->motor_cmd_max = GS_TRITON_MOTOR_CMD_MAX;
+    c->stats_version = GS_TRITON_STATS_VERSION;
+}
+
+// Linux frees its own echo slots on reset. The queue is shared, so it is only
+// flushed once no channel can have echoes left in it.
+static void channel_stopped(struct can_channel *c) {
+    c->started = false;
+    c->stats.bus_state = GS_CAN_STATE_STOPPED;
+    xQueueReset(c->tx_inflight_queue);
+    if (!any_channel_started()) xQueueReset(echo_queue);
+}
+
 // --- CAN DRIVER ---
-static void stop_can() {
-    if (is_can_started) {
-        twai_stop(); 
-        twai_driver_uninstall();
-        is_can_started = false;
-        ESP_LOGW(TAG, "CAN Stopped");
-    }
-}
-
-static esp_err_t start_can(const struct gs_device_bittiming *bt) {
-    stop_can();
-    
-    // REVERTED: Removed ESP_INTR_FLAG_IRAM
-    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(TX_PIN, RX_PIN, TWAI_MODE_NORMAL);
-    g_config.tx_queue_len = 128; 
-    g_config.rx_queue_len = 128;
-    
-    twai_timing_config_t t_config = {0};
-    t_config.brp = bt->brp; 
-    t_config.tseg_1 = bt->prop_seg + bt->phase_seg1;
-    t_config.tseg_2 = bt->phase_seg2;
-    t_config.sjw = bt->sjw;
-    t_config.triple_sampling = false;
-    
-    twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
-    
-    if (twai_driver_install(&g_config, &t_config, &f_config) == ESP_OK) {
-        if (twai_start() == ESP_OK) {
-            is_can_started = true;
-            ESP_LOGI(TAG, "CAN Started (BRP: %lu)", bt->brp);
-            return ESP_OK;
-        } else {
-            ESP_LOGE(TAG, "TWAI Start Failed");
+// Each on-chip controller is a triton_twai handle. Its node stays created across stop/start, so
+// the usual `ip link set can0 down/up`, with or without a new bitrate, is a triton_twai_reconfigure()
+// and an enable. Only a change of mode (self-test, listen-only, loopback, one-shot) recreates it.
+
+// Work the TWAI ISR hands to can_event_task
+enum { TWAI_EV_TX_DONE, TWAI_EV_STATUS, TWAI_EV_GATEWAY };
+struct twai_event {
+    uint8_t type;
+    union {
+        struct { uint32_t seq; bool ok; uint32_t time_us; } tx; // the completed frame's submit seq, ISR time
+        struct { uint32_t rules; uint32_t can_id; uint8_t dlc; uint8_t data[8]; } gw; // a bit per rule
+    };
+};
+
+// Frames beyond TWAI_NODE_DEPTH in flight wait in prio, under tx_lock, and go to the node by
+// CAN ID as completions free room. Two in the node: one in the controller's single TX buffer and
+// one the driver loads from its ISR, so the bus sees no gap while can_event_task feeds the next.
+#define TWAI_NODE_DEPTH CONFIG_TRITON_TWAI_NODE_DEPTH
+#if TWAI_NODE_DEPTH > CONFIG_TRITON_TWAI_TX_QUEUE_LEN
+#error "CONFIG_TRITON_TWAI_NODE_DEPTH must fit the triton_twai TX ring"
+#endif
+
+// One per on-chip controller, twai[ch] for channel ch
+static struct twai_ctl {
+    triton_twai_ctrl_t *ctrl;
+    QueueHandle_t events;
+    volatile uint32_t gateway_pending; // TWAI_EV_GATEWAY entries in events
+    // State changes and bus errors since can_event_task last looked, one TWAI_EV_STATUS posted for all
+    portMUX_TYPE status_mux;
+    struct {
+        bool posted;
+        bool arb_lost;
+        bool bus_error;
+    } status;
+    uint32_t tx_head; // the seq after the newest submitted frame, under tx_lock
+    struct tx_prio prio;
+} twai[TWAI_CHANNELS];
+
+// The core that creates a controller's node, and so takes its interrupt, and runs its event task
+static const BaseType_t twai_cores[TWAI_CHANNELS] = {
+    CONFIG_TRITON_TWAI0_CORE,
+#if TWAI_CHANNELS > 1
+    CONFIG_TRITON_TWAI1_CORE,
+#endif
+#if TWAI_CHANNELS > 2
+    CONFIG_TRITON_TWAI2_CORE,
+#endif
+};
+
+static bool twai_on_rx(triton_twai_ctrl_t *ctrl, const twai_frame_t *frame, void *ctx);
+static bool twai_on_tx_done(triton_twai_ctrl_t *ctrl, uint32_t seq, bool ok, void *ctx);
+static bool twai_on_state(triton_twai_ctrl_t *ctrl, twai_error_state_t state, void *ctx);
+static bool twai_on_error(triton_twai_ctrl_t *ctrl, twai_error_flags_t flags, void *ctx);
+
+// gs_triton_filter.hw_* keep the acceptance register layout of the legacy driver (mask bit set:
+// don't care). Single mode becomes one mask filter over the 29-bit ID, which programs the same
+// register bits, so standard frames still match on the top 11; dual mode becomes two standard-ID
+// filters. The RTR and data byte bits of the registers are not carried over.
+static twai_mask_filter_config_t twai_hw_filter(const struct gs_triton_filter *f) {
+    uint32_t care = ~f->hw_mask;
+    if (!f->hw_single) {
+        return twai_make_dual_filter(f->hw_code >> 21, care >> 21, (f->hw_code >> 5) & 0x7FF, (care >> 5) & 0x7FF, false);
+    }
+    twai_mask_filter_config_t filter = { .id = f->hw_code >> 3, .mask = care >> 3 };
+    filter.is_ext = 1;
+    return filter;
+}
+
+static void stop_can(struct can_channel *c) {
+    struct twai_ctl *t = &twai[c->index];
+    if (c->started) {
+        xSemaphoreTake(c->tx_lock, portMAX_DELAY);
+        triton_twai_ctrl_disable(t->ctrl); // deletes a node with frames queued, or in bus-off
+        t->prio.count = 0; // dropped with the in-flight queue, unechoed
+        if (c->index == 0 && selftest_running) selftest_end();
+        channel_stopped(c);
+        xSemaphoreGive(c->tx_lock);
+        TLOGW("CAN%u Stopped", c->index);
+    }
+}
+
+static esp_err_t start_can_local(struct can_channel *c, const struct gs_device_bittiming *bt) {
+    struct twai_ctl *t = &twai[c->index];
+    stop_can(c);
+
+    // Self-test, channel 0 only: no other node has to acknowledge, and the controller receives its own frames
+    bool selftest = c->index == 0 && (selftest_config.flags & GS_TRITON_SELFTEST_ENABLE);
+    // An armed self-test needs the bus to itself and its own loopback
+    if (selftest) c->ctrl_mode &= ~(GS_CAN_MODE_LISTEN_ONLY | GS_CAN_MODE_LOOP_BACK);
+    // Loopback receives its own frames and, like self-test, needs no other node to acknowledge.
+    // One-shot gives up after the first attempt; otherwise a frame is retried until sent.
+    uint32_t modes = ((c->ctrl_mode & GS_CAN_MODE_LISTEN_ONLY) ? TRITON_TWAI_MODE_LISTEN_ONLY : 0) |
+                     ((selftest || (c->ctrl_mode & GS_CAN_MODE_LOOP_BACK)) ? TRITON_TWAI_MODE_LOOPBACK : 0) |
+                     ((c->ctrl_mode & GS_CAN_MODE_ONE_SHOT) ? TRITON_TWAI_MODE_ONE_SHOT : 0);
+    twai_timing_advanced_config_t timing = {
+        .clk_src = TWAI_CLK_SRC_DEFAULT, .brp = bt->brp,
+        .tseg_1 = bt->prop_seg + bt->phase_seg1, .tseg_2 = bt->phase_seg2, .sjw = bt->sjw,
+        .triple_sampling = (c->ctrl_mode & GS_CAN_MODE_TRIPLE_SAMPLE) != 0,
+    };
+    twai_mask_filter_config_t filter = twai_hw_filter(&c->rx_filter);
+    bool reuse;
+    if (triton_twai_reconfigure(t->ctrl, modes, &timing, &filter, &reuse) != ESP_OK) {
+        TLOGE("CAN%u: TWAI Config Failed", c->index);
+        return ESP_FAIL;
+    }
+    if (reuse) c->stats.reconfig_fast++;
+    portENTER_CRITICAL(&t->status_mux);
+    t->status.arb_lost = t->status.bus_error = false; // nothing of the last session leaks into this one
+    portEXIT_CRITICAL(&t->status_mux);
+    if (triton_twai_ctrl_enable(t->ctrl) != ESP_OK) {
+        TLOGE("CAN%u: TWAI Start Failed", c->index); // the next start begins from a fresh node
+        return ESP_FAIL;
+    }
+    c->started = true;
+    c->stats.bus_state = GS_CAN_STATE_ERROR_ACTIVE;
+    c->stats.tec = 0; c->stats.rec = 0;
+    if (selftest) selftest_begin();
+    if (selftest) TLOGI("CAN Started in self-test mode (BRP: %lu, %lu pps)", bt->brp, selftest_run.rate_pps);
+    else TLOGI("CAN%u Started (BRP: %lu%s)", c->index, bt->brp, reuse ? ", node kept" : "");
+    return ESP_OK;
+}
+
+#if PIN_TASKS_TO_CORES
+struct start_can_call { struct can_channel *c; const struct gs_device_bittiming *bt; esp_err_t err; };
+
+static void start_can_ipc(void *arg) {
+    struct start_can_call *call = arg;
+    call->err = start_can_local(call->c, call->bt);
+}
+#endif
+
+// The TWAI interrupt is allocated on the core that creates the node: the controller's twai_cores entry
+static esp_err_t start_can(struct can_channel *c, const struct gs_device_bittiming *bt) {
+#if PIN_TASKS_TO_CORES
+    struct start_can_call call = { .c = c, .bt = bt, .err = ESP_FAIL };
+    if (esp_ipc_call_blocking(twai_cores[c->index], start_can_ipc, &call) != ESP_OK) return ESP_FAIL;
+    return call.err;
+#else
+    return start_can_local(c, bt);
+#endif
+}
+
+// MCP channels: the chip keeps its own state, so start/stop is a mode change over SPI
+static void mcp_channel_stop(struct can_channel *c) {
+    if (!c->started) return;
+    xSemaphoreTake(c->tx_lock, portMAX_DELAY);
+    mcp251xfd_stop(c->mcp);
+    channel_stopped(c);
+    xSemaphoreGive(c->tx_lock);
+    TLOGW("CAN%u Stopped", c->index);
+}
+
+static esp_err_t mcp_channel_start(struct can_channel *c, const struct gs_device_bittiming *bt,
+                                   const struct gs_device_bittiming *dbt) {
+    mcp_channel_stop(c);
+    if (!c->mcp) return ESP_ERR_INVALID_STATE;
+
+    mcp251xfd_timing_t nominal = {
+        .brp = bt->brp, .tseg1 = bt->prop_seg + bt->phase_seg1, .tseg2 = bt->phase_seg2, .sjw = bt->sjw
+    };
+    mcp251xfd_timing_t data = {
+        .brp = dbt->brp, .tseg1 = dbt->prop_seg + dbt->phase_seg1, .tseg2 = dbt->phase_seg2, .sjw = dbt->sjw
+    };
+    // External loopback still drives the bus but needs no acknowledge, like TWAI self-test
+    mcp251xfd_mode_t mode = (c->ctrl_mode & GS_CAN_MODE_LISTEN_ONLY) ? MCP251XFD_MODE_LISTEN_ONLY
+                          : (c->ctrl_mode & GS_CAN_MODE_LOOP_BACK) ? MCP251XFD_MODE_EXT_LOOPBACK
+                          : c->fd ? MCP251XFD_MODE_NORMAL_FD : MCP251XFD_MODE_NORMAL_CAN20;
+    mcp251xfd_set_one_shot(c->mcp, (c->ctrl_mode & GS_CAN_MODE_ONE_SHOT) != 0);
+    esp_err_t err = mcp251xfd_start(c->mcp, &nominal, c->fd ? &data : NULL, mode);
+    if (err != ESP_OK) {
+        TLOGE("CAN%u Start Failed (%s)", c->index, esp_err_to_name(err));
+        return err;
+    }
+    c->started = true;
+    c->stats.bus_state = GS_CAN_STATE_ERROR_ACTIVE;
+    c->stats.tec = 0; c->stats.rec = 0;
+    c->stats.reconfig_fast++; // registers only, there is no driver to reinstall
+    xTaskNotifyGive(c->task);
+    if (c->fd) TLOGI("CAN%u Started FD (BRP: %lu, data BRP: %lu)", c->index, bt->brp, dbt->brp);
+    else TLOGI("CAN%u Started (BRP: %lu)", c->index, bt->brp);
+    return ESP_OK;
+}
+
+static esp_err_t start_channel(uint32_t ch) {
+    struct gs_triton_stats *s = &channels[ch].stats;
+    int64_t t0 = esp_timer_get_time();
+    struct can_channel *c = &channels[ch];
+    esp_err_t err = channel_is_twai(c) ? start_can(c, &pending_bt[ch]) : mcp_channel_start(c, &pending_bt[ch], &pending_dbt[ch]);
+    // Whole restart as the host sees it: stop, reconfigure and start, including the IPC hop to the controller's core
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    if (err == ESP_OK) {
+        c->run = (struct channel_run){
+            .bt = pending_bt[ch], .dbt = pending_dbt[ch], .ctrl_mode = c->ctrl_mode, .fd = c->fd,
+            .hw_code = c->rx_filter.hw_code, .hw_mask = c->rx_filter.hw_mask, .hw_single = c->rx_filter.hw_single,
+        };
+    }
+    s->reconfig_count++;
+    s->reconfig_last_us = us;
+    if (us > s->reconfig_max_us) s->reconfig_max_us = us;
+    return err;
+}
+
+static void stop_channel(uint32_t ch) {
+    if (channel_is_twai(&channels[ch])) stop_can(&channels[ch]);
+    else mcp_channel_stop(&channels[ch]);
+}
+
+// --- AUTOSTART ---
+static void autostart_key(uint32_t ch, char *key, size_t len) {
+    snprintf(key, len, "autostart%lu", ch);
+}
+
+static void autostart_save(uint32_t ch) {
+    nvs_handle_t nvs;
+    char key[16];
+    autostart_key(ch, key, sizeof(key));
+    esp_err_t err = nvs_open(AUTOSTART_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        if (autostart[ch].flags & GS_TRITON_AUTOSTART_ENABLE) err = nvs_set_blob(nvs, key, &autostart[ch], sizeof(autostart[ch]));
+        else if ((err = nvs_erase_key(nvs, key)) == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+        if (err == ESP_OK) err = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) TLOGE("CAN%lu autostart not saved (%s)", ch, esp_err_to_name(err));
+    else if (autostart[ch].flags & GS_TRITON_AUTOSTART_ENABLE) TLOGI("CAN%lu autostart saved (BRP: %lu)", ch, autostart[ch].bt.brp);
+    else TLOGI("CAN%lu autostart cleared", ch);
+}
+
+// The controller modes a channel starts with: what the host asked for and the channel supports (the
+// feature and mode bits of these coincide), plus the ones CONFIG_TRITON_FORCE_ONE_SHOT adds
+static uint32_t channel_modes(uint32_t ch, uint32_t flags) {
+    uint32_t modes = flags & (GS_CAN_MODE_LISTEN_ONLY | GS_CAN_MODE_LOOP_BACK | GS_CAN_MODE_ONE_SHOT |
+                              GS_CAN_MODE_TRIPLE_SAMPLE);
+#if CONFIG_TRITON_FORCE_ONE_SHOT
+    modes |= GS_CAN_MODE_ONE_SHOT;
+#endif
+    return modes & bt_const[ch].feature;
+}
+
+// Before USB comes up: stored channels start right away and keep what they receive in their RX
+// ring (newest frames win) until the host sends its own GS_CAN_MODE_START
+static void autostart_boot(void) {
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        nvs_flash_erase();
+        err = nvs_flash_init();
+    }
+    nvs_handle_t nvs;
+    if (err != ESP_OK || nvs_open(AUTOSTART_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) return; // nothing stored yet
+    for (uint32_t ch = 0; ch < TRITON_CHANNELS; ch++) {
+        char key[16];
+        size_t len = sizeof(autostart[ch]);
+        autostart_key(ch, key, sizeof(key));
+        if (nvs_get_blob(nvs, key, &autostart[ch], &len) != ESP_OK || len != sizeof(autostart[ch])) {
+            memset(&autostart[ch], 0, sizeof(autostart[ch]));
+            continue;
+        }
+        if (!(autostart[ch].flags & GS_TRITON_AUTOSTART_ENABLE) || autostart[ch].bt.brp == 0) continue;
+        pending_bt[ch] = autostart[ch].bt;
+        pending_dbt[ch] = autostart[ch].bt;
+        channels[ch].fd = false;
+        channels[ch].ctrl_mode = channel_modes(ch, 0);
+        if (start_channel(ch) == ESP_OK) {
+            channels[ch].holding = true;
+            TLOGI("CAN%lu autostarted, holding frames for the host", ch);
         }
-    } else {
-        ESP_LOGE(TAG, "TWAI Install Failed");
     }
-    return ESP_FAIL;
+    nvs_close(nvs);
+}
+
+// The host's first start of a held channel, autostarted or left running by the last host: when it
+// asks for exactly what is already running the controller is left alone, so nothing received in
+// between is lost. Either way the ring is flushed.
+static bool held_matches(uint32_t ch) {
+    const struct can_channel *c = &channels[ch];
+    const struct channel_run *r = &c->run;
+    if (!c->holding || !c->started || c->fd != r->fd || c->ctrl_mode != r->ctrl_mode) return false;
+    if (memcmp(&pending_bt[ch], &r->bt, sizeof(struct gs_device_bittiming)) != 0) return false;
+    if (c->fd && memcmp(&pending_dbt[ch], &r->dbt, sizeof(struct gs_device_bittiming)) != 0) return false;
+    // A TWAI channel runs with the filter and mode of the time
+    if (channel_is_twai(c) && ((ch == 0 && (selftest_config.flags & GS_TRITON_SELFTEST_ENABLE)) ||
+                               c->rx_filter.hw_code != r->hw_code || c->rx_filter.hw_mask != r->hw_mask ||
+                               c->rx_filter.hw_single != r->hw_single)) return false;
+    return true;
 }
 
 // --- USB DESCRIPTORS ---
+#if CONFIG_TRITON_LOG_CDC
+// Composite with an interface association for the CDC pair
+#define USB_DEVICE_CLASS TUSB_CLASS_MISC, .bDeviceSubClass = MISC_SUBCLASS_COMMON, .bDeviceProtocol = MISC_PROTOCOL_IAD
+#else
+#define USB_DEVICE_CLASS 0x00, .bDeviceSubClass = 0x00, .bDeviceProtocol = 0x00
+#endif
+
 uint8_t const * tud_descriptor_device_cb(void) {
     static const tusb_desc_device_t desc_device = {
         .bLength = sizeof(tusb_desc_device_t), .bDescriptorType = TUSB_DESC_DEVICE,
-        .bcdUSB = 0x0200, .bDeviceClass = 0x00, .bDeviceSubClass = 0x00,
-        .bDeviceProtocol = 0x00, .bMaxPacketSize0 = 64,
+        .bcdUSB = 0x0200, .bDeviceClass = USB_DEVICE_CLASS, .bMaxPacketSize0 = 64,
         .idVendor = USB_VID, .idProduct = USB_PID, .bcdDevice = 0x0100,
         .iManufacturer = 0x01, .iProduct = 0x02, .iSerialNumber = 0x03, .bNumConfigurations = 0x01
     };
     return (uint8_t const *) &desc_device;
 }
+
+// Bulk endpoints take 64-byte packets at full speed and 512-byte ones at high speed (the P4's
+// UTMI PHY), so the configuration comes in both sizes and the host gets the one for the link
+#if CONFIG_TRITON_LOG_CDC
+// gs_usb binds interface 0 only; the log TTY is interfaces 1 (notification EP 0x82) and 2 (data 0x03/0x83)
+#define USB_CONFIGURATION(ep) { \
+        TUD_CONFIG_DESCRIPTOR(1, 3 + ECHO_ITF_COUNT, 0, 0x20 + TUD_CDC_DESC_LEN + ECHO_ITF_DESC_LEN, 0x00, 100), \
+        0x09, 0x04, 0x00, 0x00, 0x02, 0xFF, 0xFF, 0xFF, 0x00, \
+        0x07, 0x05, 0x81, 0x02, U16_TO_U8S_LE(ep), 0x00, \
+        0x07, 0x05, 0x01, 0x02, U16_TO_U8S_LE(ep), 0x00, \
+        TUD_CDC_DESCRIPTOR(1, 4, 0x82, 8, 0x03, 0x83, ep), \
+        USB_ECHO_DESCRIPTOR(0x03, ep) \
+    }
+#else
+#define USB_CONFIGURATION(ep) { \
+        0x09, 0x02, 0x20 + ECHO_ITF_DESC_LEN, 0x00, 0x01 + ECHO_ITF_COUNT, 0x01, 0x00, 0x80, 0x32, \
+        0x09, 0x04, 0x00, 0x00, 0x02, 0xFF, 0xFF, 0xFF, 0x00, \
+        0x07, 0x05, 0x81, 0x02, U16_TO_U8S_LE(ep), 0x00, \
+        0x07, 0x05, 0x01, 0x02, U16_TO_U8S_LE(ep), 0x00, \
+        USB_ECHO_DESCRIPTOR(0x01, ep) \
+    }
+#endif
+#if CONFIG_TRITON_ECHO_EP
+#define USB_ECHO_DESCRIPTOR(itf, ep) \
+        0x09, 0x04, itf, 0x00, 0x01, 0xFF, 0xFF, 0xFF, 0x00, \
+        0x07, 0x05, ECHO_EP_ADDR, 0x02, U16_TO_U8S_LE(ep), 0x00,
+#else
+#define USB_ECHO_DESCRIPTOR(itf, ep)
+#endif
+
+static const uint8_t desc_configuration_fs[] = USB_CONFIGURATION(64);
+#if TUD_OPT_HIGH_SPEED
+static const uint8_t desc_configuration_hs[] = USB_CONFIGURATION(512);
+#endif
+
 uint8_t const * tud_descriptor_configuration_cb(uint8_t index) {
-    static const uint8_t desc_configuration[] = {
-        0x09, 0x02, 0x20, 0x00, 0x01, 0x01, 0x00, 0x80, 0x32,
-        0x09, 0x04, 0x00, 0x00, 0x02, 0xFF, 0xFF, 0xFF, 0x00,
-        0x07, 0x05, 0x81, 0x02, 0x40, 0x00, 0x00,
-        0x07, 0x05, 0x01, 0x02, 0x40, 0x00, 0x00
+#if TUD_OPT_HIGH_SPEED
+    if (tud_speed_get() == TUSB_SPEED_HIGH) return desc_configuration_hs;
+#endif
+    return desc_configuration_fs;
+}
+
+#if TUD_OPT_HIGH_SPEED
+// A high-speed device also says what it would be at the other speed
+uint8_t const * tud_descriptor_device_qualifier_cb(void) {
+    static const tusb_desc_device_qualifier_t desc_qualifier = {
+        .bLength = sizeof(tusb_desc_device_qualifier_t), .bDescriptorType = TUSB_DESC_DEVICE_QUALIFIER,
+        .bcdUSB = 0x0200, .bDeviceClass = USB_DEVICE_CLASS, .bMaxPacketSize0 = 64,
+        .bNumConfigurations = 0x01, .bReserved = 0x00
     };
-    return desc_configuration;
+    return (uint8_t const *) &desc_qualifier;
+}
+
+uint8_t const * tud_descriptor_other_speed_configuration_cb(uint8_t index) {
+    static uint8_t desc_other[sizeof(desc_configuration_fs)];
+    memcpy(desc_other, tud_speed_get() == TUSB_SPEED_HIGH ? desc_configuration_fs : desc_configuration_hs, sizeof(desc_other));
+    desc_other[1] = TUSB_DESC_OTHER_SPEED_CONFIG;
+    return desc_other;
+}
+#endif
+#if CONFIG_IDF_TARGET_ESP32P4
+#define USB_PRODUCT "ESP32-P4 CAN"
+#else
+#define USB_PRODUCT "ESP32-S3 CAN"
+#endif
+
+// Factory MAC from eFuse as 12 hex digits: unique per chip, so udev can name each adapter's interfaces
+static char usb_serial[13] = "000000000000";
+
+static void usb_serial_init(void) {
+    uint8_t mac[6];
+    if (esp_efuse_mac_get_default(mac) != ESP_OK) {
+        ESP_LOGW(TAG, "No eFuse MAC, serial number %s", usb_serial);
+        return;
+    }
+    snprintf(usb_serial, sizeof(usb_serial), "%02X%02X%02X%02X%02X%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    ESP_LOGI(TAG, "Serial number %s", usb_serial);
 }
+
 uint16_t const* tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
     static uint16_t _desc_str[32];
-    const char* str_arr[] = { (const char[]) { 0x09, 0x04 }, "Triton", "ESP32-S3 CAN", "1.0" };
+    const char* str_arr[] = { (const char[]) { 0x09, 0x04 }, "Triton", USB_PRODUCT, usb_serial, "TritonCAN log" };
     if (index == 0) {
         memcpy(&_desc_str[1], str_arr[0], 2); _desc_str[0] = (TUSB_DESC_STRING << 8 ) | (2 + 2);
         return _desc_str;
     }
-    if (index >= 4) return NULL;
+    if (index >= sizeof(str_arr) / sizeof(str_arr[0])) return NULL;
     const char* str = str_arr[index]; uint8_t len = (uint8_t) strlen(str); if (len > 31) len = 31;
     for (uint8_t i=0; i<len; i++) _desc_str[1+i] = str[i];
     _desc_str[0] = (TUSB_DESC_STRING << 8 ) | (2*len + 2);
     return _desc_str;
 }
 
+// --- TASK STATS ---
+// Whole image, not only the bridge: initialised and zeroed data in internal DRAM
+extern int _data_start, _data_end, _bss_start, _bss_end;
+
+static uint32_t static_dram_bytes(void) {
+    return (uint32_t)((uint8_t *)&_data_end - (uint8_t *)&_data_start) + (uint32_t)((uint8_t *)&_bss_end - (uint8_t *)&_bss_start);
+}
+
+static uint32_t heap_boot_free; // internal heap once every task is up
+
+// Filled in the SETUP stage of GS_USB_BREQ_TRITON_TASKS. uxTaskGetSystemState() holds the scheduler
+// for a few tens of us, in the USB task only, and only when a host asks.
+static void task_stats_snapshot(struct gs_triton_tasks *out) {
+    memset(out, 0, sizeof(*out));
+    out->time_us = (uint32_t)esp_timer_get_time();
+    for (uint32_t core = 0; core < portNUM_PROCESSORS; core++) {
+        out->isr_cycles += isr_time[core].cycles;
+        out->isr_count += isr_time[core].count;
+    }
+    out->cpu_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    out->static_dram = static_dram_bytes();
+    out->heap_boot_free = heap_boot_free;
+    out->heap_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    out->heap_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    static TaskStatus_t status[GS_TRITON_TASKS_MAX];
+    UBaseType_t n = uxTaskGetSystemState(status, GS_TRITON_TASKS_MAX, NULL); // 0: more tasks than fit
+    for (UBaseType_t i = 0; i < n; i++) {
+        struct gs_triton_task *t = &out->task[i];
+        BaseType_t core = xTaskGetCoreID(status[i].xHandle);
+        strncpy(t->name, status[i].pcTaskName, sizeof(t->name) - 1); // zeroed above: stays terminated
+        t->runtime_us = (uint32_t)status[i].ulRunTimeCounter;
+        t->stack_free = status[i].usStackHighWaterMark; // bytes: StackType_t is a byte here
+        t->core = core == tskNO_AFFINITY ? GS_TRITON_TASK_ANY_CORE : (uint8_t)core;
+        t->priority = (uint8_t)status[i].uxCurrentPriority;
+        t->state = (uint8_t)status[i].eCurrentState;
+    }
+    out->task_count = n;
+#endif
+}
+
 // --- USB CALLBACKS ---
+// Data stage of a control request. Requests from the SPI link (3.Y) go through the same callback.
+#if CONFIG_TRITON_SPI_LINK
+static bool control_xfer(uint8_t rhport, tusb_control_request_t const *request, void *buffer, uint16_t len);
+#else
+#define control_xfer tud_control_xfer
+#endif
+
 bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const * request) {
+    uint16_t ch = request->wValue; // channel, for the per-channel requests
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_MODE) {
+        fwd_notify();
+        return true;
+    }
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_USB_BATCH) {
+        if (usb_batch.max_frames < 1) usb_batch.max_frames = 1;
+        if (usb_batch.max_frames > USB_BATCH_MAX_FRAMES) usb_batch.max_frames = USB_BATCH_MAX_FRAMES;
+        TLOGI("USB batch: %lu frames / %lu us%s", usb_batch.max_frames, usb_batch.flush_us,
+              (usb_batch.flags & GS_TRITON_USB_BATCH_ADAPTIVE) ? ", adaptive" : "");
+        fwd_notify();
+        return true;
+    }
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_FILTER &&
+        !(request->bmRequestType & TUSB_DIR_IN_MASK) && ch < TRITON_CHANNELS) {
+        struct gs_triton_filter *filter = &channels[ch].rx_filter;
+        if (pending_filter.sw_count > GS_TRITON_SW_FILTERS) pending_filter.sw_count = GS_TRITON_SW_FILTERS;
+        // Software list takes effect immediately; publish the count last so the RX task never sees stale slots
+        filter->sw_count = 0;
+        memcpy(filter->sw, pending_filter.sw, sizeof(filter->sw));
+        filter->hw_code = pending_filter.hw_code;
+        filter->hw_mask = pending_filter.hw_mask;
+        filter->hw_single = pending_filter.hw_single;
+        filter->sw_count = pending_filter.sw_count;
+        TLOGI("CAN%u filter: hw %08lx/%08lx (%s), %lu sw entries", ch, filter->hw_code, filter->hw_mask,
+                 filter->hw_single ? "single" : "dual", filter->sw_count);
+        return true;
+    }
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_DECIMATE &&
+        !(request->bmRequestType & TUSB_DIR_IN_MASK) && ch < TRITON_CHANNELS) {
+        struct gs_triton_decimate *d = &channels[ch].decimate;
+        uint32_t count = pending_decimate.rule_count;
+        if (count > GS_TRITON_DECIMATE_RULES) count = GS_TRITON_DECIMATE_RULES;
+        for (uint32_t i = 0; i < count; i++) {
+            if (pending_decimate.rule[i].mode > GS_TRITON_DECIMATE_ON_CHANGE) {
+                TLOGW("CAN%u decimation rule %lu rejected: mode %lu", ch, i, pending_decimate.rule[i].mode);
+                return true;
+            }
+        }
+        // Same publish order as the filter; the RX task drops its per-ID state when it sees the new generation
+        d->rule_count = 0;
+        memcpy(d->rule, pending_decimate.rule, sizeof(d->rule));
+        channels[ch].decim_gen++;
+        d->rule_count = count;
+        TLOGI("CAN%u decimation: %lu rules", ch, count);
+        return true;
+    }
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_MAILBOX &&
+        !(request->bmRequestType & TUSB_DIR_IN_MASK) && ch < TRITON_CHANNELS) {
+        rx_mailbox_set(&channels[ch].mailbox, &pending_mailbox);
+        TLOGI("CAN%u mailbox: %lu IDs%s", ch, channels[ch].mailbox.count,
+              (pending_mailbox.flags & GS_TRITON_MAILBOX_CONSUME) ? ", not streamed" : "");
+        return true;
+    }
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_TX_DEADLINE &&
+        !(request->bmRequestType & TUSB_DIR_IN_MASK) && ch < TRITON_CHANNELS) {
+        struct gs_triton_tx_deadline *d = &channels[ch].tx_deadline;
+        uint32_t count = pending_tx_deadline.rule_count;
+        if (count > GS_TRITON_TX_DEADLINE_RULES) count = GS_TRITON_TX_DEADLINE_RULES;
+        // Same publish order as the filter: can_tx_task never sees a count ahead of its rules
+        d->rule_count = 0;
+        memcpy(d->rule, pending_tx_deadline.rule, sizeof(d->rule));
+        d->inflight_max = pending_tx_deadline.inflight_max;
+        d->rule_count = count;
+        TLOGI("CAN%u TX deadlines: %lu rules, in flight %lu", ch, count, d->inflight_max);
+        if (tx_task_handle) xTaskNotifyGive(tx_task_handle); // a lifted cap frees waiting frames
+        return true;
+    }
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_GATEWAY &&
+        !(request->bmRequestType & TUSB_DIR_IN_MASK)) {
+        if (!gateway_submit(&pending_gateway)) TLOGW("Gateway rule %lu rejected", pending_gateway.slot);
+        return true;
+    }
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_CYCLIC &&
+        !(request->bmRequestType & TUSB_DIR_IN_MASK)) {
+        if (!cyclic_submit(&pending_cyclic)) TLOGW("Cyclic slot %lu rejected", pending_cyclic.slot);
+        return true;
+    }
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_SERVO &&
+        !(request->bmRequestType & TUSB_DIR_IN_MASK)) {
+        if (!servo_submit_config(&pending_servo_config)) TLOGW("Servo config rejected");
+        return true;
+    }
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_SERVO_SETPOINT) {
+        servo_submit_setpoint(&pending_servo_setpoint);
+        return true;
+    }
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_MOTOR_CMD) {
+        if (!motor_cmd_submit(&pending_motor_cmd)) TLOGW("Motor command rejected: %lu motors", pending_motor_cmd.motor_count);
+        return true;
+    }
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_PACKED &&
+        !(request->bmRequestType & TUSB_DIR_IN_MASK)) {
+#if CONFIG_TRITON_SPI_LINK
+        if (!pending_packed.enable) {
+            TLOGW("Wire format: the SPI link is packed only");
+            return true;
+        }
+#endif
+        packed_mode = pending_packed.enable != 0;
+        TLOGI("Wire format: %s", packed_mode ? "packed" : "gs_usb");
+        return true;
+    }
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_ECHO_EP &&
+        !(request->bmRequestType & TUSB_DIR_IN_MASK)) {
+        echo_ep = pending_echo_ep.enable != 0;
+        TLOGI("Echoes on endpoint 0x%02x", echo_ep ? ECHO_EP_ADDR : 0x81);
+        fwd_notify();
+        return true;
+    }
+#if CONFIG_TRITON_TRACE
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_TRACE &&
+        !(request->bmRequestType & TUSB_DIR_IN_MASK)) {
+        trace_reset(pending_trace.every);
+        TLOGI("Trace: %s", pending_trace.every ? "on" : "off");
+        return true;
+    }
+#endif
+#if CONFIG_TRITON_FRAME_TRACE
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_FRAME_TRACE &&
+        !(request->bmRequestType & TUSB_DIR_IN_MASK)) {
+        ftrace_reset(&pending_ftrace);
+        TLOGI("Frame trace: stages 0x%lx, channels 0x%lx", pending_ftrace.stages, pending_ftrace.channels);
+        return true;
+    }
+#endif
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_SELFTEST &&
+        !(request->bmRequestType & TUSB_DIR_IN_MASK)) {
+        if (!selftest_arm(&pending_selftest)) TLOGW("Self-test config rejected");
+        else if (pending_selftest.flags & GS_TRITON_SELFTEST_ENABLE) TLOGI("Self-test armed: %lu pps, applied on the next start of CAN0", pending_selftest.rate_pps);
+        else TLOGI("Self-test disarmed");
+        return true;
+    }
+    if (stage == CONTROL_STAGE_ACK && request->bRequest == GS_USB_BREQ_TRITON_AUTOSTART &&
+        !(request->bmRequestType & TUSB_DIR_IN_MASK)) {
+        struct gs_triton_autostart config = pending_autostart;
+        config.flags &= GS_TRITON_AUTOSTART_ENABLE;
+        if (config.bt.brp == 0) config.bt = pending_bt[ch];
+        if ((config.flags & GS_TRITON_AUTOSTART_ENABLE) && config.bt.brp == 0) {
+            TLOGW("CAN%u autostart rejected: no bit timing", ch);
+            return true;
+        }
+        autostart[ch] = config;
+        autostart_save_mask |= 1u << ch;
+        fwd_notify();
+        return true;
+    }
     if (stage != CONTROL_STAGE_SETUP) return true;
+    switch (request->bRequest) {
+        case GS_USB_BREQ_BITTIMING:
+        case GS_USB_BREQ_DATA_BITTIMING:
+        case GS_USB_BREQ_MODE:
+        case GS_USB_BREQ_BT_CONST:
+        case GS_USB_BREQ_BT_CONST_EXT:
+        case GS_USB_BREQ_GET_STATE:
+        case GS_USB_BREQ_TRITON_FILTER:
+        case GS_USB_BREQ_TRITON_STATS:
+        case GS_USB_BREQ_TRITON_AUTOSTART:
+        case GS_USB_BREQ_TRITON_DECIMATE:
+        case GS_USB_BREQ_TRITON_TX_DEADLINE:
+        case GS_USB_BREQ_TRITON_MAILBOX:
+            if (ch >= TRITON_CHANNELS) return false; // stall: no such channel
+            break;
+        default:
+            break;
+    }
     switch (request->bRequest) {
         case GS_USB_BREQ_HOST_FORMAT: 
-            return tud_control_xfer(rhport, request, &pending_host_config, sizeof(struct gs_host_config));
+            return control_xfer(rhport, request, &pending_host_config, sizeof(struct gs_host_config));
         case GS_USB_BREQ_BITTIMING: 
-            return tud_control_xfer(rhport, request, &pending_bt, sizeof(struct gs_device_bittiming));
+            return control_xfer(rhport, request, &pending_bt[ch], sizeof(struct gs_device_bittiming));
+        case GS_USB_BREQ_DATA_BITTIMING:
+            return control_xfer(rhport, request, &pending_dbt[ch], sizeof(struct gs_device_bittiming));
+        case GS_USB_BREQ_TRITON_FILTER:
+            if (request->bmRequestType & TUSB_DIR_IN_MASK) pending_filter = channels[ch].rx_filter;
+            return control_xfer(rhport, request, &pending_filter, sizeof(struct gs_triton_filter));
         case GS_USB_BREQ_MODE: 
-            pending_mode.flags = MAGIC_FLAG;
-            return tud_control_xfer(rhport, request, &pending_mode, sizeof(struct gs_device_mode));
+            pending_mode[ch].flags = MAGIC_FLAG;
+            return control_xfer(rhport, request, &pending_mode[ch], sizeof(struct gs_device_mode));
         case GS_USB_BREQ_BT_CONST:
-            return tud_control_xfer(rhport, request, &bt_const, sizeof(struct gs_device_bt_const));
+            return control_xfer(rhport, request, &bt_const[ch], sizeof(struct gs_device_bt_const));
+        case GS_USB_BREQ_BT_CONST_EXT:
+            if (!(bt_const[ch].feature & GS_CAN_FEATURE_BT_CONST_EXT)) return false;
+            return control_xfer(rhport, request, &bt_const[ch], sizeof(struct gs_device_bt_const_extended));
         case GS_USB_BREQ_DEVICE_CONFIG:
-            return tud_control_xfer(rhport, request, &dconf, sizeof(struct gs_device_config));
+            return control_xfer(rhport, request, &dconf, sizeof(struct gs_device_config));
+        case GS_USB_BREQ_GET_STATE:
+            // Cached by the channel's CAN task, so this never touches the driver from the USB task
+            dev_state.state = channels[ch].stats.bus_state;
+            dev_state.rxerr = channels[ch].stats.rec;
+            dev_state.txerr = channels[ch].stats.tec;
+            return control_xfer(rhport, request, &dev_state, sizeof(struct gs_device_state));
+        case GS_USB_BREQ_TRITON_STATS: {
+            struct can_channel *c = &channels[ch];
+            c->stats.uptime_ms = (uint32_t)(esp_timer_get_time() / 1000);
+            stats_snapshot = c->stats;
+            stats_snapshot.latency_avg_us = c->stats.latency_samples ? (uint32_t)(c->latency_sum_us / c->stats.latency_samples) : 0;
+            stats_snapshot.echo_queue_hwm = channels[0].stats.echo_queue_hwm;
+            stats_snapshot.usb_transfers = channels[0].stats.usb_transfers;
+            stats_snapshot.usb_write_stalls = channels[0].stats.usb_write_stalls;
+            memcpy(&stats_snapshot.usb_flush_full, &channels[0].stats.usb_flush_full,
+                   offsetof(struct gs_triton_stats, usb_gap_max_ms) + sizeof(uint32_t) -
+                   offsetof(struct gs_triton_stats, usb_flush_full));
+            memcpy(stats_snapshot.hist_usb_in, channels[0].stats.hist_usb_in, sizeof(stats_snapshot.hist_usb_in));
+            memcpy(stats_snapshot.hist_tx_wake, channels[0].stats.hist_tx_wake, sizeof(stats_snapshot.hist_tx_wake));
+            c->stats.latency_min_us = 0; c->stats.latency_max_us = 0; c->stats.latency_samples = 0; c->latency_sum_us = 0;
+            c->stats.cyclic_late_max_us = 0;
+            return control_xfer(rhport, request, &stats_snapshot, sizeof(struct gs_triton_stats));
+        }
+        case GS_USB_BREQ_TIMESTAMP:
+            // Same 1 MHz esp_timer clock as the frame timestamps, wraps every ~71 minutes
+            timestamp_now = (uint32_t)esp_timer_get_time();
+            return control_xfer(rhport, request, &timestamp_now, sizeof(timestamp_now));
+        case GS_USB_BREQ_TRITON_CLOCK:
+            if (!(request->bmRequestType & TUSB_DIR_IN_MASK)) return false;
+            // Sampled in the SETUP stage. The IN data and status stages that follow make the exchange
+            // asymmetric by a fraction of the round trip; the host keeps only its fastest exchanges
+            clock_now.time_us = (uint64_t)esp_timer_get_time();
+            return control_xfer(rhport, request, &clock_now, sizeof(struct gs_triton_clock));
+        case GS_USB_BREQ_TRITON_RX_POLICY:
+            return control_xfer(rhport, request, &rx_policy, sizeof(struct gs_triton_rx_policy));
+        case GS_USB_BREQ_TRITON_USB_BATCH:
+            // A v1 host writes max_frames and flush_us only
+            if (!(request->bmRequestType & TUSB_DIR_IN_MASK) && request->wLength < sizeof(struct gs_triton_usb_batch)) {
+                usb_batch.flags = 0;
+            }
+            return control_xfer(rhport, request, &usb_batch, sizeof(struct gs_triton_usb_batch));
+        case GS_USB_BREQ_TRITON_CYCLIC:
+            if (request->bmRequestType & TUSB_DIR_IN_MASK) {
+                if (request->wValue >= GS_TRITON_CYCLIC_SLOTS) return false;
+                // A change still waiting for can_cyclic_task is what the slot is about to become
+                portENTER_CRITICAL(&cyclic_mux);
+                pending_cyclic = (cyclic_post_mask & (1u << request->wValue)) ? cyclic_post[request->wValue]
+                                                                            : cyclic_table[request->wValue].config;
+                portEXIT_CRITICAL(&cyclic_mux);
+            }
+            return control_xfer(rhport, request, &pending_cyclic, sizeof(struct gs_triton_cyclic));
+        case GS_USB_BREQ_TRITON_SERVO:
+            if (request->bmRequestType & TUSB_DIR_IN_MASK) {
+                servo_snapshot(&servo_state);
+                return control_xfer(rhport, request, &servo_state, sizeof(struct gs_triton_servo_state));
+            }
+            return control_xfer(rhport, request, &pending_servo_config, sizeof(struct gs_triton_servo_config));
+        case GS_USB_BREQ_TRITON_SERVO_SETPOINT:
+            if (request->bmRequestType & TUSB_DIR_IN_MASK) return false;
+            // Short transfers are fine: only the first motor_count targets are used
+            return control_xfer(rhport, request, &pending_servo_setpoint, sizeof(struct gs_triton_servo_setpoint));
+        case GS_USB_BREQ_TRITON_MOTOR_CMD:
+            if (request->bmRequestType & TUSB_DIR_IN_MASK) return false;
+            return control_xfer(rhport, request, &pending_motor_cmd, sizeof(struct gs_triton_motor_cmd)); // short is fine
+        case GS_USB_BREQ_TRITON_PACKED:
+            if (request->bmRequestType & TUSB_DIR_IN_MASK) {
+                pending_packed.enable = packed_mode;
+            } else if (any_channel_started()) {
+                return false; // the stream format can't change under running channels
+            }
+            return control_xfer(rhport, request, &pending_packed, sizeof(struct gs_triton_packed));
+        case GS_USB_BREQ_TRITON_ECHO_EP:
+            if (request->bmRequestType & TUSB_DIR_IN_MASK) {
+                pending_echo_ep.enable = echo_ep;
+                pending_echo_ep.endpoint = ECHO_EP_ADDR;
+            } else if (!ECHO_EP_ADDR || any_channel_started()) {
+                return false; // not built in, or echoes would move under running channels
+            }
+            return control_xfer(rhport, request, &pending_echo_ep, sizeof(struct gs_triton_echo_ep));
+        case GS_USB_BREQ_TRITON_TRACE:
+#if CONFIG_TRITON_TRACE
+            if (!(request->bmRequestType & TUSB_DIR_IN_MASK)) {
+                return control_xfer(rhport, request, &pending_trace, sizeof(struct gs_triton_trace_config));
+            }
+            trace_read(&trace_snapshot);
+            return control_xfer(rhport, request, &trace_snapshot, offsetof(struct gs_triton_trace, event) +
+                                    trace_snapshot.count * sizeof(struct gs_triton_trace_event));
+#else
+            return false; // not built in
+#endif
+        case GS_USB_BREQ_TRITON_FRAME_TRACE:
+#if CONFIG_TRITON_FRAME_TRACE
+            if (!(request->bmRequestType & TUSB_DIR_IN_MASK)) {
+                return control_xfer(rhport, request, &pending_ftrace, sizeof(struct gs_triton_ftrace_config));
+            }
+            if (request->wLength < offsetof(struct gs_triton_ftrace, record)) return false;
+            // No more than the host asked for: what does not fit stays in the ring
+            ftrace_read(&ftrace_snapshot, (request->wLength - offsetof(struct gs_triton_ftrace, record)) /
+                                              sizeof(struct gs_triton_ftrace_record));
+            return control_xfer(rhport, request, &ftrace_snapshot, offsetof(struct gs_triton_ftrace, record) +
+                                    ftrace_snapshot.count * sizeof(struct gs_triton_ftrace_record));
+#else
+            return false; // not built in
+#endif
+        case GS_USB_BREQ_TRITON_SELFTEST:
+            if (request->bmRequestType & TUSB_DIR_IN_MASK) {
+                selftest_snapshot(&selftest_state);
+                return control_xfer(rhport, request, &selftest_state, sizeof(struct gs_triton_selftest_result));
+            }
+            return control_xfer(rhport, request, &pending_selftest, sizeof(struct gs_triton_selftest_config));
+        case GS_USB_BREQ_TRITON_AUTOSTART:
+            if (request->bmRequestType & TUSB_DIR_IN_MASK) {
+                pending_autostart = autostart[ch];
+                if (channels[ch].holding && !channels[ch].detached) pending_autostart.flags |= GS_TRITON_AUTOSTART_ACTIVE;
+            }
+            return control_xfer(rhport, request, &pending_autostart, sizeof(struct gs_triton_autostart));
+        case GS_USB_BREQ_TRITON_GATEWAY:
+            if (request->bmRequestType & TUSB_DIR_IN_MASK) {
+                if (request->wValue >= GS_TRITON_GATEWAY_RULES) return false;
+                pending_gateway = gateway_table[request->wValue];
+            }
+            return control_xfer(rhport, request, &pending_gateway, sizeof(struct gs_triton_gateway_rule));
+        case GS_USB_BREQ_TRITON_DECIMATE:
+            if (request->bmRequestType & TUSB_DIR_IN_MASK) pending_decimate = channels[ch].decimate;
+            return control_xfer(rhport, request, &pending_decimate, sizeof(struct gs_triton_decimate));
+        case GS_USB_BREQ_TRITON_TX_DEADLINE:
+            if (request->bmRequestType & TUSB_DIR_IN_MASK) pending_tx_deadline = channels[ch].tx_deadline;
+            return control_xfer(rhport, request, &pending_tx_deadline, sizeof(struct gs_triton_tx_deadline));
+        case GS_USB_BREQ_TRITON_MAILBOX:
+            if (!(request->bmRequestType & TUSB_DIR_IN_MASK)) {
+                return control_xfer(rhport, request, &pending_mailbox, sizeof(struct gs_triton_mailbox_config));
+            }
+            rx_mailbox_read(&channels[ch].mailbox, &mailbox_snapshot);
+            mailbox_snapshot.time_us = (uint32_t)esp_timer_get_time();
+            return control_xfer(rhport, request, &mailbox_snapshot, sizeof(struct gs_triton_mailbox));
+        case GS_USB_BREQ_TRITON_TASKS:
+            if (!(request->bmRequestType & TUSB_DIR_IN_MASK)) return false;
+            task_stats_snapshot(&task_stats);
+            return control_xfer(rhport, request, &task_stats, sizeof(struct gs_triton_tasks));
+        case GS_USB_BREQ_TRITON_CAPS:
+            if (!(request->bmRequestType & TUSB_DIR_IN_MASK)) return false;
+            caps_fill(&caps);
+            return control_xfer(rhport, request, &caps, sizeof(struct gs_triton_caps));
         default: 
-            return tud_control_xfer(rhport, request, NULL, 0);
+            return control_xfer(rhport, request, NULL, 0);
     }
 }
 
-void tud_vendor_rx_cb(uint8_t itf) {
-    if (!is_can_started) { tud_vendor_read_flush(); return; }
-    
-    struct gs_host_frame frame;
-    while (tud_vendor_available() >= sizeof(frame)) {
-        if (tud_vendor_read(&frame, sizeof(frame)) == sizeof(frame)) {
-            twai_message_t msg = {0};
-            msg.identifier = frame.can_id; 
-            msg.data_length_code = frame.can_dlc;
-            if (frame.can_id & 0x80000000) { 
-                msg.extd = 1; msg.identifier &= 0x1FFFFFFF; 
-            }
-            memcpy(msg.data, frame.data, 8);
-            
-            // Transmit to Physical Bus
-            if (twai_transmit(&msg, 0) == ESP_OK) {
-                tx_pps++;
-                
-                // === FIX START: Send Echo back to Linux ===
-                // Linux gs_usb driver waits for this to free the buffer slot
-                struct gs_host_frame echo_frame;
-                memset(&echo_frame, 0, sizeof(echo_frame));
-                
-                echo_frame.echo_id = frame.echo_id; // CRITICAL: Match the ID Linux sent
-                echo_frame.can_id = frame.can_id;
-                echo_frame.can_dlc = frame.can_dlc;
-                echo_frame.channel = frame.channel;
-                echo_frame.flags = 0; // 0 = Normal Frame (Echo)
-                memcpy(echo_frame.data, frame.data, 8);
-                
-                // Send to the same queue that handles RX frames
-                xQueueSend(can_to_usb_queue, &echo_frame, 0);
-                // === FIX END ===
-
-                #if DEBUG_ALL_FRAMES
-                ESP_LOGI(TAG, "TX -> ID: %lx", msg.identifier);
-                #endif
-            }
-        }
+// Host data came in: mark its arrival and wake can_tx_task. available: bytes now waiting to be read.
+static void out_arrived(uint32_t available) {
+    stage_mark(&tx_wake_us);
+    uint32_t head = out_marks.head;
+    if (head - __atomic_load_n(&out_marks.tail, __ATOMIC_ACQUIRE) < OUT_MARKS) {
+        out_marks.mark[head % OUT_MARKS].end = __atomic_load_n(&out_marks.read, __ATOMIC_RELAXED) + available;
+        out_marks.mark[head % OUT_MARKS].time_us = (uint32_t)esp_timer_get_time();
+        __atomic_store_n(&out_marks.head, head + 1, __ATOMIC_RELEASE);
     }
+    if (tx_task_handle) xTaskNotifyGive(tx_task_handle);
 }
 
-// --- TASKS ---
-void usb_manager_task(void *arg) {
-    ESP_LOGI(TAG, "USB Manager Started");
-    int stats_timer = 0;
-    while (1) {
-        tud_task(); 
-        
-        // Stats: 100 ticks = 1 second (at 100Hz tick rate)
-        if (++stats_timer % 100 == 0) {
-            if (is_can_started) {
-                // Only print if there is activity to reduce noise
-                if (rx_pps > 0 || tx_pps > 0) {
-                    ESP_LOGI(TAG, "STATS | RX: %lu pps | TX: %lu pps | Last ID: %03lx", rx_pps, tx_pps, last_can_id);
-                }
-            }
-            rx_pps = 0; tx_pps = 0;
-        }
-        vTaskDelay(1); 
+// Host frames are pulled from the OUT FIFO by can_tx_task, so a full TX path NAKs the host
+void tud_vendor_rx_cb(uint8_t itf) {
+    out_arrived(tud_vendor_available());
+}
+
+// IN transfer finished: wake the forwarder so the next frame is staged right away
+void tud_vendor_tx_cb(uint8_t itf, uint32_t sent_bytes) {
+    if (itf == 0) {
+        stage_close(&usb_flush_us, channels[0].stats.hist_usb_in); // RX batches only
+        trace_in_done();
+        // TinyUSB sends what is left in the FIFO as soon as this returns
+        usb_in_busy = tud_vendor_write_available() < CFG_TUD_VENDOR_TX_BUFSIZE;
+        usb_in_done++;
     }
+    fwd_notify();
 }
 
-void can_forward_task(void *arg) {
-    struct gs_host_frame frame;
-    while (!tud_mounted()) vTaskDelay(pdMS_TO_TICKS(100));
-    ESP_LOGI(TAG, "USB Mounted - System Ready");
+// Runs on the USB task, before the new host's first request
+static void usb_session_end(void) {
+    usb_session_live = false;
+    usb_session++;
+    usb_gap_start_us = esp_timer_get_time();
+    usb_detach_pending = true;
+    channels[0].stats.usb_sessions_lost++;
+}
 
-    while (1) { 
-        if (pending_mode.flags != MAGIC_FLAG) {
-             if (pending_mode.mode == GS_CAN_MODE_START) start_can(&pending_bt);
-             else if (pending_mode.mode == GS_CAN_MODE_RESET) stop_can();
-             pending_mode.flags = MAGIC_FLAG; 
-        }
+void tud_mount_cb(void) {
+    if (usb_session_live) usb_session_end(); // re-enumerated without an unmount
+    usb_session_live = true;
+    packed_mode = false; // every new host session starts out speaking gs_usb
+    echo_ep = false;
+#if CONFIG_TRITON_TRACE
+    trace_reset(0);
+#endif
+#if CONFIG_TRITON_FRAME_TRACE
+    ftrace_reset(&(struct gs_triton_ftrace_config){ 0 });
+#endif
+    fwd_notify();
+}
 
-        while (uxQueueMessagesWaiting(can_to_usb_queue) > 0) {
-            if (tud_vendor_write_available() < sizeof(struct gs_host_frame)) break;
-            if (xQueueReceive(can_to_usb_queue, &frame, 0) == pdTRUE) {
-                if (tud_vendor_write(&frame, sizeof(frame)) == sizeof(frame)) {
-                     tud_vendor_write_flush();
-                }
-            }
-        }
-        vTaskDelay(1);
-    }
+void tud_umount_cb(void) {
+    if (usb_session_live) usb_session_end();
+    fwd_notify();
 }
 
-void can_rx_task(void *arg) {
-    twai_message_t msg; 
-    struct gs_host_frame frame;
-    ESP_LOGI(TAG, "CAN Listener Ready");
+// Suspend keeps the session: the channels run on and their rings fill until the host resumes
+void tud_suspend_cb(bool remote_wakeup_en) {
+    (void)remote_wakeup_en;
+    channels[0].stats.usb_suspends++;
+}
 
-    while (1) {
-        if (!is_can_started) { vTaskDelay(pdMS_TO_TICKS(100)); continue; }
-        if (twai_receive(&msg, pdMS_TO_TICKS(50)) == ESP_OK) {
-            rx_pps++;
-            last_can_id = msg.identifier;
-            
-            #if DEBUG_ALL_FRAMES
-            ESP_LOGI(TAG, "RX <- ID: %lx", msg.identifier);
-            #endif
+void tud_resume_cb(void) {
+    fwd_notify();
+}
 
-            memset(&frame, 0, sizeof(frame));
-            frame.echo_id = 0xFFFFFFFF; 
-            frame.can_id = msg.identifier;
-            if (msg.extd) frame.can_id |= 0x80000000;
-            frame.can_dlc = msg.data_length_code;
-            memcpy(frame.data, msg.data, 8);
-            xQueueSend(can_to_usb_queue, &frame, 0);
-        }
+static void batch_timer_cb(void *arg) {
+    fwd_notify();
+}
+
+// Ends a batch once it is sealed and fully completed: one ack record instead of per-frame echoes
+static void packed_batch_update(uint32_t idx, int sent, int failed, int outstanding, bool seal) {
+    struct packed_batch done = { 0 };
+    portENTER_CRITICAL(&packed_mux);
+    struct packed_batch *b = &packed_batches[idx];
+    b->sent += sent;
+    b->failed += failed;
+    b->outstanding += outstanding;
+    if (seal) b->sealed = true;
+    if (b->in_use && b->sealed && b->outstanding == 0) {
+        done = *b;
+        b->in_use = false;
     }
+    portEXIT_CRITICAL(&packed_mux);
+    if (!done.in_use) return;
+
+    struct gs_host_frame ack = { .echo_id = PACKED_ACK_ECHO_ID, .can_id = done.batch_id, .can_dlc = 4 };
+    struct gs_triton_packed_ack body = { .sent = done.sent, .failed = done.failed };
+    memcpy(ack.data, &body, sizeof(body));
+    ack.timestamp_us = (uint32_t)esp_timer_get_time();
+    if (xQueueSend(echo_queue, &ack, pdMS_TO_TICKS(10)) != pdTRUE) { channels[0].stats.echo_dropped++; return; }
+    fwd_notify();
+}
+
+// Linux gs_usb waits for this echo to free the buffer slot, so every host frame gets exactly one.
+// done_us, the echo's timestamp, is when the controller reported the frame sent (or failed), on the
+// esp_timer clock of the RX timestamps.
+static void tx_echo_at(const struct gs_host_frame *frame, bool failed, uint32_t done_us) {
+    struct can_channel *c = &channels[frame->channel];
+    if (!failed) STAGE_SAMPLE(c->stats.hist_tx_done, done_us - frame->timestamp_us); // submit time, see twai_send()
+    ftrace(c, GS_TRITON_FTRACE_TX_DONE, frame->can_id, frame->can_dlc,
+           failed ? GS_CAN_FLAG_TRITON_TX_FAILED | (frame->flags & GS_CAN_FLAG_TRITON_TX_EXPIRED) : 0, failed, done_us);
+    if (frame->echo_id == CYCLIC_ECHO_ID) {
+        if (failed) c->stats.cyclic_missed++; else c->stats.cyclic_frames++;
+        return;
+    }
+    if (frame->echo_id == SERVO_ECHO_ID) {
+        if (failed) servo_commands_failed++; else servo_commands++;
+        return;
+    }
+    if (frame->echo_id == SELFTEST_ECHO_ID) {
+        if (failed) selftest_result.tx_failed++;
+        return;
+    }
+    if ((frame->echo_id & PACKED_ECHO_MASK) == GATEWAY_ECHO_BASE) {
+        struct gs_triton_gateway_rule *r = &gateway_table[frame->echo_id % GS_TRITON_GATEWAY_RULES];
+        if (failed) r->failed++; else r->sent++;
+        return;
+    }
+    if (failed) c->stats.tx_failed++; else c->stats.tx_frames++;
+    if (frame->reserved != usb_session) {
+        c->stats.tx_echo_stale++; // sent for a host that has gone since
+        return;
+    }
+    if ((frame->echo_id & PACKED_ECHO_MASK) == PACKED_ECHO_BASE) {
+        packed_batch_update(frame->echo_id & ~PACKED_ECHO_MASK, !failed, failed, -1, false);
+        return;
+    }
+    struct gs_host_frame echo_frame = *frame; // CRITICAL: echo_id must match the ID Linux sent
+    echo_frame.flags = failed ? GS_CAN_FLAG_TRITON_TX_FAILED | (frame->flags & GS_CAN_FLAG_TRITON_TX_EXPIRED) : 0;
+    echo_frame.reserved = 0;
+    echo_frame.timestamp_us = done_us;
+    if (TRACE_SAMPLE(c)) {
+        trace_put(GS_TRITON_TRACE_TX_DONE, c->index, frame->can_id, frame->timestamp_us, done_us);
+        echo_frame.flags |= RX_FLAG_TRACE;
+    }
+    if (xQueueSend(echo_queue, &echo_frame, pdMS_TO_TICKS(10)) != pdTRUE) { c->stats.echo_dropped++; return; }
+    uint32_t depth = uxQueueMessagesWaiting(echo_queue);
+    if (depth > channels[0].stats.echo_queue_hwm) channels[0].stats.echo_queue_hwm = depth;
+    fwd_notify();
+}
+
+// Frames failed before they reach the controller: now is when
+static void tx_echo(const struct gs_host_frame *frame, bool failed) {
+    tx_echo_at(frame, failed, (uint32_t)esp_timer_get_time());
+}
+
+// --- LOG OUTPUT ---
+static void log_emit(uint8_t level, uint32_t time_ms, const char *msg) {
+    char line[LOG_LINE_MAX + 32];
+    int n = snprintf(line, sizeof(line), "%c (%lu) %s: %s\n", "NEWIDV"[level < 6 ? level : 0], time_ms, TAG, msg);
+    if (n >= (int)sizeof(line)) n = sizeof(line) - 1;
+    esp_log_write(level, TAG, "%s", line);
+#if CONFIG_TRITON_LOG_CDC
+    // Nobody listening (DTR low): nothing is queued, so attaching later starts with fresh lines
+    if (tud_cdc_connected()) {
+        tud_cdc_write(line, (uint32_t)n);
+        tud_cdc_write_flush();
+    }
+#endif
+}
+
+static void log_drain(void) {
+    static uint32_t dropped_reported = 0;
+    while (1) {
+        struct log_record *slot = &log_ring[log_tail & (LOG_RING_LEN - 1)];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != log_tail + 1) break; // empty, or still being written
+        struct log_record r = *slot;
+        __atomic_store_n(&slot->seq, log_tail + LOG_RING_LEN, __ATOMIC_RELEASE);
+        log_tail++;
+        uint32_t *a = r.args;
+        char msg[LOG_LINE_MAX];
+        snprintf(msg, sizeof(msg), r.fmt, a[0], a[1], a[2], a[3], a[4], a[5]);
+        log_emit(r.level, r.time_ms, msg);
+    }
+    uint32_t dropped = __atomic_load_n(&log_dropped, __ATOMIC_RELAXED);
+    if (dropped != dropped_reported) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "log ring full, %lu messages lost", dropped - dropped_reported);
+        log_emit(ESP_LOG_WARN, (uint32_t)(esp_timer_get_time() / 1000), msg);
+        dropped_reported = dropped;
+    }
+}
+
+static void stats_print(void) {
+    static struct gs_triton_stats last[TRITON_CHANNELS];
+    for (uint32_t ch = 0; ch < TRITON_CHANNELS; ch++) {
+        const struct gs_triton_stats *s = &channels[ch].stats;
+        // Only print if there is activity to reduce noise
+        if (channels[ch].started && (s->rx_frames != last[ch].rx_frames || s->tx_frames != last[ch].tx_frames)) {
+            char msg[LOG_LINE_MAX];
+            snprintf(msg, sizeof(msg), "STATS CAN%lu | RX: %lu pps (%lu filtered, %lu dropped) | TX: %lu pps (%lu failed) | Bus: TEC %lu REC %lu, %lu errors | Last ID: %03lx | Batch: %lu avg %lu max (limit %lu) | Echo wait: %lu avg %lu max us",
+                     ch, s->rx_frames - last[ch].rx_frames, s->rx_filtered - last[ch].rx_filtered,
+                     s->rx_dropped - last[ch].rx_dropped, s->tx_frames - last[ch].tx_frames,
+                     s->tx_failed - last[ch].tx_failed, s->tec, s->rec,
+                     s->bus_errors - last[ch].bus_errors, last_can_id,
+                     batch_count ? batch_frames / batch_count : 0, batch_max, usb_batch.max_frames,
+                     echo_count ? echo_wait_us / echo_count : 0, echo_wait_max_us);
+            log_emit(ESP_LOG_INFO, (uint32_t)(esp_timer_get_time() / 1000), msg);
+        }
+        last[ch] = *s;
+    }
+    batch_count = 0; batch_frames = 0; batch_max = 0;
+    echo_count = 0; echo_wait_us = 0; echo_wait_max_us = 0;
+}
+
+// Once a second from the esp_timer task; the printing itself is log_task's job, so neither the
+// USB task nor the esp_timer task (which also runs the batch deadline) ever waits for the UART
+static void stats_timer_cb(void *arg) {
+    if (log_task_handle) xTaskNotify(log_task_handle, LOG_NOTIFY_STATS, eSetBits);
+}
+
+// Lowest priority: it only runs when nothing else wants the core, and a slow console costs
+// dropped log lines instead of CAN or USB time
+void log_task(void *arg) {
+    while (1) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, pdMS_TO_TICKS(20));
+        log_drain();
+        if (bits & LOG_NOTIFY_STATS) stats_print();
+    }
+}
+
+// --- TASKS ---
+// tud_task() blocks on TinyUSB's event queue until the USB ISR posts something, then handles
+// every queued event. Nothing else may delay the loop: a control request is answered as soon as
+// its SETUP packet lands, not on the next RTOS tick.
+void usb_manager_task(void *arg) {
+    TLOGI("USB Manager Started");
+    while (1) {
+        tud_task();
+    }
+}
+
+static void usb_flush_batch(uint32_t frames) {
+    tud_vendor_write_flush();
+    usb_in_busy = true;
+    stage_mark(&usb_flush_us);
+    trace_flushed();
+    channels[0].stats.usb_transfers++;
+    batch_count++;
+    batch_frames += frames;
+    if (frames > batch_max) batch_max = frames;
+}
+
+static bool fwd_pop_echo(struct gs_host_frame *frame) {
+    if (xQueueReceive(echo_queue, frame, 0) != pdTRUE) return false;
+    if (frame->echo_id != 0xFFFFFFFF) {
+        // timestamp_us is the TX completion interrupt: can_event_task plus the wait in echo_queue
+        uint32_t wait = (uint32_t)esp_timer_get_time() - frame->timestamp_us;
+        echo_count++;
+        echo_wait_us += wait;
+        if (wait > echo_wait_max_us) echo_wait_max_us = wait;
+        STAGE_SAMPLE(channels[frame->channel].stats.hist_echo_dwell, wait);
+        if (frame->flags & RX_FLAG_TRACE) {
+            frame->flags &= ~RX_FLAG_TRACE;
+            trace_fifo(GS_TRITON_TRACE_TX_ECHO, frame->channel, frame->can_id, frame->timestamp_us,
+                       frame->timestamp_us + wait);
+        }
+    }
+    return true;
+}
+
+// Producer side, called by the channel's RX task only. flags may carry RX_FLAG_SELFTEST; the trace
+// sample adds RX_FLAG_TRACE.
+// Returns false when full.
+static IRAM_ATTR bool rx_ring_push(struct can_channel *c, uint32_t can_id, uint8_t dlc, uint8_t flags,
+                                   const uint8_t *data, uint32_t ts) {
+    struct rx_ring *ring = &c->rx_ring;
+    flags |= TRACE_SAMPLE(c);
+    if (!rx_ring_put(ring, c->index, can_id, dlc, flags, data, ts)) {
+        c->stats.rx_dropped++;
+        ftrace(c, GS_TRITON_FTRACE_RX, can_id, dlc, flags, 1, ts);
+        return false;
+    }
+    ftrace(c, GS_TRITON_FTRACE_RX, can_id, dlc, flags, 0, ts);
+    if (flags & RX_FLAG_TRACE) trace_put(GS_TRITON_TRACE_RX_RING, c->index, can_id, ts, (uint32_t)esp_timer_get_time());
+    uint32_t depth = ring->head - ring->tail;
+    if (depth > c->stats.rx_ring_hwm) c->stats.rx_ring_hwm = depth;
+    fwd_notify();
+    return true;
+}
+
+// Host is not keeping up: make room in the ring according to rx_policy. DROP_NEWEST keeps every
+// frame it can, so it first moves the oldest to the PSRAM tier while that has room; the evicting
+// policies want fresh frames, which a backlog in PSRAM would only delay.
+static void rx_ring_evict_channel(struct can_channel *c) {
+    // An autostarted ring has no reader yet: keep the latest bus state rather than the first frames
+    // after boot. A detached one keeps its policy, and so the PSRAM tier, for the host coming back.
+    uint32_t policy = (c->holding && !c->detached && rx_policy.policy == GS_TRITON_RX_DROP_NEWEST) ? GS_TRITON_RX_DROP_OLDEST : rx_policy.policy;
+    if (policy == GS_TRITON_RX_DROP_NEWEST) {
+        bool empty = rx_spill_count(&c->rx_spill) == 0;
+        uint32_t moved = rx_spill_absorb(&c->rx_spill, &c->rx_ring);
+        if (moved) {
+            c->stats.rx_spilled += moved;
+            if (empty) c->stats.rx_spill_bursts++;
+            uint32_t depth = rx_spill_count(&c->rx_spill);
+            if (depth > c->stats.rx_spill_hwm) c->stats.rx_spill_hwm = depth;
+        }
+    }
+    c->stats.rx_evicted += rx_ring_evict(&c->rx_ring, policy);
+}
+
+static void fwd_latency_sample(struct can_channel *c, uint32_t lat) {
+    if (c->stats.latency_samples == 0 || lat < c->stats.latency_min_us) c->stats.latency_min_us = lat;
+    if (lat > c->stats.latency_max_us) c->stats.latency_max_us = lat;
+    c->latency_sum_us += lat;
+    c->stats.latency_samples++;
+    STAGE_SAMPLE(c->stats.hist_rx_dwell, lat);
+}
+
+struct fwd_visit {
+    struct can_channel *c;
+    uint32_t now;
+};
+
+static void fwd_visit_frame(void *ctx, struct gs_host_frame *f) {
+    struct fwd_visit *v = ctx;
+    uint32_t lat = v->now - *frame_timestamp(f);
+    fwd_latency_sample(v->c, lat);
+    if (f->flags & RX_FLAG_SELFTEST) {
+        f->flags &= ~RX_FLAG_SELFTEST;
+        selftest_usb_sample(lat);
+    }
+    if (f->flags & RX_FLAG_TRACE) {
+        f->flags &= ~RX_FLAG_TRACE;
+        trace_fifo(GS_TRITON_TRACE_RX_FIFO, v->c->index, f->can_id, *frame_timestamp(f), v->now);
+    }
+}
+
+// Write up to n frames of one channel's contiguous run, from the PSRAM tier while it holds any
+// (those are the older frames), as far as they fit whole into the FIFO. Returns how many were written.
+static uint32_t fwd_write_ring(struct can_channel *c, uint32_t n) {
+    bool spill = rx_spill_count(&c->rx_spill) != 0;
+    // Tell SocketCAN about frames lost since the last delivery (counted as rx_over_errors)
+    uint32_t lost = c->stats.rx_dropped + c->stats.rx_evicted;
+    if (lost != c->rx_lost_reported) {
+        struct gs_host_frame *first = spill ? rx_spill_slot(&c->rx_spill, c->rx_spill.tail)
+                                            : rx_ring_slot(&c->rx_ring, c->rx_ring.tail);
+        first->flags |= GS_CAN_FLAG_OVERFLOW;
+        c->rx_lost_reported = lost;
+    }
+    struct fwd_visit v = { .c = c, .now = (uint32_t)esp_timer_get_time() };
+    if (spill) return rx_spill_write_usb(&c->rx_spill, n, usb_frame_size, fwd_visit_frame, &v);
+    return rx_ring_write_usb(&c->rx_ring, n, usb_frame_size, fwd_visit_frame, &v);
+}
+
+static uint32_t fwd_rx_count(const struct can_channel *c) {
+    uint32_t n = rx_spill_count(&c->rx_spill);
+    return n ? n : rx_ring_count(&c->rx_ring);
+}
+
+// Write up to max_frames frames for the host, echoes first (unless they have their own endpoint),
+// then the channel rings in turn. Returns how many were written.
+static uint32_t fwd_write(uint32_t max_frames) {
+    static uint32_t next_channel = 0;
+    struct gs_host_frame frame;
+    if (max_frames == 0) return 0;
+    if (!echo_ep && fwd_pop_echo(&frame)) {
+        return tud_vendor_write(&frame, usb_frame_size) == usb_frame_size ? 1 : 0;
+    }
+    for (uint32_t k = 0; k < TRITON_CHANNELS; k++) {
+        uint32_t ch = (next_channel + k) % TRITON_CHANNELS;
+        if (channels[ch].holding) continue;
+        uint32_t n = fwd_rx_count(&channels[ch]);
+        if (n == 0) continue;
+        next_channel = (ch + 1) % TRITON_CHANNELS; // a busy channel can't starve the others
+        return fwd_write_ring(&channels[ch], n > max_frames ? max_frames : n);
+    }
+    return 0;
+}
+
+// --- PACKED WIRE FORMAT ---
+struct packed_builder {
+    uint8_t *buf;
+    uint32_t pos, cap, records;
+    uint32_t base_us; // block timestamp: time of the first record
+};
+
+static bool packed_append(struct packed_builder *b, uint32_t time_us, uint8_t type, uint8_t channel, uint8_t flags,
+                          uint32_t can_id, const uint8_t *data, uint8_t len) {
+    if (b->pos + sizeof(struct gs_triton_packed_record) + len > b->cap) return false;
+    if (b->records == 0) b->base_us = time_us;
+    int32_t delta = (int32_t)(time_us - b->base_us); // sources interleave, so it can be negative
+    if (delta > INT16_MAX || delta < INT16_MIN) return false;
+    struct gs_triton_packed_record rec = {
+        .len = len, .flags = flags, .chan_type = (uint8_t)(type << 4 | (channel & 0xF)),
+        .delta_us = (int16_t)delta, .can_id = can_id,
+    };
+    memcpy(b->buf + b->pos, &rec, sizeof(rec));
+    memcpy(b->buf + b->pos + sizeof(rec), data, len);
+    b->pos += sizeof(rec) + len;
+    b->records++;
+    return true;
+}
+
+// Fills one block from echo_queue (acks and error frames) and then the rings, each only if asked
+// for. Returns its length, 0 when there was nothing to send.
+static uint32_t packed_build(uint8_t *buf, uint32_t cap, uint32_t *records, bool echoes, bool rings) {
+    static uint32_t next_channel = 0;
+    struct packed_builder b = { .buf = buf, .pos = sizeof(struct gs_triton_packed_block), .cap = cap };
+    struct gs_host_frame frame;
+    while (echoes && xQueuePeek(echo_queue, &frame, 0) == pdTRUE) {
+        bool ack = frame.echo_id == PACKED_ACK_ECHO_ID;
+        if (!packed_append(&b, frame.timestamp_us, ack ? GS_TRITON_REC_TX_ACK : GS_TRITON_REC_FRAME, frame.channel,
+                           frame.flags, frame.can_id, frame.data, ack ? sizeof(struct gs_triton_packed_ack) : 8)) break;
+        fwd_pop_echo(&frame);
+    }
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    for (uint32_t k = 0; rings && k < TRITON_CHANNELS; k++) {
+        struct can_channel *c = &channels[(next_channel + k) % TRITON_CHANNELS];
+        struct rx_ring *ring = &c->rx_ring;
+        struct rx_spill *spill = &c->rx_spill;
+        while (fwd_rx_count(c)) {
+            // The PSRAM tier holds the older frames
+            bool spilled = rx_spill_count(spill) != 0;
+            struct gs_host_frame *f = spilled ? rx_spill_slot(spill, spill->tail) : rx_ring_slot(ring, ring->tail);
+            uint8_t flags = f->flags & ~(RX_FLAG_SELFTEST | RX_FLAG_TRACE);
+            uint32_t lost = c->stats.rx_dropped + c->stats.rx_evicted;
+            if (lost != c->rx_lost_reported) flags |= GS_CAN_FLAG_OVERFLOW;
+            uint8_t len = (flags & GS_CAN_FLAG_FD) ? gs_can_fd_dlc2len(f->can_dlc) : (f->can_dlc > 8 ? 8 : f->can_dlc);
+            uint32_t ts = *frame_timestamp(f);
+            if (!packed_append(&b, ts, GS_TRITON_REC_FRAME, c->index, flags, f->can_id, f->data, len)) goto full;
+            c->rx_lost_reported = lost;
+            fwd_latency_sample(c, now - ts);
+            if (f->flags & RX_FLAG_SELFTEST) selftest_usb_sample(now - ts);
+            if (f->flags & RX_FLAG_TRACE) trace_fifo(GS_TRITON_TRACE_RX_FIFO, c->index, f->can_id, ts, now);
+            if (spilled) spill->tail++;
+            else rx_ring_release(ring, 1);
+        }
+    }
+full:
+    if (rings) next_channel = (next_channel + 1) % TRITON_CHANNELS; // a busy channel can't starve the others
+    if (b.records == 0) return 0;
+    struct gs_triton_packed_block hdr = { .magic = GS_TRITON_PACKED_MAGIC, .length = b.pos, .timestamp_us = b.base_us };
+    memcpy(buf, &hdr, sizeof(hdr));
+    *records = b.records;
+    return b.pos;
+}
+
+// Packed mode: write whole blocks into interface itf's FIFO while anything is pending and it has
+// room. Returns the records written; the caller flushes once, so a burst leaves as a single transfer.
+static uint32_t fwd_write_packed(uint8_t itf, bool echoes, bool rings) {
+    static uint8_t block[GS_TRITON_PACKED_BLOCK_MAX] __attribute__((aligned(4)));
+    const uint32_t min_room = sizeof(struct gs_triton_packed_block) + sizeof(struct gs_triton_packed_record) + 64;
+    uint32_t records = 0;
+    while (1) {
+        uint32_t room = tud_vendor_n_write_available(itf);
+        if (room < min_room) break;
+        uint32_t n = 0;
+        uint32_t bytes = packed_build(block, room < sizeof(block) ? room : sizeof(block), &n, echoes, rings);
+        if (bytes == 0) break;
+        tud_vendor_n_write(itf, block, bytes);
+        records += n;
+    }
+    return records;
+}
+
+#if CONFIG_TRITON_ECHO_EP
+// Echo endpoint: all of echo_queue, in the host's wire format, flushed on every pass. Its transfers
+// are short and never wait behind RX data filling 0x81; several gs_usb frames may share one.
+static void fwd_write_echo_ep(void) {
+    uint32_t n = 0;
+    if (packed_mode) {
+        n = fwd_write_packed(ECHO_ITF, true, false);
+    } else {
+        struct gs_host_frame frame;
+        while (tud_vendor_n_write_available(ECHO_ITF) >= usb_frame_size && fwd_pop_echo(&frame)) {
+            tud_vendor_n_write(ECHO_ITF, &frame, usb_frame_size);
+            n++;
+        }
+    }
+    if (n) tud_vendor_n_write_flush(ECHO_ITF);
+}
+#endif
+
+static bool fwd_rx_pending(void) {
+    for (uint32_t ch = 0; ch < TRITON_CHANNELS; ch++) {
+        if (!channels[ch].holding && fwd_rx_count(&channels[ch])) return true;
+    }
+    return false;
+}
+
+// The host has gone but the bus has not: running channels keep receiving, into the ring and the
+// PSRAM tier, and are held for the next host like an autostarted channel. What the last session
+// had queued for its host (echoes, error frames, packed acks) is dropped with it.
+static void fwd_detach_channels(void) {
+    for (uint32_t ch = 0; ch < TRITON_CHANNELS; ch++) {
+        struct can_channel *c = &channels[ch];
+        if (!c->started || c->holding) continue;
+        c->holding = true;
+        c->detached = true;
+        TLOGW("CAN%lu detached from USB, holding frames for the next host", ch);
+    }
+    xQueueReset(echo_queue);
+    portENTER_CRITICAL(&packed_mux);
+    memset(packed_batches, 0, sizeof(packed_batches));
+    portEXIT_CRITICAL(&packed_mux);
+}
+
+// A detached channel taken over with its running settings: the gap cost no restart
+static void usb_resumed(struct can_channel *c) {
+    struct gs_triton_stats *s = &channels[0].stats;
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - usb_gap_start_us) / 1000);
+    c->stats.usb_resumed++;
+    s->usb_gap_last_ms = ms;
+    if (ms > s->usb_gap_max_ms) s->usb_gap_max_ms = ms;
+    TLOGI("CAN%u resumed by the new host after %lu ms, %lu frames held", c->index, ms, rx_spill_count(&c->rx_spill) + rx_ring_count(&c->rx_ring));
+}
+
+// Applies the mode changes and autostart saves control requests left: starting a channel or
+// writing flash never stalls the control path
+static void fwd_apply_requests(void) {
+    if (usb_detach_pending) {
+        usb_detach_pending = false;
+        fwd_detach_channels();
+    }
+    for (uint32_t ch = 0; ch < TRITON_CHANNELS; ch++) {
+        struct gs_device_mode *mode = &pending_mode[ch];
+        if (mode->flags == MAGIC_FLAG) continue;
+        if (mode->mode == GS_CAN_MODE_START) {
+            // Frame size is per device: Linux asks for timestamps on every channel alike
+            usb_frame_size = (mode->flags & GS_CAN_MODE_HW_TIMESTAMP) ? GS_HOST_FRAME_TS_SIZE : GS_HOST_FRAME_SIZE;
+            channels[ch].berr_reporting = (mode->flags & GS_CAN_MODE_BERR_REPORTING) != 0;
+            channels[ch].fd = (mode->flags & GS_CAN_MODE_FD) && (bt_const[ch].feature & GS_CAN_FEATURE_FD);
+            channels[ch].ctrl_mode = channel_modes(ch, mode->flags);
+            if (held_matches(ch)) {
+                if (channels[ch].detached) usb_resumed(&channels[ch]);
+                else TLOGI("CAN%lu taken over by the host", ch);
+            } else {
+                start_channel(ch);
+            }
+        }
+        else if (mode->mode == GS_CAN_MODE_RESET) stop_channel(ch);
+        channels[ch].holding = false;
+        channels[ch].detached = false;
+        mode->flags = MAGIC_FLAG;
+    }
+    for (uint32_t ch = 0; ch < TRITON_CHANNELS; ch++) {
+        if (!(autostart_save_mask & (1u << ch))) continue;
+        __atomic_fetch_and(&autostart_save_mask, ~(1u << ch), __ATOMIC_RELAXED);
+        autostart_save(ch);
+    }
+}
+
+// Adaptive batching: folds n frames staged at now into the average gap between frames. A gap is
+// capped at the hold time, so a quiet spell is forgotten within a few wake-ups of a burst
+static void usb_adapt_arrived(uint32_t n, int64_t now) {
+    uint64_t cap = (uint64_t)usb_batch.flush_us * 16 + 16;
+    if (usb_adapt.gap_us16 == 0) usb_adapt.gap_us16 = cap; // sparse until shown otherwise
+    if (usb_adapt.last_us) {
+        uint64_t gap = (uint64_t)(now - usb_adapt.last_us) * 16 / n;
+        if (gap > cap) gap = cap;
+        usb_adapt.gap_us16 += ((int64_t)gap - (int64_t)usb_adapt.gap_us16) / USB_ADAPT_WEIGHT;
+    }
+    usb_adapt.last_us = now;
+    channels[0].stats.usb_arrival_gap_us = usb_adapt.gap_us16 / 16;
+}
+
+// Frames a batch waits for. Fixed batching: max_frames. Adaptive: the frames the current rate
+// brings within flush_us, so sparse traffic goes out at once. While an IN transfer is in flight
+// nothing is held back by flushing, since the next transfer starts with whatever is staged
+// when it completes: up to max_frames then
+static uint32_t usb_batch_target(void) {
+    uint32_t max = usb_batch.max_frames;
+    if (!(usb_batch.flags & GS_TRITON_USB_BATCH_ADAPTIVE) || usb_in_busy) return max;
+    uint64_t frames = (uint64_t)usb_batch.flush_us * 16 / (usb_adapt.gap_us16 | 1);
+    return frames < 1 ? 1 : frames > max ? max : (uint32_t)frames;
+}
+
+void can_forward_task(void *arg) {
+    uint32_t pending = 0;
+    int64_t batch_start_us = 0;
+    uint32_t batch_in_done = 0; // usb_in_done when the batch started
+    // Autostarted channels keep receiving meanwhile; keep their rings trimmed to the newest frames
+    while (!tud_mounted()) {
+        for (uint32_t ch = 0; ch < TRITON_CHANNELS; ch++) rx_ring_evict_channel(&channels[ch]);
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    }
+    TLOGI("USB Mounted - System Ready");
+
+    while (1) {
+        fwd_apply_requests();
+        if (!tud_mounted()) {
+            // Between hosts: the detached channels fill their ring and PSRAM tier until the next
+            // one. A batch staged in the FIFO went with the bus reset.
+            pending = 0;
+            usb_in_busy = false;
+            for (uint32_t ch = 0; ch < TRITON_CHANNELS; ch++) rx_ring_evict_channel(&channels[ch]);
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+            continue;
+        }
+#if CONFIG_TRITON_ECHO_EP
+        if (echo_ep) fwd_write_echo_ep();
+#endif
+        if (packed_mode) {
+            uint32_t records = fwd_write_packed(0, !echo_ep, true);
+            if (records) usb_flush_batch(records);
+        } else if (usb_batch.max_frames <= 1) {
+            // One frame per transfer: stage a frame only while the FIFO is empty, so the
+            // flush TinyUSB issues on IN completion never concatenates two frames
+            while (tud_vendor_write_available() >= CFG_TUD_VENDOR_TX_BUFSIZE && fwd_write(1)) {
+                usb_flush_batch(1);
+            }
+        } else {
+            // Packed: fill the FIFO back to back, flush once per batch or on deadline
+            bool adaptive = usb_batch.flags & GS_TRITON_USB_BATCH_ADAPTIVE;
+            while (1) {
+                uint32_t target = usb_batch_target();
+                uint32_t room = tud_vendor_write_available() / usb_frame_size;
+                if (pending < target && room > target - pending) room = target - pending;
+                uint32_t n = pending < target ? fwd_write(room) : 0;
+                if (n) {
+                    int64_t now = esp_timer_get_time();
+                    if (pending == 0) { batch_start_us = now; batch_in_done = usb_in_done; }
+                    pending += n;
+                    if (adaptive) usb_adapt_arrived(n, now);
+                    target = usb_batch_target();
+                }
+                if (pending && (pending >= target || tud_vendor_write_available() < usb_frame_size)) {
+                    if (adaptive && target <= 1) channels[0].stats.usb_flush_sparse++;
+                    else channels[0].stats.usb_flush_full++;
+                    usb_flush_batch(pending);
+                    pending = 0;
+                } else if (n == 0) {
+                    break;
+                }
+            }
+            channels[0].stats.usb_batch_target = usb_batch_target();
+            if (pending) {
+                int64_t now = esp_timer_get_time();
+                int64_t left_us = batch_start_us + usb_batch.flush_us - now;
+                int64_t pause_us = usb_adapt.last_us + (USB_ADAPT_PAUSE * (int64_t)usb_adapt.gap_us16 + 15) / 16 - now;
+                if (left_us <= 0) {
+                    channels[0].stats.usb_flush_deadline++;
+                    usb_flush_batch(pending);
+                    pending = 0;
+                } else if (adaptive && usb_in_busy && usb_in_done != batch_in_done) {
+                    // The transfer TinyUSB queued on completion has taken the batch
+                    channels[0].stats.usb_flush_busy++;
+                    usb_flush_batch(pending);
+                    pending = 0;
+                } else if (adaptive && !usb_in_busy && pause_us <= 0) {
+                    // The burst is over: nothing is gained by waiting out the hold
+                    channels[0].stats.usb_flush_sparse++;
+                    usb_flush_batch(pending);
+                    pending = 0;
+                } else {
+                    // Sub-tick deadline: let a one-shot timer wake us instead of the RTOS tick
+                    if (adaptive && !usb_in_busy && pause_us < left_us) left_us = pause_us;
+                    esp_timer_stop(batch_timer);
+                    esp_timer_start_once(batch_timer, (uint64_t)left_us);
+                }
+            }
+        }
+        if (tud_vendor_write_available() < usb_frame_size && (fwd_rx_pending() || (!echo_ep && uxQueueMessagesWaiting(echo_queue)))) {
+            channels[0].stats.usb_write_stalls++;
+        }
+        for (uint32_t ch = 0; ch < TRITON_CHANNELS; ch++) rx_ring_evict_channel(&channels[ch]);
+        // Sleep until the RX task, the USB stack or the batch timer has something for us
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+// Hands a frame to the node, under tx_lock
+static esp_err_t twai_submit(struct can_channel *c, const struct gs_host_frame_canfd *frame,
+                             const struct gs_host_frame *inflight) {
+    struct twai_ctl *t = &twai[c->index];
+    uint8_t buf[8];
+    twai_frame_t msg;
+    twai_from_host(frame, &msg, buf);
+    uint32_t seq;
+    esp_err_t err = triton_twai_ctrl_submit(t->ctrl, &msg, &seq);
+    if (err == ESP_OK) {
+        t->tx_head = seq + 1;
+        xQueueSend(c->tx_inflight_queue, inflight, 0);
+    }
+    ftrace(c, GS_TRITON_FTRACE_TX_SUBMIT, frame->can_id, frame->can_dlc, frame->flags, (uint16_t)err,
+           inflight->timestamp_us);
+    return err;
+}
+
+// Tops the node up from its prio queue, under tx_lock. Frames the node refuses go to failed[] (at most
+// TWAI_NODE_DEPTH), for the caller to echo once it has let go of the lock.
+static uint32_t twai_prio_feed(struct can_channel *c, struct gs_host_frame *failed) {
+    uint32_t n = 0;
+    struct tx_prio_entry e;
+    bool overtook;
+    while (uxQueueMessagesWaiting(c->tx_inflight_queue) < TWAI_NODE_DEPTH && n < TWAI_NODE_DEPTH &&
+           tx_prio_pop(&twai[c->index].prio, &e, &overtook)) {
+        if (overtook) c->stats.tx_reordered++;
+        if (twai_submit(c, (const struct gs_host_frame_canfd *)&e.frame, &e.inflight) != ESP_OK) failed[n++] = e.inflight;
+    }
+    return n;
+}
+
+static esp_err_t twai_send(struct can_channel *c, const struct gs_host_frame_canfd *frame,
+                           const struct gs_host_frame *echo) {
+    if (frame->flags & GS_CAN_FLAG_FD) return ESP_ERR_NOT_SUPPORTED;
+    if (c->ctrl_mode & GS_CAN_MODE_LISTEN_ONLY) return ESP_ERR_NOT_SUPPORTED; // nothing goes on the bus
+    // The in-flight copy carries the submit time until tx_echo() stamps the completion
+    struct gs_host_frame inflight = *echo;
+    inflight.timestamp_us = (uint32_t)esp_timer_get_time();
+
+    struct tx_prio *prio = &twai[c->index].prio;
+    struct gs_host_frame refused[TWAI_NODE_DEPTH];
+    uint32_t r = 0;
+    xSemaphoreTake(c->tx_lock, portMAX_DELAY);
+    esp_err_t err;
+    if (!c->started) {
+        err = ESP_ERR_INVALID_STATE;
+    } else if (prio->count == 0 && uxQueueMessagesWaiting(c->tx_inflight_queue) < TWAI_NODE_DEPTH) {
+        err = twai_submit(c, frame, &inflight); // nothing to overtake
+    } else if (!tx_prio_push(prio, frame, &inflight)) {
+        err = ESP_ERR_NO_MEM; // full: the caller retries, or the cyclic/servo slot is missed
+    } else {
+        err = ESP_OK;
+        c->stats.tx_prio_queued++;
+        if (prio->count > c->stats.tx_prio_hwm) c->stats.tx_prio_hwm = prio->count;
+        r = twai_prio_feed(c, refused); // room left by a frame the node refused earlier
+    }
+    xSemaphoreGive(c->tx_lock);
+    for (uint32_t i = 0; i < r; i++) tx_echo(&refused[i], true);
+    return err;
+}
+
+static esp_err_t mcp_send(struct can_channel *c, const struct gs_host_frame_canfd *frame,
+                          const struct gs_host_frame *echo) {
+    if (c->ctrl_mode & GS_CAN_MODE_LISTEN_ONLY) return ESP_ERR_NOT_SUPPORTED;
+    mcp251xfd_frame_t msg = {
+        .id = frame->can_id & 0x1FFFFFFF,
+        .flags = (frame->can_id & 0x80000000) ? MCP251XFD_FLAG_EXTD : 0,
+        .seq = frame->echo_id,
+    };
+    if (frame->flags & GS_CAN_FLAG_FD) {
+        if (!c->fd) return ESP_ERR_NOT_SUPPORTED;
+        msg.flags |= MCP251XFD_FLAG_FD;
+        if (frame->flags & GS_CAN_FLAG_BRS) msg.flags |= MCP251XFD_FLAG_BRS;
+        msg.dlc = frame->can_dlc & 0xF;
+        memcpy(msg.data, frame->data, gs_can_fd_dlc2len(msg.dlc));
+    } else {
+        if (frame->can_id & 0x40000000) msg.flags |= MCP251XFD_FLAG_RTR;
+        msg.dlc = frame->can_dlc > 8 ? 8 : frame->can_dlc;
+        memcpy(msg.data, frame->data, 8);
+    }
+
+    struct gs_host_frame inflight = *echo;
+    inflight.timestamp_us = (uint32_t)esp_timer_get_time();
+
+    // The TEF task pops the in-flight queue under the same lock, so the push can't trail the completion
+    xSemaphoreTake(c->tx_lock, portMAX_DELAY);
+    esp_err_t err = !c->started ? ESP_ERR_INVALID_STATE
+                  : uxQueueSpacesAvailable(c->tx_inflight_queue) == 0 ? ESP_ERR_NO_MEM
+                  : mcp251xfd_transmit(c->mcp, &msg);
+    if (err == ESP_OK) xQueueSend(c->tx_inflight_queue, &inflight, 0);
+    xSemaphoreGive(c->tx_lock);
+    ftrace(c, GS_TRITON_FTRACE_TX_SUBMIT, frame->can_id, frame->can_dlc, frame->flags, (uint16_t)err,
+           inflight.timestamp_us);
+    return err;
+}
+
+// RX hook, also safe in the ISR: counts the rules a received frame matches and returns a bit per
+// rule for gateway_forward(). *consumed is set if one of them keeps it off the host stream.
+static IRAM_ATTR uint32_t gateway_match(const struct can_channel *src, uint32_t can_id, bool *consumed) {
+    if (!(gateway_src_mask & (1u << src->index))) return 0;
+    uint32_t rules = 0;
+    for (uint32_t i = 0; i < GS_TRITON_GATEWAY_RULES; i++) {
+        struct gs_triton_gateway_rule *r = &gateway_table[i];
+        if (!(r->flags & GS_TRITON_GATEWAY_ENABLE) || r->src_channel != src->index ||
+            ((can_id ^ r->can_id) & r->mask) != 0) continue;
+        r->matched++;
+        if (r->flags & GS_TRITON_GATEWAY_CONSUME) *consumed = true;
+        rules |= 1u << i;
+    }
+    return rules;
+}
+
+// Hands the frame to the destination controller of each rule in rules. Never waits: a destination
+// that is stopped or full drops the frame.
+static void gateway_forward(uint32_t rules, uint32_t can_id, uint8_t dlc, uint8_t flags, const uint8_t *data) {
+    for (uint32_t i = 0; rules; i++, rules >>= 1) {
+        struct gs_triton_gateway_rule *r = &gateway_table[i];
+        if (!(rules & 1) || !(r->flags & GS_TRITON_GATEWAY_ENABLE)) continue; // disabled since the match
+        struct can_channel *dst = &channels[r->dst_channel];
+        struct gs_host_frame_canfd frame = {
+            .echo_id = GATEWAY_ECHO_BASE | i, .can_id = (can_id & ~r->rewrite_mask) | (r->rewrite_id & r->rewrite_mask),
+            .can_dlc = dlc, .channel = r->dst_channel, .flags = flags & (GS_CAN_FLAG_FD | GS_CAN_FLAG_BRS),
+        };
+        memcpy(frame.data, data, (flags & GS_CAN_FLAG_FD) ? gs_can_fd_dlc2len(dlc) : 8);
+        struct gs_host_frame echo;
+        memset(&echo, 0, sizeof(echo));
+        memcpy(&echo, &frame, GS_HOST_FRAME_HDR_SIZE);
+        esp_err_t err = channel_is_twai(dst) ? twai_send(dst, &frame, &echo) : mcp_send(dst, &frame, &echo);
+        if (err != ESP_OK) r->dropped++;
+    }
+}
+
+// RX hook of the MCP channels. Returns true if a matching rule consumes the frame.
+static bool gateway_route(const struct can_channel *src, uint32_t can_id, uint8_t dlc, uint8_t flags,
+                          const uint8_t *data) {
+    bool consumed = false;
+    uint32_t rules = gateway_match(src, can_id, &consumed);
+    if (rules) gateway_forward(rules, can_id, dlc, flags, data);
+    return consumed;
+}
+
+// Host OUT data as linear memory, owned by can_tx_task. Each wake-up moves everything the OUT
+// FIFO holds in one tud_vendor_read() (one FIFO lock, one endpoint re-arm) and every complete frame
+// is parsed in place; a partial frame stays at the front for the next pass. It is small, so a full
+// TX path still leaves the OUT FIFO full and the host NAKed.
+#define OUT_BUF_LEN 1024
+static struct {
+    uint8_t data[OUT_BUF_LEN];
+    uint32_t pos, len; // parsed up to pos, filled up to len
+} out_buf;
+
+#if CONFIG_TRITON_SPI_LINK
+// The SPI link task writes the host stream here instead of TinyUSB's OUT FIFO: it takes a payload
+// only whole, so a full TX path leaves the host holding it as a NAKed OUT transfer would
+static StreamBufferHandle_t spi_out;
+static inline uint32_t host_out_available(void) { return xStreamBufferBytesAvailable(spi_out); }
+static inline uint32_t host_out_read(void *dst, uint32_t n) { return xStreamBufferReceive(spi_out, dst, n, 0); }
+static void host_out_flush(void) {
+    while (xStreamBufferReceive(spi_out, out_buf.data, OUT_BUF_LEN, 0)) { }
+}
+#else
+static inline uint32_t host_out_available(void) { return tud_vendor_available(); }
+static inline uint32_t host_out_read(void *dst, uint32_t n) { return tud_vendor_read(dst, n); }
+static inline void host_out_flush(void) { tud_vendor_read_flush(); }
+#endif
+
+static inline uint32_t out_avail(void) {
+    return out_buf.len - out_buf.pos;
+}
+
+static inline const uint8_t *out_peek(void) {
+    return out_buf.data + out_buf.pos;
+}
+
+static inline void out_take(void *dst, uint32_t n) {
+    memcpy(dst, out_peek(), n);
+    out_buf.pos += n;
+}
+
+// Drops the marks of OUT transfers that end at or before stream offset at
+static void out_marks_retire(uint32_t at) {
+    uint32_t head = __atomic_load_n(&out_marks.head, __ATOMIC_ACQUIRE);
+    uint32_t tail = out_marks.tail;
+    while (tail != head && (int32_t)(out_marks.mark[tail % OUT_MARKS].end - at) <= 0) tail++;
+    __atomic_store_n(&out_marks.tail, tail, __ATOMIC_RELEASE);
+}
+
+// Returns how many bytes came in
+static uint32_t out_fill(void) {
+    if (out_buf.pos) {
+        out_buf.len -= out_buf.pos;
+        memmove(out_buf.data, out_buf.data + out_buf.pos, out_buf.len);
+        out_buf.pos = 0;
+    }
+    out_marks_retire(out_marks.read - out_buf.len); // parsed: their time is no longer needed
+    if (out_buf.len == OUT_BUF_LEN || !host_out_available()) return 0;
+    uint32_t n = host_out_read(out_buf.data + out_buf.len, OUT_BUF_LEN - out_buf.len);
+    out_buf.len += n;
+    __atomic_store_n(&out_marks.read, out_marks.read + n, __ATOMIC_RELAXED);
+    return n;
+}
+
+static void out_flush(void) {
+    host_out_flush();
+    out_buf.pos = out_buf.len = 0;
+    __atomic_store_n(&out_marks.tail, __atomic_load_n(&out_marks.head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+// esp_timer time (low 32 bits) at which the next unparsed byte reached the OUT FIFO
+static uint32_t out_arrival_us(void) {
+    out_marks_retire(out_marks.read - out_avail());
+    uint32_t tail = out_marks.tail;
+    return tail != __atomic_load_n(&out_marks.head, __ATOMIC_ACQUIRE) ? out_marks.mark[tail % OUT_MARKS].time_us
+                                                                       : (uint32_t)esp_timer_get_time();
+}
+
+// TX deadlines (GS_USB_BREQ_TRITON_TX_DEADLINE). own_us: the frame's own deadline, 0 for the rules'.
+static bool tx_expired(const struct can_channel *c, uint32_t can_id, uint32_t own_us, uint32_t arrived_us) {
+    uint32_t max_age_us = own_us;
+    const struct gs_triton_tx_deadline *d = &c->tx_deadline;
+    for (uint32_t i = 0; !max_age_us && i < d->rule_count; i++) {
+        if (((can_id ^ d->rule[i].can_id) & d->rule[i].mask) == 0) {
+            max_age_us = d->rule[i].max_age_us;
+            break;
+        }
+    }
+    return max_age_us && (uint32_t)esp_timer_get_time() - arrived_us > max_age_us;
+}
+
+// The backlog stays in out_buf, where frames can still expire, rather than in the driver queue
+static bool tx_inflight_capped(const struct can_channel *c) {
+    uint32_t queued = uxQueueMessagesWaiting(c->tx_inflight_queue) + (channel_is_twai(c) ? twai[c->index].prio.count : 0);
+    return c->tx_deadline.inflight_max && queued >= c->tx_deadline.inflight_max;
+}
+
+// Fails a host frame past its deadline instead of sending it
+static void tx_expire(struct can_channel *c, struct gs_host_frame *echo) {
+    c->stats.tx_expired++;
+    echo->flags = GS_CAN_FLAG_TRITON_TX_EXPIRED;
+    tx_echo(echo, true);
+}
+
+// Packed-mode OUT parser state, owned by can_tx_task
+static struct {
+    enum { PK_BLOCK, PK_BATCH, PK_RECORD, PK_PAYLOAD, PK_READY } state;
+    struct gs_triton_packed_tx_block block;
+    struct gs_triton_packed_record rec;
+    struct gs_host_frame_canfd frame;
+    uint32_t left;  // records still to read in the block
+    uint32_t batch; // packed_batches index
+    uint32_t arrived_us; // of the current record, for its deadline
+} packed_rx;
+
+static bool packed_batch_alloc(uint32_t batch_id, uint32_t *idx) {
+    bool found = false;
+    portENTER_CRITICAL(&packed_mux);
+    for (uint32_t i = 0; i < PACKED_BATCHES && !found; i++) {
+        if (packed_batches[i].in_use) continue;
+        packed_batches[i] = (struct packed_batch){ .batch_id = batch_id, .in_use = true };
+        *idx = i;
+        found = true;
+    }
+    portEXIT_CRITICAL(&packed_mux);
+    return found;
+}
+
+// Drops a half-read block: its unread records count as failed so the batch is still acknowledged
+static void packed_rx_reset(void) {
+    if (packed_rx.state >= PK_RECORD) packed_batch_update(packed_rx.batch, 0, packed_rx.left, 0, true);
+    packed_rx.state = PK_BLOCK;
+}
+
+// Malformed stream: there is no way to find the next block boundary, so drop what is buffered
+static void packed_rx_resync(const char *why) {
+    TLOGW("Packed TX stream: %s, flushing", why);
+    out_flush();
+    packed_rx_reset();
+}
+
+// Packed counterpart of tx_parse_frames(), on the same buffer. Returns when it has to wait for
+// more OUT data or for TX room (batch table or in-flight queue).
+static void packed_tx_poll(void) {
+    while (1) {
+        switch (packed_rx.state) {
+        case PK_BLOCK:
+            if (out_avail() < sizeof(packed_rx.block)) return;
+            out_take(&packed_rx.block, sizeof(packed_rx.block));
+            if (packed_rx.block.magic != GS_TRITON_PACKED_MAGIC) {
+                TLOGW("Packed TX stream: bad magic %04x, flushing", packed_rx.block.magic);
+                out_flush();
+                return;
+            }
+            packed_rx.left = packed_rx.block.count;
+            packed_rx.state = PK_BATCH;
+            // fall through
+        case PK_BATCH:
+            if (!packed_batch_alloc(packed_rx.block.batch_id, &packed_rx.batch)) return; // woken by the next completion
+            packed_rx.state = PK_RECORD;
+            // fall through
+        case PK_RECORD:
+            if (packed_rx.left == 0) {
+                packed_batch_update(packed_rx.batch, 0, 0, 0, true);
+                packed_rx.state = PK_BLOCK;
+                break;
+            }
+            if (out_avail() < sizeof(packed_rx.rec)) return;
+            packed_rx.arrived_us = out_arrival_us();
+            out_take(&packed_rx.rec, sizeof(packed_rx.rec));
+            if (packed_rx.rec.len > 64 || (!(packed_rx.rec.flags & GS_CAN_FLAG_FD) && packed_rx.rec.len > 8)) {
+                packed_rx_resync("bad record length");
+                return;
+            }
+            packed_rx.state = PK_PAYLOAD;
+            // fall through
+        case PK_PAYLOAD:
+            if (out_avail() < packed_rx.rec.len) return;
+            memset(&packed_rx.frame, 0, sizeof(packed_rx.frame));
+            out_take(packed_rx.frame.data, packed_rx.rec.len);
+            packed_rx.state = PK_READY;
+            // fall through
+        case PK_READY: {
+            struct gs_host_frame_canfd *frame = &packed_rx.frame;
+            uint8_t ch = packed_rx.rec.chan_type & 0xF;
+            frame->echo_id = PACKED_ECHO_BASE | packed_rx.batch;
+            frame->can_id = packed_rx.rec.can_id;
+            frame->channel = ch;
+            frame->flags = packed_rx.rec.flags & (GS_CAN_FLAG_FD | GS_CAN_FLAG_BRS);
+            frame->can_dlc = (frame->flags & GS_CAN_FLAG_FD) ? gs_can_fd_len2dlc(packed_rx.rec.len) : packed_rx.rec.len;
+            esp_err_t err = ESP_ERR_INVALID_ARG;
+            if (ch < TRITON_CHANNELS) {
+                struct can_channel *c = &channels[ch];
+                struct gs_host_frame echo;
+                memset(&echo, 0, sizeof(echo));
+                memcpy(&echo, frame, GS_HOST_FRAME_HDR_SIZE);
+                echo.reserved = usb_session;
+                bool expired = tx_expired(c, frame->can_id, (uint16_t)packed_rx.rec.delta_us, packed_rx.arrived_us);
+                if (!expired && tx_inflight_capped(c)) return; // woken by the next completion
+                // Counted before the send: the completion may come back before it returns
+                uint32_t t0 = STAGE_CYCLES();
+                packed_batch_update(packed_rx.batch, 0, 0, 1, false);
+                if (expired) {
+                    tx_expire(c, &echo);
+                    packed_rx.left--;
+                    packed_rx.state = PK_RECORD;
+                    break;
+                }
+                err = channel_is_twai(c) ? twai_send(c, frame, &echo) : mcp_send(c, frame, &echo);
+                if (err == ESP_ERR_NO_MEM) { packed_batch_update(packed_rx.batch, 0, 0, -1, false); return; }
+                STAGE_SAMPLE(c->stats.hist_tx_cycles, STAGE_CYCLES() - t0);
+                if (err == ESP_OK) {
+                    uint32_t depth = uxQueueMessagesWaiting(c->tx_inflight_queue);
+                    if (depth > c->stats.tx_inflight_hwm) c->stats.tx_inflight_hwm = depth;
+                } else {
+                    c->stats.tx_failed++;
+                    packed_batch_update(packed_rx.batch, 0, 1, -1, false);
+                }
+            } else {
+                packed_batch_update(packed_rx.batch, 0, 1, 0, false);
+            }
+            packed_rx.left--;
+            packed_rx.state = PK_RECORD;
+            break;
+        }
+        }
+    }
+}
+
+// Host frames are 8-byte classic frames, or gs_host_frame_canfd on a channel started in FD mode
+static uint32_t tx_payload_size(uint8_t channel) {
+    return channel < TRITON_CHANNELS && channels[channel].fd ? 64 : 8;
+}
+
+// Sends every complete gs_host_frame in out_buf, straight from the buffer. Returns false when a
+// channel is full: the frame stays put and so does everything behind it.
+static bool tx_parse_frames(void) {
+    struct gs_host_frame echo; // header only: all an echo or the in-flight queue needs
+    while (out_avail() >= GS_HOST_FRAME_HDR_SIZE) {
+        // Packed struct, so the unaligned view is fine; the header's channel decides the payload length
+        const struct gs_host_frame_canfd *frame = (const struct gs_host_frame_canfd *)out_peek();
+        uint32_t size = GS_HOST_FRAME_HDR_SIZE + tx_payload_size(frame->channel);
+        if (out_avail() < size) break; // rest of the transfer still on its way
+        if (frame->channel >= TRITON_CHANNELS) {
+            TLOGW("TX for unknown channel %u dropped", frame->channel);
+            out_buf.pos += size;
+            continue;
+        }
+        struct can_channel *c = &channels[frame->channel];
+        memset(&echo, 0, sizeof(echo));
+        memcpy(&echo, frame, GS_HOST_FRAME_HDR_SIZE);
+        echo.reserved = usb_session; // the host's byte, unused: the session it was sent in
+        // Stale frames go even while the channel is full, which is when they pile up
+        if (tx_expired(c, frame->can_id, 0, out_arrival_us())) {
+            out_buf.pos += size;
+            tx_expire(c, &echo);
+            continue;
+        }
+        // A full channel holds the OUT FIFO for all of them, which is what NAKs the host
+        if (uxQueueSpacesAvailable(c->tx_inflight_queue) == 0 || tx_inflight_capped(c)) return false;
+
+        uint32_t t0 = STAGE_CYCLES();
+        esp_err_t err = channel_is_twai(c) ? twai_send(c, frame, &echo) : mcp_send(c, frame, &echo);
+        if (err == ESP_ERR_NO_MEM) return false; // priority queue full, or a cyclic frame took the last slot
+        out_buf.pos += size;
+        STAGE_SAMPLE(c->stats.hist_tx_cycles, STAGE_CYCLES() - t0);
+        if (err == ESP_OK) {
+            uint32_t depth = uxQueueMessagesWaiting(c->tx_inflight_queue);
+            if (depth > c->stats.tx_inflight_hwm) c->stats.tx_inflight_hwm = depth;
+        } else {
+            tx_echo(&echo, true); // bus-off, stopped or not an FD channel: fail it right away
+        }
+    }
+    return true;
+}
+
+void can_tx_task(void *arg) {
+    TLOGI("CAN Transmitter Ready");
+
+    while (1) {
+        // Woken by new OUT data and by the CAN tasks when TX slots free up
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        stage_close(&tx_wake_us, channels[0].stats.hist_tx_wake);
+        if (!any_channel_started()) { out_flush(); packed_rx_reset(); continue; }
+        // Parse what is buffered, then top the buffer up; stop once a pass brings nothing new
+        do {
+            if (packed_mode) packed_tx_poll();
+            else if (!tx_parse_frames()) break;
+        } while (out_fill());
+    }
+}
+
+// --- SPI HOST LINK ---
+#if CONFIG_TRITON_SPI_LINK
+// The host clocks fixed-size full-duplex transactions (gs_triton_spi_hdr, README 3.Y). One is
+// always queued: its MISO half is built beforehand from echo_queue and the rings, as for USB, and
+// its MOSI half handled once it completes, so an answer (ack, credit, control reply) comes in the
+// transaction after the one that asked. DRDY goes high once a transaction with something for the
+// host is loaded. Frames that arrive while an empty one is loaded raise it too: the host clocks
+// that one and gets them in the next.
+#define SPI_LINK_HOST SPI3_HOST // SPI2 drives the MCP2518FD channels
+#define SPI_LINK_BLOCK CONFIG_TRITON_SPI_LINK_BLOCK
+#define SPI_LINK_DRDY CONFIG_TRITON_SPI_LINK_DRDY_GPIO
+#define SPI_LINK_RHPORT 0xFF // rhport of the control requests that came over the link
+_Static_assert(SPI_LINK_BLOCK % 4 == 0, "the SPI slave DMA moves whole words");
+static DMA_ATTR uint8_t spi_link_tx[SPI_LINK_BLOCK];
+static DMA_ATTR uint8_t spi_link_rx[SPI_LINK_BLOCK];
+static uint8_t spi_out_storage[CONFIG_TRITON_USB_RX_BUFSIZE + 1];
+static StaticStreamBuffer_t spi_out_buf;
+static portMUX_TYPE spi_link_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool spi_link_loaded = false; // a transaction is in the hardware, under spi_link_mux
+static bool spi_link_ready = false;  // and DRDY should be high for it
+
+// The control request in hand and the last reply, kept until the next request so a resend of the
+// same tag is answered again
+static struct {
+    const uint8_t *out_data; uint32_t out_len; // OUT data stage from the host
+    uint8_t reply[SPI_LINK_BLOCK - sizeof(struct gs_triton_spi_hdr)]; // gs_triton_spi_reply and IN data
+    uint32_t reply_len; // 0: nothing answered yet
+    bool due;           // goes out in the next transaction
+} spi_ctrl;
+
+static void IRAM_ATTR spi_link_setup_cb(spi_slave_transaction_t *t) {
+    portENTER_CRITICAL_ISR(&spi_link_mux);
+    spi_link_loaded = true;
+    if (spi_link_ready) gpio_ll_set_level(&GPIO, SPI_LINK_DRDY, 1);
+    portEXIT_CRITICAL_ISR(&spi_link_mux);
+}
+
+static void IRAM_ATTR spi_link_done_cb(spi_slave_transaction_t *t) {
+    portENTER_CRITICAL_ISR(&spi_link_mux);
+    spi_link_loaded = false;
+    gpio_ll_set_level(&GPIO, SPI_LINK_DRDY, 0);
+    portEXIT_CRITICAL_ISR(&spi_link_mux);
+    BaseType_t woken = pdFALSE;
+    if (fwd_task_handle) vTaskNotifyGiveFromISR(fwd_task_handle, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+
+// Data stage of a request from the link: OUT data comes from the transaction, IN data is copied
+// into the reply. Neither may be longer than a transaction can carry.
+static bool control_xfer(uint8_t rhport, tusb_control_request_t const *request, void *buffer, uint16_t len) {
+    struct gs_triton_spi_reply *r = (struct gs_triton_spi_reply *)spi_ctrl.reply;
+    if (len > request->wLength) len = request->wLength;
+    r->length = 0;
+    if (request->bmRequestType & TUSB_DIR_IN_MASK) {
+        if (len > sizeof(spi_ctrl.reply) - sizeof(*r)) return false;
+        memcpy(spi_ctrl.reply + sizeof(*r), buffer, len);
+        r->length = len;
+    } else {
+        if (spi_ctrl.out_len < request->wLength) return false; // the host sent less than it announced
+        memcpy(buffer, spi_ctrl.out_data, len);
+    }
+    return true;
+}
+
+// One request: the SETUP and ACK stages of the USB callback back to back
+static void spi_link_control(const uint8_t *p, uint32_t n) {
+    struct gs_triton_spi_ctrl c;
+    struct gs_triton_spi_reply *r = (struct gs_triton_spi_reply *)spi_ctrl.reply;
+    if (n < sizeof(c)) return;
+    memcpy(&c, p, sizeof(c));
+    if (spi_ctrl.reply_len && c.tag == r->tag && c.bRequest == r->bRequest) {
+        spi_ctrl.due = true; // its reply was lost
+        return;
+    }
+    tusb_control_request_t request = {
+        .bmRequestType = c.bmRequestType, .bRequest = c.bRequest, .wValue = c.wValue, .wIndex = 0, .wLength = c.wLength,
+    };
+    spi_ctrl.out_data = p + sizeof(c);
+    spi_ctrl.out_len = n - sizeof(c);
+    bool ok = tud_vendor_control_xfer_cb(SPI_LINK_RHPORT, CONTROL_STAGE_SETUP, &request);
+    if (ok) tud_vendor_control_xfer_cb(SPI_LINK_RHPORT, CONTROL_STAGE_ACK, &request);
+    else r->length = 0;
+    r->bRequest = c.bRequest;
+    r->tag = c.tag;
+    r->status = ok ? 0 : 1;
+    r->reserved = 0;
+    r->reserved2 = 0;
+    spi_ctrl.reply_len = sizeof(*r) + r->length;
+    spi_ctrl.due = true;
+}
+
+// Handles a completed MOSI half. expect: seq of the next host payload to take.
+static void spi_link_receive(uint32_t len, uint8_t *expect) {
+    struct gs_triton_spi_hdr h;
+    if (len < sizeof(h)) return;
+    memcpy(&h, spi_link_rx, sizeof(h));
+    uint32_t end = sizeof(h) + h.ctrl_len + h.data_len;
+    if (h.magic != GS_TRITON_SPI_MAGIC_HOST || h.version != GS_TRITON_SPI_VERSION || end > len) return;
+    ((struct gs_triton_spi_hdr *)spi_link_rx)->crc = 0;
+    if (esp_rom_crc32_le(0, spi_link_rx, end) != h.crc) return; // the host sees no ack and resends
+    if (h.ctrl_len) spi_link_control(spi_link_rx + sizeof(h), h.ctrl_len);
+    // In order and whole only: a payload that doesn't fit now comes again once credit allows
+    if (h.data_len && h.seq == *expect && h.data_len <= xStreamBufferSpacesAvailable(spi_out)) {
+        xStreamBufferSend(spi_out, spi_link_rx + sizeof(h) + h.ctrl_len, h.data_len, 0);
+        (*expect)++;
+        out_arrived(host_out_available());
+    }
+}
+
+// Fills the MISO half. Returns true when it carries anything for the host.
+static bool spi_link_build(uint8_t seq, uint8_t ack) {
+    const uint32_t min_room = sizeof(struct gs_triton_packed_block) + sizeof(struct gs_triton_packed_record) + 64;
+    uint32_t pos = sizeof(struct gs_triton_spi_hdr), ctrl = 0, records = 0;
+    if (spi_ctrl.due) {
+        memcpy(spi_link_tx + pos, spi_ctrl.reply, spi_ctrl.reply_len);
+        ctrl = spi_ctrl.reply_len;
+        pos += ctrl;
+        spi_ctrl.due = false;
+    }
+    uint32_t data = pos;
+    while (SPI_LINK_BLOCK - pos >= min_room) {
+        uint32_t room = SPI_LINK_BLOCK - pos, n = 0;
+        uint32_t bytes = packed_build(spi_link_tx + pos, room < GS_TRITON_PACKED_BLOCK_MAX ? room : GS_TRITON_PACKED_BLOCK_MAX,
+                                      &n, true, true);
+        if (bytes == 0) break;
+        pos += bytes;
+        records += n;
+    }
+    bool more = fwd_rx_pending() || uxQueueMessagesWaiting(echo_queue);
+    if (more) channels[0].stats.usb_write_stalls++;
+    size_t credit = xStreamBufferSpacesAvailable(spi_out);
+    struct gs_triton_spi_hdr h = {
+        .magic = GS_TRITON_SPI_MAGIC_DEV, .version = GS_TRITON_SPI_VERSION, .seq = seq, .ack = ack,
+        .flags = more ? GS_TRITON_SPI_MORE : 0, .ctrl_len = ctrl, .data_len = pos - data,
+        .credit = credit > UINT16_MAX ? UINT16_MAX : credit, .block = SPI_LINK_BLOCK,
+    };
+    memcpy(spi_link_tx, &h, sizeof(h));
+    h.crc = esp_rom_crc32_le(0, spi_link_tx, pos);
+    memcpy(spi_link_tx + offsetof(struct gs_triton_spi_hdr, crc), &h.crc, sizeof(h.crc));
+    return ctrl || records;
+}
+
+static bool spi_link_init(void) {
+    spi_out = xStreamBufferCreateStatic(sizeof(spi_out_storage) - 1, 1, spi_out_storage, &spi_out_buf);
+    gpio_config_t drdy = { .pin_bit_mask = 1ULL << SPI_LINK_DRDY, .mode = GPIO_MODE_OUTPUT };
+    gpio_config(&drdy);
+    gpio_set_level(SPI_LINK_DRDY, 0);
+    spi_bus_config_t bus = {
+        .mosi_io_num = CONFIG_TRITON_SPI_LINK_MOSI_GPIO, .miso_io_num = CONFIG_TRITON_SPI_LINK_MISO_GPIO,
+        .sclk_io_num = CONFIG_TRITON_SPI_LINK_SCLK_GPIO, .quadwp_io_num = -1, .quadhd_io_num = -1,
+        .max_transfer_sz = SPI_LINK_BLOCK,
+    };
+    spi_slave_interface_config_t slave = {
+        .spics_io_num = CONFIG_TRITON_SPI_LINK_CS_GPIO, .queue_size = 1, .mode = 0,
+        .post_setup_cb = spi_link_setup_cb, .post_trans_cb = spi_link_done_cb,
+    };
+    if (spi_slave_initialize(SPI_LINK_HOST, &bus, &slave, SPI_DMA_CH_AUTO) != ESP_OK) {
+        ESP_LOGE(TAG, "SPI slave init failed, no host link");
+        return false;
+    }
+    return true;
+}
+
+void spi_link_task(void *arg) {
+    uint8_t seq = 0, expect = 0;
+    if (!spi_link_init()) vTaskSuspend(NULL);
+    TLOGI("SPI link ready: %lu-byte transactions", (uint32_t)SPI_LINK_BLOCK);
+    while (1) {
+        fwd_apply_requests();
+        spi_link_ready = spi_link_build(seq++, expect); // nothing is loaded: the callbacks don't read it now
+        spi_slave_transaction_t t = { .length = SPI_LINK_BLOCK * 8, .tx_buffer = spi_link_tx, .rx_buffer = spi_link_rx };
+        spi_slave_queue_trans(SPI_LINK_HOST, &t, portMAX_DELAY);
+        if (spi_link_ready) {
+            stage_mark(&usb_flush_us);
+            trace_flushed();
+        }
+        spi_slave_transaction_t *done;
+        while (spi_slave_get_trans_result(SPI_LINK_HOST, &done, 0) != ESP_OK) {
+            // Woken by the completion, or by fwd_notify for new frames: call the host for them
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            if (spi_link_ready || !(fwd_rx_pending() || uxQueueMessagesWaiting(echo_queue))) continue;
+            portENTER_CRITICAL(&spi_link_mux);
+            spi_link_ready = true;
+            if (spi_link_loaded) gpio_ll_set_level(&GPIO, SPI_LINK_DRDY, 1);
+            portEXIT_CRITICAL(&spi_link_mux);
+        }
+        channels[0].stats.usb_transfers++;
+        stage_close(&usb_flush_us, channels[0].stats.hist_usb_in);
+        trace_in_done();
+        spi_link_receive(done->trans_len / 8, &expect);
+        for (uint32_t ch = 0; ch < TRITON_CHANNELS; ch++) rx_ring_evict_channel(&channels[ch]);
+    }
+}
+#endif
+
+// --- CYCLIC TX ---
+static IRAM_ATTR void cyclic_timer_cb(void *arg) {
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(cyclic_task_handle, &woken);
+    if (woken) esp_timer_isr_dispatch_need_yield();
+#else
+    xTaskNotifyGive(cyclic_task_handle);
+#endif
+}
+
+// First t > now with t % period == phase, so every entry keeps its offset on the shared clock
+static int64_t cyclic_align(int64_t now, uint32_t period_us, uint32_t phase_us) {
+    int64_t t = now - (now % period_us) + phase_us;
+    return t > now ? t : t + period_us;
+}
+
+static void cyclic_apply_posts(int64_t now) {
+    struct gs_triton_cyclic post[GS_TRITON_CYCLIC_SLOTS];
+    portENTER_CRITICAL(&cyclic_mux);
+    uint32_t mask = cyclic_post_mask;
+    cyclic_post_mask = 0;
+    for (uint32_t i = 0; i < GS_TRITON_CYCLIC_SLOTS; i++) {
+        if (mask & (1u << i)) post[i] = cyclic_post[i];
+    }
+    portEXIT_CRITICAL(&cyclic_mux);
+
+    for (uint32_t i = 0; i < GS_TRITON_CYCLIC_SLOTS; i++) {
+        if (!(mask & (1u << i))) continue;
+        struct cyclic_entry *e = &cyclic_table[i];
+        bool running = e->config.flags & GS_TRITON_CYCLIC_ENABLE;
+        if (post[i].flags & GS_TRITON_CYCLIC_DATA_ONLY) {
+            // Setpoint change: the schedule is untouched, the next emission carries the new bytes
+            if (!running) continue;
+            e->config.can_dlc = post[i].can_dlc;
+            e->config.frame_flags = post[i].frame_flags;
+            memcpy(e->config.data, post[i].data, sizeof(e->config.data));
+            continue;
+        }
+        e->config = post[i];
+        e->config.flags &= ~GS_TRITON_CYCLIC_DATA_ONLY;
+        if (e->config.flags & GS_TRITON_CYCLIC_ENABLE) {
+            e->next_us = cyclic_align(now, e->config.period_us, e->config.phase_us);
+            TLOGI("Cyclic %lu: CAN%u id %08lx every %lu us (+%lu)", i, e->config.channel,
+                     e->config.can_id, e->config.period_us, e->config.phase_us);
+        }
+    }
+}
+
+static void cyclic_send(struct cyclic_entry *e) {
+    struct can_channel *c = &channels[e->config.channel];
+    struct gs_host_frame_canfd frame = {
+        .echo_id = CYCLIC_ECHO_ID, .can_id = e->config.can_id, .can_dlc = e->config.can_dlc,
+        .channel = e->config.channel, .flags = e->config.frame_flags & (GS_CAN_FLAG_FD | GS_CAN_FLAG_BRS),
+    };
+    memcpy(frame.data, e->config.data, sizeof(frame.data));
+    struct gs_host_frame echo;
+    memset(&echo, 0, sizeof(echo));
+    memcpy(&echo, &frame, GS_HOST_FRAME_HDR_SIZE);
+
+    // Shares the channel's in-flight queue with host frames, so TX completion counting stays exact
+    esp_err_t err = channel_is_twai(c) ? twai_send(c, &frame, &echo) : mcp_send(c, &frame, &echo);
+    if (err != ESP_OK) c->stats.cyclic_missed++;
+}
+
+// Emits due table entries. Woken by cyclic_timer at the earliest deadline and by cyclic_submit().
+void can_cyclic_task(void *arg) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t now = esp_timer_get_time();
+        cyclic_apply_posts(now);
+
+        int64_t next = INT64_MAX;
+        for (uint32_t i = 0; i < GS_TRITON_CYCLIC_SLOTS; i++) {
+            struct cyclic_entry *e = &cyclic_table[i];
+            if (!(e->config.flags & GS_TRITON_CYCLIC_ENABLE)) continue;
+            if (e->next_us <= now) {
+                struct can_channel *c = &channels[e->config.channel];
+                if (c->started) {
+                    uint32_t late = (uint32_t)(now - e->next_us);
+                    if (late > c->stats.cyclic_late_max_us) c->stats.cyclic_late_max_us = late;
+                    cyclic_send(e);
+                }
+                e->next_us += e->config.period_us;
+                if (e->next_us <= now) {
+                    // More than a period behind: skip what is gone instead of sending a burst
+                    int64_t skipped = (now - e->next_us) / e->config.period_us + 1;
+                    if (c->started) c->stats.cyclic_missed += (uint32_t)skipped;
+                    e->next_us += skipped * e->config.period_us;
+                }
+            }
+            if (e->next_us < next) next = e->next_us;
+        }
+        if (next != INT64_MAX) {
+            int64_t wait = next - esp_timer_get_time();
+            esp_timer_stop(cyclic_timer);
+            esp_timer_start_once(cyclic_timer, wait > 0 ? (uint64_t)wait : 1);
+        }
+    }
+}
+
+// --- RS02 SERVO LOOP ---
+static IRAM_ATTR void servo_timer_cb(void *arg) {
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(servo_task_handle, &woken);
+    if (woken) esp_timer_isr_dispatch_need_yield();
+#else
+    xTaskNotifyGive(servo_task_handle);
+#endif
+}
+
+// Position and torque ramp from one setpoint to the next over a setpoint period; speed and gains step
+static void servo_interpolate(const struct gs_triton_servo_target *from, const struct gs_triton_servo_target *to,
+                              float a, struct gs_triton_servo_target *out) {
+    struct gs_triton_servo_target v = *to; // out may alias from or to
+    v.pos = from->pos + a * (to->pos - from->pos);
+    v.torque = from->torque + a * (to->torque - from->torque);
+    *out = v;
+}
+
+static void servo_send(struct can_channel *c, const rs_frame_t *rs) {
+    struct gs_host_frame_canfd frame = { .echo_id = SERVO_ECHO_ID, .can_id = 0x80000000 | rs->id, .can_dlc = 8,
+                                         .channel = c->index };
+    memcpy(frame.data, rs->data, 8);
+    struct gs_host_frame echo;
+    memset(&echo, 0, sizeof(echo));
+    memcpy(&echo, &frame, GS_HOST_FRAME_HDR_SIZE);
+    esp_err_t err = channel_is_twai(c) ? twai_send(c, &frame, &echo) : mcp_send(c, &frame, &echo);
+    if (err != ESP_OK) servo_commands_failed++;
+}
+
+static const rs_limits_t motor_limits[RS_MODEL_COUNT] = RS_MODEL_LIMITS;
+
+// GS_USB_BREQ_TRITON_MOTOR_CMD: one frame per entry, scaled with the entry's model, in the host's
+// order. They share the TX queue with everything else, so a burst beyond its room fails the rest.
+static void motor_cmd_send(const struct gs_triton_motor_cmd *cmd) {
+    static const rs_limits_t *lims[GS_TRITON_MOTOR_CMD_MAX];
+    static uint8_t ids[GS_TRITON_MOTOR_CMD_MAX];
+    static rs_command_t cmds[GS_TRITON_MOTOR_CMD_MAX];
+    static rs_frame_t frames[GS_TRITON_MOTOR_CMD_MAX];
+    for (uint32_t i = 0; i < cmd->motor_count; i++) {
+        const struct gs_triton_motor_target *t = &cmd->motor[i];
+        lims[i] = &motor_limits[t->model];
+        ids[i] = t->motor_id;
+        cmds[i] = (rs_command_t){
+            .pos = t->pos * (1.0f / GS_TRITON_MOTOR_POS_SCALE), .vel = t->vel * (1.0f / GS_TRITON_MOTOR_VEL_SCALE),
+            .torque = t->torque * (1.0f / GS_TRITON_MOTOR_TORQUE_SCALE), .kp = t->kp * (1.0f / GS_TRITON_MOTOR_KP_SCALE),
+            .kd = t->kd * (1.0f / GS_TRITON_MOTOR_KD_SCALE),
+        };
+    }
+    rs_pack_op_control_batch(cmd->motor_count, lims, ids, cmds, frames);
+    for (uint32_t i = 0; i < cmd->motor_count; i++) {
+        struct can_channel *c = &channels[cmd->motor[i].channel];
+        if (c->started) servo_send(c, &frames[i]);
+        else servo_commands_failed++;
+    }
+}
+
+// Sends one operation-control frame per motor on every servo_timer tick, so the USB round trip
+// only carries the 100 Hz setpoint stream, not the command/feedback loop itself
+void can_servo_task(void *arg) {
+    struct gs_triton_servo_config cfg = { 0 };
+    struct gs_triton_servo_target from[GS_TRITON_SERVO_MOTORS], to[GS_TRITON_SERVO_MOTORS];
+    const rs_limits_t *lims[GS_TRITON_SERVO_MOTORS];
+    rs_command_t cmds[GS_TRITON_SERVO_MOTORS];
+    rs_frame_t frames[GS_TRITON_SERVO_MOTORS];
+    struct gs_triton_servo_setpoint setpoint;
+    static struct gs_triton_motor_cmd motor_cmd;
+    int64_t ramp_start = 0, last_setpoint = 0;
+    bool have_setpoint = false;
+    for (uint32_t i = 0; i < GS_TRITON_SERVO_MOTORS; i++) lims[i] = &rs02_limits;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t now = esp_timer_get_time();
+        portENTER_CRITICAL(&servo_mux);
+        bool new_config = servo_config_posted, new_setpoint = servo_setpoint_posted;
+        if (new_config) {
+            cfg = servo_config = servo_config_post;
+            memset(servo_fb, 0, sizeof(servo_fb));
+        }
+        if (new_setpoint) setpoint = servo_setpoint_post;
+        bool new_motor_cmd = motor_cmd_posted;
+        if (new_motor_cmd) {
+            motor_cmd.motor_count = motor_cmd_post.motor_count;
+            memcpy(motor_cmd.motor, motor_cmd_post.motor, motor_cmd.motor_count * sizeof(motor_cmd.motor[0]));
+        }
+        servo_config_posted = servo_setpoint_posted = motor_cmd_posted = false;
+        portEXIT_CRITICAL(&servo_mux);
+        if (new_motor_cmd) motor_cmd_send(&motor_cmd);
+
+        if (new_config) {
+            esp_timer_stop(servo_timer);
+            have_setpoint = false;
+            servo_holding = false;
+            if (cfg.flags & GS_TRITON_SERVO_ENABLE) {
+                esp_timer_start_periodic(servo_timer, 1000000 / cfg.rate_hz);
+                TLOGI("Servo loop: %u motors on CAN%u at %lu Hz", cfg.motor_count, cfg.channel, cfg.rate_hz);
+            } else {
+                TLOGI("Servo loop stopped");
+            }
+        }
+        if (!(cfg.flags & GS_TRITON_SERVO_ENABLE)) continue;
+
+        float a = have_setpoint ? (float)(now - ramp_start) / cfg.setpoint_period_us : 1.0f;
+        if (a > 1.0f) a = 1.0f;
+        if (new_setpoint) {
+            // Ramp from wherever the command is now, so a late or early setpoint never makes a step
+            for (uint32_t i = 0; i < cfg.motor_count; i++) {
+                if (have_setpoint) servo_interpolate(&from[i], &to[i], a, &from[i]);
+                else from[i] = setpoint.motor[i];
+                to[i] = setpoint.motor[i];
+            }
+            ramp_start = last_setpoint = now;
+            a = 0.0f;
+            have_setpoint = true;
+            servo_holding = false;
+            servo_seq = setpoint.seq;
+        }
+        if (!have_setpoint) continue; // nothing is sent before the first setpoint
+
+        if (!servo_holding && now - last_setpoint > (int64_t)cfg.timeout_ms * 1000) {
+            // Host went quiet: hold the commanded position, no speed or feed-forward torque
+            for (uint32_t i = 0; i < cfg.motor_count; i++) {
+                servo_interpolate(&from[i], &to[i], a, &from[i]);
+                from[i].vel = 0.0f;
+                from[i].torque = 0.0f;
+                to[i] = from[i];
+            }
+            servo_holding = true;
+            servo_timeouts++;
+            TLOGW("Servo setpoints timed out, holding position");
+        }
+
+        struct can_channel *c = &channels[cfg.channel];
+        if (!c->started) continue;
+        // Pack the whole tick's frames first, then send them back to back
+        for (uint32_t i = 0; i < cfg.motor_count; i++) {
+            struct gs_triton_servo_target cmd;
+            servo_interpolate(&from[i], &to[i], a, &cmd);
+            cmds[i] = (rs_command_t){ cmd.pos, cmd.vel, cmd.torque, cmd.kp, cmd.kd };
+        }
+        rs_pack_op_control_batch(cfg.motor_count, lims, cfg.motor_id, cmds, frames);
+        for (uint32_t i = 0; i < cfg.motor_count; i++) servo_send(c, &frames[i]);
+    }
+}
+
+// --- LOOPBACK SELF-TEST ---
+static IRAM_ATTR void selftest_timer_cb(void *arg) {
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(selftest_task_handle, &woken);
+    if (woken) esp_timer_isr_dispatch_need_yield();
+#else
+    xTaskNotifyGive(selftest_task_handle);
+#endif
+}
+
+// Tracked before the send, since the loopback can be received before the submit returns.
+// Returns false when the TX path is full.
+static bool selftest_send(struct can_channel *c, uint32_t seq, uint32_t *rng) {
+    const struct gs_triton_selftest_config *cfg = &selftest_run;
+    *rng ^= *rng << 13; *rng ^= *rng >> 17; *rng ^= *rng << 5; // xorshift32
+    struct gs_host_frame_canfd frame = {
+        .echo_id = SELFTEST_ECHO_ID, .can_id = cfg->can_id + seq % cfg->id_count,
+        .can_dlc = cfg->dlc_min + *rng % (cfg->dlc_max - cfg->dlc_min + 1), .channel = 0,
+    };
+    memcpy(frame.data, &seq, sizeof(seq));
+    struct gs_host_frame echo;
+    memset(&echo, 0, sizeof(echo));
+    memcpy(&echo, &frame, GS_HOST_FRAME_HDR_SIZE);
+
+    portENTER_CRITICAL(&selftest_mux);
+    if (selftest_track_head - selftest_track_tail >= SELFTEST_TRACK_LEN) {
+        selftest_track_tail++; // never came back
+        selftest_result.lost++;
+    }
+    uint32_t slot = selftest_track_head++;
+    selftest_track[slot & (SELFTEST_TRACK_LEN - 1)] = (struct selftest_sent){
+        .can_id = frame.can_id, .time_us = (uint32_t)esp_timer_get_time()
+    };
+    portEXIT_CRITICAL(&selftest_mux);
+
+    esp_err_t err = twai_send(c, &frame, &echo);
+    if (err == ESP_OK) {
+        selftest_result.generated++;
+        return true;
+    }
+    portENTER_CRITICAL(&selftest_mux);
+    selftest_track_head = slot; // never on the bus
+    if (selftest_track_tail == slot + 1) selftest_track_tail = slot; // matched by another node's frame
+    portEXIT_CRITICAL(&selftest_mux);
+    if (err == ESP_ERR_NO_MEM) return false;
+    selftest_result.generated++;
+    selftest_result.tx_failed++;
+    return true;
+}
+
+// Paces the generator on the esp_timer clock: every tick sends what the rate owes since the run
+// started. A TX path that can't keep up skips the backlog rather than bursting it out later.
+void can_selftest_task(void *arg) {
+    uint64_t emitted = 0;
+    uint32_t seq = 0, rng = 1;
+    int64_t run_start = 0;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        struct can_channel *c = &channels[0];
+        if (!selftest_running || !c->started || !(selftest_config.flags & GS_TRITON_SELFTEST_ENABLE)) continue;
+        if (run_start != selftest_start_us) { // new run
+            run_start = selftest_start_us;
+            emitted = 0;
+            seq = 0;
+            rng = 0x2545F491;
+        }
+        uint64_t due = (uint64_t)(esp_timer_get_time() - run_start) * selftest_run.rate_pps / 1000000;
+        if (due - emitted > SELFTEST_TRACK_LEN) {
+            selftest_result.tx_skipped += (uint32_t)(due - emitted - SELFTEST_TRACK_LEN);
+            emitted = due - SELFTEST_TRACK_LEN;
+        }
+        while (emitted < due && selftest_send(c, seq, &rng)) {
+            emitted++;
+            seq++;
+        }
+    }
+}
+
+static uint32_t gs_state_from_twai(twai_error_state_t state) {
+    switch (state) {
+        case TWAI_ERROR_BUS_OFF: return GS_CAN_STATE_BUS_OFF;
+        case TWAI_ERROR_PASSIVE: return GS_CAN_STATE_ERROR_PASSIVE;
+        case TWAI_ERROR_WARNING: return GS_CAN_STATE_ERROR_WARNING;
+        default: return GS_CAN_STATE_ERROR_ACTIVE;
+    }
+}
+
+static void error_frame_init(struct gs_host_frame *frame) {
+    memset(frame, 0, sizeof(*frame));
+    frame->echo_id = 0xFFFFFFFF;
+    frame->can_id = CAN_ERR_FLAG | CAN_ERR_CNT;
+    frame->can_dlc = CAN_ERR_DLC;
+}
+
+// The state change part of an error frame (the kernel updates can.state from it). tx: the TX
+// error counter is the one past the warning/passive threshold.
+static void error_frame_state(struct can_channel *c, struct gs_host_frame *frame, uint32_t state, bool tx) {
+    uint32_t prev = c->stats.bus_state;
+    if (state == prev) return;
+    if (state == GS_CAN_STATE_BUS_OFF) {
+        frame->can_id |= CAN_ERR_BUSOFF;
+        c->stats.bus_off_count++;
+    } else if (prev == GS_CAN_STATE_BUS_OFF) {
+        frame->can_id |= CAN_ERR_RESTARTED;
+    }
+    if (state == GS_CAN_STATE_ERROR_PASSIVE) {
+        frame->can_id |= CAN_ERR_CRTL;
+        frame->data[1] |= tx ? CAN_ERR_CRTL_TX_PASSIVE : CAN_ERR_CRTL_RX_PASSIVE;
+    } else if (state == GS_CAN_STATE_ERROR_WARNING) {
+        frame->can_id |= CAN_ERR_CRTL;
+        frame->data[1] |= tx ? CAN_ERR_CRTL_TX_WARNING : CAN_ERR_CRTL_RX_WARNING;
+    } else if (state == GS_CAN_STATE_ERROR_ACTIVE) {
+        frame->can_id |= CAN_ERR_CRTL;
+        frame->data[1] |= CAN_ERR_CRTL_ACTIVE;
+    }
+    c->stats.bus_state = state;
+}
+
+static void send_error_frame(struct can_channel *c, struct gs_host_frame *frame, uint32_t tec, uint32_t rec) {
+    if (frame->can_id == (CAN_ERR_FLAG | CAN_ERR_CNT)) return; // only unreported bus errors
+    frame->channel = c->index;
+    frame->data[6] = tec > 255 ? 255 : tec;
+    frame->data[7] = rec > 255 ? 255 : rec;
+    frame->timestamp_us = (uint32_t)esp_timer_get_time();
+    c->stats.err_frames++;
+    if (xQueueSend(echo_queue, frame, 0) == pdTRUE) fwd_notify();
+    else c->stats.err_dropped++;
+}
+
+// --- TWAI CALLBACKS (ISR) ---
+// Same ring push as rx_ring_push(), from a TWAI channel's RX callback
+static IRAM_ATTR bool rx_ring_push_from_isr(struct can_channel *c, uint32_t can_id, uint8_t dlc, uint8_t flags,
+                                            const uint8_t *data, uint32_t ts, BaseType_t *woken) {
+    struct rx_ring *ring = &c->rx_ring;
+    flags |= TRACE_SAMPLE(c);
+    if (!rx_ring_put(ring, c->index, can_id, dlc, flags, data, ts)) {
+        c->stats.rx_dropped++;
+        ftrace(c, GS_TRITON_FTRACE_RX, can_id, dlc, flags, 1, ts);
+        return false;
+    }
+    ftrace(c, GS_TRITON_FTRACE_RX, can_id, dlc, flags, 0, ts);
+    if (flags & RX_FLAG_TRACE) trace_put(GS_TRITON_TRACE_RX_RING, c->index, can_id, ts, (uint32_t)esp_timer_get_time());
+    uint32_t depth = ring->head - ring->tail;
+    if (depth > c->stats.rx_ring_hwm) c->stats.rx_ring_hwm = depth;
+    if (fwd_task_handle) vTaskNotifyGiveFromISR(fwd_task_handle, woken);
+    return true;
+}
+
+// Gateway sends can wait on a TX lock, so they go to can_event_task. A full deferral queue drops.
+static IRAM_ATTR void twai_defer_gateway(struct twai_ctl *t, uint32_t rules, uint32_t can_id, uint8_t dlc,
+                                         const uint8_t *data, BaseType_t *woken) {
+    struct twai_event ev = { .type = TWAI_EV_GATEWAY, .gw = { .rules = rules, .can_id = can_id, .dlc = dlc } };
+    memcpy(ev.gw.data, data, 8);
+    if (__atomic_load_n(&t->gateway_pending, __ATOMIC_RELAXED) < TWAI_GATEWAY_DEFER &&
+        xQueueSendFromISR(t->events, &ev, woken) == pdTRUE) {
+        __atomic_add_fetch(&t->gateway_pending, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    for (uint32_t i = 0; rules; i++, rules >>= 1) {
+        if (rules & 1) gateway_table[i].dropped++;
+    }
+}
+
+// A TWAI channel's RX path: straight from the controller into the ring, with no driver queue or
+// task switch in between. Kept in IRAM so a flash cache miss can't stall it.
+static inline IRAM_ATTR bool twai_rx_frame(const twai_frame_t *msg, struct can_channel *c) {
+    const uint8_t *data = msg->buffer; // all 8 bytes, zero past the DLC
+    uint32_t ts = (uint32_t)esp_timer_get_time();
+    uint32_t t0 = STAGE_CYCLES();
+    BaseType_t woken = pdFALSE;
+    c->stats.rx_frames++;
+    last_can_id = msg->header.id;
+
+    uint32_t can_id = twai_rx_can_id(&msg->header);
+    uint8_t dlc = msg->header.dlc > 8 ? 8 : msg->header.dlc;
+    uint8_t flags = 0;
+    if (c->index == 0 && selftest_running && selftest_match(can_id, &ts)) {
+        flags = RX_FLAG_SELFTEST;
+    } else {
+        bool consumed = false;
+        uint32_t rules = gateway_match(c, can_id, &consumed);
+        if (rules) twai_defer_gateway(&twai[c->index], rules, can_id, dlc, data, &woken);
+        if (servo_take_feedback(c, can_id, data, msg->header.dlc) || consumed) return woken == pdTRUE;
+        if (rx_mailbox_put(&c->mailbox, can_id, msg->header.dlc, 0, data, dlc, ts)) return woken == pdTRUE;
+    }
+    if (!rx_filter_match(&c->rx_filter, can_id)) {
+        c->stats.rx_filtered++;
+    } else if (flags || !rx_decimate(c, can_id, msg->header.dlc, data, dlc, ts)) {
+        if (rx_ring_push_from_isr(c, can_id, msg->header.dlc, flags, data, ts, &woken)) {
+            STAGE_SAMPLE(c->stats.hist_rx_cycles, STAGE_CYCLES() - t0);
+        }
+    }
+    return woken == pdTRUE;
+}
+
+static IRAM_ATTR bool twai_on_rx(triton_twai_ctrl_t *ctrl, const twai_frame_t *frame, void *ctx) {
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    bool woken = twai_rx_frame(frame, ctx);
+    isr_account(t0);
+    return woken;
+}
+
+static IRAM_ATTR bool twai_on_tx_done(triton_twai_ctrl_t *ctrl, uint32_t seq, bool ok, void *ctx) {
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    struct twai_ctl *t = &twai[((struct can_channel *)ctx)->index];
+    BaseType_t woken = pdFALSE;
+    struct twai_event ev = {
+        .type = TWAI_EV_TX_DONE,
+        .tx = { .seq = seq, .ok = ok, .time_us = (uint32_t)esp_timer_get_time() },
+    };
+    xQueueSendFromISR(t->events, &ev, &woken);
+    isr_account(t0);
+    return woken == pdTRUE;
+}
+
+static IRAM_ATTR void twai_post_status(struct twai_ctl *t, bool arb_lost, bool bus_error, BaseType_t *woken) {
+    portENTER_CRITICAL_ISR(&t->status_mux);
+    t->status.arb_lost |= arb_lost;
+    t->status.bus_error |= bus_error;
+    bool post = !t->status.posted;
+    t->status.posted = true;
+    portEXIT_CRITICAL_ISR(&t->status_mux);
+    struct twai_event ev = { .type = TWAI_EV_STATUS };
+    if (post) xQueueSendFromISR(t->events, &ev, woken);
+}
+
+static IRAM_ATTR bool twai_on_state(triton_twai_ctrl_t *ctrl, twai_error_state_t state, void *ctx) {
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    BaseType_t woken = pdFALSE;
+    twai_post_status(&twai[((struct can_channel *)ctx)->index], false, false, &woken);
+    isr_account(t0);
+    return woken == pdTRUE;
+}
+
+static IRAM_ATTR bool twai_on_error(triton_twai_ctrl_t *ctrl, twai_error_flags_t f, void *ctx) {
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    struct can_channel *c = ctx;
+    BaseType_t woken = pdFALSE;
+    c->stats.bus_errors++;
+    if (f.arb_lost) c->stats.arb_lost++;
+    // Bus errors only become error frames with GS_CAN_MODE_BERR_REPORTING
+    if (c->berr_reporting) twai_post_status(&twai[c->index], f.arb_lost, f.bit_err || f.form_err || f.stuff_err || f.ack_err, &woken);
+    isr_account(t0);
+    return woken == pdTRUE;
+}
+
+// --- TWAI EVENTS ---
+// Completions come in transmit order, so a completed frame echoes every in-flight frame up to and
+// including it: one further in than the oldest means completions were lost on the way, and the
+// frames before it went out first (their echoes share done_us). A seq outside the in-flight window
+// is from an earlier session.
+static void twai_tx_done(struct can_channel *c, uint32_t seq, bool ok, uint32_t done_us) {
+    static struct gs_host_frame done[TX_QUEUE_LEN];
+    struct gs_host_frame refused[TWAI_NODE_DEPTH];
+    uint32_t n = 0, r = 0;
+    xSemaphoreTake(c->tx_lock, portMAX_DELAY);
+    uint32_t inflight = uxQueueMessagesWaiting(c->tx_inflight_queue);
+    uint32_t ahead = seq - (twai[c->index].tx_head - inflight);
+    if (ahead < inflight) {
+        while (n <= ahead) xQueueReceive(c->tx_inflight_queue, &done[n++], 0);
+    }
+    if (c->started) r = twai_prio_feed(c, refused);
+    xSemaphoreGive(c->tx_lock);
+    for (uint32_t i = 0; i < n; i++) tx_echo_at(&done[i], !ok && i == n - 1, done_us);
+    for (uint32_t i = 0; i < r; i++) tx_echo(&refused[i], true);
+    if (n && tx_task_handle) xTaskNotifyGive(tx_task_handle);
+}
+
+// Reports the node's state to the host and starts recovery from bus-off. The node keeps its TX
+// queue through bus-off and recovery, and reports each frame through on_tx_done.
+static void twai_report_status(struct can_channel *c) {
+    struct twai_ctl *t = &twai[c->index];
+    portENTER_CRITICAL(&t->status_mux);
+    bool arb_lost = t->status.arb_lost, bus_error = t->status.bus_error;
+    t->status.arb_lost = t->status.bus_error = t->status.posted = false;
+    portEXIT_CRITICAL(&t->status_mux);
+
+    twai_node_status_t status;
+    if (!c->started || triton_twai_ctrl_get_status(t->ctrl, &status) != ESP_OK) return;
+    uint32_t prev = c->stats.bus_state;
+    uint32_t state = gs_state_from_twai(status.state);
+    struct gs_host_frame frame;
+    error_frame_init(&frame);
+    error_frame_state(c, &frame, state, status.tx_error_count >= status.rx_error_count);
+    if (arb_lost) frame.can_id |= CAN_ERR_LOSTARB;
+    if (bus_error) frame.can_id |= CAN_ERR_PROT | CAN_ERR_BUSERROR;
+    c->stats.tec = status.tx_error_count;
+    c->stats.rec = status.rx_error_count;
+    send_error_frame(c, &frame, status.tx_error_count, status.rx_error_count);
+
+    if (state == GS_CAN_STATE_BUS_OFF && prev != GS_CAN_STATE_BUS_OFF) {
+        TLOGW("CAN%u: Bus-off (TEC %u), recovering", c->index, status.tx_error_count);
+        xSemaphoreTake(c->tx_lock, portMAX_DELAY);
+        if (c->started) triton_twai_ctrl_recover(t->ctrl);
+        xSemaphoreGive(c->tx_lock);
+    } else if (prev == GS_CAN_STATE_BUS_OFF && state != GS_CAN_STATE_BUS_OFF) {
+        TLOGI("CAN%u: Bus recovered", c->index);
+    }
+}
+
+// A TWAI channel's task side, one task per controller on its core: echoes, error frames, bus-off
+// recovery and gateway sends, in the order the ISR posted them
+void can_event_task(void *arg) {
+    struct can_channel *c = arg;
+    struct twai_ctl *t = &twai[c->index];
+    struct twai_event ev;
+    TLOGI("CAN%u Listener Ready", c->index);
+
+    while (1) {
+        if (xQueueReceive(t->events, &ev, portMAX_DELAY) != pdTRUE) continue;
+        switch (ev.type) {
+            case TWAI_EV_TX_DONE:
+                twai_tx_done(c, ev.tx.seq, ev.tx.ok, ev.tx.time_us);
+                break;
+            case TWAI_EV_STATUS:
+                twai_report_status(c);
+                break;
+            case TWAI_EV_GATEWAY:
+                gateway_forward(ev.gw.rules, ev.gw.can_id, ev.gw.dlc, 0, ev.gw.data);
+                __atomic_sub_fetch(&t->gateway_pending, 1, __ATOMIC_RELAXED);
+                break;
+        }
+    }
+}
+
+// --- MCP2518FD CHANNELS ---
+static uint32_t mcp_gs_state(const mcp251xfd_events_t *ev) {
+    if (ev->status & MCP251XFD_ST_BUS_OFF) return GS_CAN_STATE_BUS_OFF;
+    if (ev->status & (MCP251XFD_ST_TX_PASSIVE | MCP251XFD_ST_RX_PASSIVE)) return GS_CAN_STATE_ERROR_PASSIVE;
+    if (ev->status & MCP251XFD_ST_WARN) return GS_CAN_STATE_ERROR_WARNING;
+    return GS_CAN_STATE_ERROR_ACTIVE;
+}
+
+// Same error frames as the TWAI channels', built from the chip's interrupt flags and TREC.
+// The chip leaves bus-off on its own after 128 x 11 recessive bits, so there is nothing to recover.
+static void mcp_report_events(struct can_channel *c, const mcp251xfd_events_t *ev) {
+    struct gs_host_frame frame;
+    error_frame_init(&frame);
+    uint32_t state = mcp_gs_state(ev);
+    error_frame_state(c, &frame, state, state == GS_CAN_STATE_ERROR_PASSIVE ? (ev->status & MCP251XFD_ST_TX_PASSIVE)
+                                                                           : (ev->status & MCP251XFD_ST_TX_WARN));
+    if (ev->flags & MCP251XFD_EV_RX_OVERFLOW) {
+        c->stats.rx_overrun++;
+        frame.can_id |= CAN_ERR_CRTL;
+        frame.data[1] |= CAN_ERR_CRTL_RX_OVERFLOW;
+    }
+    if (ev->flags & MCP251XFD_EV_BUS_ERR) {
+        c->stats.bus_errors++;
+        if (c->berr_reporting) frame.can_id |= CAN_ERR_PROT | CAN_ERR_BUSERROR;
+    }
+    if (ev->flags & MCP251XFD_EV_SYS_ERR) TLOGW("CAN%u: MCP251xFD system error", c->index);
+
+    c->stats.tec = ev->tec;
+    c->stats.rec = ev->rec;
+    send_error_frame(c, &frame, ev->tec, ev->rec);
+}
+
+// One TEF entry per completed frame, in transmit order: echo the oldest in-flight frame for each.
+// A bus-off chip keeps its TX FIFO and sends it after recovery, so there is no failed path here.
+// The TEF's own timestamps run on the chip's clock: echoes take done_us, the time the interrupt was
+// serviced, as the RX frames of the same pass do.
+static void mcp_tx_done(struct can_channel *c, uint32_t done_us) {
+    struct gs_host_frame done[MCP251XFD_TX_DEPTH];
+    uint32_t n = 0, seq, ts;
+    xSemaphoreTake(c->tx_lock, portMAX_DELAY);
+    while (c->started && n < MCP251XFD_TX_DEPTH && mcp251xfd_read_tef(c->mcp, &seq, &ts) == ESP_OK) {
+        if (xQueueReceive(c->tx_inflight_queue, &done[n], 0) == pdTRUE) n++;
+    }
+    xSemaphoreGive(c->tx_lock);
+    for (uint32_t i = 0; i < n; i++) tx_echo_at(&done[i], false, done_us);
+    if (n && tx_task_handle) xTaskNotifyGive(tx_task_handle);
+}
+
+static void mcp_channel_task(void *arg) {
+    struct can_channel *c = arg;
+    mcp251xfd_events_t ev;
+    mcp251xfd_frame_t msg;
+    TLOGI("CAN%u Listener Ready", c->index);
+
+    while (1) {
+        // Woken by the INT falling edge; the timeout covers an edge lost while INT was already low
+        bool woken = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100)) != 0;
+        if (!c->started) continue;
+        if (woken) STAGE_SAMPLE(c->stats.hist_rx_wake, (uint32_t)esp_timer_get_time() - mcp251xfd_int_time_us(c->mcp));
+        do {
+            if (mcp251xfd_read_events(c->mcp, &ev) != ESP_OK) break;
+            // No per-frame hook into the host clock: stamp the batch when the interrupt is serviced
+            uint32_t ts = (uint32_t)esp_timer_get_time();
+            if (ev.flags & MCP251XFD_EV_RX) {
+                while (mcp251xfd_receive(c->mcp, &msg) == ESP_OK) {
+                    uint32_t t0 = STAGE_CYCLES();
+                    bool pushed;
+                    c->stats.rx_frames++;
+                    last_can_id = msg.id;
+                    uint32_t can_id = msg.id;
+                    if (msg.flags & MCP251XFD_FLAG_EXTD) can_id |= 0x80000000;
+                    if (msg.flags & MCP251XFD_FLAG_RTR) can_id |= 0x40000000;
+                    uint8_t flags = 0, dlc = msg.dlc > 8 ? 8 : msg.dlc;
+                    if (msg.flags & MCP251XFD_FLAG_FD) {
+                        flags = GS_CAN_FLAG_FD;
+                        if (msg.flags & MCP251XFD_FLAG_BRS) flags |= GS_CAN_FLAG_BRS;
+                        if (msg.flags & MCP251XFD_FLAG_ESI) flags |= GS_CAN_FLAG_ESI;
+                        dlc = msg.dlc;
+                    }
+                    bool consumed = gateway_route(c, can_id, dlc, flags, msg.data);
+                    if ((!(flags & GS_CAN_FLAG_FD) && servo_take_feedback(c, can_id, msg.data, msg.dlc)) || consumed) continue;
+                    uint32_t len = (flags & GS_CAN_FLAG_FD) ? gs_can_fd_dlc2len(dlc) : dlc;
+                    if (rx_mailbox_put(&c->mailbox, can_id, dlc, flags, msg.data, len, ts)) continue;
+                    if (!rx_filter_match(&c->rx_filter, can_id)) { c->stats.rx_filtered++; continue; }
+                    if (rx_decimate(c, can_id, msg.dlc, msg.data, len, ts)) continue;
+                    pushed = rx_ring_push(c, can_id, dlc, flags, msg.data, ts);
+                    if (pushed) STAGE_SAMPLE(c->stats.hist_rx_cycles, STAGE_CYCLES() - t0);
+                }
+            }
+            if (ev.flags & MCP251XFD_EV_TEF) mcp_tx_done(c, ts);
+            mcp_report_events(c, &ev);
+        } while (c->started && mcp251xfd_int_pending(c->mcp)); // INT is a level: service until released
+    }
+}
+
+#if MCP_CHANNELS
+static const struct { gpio_num_t cs_io, int_io; } mcp_pins[MCP_CHANNELS] = {
+    { CONFIG_TRITON_MCP_CS1_GPIO, CONFIG_TRITON_MCP_INT1_GPIO },
+#if MCP_CHANNELS > 1
+    { CONFIG_TRITON_MCP_CS2_GPIO, CONFIG_TRITON_MCP_INT2_GPIO },
+#endif
+};
+
+// A chip that does not answer keeps its channel number (so the MCP channels never swap) but fails to start
+static void mcp_channels_init(void) {
+    spi_bus_config_t bus = {
+        .mosi_io_num = CONFIG_TRITON_MCP_MOSI_GPIO, .miso_io_num = CONFIG_TRITON_MCP_MISO_GPIO,
+        .sclk_io_num = CONFIG_TRITON_MCP_SCLK_GPIO, .quadwp_io_num = -1, .quadhd_io_num = -1,
+        .max_transfer_sz = 128,
+    };
+    if (spi_bus_initialize(MCP_SPI_HOST, &bus, SPI_DMA_CH_AUTO) != ESP_OK) {
+        ESP_LOGE(TAG, "SPI bus init failed, MCP channels disabled");
+        return;
+    }
+    for (uint32_t i = 0; i < MCP_CHANNELS; i++) {
+        struct can_channel *c = &channels[TWAI_CHANNELS + i];
+        mcp251xfd_config_t config = {
+            .host = MCP_SPI_HOST, .cs_io = mcp_pins[i].cs_io, .int_io = mcp_pins[i].int_io,
+            .spi_clock_hz = CONFIG_TRITON_MCP_SPI_CLOCK_HZ, .osc_hz = CONFIG_TRITON_MCP_OSC_HZ,
+        };
+        if (mcp251xfd_init(&config, c->task, &c->mcp) != ESP_OK) {
+            c->mcp = NULL;
+            ESP_LOGE(TAG, "CAN%lu: no MCP251xFD on CS %d", TWAI_CHANNELS + i, config.cs_io);
+        }
+        bt_const[TWAI_CHANNELS + i] = (struct gs_device_bt_const_extended) {
+            // No triple sampling on the MCP2518FD
+            .feature = GS_CAN_FEATURE_LISTEN_ONLY | GS_CAN_FEATURE_LOOP_BACK | GS_CAN_FEATURE_ONE_SHOT |
+                       GS_CAN_FEATURE_HW_TIMESTAMP | GS_CAN_FEATURE_BERR_REPORTING | GS_CAN_FEATURE_GET_STATE |
+                       GS_CAN_FEATURE_FD | GS_CAN_FEATURE_BT_CONST_EXT,
+            .fclk_can = CONFIG_TRITON_MCP_OSC_HZ,
+            .tseg1_min = 2, .tseg1_max = 256, .tseg2_min = 1, .tseg2_max = 128, .sjw_max = 128,
+            .brp_min = 1, .brp_max = 256, .brp_inc = 1,
+            .dtseg1_min = 1, .dtseg1_max = 32, .dtseg2_min = 1, .dtseg2_max = 16, .dsjw_max = 16,
+            .dbrp_min = 1, .dbrp_max = 256, .dbrp_inc = 1
+        };
+    }
+}
+#endif
+
+// --- STATIC MEMORY ---
+// Tasks, queues and locks of the bridge live in internal DRAM (.bss), sized at build time by the
+// tuning menu: nothing on the data path allocates, and a restart can't fragment anything. Left on
+// the heap, once at boot: the esp_timer handles, the SPI/GPIO ISR services and TinyUSB's own state,
+// and the TWAI node, which the driver allocates when a mode change makes it recreate it (E.).
+#define BRIDGE_TASKS (7 + TWAI_CHANNELS + MCP_CHANNELS)
+#define ECHO_QUEUE_LEN (TWAI_CHANNELS * TX_QUEUE_LEN + MCP_CHANNELS * MCP251XFD_TX_DEPTH + 16) // every in-flight echo plus error frames
+struct task_mem { StaticTask_t tcb; StackType_t stack[TASK_STACK_SIZE]; };
+static struct task_mem task_mem[BRIDGE_TASKS];
+static uint32_t task_mem_used;
+static StaticQueue_t echo_queue_buf, twai_events_buf[TWAI_CHANNELS];
+static uint8_t echo_queue_storage[ECHO_QUEUE_LEN * sizeof(struct gs_host_frame)];
+static uint8_t twai_events_storage[TWAI_CHANNELS][TWAI_EVENT_QUEUE_LEN * sizeof(struct twai_event)];
+static struct gs_host_frame twai_inflight_storage[TWAI_CHANNELS][TX_QUEUE_LEN];
+#if MCP_CHANNELS
+static struct gs_host_frame mcp_inflight_storage[MCP_CHANNELS][MCP251XFD_TX_DEPTH];
+#endif
+static struct { StaticQueue_t inflight; StaticSemaphore_t lock; } channel_sync[TRITON_CHANNELS];
+
+// StackType_t is a byte on this port, so TASK_STACK_SIZE is in bytes as for xTaskCreate
+static TaskHandle_t start_task(TaskFunction_t fn, const char *name, void *arg, UBaseType_t priority, BaseType_t core) {
+    configASSERT(task_mem_used < BRIDGE_TASKS);
+    struct task_mem *m = &task_mem[task_mem_used++];
+    return xTaskCreateStaticPinnedToCore(fn, name, TASK_STACK_SIZE, arg, priority, m->stack, &m->tcb, core);
 }
 
 void app_main(void) {
     ESP_LOGI(TAG, "=== v32 STABLE PRODUCTION ===");
-    pending_mode.flags = MAGIC_FLAG;
-    can_to_usb_queue = xQueueCreate(128, sizeof(struct gs_host_frame));
+    echo_queue = xQueueCreateStatic(ECHO_QUEUE_LEN, sizeof(struct gs_host_frame), echo_queue_storage, &echo_queue_buf);
+    for (uint32_t ch = 0; ch < TWAI_CHANNELS; ch++) {
+        twai[ch].events = xQueueCreateStatic(TWAI_EVENT_QUEUE_LEN, sizeof(struct twai_event), twai_events_storage[ch],
+                                             &twai_events_buf[ch]);
+        portMUX_INITIALIZE(&twai[ch].status_mux);
+        // Pins and menu bitrate from the triton_twai menu; the node is created on the first start
+        const triton_twai_callbacks_t cbs = {
+            .on_rx = twai_on_rx, .on_tx_done = twai_on_tx_done, .on_state = twai_on_state, .on_error = twai_on_error,
+            .ctx = &channels[ch],
+        };
+        if (triton_twai_ctrl_open(ch, NULL, &cbs, &twai[ch].ctrl) != ESP_OK) ESP_LOGE(TAG, "CAN%lu: no TWAI controller", ch);
+        // The timing limits are the same on every controller; the clock is the target's TWAI default
+        uint32_t fclk_hz;
+        if (ch > 0) bt_const[ch] = bt_const[0];
+        if (esp_clk_tree_src_get_freq_hz((soc_module_clk_t)TWAI_CLK_SRC_DEFAULT, ESP_CLK_TREE_SRC_FREQ_PRECISION_CACHED,
+                                         &fclk_hz) == ESP_OK) bt_const[ch].fclk_can = fclk_hz;
+    }
+    for (uint32_t ch = 0; ch < TRITON_CHANNELS; ch++) {
+        struct can_channel *c = &channels[ch];
+        c->index = ch;
+        c->stats.version = GS_TRITON_STATS_VERSION;
+        c->stats.size = sizeof(struct gs_triton_stats);
+        c->stats.bus_state = GS_CAN_STATE_STOPPED;
+        c->rx_filter.hw_mask = 0xFFFFFFFF; // accept all
+#if MCP_CHANNELS
+        if (!channel_is_twai(c)) {
+            c->rx_ring.slots = (uint8_t *)mcp_rx_slots[ch - TWAI_CHANNELS];
+            c->rx_ring.slot_size = sizeof(struct gs_host_frame_canfd);
+        } else
+#endif
+        {
+            c->rx_ring.slots = (uint8_t *)twai_rx_slots[ch];
+            c->rx_ring.slot_size = sizeof(struct gs_host_frame);
+        }
+#if CONFIG_TRITON_RX_SPILL_FRAMES
+        // Without the PSRAM tier a full ring goes straight to the overflow policy
+        c->rx_spill.slot_size = c->rx_ring.slot_size;
+        c->rx_spill.slots = heap_caps_malloc(RX_SPILL_FRAMES * c->rx_spill.slot_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (c->rx_spill.slots) c->rx_spill.len = RX_SPILL_FRAMES;
+        else ESP_LOGW(TAG, "CAN%lu: no PSRAM for %u spill frames", ch, RX_SPILL_FRAMES);
+#endif
+        c->rx_filter.hw_single = 1;
+        // In flight is bounded by the controller's own TX buffer, so transmit never has to wait
+        uint8_t *inflight = channel_is_twai(c) ? (uint8_t *)twai_inflight_storage[ch] : NULL;
+#if MCP_CHANNELS
+        if (!channel_is_twai(c)) inflight = (uint8_t *)mcp_inflight_storage[ch - TWAI_CHANNELS];
+#endif
+        c->tx_inflight_queue = xQueueCreateStatic(channel_is_twai(c) ? TX_QUEUE_LEN : MCP251XFD_TX_DEPTH, sizeof(struct gs_host_frame),
+                                                  inflight, &channel_sync[ch].inflight);
+        c->tx_lock = xSemaphoreCreateMutexStatic(&channel_sync[ch].lock);
+        pending_mode[ch].flags = MAGIC_FLAG;
+    }
+    const esp_timer_create_args_t batch_timer_args = { .callback = batch_timer_cb, .name = "usb_batch" };
+    esp_timer_create(&batch_timer_args, &batch_timer);
+    const esp_timer_create_args_t stats_timer_args = { .callback = stats_timer_cb, .name = "stats" };
+    esp_timer_create(&stats_timer_args, &stats_timer);
+    esp_timer_start_periodic(stats_timer, 1000000);
+    const esp_timer_create_args_t cyclic_timer_args = {
+        .callback = cyclic_timer_cb, .name = "can_cyclic",
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+        .dispatch_method = ESP_TIMER_ISR, // straight from the systimer interrupt, no esp_timer task hop
+#endif
+    };
+    esp_timer_create(&cyclic_timer_args, &cyclic_timer);
+    const esp_timer_create_args_t servo_timer_args = {
+        .callback = servo_timer_cb, .name = "can_servo",
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+        .dispatch_method = ESP_TIMER_ISR,
+#endif
+    };
+    esp_timer_create(&servo_timer_args, &servo_timer);
+    const esp_timer_create_args_t selftest_timer_args = {
+        .callback = selftest_timer_cb, .name = "can_selftest",
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+        .dispatch_method = ESP_TIMER_ISR,
+#endif
+    };
+    esp_timer_create(&selftest_timer_args, &selftest_timer);
 
+    // Before USB comes up, so the host never sees a half-initialized channel. The tasks
+    // go first: the driver needs their handles for the INT notification.
+    for (uint32_t ch = TWAI_CHANNELS; ch < TRITON_CHANNELS; ch++) {
+        channels[ch].task = start_task(mcp_channel_task, "can_mcp", &channels[ch], CAN_TASK_PRIORITY, CAN_TASK_CORE);
+    }
+#if MCP_CHANNELS
+    mcp_channels_init();
+#endif
+    autostart_boot();
+
+#if CONFIG_TRITON_SPI_LINK
+    // No USB: the link task takes the forwarder's place and answers control requests itself
+    packed_mode = true;
+    log_task_handle = start_task(log_task, "log", NULL, 1, USB_TASK_CORE);
+    fwd_task_handle = start_task(spi_link_task, "spi_link", NULL, CAN_TASK_PRIORITY, USB_TASK_CORE);
+#else
+    usb_serial_init();
+#if CONFIG_IDF_TARGET_ESP32P4
+    // The high-speed OTG controller (tusb_config.h) sits behind the UTMI PHY
+    usb_phy_config_t phy_conf = { .controller = USB_PHY_CTRL_OTG, .target = USB_PHY_TARGET_UTMI, .otg_mode = USB_OTG_MODE_DEVICE };
+#else
     usb_phy_config_t phy_conf = { .controller = USB_PHY_CTRL_OTG, .target = USB_PHY_TARGET_INT, .otg_mode = USB_OTG_MODE_DEVICE };
+#endif
     usb_new_phy(&phy_conf, &phy_handle);
     tusb_init();
 
-    xTaskCreate(usb_manager_task, "usb_mgr", 4096, NULL, 5, NULL);
-    xTaskCreate(can_forward_task, "fwd_task", 4096, NULL, 4, NULL);
-    xTaskCreate(can_rx_task, "can_rx", 4096, NULL, 4, NULL);
+    start_task(usb_manager_task, "usb_mgr", NULL, CONTROL_TASK_PRIORITY, USB_TASK_CORE);
+    log_task_handle = start_task(log_task, "log", NULL, 1, USB_TASK_CORE);
+    fwd_task_handle = start_task(can_forward_task, "fwd_task", NULL, CAN_TASK_PRIORITY, USB_TASK_CORE);
+#endif
+    tx_task_handle = start_task(can_tx_task, "can_tx", NULL, CAN_TASK_PRIORITY, CAN_TASK_CORE);
+    for (uint32_t ch = 0; ch < TWAI_CHANNELS; ch++) {
+#if PIN_TASKS_TO_CORES
+        start_task(can_event_task, "can_event", &channels[ch], CAN_TASK_PRIORITY, twai_cores[ch]);
+#else
+        start_task(can_event_task, "can_event", &channels[ch], CAN_TASK_PRIORITY, tskNO_AFFINITY);
+#endif
+    }
+    // Above the other CAN tasks: a deadline should only ever wait for the bus
+    cyclic_task_handle = start_task(can_cyclic_task, "can_cyclic", NULL, CONTROL_TASK_PRIORITY, CAN_TASK_CORE);
+    servo_task_handle = start_task(can_servo_task, "can_servo", NULL, CONTROL_TASK_PRIORITY, CAN_TASK_CORE);
+    selftest_task_handle = start_task(can_selftest_task, "can_selftest", NULL, CAN_TASK_PRIORITY, CAN_TASK_CORE);
+    heap_boot_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    ESP_LOGI(TAG, "Static DRAM %lu bytes, %lu of them bridge tasks; internal heap %lu bytes free",
+             static_dram_bytes(), (uint32_t)sizeof(task_mem), heap_boot_free);
 }
@@ -0,0 +1,239 @@
+#include "triton_core.h"
+#include "tusb.h"
+
+IRAM_ATTR bool rx_ring_put(struct rx_ring *ring, uint8_t channel, uint32_t can_id, uint8_t dlc, uint8_t flags,
+                           const uint8_t *data, uint32_t ts) {
+    uint32_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= RX_RING_LEN) return false;
+    struct gs_host_frame *frame = rx_ring_slot(ring, head);
+    frame->echo_id = 0xFFFFFFFF;
+    frame->can_id = can_id;
+    frame->can_dlc = dlc;
+    frame->channel = channel; frame->flags = flags; frame->reserved = 0;
+    if (flags & GS_CAN_FLAG_FD) memcpy(frame->data, data, gs_can_fd_dlc2len(dlc));
+    else memcpy(frame->data, data, 8);
+    *frame_timestamp(frame) = ts;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+uint32_t rx_ring_evict(struct rx_ring *ring, uint32_t policy) {
+    uint32_t count = rx_ring_count(ring);
+    if (policy == GS_TRITON_RX_DROP_NEWEST || count < RX_RING_HIGH) return 0;
+
+    uint32_t tail = ring->tail;
+    uint32_t new_tail = tail + (count - RX_RING_LOW);
+    if (policy == GS_TRITON_RX_LATEST_PER_ID) {
+        // Walk newest to oldest, keep the first frame seen per ID and pack survivors toward the head
+        uint32_t ids[RX_EVICT_MAX_IDS];
+        uint32_t n_ids = 0;
+        uint32_t w = tail + count;
+        for (uint32_t i = tail + count; i-- != tail && n_ids < RX_EVICT_MAX_IDS; ) {
+            struct gs_host_frame *f = rx_ring_slot(ring, i);
+            uint32_t k = 0;
+            while (k < n_ids && ids[k] != f->can_id) k++;
+            if (k < n_ids) continue;
+            ids[n_ids++] = f->can_id;
+            if (--w != i) memcpy(rx_ring_slot(ring, w), f, ring->slot_size);
+        }
+        // Too many distinct IDs: whatever is still below the low mark goes as in DROP_OLDEST
+        if (w > new_tail) new_tail = w;
+    }
+    rx_ring_release(ring, new_tail - tail);
+    return new_tail - tail;
+}
+
+// Writes a contiguous run of n slots to the FIFO, as far as the frames fit whole. Returns how many.
+static uint32_t write_slots_usb(uint8_t *slots, uint32_t slot_size, uint32_t n, uint32_t usb_frame_size,
+                                rx_ring_visit_fn visit, void *ctx) {
+    uint32_t room = tud_vendor_write_available();
+    uint32_t bytes = 0;
+    bool run = true; // every slot is exactly one wire frame: the run goes out in one write
+    uint32_t k;
+    for (k = 0; k < n; k++) {
+        struct gs_host_frame *f = (struct gs_host_frame *)(slots + k * slot_size);
+        uint32_t size = frame_wire_size(f, usb_frame_size);
+        if (bytes + size > room) break;
+        bytes += size;
+        if (size != slot_size) run = false;
+        if (visit) visit(ctx, f);
+    }
+    n = k;
+    if (run) {
+        tud_vendor_write(slots, bytes);
+    } else {
+        // Timestamp-less or classic-in-FD-slot frames are shorter than a slot
+        for (k = 0; k < n; k++) {
+            struct gs_host_frame *f = (struct gs_host_frame *)(slots + k * slot_size);
+            tud_vendor_write(f, frame_wire_size(f, usb_frame_size));
+        }
+    }
+    return n;
+}
+
+uint32_t rx_ring_write_usb(struct rx_ring *ring, uint32_t n, uint32_t usb_frame_size, rx_ring_visit_fn visit, void *ctx) {
+    uint32_t idx = ring->tail & (RX_RING_LEN - 1);
+    if (n > RX_RING_LEN - idx) n = RX_RING_LEN - idx; // contiguous run up to the wrap
+    n = write_slots_usb((uint8_t *)rx_ring_slot(ring, ring->tail), ring->slot_size, n, usb_frame_size, visit, ctx);
+    rx_ring_release(ring, n);
+    return n;
+}
+
+uint32_t rx_spill_absorb(struct rx_spill *spill, struct rx_ring *ring) {
+    uint32_t count = rx_ring_count(ring);
+    if (!spill->slots || count < RX_RING_HIGH) return 0;
+    uint32_t n = count - RX_RING_LOW;
+    uint32_t room = spill->len - rx_spill_count(spill);
+    if (n > room) n = room;
+    for (uint32_t k = 0; k < n; k++) {
+        memcpy(rx_spill_slot(spill, spill->head + k), rx_ring_slot(ring, ring->tail + k), ring->slot_size);
+    }
+    spill->head += n;
+    rx_ring_release(ring, n);
+    return n;
+}
+
+uint32_t rx_spill_write_usb(struct rx_spill *spill, uint32_t n, uint32_t usb_frame_size, rx_ring_visit_fn visit, void *ctx) {
+    uint32_t idx = spill->tail & (spill->len - 1);
+    if (n > spill->len - idx) n = spill->len - idx;
+    n = write_slots_usb((uint8_t *)rx_spill_slot(spill, spill->tail), spill->slot_size, n, usb_frame_size, visit, ctx);
+    spill->tail += n;
+    return n;
+}
+
+IRAM_ATTR enum rx_decim_result rx_decim_apply(struct rx_decim *d, const struct gs_triton_decimate *rules, uint32_t gen,
+                                              uint32_t can_id, uint8_t dlc, const uint8_t *data, uint32_t len, uint32_t ts) {
+    uint32_t n = rules->rule_count;
+    if (n == 0) return RX_DECIM_PASS;
+    const struct gs_triton_decimate_rule *rule = NULL;
+    for (uint32_t i = 0; i < n && !rule; i++) {
+        if (((can_id ^ rules->rule[i].can_id) & rules->rule[i].mask) == 0) rule = &rules->rule[i];
+    }
+    if (!rule) return RX_DECIM_PASS;
+    if (d->gen_seen != gen) {
+        d->gen_seen = gen;
+        d->count = 0;
+    }
+    uint32_t hash = 0;
+    if (rule->mode == GS_TRITON_DECIMATE_ON_CHANGE) { // FNV-1a
+        hash = (2166136261u ^ dlc) * 16777619u;
+        for (uint32_t i = 0; i < len; i++) hash = (hash ^ data[i]) * 16777619u;
+    }
+
+    struct rx_decim_id *e = d->ids, *end = d->ids + d->count;
+    while (e < end && e->can_id != can_id) e++;
+    if (e == end) {
+        if (d->count == DECIMATE_MAX_IDS) return RX_DECIM_UNTRACKED;
+        d->count++;
+        *e = (struct rx_decim_id){ .can_id = can_id, .last_us = ts, .hash = hash };
+        return RX_DECIM_PASS;
+    }
+    bool drop = false;
+    switch (rule->mode) {
+        case GS_TRITON_DECIMATE_EVERY_N:
+            drop = ++e->count < rule->param;
+            if (!drop) e->count = 0;
+            break;
+        case GS_TRITON_DECIMATE_INTERVAL:
+            drop = ts - e->last_us < rule->param;
+            if (!drop) e->last_us = ts;
+            break;
+        case GS_TRITON_DECIMATE_ON_CHANGE:
+            drop = hash == e->hash;
+            e->hash = hash;
+            break;
+    }
+    return drop ? RX_DECIM_DROP : RX_DECIM_PASS;
+}
+
+// The writer marks its slot before it checks count, and the set clears count before it checks the
+// marks, so one of them always sees the other: no frame lands in a slot that is being emptied.
+void rx_mailbox_set(struct rx_mailbox *box, const struct gs_triton_mailbox_config *config) {
+    __atomic_store_n(&box->count, 0, __ATOMIC_SEQ_CST);
+    for (uint32_t i = 0; i < GS_TRITON_MAILBOX_IDS; i++) {
+        while (__atomic_load_n(&box->seq[i], __ATOMIC_SEQ_CST) & 1) {} // a frame still being stored
+    }
+    uint32_t n = config->id_count > GS_TRITON_MAILBOX_IDS ? GS_TRITON_MAILBOX_IDS : config->id_count;
+    memset(box->slot, 0, sizeof(box->slot));
+    for (uint32_t i = 0; i < n; i++) box->slot[i].can_id = config->can_id[i];
+    box->flags = config->flags;
+    __atomic_store_n(&box->count, n, __ATOMIC_RELEASE);
+}
+
+IRAM_ATTR bool rx_mailbox_put(struct rx_mailbox *box, uint32_t can_id, uint8_t dlc, uint8_t flags, const uint8_t *data,
+                              uint32_t len, uint32_t ts) {
+    uint32_t n = __atomic_load_n(&box->count, __ATOMIC_ACQUIRE);
+    uint32_t i = 0;
+    while (i < n && box->slot[i].can_id != can_id) i++;
+    if (i == n) return false;
+    uint32_t seq = box->seq[i];
+    __atomic_store_n(&box->seq[i], seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    bool live = __atomic_load_n(&box->count, __ATOMIC_RELAXED) != 0;
+    if (live) {
+        struct gs_triton_mailbox_slot *slot = &box->slot[i];
+        if (len > sizeof(slot->data)) len = sizeof(slot->data);
+        slot->count++;
+        slot->timestamp_us = ts;
+        slot->can_dlc = dlc;
+        slot->flags = flags;
+        memcpy(slot->data, data, len);
+        memset(slot->data + len, 0, sizeof(slot->data) - len);
+    }
+    __atomic_store_n(&box->seq[i], seq + 2, __ATOMIC_RELEASE);
+    return live && (box->flags & GS_TRITON_MAILBOX_CONSUME);
+}
+
+void rx_mailbox_read(const struct rx_mailbox *box, struct gs_triton_mailbox *out) {
+    uint32_t n = __atomic_load_n(&box->count, __ATOMIC_ACQUIRE);
+    out->id_count = n;
+    out->flags = box->flags;
+    memset(out->slot, 0, sizeof(out->slot));
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t seq;
+        do {
+            seq = __atomic_load_n(&box->seq[i], __ATOMIC_ACQUIRE);
+            out->slot[i] = box->slot[i];
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        } while ((seq & 1) || seq != __atomic_load_n(&box->seq[i], __ATOMIC_RELAXED));
+    }
+}
+
+bool twai_from_host(const struct gs_host_frame_canfd *frame, twai_frame_t *msg, uint8_t *buf) {
+    if (frame->flags & GS_CAN_FLAG_FD) return false;
+    memset(msg, 0, sizeof(*msg));
+    msg->header.ide = (frame->can_id & 0x80000000) != 0;
+    msg->header.rtr = (frame->can_id & 0x40000000) != 0;
+    msg->header.id = frame->can_id & (msg->header.ide ? 0x1FFFFFFF : 0x7FF);
+    msg->header.dlc = frame->can_dlc > 8 ? 8 : frame->can_dlc;
+    memcpy(buf, frame->data, 8);
+    msg->buffer = buf;
+    msg->buffer_len = msg->header.rtr ? 0 : msg->header.dlc;
+    return true;
+}
+
+bool tx_prio_push(struct tx_prio *q, const struct gs_host_frame_canfd *frame, const struct gs_host_frame *inflight) {
+    if (q->count == TX_PRIO_LEN) return false;
+    struct tx_prio_entry *e = &q->entry[q->count++];
+    e->key = tx_prio_key(frame->can_id);
+    e->seq = q->seq++;
+    memcpy(&e->frame, frame, GS_HOST_FRAME_HDR_SIZE + 8);
+    e->inflight = *inflight;
+    return true;
+}
+
+bool tx_prio_pop(struct tx_prio *q, struct tx_prio_entry *out, bool *overtook) {
+    if (q->count == 0) return false;
+    uint32_t best = 0;
+    uint32_t oldest = q->entry[0].seq;
+    for (uint32_t i = 1; i < q->count; i++) {
+        const struct tx_prio_entry *e = &q->entry[i];
+        const struct tx_prio_entry *b = &q->entry[best];
+        if (e->key < b->key || (e->key == b->key && (int32_t)(e->seq - b->seq) < 0)) best = i;
+        if ((int32_t)(e->seq - oldest) < 0) oldest = e->seq;
+    }
+    *out = q->entry[best];
+    *overtook = out->seq != oldest;
+    q->entry[best] = q->entry[--q->count];
+    return true;
+}
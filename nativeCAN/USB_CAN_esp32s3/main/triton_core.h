@@ -0,0 +1,197 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_twai.h"
+#include "gs_usb.h"
+
+// Frame conversion and queueing logic of the bridge, kept free of FreeRTOS and channel state so
+// the same file builds on a Linux host against mocks of esp_twai.h and tusb.h (test/host).
+// Counters, locking and task notification stay with the callers in main.c.
+
+// RX frames go from a channel's RX task to can_forward_task through a single-producer/single-consumer
+// ring of preformatted slots: filled in place, written to the TinyUSB FIFO straight from the slot.
+// CAN FD capable channels have gs_host_frame_canfd slots; classic frames in them keep the
+// gs_host_frame layout, so every slot starts with exactly the bytes that go on the wire.
+// Depths come from the Kconfig tuning menu (sdkconfig.h, through esp_attr.h); the host tests have
+// no sdkconfig and build with the balanced preset's values.
+#ifdef CONFIG_TRITON_RX_RING_LEN
+#define RX_RING_LEN CONFIG_TRITON_RX_RING_LEN
+#else
+#define RX_RING_LEN 128
+#endif
+#if RX_RING_LEN & (RX_RING_LEN - 1)
+#error "CONFIG_TRITON_RX_RING_LEN must be a power of two"
+#endif
+#define RX_RING_ALIGN 32 // keep the two indices off each other's cache line
+struct rx_ring {
+    volatile uint32_t head __attribute__((aligned(RX_RING_ALIGN))); // written by the RX task only
+    volatile uint32_t tail __attribute__((aligned(RX_RING_ALIGN))); // written by can_forward_task only
+    uint8_t *slots; // RX_RING_LEN slots of slot_size bytes
+    uint32_t slot_size;
+};
+// Overflow policy: once the ring is RX_RING_HIGH deep, can_forward_task evicts frames down to
+// RX_RING_LOW. Only the consumer moves tail, so eviction needs no locking with can_rx_task.
+#define RX_RING_HIGH (RX_RING_LEN * 3 / 4)
+#define RX_RING_LOW (RX_RING_LEN / 2)
+#define RX_EVICT_MAX_IDS 32 // distinct IDs LATEST_PER_ID keeps before falling back to DROP_OLDEST
+
+static inline uint32_t rx_ring_count(const struct rx_ring *ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - ring->tail;
+}
+
+static inline void rx_ring_release(struct rx_ring *ring, uint32_t n) {
+    __atomic_store_n(&ring->tail, ring->tail + n, __ATOMIC_RELEASE);
+}
+
+static inline IRAM_ATTR struct gs_host_frame *rx_ring_slot(const struct rx_ring *ring, uint32_t i) {
+    return (struct gs_host_frame *)(ring->slots + (i & (RX_RING_LEN - 1)) * ring->slot_size);
+}
+
+// The timestamp follows the payload, so where it sits depends on the layout
+static inline IRAM_ATTR uint32_t *frame_timestamp(struct gs_host_frame *frame) {
+    if (frame->flags & GS_CAN_FLAG_FD) return &((struct gs_host_frame_canfd *)frame)->timestamp_us;
+    return &frame->timestamp_us;
+}
+
+// usb_frame_size: bytes of a classic frame on the wire, with or without the timestamp
+static inline uint32_t frame_wire_size(const struct gs_host_frame *frame, uint32_t usb_frame_size) {
+    if (frame->flags & GS_CAN_FLAG_FD) return usb_frame_size + (GS_HOST_FRAME_CANFD_SIZE - GS_HOST_FRAME_SIZE);
+    return usb_frame_size;
+}
+
+// Producer side: fills and publishes the next slot. flags: GS_CAN_FLAG_FD/BRS/ESI (dlc is then a
+// CAN FD DLC code; FD frames only go to rings with gs_host_frame_canfd slots) plus any ring-only
+// marker bits of the caller. Returns false when full.
+bool rx_ring_put(struct rx_ring *ring, uint8_t channel, uint32_t can_id, uint8_t dlc, uint8_t flags,
+                 const uint8_t *data, uint32_t ts);
+
+// Consumer side: makes room in a ring that is RX_RING_HIGH deep, down to RX_RING_LOW, by
+// GS_TRITON_RX_DROP_OLDEST or GS_TRITON_RX_LATEST_PER_ID. Returns how many frames went.
+uint32_t rx_ring_evict(struct rx_ring *ring, uint32_t policy);
+
+// Consumer side: writes up to n (at most rx_ring_count) frames of the ring's contiguous run to the
+// vendor IN FIFO, as far as they fit whole, and releases them. visit sees each frame before it
+// is written (latency sampling, clearing marker bits). Returns how many were written.
+typedef void (*rx_ring_visit_fn)(void *ctx, struct gs_host_frame *frame);
+uint32_t rx_ring_write_usb(struct rx_ring *ring, uint32_t n, uint32_t usb_frame_size, rx_ring_visit_fn visit, void *ctx);
+
+// Optional second RX tier, in PSRAM (CONFIG_TRITON_RX_SPILL_FRAMES): once a ring is RX_RING_HIGH deep,
+// can_forward_task moves its oldest frames here before the ring can fill, and forwards the tier
+// before the ring, so order is kept. Only the consumer touches it: no atomics. slots NULL: no tier.
+struct rx_spill {
+    uint8_t *slots; // len slots of the ring's slot_size
+    uint32_t len;   // power of two
+    uint32_t slot_size;
+    uint32_t head, tail;
+};
+
+static inline uint32_t rx_spill_count(const struct rx_spill *spill) {
+    return spill->head - spill->tail;
+}
+
+static inline struct gs_host_frame *rx_spill_slot(const struct rx_spill *spill, uint32_t i) {
+    return (struct gs_host_frame *)(spill->slots + (i & (spill->len - 1)) * spill->slot_size);
+}
+
+// Moves the oldest frames of a ring that is RX_RING_HIGH deep into the tier, down to RX_RING_LOW or
+// until the tier is full. Returns how many moved; what remains is left to rx_ring_evict.
+uint32_t rx_spill_absorb(struct rx_spill *spill, struct rx_ring *ring);
+
+// As rx_ring_write_usb, for the tier's contiguous run
+uint32_t rx_spill_write_usb(struct rx_spill *spill, uint32_t n, uint32_t usb_frame_size, rx_ring_visit_fn visit, void *ctx);
+
+// Software allow-list of GS_USB_BREQ_TRITON_FILTER; an empty list accepts everything
+static inline IRAM_ATTR bool rx_filter_match(const struct gs_triton_filter *filter, uint32_t can_id) {
+    uint32_t n = filter->sw_count;
+    if (n == 0) return true;
+    for (uint32_t i = 0; i < n; i++) {
+        if (((can_id ^ filter->sw[i].can_id) & filter->sw[i].mask) == 0) return true;
+    }
+    return false;
+}
+
+// Per-ID decimation (GS_USB_BREQ_TRITON_DECIMATE), state owned by the channel's RX task
+#define DECIMATE_MAX_IDS 64 // distinct IDs a channel's decimation rules track; the rest pass
+struct rx_decim_id {
+    uint32_t can_id;
+    uint32_t count;   // EVERY_N: frames dropped since the last forwarded one
+    uint32_t last_us; // INTERVAL: timestamp of the last forwarded frame
+    uint32_t hash;    // ON_CHANGE: DLC and payload of the last forwarded frame
+};
+struct rx_decim {
+    struct rx_decim_id ids[DECIMATE_MAX_IDS];
+    uint32_t count;
+    uint32_t gen_seen; // ids belong to this rule set
+};
+enum rx_decim_result { RX_DECIM_PASS, RX_DECIM_DROP, RX_DECIM_UNTRACKED };
+
+// The first matching rule decides; IDs no rule matches, and the first frame of each ID, pass.
+// gen is bumped by each rule write: a new value starts every ID afresh.
+enum rx_decim_result rx_decim_apply(struct rx_decim *d, const struct gs_triton_decimate *rules, uint32_t gen,
+                                    uint32_t can_id, uint8_t dlc, const uint8_t *data, uint32_t len, uint32_t ts);
+
+// Latest-value mailbox (GS_USB_BREQ_TRITON_MAILBOX). One writer, the channel's RX task or ISR, and
+// readers on the other core: each slot has a sequence count, odd while the writer is in it, and a
+// reader copies a slot again until it sees the same even count before and after.
+struct rx_mailbox {
+    struct gs_triton_mailbox_slot slot[GS_TRITON_MAILBOX_IDS];
+    uint32_t seq[GS_TRITON_MAILBOX_IDS];
+    uint32_t count; // 0 while the set is rewritten, published last
+    uint32_t flags;
+};
+
+// Clears the mailbox and gives it the IDs of config (at most GS_TRITON_MAILBOX_IDS)
+void rx_mailbox_set(struct rx_mailbox *box, const struct gs_triton_mailbox_config *config);
+// Keeps the frame if the mailbox has its ID. Returns true when it did and the mailbox consumes it.
+bool rx_mailbox_put(struct rx_mailbox *box, uint32_t can_id, uint8_t dlc, uint8_t flags, const uint8_t *data,
+                    uint32_t len, uint32_t ts);
+// Consistent copy of every slot; out->time_us is left to the caller
+void rx_mailbox_read(const struct rx_mailbox *box, struct gs_triton_mailbox *out);
+
+// gs_host_frame.can_id of a received TWAI frame
+static inline IRAM_ATTR uint32_t twai_rx_can_id(const twai_frame_header_t *header) {
+    uint32_t can_id = header->id;
+    if (header->ide) can_id |= 0x80000000;
+    if (header->rtr) can_id |= 0x40000000;
+    return can_id;
+}
+
+// Host frame -> TWAI frame with its payload in buf (8 bytes, must stay valid until the TX is done).
+// False for CAN FD frames, which the TWAI controller can't send.
+bool twai_from_host(const struct gs_host_frame_canfd *frame, twai_frame_t *msg, uint8_t *buf);
+
+// Channel 0's TX priority queue. The TWAI node sends in submission order, so host frames beyond the
+// few the node holds wait here instead, and the node is always fed the most urgent one: lowest
+// arbitration key first, which is what the bus would pick, and in arrival order among equal keys.
+#ifdef CONFIG_TRITON_TX_PRIO_LEN
+#define TX_PRIO_LEN CONFIG_TRITON_TX_PRIO_LEN
+#else
+#define TX_PRIO_LEN 16
+#endif
+struct tx_prio_entry {
+    uint32_t key;  // tx_prio_key()
+    uint32_t seq;  // arrival order
+    struct gs_host_frame frame;    // classic only: the layout of gs_host_frame_canfd up to data[8]
+    struct gs_host_frame inflight; // the echo header, as the in-flight queue takes it
+};
+struct tx_prio {
+    struct tx_prio_entry entry[TX_PRIO_LEN]; // unordered, count used
+    uint32_t count;
+    uint32_t seq;
+};
+
+// The bits of a gs_host_frame.can_id in the order they arbitrate: base ID, RTR or SRR, IDE, extended
+// ID, RTR. Lower wins, so a standard frame beats an extended one with the same base ID.
+static inline uint32_t tx_prio_key(uint32_t can_id) {
+    uint32_t rtr = (can_id & 0x40000000) != 0;
+    if (!(can_id & 0x80000000)) return ((can_id & 0x7FF) << 21) | (rtr << 20);
+    uint32_t id = can_id & 0x1FFFFFFF;
+    return ((id >> 18) << 21) | (3u << 19) | ((id & 0x3FFFF) << 1) | rtr;
+}
+
+// Returns false when the queue is full
+bool tx_prio_push(struct tx_prio *q, const struct gs_host_frame_canfd *frame, const struct gs_host_frame *inflight);
+// Takes the most urgent entry; false when empty. *overtook is set when it leaves older entries behind.
+bool tx_prio_pop(struct tx_prio *q, struct tx_prio_entry *out, bool *overtook);
@@ -1,17 +1,41 @@
 #ifndef _TUSB_CONFIG_H_
 #define _TUSB_CONFIG_H_
+#include "sdkconfig.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
+#if CONFIG_IDF_TARGET_ESP32P4
+// The P4's high-speed controller, on its UTMI PHY, is TinyUSB's port 1 (port 0 is the full-speed one)
+#define CFG_TUSB_MCU               OPT_MCU_ESP32P4
+#define CFG_TUSB_RHPORT1_MODE      (OPT_MODE_DEVICE | OPT_MODE_HIGH_SPEED)
+#else
 #define CFG_TUSB_MCU               OPT_MCU_ESP32S3
 #define CFG_TUSB_RHPORT0_MODE      OPT_MODE_DEVICE
+#endif
 #define CFG_TUSB_OS                OPT_OS_FREERTOS
 #define CFG_TUD_ENABLED            1
 #define CFG_TUD_ENDPOINT0_SIZE     64
+#if CONFIG_TRITON_ECHO_EP
+#define CFG_TUD_VENDOR             2 // gs_usb, then the echo interface
+#else
 #define CFG_TUD_VENDOR             1
-#define CFG_TUD_VENDOR_RX_BUFSIZE  1024
-#define CFG_TUD_VENDOR_TX_BUFSIZE  4096 
+#endif
+// Bytes per usbd transfer on the bulk endpoints. The DWC2 driver of this TinyUSB release runs in
+// slave mode only (no DMA), so the CPU cost is per transfer: an interrupt, a tud_task event and
+// a class callback. 512 moves up to eight 64-byte packets per transfer instead of one, or one
+// 512-byte packet at high speed. An OUT transfer ends on a short packet, so a host writing
+// multiples of the packet size must end with a ZLP.
+#define CFG_TUD_VENDOR_EPSIZE      512
+// FIFO sizes from the Kconfig tuning menu: OUT holds host frames the TX task has yet to take, IN
+// the frames staged for the host (and so the largest USB IN batch)
+#define CFG_TUD_VENDOR_RX_BUFSIZE  CONFIG_TRITON_USB_RX_BUFSIZE
+#define CFG_TUD_VENDOR_TX_BUFSIZE  CONFIG_TRITON_USB_TX_BUFSIZE
 #define CFG_TUD_CONTROL_COMPLETE_CALLBACK 1
+#if CONFIG_TRITON_LOG_CDC
+#define CFG_TUD_CDC                1
+#define CFG_TUD_CDC_RX_BUFSIZE     64
+#define CFG_TUD_CDC_TX_BUFSIZE     2048
+#endif
 #ifdef __cplusplus
 }
 #endif
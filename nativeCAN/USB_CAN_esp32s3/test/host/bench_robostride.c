@@ -0,0 +1,99 @@
+// Packs RoboStride command frames on the host and reports packs per second for the shared codec and
+// for the manual's float-divide packing it replaced. Usage: robostride_bench [packs]
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "robostride.h"
+
+static const rs_limits_t limits[RS_MODEL_COUNT] = RS_MODEL_LIMITS;
+static const char *const names[RS_MODEL_COUNT] = { "RS02", "RS03", "RS04" };
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static volatile uint32_t sink; // keeps the compiler from dropping the work
+
+static int float_to_uint(float x, float x_min, float x_max, int bits) {
+    if (x > x_max) x = x_max;
+    else if (x < x_min) x = x_min;
+    return (int)((x - x_min) * ((float)((1 << bits) - 1)) / (x_max - x_min));
+}
+
+// twai_motor_demo's packing before the shared codec: one divide per field
+static uint32_t pack_divide(float p_max, float v_max, float t_max, float kp_max, float kd_max, float pos, float vel,
+                            float torque, float kp, float kd, uint8_t data[8]) {
+    uint16_t v[4] = {
+        (uint16_t)float_to_uint(pos, -p_max, p_max, 16), (uint16_t)float_to_uint(vel, -v_max, v_max, 16),
+        (uint16_t)float_to_uint(kp, 0.0f, kp_max, 16), (uint16_t)float_to_uint(kd, 0.0f, kd_max, 16),
+    };
+    for (int i = 0; i < 4; i++) {
+        data[2 * i] = (uint8_t)(v[i] >> 8);
+        data[2 * i + 1] = (uint8_t)(v[i] & 0xFF);
+    }
+    return rs_build_ext_id(1, (uint16_t)float_to_uint(torque, -t_max, t_max, 16), RS_TYPE_OP_CONTROL);
+}
+
+enum { OP_CONTROL, MIT, RS02_OP_CONTROL, DIVIDE };
+
+#define BATCH 16
+
+static double bench(const rs_limits_t *l, int kind, uint32_t packs) {
+    uint8_t data[8];
+    uint32_t acc = 0;
+    double t0 = now_ns();
+    for (uint32_t i = 0; i < packs; i++) {
+        float x = (float)(i & 1023) * (1.0f / 1024.0f);
+        if (kind == OP_CONTROL) {
+            acc += rs_pack_op_control(l, 1, x, x, x, x, x, data);
+        } else if (kind == MIT) {
+            rs_pack_mit(l, x, x, x, x, x, data);
+        } else if (kind == RS02_OP_CONTROL) {
+            acc += rs02_pack_op_control(1, x, x, x, x, x, data); // generated, limits folded in
+        } else {
+            acc += pack_divide(12.57f, 44.0f, 17.0f, 500.0f, 5.0f, x, x, x, x, x, data);
+        }
+        acc += data[7];
+    }
+    double t1 = now_ns();
+    sink += acc;
+    return packs / ((t1 - t0) * 1e-9) / 1e6;
+}
+
+// A 16-motor limb, packed in one rs_pack_op_control_batch() call per cycle
+static double bench_batch(const rs_limits_t *l, uint32_t packs) {
+    const rs_limits_t *lims[BATCH];
+    uint8_t ids[BATCH];
+    rs_command_t cmds[BATCH];
+    rs_frame_t frames[BATCH];
+    for (int i = 0; i < BATCH; i++) {
+        lims[i] = l;
+        ids[i] = (uint8_t)(i + 1);
+        cmds[i] = (rs_command_t){ 0.1f * i, 0.2f * i, 0.3f * i, 1.0f * i, 0.1f * i };
+    }
+    uint32_t acc = 0;
+    double t0 = now_ns();
+    for (uint32_t n = 0; n < packs; n += BATCH) {
+        cmds[n & (BATCH - 1)].pos = (float)(n & 1023) * (1.0f / 1024.0f);
+        rs_pack_op_control_batch(BATCH, lims, ids, cmds, frames);
+        acc += frames[BATCH - 1].id + frames[0].data[1];
+    }
+    double t1 = now_ns();
+    sink += acc;
+    return packs / ((t1 - t0) * 1e-9) / 1e6;
+}
+
+int main(int argc, char **argv) {
+    uint32_t packs = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 20000000;
+    printf("%u packs per run\n", packs);
+    for (int m = 0; m < RS_MODEL_COUNT; m++) {
+        printf("%s op-control (type 1):   %7.1f M packs/s\n", names[m], bench(&limits[m], OP_CONTROL, packs));
+        printf("%s MIT command 3:         %7.1f M packs/s\n", names[m], bench(&limits[m], MIT, packs));
+    }
+    printf("RS02 batch of %d motors:   %7.1f M packs/s\n", BATCH, bench_batch(&limits[RS_MODEL_RS02], packs));
+    printf("RS02 op-control, generated: %6.1f M packs/s\n", bench(NULL, RS02_OP_CONTROL, packs));
+    printf("RS02 float divide (old):   %7.1f M packs/s\n", bench(NULL, DIVIDE, packs));
+    return 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+// The parts of the ESP-IDF esp_twai driver triton_core uses, same frame layout
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct {
+    uint32_t id;
+    uint16_t dlc;
+    uint32_t ide: 1;
+    uint32_t rtr: 1;
+    uint32_t fdf: 1;
+    uint32_t brs: 1;
+    uint32_t esi: 1;
+    uint64_t timestamp;
+    uint64_t trigger_time;
+} twai_frame_header_t;
+
+typedef struct {
+    twai_frame_header_t header;
+    uint8_t *buffer;
+    size_t buffer_len;
+} twai_frame_t;
+
+typedef struct twai_node_base *twai_node_handle_t;
+
+// The node is a frame queue: twai_node_transmit fills it, twai_node_receive_from_isr drains it
+// (copying the payload into the caller's buffer). ESP_ERR_TIMEOUT when full/empty.
+esp_err_t twai_node_transmit(twai_node_handle_t node, const twai_frame_t *frame, int timeout_ms);
+esp_err_t twai_node_receive_from_isr(twai_node_handle_t node, twai_frame_t *rx_frame);
+
+// Mock control
+void mock_twai_reset(uint32_t queue_len);
+uint32_t mock_twai_pending(void);
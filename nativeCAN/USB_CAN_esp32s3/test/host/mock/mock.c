@@ -0,0 +1,67 @@
+#include <string.h>
+#include "esp_twai.h"
+#include "tusb.h"
+
+#define MOCK_TWAI_MAX 64
+#define MOCK_USB_MAX 65536
+
+static struct { twai_frame_header_t header; uint8_t data[8]; size_t len; } twai_queue[MOCK_TWAI_MAX];
+static uint32_t twai_head, twai_tail, twai_len = MOCK_TWAI_MAX;
+
+esp_err_t twai_node_transmit(twai_node_handle_t node, const twai_frame_t *frame, int timeout_ms) {
+    (void)node; (void)timeout_ms;
+    if (twai_head - twai_tail >= twai_len || frame->buffer_len > 8) return ESP_ERR_TIMEOUT;
+    uint32_t i = twai_head++ % MOCK_TWAI_MAX;
+    twai_queue[i].header = frame->header;
+    twai_queue[i].len = frame->buffer_len;
+    memcpy(twai_queue[i].data, frame->buffer, frame->buffer_len);
+    return ESP_OK;
+}
+
+esp_err_t twai_node_receive_from_isr(twai_node_handle_t node, twai_frame_t *rx_frame) {
+    (void)node;
+    if (twai_head == twai_tail) return ESP_ERR_TIMEOUT;
+    uint32_t i = twai_tail++ % MOCK_TWAI_MAX;
+    size_t n = twai_queue[i].len < rx_frame->buffer_len ? twai_queue[i].len : rx_frame->buffer_len;
+    rx_frame->header = twai_queue[i].header;
+    memcpy(rx_frame->buffer, twai_queue[i].data, n);
+    return ESP_OK;
+}
+
+void mock_twai_reset(uint32_t queue_len) {
+    twai_head = twai_tail = 0;
+    twai_len = queue_len > MOCK_TWAI_MAX ? MOCK_TWAI_MAX : queue_len;
+}
+
+uint32_t mock_twai_pending(void) { return twai_head - twai_tail; }
+
+static uint8_t usb_fifo[MOCK_USB_MAX];
+static uint32_t usb_len, usb_cap = MOCK_USB_MAX, usb_writes;
+
+uint32_t tud_vendor_write_available(void) { return usb_cap - usb_len; }
+
+uint32_t tud_vendor_write(const void *buf, uint32_t size) {
+    if (size > usb_cap - usb_len) size = usb_cap - usb_len;
+    memcpy(usb_fifo + usb_len, buf, size);
+    usb_len += size;
+    usb_writes++;
+    return size;
+}
+
+uint32_t tud_vendor_write_flush(void) { return usb_len; }
+
+void mock_usb_reset(uint32_t capacity) {
+    usb_len = 0;
+    usb_writes = 0;
+    usb_cap = capacity > MOCK_USB_MAX ? MOCK_USB_MAX : capacity;
+}
+
+uint32_t mock_usb_drain(uint8_t *buf, uint32_t size) {
+    uint32_t n = usb_len < size ? usb_len : size;
+    if (buf) memcpy(buf, usb_fifo, n);
+    memmove(usb_fifo, usb_fifo + n, usb_len - n);
+    usb_len -= n;
+    return n;
+}
+
+uint32_t mock_usb_writes(void) { return usb_writes; }
@@ -0,0 +1,13 @@
+#pragma once
+// tud_vendor_* of TinyUSB over an in-memory IN FIFO whose size the test sets
+#include <stdbool.h>
+#include <stdint.h>
+
+uint32_t tud_vendor_write_available(void);
+uint32_t tud_vendor_write(const void *buf, uint32_t size);
+uint32_t tud_vendor_write_flush(void);
+
+// Mock control: capacity in bytes; mock_usb_drain hands out and empties what was written
+void mock_usb_reset(uint32_t capacity);
+uint32_t mock_usb_drain(uint8_t *buf, uint32_t size);
+uint32_t mock_usb_writes(void);
@@ -0,0 +1,292 @@
+// Host unit test of main/triton_core.c: ring, eviction, USB writes, spill tier, filter, decimation,
+// mailbox, conversion, TX priority queue
+#undef NDEBUG // the checks are the test
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "triton_core.h"
+#include "tusb.h"
+
+static struct gs_host_frame classic_slots[RX_RING_LEN];
+static struct gs_host_frame_canfd fd_slots[RX_RING_LEN];
+
+static void ring_init(struct rx_ring *ring, bool fd) {
+    memset(ring, 0, sizeof(*ring));
+    ring->slots = fd ? (uint8_t *)fd_slots : (uint8_t *)classic_slots;
+    ring->slot_size = fd ? sizeof(struct gs_host_frame_canfd) : sizeof(struct gs_host_frame);
+}
+
+static const uint8_t payload[64] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+
+static void test_put(void) {
+    struct rx_ring ring;
+    ring_init(&ring, false);
+    for (uint32_t i = 0; i < RX_RING_LEN; i++) assert(rx_ring_put(&ring, 0, 0x100 + i, 8, 0, payload, i));
+    assert(!rx_ring_put(&ring, 0, 0x1, 8, 0, payload, 0));
+    assert(rx_ring_count(&ring) == RX_RING_LEN);
+    struct gs_host_frame *f = rx_ring_slot(&ring, 5);
+    assert(f->echo_id == 0xFFFFFFFF && f->can_id == 0x105 && f->can_dlc == 8 && f->timestamp_us == 5);
+    assert(memcmp(f->data, payload, 8) == 0);
+
+    ring_init(&ring, true);
+    assert(rx_ring_put(&ring, 2, 0x80000123, 9, GS_CAN_FLAG_FD | GS_CAN_FLAG_BRS, payload, 77));
+    struct gs_host_frame_canfd *fd = (struct gs_host_frame_canfd *)rx_ring_slot(&ring, 0);
+    assert(fd->channel == 2 && fd->timestamp_us == 77 && memcmp(fd->data, payload, 12) == 0);
+    assert(*frame_timestamp((struct gs_host_frame *)fd) == 77);
+}
+
+static void test_evict(void) {
+    struct rx_ring ring;
+    ring_init(&ring, false);
+    for (uint32_t i = 0; i < RX_RING_HIGH; i++) rx_ring_put(&ring, 0, i, 8, 0, payload, i);
+    assert(rx_ring_evict(&ring, GS_TRITON_RX_DROP_NEWEST) == 0);
+    assert(rx_ring_evict(&ring, GS_TRITON_RX_DROP_OLDEST) == RX_RING_HIGH - RX_RING_LOW);
+    assert(rx_ring_count(&ring) == RX_RING_LOW && rx_ring_slot(&ring, ring.tail)->can_id == RX_RING_HIGH - RX_RING_LOW);
+    assert(rx_ring_evict(&ring, GS_TRITON_RX_DROP_OLDEST) == 0);
+
+    // Four IDs cycling: only the newest frame of each survives
+    ring_init(&ring, false);
+    for (uint32_t i = 0; i < RX_RING_HIGH; i++) rx_ring_put(&ring, 0, i % 4, 8, 0, payload, i);
+    assert(rx_ring_evict(&ring, GS_TRITON_RX_LATEST_PER_ID) == RX_RING_HIGH - 4);
+    assert(rx_ring_count(&ring) == 4);
+    for (uint32_t k = 0; k < 4; k++) {
+        struct gs_host_frame *f = rx_ring_slot(&ring, ring.tail + k);
+        assert(f->can_id == k && f->timestamp_us == RX_RING_HIGH - 4 + k);
+    }
+
+    // All IDs distinct: the newest RX_EVICT_MAX_IDS are kept, everything older goes
+    ring_init(&ring, false);
+    for (uint32_t i = 0; i < RX_RING_HIGH; i++) rx_ring_put(&ring, 0, i, 8, 0, payload, i);
+    assert(rx_ring_evict(&ring, GS_TRITON_RX_LATEST_PER_ID) == RX_RING_HIGH - RX_EVICT_MAX_IDS);
+    assert(rx_ring_slot(&ring, ring.tail)->can_id == RX_RING_HIGH - RX_EVICT_MAX_IDS);
+}
+
+static uint32_t visited;
+static void count_visit(void *ctx, struct gs_host_frame *f) {
+    (void)ctx; (void)f;
+    visited++;
+}
+
+static void test_write_usb(void) {
+    struct rx_ring ring;
+    uint8_t out[RX_RING_LEN * sizeof(struct gs_host_frame_canfd)];
+
+    // Slot-sized frames go out in one write, and only whole frames
+    ring_init(&ring, false);
+    for (uint32_t i = 0; i < 10; i++) rx_ring_put(&ring, 0, i, 8, 0, payload, i);
+    mock_usb_reset(GS_HOST_FRAME_TS_SIZE * 4 + 3);
+    visited = 0;
+    assert(rx_ring_write_usb(&ring, 10, GS_HOST_FRAME_TS_SIZE, count_visit, NULL) == 4);
+    assert(visited == 4 && mock_usb_writes() == 1 && rx_ring_count(&ring) == 6);
+    assert(mock_usb_drain(out, sizeof(out)) == GS_HOST_FRAME_TS_SIZE * 4);
+    assert(((struct gs_host_frame *)out)[3].can_id == 3);
+
+    // Without timestamps a frame is shorter than its slot
+    mock_usb_reset(1 << 16);
+    assert(rx_ring_write_usb(&ring, 6, GS_HOST_FRAME_SIZE, NULL, NULL) == 6);
+    assert(mock_usb_writes() == 6 && mock_usb_drain(out, sizeof(out)) == GS_HOST_FRAME_SIZE * 6);
+    assert(((struct gs_host_frame *)out)->can_id == 4);
+
+    // A run stops at the wrap
+    ring_init(&ring, false);
+    ring.head = ring.tail = RX_RING_LEN - 2;
+    for (uint32_t i = 0; i < 4; i++) rx_ring_put(&ring, 0, i, 8, 0, payload, i);
+    assert(rx_ring_write_usb(&ring, 4, GS_HOST_FRAME_TS_SIZE, NULL, NULL) == 2);
+    assert(rx_ring_write_usb(&ring, rx_ring_count(&ring), GS_HOST_FRAME_TS_SIZE, NULL, NULL) == 2);
+    mock_usb_drain(NULL, sizeof(out));
+
+    // Classic and FD frames out of FD slots
+    ring_init(&ring, true);
+    rx_ring_put(&ring, 1, 0x10, 8, 0, payload, 0);
+    rx_ring_put(&ring, 1, 0x11, 15, GS_CAN_FLAG_FD, payload, 0);
+    assert(rx_ring_write_usb(&ring, 2, GS_HOST_FRAME_TS_SIZE, NULL, NULL) == 2);
+    assert(mock_usb_drain(out, sizeof(out)) == GS_HOST_FRAME_TS_SIZE + GS_HOST_FRAME_CANFD_TS_SIZE);
+}
+
+static void test_spill(void) {
+    static struct gs_host_frame spill_slots[64];
+    struct rx_spill spill = { .slots = (uint8_t *)spill_slots, .len = 64, .slot_size = sizeof(struct gs_host_frame) };
+    struct rx_ring ring;
+    uint8_t out[64 * sizeof(struct gs_host_frame)];
+
+    // Below the high mark nothing moves; at it, the oldest frames go down to the low mark
+    ring_init(&ring, false);
+    for (uint32_t i = 0; i < RX_RING_HIGH - 1; i++) rx_ring_put(&ring, 0, i, 8, 0, payload, i);
+    assert(rx_spill_absorb(&spill, &ring) == 0);
+    rx_ring_put(&ring, 0, RX_RING_HIGH - 1, 8, 0, payload, 0);
+    uint32_t moved = RX_RING_HIGH - RX_RING_LOW;
+    assert(rx_spill_absorb(&spill, &ring) == moved);
+    assert(rx_spill_count(&spill) == moved && rx_ring_count(&ring) == RX_RING_LOW);
+    assert(rx_spill_slot(&spill, spill.tail)->can_id == 0 && rx_ring_slot(&ring, ring.tail)->can_id == moved);
+
+    // A full tier takes what fits and leaves the rest to the policy
+    for (uint32_t i = 0; i < moved; i++) rx_ring_put(&ring, 0, 0x200 + i, 8, 0, payload, i);
+    assert(rx_spill_absorb(&spill, &ring) == 64 - moved);
+    assert(rx_spill_count(&spill) == 64 && rx_spill_absorb(&spill, &ring) == 0);
+
+    // Out to USB in order, a run at a time up to the wrap
+    mock_usb_reset(1 << 16);
+    assert(rx_spill_write_usb(&spill, 10, GS_HOST_FRAME_TS_SIZE, NULL, NULL) == 10);
+    assert(mock_usb_writes() == 1 && mock_usb_drain(out, sizeof(out)) == GS_HOST_FRAME_TS_SIZE * 10);
+    assert(((struct gs_host_frame *)out)[9].can_id == 9);
+    spill.head = spill.tail = 62;
+    for (uint32_t i = 0; i < 4; i++) memcpy(rx_spill_slot(&spill, spill.head++), rx_ring_slot(&ring, ring.tail), sizeof(struct gs_host_frame));
+    assert(rx_spill_write_usb(&spill, 4, GS_HOST_FRAME_TS_SIZE, NULL, NULL) == 2);
+    assert(rx_spill_write_usb(&spill, rx_spill_count(&spill), GS_HOST_FRAME_TS_SIZE, NULL, NULL) == 2);
+    assert(rx_spill_count(&spill) == 0);
+    mock_usb_drain(NULL, sizeof(out));
+
+    // No tier: nothing is taken
+    struct rx_spill none = { 0 };
+    assert(rx_spill_absorb(&none, &ring) == 0);
+}
+
+static void test_filter(void) {
+    struct gs_triton_filter filter = { 0 };
+    assert(rx_filter_match(&filter, 0x123));
+    filter.sw_count = 2;
+    filter.sw[0].can_id = 0x100; filter.sw[0].mask = 0x7F0;
+    filter.sw[1].can_id = 0x80000000 | 0x18DAF110; filter.sw[1].mask = 0x9FFFFFFF;
+    assert(rx_filter_match(&filter, 0x10F));
+    assert(!rx_filter_match(&filter, 0x110));
+    assert(rx_filter_match(&filter, 0x80000000 | 0x18DAF110));
+    assert(!rx_filter_match(&filter, 0x18DAF110));
+}
+
+static void test_decimate(void) {
+    static struct rx_decim d;
+    struct gs_triton_decimate rules = { .rule_count = 3 };
+    rules.rule[0] = (struct gs_triton_decimate_rule){ .can_id = 0x100, .mask = 0x7FF, .mode = GS_TRITON_DECIMATE_EVERY_N, .param = 4 };
+    rules.rule[1] = (struct gs_triton_decimate_rule){ .can_id = 0x200, .mask = 0x7FF, .mode = GS_TRITON_DECIMATE_INTERVAL, .param = 1000 };
+    rules.rule[2] = (struct gs_triton_decimate_rule){ .can_id = 0x300, .mask = 0x7FF, .mode = GS_TRITON_DECIMATE_ON_CHANGE };
+    uint8_t data[8] = { 0 };
+
+    uint32_t passed = 0;
+    for (uint32_t i = 0; i < 13; i++) passed += rx_decim_apply(&d, &rules, 1, 0x100, 8, data, 8, i) == RX_DECIM_PASS;
+    assert(passed == 4); // the first, then every 4th
+    assert(rx_decim_apply(&d, &rules, 1, 0x200, 8, data, 8, 0) == RX_DECIM_PASS);
+    assert(rx_decim_apply(&d, &rules, 1, 0x200, 8, data, 8, 999) == RX_DECIM_DROP);
+    assert(rx_decim_apply(&d, &rules, 1, 0x200, 8, data, 8, 1000) == RX_DECIM_PASS);
+    assert(rx_decim_apply(&d, &rules, 1, 0x300, 8, data, 8, 0) == RX_DECIM_PASS);
+    assert(rx_decim_apply(&d, &rules, 1, 0x300, 8, data, 8, 0) == RX_DECIM_DROP);
+    data[7] = 1;
+    assert(rx_decim_apply(&d, &rules, 1, 0x300, 8, data, 8, 0) == RX_DECIM_PASS);
+    assert(rx_decim_apply(&d, &rules, 1, 0x300, 7, data, 7, 0) == RX_DECIM_PASS); // DLC counts too
+    assert(rx_decim_apply(&d, &rules, 1, 0x400, 8, data, 8, 0) == RX_DECIM_PASS); // no rule
+
+    // A new rule set starts every ID afresh
+    assert(rx_decim_apply(&d, &rules, 2, 0x300, 7, data, 7, 0) == RX_DECIM_PASS);
+    assert(d.count == 1);
+
+    rules.rule[0].mask = 0;
+    for (uint32_t i = 0; i < DECIMATE_MAX_IDS; i++) rx_decim_apply(&d, &rules, 3, 0x1000 + i, 8, data, 8, 0);
+    assert(rx_decim_apply(&d, &rules, 3, 0x5000, 8, data, 8, 0) == RX_DECIM_UNTRACKED);
+}
+
+static void test_mailbox(void) {
+    static struct rx_mailbox box;
+    static struct gs_triton_mailbox out;
+    struct gs_triton_mailbox_config config = { .id_count = 2, .can_id = { 0x100, 0x80001234 } };
+    rx_mailbox_set(&box, &config);
+    assert(!rx_mailbox_put(&box, 0x100, 8, 0, payload, 8, 10));
+    uint8_t newer[8] = { 9 };
+    assert(!rx_mailbox_put(&box, 0x100, 8, 0, newer, 8, 20));
+    assert(!rx_mailbox_put(&box, 0x200, 8, 0, payload, 8, 30)); // not in the set
+    assert(!rx_mailbox_put(&box, 0x80001234, 15, GS_CAN_FLAG_FD, payload, 64, 40));
+    rx_mailbox_read(&box, &out);
+    assert(out.id_count == 2 && out.flags == 0);
+    assert(out.slot[0].can_id == 0x100 && out.slot[0].count == 2 && out.slot[0].timestamp_us == 20);
+    assert(memcmp(out.slot[0].data, newer, 8) == 0);
+    assert(out.slot[1].count == 1 && out.slot[1].can_dlc == 15 && out.slot[1].flags == GS_CAN_FLAG_FD);
+    assert(memcmp(out.slot[1].data, payload, 8) == 0); // FD payload: the first 8 bytes
+    assert(box.seq[0] == 4 && box.seq[1] == 2); // even: no writer inside
+
+    // A new set empties every slot; CONSUME tells the caller to drop the frame
+    config = (struct gs_triton_mailbox_config){ .id_count = 1, .flags = GS_TRITON_MAILBOX_CONSUME, .can_id = { 0x200 } };
+    rx_mailbox_set(&box, &config);
+    assert(!rx_mailbox_put(&box, 0x100, 8, 0, payload, 8, 50));
+    assert(rx_mailbox_put(&box, 0x200, 2, 0, payload, 2, 60));
+    rx_mailbox_read(&box, &out);
+    assert(out.id_count == 1 && out.slot[0].count == 1 && out.slot[0].data[1] == 2 && out.slot[0].data[2] == 0);
+    assert(out.slot[1].can_id == 0 && out.slot[1].count == 0);
+
+    config.id_count = GS_TRITON_MAILBOX_IDS + 5;
+    rx_mailbox_set(&box, &config);
+    assert(box.count == GS_TRITON_MAILBOX_IDS);
+}
+
+static void test_twai(void) {
+    twai_frame_header_t header = { .id = 0x18DAF110, .dlc = 8, .ide = 1 };
+    assert(twai_rx_can_id(&header) == (0x80000000 | 0x18DAF110));
+    header = (twai_frame_header_t){ .id = 0x7FF, .dlc = 0, .rtr = 1 };
+    assert(twai_rx_can_id(&header) == (0x40000000 | 0x7FF));
+
+    struct gs_host_frame_canfd frame = { .echo_id = 1, .can_id = 0x80000000 | 0x1234567, .can_dlc = 12 };
+    memcpy(frame.data, payload, 8);
+    twai_frame_t msg;
+    uint8_t buf[8];
+    assert(twai_from_host(&frame, &msg, buf));
+    assert(msg.header.ide && !msg.header.rtr && msg.header.id == 0x1234567 && msg.header.dlc == 8);
+    assert(msg.buffer == buf && msg.buffer_len == 8 && memcmp(buf, payload, 8) == 0);
+
+    // Through the node and back, as the RX callback reads it
+    mock_twai_reset(4);
+    assert(twai_node_transmit(NULL, &msg, 0) == ESP_OK);
+    uint8_t rx[8] = { 0 };
+    twai_frame_t got = { .buffer = rx, .buffer_len = sizeof(rx) };
+    assert(twai_node_receive_from_isr(NULL, &got) == ESP_OK && memcmp(rx, payload, 8) == 0);
+    assert(twai_rx_can_id(&got.header) == frame.can_id);
+
+    frame.can_id = 0x40000000 | 0x123; // standard RTR
+    assert(twai_from_host(&frame, &msg, buf));
+    assert(!msg.header.ide && msg.header.rtr && msg.header.id == 0x123 && msg.buffer_len == 0);
+    frame.flags = GS_CAN_FLAG_FD;
+    assert(!twai_from_host(&frame, &msg, buf));
+}
+
+static void test_tx_prio(void) {
+    // Arbitration order: lower base ID first, std before ext with the same base, data before RTR
+    assert(tx_prio_key(0x100) < tx_prio_key(0x101));
+    assert(tx_prio_key(0x100) < tx_prio_key(0x40000000 | 0x100));
+    assert(tx_prio_key(0x40000000 | 0x100) < tx_prio_key(0x80000000 | (0x100u << 18)));
+    assert(tx_prio_key(0x80000000 | (0x100u << 18) | 5) < tx_prio_key(0x80000000 | (0x101u << 18)));
+    assert(tx_prio_key(0x80000000 | 0x1FFFFFFF) < tx_prio_key(0xC0000000 | 0x1FFFFFFF));
+
+    struct tx_prio q;
+    memset(&q, 0, sizeof(q));
+    struct gs_host_frame_canfd frame = { .can_dlc = 8 };
+    struct gs_host_frame inflight = { 0 };
+    const uint32_t ids[] = { 0x300, 0x300, 0x80000000 | 0x18000001, 0x050, 0x300 };
+    for (uint32_t i = 0; i < 5; i++) {
+        frame.can_id = ids[i];
+        frame.data[0] = (uint8_t)i;
+        inflight.echo_id = i;
+        assert(tx_prio_push(&q, &frame, &inflight));
+    }
+    struct tx_prio_entry e;
+    bool overtook;
+    assert(tx_prio_pop(&q, &e, &overtook) && e.frame.can_id == 0x050 && e.inflight.echo_id == 3 && overtook);
+    // Equal IDs keep their order
+    assert(tx_prio_pop(&q, &e, &overtook) && e.inflight.echo_id == 0 && e.frame.data[0] == 0 && !overtook);
+    assert(tx_prio_pop(&q, &e, &overtook) && e.inflight.echo_id == 1 && !overtook);
+    assert(tx_prio_pop(&q, &e, &overtook) && e.inflight.echo_id == 4 && overtook); // 0x300 beats 0x18000001 (base 0x600)
+    assert(tx_prio_pop(&q, &e, &overtook) && e.inflight.echo_id == 2 && !overtook);
+    assert(!tx_prio_pop(&q, &e, &overtook));
+
+    for (uint32_t i = 0; i < TX_PRIO_LEN; i++) assert(tx_prio_push(&q, &frame, &inflight));
+    assert(!tx_prio_push(&q, &frame, &inflight));
+}
+
+int main(void) {
+    test_put();
+    test_evict();
+    test_write_usb();
+    test_spill();
+    test_filter();
+    test_decimate();
+    test_mailbox();
+    test_twai();
+    test_tx_prio();
+    printf("triton_core: all tests passed\n");
+    return 0;
+}
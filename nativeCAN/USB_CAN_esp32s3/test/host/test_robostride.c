@@ -0,0 +1,139 @@
+// Host unit test of components/robostride: the multiply-only codec against the manual's float_to_uint
+#undef NDEBUG // the checks are the test
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "robostride.h"
+
+static const rs_limits_t limits[RS_MODEL_COUNT] = RS_MODEL_LIMITS;
+
+// The manual's reference packing, with the divide
+static int float_to_uint(float x, float x_min, float x_max, int bits) {
+    if (x > x_max) x = x_max;
+    else if (x < x_min) x = x_min;
+    return (int)((x - x_min) * ((float)((1 << bits) - 1)) / (x_max - x_min));
+}
+
+static void test_encode(void) {
+    for (int m = 0; m < RS_MODEL_COUNT; m++) {
+        const rs_range_t *r = &limits[m].t;
+        float lo = r->min, hi = r->min + 65535.0f * r->dec;
+        for (int i = -100; i <= 1100; i++) {
+            float x = lo + (hi - lo) * (float)i / 1000.0f;
+            int ref = float_to_uint(x, lo, hi, 16);
+            int got = rs_encode(r, x);
+            assert(abs(got - ref) <= 1); // the reciprocal can round the other way at a code boundary
+            assert(fabsf(rs_decode(r, (uint16_t)got) - fminf(fmaxf(x, lo), hi)) <= 2.0f * r->dec);
+        }
+        assert(rs_encode(r, -1e9f) == 0 && rs_encode(r, 1e9f) == 65535);
+    }
+}
+
+static void test_code12(void) {
+    assert(rs_code12(0) == 0 && rs_code12(65535) == 4095);
+    assert(rs_code16(0) == 0 && rs_code16(4095) == 65535);
+    for (uint32_t c = 0; c <= 4095; c++) {
+        assert(rs_code12(rs_code16((uint16_t)c)) == c);
+        // Bit replication stays within one 16-bit LSB of c * 65535 / 4095
+        assert(fabs(rs_code16((uint16_t)c) - c * 65535.0 / 4095.0) <= 1.0);
+    }
+    for (uint32_t c = 0; c <= 65535; c++) {
+        assert(fabs(rs_code12((uint16_t)c) - c * 4095.0 / 65535.0) <= 0.5 + 1e-9);
+    }
+}
+
+static void test_frames(void) {
+    const rs_limits_t *l = &limits[RS_MODEL_RS02];
+    uint8_t data[8];
+    uint32_t id = rs_pack_op_control(l, 5, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, data);
+    assert(rs_ext_id_type(id) == RS_TYPE_OP_CONTROL && (id & 0xFF) == 5);
+    assert(((id >> 8) & 0xFFFF) == 0x7FFF); // zero torque is mid-range
+    assert(data[0] == 0x7F && data[1] == 0xFF);
+
+    // Feedback from motor 5 to host 1, run mode, fault bit 0, 42.5 °C, echoing the command's P/V
+    uint8_t fb_data[8] = { data[0], data[1], data[2], data[3], 0x7F, 0xFF, 0x01, 0xA9 };
+    rs_feedback_t fb;
+    rs_decode_feedback(l, 0x02000000 | 2u << 22 | 1u << 16 | 5u << 8 | 1, fb_data, &fb);
+    assert(fb.motor_id == 5 && fb.mode == 2 && fb.fault == 1);
+    assert(fabsf(fb.vel - 1.0f) < 0.01f && fabsf(fb.pos) < 0.001f && fabsf(fb.torque) < 0.001f);
+    assert(fabsf(fb.temp - 42.5f) < 0.001f);
+
+    // MIT: pack, then read the reply layout back from the same fields
+    rs_pack_mit(l, 0.5f, 1.0f, 10.0f, 1.0f, 2.0f, data);
+    uint16_t v12 = (uint16_t)(data[2] << 4 | data[3] >> 4);
+    uint8_t reply[8] = { 5, data[0], data[1], (uint8_t)(v12 >> 4), (uint8_t)((v12 & 0xF) << 4 | (data[6] & 0xF)), data[7] };
+    rs_decode_mit_feedback(l, reply, &fb);
+    assert(fb.motor_id == 5 && fabsf(fb.pos - 0.5f) < 0.001f);
+    assert(fabsf(fb.vel - 1.0f) < 2 * 88.0f / 4095 && fabsf(fb.torque - 2.0f) < 2 * 34.0f / 4095);
+}
+
+static void test_batch(void) {
+    const rs_limits_t *lims[3] = { &limits[RS_MODEL_RS02], &limits[RS_MODEL_RS04], &limits[RS_MODEL_RS03] };
+    const uint8_t ids[3] = { 1, 2, 7 };
+    const rs_command_t cmds[3] = {
+        { 0.5f, 1.0f, 2.0f, 10.0f, 1.0f }, { -1.0f, -2.0f, -50.0f, 100.0f, 2.0f }, { 0.0f, 0.0f, 5.0f, 0.0f, 0.5f },
+    };
+    rs_frame_t frames[3];
+    rs_pack_op_control_batch(3, lims, ids, cmds, frames);
+    for (int i = 0; i < 3; i++) {
+        uint8_t data[8];
+        uint32_t id = rs_pack_op_control(lims[i], ids[i], cmds[i].pos, cmds[i].vel, cmds[i].torque, cmds[i].kp,
+                                         cmds[i].kd, data);
+        assert(frames[i].id == id && memcmp(frames[i].data, data, 8) == 0);
+        // Feed-forward torque in ID bits 8..23, scaled to the motor's own model
+        assert(fabsf(rs_decode(&lims[i]->t, (uint16_t)(id >> 8)) - cmds[i].torque) <= 2.0f * lims[i]->t.dec);
+    }
+}
+
+// The generated per-model codecs must produce exactly what the generic ones do with the model's limits
+typedef struct {
+    const rs_limits_t *l;
+    uint32_t (*pack_op_control)(uint8_t, float, float, float, float, float, uint8_t[8]);
+    void (*decode_feedback)(uint32_t, const uint8_t[8], rs_feedback_t *);
+    void (*pack_mit)(float, float, float, float, float, uint8_t[8]);
+    void (*decode_mit_feedback)(const uint8_t[8], rs_feedback_t *);
+} model_codec_t;
+
+static void test_model_codecs(void) {
+    const model_codec_t codecs[] = {
+        { &limits[RS_MODEL_RS02], rs02_pack_op_control, rs02_decode_feedback, rs02_pack_mit, rs02_decode_mit_feedback },
+        { &limits[RS_MODEL_RS03], rs03_pack_op_control, rs03_decode_feedback, rs03_pack_mit, rs03_decode_mit_feedback },
+        { &limits[RS_MODEL_RS04], rs04_pack_op_control, rs04_decode_feedback, rs04_pack_mit, rs04_decode_mit_feedback },
+    };
+    for (size_t m = 0; m < sizeof codecs / sizeof codecs[0]; m++) {
+        const model_codec_t *c = &codecs[m];
+        for (int i = 0; i < 1000; i++) {
+            float x = (float)(i - 500) / 25.0f; // past the limits at both ends
+            uint8_t got[8], want[8];
+            assert(c->pack_op_control(3, x, -x, x / 2, x * x, x / 4, got) ==
+                   rs_pack_op_control(c->l, 3, x, -x, x / 2, x * x, x / 4, want));
+            assert(memcmp(got, want, 8) == 0);
+            c->pack_mit(x, -x, x * x, x / 4, x / 2, got);
+            rs_pack_mit(c->l, x, -x, x * x, x / 4, x / 2, want);
+            assert(memcmp(got, want, 8) == 0);
+
+            uint8_t data[8];
+            for (int b = 0; b < 8; b++) data[b] = (uint8_t)(i * 37 + b * 101);
+            rs_feedback_t fb_got = { 0 }, fb_want = { 0 };
+            c->decode_feedback(0x02000000 | (uint32_t)i << 8 | 1, data, &fb_got);
+            rs_decode_feedback(c->l, 0x02000000 | (uint32_t)i << 8 | 1, data, &fb_want);
+            assert(memcmp(&fb_got, &fb_want, sizeof fb_got) == 0);
+            c->decode_mit_feedback(data, &fb_got);
+            rs_decode_mit_feedback(c->l, data, &fb_want);
+            assert(memcmp(&fb_got, &fb_want, sizeof fb_got) == 0);
+        }
+    }
+    assert(RS_TYPE_OP_CONTROL == 1 && RS_TYPE_FEEDBACK == 2 && RS_TYPE_ENABLE_ACTIVE_REPORTING == 24);
+}
+
+int main(void) {
+    test_encode();
+    test_code12();
+    test_frames();
+    test_batch();
+    test_model_codecs();
+    printf("robostride: all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,90 @@
+import can
+import time
+import argparse
+import threading
+
+# Sustained throughput benchmark for the gs_usb adapter.
+# Needs two interfaces on the same bus: the adapter under test (DUT) and a
+# reference adapter (e.g. a second ESP32-S3 or a PCAN/candleLight dongle).
+#
+#   rx: reference floods the bus, count what arrives through the DUT
+#   tx: DUT floods the bus, count what the reference sees
+#
+# Flash with PIN_TASKS_TO_CORES 0 / CONFIG_TWAI_ISR_IN_IRAM=n for the "before"
+# run and with the defaults for the "after" run, then compare the pps lines.
+
+DEFAULT_DUT = 'can0'
+DEFAULT_REF = 'can1'
+DEFAULT_SECONDS = 10.0
+BENCH_ID = 0x321
+
+def flood(bus, seconds, stop):
+    """Send back-to-back 8-byte frames, retrying while the TX queue is full."""
+    sent = 0
+    end = time.monotonic() + seconds
+    while time.monotonic() < end and not stop.is_set():
+        msg = can.Message(arbitration_id=BENCH_ID, is_extended_id=False,
+                          data=sent.to_bytes(4, 'little') + b'\xAA' * 4)
+        try:
+            bus.send(msg, timeout=0.1)
+            sent += 1
+        except can.CanError:
+            pass  # ENOBUFS: the interface queue is full, try again
+    return sent
+
+def count(bus, seconds):
+    """Count BENCH_ID frames and sequence gaps until the bus goes quiet."""
+    received = 0
+    lost = 0
+    expected = None
+    first = last = None
+    end = time.monotonic() + seconds + 1.0
+    while time.monotonic() < end:
+        msg = bus.recv(timeout=0.2)
+        if msg is None or msg.arbitration_id != BENCH_ID or msg.is_error_frame:
+            continue
+        now = time.monotonic()
+        first = first or now
+        last = now
+        seq = int.from_bytes(msg.data[:4], 'little')
+        if expected is not None and seq > expected:
+            lost += seq - expected
+        expected = seq + 1
+        received += 1
+    elapsed = (last - first) if first and last and last > first else seconds
+    return received, lost, elapsed
+
+def run(direction, dut, ref, seconds):
+    tx_chan, rx_chan = (ref, dut) if direction == 'rx' else (dut, ref)
+    tx_bus = can.interface.Bus(channel=tx_chan, interface='socketcan')
+    rx_bus = can.interface.Bus(channel=rx_chan, interface='socketcan',
+                               receive_own_messages=False)
+    stop = threading.Event()
+    result = {}
+
+    def reader():
+        result['rx'] = count(rx_bus, seconds)
+
+    t = threading.Thread(target=reader)
+    t.start()
+    time.sleep(0.2)
+    sent = flood(tx_bus, seconds, stop)
+    t.join()
+
+    received, lost, elapsed = result['rx']
+    print(f"{direction.upper()} {tx_chan} -> {rx_chan}")
+    print(f"  sent:     {sent}")
+    print(f"  received: {received} ({received / elapsed:.0f} pps sustained)")
+    print(f"  lost:     {lost} (sequence gaps)")
+
+    tx_bus.shutdown()
+    rx_bus.shutdown()
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="gs_usb adapter sustained pps benchmark")
+    parser.add_argument('direction', choices=['rx', 'tx'])
+    parser.add_argument('--dut', default=DEFAULT_DUT)
+    parser.add_argument('--ref', default=DEFAULT_REF)
+    parser.add_argument('--seconds', type=float, default=DEFAULT_SECONDS)
+    args = parser.parse_args()
+    run(args.direction, args.dut, args.ref, args.seconds)
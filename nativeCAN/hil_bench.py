@@ -0,0 +1,453 @@
+#!/usr/bin/env python3
+"""
+Hardware-in-the-Loop Benchmark
+------------------------------
+Drives the adapter with the twai_transmitter traffic generator at stepped bus
+loads and reports, per load step, loss, latency and CPU for each stage of the
+path a frame takes:
+
+    generator --bus--> adapter (TWAI ISR) --USB--> gs_usb (kernel) --socket--> this process
+
+Rig: an ESP32-C3 running twai_transmitter on the same bus as the adapter under
+test, its console UART on --serial. Each step sends "load <percent>" to the
+generator (see twai_transmitter/main/main.c) and reads its one-second report
+lines back, so no reflash between steps. --flash builds and flashes the
+generator first with idf.py (ESP-IDF in the environment); the load in its
+sdkconfig only applies until the first step.
+
+Timestamps, per frame:
+
+  - tx:   esp_timer on the generator when the frame was queued (payload bytes 4..7)
+  - hw:   esp_timer on the adapter in the TWAI callback (GS_CAN_MODE_HW_TIMESTAMP),
+          as the gs_usb driver hands it to SO_TIMESTAMPING (raw hardware)
+  - sw:   kernel receive time (SO_TIMESTAMPING, software)
+  - user: time.time_ns() once recvmsg() returns
+
+The generator, adapter and host clocks are not synchronised. For the two
+stages that cross a clock (generator -> adapter, adapter -> kernel) the
+offset and drift are removed by fitting a line through the minimum of each
+0.5 s window, so those stages are latency above the fastest frame seen: queueing
+and scheduling, not wire time. kernel -> user is on one clock and absolute.
+
+Loss, per stage: frames the generator could not queue (its "queue full",
+a shortfall and not a loss), frames the adapter dropped (rx_dropped, rx_evicted,
+rx_missed and rx_overrun from GS_USB_BREQ_TRITON_STATS), frames the kernel
+dropped on the socket (SO_RXQ_OVFL), and the total from gaps in the
+generator's sequence numbers. What the total has on top of the adapter and
+kernel counts was lost on the bus or in the gs_usb driver.
+
+CPU, per stage: this process (user + system time per 1000 frames), the host's
+softirq time (/proc/stat, where gs_usb completes its URBs), and the adapter's
+RX task cycles per frame (hist_rx_cycles). The adapter counters need pyusb and
+access to the device node; without them those columns stay empty.
+
+    sudo python3 hil_bench.py can0 --serial /dev/ttyUSB0 --loads 10,25,50,75,90,100 --results hil.jsonl
+    sudo python3 hil_bench.py can0 --serial /dev/ttyUSB0 --flash --label "pinned, IRAM ISR" --results hil.jsonl
+    python3 hil_bench.py --summary hil.jsonl
+"""
+
+import argparse
+import json
+import os
+import re
+import socket
+import struct
+import subprocess
+import sys
+import threading
+import time
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'MotorTest'))
+from latency_bench import interface_info  # noqa: E402
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+GENERATOR_DIR = os.path.join(HERE, '..', 'twai_transmitter')
+
+CAN_FRAME = struct.Struct("=IB3x8s")
+CAN_EFF_FLAG = 0x80000000
+CAN_RTR_FLAG = 0x40000000
+CAN_ERR_FLAG = 0x20000000
+CAN_EFF_MASK = 0x1FFFFFFF
+SO_TIMESTAMPING = getattr(socket, "SO_TIMESTAMPING", 37)
+SO_RXQ_OVFL = getattr(socket, "SO_RXQ_OVFL", 40)
+SOF_TIMESTAMPING_RX_HARDWARE = 1 << 2
+SOF_TIMESTAMPING_RX_SOFTWARE = 1 << 3
+SOF_TIMESTAMPING_SOFTWARE = 1 << 4
+SOF_TIMESTAMPING_RAW_HARDWARE = 1 << 6
+TIMESPEC3 = struct.Struct("=qqqqqq")   # software, legacy, raw hardware
+RCVBUF = 8 * 1024 * 1024
+
+DEFAULT_LOADS = (10, 25, 50, 75, 90, 100)
+WINDOW_NS = 500_000_000                # envelope window for the cross-clock stages
+PERCENTILES = (50, 99, 99.9)
+ADAPTER_LOSS = ('rx_dropped', 'rx_evicted', 'rx_missed', 'rx_overrun')
+
+# I (12345) TWAI_TX: 8123 frames/s, load 74.9 % (unstuffed, target 75 %), queue full 0, seq 123456
+REPORT_RE = re.compile(r"(\d+) frames/s, load (\d+)\.(\d) % \(unstuffed, target (\d+) %\), "
+                       r"queue full (\d+), seq (\d+)")
+
+
+def flash_generator(port):
+    print(f"🔧 Flashing twai_transmitter to {port}")
+    subprocess.run(["idf.py", "-C", GENERATOR_DIR, "-p", port, "flash"], check=True)
+
+
+def git_describe():
+    try:
+        return subprocess.run(["git", "-C", HERE, "describe", "--always", "--dirty"],
+                              capture_output=True, text=True, check=True).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+class Generator:
+    """The traffic generator's console: sets the target load, collects its one-second reports."""
+
+    def __init__(self, port, baud=115200):
+        import serial  # pip install pyserial
+        self.port = serial.Serial(port, baud, timeout=0.2)
+        self.lock = threading.Lock()
+        self.reports = []
+        self.stop = threading.Event()
+        self.thread = threading.Thread(target=self._read, daemon=True)
+        self.thread.start()
+
+    def _read(self):
+        while not self.stop.is_set():
+            line = self.port.readline().decode(errors='replace')
+            m = REPORT_RE.search(line)
+            if m:
+                fps, whole, tenth, target, full, seq = (int(g) for g in m.groups())
+                with self.lock:
+                    self.reports.append({'fps': fps, 'load': whole + tenth / 10, 'target': target,
+                                         'queue_full': full, 'seq': seq})
+
+    def set_load(self, percent):
+        self.port.write(f"load {percent}\n".encode())
+
+    def take_reports(self):
+        with self.lock:
+            out, self.reports = self.reports, []
+        return out
+
+    def close(self):
+        self.set_load(0)
+        self.stop.set()
+        self.thread.join()
+        self.port.close()
+
+
+class Adapter:
+    """GS_USB_BREQ_TRITON_STATS through EP0; None when pyusb or the device is not there."""
+
+    def __init__(self, channel):
+        self.channel = channel
+        self.dev = None
+        try:
+            import triton_stats
+            import triton_usb
+            self.stats = triton_stats
+            self.dev = triton_usb.find_adapter()
+        except ImportError:
+            pass
+        if self.dev is None:
+            print("  (adapter statistics unavailable: no pyusb or no device, adapter columns stay empty)")
+
+    def read(self):
+        if self.dev is None:
+            return None
+        try:
+            return self.stats.read_stats(self.dev, self.channel)
+        except Exception as e:  # usb.core.USBError, permissions
+            print(f"  (adapter statistics: {e})")
+            self.dev = None
+            return None
+
+    def delta(self, before, after):
+        if before is None or after is None:
+            return None
+        out = {k: (after[k] - before[k]) & 0xFFFFFFFF for k in ADAPTER_LOSS + ('rx_frames',)}
+        hist = [(a - b) & 0xFFFFFFFF for a, b in zip(after['hist_rx_cycles'], before['hist_rx_cycles'])]
+        out['rx_cycles_p50'] = self.stats.percentile(hist, 0.5) if sum(hist) else None
+        out['rx_cycles_p99'] = self.stats.percentile(hist, 0.99) if sum(hist) else None
+        for key in ('hist_rx_dwell', 'hist_usb_in'):
+            h = [(a - b) & 0xFFFFFFFF for a, b in zip(after[key], before[key])]
+            out[f"{key[5:]}_p99_us"] = self.stats.percentile(h, 0.99) if sum(h) else None
+        return out
+
+
+def open_socket(interface):
+    sock = socket.socket(socket.AF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, RCVBUF)
+    sock.setsockopt(socket.SOL_SOCKET, SO_TIMESTAMPING,
+                    SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE
+                    | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE)
+    sock.setsockopt(socket.SOL_SOCKET, SO_RXQ_OVFL, 1)
+    sock.bind((interface,))
+    sock.settimeout(0.2)
+    return sock
+
+
+def softirq_jiffies():
+    try:
+        with open("/proc/stat") as f:
+            return int(f.readline().split()[7])
+    except (OSError, IndexError, ValueError):
+        return None
+
+
+def capture(sock, seconds, id_range):
+    """Frames for `seconds`: (seq, tx_us, hw_ns, sw_ns, user_ns) for each, and the kernel's drop count."""
+    frames = []
+    overflow = None
+    cmsg_space = socket.CMSG_SPACE(TIMESPEC3.size) + socket.CMSG_SPACE(4)
+    end = time.monotonic() + seconds
+    while time.monotonic() < end:
+        try:
+            raw, ancdata, _, _ = sock.recvmsg(CAN_FRAME.size, cmsg_space)
+        except socket.timeout:
+            continue
+        user_ns = time.time_ns()
+        can_id, dlc, data = CAN_FRAME.unpack(raw)
+        if can_id & (CAN_ERR_FLAG | CAN_RTR_FLAG) or dlc < 4:
+            continue
+        ident = can_id & CAN_EFF_MASK
+        if id_range and not id_range[0] <= ident <= id_range[1]:
+            continue
+        sw_ns = hw_ns = None
+        for level, kind, payload in ancdata:
+            if level != socket.SOL_SOCKET:
+                continue
+            if kind == SO_TIMESTAMPING and len(payload) >= TIMESPEC3.size:
+                s0, n0, _, _, s2, n2 = TIMESPEC3.unpack_from(payload)
+                sw_ns = s0 * 1_000_000_000 + n0 or None
+                hw_ns = s2 * 1_000_000_000 + n2 or None
+            elif kind == SO_RXQ_OVFL and len(payload) >= 4:
+                overflow = struct.unpack_from("=I", payload)[0]
+        seq = int.from_bytes(data[0:4], 'little')
+        tx_us = int.from_bytes(data[4:8], 'little') if dlc == 8 else None
+        frames.append((seq, tx_us, hw_ns, sw_ns, user_ns))
+    return frames, overflow
+
+
+def seq_loss(frames):
+    """Frames missing from the generator's sequence, and how many arrived."""
+    lost = 0
+    expected = None
+    for seq, *_ in frames:
+        if expected is not None:
+            gap = (seq - expected) & 0xFFFFFFFF
+            if gap < 0x80000000:
+                lost += gap
+        expected = (seq + 1) & 0xFFFFFFFF
+    return lost
+
+
+def above_envelope(points):
+    """Samples (t_ns, delay_ns) as delay above a line through each window's minimum.
+
+    Removes the offset and drift between two free-running clocks, so what is
+    left is queueing and scheduling on top of the fastest path.
+    """
+    if len(points) < 2:
+        return []
+    t0 = points[0][0]
+    minima = {}
+    for t, d in points:
+        w = (t - t0) // WINDOW_NS
+        if w not in minima or d < minima[w][1]:
+            minima[w] = (t, d)
+    mins = sorted(minima.values())
+    if len(mins) < 2:
+        floor = mins[0][1]
+        return [d - floor for _, d in points]
+    n = len(mins)
+    mt = sum(t for t, _ in mins) / n
+    md = sum(d for _, d in mins) / n
+    var = sum((t - mt) ** 2 for t, _ in mins)
+    slope = sum((t - mt) * (d - md) for t, d in mins) / var if var else 0.0
+    # Shift the line down to the lowest minimum, so no sample is below it
+    offset = min(d - (md + slope * (t - mt)) for t, d in mins)
+    return [d - (md + slope * (t - mt) + offset) for t, d in points]
+
+
+def _percentile(ordered, p):
+    return ordered[min(len(ordered) - 1, int(len(ordered) * p / 100.0))]
+
+
+def stats(samples_ns):
+    if not samples_ns:
+        return None
+    us = sorted(s / 1e3 for s in samples_ns)
+    out = {f"p{p:g}": round(_percentile(us, p), 1) for p in PERCENTILES}
+    out["max"] = round(us[-1], 1)
+    out["samples"] = len(us)
+    return out
+
+
+def stage_latencies(frames):
+    gen_adapter, adapter_kernel, kernel_user = [], [], []
+    prev_tx = None
+    wrap = 0
+    for _, tx_us, hw_ns, sw_ns, user_ns in frames:
+        if hw_ns is not None and tx_us is not None:
+            # tx_us is the low 32 bits of the generator's µs clock, which wraps every 71 minutes
+            if prev_tx is not None and tx_us + (1 << 31) < prev_tx:
+                wrap += 1 << 32
+            prev_tx = tx_us
+            gen_adapter.append((hw_ns, hw_ns - (tx_us + wrap) * 1000))
+        if hw_ns is not None and sw_ns is not None:
+            adapter_kernel.append((sw_ns, sw_ns - hw_ns))
+        if sw_ns is not None:
+            kernel_user.append(user_ns - sw_ns)
+    return {
+        "generator_adapter_us": stats(above_envelope(gen_adapter)),
+        "adapter_kernel_us": stats(above_envelope(adapter_kernel)),
+        "kernel_user_us": stats(kernel_user),
+    }
+
+
+def run_step(args, sock, generator, adapter, load):
+    generator.set_load(load)
+    time.sleep(args.settle)
+    generator.take_reports()
+    before = adapter.read()
+    soft0 = softirq_jiffies()
+    cpu0 = os.times()
+    frames, overflow = capture(sock, args.seconds, args.ids)
+    cpu1 = os.times()
+    soft1 = softirq_jiffies()
+    after = adapter.read()
+    time.sleep(0.3)                    # the report covering the end of the window
+    reports = generator.take_reports()
+
+    received = len(frames)
+    lost = seq_loss(frames)
+    dev = adapter.delta(before, after)
+    kernel_drops = (overflow - args.overflow_base) & 0xFFFFFFFF if overflow is not None else 0
+    if overflow is not None:
+        args.overflow_base = overflow
+    adapter_drops = sum(dev[k] for k in ADAPTER_LOSS) if dev else None
+    cpu_s = (cpu1.user - cpu0.user) + (cpu1.system - cpu0.system)
+    result = {
+        "target_load": load,
+        "measured_load": round(sum(r['load'] for r in reports) / len(reports), 1) if reports else None,
+        "generator_fps": round(sum(r['fps'] for r in reports) / len(reports)) if reports else None,
+        "generator_queue_full": sum(r['queue_full'] for r in reports),
+        "received": received,
+        "rx_fps": round(received / args.seconds),
+        "lost": lost,
+        "lost_adapter": adapter_drops,
+        "lost_kernel": kernel_drops,
+        "lost_other": max(0, lost - (adapter_drops or 0) - kernel_drops),
+        "cpu_ms_per_kframe": round(1e6 * cpu_s / received, 2) if received else None,
+        "softirq_ms": (soft1 - soft0) * 1000 // os.sysconf('SC_CLK_TCK') if soft0 is not None else None,
+        "adapter": dev,
+    }
+    result.update(stage_latencies(frames))
+    return result
+
+
+def run(args):
+    driver, bitrate = interface_info(args.interface)
+    if args.flash:
+        flash_generator(args.serial)
+    generator = Generator(args.serial)
+    adapter = Adapter(args.channel)
+    sock = open_socket(args.interface)
+    args.overflow_base = 0
+    steps = []
+    try:
+        generator.set_load(0)
+        time.sleep(args.settle)
+        capture(sock, 0.2, args.ids)   # drain, and pick up the kernel's drop count so far
+        for load in args.loads:
+            print(f"  load {load} % ...", flush=True)
+            steps.append(run_step(args, sock, generator, adapter, load))
+    finally:
+        generator.close()
+        sock.close()
+    return {
+        "label": args.label,
+        "adapter": driver or "unknown",
+        "interface": args.interface,
+        "bitrate": bitrate,
+        "firmware": git_describe(),
+        "seconds": args.seconds,
+        "steps": steps,
+        "time": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+    }
+
+
+def _cell(value, width, fmt=""):
+    return f"{'-':>{width}}" if value is None else f"{value:>{width}{fmt}}"
+
+
+def print_run(r):
+    rate = f"{r['bitrate'] // 1000} kbit/s" if r["bitrate"] else "bitrate unknown"
+    label = f" [{r['label']}]" if r.get("label") else ""
+    print(f"🧪 {r['adapter']} on {r['interface']} ({rate}), firmware {r['firmware'] or '?'}{label}")
+    print(f"  {'LOAD':>4} {'MEAS':>5} {'RX FPS':>6} {'QFULL':>6} {'LOST':>6} {'ADPT':>5} {'KERN':>5} {'OTHER':>5}"
+          f"  {'GEN>ADPT p99':>12} {'ADPT>KERN p99':>13} {'KERN>USER p99':>13}"
+          f"  {'CPU ms/kf':>9} {'SOFTIRQ':>7} {'RX CYC p99':>10}")
+    for s in r["steps"]:
+        dev = s.get("adapter") or {}
+        lat = [(s.get(k) or {}).get("p99") for k in ("generator_adapter_us", "adapter_kernel_us", "kernel_user_us")]
+        print(f"  {s['target_load']:>4} {_cell(s['measured_load'], 5, '.1f')} {s['rx_fps']:>6} "
+              f"{s['generator_queue_full']:>6} {s['lost']:>6} {_cell(s['lost_adapter'], 5)} {s['lost_kernel']:>5} "
+              f"{s['lost_other']:>5}  {_cell(lat[0], 12, '.1f')} {_cell(lat[1], 13, '.1f')} {_cell(lat[2], 13, '.1f')}"
+              f"  {_cell(s['cpu_ms_per_kframe'], 9, '.2f')} {_cell(s['softirq_ms'], 7)} "
+              f"{_cell(dev.get('rx_cycles_p99'), 10)}")
+    print("  latencies in µs; GEN>ADPT and ADPT>KERN are above the fastest frame (clock offset removed)")
+
+
+def summary(path):
+    with open(path) as f:
+        for line in f:
+            if line.strip():
+                print_run(json.loads(line))
+                print()
+
+
+def load_list(text):
+    loads = [int(v) for v in text.split(",")]
+    if any(not 0 <= v <= 100 for v in loads):
+        raise argparse.ArgumentTypeError("loads are percentages, 0..100")
+    return loads
+
+
+def id_range(text):
+    lo, _, hi = text.partition("-")
+    return int(lo, 0), int(hi or lo, 0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stepped-load HIL benchmark: twai_transmitter -> adapter -> host")
+    parser.add_argument("interface", nargs="?")
+    parser.add_argument("--serial", help="Console UART of the twai_transmitter board, e.g. /dev/ttyUSB0")
+    parser.add_argument("--flash", action="store_true", help="Build and flash twai_transmitter with idf.py first")
+    parser.add_argument("--loads", type=load_list, default=list(DEFAULT_LOADS), help="Comma-separated percentages")
+    parser.add_argument("--seconds", type=float, default=10.0, help="Measurement window per step")
+    parser.add_argument("--settle", type=float, default=1.5, help="Seconds after a load change before measuring")
+    parser.add_argument("--ids", type=id_range, help="Only count IDs in LO-HI (the generator's range)")
+    parser.add_argument("--channel", type=int, default=0, help="Adapter channel for the statistics")
+    parser.add_argument("--label", help="Free text stored with the run, e.g. the build variant")
+    parser.add_argument("--results", help="Append the run as a JSON line to this file")
+    parser.add_argument("--summary", metavar="FILE", help="Print every run of a results file and exit")
+    args = parser.parse_args()
+
+    if args.summary:
+        summary(args.summary)
+        return
+    if args.interface is None or args.serial is None:
+        parser.error("interface and --serial are required")
+    result = run(args)
+    print_run(result)
+    if args.results:
+        with open(args.results, "a") as f:
+            f.write(json.dumps(result) + "\n")
+        print(f"  appended to {args.results}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+
+// Bit timing from a channel's GS_USB_BREQ_BT_CONST / BT_CONST_EXT limits, shared by the USB and
+// SPI hosts.
+
+namespace tritoncan {
+
+class Error : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// struct gs_device_bittiming
+struct BitTiming {
+    uint32_t prop_seg = 0, phase_seg1 = 0, phase_seg2 = 0, sjw = 0, brp = 0;
+};
+
+// GS_CAN_FEATURE_BT_CONST_EXT: the channel has a CAN FD data phase and answers BT_CONST_EXT
+constexpr uint32_t kFeatureBtConstExt = 1 << 10;
+// Bytes of gs_device_bt_const and gs_device_bt_const_extended
+constexpr uint16_t kBtConstSize = 40;
+constexpr uint16_t kBtConstExtSize = 72;
+
+// bt_const: the raw reply, kBtConstExtSize bytes for the data phase. Exact bitrates only, the
+// sample point as close as the limits allow; throws Error when no divider fits.
+BitTiming compute_bittiming(const uint8_t *bt_const, uint32_t bitrate, double sample_point, bool data_phase);
+
+} // namespace tritoncan
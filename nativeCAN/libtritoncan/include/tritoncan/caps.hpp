@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// What an adapter build supports (GS_USB_BREQ_TRITON_CAPS, struct gs_triton_caps in
+// nativeCAN/USB_CAN_esp32s3/main/gs_usb.h), shared by the USB and SPI hosts.
+
+namespace tritoncan {
+
+// Capabilities::features (GS_TRITON_CAP_*)
+constexpr uint32_t kCapUsbBatch = 1 << 0;
+constexpr uint32_t kCapUsbBatchAdaptive = 1 << 1;
+constexpr uint32_t kCapPacked = 1 << 2;
+constexpr uint32_t kCapEchoEp = 1 << 3;
+constexpr uint32_t kCapClock = 1 << 4;
+constexpr uint32_t kCapTxDeadline = 1 << 5;
+constexpr uint32_t kCapFilter = 1 << 6;
+constexpr uint32_t kCapRxPolicy = 1 << 7;
+constexpr uint32_t kCapDecimate = 1 << 8;
+constexpr uint32_t kCapMailbox = 1 << 9;
+constexpr uint32_t kCapCyclic = 1 << 10;
+constexpr uint32_t kCapGateway = 1 << 11;
+constexpr uint32_t kCapServo = 1 << 12;
+constexpr uint32_t kCapMotorCmd = 1 << 13;
+constexpr uint32_t kCapSelftest = 1 << 14;
+constexpr uint32_t kCapAutostart = 1 << 15;
+constexpr uint32_t kCapTasks = 1 << 16;
+constexpr uint32_t kCapTrace = 1 << 17;
+constexpr uint32_t kCapStageProfiling = 1 << 18;
+constexpr uint32_t kCapRxSpill = 1 << 19;
+constexpr uint32_t kCapLogCdc = 1 << 20;
+constexpr uint32_t kCapSpiLink = 1 << 21;
+
+// Bytes of gs_triton_caps version 1, the most a host asks for
+constexpr uint16_t kCapsSize = 92;
+
+// Fields the device did not fill in (older caps versions) stay 0
+struct Capabilities {
+    bool valid = false; // the device answered; false: firmware from before the request
+    uint32_t version = 0;
+    uint32_t features = 0;
+    uint32_t channels = 0;
+    uint32_t fd_channels = 0; // a bit per channel
+    uint32_t usb_in_fifo = 0, usb_out_fifo = 0, usb_ep_size = 0; // bytes
+    uint32_t usb_batch_max_frames = 0;
+    uint32_t packed_block_max = 0;
+    uint32_t spi_block = 0;
+    uint32_t rx_ring_len = 0, rx_spill_frames = 0, tx_queue_len = 0;
+    uint32_t sw_filters = 0, cyclic_slots = 0, decimate_rules = 0, gateway_rules = 0, tx_deadline_rules = 0;
+    uint32_t mailbox_ids = 0, servo_motors = 0, motor_cmd_max = 0;
+    uint32_t stats_version = 0;
+
+    bool has(uint32_t feature) const { return valid && (features & feature) == feature; }
+    bool fd(uint32_t channel) const { return channel < 32 && (fd_channels >> channel & 1); }
+};
+
+// raw: the reply, len the bytes that came back. A reply shorter than its own header is invalid.
+Capabilities parse_capabilities(const uint8_t *raw, size_t len);
+
+} // namespace tritoncan
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+// Maps the adapter's esp_timer (µs) onto the host's CLOCK_MONOTONIC (ns), from timed
+// GS_USB_BREQ_TRITON_CLOCK exchanges. Adapters synced this way share one time base, so frames
+// from different buses can be ordered and fused.
+
+namespace tritoncan {
+
+struct ClockSample {
+    int64_t host_ns = 0;    // midpoint of the exchange on CLOCK_MONOTONIC
+    uint64_t device_us = 0; // device time it returned
+    int64_t rtt_ns = 0;
+};
+
+class ClockSync {
+public:
+    // Samples the offset/drift fit spans (one per second from Device: about half a minute)
+    static constexpr size_t kWindow = 32;
+
+    // One exchange, normally the fastest of a burst: before/after bracket the control transfer
+    void add(int64_t host_before_ns, int64_t host_after_ns, uint64_t device_us);
+    void reset();
+
+    // Host CLOCK_MONOTONIC of a device timestamp, 0 before the first sample. Only the low 32 bits
+    // are used, unwrapped against the latest sample, so wire timestamps and Frame::timestamp_us
+    // both work within ±35 minutes of it.
+    int64_t to_host_ns(uint64_t device_us) const;
+
+    bool synced() const;
+    double drift_ppm() const;   // device clock rate error, positive when the device runs fast
+    int64_t offset_ns() const;  // host - device time at the latest sample
+    int64_t rtt_ns() const;     // round trip of the latest sample; the offset error is below half of it
+    double residual_ns() const; // RMS distance of the samples from the fit
+
+private:
+    void fit();
+
+    mutable std::mutex mutex_;
+    std::deque<ClockSample> samples_;
+    // host_ns = host_ref_ + ns_per_us_ * (device_us - dev_ref_)
+    int64_t host_ref_ = 0;
+    uint64_t dev_ref_ = 0;
+    double ns_per_us_ = 1000.0;
+    double residual_ns_ = 0;
+};
+
+} // namespace tritoncan
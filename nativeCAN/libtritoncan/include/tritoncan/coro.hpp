@@ -0,0 +1,188 @@
+#pragma once
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "tritoncan/coro.hpp needs C++20 coroutines (-std=c++20); the rest of the library is C++17"
+#endif
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include "tritoncan/requests.hpp"
+
+// C++20 coroutines over Requests. A request is one co_await, and its state is the awaiting
+// coroutine's frame, so thousands can be outstanding on one polling thread without a thread or a
+// hand-written callback each:
+//
+//   tritoncan::Task<void> read_param(tritoncan::AsyncBus bus, uint32_t motor) {
+//       tritoncan::Reply r = co_await bus.request(param_read(motor), {reply_id(motor), kMask}, 20ms);
+//       if (r) ... r.frame ...
+//   }
+//   tritoncan::spawn(read_param(tritoncan::AsyncBus(requests, legs), 0x7F));
+//   while (running) requests.poll(buses);   // coroutines resume in here
+//
+// Coroutines resume on the thread that polls, inside Requests::feed() or expire(). Task is lazy:
+// it starts when awaited, or when spawn() detaches it.
+
+namespace tritoncan {
+
+template <class T = void>
+class Task;
+
+namespace detail {
+
+template <class T>
+struct TaskResult {
+    std::optional<T> value;
+    void return_value(T v) { value.emplace(std::move(v)); }
+    T take() { return std::move(*value); }
+};
+
+template <>
+struct TaskResult<void> {
+    void return_void() {}
+    void take() {}
+};
+
+} // namespace detail
+
+template <class T>
+class Task {
+public:
+    struct promise_type : detail::TaskResult<T> {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr error;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        auto final_suspend() noexcept {
+            struct Resume {
+                bool await_ready() noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                    auto next = h.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+            return Resume{};
+        }
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task &operator=(Task &&other) noexcept {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+    ~Task() {
+        if (handle_) handle_.destroy();
+    }
+
+    // co_await task: runs it, resumes the awaiting coroutine when it finishes, rethrows what it threw
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> h;
+            bool await_ready() noexcept { return !h || h.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+                h.promise().continuation = caller;
+                return h;
+            }
+            T await_resume() {
+                if (h.promise().error) std::rethrow_exception(h.promise().error);
+                return h.promise().take();
+            }
+        };
+        return Awaiter{handle_};
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : handle_(h) {}
+    std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+// A coroutine that starts at once and frees its own frame at the end
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); } // as an exception leaving a std::thread
+    };
+};
+
+inline Detached run_detached(Task<void> task) { co_await std::move(task); }
+
+} // namespace detail
+
+// Starts task now and lets it run to the end on its own: up to its first co_await here, the rest
+// inside the poll loop. Exceptions must not escape it.
+inline void spawn(Task<void> task) { detail::run_detached(std::move(task)); }
+
+// co_await on a Requests submission; the Reply is the result
+class RequestAwaiter {
+public:
+    RequestAwaiter(Requests &requests, uint8_t bus, std::optional<Frame> frame, Expect expect, int64_t deadline_ns)
+        : requests_(requests), bus_(bus), frame_(std::move(frame)), expect_(std::move(expect)),
+          deadline_ns_(deadline_ns) {}
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> caller) {
+        auto done = [this, caller](const Reply &reply) {
+            reply_ = reply;
+            // SendFailed is reported inside submit(), before the coroutine has really suspended
+            if (suspended_) caller.resume();
+        };
+        if (frame_) {
+            requests_.submit(bus_, *frame_, std::move(expect_), deadline_ns_, std::move(done));
+        } else {
+            requests_.expect(bus_, std::move(expect_), deadline_ns_, std::move(done));
+        }
+        if (reply_) return false; // completed already: carry on without suspending
+        suspended_ = true;
+        return true;
+    }
+    Reply await_resume() { return std::move(*reply_); }
+
+private:
+    Requests &requests_;
+    uint8_t bus_;
+    std::optional<Frame> frame_;
+    Expect expect_;
+    int64_t deadline_ns_;
+    bool suspended_ = false;
+    std::optional<Reply> reply_;
+};
+
+// One bus of a set seen through its Requests: what a coroutine awaits on
+class AsyncBus {
+public:
+    AsyncBus(Requests &requests, uint8_t bus) : requests_(&requests), bus_(bus) {}
+
+    uint8_t index() const { return bus_; }
+    Requests &requests() const { return *requests_; }
+
+    // Send frame and wait for its reply, at most timeout (reply.status Timeout after it)
+    RequestAwaiter request(const Frame &frame, Expect expect, std::chrono::nanoseconds timeout) const {
+        return RequestAwaiter(*requests_, bus_, frame, std::move(expect), Requests::now_ns() + timeout.count());
+    }
+    // ... until an absolute deadline on CLOCK_MONOTONIC (Requests::now_ns())
+    RequestAwaiter request_until(const Frame &frame, Expect expect, int64_t deadline_ns) const {
+        return RequestAwaiter(*requests_, bus_, frame, std::move(expect), deadline_ns);
+    }
+    // Wait for a matching frame without sending
+    RequestAwaiter receive(Expect expect, std::chrono::nanoseconds timeout) const {
+        return RequestAwaiter(*requests_, bus_, std::nullopt, std::move(expect), Requests::now_ns() + timeout.count());
+    }
+
+private:
+    Requests *requests_;
+    uint8_t bus_;
+};
+
+} // namespace tritoncan
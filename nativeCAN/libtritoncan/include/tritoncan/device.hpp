@@ -0,0 +1,161 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "tritoncan/bittiming.hpp"
+#include "tritoncan/caps.hpp"
+#include "tritoncan/clock.hpp"
+#include "tritoncan/gsusb.hpp"
+#include "tritoncan/packed.hpp"
+
+struct libusb_context;
+struct libusb_device_handle;
+struct libusb_transfer;
+
+// Userspace host for the TritonCAN adapter over libusb. Opening the device detaches the gs_usb kernel
+// driver (the SocketCAN interfaces disappear) and closing it hands the device back, switched to the
+// gs_usb format again. open() reads the adapter's capabilities and takes the fastest path it has:
+// the packed wire format with adaptive USB IN batching and the echo endpoint where built in, plain
+// gs_usb framing on firmware without the packed format.
+
+namespace tritoncan {
+
+constexpr uint16_t kDefaultVid = 0x1D50;
+constexpr uint16_t kDefaultPid = 0x606F;
+
+// GS_CAN_MODE_* flags for Device::start()
+constexpr uint32_t kModeListenOnly = 1 << 0;
+constexpr uint32_t kModeLoopback = 1 << 1;
+constexpr uint32_t kModeFd = 1 << 8;
+
+class Device {
+public:
+    using FrameHandler = std::function<void(const Frame &)>;
+    using AckHandler = std::function<void(const TxAck &)>;
+
+    // Throws Error if no adapter answers or it can't be claimed. Without a serial number the first
+    // adapter found is opened; with several on one host, pick one by serial (its eFuse MAC).
+    static std::unique_ptr<Device> open(uint16_t vid = kDefaultVid, uint16_t pid = kDefaultPid);
+    static std::unique_ptr<Device> open(const std::string &serial, uint16_t vid = kDefaultVid, uint16_t pid = kDefaultPid);
+    // Serial numbers of the adapters present, whether or not gs_usb has them
+    static std::vector<std::string> list(uint16_t vid = kDefaultVid, uint16_t pid = kDefaultPid);
+    ~Device();
+    Device(const Device &) = delete;
+    Device &operator=(const Device &) = delete;
+
+    uint32_t channel_count() const { return channels_; }
+    const std::string &serial() const { return serial_; }
+    // GS_USB_BREQ_TRITON_CAPS; not valid on firmware from before the request
+    const Capabilities &capabilities() const { return caps_; }
+    // Packed wire format in use; false: gs_usb framing, one echo per frame behind each batch ack
+    bool packed() const { return packed_; }
+
+    // Handlers run on the library's event thread: keep them short. Set them before start().
+    void on_frame(FrameHandler handler) { on_frame_ = std::move(handler); }
+    void on_ack(AckHandler handler) { on_ack_ = std::move(handler); }
+
+    // Computes timing from the channel's BT_CONST limits (sample point 87.5% by default)
+    void set_bitrate(uint8_t channel, uint32_t bitrate, double sample_point = 0.875);
+    void set_data_bitrate(uint8_t channel, uint32_t bitrate, double sample_point = 0.75);
+    void set_bittiming(uint8_t channel, const BitTiming &bt, bool data_phase = false);
+    void start(uint8_t channel, uint32_t mode_flags = 0);
+    void stop(uint8_t channel);
+
+    // Queues the frames as one batch (one bulk OUT transfer) and returns its id. The device
+    // acknowledges the batch once, through on_ack, when every frame has been sent or failed.
+    // Over gs_usb framing the library acks the batch from the frames' echoes, Frame::max_age_us
+    // is not carried, and stop() fails the batch's frames still in flight on that channel.
+    uint32_t send(const Frame *frames, size_t count);
+    uint32_t send(const std::vector<Frame> &frames) { return send(frames.data(), frames.size()); }
+
+    // Device -> host clock mapping, behind Frame::host_time_ns. open() syncs it with a burst of
+    // exchanges and a background thread repeats that every kClockSyncPeriod. sync_clock() runs one
+    // burst now and keeps the fastest exchange. Firmware without GS_USB_BREQ_TRITON_CLOCK leaves
+    // the clock unsynced and host_time_ns 0.
+    static constexpr std::chrono::milliseconds kClockSyncPeriod{1000};
+    void sync_clock(int exchanges = 16);
+    const ClockSync &clock() const { return clock_; }
+
+    // Bytes and blocks seen on the IN streams, and framing errors. Over gs_usb framing every frame
+    // counts as a block.
+    uint64_t rx_bytes() const { return rx_bytes_; }
+    uint64_t rx_blocks() const {
+        return decoder_.blocks() + echo_decoder_.blocks() + host_decoder_.frames() + echo_host_decoder_.frames();
+    }
+    uint64_t rx_errors() const {
+        return decoder_.errors() + echo_decoder_.errors() + host_decoder_.errors() + echo_host_decoder_.errors();
+    }
+
+    // Address of the echo endpoint, 0 when everything arrives on 0x81. Firmware built with
+    // CONFIG_TRITON_ECHO_EP sends acks and error frames there, so they never queue behind RX data.
+    // The two endpoints are read concurrently: an ack can reach on_ack before RX frames the device
+    // received earlier reach on_frame.
+    uint8_t echo_endpoint() const { return echo_ep_; }
+
+private:
+    Device() = default;
+    void control_out(uint8_t request, uint16_t value, const void *data, uint16_t len);
+    size_t control_in(uint8_t request, uint16_t value, void *data, uint16_t len); // bytes received
+    BitTiming compute_timing(uint8_t channel, uint32_t bitrate, double sample_point, bool data_phase);
+    void forget_batch(uint32_t batch);
+    void echo_done(uint32_t echo_id, const Frame &echo, bool failed);
+    void fail_echoes(uint8_t channel);
+    void event_loop();
+    void clock_loop();
+    static void in_done(libusb_transfer *transfer);
+    static void out_done(libusb_transfer *transfer);
+
+    libusb_context *ctx_ = nullptr;
+    libusb_device_handle *handle_ = nullptr;
+    uint32_t channels_ = 0;
+    std::string serial_;
+    uint8_t echo_itf_ = 0; // claimed when echo_ep_ is set
+    uint8_t echo_ep_ = 0;
+    Capabilities caps_;
+    bool packed_ = false;
+    bool restore_batch_ = false; // usb_batch_ holds the config open() replaced
+    uint8_t usb_batch_[12] = {};
+    std::vector<libusb_transfer *> in_transfers_;
+    std::vector<std::vector<uint8_t>> in_buffers_;
+    std::atomic<int> in_active_{0};
+    std::atomic<int> out_active_{0};
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+    std::thread clock_thread_;
+    std::mutex clock_mutex_;
+    std::condition_variable clock_cv_;
+    bool clock_running_ = false; // under clock_mutex_
+    ClockSync clock_;
+    std::mutex tx_mutex_;
+    uint32_t next_batch_ = 1;
+    // gs_usb framing, under tx_mutex_: how far each batch got, and the batch of every echo id in flight
+    struct EchoBatch {
+        uint16_t left = 0, sent = 0, failed = 0;
+    };
+    struct InFlight {
+        uint32_t batch;
+        uint8_t channel;
+    };
+    std::unordered_map<uint32_t, EchoBatch> echo_batches_;
+    std::unordered_map<uint32_t, InFlight> echo_ids_;
+    uint32_t next_echo_ = 0;
+    uint32_t fd_started_ = 0; // a bit per channel started with kModeFd
+    HostFrameDecoder host_decoder_;      // gs_usb framing
+    HostFrameDecoder echo_host_decoder_; // gs_usb framing from echo_ep_
+    StreamDecoder decoder_;
+    StreamDecoder echo_decoder_; // blocks from echo_ep_
+    std::atomic<uint64_t> rx_bytes_{0};
+    FrameHandler on_frame_;
+    AckHandler on_ack_;
+};
+
+} // namespace tritoncan
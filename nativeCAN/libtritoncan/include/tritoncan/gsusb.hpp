@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "tritoncan/packed.hpp"
+
+// Plain gs_usb framing (struct gs_host_frame / gs_host_frame_canfd), for firmware without the packed
+// format. Device -> host: whole frames, 4 bytes of timestamp_us after the payload when the channels
+// were started with GS_CAN_MODE_HW_TIMESTAMP. A frame with an echo_id other than kNoEchoId is the
+// echo of a host frame.
+
+namespace tritoncan {
+
+constexpr uint32_t kNoEchoId = 0xFFFFFFFF;
+constexpr size_t kHostFrameHeaderSize = 12;
+// Echo flags of this firmware (the kernel driver ignores them)
+constexpr uint8_t kFlagTxExpired = 1 << 6;
+constexpr uint8_t kFlagTxFailed = 1 << 7;
+
+class HostFrameDecoder {
+public:
+    std::function<void(const Frame &)> on_frame;
+    // echo: the echoed frame's header and timestamp; failed when it carries kFlagTxFailed
+    std::function<void(uint32_t echo_id, const Frame &echo, bool failed)> on_echo;
+
+    // timestamps: the channels run with GS_CAN_MODE_HW_TIMESTAMP. Returns false if the stream was
+    // malformed; the buffered bytes are then dropped.
+    bool feed(const uint8_t *data, size_t len, bool timestamps);
+    void reset();
+
+    uint64_t frames() const { return frames_; }
+    uint64_t errors() const { return errors_; }
+
+private:
+    std::vector<uint8_t> carry_;
+    uint64_t epoch_ = 0;
+    uint32_t last_ts_ = 0;
+    bool have_ts_ = false;
+    uint64_t frames_ = 0;
+    uint64_t errors_ = 0;
+};
+
+// Appends one host frame. fd_channel: the channel was started with kModeFd, so every frame on it
+// takes the gs_host_frame_canfd size.
+void append_host_frame(std::vector<uint8_t> &out, uint32_t echo_id, const Frame &f, bool fd_channel);
+
+} // namespace tritoncan
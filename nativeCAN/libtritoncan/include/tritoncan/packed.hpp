@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Packed wire format of the TritonCAN adapter (GS_USB_BREQ_TRITON_PACKED), as defined by
+// struct gs_triton_packed_* in nativeCAN/USB_CAN_esp32s3/main/gs_usb.h.
+//
+// Device -> host: blocks of { magic, length, timestamp_us } followed by variable-length records
+// { len, flags, chan_type, delta_us, can_id, data[len] }. Host -> device: a { magic, count,
+// batch_id } header and count records, answered by one TX ack record for the whole batch.
+
+namespace tritoncan {
+
+constexpr uint16_t kPackedMagic = 0x5443;
+constexpr size_t kBlockHeaderSize = 8;
+constexpr size_t kRecordHeaderSize = 9;
+constexpr size_t kTxBlockHeaderSize = 8;
+constexpr size_t kMaxPayload = 64;
+
+// Frame::can_id, gs_host_frame / SocketCAN layout
+constexpr uint32_t kCanEffFlag = 0x80000000;
+constexpr uint32_t kCanRtrFlag = 0x40000000;
+constexpr uint32_t kCanErrFlag = 0x20000000;
+
+// Frame::flags (GS_CAN_FLAG_*)
+constexpr uint8_t kFlagOverflow = 1 << 0; // frames were lost on the device before this one
+constexpr uint8_t kFlagFd = 1 << 1;
+constexpr uint8_t kFlagBrs = 1 << 2;
+constexpr uint8_t kFlagEsi = 1 << 3;
+
+enum class RecordType : uint8_t { Frame = 0, TxAck = 1 };
+
+struct Frame {
+    uint32_t can_id = 0;
+    uint8_t channel = 0;
+    uint8_t flags = 0;
+    uint8_t len = 0; // payload bytes: up to 8, or 64 with kFlagFd
+    uint16_t max_age_us = 0; // TX only: the adapter fails the frame this long after it arrives, unsent (0: the channel's rules)
+    std::array<uint8_t, kMaxPayload> data{};
+    uint64_t timestamp_us = 0; // device clock, extended to 64 bits (RX only)
+    int64_t host_time_ns = 0;  // timestamp_us on CLOCK_MONOTONIC, set by Device once its clock is synced
+};
+
+struct TxAck {
+    uint32_t batch_id = 0;
+    uint16_t sent = 0;
+    uint16_t failed = 0; // bus-off, channel stopped, not an FD channel, ...
+    uint64_t timestamp_us = 0;
+    int64_t host_time_ns = 0;
+};
+
+// Reassembles the bulk IN stream. Blocks may straddle transfers; the decoder keeps the partial tail.
+class StreamDecoder {
+public:
+    std::function<void(const Frame &)> on_frame;
+    std::function<void(const TxAck &)> on_ack;
+
+    // Returns false if the stream was malformed; the buffered bytes are then dropped.
+    bool feed(const uint8_t *data, size_t len);
+    void reset();
+
+    uint64_t blocks() const { return blocks_; }
+    uint64_t errors() const { return errors_; }
+
+private:
+    bool decode_block(const uint8_t *block, size_t len);
+    uint64_t extend(uint32_t ts);
+
+    std::vector<uint8_t> carry_;
+    uint64_t epoch_ = 0;
+    uint32_t last_ts_ = 0;
+    bool have_ts_ = false;
+    uint64_t blocks_ = 0;
+    uint64_t errors_ = 0;
+};
+
+// Wire size of one host TX record
+inline size_t tx_record_size(const Frame &f) { return kRecordHeaderSize + f.len; }
+
+// Appends one TX block (at most 65535 frames) to out
+void append_tx_block(std::vector<uint8_t> &out, uint32_t batch_id, const Frame *frames, size_t count);
+
+} // namespace tritoncan
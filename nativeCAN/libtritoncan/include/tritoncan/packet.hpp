@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tritoncan/socketcan.hpp"
+
+// Capture backend on AF_PACKET with a TPACKET_V3 ring, receive only. Each interface gets a packet
+// socket whose ring of blocks is mapped into this process. The kernel writes every frame of the
+// interface into the current block with its timestamp, and hands the block over when it is full or
+// retire_ms after its first frame. Reading a block is a walk over memory the kernel already filled:
+// no system call and no copy per frame, one epoll wake-up per block. The handler gets the same
+// Frame batches as from BusSet.
+//
+// What it sees is what candump sees, not what one raw socket gets: every frame of the interface,
+// error frames included, with no CAN_RAW filters, and the frames any socket on this host sends
+// (the loopback echo, once; the outgoing copy is skipped). A full ring drops frames in the kernel;
+// they are counted in BusStats::rx_dropped and set kFlagOverflow on the first frame of the block
+// that reports them.
+//
+// Needs CAP_NET_RAW. Not a thread-safe object: add(), poll() and stop() as for BusSet.
+
+namespace tritoncan {
+
+struct PacketOptions {
+    // A block is a multiple of the page size; a classic frame takes 112 bytes of it,
+    // an FD frame 176
+    size_t block_size = 1 << 20;
+    unsigned blocks = 16;
+    unsigned retire_ms = 10; // a block that is not full goes to user space after this long
+    // Software: kernel receive time in host_time_ns. Hardware: the driver's stamp in timestamp_us
+    // instead, where it has one (gs_usb with GS_CAN_MODE_HW_TIMESTAMP). None is taken as Software:
+    // the ring has a stamp either way.
+    Timestamps timestamps = Timestamps::Software;
+};
+
+class PacketBusSet {
+public:
+    using BatchHandler = BusSet::BatchHandler;
+    static constexpr size_t kBatch = 256;
+
+    PacketBusSet();
+    ~PacketBusSet();
+    PacketBusSet(const PacketBusSet &) = delete;
+    PacketBusSet &operator=(const PacketBusSet &) = delete;
+
+    // Returns the bus index (its Frame::channel). Throws std::system_error if the socket, its ring
+    // or the binding fails, or the interface is not a CAN interface. Not while the thread runs.
+    uint8_t add(const std::string &interface, const PacketOptions &options = {});
+    size_t size() const { return buses_.size(); }
+    const std::string &interface(uint8_t index) const { return buses_.at(index)->interface; }
+    // rx_batches counts blocks; nothing is sent on this set
+    const BusStats &stats(uint8_t index) const { return buses_.at(index)->stats; }
+
+    void on_frames(BatchHandler handler) { on_frames_ = std::move(handler); }
+    void into(FrameRing &ring);
+
+    // Waits up to timeout_ms (-1 forever) and dispatches every block handed over. Returns the
+    // frames dispatched; 0 on timeout or after stop().
+    size_t poll(int timeout_ms);
+    void start();
+    void stop();
+
+private:
+    struct Bus {
+        std::string interface;
+        int fd = -1;
+        uint8_t *ring = nullptr;
+        size_t ring_size = 0;
+        size_t block_size = 0;
+        unsigned blocks = 0;
+        unsigned next = 0; // the block the kernel hands over next
+        bool hardware = false;
+        BusStats stats;
+    };
+
+    size_t drain(uint8_t index);
+    void dispatch(uint8_t index, size_t count);
+
+    std::vector<std::unique_ptr<Bus>> buses_;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+    BatchHandler on_frames_;
+    std::vector<Frame> batch_;
+};
+
+} // namespace tritoncan
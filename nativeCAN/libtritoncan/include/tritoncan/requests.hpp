@@ -0,0 +1,127 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tritoncan/packed.hpp"
+
+// Correlation of request/response exchanges on a BusSet or UringBusSet: send a frame, then take the
+// first received frame on that bus whose ID (under a mask) and payload say it is the answer, or give
+// up at a deadline. Parameter reads, discovery and group commands all come down to this. Pending
+// requests are indexed by bus and expected reply ID, one table per distinct mask, so a received
+// frame costs a hash lookup per mask however many requests are outstanding. Replies to the same
+// key complete their requests in the order those were made.
+//
+// Not thread-safe: submit, feed and expire on the thread that polls the set (attach() and poll()
+// below do the wiring). Callbacks run there too, after the table is updated, so they may submit
+// again. tritoncan/coro.hpp puts C++20 coroutines on top.
+
+namespace tritoncan {
+
+// What the reply to a request looks like
+struct Expect {
+    uint32_t id = 0;             // Frame::can_id of the reply, kCanEffFlag included for extended IDs
+    uint32_t mask = 0x1FFFFFFF;  // ID bits that must equal id's; the EFF flag is always compared
+    // Optional further test on the frame, such as the parameter index echoed in the payload
+    std::function<bool(const Frame &)> match;
+};
+
+enum class ReplyStatus : uint8_t {
+    Ok,
+    Timeout,
+    SendFailed, // the interface queue refused the request frame (ENOBUFS); nothing was sent
+    Cancelled,
+};
+
+struct Reply {
+    ReplyStatus status = ReplyStatus::Timeout;
+    Frame frame; // the reply, with status Ok
+    explicit operator bool() const { return status == ReplyStatus::Ok; }
+};
+
+class Requests {
+public:
+    using SendFn = std::function<size_t(uint8_t bus, const Frame *frames, size_t count)>;
+    using Callback = std::function<void(const Reply &)>;
+    using Id = uint64_t; // never 0
+
+    // send writes frames to a bus and returns how many were taken, as BusSet::send does
+    explicit Requests(SendFn send) : send_(std::move(send)) {}
+    Requests(const Requests &) = delete;
+    Requests &operator=(const Requests &) = delete;
+
+    // Sends frame on bus; done is called once, with the first accepted reply, with Timeout at
+    // deadline_ns (CLOCK_MONOTONIC, as Frame::host_time_ns), or with SendFailed before submit returns.
+    Id submit(uint8_t bus, const Frame &frame, Expect expect, int64_t deadline_ns, Callback done);
+    // Waits for a reply without sending anything first (a further answer to a broadcast)
+    Id expect(uint8_t bus, Expect expect, int64_t deadline_ns, Callback done);
+    // Completes a pending request with Cancelled; false when it was no longer pending
+    bool cancel(Id id);
+
+    // Completes the requests these frames of bus answer; returns how many
+    size_t feed(uint8_t bus, const Frame *frames, size_t count);
+    // Completes the requests whose deadline is not after now_ns with Timeout; returns how many
+    size_t expire(int64_t now_ns);
+
+    // poll() timeout until the earliest deadline: -1 with nothing pending, at most limit_ms when >= 0
+    int timeout_ms(int64_t now_ns, int limit_ms = -1) const;
+    size_t pending() const { return pending_.size(); }
+    uint64_t completed() const { return completed_; }
+    uint64_t timeouts() const { return timeouts_; }
+
+    static int64_t now_ns();
+
+    // set's frame handler: feed() every batch, then pass it on to next (when set)
+    template <class Set>
+    void attach(Set &set, std::function<void(uint8_t, const Frame *, size_t)> next = {}) {
+        set.on_frames([this, next = std::move(next)](uint8_t bus, const Frame *frames, size_t count) {
+            feed(bus, frames, count);
+            if (next) next(bus, frames, count);
+        });
+    }
+    // One set.poll() that wakes for the earliest deadline, then expire(); returns the frames polled
+    template <class Set>
+    size_t poll(Set &set, int limit_ms = -1) {
+        size_t n = set.poll(timeout_ms(now_ns(), limit_ms));
+        expire(now_ns());
+        return n;
+    }
+
+private:
+    struct Table {
+        uint32_t mask; // with the EFF flag
+        std::unordered_map<uint64_t, std::list<Id>> waiting; // key(bus, id & mask) -> oldest first
+    };
+    struct Pending {
+        uint8_t bus;
+        Expect expect;
+        int64_t deadline_ns;
+        Callback done;
+        std::list<Id>::iterator position; // in its table's list
+    };
+
+    static uint64_t key(uint8_t bus, uint32_t id) { return (uint64_t(bus) << 32) | id; }
+    Table &table(uint32_t mask);
+    Id add(uint8_t bus, Expect expect, int64_t deadline_ns, Callback done);
+    // Takes id out of the tables and queues its callback for run()
+    void finish(Id id, ReplyStatus status, const Frame *frame);
+    void run();
+
+    SendFn send_;
+    Id next_id_ = 1;
+    std::unordered_map<Id, Pending> pending_;
+    std::vector<Table> tables_; // most mask bits first
+    // (deadline, id); entries of requests already completed are skipped when they come up
+    std::priority_queue<std::pair<int64_t, Id>, std::vector<std::pair<int64_t, Id>>, std::greater<>> deadlines_;
+    std::vector<std::pair<Callback, Reply>> ready_;
+    bool running_ = false;
+    uint64_t completed_ = 0;
+    uint64_t timeouts_ = 0;
+};
+
+} // namespace tritoncan
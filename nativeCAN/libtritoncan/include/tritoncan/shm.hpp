@@ -0,0 +1,184 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "tritoncan/packed.hpp"
+
+// Shared-memory fan-out of one CAN interface (tritoncand). The daemon owns the socket and is the
+// only writer of an RX ring that every client reads in place, each at its own cursor; nothing is
+// copied per client and nothing a slow client does holds the others back (it loses frames once it
+// falls a whole ring behind). Each client has its own TX ring, which the daemon drains onto the bus.
+//
+// Segment /dev/shm/tritoncan.<interface>, little-endian, offsets in bytes. td_can_bridges/
+// tritoncand_bus.py reads the same layout, so change both together and bump kShmVersion.
+//
+//   0          ShmHeader (512)
+//   clients    max_clients x ShmClientSlot (64): claimed with an OFD write lock on the slot's
+//              bytes, which the kernel drops when the client closes the segment or dies
+//   rx         slots x ShmFrame (96): frame n in slot n & (slots - 1); seq == n once complete
+//   tx         max_clients x tx_slots x ShmFrame: client i's ring, seq unused
+
+namespace tritoncan {
+
+constexpr uint32_t kShmMagic = 0x48534354; // "TCSH"
+constexpr uint32_t kShmVersion = 1;
+constexpr uint64_t kShmWriting = UINT64_MAX; // ShmFrame::seq while the daemon rewrites the slot
+
+struct ShmFrame {
+    std::atomic<uint64_t> seq;
+    int64_t host_time_ns;  // kernel receive time on CLOCK_MONOTONIC
+    uint64_t timestamp_us; // adapter time, when the daemon runs with hardware timestamps
+    uint32_t can_id;       // with kCanEffFlag / kCanRtrFlag / kCanErrFlag
+    uint8_t len;
+    uint8_t flags;         // kFlagFd / kFlagBrs / kFlagEsi / kFlagOverflow
+    uint8_t reserved[2];
+    uint8_t data[kMaxPayload];
+};
+static_assert(sizeof(ShmFrame) == 96, "ShmFrame layout");
+
+struct ShmClientSlot {
+    std::atomic<uint32_t> owner;   // pid of the client, set once it holds the lock; 0 when free
+    std::atomic<uint32_t> waiting; // the client sleeps on ShmHeader::rx_futex
+    uint64_t reserved;
+    std::atomic<uint64_t> cursor;  // next RX frame the client reads
+    std::atomic<uint64_t> lost;    // frames overwritten before the client read them
+    std::atomic<uint64_t> tx_head; // written by the client
+    std::atomic<uint64_t> tx_tail; // written by the daemon
+    std::atomic<uint64_t> tx_full; // send() calls that found the ring full
+    char name[8];
+};
+static_assert(sizeof(ShmClientSlot) == 64, "ShmClientSlot layout");
+
+struct ShmHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;       // RX ring size, a power of two
+    uint32_t slot_size;   // sizeof(ShmFrame)
+    uint32_t max_clients;
+    uint32_t tx_slots;    // per client, a power of two
+    uint32_t client_size; // sizeof(ShmClientSlot)
+    std::atomic<uint32_t> daemon_pid; // 0 once the daemon has shut down
+    uint64_t clients_offset;
+    uint64_t rx_offset;
+    uint64_t tx_offset;
+    char interface[16];
+    uint8_t reserved0[56];
+    alignas(64) std::atomic<uint64_t> write_seq; // frames published so far
+    std::atomic<uint32_t> rx_futex;              // bumped after every published batch
+    alignas(64) std::atomic<uint32_t> tx_futex;  // bumped by clients after queueing TX
+    std::atomic<uint32_t> tx_sleeping;           // the daemon's TX thread waits on tx_futex
+    alignas(64) std::atomic<uint64_t> rx_frames;
+    std::atomic<uint64_t> rx_dropped;            // by the kernel on the daemon's socket (SO_RXQ_OVFL)
+    std::atomic<uint64_t> tx_frames;
+    std::atomic<uint64_t> tx_busy;               // TX retried because the interface queue was full
+    uint8_t reserved1[224];
+};
+static_assert(sizeof(ShmHeader) == 512, "ShmHeader layout");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory atomics must be lock-free");
+
+std::string shm_path(const std::string &interface); // "/tritoncan.<interface>", for shm_open
+
+// The daemon's side of one segment: creates it, publishes RX, drains the clients' TX rings.
+class ShmPublisher {
+public:
+    // Throws std::system_error. mode applies to the segment (clients need read and write).
+    ShmPublisher(const std::string &interface, uint32_t slots, uint32_t max_clients, uint32_t tx_slots, unsigned mode);
+    ~ShmPublisher(); // unlinks the segment
+    ShmPublisher(const ShmPublisher &) = delete;
+    ShmPublisher &operator=(const ShmPublisher &) = delete;
+
+    void publish(const Frame *frames, size_t count);
+    // Up to max frames queued by the next client with TX pending, round robin; 0 when none is.
+    // consume_tx() then retires the first n (what the bus took); the rest are taken again next time.
+    size_t take_tx(uint32_t &client, Frame *out, size_t max);
+    void consume_tx(uint32_t client, size_t n);
+    // Sleeps until a client queues TX or timeout_ms passes
+    void wait_tx(uint32_t seen, int timeout_ms);
+    uint32_t tx_seen() const { return header_->tx_futex.load(std::memory_order_acquire); }
+    // Frees the slots of clients that exited without detaching
+    void reap();
+
+    ShmHeader &header() { return *header_; }
+    ShmClientSlot &client(uint32_t i) { return clients_[i]; }
+
+private:
+    std::string name_;
+    int fd_ = -1;
+    size_t size_ = 0;
+    ShmHeader *header_ = nullptr;
+    ShmClientSlot *clients_ = nullptr;
+    ShmFrame *rx_ = nullptr;
+    ShmFrame *tx_ = nullptr;
+    uint64_t mask_ = 0;
+    uint32_t next_client_ = 0;
+};
+
+// A client of a running daemon. Not thread-safe: one reader thread (and send() from it or another
+// single thread) per ShmClient; open several for several threads.
+class ShmClient {
+public:
+    explicit ShmClient(const std::string &interface, const std::string &name = {});
+    ~ShmClient();
+    ShmClient(const ShmClient &) = delete;
+    ShmClient &operator=(const ShmClient &) = delete;
+
+    // Copies out up to max frames. Returns 0 when the client has caught up.
+    size_t read(Frame *out, size_t max);
+    // Zero-copy: fn(const ShmFrame &) for each new frame, in place in the ring. Returns the frames
+    // visited. A frame the daemon overwrote while fn looked at it counts in lost(): fn may have
+    // seen it torn, so fn should only read, and copy what it keeps.
+    template <typename Fn>
+    size_t read_view(Fn &&fn, size_t max = SIZE_MAX);
+    // Blocks until frames are pending, timeout_ms passes (-1: forever) or the daemon shuts down.
+    // True when frames are pending.
+    bool wait(int timeout_ms);
+
+    // Queues frames for the daemon to send. Returns how many fit in this client's TX ring.
+    size_t send(const Frame *frames, size_t count);
+
+    uint64_t lost() const { return slot_->lost.load(std::memory_order_relaxed); }
+    bool daemon_alive() const { return header_->daemon_pid.load(std::memory_order_acquire) != 0; }
+    uint64_t pending() const { return header_->write_seq.load(std::memory_order_acquire) - cursor_; }
+    const ShmHeader &header() const { return *header_; }
+
+private:
+    // Skips what was overwritten; returns the start of the frames still in the ring
+    uint64_t catch_up(uint64_t write);
+
+    int fd_ = -1;
+    size_t size_ = 0;
+    uint32_t index_ = 0;
+    ShmHeader *header_ = nullptr;
+    ShmClientSlot *slot_ = nullptr;
+    ShmFrame *rx_ = nullptr;
+    ShmFrame *tx_ = nullptr;
+    uint64_t mask_ = 0;
+    uint64_t cursor_ = 0;
+};
+
+template <typename Fn>
+size_t ShmClient::read_view(Fn &&fn, size_t max) {
+    const uint64_t write = header_->write_seq.load(std::memory_order_acquire);
+    uint64_t c = catch_up(write);
+    size_t n = 0;
+    uint64_t lost = 0;
+    for (; c != write && n < max; c++) {
+        const ShmFrame &f = rx_[c & mask_];
+        if (f.seq.load(std::memory_order_acquire) != c) {
+            lost++;
+            continue;
+        }
+        fn(f);
+        n++;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (f.seq.load(std::memory_order_relaxed) != c) lost++;
+    }
+    cursor_ = c;
+    slot_->cursor.store(c, std::memory_order_relaxed);
+    if (lost) slot_->lost.fetch_add(lost, std::memory_order_relaxed);
+    return n;
+}
+
+} // namespace tritoncan
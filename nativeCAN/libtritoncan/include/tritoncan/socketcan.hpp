@@ -0,0 +1,156 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "tritoncan/packed.hpp"
+
+struct msghdr;
+
+// Raw SocketCAN sockets for any number of buses, read and written in batches: recvmmsg and
+// sendmmsg move up to kBatch frames per system call, and one epoll loop serves every bus. Frames
+// use the same Frame as the libusb Device, so code on top does not care which path they came by.
+//
+// Frame fields on this path:
+//   channel       index of the bus in its BusSet (0 for a SocketBus on its own)
+//   flags         kFlagFd / kFlagBrs / kFlagEsi; kFlagOverflow when the kernel dropped frames on
+//                 this socket (SO_RXQ_OVFL) since the previous one
+//   timestamp_us  adapter time from the driver's hardware timestamp, with Timestamps::Hardware
+//   host_time_ns  kernel receive time, moved onto CLOCK_MONOTONIC
+
+namespace tritoncan {
+
+enum class Timestamps : uint8_t {
+    None,
+    Software, // kernel receive time only
+    Hardware, // and the driver's raw hardware time (gs_usb with GS_CAN_MODE_HW_TIMESTAMP)
+};
+
+struct BusOptions {
+    bool fd = false;          // CAN_RAW_FD_FRAMES: receive and send CAN FD frames too
+    bool receive_own = false; // CAN_RAW_RECV_OWN_MSGS: echoes of this socket's frames
+    bool error_frames = false; // every CAN_ERR_* class, as frames with kCanErrFlag
+    Timestamps timestamps = Timestamps::Software;
+    int rcvbuf = 4 << 20;     // SO_RCVBUF bytes; the kernel may cap it at net.core.rmem_max
+    // CAN_RAW_FILTER as { id, mask } pairs; empty receives everything
+    std::vector<std::pair<uint32_t, uint32_t>> filters;
+};
+
+// Counters of one bus. Written by the thread that reads or writes it, readable from any.
+struct BusStats {
+    std::atomic<uint64_t> rx_frames{0};
+    std::atomic<uint64_t> rx_batches{0};    // recvmmsg calls that returned frames
+    std::atomic<uint64_t> rx_dropped{0};    // SO_RXQ_OVFL: the socket queue was full
+    std::atomic<uint64_t> tx_frames{0};
+    std::atomic<uint64_t> tx_batches{0};
+    std::atomic<uint64_t> tx_busy{0};       // send() calls cut short by a full interface queue
+    std::atomic<uint64_t> error_frames{0};
+};
+
+// One raw CAN socket, non-blocking. Throws std::system_error if it can't be opened or bound.
+class SocketBus {
+public:
+    static constexpr size_t kBatch = 64;
+
+    explicit SocketBus(const std::string &interface, const BusOptions &options = {}, uint8_t channel = 0);
+    ~SocketBus();
+    SocketBus(const SocketBus &) = delete;
+    SocketBus &operator=(const SocketBus &) = delete;
+
+    int fd() const { return fd_; }
+    const std::string &interface() const { return interface_; }
+    uint8_t channel() const { return channel_; }
+    const BusStats &stats() const { return stats_; }
+
+    // Reads what is queued, up to max frames (one recvmmsg per kBatch). Returns 0 when nothing is.
+    size_t receive(Frame *out, size_t max);
+    // Writes frames with sendmmsg. Returns how many the kernel took: fewer than count when the
+    // interface queue is full (ENOBUFS / EAGAIN), in which case the rest stay with the caller.
+    // Safe from any thread, concurrently with receive().
+    size_t send(const Frame *frames, size_t count);
+
+private:
+    friend class UringBusSet;
+    struct RxBuffers; // recvmmsg headers, frames and control messages, reused across calls
+
+    // One received canfd_frame of len bytes and its control messages (msg) into f
+    void decode(const void *frame, size_t len, const msghdr &msg, int64_t to_monotonic, Frame &f);
+
+    std::string interface_;
+    uint8_t channel_;
+    bool fd_frames_;
+    int fd_ = -1;
+    std::unique_ptr<RxBuffers> rx_;
+    uint32_t last_drops_ = 0; // SO_RXQ_OVFL is cumulative per socket
+    BusStats stats_;
+};
+
+// Single-producer, single-consumer ring: the BusSet thread pushes, one consumer thread pops.
+// Frames that don't fit are counted in dropped() instead of blocking the loop.
+class FrameRing {
+public:
+    // Capacity is rounded up to a power of two
+    explicit FrameRing(size_t capacity);
+
+    size_t push(const Frame *frames, size_t count);
+    size_t pop(Frame *out, size_t max);
+    size_t size() const { return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<Frame> slots_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
+
+// Many SocketBus on one epoll loop. Add the buses, set the handler, then either call poll() from
+// your own loop or start() the library's thread.
+class BusSet {
+public:
+    // A batch of frames from one bus: frames[i].channel == bus for all of them
+    using BatchHandler = std::function<void(uint8_t bus, const Frame *frames, size_t count)>;
+
+    BusSet();
+    ~BusSet();
+    BusSet(const BusSet &) = delete;
+    BusSet &operator=(const BusSet &) = delete;
+
+    // Returns the bus index (its Frame::channel). Not while the thread runs.
+    uint8_t add(const std::string &interface, const BusOptions &options = {});
+    size_t size() const { return buses_.size(); }
+    SocketBus &bus(uint8_t index) { return *buses_.at(index); }
+    const SocketBus &bus(uint8_t index) const { return *buses_.at(index); }
+
+    // Runs on the thread that polls: keep it short, or push into a FrameRing
+    void on_frames(BatchHandler handler) { on_frames_ = std::move(handler); }
+    // Convenience handler: every bus's frames into ring (one consumer)
+    void into(FrameRing &ring);
+
+    // Waits up to timeout_ms (-1 forever) and dispatches every bus that has frames. Returns the
+    // frames dispatched; 0 on timeout or after stop().
+    size_t poll(int timeout_ms);
+    void start();            // poll() on a thread of its own until stop()
+    void stop();             // wakes poll() and joins the thread; safe from any thread
+
+    size_t send(uint8_t bus, const Frame *frames, size_t count) { return buses_.at(bus)->send(frames, count); }
+    size_t send(uint8_t bus, const std::vector<Frame> &frames) { return send(bus, frames.data(), frames.size()); }
+
+private:
+    std::vector<std::unique_ptr<SocketBus>> buses_;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+    BatchHandler on_frames_;
+    std::vector<Frame> batch_;
+};
+
+} // namespace tritoncan
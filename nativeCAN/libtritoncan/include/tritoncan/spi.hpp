@@ -0,0 +1,156 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tritoncan/bittiming.hpp"
+#include "tritoncan/caps.hpp"
+#include "tritoncan/clock.hpp"
+#include "tritoncan/packed.hpp"
+
+// Host side of the adapter's SPI link (firmware built with CONFIG_TRITON_SPI_LINK, section Y of
+// ../README.md) on Linux spidev, the host as SPI master. The data-ready line is read through the
+// GPIO character device. The interface is Device's: the same packed frames, batch acks and
+// control requests, carried in fixed-size full-duplex transactions by one I/O thread.
+
+namespace tritoncan {
+
+struct SpiOptions {
+    std::string device = "/dev/spidev0.0";
+    uint32_t speed_hz = 20000000;
+    std::string gpio_chip = "/dev/gpiochip0";
+    int drdy_line = -1;      // offset of the data-ready line on gpio_chip; -1: poll every poll_us
+    uint32_t block = 1024;   // the firmware's CONFIG_TRITON_SPI_LINK_BLOCK
+    uint32_t gap_us = 50;    // least time between transactions, for the device to queue the next
+    uint32_t poll_us = 1000; // clock an idle link this often without drdy_line, or while waiting for credit
+};
+
+struct SpiStats {
+    uint64_t transactions = 0;
+    uint64_t bad = 0;     // from the device: wrong magic, length or CRC; their frames are lost
+    uint64_t resent = 0;  // host payloads the device did not take and got again
+    uint64_t control_retries = 0;
+};
+
+class SpiDevice {
+public:
+    using FrameHandler = std::function<void(const Frame &)>;
+    using AckHandler = std::function<void(const TxAck &)>;
+
+    // Throws Error if the device does not answer on options.device or its block size differs
+    static std::unique_ptr<SpiDevice> open(const SpiOptions &options = {});
+    ~SpiDevice();
+    SpiDevice(const SpiDevice &) = delete;
+    SpiDevice &operator=(const SpiDevice &) = delete;
+
+    uint32_t channel_count() const { return channels_; }
+    // GS_USB_BREQ_TRITON_CAPS; not valid on firmware from before the request
+    const Capabilities &capabilities() const { return caps_; }
+
+    // Handlers run on the I/O thread: keep them short. Set them before start().
+    void on_frame(FrameHandler handler) { on_frame_ = std::move(handler); }
+    void on_ack(AckHandler handler) { on_ack_ = std::move(handler); }
+
+    void set_bitrate(uint8_t channel, uint32_t bitrate, double sample_point = 0.875);
+    void set_data_bitrate(uint8_t channel, uint32_t bitrate, double sample_point = 0.75);
+    void set_bittiming(uint8_t channel, const BitTiming &bt, bool data_phase = false);
+    void start(uint8_t channel, uint32_t mode_flags = 0);
+    void stop(uint8_t channel);
+
+    // Queues the frames as one batch and returns its id; on_ack reports it once. The batch goes
+    // out as the device's credit allows, possibly split over several transactions.
+    uint32_t send(const Frame *frames, size_t count);
+    uint32_t send(const std::vector<Frame> &frames) { return send(frames.data(), frames.size()); }
+
+    // As Device. The device samples its clock between the transaction that carries the request
+    // and the one that carries the reply, so an exchange brackets it within the gap between two
+    // transactions rather than a USB round trip.
+    static constexpr std::chrono::milliseconds kClockSyncPeriod{1000};
+    void sync_clock(int exchanges = 16);
+    const ClockSync &clock() const { return clock_; }
+
+    uint64_t rx_bytes() const { return rx_bytes_; }
+    uint64_t rx_blocks() const { return decoder_.blocks(); }
+    uint64_t rx_errors() const { return decoder_.errors(); }
+    SpiStats stats() const;
+
+private:
+    struct Payload {
+        uint8_t seq;
+        std::vector<uint8_t> bytes;
+        uint64_t sent_in = 0; // transaction that last carried it
+    };
+    struct Control {
+        std::vector<uint8_t> request; // gs_triton_spi_ctrl and OUT data
+        uint8_t tag = 0;
+        bool pending = false, done = false, stalled = false;
+        uint64_t sent_in = 0; // 0: not sent yet
+        int64_t sent_end_ns = 0, reply_start_ns = 0;
+        std::vector<uint8_t> reply;
+    };
+
+    explicit SpiDevice(const SpiOptions &options) : options_(options) {}
+    void control(bool in, uint8_t request, uint16_t value, void *data, uint16_t len, int64_t *before = nullptr,
+                 int64_t *after = nullptr);
+    void control_out(uint8_t request, uint16_t value, const void *data, uint16_t len);
+    void control_in(uint8_t request, uint16_t value, void *data, uint16_t len);
+    BitTiming compute_timing(uint8_t channel, uint32_t bitrate, double sample_point, bool data_phase);
+    size_t credit_left() const;
+    bool stream_ready() const;
+    void build(uint8_t *tx);
+    void handle(uint8_t *rx, int64_t start_ns);
+    bool transfer();
+    bool drdy_level();
+    void wait(int64_t timeout_us);
+    void io_loop();
+    void clock_loop();
+
+    SpiOptions options_;
+    int spi_fd_ = -1;
+    int drdy_fd_ = -1;
+    int wake_fd_ = -1;
+    uint32_t channels_ = 0;
+    Capabilities caps_;
+    std::vector<uint8_t> tx_buf_, rx_buf_;
+    uint64_t txn_ = 0;         // transactions clocked
+    int64_t last_end_ns_ = 0;
+    bool more_ = false;        // the device said frames are left over
+    bool synced_ = false;      // a good header came back since open
+    uint32_t device_block_ = 0; // transaction size the device reported
+
+    mutable std::mutex mutex_; // everything below, between the I/O thread and callers
+    std::condition_variable cv_;
+    std::deque<uint8_t> unsent_;   // host stream not handed to a payload yet
+    std::deque<Payload> unacked_;  // sent, not acknowledged yet, in seq order
+    size_t resend_ = 0;            // unacked_ from here on are due (again); == size(): none
+    uint8_t next_seq_ = 0;
+    uint32_t credit_ = 0;          // from the latest good header
+    uint64_t credit_txn_ = 0;      // the transaction that brought it
+    Control ctrl_;
+    uint8_t next_tag_ = 1;
+    SpiStats stats_;
+    uint32_t next_batch_ = 1;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+
+    std::mutex control_mutex_; // one control request at a time
+    std::thread clock_thread_;
+    std::mutex clock_mutex_;
+    std::condition_variable clock_cv_;
+    bool clock_running_ = false; // under clock_mutex_
+    ClockSync clock_;
+    StreamDecoder decoder_;
+    std::atomic<uint64_t> rx_bytes_{0};
+    FrameHandler on_frame_;
+    AckHandler on_ack_;
+};
+
+} // namespace tritoncan
@@ -0,0 +1,102 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tritoncan/socketcan.hpp"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf;
+struct msghdr;
+
+// io_uring receive backend, a drop-in for BusSet. Each bus has one multishot recvmsg armed on it.
+// Every bus draws from one provided buffer ring registered with the kernel (IORING_REGISTER_PBUF_RING),
+// and all of them complete into one completion queue. A wake-up then costs one io_uring_enter()
+// however many buses have frames, where BusSet makes an epoll_wait plus one recvmmsg per ready bus.
+// Frames, timestamps and drop counters are the same as BusSet's. Sending stays on sendmmsg.
+//
+// Needs Linux 6.0 (multishot recvmsg). UringBusSet::supported() says whether this kernel (and any
+// seccomp policy around it, as in most containers) allows it; fall back to BusSet when it doesn't.
+// Not a thread-safe object: add(), poll() and stop() as for BusSet.
+
+namespace tritoncan {
+
+class UringBusSet {
+public:
+    using BatchHandler = BusSet::BatchHandler;
+
+    // Receive buffers shared by every bus, one frame each. When they run out a bus's multishot
+    // receive ends; it is re-armed once buffers are recycled and its frames wait in the socket.
+    static constexpr unsigned kBuffers = 4096;
+    static constexpr unsigned kQueueDepth = 64;
+
+    static bool supported();
+
+    UringBusSet();
+    ~UringBusSet();
+    UringBusSet(const UringBusSet &) = delete;
+    UringBusSet &operator=(const UringBusSet &) = delete;
+
+    uint8_t add(const std::string &interface, const BusOptions &options = {});
+    size_t size() const { return buses_.size(); }
+    SocketBus &bus(uint8_t index) { return *buses_.at(index).socket; }
+    const SocketBus &bus(uint8_t index) const { return *buses_.at(index).socket; }
+
+    void on_frames(BatchHandler handler) { on_frames_ = std::move(handler); }
+    void into(FrameRing &ring);
+
+    size_t poll(int timeout_ms);
+    void start();
+    void stop();
+
+    size_t send(uint8_t bus, const Frame *frames, size_t count) { return buses_.at(bus).socket->send(frames, count); }
+    size_t send(uint8_t bus, const std::vector<Frame> &frames) { return send(bus, frames.data(), frames.size()); }
+
+    // Multishot receives that ended and were armed again (out of buffers, mostly)
+    uint64_t rearms() const { return rearms_.load(std::memory_order_relaxed); }
+
+private:
+    struct Bus {
+        std::unique_ptr<SocketBus> socket;
+        std::unique_ptr<msghdr> msg; // template for the multishot receive: control length only
+        std::vector<Frame> pending;  // this wake-up's frames, dispatched as one batch
+    };
+
+    void release();
+    io_uring_sqe *next_sqe();
+    void arm_receive(uint8_t index);
+    void arm_wake();
+    void submit_and_wait(int timeout_ms);
+    void recycle(uint16_t bid);
+    void flush(uint8_t index);
+
+    int ring_fd_ = -1;
+    int wake_fd_ = -1;
+    // Submission and completion rings (one mmap with IORING_FEAT_SINGLE_MMAP), and the SQE array
+    void *ring_ = nullptr;
+    size_t ring_size_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned *sq_head_ = nullptr, *sq_tail_ = nullptr, *sq_mask_ = nullptr, *sq_array_ = nullptr;
+    unsigned *cq_head_ = nullptr, *cq_tail_ = nullptr, *cq_mask_ = nullptr;
+    io_uring_cqe *cqes_ = nullptr;
+    unsigned to_submit_ = 0;
+    // Provided buffers: the ring the kernel picks from and the memory behind it
+    io_uring_buf *buf_ring_ = nullptr; // the tail overlays buf_ring_[0].resv
+    size_t buf_ring_size_ = 0;
+    uint8_t *buffers_ = nullptr;
+    uint16_t buf_tail_ = 0;
+
+    std::vector<Bus> buses_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> rearms_{0};
+    std::thread thread_;
+    BatchHandler on_frames_;
+};
+
+} // namespace tritoncan
@@ -0,0 +1,53 @@
+#include "tritoncan/bittiming.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace tritoncan {
+
+namespace {
+
+uint32_t u32_at(const uint8_t *p, size_t i) {
+    p += 4 * i;
+    return static_cast<uint32_t>(p[0] | p[1] << 8 | p[2] << 16) | static_cast<uint32_t>(p[3]) << 24;
+}
+
+} // namespace
+
+BitTiming compute_bittiming(const uint8_t *raw, uint32_t bitrate, double sample_point, bool data_phase) {
+    // gs_device_bt_const_extended: feature, fclk, then nominal limits, then data limits
+    size_t base = data_phase ? 10 : 2;
+    uint32_t fclk = u32_at(raw, 1);
+    uint32_t tseg1_min = u32_at(raw, base), tseg1_max = u32_at(raw, base + 1);
+    uint32_t tseg2_min = u32_at(raw, base + 2), tseg2_max = u32_at(raw, base + 3);
+    uint32_t sjw_max = u32_at(raw, base + 4);
+    uint32_t brp_min = u32_at(raw, base + 5), brp_max = u32_at(raw, base + 6), brp_inc = u32_at(raw, base + 7);
+    if (brp_inc == 0) brp_inc = 1;
+
+    BitTiming best;
+    double best_err = 1.0;
+    for (uint32_t brp = brp_min ? brp_min : 1; brp <= brp_max; brp += brp_inc) {
+        if (fclk % (brp * bitrate)) continue; // exact bitrates only
+        uint32_t tq = fclk / (brp * bitrate);
+        if (tq < 1 + tseg1_min + tseg2_min || tq > 1 + tseg1_max + tseg2_max) continue;
+        auto tseg2 = static_cast<uint32_t>(std::lround(tq * (1.0 - sample_point)));
+        if (tseg2 < tseg2_min) tseg2 = tseg2_min;
+        if (tseg2 > tseg2_max) tseg2 = tseg2_max;
+        uint32_t tseg1 = tq - 1 - tseg2;
+        if (tseg1 < tseg1_min || tseg1 > tseg1_max) continue;
+        double err = std::fabs(static_cast<double>(1 + tseg1) / tq - sample_point);
+        if (err < best_err) { // ascending brp: on a tie, more time quanta win
+            best_err = err;
+            best.brp = brp;
+            best.prop_seg = tseg1 / 2;
+            best.phase_seg1 = tseg1 - best.prop_seg;
+            best.phase_seg2 = tseg2;
+            best.sjw = std::min(sjw_max, std::max<uint32_t>(1, tseg2 / 2));
+        }
+    }
+    if (best.brp == 0) throw Error("no bit timing for " + std::to_string(bitrate) + " bit/s");
+    return best;
+}
+
+} // namespace tritoncan
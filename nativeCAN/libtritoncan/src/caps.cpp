@@ -0,0 +1,48 @@
+#include "tritoncan/caps.hpp"
+
+#include <algorithm>
+
+namespace tritoncan {
+
+namespace {
+
+uint32_t u32_at(const uint8_t *p, size_t i) {
+    p += 4 * i;
+    return static_cast<uint32_t>(p[0] | p[1] << 8 | p[2] << 16) | static_cast<uint32_t>(p[3]) << 24;
+}
+
+} // namespace
+
+Capabilities parse_capabilities(const uint8_t *raw, size_t len) {
+    Capabilities c;
+    if (len < 12) return c;
+    // size: what the device filled in, which may be more (a newer version) or less than len
+    size_t words = std::min<size_t>(len, u32_at(raw, 1)) / 4;
+    auto field = [&](size_t i) { return i < words ? u32_at(raw, i) : 0u; };
+    c.valid = true;
+    c.version = field(0);
+    c.features = field(2);
+    c.channels = field(3);
+    c.fd_channels = field(4);
+    c.usb_in_fifo = field(5);
+    c.usb_out_fifo = field(6);
+    c.usb_ep_size = field(7);
+    c.usb_batch_max_frames = field(8);
+    c.packed_block_max = field(9);
+    c.spi_block = field(10);
+    c.rx_ring_len = field(11);
+    c.rx_spill_frames = field(12);
+    c.tx_queue_len = field(13);
+    c.sw_filters = field(14);
+    c.cyclic_slots = field(15);
+    c.decimate_rules = field(16);
+    c.gateway_rules = field(17);
+    c.tx_deadline_rules = field(18);
+    c.mailbox_ids = field(19);
+    c.servo_motors = field(20);
+    c.motor_cmd_max = field(21);
+    c.stats_version = field(22);
+    return c;
+}
+
+} // namespace tritoncan
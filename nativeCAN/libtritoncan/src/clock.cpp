@@ -0,0 +1,93 @@
+#include "tritoncan/clock.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace tritoncan {
+
+void ClockSync::add(int64_t host_before_ns, int64_t host_after_ns, uint64_t device_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // A device clock that went backwards means the adapter rebooted: the old fit is meaningless
+    if (!samples_.empty() && device_us <= samples_.back().device_us) samples_.clear();
+    samples_.push_back({host_before_ns + (host_after_ns - host_before_ns) / 2, device_us, host_after_ns - host_before_ns});
+    if (samples_.size() > kWindow) samples_.pop_front();
+    fit();
+}
+
+void ClockSync::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    samples_.clear();
+    host_ref_ = 0;
+    dev_ref_ = 0;
+    ns_per_us_ = 1000.0;
+    residual_ns_ = 0;
+}
+
+// Least squares over the samples whose round trip was close to the best one: a slow exchange
+// (host preempted, bus busy) says little about when the device sampled its clock
+void ClockSync::fit() {
+    const ClockSample &last = samples_.back();
+    int64_t best_rtt = last.rtt_ns;
+    for (const ClockSample &s : samples_) best_rtt = std::min(best_rtt, s.rtt_ns);
+    double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (const ClockSample &s : samples_) {
+        if (s.rtt_ns > 2 * best_rtt) continue;
+        // Relative to the latest sample, so doubles keep sub-ns resolution
+        double x = static_cast<double>(static_cast<int64_t>(s.device_us - last.device_us));
+        double y = static_cast<double>(s.host_ns - last.host_ns);
+        n++;
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    double var = n * sxx - sx * sx;
+    // Two close samples give a wild slope: wait for a spread of at least a second
+    double slope = (n >= 2 && var > 0 && sxx - sx * sx / n > 1e12) ? (n * sxy - sx * sy) / var : 1000.0;
+    double intercept = n > 0 ? (sy - slope * sx) / n : 0;
+    double sq = 0;
+    for (const ClockSample &s : samples_) {
+        if (s.rtt_ns > 2 * best_rtt) continue;
+        double x = static_cast<double>(static_cast<int64_t>(s.device_us - last.device_us));
+        double e = static_cast<double>(s.host_ns - last.host_ns) - (intercept + slope * x);
+        sq += e * e;
+    }
+    host_ref_ = last.host_ns + static_cast<int64_t>(std::llround(intercept));
+    dev_ref_ = last.device_us;
+    ns_per_us_ = slope;
+    residual_ns_ = n > 0 ? std::sqrt(sq / n) : 0;
+}
+
+int64_t ClockSync::to_host_ns(uint64_t device_us) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (samples_.empty()) return 0;
+    auto delta = static_cast<int32_t>(static_cast<uint32_t>(device_us) - static_cast<uint32_t>(dev_ref_));
+    return host_ref_ + static_cast<int64_t>(std::llround(ns_per_us_ * delta));
+}
+
+bool ClockSync::synced() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !samples_.empty();
+}
+
+double ClockSync::drift_ppm() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return (1000.0 / ns_per_us_ - 1.0) * 1e6;
+}
+
+int64_t ClockSync::offset_ns() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return host_ref_ - static_cast<int64_t>(dev_ref_) * 1000;
+}
+
+int64_t ClockSync::rtt_ns() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return samples_.empty() ? 0 : samples_.back().rtt_ns;
+}
+
+double ClockSync::residual_ns() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return residual_ns_;
+}
+
+} // namespace tritoncan
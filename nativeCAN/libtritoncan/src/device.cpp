@@ -0,0 +1,506 @@
+#include "tritoncan/device.hpp"
+
+#include <libusb-1.0/libusb.h>
+
+#include <algorithm>
+#include <ctime>
+#include <initializer_list>
+#include <iterator>
+#include <string>
+
+namespace tritoncan {
+
+namespace {
+
+// gs_usb.h
+constexpr uint8_t kBreqHostFormat = 0;
+constexpr uint8_t kBreqBitTiming = 1;
+constexpr uint8_t kBreqMode = 2;
+constexpr uint8_t kBreqBtConst = 4;
+constexpr uint8_t kBreqDeviceConfig = 5;
+constexpr uint8_t kBreqDataBitTiming = 10;
+constexpr uint8_t kBreqBtConstExt = 11;
+constexpr uint8_t kBreqTritonUsbBatch = 0x40;
+constexpr uint8_t kBreqTritonPacked = 0x47;
+constexpr uint8_t kBreqTritonClock = 0x4B;
+constexpr uint8_t kBreqTritonEchoEp = 0x51;
+constexpr uint8_t kBreqTritonCaps = 0x53;
+constexpr uint32_t kModeReset = 0;
+constexpr uint32_t kModeStart = 1;
+constexpr uint32_t kModeHwTimestamp = 1 << 4;
+constexpr uint32_t kFeatureFd = 1 << 8;
+constexpr uint32_t kUsbBatchAdaptive = 1 << 0;
+// gs_usb framing: echo ids the host picks stay clear of the firmware's own from 0xFFFD0000 up
+constexpr uint32_t kEchoIdMask = 0x7FFFFFFF;
+
+constexpr uint8_t kInterface = 0;
+constexpr uint8_t kEpIn = 0x81;
+constexpr uint8_t kEpOut = 0x01;
+constexpr uint8_t kReqOut = LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE;
+constexpr uint8_t kReqIn = LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE;
+constexpr unsigned kControlTimeoutMs = 1000;
+
+// Several IN transfers stay queued so the device never waits for the host to resubmit
+constexpr int kInTransfers = 8;
+constexpr int kInTransferSize = 16384;
+// The echo endpoint carries acks and error frames only: short transfers, flushed one by one
+constexpr int kEchoTransfers = 4;
+constexpr int kEchoTransferSize = 2048;
+
+struct OutRequest {
+    std::atomic<int> *active;
+    std::vector<uint8_t> buf;
+};
+
+void check(int rc, const char *what) {
+    if (rc < 0) throw Error(std::string(what) + ": " + libusb_error_name(rc));
+}
+
+// Control payloads are arrays of little-endian uint32 (the device is an ESP32-S3)
+std::vector<uint8_t> pack_u32(std::initializer_list<uint32_t> values) {
+    std::vector<uint8_t> out;
+    for (uint32_t v : values) {
+        for (int i = 0; i < 4; i++) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+    return out;
+}
+
+uint32_t u32_at(const uint8_t *p, size_t i) {
+    p += 4 * i;
+    return static_cast<uint32_t>(p[0] | p[1] << 8 | p[2] << 16) | static_cast<uint32_t>(p[3]) << 24;
+}
+
+// Visits every adapter with the given VID/PID: fn(handle, serial) returns true to keep the handle
+template <typename Fn>
+void for_each_adapter(libusb_context *ctx, uint16_t vid, uint16_t pid, Fn fn) {
+    libusb_device **list = nullptr;
+    ssize_t n = libusb_get_device_list(ctx, &list);
+    check(static_cast<int>(n < 0 ? n : 0), "libusb_get_device_list");
+    for (ssize_t i = 0; i < n; i++) {
+        libusb_device_descriptor desc;
+        if (libusb_get_device_descriptor(list[i], &desc) < 0 || desc.idVendor != vid || desc.idProduct != pid) continue;
+        libusb_device_handle *h = nullptr;
+        if (libusb_open(list[i], &h) < 0) continue; // no permission: see udev/99-tritoncan.rules
+        unsigned char serial[64] = {};
+        int len = libusb_get_string_descriptor_ascii(h, desc.iSerialNumber, serial, sizeof(serial) - 1);
+        if (fn(h, std::string(reinterpret_cast<char *>(serial), len > 0 ? static_cast<size_t>(len) : 0))) break;
+        libusb_close(h);
+    }
+    libusb_free_device_list(list, 1);
+}
+
+// Firmware built with CONFIG_TRITON_ECHO_EP has a second vendor interface with a single bulk IN
+// endpoint. Returns false when there is none.
+bool find_echo_interface(libusb_device_handle *h, uint8_t &itf, uint8_t &ep) {
+    libusb_config_descriptor *config = nullptr;
+    if (libusb_get_active_config_descriptor(libusb_get_device(h), &config) < 0) return false;
+    bool found = false;
+    for (uint8_t i = 0; i < config->bNumInterfaces && !found; i++) {
+        if (config->interface[i].num_altsetting < 1) continue;
+        const libusb_interface_descriptor &alt = config->interface[i].altsetting[0];
+        if (alt.bInterfaceNumber == kInterface || alt.bInterfaceClass != LIBUSB_CLASS_VENDOR_SPEC || alt.bNumEndpoints != 1) continue;
+        const libusb_endpoint_descriptor &e = alt.endpoint[0];
+        if ((e.bEndpointAddress & LIBUSB_ENDPOINT_IN) && (e.bmAttributes & 0x03) == LIBUSB_TRANSFER_TYPE_BULK) {
+            itf = alt.bInterfaceNumber;
+            ep = e.bEndpointAddress;
+            found = true;
+        }
+    }
+    libusb_free_config_descriptor(config);
+    return found;
+}
+
+int64_t monotonic_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+} // namespace
+
+std::vector<std::string> Device::list(uint16_t vid, uint16_t pid) {
+    libusb_context *ctx = nullptr;
+    check(libusb_init(&ctx), "libusb_init");
+    std::vector<std::string> serials;
+    try {
+        for_each_adapter(ctx, vid, pid, [&](libusb_device_handle *, const std::string &serial) {
+            serials.push_back(serial);
+            return false;
+        });
+    } catch (const Error &) {
+        libusb_exit(ctx);
+        throw;
+    }
+    libusb_exit(ctx);
+    return serials;
+}
+
+std::unique_ptr<Device> Device::open(uint16_t vid, uint16_t pid) {
+    return open(std::string(), vid, pid);
+}
+
+std::unique_ptr<Device> Device::open(const std::string &serial, uint16_t vid, uint16_t pid) {
+    std::unique_ptr<Device> d(new Device());
+    check(libusb_init(&d->ctx_), "libusb_init");
+    for_each_adapter(d->ctx_, vid, pid, [&](libusb_device_handle *h, const std::string &s) {
+        if (!serial.empty() && s != serial) return false;
+        d->handle_ = h;
+        d->serial_ = s;
+        return true;
+    });
+    if (!d->handle_) throw Error(serial.empty() ? "TritonCAN adapter not found" : "TritonCAN adapter " + serial + " not found");
+    libusb_set_auto_detach_kernel_driver(d->handle_, 1); // gs_usb comes back on release
+    check(libusb_claim_interface(d->handle_, kInterface), "claim interface");
+
+    auto host_format = pack_u32({0x0000beef});
+    d->control_out(kBreqHostFormat, 1, host_format.data(), static_cast<uint16_t>(host_format.size()));
+    uint8_t config[12] = {};
+    d->control_in(kBreqDeviceConfig, 0, config, sizeof(config));
+    d->channels_ = config[3] + 1u; // icount
+    uint8_t caps[kCapsSize] = {};
+    try {
+        d->caps_ = parse_capabilities(caps, d->control_in(kBreqTritonCaps, 0, caps, sizeof(caps)));
+    } catch (const Error &) {
+        // firmware from before GS_USB_BREQ_TRITON_CAPS: each request below is tried instead
+    }
+    // The format can only change while every channel is stopped
+    for (uint32_t ch = 0; ch < d->channels_; ch++) d->stop(static_cast<uint8_t>(ch));
+    if (!d->caps_.valid || d->caps_.has(kCapPacked)) {
+        auto packed = pack_u32({1});
+        try {
+            d->control_out(kBreqTritonPacked, 0, packed.data(), static_cast<uint16_t>(packed.size()));
+            d->packed_ = true;
+        } catch (const Error &) {
+            if (d->caps_.valid) throw;
+            // older firmware: gs_usb framing
+        }
+    }
+    if (d->packed_ && d->caps_.has(kCapUsbBatchAdaptive)) {
+        // Batches as large as the IN FIFO takes while frames stream, one frame per transfer while
+        // they are sparse; the device's flush deadline stays
+        if (d->control_in(kBreqTritonUsbBatch, 0, d->usb_batch_, sizeof(d->usb_batch_)) >= 8) {
+            d->restore_batch_ = true;
+            auto batch = pack_u32({d->caps_.usb_batch_max_frames, u32_at(d->usb_batch_, 1), kUsbBatchAdaptive});
+            d->control_out(kBreqTritonUsbBatch, 0, batch.data(), static_cast<uint16_t>(batch.size()));
+        }
+    }
+    uint8_t echo_itf = 0;
+    if ((!d->caps_.valid || d->caps_.has(kCapEchoEp)) && find_echo_interface(d->handle_, echo_itf, d->echo_ep_) &&
+        libusb_claim_interface(d->handle_, echo_itf) == 0) {
+        d->echo_itf_ = echo_itf;
+        auto enable = pack_u32({1, 0});
+        try {
+            d->control_out(kBreqTritonEchoEp, 0, enable.data(), static_cast<uint16_t>(enable.size()));
+        } catch (const Error &) {
+            d->echo_ep_ = 0; // older firmware: echoes stay on 0x81
+        }
+    } else {
+        d->echo_ep_ = 0;
+    }
+
+    Device *dev = d.get();
+    auto on_frame = [dev](const Frame &f) {
+        if (!dev->on_frame_) return;
+        Frame out = f;
+        out.host_time_ns = dev->clock_.to_host_ns(f.timestamp_us);
+        dev->on_frame_(out);
+    };
+    auto on_ack = [dev](const TxAck &a) {
+        if (!dev->on_ack_) return;
+        TxAck out = a;
+        out.host_time_ns = dev->clock_.to_host_ns(a.timestamp_us);
+        dev->on_ack_(out);
+    };
+    d->decoder_.on_frame = d->echo_decoder_.on_frame = on_frame;
+    d->decoder_.on_ack = d->echo_decoder_.on_ack = on_ack;
+    d->host_decoder_.on_frame = d->echo_host_decoder_.on_frame = on_frame;
+    d->host_decoder_.on_echo = d->echo_host_decoder_.on_echo = [dev](uint32_t id, const Frame &echo, bool failed) {
+        dev->echo_done(id, echo, failed);
+    };
+
+    d->running_ = true;
+    int echo_transfers = d->echo_ep_ ? kEchoTransfers : 0;
+    for (int i = 0; i < kInTransfers + echo_transfers; i++) {
+        bool echo = i >= kInTransfers;
+        d->in_buffers_.emplace_back(echo ? kEchoTransferSize : kInTransferSize);
+        libusb_transfer *t = libusb_alloc_transfer(0);
+        if (!t) throw Error("libusb_alloc_transfer failed");
+        d->in_transfers_.push_back(t);
+        libusb_fill_bulk_transfer(t, d->handle_, echo ? d->echo_ep_ : kEpIn, d->in_buffers_.back().data(),
+                                  static_cast<int>(d->in_buffers_.back().size()), in_done, dev, 0);
+        check(libusb_submit_transfer(t), "submit IN transfer");
+        d->in_active_++;
+    }
+    d->thread_ = std::thread(&Device::event_loop, dev);
+    try {
+        d->sync_clock();
+        d->clock_running_ = true;
+        d->clock_thread_ = std::thread(&Device::clock_loop, dev);
+    } catch (const Error &) {
+        // firmware without GS_USB_BREQ_TRITON_CLOCK: device timestamps only
+    }
+    return d;
+}
+
+Device::~Device() {
+    {
+        std::lock_guard<std::mutex> lock(clock_mutex_);
+        clock_running_ = false;
+    }
+    clock_cv_.notify_all();
+    if (clock_thread_.joinable()) clock_thread_.join();
+    if (handle_) {
+        try {
+            for (uint32_t ch = 0; ch < channels_; ch++) stop(static_cast<uint8_t>(ch));
+            if (echo_ep_) {
+                auto disable = pack_u32({0, 0});
+                control_out(kBreqTritonEchoEp, 0, disable.data(), static_cast<uint16_t>(disable.size()));
+            }
+            if (restore_batch_) control_out(kBreqTritonUsbBatch, 0, usb_batch_, sizeof(usb_batch_));
+            if (packed_) {
+                auto packed = pack_u32({0});
+                control_out(kBreqTritonPacked, 0, packed.data(), static_cast<uint16_t>(packed.size()));
+            }
+        } catch (const Error &) {
+            // unplugged: nothing left to restore
+        }
+        running_ = false;
+        for (libusb_transfer *t : in_transfers_) libusb_cancel_transfer(t);
+    }
+    running_ = false;
+    if (thread_.joinable()) thread_.join();
+    else event_loop(); // open() failed half way: reap whatever was submitted
+    for (libusb_transfer *t : in_transfers_) libusb_free_transfer(t);
+    if (handle_) {
+        if (echo_itf_) libusb_release_interface(handle_, echo_itf_);
+        libusb_release_interface(handle_, kInterface);
+        libusb_close(handle_);
+    }
+    if (ctx_) libusb_exit(ctx_);
+}
+
+void Device::control_out(uint8_t request, uint16_t value, const void *data, uint16_t len) {
+    int rc = libusb_control_transfer(handle_, kReqOut, request, value, kInterface,
+                                     static_cast<unsigned char *>(const_cast<void *>(data)), len, kControlTimeoutMs);
+    check(rc, "control OUT");
+}
+
+size_t Device::control_in(uint8_t request, uint16_t value, void *data, uint16_t len) {
+    int rc = libusb_control_transfer(handle_, kReqIn, request, value, kInterface, static_cast<unsigned char *>(data),
+                                     len, kControlTimeoutMs);
+    check(rc, "control IN");
+    return static_cast<size_t>(rc);
+}
+
+BitTiming Device::compute_timing(uint8_t channel, uint32_t bitrate, double sample_point, bool data_phase) {
+    uint8_t raw[kBtConstExtSize] = {};
+    control_in(kBreqBtConst, channel, raw, kBtConstSize);
+    if (data_phase) {
+        if (!(u32_at(raw, 0) & kFeatureBtConstExt)) throw Error("channel has no CAN FD data phase");
+        control_in(kBreqBtConstExt, channel, raw, sizeof(raw));
+    }
+    return compute_bittiming(raw, bitrate, sample_point, data_phase);
+}
+
+void Device::set_bitrate(uint8_t channel, uint32_t bitrate, double sample_point) {
+    set_bittiming(channel, compute_timing(channel, bitrate, sample_point, false), false);
+}
+
+void Device::set_data_bitrate(uint8_t channel, uint32_t bitrate, double sample_point) {
+    set_bittiming(channel, compute_timing(channel, bitrate, sample_point, true), true);
+}
+
+void Device::set_bittiming(uint8_t channel, const BitTiming &bt, bool data_phase) {
+    auto raw = pack_u32({bt.prop_seg, bt.phase_seg1, bt.phase_seg2, bt.sjw, bt.brp});
+    control_out(data_phase ? kBreqDataBitTiming : kBreqBitTiming, channel, raw.data(), static_cast<uint16_t>(raw.size()));
+}
+
+void Device::start(uint8_t channel, uint32_t mode_flags) {
+    if (!packed_) {
+        mode_flags |= kModeHwTimestamp; // Frame::timestamp_us, as the packed format has it
+        // The device takes FD-sized host frames on the channel only if it really is an FD channel
+        uint8_t raw[kBtConstSize] = {};
+        control_in(kBreqBtConst, channel, raw, sizeof(raw));
+        bool fd = (mode_flags & kModeFd) && (u32_at(raw, 0) & kFeatureFd);
+        uint32_t bit = 1u << (channel & 31);
+        std::lock_guard<std::mutex> lock(tx_mutex_);
+        fd_started_ = fd ? fd_started_ | bit : fd_started_ & ~bit;
+    }
+    auto raw = pack_u32({kModeStart, mode_flags});
+    control_out(kBreqMode, channel, raw.data(), static_cast<uint16_t>(raw.size()));
+}
+
+void Device::stop(uint8_t channel) {
+    auto raw = pack_u32({kModeReset, 0});
+    control_out(kBreqMode, channel, raw.data(), static_cast<uint16_t>(raw.size()));
+    if (!packed_) fail_echoes(channel); // the device drops their echoes on reset
+}
+
+uint32_t Device::send(const Frame *frames, size_t count) {
+    auto *req = new OutRequest{&out_active_, {}};
+    uint32_t batch;
+    {
+        std::lock_guard<std::mutex> lock(tx_mutex_);
+        batch = next_batch_++;
+        if (!packed_) {
+            count = std::min<size_t>(count, 0xFFFF);
+            for (size_t i = 0; i < count; i++) {
+                uint32_t echo_id = next_echo_++ & kEchoIdMask;
+                echo_ids_[echo_id] = {batch, frames[i].channel};
+                append_host_frame(req->buf, echo_id, frames[i], fd_started_ >> (frames[i].channel & 31) & 1);
+            }
+            if (count) echo_batches_[batch].left = static_cast<uint16_t>(count);
+        }
+    }
+    if (packed_) {
+        append_tx_block(req->buf, batch, frames, count);
+    } else if (req->buf.empty()) {
+        delete req; // nothing for the device to echo: acked right here
+        if (on_ack_) {
+            TxAck ack;
+            ack.batch_id = batch;
+            on_ack_(ack);
+        }
+        return batch;
+    }
+    libusb_transfer *t = libusb_alloc_transfer(0);
+    if (!t) {
+        delete req;
+        forget_batch(batch);
+        throw Error("libusb_alloc_transfer failed");
+    }
+    libusb_fill_bulk_transfer(t, handle_, kEpOut, req->buf.data(), static_cast<int>(req->buf.size()), out_done, req, 0);
+    t->flags |= LIBUSB_TRANSFER_ADD_ZERO_PACKET; // the device ends a transfer on a short packet only
+    out_active_++;
+    int rc = libusb_submit_transfer(t);
+    if (rc < 0) {
+        out_active_--;
+        libusb_free_transfer(t);
+        delete req;
+        forget_batch(batch);
+        check(rc, "submit OUT transfer");
+    }
+    return batch;
+}
+
+void Device::forget_batch(uint32_t batch) {
+    std::lock_guard<std::mutex> lock(tx_mutex_);
+    if (!echo_batches_.erase(batch)) return;
+    for (auto it = echo_ids_.begin(); it != echo_ids_.end();) {
+        it = it->second.batch == batch ? echo_ids_.erase(it) : std::next(it);
+    }
+}
+
+void Device::echo_done(uint32_t echo_id, const Frame &echo, bool failed) {
+    TxAck ack;
+    {
+        std::lock_guard<std::mutex> lock(tx_mutex_);
+        auto id = echo_ids_.find(echo_id);
+        if (id == echo_ids_.end()) return; // a frame stop() failed already, or another host's
+        auto b = echo_batches_.find(id->second.batch);
+        echo_ids_.erase(id);
+        if (b == echo_batches_.end()) return;
+        (failed ? b->second.failed : b->second.sent)++;
+        if (--b->second.left) return;
+        ack.batch_id = b->first;
+        ack.sent = b->second.sent;
+        ack.failed = b->second.failed;
+        ack.timestamp_us = echo.timestamp_us;
+        echo_batches_.erase(b);
+    }
+    if (!on_ack_) return;
+    ack.host_time_ns = clock_.to_host_ns(ack.timestamp_us);
+    on_ack_(ack);
+}
+
+void Device::fail_echoes(uint8_t channel) {
+    std::vector<TxAck> acks;
+    {
+        std::lock_guard<std::mutex> lock(tx_mutex_);
+        for (auto id = echo_ids_.begin(); id != echo_ids_.end();) {
+            if (id->second.channel != channel) {
+                ++id;
+                continue;
+            }
+            auto b = echo_batches_.find(id->second.batch);
+            if (b != echo_batches_.end()) {
+                b->second.failed++;
+                if (--b->second.left == 0) {
+                    TxAck ack;
+                    ack.batch_id = b->first;
+                    ack.sent = b->second.sent;
+                    ack.failed = b->second.failed;
+                    acks.push_back(ack);
+                    echo_batches_.erase(b);
+                }
+            }
+            id = echo_ids_.erase(id);
+        }
+    }
+    if (on_ack_) {
+        for (const TxAck &ack : acks) on_ack_(ack);
+    }
+}
+
+void Device::sync_clock(int exchanges) {
+    int64_t best_before = 0, best_after = 0;
+    uint64_t best_device = 0;
+    for (int i = 0; i < exchanges; i++) {
+        uint8_t raw[8];
+        int64_t before = monotonic_ns();
+        control_in(kBreqTritonClock, 0, raw, sizeof(raw));
+        int64_t after = monotonic_ns();
+        if (i == 0 || after - before < best_after - best_before) {
+            best_before = before;
+            best_after = after;
+            best_device = u32_at(raw, 0) | static_cast<uint64_t>(u32_at(raw, 1)) << 32;
+        }
+    }
+    clock_.add(best_before, best_after, best_device);
+}
+
+void Device::clock_loop() {
+    std::unique_lock<std::mutex> lock(clock_mutex_);
+    while (!clock_cv_.wait_for(lock, kClockSyncPeriod, [this] { return !clock_running_; })) {
+        lock.unlock();
+        try {
+            sync_clock();
+        } catch (const Error &) {
+            return; // unplugged: the next host call reports it
+        }
+        lock.lock();
+    }
+}
+
+void Device::event_loop() {
+    while (running_ || in_active_ > 0 || out_active_ > 0) {
+        timeval tv{0, 100000};
+        libusb_handle_events_timeout_completed(ctx_, &tv, nullptr);
+    }
+}
+
+void Device::in_done(libusb_transfer *t) {
+    auto *d = static_cast<Device *>(t->user_data);
+    if (t->status == LIBUSB_TRANSFER_COMPLETED) {
+        d->rx_bytes_ += static_cast<uint64_t>(t->actual_length);
+        if (d->packed_) {
+            StreamDecoder &decoder = t->endpoint == kEpIn ? d->decoder_ : d->echo_decoder_;
+            decoder.feed(t->buffer, static_cast<size_t>(t->actual_length));
+        } else {
+            HostFrameDecoder &decoder = t->endpoint == kEpIn ? d->host_decoder_ : d->echo_host_decoder_;
+            decoder.feed(t->buffer, static_cast<size_t>(t->actual_length), true); // start() asks for timestamps
+        }
+    }
+    bool retry = t->status == LIBUSB_TRANSFER_COMPLETED || t->status == LIBUSB_TRANSFER_TIMED_OUT;
+    if (d->running_ && retry && libusb_submit_transfer(t) == 0) return;
+    d->in_active_--;
+}
+
+void Device::out_done(libusb_transfer *t) {
+    auto *req = static_cast<OutRequest *>(t->user_data);
+    (*req->active)--;
+    delete req;
+    libusb_free_transfer(t);
+}
+
+} // namespace tritoncan
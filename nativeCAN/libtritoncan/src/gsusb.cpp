@@ -0,0 +1,89 @@
+#include "tritoncan/gsusb.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace tritoncan {
+
+namespace {
+
+uint32_t get_u32(const uint8_t *p) { return static_cast<uint32_t>(p[0] | p[1] << 8 | p[2] << 16) | static_cast<uint32_t>(p[3]) << 24; }
+void put_u32(std::vector<uint8_t> &out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+
+// can_fd_dlc2len() in Linux
+uint8_t dlc_to_len(uint8_t dlc, bool fd) {
+    static const uint8_t len[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+    return fd ? len[dlc & 0xF] : std::min<uint8_t>(dlc, 8);
+}
+
+uint8_t len_to_dlc(uint8_t len) {
+    uint8_t dlc = 0;
+    while (dlc < 15 && dlc_to_len(dlc, true) < len) dlc++;
+    return dlc;
+}
+
+} // namespace
+
+void HostFrameDecoder::reset() {
+    carry_.clear();
+    have_ts_ = false;
+    epoch_ = 0;
+}
+
+bool HostFrameDecoder::feed(const uint8_t *data, size_t len, bool timestamps) {
+    carry_.insert(carry_.end(), data, data + len);
+    size_t pos = 0;
+    while (carry_.size() - pos >= kHostFrameHeaderSize) {
+        const uint8_t *p = carry_.data() + pos;
+        uint8_t flags = p[10];
+        size_t payload = (flags & kFlagFd) ? kMaxPayload : 8;
+        size_t size = kHostFrameHeaderSize + payload + (timestamps ? 4 : 0);
+        if (carry_.size() - pos < size) break; // rest of the frame is in the next transfer
+        if (p[9] > 0xF) { // channel out of range: lost framing, the sizes can no longer be trusted
+            errors_++;
+            carry_.clear();
+            return false;
+        }
+        Frame f;
+        f.can_id = get_u32(p + 4);
+        f.channel = p[9];
+        f.flags = flags & (kFlagOverflow | kFlagFd | kFlagBrs | kFlagEsi);
+        f.len = dlc_to_len(p[8], flags & kFlagFd);
+        std::memcpy(f.data.data(), p + kHostFrameHeaderSize, f.len);
+        if (timestamps) {
+            // The device clock is 32-bit µs and wraps every ~71 minutes
+            uint32_t ts = get_u32(p + kHostFrameHeaderSize + payload);
+            if (have_ts_ && ts < last_ts_ && last_ts_ - ts > 0x80000000u) epoch_ += 1ull << 32;
+            last_ts_ = ts;
+            have_ts_ = true;
+            f.timestamp_us = epoch_ | ts;
+        }
+        uint32_t echo_id = get_u32(p);
+        if (echo_id != kNoEchoId) {
+            if (on_echo) on_echo(echo_id, f, (flags & kFlagTxFailed) != 0);
+        } else if (on_frame) {
+            on_frame(f);
+        }
+        frames_++;
+        pos += size;
+    }
+    carry_.erase(carry_.begin(), carry_.begin() + static_cast<std::ptrdiff_t>(pos));
+    return true;
+}
+
+void append_host_frame(std::vector<uint8_t> &out, uint32_t echo_id, const Frame &f, bool fd_channel) {
+    bool fd = fd_channel && (f.flags & kFlagFd);
+    uint8_t len = std::min<uint8_t>(f.len, fd ? kMaxPayload : 8);
+    put_u32(out, echo_id);
+    put_u32(out, f.can_id);
+    out.push_back(fd ? len_to_dlc(len) : len);
+    out.push_back(f.channel);
+    out.push_back(fd ? f.flags & (kFlagFd | kFlagBrs) : 0);
+    out.push_back(0);
+    out.insert(out.end(), f.data.begin(), f.data.begin() + len);
+    out.insert(out.end(), (fd_channel ? kMaxPayload : 8) - len, 0);
+}
+
+} // namespace tritoncan
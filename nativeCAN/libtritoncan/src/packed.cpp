@@ -0,0 +1,117 @@
+#include "tritoncan/packed.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace tritoncan {
+
+namespace {
+
+// The device is little-endian (ESP32-S3); decode byte by byte so the host's byte order does not matter
+uint16_t get_u16(const uint8_t *p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+uint32_t get_u32(const uint8_t *p) { return static_cast<uint32_t>(p[0] | p[1] << 8 | p[2] << 16) | static_cast<uint32_t>(p[3]) << 24; }
+void put_u16(std::vector<uint8_t> &out, uint16_t v) {
+    out.push_back(static_cast<uint8_t>(v));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+}
+void put_u32(std::vector<uint8_t> &out, uint32_t v) {
+    put_u16(out, static_cast<uint16_t>(v));
+    put_u16(out, static_cast<uint16_t>(v >> 16));
+}
+
+} // namespace
+
+void StreamDecoder::reset() {
+    carry_.clear();
+    have_ts_ = false;
+    epoch_ = 0;
+}
+
+// The device clock is 32-bit µs and wraps every ~71 minutes
+uint64_t StreamDecoder::extend(uint32_t ts) {
+    if (have_ts_ && ts < last_ts_ && last_ts_ - ts > 0x80000000u) epoch_ += 1ull << 32;
+    last_ts_ = ts;
+    have_ts_ = true;
+    return epoch_ | ts;
+}
+
+bool StreamDecoder::feed(const uint8_t *data, size_t len) {
+    carry_.insert(carry_.end(), data, data + len);
+    size_t pos = 0;
+    bool ok = true;
+    while (carry_.size() - pos >= kBlockHeaderSize) {
+        const uint8_t *hdr = carry_.data() + pos;
+        uint16_t length = get_u16(hdr + 2);
+        if (get_u16(hdr) != kPackedMagic || length < kBlockHeaderSize) {
+            ok = false;
+            break;
+        }
+        if (carry_.size() - pos < length) break; // rest of the block is in the next transfer
+        if (!decode_block(hdr, length)) {
+            ok = false;
+            break;
+        }
+        pos += length;
+    }
+    if (!ok) {
+        errors_++;
+        carry_.clear();
+        return false;
+    }
+    carry_.erase(carry_.begin(), carry_.begin() + static_cast<std::ptrdiff_t>(pos));
+    return true;
+}
+
+bool StreamDecoder::decode_block(const uint8_t *block, size_t len) {
+    uint64_t base = extend(get_u32(block + 4));
+    size_t pos = kBlockHeaderSize;
+    while (pos < len) {
+        if (len - pos < kRecordHeaderSize) return false;
+        const uint8_t *rec = block + pos;
+        uint8_t payload = rec[0];
+        if (payload > kMaxPayload || len - pos - kRecordHeaderSize < payload) return false;
+        auto type = static_cast<RecordType>(rec[2] >> 4);
+        uint64_t ts = base + static_cast<int16_t>(get_u16(rec + 3));
+        uint32_t can_id = get_u32(rec + 5);
+        const uint8_t *body = rec + kRecordHeaderSize;
+        if (type == RecordType::Frame) {
+            Frame f;
+            f.can_id = can_id;
+            f.channel = rec[2] & 0xF;
+            f.flags = rec[1];
+            f.len = payload;
+            std::memcpy(f.data.data(), body, payload);
+            f.timestamp_us = ts;
+            if (on_frame) on_frame(f);
+        } else if (type == RecordType::TxAck && payload >= 4) {
+            TxAck a;
+            a.batch_id = can_id;
+            a.sent = get_u16(body);
+            a.failed = get_u16(body + 2);
+            a.timestamp_us = ts;
+            if (on_ack) on_ack(a);
+        } // unknown record types are skipped: newer firmware may add some
+        pos += kRecordHeaderSize + payload;
+    }
+    blocks_++;
+    return true;
+}
+
+void append_tx_block(std::vector<uint8_t> &out, uint32_t batch_id, const Frame *frames, size_t count) {
+    count = std::min<size_t>(count, 0xFFFF);
+    put_u16(out, kPackedMagic);
+    put_u16(out, static_cast<uint16_t>(count));
+    put_u32(out, batch_id);
+    for (size_t i = 0; i < count; i++) {
+        const Frame &f = frames[i];
+        uint8_t len = std::min<uint8_t>(f.len, (f.flags & kFlagFd) ? kMaxPayload : 8);
+        out.push_back(len);
+        out.push_back(f.flags & (kFlagFd | kFlagBrs));
+        out.push_back(f.channel & 0xF); // RecordType::Frame
+        put_u16(out, f.max_age_us); // delta_us carries the deadline on TX
+        put_u32(out, f.can_id);
+        out.insert(out.end(), f.data.begin(), f.data.begin() + len);
+    }
+}
+
+} // namespace tritoncan
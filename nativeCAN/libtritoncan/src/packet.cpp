@@ -0,0 +1,256 @@
+#include "tritoncan/packet.hpp"
+
+#include <arpa/inet.h>
+#include <linux/can.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/net_tstamp.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <system_error>
+
+#ifndef PACKET_IGNORE_OUTGOING
+#define PACKET_IGNORE_OUTGOING 23 // Linux 4.20
+#endif
+
+namespace tritoncan {
+
+namespace {
+
+// The ring's frame slots: V3 packs frames into blocks back to back and only checks the geometry
+constexpr unsigned kFrameSize = 2048;
+
+[[noreturn]] void fail(const std::string &what, int err = errno) {
+    throw std::system_error(err, std::generic_category(), what);
+}
+
+int64_t clock_ns(clockid_t clock) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+template <typename T>
+T *at(void *base, uint32_t offset) {
+    return reinterpret_cast<T *>(static_cast<uint8_t *>(base) + offset);
+}
+
+} // namespace
+
+PacketBusSet::PacketBusSet() : batch_(kBatch) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        int err = errno;
+        if (epoll_fd_ >= 0) close(epoll_fd_);
+        if (wake_fd_ >= 0) close(wake_fd_);
+        fail("epoll/eventfd", err);
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u32 = UINT32_MAX;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev) < 0) {
+        int err = errno;
+        close(epoll_fd_);
+        close(wake_fd_);
+        fail("epoll_ctl", err);
+    }
+}
+
+PacketBusSet::~PacketBusSet() {
+    stop();
+    for (auto &bus : buses_) {
+        munmap(bus->ring, bus->ring_size);
+        close(bus->fd);
+    }
+    close(epoll_fd_);
+    close(wake_fd_);
+}
+
+uint8_t PacketBusSet::add(const std::string &interface, const PacketOptions &options) {
+    if (running_) throw std::logic_error("PacketBusSet::add() while the thread runs");
+    if (buses_.size() > UINT8_MAX) throw std::length_error("PacketBusSet: at most 256 buses");
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    if (options.block_size < kFrameSize || options.block_size % page || options.blocks == 0)
+        throw std::invalid_argument("PacketBusSet: block_size must be a multiple of the page size, blocks > 0");
+    const auto index = static_cast<uint8_t>(buses_.size());
+    auto bus = std::make_unique<Bus>();
+    bus->interface = interface;
+    bus->block_size = options.block_size;
+    bus->blocks = options.blocks;
+    bus->hardware = options.timestamps == Timestamps::Hardware;
+
+    // Protocol 0: nothing is queued until the ring is in place and bind() names ETH_P_ALL
+    bus->fd = socket(AF_PACKET, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (bus->fd < 0) fail("socket(AF_PACKET)");
+    try {
+        ifreq ifr{};
+        std::strncpy(ifr.ifr_name, interface.c_str(), IFNAMSIZ - 1);
+        if (ioctl(bus->fd, SIOCGIFHWADDR, &ifr) < 0) fail(interface);
+        if (ifr.ifr_hwaddr.sa_family != ARPHRD_CAN) fail(interface + ": not a CAN interface", ENODEV);
+        const int ifindex = static_cast<int>(if_nametoindex(interface.c_str()));
+        if (ifindex == 0) fail(interface);
+
+        int version = TPACKET_V3;
+        if (setsockopt(bus->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+            fail(interface + ": TPACKET_V3");
+        if (bus->hardware) {
+            int ts = SOF_TIMESTAMPING_RAW_HARDWARE;
+            if (setsockopt(bus->fd, SOL_PACKET, PACKET_TIMESTAMP, &ts, sizeof(ts)) < 0)
+                fail(interface + ": PACKET_TIMESTAMP");
+        }
+        // Best effort: before 4.20 the outgoing copies reach the ring and are skipped in drain()
+        int one = 1;
+        setsockopt(bus->fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &one, sizeof(one));
+
+        tpacket_req3 req{};
+        req.tp_block_size = static_cast<unsigned>(options.block_size);
+        req.tp_block_nr = options.blocks;
+        req.tp_frame_size = kFrameSize;
+        req.tp_frame_nr = static_cast<unsigned>(options.block_size / kFrameSize) * options.blocks;
+        req.tp_retire_blk_tov = options.retire_ms;
+        if (setsockopt(bus->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) fail(interface + ": PACKET_RX_RING");
+        bus->ring_size = options.block_size * options.blocks;
+        void *ring = mmap(nullptr, bus->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, bus->fd, 0);
+        if (ring == MAP_FAILED) fail(interface + ": mmap ring");
+        bus->ring = static_cast<uint8_t *>(ring);
+
+        sockaddr_ll addr{};
+        addr.sll_family = AF_PACKET;
+        addr.sll_protocol = htons(ETH_P_ALL);
+        addr.sll_ifindex = ifindex;
+        if (bind(bus->fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) fail(interface + ": bind");
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u32 = index;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, bus->fd, &ev) < 0) fail(interface + ": epoll_ctl");
+    } catch (...) {
+        if (bus->ring) munmap(bus->ring, bus->ring_size);
+        close(bus->fd);
+        throw;
+    }
+    buses_.push_back(std::move(bus));
+    return index;
+}
+
+void PacketBusSet::into(FrameRing &ring) {
+    on_frames([&ring](uint8_t, const Frame *frames, size_t count) { ring.push(frames, count); });
+}
+
+void PacketBusSet::dispatch(uint8_t index, size_t count) {
+    if (count && on_frames_) on_frames_(index, batch_.data(), count);
+}
+
+size_t PacketBusSet::drain(uint8_t index) {
+    Bus &bus = *buses_[index];
+    size_t total = 0, count = 0;
+    // Every block handed over, oldest first; each goes back to the kernel once its frames are copied
+    for (;;) {
+        auto *block = reinterpret_cast<tpacket_block_desc *>(bus.ring + static_cast<size_t>(bus.next) * bus.block_size);
+        tpacket_hdr_v1 &h1 = block->hdr.bh1;
+        const uint32_t status = __atomic_load_n(&h1.block_status, __ATOMIC_ACQUIRE);
+        if (!(status & TP_STATUS_USER)) break;
+
+        bool overflow = false;
+        if (status & TP_STATUS_LOSING) {
+            // Reading the counters resets them, which clears TP_STATUS_LOSING on later blocks
+            tpacket_stats_v3 st{};
+            socklen_t len = sizeof(st);
+            if (getsockopt(bus.fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) == 0 && st.tp_drops) {
+                bus.stats.rx_dropped.fetch_add(st.tp_drops, std::memory_order_relaxed);
+                overflow = true;
+            }
+        }
+        // The ring's software stamps are CLOCK_REALTIME, as SO_TIMESTAMPING's
+        const int64_t to_monotonic = clock_ns(CLOCK_MONOTONIC) - clock_ns(CLOCK_REALTIME);
+        auto *pkt = at<tpacket3_hdr>(block, h1.offset_to_first_pkt);
+        for (uint32_t i = 0; i < h1.num_pkts; i++, pkt = at<tpacket3_hdr>(pkt, pkt->tp_next_offset)) {
+            const auto *sll = at<sockaddr_ll>(pkt, TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+            const uint32_t len = pkt->tp_snaplen;
+            if (sll->sll_pkttype == PACKET_OUTGOING || (len != CAN_MTU && len != CANFD_MTU)) continue;
+            const auto &cf = *at<canfd_frame>(pkt, pkt->tp_mac);
+            Frame &f = batch_[count++];
+            f.can_id = cf.can_id;
+            f.channel = index;
+            f.flags = overflow ? kFlagOverflow : 0;
+            overflow = false;
+            if (len == CANFD_MTU) {
+                f.flags |= kFlagFd;
+                if (cf.flags & CANFD_BRS) f.flags |= kFlagBrs;
+                if (cf.flags & CANFD_ESI) f.flags |= kFlagEsi;
+            }
+            f.len = std::min<uint8_t>(cf.len, (f.flags & kFlagFd) ? CANFD_MAX_DLEN : CAN_MAX_DLEN);
+            std::memcpy(f.data.data(), cf.data, f.len);
+            const int64_t ns = static_cast<int64_t>(pkt->tp_sec) * 1000000000 + pkt->tp_nsec;
+            if (bus.hardware && (pkt->tp_status & TP_STATUS_TS_RAW_HARDWARE)) {
+                f.timestamp_us = static_cast<uint64_t>(ns / 1000);
+                f.host_time_ns = 0;
+            } else {
+                f.timestamp_us = 0;
+                f.host_time_ns = ns + to_monotonic;
+            }
+            if (f.can_id & kCanErrFlag) bus.stats.error_frames.fetch_add(1, std::memory_order_relaxed);
+            if (count == batch_.size()) {
+                dispatch(index, count);
+                total += count;
+                count = 0;
+            }
+        }
+        __atomic_store_n(&h1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        bus.stats.rx_batches.fetch_add(1, std::memory_order_relaxed);
+        bus.next = (bus.next + 1) % bus.blocks;
+    }
+    dispatch(index, count);
+    total += count;
+    bus.stats.rx_frames.fetch_add(total, std::memory_order_relaxed);
+    return total;
+}
+
+size_t PacketBusSet::poll(int timeout_ms) {
+    epoll_event events[16];
+    int n = epoll_wait(epoll_fd_, events, 16, timeout_ms);
+    if (n < 0) {
+        if (errno == EINTR) return 0;
+        fail("epoll_wait");
+    }
+    size_t total = 0;
+    for (int i = 0; i < n; i++) {
+        const uint32_t index = events[i].data.u32;
+        if (index == UINT32_MAX) {
+            uint64_t value;
+            [[maybe_unused]] ssize_t r = read(wake_fd_, &value, sizeof(value));
+            continue;
+        }
+        total += drain(static_cast<uint8_t>(index));
+    }
+    return total;
+}
+
+void PacketBusSet::start() {
+    if (running_.exchange(true)) return;
+    thread_ = std::thread([this] {
+        while (running_.load(std::memory_order_relaxed)) poll(-1);
+    });
+}
+
+void PacketBusSet::stop() {
+    if (!running_.exchange(false)) return;
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t r = write(wake_fd_, &one, sizeof(one));
+    if (thread_.joinable()) thread_.join();
+}
+
+} // namespace tritoncan
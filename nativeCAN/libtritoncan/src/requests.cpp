@@ -0,0 +1,142 @@
+#include "tritoncan/requests.hpp"
+
+#include <time.h>
+
+#include <algorithm>
+#include <climits>
+
+namespace tritoncan {
+
+int64_t Requests::now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+Requests::Table &Requests::table(uint32_t mask) {
+    for (Table &t : tables_)
+        if (t.mask == mask) return t;
+    tables_.push_back({mask, {}});
+    std::stable_sort(tables_.begin(), tables_.end(), [](const Table &a, const Table &b) {
+        return __builtin_popcount(a.mask) > __builtin_popcount(b.mask);
+    });
+    for (Table &t : tables_)
+        if (t.mask == mask) return t;
+    return tables_.back(); // not reached
+}
+
+Requests::Id Requests::add(uint8_t bus, Expect expect, int64_t deadline_ns, Callback done) {
+    const uint32_t mask = (expect.mask & 0x1FFFFFFF) | kCanEffFlag;
+    std::list<Id> &waiting = table(mask).waiting[key(bus, expect.id & mask)];
+    const Id id = next_id_++;
+    waiting.push_back(id);
+    pending_.emplace(id, Pending{bus, std::move(expect), deadline_ns, std::move(done), std::prev(waiting.end())});
+    deadlines_.emplace(deadline_ns, id);
+    return id;
+}
+
+Requests::Id Requests::submit(uint8_t bus, const Frame &frame, Expect expect, int64_t deadline_ns, Callback done) {
+    // Registered before the send, so a reply read in the same poll round still finds it
+    const Id id = add(bus, std::move(expect), deadline_ns, std::move(done));
+    if (send_(bus, &frame, 1) != 1) {
+        finish(id, ReplyStatus::SendFailed, nullptr);
+        run();
+    }
+    return id;
+}
+
+Requests::Id Requests::expect(uint8_t bus, Expect expect, int64_t deadline_ns, Callback done) {
+    return add(bus, std::move(expect), deadline_ns, std::move(done));
+}
+
+bool Requests::cancel(Id id) {
+    if (!pending_.count(id)) return false;
+    finish(id, ReplyStatus::Cancelled, nullptr);
+    run();
+    return true;
+}
+
+void Requests::finish(Id id, ReplyStatus status, const Frame *frame) {
+    auto it = pending_.find(id);
+    Pending &p = it->second;
+    const uint32_t mask = (p.expect.mask & 0x1FFFFFFF) | kCanEffFlag;
+    Table &t = table(mask);
+    auto list = t.waiting.find(key(p.bus, p.expect.id & mask));
+    list->second.erase(p.position);
+    if (list->second.empty()) t.waiting.erase(list);
+    Reply reply;
+    reply.status = status;
+    if (frame) reply.frame = *frame;
+    ready_.emplace_back(std::move(p.done), reply);
+    pending_.erase(it);
+    completed_++;
+    if (status == ReplyStatus::Timeout) timeouts_++;
+}
+
+void Requests::run() {
+    // A callback that completes another request (cancel, a send that fails) lands in the outer loop
+    if (running_) return;
+    running_ = true;
+    for (size_t i = 0; i < ready_.size(); i++) {
+        auto item = std::move(ready_[i]);
+        if (item.first) item.first(item.second);
+    }
+    ready_.clear();
+    running_ = false;
+}
+
+size_t Requests::feed(uint8_t bus, const Frame *frames, size_t count) {
+    size_t answered = 0;
+    for (size_t i = 0; i < count && !pending_.empty(); i++) {
+        const Frame &f = frames[i];
+        if (f.can_id & (kCanErrFlag | kCanRtrFlag)) continue;
+        for (Table &t : tables_) {
+            auto list = t.waiting.find(key(bus, f.can_id & t.mask));
+            if (list == t.waiting.end()) continue;
+            Id hit = 0;
+            for (Id id : list->second) {
+                const Expect &e = pending_.at(id).expect;
+                if (!e.match || e.match(f)) {
+                    hit = id;
+                    break;
+                }
+            }
+            if (hit) {
+                finish(hit, ReplyStatus::Ok, &f);
+                answered++;
+                break; // one reply answers one request
+            }
+        }
+    }
+    run();
+    return answered;
+}
+
+size_t Requests::expire(int64_t now_ns) {
+    size_t expired = 0;
+    while (!deadlines_.empty() && deadlines_.top().first <= now_ns) {
+        const Id id = deadlines_.top().second;
+        deadlines_.pop();
+        if (!pending_.count(id)) continue;
+        finish(id, ReplyStatus::Timeout, nullptr);
+        expired++;
+    }
+    // Completed requests leave their heap entries behind; rebuild before those outnumber the live ones
+    if (deadlines_.size() > 64 && deadlines_.size() > 4 * pending_.size()) {
+        decltype(deadlines_) live;
+        for (const auto &p : pending_) live.emplace(p.second.deadline_ns, p.first);
+        deadlines_.swap(live);
+    }
+    run();
+    return expired;
+}
+
+int Requests::timeout_ms(int64_t now_ns, int limit_ms) const {
+    if (pending_.empty()) return limit_ms;
+    // The earliest heap entry may belong to a completed request: waking early for it is harmless
+    const int64_t wait_ns = std::max<int64_t>(0, deadlines_.top().first - now_ns);
+    const int64_t ms = std::min<int64_t>((wait_ns + 999999) / 1000000, INT_MAX);
+    return limit_ms >= 0 ? static_cast<int>(std::min<int64_t>(ms, limit_ms)) : static_cast<int>(ms);
+}
+
+} // namespace tritoncan
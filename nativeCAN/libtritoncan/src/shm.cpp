@@ -0,0 +1,336 @@
+#include "tritoncan/shm.hpp"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <system_error>
+
+namespace tritoncan {
+
+namespace {
+
+[[noreturn]] void fail(const std::string &what, int err = errno) {
+    throw std::system_error(err, std::generic_category(), what);
+}
+
+bool power_of_two(uint32_t n) {
+    return n && !(n & (n - 1));
+}
+
+// Shared futexes (no FUTEX_PRIVATE_FLAG): the waiters are in other processes
+void futex_wait(std::atomic<uint32_t> &word, uint32_t expected, int timeout_ms) {
+    timespec ts{timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, expected, timeout_ms < 0 ? nullptr : &ts,
+            nullptr, 0);
+}
+
+void futex_wake(std::atomic<uint32_t> &word, int count) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, count, nullptr, nullptr, 0);
+}
+
+// Open file description locks (F_OFD_*), as the Python client takes them: they belong to the
+// shm_open() of each ShmClient, so two clients in one process hold separate slots, and closing one
+// leaves the other's lock alone. Classic record locks are per process and dropped on any close().
+bool try_lock(int fd, off_t start, off_t len) {
+    struct flock fl {};
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = start;
+    fl.l_len = len;
+    return fcntl(fd, F_OFD_SETLK, &fl) == 0;
+}
+
+// Whether another open of the segment holds a lock on the range
+bool locked(int fd, off_t start, off_t len) {
+    struct flock fl {};
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = start;
+    fl.l_len = len;
+    return fcntl(fd, F_OFD_GETLK, &fl) == 0 && fl.l_type != F_UNLCK;
+}
+
+void to_shm(ShmFrame &s, const Frame &f) {
+    s.host_time_ns = f.host_time_ns;
+    s.timestamp_us = f.timestamp_us;
+    s.can_id = f.can_id;
+    s.len = std::min<uint8_t>(f.len, kMaxPayload);
+    s.flags = f.flags;
+    std::memcpy(s.data, f.data.data(), s.len);
+}
+
+void from_shm(Frame &f, const ShmFrame &s, uint8_t channel) {
+    f.can_id = s.can_id;
+    f.channel = channel;
+    f.flags = s.flags;
+    f.len = std::min<uint8_t>(s.len, kMaxPayload);
+    std::memcpy(f.data.data(), s.data, f.len);
+    f.timestamp_us = s.timestamp_us;
+    f.host_time_ns = s.host_time_ns;
+}
+
+} // namespace
+
+std::string shm_path(const std::string &interface) {
+    return "/tritoncan." + interface;
+}
+
+ShmPublisher::ShmPublisher(const std::string &interface, uint32_t slots, uint32_t max_clients, uint32_t tx_slots,
+                           unsigned mode)
+    : name_(shm_path(interface)) {
+    if (interface.empty() || interface.size() >= sizeof(ShmHeader::interface) || interface.find('/') != std::string::npos)
+        fail("bad interface name " + interface, EINVAL);
+    if (!power_of_two(slots) || slots < 64 || !power_of_two(tx_slots) || !max_clients || max_clients > 256)
+        fail(name_ + ": slots and tx_slots must be powers of two, max_clients 1..256", EINVAL);
+
+    // A segment left by a daemon that crashed is replaced; one whose daemon still holds its lock is not
+    int old = shm_open(name_.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (old >= 0) {
+        const bool busy = locked(old, 0, sizeof(ShmHeader));
+        close(old);
+        if (busy) fail(name_ + ": another tritoncand serves " + interface, EBUSY);
+        shm_unlink(name_.c_str());
+    }
+    fd_ = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+    if (fd_ < 0) fail("shm_open " + name_);
+    try {
+        fchmod(fd_, mode); // past the umask
+        if (!try_lock(fd_, 0, sizeof(ShmHeader))) fail(name_ + ": lock");
+        const uint64_t clients_offset = sizeof(ShmHeader);
+        const uint64_t rx_offset = clients_offset + uint64_t{max_clients} * sizeof(ShmClientSlot);
+        const uint64_t tx_offset = rx_offset + uint64_t{slots} * sizeof(ShmFrame);
+        size_ = tx_offset + uint64_t{max_clients} * tx_slots * sizeof(ShmFrame);
+        if (ftruncate(fd_, static_cast<off_t>(size_)) < 0) fail(name_ + ": ftruncate");
+        void *p = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, 0);
+        if (p == MAP_FAILED) fail(name_ + ": mmap");
+        auto *base = static_cast<uint8_t *>(p);
+        header_ = reinterpret_cast<ShmHeader *>(base);
+        clients_ = reinterpret_cast<ShmClientSlot *>(base + clients_offset);
+        rx_ = reinterpret_cast<ShmFrame *>(base + rx_offset);
+        tx_ = reinterpret_cast<ShmFrame *>(base + tx_offset);
+        mask_ = slots - 1;
+        for (uint32_t i = 0; i < slots; i++) rx_[i].seq.store(kShmWriting, std::memory_order_relaxed);
+
+        header_->version = kShmVersion;
+        header_->slots = slots;
+        header_->slot_size = sizeof(ShmFrame);
+        header_->max_clients = max_clients;
+        header_->tx_slots = tx_slots;
+        header_->client_size = sizeof(ShmClientSlot);
+        header_->clients_offset = clients_offset;
+        header_->rx_offset = rx_offset;
+        header_->tx_offset = tx_offset;
+        std::memcpy(header_->interface, interface.data(), interface.size());
+        header_->daemon_pid.store(static_cast<uint32_t>(getpid()), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        header_->magic = kShmMagic; // clients check it last
+    } catch (...) {
+        if (header_) munmap(header_, size_);
+        close(fd_);
+        shm_unlink(name_.c_str());
+        throw;
+    }
+}
+
+ShmPublisher::~ShmPublisher() {
+    header_->daemon_pid.store(0, std::memory_order_seq_cst);
+    header_->rx_futex.fetch_add(1, std::memory_order_seq_cst);
+    futex_wake(header_->rx_futex, INT_MAX);
+    shm_unlink(name_.c_str());
+    munmap(header_, size_);
+    close(fd_);
+}
+
+void ShmPublisher::publish(const Frame *frames, size_t count) {
+    uint64_t seq = header_->write_seq.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++, seq++) {
+        ShmFrame &s = rx_[seq & mask_];
+        // Readers that see kShmWriting, or a seq other than the one they wanted, skip the slot
+        s.seq.store(kShmWriting, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        to_shm(s, frames[i]);
+        s.seq.store(seq, std::memory_order_release);
+    }
+    header_->write_seq.store(seq, std::memory_order_seq_cst);
+    header_->rx_frames.fetch_add(count, std::memory_order_relaxed);
+    header_->rx_futex.fetch_add(1, std::memory_order_seq_cst);
+    for (uint32_t i = 0; i < header_->max_clients; i++) {
+        if (clients_[i].waiting.load(std::memory_order_seq_cst)) {
+            futex_wake(header_->rx_futex, INT_MAX);
+            break;
+        }
+    }
+}
+
+size_t ShmPublisher::take_tx(uint32_t &client, Frame *out, size_t max) {
+    const uint32_t clients = header_->max_clients;
+    const uint64_t tmask = header_->tx_slots - 1;
+    for (uint32_t k = 0; k < clients; k++) {
+        const uint32_t i = (next_client_ + k) % clients;
+        ShmClientSlot &c = clients_[i];
+        if (!c.owner.load(std::memory_order_acquire)) continue;
+        const uint64_t tail = c.tx_tail.load(std::memory_order_relaxed);
+        const uint64_t head = c.tx_head.load(std::memory_order_acquire);
+        if (head == tail) continue;
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(head - tail, max));
+        const ShmFrame *ring = tx_ + uint64_t{i} * header_->tx_slots;
+        for (size_t j = 0; j < n; j++) from_shm(out[j], ring[(tail + j) & tmask], 0);
+        client = i;
+        next_client_ = (i + 1) % clients;
+        return n;
+    }
+    return 0;
+}
+
+void ShmPublisher::consume_tx(uint32_t client, size_t n) {
+    ShmClientSlot &c = clients_[client];
+    c.tx_tail.store(c.tx_tail.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    header_->tx_frames.fetch_add(n, std::memory_order_relaxed);
+}
+
+void ShmPublisher::wait_tx(uint32_t seen, int timeout_ms) {
+    header_->tx_sleeping.store(1, std::memory_order_seq_cst);
+    bool queued = false;
+    for (uint32_t i = 0; i < header_->max_clients && !queued; i++) {
+        const ShmClientSlot &c = clients_[i];
+        queued = c.owner.load(std::memory_order_seq_cst) &&
+                 c.tx_head.load(std::memory_order_seq_cst) != c.tx_tail.load(std::memory_order_relaxed);
+    }
+    if (!queued) futex_wait(header_->tx_futex, seen, timeout_ms);
+    header_->tx_sleeping.store(0, std::memory_order_relaxed);
+}
+
+void ShmPublisher::reap() {
+    for (uint32_t i = 0; i < header_->max_clients; i++) {
+        ShmClientSlot &c = clients_[i];
+        uint32_t owner = c.owner.load(std::memory_order_acquire);
+        if (!owner) continue;
+        const off_t at = static_cast<off_t>(header_->clients_offset + uint64_t{i} * sizeof(ShmClientSlot));
+        // The compare-exchange leaves a client that claimed the slot since the lock test alone
+        if (!locked(fd_, at, sizeof(ShmClientSlot))) c.owner.compare_exchange_strong(owner, 0);
+    }
+}
+
+ShmClient::ShmClient(const std::string &interface, const std::string &name) {
+    const std::string path = shm_path(interface);
+    fd_ = shm_open(path.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (fd_ < 0) fail(path + " (is tritoncand running for " + interface + "?)");
+    try {
+        struct stat st;
+        if (fstat(fd_, &st) < 0) fail(path + ": fstat");
+        if (static_cast<size_t>(st.st_size) < sizeof(ShmHeader)) fail(path + ": not a tritoncand segment", EPROTO);
+        if (!locked(fd_, 0, sizeof(ShmHeader))) fail(path + ": its tritoncand has exited", ECONNREFUSED);
+        size_ = static_cast<size_t>(st.st_size);
+        void *p = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (p == MAP_FAILED) fail(path + ": mmap");
+        auto *base = static_cast<uint8_t *>(p);
+        header_ = reinterpret_cast<ShmHeader *>(base);
+        if (header_->magic != kShmMagic || header_->version != kShmVersion || header_->slot_size != sizeof(ShmFrame) ||
+            header_->client_size != sizeof(ShmClientSlot))
+            fail(path + ": layout version mismatch with this library", EPROTO);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        rx_ = reinterpret_cast<ShmFrame *>(base + header_->rx_offset);
+        tx_ = reinterpret_cast<ShmFrame *>(base + header_->tx_offset);
+        mask_ = header_->slots - 1;
+
+        auto *clients = reinterpret_cast<ShmClientSlot *>(base + header_->clients_offset);
+        uint32_t i = 0;
+        for (; i < header_->max_clients; i++) {
+            const off_t at = static_cast<off_t>(header_->clients_offset + uint64_t{i} * sizeof(ShmClientSlot));
+            if (try_lock(fd_, at, sizeof(ShmClientSlot))) break;
+        }
+        if (i == header_->max_clients) fail(path + ": all client slots in use", EBUSY);
+        index_ = i;
+        slot_ = &clients[i];
+        tx_ += uint64_t{i} * header_->tx_slots;
+
+        cursor_ = header_->write_seq.load(std::memory_order_acquire); // from now on, not the backlog
+        slot_->cursor.store(cursor_, std::memory_order_relaxed);
+        slot_->lost.store(0, std::memory_order_relaxed);
+        slot_->tx_full.store(0, std::memory_order_relaxed);
+        slot_->waiting.store(0, std::memory_order_relaxed);
+        // Whatever a previous owner left queued is dropped
+        slot_->tx_head.store(slot_->tx_tail.load(std::memory_order_acquire), std::memory_order_relaxed);
+        std::memset(slot_->name, 0, sizeof(slot_->name));
+        std::memcpy(slot_->name, name.data(), std::min(name.size(), sizeof(slot_->name)));
+        slot_->owner.store(static_cast<uint32_t>(getpid()), std::memory_order_release);
+    } catch (...) {
+        if (header_) munmap(header_, size_);
+        close(fd_);
+        throw;
+    }
+}
+
+ShmClient::~ShmClient() {
+    slot_->owner.store(0, std::memory_order_release);
+    munmap(header_, size_);
+    close(fd_); // drops this client's slot lock, and only that one
+
+}
+
+uint64_t ShmClient::catch_up(uint64_t write) {
+    const uint64_t slots = header_->slots;
+    if (write - cursor_ > slots) {
+        // Lapped: resume a quarter ring behind the writer, out of its way
+        const uint64_t resume = write - (slots - slots / 4);
+        slot_->lost.fetch_add(resume - cursor_, std::memory_order_relaxed);
+        cursor_ = resume;
+    }
+    return cursor_;
+}
+
+size_t ShmClient::read(Frame *out, size_t max) {
+    const uint64_t write = header_->write_seq.load(std::memory_order_acquire);
+    uint64_t c = catch_up(write);
+    size_t n = 0;
+    uint64_t lost = 0;
+    for (; c != write && n < max; c++) {
+        const ShmFrame &s = rx_[c & mask_];
+        if (s.seq.load(std::memory_order_acquire) != c) {
+            lost++;
+            continue;
+        }
+        from_shm(out[n], s, 0);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) != c) lost++; // overwritten while copied
+        else n++;
+    }
+    cursor_ = c;
+    slot_->cursor.store(c, std::memory_order_relaxed);
+    if (lost) slot_->lost.fetch_add(lost, std::memory_order_relaxed);
+    return n;
+}
+
+bool ShmClient::wait(int timeout_ms) {
+    if (pending()) return true;
+    slot_->waiting.store(1, std::memory_order_seq_cst);
+    const uint32_t seen = header_->rx_futex.load(std::memory_order_seq_cst);
+    if (!pending() && daemon_alive()) futex_wait(header_->rx_futex, seen, timeout_ms);
+    slot_->waiting.store(0, std::memory_order_relaxed);
+    return pending() != 0;
+}
+
+size_t ShmClient::send(const Frame *frames, size_t count) {
+    const uint64_t slots = header_->tx_slots;
+    const uint64_t head = slot_->tx_head.load(std::memory_order_relaxed);
+    const uint64_t tail = slot_->tx_tail.load(std::memory_order_acquire);
+    const size_t n = static_cast<size_t>(std::min<uint64_t>(count, slots - (head - tail)));
+    for (size_t i = 0; i < n; i++) to_shm(tx_[(head + i) & (slots - 1)], frames[i]);
+    if (n < count) slot_->tx_full.fetch_add(1, std::memory_order_relaxed);
+    if (!n) return 0;
+    slot_->tx_head.store(head + n, std::memory_order_seq_cst);
+    header_->tx_futex.fetch_add(1, std::memory_order_seq_cst);
+    if (header_->tx_sleeping.load(std::memory_order_seq_cst)) futex_wake(header_->tx_futex, 1);
+    return n;
+}
+
+} // namespace tritoncan
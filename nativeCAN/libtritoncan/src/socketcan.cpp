@@ -0,0 +1,313 @@
+#include "tritoncan/socketcan.hpp"
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/net_tstamp.h>
+#include <net/if.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <system_error>
+
+namespace tritoncan {
+
+namespace {
+
+[[noreturn]] void fail(const std::string &what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+int64_t clock_ns(clockid_t clock) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+int64_t timespec_ns(const timespec &ts) {
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Control space for SCM_TIMESTAMPING (three timespecs: software, legacy, raw hardware) and SO_RXQ_OVFL
+constexpr size_t kCmsgSpace = CMSG_SPACE(3 * sizeof(timespec)) + CMSG_SPACE(sizeof(uint32_t));
+
+} // namespace
+
+struct SocketBus::RxBuffers {
+    mmsghdr hdrs[kBatch];
+    iovec iov[kBatch];
+    canfd_frame frames[kBatch];
+    alignas(cmsghdr) uint8_t control[kBatch][kCmsgSpace];
+};
+
+SocketBus::SocketBus(const std::string &interface, const BusOptions &options, uint8_t channel)
+    : interface_(interface), channel_(channel), fd_frames_(options.fd), rx_(new RxBuffers()) {
+    fd_ = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
+    if (fd_ < 0) fail("socket(PF_CAN)");
+    try {
+        int one = 1;
+        if (options.fd && setsockopt(fd_, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &one, sizeof(one)) < 0)
+            fail(interface + ": CAN_RAW_FD_FRAMES");
+        if (options.receive_own && setsockopt(fd_, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &one, sizeof(one)) < 0)
+            fail(interface + ": CAN_RAW_RECV_OWN_MSGS");
+        if (options.error_frames) {
+            can_err_mask_t mask = CAN_ERR_MASK;
+            if (setsockopt(fd_, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &mask, sizeof(mask)) < 0)
+                fail(interface + ": CAN_RAW_ERR_FILTER");
+        }
+        if (!options.filters.empty()) {
+            std::vector<can_filter> filters;
+            for (const auto &f : options.filters) filters.push_back({f.first, f.second});
+            if (setsockopt(fd_, SOL_CAN_RAW, CAN_RAW_FILTER, filters.data(),
+                           static_cast<socklen_t>(filters.size() * sizeof(can_filter))) < 0)
+                fail(interface + ": CAN_RAW_FILTER");
+        }
+        // Best effort: without CAP_NET_ADMIN the buffer stays at the rmem_max cap
+        setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &options.rcvbuf, sizeof(options.rcvbuf));
+        if (setsockopt(fd_, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) < 0) fail(interface + ": SO_RXQ_OVFL");
+        if (options.timestamps != Timestamps::None) {
+            int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+            if (options.timestamps == Timestamps::Hardware)
+                flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+            if (setsockopt(fd_, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0)
+                fail(interface + ": SO_TIMESTAMPING");
+        }
+
+        sockaddr_can addr{};
+        addr.can_family = AF_CAN;
+        addr.can_ifindex = static_cast<int>(if_nametoindex(interface.c_str()));
+        if (addr.can_ifindex == 0) fail(interface);
+        if (bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) fail(interface + ": bind");
+    } catch (...) {
+        close(fd_);
+        throw;
+    }
+
+    for (size_t i = 0; i < kBatch; i++) {
+        rx_->iov[i] = {&rx_->frames[i], sizeof(canfd_frame)};
+        msghdr &m = rx_->hdrs[i].msg_hdr;
+        m.msg_iov = &rx_->iov[i];
+        m.msg_iovlen = 1;
+    }
+}
+
+SocketBus::~SocketBus() {
+    if (fd_ >= 0) close(fd_);
+}
+
+void SocketBus::decode(const void *frame, size_t len, const msghdr &msg, int64_t to_monotonic, Frame &f) {
+    const auto &cf = *static_cast<const canfd_frame *>(frame);
+    f.can_id = cf.can_id;
+    f.channel = channel_;
+    f.flags = 0;
+    if (len == CANFD_MTU) {
+        f.flags |= kFlagFd;
+        if (cf.flags & CANFD_BRS) f.flags |= kFlagBrs;
+        if (cf.flags & CANFD_ESI) f.flags |= kFlagEsi;
+    }
+    f.len = std::min<uint8_t>(cf.len, (f.flags & kFlagFd) ? CANFD_MAX_DLEN : CAN_MAX_DLEN);
+    std::memcpy(f.data.data(), cf.data, f.len);
+    f.timestamp_us = 0;
+    f.host_time_ns = 0;
+    for (cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(const_cast<msghdr *>(&msg), c)) {
+        if (c->cmsg_level != SOL_SOCKET) continue;
+        if (c->cmsg_type == SO_TIMESTAMPING) {
+            timespec ts[3];
+            std::memcpy(ts, CMSG_DATA(c), sizeof(ts));
+            if (ts[0].tv_sec || ts[0].tv_nsec) f.host_time_ns = timespec_ns(ts[0]) + to_monotonic;
+            if (ts[2].tv_sec || ts[2].tv_nsec) f.timestamp_us = static_cast<uint64_t>(timespec_ns(ts[2]) / 1000);
+        } else if (c->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t drops;
+            std::memcpy(&drops, CMSG_DATA(c), sizeof(drops));
+            if (drops != last_drops_) {
+                stats_.rx_dropped.fetch_add(drops - last_drops_, std::memory_order_relaxed);
+                last_drops_ = drops;
+                f.flags |= kFlagOverflow;
+            }
+        }
+    }
+    if (f.can_id & kCanErrFlag) stats_.error_frames.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t SocketBus::receive(Frame *out, size_t max) {
+    size_t total = 0;
+    while (total < max) {
+        unsigned want = static_cast<unsigned>(std::min(max - total, kBatch));
+        for (unsigned i = 0; i < want; i++) {
+            // The kernel shrinks msg_controllen to what it wrote
+            rx_->hdrs[i].msg_hdr.msg_control = rx_->control[i];
+            rx_->hdrs[i].msg_hdr.msg_controllen = kCmsgSpace;
+        }
+        int n = recvmmsg(fd_, rx_->hdrs, want, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) break;
+            fail(interface_ + ": recvmmsg");
+        }
+        if (n == 0) break;
+        // One realtime -> monotonic offset per batch: the software stamps are CLOCK_REALTIME
+        const int64_t to_monotonic = clock_ns(CLOCK_MONOTONIC) - clock_ns(CLOCK_REALTIME);
+        for (int i = 0; i < n; i++)
+            decode(&rx_->frames[i], rx_->hdrs[i].msg_len, rx_->hdrs[i].msg_hdr, to_monotonic, out[total++]);
+        stats_.rx_frames.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+        stats_.rx_batches.fetch_add(1, std::memory_order_relaxed);
+        if (static_cast<unsigned>(n) < want) break; // drained
+    }
+    return total;
+}
+
+size_t SocketBus::send(const Frame *frames, size_t count) {
+    size_t sent = 0;
+    while (sent < count) {
+        mmsghdr hdrs[kBatch];
+        iovec iov[kBatch];
+        canfd_frame out[kBatch];
+        const size_t n = std::min(count - sent, kBatch);
+        for (size_t i = 0; i < n; i++) {
+            const Frame &f = frames[sent + i];
+            const bool fd = fd_frames_ && (f.flags & kFlagFd);
+            canfd_frame &cf = out[i];
+            std::memset(&cf, 0, sizeof(cf));
+            cf.can_id = f.can_id;
+            cf.len = std::min<uint8_t>(f.len, fd ? CANFD_MAX_DLEN : CAN_MAX_DLEN);
+            if (fd) cf.flags = ((f.flags & kFlagBrs) ? CANFD_BRS : 0) | CANFD_FDF;
+            std::memcpy(cf.data, f.data.data(), cf.len);
+            iov[i] = {&cf, fd ? CANFD_MTU : CAN_MTU};
+            hdrs[i] = {};
+            hdrs[i].msg_hdr.msg_iov = &iov[i];
+            hdrs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int done = sendmmsg(fd_, hdrs, static_cast<unsigned>(n), MSG_DONTWAIT);
+        if (done < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+                stats_.tx_busy.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            if (errno == EINTR) continue;
+            fail(interface_ + ": sendmmsg");
+        }
+        sent += static_cast<size_t>(done);
+        stats_.tx_frames.fetch_add(static_cast<uint64_t>(done), std::memory_order_relaxed);
+        stats_.tx_batches.fetch_add(1, std::memory_order_relaxed);
+        if (static_cast<size_t>(done) < n) {
+            // sendmmsg stops at the first frame that failed: the queue filled up part way through
+            stats_.tx_busy.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+    }
+    return sent;
+}
+
+FrameRing::FrameRing(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    slots_.resize(size);
+    mask_ = size - 1;
+}
+
+size_t FrameRing::push(const Frame *frames, size_t count) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    const size_t free = slots_.size() - (head - tail_.load(std::memory_order_acquire));
+    const size_t n = std::min(count, free);
+    for (size_t i = 0; i < n; i++) slots_[(head + i) & mask_] = frames[i];
+    head_.store(head + n, std::memory_order_release);
+    if (n < count) dropped_.fetch_add(count - n, std::memory_order_relaxed);
+    return n;
+}
+
+size_t FrameRing::pop(Frame *out, size_t max) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t n = std::min(max, head_.load(std::memory_order_acquire) - tail);
+    for (size_t i = 0; i < n; i++) out[i] = slots_[(tail + i) & mask_];
+    tail_.store(tail + n, std::memory_order_release);
+    return n;
+}
+
+BusSet::BusSet() : batch_(SocketBus::kBatch) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        int err = errno;
+        if (epoll_fd_ >= 0) close(epoll_fd_);
+        if (wake_fd_ >= 0) close(wake_fd_);
+        errno = err;
+        fail("epoll/eventfd");
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u32 = UINT32_MAX;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev) < 0) {
+        close(epoll_fd_);
+        close(wake_fd_);
+        fail("epoll_ctl");
+    }
+}
+
+BusSet::~BusSet() {
+    stop();
+    close(epoll_fd_);
+    close(wake_fd_);
+}
+
+uint8_t BusSet::add(const std::string &interface, const BusOptions &options) {
+    if (running_) throw std::logic_error("BusSet::add() while the thread runs");
+    if (buses_.size() > UINT8_MAX) throw std::length_error("BusSet: at most 256 buses");
+    const auto index = static_cast<uint8_t>(buses_.size());
+    auto bus = std::make_unique<SocketBus>(interface, options, index);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u32 = index;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, bus->fd(), &ev) < 0) fail(interface + ": epoll_ctl");
+    buses_.push_back(std::move(bus));
+    return index;
+}
+
+void BusSet::into(FrameRing &ring) {
+    on_frames([&ring](uint8_t, const Frame *frames, size_t count) { ring.push(frames, count); });
+}
+
+size_t BusSet::poll(int timeout_ms) {
+    epoll_event events[16];
+    int n = epoll_wait(epoll_fd_, events, 16, timeout_ms);
+    if (n < 0) {
+        if (errno == EINTR) return 0;
+        fail("epoll_wait");
+    }
+    size_t total = 0;
+    for (int i = 0; i < n; i++) {
+        const uint32_t index = events[i].data.u32;
+        if (index == UINT32_MAX) {
+            uint64_t value;
+            [[maybe_unused]] ssize_t r = read(wake_fd_, &value, sizeof(value));
+            continue;
+        }
+        SocketBus &bus = *buses_[index];
+        // A batch at a time, so the handler sees bursts as whole batches and one busy bus
+        // can't keep the others waiting for more than a batch
+        size_t got = bus.receive(batch_.data(), batch_.size());
+        if (got && on_frames_) on_frames_(static_cast<uint8_t>(index), batch_.data(), got);
+        total += got;
+    }
+    return total;
+}
+
+void BusSet::start() {
+    if (running_.exchange(true)) return;
+    thread_ = std::thread([this] {
+        while (running_.load(std::memory_order_relaxed)) poll(-1);
+    });
+}
+
+void BusSet::stop() {
+    if (!running_.exchange(false)) return;
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t r = write(wake_fd_, &one, sizeof(one));
+    if (thread_.joinable()) thread_.join();
+}
+
+} // namespace tritoncan
@@ -0,0 +1,500 @@
+#include "tritoncan/spi.hpp"
+
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <linux/spi/spidev.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+namespace tritoncan {
+
+namespace {
+
+// gs_usb.h
+constexpr uint8_t kBreqMode = 2;
+constexpr uint8_t kBreqBitTiming = 1;
+constexpr uint8_t kBreqBtConst = 4;
+constexpr uint8_t kBreqDeviceConfig = 5;
+constexpr uint8_t kBreqDataBitTiming = 10;
+constexpr uint8_t kBreqBtConstExt = 11;
+constexpr uint8_t kBreqTritonClock = 0x4B;
+constexpr uint8_t kBreqTritonCaps = 0x53;
+constexpr uint32_t kModeReset = 0;
+constexpr uint32_t kModeStart = 1;
+constexpr uint16_t kMagicHost = 0x5348;
+constexpr uint16_t kMagicDevice = 0x5344;
+constexpr uint8_t kVersion = 1;
+constexpr uint8_t kFlagMore = 1 << 0;
+constexpr size_t kHeaderSize = 20; // gs_triton_spi_hdr
+constexpr size_t kCrcOffset = 16;
+constexpr size_t kCtrlSize = 8;    // gs_triton_spi_ctrl, gs_triton_spi_reply
+constexpr uint8_t kReqOut = 0x41;  // vendor, interface
+constexpr uint8_t kReqIn = 0xC1;
+
+constexpr std::chrono::milliseconds kControlTimeout{1000};
+// A request is sent again when the transaction after the next one still brings no reply
+constexpr uint64_t kControlRetry = 2;
+// Host payloads in flight; the device acknowledges one transaction later
+constexpr size_t kWindow = 4;
+
+int64_t monotonic_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+[[noreturn]] void fail(const std::string &what) {
+    throw Error(what + ": " + std::strerror(errno));
+}
+
+// CRC-32 as zlib's crc32() and the ESP32 ROM's esp_rom_crc32_le()
+uint32_t crc32(const uint8_t *p, size_t n) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    while (n--) crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void put16(uint8_t *p, uint16_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+void put32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+uint16_t get16(const uint8_t *p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+
+uint32_t get32(const uint8_t *p) {
+    return static_cast<uint32_t>(p[0] | p[1] << 8 | p[2] << 16) | static_cast<uint32_t>(p[3]) << 24;
+}
+
+std::vector<uint8_t> pack_u32(std::initializer_list<uint32_t> values) {
+    std::vector<uint8_t> out(4 * values.size());
+    size_t i = 0;
+    for (uint32_t v : values) put32(&out[4 * i++], v);
+    return out;
+}
+
+} // namespace
+
+std::unique_ptr<SpiDevice> SpiDevice::open(const SpiOptions &options) {
+    if (options.block < 256 || options.block > 4096 || options.block % 4) throw Error("SPI block must be 256..4096, a multiple of 4");
+    std::unique_ptr<SpiDevice> d(new SpiDevice(options));
+    d->spi_fd_ = ::open(options.device.c_str(), O_RDWR | O_CLOEXEC);
+    if (d->spi_fd_ < 0) fail(options.device);
+    uint8_t mode = SPI_MODE_0, bits = 8;
+    uint32_t speed = options.speed_hz;
+    if (ioctl(d->spi_fd_, SPI_IOC_WR_MODE, &mode) < 0 || ioctl(d->spi_fd_, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+        ioctl(d->spi_fd_, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0) {
+        fail(options.device + ": SPI setup");
+    }
+    if (options.drdy_line >= 0) {
+        int chip = ::open(options.gpio_chip.c_str(), O_RDWR | O_CLOEXEC);
+        if (chip < 0) fail(options.gpio_chip);
+        gpio_v2_line_request req{};
+        req.offsets[0] = static_cast<uint32_t>(options.drdy_line);
+        std::strncpy(req.consumer, "tritoncan-drdy", sizeof(req.consumer) - 1);
+        req.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING;
+        req.num_lines = 1;
+        int rc = ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &req);
+        ::close(chip);
+        if (rc < 0) fail(options.gpio_chip + " line " + std::to_string(options.drdy_line));
+        d->drdy_fd_ = req.fd;
+    }
+    d->wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (d->wake_fd_ < 0) fail("eventfd");
+    d->tx_buf_.assign(options.block, 0);
+    d->rx_buf_.assign(options.block, 0);
+
+    // A few transactions until a good header comes back: the first may find nothing queued
+    for (int i = 0; i < 16 && !d->synced_; i++) {
+        if (!d->transfer()) fail(options.device);
+        timespec pause{0, static_cast<long>(options.poll_us) * 1000};
+        nanosleep(&pause, nullptr);
+    }
+    if (d->device_block_ && d->device_block_ != options.block) {
+        throw Error("the device uses " + std::to_string(d->device_block_) + "-byte transactions, not " +
+                    std::to_string(options.block));
+    }
+    if (!d->synced_) throw Error("no TritonCAN SPI link on " + options.device);
+
+    SpiDevice *dev = d.get();
+    d->decoder_.on_frame = [dev](const Frame &f) {
+        if (!dev->on_frame_) return;
+        Frame out = f;
+        out.host_time_ns = dev->clock_.to_host_ns(f.timestamp_us);
+        dev->on_frame_(out);
+    };
+    d->decoder_.on_ack = [dev](const TxAck &a) {
+        if (!dev->on_ack_) return;
+        TxAck out = a;
+        out.host_time_ns = dev->clock_.to_host_ns(a.timestamp_us);
+        dev->on_ack_(out);
+    };
+    d->running_ = true;
+    d->thread_ = std::thread(&SpiDevice::io_loop, dev);
+
+    uint8_t config[12] = {};
+    d->control_in(kBreqDeviceConfig, 0, config, sizeof(config));
+    d->channels_ = config[3] + 1u; // icount
+    uint8_t caps[kCapsSize] = {};
+    try {
+        d->control_in(kBreqTritonCaps, 0, caps, sizeof(caps));
+        d->caps_ = parse_capabilities(caps, sizeof(caps)); // the size field says how much came back
+    } catch (const Error &) {
+        // firmware from before GS_USB_BREQ_TRITON_CAPS
+    }
+    for (uint32_t ch = 0; ch < d->channels_; ch++) d->stop(static_cast<uint8_t>(ch));
+    d->sync_clock();
+    d->clock_running_ = true;
+    d->clock_thread_ = std::thread(&SpiDevice::clock_loop, dev);
+    return d;
+}
+
+SpiDevice::~SpiDevice() {
+    {
+        std::lock_guard<std::mutex> lock(clock_mutex_);
+        clock_running_ = false;
+    }
+    clock_cv_.notify_all();
+    if (clock_thread_.joinable()) clock_thread_.join();
+    if (running_) {
+        try {
+            for (uint32_t ch = 0; ch < channels_; ch++) stop(static_cast<uint8_t>(ch));
+        } catch (const Error &) {
+            // link down: nothing left to restore
+        }
+    }
+    running_ = false;
+    if (wake_fd_ >= 0) {
+        uint64_t one = 1;
+        (void)!write(wake_fd_, &one, sizeof(one));
+    }
+    if (thread_.joinable()) thread_.join();
+    for (int fd : {spi_fd_, drdy_fd_, wake_fd_}) {
+        if (fd >= 0) ::close(fd);
+    }
+}
+
+SpiStats SpiDevice::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void SpiDevice::control(bool in, uint8_t request, uint16_t value, void *data, uint16_t len, int64_t *before,
+                        int64_t *after) {
+    std::lock_guard<std::mutex> serial(control_mutex_);
+    size_t out_len = in ? 0 : len;
+    if (kHeaderSize + kCtrlSize + std::max<size_t>(out_len, in ? len : 0) > options_.block) {
+        throw Error("control request longer than an SPI transaction");
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!running_) throw Error("SPI link down");
+    ctrl_ = Control{};
+    ctrl_.tag = next_tag_++;
+    if (next_tag_ == 0) next_tag_ = 1; // 0 is never a request's
+    ctrl_.request.resize(kCtrlSize + out_len);
+    uint8_t *p = ctrl_.request.data();
+    p[0] = in ? kReqIn : kReqOut;
+    p[1] = request;
+    p[2] = ctrl_.tag;
+    put16(p + 4, value);
+    put16(p + 6, len);
+    if (out_len) std::memcpy(p + kCtrlSize, data, out_len);
+    ctrl_.pending = true;
+    uint64_t one = 1;
+    (void)!write(wake_fd_, &one, sizeof(one));
+    bool done = cv_.wait_for(lock, kControlTimeout, [this] { return ctrl_.done || !running_; });
+    ctrl_.pending = false;
+    if (!done || !ctrl_.done) throw Error(running_ ? "control request timed out" : "SPI link down");
+    if (ctrl_.stalled) throw Error("control request " + std::to_string(request) + " refused");
+    if (in) std::memcpy(data, ctrl_.reply.data(), std::min<size_t>(len, ctrl_.reply.size()));
+    if (before) *before = ctrl_.sent_end_ns;
+    if (after) *after = ctrl_.reply_start_ns;
+}
+
+void SpiDevice::control_out(uint8_t request, uint16_t value, const void *data, uint16_t len) {
+    control(false, request, value, const_cast<void *>(data), len);
+}
+
+void SpiDevice::control_in(uint8_t request, uint16_t value, void *data, uint16_t len) {
+    control(true, request, value, data, len);
+}
+
+BitTiming SpiDevice::compute_timing(uint8_t channel, uint32_t bitrate, double sample_point, bool data_phase) {
+    uint8_t raw[kBtConstExtSize] = {};
+    control_in(kBreqBtConst, channel, raw, kBtConstSize);
+    if (data_phase) {
+        if (!(get32(raw) & kFeatureBtConstExt)) throw Error("channel has no CAN FD data phase");
+        control_in(kBreqBtConstExt, channel, raw, sizeof(raw));
+    }
+    return compute_bittiming(raw, bitrate, sample_point, data_phase);
+}
+
+void SpiDevice::set_bitrate(uint8_t channel, uint32_t bitrate, double sample_point) {
+    set_bittiming(channel, compute_timing(channel, bitrate, sample_point, false), false);
+}
+
+void SpiDevice::set_data_bitrate(uint8_t channel, uint32_t bitrate, double sample_point) {
+    set_bittiming(channel, compute_timing(channel, bitrate, sample_point, true), true);
+}
+
+void SpiDevice::set_bittiming(uint8_t channel, const BitTiming &bt, bool data_phase) {
+    auto raw = pack_u32({bt.prop_seg, bt.phase_seg1, bt.phase_seg2, bt.sjw, bt.brp});
+    control_out(data_phase ? kBreqDataBitTiming : kBreqBitTiming, channel, raw.data(), static_cast<uint16_t>(raw.size()));
+}
+
+void SpiDevice::start(uint8_t channel, uint32_t mode_flags) {
+    auto raw = pack_u32({kModeStart, mode_flags});
+    control_out(kBreqMode, channel, raw.data(), static_cast<uint16_t>(raw.size()));
+}
+
+void SpiDevice::stop(uint8_t channel) {
+    auto raw = pack_u32({kModeReset, 0});
+    control_out(kBreqMode, channel, raw.data(), static_cast<uint16_t>(raw.size()));
+}
+
+uint32_t SpiDevice::send(const Frame *frames, size_t count) {
+    std::vector<uint8_t> block;
+    uint32_t batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) throw Error("SPI link down");
+        batch = next_batch_++;
+        append_tx_block(block, batch, frames, count);
+        unsent_.insert(unsent_.end(), block.begin(), block.end());
+    }
+    uint64_t one = 1;
+    (void)!write(wake_fd_, &one, sizeof(one));
+    return batch;
+}
+
+void SpiDevice::sync_clock(int exchanges) {
+    int64_t best_before = 0, best_after = 0;
+    uint64_t best_device = 0;
+    for (int i = 0; i < exchanges; i++) {
+        uint8_t raw[8];
+        int64_t before = 0, after = 0;
+        control(true, kBreqTritonClock, 0, raw, sizeof(raw), &before, &after);
+        if (i == 0 || after - before < best_after - best_before) {
+            best_before = before;
+            best_after = after;
+            best_device = get32(raw) | static_cast<uint64_t>(get32(raw + 4)) << 32;
+        }
+    }
+    clock_.add(best_before, best_after, best_device);
+}
+
+void SpiDevice::clock_loop() {
+    std::unique_lock<std::mutex> lock(clock_mutex_);
+    while (!clock_cv_.wait_for(lock, kClockSyncPeriod, [this] { return !clock_running_; })) {
+        lock.unlock();
+        try {
+            sync_clock();
+        } catch (const Error &) {
+            return; // link down: the next host call reports it
+        }
+        lock.lock();
+    }
+}
+
+// Host stream bytes the device can still take: its latest credit less what was sent since it
+size_t SpiDevice::credit_left() const {
+    size_t used = 0;
+    for (const Payload &p : unacked_) {
+        if (p.sent_in >= credit_txn_) used += p.bytes.size();
+    }
+    return credit_ > used ? credit_ - used : 0;
+}
+
+// A payload can go out now: one to resend that fits the credit, or new stream bytes
+bool SpiDevice::stream_ready() const {
+    if (resend_ < unacked_.size()) return unacked_[resend_].bytes.size() <= credit_left();
+    return !unsent_.empty() && unacked_.size() < kWindow && credit_left() > 0;
+}
+
+// The MOSI half of transaction txn_ + 1, under mutex_
+void SpiDevice::build(uint8_t *tx) {
+    uint64_t n = txn_ + 1;
+    size_t pos = kHeaderSize;
+    uint16_t ctrl_len = 0, data_len = 0;
+    uint8_t seq = next_seq_;
+    if (ctrl_.pending && !ctrl_.done && (ctrl_.sent_in == 0 || n >= ctrl_.sent_in + kControlRetry)) {
+        if (ctrl_.sent_in) stats_.control_retries++;
+        std::memcpy(tx + pos, ctrl_.request.data(), ctrl_.request.size());
+        ctrl_len = static_cast<uint16_t>(ctrl_.request.size());
+        pos += ctrl_len;
+        ctrl_.sent_in = n;
+    }
+    size_t room = std::min(options_.block - pos, credit_left());
+    if (resend_ < unacked_.size()) {
+        Payload &p = unacked_[resend_];
+        if (p.bytes.size() <= room) {
+            std::memcpy(tx + pos, p.bytes.data(), p.bytes.size());
+            data_len = static_cast<uint16_t>(p.bytes.size());
+            seq = p.seq;
+            p.sent_in = n;
+            resend_++;
+            stats_.resent++;
+        }
+    } else if (!unsent_.empty() && unacked_.size() < kWindow && room) {
+        size_t len = std::min(room, unsent_.size());
+        Payload p{next_seq_++, std::vector<uint8_t>(unsent_.begin(), unsent_.begin() + static_cast<long>(len)), n};
+        unsent_.erase(unsent_.begin(), unsent_.begin() + static_cast<long>(len));
+        std::memcpy(tx + pos, p.bytes.data(), len);
+        data_len = static_cast<uint16_t>(len);
+        seq = p.seq;
+        unacked_.push_back(std::move(p));
+        resend_ = unacked_.size();
+    }
+    pos += data_len;
+    std::memset(tx, 0, kHeaderSize);
+    put16(tx, kMagicHost);
+    tx[2] = kVersion;
+    tx[3] = seq;
+    put16(tx + 6, ctrl_len);
+    put16(tx + 8, data_len);
+    put32(tx + kCrcOffset, crc32(tx, pos));
+}
+
+// The MISO half of transaction txn_
+void SpiDevice::handle(uint8_t *rx, int64_t start_ns) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint16_t ctrl_len = get16(rx + 6), data_len = get16(rx + 8);
+    if (get16(rx) != kMagicDevice || rx[2] != kVersion) {
+        stats_.bad++;
+        return;
+    }
+    device_block_ = get16(rx + 12);
+    size_t end = kHeaderSize + ctrl_len + data_len;
+    uint32_t crc = get32(rx + kCrcOffset);
+    put32(rx + kCrcOffset, 0);
+    if (device_block_ != options_.block || end > options_.block || crc32(rx, end) != crc) {
+        stats_.bad++;
+        return;
+    }
+    synced_ = true;
+    more_ = (rx[5] & kFlagMore) != 0;
+    uint8_t ack = rx[4];
+    while (!unacked_.empty() && static_cast<int8_t>(unacked_.front().seq - ack) < 0) {
+        unacked_.pop_front();
+        if (resend_) resend_--;
+    }
+    // The device answers the transaction before this one: a payload sent before it and still not
+    // acknowledged was refused (bad CRC, no room, out of order), and so was everything after it
+    if (!unacked_.empty() && unacked_.front().sent_in < txn_) resend_ = 0;
+    credit_ = get16(rx + 10);
+    credit_txn_ = txn_;
+    if (ctrl_len >= kCtrlSize && ctrl_.pending && !ctrl_.done && rx[kHeaderSize + 1] == ctrl_.tag &&
+        rx[kHeaderSize] == ctrl_.request[1]) {
+        const uint8_t *reply = rx + kHeaderSize;
+        size_t length = std::min<size_t>(get16(reply + 4), ctrl_len - kCtrlSize);
+        ctrl_.stalled = reply[2] != 0;
+        ctrl_.reply.assign(reply + kCtrlSize, reply + kCtrlSize + length);
+        ctrl_.reply_start_ns = start_ns;
+        ctrl_.done = true;
+        cv_.notify_all();
+    }
+    lock.unlock();
+    if (data_len) {
+        rx_bytes_ += data_len;
+        decoder_.feed(rx + kHeaderSize + ctrl_len, data_len);
+    }
+}
+
+bool SpiDevice::transfer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        build(tx_buf_.data());
+    }
+    spi_ioc_transfer tr{};
+    tr.tx_buf = reinterpret_cast<uintptr_t>(tx_buf_.data());
+    tr.rx_buf = reinterpret_cast<uintptr_t>(rx_buf_.data());
+    tr.len = options_.block;
+    tr.speed_hz = options_.speed_hz;
+    tr.bits_per_word = 8;
+    int64_t start = monotonic_ns();
+    if (ioctl(spi_fd_, SPI_IOC_MESSAGE(1), &tr) < 0) return false;
+    int64_t end = monotonic_ns();
+    txn_++;
+    last_end_ns_ = end;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.transactions++;
+        if (ctrl_.sent_in == txn_) ctrl_.sent_end_ns = end;
+    }
+    handle(rx_buf_.data(), start);
+    return true;
+}
+
+bool SpiDevice::drdy_level() {
+    if (drdy_fd_ < 0) return false;
+    gpio_v2_line_values values{};
+    values.mask = 1;
+    return ioctl(drdy_fd_, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) == 0 && (values.bits & 1);
+}
+
+// Sleeps until a caller has work, DRDY rises or timeout_us pass (-1: no timeout)
+void SpiDevice::wait(int64_t timeout_us) {
+    pollfd fds[2] = {{wake_fd_, POLLIN, 0}, {drdy_fd_, POLLIN, 0}};
+    timespec ts{static_cast<time_t>(timeout_us / 1000000), static_cast<long>(timeout_us % 1000000) * 1000};
+    if (ppoll(fds, drdy_fd_ >= 0 ? 2 : 1, timeout_us < 0 ? nullptr : &ts, nullptr) <= 0) return;
+    uint64_t count;
+    if (fds[0].revents & POLLIN) (void)!read(wake_fd_, &count, sizeof(count));
+    if (fds[1].revents & POLLIN) {
+        gpio_v2_line_event events[16];
+        (void)!read(drdy_fd_, events, sizeof(events)); // the level is read again before it counts
+    }
+}
+
+void SpiDevice::io_loop() {
+    while (running_) {
+        bool urgent, waiting;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            urgent = more_ || (ctrl_.pending && !ctrl_.done) || stream_ready();
+            waiting = !unsent_.empty() || !unacked_.empty(); // for credit or acks
+        }
+        int64_t since_us = (monotonic_ns() - last_end_ns_) / 1000;
+        if (!urgent) urgent = drdy_level();
+        // Without DRDY an idle link is polled, with it only a host that waits for the device is
+        int64_t due_us = urgent ? options_.gap_us : (waiting || drdy_fd_ < 0) ? options_.poll_us : -1;
+        if (due_us < 0) {
+            wait(-1);
+            continue;
+        }
+        if (since_us < due_us) {
+            if (urgent) {
+                timespec pause{0, static_cast<long>(due_us - since_us) * 1000};
+                nanosleep(&pause, nullptr);
+            } else {
+                wait(due_us - since_us);
+                continue;
+            }
+        }
+        if (!transfer()) break;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+    cv_.notify_all();
+}
+
+} // namespace tritoncan
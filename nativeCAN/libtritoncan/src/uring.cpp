@@ -0,0 +1,322 @@
+#include "tritoncan/uring.hpp"
+
+#include <linux/can.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <system_error>
+
+namespace tritoncan {
+
+namespace {
+
+// Same control space as SocketBus: SCM_TIMESTAMPING and SO_RXQ_OVFL
+constexpr size_t kControl = CMSG_SPACE(3 * sizeof(timespec)) + CMSG_SPACE(sizeof(uint32_t));
+// One provided buffer: io_uring_recvmsg_out, the control messages, then the frame
+constexpr size_t kBufferSize = 256;
+static_assert(sizeof(io_uring_recvmsg_out) + kControl + sizeof(canfd_frame) <= kBufferSize, "buffer too small");
+constexpr uint16_t kBufferGroup = 0;
+constexpr uint64_t kWakeTag = UINT64_MAX;
+
+[[noreturn]] void fail(const std::string &what, int err = errno) {
+    throw std::system_error(err, std::generic_category(), what);
+}
+
+int uring_setup(unsigned entries, io_uring_params *p) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, const void *arg, size_t argsz) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz));
+}
+
+int uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+int64_t clock_ns(clockid_t clock) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+template <typename T>
+T *at(void *base, uint32_t offset) {
+    return reinterpret_cast<T *>(static_cast<uint8_t *>(base) + offset);
+}
+
+void *map_anonymous(size_t size) {
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) fail("mmap");
+    return p;
+}
+
+} // namespace
+
+bool UringBusSet::supported() {
+    utsname u;
+    int major = 0, minor = 0;
+    if (uname(&u) < 0 || std::sscanf(u.release, "%d.%d", &major, &minor) != 2 || major < 6) return false;
+    io_uring_params p{};
+    int fd = uring_setup(2, &p);
+    if (fd < 0) return false; // ENOSYS, or EPERM from seccomp / io_uring_disabled
+    const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    void *ring = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    bool ok = ring != MAP_FAILED;
+    if (ok) {
+        io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+        reg.ring_entries = 1;
+        reg.bgid = kBufferGroup;
+        ok = uring_register(fd, IORING_REGISTER_PBUF_RING, &reg, 1) == 0;
+        munmap(ring, size);
+    }
+    close(fd);
+    return ok;
+}
+
+UringBusSet::UringBusSet() {
+    io_uring_params p{};
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+    p.cq_entries = kBuffers + kQueueDepth; // one CQE per buffer in flight, so the CQ never overflows
+    ring_fd_ = uring_setup(kQueueDepth, &p);
+    if (ring_fd_ < 0 && errno == EINVAL) {
+        p = {};
+        p.flags = IORING_SETUP_CQSIZE; // before 5.19
+        p.cq_entries = kBuffers + kQueueDepth;
+        ring_fd_ = uring_setup(kQueueDepth, &p);
+    }
+    if (ring_fd_ < 0) fail("io_uring_setup");
+    try {
+        if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG))
+            fail("io_uring: kernel too old", ENOTSUP);
+        ring_size_ = std::max(p.sq_off.array + p.sq_entries * sizeof(unsigned), p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe));
+        ring_ = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+        if (ring_ == MAP_FAILED) {
+            ring_ = nullptr;
+            fail("io_uring: mmap rings");
+        }
+        sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) fail("io_uring: mmap SQEs");
+        sqes_ = static_cast<io_uring_sqe *>(sqes);
+        sq_head_ = at<unsigned>(ring_, p.sq_off.head);
+        sq_tail_ = at<unsigned>(ring_, p.sq_off.tail);
+        sq_mask_ = at<unsigned>(ring_, p.sq_off.ring_mask);
+        sq_array_ = at<unsigned>(ring_, p.sq_off.array);
+        cq_head_ = at<unsigned>(ring_, p.cq_off.head);
+        cq_tail_ = at<unsigned>(ring_, p.cq_off.tail);
+        cq_mask_ = at<unsigned>(ring_, p.cq_off.ring_mask);
+        cqes_ = at<io_uring_cqe>(ring_, p.cq_off.cqes);
+
+        // Provided buffer ring: page-aligned, registered once; the kernel picks a buffer per frame
+        buf_ring_size_ = kBuffers * sizeof(io_uring_buf);
+        // As an array of io_uring_buf: the header's flexible array member is not at offset 0 in C++
+        buf_ring_ = static_cast<io_uring_buf *>(map_anonymous(buf_ring_size_));
+        buffers_ = static_cast<uint8_t *>(map_anonymous(kBuffers * kBufferSize));
+        io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+        reg.ring_entries = kBuffers;
+        reg.bgid = kBufferGroup;
+        if (uring_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) fail("io_uring: register buffer ring");
+        for (unsigned i = 0; i < kBuffers; i++) recycle(static_cast<uint16_t>(i));
+
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_fd_ < 0) fail("eventfd");
+        arm_wake();
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+UringBusSet::~UringBusSet() {
+    stop();
+    release();
+}
+
+void UringBusSet::release() {
+    if (ring_fd_ >= 0) close(ring_fd_); // cancels the armed receives
+    ring_fd_ = -1;
+    if (wake_fd_ >= 0) close(wake_fd_);
+    wake_fd_ = -1;
+    if (ring_) munmap(ring_, ring_size_);
+    if (sqes_) munmap(sqes_, sqes_size_);
+    if (buf_ring_) munmap(buf_ring_, buf_ring_size_);
+    if (buffers_) munmap(buffers_, kBuffers * kBufferSize);
+    ring_ = nullptr;
+    sqes_ = nullptr;
+    buf_ring_ = nullptr;
+    buffers_ = nullptr;
+}
+
+void UringBusSet::recycle(uint16_t bid) {
+    io_uring_buf &b = buf_ring_[buf_tail_ & (kBuffers - 1)];
+    b.addr = reinterpret_cast<uint64_t>(buffers_ + static_cast<size_t>(bid) * kBufferSize);
+    b.len = kBufferSize;
+    b.bid = bid;
+    buf_tail_++;
+    // Published in one release store per batch: see poll()
+}
+
+io_uring_sqe *UringBusSet::next_sqe() {
+    unsigned tail = *sq_tail_;
+    if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) > *sq_mask_) {
+        submit_and_wait(0); // full: hand what is queued to the kernel first
+        tail = *sq_tail_;
+    }
+    const unsigned index = tail & *sq_mask_;
+    io_uring_sqe *sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    to_submit_++;
+    return sqe;
+}
+
+void UringBusSet::arm_receive(uint8_t index) {
+    io_uring_sqe *sqe = next_sqe();
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = buses_[index].socket->fd();
+    sqe->addr = reinterpret_cast<uint64_t>(buses_[index].msg.get());
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kBufferGroup;
+    sqe->user_data = index;
+}
+
+void UringBusSet::arm_wake() {
+    io_uring_sqe *sqe = next_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = wake_fd_;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = kWakeTag;
+}
+
+void UringBusSet::submit_and_wait(int timeout_ms) {
+    const unsigned submit = to_submit_;
+    to_submit_ = 0;
+    if (timeout_ms == 0 && submit == 0) return;
+    __kernel_timespec ts{};
+    ts.tv_sec = timeout_ms > 0 ? timeout_ms / 1000 : 0;
+    ts.tv_nsec = timeout_ms > 0 ? (timeout_ms % 1000) * 1000000LL : 0;
+    io_uring_getevents_arg arg{};
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+    const unsigned wait = timeout_ms != 0 ? 1 : 0;
+    const unsigned flags = (wait ? IORING_ENTER_GETEVENTS : 0) | (timeout_ms > 0 ? IORING_ENTER_EXT_ARG : 0);
+    const void *argp = timeout_ms > 0 ? &arg : nullptr;
+    const size_t argsz = timeout_ms > 0 ? sizeof(arg) : 0;
+    if (uring_enter(ring_fd_, submit, wait, flags, argp, argsz) < 0) {
+        if (errno == ETIME || errno == EINTR || errno == EBUSY || errno == EAGAIN) return;
+        fail("io_uring_enter");
+    }
+}
+
+uint8_t UringBusSet::add(const std::string &interface, const BusOptions &options) {
+    if (running_) throw std::logic_error("UringBusSet::add() while the thread runs");
+    if (buses_.size() > UINT8_MAX) throw std::length_error("UringBusSet: at most 256 buses");
+    const auto index = static_cast<uint8_t>(buses_.size());
+    Bus bus;
+    bus.socket = std::make_unique<SocketBus>(interface, options, index);
+    bus.msg = std::make_unique<msghdr>();
+    bus.msg->msg_controllen = kControl;
+    bus.pending.reserve(SocketBus::kBatch);
+    buses_.push_back(std::move(bus));
+    arm_receive(index);
+    submit_and_wait(0);
+    return index;
+}
+
+void UringBusSet::into(FrameRing &ring) {
+    on_frames([&ring](uint8_t, const Frame *frames, size_t count) { ring.push(frames, count); });
+}
+
+void UringBusSet::flush(uint8_t index) {
+    Bus &bus = buses_[index];
+    if (bus.pending.empty()) return;
+    bus.socket->stats_.rx_frames.fetch_add(bus.pending.size(), std::memory_order_relaxed);
+    bus.socket->stats_.rx_batches.fetch_add(1, std::memory_order_relaxed);
+    if (on_frames_) on_frames_(index, bus.pending.data(), bus.pending.size());
+    bus.pending.clear();
+}
+
+size_t UringBusSet::poll(int timeout_ms) {
+    unsigned head = *cq_head_;
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        submit_and_wait(timeout_ms);
+        head = *cq_head_;
+    }
+    const int64_t to_monotonic = clock_ns(CLOCK_MONOTONIC) - clock_ns(CLOCK_REALTIME);
+    size_t total = 0;
+    const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        const io_uring_cqe &cqe = cqes_[head & *cq_mask_];
+        const bool more = cqe.flags & IORING_CQE_F_MORE;
+        if (cqe.user_data == kWakeTag) {
+            uint64_t value;
+            [[maybe_unused]] ssize_t r = read(wake_fd_, &value, sizeof(value));
+            if (!more) arm_wake();
+            continue;
+        }
+        const auto index = static_cast<uint8_t>(cqe.user_data);
+        if (cqe.res >= 0 && (cqe.flags & IORING_CQE_F_BUFFER)) {
+            const auto bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            uint8_t *buf = buffers_ + static_cast<size_t>(bid) * kBufferSize;
+            const auto *out = reinterpret_cast<const io_uring_recvmsg_out *>(buf);
+            msghdr msg{};
+            msg.msg_control = buf + sizeof(io_uring_recvmsg_out);
+            msg.msg_controllen = out->controllen;
+            Bus &bus = buses_[index];
+            bus.pending.emplace_back();
+            bus.socket->decode(buf + sizeof(io_uring_recvmsg_out) + kControl, out->payloadlen, msg, to_monotonic,
+                               bus.pending.back());
+            recycle(bid);
+            if (bus.pending.size() == SocketBus::kBatch) flush(index);
+            total++;
+        } else if (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED) {
+            __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+            fail(buses_[index].socket->interface() + ": io_uring recvmsg", -cqe.res);
+        }
+        if (!more && index < buses_.size()) {
+            // Ended, mostly ENOBUFS (every buffer in use): its frames wait in the socket queue
+            rearms_.fetch_add(1, std::memory_order_relaxed);
+            arm_receive(index);
+        }
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    __atomic_store_n(&buf_ring_[0].resv, buf_tail_, __ATOMIC_RELEASE); // the ring's tail
+    for (size_t i = 0; i < buses_.size(); i++) flush(static_cast<uint8_t>(i));
+    if (to_submit_) submit_and_wait(0);
+    return total;
+}
+
+void UringBusSet::start() {
+    if (running_.exchange(true)) return;
+    thread_ = std::thread([this] {
+        while (running_.load(std::memory_order_relaxed)) poll(-1);
+    });
+}
+
+void UringBusSet::stop() {
+    if (!running_.exchange(false)) return;
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t r = write(wake_fd_, &one, sizeof(one));
+    if (thread_.joinable()) thread_.join();
+}
+
+} // namespace tritoncan
@@ -0,0 +1,82 @@
+// ShmPublisher / ShmClient on a real segment, without a bus: slot claims of two clients in one
+// process, and reap() once one of them is gone
+#undef NDEBUG // the checks are the test
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+
+#include "tritoncan/shm.hpp"
+
+using namespace tritoncan;
+
+namespace {
+
+Frame frame(uint32_t can_id) {
+    Frame f{};
+    f.can_id = can_id;
+    f.len = 2;
+    f.data[0] = 0xAB;
+    f.data[1] = 0xCD;
+    return f;
+}
+
+uint32_t slot_of(ShmPublisher &pub, const char *name) {
+    for (uint32_t i = 0; i < pub.header().max_clients; i++)
+        if (pub.client(i).owner.load() && std::string(pub.client(i).name) == name) return i;
+    assert(!"client slot not found");
+    return UINT32_MAX;
+}
+
+// Closing one client's segment must not drop the other's slot lock: reap() would then free a
+// slot that is still in use and take_tx() skip its queue
+void test_two_clients_one_process(const std::string &interface) {
+    ShmPublisher pub(interface, 64, 4, 16, 0600);
+    auto *first = new ShmClient(interface, "first");
+    ShmClient second(interface, "second");
+    const uint32_t a = slot_of(pub, "first"), b = slot_of(pub, "second");
+    assert(a != b);
+
+    delete first;
+    pub.reap();
+    assert(pub.client(a).owner.load() == 0);
+    assert(pub.client(b).owner.load() == static_cast<uint32_t>(getpid()));
+
+    const Frame f = frame(0x123);
+    assert(second.send(&f, 1) == 1);
+    Frame out[4];
+    uint32_t client = UINT32_MAX;
+    assert(pub.take_tx(client, out, 4) == 1);
+    assert(client == b && out[0].can_id == 0x123 && out[0].len == 2 && out[0].data[1] == 0xCD);
+    pub.consume_tx(client, 1);
+    assert(pub.take_tx(client, out, 4) == 0);
+
+    // The freed slot is taken again, by a third client of the same process
+    ShmClient third(interface, "third");
+    assert(slot_of(pub, "third") == a);
+    pub.reap();
+    assert(pub.client(a).owner.load() && pub.client(b).owner.load());
+}
+
+void test_rx(const std::string &interface) {
+    ShmPublisher pub(interface, 64, 2, 16, 0600);
+    ShmClient one(interface, "one"), two(interface, "two");
+    Frame in[3] = {frame(1), frame(2), frame(3)};
+    pub.publish(in, 3);
+    Frame out[8];
+    assert(one.read(out, 8) == 3 && out[2].can_id == 3);
+    assert(two.read(out, 8) == 3 && out[0].can_id == 1);
+    assert(one.read(out, 8) == 0);
+}
+
+} // namespace
+
+int main() {
+    // Not a real interface: the publisher only names its segment after it
+    const std::string interface = "shmt" + std::to_string(getpid() % 100000);
+    test_two_clients_one_process(interface);
+    test_rx(interface);
+    std::printf("shm: all tests passed\n");
+    return 0;
+}
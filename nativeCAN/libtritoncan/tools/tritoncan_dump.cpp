@@ -0,0 +1,108 @@
+// High-rate logger on the packed wire format: candump-style lines, or per-second rates with --rate.
+// With -T the timestamps are host CLOCK_MONOTONIC (synced device clock) instead of device time.
+// -s picks an adapter by serial number when several are plugged in; --list prints them.
+//
+//   tritoncan_dump [-s serial] [-c channel]... [-b bitrate] [--fd -d dbitrate] [--rate] [-T]
+//   tritoncan_dump --list
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tritoncan/device.hpp"
+
+namespace {
+
+std::atomic<bool> g_stop{false};
+
+void print_frame(const tritoncan::Frame &f, bool host_time) {
+    char line[256];
+    uint64_t us = host_time ? static_cast<uint64_t>(f.host_time_ns / 1000) : f.timestamp_us;
+    int n = std::snprintf(line, sizeof(line), "(%llu.%06llu) can%u ", static_cast<unsigned long long>(us / 1000000),
+                          static_cast<unsigned long long>(us % 1000000), f.channel);
+    if (f.can_id & tritoncan::kCanEffFlag) n += std::snprintf(line + n, sizeof(line) - n, "%08X", f.can_id & 0x1FFFFFFF);
+    else n += std::snprintf(line + n, sizeof(line) - n, "%03X", f.can_id & 0x7FF);
+    if (f.flags & tritoncan::kFlagFd) n += std::snprintf(line + n, sizeof(line) - n, "##%X", (f.flags & tritoncan::kFlagBrs) ? 1 : 0);
+    else if (f.can_id & tritoncan::kCanRtrFlag) n += std::snprintf(line + n, sizeof(line) - n, "#R");
+    else n += std::snprintf(line + n, sizeof(line) - n, "#");
+    for (uint8_t i = 0; i < f.len && n < static_cast<int>(sizeof(line)) - 3; i++) n += std::snprintf(line + n, sizeof(line) - n, "%02X", f.data[i]);
+    if (f.flags & tritoncan::kFlagOverflow) std::printf("%s  (frames lost before this one)\n", line);
+    else std::printf("%s\n", line);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<uint8_t> channels;
+    uint32_t bitrate = 1000000, dbitrate = 0;
+    bool fd = false, rate = false, host_time = false, list = false;
+    std::string serial;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "-c" && i + 1 < argc) channels.push_back(static_cast<uint8_t>(std::atoi(argv[++i])));
+        else if (a == "-b" && i + 1 < argc) bitrate = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+        else if (a == "-d" && i + 1 < argc) dbitrate = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+        else if (a == "--fd") fd = true;
+        else if (a == "--rate") rate = true;
+        else if (a == "-T") host_time = true;
+        else if (a == "-s" && i + 1 < argc) serial = argv[++i];
+        else if (a == "--list") list = true;
+        else {
+            std::fprintf(stderr, "usage: %s [-s serial] [-c channel]... [-b bitrate] [--fd -d dbitrate] [--rate] [-T] | --list\n", argv[0]);
+            return 2;
+        }
+    }
+    if (channels.empty()) channels.push_back(0);
+    std::signal(SIGINT, [](int) { g_stop = true; });
+
+    try {
+        if (list) {
+            for (const std::string &s : tritoncan::Device::list()) std::printf("%s\n", s.c_str());
+            return 0;
+        }
+        auto dev = tritoncan::Device::open(serial);
+        std::atomic<uint64_t> frames{0}, errors{0}, lost{0};
+        dev->on_frame([&](const tritoncan::Frame &f) {
+            frames++;
+            if (f.can_id & tritoncan::kCanErrFlag) errors++;
+            if (f.flags & tritoncan::kFlagOverflow) lost++;
+            if (!rate) print_frame(f, host_time);
+        });
+        for (uint8_t ch : channels) {
+            if (ch >= dev->channel_count()) throw tritoncan::Error("no channel " + std::to_string(ch));
+            dev->set_bitrate(ch, bitrate);
+            if (fd) dev->set_data_bitrate(ch, dbitrate ? dbitrate : bitrate);
+            dev->start(ch, fd ? tritoncan::kModeFd : 0);
+        }
+
+        uint64_t last_frames = 0, last_bytes = 0, last_blocks = 0;
+        while (!g_stop) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            if (!rate) continue;
+            uint64_t f = frames, b = dev->rx_bytes(), k = dev->rx_blocks();
+            std::printf("%llu frames/s  %llu B/s  %llu blocks/s  error frames %llu  overflow marks %llu  stream errors %llu\n",
+                        static_cast<unsigned long long>(f - last_frames), static_cast<unsigned long long>(b - last_bytes),
+                        static_cast<unsigned long long>(k - last_blocks), static_cast<unsigned long long>(errors.load()),
+                        static_cast<unsigned long long>(lost.load()), static_cast<unsigned long long>(dev->rx_errors()));
+            const tritoncan::ClockSync &clock = dev->clock();
+            if (clock.synced()) {
+                std::printf("  clock: offset %.6f s  drift %+.2f ppm  rtt %lld us  fit %.1f us\n", clock.offset_ns() / 1e9,
+                            clock.drift_ppm(), static_cast<long long>(clock.rtt_ns() / 1000), clock.residual_ns() / 1000);
+            }
+            std::fflush(stdout);
+            last_frames = f;
+            last_bytes = b;
+            last_blocks = k;
+        }
+    } catch (const tritoncan::Error &e) {
+        std::fprintf(stderr, "tritoncan_dump: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,159 @@
+// Request/response round trips with C++20 coroutines (tritoncan/coro.hpp) on one BusSet thread.
+// --outstanding coroutines each loop over co_await bus.request(...) to one of --devices simulated
+// devices. The devices are a second socket on the same interface, in the same loop, that echo
+// every request payload from ID 0x400 + n. Reports round trips per second, timeouts, CPU per
+// round trip and the round-trip latency.
+//
+//   tritoncan_request_bench [-i vcan0] [--outstanding n] [--devices n] [--seconds s] [--timeout-ms ms]
+//
+// Defaults: vcan0, 1000 outstanding requests over 64 devices for 5 s, 100 ms timeout.
+//   sudo ip link add vcan0 type vcan && sudo ip link set up vcan0
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "tritoncan/coro.hpp"
+#include "tritoncan/requests.hpp"
+#include "tritoncan/socketcan.hpp"
+
+namespace {
+
+constexpr uint32_t kRequestBase = 0x200;
+constexpr uint32_t kReplyBase = 0x400;
+constexpr uint32_t kSffMask = 0x7FF;
+
+struct Stats {
+    bool stopping = false;
+    size_t running = 0;
+    uint64_t ok = 0, timeouts = 0, send_failed = 0;
+    std::vector<uint64_t> latency_us = std::vector<uint64_t>(10001); // 1 µs buckets up to 10 ms, then the rest
+};
+
+double percentile(const std::vector<uint64_t> &hist, double q) {
+    uint64_t total = 0;
+    for (uint64_t c : hist) total += c;
+    uint64_t acc = 0;
+    for (size_t i = 0; i < hist.size(); i++) {
+        acc += hist[i];
+        if (acc >= q * total) return static_cast<double>(i);
+    }
+    return 0;
+}
+
+// One client: a request to its device, await the echo of its own sequence number, repeat
+tritoncan::Task<void> client(tritoncan::AsyncBus bus, uint32_t worker, uint32_t device, std::chrono::milliseconds timeout,
+                             Stats &s) {
+    s.running++;
+    for (uint32_t seq = 0; !s.stopping; seq++) {
+        tritoncan::Frame req;
+        req.can_id = kRequestBase + device;
+        req.len = 8;
+        std::memcpy(req.data.data(), &worker, 4);
+        std::memcpy(req.data.data() + 4, &seq, 4);
+        tritoncan::Expect reply;
+        reply.id = kReplyBase + device;
+        reply.mask = kSffMask;
+        reply.match = [worker, seq](const tritoncan::Frame &f) {
+            uint32_t w, q;
+            std::memcpy(&w, f.data.data(), 4);
+            std::memcpy(&q, f.data.data() + 4, 4);
+            return f.len == 8 && w == worker && q == seq;
+        };
+        const int64_t start = tritoncan::Requests::now_ns();
+        tritoncan::Reply r = co_await bus.request(req, std::move(reply), timeout);
+        switch (r.status) {
+        case tritoncan::ReplyStatus::Ok: {
+            s.ok++;
+            const int64_t us = (tritoncan::Requests::now_ns() - start) / 1000;
+            s.latency_us[static_cast<size_t>(std::clamp<int64_t>(us, 0, 10000))]++;
+            break;
+        }
+        case tritoncan::ReplyStatus::SendFailed:
+            s.send_failed++;
+            co_await bus.receive({0, 0x7FF, [](const tritoncan::Frame &) { return false; }}, std::chrono::milliseconds(1));
+            break; // the interface queue was full: back off for a millisecond
+        default:
+            s.timeouts++;
+            break;
+        }
+    }
+    s.running--;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string interface = "vcan0";
+    size_t outstanding = 1000, devices = 64;
+    double seconds = 5;
+    int timeout_ms = 100;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "-i" && i + 1 < argc) interface = argv[++i];
+        else if (a == "--outstanding" && i + 1 < argc) outstanding = std::strtoul(argv[++i], nullptr, 0);
+        else if (a == "--devices" && i + 1 < argc) devices = std::strtoul(argv[++i], nullptr, 0);
+        else if (a == "--seconds" && i + 1 < argc) seconds = std::atof(argv[++i]);
+        else if (a == "--timeout-ms" && i + 1 < argc) timeout_ms = std::atoi(argv[++i]);
+        else {
+            std::fprintf(stderr, "usage: %s [-i vcan0] [--outstanding n] [--devices n] [--seconds s] [--timeout-ms ms]\n",
+                         argv[0]);
+            return 2;
+        }
+    }
+    devices = std::clamp<size_t>(devices, 1, kReplyBase - kRequestBase);
+
+    try {
+        tritoncan::BusSet set;
+        tritoncan::BusOptions opts;
+        const uint8_t host = set.add(interface, opts);
+        opts.filters = {{kRequestBase, 0x600}}; // 0x200..0x3FF: the devices see requests only
+        const uint8_t sim = set.add(interface, opts);
+        tritoncan::Requests requests([&set](uint8_t bus, const tritoncan::Frame *f, size_t n) { return set.send(bus, f, n); });
+        std::vector<tritoncan::Frame> replies;
+        requests.attach(set, [&](uint8_t bus, const tritoncan::Frame *frames, size_t count) {
+            if (bus != sim) return;
+            replies.assign(frames, frames + count);
+            for (tritoncan::Frame &f : replies) f.can_id = kReplyBase + (f.can_id & kSffMask) - kRequestBase;
+            set.send(sim, replies);
+        });
+
+        Stats s;
+        for (size_t w = 0; w < outstanding; w++) {
+            tritoncan::spawn(client(tritoncan::AsyncBus(requests, host), static_cast<uint32_t>(w),
+                                    static_cast<uint32_t>(w % devices), std::chrono::milliseconds(timeout_ms), s));
+        }
+        std::printf("%zu outstanding requests over %zu devices on %s for %.0f s\n", outstanding, devices,
+                    interface.c_str(), seconds);
+
+        rusage before, after;
+        getrusage(RUSAGE_THREAD, &before);
+        const int64_t start = tritoncan::Requests::now_ns();
+        const int64_t end = start + static_cast<int64_t>(seconds * 1e9);
+        while (tritoncan::Requests::now_ns() < end) requests.poll(set, 100);
+        s.stopping = true;
+        while (s.running) requests.poll(set, 100); // the last round of every client
+        getrusage(RUSAGE_THREAD, &after);
+        const double wall = static_cast<double>(tritoncan::Requests::now_ns() - start) / 1e9;
+        auto secs = [](const timeval &tv) { return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6; };
+        const double cpu = secs(after.ru_utime) - secs(before.ru_utime) + secs(after.ru_stime) - secs(before.ru_stime);
+
+        std::printf("%llu round trips (%.0f/s), %llu timeouts, %llu sends refused\n",
+                    static_cast<unsigned long long>(s.ok), static_cast<double>(s.ok) / wall,
+                    static_cast<unsigned long long>(s.timeouts), static_cast<unsigned long long>(s.send_failed));
+        std::printf("CPU %.1f%% of a core, %.2f us per round trip (requester and devices)  latency p50 %.0f p99 %.0f us\n",
+                    100.0 * cpu / wall, s.ok ? 1e6 * cpu / static_cast<double>(s.ok) : 0.0,
+                    percentile(s.latency_us, 0.5), percentile(s.latency_us, 0.99));
+    } catch (const std::system_error &e) {
+        std::fprintf(stderr, "tritoncan_request_bench: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
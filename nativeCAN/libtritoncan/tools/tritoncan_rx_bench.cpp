@@ -0,0 +1,181 @@
+// Receive backends side by side: BusSet (epoll + recvmmsg) and UringBusSet (io_uring multishot
+// recvmsg). A sender thread paces frames onto every interface at --rate each; the receiving
+// thread counts them and measures its own CPU time, wake-ups and kernel -> handler latency.
+//
+//   tritoncan_rx_bench [-i vcan0,vcan1,...] [--rate fps] [--seconds s] [--backend epoll|uring|both]
+//
+// Defaults: vcan0..vcan7 at 8000 frames/s each for 10 s, both backends. Create the interfaces with
+//   for i in $(seq 0 7); do sudo ip link add vcan$i type vcan && sudo ip link set up vcan$i; done
+
+#include <sys/resource.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "tritoncan/socketcan.hpp"
+#include "tritoncan/uring.hpp"
+
+namespace {
+
+constexpr int kTickNs = 1000000; // sender pacing: one sendmmsg per bus per millisecond
+
+int64_t now_ns(clockid_t clock = CLOCK_MONOTONIC) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+struct Result {
+    uint64_t sent = 0, received = 0, dropped = 0, wakeups = 0, batches = 0;
+    double cpu_s = 0, wall_s = 0;
+    long voluntary_switches = 0;
+    std::vector<uint64_t> latency_us; // histogram, 1 µs buckets up to 1 ms, the last one for the rest
+};
+
+double percentile(const std::vector<uint64_t> &hist, double q) {
+    uint64_t total = 0;
+    for (uint64_t c : hist) total += c;
+    uint64_t acc = 0;
+    for (size_t i = 0; i < hist.size(); i++) {
+        acc += hist[i];
+        if (acc >= q * total) return static_cast<double>(i);
+    }
+    return 0;
+}
+
+// The sender's own sockets: it never receives, so the receiving side sees every frame once
+void send_loop(const std::vector<std::string> &interfaces, double rate, double seconds, std::atomic<uint64_t> &sent) {
+    std::vector<std::unique_ptr<tritoncan::SocketBus>> buses;
+    tritoncan::BusOptions opts;
+    opts.timestamps = tritoncan::Timestamps::None;
+    for (const std::string &name : interfaces) buses.push_back(std::make_unique<tritoncan::SocketBus>(name, opts));
+    std::vector<tritoncan::Frame> batch(tritoncan::SocketBus::kBatch);
+    std::vector<uint32_t> seq(interfaces.size(), 0);
+    const int64_t start = now_ns();
+    const int64_t end = start + static_cast<int64_t>(seconds * 1e9);
+    timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (int64_t t = start; t < end; t = now_ns()) {
+        const double due = rate * static_cast<double>(t - start) / 1e9;
+        for (size_t b = 0; b < buses.size(); b++) {
+            size_t n = std::min(batch.size(), static_cast<size_t>(due) - std::min<size_t>(static_cast<size_t>(due), seq[b]));
+            for (size_t i = 0; i < n; i++) {
+                batch[i].can_id = 0x100 + static_cast<uint32_t>(b);
+                batch[i].len = 8;
+                std::memcpy(batch[i].data.data(), &seq[b], 4);
+                seq[b]++;
+            }
+            size_t done = buses[b]->send(batch.data(), n);
+            seq[b] -= static_cast<uint32_t>(n - done); // the rest goes out next tick
+            sent += done;
+        }
+        next.tv_nsec += kTickNs;
+        if (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+    }
+}
+
+template <typename Set>
+Result run(const std::vector<std::string> &interfaces, double rate, double seconds) {
+    Set set;
+    tritoncan::BusOptions opts;
+    for (const std::string &name : interfaces) set.add(name, opts);
+    Result r;
+    r.latency_us.assign(1001, 0);
+    set.on_frames([&](uint8_t, const tritoncan::Frame *frames, size_t count) {
+        const int64_t now = now_ns();
+        r.batches++;
+        r.received += count;
+        for (size_t i = 0; i < count; i++) {
+            if (!frames[i].host_time_ns) continue;
+            const int64_t us = (now - frames[i].host_time_ns) / 1000;
+            r.latency_us[static_cast<size_t>(std::clamp<int64_t>(us, 0, 1000))]++;
+        }
+    });
+
+    std::atomic<uint64_t> sent{0};
+    rusage before, after;
+    getrusage(RUSAGE_THREAD, &before);
+    const int64_t start = now_ns();
+    std::thread sender(send_loop, std::cref(interfaces), rate, seconds, std::ref(sent));
+    const int64_t end = start + static_cast<int64_t>((seconds + 0.5) * 1e9);
+    while (now_ns() < end) {
+        if (set.poll(100)) r.wakeups++;
+    }
+    sender.join();
+    while (set.poll(50)) r.wakeups++; // what is still queued
+    getrusage(RUSAGE_THREAD, &after);
+    r.wall_s = static_cast<double>(now_ns() - start) / 1e9;
+
+    auto secs = [](const timeval &tv) { return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6; };
+    r.cpu_s = secs(after.ru_utime) - secs(before.ru_utime) + secs(after.ru_stime) - secs(before.ru_stime);
+    r.voluntary_switches = after.ru_nvcsw - before.ru_nvcsw;
+    r.sent = sent;
+    for (size_t i = 0; i < set.size(); i++) r.dropped += set.bus(static_cast<uint8_t>(i)).stats().rx_dropped;
+    return r;
+}
+
+void print(const char *name, const Result &r) {
+    const double kframes = static_cast<double>(r.received) / 1000.0;
+    std::printf("%-6s received %llu/%llu (kernel drops %llu)  CPU %.1f%% of a core, %.1f us per 1000 frames\n", name,
+                static_cast<unsigned long long>(r.received), static_cast<unsigned long long>(r.sent),
+                static_cast<unsigned long long>(r.dropped), 100.0 * r.cpu_s / r.wall_s,
+                kframes > 0 ? 1e6 * r.cpu_s / kframes : 0.0);
+    std::printf("       %.0f wake-ups/s, %.1f frames per wake-up, %.1f per batch, %ld sleeps  latency p50 %.0f p99 %.0f us\n",
+                static_cast<double>(r.wakeups) / r.wall_s, r.wakeups ? static_cast<double>(r.received) / static_cast<double>(r.wakeups) : 0.0,
+                r.batches ? static_cast<double>(r.received) / static_cast<double>(r.batches) : 0.0, r.voluntary_switches,
+                percentile(r.latency_us, 0.5), percentile(r.latency_us, 0.99));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::string> interfaces;
+    double rate = 8000, seconds = 10;
+    std::string backend = "both";
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "-i" && i + 1 < argc) {
+            std::string list = argv[++i];
+            for (size_t pos = 0; pos <= list.size();) {
+                size_t comma = list.find(',', pos);
+                if (comma == std::string::npos) comma = list.size();
+                if (comma > pos) interfaces.push_back(list.substr(pos, comma - pos));
+                pos = comma + 1;
+            }
+        } else if (a == "--rate" && i + 1 < argc) rate = std::atof(argv[++i]);
+        else if (a == "--seconds" && i + 1 < argc) seconds = std::atof(argv[++i]);
+        else if (a == "--backend" && i + 1 < argc) backend = argv[++i];
+        else {
+            std::fprintf(stderr, "usage: %s [-i if0,if1,...] [--rate fps] [--seconds s] [--backend epoll|uring|both]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (interfaces.empty()) {
+        for (int i = 0; i < 8; i++) interfaces.push_back("vcan" + std::to_string(i));
+    }
+
+    try {
+        std::printf("%zu buses x %.0f frames/s for %.0f s\n", interfaces.size(), rate, seconds);
+        if (backend == "epoll" || backend == "both") print("epoll", run<tritoncan::BusSet>(interfaces, rate, seconds));
+        if (backend == "uring" || backend == "both") {
+            if (tritoncan::UringBusSet::supported()) print("uring", run<tritoncan::UringBusSet>(interfaces, rate, seconds));
+            else std::printf("uring  not available on this kernel (or blocked by seccomp)\n");
+        }
+    } catch (const std::system_error &e) {
+        std::fprintf(stderr, "tritoncan_rx_bench: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
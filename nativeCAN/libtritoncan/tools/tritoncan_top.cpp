@@ -0,0 +1,363 @@
+// Live monitor for SocketCAN buses: per ID the frame rate, period and its jitter, and the last
+// frame with its signals decoded from the DBC files given with --dbc; per bus a load bar, error
+// frame counters and kernel drops. Jitter is the standard deviation of the gaps between an ID's
+// frames, worst the largest distance of one gap from their mean, both over the last refresh.
+// One thread reads every bus through BusSet (recvmmsg on one epoll loop). A frame costs a hash
+// lookup and a few additions; only the last frame of each ID is decoded, once per refresh. The
+// header shows the tool's own CPU time per wall second. With --mmap it reads through PacketBusSet
+// instead (an AF_PACKET TPACKET_V3 ring per bus, no system call per frame; needs CAP_NET_RAW), which
+// also shows the frames this host sends.
+//
+//   tritoncan_top IFACE [IFACE ...] [--dbc file.dbc]... [-b bitrate] [-d dbitrate] [--fd] [-H]
+//                 [--interval ms] [--once] [--mmap]
+//
+// Load is the worst-case wire length of the frames seen (every possible stuff bit, as
+// td_can_bridges.bus_load), against -b / -d, which default to 1 Mbit/s. -H times periods with the
+// adapter's hardware timestamps (gs_usb with GS_CAN_MODE_HW_TIMESTAMP) instead of kernel receive
+// time. --once prints one refresh and exits.
+
+#include <linux/can/error.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "rx_core.hpp"
+#include "td_can_bridge_cpp/dbc.hpp"
+#include "tritoncan/packet.hpp"
+#include "tritoncan/socketcan.hpp"
+
+namespace {
+
+std::atomic<bool> g_stop{false};
+
+constexpr uint32_t kIdKey = tritoncan::kCanEffFlag | 0x1FFFFFFF; // IDE and ID: RTR shares its data frame's row
+constexpr int kBarWidth = 30;
+
+int64_t now_ns(clockid_t clock = CLOCK_MONOTONIC) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// bus_load.frame_bits(): nominal bit times of one data frame with every possible stuff bit
+double frame_bits(uint8_t len, bool extended, bool fd, double data_ratio) {
+    if (!fd) {
+        int g = extended ? 54 : 34;
+        return g + 8 * len + 13 + (g + 8 * len - 1) / 4;
+    }
+    int arbitration = 1 + (extended ? 31 : 12) + 2 + 1;
+    int crc = len <= 16 ? 17 : 21;
+    int data_phase = 1 + 4 + 8 * len + 4 + crc + (crc + 4 + 3) / 4;
+    int dynamic_stuff = (arbitration + 5 + 8 * len - 1) / 4;
+    return arbitration + dynamic_stuff + data_phase * data_ratio + 13;
+}
+
+const tritoncan::BusStats &bus_stats(const tritoncan::BusSet &set, uint8_t bus) { return set.bus(bus).stats(); }
+const tritoncan::BusStats &bus_stats(const tritoncan::PacketBusSet &set, uint8_t bus) { return set.stats(bus); }
+
+// A DBC message as the RX core decodes it; spec.raw for those it can't (multiplexed, over 8 bytes)
+struct Decoder {
+    const td_can_bridge::Message *message = nullptr;
+    td_can::MessageSpec spec;
+};
+
+struct IdStats {
+    uint64_t frames = 0;
+    uint64_t window = 0;      // frames since the last refresh
+    int64_t last_ns = 0;
+    // Gaps between frames since the last refresh (Welford), in ns
+    uint64_t gaps = 0;
+    double gap_mean = 0, gap_m2 = 0;
+    int64_t gap_min = 0, gap_max = 0;
+    tritoncan::Frame last;
+    const Decoder *decoder = nullptr;
+};
+
+struct BusErrors {
+    uint64_t frames = 0, bus_off = 0, passive = 0, warning = 0, protocol = 0, ack = 0, lost_arb = 0, restarted = 0;
+};
+
+struct BusView {
+    std::string name;
+    std::unordered_map<uint32_t, IdStats> ids;
+    double window_bits = 0;
+    uint64_t window_frames = 0;
+    BusErrors errors;
+};
+
+struct Options {
+    std::vector<std::string> interfaces;
+    std::vector<std::string> dbc;
+    uint32_t bitrate = 1000000, dbitrate = 0;
+    bool fd = false, hardware = false, once = false, mmap = false;
+    int interval_ms = 1000;
+};
+
+class Monitor {
+public:
+    Monitor(const Options &o, const std::vector<td_can_bridge::Database> &dbs) : opts_(o) {
+        data_ratio_ = o.fd && o.dbitrate ? static_cast<double>(o.bitrate) / o.dbitrate : 1.0;
+        for (const td_can_bridge::Database &db : dbs) {
+            for (const td_can_bridge::Message &m : db.messages()) {
+                Decoder &d = decoders_[m.frame_id | (m.extended ? tritoncan::kCanEffFlag : 0)];
+                d.message = &m;
+                d.spec.length = static_cast<uint8_t>(m.length);
+                d.spec.raw = !m.supported();
+                if (d.spec.raw) continue;
+                for (const td_can_bridge::Signal &s : m.signals) d.spec.signals.push_back(m.layout(s));
+            }
+        }
+        for (const std::string &name : o.interfaces) buses_.push_back(BusView{name, {}, 0, 0, {}});
+    }
+
+    void add(uint8_t bus, const tritoncan::Frame &f) {
+        BusView &b = buses_[bus];
+        if (f.can_id & tritoncan::kCanErrFlag) {
+            count_error(b.errors, f);
+            return;
+        }
+        bool extended = f.can_id & tritoncan::kCanEffFlag;
+        b.window_bits += frame_bits(f.len, extended, f.flags & tritoncan::kFlagFd, data_ratio_);
+        b.window_frames++;
+        auto [it, fresh] = b.ids.try_emplace(f.can_id & kIdKey);
+        IdStats &s = it->second;
+        if (fresh) {
+            auto d = decoders_.find(f.can_id & kIdKey);
+            if (d != decoders_.end()) s.decoder = &d->second;
+        }
+        int64_t t = opts_.hardware ? static_cast<int64_t>(f.timestamp_us) * 1000 : f.host_time_ns;
+        if (s.frames && t) {
+            int64_t gap = t - s.last_ns;
+            if (s.gaps == 0 || gap < s.gap_min) s.gap_min = gap;
+            if (s.gaps == 0 || gap > s.gap_max) s.gap_max = gap;
+            s.gaps++;
+            double delta = gap - s.gap_mean;
+            s.gap_mean += delta / s.gaps;
+            s.gap_m2 += delta * (gap - s.gap_mean);
+        }
+        s.last_ns = t;
+        s.frames++;
+        s.window++;
+        s.last = f;
+    }
+
+    // Redraws the whole screen and starts the next window; window_s is its length
+    template <class Set>
+    void draw(const Set &set, double window_s, double cpu) {
+        int rows = 50, cols = 160;
+        winsize ws{};
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row && ws.ws_col) {
+            rows = ws.ws_row;
+            cols = ws.ws_col;
+        }
+        std::string out = opts_.once ? "" : "\x1b[H\x1b[2J";
+        line(out, cols, "tritoncan_top  %d buses  every %.1f s  %.1f%% CPU", static_cast<int>(buses_.size()), window_s, 100.0 * cpu);
+        int left = rows - 2;
+        for (size_t i = 0; i < buses_.size() && (left > 0 || opts_.once); i++) {
+            BusView &b = buses_[i];
+            const tritoncan::BusStats &st = bus_stats(set, static_cast<uint8_t>(i));
+            double load = b.window_bits / (window_s * opts_.bitrate);
+            int filled = static_cast<int>(std::lround(std::min(load, 1.0) * kBarWidth));
+            line(out, cols, "");
+            line(out, cols, "%-8s [%s%s] %5.1f%%  %7.0f frames/s  %zu IDs  kernel drops %llu", b.name.c_str(),
+                 std::string(filled, '#').c_str(), std::string(kBarWidth - filled, '.').c_str(), 100.0 * load,
+                 b.window_frames / window_s, b.ids.size(), static_cast<unsigned long long>(st.rx_dropped.load()));
+            const BusErrors &e = b.errors;
+            line(out, cols, "         errors %llu: bus-off %llu  passive %llu  warning %llu  protocol %llu  no-ack %llu  lost-arb %llu  restarted %llu",
+                 u(e.frames), u(e.bus_off), u(e.passive), u(e.warning), u(e.protocol), u(e.ack), u(e.lost_arb), u(e.restarted));
+            line(out, cols, "  %-9s %8s %10s %10s %10s %10s  %s", "ID", "frames/s", "period ms", "jitter us", "worst us", "count", "last");
+            left -= 4;
+            std::vector<std::pair<uint32_t, IdStats *>> sorted;
+            sorted.reserve(b.ids.size());
+            for (auto &[id, s] : b.ids) sorted.emplace_back(id, &s);
+            std::sort(sorted.begin(), sorted.end(), [](const auto &x, const auto &y) { return x.first < y.first; });
+            for (auto &[id, s] : sorted) {
+                if (left <= 0 && !opts_.once) break;
+                row(out, cols, id, *s, window_s);
+                left--;
+            }
+        }
+        for (BusView &b : buses_) {
+            for (auto &[id, s] : b.ids) {
+                s.window = 0;
+                s.gaps = 0;
+                s.gap_mean = s.gap_m2 = 0;
+            }
+            b.window_bits = 0;
+            b.window_frames = 0;
+        }
+        std::fwrite(out.data(), 1, out.size(), stdout);
+        std::fflush(stdout);
+    }
+
+private:
+    static unsigned long long u(uint64_t v) { return static_cast<unsigned long long>(v); }
+
+    template <typename... Args>
+    static void line(std::string &out, int cols, const char *fmt, Args... args) {
+        char buf[1024];
+        int n = std::snprintf(buf, sizeof(buf), fmt, args...);
+        n = std::max(0, std::min({n, static_cast<int>(sizeof(buf)) - 1, cols}));
+        out.append(buf, static_cast<size_t>(n));
+        out += '\n';
+    }
+
+    static void count_error(BusErrors &e, const tritoncan::Frame &f) {
+        e.frames++;
+        uint32_t cls = f.can_id & CAN_ERR_MASK;
+        if (cls & CAN_ERR_BUSOFF) e.bus_off++;
+        if (cls & CAN_ERR_CRTL) {
+            if (f.data[1] & (CAN_ERR_CRTL_RX_PASSIVE | CAN_ERR_CRTL_TX_PASSIVE)) e.passive++;
+            else if (f.data[1] & (CAN_ERR_CRTL_RX_WARNING | CAN_ERR_CRTL_TX_WARNING)) e.warning++;
+        }
+        if (cls & CAN_ERR_PROT) e.protocol++;
+        if (cls & CAN_ERR_ACK) e.ack++;
+        if (cls & CAN_ERR_LOSTARB) e.lost_arb++;
+        if (cls & CAN_ERR_RESTARTED) e.restarted++;
+    }
+
+    // Signals of the last frame, or its payload when no supported DBC message has the ID
+    std::string last_value(const IdStats &s) {
+        const tritoncan::Frame &f = s.last;
+        std::string text;
+        char buf[64];
+        const Decoder *d = s.decoder;
+        if (d && !d->spec.raw && f.len >= d->spec.length) {
+            td_can::Decoded dec;
+            dec.len = f.len;
+            std::copy(f.data.begin(), f.data.begin() + f.len, dec.data);
+            batch_.clear();
+            td_can::RxCore::decode(d->spec, dec, batch_);
+            text = d->message->name + ":";
+            for (size_t i = 0; i < dec.count; i++) {
+                const td_can::Value &v = batch_.values[dec.first_value + i];
+                if (v.kind == td_can::Value::Float) std::snprintf(buf, sizeof(buf), "%.6g", v.d);
+                else if (v.kind == td_can::Value::Int) std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v.i));
+                else std::snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(v.u));
+                text += " " + d->message->signals[i].name + "=" + buf;
+            }
+            return text;
+        }
+        if (d) text = d->message->name + (d->spec.raw ? " (not decoded): " : " (short): ");
+        if (f.can_id & tritoncan::kCanRtrFlag) return text + "remote";
+        for (uint8_t i = 0; i < f.len; i++) {
+            std::snprintf(buf, sizeof(buf), i ? " %02X" : "%02X", f.data[i]);
+            text += buf;
+        }
+        return text;
+    }
+
+    void row(std::string &out, int cols, uint32_t id, const IdStats &s, double window_s) {
+        char name[16];
+        if (id & tritoncan::kCanEffFlag) std::snprintf(name, sizeof(name), "%08X", id & 0x1FFFFFFF);
+        else std::snprintf(name, sizeof(name), "%03X", id & 0x7FF);
+        char period[16] = "-", jitter[16] = "-", worst[16] = "-";
+        if (s.gaps) {
+            std::snprintf(period, sizeof(period), "%.3f", s.gap_mean / 1e6);
+            std::snprintf(worst, sizeof(worst), "%.0f", std::max(s.gap_max - s.gap_mean, s.gap_mean - s.gap_min) / 1e3);
+        }
+        if (s.gaps > 1) std::snprintf(jitter, sizeof(jitter), "%.1f", std::sqrt(s.gap_m2 / (s.gaps - 1)) / 1e3);
+        line(out, cols, "  %-9s %8.1f %10s %10s %10s %10llu  %s", name, s.window / window_s, period, jitter, worst,
+             u(s.frames), last_value(s).c_str());
+    }
+
+    const Options &opts_;
+    double data_ratio_ = 1.0;
+    std::unordered_map<uint32_t, Decoder> decoders_; // by ID, CAN_EFF_FLAG included
+    std::vector<BusView> buses_;
+    td_can::Batch batch_;
+};
+
+int usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s IFACE [IFACE ...] [--dbc file.dbc]... [-b bitrate] [-d dbitrate] [--fd] [-H]\n"
+                 "          [--interval ms] [--once] [--mmap]\n",
+                 argv0);
+    return 2;
+}
+
+// Reads every bus of set into monitor and redraws each interval until stopped
+template <class Set>
+void run(Set &set, Monitor &monitor, const Options &o) {
+    set.on_frames([&](uint8_t bus, const tritoncan::Frame *frames, size_t count) {
+        for (size_t i = 0; i < count; i++) monitor.add(bus, frames[i]);
+    });
+    const int64_t interval = static_cast<int64_t>(o.interval_ms) * 1000000;
+    int64_t start = now_ns(), next = start + interval;
+    int64_t cpu_start = now_ns(CLOCK_PROCESS_CPUTIME_ID);
+    while (!g_stop) {
+        int64_t left = next - now_ns();
+        if (left > 0) {
+            set.poll(static_cast<int>((left + 999999) / 1000000));
+            continue;
+        }
+        int64_t now = now_ns(), cpu = now_ns(CLOCK_PROCESS_CPUTIME_ID);
+        double window_s = (now - start) / 1e9;
+        monitor.draw(set, window_s, (cpu - cpu_start) / 1e9 / window_s);
+        if (o.once) break;
+        start = now;
+        cpu_start = cpu;
+        next = now + interval;
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--dbc" && more) o.dbc.push_back(argv[++i]);
+        else if (a == "-b" && more) o.bitrate = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+        else if (a == "-d" && more) o.dbitrate = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+        else if (a == "--fd") o.fd = true;
+        else if (a == "-H") o.hardware = true;
+        else if (a == "--interval" && more) o.interval_ms = std::max(100, std::atoi(argv[++i]));
+        else if (a == "--once") o.once = true;
+        else if (a == "--mmap") o.mmap = true;
+        else if (!a.empty() && a[0] != '-') o.interfaces.push_back(a);
+        else return usage(argv[0]);
+    }
+    if (o.interfaces.empty() || o.bitrate == 0) return usage(argv[0]);
+    std::signal(SIGINT, [](int) { g_stop = true; });
+    std::signal(SIGTERM, [](int) { g_stop = true; });
+
+    try {
+        std::vector<td_can_bridge::Database> dbs;
+        for (const std::string &path : o.dbc) dbs.push_back(td_can_bridge::Database::load(path));
+        Monitor monitor(o, dbs);
+        const auto timestamps = o.hardware ? tritoncan::Timestamps::Hardware : tritoncan::Timestamps::Software;
+        if (o.mmap) {
+            // Every frame of the interface, FD and error frames included: no socket options to set
+            tritoncan::PacketBusSet set;
+            tritoncan::PacketOptions opts;
+            opts.timestamps = timestamps;
+            for (const std::string &name : o.interfaces) set.add(name, opts);
+            run(set, monitor, o);
+        } else {
+            tritoncan::BusSet set;
+            tritoncan::BusOptions opts;
+            opts.fd = o.fd;
+            opts.error_frames = true;
+            opts.timestamps = timestamps;
+            for (const std::string &name : o.interfaces) set.add(name, opts);
+            run(set, monitor, o);
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "tritoncan_top: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
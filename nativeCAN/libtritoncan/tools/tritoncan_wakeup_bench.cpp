@@ -0,0 +1,267 @@
+// Wake-up latency of one receiver per mode: a blocking read(), epoll_wait + recvmmsg (what BusSet
+// does) and the Python bridge's busy-poll core (rx_busy_poll: a BusyPoller thread spinning on
+// recvmmsg, handing frames to RxCore::poll through its ring). A sender thread writes one frame per
+// --interval-us carrying its CLOCK_MONOTONIC send time, so every frame finds the receiver idle;
+// the latency is send -> frame in the receiver's hands. Reports the distribution and the
+// receiver's CPU use.
+//
+//   tritoncan_wakeup_bench [-i vcan0] [--mode blocking|epoll|busy|all] [--seconds s] [--interval-us us]
+//                          [--cpu n] [--poll-cpu n] [--spin-us us] [--hog]
+//
+// --cpu pins the receiving thread (for busy: the one calling poll()), --poll-cpu the busy poller
+// (default: --cpu + 1). --hog adds a thread spinning on --cpu, as on a shared core. --spin-us is
+// how long poll() spins on the busy ring before it sleeps (default -1: always).
+//
+// Defaults: vcan0, every mode for 5 s each, a frame every 1000 us, unpinned.
+//   sudo ip link add vcan0 type vcan && sudo ip link set up vcan0
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/can.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "busy_poll.hpp"
+#include "rx_core.hpp"
+#include "tritoncan/socketcan.hpp"
+
+namespace {
+
+constexpr uint32_t kId = 0x321;
+constexpr size_t kBuckets = 2001; // 1 µs up to 2 ms, the last one for the rest
+
+int64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+double cpu_s(int who) {
+    rusage r;
+    getrusage(who, &r);
+    auto secs = [](const timeval &tv) { return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6; };
+    return secs(r.ru_utime) + secs(r.ru_stime);
+}
+
+void pin(int cpu) {
+    if (cpu < 0) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+        std::fprintf(stderr, "CPU %d: %s, running unpinned\n", cpu, std::strerror(error));
+}
+
+struct Options {
+    std::string interface = "vcan0";
+    double seconds = 5;
+    int interval_us = 1000;
+    int cpu = -1, poll_cpu = -1, spin_us = -1;
+    bool hog = false;
+};
+
+struct Result {
+    std::vector<uint64_t> latency_us = std::vector<uint64_t>(kBuckets);
+    uint64_t frames = 0;
+    int64_t max_ns = 0;
+    double cpu_s = 0; // the receiver's threads, the sender excluded
+    double wall_s = 0;
+
+    void add(const uint8_t *data, int64_t now) {
+        int64_t sent;
+        std::memcpy(&sent, data, sizeof(sent));
+        const int64_t ns = now - sent;
+        max_ns = std::max(max_ns, ns);
+        latency_us[static_cast<size_t>(std::clamp<int64_t>(ns / 1000, 0, kBuckets - 1))]++;
+        frames++;
+    }
+};
+
+double percentile(const std::vector<uint64_t> &hist, double q) {
+    uint64_t total = 0;
+    for (uint64_t c : hist) total += c;
+    uint64_t acc = 0;
+    for (size_t i = 0; i < hist.size(); i++) {
+        acc += hist[i];
+        if (acc >= q * total) return static_cast<double>(i);
+    }
+    return 0;
+}
+
+// One frame per interval on its own socket, stamped just before the write
+void send_loop(const Options &o, std::atomic<bool> &done, double &sender_cpu) {
+    tritoncan::BusOptions opts;
+    opts.timestamps = tritoncan::Timestamps::None;
+    tritoncan::SocketBus bus(o.interface, opts);
+    tritoncan::Frame f;
+    f.can_id = kId;
+    f.len = 8;
+    timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    const int64_t end = now_ns() + static_cast<int64_t>(o.seconds * 1e9);
+    while (now_ns() < end) {
+        next.tv_nsec += o.interval_us * 1000L;
+        while (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+        const int64_t t = now_ns();
+        std::memcpy(f.data.data(), &t, sizeof(t));
+        bus.send(&f, 1);
+    }
+    sender_cpu = cpu_s(RUSAGE_THREAD);
+    done = true;
+}
+
+// Frames of a can_frame socket read with plain read(): one wake-up per frame
+void run_blocking(const Options &o, int fd, const std::atomic<bool> &done, Result &r) {
+    pin(o.cpu);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    timeval tv{0, 100000}; // so the loop sees done
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    canfd_frame frame;
+    while (!done) {
+        ssize_t n = read(fd, &frame, sizeof(frame));
+        if (n >= static_cast<ssize_t>(CAN_MTU) && (frame.can_id & CAN_EFF_MASK) == kId) r.add(frame.data, now_ns());
+    }
+}
+
+void run_epoll(const Options &o, int fd, const std::atomic<bool> &done, Result &r) {
+    pin(o.cpu);
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+    std::vector<canfd_frame> frames(64);
+    std::vector<iovec> iov(frames.size());
+    std::vector<mmsghdr> hdrs(frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+        iov[i] = {&frames[i], sizeof(canfd_frame)};
+        hdrs[i] = {};
+        hdrs[i].msg_hdr.msg_iov = &iov[i];
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+    }
+    while (!done) {
+        if (epoll_wait(ep, &ev, 1, 100) <= 0) continue;
+        int n = recvmmsg(fd, hdrs.data(), static_cast<unsigned>(hdrs.size()), MSG_DONTWAIT, nullptr);
+        const int64_t now = now_ns();
+        for (int i = 0; i < n; i++) {
+            if ((frames[i].can_id & CAN_EFF_MASK) == kId) r.add(frames[i].data, now);
+        }
+    }
+    close(ep);
+}
+
+void run_busy(const Options &o, int fd, const std::atomic<bool> &done, Result &r) {
+    td_can::RxCore core(fd, 64);
+    td_can::MessageSpec raw;
+    raw.length = 8;
+    raw.raw = true; // the payload back as bytes: the send time
+    core.set_message(kId, false, raw);
+    core.set_busy(4096, o.spin_us);
+    td_can::BusyPoller poller(o.poll_cpu >= 0 ? o.poll_cpu : (o.cpu >= 0 ? o.cpu + 1 : -1));
+    if (poller.thread_error()) std::fprintf(stderr, "busy poller: %s, running unpinned\n", std::strerror(poller.thread_error()));
+    poller.add(core);
+    std::thread stopper([&] {
+        while (!done) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        core.stop();
+    });
+    pin(o.cpu);
+    td_can::Batch batch;
+    while (core.poll(100, batch)) {
+        const int64_t now = now_ns();
+        for (const td_can::Decoded &d : batch.frames) r.add(d.data, now);
+    }
+    stopper.join();
+    poller.remove(core);
+}
+
+template <class Run>
+Result measure(const Options &o, Run run) {
+    tritoncan::BusOptions opts;
+    opts.timestamps = tritoncan::Timestamps::None;
+    tritoncan::SocketBus bus(o.interface, opts);
+    std::atomic<bool> done{false}, hog_done{false};
+    std::thread hog;
+    if (o.hog) {
+        hog = std::thread([&] {
+            pin(o.cpu);
+            while (!hog_done.load(std::memory_order_relaxed)) {
+            }
+        });
+    }
+    Result r;
+    double sender_cpu = 0;
+    const double cpu_before = cpu_s(RUSAGE_SELF);
+    const int64_t start = now_ns();
+    std::thread sender(send_loop, std::cref(o), std::ref(done), std::ref(sender_cpu));
+    run(o, bus.fd(), done, r);
+    sender.join();
+    r.wall_s = static_cast<double>(now_ns() - start) / 1e9;
+    hog_done = true;
+    if (hog.joinable()) hog.join();
+    // The hog's time falls in RUSAGE_SELF too; it is one core for the whole run
+    r.cpu_s = cpu_s(RUSAGE_SELF) - cpu_before - sender_cpu - (o.hog ? r.wall_s : 0.0);
+    return r;
+}
+
+void print(const char *name, const Result &r) {
+    std::printf("%-8s %7llu frames  p50 %4.0f  p90 %4.0f  p99 %4.0f  p99.9 %4.0f  max %6.1f us  CPU %5.1f%% of a core\n",
+                name, static_cast<unsigned long long>(r.frames), percentile(r.latency_us, 0.5),
+                percentile(r.latency_us, 0.9), percentile(r.latency_us, 0.99), percentile(r.latency_us, 0.999),
+                static_cast<double>(r.max_ns) / 1000.0, r.wall_s > 0 ? 100.0 * std::max(0.0, r.cpu_s) / r.wall_s : 0.0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options o;
+    std::string mode = "all";
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "-i" && i + 1 < argc) o.interface = argv[++i];
+        else if (a == "--mode" && i + 1 < argc) mode = argv[++i];
+        else if (a == "--seconds" && i + 1 < argc) o.seconds = std::atof(argv[++i]);
+        else if (a == "--interval-us" && i + 1 < argc) o.interval_us = std::max(1, std::atoi(argv[++i]));
+        else if (a == "--cpu" && i + 1 < argc) o.cpu = std::atoi(argv[++i]);
+        else if (a == "--poll-cpu" && i + 1 < argc) o.poll_cpu = std::atoi(argv[++i]);
+        else if (a == "--spin-us" && i + 1 < argc) o.spin_us = std::atoi(argv[++i]);
+        else if (a == "--hog") o.hog = true;
+        else {
+            std::fprintf(stderr,
+                         "usage: %s [-i vcan0] [--mode blocking|epoll|busy|all] [--seconds s] [--interval-us us]\n"
+                         "       [--cpu n] [--poll-cpu n] [--spin-us us] [--hog]\n",
+                         argv[0]);
+            return 2;
+        }
+    }
+
+    try {
+        std::printf("%s: a frame every %d us for %.0f s per mode%s\n", o.interface.c_str(), o.interval_us, o.seconds,
+                    o.hog ? ", a spinning thread on the receiver's CPU" : "");
+        if (mode == "blocking" || mode == "all") print("blocking", measure(o, run_blocking));
+        if (mode == "epoll" || mode == "all") print("epoll", measure(o, run_epoll));
+        if (mode == "busy" || mode == "all") print("busy", measure(o, run_busy));
+    } catch (const std::system_error &e) {
+        std::fprintf(stderr, "tritoncan_wakeup_bench: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,175 @@
+// tritoncand: owns CAN interfaces once and fans their traffic out through shared memory. Every
+// frame is received by one socket and published into /dev/shm/tritoncan.<interface>, where any
+// number of clients (ShmClient, or td_can_bridges' "tritoncand" python-can interface) read it in
+// place; what they queue in their TX rings goes out on the same socket.
+//
+//   tritoncand can0 [can1 ...] [--backend epoll|uring] [--timestamps none|software|hardware] [--fd]
+//              [--slots n] [--tx-slots n] [--clients n] [--mode octal] [--stats s]
+//
+// SIGINT / SIGTERM unlink the segments; clients see the daemon gone and close.
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "tritoncan/shm.hpp"
+#include "tritoncan/socketcan.hpp"
+#include "tritoncan/uring.hpp"
+
+namespace {
+
+volatile std::sig_atomic_t stopping = 0;
+
+void on_signal(int) {
+    stopping = 1;
+}
+
+struct Options {
+    std::vector<std::string> interfaces;
+    std::string backend = "epoll";
+    tritoncan::BusOptions bus;
+    uint32_t slots = 65536; // 6 MiB per interface: several seconds of a saturated 1 Mbit/s bus
+    uint32_t tx_slots = 1024;
+    uint32_t clients = 32;
+    unsigned mode = 0660;
+    double stats_s = 0;
+};
+
+double now_s() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+// One per interface: drains the clients' TX rings onto the bus and frees the slots of dead clients
+template <typename Set>
+void tx_loop(Set &set, uint8_t bus, tritoncan::ShmPublisher &pub) {
+    std::vector<tritoncan::Frame> batch(tritoncan::SocketBus::kBatch);
+    double next_reap = 0;
+    while (!stopping) {
+        const uint32_t seen = pub.tx_seen();
+        uint32_t client = 0;
+        const size_t n = pub.take_tx(client, batch.data(), batch.size());
+        if (n) {
+            const size_t sent = set.send(bus, batch.data(), n);
+            pub.consume_tx(client, sent);
+            if (sent < n) {
+                // Interface queue full: the rest stays in the client's ring
+                pub.header().tx_busy.fetch_add(1, std::memory_order_relaxed);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            continue;
+        }
+        const double t = now_s();
+        if (t >= next_reap) {
+            pub.reap();
+            pub.header().rx_dropped.store(set.bus(bus).stats().rx_dropped, std::memory_order_relaxed);
+            next_reap = t + 0.5;
+        }
+        pub.wait_tx(seen, 100);
+    }
+}
+
+void print_stats(const Options &o, std::vector<std::unique_ptr<tritoncan::ShmPublisher>> &pubs) {
+    for (size_t i = 0; i < pubs.size(); i++) {
+        tritoncan::ShmHeader &h = pubs[i]->header();
+        const uint64_t write = h.write_seq.load(std::memory_order_relaxed);
+        std::printf("%s: rx %llu (kernel drops %llu), tx %llu (busy %llu)", o.interfaces[i].c_str(),
+                    static_cast<unsigned long long>(h.rx_frames.load()), static_cast<unsigned long long>(h.rx_dropped.load()),
+                    static_cast<unsigned long long>(h.tx_frames.load()), static_cast<unsigned long long>(h.tx_busy.load()));
+        for (uint32_t c = 0; c < h.max_clients; c++) {
+            tritoncan::ShmClientSlot &s = pubs[i]->client(c);
+            const uint32_t pid = s.owner.load(std::memory_order_relaxed);
+            if (!pid) continue;
+            std::printf("  [%u %.8s pid %u: behind %llu, lost %llu, tx full %llu]", c, s.name, pid,
+                        static_cast<unsigned long long>(write - s.cursor.load()),
+                        static_cast<unsigned long long>(s.lost.load()), static_cast<unsigned long long>(s.tx_full.load()));
+        }
+        std::printf("\n");
+    }
+    std::fflush(stdout);
+}
+
+template <typename Set>
+void serve(const Options &o) {
+    Set set;
+    std::vector<std::unique_ptr<tritoncan::ShmPublisher>> pubs;
+    for (const std::string &name : o.interfaces) {
+        set.add(name, o.bus);
+        pubs.push_back(std::make_unique<tritoncan::ShmPublisher>(name, o.slots, o.clients, o.tx_slots, o.mode));
+    }
+    set.on_frames([&](uint8_t bus, const tritoncan::Frame *frames, size_t count) { pubs[bus]->publish(frames, count); });
+
+    std::vector<std::thread> tx;
+    for (size_t i = 0; i < pubs.size(); i++) tx.emplace_back(tx_loop<Set>, std::ref(set), static_cast<uint8_t>(i), std::ref(*pubs[i]));
+    std::fprintf(stderr, "tritoncand: serving %zu interface(s)\n", pubs.size());
+
+    double next_stats = now_s() + o.stats_s;
+    while (!stopping) {
+        set.poll(100);
+        if (o.stats_s > 0 && now_s() >= next_stats) {
+            print_stats(o, pubs);
+            next_stats += o.stats_s;
+        }
+    }
+    for (std::thread &t : tx) t.join();
+}
+
+int usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s IFACE [IFACE ...] [--backend epoll|uring] [--timestamps none|software|hardware] [--fd]\n"
+                 "       [--slots n] [--tx-slots n] [--clients n] [--mode octal] [--stats s]\n",
+                 argv0);
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        const bool more = i + 1 < argc;
+        if (a == "--backend" && more) o.backend = argv[++i];
+        else if (a == "--timestamps" && more) {
+            std::string t = argv[++i];
+            if (t == "none") o.bus.timestamps = tritoncan::Timestamps::None;
+            else if (t == "software") o.bus.timestamps = tritoncan::Timestamps::Software;
+            else if (t == "hardware") o.bus.timestamps = tritoncan::Timestamps::Hardware;
+            else return usage(argv[0]);
+        } else if (a == "--fd") o.bus.fd = true;
+        else if (a == "--slots" && more) o.slots = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+        else if (a == "--tx-slots" && more) o.tx_slots = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+        else if (a == "--clients" && more) o.clients = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+        else if (a == "--mode" && more) o.mode = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 8));
+        else if (a == "--stats" && more) o.stats_s = std::atof(argv[++i]);
+        else if (!a.empty() && a[0] != '-') o.interfaces.push_back(a);
+        else return usage(argv[0]);
+    }
+    if (o.interfaces.empty() || (o.backend != "epoll" && o.backend != "uring")) return usage(argv[0]);
+
+    struct sigaction sa {};
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    try {
+        if (o.backend == "uring" && !tritoncan::UringBusSet::supported()) {
+            std::fprintf(stderr, "tritoncand: io_uring not available here, using epoll\n");
+            o.backend = "epoll";
+        }
+        if (o.backend == "uring") serve<tritoncan::UringBusSet>(o);
+        else serve<tritoncan::BusSet>(o);
+    } catch (const std::system_error &e) {
+        std::fprintf(stderr, "tritoncand: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -3,82 +3,24 @@ import time
 import struct
 import math
 
+import robostride
+
 # Configuration
 CHANNEL = 'can0'
 BITRATE = 1000000  # 1 Mbps
-MOTOR_ID = 0x01    # Default ID, change if needed
+MOTOR_IDS = [0x01] # Default ID, add more to drive several motors per cycle
 DT = 0.01          # Loop period
 
-# MIT Protocol Ranges (Estimated for RS02)
-P_MIN = -12.57
-P_MAX = 12.57
-V_MIN = -30.0
-V_MAX = 30.0
-KP_MIN = 0.0
-KP_MAX = 500.0
-KD_MIN = 0.0
-KD_MAX = 5.0
-T_MIN = -17.0
-T_MAX = 17.0
-
-def float_to_uint(x, x_min, x_max, bits):
-    span = x_max - x_min
-    offset = x_min
-    if x > x_max: x = x_max
-    elif x < x_min: x = x_min
-    return int((x - offset) * ((1 << bits) - 1) / span)
-
-def uint_to_float(x_int, x_min, x_max, bits):
-    span = x_max - x_min
-    offset = x_min
-    return (float(x_int) * span / ((1 << bits) - 1)) + offset
+# MIT protocol ranges for the motor model, from the shared RoboStride codec
+MODEL = 'RS02'
+LIMITS = robostride.limits(MODEL)
 
-def pack_cmd(p_des, v_des, kp, kd, t_ff):
+def send_cycle(bus, cmd):
     """
-    Pack the command into 8 bytes using MIT protocol.
+    Send the same (p_des, v_des, t_ff, kp, kd) command to every motor, MIT protocol.
     """
-    p_int = float_to_uint(p_des, P_MIN, P_MAX, 16)
-    v_int = float_to_uint(v_des, V_MIN, V_MAX, 12)
-    kp_int = float_to_uint(kp, KP_MIN, KP_MAX, 12)
-    kd_int = float_to_uint(kd, KD_MIN, KD_MAX, 12)
-    t_int = float_to_uint(t_ff, T_MIN, T_MAX, 12)
-
-    # Packing (Standard MIT/Mini Cheetah format)
-    # 0: p_int[15:8]
-    # 1: p_int[7:0]
-    # 2: v_int[11:4]
-    # 3: v_int[3:0] | kp_int[11:8]
-    # 4: kp_int[7:0]
-    # 5: kd_int[11:4]
-    # 6: kd_int[3:0] | t_int[11:8]
-    # 7: t_int[7:0]
-    
-    data = [0] * 8
-    data[0] = (p_int >> 8) & 0xFF
-    data[1] = p_int & 0xFF
-    data[2] = (v_int >> 4) & 0xFF
-    data[3] = ((v_int & 0xF) << 4) | ((kp_int >> 8) & 0xF)
-    data[4] = kp_int & 0xFF
-    data[5] = (kd_int >> 4) & 0xFF
-    data[6] = ((kd_int & 0xF) << 4) | ((t_int >> 8) & 0xF)
-    data[7] = t_int & 0xFF
-    
-    return data
-
-def unpack_reply(data):
-    """
-    Unpack the reply from the motor.
-    """
-    id = data[0]
-    p_int = (data[1] << 8) | data[2]
-    v_int = (data[3] << 4) | (data[4] >> 4)
-    t_int = ((data[4] & 0xF) << 8) | data[5]
-    
-    p = uint_to_float(p_int, P_MIN, P_MAX, 16)
-    v = uint_to_float(v_int, V_MIN, V_MAX, 12)
-    t = uint_to_float(t_int, T_MIN, T_MAX, 12)
-    
-    return p, v, t
+    for motor_id, data in robostride.pack_many(LIMITS, MOTOR_IDS, [cmd] * len(MOTOR_IDS), robostride.MIT):
+        bus.send(can.Message(arbitration_id=motor_id, data=data, is_extended_id=False))
 
 def enable_motor(bus, motor_id):
     """
@@ -121,7 +63,8 @@ def main():
     print("Starting Motor Demo...")
     
     try:
-        enable_motor(bus, MOTOR_ID)
+        for motor_id in MOTOR_IDS:
+            enable_motor(bus, motor_id)
         
         # Spin slowly
         # We use velocity control: p_des=0, v_des=target, kp=0, kd=1.0, t_ff=0
@@ -129,30 +72,32 @@ def main():
         
         start_time = time.time()
         while time.time() - start_time < 5.0: # Run for 5 seconds
-            data = pack_cmd(0.0, target_vel, 0.0, 1.0, 0.0)
-            msg = can.Message(arbitration_id=MOTOR_ID, data=data, is_extended_id=False)
-            bus.send(msg)
+            send_cycle(bus, (0.0, target_vel, 0.0, 0.0, 1.0))
             
-            # Try to read reply (non-blocking)
+            # Try to read the replies (non-blocking)
+            replies = []
             msg = bus.recv(timeout=0.001)
-            if msg:
-                # print(f"Received: {msg.data.hex()}")
+            while msg:
+                replies.append((msg.arbitration_id, msg.data))
+                msg = bus.recv(timeout=0.0) if len(replies) < len(MOTOR_IDS) else None
+            for fb in robostride.unpack_many(LIMITS, replies, robostride.MIT):
+                # print(f"Motor {fb.motor_id}: p={fb.pos:.2f} v={fb.vel:.2f} t={fb.torque:.2f}")
                 pass
                 
             time.sleep(DT)
             
         print("Stopping...")
         # Stop the motor
-        data = pack_cmd(0.0, 0.0, 0.0, 1.0, 0.0)
-        msg = can.Message(arbitration_id=MOTOR_ID, data=data, is_extended_id=False)
-        bus.send(msg)
+        send_cycle(bus, (0.0, 0.0, 0.0, 0.0, 1.0))
         time.sleep(0.5)
         
-        disable_motor(bus, MOTOR_ID)
+        for motor_id in MOTOR_IDS:
+            disable_motor(bus, motor_id)
         
     except KeyboardInterrupt:
         print("\nInterrupted!")
-        disable_motor(bus, MOTOR_ID)
+        for motor_id in MOTOR_IDS:
+            disable_motor(bus, motor_id)
     except Exception as e:
         print(f"Error: {e}")
 
@@ -0,0 +1,223 @@
+import struct
+import time
+from collections import namedtuple
+
+from robostride_models import MODELS
+
+# RobStride codec for the host tools: the same packing as components/robostride/include/robostride.h
+# in the firmware, with the per-model ranges from robostride_models.py (generated from the model
+# metadata). Scales are computed once per model, so packing is a multiply per field.
+# Both protocols of the metadata are here: 'robostride_private' (29-bit IDs, 16-bit fields) and
+# 'mit' (11-bit IDs, 12/16-bit fields). pack_many / unpack_many do a cycle of N motors at once.
+# Running this file prints a packs-per-second microbenchmark.
+
+TYPE_OP_CONTROL = 1
+TYPE_FEEDBACK = 2
+TYPE_ENABLE = 3
+TYPE_STOP = 4
+
+PRIVATE = 'robostride_private'
+MIT = 'mit'
+
+Feedback = namedtuple('Feedback', 'motor_id fault mode pos vel torque temp')
+
+class Range:
+    __slots__ = ('lo', 'hi', 'enc', 'dec')
+
+    def __init__(self, lo, hi):
+        self.lo, self.hi = lo, hi
+        self.enc = 65535.0 / (hi - lo)
+        self.dec = (hi - lo) / 65535.0
+
+    def encode(self, x):
+        u = (x - self.lo) * self.enc
+        if u <= 0.0:
+            return 0
+        if u >= 65535.0:
+            return 65535
+        return int(u)
+
+    def decode(self, u):
+        return u * self.dec + self.lo
+
+class Limits:
+    def __init__(self, model):
+        pos, vel, torque, kp, kd, self.temp_scale = MODELS[model]
+        self.model = model
+        self.p, self.v, self.t, self.kp, self.kd = (Range(*r) for r in (pos, vel, torque, kp, kd))
+
+_limits = {}
+
+def limits(model):
+    """Scales for 'RS02', 'RS03' or 'RS04', built once."""
+    if model not in _limits:
+        _limits[model] = Limits(model)
+    return _limits[model]
+
+# 12-bit MIT fields, rescaled from the 16-bit code in fixed point as in the firmware
+def code12(c16):
+    y = c16 * 4095 + 32767
+    return (y + (y >> 16) + 1) >> 16
+
+def code16(c12):
+    return (c12 << 4) | (c12 >> 8)
+
+def build_ext_id(motor_id, data, comm_type):
+    return motor_id | (data << 8) | ((comm_type & 0x1F) << 24)
+
+def ext_id_type(can_id):
+    return (can_id >> 24) & 0x1F
+
+def pack_op_control(lim, motor_id, pos, vel, torque, kp, kd):
+    """Type 1: returns (extended CAN ID, 8-byte payload)."""
+    data = struct.pack('>4H', lim.p.encode(pos), lim.v.encode(vel), lim.kp.encode(kp), lim.kd.encode(kd))
+    return build_ext_id(motor_id, lim.t.encode(torque), TYPE_OP_CONTROL), data
+
+def pack_op_control_batch(lims, motor_ids, cmds):
+    """Type 1 for several motors: cmds[i] is (pos, vel, torque, kp, kd) for motor_ids[i], scaled
+    with lims[i]. Returns a list of (extended CAN ID, payload)."""
+    return pack_many(lims, motor_ids, cmds, PRIVATE)
+
+_structs = {}
+
+def _struct(n, fields=4):
+    if (n, fields) not in _structs:
+        _structs[n, fields] = struct.Struct('>' + '%dH' % fields * n)
+    return _structs[n, fields]
+
+def _codes(lim, cmds):
+    # Range.encode of every field, one flat list in (pos, vel, kp, kd, torque) order; the scales
+    # are read once for the whole cycle and the clamps are inline instead of a call per field
+    p, v, t, k, d = lim.p, lim.v, lim.t, lim.kp, lim.kd
+    plo, penc, vlo, venc, tlo, tenc = p.lo, p.enc, v.lo, v.enc, t.lo, t.enc
+    klo, kenc, dlo, denc = k.lo, k.enc, d.lo, d.enc
+    out = []
+    for pos, vel, torque, kp, kd in cmds:
+        a = (pos - plo) * penc
+        b = (vel - vlo) * venc
+        e = (kp - klo) * kenc
+        f = (kd - dlo) * denc
+        g = (torque - tlo) * tenc
+        out += (0 if a <= 0.0 else 65535 if a >= 65535.0 else int(a),
+                0 if b <= 0.0 else 65535 if b >= 65535.0 else int(b),
+                0 if e <= 0.0 else 65535 if e >= 65535.0 else int(e),
+                0 if f <= 0.0 else 65535 if f >= 65535.0 else int(f),
+                0 if g <= 0.0 else 65535 if g >= 65535.0 else int(g))
+    return out
+
+def pack_many(lims, motor_ids, cmds, protocol=PRIVATE):
+    """One cycle for N motors: cmds[i] is (pos, vel, torque, kp, kd) for motor_ids[i]; lims is one
+    Limits for every motor or a list of them. Returns a list of (CAN ID, payload): type 1 frames
+    (29-bit IDs) for PRIVATE, MIT command 3 frames (11-bit ID = motor ID) for MIT."""
+    n = len(motor_ids)
+    if isinstance(lims, Limits):
+        c = _codes(lims, cmds)
+    else:
+        c = [u for lim, cmd in zip(lims, cmds) for u in _codes(lim, (cmd,))]
+    if protocol == PRIVATE:
+        # Packed as 10 bytes per motor, so each payload is a slice and the torque trails it
+        buf = _struct(n, 5).pack(*c)
+        return [(m | (c[5 * i + 4] << 8) | (TYPE_OP_CONTROL << 24), buf[10 * i:10 * i + 8])
+                for i, m in enumerate(motor_ids)]
+    if protocol == MIT:
+        out = []
+        for i in range(0, 5 * n, 5):
+            p, v, kp, kd, t = c[i], code12(c[i + 1]), code12(c[i + 2]), code12(c[i + 3]), code12(c[i + 4])
+            out.append(bytes((p >> 8, p & 0xFF, v >> 4, ((v & 0xF) << 4) | (kp >> 8), kp & 0xFF,
+                              kd >> 4, ((kd & 0xF) << 4) | (t >> 8), t & 0xFF)))
+        return list(zip(motor_ids, out))
+    raise ValueError(f"unknown protocol '{protocol}', expected '{PRIVATE}' or '{MIT}'")
+
+def decode_feedback(lim, can_id, data):
+    """Type 2. The caller has checked ext_id_type(can_id) == TYPE_FEEDBACK."""
+    p, v, t, temp = struct.unpack_from('>4H', data)
+    return Feedback((can_id >> 8) & 0xFF, (can_id >> 16) & 0x3F, (can_id >> 22) & 0x3,
+                    lim.p.decode(p), lim.v.decode(v), lim.t.decode(t), temp * lim.temp_scale)
+
+def pack_mit(lim, pos, vel, kp, kd, torque):
+    """MIT command 3 (standard frame, ID = motor CAN_ID): 8-byte payload."""
+    p = lim.p.encode(pos)
+    v = code12(lim.v.encode(vel))
+    kp12 = code12(lim.kp.encode(kp))
+    kd12 = code12(lim.kd.encode(kd))
+    t = code12(lim.t.encode(torque))
+    return bytes((p >> 8, p & 0xFF, v >> 4, ((v & 0xF) << 4) | (kp12 >> 8), kp12 & 0xFF,
+                  kd12 >> 4, ((kd12 & 0xF) << 4) | (t >> 8), t & 0xFF))
+
+def decode_mit_feedback(lim, data):
+    """MIT response 1: (motor_id, pos, vel, torque)."""
+    p = (data[1] << 8) | data[2]
+    v = (data[3] << 4) | (data[4] >> 4)
+    t = ((data[4] & 0xF) << 8) | data[5]
+    return data[0], lim.p.decode(p), lim.v.decode(code16(v)), lim.t.decode(code16(t))
+
+def unpack_many(lims, frames, protocol=PRIVATE):
+    """Replies of one cycle: frames is a list of (CAN ID, 8-byte payload), lims one Limits or one
+    per frame. Returns a Feedback per frame. MIT replies carry no fault, mode or temperature
+    (None), and their motor ID is the payload's first byte."""
+    if protocol == PRIVATE:
+        if isinstance(lims, Limits):
+            p, v, t, temp_scale = lims.p, lims.v, lims.t, lims.temp_scale
+            pd, plo, vd, vlo, td, tlo = p.dec, p.lo, v.dec, v.lo, t.dec, t.lo
+            raw = struct.iter_unpack('>4H', b''.join(bytes(data[:8]) for _, data in frames))
+            return [Feedback((can_id >> 8) & 0xFF, (can_id >> 16) & 0x3F, (can_id >> 22) & 0x3,
+                             pu * pd + plo, vu * vd + vlo, tu * td + tlo, temp * temp_scale)
+                    for (can_id, _), (pu, vu, tu, temp) in zip(frames, raw)]
+        return [decode_feedback(lim, can_id, data) for lim, (can_id, data) in zip(lims, frames)]
+    if protocol == MIT:
+        if isinstance(lims, Limits):
+            p, v, t = lims.p, lims.v, lims.t
+            pd, plo, vd, vlo, td, tlo = p.dec, p.lo, v.dec, v.lo, t.dec, t.lo
+            out = []
+            for _, d in frames:
+                vu = (d[3] << 4) | (d[4] >> 4)
+                tu = ((d[4] & 0xF) << 8) | d[5]
+                # code16() inline: a call per field costs as much as the decode
+                out.append(Feedback(d[0], None, None, ((d[1] << 8) | d[2]) * pd + plo,
+                                    ((vu << 4) | (vu >> 8)) * vd + vlo, ((tu << 4) | (tu >> 8)) * td + tlo, None))
+            return out
+        return [Feedback(motor_id, None, None, pos, vel, torque, None)
+                for motor_id, pos, vel, torque in (decode_mit_feedback(lim, data)
+                                                   for lim, (_, data) in zip(lims, frames))]
+    raise ValueError(f"unknown protocol '{protocol}', expected '{PRIVATE}' or '{MIT}'")
+
+def _rate(fn, reps, runs=3):
+    best = float('inf')
+    for _ in range(runs):
+        t0 = time.perf_counter()
+        for _ in range(reps):
+            fn()
+        best = min(best, time.perf_counter() - t0)
+    return reps / best
+
+if __name__ == "__main__":
+    n = 200000
+    for model in MODELS:
+        lim = limits(model)
+        for name, fn in (('op_control', lambda i: pack_op_control(lim, 1, 0.5, 1.0, 0.1, 10.0, 1.0)),
+                         ('mit', lambda i: pack_mit(lim, 0.5, 1.0, 10.0, 1.0, 0.1))):
+            t0 = time.perf_counter()
+            for i in range(n):
+                fn(i)
+            dt = time.perf_counter() - t0
+            print(f"{model} {name:10s} {n / dt / 1e3:8.0f} k packs/s")
+
+    # One cycle of N motors: a per-motor call each against pack_many / unpack_many
+    lim = limits('RS02')
+    for motors in (4, 12, 32):
+        ids = list(range(1, motors + 1))
+        cmds = [(0.1 * i, 0.5, 0.2, 20.0, 1.0) for i in ids]
+        reps = 200000 // motors
+        for protocol, one, decode in (
+                (PRIVATE, lambda m, c: pack_op_control(lim, m, *c), lambda f: decode_feedback(lim, *f)),
+                (MIT, lambda m, c: pack_mit(lim, c[0], c[1], c[3], c[4], c[2]),
+                 lambda f: decode_mit_feedback(lim, f[1]))):
+            frames = pack_many(lim, ids, cmds, protocol)
+            replies = [(build_ext_id(0xFD, m, TYPE_FEEDBACK), data) for m, (_, data) in zip(ids, frames)]
+            tx = (_rate(lambda: [one(m, c) for m, c in zip(ids, cmds)], reps),
+                  _rate(lambda: pack_many(lim, ids, cmds, protocol), reps))
+            rx = (_rate(lambda: [decode(f) for f in replies], reps),
+                  _rate(lambda: unpack_many(lim, replies, protocol), reps))
+            print(f"{motors:2d} motors {protocol:18s} pack {tx[0] * motors / 1e3:5.0f} -> "
+                  f"{tx[1] * motors / 1e3:5.0f} k/s, unpack {rx[0] * motors / 1e3:5.0f} -> "
+                  f"{rx[1] * motors / 1e3:5.0f} k/s")
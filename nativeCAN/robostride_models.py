@@ -0,0 +1,51 @@
+# Generated by nativeCAN/USB_CAN_esp32s3/components/robostride/gen_models.py from docs/device_can/robostride/*/metadata.yaml. Do not edit.
+
+# model -> ((lo, hi) for position, velocity, torque, kp, kd), temperature scale
+MODELS = {
+    'RS02': ((-12.57, 12.57), (-44.0, 44.0), (-17.0, 17.0), (0.0, 500.0), (0.0, 5.0), 0.1),
+    'RS03': ((-12.57, 12.57), (-20.0, 20.0), (-60.0, 60.0), (0.0, 5000.0), (0.0, 100.0), 0.1),
+    'RS04': ((-12.57, 12.57), (-15.0, 15.0), (-120.0, 120.0), (0.0, 5000.0), (0.0, 100.0), 0.1),
+}
+
+# private protocol communication types
+TYPES = {
+    'get_device_id': 0,
+    'motion_control': 1,
+    'feedback': 2,
+    'enable': 3,
+    'stop': 4,
+    'set_mechanical_zero': 6,
+    'set_can_id': 7,
+    'read_parameter': 17,
+    'write_parameter': 18,
+    'fault_feedback': 21,
+    'save_parameters': 22,
+    'set_baud_rate': 23,
+    'enable_active_reporting': 24,
+    'set_protocol': 25,
+}
+
+# MIT protocol commands
+MIT_COMMANDS = {
+    'enable_motor': 1,
+    'stop_motor': 2,
+    'motion_control_dynamic': 3,
+    'set_zero_non_position': 4,
+    'clear_errors': 5,
+    'set_operation_mode': 6,
+    'modify_motor_can_id': 7,
+    'change_protocol': 8,
+    'modify_host_can_id': 9,
+    'position_control': 10,
+    'velocity_control': 11,
+}
+
+# fault bit masks of parameter 0x3022
+FAULTS = {
+    'motor_over_temperature': 1 << 0,
+    'driver_chip_fault': 1 << 1,
+    'under_voltage': 1 << 2,
+    'over_voltage': 1 << 3,
+    'encoder_not_calibrated': 1 << 7,
+    'iq_overload': 1 << 14,
+}
@@ -0,0 +1,65 @@
+import usb.core
+import struct
+import argparse
+
+from triton_usb import add_serial_argument, open_adapter
+
+# Stores a boot-time bit timing per channel (GS_USB_BREQ_TRITON_AUTOSTART) in the
+# adapter's NVS. At power-up a stored channel starts at once and holds what it
+# receives until the host brings the interface up; if the host asks for the same
+# bitrate the controller keeps running and the held frames are delivered first.
+# `save` stores the timing the channel was last configured with, so set the
+# bitrate with `ip link` once and save it. EP0 vendor requests only, so gs_usb
+# stays bound. Needs pyusb.
+
+GS_USB_BREQ_BT_CONST = 4
+GS_USB_BREQ_TRITON_AUTOSTART = 0x49
+REQ_OUT_VENDOR_DEVICE = 0x40
+REQ_IN_VENDOR_DEVICE = 0xC0
+
+AUTOSTART_ENABLE = 1 << 0
+AUTOSTART_ACTIVE = 1 << 1
+
+# struct gs_triton_autostart in gs_usb.h: flags, then gs_device_bittiming
+AUTOSTART_FMT = '<6I'
+
+def write(dev, channel, flags, bt=(0, 0, 0, 0, 0)):
+    dev.ctrl_transfer(REQ_OUT_VENDOR_DEVICE, GS_USB_BREQ_TRITON_AUTOSTART, channel, 0,
+                      struct.pack(AUTOSTART_FMT, flags, *bt))
+
+def read(dev, channel):
+    raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_TRITON_AUTOSTART, channel, 0,
+                                  struct.calcsize(AUTOSTART_FMT)))
+    flags, prop_seg, phase_seg1, phase_seg2, sjw, brp = struct.unpack(AUTOSTART_FMT, raw)
+    return flags, (prop_seg, phase_seg1, phase_seg2, sjw, brp)
+
+def fclk(dev, channel):
+    raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_BT_CONST, channel, 0, 40))
+    return struct.unpack_from('<I', raw, 4)[0]
+
+def show(dev, channel):
+    flags, (prop_seg, phase_seg1, phase_seg2, sjw, brp) = read(dev, channel)
+    if not flags & AUTOSTART_ENABLE:
+        print(f"can{channel}: autostart off")
+        return
+    tq = 1 + prop_seg + phase_seg1 + phase_seg2
+    rate = fclk(dev, channel) // (brp * tq)
+    state = "holding frames for the host" if flags & AUTOSTART_ACTIVE else "host in control"
+    print(f"can{channel}: autostart at {rate} bit/s (BRP {brp}, {tq} tq, sample point "
+          f"{100.0 * (1 + prop_seg + phase_seg1) / tq:.1f}%)  {state}")
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="TritonCAN boot-time autostart")
+    add_serial_argument(parser)
+    parser.add_argument('cmd', choices=['save', 'clear', 'show'],
+                        help="save: store the current bit timing; clear: start only on host request")
+    parser.add_argument('--channel', type=int, default=0)
+    args = parser.parse_args()
+
+    dev = open_adapter(args.serial)
+
+    if args.cmd == 'save':
+        write(dev, args.channel, AUTOSTART_ENABLE)
+    elif args.cmd == 'clear':
+        write(dev, args.channel, 0)
+    show(dev, args.channel)
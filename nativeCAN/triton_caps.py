@@ -0,0 +1,55 @@
+import usb.core
+import struct
+import argparse
+
+from triton_usb import add_serial_argument, open_adapter
+
+# Prints what the adapter's firmware supports (GS_USB_BREQ_TRITON_CAPS): the
+# feature bitmap, buffer sizes and limits of struct gs_triton_caps. EP0 vendor
+# requests only, so gs_usb stays bound. Needs pyusb. Firmware from before the
+# request stalls it: that adapter speaks plain gs_usb only, plus whichever
+# requests the other triton_*.py tools find it answers.
+
+GS_USB_BREQ_TRITON_CAPS = 0x53
+REQ_IN_VENDOR_DEVICE = 0xC0
+
+# GS_TRITON_CAP_* bit order in gs_usb.h
+FEATURES = ['usb_batch', 'usb_batch_adaptive', 'packed', 'echo_ep', 'clock', 'tx_deadline', 'filter',
+            'rx_policy', 'decimate', 'mailbox', 'cyclic', 'gateway', 'servo', 'motor_cmd', 'selftest',
+            'autostart', 'tasks', 'trace', 'stage_profiling', 'rx_spill', 'log_cdc', 'spi_link', 'usb_reattach',
+            'frame_trace']
+# Field order of struct gs_triton_caps (version 1)
+FIELDS = ['version', 'size', 'features', 'channels', 'fd_channels',
+          'usb_in_fifo', 'usb_out_fifo', 'usb_ep_size', 'usb_batch_max_frames', 'packed_block_max', 'spi_block',
+          'rx_ring_len', 'rx_spill_frames', 'tx_queue_len',
+          'sw_filters', 'cyclic_slots', 'decimate_rules', 'gateway_rules', 'tx_deadline_rules',
+          'mailbox_ids', 'servo_motors', 'motor_cmd_max', 'stats_version']
+
+def read_caps(dev):
+    """gs_triton_caps as a dict, or None on firmware without the request."""
+    try:
+        raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_TRITON_CAPS, 0, 0, 4 * len(FIELDS)))
+    except usb.core.USBError:
+        return None
+    if len(raw) < 12:
+        return None
+    n = min(len(raw), struct.unpack_from('<I', raw, 4)[0]) // 4
+    values = struct.unpack_from('<%dI' % n, raw)
+    caps = {k: values[i] if i < n else 0 for i, k in enumerate(FIELDS)}  # 0: older caps version
+    caps['feature_names'] = [name for i, name in enumerate(FEATURES) if caps['features'] >> i & 1]
+    return caps
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Show the TritonCAN adapter's capabilities")
+    add_serial_argument(parser)
+    args = parser.parse_args()
+
+    dev = open_adapter(args.serial)
+    caps = read_caps(dev)
+    if caps is None:
+        raise SystemExit("Firmware without GS_USB_BREQ_TRITON_CAPS: plain gs_usb")
+    fd = [ch for ch in range(caps['channels']) if caps['fd_channels'] >> ch & 1]
+    print(f"caps v{caps['version']} ({caps['size']} bytes), {caps['channels']} channels, FD on {fd or 'none'}")
+    print(f"features: {', '.join(caps['feature_names']) or 'none'}")
+    for k in FIELDS[5:]:
+        print(f"  {k:22s} {caps[k]}")
@@ -0,0 +1,86 @@
+import usb.core
+import time
+import struct
+import argparse
+
+from triton_usb import add_serial_argument, open_adapter
+
+# Maps the adapter's esp_timer (frame timestamps, us) onto this host's
+# CLOCK_MONOTONIC with GS_USB_BREQ_TRITON_CLOCK. Each sync is a burst of timed
+# control requests; the fastest exchange of the burst is kept and a least
+# squares fit over the last 32 syncs gives offset and drift, as ClockSync in
+# libtritoncan does. Import ClockSync to stamp frames read with pyusb, or run
+# this file to watch the estimate. EP0 vendor requests only, so gs_usb stays
+# bound. Needs pyusb.
+
+GS_USB_BREQ_TRITON_CLOCK = 0x4B
+REQ_IN_VENDOR_DEVICE = 0xC0
+WINDOW = 32
+
+def exchange(dev):
+    before = time.clock_gettime_ns(time.CLOCK_MONOTONIC)
+    raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_TRITON_CLOCK, 0, 0, 8))
+    after = time.clock_gettime_ns(time.CLOCK_MONOTONIC)
+    return before, after, struct.unpack('<Q', raw)[0]
+
+class ClockSync:
+    def __init__(self, dev):
+        self.dev = dev
+        self.samples = []  # (host_ns midpoint, device_us, rtt_ns)
+        self.host_ref = self.dev_ref = 0
+        self.ns_per_us = 1000.0
+
+    def sync(self, exchanges=16):
+        before, after, device_us = min((exchange(self.dev) for _ in range(exchanges)), key=lambda e: e[1] - e[0])
+        if self.samples and device_us <= self.samples[-1][1]:
+            self.samples = []  # adapter rebooted
+        self.samples = (self.samples + [((before + after) // 2, device_us, after - before)])[-WINDOW:]
+        self._fit()
+
+    def _fit(self):
+        host0, dev0, _ = self.samples[-1]
+        best = min(s[2] for s in self.samples)
+        pts = [(s[1] - dev0, s[0] - host0) for s in self.samples if s[2] <= 2 * best]
+        n = len(pts)
+        sx = sum(x for x, _ in pts)
+        sy = sum(y for _, y in pts)
+        sxx = sum(x * x for x, _ in pts)
+        sxy = sum(x * y for x, y in pts)
+        spread = sxx - sx * sx / n
+        self.ns_per_us = (n * sxy - sx * sy) / (n * sxx - sx * sx) if n >= 2 and spread > 1e12 else 1000.0
+        self.host_ref = host0 + round((sy - self.ns_per_us * sx) / n)
+        self.dev_ref = dev0
+
+    def to_host_ns(self, device_us):
+        """CLOCK_MONOTONIC ns of a device timestamp; 32-bit wire values are unwrapped."""
+        delta = (device_us - self.dev_ref) & 0xFFFFFFFF
+        if delta >= 0x80000000:
+            delta -= 1 << 32
+        return self.host_ref + round(self.ns_per_us * delta)
+
+    def drift_ppm(self):
+        return (1000.0 / self.ns_per_us - 1.0) * 1e6
+
+    def offset_ns(self):
+        return self.host_ref - self.dev_ref * 1000
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="TritonCAN device/host clock sync")
+    add_serial_argument(parser)
+    parser.add_argument('--interval', type=float, default=1.0, help="seconds between syncs")
+    parser.add_argument('--count', type=int, default=0, help="stop after this many syncs (0: run)")
+    args = parser.parse_args()
+
+    dev = open_adapter(args.serial)
+
+    clock = ClockSync(dev)
+    n = 0
+    while True:
+        clock.sync()
+        _, _, rtt = clock.samples[-1]
+        print(f"offset {clock.offset_ns() / 1e9:.6f} s  drift {clock.drift_ppm():+.2f} ppm  "
+              f"rtt {rtt / 1000:.0f} us  ({len(clock.samples)} syncs)")
+        n += 1
+        if args.count and n >= args.count:
+            break
+        time.sleep(args.interval)
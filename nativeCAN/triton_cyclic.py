@@ -0,0 +1,102 @@
+import usb.core
+import struct
+import argparse
+
+from triton_usb import add_serial_argument, open_adapter, parse_id
+
+# Manages the adapter's periodic TX table (GS_USB_BREQ_TRITON_CYCLIC), the
+# on-device equivalent of a SocketCAN BCM TX_SETUP. Frames keep going out from
+# the device timer whatever the host is doing; update only the payload when a
+# setpoint changes. Like triton_stats.py it uses EP0 vendor requests only, so
+# the gs_usb kernel driver stays bound. Needs pyusb.
+
+GS_USB_BREQ_TRITON_CYCLIC = 0x44
+REQ_OUT_VENDOR_DEVICE = 0x40
+REQ_IN_VENDOR_DEVICE = 0xC0
+SLOTS = 16
+MIN_PERIOD_US = 100
+
+CYCLIC_ENABLE = 1 << 0
+CYCLIC_DATA_ONLY = 1 << 1
+GS_CAN_FLAG_FD = 1 << 1
+GS_CAN_FLAG_BRS = 1 << 2
+CAN_RTR_FLAG = 0x40000000
+
+# struct gs_triton_cyclic in gs_usb.h
+CYCLIC_FMT = '<5I4B64s'
+FD_LENS = [0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64]
+
+def len_to_dlc(n):
+    for dlc, size in enumerate(FD_LENS):
+        if size >= n:
+            return dlc
+    raise ValueError("payload longer than 64 bytes")
+
+def pack(slot, flags, period_us=0, phase_us=0, can_id=0, data=b'', channel=0, fd=False, brs=False):
+    if len(data) > 8 and not fd:
+        raise ValueError("classic frames carry at most 8 bytes (use --fd)")
+    frame_flags = (GS_CAN_FLAG_FD if fd else 0) | (GS_CAN_FLAG_BRS if brs else 0)
+    return struct.pack(CYCLIC_FMT, slot, flags, period_us, phase_us, can_id,
+                       len_to_dlc(len(data)), channel, frame_flags, 0, bytes(data))
+
+def write_slot(dev, raw):
+    dev.ctrl_transfer(REQ_OUT_VENDOR_DEVICE, GS_USB_BREQ_TRITON_CYCLIC, 0, 0, raw)
+
+def set_cyclic(dev, slot, can_id, data, period_us, phase_us=0, channel=0, fd=False, brs=False):
+    """Starts (or restarts) a slot. Slots with the same period keep their phase offset."""
+    if period_us < MIN_PERIOD_US or phase_us >= period_us:
+        raise ValueError("period must be >= %d us and phase < period" % MIN_PERIOD_US)
+    write_slot(dev, pack(slot, CYCLIC_ENABLE, period_us, phase_us, can_id, data, channel, fd, brs))
+
+def update_payload(dev, slot, data, fd=False):
+    """Replaces the payload of a running slot without touching its schedule."""
+    write_slot(dev, pack(slot, CYCLIC_ENABLE | CYCLIC_DATA_ONLY, data=data, fd=fd))
+
+def disable(dev, slot):
+    write_slot(dev, pack(slot, 0))
+
+def read_slot(dev, slot):
+    raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_TRITON_CYCLIC, slot, 0,
+                                  struct.calcsize(CYCLIC_FMT)))
+    _, flags, period, phase, can_id, dlc, channel, frame_flags, _, data = struct.unpack(CYCLIC_FMT, raw)
+    return {'enabled': bool(flags & CYCLIC_ENABLE), 'period_us': period, 'phase_us': phase,
+            'can_id': can_id, 'channel': channel, 'fd': bool(frame_flags & GS_CAN_FLAG_FD),
+            'data': data[:FD_LENS[dlc & 0xF]]}
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="TritonCAN on-device cyclic transmit")
+    add_serial_argument(parser)
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('set', help="start a periodic frame")
+    p.add_argument('slot', type=int)
+    p.add_argument('can_id', help="hex, 8 digits for an extended ID")
+    p.add_argument('data', help="hex payload, e.g. 0011223344556677")
+    p.add_argument('--period-us', type=int, required=True)
+    p.add_argument('--phase-us', type=int, default=0)
+    p.add_argument('--channel', type=int, default=0)
+    p.add_argument('--fd', action='store_true')
+    p.add_argument('--brs', action='store_true')
+    p = sub.add_parser('data', help="replace the payload of a running slot")
+    p.add_argument('slot', type=int)
+    p.add_argument('data')
+    p.add_argument('--fd', action='store_true')
+    p = sub.add_parser('off', help="stop a slot")
+    p.add_argument('slot', type=int)
+    sub.add_parser('list', help="show all slots")
+    args = parser.parse_args()
+
+    dev = open_adapter(args.serial)
+
+    if args.cmd == 'set':
+        set_cyclic(dev, args.slot, parse_id(args.can_id), bytes.fromhex(args.data), args.period_us,
+                   args.phase_us, args.channel, args.fd, args.brs)
+    elif args.cmd == 'data':
+        update_payload(dev, args.slot, bytes.fromhex(args.data), args.fd)
+    elif args.cmd == 'off':
+        disable(dev, args.slot)
+    for slot in range(SLOTS) if args.cmd == 'list' else [args.slot]:
+        e = read_slot(dev, slot)
+        if e['enabled'] or args.cmd != 'list':
+            state = f"every {e['period_us']} us +{e['phase_us']}" if e['enabled'] else "off"
+            print(f"slot {slot:2}  can{e['channel']}  {e['can_id'] & 0x1FFFFFFF:08X}  "
+                  f"[{len(e['data'])}] {e['data'].hex()}  {state}")
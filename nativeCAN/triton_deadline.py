@@ -0,0 +1,84 @@
+import usb.core
+import struct
+import argparse
+
+from triton_usb import add_serial_argument, open_adapter, parse_id
+
+# Edits a channel's TX deadline rules (GS_USB_BREQ_TRITON_TX_DEADLINE). A host
+# frame whose ID matches a rule is failed, unsent, once it has waited longer
+# than the rule's age in the adapter; the echo comes back with TX_FAILED and
+# TX_EXPIRED and the frame counts as "expired" in triton_stats.py. --inflight
+# caps the frames queued in the controller, so a backlog waits where it can
+# still expire. EP0 vendor requests only, so gs_usb stays bound. Needs pyusb.
+
+GS_USB_BREQ_TRITON_TX_DEADLINE = 0x4D
+REQ_OUT_VENDOR_DEVICE = 0x40
+REQ_IN_VENDOR_DEVICE = 0xC0
+RULES = 16
+CAN_EFF_FLAG = 0x80000000
+
+# struct gs_triton_tx_deadline in gs_usb.h: rule_count, inflight_max, then RULES {can_id, mask, max_age_us}
+RULE_FMT = '<3I'
+TABLE_FMT = '<2I' + RULE_FMT[1:] * RULES
+
+def read_table(dev, channel):
+    raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_TRITON_TX_DEADLINE, channel, 0,
+                                  struct.calcsize(TABLE_FMT)))
+    values = struct.unpack(TABLE_FMT, raw)
+    return [tuple(values[2 + 3 * i:5 + 3 * i]) for i in range(min(values[0], RULES))], values[1]
+
+def write_table(dev, channel, rules, inflight):
+    if len(rules) > RULES:
+        raise SystemExit(f"at most {RULES} rules per channel")
+    flat = [v for rule in rules for v in rule] + [0] * 3 * (RULES - len(rules))
+    dev.ctrl_transfer(REQ_OUT_VENDOR_DEVICE, GS_USB_BREQ_TRITON_TX_DEADLINE, channel, 0,
+                      struct.pack(TABLE_FMT, len(rules), inflight, *flat))
+
+def parse_match(text):
+    """ID[/MASK] in hex; without a mask the ID must match exactly. The mask always checks IDE."""
+    can_id, _, mask = text.partition('/')
+    can_id = parse_id(can_id)
+    return can_id, (int(mask, 16) if mask else 0xFFFFFFFF) | CAN_EFF_FLAG
+
+def describe(rule):
+    can_id, mask, max_age_us = rule
+    what = f"expires after {max_age_us} us" if max_age_us else "never expires"
+    return f"{can_id & 0x1FFFFFFF:08X}/{mask & 0x1FFFFFFF:08X} {'ext' if can_id & CAN_EFF_FLAG else 'std'}  {what}"
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="TritonCAN per-ID TX deadlines")
+    add_serial_argument(parser)
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('add', help="append a rule")
+    p.add_argument('match', help="hex ID[/MASK], 8 digits for an extended ID")
+    p.add_argument('--max-age-us', type=int, required=True, metavar='T',
+                   help="fail matching frames still unsent T us after they reach the adapter (0: never)")
+    p = sub.add_parser('del', help="remove a rule by its index in `list`")
+    p.add_argument('index', type=int)
+    p = sub.add_parser('inflight', help="cap the frames queued in the controller (0: no cap)")
+    p.add_argument('count', type=int)
+    sub.add_parser('clear', help="no deadlines, no cap")
+    sub.add_parser('list', help="show the rules")
+    parser.add_argument('--channel', type=int, default=0)
+    args = parser.parse_args()
+
+    dev = open_adapter(args.serial)
+
+    rules, inflight = read_table(dev, args.channel)
+    if args.cmd == 'add':
+        can_id, mask = parse_match(args.match)
+        rules.append((can_id, mask, args.max_age_us))
+        write_table(dev, args.channel, rules, inflight)
+    elif args.cmd == 'del':
+        del rules[args.index]
+        write_table(dev, args.channel, rules, inflight)
+    elif args.cmd == 'inflight':
+        write_table(dev, args.channel, rules, args.count)
+    elif args.cmd == 'clear':
+        write_table(dev, args.channel, [], 0)
+    rules, inflight = read_table(dev, args.channel)
+    print(f"can{args.channel}: {'at most %d' % inflight if inflight else 'no cap on'} frames in the controller")
+    if not rules:
+        print(f"can{args.channel}: no deadlines")
+    for i, rule in enumerate(rules):
+        print(f"can{args.channel} rule {i:2}  {describe(rule)}")
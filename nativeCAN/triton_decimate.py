@@ -0,0 +1,86 @@
+import usb.core
+import struct
+import argparse
+
+from triton_usb import add_serial_argument, open_adapter, parse_id
+
+# Edits a channel's per-ID decimation rules (GS_USB_BREQ_TRITON_DECIMATE). The
+# device applies them in its RX tasks, so suppressed frames never cross USB;
+# they show up as "decimated" in triton_stats.py. Each rule acts on every
+# matching ID separately: a masked rule over RS02 type-24 reports limits each
+# motor, not the group. EP0 vendor requests only, so gs_usb stays bound.
+# Needs pyusb.
+
+GS_USB_BREQ_TRITON_DECIMATE = 0x4A
+REQ_OUT_VENDOR_DEVICE = 0x40
+REQ_IN_VENDOR_DEVICE = 0xC0
+RULES = 16
+CAN_EFF_FLAG = 0x80000000
+
+# struct gs_triton_decimate in gs_usb.h: rule_count, then RULES {can_id, mask, mode, param}
+RULE_FMT = '<4I'
+TABLE_FMT = '<I' + RULE_FMT[1:] * RULES
+
+def read_rules(dev, channel):
+    raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_TRITON_DECIMATE, channel, 0,
+                                  struct.calcsize(TABLE_FMT)))
+    values = struct.unpack(TABLE_FMT, raw)
+    return [tuple(values[1 + 4 * i:5 + 4 * i]) for i in range(min(values[0], RULES))]
+
+def write_rules(dev, channel, rules):
+    if len(rules) > RULES:
+        raise SystemExit(f"at most {RULES} rules per channel")
+    flat = [v for rule in rules for v in rule] + [0] * 4 * (RULES - len(rules))
+    dev.ctrl_transfer(REQ_OUT_VENDOR_DEVICE, GS_USB_BREQ_TRITON_DECIMATE, channel, 0,
+                      struct.pack(TABLE_FMT, len(rules), *flat))
+
+def parse_match(text):
+    """ID[/MASK] in hex; without a mask the ID must match exactly. The mask always checks IDE."""
+    can_id, _, mask = text.partition('/')
+    can_id = parse_id(can_id)
+    return can_id, (int(mask, 16) if mask else 0xFFFFFFFF) | CAN_EFF_FLAG
+
+def describe(rule):
+    can_id, mask, mode, param = rule
+    what = {0: f"1 in {param}", 1: f"at most 1 per {param} us", 2: "on change"}.get(mode, f"mode {mode}")
+    return f"{can_id & 0x1FFFFFFF:08X}/{mask & 0x1FFFFFFF:08X} {'ext' if can_id & CAN_EFF_FLAG else 'std'}  {what}"
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="TritonCAN per-ID RX decimation")
+    add_serial_argument(parser)
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('add', help="append a rule")
+    p.add_argument('match', help="hex ID[/MASK], 8 digits for an extended ID")
+    how = p.add_mutually_exclusive_group(required=True)
+    how.add_argument('--every', type=int, metavar='N', help="forward one frame in N")
+    how.add_argument('--interval-us', type=int, metavar='T', help="at most one frame per T us")
+    how.add_argument('--on-change', action='store_true', help="only when the payload changes")
+    p = sub.add_parser('del', help="remove a rule by its index in `list`")
+    p.add_argument('index', type=int)
+    sub.add_parser('clear', help="forward everything")
+    sub.add_parser('list', help="show the rules")
+    parser.add_argument('--channel', type=int, default=0)
+    args = parser.parse_args()
+
+    dev = open_adapter(args.serial)
+
+    rules = read_rules(dev, args.channel)
+    if args.cmd == 'add':
+        can_id, mask = parse_match(args.match)
+        if args.every is not None:
+            rules.append((can_id, mask, 0, args.every))
+        elif args.interval_us is not None:
+            rules.append((can_id, mask, 1, args.interval_us))
+        else:
+            rules.append((can_id, mask, 2, 0))
+        write_rules(dev, args.channel, rules)
+    elif args.cmd == 'del':
+        del rules[args.index]
+        write_rules(dev, args.channel, rules)
+    elif args.cmd == 'clear':
+        write_rules(dev, args.channel, [])
+    rules = read_rules(dev, args.channel)
+    if not rules:
+        print(f"can{args.channel}: no decimation")
+    for i, rule in enumerate(rules):
+        print(f"can{args.channel} rule {i:2}  {describe(rule)}")
@@ -0,0 +1,82 @@
+import os
+import argparse
+
+# Lists the TritonCAN adapters on this host from sysfs: serial number (the
+# chip's eFuse MAC), USB port path and the SocketCAN interface of each channel.
+# With --udev it prints rules for udev/99-tritoncan.rules that give the
+# channels stable names, so per-bus thread pinning and IRQ affinity can be
+# scripted against names rather than enumeration order. Needs no pyusb and
+# no root.
+
+USB_VID = '1d50'
+USB_PID = '606f'
+SYS_USB = '/sys/bus/usb/devices'
+SYS_NET = '/sys/class/net'
+IFNAMSIZ = 16
+
+def read(path, default=''):
+    try:
+        with open(path) as f:
+            return f.read().strip()
+    except OSError:
+        return default
+
+def interfaces(usb_path):
+    """SocketCAN interfaces on this USB device, as {channel: name}."""
+    found = {}
+    for name in sorted(os.listdir(SYS_NET)) if os.path.isdir(SYS_NET) else []:
+        dev = os.path.realpath(os.path.join(SYS_NET, name, 'device'))
+        if dev.startswith(usb_path + '/'):
+            found[int(read(os.path.join(SYS_NET, name, 'dev_port'), '0'), 0)] = name
+    return found
+
+def adapters():
+    found = []
+    for entry in sorted(os.listdir(SYS_USB)) if os.path.isdir(SYS_USB) else []:
+        path = os.path.join(SYS_USB, entry)
+        if read(os.path.join(path, 'idVendor')) != USB_VID or read(os.path.join(path, 'idProduct')) != USB_PID:
+            continue
+        real = os.path.realpath(path)
+        driver = os.path.join(real + '/' + entry + ':1.0', 'driver')
+        found.append({
+            'serial': read(os.path.join(path, 'serial'), '?'),
+            'port': entry,
+            'bus': int(read(os.path.join(path, 'busnum'), '0')),
+            'address': int(read(os.path.join(path, 'devnum'), '0')),
+            'driver': os.path.basename(os.path.realpath(driver)) if os.path.exists(driver) else None,
+            'interfaces': interfaces(real),
+        })
+    return sorted(found, key=lambda a: a['serial'])
+
+def udev_rule(name, serial, channel=0):
+    if len(name) >= IFNAMSIZ:
+        raise SystemExit(f"{name}: interface names are at most {IFNAMSIZ - 1} characters")
+    return ('SUBSYSTEM=="net", ACTION=="add", DRIVERS=="gs_usb", '
+            f'ATTRS{{idVendor}}=="{USB_VID}", ATTRS{{idProduct}}=="{USB_PID}", '
+            f'ATTRS{{serial}}=="{serial}", ATTR{{dev_port}}=="{channel}", NAME="{name}"')
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Find TritonCAN adapters and name their interfaces")
+    parser.add_argument('--udev', nargs='+', metavar='NAME=SERIAL[:CH]',
+                        help="print udev rules naming these adapter channels")
+    args = parser.parse_args()
+
+    if args.udev:
+        for spec in args.udev:
+            name, _, target = spec.partition('=')
+            serial, _, channel = target.partition(':')
+            if not name or not serial:
+                raise SystemExit(f"{spec}: expected NAME=SERIAL[:CH]")
+            print(udev_rule(name, serial.upper(), int(channel or 0)))
+        raise SystemExit(0)
+
+    found = adapters()
+    if not found:
+        raise SystemExit("No TritonCAN adapter (VID 0x1D50, PID 0x606F)")
+    for a in found:
+        state = a['driver'] or 'no driver'
+        if a['driver'] == 'usbfs':
+            state = 'userspace (libtritoncan, pyusb)'
+        print(f"{a['serial']}  usb {a['port']} (bus {a['bus']} addr {a['address']})  {state}")
+        for channel, name in sorted(a['interfaces'].items()):
+            print(f"  channel {channel}: {name}")
@@ -0,0 +1,110 @@
+import usb.core
+import time
+import struct
+import argparse
+
+from triton_usb import add_serial_argument, open_adapter
+
+# Frame trace with GS_USB_BREQ_TRITON_FRAME_TRACE (firmware built with
+# CONFIG_TRITON_FRAME_TRACE): a record of every frame of the chosen channels at
+# the chosen stages, read over EP0 while gs_usb keeps the interface. "rx" is a
+# frame put in the channel ring ("drop": the ring was full), "submit" a host
+# frame handed to the controller with the driver's result, "done" its
+# completion. Prints one line per record, or writes them as CSV with -o.
+# Times are seconds on the adapter's clock, the one gs_usb timestamps use.
+# Needs pyusb.
+
+GS_USB_BREQ_TRITON_FRAME_TRACE = 0x54
+REQ_OUT_VENDOR_DEVICE = 0x40
+REQ_IN_VENDOR_DEVICE = 0xC0
+READ = 240
+HEADER = struct.Struct('<IIII')
+RECORD = struct.Struct('<IIBBBBHH')
+STAGES = ['rx', 'submit', 'done']
+CAN_EFF_FLAG = 0x80000000
+CAN_RTR_FLAG = 0x40000000
+FLAG_FD = 1 << 1
+FLAG_TX_EXPIRED = 1 << 6
+FLAG_TX_FAILED = 1 << 7
+
+def set_trace(dev, stages, channels):
+    dev.ctrl_transfer(REQ_OUT_VENDOR_DEVICE, GS_USB_BREQ_TRITON_FRAME_TRACE, 0, 0,
+                      struct.pack('<II', stages, channels))
+
+def read_records(dev):
+    """(device time_us, records as (time_us, can_id, channel, stage, flags, dlc, status), lost) of one read."""
+    raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_TRITON_FRAME_TRACE, 0, 0,
+                                  HEADER.size + READ * RECORD.size))
+    now, count, lost, _ = HEADER.unpack_from(raw)
+    records = []
+    for i in range(count):
+        t, can_id, ch, stage, flags, dlc, _, status = RECORD.unpack_from(raw, HEADER.size + i * RECORD.size)
+        records.append((t, can_id, ch, stage, flags, dlc, status))
+    return now, records, lost
+
+def describe(stage, flags, status):
+    if stage == 0:
+        return "drop" if status else ""
+    if stage == 1:
+        return "ok" if status == 0 else f"err 0x{status:x}"
+    if flags & FLAG_TX_EXPIRED:
+        return "expired"
+    return "failed" if flags & FLAG_TX_FAILED else "sent"
+
+def ident(can_id):
+    if can_id & CAN_EFF_FLAG:
+        return f"{can_id & 0x1FFFFFFF:08X}"
+    return f"{can_id & 0x7FF:03X}"
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="TritonCAN frame trace")
+    add_serial_argument(parser)
+    parser.add_argument('--stages', default="rx,submit,done", help=f"comma-separated, of {', '.join(STAGES)}")
+    parser.add_argument('--channels', type=lambda s: int(s, 0), default=0xFF, help="bit mask of traced channels")
+    parser.add_argument('--duration', type=float, default=0, help="seconds to record (0: until Ctrl-C)")
+    parser.add_argument('--hz', type=float, default=200, help="reads per second while the ring is drained")
+    parser.add_argument('-o', '--output', help="write CSV here instead of printing")
+    args = parser.parse_args()
+
+    stages = 0
+    for name in args.stages.split(','):
+        if name not in STAGES:
+            raise SystemExit(f"Unknown stage {name!r}")
+        stages |= 1 << STAGES.index(name)
+    dev = open_adapter(args.serial)
+    try:
+        set_trace(dev, stages, args.channels)
+    except usb.core.USBError:
+        raise SystemExit("Frame trace request stalled: firmware built without CONFIG_TRITON_FRAME_TRACE")
+
+    out = open(args.output, 'w') if args.output else None
+    if out:
+        out.write("time_s,channel,stage,can_id,dlc,flags,result\n")
+    total, lost, base, last = 0, 0, 0, None
+    start = time.monotonic()
+    try:
+        while not args.duration or time.monotonic() - start < args.duration:
+            _, records, lost = read_records(dev)
+            for t, can_id, ch, stage, flags, dlc, status in records:
+                # 32-bit device microseconds, unwrapped: records come oldest first
+                if last is not None and t < last and last - t > 0x80000000:
+                    base += 1 << 32
+                last = t
+                secs = (base + t) / 1e6
+                what = describe(stage, flags, status)
+                if out:
+                    out.write(f"{secs:.6f},{ch},{STAGES[stage]},0x{can_id:08X},{dlc},0x{flags:02X},{what}\n")
+                else:
+                    rtr = " R" if can_id & CAN_RTR_FLAG else ""
+                    fd = " FD" if flags & FLAG_FD else ""
+                    print(f"{secs:14.6f} can{ch} {STAGES[stage]:<6} {ident(can_id):>8} [{dlc}]{rtr}{fd} {what}")
+            total += len(records)
+            if len(records) < READ:
+                time.sleep(1.0 / args.hz)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        set_trace(dev, 0, 0)
+        if out:
+            out.close()
+    print(f"{total} records, {lost} lost" + (f" -> {args.output}" if args.output else ""))
@@ -0,0 +1,86 @@
+import usb.core
+import struct
+import argparse
+
+from triton_usb import add_serial_argument, open_adapter, parse_id
+
+# Edits the adapter's CAN-to-CAN routing table (GS_USB_BREQ_TRITON_GATEWAY):
+# frames matching a rule on one channel are sent on another straight from the
+# RX task, optionally with a rewritten ID, without a round trip through the
+# host. `list` shows each rule with its counters. EP0 vendor requests only, so
+# gs_usb stays bound. Needs pyusb.
+
+GS_USB_BREQ_TRITON_GATEWAY = 0x4C
+REQ_OUT_VENDOR_DEVICE = 0x40
+REQ_IN_VENDOR_DEVICE = 0xC0
+RULES = 16
+CAN_EFF_FLAG = 0x80000000
+
+GATEWAY_ENABLE = 1 << 0
+GATEWAY_CONSUME = 1 << 1
+
+# struct gs_triton_gateway_rule in gs_usb.h
+RULE_FMT = '<2I2B2x8I'
+
+def write_rule(dev, slot, flags=0, src=0, dst=0, can_id=0, mask=0, rewrite_id=0, rewrite_mask=0):
+    dev.ctrl_transfer(REQ_OUT_VENDOR_DEVICE, GS_USB_BREQ_TRITON_GATEWAY, 0, 0,
+                      struct.pack(RULE_FMT, slot, flags, src, dst, can_id, mask, rewrite_id, rewrite_mask, 0, 0, 0, 0))
+
+def read_rule(dev, slot):
+    raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_TRITON_GATEWAY, slot, 0,
+                                  struct.calcsize(RULE_FMT)))
+    keys = ['slot', 'flags', 'src', 'dst', 'can_id', 'mask', 'rewrite_id', 'rewrite_mask',
+            'matched', 'sent', 'dropped', 'failed']
+    return dict(zip(keys, struct.unpack(RULE_FMT, raw)))
+
+def parse_match(text):
+    """ID[/MASK] in hex; without a mask the ID must match exactly. The mask always checks IDE."""
+    can_id, _, mask = text.partition('/')
+    return parse_id(can_id), (int(mask, 16) if mask else 0xFFFFFFFF) | CAN_EFF_FLAG
+
+def show(r):
+    if not r['flags'] & GATEWAY_ENABLE:
+        print(f"rule {r['slot']:2}  off")
+        return
+    rewrite = ""
+    if r['rewrite_mask']:
+        rewrite = f"  id <- {r['rewrite_id'] & 0x1FFFFFFF:08X}/{r['rewrite_mask'] & 0x1FFFFFFF:08X}"
+    consume = "  (not to host)" if r['flags'] & GATEWAY_CONSUME else ""
+    print(f"rule {r['slot']:2}  can{r['src']} {r['can_id'] & 0x1FFFFFFF:08X}/{r['mask'] & 0x1FFFFFFF:08X} -> "
+          f"can{r['dst']}{rewrite}{consume}  matched {r['matched']}  sent {r['sent']}  "
+          f"dropped {r['dropped']}  failed {r['failed']}")
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="TritonCAN on-device CAN-to-CAN routing")
+    add_serial_argument(parser)
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('set', help="route matching frames from one channel to another")
+    p.add_argument('slot', type=int)
+    p.add_argument('src', type=int, help="source channel")
+    p.add_argument('match', help="hex ID[/MASK], 8 digits for an extended ID")
+    p.add_argument('dst', type=int, help="destination channel")
+    p.add_argument('--rewrite', metavar='ID[/MASK]',
+                   help="replace the ID bits in MASK (default: all) with ID, hex")
+    p.add_argument('--consume', action='store_true', help="do not also deliver routed frames to the host")
+    p = sub.add_parser('off', help="remove a rule")
+    p.add_argument('slot', type=int)
+    sub.add_parser('list', help="show the rules and their counters")
+    args = parser.parse_args()
+
+    dev = open_adapter(args.serial)
+
+    if args.cmd == 'set':
+        can_id, mask = parse_match(args.match)
+        rewrite_id = rewrite_mask = 0
+        if args.rewrite:
+            text, _, m = args.rewrite.partition('/')
+            rewrite_id = parse_id(text)
+            rewrite_mask = int(m, 16) if m else 0xFFFFFFFF
+        flags = GATEWAY_ENABLE | (GATEWAY_CONSUME if args.consume else 0)
+        write_rule(dev, args.slot, flags, args.src, args.dst, can_id, mask, rewrite_id, rewrite_mask)
+    elif args.cmd == 'off':
+        write_rule(dev, args.slot)
+    for slot in range(RULES) if args.cmd == 'list' else [args.slot]:
+        r = read_rule(dev, slot)
+        if r['flags'] & GATEWAY_ENABLE or args.cmd != 'list':
+            show(r)
@@ -0,0 +1,79 @@
+import usb.core
+import struct
+import argparse
+import time
+
+from triton_usb import add_serial_argument, open_adapter, parse_id
+
+# Latest frame per CAN ID (GS_USB_BREQ_TRITON_MAILBOX). The adapter keeps the
+# newest frame of each ID in the set; one control transfer reads them all, so a
+# slow consumer polls at its own rate instead of taking every frame off the bus.
+# --consume keeps those IDs out of the gs_usb stream. EP0 vendor requests only,
+# so gs_usb stays bound. Needs pyusb.
+
+GS_USB_BREQ_TRITON_MAILBOX = 0x4F
+REQ_OUT_VENDOR_DEVICE = 0x40
+REQ_IN_VENDOR_DEVICE = 0xC0
+IDS = 32
+CONSUME = 1 << 0
+CAN_EFF_FLAG = 0x80000000
+GS_CAN_FLAG_FD = 1 << 1
+
+# struct gs_triton_mailbox_config in gs_usb.h: id_count, flags, IDS can_id
+CONFIG_FMT = '<2I%dI' % IDS
+# struct gs_triton_mailbox: time_us, id_count, flags, then IDS {can_id, count, timestamp_us, can_dlc, flags, reserved[2], data[8]}
+SLOT_FMT = '<3I2B2x8s'
+SNAPSHOT_HDR = '<3I'
+
+def read_mailbox(dev, channel):
+    raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_TRITON_MAILBOX, channel, 0,
+                                  struct.calcsize(SNAPSHOT_HDR) + IDS * struct.calcsize(SLOT_FMT)))
+    time_us, count, flags = struct.unpack_from(SNAPSHOT_HDR, raw)
+    slots = [struct.unpack_from(SLOT_FMT, raw, struct.calcsize(SNAPSHOT_HDR) + i * struct.calcsize(SLOT_FMT))
+             for i in range(min(count, IDS))]
+    return time_us, flags, slots
+
+def write_mailbox(dev, channel, ids, flags):
+    if len(ids) > IDS:
+        raise SystemExit(f"at most {IDS} IDs per channel")
+    dev.ctrl_transfer(REQ_OUT_VENDOR_DEVICE, GS_USB_BREQ_TRITON_MAILBOX, channel, 0,
+                      struct.pack(CONFIG_FMT, len(ids), flags, *(ids + [0] * (IDS - len(ids)))))
+
+def describe(time_us, slot):
+    can_id, count, ts, dlc, flags, data = slot
+    name = f"{can_id & 0x1FFFFFFF:08X}" if can_id & CAN_EFF_FLAG else f"{can_id & 0x7FF:03X}"
+    if not count:
+        return f"{name:8}  no frame yet"
+    age_ms = ((time_us - ts) & 0xFFFFFFFF) / 1000
+    fd = " fd" if flags & GS_CAN_FLAG_FD else ""
+    return f"{name:8}  [{dlc:2}{fd}] {data.hex(' ')}  {age_ms:8.1f} ms old  {count} frames"
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="TritonCAN latest-value mailbox")
+    add_serial_argument(parser)
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('set', help="replace the set of IDs (empties every slot)")
+    p.add_argument('ids', nargs='+', help="hex IDs, 8 digits for an extended ID")
+    p.add_argument('--consume', action='store_true', help="do not stream these IDs to gs_usb")
+    sub.add_parser('clear', help="no IDs")
+    p = sub.add_parser('show', help="print the newest frame of every ID")
+    p.add_argument('--hz', type=float, default=0, help="poll this often until interrupted")
+    parser.add_argument('--channel', type=int, default=0)
+    args = parser.parse_args()
+
+    dev = open_adapter(args.serial)
+
+    if args.cmd == 'set':
+        write_mailbox(dev, args.channel, [parse_id(t) for t in args.ids], CONSUME if args.consume else 0)
+    elif args.cmd == 'clear':
+        write_mailbox(dev, args.channel, [], 0)
+    while True:
+        time_us, flags, slots = read_mailbox(dev, args.channel)
+        if not slots:
+            print(f"can{args.channel}: no mailbox IDs")
+        for slot in slots:
+            print(f"can{args.channel} {describe(time_us, slot)}{'  (not streamed)' if flags & CONSUME else ''}")
+        if args.cmd != 'show' or not args.hz:
+            break
+        time.sleep(1 / args.hz)
+        print()
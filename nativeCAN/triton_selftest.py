@@ -0,0 +1,116 @@
+import usb.core
+import time
+import struct
+import argparse
+import subprocess
+
+from triton_usb import add_serial_argument, open_adapter, parse_id
+
+# Drives the adapter's loopback self-test (GS_USB_BREQ_TRITON_SELFTEST): with
+# the test armed, can0 runs in TWAI no-ACK mode and receives its own frames,
+# so throughput and latency can be measured without a second node on the bus.
+# The device generates the traffic and times every frame from submit to
+# self-reception and on into the USB FIFO. Arming takes effect on the next
+# start of can0, which `run` does with `ip link` (the bitrate stays as set).
+# EP0 vendor requests only, so gs_usb stays bound. Needs pyusb.
+
+GS_USB_BREQ_TRITON_SELFTEST = 0x48
+REQ_OUT_VENDOR_DEVICE = 0x40
+REQ_IN_VENDOR_DEVICE = 0xC0
+
+SELFTEST_ENABLE = 1 << 0
+SELFTEST_RUNNING = 1 << 1
+HIST_BUCKETS = 16
+
+# struct gs_triton_selftest_config / gs_triton_selftest_result in gs_usb.h
+CONFIG_FMT = '<4I2B2x'
+RESULT_FIELDS = [
+    'flags', 'elapsed_ms', 'tx_pps', 'rx_pps',
+    'generated', 'tx_failed', 'tx_skipped', 'received', 'lost',
+    'rx_min_us', 'rx_avg_us', 'rx_max_us',
+    'usb_min_us', 'usb_avg_us', 'usb_max_us', 'usb_frames',
+]
+RESULT_FMT = '<%dI' % (len(RESULT_FIELDS) + 2 * HIST_BUCKETS)
+
+def arm(dev, rate_pps, can_id=0x100, id_count=1, dlc_min=8, dlc_max=8):
+    raw = struct.pack(CONFIG_FMT, SELFTEST_ENABLE, rate_pps, can_id, id_count, dlc_min, dlc_max)
+    dev.ctrl_transfer(REQ_OUT_VENDOR_DEVICE, GS_USB_BREQ_TRITON_SELFTEST, 0, 0, raw)
+
+def disarm(dev):
+    dev.ctrl_transfer(REQ_OUT_VENDOR_DEVICE, GS_USB_BREQ_TRITON_SELFTEST, 0, 0,
+                      struct.pack(CONFIG_FMT, 0, 0, 0, 0, 0, 0))
+
+def read_result(dev):
+    raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_TRITON_SELFTEST, 0, 0,
+                                  struct.calcsize(RESULT_FMT)))
+    values = struct.unpack(RESULT_FMT, raw)
+    r = dict(zip(RESULT_FIELDS, values))
+    n = len(RESULT_FIELDS)
+    r['rx_hist'] = values[n:n + HIST_BUCKETS]
+    r['usb_hist'] = values[n + HIST_BUCKETS:]
+    return r
+
+def restart(iface):
+    subprocess.run(['ip', 'link', 'set', iface, 'down'], check=True)
+    subprocess.run(['ip', 'link', 'set', iface, 'up'], check=True)
+
+def bucket_label(i):
+    lo = 0 if i == 0 else 1 << i
+    return f">= {lo} us" if i == HIST_BUCKETS - 1 else f"{lo}..{(1 << (i + 1)) - 1} us"
+
+def show_hist(title, hist):
+    total = sum(hist)
+    if not total:
+        return
+    print(f"  {title}")
+    peak = max(hist)
+    for i, n in enumerate(hist):
+        if n:
+            print(f"    {bucket_label(i):>14}  {n:9}  {100.0 * n / total:5.1f}%  {'#' * max(1, 40 * n // peak)}")
+
+def show(r):
+    state = "running" if r['flags'] & SELFTEST_RUNNING else "armed" if r['flags'] & SELFTEST_ENABLE else "off"
+    print(f"self-test {state}  {r['elapsed_ms'] / 1000:.1f}s")
+    print(f"  TX {r['tx_pps']} pps  generated {r['generated']}  failed {r['tx_failed']}  skipped {r['tx_skipped']}")
+    print(f"  RX {r['rx_pps']} pps  received {r['received']}  lost {r['lost']}  to USB {r['usb_frames']}")
+    if r['received']:
+        print(f"  submit->RX:  min {r['rx_min_us']} / avg {r['rx_avg_us']} / max {r['rx_max_us']} us")
+    if r['usb_frames']:
+        print(f"  submit->USB: min {r['usb_min_us']} / avg {r['usb_avg_us']} / max {r['usb_max_us']} us")
+    show_hist("submit->RX histogram", r['rx_hist'])
+    show_hist("submit->USB histogram", r['usb_hist'])
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="TritonCAN loopback throughput/latency self-test")
+    add_serial_argument(parser)
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    for name, text in (('run', "arm, restart the interface, measure, restore"), ('arm', "arm for the next start of can0")):
+        p = sub.add_parser(name, help=text)
+        p.add_argument('--rate', type=int, default=5000, help="frames per second (0: loop host frames only)")
+        p.add_argument('--id', default='100', help="first CAN ID, hex (8 digits for extended)")
+        p.add_argument('--ids', type=int, default=1, help="number of consecutive IDs to cycle through")
+        p.add_argument('--dlc', default='8', help="DLC or range, e.g. 0-8")
+        if name == 'run':
+            p.add_argument('--seconds', type=float, default=10.0)
+            p.add_argument('--iface', default='can0')
+    sub.add_parser('disarm', help="back to normal mode on the next start of can0")
+    sub.add_parser('result', help="show the current or last run")
+    args = parser.parse_args()
+
+    dev = open_adapter(args.serial)
+
+    if args.cmd in ('run', 'arm'):
+        lo, _, hi = args.dlc.partition('-')
+        arm(dev, args.rate, parse_id(args.id), args.ids, int(lo), int(hi or lo))
+    if args.cmd == 'run':
+        restart(args.iface)
+        try:
+            time.sleep(args.seconds)
+            show(read_result(dev))
+        finally:
+            disarm(dev)
+            restart(args.iface)
+    elif args.cmd == 'disarm':
+        disarm(dev)
+    elif args.cmd == 'result':
+        show(read_result(dev))
@@ -0,0 +1,127 @@
+import usb.core
+import time
+import math
+import struct
+import argparse
+
+from triton_usb import add_serial_argument, open_adapter
+
+# Drives the adapter's on-device RS02 servo loop (GS_USB_BREQ_TRITON_SERVO).
+# The host streams setpoints at ~100 Hz over EP0; the firmware interpolates
+# them and sends the type-1 operation-control frames itself at rate_hz, and
+# returns the decoded type-2 feedback as one state snapshot per read. Enable
+# the motors first (type 3, e.g. with motor_demo.py); the loop only commands
+# them. With --direct there is no loop: each setpoint goes out once as a
+# GS_USB_BREQ_TRITON_MOTOR_CMD, fixed-point tuples the firmware packs into the
+# frames. Needs pyusb; the gs_usb kernel driver stays bound.
+
+GS_USB_BREQ_TRITON_SERVO = 0x45
+GS_USB_BREQ_TRITON_SERVO_SETPOINT = 0x46
+GS_USB_BREQ_TRITON_MOTOR_CMD = 0x50
+REQ_OUT_VENDOR_DEVICE = 0x40
+REQ_IN_VENDOR_DEVICE = 0xC0
+MOTORS = 8
+MOTOR_CMD_MAX = 32
+MODELS = ('rs02', 'rs03', 'rs04')  # rs_model_t
+
+SERVO_ENABLE = 1 << 0
+SERVO_CONSUME_FEEDBACK = 1 << 1
+FB_VALID = 1 << 0
+FB_STALE = 1 << 1
+HOLDING = 1 << 2
+
+# struct gs_triton_servo_config / _setpoint / _state in gs_usb.h
+CONFIG_FMT = '<I4B3I8B'
+TARGET_FMT = '<5f'
+STATE_HDR_FMT = '<6I'
+STATE_MOTOR_FMT = '<4f4BI'
+# struct gs_triton_motor_target: channel, motor_id, model, reserved, pos, vel, torque, kp, kd
+MOTOR_TARGET_FMT = '<4B3h2H'
+MOTOR_SCALES = (2048, 512, 256, 8, 512)  # GS_TRITON_MOTOR_*_SCALE: pos, vel, torque, kp, kd
+
+def configure(dev, motor_ids, channel=0, host_id=1, rate_hz=1000, setpoint_period_us=10000,
+              timeout_ms=100, consume_feedback=True):
+    flags = SERVO_ENABLE | (SERVO_CONSUME_FEEDBACK if consume_feedback else 0)
+    ids = list(motor_ids) + [0] * (MOTORS - len(motor_ids))
+    dev.ctrl_transfer(REQ_OUT_VENDOR_DEVICE, GS_USB_BREQ_TRITON_SERVO, 0, 0,
+                      struct.pack(CONFIG_FMT, flags, channel, host_id, len(motor_ids), 0,
+                                  rate_hz, setpoint_period_us, timeout_ms, *ids))
+
+def stop(dev):
+    dev.ctrl_transfer(REQ_OUT_VENDOR_DEVICE, GS_USB_BREQ_TRITON_SERVO, 0, 0,
+                      struct.pack(CONFIG_FMT, 0, 0, 0, 0, 0, 0, 0, 0, *([0] * MOTORS)))
+
+def send_setpoint(dev, seq, targets):
+    """targets: one (pos, vel, torque, kp, kd) tuple per configured motor."""
+    raw = struct.pack('<I', seq) + b''.join(struct.pack(TARGET_FMT, *t) for t in targets)
+    dev.ctrl_transfer(REQ_OUT_VENDOR_DEVICE, GS_USB_BREQ_TRITON_SERVO_SETPOINT, 0, 0, raw)
+
+def _fixed(x, scale, lo, hi):
+    return max(lo, min(hi, round(x * scale)))
+
+def send_motor_commands(dev, commands):
+    """commands: (channel, motor_id, model, pos, vel, torque, kp, kd) per motor, model as in MODELS."""
+    if len(commands) > MOTOR_CMD_MAX:
+        raise ValueError(f"at most {MOTOR_CMD_MAX} motors per command")
+    raw = struct.pack('<I', len(commands))
+    for channel, motor_id, model, *values in commands:
+        fixed = [_fixed(v, s, -32768, 32767) for v, s in zip(values[:3], MOTOR_SCALES[:3])]
+        fixed += [_fixed(v, s, 0, 65535) for v, s in zip(values[3:], MOTOR_SCALES[3:])]
+        raw += struct.pack(MOTOR_TARGET_FMT, channel, motor_id, MODELS.index(model), 0, *fixed)
+    dev.ctrl_transfer(REQ_OUT_VENDOR_DEVICE, GS_USB_BREQ_TRITON_MOTOR_CMD, 0, 0, raw)
+
+def read_state(dev):
+    size = struct.calcsize(STATE_HDR_FMT) + MOTORS * struct.calcsize(STATE_MOTOR_FMT)
+    raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_TRITON_SERVO, 0, 0, size))
+    seq, ts, commands, failed, feedback, timeouts = struct.unpack_from(STATE_HDR_FMT, raw)
+    motors = []
+    for off in range(struct.calcsize(STATE_HDR_FMT), len(raw), struct.calcsize(STATE_MOTOR_FMT)):
+        pos, vel, torque, temp, status, fault, mode, _, age = struct.unpack_from(STATE_MOTOR_FMT, raw, off)
+        motors.append({'pos': pos, 'vel': vel, 'torque': torque, 'temp': temp, 'status': status,
+                       'fault': fault, 'mode': mode, 'age_us': age})
+    return {'seq': seq, 'timestamp_us': ts, 'commands': commands, 'commands_failed': failed,
+            'feedback_frames': feedback, 'setpoint_timeouts': timeouts, 'motors': motors}
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Sine trajectory through the TritonCAN on-device servo loop")
+    add_serial_argument(parser)
+    parser.add_argument('motor_ids', type=int, nargs='+')
+    parser.add_argument('--channel', type=int, default=0)
+    parser.add_argument('--host-id', type=int, default=1)
+    parser.add_argument('--rate-hz', type=int, default=1000, help="device command rate per motor")
+    parser.add_argument('--setpoint-hz', type=float, default=100.0)
+    parser.add_argument('--amplitude', type=float, default=0.5, help="rad")
+    parser.add_argument('--freq', type=float, default=0.5, help="trajectory frequency, Hz")
+    parser.add_argument('--kp', type=float, default=20.0)
+    parser.add_argument('--kd', type=float, default=1.0)
+    parser.add_argument('--duration', type=float, default=10.0)
+    parser.add_argument('--direct', action='store_true', help="one motor command per setpoint, no device loop")
+    parser.add_argument('--model', choices=MODELS, default='rs02', help="with --direct")
+    args = parser.parse_args()
+
+    dev = open_adapter(args.serial)
+
+    period = 1.0 / args.setpoint_hz
+    if not args.direct:
+        configure(dev, args.motor_ids, args.channel, args.host_id, args.rate_hz, int(period * 1e6))
+    try:
+        start = time.monotonic()
+        seq = 0
+        while time.monotonic() - start < args.duration:
+            t = seq * period
+            w = 2 * math.pi * args.freq
+            pos, vel = args.amplitude * math.sin(w * t), args.amplitude * w * math.cos(w * t)
+            if args.direct:
+                send_motor_commands(dev, [(args.channel, m, args.model, pos, vel, 0.0, args.kp, args.kd)
+                                          for m in args.motor_ids])
+            else:
+                send_setpoint(dev, seq, [(pos, vel, 0.0, args.kp, args.kd)] * len(args.motor_ids))
+            s = read_state(dev)
+            if seq % int(args.setpoint_hz) == 0:
+                fb = '  '.join(f"{m['pos']:+.3f}rad {m['torque']:+.2f}Nm {m['age_us']}us"
+                               for m in s['motors'][:len(args.motor_ids)])
+                print(f"seq {s['seq']}  cmd {pos:+.3f}  cmds {s['commands']} (failed {s['commands_failed']})  {fb}")
+            seq += 1
+            time.sleep(max(0.0, start + seq * period - time.monotonic()))
+    finally:
+        stop(dev)
@@ -0,0 +1,214 @@
+import usb.core
+import time
+import struct
+import argparse
+
+from triton_usb import add_serial_argument, open_adapter
+
+# Polls the adapter's on-device statistics block (GS_USB_BREQ_TRITON_STATS).
+# Works while can0 is up: it only uses EP0 vendor requests, so the gs_usb
+# kernel driver stays bound. Needs pyusb (pip install pyusb) and read access
+# to the device node (run as root or add a udev rule). USB counters are
+# device-wide; everything else is per channel (--channel). --tasks adds the
+# device-wide CPU share and free stack of every FreeRTOS task
+# (GS_USB_BREQ_TRITON_TASKS).
+
+GS_USB_BREQ_TRITON_STATS = 0x42
+GS_USB_BREQ_TRITON_TASKS = 0x4E
+REQ_IN_VENDOR_DEVICE = 0xC0
+
+# Field order of struct gs_triton_stats (version 10) in gs_usb.h
+FIELDS = [
+    'version', 'size', 'uptime_ms',
+    'rx_frames', 'rx_filtered', 'rx_dropped',
+    'tx_frames', 'tx_failed',
+    'echo_dropped', 'err_frames', 'err_dropped',
+    'rx_ring_hwm', 'echo_queue_hwm', 'tx_inflight_hwm',
+    'usb_transfers', 'usb_write_stalls',
+    'bus_state', 'tec', 'rec',
+    'bus_errors', 'bus_off_count', 'arb_lost', 'rx_missed', 'rx_overrun',
+    'latency_min_us', 'latency_avg_us', 'latency_max_us', 'latency_samples',
+    'rx_evicted',
+    'cyclic_frames', 'cyclic_missed', 'cyclic_late_max_us',
+]
+# v4: stage histograms after the scalar fields, HIST_BUCKETS log2 buckets each
+HIST_BUCKETS = 16
+HISTS = [
+    ('hist_rx_wake', 'INT edge -> RX task', 'us'),
+    ('hist_rx_cycles', 'RX task per frame', 'cycles'),
+    ('hist_rx_dwell', 'RX sample -> USB FIFO', 'us'),
+    ('hist_usb_in', 'USB flush -> IN complete', 'us'),
+    ('hist_tx_wake', 'OUT data -> TX task', 'us'),
+    ('hist_tx_cycles', 'TX task per frame', 'cycles'),
+    ('hist_tx_done', 'submit -> TX complete', 'us'),
+    ('hist_echo_dwell', 'TX complete -> echo in FIFO', 'us'),
+]
+# v5: after the histograms
+FIELDS_V5 = ['reconfig_count', 'reconfig_fast', 'reconfig_last_us', 'reconfig_max_us',
+             'rx_decimated', 'decimate_untracked',  # v6
+             'tx_expired',  # v7
+             'tx_prio_queued', 'tx_reordered', 'tx_prio_hwm',  # v8
+             'rx_spilled', 'rx_spill_bursts', 'rx_spill_hwm',  # v9
+             'usb_flush_full', 'usb_flush_deadline', 'usb_flush_sparse', 'usb_flush_busy',  # v10
+             'usb_batch_target', 'usb_arrival_gap_us',
+             'usb_sessions_lost', 'usb_suspends', 'usb_gap_last_ms', 'usb_gap_max_ms',  # v11
+             'usb_resumed', 'tx_echo_stale']
+STATES = ['ERROR_ACTIVE', 'ERROR_WARNING', 'ERROR_PASSIVE', 'BUS_OFF', 'STOPPED']
+# Cumulative counters: shown as per-second rates between polls
+RATES = ['rx_frames', 'rx_filtered', 'rx_decimated', 'rx_dropped', 'rx_evicted', 'rx_spilled', 'tx_frames', 'tx_failed',
+         'tx_expired', 'tx_prio_queued', 'tx_reordered', 'echo_dropped', 'err_dropped', 'usb_transfers', 'usb_write_stalls', 'bus_errors',
+         'cyclic_frames', 'cyclic_missed', 'usb_flush_full', 'usb_flush_deadline', 'usb_flush_sparse', 'usb_flush_busy']
+
+def read_stats(dev, channel=0):
+    raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_TRITON_STATS, channel, 0,
+                                  4 * (len(FIELDS) + HIST_BUCKETS * len(HISTS) + len(FIELDS_V5))))
+    n = min(len(raw), struct.unpack_from('<I', raw, 4)[0] if len(raw) >= 8 else 0) // 4
+    values = struct.unpack_from('<%dI' % n, raw)
+    s = dict(zip(FIELDS, values))
+    for k in FIELDS[n:]:
+        s[k] = 0  # older firmware
+    for i, (k, _, _) in enumerate(HISTS):
+        start = len(FIELDS) + i * HIST_BUCKETS
+        s[k] = values[start:start + HIST_BUCKETS] if n >= start + HIST_BUCKETS else (0,) * HIST_BUCKETS
+    base = len(FIELDS) + HIST_BUCKETS * len(HISTS)
+    for i, k in enumerate(FIELDS_V5):
+        s[k] = values[base + i] if n > base + i else 0
+    return s
+
+# struct gs_triton_tasks in gs_usb.h: time_us, task_count, isr_cycles, isr_count, cpu_mhz, then
+# TASKS_MAX {name[16], runtime_us, stack_free, core, priority, state, reserved}
+TASKS_MAX = 32
+TASK_FMT = '<16s2I4B'
+TASKS_HDR = '<5I'
+# After the task table: static_dram, heap_boot_free, heap_free, heap_min_free (absent before static memory)
+TASKS_MEMORY = '<4I'
+TASK_STATES = 'RrBSD?'  # running, ready, blocked, suspended, deleted
+
+def read_tasks(dev):
+    raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_TRITON_TASKS, 0, 0,
+                                  struct.calcsize(TASKS_HDR) + TASKS_MAX * struct.calcsize(TASK_FMT) +
+                                  struct.calcsize(TASKS_MEMORY)))
+    time_us, count, isr_cycles, isr_count, cpu_mhz = struct.unpack_from(TASKS_HDR, raw)
+    tasks = {}
+    for i in range(min(count, TASKS_MAX)):
+        name, runtime, stack_free, core, prio, state, _ = struct.unpack_from(
+            TASK_FMT, raw, struct.calcsize(TASKS_HDR) + i * struct.calcsize(TASK_FMT))
+        tasks[name.split(b'\0')[0].decode(errors='replace')] = (runtime, stack_free, core, prio, state)
+    memory_at = struct.calcsize(TASKS_HDR) + TASKS_MAX * struct.calcsize(TASK_FMT)
+    memory = struct.unpack_from(TASKS_MEMORY, raw, memory_at) if len(raw) >= memory_at + struct.calcsize(TASKS_MEMORY) else None
+    return {'time_us': time_us, 'isr_cycles': isr_cycles, 'isr_count': isr_count, 'cpu_mhz': cpu_mhz, 'tasks': tasks,
+            'memory': memory}
+
+def show_tasks(t, prev):
+    """CPU share per task since the previous poll (since boot on the first one), busiest first."""
+    if t['memory']:
+        static_dram, boot_free, free, min_free = t['memory']
+        taken = f"{boot_free - free} B taken since boot" if free < boot_free else "none taken since boot"
+        print(f"  memory: {static_dram} B static DRAM; internal heap {free} B free ({taken}), lowest ever {min_free} B")
+    if not t['tasks']:
+        print("  tasks: no run-time stats (CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS off)")
+        return
+    dt = ((t['time_us'] - prev['time_us']) & 0xFFFFFFFF) if prev else t['time_us']
+    if not dt:
+        return
+    def share(name):
+        runtime = t['tasks'][name][0]
+        before = prev['tasks'].get(name, (0,))[0] if prev else 0
+        return ((runtime - before) & 0xFFFFFFFF) / dt
+    isr_cycles = ((t['isr_cycles'] - prev['isr_cycles']) & 0xFFFFFFFF) if prev else t['isr_cycles']
+    isr_count = ((t['isr_count'] - prev['isr_count']) & 0xFFFFFFFF) if prev else t['isr_count']
+    print(f"  TWAI ISR callbacks: {100 * isr_cycles / (t['cpu_mhz'] * dt):.1f}% of the CAN core, "
+          f"{isr_count * 1e6 / dt:.0f}/s, {isr_cycles / isr_count if isr_count else 0:.0f} cycles each")
+    for name in sorted(t['tasks'], key=share, reverse=True):
+        runtime, stack_free, core, prio, state = t['tasks'][name]
+        where = 'any' if core == 0xFF else f"core{core}"
+        print(f"  {name:16} {100 * share(name):5.1f}%  {where:5} prio {prio:2}  "
+              f"{TASK_STATES[min(state, 5)]}  stack free {stack_free} B")
+
+def percentile(hist, q):
+    """Upper bound of the bucket holding the q-quantile."""
+    target = q * sum(hist)
+    acc = 0
+    for i, count in enumerate(hist):
+        acc += count
+        if acc >= target:
+            return (1 << (i + 1)) - 1 if i < HIST_BUCKETS - 1 else float('inf')
+    return 0
+
+def show_hists(s, prev):
+    """Per-stage distribution since the previous poll (or since boot on the first one)."""
+    for key, title, unit in HISTS:
+        hist = [(a - b) & 0xFFFFFFFF for a, b in zip(s[key], prev[key])] if prev else list(s[key])
+        total = sum(hist)
+        if not total:
+            continue
+        bars = ''.join(' .:-=+*#%@'[min(9, (10 * c + total - 1) // total)] for c in hist)
+        print(f"  {title:28} {total:8}  p50 <={percentile(hist, 0.5)} p99 <={percentile(hist, 0.99)} "
+              f"max <={percentile(hist, 1.0)} {unit}  |{bars}|")
+
+def show(s, prev, dt, channel=0):
+    state = STATES[s['bus_state']] if s['bus_state'] < len(STATES) else str(s['bus_state'])
+    print(f"can{channel}  uptime {s['uptime_ms'] / 1000:.0f}s  state {state}  TEC {s['tec']}  REC {s['rec']}  v{s['version']}")
+    if prev:
+        rate = {k: ((s[k] - prev[k]) & 0xFFFFFFFF) / dt for k in RATES}
+        print(f"  RX {rate['rx_frames']:.0f} pps  filtered {rate['rx_filtered']:.0f}/s  decimated {rate['rx_decimated']:.0f}/s  dropped {rate['rx_dropped']:.0f}/s  evicted {rate['rx_evicted']:.0f}/s")
+        print(f"  TX {rate['tx_frames']:.0f} pps  failed {rate['tx_failed']:.0f}/s  expired {rate['tx_expired']:.0f}/s  echo drops {rate['echo_dropped']:.0f}/s")
+        print(f"  USB {rate['usb_transfers']:.0f} transfers/s  stalls {rate['usb_write_stalls']:.0f}/s  bus errors {rate['bus_errors']:.0f}/s")
+        flushes = ('usb_flush_full', 'usb_flush_deadline', 'usb_flush_sparse', 'usb_flush_busy')
+        if any(rate[k] for k in flushes):
+            print(f"  USB batches/s: full {rate['usb_flush_full']:.0f}  deadline {rate['usb_flush_deadline']:.0f}  "
+                  f"sparse {rate['usb_flush_sparse']:.0f}  busy {rate['usb_flush_busy']:.0f}  "
+                  f"(target {s['usb_batch_target']} frames, arrival gap {s['usb_arrival_gap_us']} us)")
+    print(f"  totals: RX {s['rx_frames']} (dropped {s['rx_dropped']})  TX {s['tx_frames']} (failed {s['tx_failed']})  "
+          f"bus-off {s['bus_off_count']}  arb lost {s['arb_lost']}  missed {s['rx_missed']}  overrun {s['rx_overrun']}")
+    print(f"  high water: rx ring {s['rx_ring_hwm']}  echo queue {s['echo_queue_hwm']}  tx in flight {s['tx_inflight_hwm']}"
+          f"  tx priority queue {s['tx_prio_hwm']}")
+    if s['rx_spill_bursts']:
+        print(f"  PSRAM RX tier: {s['rx_spill_bursts']} bursts, {s['rx_spilled']} frames, deepest {s['rx_spill_hwm']}"
+              + (f", {rate['rx_spilled']:.0f} frames/s now" if prev and rate['rx_spilled'] else ""))
+    if s['usb_sessions_lost'] or s['usb_suspends']:
+        print(f"  USB sessions lost {s['usb_sessions_lost']}  suspends {s['usb_suspends']}  "
+              f"resumed without restart {s['usb_resumed']}  gap last {s['usb_gap_last_ms']} / max {s['usb_gap_max_ms']} ms"
+              f"  stale echoes {s['tx_echo_stale']}")
+    if prev and rate['tx_prio_queued']:
+        print(f"  TX priority queue {rate['tx_prio_queued']:.0f} frames/s  reordered {rate['tx_reordered']:.0f}/s")
+    if s['latency_samples']:
+        print(f"  RX->USB latency: min {s['latency_min_us']} / avg {s['latency_avg_us']} / max {s['latency_max_us']} us "
+              f"({s['latency_samples']} frames)")
+    if s['decimate_untracked']:
+        print(f"  decimation: {s['decimate_untracked']} frames passed untracked (per-ID table full)")
+    if s['reconfig_count']:
+        print(f"  restarts {s['reconfig_count']} ({s['reconfig_fast']} without reinstall)  "
+              f"last {s['reconfig_last_us']} us  max {s['reconfig_max_us']} us")
+    if prev and (rate['cyclic_frames'] or rate['cyclic_missed']):
+        print(f"  cyclic TX {rate['cyclic_frames']:.0f} pps  missed {rate['cyclic_missed']:.0f}/s  "
+              f"worst late {s['cyclic_late_max_us']} us")
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Read TritonCAN adapter statistics")
+    add_serial_argument(parser)
+    parser.add_argument('--interval', type=float, default=1.0, help="poll period in seconds")
+    parser.add_argument('--once', action='store_true', help="print one snapshot and exit")
+    parser.add_argument('--channel', type=int, default=0, help="adapter channel (0 = TWAI, 1.. = MCP2518FD)")
+    parser.add_argument('--hist', action='store_true', help="also show the pipeline stage histograms (v4)")
+    parser.add_argument('--tasks', action='store_true', help="also show CPU share and free stack per task")
+    args = parser.parse_args()
+
+    dev = open_adapter(args.serial)
+
+    prev = prev_tasks = None
+    last_t = time.monotonic()
+    while True:
+        s = read_stats(dev, args.channel)
+        now = time.monotonic()
+        show(s, prev, now - last_t, args.channel)
+        if args.hist:
+            show_hists(s, prev)
+        if args.tasks:
+            tasks = read_tasks(dev)
+            show_tasks(tasks, prev_tasks)
+            prev_tasks = tasks
+        if args.once:
+            break
+        prev, last_t = s, now
+        time.sleep(args.interval)
@@ -0,0 +1,192 @@
+import usb.core
+import time
+import json
+import struct
+import bisect
+import argparse
+
+from triton_clock import ClockSync
+from triton_usb import add_serial_argument, open_adapter
+
+# Per-frame pipeline trace with GS_USB_BREQ_TRITON_TRACE (firmware built with
+# CONFIG_TRITON_TRACE). "record" samples one frame in --every per channel and
+# reads the adapter's event ring: for a received frame when it reached the
+# channel ring, the USB IN FIFO and the host (IN transfer complete); for a
+# host frame when it went to the controller, was sent and its echo queued.
+# Event times are mapped to this host's CLOCK_MONOTONIC with ClockSync and
+# written as Chrome trace-event JSON, which Perfetto (ui.perfetto.dev) opens.
+# "merge" joins that with the host spans td_can_bridges writes for a bus with
+# "trace" set (same clock), linking each host frame to the adapter frame of
+# its CAN ID nearest in time by a flow arrow. Sampling both sides with
+# --every 1 / every: 1 links every frame; with sparser sampling only the
+# frames both happened to trace are linked. Needs pyusb.
+
+GS_USB_BREQ_TRITON_TRACE = 0x52
+REQ_OUT_VENDOR_DEVICE = 0x40
+REQ_IN_VENDOR_DEVICE = 0xC0
+READ = 60
+HEADER = struct.Struct('<IIII')
+EVENT = struct.Struct('<IIIBBH')
+RX_RING, RX_FIFO, USB_IN, TX_DONE, TX_ECHO = range(5)
+ADAPTER_PID = 1
+USB_TID = 100
+
+def set_trace(dev, every):
+    dev.ctrl_transfer(REQ_OUT_VENDOR_DEVICE, GS_USB_BREQ_TRITON_TRACE, 0, 0, struct.pack('<I', every))
+
+def read_events(dev):
+    """(events as (time_us, frame_us, can_id, channel, stage), lost, every) of one read, oldest first."""
+    raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_TRITON_TRACE, 0, 0,
+                                  HEADER.size + READ * EVENT.size))
+    _, count, lost, every = HEADER.unpack_from(raw)
+    events = [EVENT.unpack_from(raw, HEADER.size + i * EVENT.size)[:5] for i in range(count)]
+    return events, lost, every
+
+def span(name, tid, start_ns, end_ns, **args):
+    return {"ph": "X", "cat": "adapter", "name": name, "pid": ADAPTER_PID, "tid": tid,
+            "ts": start_ns / 1000, "dur": max(0, end_ns - start_ns) / 1000, "args": args}
+
+def adapter_events(events):
+    """Trace events of (time_ns, frame_ns, can_id, channel, stage) records in host time."""
+    out = [{"ph": "M", "name": "process_name", "pid": ADAPTER_PID, "args": {"name": "TritonCAN adapter"}},
+           {"ph": "M", "name": "thread_name", "pid": ADAPTER_PID, "tid": USB_TID, "args": {"name": "USB IN"}}]
+    channels = sorted({e[3] for e in events if e[3] != 0xFF})
+    for ch in channels:
+        out.append({"ph": "M", "name": "thread_name", "pid": ADAPTER_PID, "tid": 2 * ch + 1,
+                    "args": {"name": f"CAN{ch} RX"}})
+        out.append({"ph": "M", "name": "thread_name", "pid": ADAPTER_PID, "tid": 2 * ch + 2,
+                    "args": {"name": f"CAN{ch} TX"}})
+    ins = [(e[1], e[0]) for e in events if e[4] == USB_IN]  # (flush, done), in order
+    flushes = [f for f, _ in ins]
+    for flush, done in ins:
+        out.append(span("flush -> IN done", USB_TID, flush, done))
+
+    def usb_in(queued):
+        i = bisect.bisect_left(flushes, queued)
+        return ins[i][1] if i < len(ins) else None
+
+    ring = {}  # (channel, can_id, frame_ns) -> ring time
+    sent = {}  # (channel, can_id, done_ns) -> frame handed to the controller
+    for time_ns, frame_ns, can_id, ch, stage in events:
+        if stage == RX_RING:
+            ring[(ch, can_id, frame_ns)] = time_ns
+            out.append(span("RX -> ring", 2 * ch + 1, frame_ns, time_ns, can_id=can_id))
+        elif stage == RX_FIFO:
+            start = ring.pop((ch, can_id, frame_ns), None)
+            if start is not None:
+                out.append(span("ring -> FIFO", 2 * ch + 1, start, time_ns, can_id=can_id))
+            done = usb_in(time_ns)
+            if done is not None:
+                out.append(span("FIFO -> host", 2 * ch + 1, time_ns, done, can_id=can_id, frame="rx"))
+        elif stage == TX_DONE:
+            sent[(ch, can_id, time_ns)] = frame_ns
+            out.append(span("on the bus", 2 * ch + 2, frame_ns, time_ns, can_id=can_id, frame="tx"))
+        elif stage == TX_ECHO:
+            if (ch, can_id, frame_ns) in sent:
+                out.append(span("echo -> FIFO", 2 * ch + 2, frame_ns, time_ns, can_id=can_id))
+            done = usb_in(time_ns)
+            if done is not None:
+                out.append(span("echo FIFO -> host", 2 * ch + 2, time_ns, done, can_id=can_id))
+    return out
+
+def record(args):
+    dev = open_adapter(args.serial)
+    clock = ClockSync(dev)
+    clock.sync()
+    try:
+        set_trace(dev, args.every)
+    except usb.core.USBError:
+        raise SystemExit("Trace request stalled: firmware built without CONFIG_TRITON_TRACE")
+    events, lost = [], 0
+    start = last_sync = time.monotonic()
+    try:
+        while not args.duration or time.monotonic() - start < args.duration:
+            batch, lost, _ = read_events(dev)
+            # Mapped at once: the fit is freshest for recent events
+            events += [(clock.to_host_ns(t), clock.to_host_ns(f), can_id, ch, stage)
+                       for t, f, can_id, ch, stage in batch]
+            if time.monotonic() - last_sync >= args.sync:
+                clock.sync()
+                last_sync = time.monotonic()
+            if len(batch) < READ:
+                time.sleep(1.0 / args.hz)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        set_trace(dev, 0)
+    trace = {"traceEvents": adapter_events(events), "displayTimeUnit": "ns",
+             "otherData": {"clock": "CLOCK_MONOTONIC", "source": "triton_trace", "every": args.every,
+                           "events": len(events), "lost": lost}}
+    with open(args.output, "w") as out:
+        json.dump(trace, out)
+    print(f"{len(events)} events ({lost} lost) -> {args.output}")
+
+def merge(args):
+    events, other = [], {}
+    for n, path in enumerate(args.traces):
+        with open(path) as f:
+            trace = json.load(f)
+        pids = {}
+        for e in trace["traceEvents"]:
+            # Each file gets its own pid range, so an adapter and a host never share a track
+            e["pid"] = pids.setdefault(e["pid"], 1000 * (n + 1) + len(pids))
+            events.append(e)
+        other[path] = trace.get("otherData", {})
+    window = args.window_us
+    frames = {}  # (kind, CAN ID) -> sorted [(ts, event)] of the adapter's frame ends
+    for e in events:
+        if e.get("cat") == "adapter" and e["ph"] == "X" and "frame" in e["args"]:
+            edge = e["ts"] + e["dur"] if e["args"]["frame"] == "rx" else e["ts"]
+            frames.setdefault((e["args"]["frame"], e["args"]["can_id"] & 0x1FFFFFFF), []).append((edge, e))
+    for candidates in frames.values():
+        candidates.sort(key=lambda c: c[0])
+    flows, used = [], set()
+    for e in events:
+        if e.get("cat") != "host" or e["ph"] != "X":
+            continue
+        if e["name"] == "socket":
+            kind, edge = "rx", e["ts"]
+        elif e["name"].startswith("send "):
+            kind, edge = "tx", e["ts"] + e["dur"]
+        else:
+            continue
+        candidates = frames.get((kind, e["args"]["can_id"] & 0x1FFFFFFF), [])
+        i = bisect.bisect_left(candidates, edge - window, key=lambda c: c[0])
+        best = None
+        while i < len(candidates) and candidates[i][0] <= edge + window:
+            if id(candidates[i][1]) not in used and (best is None or
+                                                     abs(candidates[i][0] - edge) < abs(best[0] - edge)):
+                best = candidates[i]
+            i += 1
+        if best is None:
+            continue
+        used.add(id(best[1]))
+        src, dst = (best[1], e) if kind == "rx" else (e, best[1])
+        flow = len(flows) // 2 + 1
+        flows.append({"ph": "s", "cat": "frame", "name": "frame", "id": flow, "pid": src["pid"],
+                      "tid": src["tid"], "ts": src["ts"]})
+        flows.append({"ph": "f", "bp": "e", "cat": "frame", "name": "frame", "id": flow, "pid": dst["pid"],
+                      "tid": dst["tid"], "ts": dst["ts"]})
+    with open(args.output, "w") as out:
+        json.dump({"traceEvents": events + flows, "displayTimeUnit": "ns",
+                   "otherData": {"clock": "CLOCK_MONOTONIC", "merged": other}}, out)
+    print(f"{len(events)} events, {len(flows) // 2} frames linked -> {args.output}")
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="TritonCAN per-frame pipeline trace")
+    commands = parser.add_subparsers(dest="command", required=True)
+    rec = commands.add_parser("record", help="trace the adapter into a Chrome/Perfetto JSON file")
+    rec.add_argument('-o', '--output', default="adapter-trace.json")
+    add_serial_argument(rec)
+    rec.add_argument('--every', type=int, default=10, help="trace one frame in this many per channel")
+    rec.add_argument('--duration', type=float, default=0, help="seconds to record (0: until Ctrl-C)")
+    rec.add_argument('--hz', type=float, default=100, help="event reads per second while the ring is drained")
+    rec.add_argument('--sync', type=float, default=1.0, help="seconds between clock syncs")
+    rec.set_defaults(run=record)
+    mrg = commands.add_parser("merge", help="join adapter and host traces, linking frames by CAN ID and time")
+    mrg.add_argument('traces', nargs='+', help="triton_trace.py record and td_can_bridges trace files")
+    mrg.add_argument('-o', '--output', default="trace.json")
+    mrg.add_argument('--window-us', type=float, default=2000, help="largest adapter-host gap linked")
+    mrg.set_defaults(run=merge)
+    args = parser.parse_args()
+    args.run(args)
@@ -0,0 +1,43 @@
+import usb.core
+import usb.util
+
+# What the pyusb tools (triton_stats.py, triton_cyclic.py, ...) share: finding
+# the adapter, by serial number when several are attached, and CAN ID
+# arguments. triton_discover.py lists the serial numbers; it reads sysfs and
+# needs no pyusb.
+
+USB_VID = 0x1D50
+USB_PID = 0x606F
+CAN_EFF_FLAG = 0x80000000
+
+def add_serial_argument(parser):
+    parser.add_argument('--serial', help="the adapter with this USB serial number, as triton_discover.py "
+                                         "lists them (default: the first one found)")
+
+def serial_number(dev):
+    """The device's serial number string, or None if it cannot be read (no permission, no string)."""
+    try:
+        return usb.util.get_string(dev, dev.iSerialNumber) if dev.iSerialNumber else None
+    except (usb.core.USBError, ValueError, NotImplementedError):
+        return None
+
+def find_adapter(serial=None):
+    """The adapter's pyusb device; None if it is not attached."""
+    if serial is None:
+        return usb.core.find(idVendor=USB_VID, idProduct=USB_PID)
+    serial = serial.upper()
+    return usb.core.find(idVendor=USB_VID, idProduct=USB_PID,
+                         custom_match=lambda dev: (serial_number(dev) or '').upper() == serial)
+
+def open_adapter(serial=None):
+    """As find_adapter(), for a tool's main: exits with a message if the adapter is not attached."""
+    dev = find_adapter(serial)
+    if dev is None:
+        which = f" with serial {serial}" if serial else ""
+        raise SystemExit(f"Adapter{which} not found (VID 0x{USB_VID:04X}, PID 0x{USB_PID:04X})")
+    return dev
+
+def parse_id(text):
+    """A CAN ID in hex; extended when above 0x7FF or written with more than 3 digits."""
+    can_id = int(text, 16)
+    return can_id | CAN_EFF_FLAG if can_id > 0x7FF or len(text) > 3 else can_id
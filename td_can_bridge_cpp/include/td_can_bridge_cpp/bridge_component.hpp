@@ -0,0 +1,36 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <rclcpp/rclcpp.hpp>
+
+#include "td_can_bridge_cpp/bus_bridge.hpp"
+
+namespace td_can_bridge {
+
+// C++ counterpart of td_can_bridges.bridge_node.TDCANBridge as an rclcpp component. It reads the
+// same YAML (parameter config) and runs every bus of it, or the one named by parameter bus. Loaded
+// into a component container next to the controllers, with intra-process comms on for them too,
+// every decoded frame reaches them as the unique_ptr it was published with: no serialisation and,
+// for a single subscriber, no copy. With parameter loaned_messages the node publishes in messages
+// loaned from the RMW instead, for readers in other processes on the host (Cyclone DDS with
+// iceoryx); intra-process comms are then off. With rx_pool in the YAML, every BridgeComponent
+// of the process publishes on one WorkPool, made by the first of them.
+class BridgeComponent : public rclcpp::Node {
+public:
+    explicit BridgeComponent(const rclcpp::NodeOptions &options);
+    ~BridgeComponent() override;
+
+private:
+    void report_pool();
+
+    std::shared_ptr<WorkPool> pool_;
+    std::vector<std::unique_ptr<BusBridge>> buses_;
+    // The component that made pool_ logs its steals and utilisation
+    rclcpp::TimerBase::SharedPtr pool_timer_;
+    std::vector<WorkPool::WorkerStats> pool_last_;
+    int64_t pool_last_ns_ = 0;
+};
+
+} // namespace td_can_bridge
@@ -0,0 +1,164 @@
+#pragma once
+#include <linux/can.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <rclcpp/rclcpp.hpp>
+
+#include "rx_core.hpp"
+#include "td_can_bridge_cpp/config.hpp"
+#include "td_can_bridge_cpp/dbc.hpp"
+#include "td_can_bridge_cpp/work_pool.hpp"
+
+// One bus of the C++ bridge: the CAN_RAW socket, an RxCore decoding on a thread of its own and
+// the ROS side of the bus's rx_frames and tx_topics. Messages are std_msgs scalars (Float32,
+// Float64, Int8..Int64, UInt8..UInt64, Bool) holding one signal in data, the types the motor
+// configs use; a binding of any other type, a publish: frame binding or a DBC message the RX core
+// would hand back raw is logged and skipped, and stays with the Python bridge. With a WorkPool
+// the RX thread only receives and decodes: it hands each batch to the pool, one lane per frame ID,
+// and the workers publish.
+
+namespace td_can_bridge {
+
+// A std_msgs scalar publisher, type-erased so one RX entry can feed topics of any of the types
+class ScalarPublisher {
+public:
+    virtual ~ScalarPublisher() = default;
+    // Publishes a fresh message through unique_ptr, where intra-process subscribers take it without a
+    // copy, or in a message loaned from the RMW (shared memory with Cyclone DDS and iceoryx)
+    virtual void publish(const td_can::Value &value) = 0;
+};
+
+class BusBridge {
+public:
+    // Opens and binds the socket and creates the publishers and subscriptions; throws
+    // std::system_error when the interface cannot be opened, std::runtime_error on a bad DBC. With
+    // loan, RX topics publish loaned messages where the RMW can loan them. With pool, the RX
+    // topics are published on its workers, in bridge.rx_pool.batches batches of rx_batch frames.
+    BusBridge(rclcpp::Node &node, const BusConfig &cfg, const BridgeConfig &bridge, bool loan = false,
+              std::shared_ptr<WorkPool> pool = nullptr);
+    ~BusBridge();
+    BusBridge(const BusBridge &) = delete;
+    BusBridge &operator=(const BusBridge &) = delete;
+
+    // Starts the RX thread, and with realtime the TX thread after the wakeup self-test. Throws
+    // std::runtime_error when a self-test with required fails.
+    void start();
+    // Stops the threads; with a pool, returns once the workers have published what was received
+    void stop();
+
+    const std::string &name() const { return cfg_.name; }
+    // Heap to fault in before mlockall: realtime.heap_kb, else an estimate from the bindings
+    size_t heap_bytes() const;
+
+private:
+    // A topic fed by one signal of an RX entry
+    struct RxTarget {
+        size_t value = 0;                // index into the entry's decoded values
+        std::string topic;               // may name id_fields
+        std::string type;
+        rclcpp::QoS qos{10};
+        std::vector<std::pair<std::string, std::pair<int, int>>> id_fields;
+        std::unique_ptr<ScalarPublisher> pub;                             // topic without id_fields
+        std::map<std::string, std::unique_ptr<ScalarPublisher>> pubs;     // per formatted topic
+        std::unordered_map<uint32_t, ScalarPublisher *> by_id;            // into pubs, by frame ID
+    };
+    // One RxCore table entry: the signals of every binding of the same ID and mask
+    struct RxEntry {
+        uint32_t id = 0;
+        bool extended = false;
+        uint32_t mask = CAN_EFF_MASK;
+        const Message *message = nullptr;
+        std::vector<std::string> signals;
+        std::vector<RxTarget> targets;
+    };
+    // rx_pool: a received batch on its way through the lanes, back in free_ when the last is done
+    struct Work {
+        td_can::Batch batch;
+        std::vector<uint32_t> next;     // per frame: the next one of the same lane, kEnd after the last
+        std::atomic<size_t> lanes{0};   // lanes still publishing from it
+    };
+    struct Chain {                      // the frames of one lane in a Work
+        Work *work = nullptr;
+        uint32_t first = 0;
+    };
+    // rx_pool: the publish lane of one frame ID, its publishers looked up on the first frame
+    struct RxLane {
+        std::unique_ptr<SerialLane<Chain>> lane;
+        std::vector<std::pair<size_t, ScalarPublisher *>> targets;  // value index, publisher
+        uint64_t epoch = 0;             // RX thread: head and tail are frames of batch number epoch
+        uint32_t head = 0, tail = 0;
+    };
+    static constexpr uint32_t kEnd = UINT32_MAX;
+
+    struct TxEntry {
+        std::string key;
+        const Message *message = nullptr;
+        const Signal *signal = nullptr;
+        rclcpp::SubscriptionBase::SharedPtr subscription;
+        rclcpp::TimerBase::SharedPtr timer;   // period_ms: resends the latest payload
+        std::chrono::nanoseconds hold{0};     // 0: no hold_ms
+        std::mutex mutex;                     // frame, last and have
+        can_frame frame{};
+        std::chrono::steady_clock::time_point last;
+        bool have = false;                    // a payload arrived
+    };
+
+    void open_socket();
+    void add_rx(const RxBinding &binding, const rclcpp::QoS &qos);
+    void add_tx(const TxBinding &binding, const rclcpp::QoS &qos);
+    void apply_filters();
+    RxEntry *find(uint32_t id);
+    // The entry frame publishes to; nullptr for error frames, unbound IDs and short payloads (logged)
+    RxEntry *accept(const td_can::Decoded &frame);
+    void dispatch(const td_can::Decoded &frame, const td_can::Batch &batch);
+    RxLane &lane(uint32_t id, RxEntry &entry);
+    void publish(const Chain &chain, const RxLane &lane);
+    void release(Work *work);
+    ScalarPublisher *publisher(RxTarget &target, uint32_t id);
+    void send(TxEntry &tx, double value);
+    void write_frame(const TxEntry &tx);
+    const std::vector<int> &rx_cpus() const;
+    void realtime_thread(const char *role, int priority, const std::vector<int> &cpus);
+    void selftest();
+    void rx_main();
+    void rx_pooled();
+
+    rclcpp::Node &node_;
+    BusConfig cfg_;
+    Database dbc_;
+    bool loan_;
+    int fd_ = -1;
+    std::unique_ptr<td_can::RxCore> core_;
+    std::thread rx_thread_;
+    // realtime: the TX callbacks run in a group of their own, spun on tx_thread_
+    rclcpp::CallbackGroup::SharedPtr tx_group_;
+    std::unique_ptr<rclcpp::executors::SingleThreadedExecutor> tx_executor_;
+    std::thread tx_thread_;
+    std::vector<std::unique_ptr<RxEntry>> rx_;
+    std::unordered_map<uint32_t, RxEntry *> exact_;   // by ID; frames arrive without the EFF flag
+    std::vector<RxEntry *> masked_;                    // most mask bits first, as RxCore looks them up
+    std::vector<std::unique_ptr<TxEntry>> tx_;
+    std::atomic<uint64_t> short_frames_{0};   // payloads shorter than the DBC length, not published
+    // rx_pool; the lanes go before the pool they run on
+    std::shared_ptr<WorkPool> pool_;
+    std::vector<std::unique_ptr<Work>> works_;
+    std::mutex free_mutex_;
+    std::condition_variable free_cv_;
+    std::vector<Work *> free_;
+    std::unordered_map<uint32_t, std::unique_ptr<RxLane>> lanes_;  // RX thread, by frame ID
+    std::vector<RxLane *> touched_;                                // RX thread: lanes of this batch
+    uint64_t epoch_ = 0;
+};
+
+} // namespace td_can_bridge
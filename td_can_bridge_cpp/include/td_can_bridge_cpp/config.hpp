@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The bridge YAML of td_can_bridges (load_bridge_config in service.py, docs/can_service.md §2),
+// read with the same keys and defaults. Keys only the Python service implements (rx_mode,
+// signal_store, recorder, tx_classes, ...) are accepted and ignored, so one file serves both
+// bridges.
+
+namespace td_can_bridge {
+
+struct QosProfile {
+    std::string reliability = "reliable";
+    std::string durability = "volatile";
+    int depth = 10;
+};
+
+struct RxBinding {
+    std::string key;
+    std::string message;                       // dbc_message, default the key
+    std::string topic;                         // default the key; may name id_fields: "/td/{motor_id}/vel"
+    std::string type = "std_msgs/msg/Float32";
+    std::map<std::string, std::string> fields; // DBC signal -> message field
+    std::optional<uint32_t> can_id;
+    std::optional<uint32_t> id_mask;
+    std::vector<std::pair<std::string, std::pair<int, int>>> id_fields;  // name -> inclusive bit range
+    std::string publish;                       // "frame": the generated message type, rejected here
+};
+
+struct TxBinding {
+    std::string key;
+    std::string message;
+    std::string topic;                         // default the key
+    std::string type = "std_msgs/msg/Float32";
+    std::map<std::string, std::string> fields; // message field -> DBC signal
+    std::string qos = "command";
+    std::optional<double> period_ms;
+    std::optional<double> hold_ms;
+};
+
+// realtime: of a bus (td_can_bridge_cpp only; the Python service ignores it), see realtime.hpp
+struct RealtimeConfig {
+    bool enabled = false;            // the bus has a realtime entry
+    bool lock_memory = true;         // mlockall for the process, after faulting heap_kb in
+    int heap_kb = 0;                 // 0: sized from the bus's bindings
+    int rx_priority = 0;             // SCHED_FIFO priority of the RX thread, 1..99; 0 keeps SCHED_OTHER
+    std::vector<int> rx_cpus;        // default cpu_affinity
+    int tx_priority = 0;             // of the TX thread: the bus's tx_topics callbacks and period_ms timers
+    std::vector<int> tx_cpus;
+    double selftest_s = 1.0;         // wakeup self-test at startup; 0: none
+    int selftest_period_us = 1000;
+    double max_wakeup_us = 200.0;    // worst wakeup the self-test accepts
+    bool selftest_required = false;  // a failed self-test fails the start instead of a warning
+};
+
+// rx_pool: at the top level (td_can_bridge_cpp only), see work_pool.hpp. Absent or workers 0:
+// each bus publishes on its RX thread.
+struct PoolConfig {
+    int workers = 0;                 // threads every bus of the process publishes on
+    int priority = 0;                // SCHED_FIFO priority of the workers; 0 keeps SCHED_OTHER
+    std::vector<int> cpus;           // of the workers
+    int batches = 16;                // RX batches a bus may have queued; then its RX thread waits
+    double report_period_s = 10.0;   // steals and utilisation in the log; 0: never
+};
+
+struct BusConfig {
+    std::string name;
+    std::string interface;
+    std::string dbc_file;                      // resolved against the YAML's directory
+    bool fd = false;
+    bool auto_filters = false;
+    int rx_batch = 64;
+    std::vector<int> cpu_affinity;             // CPUs of the RX thread
+    RealtimeConfig realtime;
+    std::vector<RxBinding> rx_bindings;        // in file order
+    std::vector<TxBinding> tx_bindings;
+};
+
+struct BridgeConfig {
+    std::string path;
+    std::vector<BusConfig> buses;
+    std::map<std::string, QosProfile> qos;
+    PoolConfig rx_pool;
+
+    const BusConfig *bus(const std::string &name) const;
+    // The named profile, else default_depth with the other defaults
+    QosProfile qos_profile(const std::string &name, int default_depth) const;
+};
+
+// Throws std::runtime_error naming the entry ("buses[0].rx_frames.X") when a key is missing or
+// has the wrong type, as load_bridge_config raises ValueError
+BridgeConfig load_bridge_config(const std::string &path);
+
+} // namespace td_can_bridge
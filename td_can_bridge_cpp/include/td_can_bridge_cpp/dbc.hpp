@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "rx_core.hpp"
+
+// The part of a DBC file the C++ bridge needs: messages (BO_), their signals (SG_) and float
+// signal types (SIG_VALTYPE_). Value tables and attributes are skipped, so signals with choices
+// decode to their numbers. Multiplexed messages and messages over 8 bytes are parsed but marked
+// unsupported; the Python bridge serves those.
+
+namespace td_can_bridge {
+
+struct Signal {
+    std::string name;
+    int start = 0;            // DBC start bit: the LSB (Intel) or the MSB in sawtooth numbering (Motorola)
+    int length = 0;
+    bool big_endian = false;
+    bool is_signed = false;
+    bool is_float = false;
+    double scale = 1.0;
+    double offset = 0.0;
+    double minimum = 0.0;
+    double maximum = 0.0;     // minimum == maximum: no range
+    bool multiplexed = false; // a multiplexer or multiplexed signal
+};
+
+struct Message {
+    std::string name;
+    uint32_t frame_id = 0;    // without CAN_EFF_FLAG
+    bool extended = false;
+    int length = 0;
+    std::vector<Signal> signals;
+
+    // False for what the RX core would hand back raw: multiplexed, over 8 bytes, a float of other
+    // than 32 or 64 bits, a Motorola signal running past the payload
+    bool supported() const;
+    const Signal *signal(const std::string &name) const;
+    // RxCore layout of one signal of a supported() message, as native_layout() in decoders.py
+    td_can::SignalSpec layout(const Signal &signal) const;
+    // Writes value (physical units) into the first length bytes of data; throws std::out_of_range
+    // when it is outside the DBC range or the raw value does not fit the signal
+    void encode(const Signal &signal, double value, uint8_t *data) const;
+};
+
+class Database {
+public:
+    // Throws std::runtime_error when the file cannot be read or a BO_/SG_ line is malformed
+    static Database load(const std::string &path);
+
+    const Message *message(const std::string &name) const;
+    const std::vector<Message> &messages() const { return messages_; }
+
+private:
+    std::vector<Message> messages_;
+    std::map<std::string, size_t> by_name_;
+};
+
+} // namespace td_can_bridge
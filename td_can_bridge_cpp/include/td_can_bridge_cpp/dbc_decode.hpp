@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// Bit extraction for the headers scripts/dbc_to_cpp.py generates from a DBC: one struct per
+// message with an inline decode(). Every signal's position is a template argument, so each
+// extraction compiles to a shift and a mask of the payload read once as a 64-bit integer, the
+// layout of td_can_bridges.decoders.native_layout. No heap, no tables, no virtual calls.
+
+namespace td_can_bridge::dbc {
+
+// The first N bytes of a payload as one little-endian (Intel) integer
+template <unsigned N>
+constexpr uint64_t load_le(const uint8_t *data) noexcept
+{
+    static_assert(N >= 1 && N <= 8, "payloads over 8 bytes are not decoded in C++");
+    uint64_t v = 0;
+    for (unsigned i = 0; i < N; i++) v |= uint64_t(data[i]) << (8 * i);
+    return v;
+}
+
+// ... and as one big-endian (Motorola) integer
+template <unsigned N>
+constexpr uint64_t load_be(const uint8_t *data) noexcept
+{
+    static_assert(N >= 1 && N <= 8, "payloads over 8 bytes are not decoded in C++");
+    uint64_t v = 0;
+    for (unsigned i = 0; i < N; i++) v = (v << 8) | data[i];
+    return v;
+}
+
+template <unsigned Length>
+constexpr uint64_t mask() noexcept
+{
+    static_assert(Length >= 1 && Length <= 64, "signal length out of range");
+    return Length >= 64 ? ~0ull : (1ull << (Length % 64)) - 1;
+}
+
+// The raw bits of a signal whose LSB is bit Shift of the payload integer
+template <unsigned Shift, unsigned Length>
+constexpr uint64_t bits(uint64_t payload) noexcept
+{
+    static_assert(Shift + Length <= 64, "signal runs past the payload");
+    return (payload >> Shift) & mask<Length>();
+}
+
+// ... sign-extended
+template <unsigned Shift, unsigned Length>
+constexpr int64_t sbits(uint64_t payload) noexcept
+{
+    const uint64_t raw = bits<Shift, Length>(payload);
+    if constexpr (Length < 64) {
+        if (raw >> (Length - 1)) return int64_t(raw | ~mask<Length>());
+    }
+    return int64_t(raw);
+}
+
+// Physical value of an integer signal; raw * scale + offset rounds like the Python decoders when
+// built with -ffp-contract=off
+template <unsigned Shift, unsigned Length, bool Signed>
+constexpr double scaled(uint64_t payload, double scale, double offset) noexcept
+{
+    if constexpr (Signed) {
+        return double(sbits<Shift, Length>(payload)) * scale + offset;
+    } else {
+        return double(bits<Shift, Length>(payload)) * scale + offset;
+    }
+}
+
+// IEEE 754 signals of 32 or 64 bits; memcpy keeps these out of constant expressions
+template <unsigned Shift, unsigned Length>
+inline double ieee(uint64_t payload, double scale, double offset) noexcept
+{
+    static_assert(Length == 32 || Length == 64, "float signals are 32 or 64 bits");
+    const uint64_t raw = bits<Shift, Length>(payload);
+    if constexpr (Length == 32) {
+        const uint32_t b = uint32_t(raw);
+        float f;
+        std::memcpy(&f, &b, sizeof(f));
+        return double(f) * scale + offset;
+    } else {
+        double f;
+        std::memcpy(&f, &raw, sizeof(f));
+        return f * scale + offset;
+    }
+}
+
+// An inclusive bit range of the arbitration ID, as in a binding's id_fields
+template <unsigned Low, unsigned High>
+constexpr uint32_t id_field(uint32_t can_id) noexcept
+{
+    static_assert(Low <= High && High < 29, "ID field out of range");
+    return uint32_t(bits<Low, High - Low + 1>(can_id));
+}
+
+} // namespace td_can_bridge::dbc
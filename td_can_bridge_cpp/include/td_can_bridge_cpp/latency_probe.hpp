@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <rclcpp/rclcpp.hpp>
+#include <std_msgs/msg/float32.hpp>
+
+namespace td_can_bridge {
+
+// Consumer for scripts/bench_launch.py. Subscribes to a std_msgs/Float32 topic whose data carries a
+// sequence number (the bench's FootForce forceN) and stamps each message with steady_clock on
+// arrival. That is CLOCK_MONOTONIC, which the bench sends with, so the difference is the latency
+// from the frame's send to the callback. Loaded next to the bridge it measures the intra-process
+// path; run alone (latency_probe) it measures the DDS one. Writes "<sequence> <ns>" lines to
+// parameter output once a second and on destruction.
+class LatencyProbe : public rclcpp::Node {
+public:
+    explicit LatencyProbe(const rclcpp::NodeOptions &options);
+    ~LatencyProbe() override;
+
+private:
+    void flush();
+
+    std::mutex mutex_;   // samples_: the callback and the timer may run on different threads
+    std::vector<std::pair<uint32_t, int64_t>> samples_;
+    std::FILE *out_ = nullptr;
+    rclcpp::Subscription<std_msgs::msg::Float32>::SharedPtr sub_;
+    rclcpp::TimerBase::SharedPtr timer_;
+};
+
+} // namespace td_can_bridge
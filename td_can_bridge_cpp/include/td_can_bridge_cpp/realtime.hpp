@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Process and thread set-up for a bus with realtime: (config.hpp). A page fault, a heap that grows
+// through mmap or a thread of the desktop taking the RX CPU each cost milliseconds; a bridge that
+// decodes in microseconds only keeps that if none of them happen. The calls return 0 or the errno
+// of what failed, so the bridge decides whether that is a warning or an error.
+
+namespace td_can_bridge {
+
+// Faults heap_bytes of heap in and keeps freed memory there (no trim, no mmap for large blocks),
+// then mlockall(MCL_CURRENT | MCL_FUTURE): later allocations reuse pages that are already
+// resident. Needs CAP_IPC_LOCK or a memlock limit (ulimit -l) above the process size.
+int lock_memory(size_t heap_bytes);
+
+// SCHED_FIFO at priority (0: leave the policy) and the CPUs (empty: leave them) for the calling
+// thread, and its stack faulted in. Tries both and returns the first error.
+int set_thread_realtime(int priority, const std::vector<int> &cpus);
+
+struct WakeupStats {
+    size_t samples = 0;
+    size_t over = 0;        // wakeups later than the limit
+    double mean_us = 0.0;
+    double p99_us = 0.0;
+    double max_us = 0.0;
+    int error = 0;          // of set_thread_realtime on the test thread: the figures are then without it
+};
+
+// Sleeps to absolute CLOCK_MONOTONIC deadlines every period_us for seconds, on a thread of its
+// own with the priority and CPUs given, and reports how late each wakeup was. What the RX thread
+// would see on the same CPUs, before any frame is waiting.
+WakeupStats wakeup_test(int period_us, double seconds, int priority, const std::vector<int> &cpus, double limit_us);
+
+} // namespace td_can_bridge
@@ -0,0 +1,120 @@
+#pragma once
+#include <linux/can.h>
+#include <sys/socket.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <hardware_interface/handle.hpp>
+#include <hardware_interface/hardware_info.hpp>
+#include <hardware_interface/system_interface.hpp>
+#include <hardware_interface/types/hardware_interface_return_values.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <rclcpp_lifecycle/state.hpp>
+
+#include "robostride.h"
+#include "rx_core.hpp"
+
+// ros2_control hardware for RoboStride motors on one SocketCAN interface, with no ROS topic between
+// the controller and the bus. write() packs a type-1 operation-control frame for every joint with
+// rs_pack_op_control_batch and sends them in one sendmmsg; read() drains the type-2 feedback the
+// motors answer with through an RxCore polled without waiting, so the state a controller sees is
+// the reply to the previous cycle's command. Declared in the URDF as
+//
+//   <ros2_control name="limb" type="system">
+//     <hardware>
+//       <plugin>td_can_bridge/RobostrideSystem</plugin>
+//       <param name="can_interface">can0</param>
+//       <param name="host_id">0xFD</param>
+//       <param name="cycle_budget_us">1000</param>
+//     </hardware>
+//     <joint name="hip"><param name="motor_id">1</param><param name="model">RS03</param>...</joint>
+//   </ros2_control>
+
+namespace td_can_bridge {
+
+class RobostrideSystem : public hardware_interface::SystemInterface {
+public:
+    hardware_interface::CallbackReturn on_init(const hardware_interface::HardwareInfo &info) override;
+    hardware_interface::CallbackReturn on_configure(const rclcpp_lifecycle::State &previous) override;
+    hardware_interface::CallbackReturn on_cleanup(const rclcpp_lifecycle::State &previous) override;
+    hardware_interface::CallbackReturn on_activate(const rclcpp_lifecycle::State &previous) override;
+    hardware_interface::CallbackReturn on_deactivate(const rclcpp_lifecycle::State &previous) override;
+
+    std::vector<hardware_interface::StateInterface> export_state_interfaces() override;
+    std::vector<hardware_interface::CommandInterface> export_command_interfaces() override;
+
+    hardware_interface::return_type read(const rclcpp::Time &time, const rclcpp::Duration &period) override;
+    hardware_interface::return_type write(const rclcpp::Time &time, const rclcpp::Duration &period) override;
+
+private:
+    struct Joint {
+        std::string name;
+        uint8_t motor_id = 0;
+        const rs_limits_t *limits = nullptr;
+        double kp = 0.0;   // for the position term; 0 with no position command
+        double kd = 0.0;
+        // state
+        double position = 0.0;
+        double velocity = 0.0;
+        double effort = 0.0;
+        double temperature = 0.0;
+        uint8_t fault = 0;
+        bool fresh = false;   // feedback arrived in this read()
+        // commands, NaN until a controller writes them
+        double cmd_position = 0.0;
+        double cmd_velocity = 0.0;
+        double cmd_effort = 0.0;
+    };
+    // Mean and maximum of one duration over a report period
+    struct Timing {
+        uint64_t count = 0;
+        double sum_us = 0.0;
+        double max_us = 0.0;
+        void add(double us);
+    };
+
+    void open_socket();
+    void close_socket();
+    // Type 3 (enable) or 4 (stop) to every joint, in one sendmmsg
+    bool send_all(uint8_t type);
+    bool send_frames(size_t n);
+    void report(std::chrono::steady_clock::time_point now);
+
+    std::string interface_;
+    uint8_t host_id_ = 0xFD;
+    double budget_us_ = 1000.0;   // one controller_manager cycle: 1000 at 1 kHz, 2000 at 500 Hz
+    std::chrono::nanoseconds report_period_{std::chrono::seconds(5)};
+
+    std::vector<Joint> joints_;
+    std::array<int16_t, 256> by_motor_;   // joint index by motor ID, -1 for none
+
+    int fd_ = -1;
+    std::unique_ptr<td_can::RxCore> core_;
+    td_can::Batch batch_;
+    // write(): the packed commands and the frames and headers sendmmsg takes, sized once in on_init
+    std::vector<const rs_limits_t *> limits_;
+    std::vector<uint8_t> motor_ids_;
+    std::vector<rs_command_t> commands_;
+    std::vector<rs_frame_t> packed_;
+    std::vector<can_frame> frames_;
+    std::vector<iovec> iov_;
+    std::vector<mmsghdr> hdrs_;
+
+    // Cycle-time budget, logged every report_period_
+    Timing period_;
+    Timing read_;
+    Timing write_;
+    uint64_t late_ = 0;          // cycles whose period ran over the budget by more than a quarter
+    uint64_t missed_ = 0;        // joint-cycles with no feedback
+    uint64_t tx_dropped_ = 0;    // frames the socket would not take
+    uint64_t faults_ = 0;        // feedback with a fault bit set
+    std::chrono::steady_clock::time_point last_report_;
+};
+
+} // namespace td_can_bridge
@@ -0,0 +1,158 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Work-stealing pool for the bridge's publish work (rx_pool: in config.hpp). It runs lanes, not
+// loose tasks: a lane is a serial queue, so what it holds runs one job at a time and in post
+// order, while different lanes run on as many workers as there are. The bridge keeps one lane per
+// (bus, frame ID), which orders the frames of one ID on a bus as they arrived without
+// serialising the rest of the bus.
+//
+// Every worker has a deque of lanes that have work. A lane posted from outside the pool goes to the
+// back of its home worker's deque (lanes are spread over the workers as they are created). A
+// worker takes lanes from the front of its own deque, oldest first, and runs up to kBudget jobs of
+// each before it puts the lane back behind the others. A worker with an empty deque steals the
+// newest lane from the back of another's, so a hot bus spreads over every core while the other
+// buses are quiet. Idle workers sleep on a condition variable; a post wakes one of them when any
+// are asleep.
+
+namespace td_can_bridge {
+
+class WorkPool {
+public:
+    static constexpr size_t kBudget = 32;  // jobs of one lane per turn
+
+    // Base of SerialLane: what the workers schedule
+    class Lane {
+    public:
+        virtual ~Lane() = default;
+
+    protected:
+        explicit Lane(WorkPool &pool) : pool_(pool), home_(pool.next_home()) {}
+        // Runs up to budget jobs; true when more are left (the lane stays scheduled)
+        virtual bool run(size_t budget) = 0;
+        // To be called by a post that found the lane idle
+        void schedule() { pool_.schedule(this); }
+        WorkPool &pool_;
+
+    private:
+        friend class WorkPool;
+        size_t home_;
+    };
+
+    struct WorkerStats {
+        uint64_t turns = 0;    // lane turns run, up to kBudget jobs each
+        uint64_t steals = 0;   // lanes taken from another worker's deque
+        uint64_t busy_ns = 0;  // time spent running lanes
+    };
+
+    // Starts that many worker threads (at least one), each set to priority and cpus as
+    // set_thread_realtime does; a failure there is kept in thread_error() and the worker runs regardless
+    WorkPool(size_t workers, int priority = 0, const std::vector<int> &cpus = {});
+    // Runs what is still queued, then joins the workers
+    ~WorkPool();
+    WorkPool(const WorkPool &) = delete;
+    WorkPool &operator=(const WorkPool &) = delete;
+
+    size_t workers() const { return workers_.size(); }
+    WorkerStats stats(size_t worker) const;
+    int thread_error() const { return thread_error_.load(std::memory_order_relaxed); }
+    static int64_t now_ns();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Lane *> lanes;
+        std::atomic<uint64_t> turns{0}, steals{0}, busy_ns{0};
+        std::thread thread;
+    };
+
+    size_t next_home() { return homes_.fetch_add(1, std::memory_order_relaxed) % workers_.size(); }
+    void schedule(Lane *lane);
+    Lane *take(size_t self);
+    Lane *steal(size_t self);
+    void run(size_t self, int priority, const std::vector<int> &cpus);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> homes_{0};
+    std::atomic<size_t> queued_{0};    // lanes in the deques
+    std::atomic<size_t> sleepers_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;            // under sleep_mutex_
+    std::atomic<int> thread_error_{0};
+};
+
+// A lane of Job values, handed to handler one at a time in post order. post() may be called from
+// any thread. The destructor waits until no worker holds the lane; post nothing to it after that.
+template <class Job>
+class SerialLane : public WorkPool::Lane {
+public:
+    SerialLane(WorkPool &pool, std::function<void(Job &)> handler) : Lane(pool), handler_(std::move(handler)) {}
+    ~SerialLane() override
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return !scheduled_; });
+    }
+
+    void post(Job job)
+    {
+        bool wake = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // A ring that grows by doubling: steady state allocates nothing
+            if (count_ == ring_.size()) {
+                std::vector<Job> bigger(std::max<size_t>(16, ring_.size() * 2));
+                for (size_t i = 0; i < count_; i++) bigger[i] = std::move(ring_[(head_ + i) % ring_.size()]);
+                ring_.swap(bigger);
+                head_ = 0;
+            }
+            ring_[(head_ + count_) % ring_.size()] = std::move(job);
+            count_++;
+            wake = !scheduled_;
+            scheduled_ = true;
+        }
+        if (wake) schedule();
+    }
+
+private:
+    bool run(size_t budget) override
+    {
+        for (size_t n = 0; n < budget; n++) {
+            Job job;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (count_ == 0) {
+                    // Last touch of the lane by this worker: a destructor may go ahead from here
+                    scheduled_ = false;
+                    idle_.notify_all();
+                    return false;
+                }
+                job = std::move(ring_[head_]);
+                head_ = (head_ + 1) % ring_.size();
+                count_--;
+            }
+            handler_(job);
+        }
+        return true;
+    }
+
+    std::function<void(Job &)> handler_;
+    std::mutex mutex_;
+    std::condition_variable idle_;
+    std::vector<Job> ring_;
+    size_t head_ = 0, count_ = 0;
+    bool scheduled_ = false;  // in a deque or running on a worker
+};
+
+} // namespace td_can_bridge
@@ -0,0 +1,134 @@
+#include "td_can_bridge_cpp/bridge_component.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+#include <rclcpp_components/register_node_macro.hpp>
+
+#include "td_can_bridge_cpp/config.hpp"
+#include "td_can_bridge_cpp/realtime.hpp"
+
+namespace td_can_bridge {
+
+namespace {
+
+// loaned_messages has to be known before the node exists, to choose its intra-process setting
+bool loaned_messages(const rclcpp::NodeOptions &options)
+{
+    for (const rclcpp::Parameter &p : options.parameter_overrides()) {
+        if (p.get_name() == "loaned_messages") return p.as_bool();
+    }
+    return false;
+}
+
+// The process's pool: components in one container share it while any of them holds it
+std::shared_ptr<WorkPool> shared_pool(const PoolConfig &cfg, bool &created)
+{
+    static std::mutex mutex;
+    static std::weak_ptr<WorkPool> pool;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<WorkPool> existing = pool.lock();
+    created = !existing;
+    if (existing) return existing;
+    existing = std::make_shared<WorkPool>(size_t(cfg.workers), cfg.priority, cfg.cpus);
+    pool = existing;
+    return existing;
+}
+
+} // namespace
+
+BridgeComponent::BridgeComponent(const rclcpp::NodeOptions &options)
+    // A loaned message goes out through the RMW only, past any intra-process subscriber: one or the other
+    : rclcpp::Node("td_can_bridge", rclcpp::NodeOptions(options).use_intra_process_comms(!loaned_messages(options)))
+{
+    std::string path = declare_parameter<std::string>("config", "");
+    std::string bus_name = declare_parameter<std::string>("bus", "");
+    bool loan = declare_parameter<bool>("loaned_messages", false);
+    if (path.empty()) throw std::runtime_error("parameter 'config' is required (path to YAML config).");
+
+    BridgeConfig cfg = load_bridge_config(path);
+    std::vector<const BusConfig *> buses;
+    for (const BusConfig &bus : cfg.buses) {
+        if (bus_name.empty() || bus.name == bus_name) buses.push_back(&bus);
+    }
+    if (!bus_name.empty() && buses.empty()) throw std::runtime_error("Config has no bus named '" + bus_name + "'.");
+    if (buses.empty()) throw std::runtime_error("Config has no 'buses' entries.");
+
+    bool created = false;
+    if (cfg.rx_pool.workers > 0) {
+        pool_ = shared_pool(cfg.rx_pool, created);
+        if (!created && pool_->workers() != size_t(cfg.rx_pool.workers)) {
+            RCLCPP_WARN(get_logger(), "rx_pool: joining the process's pool of %zu workers, not %d", pool_->workers(),
+                        cfg.rx_pool.workers);
+        }
+    }
+    for (const BusConfig *bus : buses) buses_.push_back(std::make_unique<BusBridge>(*this, *bus, cfg, loan, pool_));
+    // After the publishers exist, before any thread runs: everything from here on is resident
+    size_t heap = 0;
+    bool lock = false;
+    for (size_t i = 0; i < buses.size(); i++) {
+        if (!buses[i]->realtime.enabled || !buses[i]->realtime.lock_memory) continue;
+        lock = true;
+        heap += buses_[i]->heap_bytes();
+    }
+    if (lock) {
+        int error = lock_memory(heap);
+        if (error) {
+            RCLCPP_WARN(get_logger(), "realtime: mlockall failed (%s); needs CAP_IPC_LOCK or a higher ulimit -l",
+                        std::strerror(error));
+        } else {
+            RCLCPP_INFO(get_logger(), "realtime: memory locked, %zu KiB of heap faulted in", heap / 1024);
+        }
+    }
+    for (auto &bus : buses_) bus->start();
+    if (created) {
+        if (pool_->thread_error()) {
+            RCLCPP_WARN(get_logger(), "rx_pool: SCHED_FIFO %d / %zu CPUs not (all) applied to the workers: %s",
+                        cfg.rx_pool.priority, cfg.rx_pool.cpus.size(), std::strerror(pool_->thread_error()));
+        }
+        if (cfg.rx_pool.report_period_s > 0) {
+            pool_last_.resize(pool_->workers());
+            pool_last_ns_ = WorkPool::now_ns();
+            auto period = std::chrono::nanoseconds(int64_t(cfg.rx_pool.report_period_s * 1e9));
+            pool_timer_ = create_wall_timer(period, [this]() { report_pool(); });
+        }
+    }
+    RCLCPP_INFO(get_logger(), "td_can_bridge_cpp started with %zu bus(es), %s%s.", buses_.size(),
+                loan ? "loaned messages" : "intra-process",
+                pool_ ? (", publishing on " + std::to_string(pool_->workers()) + " pool workers").c_str() : "");
+}
+
+void BridgeComponent::report_pool()
+{
+    // Per worker since the last report: share of the time spent publishing, and lanes stolen
+    int64_t now = WorkPool::now_ns();
+    double wall = double(now - pool_last_ns_);
+    pool_last_ns_ = now;
+    std::string line;
+    uint64_t turns = 0, steals = 0;
+    for (size_t i = 0; i < pool_last_.size(); i++) {
+        WorkPool::WorkerStats s = pool_->stats(i);
+        const WorkPool::WorkerStats &last = pool_last_[i];
+        char part[64];
+        std::snprintf(part, sizeof(part), "%s%.0f%%/%lu", i ? " " : "", 100.0 * double(s.busy_ns - last.busy_ns) / wall,
+                      (unsigned long)(s.steals - last.steals));
+        line += part;
+        turns += s.turns - last.turns;
+        steals += s.steals - last.steals;
+        pool_last_[i] = s;
+    }
+    RCLCPP_INFO(get_logger(), "rx_pool: %lu lane turns, %lu stolen; per worker busy/steals: %s", (unsigned long)turns,
+                (unsigned long)steals, line.c_str());
+}
+
+BridgeComponent::~BridgeComponent()
+{
+    // RX threads publish through this node: stop them before it goes
+    for (auto &bus : buses_) bus->stop();
+}
+
+} // namespace td_can_bridge
+
+RCLCPP_COMPONENTS_REGISTER_NODE(td_can_bridge::BridgeComponent)
@@ -0,0 +1,572 @@
+#include "td_can_bridge_cpp/bus_bridge.hpp"
+
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+
+#include "td_can_bridge_cpp/realtime.hpp"
+
+#include <std_msgs/msg/bool.hpp>
+#include <std_msgs/msg/float32.hpp>
+#include <std_msgs/msg/float64.hpp>
+#include <std_msgs/msg/int16.hpp>
+#include <std_msgs/msg/int32.hpp>
+#include <std_msgs/msg/int64.hpp>
+#include <std_msgs/msg/int8.hpp>
+#include <std_msgs/msg/u_int16.hpp>
+#include <std_msgs/msg/u_int32.hpp>
+#include <std_msgs/msg/u_int64.hpp>
+#include <std_msgs/msg/u_int8.hpp>
+
+namespace td_can_bridge {
+
+namespace {
+
+template <typename T>
+T to_data(const td_can::Value &v)
+{
+    switch (v.kind) {
+    case td_can::Value::Float: return static_cast<T>(v.d);
+    case td_can::Value::Int: return static_cast<T>(v.i);
+    default: return static_cast<T>(v.u);
+    }
+}
+
+template <typename Msg>
+class TypedPublisher : public ScalarPublisher {
+public:
+    TypedPublisher(rclcpp::Node &node, const std::string &topic, const rclcpp::QoS &qos, bool loan)
+        : pub_(node.create_publisher<Msg>(topic, qos))
+    {
+        loan_ = loan && pub_->can_loan_messages();
+        if (loan && !loan_)
+            RCLCPP_WARN(node.get_logger(), "%s: the RMW cannot loan messages here, publishing copies", topic.c_str());
+    }
+
+    void publish(const td_can::Value &value) override
+    {
+        if (loan_) {
+            // Decoded straight into middleware memory; readers on the host map the same sample
+            auto msg = pub_->borrow_loaned_message();
+            msg.get().data = to_data<decltype(Msg::data)>(value);
+            pub_->publish(std::move(msg));
+            return;
+        }
+        auto msg = std::make_unique<Msg>();
+        msg->data = to_data<decltype(Msg::data)>(value);
+        pub_->publish(std::move(msg));
+    }
+
+private:
+    typename rclcpp::Publisher<Msg>::SharedPtr pub_;
+    bool loan_ = false;
+};
+
+// Calls f with a null Msg* for the std_msgs scalar named by type; false for any other type
+template <typename F>
+bool with_scalar(const std::string &type, F &&f)
+{
+    namespace m = std_msgs::msg;
+    if (type == "std_msgs/msg/Float32") f(static_cast<m::Float32 *>(nullptr));
+    else if (type == "std_msgs/msg/Float64") f(static_cast<m::Float64 *>(nullptr));
+    else if (type == "std_msgs/msg/Int8") f(static_cast<m::Int8 *>(nullptr));
+    else if (type == "std_msgs/msg/Int16") f(static_cast<m::Int16 *>(nullptr));
+    else if (type == "std_msgs/msg/Int32") f(static_cast<m::Int32 *>(nullptr));
+    else if (type == "std_msgs/msg/Int64") f(static_cast<m::Int64 *>(nullptr));
+    else if (type == "std_msgs/msg/UInt8") f(static_cast<m::UInt8 *>(nullptr));
+    else if (type == "std_msgs/msg/UInt16") f(static_cast<m::UInt16 *>(nullptr));
+    else if (type == "std_msgs/msg/UInt32") f(static_cast<m::UInt32 *>(nullptr));
+    else if (type == "std_msgs/msg/UInt64") f(static_cast<m::UInt64 *>(nullptr));
+    else if (type == "std_msgs/msg/Bool") f(static_cast<m::Bool *>(nullptr));
+    else return false;
+    return true;
+}
+
+std::unique_ptr<ScalarPublisher> make_publisher(rclcpp::Node &node, const std::string &type,
+                                                const std::string &topic, const rclcpp::QoS &qos, bool loan)
+{
+    std::unique_ptr<ScalarPublisher> pub;
+    with_scalar(type, [&](auto *tag) {
+        using Msg = std::remove_pointer_t<decltype(tag)>;
+        pub = std::make_unique<TypedPublisher<Msg>>(node, topic, qos, loan);
+    });
+    return pub;
+}
+
+// The signal a std_msgs scalar carries in data: the one of fields, or of a one-signal message
+std::string scalar_signal(const std::map<std::string, std::string> &fields, bool signal_first, const Message &msg)
+{
+    if (fields.size() == 1) {
+        const auto &[first, second] = *fields.begin();
+        if ((signal_first ? second : first) == "data") return signal_first ? first : second;
+        return "";
+    }
+    if (fields.empty() && msg.signals.size() == 1) return msg.signals[0].name;
+    return "";
+}
+
+std::string lower(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    return text;
+}
+
+rclcpp::QoS make_qos(const QosProfile &profile, const rclcpp::Logger &logger)
+{
+    rclcpp::QoS qos(rclcpp::KeepLast(profile.depth));
+    if (lower(profile.reliability) == "best_effort") qos.best_effort();
+    else qos.reliable();
+    // Intra-process publishers refuse transient_local; the Python bridge keeps serving latched topics
+    if (lower(profile.durability) == "transient_local")
+        RCLCPP_WARN(logger, "QoS durability transient_local is not available with intra-process comms; using volatile");
+    qos.durability_volatile();
+    return qos;
+}
+
+} // namespace
+
+BusBridge::BusBridge(rclcpp::Node &node, const BusConfig &cfg, const BridgeConfig &bridge, bool loan,
+                     std::shared_ptr<WorkPool> pool)
+    : node_(node), cfg_(cfg), dbc_(Database::load(cfg.dbc_file)), loan_(loan), pool_(std::move(pool))
+{
+    open_socket();
+    core_ = std::make_unique<td_can::RxCore>(fd_, size_t(std::max(cfg_.rx_batch, 1)));
+    // Not added to the node's executor: tx_thread_ spins it
+    if (cfg_.realtime.enabled) tx_group_ = node_.create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, false);
+
+    rclcpp::QoS sensor = make_qos(bridge.qos_profile("sensor", 20), node_.get_logger());
+    for (const RxBinding &binding : cfg_.rx_bindings) add_rx(binding, sensor);
+    for (const TxBinding &binding : cfg_.tx_bindings)
+        add_tx(binding, make_qos(bridge.qos_profile(binding.qos, 10), node_.get_logger()));
+
+    for (const auto &entry : rx_) {
+        td_can::MessageSpec spec;
+        spec.length = uint8_t(entry->message->length);
+        for (const std::string &name : entry->signals) spec.signals.push_back(entry->message->layout(*entry->message->signal(name)));
+        core_->set_message(entry->id, entry->extended, std::move(spec), entry->mask);
+    }
+    std::stable_sort(masked_.begin(), masked_.end(), [](const RxEntry *a, const RxEntry *b) {
+        return __builtin_popcount(a->mask) > __builtin_popcount(b->mask);
+    });
+    if (cfg_.auto_filters) apply_filters();
+    if (pool_) {
+        // Sized once, like the batch of rx_main: the pooled RX path allocates only on a new frame ID
+        for (int i = 0; i < bridge.rx_pool.batches; i++) {
+            works_.push_back(std::make_unique<Work>());
+            core_->reserve(works_.back()->batch);
+            works_.back()->next.reserve(size_t(std::max(cfg_.rx_batch, 1)));
+            free_.push_back(works_.back().get());
+        }
+    }
+}
+
+BusBridge::~BusBridge()
+{
+    stop();
+    if (fd_ >= 0) close(fd_);
+}
+
+void BusBridge::open_socket()
+{
+    fd_ = socket(PF_CAN, SOCK_RAW | SOCK_CLOEXEC, CAN_RAW);
+    if (fd_ < 0) throw std::system_error(errno, std::generic_category(), "socket");
+    auto fail = [this](const std::string &what) {
+        int err = errno;
+        close(fd_);
+        fd_ = -1;
+        throw std::system_error(err, std::generic_category(), what);
+    };
+
+    ifreq ifr{};
+    std::strncpy(ifr.ifr_name, cfg_.interface.c_str(), IFNAMSIZ - 1);
+    if (ioctl(fd_, SIOCGIFINDEX, &ifr) < 0) fail("interface " + cfg_.interface);
+    int on = 1;
+    if (cfg_.fd && setsockopt(fd_, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &on, sizeof(on)) < 0) fail("CAN_RAW_FD_FRAMES");
+    sockaddr_can addr{};
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) fail("bind " + cfg_.interface);
+}
+
+void BusBridge::add_rx(const RxBinding &binding, const rclcpp::QoS &qos)
+{
+    auto skip = [&](const std::string &why) {
+        RCLCPP_WARN(node_.get_logger(), "[%s] RX binding '%s' skipped, run it on td_can_bridge: %s",
+                    cfg_.name.c_str(), binding.key.c_str(), why.c_str());
+    };
+    const Message *msg = dbc_.message(binding.message);
+    if (msg == nullptr) throw std::runtime_error("RX binding '" + binding.key + "': no DBC message " + binding.message);
+    if (!binding.publish.empty()) return skip("publish: " + binding.publish);
+    if (!msg->supported()) return skip(msg->name + " is multiplexed, over 8 bytes or has an odd float");
+    if (!with_scalar(binding.type, [](auto *) {})) return skip(binding.type + " is not a std_msgs scalar");
+    std::string signal = scalar_signal(binding.fields, true, *msg);
+    if (signal.empty()) return skip("a std_msgs scalar takes one signal, mapped to 'data'");
+    if (msg->signal(signal) == nullptr)
+        throw std::runtime_error("RX binding '" + binding.key + "': " + msg->name + " has no signal " + signal);
+
+    uint32_t full = msg->extended ? CAN_EFF_MASK : CAN_SFF_MASK;
+    uint32_t mask = binding.id_mask.value_or(full) & full;
+    uint32_t id = binding.can_id.value_or(msg->frame_id) & mask;
+    RxEntry *entry = nullptr;
+    for (const auto &e : rx_) {
+        if (e->id == id && e->mask == mask && e->extended == msg->extended && e->message == msg) entry = e.get();
+    }
+    if (entry == nullptr) {
+        rx_.push_back(std::make_unique<RxEntry>());
+        entry = rx_.back().get();
+        entry->id = id;
+        entry->extended = msg->extended;
+        entry->mask = mask;
+        entry->message = msg;
+        if (mask == full) exact_[id] = entry;
+        else masked_.push_back(entry);
+    }
+
+    RxTarget target;
+    auto it = std::find(entry->signals.begin(), entry->signals.end(), signal);
+    target.value = size_t(it - entry->signals.begin());
+    if (it == entry->signals.end()) entry->signals.push_back(signal);
+    target.topic = binding.topic;
+    target.type = binding.type;
+    target.qos = qos;
+    target.id_fields = binding.id_fields;
+    if (target.topic.find('{') == std::string::npos) target.pub = make_publisher(node_, target.type, target.topic, qos, loan_);
+    RCLCPP_INFO(node_.get_logger(), "RX bind: DBC:%s (id=0x%X) -> %s", msg->name.c_str(), msg->frame_id,
+                binding.topic.c_str());
+    entry->targets.push_back(std::move(target));
+}
+
+void BusBridge::add_tx(const TxBinding &binding, const rclcpp::QoS &qos)
+{
+    auto skip = [&](const std::string &why) {
+        RCLCPP_WARN(node_.get_logger(), "[%s] TX binding '%s' skipped, run it on td_can_bridge: %s",
+                    cfg_.name.c_str(), binding.key.c_str(), why.c_str());
+    };
+    const Message *msg = dbc_.message(binding.message);
+    if (msg == nullptr) throw std::runtime_error("TX binding '" + binding.key + "': no DBC message " + binding.message);
+    if (!msg->supported()) return skip(msg->name + " is multiplexed, over 8 bytes or has an odd float");
+    if (!with_scalar(binding.type, [](auto *) {})) return skip(binding.type + " is not a std_msgs scalar");
+    // As in the Python packer every signal of the frame needs a value, so only one-signal messages fit
+    std::string signal = scalar_signal(binding.fields, false, *msg);
+    if (signal.empty() || msg->signals.size() != 1)
+        return skip("a std_msgs scalar fills one-signal messages only, its field 'data' mapped to the signal");
+    if (msg->signal(signal) == nullptr)
+        throw std::runtime_error("TX binding '" + binding.key + "': " + msg->name + " has no signal " + signal);
+
+    tx_.push_back(std::make_unique<TxEntry>());
+    TxEntry &tx = *tx_.back();
+    tx.key = binding.key;
+    tx.message = msg;
+    tx.signal = msg->signal(signal);
+    tx.frame.can_id = msg->frame_id | (msg->extended ? CAN_EFF_FLAG : 0);
+    tx.frame.can_dlc = uint8_t(msg->length);
+    if (binding.hold_ms) tx.hold = std::chrono::nanoseconds(int64_t(*binding.hold_ms * 1e6));
+
+    std::string topic = binding.topic;
+    auto on_value = [this, &tx, topic](double value) {
+        try {
+            send(tx, value);
+        } catch (const std::exception &exc) {
+            RCLCPP_ERROR_THROTTLE(node_.get_logger(), *node_.get_clock(), 5000,
+                                  "Failed to send CAN frame for topic %s: %s", topic.c_str(), exc.what());
+        }
+    };
+    rclcpp::SubscriptionOptions options;
+    options.callback_group = tx_group_;
+    with_scalar(binding.type, [&](auto *tag) {
+        using Msg = std::remove_pointer_t<decltype(tag)>;
+        tx.subscription = node_.create_subscription<Msg>(
+            topic, qos, [on_value](std::unique_ptr<Msg> msg) { on_value(double(msg->data)); }, options);
+    });
+    if (binding.period_ms) {
+        auto period = std::chrono::nanoseconds(int64_t(*binding.period_ms * 1e6));
+        tx.timer = node_.create_wall_timer(period, [this, &tx, topic]() {
+            std::lock_guard<std::mutex> lock(tx.mutex);
+            if (!tx.have) return;
+            if (tx.hold.count() && std::chrono::steady_clock::now() - tx.last > tx.hold) return;
+            try {
+                write_frame(tx);
+            } catch (const std::system_error &exc) {
+                RCLCPP_ERROR_THROTTLE(node_.get_logger(), *node_.get_clock(), 5000,
+                                      "Failed to send CAN frame for topic %s: %s", topic.c_str(), exc.what());
+            }
+        }, tx_group_);
+    }
+    RCLCPP_INFO(node_.get_logger(), "TX bind: %s -> DBC:%s (id=0x%X)", topic.c_str(), msg->name.c_str(),
+                msg->frame_id);
+}
+
+void BusBridge::apply_filters()
+{
+    // One kernel filter per RX entry, as auto_filters does on the Python bridge
+    std::vector<can_filter> filters;
+    for (const auto &entry : rx_) {
+        can_filter f;
+        f.can_id = entry->id | (entry->extended ? CAN_EFF_FLAG : 0);
+        f.can_mask = entry->mask | CAN_EFF_FLAG | CAN_RTR_FLAG;
+        filters.push_back(f);
+    }
+    if (setsockopt(fd_, SOL_CAN_RAW, CAN_RAW_FILTER, filters.data(), socklen_t(filters.size() * sizeof(can_filter))) < 0)
+        throw std::system_error(errno, std::generic_category(), "CAN_RAW_FILTER");
+}
+
+void BusBridge::start()
+{
+    if (rx_thread_.joinable()) return;
+    if (cfg_.realtime.enabled && cfg_.realtime.selftest_s > 0) selftest();
+    rx_thread_ = std::thread(&BusBridge::rx_main, this);
+    if (tx_group_) {
+        tx_executor_ = std::make_unique<rclcpp::executors::SingleThreadedExecutor>();
+        tx_executor_->add_callback_group(tx_group_, node_.get_node_base_interface());
+        tx_thread_ = std::thread([this]() {
+            realtime_thread("TX", cfg_.realtime.tx_priority, cfg_.realtime.tx_cpus);
+            tx_executor_->spin();
+        });
+    }
+    RCLCPP_INFO(node_.get_logger(), "[%s] up on %s, fd=%s: %zu RX entries, %zu TX bindings%s", cfg_.name.c_str(),
+                cfg_.interface.c_str(), cfg_.fd ? "true" : "false", rx_.size(), tx_.size(),
+                cfg_.realtime.enabled ? ", real-time" : "");
+}
+
+void BusBridge::stop()
+{
+    if (tx_thread_.joinable()) {
+        tx_executor_->cancel();
+        tx_thread_.join();
+    }
+    if (!rx_thread_.joinable()) return;
+    core_->stop();
+    rx_thread_.join();
+    // The workers publish through node_: wait for the batches they still hold
+    std::unique_lock<std::mutex> lock(free_mutex_);
+    free_cv_.wait(lock, [this] { return free_.size() == works_.size(); });
+}
+
+size_t BusBridge::heap_bytes() const
+{
+    if (cfg_.realtime.heap_kb > 0) return size_t(cfg_.realtime.heap_kb) * 1024;
+    // Every RX topic's intra-process buffer full, at about 1 KiB per slot (message, control block
+    // and ring entry), id_fields topics counted 16 times; plus 4 MiB for rclcpp and the RMW
+    constexpr size_t kSlot = 1024, kPerIdFields = 16, kBase = 4 << 20;
+    size_t slots = 0;
+    for (const auto &entry : rx_) {
+        for (const RxTarget &target : entry->targets)
+            slots += target.qos.depth() * (target.id_fields.empty() ? 1 : kPerIdFields);
+    }
+    return kBase + slots * kSlot;
+}
+
+const std::vector<int> &BusBridge::rx_cpus() const
+{
+    return cfg_.realtime.rx_cpus.empty() ? cfg_.cpu_affinity : cfg_.realtime.rx_cpus;
+}
+
+void BusBridge::realtime_thread(const char *role, int priority, const std::vector<int> &cpus)
+{
+    if (priority == 0 && cpus.empty()) return;
+    int error = set_thread_realtime(priority, cpus);
+    if (error) {
+        RCLCPP_WARN(node_.get_logger(), "[%s] %s thread: SCHED_FIFO %d / %zu CPUs not (all) applied: %s",
+                    cfg_.name.c_str(), role, priority, cpus.size(), std::strerror(error));
+    }
+}
+
+void BusBridge::selftest()
+{
+    const RealtimeConfig &rt = cfg_.realtime;
+    WakeupStats s = wakeup_test(rt.selftest_period_us, rt.selftest_s, rt.rx_priority, rx_cpus(), rt.max_wakeup_us);
+    if (s.error) {
+        RCLCPP_WARN(node_.get_logger(), "[%s] wakeup self-test without the RX thread's priority or CPUs: %s",
+                    cfg_.name.c_str(), std::strerror(s.error));
+    }
+    RCLCPP_INFO(node_.get_logger(), "[%s] wakeup self-test: %zu wakeups every %d us, mean %.1f, p99 %.1f, max %.1f us",
+                cfg_.name.c_str(), s.samples, rt.selftest_period_us, s.mean_us, s.p99_us, s.max_us);
+    if (s.max_us <= rt.max_wakeup_us) return;
+    std::string msg = "[" + cfg_.name + "] wakeup self-test: " + std::to_string(s.over) + " of " +
+                      std::to_string(s.samples) + " wakeups later than max_wakeup_us " +
+                      std::to_string(int(rt.max_wakeup_us)) + " (worst " + std::to_string(int(s.max_us)) + " us)";
+    if (rt.selftest_required) throw std::runtime_error(msg);
+    RCLCPP_WARN(node_.get_logger(), "%s", msg.c_str());
+}
+
+BusBridge::RxEntry *BusBridge::find(uint32_t id)
+{
+    auto it = exact_.find(id);
+    if (it != exact_.end()) return it->second;
+    for (RxEntry *entry : masked_) {
+        if ((id & entry->mask) == entry->id) return entry;
+    }
+    return nullptr;
+}
+
+ScalarPublisher *BusBridge::publisher(RxTarget &target, uint32_t id)
+{
+    // A known ID formats no topic and allocates nothing
+    auto known = target.by_id.find(id);
+    if (known != target.by_id.end()) return known->second;
+    std::string topic = target.topic;
+    for (const auto &[name, bits] : target.id_fields) {
+        uint32_t value = (id >> bits.first) & ((1u << (bits.second - bits.first + 1)) - 1);
+        std::string field = "{" + name + "}";
+        for (size_t at = topic.find(field); at != std::string::npos; at = topic.find(field, at))
+            topic.replace(at, field.size(), std::to_string(value));
+    }
+    auto &pub = target.pubs[topic];
+    if (!pub) pub = make_publisher(node_, target.type, topic, target.qos, loan_);
+    target.by_id[id] = pub.get();
+    return pub.get();
+}
+
+BusBridge::RxEntry *BusBridge::accept(const td_can::Decoded &frame)
+{
+    if (frame.id & CAN_ERR_FLAG) return nullptr;
+    RxEntry *entry = find(frame.id);
+    if (entry == nullptr) return nullptr;
+    if (frame.raw) {
+        short_frames_.fetch_add(1, std::memory_order_relaxed);
+        RCLCPP_WARN_THROTTLE(node_.get_logger(), *node_.get_clock(), 5000,
+                             "[%s] %s: %u-byte payload, the DBC says %d (%lu so far)", cfg_.name.c_str(),
+                             entry->message->name.c_str(), unsigned(frame.len), entry->message->length,
+                             (unsigned long)short_frames_.load(std::memory_order_relaxed));
+        return nullptr;
+    }
+    return entry;
+}
+
+void BusBridge::dispatch(const td_can::Decoded &frame, const td_can::Batch &batch)
+{
+    RxEntry *entry = accept(frame);
+    if (entry == nullptr) return;
+    for (RxTarget &target : entry->targets) {
+        ScalarPublisher *pub = target.pub ? target.pub.get() : publisher(target, frame.id);
+        pub->publish(batch.values[frame.first_value + target.value]);
+    }
+}
+
+BusBridge::RxLane &BusBridge::lane(uint32_t id, RxEntry &entry)
+{
+    auto known = lanes_.find(id);
+    if (known != lanes_.end()) return *known->second;
+    // Publishers are resolved here, on the RX thread, so the workers never touch an RxTarget
+    auto lane = std::make_unique<RxLane>();
+    for (RxTarget &target : entry.targets)
+        lane->targets.emplace_back(target.value, target.pub ? target.pub.get() : publisher(target, id));
+    RxLane *self = lane.get();
+    lane->lane = std::make_unique<SerialLane<Chain>>(*pool_, [this, self](Chain &chain) { publish(chain, *self); });
+    return *lanes_.emplace(id, std::move(lane)).first->second;
+}
+
+void BusBridge::publish(const Chain &chain, const RxLane &lane)
+{
+    const td_can::Batch &batch = chain.work->batch;
+    for (uint32_t i = chain.first; i != kEnd; i = chain.work->next[i]) {
+        const td_can::Decoded &frame = batch.frames[i];
+        for (const auto &[value, pub] : lane.targets) pub->publish(batch.values[frame.first_value + value]);
+    }
+    release(chain.work);
+}
+
+void BusBridge::release(Work *work)
+{
+    if (work->lanes.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    std::lock_guard<std::mutex> lock(free_mutex_);
+    free_.push_back(work);
+    free_cv_.notify_all();
+}
+
+void BusBridge::send(TxEntry &tx, double value)
+{
+    std::lock_guard<std::mutex> lock(tx.mutex);
+    tx.message->encode(*tx.signal, value, tx.frame.data);
+    tx.last = std::chrono::steady_clock::now();
+    tx.have = true;
+    if (!tx.timer) write_frame(tx);
+}
+
+void BusBridge::write_frame(const TxEntry &tx)
+{
+    if (write(fd_, &tx.frame, sizeof(tx.frame)) < 0) throw std::system_error(errno, std::generic_category(), "write");
+}
+
+void BusBridge::rx_main()
+{
+    realtime_thread("RX", cfg_.realtime.enabled ? cfg_.realtime.rx_priority : 0, rx_cpus());
+    try {
+        if (pool_) {
+            rx_pooled();
+            return;
+        }
+        td_can::Batch batch;
+        core_->reserve(batch);
+        while (core_->poll(-1, batch)) {
+            for (const td_can::Decoded &frame : batch.frames) dispatch(frame, batch);
+        }
+    } catch (const std::system_error &exc) {
+        // No reopen, unlike CanBusService's recovery: the bus stays down until the node is reloaded
+        RCLCPP_ERROR(node_.get_logger(), "[%s] RX thread stopped: %s", cfg_.name.c_str(), exc.what());
+    }
+}
+
+void BusBridge::rx_pooled()
+{
+    auto give_back = [this](Work *work) {
+        std::lock_guard<std::mutex> lock(free_mutex_);
+        free_.push_back(work);
+        free_cv_.notify_all();
+    };
+    for (;;) {
+        Work *work;
+        {
+            // None free: the workers are behind, and the frames wait in the socket buffer meanwhile
+            std::unique_lock<std::mutex> lock(free_mutex_);
+            free_cv_.wait(lock, [this] { return !free_.empty(); });
+            work = free_.back();
+            free_.pop_back();
+        }
+        bool more = false;
+        try {
+            more = core_->poll(-1, work->batch);
+        } catch (...) {
+            give_back(work);  // stop() counts the batches back in
+            throw;
+        }
+        const std::vector<td_can::Decoded> &frames = work->batch.frames;
+        // Chains the frames of each lane through next, so one post hands a lane all of its frames
+        epoch_++;
+        touched_.clear();
+        work->next.assign(frames.size(), kEnd);
+        for (uint32_t i = 0; more && i < frames.size(); i++) {
+            RxEntry *entry = accept(frames[i]);
+            if (entry == nullptr) continue;
+            RxLane &lane = this->lane(frames[i].id, *entry);
+            if (lane.epoch != epoch_) {
+                lane.epoch = epoch_;
+                lane.head = i;
+                touched_.push_back(&lane);
+            } else {
+                work->next[lane.tail] = i;
+            }
+            lane.tail = i;
+        }
+        if (touched_.empty()) {
+            give_back(work);
+        } else {
+            // Before the first post: a worker may finish its lane while the others are still posted
+            work->lanes.store(touched_.size(), std::memory_order_release);
+            for (RxLane *lane : touched_) lane->lane->post({work, lane->head});
+        }
+        if (!more) return;
+    }
+}
+
+} // namespace td_can_bridge
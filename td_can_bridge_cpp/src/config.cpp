@@ -0,0 +1,271 @@
+#include "td_can_bridge_cpp/config.hpp"
+
+#include <yaml-cpp/yaml.h>
+
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+
+namespace td_can_bridge {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+void require(const YAML::Node &node, const char *key, const std::string &context)
+{
+    if (!node[key]) throw std::runtime_error(std::string("Missing required key(s) ['") + key + "'] in " + context);
+}
+
+template <typename T>
+T get(const YAML::Node &node, const char *key, const T &fallback, const std::string &context)
+{
+    const YAML::Node value = node[key];
+    if (!value || value.IsNull()) return fallback;
+    try {
+        return value.as<T>();
+    } catch (const YAML::Exception &) {
+        throw std::runtime_error(context + "." + key + " has the wrong type");
+    }
+}
+
+// YAML ints, or strings such as "0x02000000" (_optional_int in service.py)
+std::optional<uint32_t> optional_id(const YAML::Node &node, const char *key, const std::string &context)
+{
+    const YAML::Node value = node[key];
+    if (!value || value.IsNull()) return std::nullopt;
+    try {
+        return uint32_t(std::stoul(value.as<std::string>(), nullptr, 0));
+    } catch (const std::exception &) {
+        throw std::runtime_error(context + "." + key + " must be an integer, got '" + value.as<std::string>() + "'");
+    }
+}
+
+std::optional<double> optional_double(const YAML::Node &node, const char *key, const std::string &context)
+{
+    const YAML::Node value = node[key];
+    if (!value || value.IsNull()) return std::nullopt;
+    return get<double>(node, key, 0.0, context);
+}
+
+std::map<std::string, std::string> string_map(const YAML::Node &node, const std::string &context)
+{
+    std::map<std::string, std::string> out;
+    if (!node || node.IsNull()) return out;
+    if (!node.IsMap()) throw std::runtime_error(context + " must be a mapping");
+    for (const auto &item : node) out[item.first.as<std::string>()] = item.second.as<std::string>();
+    return out;
+}
+
+// cpu_affinity and the realtime CPU lists: [2, 3] or "2-3,6" (_cpu_list in service.py)
+std::vector<int> cpu_list(const YAML::Node &node, const char *key, const std::string &context)
+{
+    std::vector<int> cpus;
+    const YAML::Node value = node[key];
+    if (!value || value.IsNull()) return cpus;
+    auto bad = [&]() {
+        return std::runtime_error(context + "." + key + " must be a CPU list such as [2, 3] or \"2-3\"");
+    };
+    try {
+        if (value.IsSequence()) {
+            for (const auto &cpu : value) cpus.push_back(cpu.as<int>());
+        } else {
+            std::stringstream text(value.as<std::string>());
+            for (std::string part; std::getline(text, part, ',');) {
+                size_t dash = part.find('-');
+                int lo = std::stoi(part.substr(0, dash));
+                int hi = dash == std::string::npos ? lo : std::stoi(part.substr(dash + 1));
+                if (hi < lo) throw bad();
+                for (int cpu = lo; cpu <= hi; cpu++) cpus.push_back(cpu);
+            }
+        }
+    } catch (const YAML::Exception &) {
+        throw bad();
+    } catch (const std::logic_error &) {
+        throw bad();
+    }
+    for (int cpu : cpus) {
+        if (cpu < 0) throw bad();
+    }
+    return cpus;
+}
+
+int priority(const YAML::Node &node, const char *key, const std::string &context)
+{
+    int value = get<int>(node, key, 0, context);
+    if (value < 0 || value > 99) throw std::runtime_error(context + "." + key + " must be a SCHED_FIFO priority, 1..99");
+    return value;
+}
+
+RealtimeConfig realtime(const YAML::Node &node, const std::string &context)
+{
+    RealtimeConfig rt;
+    if (!node || node.IsNull()) return rt;
+    if (node.IsScalar()) {
+        try {
+            rt.enabled = node.as<bool>();  // realtime: true, with the defaults
+        } catch (const YAML::Exception &) {
+            throw std::runtime_error(context + " must be true or a mapping");
+        }
+        return rt;
+    }
+    if (!node.IsMap()) throw std::runtime_error(context + " must be true or a mapping");
+    rt.enabled = true;
+    rt.lock_memory = get<bool>(node, "lock_memory", rt.lock_memory, context);
+    rt.heap_kb = get<int>(node, "heap_kb", rt.heap_kb, context);
+    rt.rx_priority = priority(node, "rx_priority", context);
+    rt.rx_cpus = cpu_list(node, "rx_cpus", context);
+    rt.tx_priority = priority(node, "tx_priority", context);
+    rt.tx_cpus = cpu_list(node, "tx_cpus", context);
+    const YAML::Node test = node["selftest"];
+    if (test && test.IsScalar() && !test.as<bool>()) {
+        rt.selftest_s = 0.0;
+    } else if (test && test.IsMap()) {
+        std::string sub = context + ".selftest";
+        rt.selftest_s = get<double>(test, "seconds", rt.selftest_s, sub);
+        rt.selftest_period_us = get<int>(test, "period_us", rt.selftest_period_us, sub);
+        rt.max_wakeup_us = get<double>(test, "max_wakeup_us", rt.max_wakeup_us, sub);
+        rt.selftest_required = get<bool>(test, "required", rt.selftest_required, sub);
+        if (rt.selftest_period_us <= 0 || rt.selftest_s < 0)
+            throw std::runtime_error(sub + ": period_us must be positive and seconds not negative");
+    }
+    return rt;
+}
+
+RxBinding rx_binding(const std::string &key, const YAML::Node &spec, const std::string &context)
+{
+    RxBinding b;
+    b.key = key;
+    b.message = get<std::string>(spec, "dbc_message", key, context);
+    b.topic = get<std::string>(spec, "topic", key, context);
+    b.type = get<std::string>(spec, "type", b.type, context);
+    b.fields = string_map(spec["fields"], context + ".fields");
+    b.can_id = optional_id(spec, "can_id", context);
+    b.id_mask = optional_id(spec, "id_mask", context);
+    b.publish = get<std::string>(spec, "publish", "", context);
+    if (const YAML::Node ids = spec["id_fields"]) {
+        for (const auto &item : ids) {
+            const YAML::Node bits = item.second;
+            if (!bits.IsSequence() || bits.size() != 2)
+                throw std::runtime_error(context + ".id_fields." + item.first.as<std::string>() + " must be [low, high]");
+            b.id_fields.push_back({item.first.as<std::string>(), {bits[0].as<int>(), bits[1].as<int>()}});
+        }
+    }
+    return b;
+}
+
+TxBinding tx_binding(const std::string &key, const YAML::Node &spec, const std::string &context)
+{
+    require(spec, "dbc_message", context);
+    TxBinding b;
+    b.key = key;
+    b.message = spec["dbc_message"].as<std::string>();
+    b.topic = get<std::string>(spec, "topic", key, context);
+    b.type = get<std::string>(spec, "type", b.type, context);
+    b.fields = string_map(spec["fields"], context + ".fields");
+    b.qos = get<std::string>(spec, "qos", b.qos, context);
+    b.period_ms = optional_double(spec, "period_ms", context);
+    b.hold_ms = optional_double(spec, "hold_ms", context);
+    return b;
+}
+
+PoolConfig rx_pool(const YAML::Node &node, const std::string &context)
+{
+    PoolConfig pool;
+    if (!node || node.IsNull()) return pool;
+    if (node.IsScalar()) {
+        try {
+            pool.workers = node.as<int>();  // rx_pool: 4, with the defaults
+        } catch (const YAML::Exception &) {
+            throw std::runtime_error(context + " must be a number of workers or a mapping");
+        }
+    } else if (node.IsMap()) {
+        pool.workers = get<int>(node, "workers", pool.workers, context);
+        pool.priority = priority(node, "priority", context);
+        pool.cpus = cpu_list(node, "cpus", context);
+        pool.batches = get<int>(node, "batches", pool.batches, context);
+        pool.report_period_s = get<double>(node, "report_period_s", pool.report_period_s, context);
+    } else {
+        throw std::runtime_error(context + " must be a number of workers or a mapping");
+    }
+    if (pool.workers < 0 || pool.batches < 1 || pool.report_period_s < 0)
+        throw std::runtime_error(context + ": workers and report_period_s must not be negative, batches at least 1");
+    return pool;
+}
+
+} // namespace
+
+const BusConfig *BridgeConfig::bus(const std::string &name) const
+{
+    for (const BusConfig &b : buses) {
+        if (b.name == name) return &b;
+    }
+    return nullptr;
+}
+
+QosProfile BridgeConfig::qos_profile(const std::string &name, int default_depth) const
+{
+    auto it = qos.find(name);
+    if (it != qos.end()) return it->second;
+    QosProfile profile;
+    profile.depth = default_depth;
+    return profile;
+}
+
+BridgeConfig load_bridge_config(const std::string &path)
+{
+    fs::path cfg_path = fs::absolute(fs::path(path)).lexically_normal();
+    if (!fs::exists(cfg_path)) throw std::runtime_error("No such config file: " + cfg_path.string());
+    YAML::Node raw = YAML::LoadFile(cfg_path.string());
+
+    BridgeConfig cfg;
+    cfg.path = cfg_path.string();
+    if (const YAML::Node qos = raw["qos"]) {
+        for (const auto &item : qos) {
+            std::string context = "qos." + item.first.as<std::string>();
+            QosProfile profile;
+            profile.reliability = get<std::string>(item.second, "reliability", profile.reliability, context);
+            profile.durability = get<std::string>(item.second, "durability", profile.durability, context);
+            // Unset depth: the default of where the profile is used (sensor 20, command 10)
+            profile.depth = get<int>(item.second, "depth", item.first.as<std::string>() == "sensor" ? 20 : 10, context);
+            cfg.qos[item.first.as<std::string>()] = profile;
+        }
+    }
+    cfg.rx_pool = rx_pool(raw["rx_pool"], "rx_pool");
+
+    const YAML::Node buses = raw["buses"];
+    for (size_t idx = 0; buses && idx < buses.size(); idx++) {
+        const YAML::Node entry = buses[idx];
+        std::string context = "buses[" + std::to_string(idx) + "]";
+        for (const char *key : {"name", "interface", "dbc_file"}) require(entry, key, context);
+
+        BusConfig bus;
+        bus.name = entry["name"].as<std::string>();
+        bus.interface = entry["interface"].as<std::string>();
+        fs::path dbc = entry["dbc_file"].as<std::string>();
+        if (dbc.is_relative()) dbc = fs::weakly_canonical(cfg_path.parent_path() / dbc);
+        bus.dbc_file = dbc.string();
+        bus.fd = get<bool>(entry, "fd", false, context);
+        bus.auto_filters = get<bool>(entry, "auto_filters", false, context);
+        bus.rx_batch = get<int>(entry, "rx_batch", 64, context);
+        bus.cpu_affinity = cpu_list(entry, "cpu_affinity", context);
+        bus.realtime = realtime(entry["realtime"], context + ".realtime");
+
+        if (const YAML::Node rx = entry["rx_frames"]) {
+            for (const auto &item : rx) {
+                std::string key = item.first.as<std::string>();
+                bus.rx_bindings.push_back(rx_binding(key, item.second, context + ".rx_frames." + key));
+            }
+        }
+        if (const YAML::Node tx = entry["tx_topics"]) {
+            for (const auto &item : tx) {
+                std::string key = item.first.as<std::string>();
+                bus.tx_bindings.push_back(tx_binding(key, item.second, context + ".tx_topics['" + key + "']"));
+            }
+        }
+        cfg.buses.push_back(std::move(bus));
+    }
+    return cfg;
+}
+
+} // namespace td_can_bridge
@@ -0,0 +1,178 @@
+#include "td_can_bridge_cpp/dbc.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+
+namespace td_can_bridge {
+
+namespace {
+
+const std::regex kMessage(R"(^BO_\s+(\d+)\s+(\w+)\s*:\s*(\d+)\s+\S+)");
+const std::regex kSignal(
+    R"(^SG_\s+(\w+)\s*(M|m\d+M?)?\s*:\s*(\d+)\|(\d+)@([01])([+-])\s*\(([^,]+),([^)]+)\)\s*\[([^|]*)\|([^\]]*)\])");
+const std::regex kValueType(R"(^SIG_VALTYPE_\s+(\d+)\s+(\w+)\s*:\s*([12])\s*;)");
+
+// Right shift that brings the signal's LSB to bit 0 of the payload integer; _shift() in decoders.py
+int shift_of(const Signal &s, int length)
+{
+    if (!s.big_endian) return s.start;
+    int msb = (length - 1 - s.start / 8) * 8 + s.start % 8;
+    return msb - s.length + 1;
+}
+
+uint64_t read_payload(const uint8_t *data, int length, bool big_endian)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < length; i++) {
+        if (big_endian) v = (v << 8) | data[i];
+        else v |= uint64_t(data[i]) << (8 * i);
+    }
+    return v;
+}
+
+void write_payload(uint8_t *data, int length, bool big_endian, uint64_t v)
+{
+    for (int i = 0; i < length; i++) {
+        int byte = big_endian ? length - 1 - i : i;
+        data[byte] = uint8_t(v >> (8 * i));
+    }
+}
+
+} // namespace
+
+bool Message::supported() const
+{
+    if (length > 8) return false;
+    for (const Signal &s : signals) {
+        if (s.multiplexed) return false;
+        if (s.is_float && s.length != 32 && s.length != 64) return false;
+        int shift = shift_of(s, length);
+        if (shift < 0 || shift + s.length > 8 * length) return false;
+    }
+    return true;
+}
+
+const Signal *Message::signal(const std::string &name) const
+{
+    for (const Signal &s : signals) {
+        if (s.name == name) return &s;
+    }
+    return nullptr;
+}
+
+td_can::SignalSpec Message::layout(const Signal &s) const
+{
+    td_can::SignalSpec spec;
+    spec.shift = uint8_t(shift_of(s, length));
+    spec.length = uint8_t(s.length);
+    spec.big_endian = s.big_endian;
+    spec.is_signed = s.is_signed;
+    spec.is_float = s.is_float;
+    spec.as_int = !s.is_float && s.scale == 1.0 && s.offset == 0.0;
+    spec.scale = s.scale;
+    spec.offset = s.offset;
+    return spec;
+}
+
+void Message::encode(const Signal &s, double value, uint8_t *data) const
+{
+    if (s.minimum != s.maximum && !(s.minimum <= value && value <= s.maximum)) {
+        std::ostringstream msg;
+        msg << s.name << "=" << value << " is outside [" << s.minimum << ", " << s.maximum << "]";
+        throw std::out_of_range(msg.str());
+    }
+    double scaled = (value - s.offset) / s.scale;
+    uint64_t bits;
+    if (s.is_float && s.length == 32) {
+        float f = float(scaled);
+        uint32_t u;
+        std::memcpy(&u, &f, sizeof(u));
+        bits = u;
+    } else if (s.is_float) {
+        std::memcpy(&bits, &scaled, sizeof(bits));
+    } else {
+        // Python's round(): halves to even
+        double raw = std::nearbyint(scaled);
+        double lo = s.is_signed ? -std::ldexp(1.0, s.length - 1) : 0.0;
+        double hi = std::ldexp(1.0, s.is_signed ? s.length - 1 : s.length) - 1.0;
+        if (!(lo <= raw && raw <= hi)) {
+            std::ostringstream msg;
+            msg << s.name << "=" << value << " does not fit " << s.length << " bits";
+            throw std::out_of_range(msg.str());
+        }
+        bits = s.is_signed ? uint64_t(int64_t(raw)) : uint64_t(raw);
+    }
+
+    uint64_t mask = s.length >= 64 ? ~0ull : (1ull << s.length) - 1;
+    int shift = shift_of(s, length);
+    uint64_t payload = read_payload(data, length, s.big_endian);
+    payload = (payload & ~(mask << shift)) | ((bits & mask) << shift);
+    write_payload(data, length, s.big_endian, payload);
+}
+
+Database Database::load(const std::string &path)
+{
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("cannot read DBC file " + path);
+
+    Database db;
+    std::map<uint32_t, size_t> by_id;  // DBC ID, CAN_EFF_FLAG included
+    std::string line;
+    int number = 0;
+    auto fail = [&](const std::string &what) {
+        throw std::runtime_error(path + ":" + std::to_string(number) + ": malformed " + what);
+    };
+    while (std::getline(in, line)) {
+        number++;
+        size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos) continue;
+        std::string text = line.substr(first);
+        std::smatch m;
+        if (text.rfind("BO_ ", 0) == 0) {
+            if (!std::regex_search(text, m, kMessage)) fail("BO_");
+            Message msg;
+            uint32_t id = uint32_t(std::stoul(m[1]));
+            msg.name = m[2];
+            msg.extended = id & 0x80000000u;
+            msg.frame_id = id & 0x1FFFFFFFu;
+            msg.length = std::stoi(m[3]);
+            by_id[id] = db.messages_.size();
+            db.by_name_[msg.name] = db.messages_.size();
+            db.messages_.push_back(std::move(msg));
+        } else if (text.rfind("SG_ ", 0) == 0) {
+            if (db.messages_.empty() || !std::regex_search(text, m, kSignal)) fail("SG_");
+            Signal s;
+            s.name = m[1];
+            s.multiplexed = m[2].matched;
+            s.start = std::stoi(m[3]);
+            s.length = std::stoi(m[4]);
+            s.big_endian = m[5] == "0";
+            s.is_signed = m[6] == "-";
+            s.scale = std::stod(m[7]);
+            s.offset = std::stod(m[8]);
+            s.minimum = std::stod(m[9]);
+            s.maximum = std::stod(m[10]);
+            db.messages_.back().signals.push_back(std::move(s));
+        } else if (text.rfind("SIG_VALTYPE_ ", 0) == 0) {
+            if (!std::regex_search(text, m, kValueType)) fail("SIG_VALTYPE_");
+            auto it = by_id.find(uint32_t(std::stoul(m[1])));
+            if (it == by_id.end()) continue;
+            for (Signal &s : db.messages_[it->second].signals) {
+                if (s.name == m[2].str()) s.is_float = true;
+            }
+        }
+    }
+    return db;
+}
+
+const Message *Database::message(const std::string &name) const
+{
+    auto it = by_name_.find(name);
+    return it == by_name_.end() ? nullptr : &messages_[it->second];
+}
+
+} // namespace td_can_bridge
@@ -0,0 +1,56 @@
+#include "td_can_bridge_cpp/latency_probe.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include <rclcpp_components/register_node_macro.hpp>
+
+namespace td_can_bridge {
+
+LatencyProbe::LatencyProbe(const rclcpp::NodeOptions &options)
+    : rclcpp::Node("td_can_latency_probe", rclcpp::NodeOptions(options).use_intra_process_comms(true))
+{
+    std::string topic = declare_parameter<std::string>("topic", "/bench/foot_force");
+    std::string output = declare_parameter<std::string>("output", "");
+    if (output.empty()) throw std::runtime_error("parameter 'output' is required (path of the samples file).");
+    out_ = std::fopen(output.c_str(), "w");
+    if (out_ == nullptr) throw std::runtime_error("cannot open " + output + ": " + std::strerror(errno));
+    samples_.reserve(1 << 16);
+
+    // Deep enough for a burst at the bench's highest rate; best effort matches the sensor profile
+    sub_ = create_subscription<std_msgs::msg::Float32>(
+        topic, rclcpp::QoS(rclcpp::KeepLast(1000)).best_effort(),
+        [this](std::unique_ptr<std_msgs::msg::Float32> msg) {
+            int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            std::lock_guard<std::mutex> lock(mutex_);
+            samples_.emplace_back(uint32_t(msg->data), now);
+        });
+    timer_ = create_wall_timer(std::chrono::seconds(1), [this]() { flush(); });
+    RCLCPP_INFO(get_logger(), "latency probe on %s, samples to %s", topic.c_str(), output.c_str());
+}
+
+LatencyProbe::~LatencyProbe()
+{
+    flush();
+    std::fclose(out_);
+}
+
+void LatencyProbe::flush()
+{
+    std::vector<std::pair<uint32_t, int64_t>> batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        batch.swap(samples_);
+        samples_.reserve(batch.capacity());
+    }
+    for (const auto &s : batch) std::fprintf(out_, "%u %lld\n", s.first, (long long)s.second);
+    std::fflush(out_);
+}
+
+} // namespace td_can_bridge
+
+RCLCPP_COMPONENTS_REGISTER_NODE(td_can_bridge::LatencyProbe)
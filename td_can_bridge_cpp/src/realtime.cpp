@@ -0,0 +1,104 @@
+#include "td_can_bridge_cpp/realtime.hpp"
+
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+namespace td_can_bridge {
+
+namespace {
+
+constexpr size_t kStackPrefault = 256 * 1024;
+
+int64_t now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Touches the thread's next kStackPrefault bytes of stack, so deeper calls later do not fault
+[[gnu::noinline]] void prefault_stack()
+{
+    volatile unsigned char stack[kStackPrefault];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) stack[i] = 0;
+}
+
+} // namespace
+
+int lock_memory(size_t heap_bytes)
+{
+    // Freed blocks stay in the heap instead of going back to the kernel: they are resident already
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    if (heap_bytes) {
+        auto *block = static_cast<unsigned char *>(malloc(heap_bytes));
+        if (block != nullptr) {
+            for (size_t i = 0; i < heap_bytes; i += 4096) block[i] = 0;
+            free(block);
+        }
+    }
+    return mlockall(MCL_CURRENT | MCL_FUTURE) < 0 ? errno : 0;
+}
+
+int set_thread_realtime(int priority, const std::vector<int> &cpus)
+{
+    int error = 0;
+    if (!cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) CPU_SET(cpu, &set);
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc) error = rc;
+    }
+    if (priority > 0) {
+        sched_param param{};
+        param.sched_priority = priority;
+        int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (rc && !error) error = rc;
+    }
+    prefault_stack();
+    return error;
+}
+
+WakeupStats wakeup_test(int period_us, double seconds, int priority, const std::vector<int> &cpus, double limit_us)
+{
+    WakeupStats stats;
+    if (period_us <= 0 || seconds <= 0) return stats;
+    std::thread test([&]() {
+        stats.error = set_thread_realtime(priority, cpus);
+        size_t count = size_t(seconds * 1e6 / period_us);
+        std::vector<double> late(count);  // allocated before the loop, as the bridge does
+        int64_t period = int64_t(period_us) * 1000;
+        int64_t deadline = now_ns() + period;
+        for (size_t i = 0; i < count; i++) {
+            timespec ts{time_t(deadline / 1000000000), long(deadline % 1000000000)};
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+            }
+            late[i] = double(now_ns() - deadline) / 1e3;
+            deadline += period;
+        }
+        stats.samples = count;
+        if (count == 0) return;
+        double sum = 0.0;
+        for (double us : late) {
+            sum += us;
+            if (us > limit_us) stats.over++;
+        }
+        stats.mean_us = sum / double(count);
+        std::sort(late.begin(), late.end());
+        stats.p99_us = late[std::min(count - 1, count * 99 / 100)];
+        stats.max_us = late.back();
+    });
+    test.join();
+    return stats;
+}
+
+} // namespace td_can_bridge
@@ -0,0 +1,758 @@
+// Virtual RoboStride motors on a SocketCAN interface, for load-testing the bridges and tools on vcan
+// without hardware. Each motor answers the private protocol the way the real one does:
+//   type 0  device ID            -> type 0 with a 64-bit ID
+//   type 1  operation control    -> type 2 feedback
+//   type 3/4 enable / stop       -> type 2 (type 4 with data[0] = 1 also clears the faults)
+//   type 6  set mechanical zero  -> type 2
+//   type 17 read parameter       -> type 17 with the value (mechPos, iqf and mechVel live)
+//   type 18/22 write / save      -> type 2 (a write of EPScan_time sets the report interval)
+//   type 24 active reporting     -> type 2 every EPScan_time interval until turned off
+// and a scheduled fault sends type 21, sets the fault bits of its feedback and disables the motor.
+// Each motor drives a rigid load with the operation-control law (kp, kd, feed-forward torque), so
+// commands have visible effects. One thread waits in epoll on the socket, a timerfd and a
+// signalfd; replies leave after --latency-us +- --jitter-us, in order per motor. --bitrate paces
+// the motors' frames to the bus time they would take, counting the frames received.
+//
+//   robostride_sim --interface vcan0 --motors 1-12:RS02,13-16:RS03 --latency-us 150 --jitter-us 50
+//       --fault 3:over_voltage@5
+#include <getopt.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "robostride.h"
+
+namespace {
+
+constexpr size_t kBatch = 64;          // frames per recvmmsg / sendmmsg
+constexpr int kFrameBits = 131;        // an 8-byte extended frame without stuffing, with the interframe space
+constexpr int64_t kStepNs = 1000000;   // integration step of the motor dynamics
+constexpr int64_t kSettledNs = 2000000000; // a motor idle this long is taken to have settled
+constexpr int64_t kLateNs = 100000;    // a reply this far behind its schedule counts as late
+constexpr float kAmbientC = 25.0f;
+constexpr float kOverTempC = 90.0f;
+
+int64_t now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+float range_max(const rs_range_t &r)
+{
+    return r.min + 65535.0f * r.dec;
+}
+
+// The load each model drives: inertia (kg m^2) and viscous friction (N m s/rad) at the output
+struct ModelSpec {
+    const char *name;
+    rs_limits_t limits;
+    float inertia;
+    float friction;
+};
+
+const ModelSpec kModels[] = {
+    {"RS02", RS02_LIMITS, 0.01f, 0.02f},
+    {"RS03", RS03_LIMITS, 0.03f, 0.05f},
+    {"RS04", RS04_LIMITS, 0.06f, 0.1f},
+};
+
+const ModelSpec *find_model(const std::string &name)
+{
+    for (const ModelSpec &m : kModels)
+        if (name == m.name) return &m;
+    return nullptr;
+}
+
+// Fault bits of parameter 0x3022, and the type 2 ID bit (16..21) each shows as, -1 for none
+struct FaultName {
+    const char *name;
+    uint32_t mask;
+    int feedback_bit;
+};
+
+const FaultName kFaults[] = {
+    {"motor_over_temperature", RS_FAULT_MOTOR_OVER_TEMPERATURE, 2},
+    {"driver_chip_fault", RS_FAULT_DRIVER_CHIP_FAULT, -1},
+    {"under_voltage", RS_FAULT_UNDER_VOLTAGE, 0},
+    {"over_voltage", RS_FAULT_OVER_VOLTAGE, -1},
+    {"encoder_not_calibrated", RS_FAULT_ENCODER_NOT_CALIBRATED, 5},
+    {"iq_overload", RS_FAULT_IQ_OVERLOAD, 1},
+};
+
+const FaultName *find_fault(const std::string &name)
+{
+    for (const FaultName &f : kFaults)
+        if (name == f.name) return &f;
+    return nullptr;
+}
+
+// Parameter indices with behaviour; every other one of the table is plain storage
+enum : uint16_t {
+    kRunMode = 0x7005,
+    kLimitTorque = 0x700B,
+    kMechPos = 0x7019,
+    kIqf = 0x701A,
+    kMechVel = 0x701B,
+    kEpscanTime = 0x7026,
+};
+
+struct Param {
+    uint16_t index;
+    char fmt;       // struct code of the value in bytes 4..7, as td_can_bridges.robostride_params
+    uint32_t bits;  // the little-endian value
+};
+
+uint32_t float_bits(float x)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+// The RS02 parameter list with plausible defaults
+std::vector<Param> default_params(const ModelSpec &model)
+{
+    auto f = [](uint16_t index, float x) { return Param{index, 'f', float_bits(x)}; };
+    return {
+        {kRunMode, 'B', 0}, f(0x7006, 0.0f), f(0x700A, 0.0f), f(kLimitTorque, range_max(model.limits.t)),
+        f(0x7010, 0.125f), f(0x7011, 0.0158f), f(0x7014, 0.1f), f(0x7016, 0.0f), f(0x7017, 2.0f),
+        f(0x7018, 23.0f), f(kMechPos, 0.0f), f(kIqf, 0.0f), f(kMechVel, 0.0f), f(0x701C, 48.0f),
+        f(0x701E, 30.0f), f(0x701F, 6.0f), f(0x7020, 0.02f), f(0x7021, 0.1f), f(0x7022, 20.0f),
+        f(0x7024, 10.0f), f(0x7025, 10.0f), {kEpscanTime, 'H', 1}, {0x7028, 'I', 0}, {0x7029, 'B', 0},
+    };
+}
+
+struct Motor {
+    uint8_t id = 0;
+    const ModelSpec *model = nullptr;
+    uint8_t mode = 0;           // 0 reset, 2 run
+    rs_command_t cmd{};
+    float pos = 0.0f, vel = 0.0f, torque = 0.0f, temp = kAmbientC;
+    int64_t t_ns = 0;           // time pos/vel/temp are for
+    uint32_t faults = 0;        // 0x3022 bits
+    bool reporting = false;
+    uint32_t report_gen = 0;    // stale report events carry an older generation
+    int64_t last_due = 0;       // replies leave in order
+    std::vector<Param> params;
+
+    Param *param(uint16_t index)
+    {
+        for (Param &p : params)
+            if (p.index == index) return &p;
+        return nullptr;
+    }
+
+    int64_t report_interval_ns()
+    {
+        // EPScan_time: 1 is 10 ms and each step adds 5 ms
+        uint32_t code = std::max<uint32_t>(1, param(kEpscanTime)->bits & 0xFFFF);
+        return (10 + 5 * int64_t(code - 1)) * 1000000;
+    }
+
+    // Steps the load up to t with semi-implicit Euler; the damping term is implicit, so the
+    // largest kd of the model stays stable at the 1 ms step
+    void advance(int64_t t)
+    {
+        int64_t dt = t - t_ns;
+        if (dt <= 0) return;
+        if (dt > kSettledNs) dt = kSettledNs;
+        t_ns = t;
+        const rs_limits_t &l = model->limits;
+        float t_max = range_max(l.t), v_max = range_max(l.v), p_max = range_max(l.p);
+        float kp = mode == 2 ? cmd.kp : 0.0f, kd = mode == 2 ? cmd.kd : 0.0f;
+        // Steady-state rise of 40 C at a third of peak torque, with a 60 s time constant
+        float heat = 40.0f / (t_max * t_max / 9.0f);
+        for (; dt > 0; dt -= kStepNs) {
+            float h = float(std::min(dt, kStepNs)) * 1e-9f;
+            float drive = mode == 2 ? kp * (cmd.pos - pos) + kd * cmd.vel + cmd.torque : 0.0f;
+            float next = (vel + h * drive / model->inertia) / (1.0f + h * (kd + model->friction) / model->inertia);
+            torque = drive - kd * next;
+            if (std::fabs(torque) > t_max) { // saturated: the damping no longer acts through the drive
+                torque = std::copysign(t_max, torque);
+                next = (vel + h * torque / model->inertia) / (1.0f + h * model->friction / model->inertia);
+            }
+            vel = std::clamp(next, -v_max, v_max);
+            pos = std::clamp(pos + h * vel, l.p.min, p_max);
+            temp += h * (heat * torque * torque - (temp - kAmbientC)) / 60.0f;
+        }
+        if (temp > kOverTempC) faults |= RS_FAULT_MOTOR_OVER_TEMPERATURE;
+        if (faults) mode = 0;
+    }
+
+    uint8_t feedback_faults() const
+    {
+        uint8_t bits = 0;
+        for (const FaultName &f : kFaults)
+            if ((faults & f.mask) && f.feedback_bit >= 0) bits |= uint8_t(1u << f.feedback_bit);
+        return bits;
+    }
+};
+
+struct Event {
+    enum Kind : uint8_t { Reply, Report, Fault };
+    int64_t due;
+    uint64_t seq;    // ties leave in the order they were scheduled
+    Kind kind;
+    uint16_t motor;  // into Simulator::motors_
+    uint32_t arg;    // Report: generation, Fault: mask
+    can_frame frame; // Reply
+    bool operator>(const Event &o) const { return due != o.due ? due > o.due : seq > o.seq; }
+};
+
+struct Options {
+    std::string interface = "vcan0";
+    std::vector<Motor> motors;
+    uint8_t host_id = 0xFD;
+    int64_t latency_ns = 150000;
+    int64_t jitter_ns = 50000;
+    int64_t bitrate = 0;
+    double stats_s = 5.0;
+    uint32_t seed = 1;
+    struct ScheduledFault {
+        uint8_t motor;
+        uint32_t mask;
+        int64_t at_ns;
+    };
+    std::vector<ScheduledFault> faults;
+};
+
+class Simulator {
+public:
+    explicit Simulator(Options opts)
+        : opts_(std::move(opts)), motors_(std::move(opts_.motors)), rng_(opts_.seed),
+          jitter_(-opts_.jitter_ns, opts_.jitter_ns)
+    {
+        by_motor_.fill(-1);
+        for (size_t i = 0; i < motors_.size(); i++) by_motor_[motors_[i].id] = int16_t(i);
+        rx_frames_.resize(kBatch);
+        rx_iov_.resize(kBatch);
+        rx_control_.resize(kBatch * kControlLen);
+        rx_hdrs_.assign(kBatch, mmsghdr{});
+        for (size_t i = 0; i < kBatch; i++) {
+            rx_iov_[i] = {&rx_frames_[i], sizeof(can_frame)};
+            rx_hdrs_[i].msg_hdr.msg_iov = &rx_iov_[i];
+            rx_hdrs_[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    ~Simulator()
+    {
+        for (int fd : {fd_, timer_fd_, signal_fd_, epoll_fd_})
+            if (fd >= 0) close(fd);
+    }
+
+    void open();
+    void run();
+
+private:
+    static constexpr size_t kControlLen = CMSG_SPACE(sizeof(uint32_t));
+
+    void schedule(Event e)
+    {
+        e.seq = seq_++;
+        events_.push(e);
+    }
+    void reply(Motor &m, uint32_t id, const uint8_t data[8], int64_t now);
+    void feedback(Motor &m, uint8_t host, int64_t now);
+    void on_frame(const can_frame &f, int64_t now);
+    void receive(int64_t now);
+    void run_due(int64_t now);
+    void flush();
+    void arm_timer();
+    void report_stats(int64_t now);
+
+    Options opts_;
+    std::vector<Motor> motors_;
+    std::array<int16_t, 256> by_motor_;
+    std::mt19937 rng_;
+    std::uniform_int_distribution<int64_t> jitter_;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;
+    uint64_t seq_ = 0;
+    int fd_ = -1, timer_fd_ = -1, signal_fd_ = -1, epoll_fd_ = -1;
+    bool want_out_ = false;
+    int64_t bus_free_ = 0;        // --bitrate: when the simulated bus is next idle
+    int64_t next_stats_ = 0;
+
+    std::vector<can_frame> rx_frames_;
+    std::vector<iovec> rx_iov_;
+    std::vector<uint8_t> rx_control_;
+    std::vector<mmsghdr> rx_hdrs_;
+    std::vector<can_frame> tx_;   // due, not yet accepted by the socket
+
+    struct Stats {
+        uint64_t rx = 0, tx = 0, replies = 0, ignored = 0, unknown_param = 0, tx_waits = 0, late = 0;
+        int64_t late_sum_ns = 0, late_max_ns = 0;
+    } stats_;
+    uint32_t kernel_drops_ = 0;   // SO_RXQ_OVFL, cumulative
+    uint32_t kernel_drops_reported_ = 0;
+};
+
+void Simulator::open()
+{
+    fd_ = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
+    if (fd_ < 0) throw std::system_error(errno, std::generic_category(), "socket");
+    ifreq ifr{};
+    std::strncpy(ifr.ifr_name, opts_.interface.c_str(), IFNAMSIZ - 1);
+    if (ioctl(fd_, SIOCGIFINDEX, &ifr) < 0)
+        throw std::system_error(errno, std::generic_category(), "interface " + opts_.interface);
+    // Extended frames only: the private protocol. A deep receive buffer rides out scheduling
+    // hiccups at full rate, and SO_RXQ_OVFL counts whatever it still drops.
+    can_filter filter{CAN_EFF_FLAG, CAN_EFF_FLAG | CAN_RTR_FLAG};
+    int one = 1, buf = 4 << 20;
+    if (setsockopt(fd_, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter)) < 0 ||
+        setsockopt(fd_, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) < 0)
+        throw std::system_error(errno, std::generic_category(), "setsockopt");
+    if (setsockopt(fd_, SOL_SOCKET, SO_RCVBUFFORCE, &buf, sizeof(buf)) < 0)
+        setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf)); // capped at rmem_max without CAP_NET_ADMIN
+    sockaddr_can addr{};
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+        throw std::system_error(errno, std::generic_category(), "bind " + opts_.interface);
+
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    signal_fd_ = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (timer_fd_ < 0 || signal_fd_ < 0 || epoll_fd_ < 0)
+        throw std::system_error(errno, std::generic_category(), "timerfd/signalfd/epoll");
+    for (int fd : {fd_, timer_fd_, signal_fd_}) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0)
+            throw std::system_error(errno, std::generic_category(), "epoll_ctl");
+    }
+}
+
+void Simulator::reply(Motor &m, uint32_t id, const uint8_t data[8], int64_t now)
+{
+    Event e{};
+    e.due = std::max(now + std::max<int64_t>(0, opts_.latency_ns + (opts_.jitter_ns ? jitter_(rng_) : 0)), m.last_due);
+    m.last_due = e.due;
+    e.kind = Event::Reply;
+    e.frame.can_id = id | CAN_EFF_FLAG;
+    e.frame.can_dlc = 8;
+    std::memcpy(e.frame.data, data, 8);
+    schedule(e);
+}
+
+// Type 2: mode in ID bits 22..23, faults in 16..21, motor in 8..15, host in 0..7
+void Simulator::feedback(Motor &m, uint8_t host, int64_t now)
+{
+    const rs_limits_t &l = m.model->limits;
+    uint8_t data[8];
+    rs_put16(&data[0], rs_encode(&l.p, m.pos));
+    rs_put16(&data[2], rs_encode(&l.v, m.vel));
+    rs_put16(&data[4], rs_encode(&l.t, m.torque));
+    rs_put16(&data[6], uint16_t(std::clamp(m.temp / l.temp_scale, 0.0f, 65535.0f)));
+    uint16_t status = uint16_t((m.mode & 0x3) << 14 | m.feedback_faults() << 8 | m.id);
+    reply(m, rs_build_ext_id(host, status, RS_TYPE_FEEDBACK), data, now);
+}
+
+void Simulator::on_frame(const can_frame &f, int64_t now)
+{
+    uint32_t id = f.can_id & CAN_EFF_MASK;
+    int16_t index = by_motor_[id & 0xFF];
+    if (index < 0 || f.can_dlc < 8) {
+        stats_.ignored++;
+        return;
+    }
+    Motor &m = motors_[size_t(index)];
+    m.advance(now);
+    uint16_t data16 = uint16_t(id >> 8);
+    uint8_t host = uint8_t(data16 & 0xFF); // every type but 1 carries the host ID here
+    uint8_t out[8] = {0};
+    switch (rs_ext_id_type(id)) {
+    case RS_TYPE_GET_DEVICE_ID: {
+        const char *name = m.model->name;
+        uint8_t uid[8] = {'R', 'S', uint8_t(name[2]), uint8_t(name[3]), 0, 0, 0, m.id};
+        reply(m, rs_build_ext_id(0xFE, m.id, RS_TYPE_GET_DEVICE_ID), uid, now);
+        return;
+    }
+    case RS_TYPE_OP_CONTROL: {
+        const rs_limits_t &l = m.model->limits;
+        m.cmd.pos = rs_decode(&l.p, rs_get16(&f.data[0]));
+        m.cmd.vel = rs_decode(&l.v, rs_get16(&f.data[2]));
+        m.cmd.kp = rs_decode(&l.kp, rs_get16(&f.data[4]));
+        m.cmd.kd = rs_decode(&l.kd, rs_get16(&f.data[6]));
+        m.cmd.torque = rs_decode(&l.t, data16);
+        feedback(m, opts_.host_id, now);
+        return;
+    }
+    case RS_TYPE_ENABLE:
+        if (!m.faults) m.mode = 2; // a faulted motor stays in reset until type 4 clears it
+        break;
+    case RS_TYPE_STOP:
+        m.mode = 0;
+        m.cmd = rs_command_t{};
+        if (f.data[0] == 1) m.faults = 0;
+        break;
+    case RS_TYPE_SET_MECHANICAL_ZERO:
+        if (f.data[0] == 1) m.pos = 0.0f;
+        break;
+    case RS_TYPE_READ_PARAMETER:
+    case RS_TYPE_WRITE_PARAMETER: {
+        uint16_t param_index = uint16_t(f.data[0] | f.data[1] << 8);
+        Param *p = m.param(param_index);
+        if (p == nullptr) {
+            stats_.unknown_param++; // the real motor stays silent too
+            return;
+        }
+        if (rs_ext_id_type(id) == RS_TYPE_WRITE_PARAMETER) {
+            std::memcpy(&p->bits, &f.data[4], 4);
+            break;
+        }
+        switch (param_index) {
+        case kMechPos: p->bits = float_bits(m.pos); break;
+        case kMechVel: p->bits = float_bits(m.vel); break;
+        case kIqf: p->bits = float_bits(m.torque); break; // torque stands in for the q-axis current
+        default: break;
+        }
+        out[0] = f.data[0];
+        out[1] = f.data[1];
+        std::memcpy(&out[4], &p->bits, 4);
+        reply(m, rs_build_ext_id(host, uint16_t(m.id), RS_TYPE_READ_PARAMETER), out, now);
+        return;
+    }
+    case RS_TYPE_SAVE_PARAMETERS:
+        break;
+    case RS_TYPE_ENABLE_ACTIVE_REPORTING: {
+        m.reporting = f.data[6] != 0;
+        m.report_gen++;
+        if (m.reporting) {
+            Event e{};
+            e.due = now + m.report_interval_ns();
+            e.kind = Event::Report;
+            e.motor = uint16_t(index);
+            e.arg = m.report_gen;
+            schedule(e);
+        }
+        return;
+    }
+    default:
+        stats_.ignored++;
+        return;
+    }
+    feedback(m, host, now);
+}
+
+void Simulator::receive(int64_t now)
+{
+    while (true) {
+        for (size_t i = 0; i < kBatch; i++) {
+            rx_hdrs_[i].msg_hdr.msg_control = rx_control_.data() + i * kControlLen;
+            rx_hdrs_[i].msg_hdr.msg_controllen = kControlLen;
+        }
+        int n = recvmmsg(fd_, rx_hdrs_.data(), kBatch, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) return;
+            throw std::system_error(errno, std::generic_category(), "recvmmsg");
+        }
+        for (int i = 0; i < n; i++) {
+            msghdr &hdr = rx_hdrs_[size_t(i)].msg_hdr;
+            for (cmsghdr *c = CMSG_FIRSTHDR(&hdr); c != nullptr; c = CMSG_NXTHDR(&hdr, c))
+                if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL)
+                    std::memcpy(&kernel_drops_, CMSG_DATA(c), sizeof(kernel_drops_));
+            if (opts_.bitrate) bus_free_ = std::max(bus_free_, now) + kFrameBits * 1000000000LL / opts_.bitrate;
+            on_frame(rx_frames_[size_t(i)], now);
+        }
+        stats_.rx += uint64_t(n);
+        if (size_t(n) < kBatch) return;
+    }
+}
+
+void Simulator::run_due(int64_t now)
+{
+    while (!events_.empty() && events_.top().due <= now) {
+        if (opts_.bitrate && bus_free_ > now) break; // the bus is still busy: the timer comes back
+        Event e = events_.top();
+        events_.pop();
+        Motor &m = motors_[e.motor];
+        switch (e.kind) {
+        case Event::Reply: {
+            int64_t late = now - e.due;
+            stats_.late_sum_ns += late;
+            stats_.late_max_ns = std::max(stats_.late_max_ns, late);
+            stats_.replies++;
+            stats_.late += late > kLateNs;
+            tx_.push_back(e.frame);
+            if (opts_.bitrate) bus_free_ = std::max(bus_free_, now) + kFrameBits * 1000000000LL / opts_.bitrate;
+            break;
+        }
+        case Event::Report:
+            if (!m.reporting || e.arg != m.report_gen) break;
+            m.advance(now);
+            feedback(m, opts_.host_id, now);
+            e.due += m.report_interval_ns();
+            schedule(e);
+            break;
+        case Event::Fault: {
+            m.advance(now);
+            m.faults |= e.arg;
+            m.mode = 0;
+            uint8_t data[8] = {0};
+            std::memcpy(data, &m.faults, 4); // 0x3022 fault word, then the warning word
+            reply(m, rs_build_ext_id(opts_.host_id, m.id, RS_TYPE_FAULT_FEEDBACK), data, now);
+            feedback(m, opts_.host_id, now);
+            std::fprintf(stderr, "motor %u: fault 0x%04X\n", m.id, e.arg);
+            break;
+        }
+        }
+    }
+}
+
+// Frames the socket refuses stay queued and go out on EPOLLOUT: a slow reader delays replies, it
+// does not lose them
+void Simulator::flush()
+{
+    size_t sent = 0;
+    while (sent < tx_.size()) {
+        mmsghdr hdrs[kBatch];
+        iovec iov[kBatch];
+        size_t n = std::min(kBatch, tx_.size() - sent);
+        for (size_t i = 0; i < n; i++) {
+            iov[i] = {&tx_[sent + i], sizeof(can_frame)};
+            hdrs[i] = mmsghdr{};
+            hdrs[i].msg_hdr.msg_iov = &iov[i];
+            hdrs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int count = sendmmsg(fd_, hdrs, unsigned(n), MSG_DONTWAIT);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != ENOBUFS)
+                throw std::system_error(errno, std::generic_category(), "sendmmsg");
+            stats_.tx_waits++;
+            break;
+        }
+        sent += size_t(count);
+    }
+    stats_.tx += sent;
+    tx_.erase(tx_.begin(), tx_.begin() + long(sent));
+    bool want_out = !tx_.empty();
+    if (want_out != want_out_) {
+        epoll_event ev{};
+        ev.events = EPOLLIN | (want_out ? EPOLLOUT : 0u);
+        ev.data.fd = fd_;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd_, &ev);
+        want_out_ = want_out;
+    }
+}
+
+void Simulator::arm_timer()
+{
+    int64_t due = next_stats_;
+    if (!events_.empty()) due = std::min(due, std::max(events_.top().due, opts_.bitrate ? bus_free_ : 0));
+    itimerspec spec{};
+    spec.it_value.tv_sec = due / 1000000000;
+    spec.it_value.tv_nsec = due % 1000000000;
+    timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void Simulator::report_stats(int64_t now)
+{
+    double s = opts_.stats_s;
+    uint32_t drops = kernel_drops_ - kernel_drops_reported_;
+    kernel_drops_reported_ = kernel_drops_;
+    std::fprintf(stderr,
+                 "%zu motors: rx %.0f/s, tx %.0f/s; replies %.1f us mean / %.1f us max behind schedule, %lu late; "
+                 "%u kernel RX drops, %lu TX waits, %lu ignored, %lu unknown parameters\n",
+                 motors_.size(), double(stats_.rx) / s, double(stats_.tx) / s,
+                 stats_.replies ? double(stats_.late_sum_ns) / double(stats_.replies) / 1e3 : 0.0, stats_.late_max_ns / 1e3,
+                 (unsigned long)stats_.late, drops, (unsigned long)stats_.tx_waits, (unsigned long)stats_.ignored,
+                 (unsigned long)stats_.unknown_param);
+    stats_ = Stats{};
+    next_stats_ = now + int64_t(s * 1e9);
+}
+
+void Simulator::run()
+{
+    int64_t start = now_ns();
+    for (Motor &m : motors_) m.t_ns = start;
+    for (const Options::ScheduledFault &f : opts_.faults) {
+        Event e{};
+        e.due = start + f.at_ns;
+        e.kind = Event::Fault;
+        e.motor = uint16_t(by_motor_[f.motor]);
+        e.arg = f.mask;
+        schedule(e);
+    }
+    next_stats_ = start + int64_t(opts_.stats_s * 1e9);
+    std::fprintf(stderr, "%zu RoboStride motors on %s, replies after %.0f +- %.0f us%s\n", motors_.size(),
+                 opts_.interface.c_str(), opts_.latency_ns / 1e3, opts_.jitter_ns / 1e3,
+                 opts_.bitrate ? ", paced to the bitrate" : "");
+    arm_timer();
+    epoll_event events[3];
+    while (true) {
+        int n = epoll_wait(epoll_fd_, events, 3, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::system_error(errno, std::generic_category(), "epoll_wait");
+        }
+        int64_t now = now_ns();
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == signal_fd_) return;
+            if (fd == timer_fd_) {
+                uint64_t expirations;
+                (void)!::read(timer_fd_, &expirations, sizeof(expirations));
+            } else if (events[i].events & EPOLLIN) {
+                receive(now);
+            }
+        }
+        run_due(now);
+        flush();
+        if (now >= next_stats_) report_stats(now);
+        arm_timer();
+    }
+}
+
+// "1-12:RS02,13:RS04"; the model defaults to RS02
+void parse_motors(const std::string &text, const ModelSpec *fallback, std::vector<Motor> &out)
+{
+    size_t pos = 0;
+    while (pos <= text.size()) {
+        size_t end = text.find(',', pos);
+        std::string part = text.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        pos = end == std::string::npos ? text.size() + 1 : end + 1;
+        const ModelSpec *model = fallback;
+        size_t colon = part.find(':');
+        if (colon != std::string::npos) {
+            model = find_model(part.substr(colon + 1));
+            if (model == nullptr) throw std::runtime_error("--motors: unknown model in '" + part + "'");
+            part.resize(colon);
+        }
+        size_t dash = part.find('-');
+        unsigned long first, last;
+        try {
+            first = std::stoul(part.substr(0, dash), nullptr, 0);
+            last = dash == std::string::npos ? first : std::stoul(part.substr(dash + 1), nullptr, 0);
+        } catch (const std::exception &) {
+            throw std::runtime_error("--motors: expected IDs like 1-12:RS02,13, got '" + text + "'");
+        }
+        if (first < 1 || last > 0xFD || first > last)
+            throw std::runtime_error("--motors: IDs must be 1..253, got '" + part + "'");
+        for (unsigned long id = first; id <= last; id++) {
+            Motor m;
+            m.id = uint8_t(id);
+            m.model = model;
+            m.params = default_params(*model);
+            out.push_back(std::move(m));
+        }
+    }
+}
+
+// "3:over_voltage@2.5": motor 3 reports over-voltage 2.5 s after the start
+Options::ScheduledFault parse_fault(const std::string &text)
+{
+    size_t colon = text.find(':'), at = text.find('@');
+    if (colon == std::string::npos || at == std::string::npos || at < colon)
+        throw std::runtime_error("--fault: expected MOTOR:NAME@SECONDS, got '" + text + "'");
+    const FaultName *fault = find_fault(text.substr(colon + 1, at - colon - 1));
+    if (fault == nullptr) {
+        std::string names;
+        for (const FaultName &f : kFaults) names += std::string(names.empty() ? "" : ", ") + f.name;
+        throw std::runtime_error("--fault: unknown fault in '" + text + "', expected one of " + names);
+    }
+    try {
+        return {uint8_t(std::stoul(text.substr(0, colon), nullptr, 0)), fault->mask,
+                int64_t(std::stod(text.substr(at + 1)) * 1e9)};
+    } catch (const std::exception &) {
+        throw std::runtime_error("--fault: expected MOTOR:NAME@SECONDS, got '" + text + "'");
+    }
+}
+
+void usage(const char *argv0)
+{
+    std::fprintf(stderr,
+                 "usage: %s [--interface vcan0] [--motors 1-12:RS02,...] [--host-id 0xFD] [--latency-us 150]\n"
+                 "       [--jitter-us 50] [--bitrate 1000000] [--fault MOTOR:NAME@SECONDS]... [--stats-s 5]\n"
+                 "       [--seed 1]\n",
+                 argv0);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    static const option longopts[] = {
+        {"interface", required_argument, nullptr, 'i'}, {"motors", required_argument, nullptr, 'm'},
+        {"host-id", required_argument, nullptr, 'H'},   {"latency-us", required_argument, nullptr, 'l'},
+        {"jitter-us", required_argument, nullptr, 'j'}, {"bitrate", required_argument, nullptr, 'b'},
+        {"fault", required_argument, nullptr, 'f'},     {"stats-s", required_argument, nullptr, 's'},
+        {"seed", required_argument, nullptr, 'S'},      {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+    Options opts;
+    std::string motors = "1-12";
+    try {
+        int c;
+        while ((c = getopt_long(argc, argv, "i:m:h", longopts, nullptr)) != -1) {
+            switch (c) {
+            case 'i': opts.interface = optarg; break;
+            case 'm': motors = optarg; break;
+            case 'H': opts.host_id = uint8_t(std::stoul(optarg, nullptr, 0)); break;
+            case 'l': opts.latency_ns = int64_t(std::stod(optarg) * 1e3); break;
+            case 'j': opts.jitter_ns = int64_t(std::stod(optarg) * 1e3); break;
+            case 'b': opts.bitrate = std::stoll(optarg); break;
+            case 'f': opts.faults.push_back(parse_fault(optarg)); break;
+            case 's': opts.stats_s = std::stod(optarg); break;
+            case 'S': opts.seed = uint32_t(std::stoul(optarg)); break;
+            default: usage(argv[0]); return c == 'h' ? 0 : 2;
+            }
+        }
+        parse_motors(motors, &kModels[0], opts.motors);
+        if (opts.latency_ns < 0 || opts.jitter_ns < 0 || opts.bitrate < 0 || opts.stats_s <= 0)
+            throw std::runtime_error("--latency-us, --jitter-us and --bitrate must be >= 0, --stats-s > 0");
+        std::vector<bool> seen(256);
+        for (const Motor &m : opts.motors) {
+            if (seen[m.id]) throw std::runtime_error("--motors: motor " + std::to_string(m.id) + " given twice");
+            seen[m.id] = true;
+        }
+        for (const Options::ScheduledFault &f : opts.faults)
+            if (!seen[f.motor]) throw std::runtime_error("--fault: motor " + std::to_string(f.motor) + " is not simulated");
+    } catch (const std::exception &exc) {
+        std::fprintf(stderr, "%s\n", exc.what());
+        usage(argv[0]);
+        return 2;
+    }
+
+    try {
+        Simulator sim(std::move(opts));
+        sim.open();
+        sim.run();
+    } catch (const std::system_error &exc) {
+        std::fprintf(stderr, "robostride_sim: %s\n", exc.what());
+        return 1;
+    }
+    return 0;
+}
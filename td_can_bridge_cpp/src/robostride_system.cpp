@@ -0,0 +1,378 @@
+#include "td_can_bridge_cpp/robostride_system.hpp"
+
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
+#include <hardware_interface/types/hardware_interface_type_values.hpp>
+#include <pluginlib/class_list_macros.hpp>
+
+namespace td_can_bridge {
+
+namespace {
+
+using hardware_interface::CallbackReturn;
+using hardware_interface::return_type;
+
+const rs_limits_t kRs02 = RS02_LIMITS;
+const rs_limits_t kRs03 = RS03_LIMITS;
+const rs_limits_t kRs04 = RS04_LIMITS;
+
+const rclcpp::Logger &logger()
+{
+    static const rclcpp::Logger log = rclcpp::get_logger("RobostrideSystem");
+    return log;
+}
+
+const rs_limits_t *model_limits(const std::string &model)
+{
+    if (model == "RS02") return &kRs02;
+    if (model == "RS03") return &kRs03;
+    if (model == "RS04") return &kRs04;
+    return nullptr;
+}
+
+// Hardware and joint <param>s come in as strings; IDs may be written 0x..
+std::string param(const std::unordered_map<std::string, std::string> &params, const std::string &key,
+                  const std::string &fallback)
+{
+    auto it = params.find(key);
+    return it == params.end() ? fallback : it->second;
+}
+
+uint32_t param_id(const std::unordered_map<std::string, std::string> &params, const std::string &key,
+                  const std::string &context)
+{
+    auto it = params.find(key);
+    if (it == params.end()) throw std::runtime_error(context + ": missing <param name=\"" + key + "\">");
+    try {
+        return uint32_t(std::stoul(it->second, nullptr, 0));
+    } catch (const std::exception &) {
+        throw std::runtime_error(context + ": " + key + " must be an integer, got '" + it->second + "'");
+    }
+}
+
+double param_double(const std::unordered_map<std::string, std::string> &params, const std::string &key,
+                    double fallback, const std::string &context)
+{
+    auto it = params.find(key);
+    if (it == params.end()) return fallback;
+    try {
+        return std::stod(it->second);
+    } catch (const std::exception &) {
+        throw std::runtime_error(context + ": " + key + " must be a number, got '" + it->second + "'");
+    }
+}
+
+double us_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+void RobostrideSystem::Timing::add(double us)
+{
+    count++;
+    sum_us += us;
+    max_us = std::max(max_us, us);
+}
+
+CallbackReturn RobostrideSystem::on_init(const hardware_interface::HardwareInfo &info)
+{
+    if (SystemInterface::on_init(info) != CallbackReturn::SUCCESS) return CallbackReturn::ERROR;
+    try {
+        const auto &hw = info_.hardware_parameters;
+        interface_ = param(hw, "can_interface", "can0");
+        host_id_ = uint8_t(hw.count("host_id") ? param_id(hw, "host_id", info_.name) : 0xFD);
+        budget_us_ = param_double(hw, "cycle_budget_us", budget_us_, info_.name);
+        double report_s = param_double(hw, "report_period_s", 5.0, info_.name);
+        if (budget_us_ <= 0 || report_s <= 0)
+            throw std::runtime_error(info_.name + ": cycle_budget_us and report_period_s must be positive");
+        report_period_ = std::chrono::nanoseconds(int64_t(report_s * 1e9));
+
+        by_motor_.fill(-1);
+        for (const hardware_interface::ComponentInfo &j : info_.joints) {
+            Joint joint;
+            joint.name = j.name;
+            uint32_t id = param_id(j.parameters, "motor_id", "joint " + j.name);
+            if (id > 0xFF) throw std::runtime_error("joint " + j.name + ": motor_id must fit in 8 bits");
+            if (by_motor_[id] >= 0)
+                throw std::runtime_error("joint " + j.name + ": motor_id " + std::to_string(id) + " is also joint " +
+                                         joints_[by_motor_[id]].name);
+            joint.motor_id = uint8_t(id);
+            std::string model = param(j.parameters, "model", "RS02");
+            joint.limits = model_limits(model);
+            if (joint.limits == nullptr)
+                throw std::runtime_error("joint " + j.name + ": model must be RS02, RS03 or RS04, got " + model);
+            joint.kp = param_double(j.parameters, "kp", 0.0, "joint " + j.name);
+            joint.kd = param_double(j.parameters, "kd", 0.0, "joint " + j.name);
+            by_motor_[id] = int16_t(joints_.size());
+            joints_.push_back(joint);
+        }
+    } catch (const std::runtime_error &exc) {
+        RCLCPP_ERROR(logger(), "%s", exc.what());
+        return CallbackReturn::ERROR;
+    }
+    if (joints_.empty()) {
+        RCLCPP_ERROR(logger(), "%s: no joints", info_.name.c_str());
+        return CallbackReturn::ERROR;
+    }
+
+    size_t n = joints_.size();
+    limits_.resize(n);
+    motor_ids_.resize(n);
+    commands_.resize(n);
+    packed_.resize(n);
+    frames_.assign(n, can_frame{});
+    iov_.resize(n);
+    hdrs_.assign(n, mmsghdr{});
+    for (size_t i = 0; i < n; i++) {
+        limits_[i] = joints_[i].limits;
+        motor_ids_[i] = joints_[i].motor_id;
+        frames_[i].can_dlc = 8;
+        iov_[i] = {&frames_[i], sizeof(can_frame)};
+        hdrs_[i].msg_hdr.msg_iov = &iov_[i];
+        hdrs_[i].msg_hdr.msg_iovlen = 1;
+    }
+    return CallbackReturn::SUCCESS;
+}
+
+std::vector<hardware_interface::StateInterface> RobostrideSystem::export_state_interfaces()
+{
+    std::vector<hardware_interface::StateInterface> out;
+    for (Joint &j : joints_) {
+        out.emplace_back(j.name, hardware_interface::HW_IF_POSITION, &j.position);
+        out.emplace_back(j.name, hardware_interface::HW_IF_VELOCITY, &j.velocity);
+        out.emplace_back(j.name, hardware_interface::HW_IF_EFFORT, &j.effort);
+        out.emplace_back(j.name, "temperature", &j.temperature);
+    }
+    return out;
+}
+
+std::vector<hardware_interface::CommandInterface> RobostrideSystem::export_command_interfaces()
+{
+    std::vector<hardware_interface::CommandInterface> out;
+    for (Joint &j : joints_) {
+        out.emplace_back(j.name, hardware_interface::HW_IF_POSITION, &j.cmd_position);
+        out.emplace_back(j.name, hardware_interface::HW_IF_VELOCITY, &j.cmd_velocity);
+        out.emplace_back(j.name, hardware_interface::HW_IF_EFFORT, &j.cmd_effort);
+    }
+    return out;
+}
+
+void RobostrideSystem::open_socket()
+{
+    // Non-blocking so a full TX queue costs write() a dropped frame rather than the cycle
+    fd_ = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
+    if (fd_ < 0) throw std::system_error(errno, std::generic_category(), "socket");
+    auto fail = [this](const std::string &what) {
+        int err = errno;
+        close_socket();
+        throw std::system_error(err, std::generic_category(), what);
+    };
+
+    ifreq ifr{};
+    std::strncpy(ifr.ifr_name, interface_.c_str(), IFNAMSIZ - 1);
+    if (ioctl(fd_, SIOCGIFINDEX, &ifr) < 0) fail("interface " + interface_);
+    // Only type-2 feedback addressed to this host reaches the socket
+    can_filter filter{};
+    filter.can_id = rs_build_ext_id(host_id_, 0, RS_TYPE_FEEDBACK) | CAN_EFF_FLAG;
+    filter.can_mask = (0x1Fu << 24) | 0xFFu | CAN_EFF_FLAG | CAN_RTR_FLAG;
+    if (setsockopt(fd_, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter)) < 0) fail("CAN_RAW_FILTER");
+    sockaddr_can addr{};
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) fail("bind " + interface_);
+
+    // Raw entries: RxCore hands back the payload and rs_decode_feedback scales it per model
+    core_ = std::make_unique<td_can::RxCore>(fd_, std::max<size_t>(2 * joints_.size(), 16));
+    td_can::MessageSpec spec;
+    spec.length = 8;
+    spec.raw = true;
+    core_->set_message(rs_build_ext_id(host_id_, 0, RS_TYPE_FEEDBACK), true, std::move(spec), (0x1Fu << 24) | 0xFFu);
+}
+
+void RobostrideSystem::close_socket()
+{
+    core_.reset();
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+}
+
+CallbackReturn RobostrideSystem::on_configure(const rclcpp_lifecycle::State &)
+{
+    try {
+        open_socket();
+    } catch (const std::system_error &exc) {
+        RCLCPP_ERROR(logger(), "%s: %s", info_.name.c_str(), exc.what());
+        return CallbackReturn::ERROR;
+    }
+    RCLCPP_INFO(logger(), "%s: %zu RoboStride joints on %s, host ID 0x%02X, cycle budget %.0f us", info_.name.c_str(),
+                joints_.size(), interface_.c_str(), host_id_, budget_us_);
+    return CallbackReturn::SUCCESS;
+}
+
+CallbackReturn RobostrideSystem::on_cleanup(const rclcpp_lifecycle::State &)
+{
+    close_socket();
+    return CallbackReturn::SUCCESS;
+}
+
+CallbackReturn RobostrideSystem::on_activate(const rclcpp_lifecycle::State &)
+{
+    // No command until a controller writes one: write() sends zero gains and zero torque meanwhile
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for (Joint &j : joints_) j.cmd_position = j.cmd_velocity = j.cmd_effort = nan;
+    period_ = read_ = write_ = Timing{};
+    late_ = missed_ = tx_dropped_ = faults_ = 0;
+    last_report_ = std::chrono::steady_clock::now();
+    if (!send_all(RS_TYPE_ENABLE)) return CallbackReturn::ERROR;
+    return CallbackReturn::SUCCESS;
+}
+
+CallbackReturn RobostrideSystem::on_deactivate(const rclcpp_lifecycle::State &)
+{
+    return send_all(RS_TYPE_STOP) ? CallbackReturn::SUCCESS : CallbackReturn::ERROR;
+}
+
+bool RobostrideSystem::send_all(uint8_t type)
+{
+    for (size_t i = 0; i < joints_.size(); i++) {
+        // The host ID rides in the type-specific bits; the payload is zero (type 4: no fault clear)
+        frames_[i].can_id = rs_build_ext_id(motor_ids_[i], host_id_, type) | CAN_EFF_FLAG;
+        std::memset(frames_[i].data, 0, sizeof(frames_[i].data));
+    }
+    if (send_frames(joints_.size())) return true;
+    RCLCPP_ERROR(logger(), "%s: sending type %u to the joints failed: %s", info_.name.c_str(), type,
+                 std::strerror(errno));
+    return false;
+}
+
+bool RobostrideSystem::send_frames(size_t n)
+{
+    size_t sent = 0;
+    while (sent < n) {
+        int count = sendmmsg(fd_, hdrs_.data() + sent, unsigned(n - sent), 0);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == ENOBUFS) {
+                tx_dropped_ += n - sent;
+                return true;
+            }
+            return false;
+        }
+        sent += size_t(count);
+    }
+    return true;
+}
+
+return_type RobostrideSystem::read(const rclcpp::Time &, const rclcpp::Duration &period)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (Joint &j : joints_) j.fresh = false;
+    try {
+        // One recvmmsg of up to the batch per poll; again while the last one read anything
+        uint64_t before;
+        do {
+            before = core_->frames();
+            core_->poll(0, batch_);
+            for (const td_can::Decoded &frame : batch_.frames) {
+                if (frame.len < 8) continue;
+                int16_t i = by_motor_[(frame.id >> 8) & 0xFF];
+                if (i < 0) continue;
+                Joint &j = joints_[size_t(i)];
+                rs_feedback_t fb;
+                rs_decode_feedback(j.limits, frame.id, frame.data, &fb);
+                j.position = fb.pos;
+                j.velocity = fb.vel;
+                j.effort = fb.torque;
+                j.temperature = fb.temp;
+                if (fb.fault && !j.fault)
+                    RCLCPP_ERROR(logger(), "%s: %s reports fault bits 0x%02X", info_.name.c_str(), j.name.c_str(),
+                                 fb.fault);
+                faults_ += fb.fault != 0;
+                j.fault = fb.fault;
+                j.fresh = true;
+            }
+        } while (core_->frames() != before);
+    } catch (const std::system_error &exc) {
+        RCLCPP_ERROR(logger(), "%s: %s", info_.name.c_str(), exc.what());
+        return return_type::ERROR;
+    }
+    for (const Joint &j : joints_) missed_ += !j.fresh;
+
+    double period_us = period.nanoseconds() / 1e3;
+    if (period_us > 0) {
+        period_.add(period_us);
+        late_ += period_us > 1.25 * budget_us_;
+    }
+    read_.add(us_since(start));
+    return return_type::OK;
+}
+
+return_type RobostrideSystem::write(const rclcpp::Time &, const rclcpp::Duration &)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < joints_.size(); i++) {
+        const Joint &j = joints_[i];
+        rs_command_t &c = commands_[i];
+        // A command no controller claimed drops its term
+        bool hold = std::isfinite(j.cmd_position);
+        c.pos = hold ? float(j.cmd_position) : 0.0f;
+        c.kp = hold ? float(j.kp) : 0.0f;
+        c.vel = std::isfinite(j.cmd_velocity) ? float(j.cmd_velocity) : 0.0f;
+        c.kd = float(j.kd);
+        c.torque = std::isfinite(j.cmd_effort) ? float(j.cmd_effort) : 0.0f;
+    }
+    size_t n = joints_.size();
+    rs_pack_op_control_batch(n, limits_.data(), motor_ids_.data(), commands_.data(), packed_.data());
+    for (size_t i = 0; i < n; i++) {
+        frames_[i].can_id = packed_[i].id | CAN_EFF_FLAG;
+        std::memcpy(frames_[i].data, packed_[i].data, 8);
+    }
+    if (!send_frames(n)) {
+        RCLCPP_ERROR(logger(), "%s: sendmmsg: %s", info_.name.c_str(), std::strerror(errno));
+        return return_type::ERROR;
+    }
+    auto now = std::chrono::steady_clock::now();
+    write_.add(std::chrono::duration<double, std::micro>(now - start).count());
+    if (now - last_report_ >= report_period_) report(now);
+    return return_type::OK;
+}
+
+void RobostrideSystem::report(std::chrono::steady_clock::time_point now)
+{
+    auto mean = [](const Timing &t) { return t.count ? t.sum_us / double(t.count) : 0.0; };
+    double io = mean(read_) + mean(write_);
+    // Late cycles are the controller_manager's; missed feedback and drops are the bus's
+    char line[320];
+    std::snprintf(line, sizeof(line),
+                  "%lu cycles, period %.0f us mean / %.0f max (budget %.0f, %lu late); read %.1f / %.1f us, "
+                  "write %.1f / %.1f us (%.1f%% of budget); %lu missed feedback, %lu TX dropped, %lu faulted",
+                  (unsigned long)read_.count, mean(period_), period_.max_us, budget_us_, (unsigned long)late_,
+                  mean(read_), read_.max_us, mean(write_), write_.max_us, 100.0 * io / budget_us_,
+                  (unsigned long)missed_, (unsigned long)tx_dropped_, (unsigned long)faults_);
+    // Late cycles are the controller_manager's; missed feedback and drops are the bus's
+    if (late_ || missed_ || tx_dropped_ || faults_)
+        RCLCPP_WARN(logger(), "%s: %s", info_.name.c_str(), line);
+    else
+        RCLCPP_INFO(logger(), "%s: %s", info_.name.c_str(), line);
+    period_ = read_ = write_ = Timing{};
+    late_ = missed_ = tx_dropped_ = faults_ = 0;
+    last_report_ = now;
+}
+
+} // namespace td_can_bridge
+
+PLUGINLIB_EXPORT_CLASS(td_can_bridge::RobostrideSystem, hardware_interface::SystemInterface)
@@ -0,0 +1,120 @@
+#include "td_can_bridge_cpp/work_pool.hpp"
+
+#include <time.h>
+
+#include "td_can_bridge_cpp/realtime.hpp"
+
+namespace td_can_bridge {
+
+namespace {
+
+// The worker the calling thread is, so a lane put back from inside the pool stays on it
+thread_local const WorkPool *current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+} // namespace
+
+int64_t WorkPool::now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+WorkPool::WorkPool(size_t workers, int priority, const std::vector<int> &cpus)
+{
+    for (size_t i = 0; i < std::max<size_t>(workers, 1); i++) workers_.push_back(std::make_unique<Worker>());
+    for (size_t i = 0; i < workers_.size(); i++)
+        workers_[i]->thread = std::thread(&WorkPool::run, this, i, priority, cpus);
+}
+
+WorkPool::~WorkPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto &w : workers_) w->thread.join();
+}
+
+WorkPool::WorkerStats WorkPool::stats(size_t worker) const
+{
+    const Worker &w = *workers_.at(worker);
+    WorkerStats s;
+    s.turns = w.turns.load(std::memory_order_relaxed);
+    s.steals = w.steals.load(std::memory_order_relaxed);
+    s.busy_ns = w.busy_ns.load(std::memory_order_relaxed);
+    return s;
+}
+
+void WorkPool::schedule(Lane *lane)
+{
+    Worker &w = *workers_[current_pool == this ? current_worker : lane->home_];
+    {
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.lanes.push_back(lane);
+    }
+    // queued_ before sleepers_, and the other way round in run(): either the sleeper sees the lane
+    // or this sees the sleeper
+    queued_.fetch_add(1);
+    if (sleepers_.load() == 0) return;
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    wake_.notify_one();
+}
+
+WorkPool::Lane *WorkPool::take(size_t self)
+{
+    Worker &w = *workers_[self];
+    std::lock_guard<std::mutex> lock(w.mutex);
+    if (w.lanes.empty()) return nullptr;
+    Lane *lane = w.lanes.front();
+    w.lanes.pop_front();
+    queued_.fetch_sub(1);
+    return lane;
+}
+
+WorkPool::Lane *WorkPool::steal(size_t self)
+{
+    for (size_t k = 1; k < workers_.size(); k++) {
+        Worker &victim = *workers_[(self + k) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.lanes.empty()) continue;
+        Lane *lane = victim.lanes.back();
+        victim.lanes.pop_back();
+        queued_.fetch_sub(1);
+        workers_[self]->steals.fetch_add(1, std::memory_order_relaxed);
+        return lane;
+    }
+    return nullptr;
+}
+
+void WorkPool::run(size_t self, int priority, const std::vector<int> &cpus)
+{
+    current_pool = this;
+    current_worker = self;
+    if (priority > 0 || !cpus.empty()) {
+        int error = set_thread_realtime(priority, cpus);
+        if (error) thread_error_.store(error, std::memory_order_relaxed);
+    }
+    Worker &me = *workers_[self];
+    for (;;) {
+        Lane *lane = take(self);
+        if (lane == nullptr) lane = steal(self);
+        if (lane != nullptr) {
+            int64_t start = now_ns();
+            bool more = lane->run(kBudget);
+            me.busy_ns.fetch_add(uint64_t(now_ns() - start), std::memory_order_relaxed);
+            me.turns.fetch_add(1, std::memory_order_relaxed);
+            if (more) schedule(lane);  // behind this worker's other lanes, or stolen meanwhile
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        if (stopping_) return;
+        sleepers_.fetch_add(1);
+        if (queued_.load() == 0) wake_.wait(lock);
+        sleepers_.fetch_sub(1);
+    }
+}
+
+} // namespace td_can_bridge
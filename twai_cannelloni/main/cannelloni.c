@@ -0,0 +1,66 @@
+#include <string.h>
+#include "cannelloni.h"
+
+void cannelloni_begin(struct cannelloni_packer *p, uint8_t *buf, size_t cap)
+{
+    p->buf = buf;
+    p->cap = cap;
+    p->len = CANNELLONI_HEADER_SIZE;
+    p->count = 0;
+}
+
+bool cannelloni_add(struct cannelloni_packer *p, uint32_t can_id, uint8_t dlc, const uint8_t *data)
+{
+    bool rtr = can_id & CANNELLONI_FLAG_RTR;
+    size_t n = rtr ? 0 : dlc;
+    if (p->len + 5 + n > p->cap) return false;
+
+    uint8_t *b = p->buf + p->len;
+    b[0] = (uint8_t)(can_id >> 24);
+    b[1] = (uint8_t)(can_id >> 16);
+    b[2] = (uint8_t)(can_id >> 8);
+    b[3] = (uint8_t)can_id;
+    b[4] = dlc;
+    memcpy(b + 5, data, n);
+    p->len += 5 + n;
+    p->count++;
+    return true;
+}
+
+size_t cannelloni_finish(struct cannelloni_packer *p, uint8_t seq)
+{
+    p->buf[0] = CANNELLONI_VERSION;
+    p->buf[1] = CANNELLONI_OP_DATA;
+    p->buf[2] = seq;
+    p->buf[3] = (uint8_t)(p->count >> 8);
+    p->buf[4] = (uint8_t)p->count;
+    return p->len;
+}
+
+int cannelloni_parse(const uint8_t *buf, size_t len, cannelloni_frame_fn fn, void *ctx)
+{
+    if (len < CANNELLONI_HEADER_SIZE || buf[0] != CANNELLONI_VERSION || buf[1] != CANNELLONI_OP_DATA) return -1;
+    uint16_t count = (uint16_t)(buf[3] << 8 | buf[4]);
+    size_t pos = CANNELLONI_HEADER_SIZE;
+
+    for (uint16_t i = 0; i < count; i++) {
+        if (pos + 5 > len) return -1;
+        uint32_t can_id = (uint32_t)buf[pos] << 24 | (uint32_t)buf[pos + 1] << 16 | (uint32_t)buf[pos + 2] << 8 |
+                          buf[pos + 3];
+        uint8_t n = buf[pos + 4];
+        bool fd = n & CANNELLONI_FD_FRAME;
+        pos += 5;
+        if (fd) {
+            n &= (uint8_t)~CANNELLONI_FD_FRAME;
+            pos++; // FD flags (BRS, ESI)
+            if (n > 64) return -1;
+        } else if (n > 8) {
+            return -1;
+        }
+        size_t data_len = (can_id & CANNELLONI_FLAG_RTR) ? 0 : n;
+        if (pos + data_len > len) return -1;
+        fn(can_id, n, buf + pos, fd, ctx);
+        pos += data_len;
+    }
+    return count;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// cannelloni's UDP format (version 2), so a Linux host can bridge the bus onto a vcan with
+//   cannelloni -I vcan0 -R <board IP> -r 20000 -l 20000
+// A datagram is a 5-byte header (version, op code, sequence number, frame count as big-endian
+// u16) and then the frames back to back: can_id as big-endian u32 with SocketCAN flags, a
+// length byte (bit 7 set for CAN FD, followed by an FD flags byte) and the data. RTR frames
+// carry no data.
+
+#define CANNELLONI_VERSION      2
+#define CANNELLONI_OP_DATA      0
+#define CANNELLONI_HEADER_SIZE  5
+#define CANNELLONI_FD_FRAME     0x80
+#define CANNELLONI_FLAG_EXT     0x80000000u
+#define CANNELLONI_FLAG_RTR     0x40000000u
+#define CANNELLONI_FLAG_ERR     0x20000000u
+
+// Fits an Ethernet MTU after the IP and UDP headers, so a datagram is never fragmented
+#define CANNELLONI_DATAGRAM_MAX 1472
+
+struct cannelloni_packer {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    uint16_t count;
+};
+
+void cannelloni_begin(struct cannelloni_packer *p, uint8_t *buf, size_t cap);
+
+// Appends a classic frame; false if it doesn't fit, and the packet is unchanged
+bool cannelloni_add(struct cannelloni_packer *p, uint32_t can_id, uint8_t dlc, const uint8_t *data);
+
+// Writes the header and returns the datagram length; begin again for the next one
+size_t cannelloni_finish(struct cannelloni_packer *p, uint8_t seq);
+
+// Calls fn for every frame of a received data datagram. Returns the frame count, or -1 if the
+// datagram is not version-2 data or is cut short (frames before the cut have been delivered).
+typedef void (*cannelloni_frame_fn)(uint32_t can_id, uint8_t len, const uint8_t *data, bool fd, void *ctx);
+int cannelloni_parse(const uint8_t *buf, size_t len, cannelloni_frame_fn fn, void *ctx);
@@ -0,0 +1,222 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "nvs_flash.h"
+#include "lwip/sockets.h"
+#include "sdkconfig.h"
+#include "triton_twai.h"
+#include "cannelloni.h"
+
+static const char *TAG = "CANNELLONI";
+
+// Bridges the bus to a Linux vcan over Wi-Fi with cannelloni (cannelloni.h). Received frames are
+// batched into datagrams by a triton_twai sink; datagrams from the host are unpacked and queued
+// for the bus by udp_rx_task. Pins and bitrate: the "Triton TWAI" menu.
+
+#define REPORT_PERIOD_MS 5000
+#define TX_TIMEOUT_MS    5    // per frame from the host when the TX ring is full
+#define WIFI_CONNECTED   BIT0
+
+_Static_assert(CANNELLONI_FLAG_EXT == TRITON_TWAI_FLAG_EXT && CANNELLONI_FLAG_RTR == TRITON_TWAI_FLAG_RTR,
+               "cannelloni and driver ID flags differ");
+
+static EventGroupHandle_t wifi_events;
+static int sock = -1;
+static struct sockaddr_in remote;
+static bool have_remote;    // set once, by whichever of Kconfig or udp_rx_task gives the address
+
+// In the triton_twai RX task only
+static uint8_t tx_buf[CANNELLONI_DATAGRAM_MAX];
+static struct cannelloni_packer packer;
+static int64_t batch_start_us;
+static uint8_t seq;
+
+struct bridge_stats {
+    uint32_t datagrams_out, frames_out, send_errors, no_host;
+    uint32_t datagrams_in, frames_in, bad_datagrams, tx_dropped, fd_dropped;
+};
+
+static struct bridge_stats stats;
+
+// ---- Wi-Fi --------------------------------------------------------------------
+
+static void wifi_event(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    if (base == WIFI_EVENT && id == WIFI_EVENT_STA_START) {
+        esp_wifi_connect();
+    } else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED) {
+        xEventGroupClearBits(wifi_events, WIFI_CONNECTED);
+        ESP_LOGW(TAG, "Wi-Fi disconnected, reconnecting");
+        esp_wifi_connect();
+    } else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+        const ip_event_got_ip_t *ev = data;
+        ESP_LOGI(TAG, "Got IP " IPSTR, IP2STR(&ev->ip_info.ip));
+        xEventGroupSetBits(wifi_events, WIFI_CONNECTED);
+    }
+}
+
+static void wifi_init_sta(void)
+{
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
+
+    wifi_events = xEventGroupCreate();
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    esp_netif_create_default_wifi_sta();
+
+    wifi_init_config_t init = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&init));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_event, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, wifi_event, NULL));
+
+    wifi_config_t config = { 0 };
+    strlcpy((char *)config.sta.ssid, CONFIG_CANNELLONI_WIFI_SSID, sizeof(config.sta.ssid));
+    strlcpy((char *)config.sta.password, CONFIG_CANNELLONI_WIFI_PASSWORD, sizeof(config.sta.password));
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &config));
+    ESP_ERROR_CHECK(esp_wifi_start());
+    // Modem sleep holds datagrams for up to a beacon interval; latency matters more here
+    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE));
+
+    ESP_LOGI(TAG, "Connecting to \"%s\"", CONFIG_CANNELLONI_WIFI_SSID);
+    xEventGroupWaitBits(wifi_events, WIFI_CONNECTED, pdFALSE, pdTRUE, portMAX_DELAY);
+}
+
+// ---- Bus -> host ----------------------------------------------------------------
+
+static void batch_send(void)
+{
+    if (packer.count == 0) return;
+    size_t len = cannelloni_finish(&packer, seq++);
+    if (!__atomic_load_n(&have_remote, __ATOMIC_ACQUIRE)) {
+        stats.no_host++;
+    } else if (sendto(sock, tx_buf, len, 0, (const struct sockaddr *)&remote, sizeof(remote)) < 0) {
+        stats.send_errors++; // ENOMEM while the Wi-Fi TX buffers are full: the batch is lost, not retried
+    } else {
+        stats.datagrams_out++;
+        stats.frames_out += packer.count;
+    }
+    cannelloni_begin(&packer, tx_buf, sizeof(tx_buf));
+}
+
+static void batch_frame(const triton_twai_frame_t *f, void *ctx)
+{
+    if (!cannelloni_add(&packer, f->id, f->dlc, f->data)) {
+        batch_send();
+        cannelloni_add(&packer, f->id, f->dlc, f->data);
+    }
+    if (packer.count == 1) batch_start_us = f->time_us;
+    if (packer.count >= CONFIG_CANNELLONI_BATCH_FRAMES) batch_send();
+}
+
+static void batch_tick(int64_t now, void *ctx)
+{
+    if (packer.count && now - batch_start_us >= CONFIG_CANNELLONI_FLUSH_MS * 1000LL) batch_send();
+}
+
+// ---- Host -> bus ----------------------------------------------------------------
+
+static void host_frame(uint32_t can_id, uint8_t len, const uint8_t *data, bool fd, void *ctx)
+{
+    if (fd) {
+        stats.fd_dropped++; // the on-chip controller is classic CAN only
+        return;
+    }
+    if (can_id & CANNELLONI_FLAG_ERR) return;
+    if (triton_twai_transmit(can_id, len, data, pdMS_TO_TICKS(TX_TIMEOUT_MS)) != ESP_OK) stats.tx_dropped++;
+}
+
+static void udp_rx_task(void *arg)
+{
+    static uint8_t buf[CANNELLONI_DATAGRAM_MAX];
+    (void)arg;
+    while (true) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int n = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+        if (n < 0) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        if (!__atomic_load_n(&have_remote, __ATOMIC_ACQUIRE)) {
+            remote = from;
+            remote.sin_port = htons(CONFIG_CANNELLONI_REMOTE_PORT);
+            __atomic_store_n(&have_remote, true, __ATOMIC_RELEASE);
+            ESP_LOGI(TAG, "Sending to %s:%d", inet_ntoa(from.sin_addr), CONFIG_CANNELLONI_REMOTE_PORT);
+        }
+        stats.datagrams_in++;
+        int frames = cannelloni_parse(buf, (size_t)n, host_frame, NULL);
+        if (frames < 0) {
+            stats.bad_datagrams++;
+        } else {
+            stats.frames_in += (uint32_t)frames;
+        }
+    }
+}
+
+static void udp_init(void)
+{
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
+        abort();
+    }
+    struct sockaddr_in local = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_CANNELLONI_LOCAL_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(sock, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        ESP_LOGE(TAG, "Failed to bind UDP port %d: errno %d", CONFIG_CANNELLONI_LOCAL_PORT, errno);
+        abort();
+    }
+    if (strlen(CONFIG_CANNELLONI_REMOTE_IP) > 0) {
+        remote.sin_family = AF_INET;
+        remote.sin_port = htons(CONFIG_CANNELLONI_REMOTE_PORT);
+        if (inet_pton(AF_INET, CONFIG_CANNELLONI_REMOTE_IP, &remote.sin_addr) != 1) {
+            ESP_LOGE(TAG, "Bad host IP \"%s\"", CONFIG_CANNELLONI_REMOTE_IP);
+            abort();
+        }
+        have_remote = true;
+    }
+    ESP_LOGI(TAG, "UDP port %d, host %s", CONFIG_CANNELLONI_LOCAL_PORT,
+             have_remote ? CONFIG_CANNELLONI_REMOTE_IP : "from the first datagram");
+}
+
+void app_main(void)
+{
+    wifi_init_sta();
+    udp_init();
+
+    cannelloni_begin(&packer, tx_buf, sizeof(tx_buf));
+    ESP_ERROR_CHECK(triton_twai_add_sink(&(triton_twai_sink_t){ .on_frame = batch_frame, .on_tick = batch_tick }));
+    triton_twai_config_t config = TRITON_TWAI_CONFIG_DEFAULT();
+    if (triton_twai_start(&config) != ESP_OK) {
+        abort();
+    }
+    xTaskCreate(udp_rx_task, "udp_rx", 4096, NULL, 9, NULL);
+
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(REPORT_PERIOD_MS));
+        struct bridge_stats s = stats;
+        triton_twai_stats_t bus;
+        triton_twai_get_stats(&bus);
+        ESP_LOGI(TAG, "to host: %lu frames in %lu datagrams, %lu send errors, %lu without host, %lu ring overruns",
+                 (unsigned long)s.frames_out, (unsigned long)s.datagrams_out, (unsigned long)s.send_errors,
+                 (unsigned long)s.no_host, (unsigned long)bus.rx_overruns);
+        ESP_LOGI(TAG, "from host: %lu frames in %lu datagrams, %lu bad, %lu TX full, %lu FD dropped",
+                 (unsigned long)s.frames_in, (unsigned long)s.datagrams_in, (unsigned long)s.bad_datagrams,
+                 (unsigned long)s.tx_dropped, (unsigned long)s.fd_dropped);
+    }
+}
@@ -1,194 +1,374 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "driver/twai.h"
+#include "triton_twai.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "robostride.h"
+#if CONFIG_TWAI_PLAYBACK
+#include "traj.h"
+#endif
 
 static const char *TAG = "RS02_BASIC";
 
-// ----- RS02 limits from manual (private protocol, operation-control mode) -----
-#define P_MIN   -12.57f   // rad  (approx -4π)
-#define P_MAX    12.57f   // rad  (approx 4π)
-#define V_MIN   -44.0f    // rad/s
-#define V_MAX    44.0f    // rad/s
-#define KP_MIN    0.0f
-#define KP_MAX  500.0f
-#define KD_MIN    0.0f
-#define KD_MAX    5.0f
-#define T_MIN   -17.0f    // N·m
-#define T_MAX    17.0f
-
-// Default IDs for a fresh RS02 (motor CAN_ID = 1, host/master CAN_ID = 1)
-#define RS02_MOTOR_ID   1
-#define RS02_MASTER_ID  1
-
-// ---- Helpers -----------------------------------------------------------------
-
-static int float_to_uint(float x, float x_min, float x_max, int bits)
+// Per-model limits and scales come from the robostride component
+// (generated from docs/device_can/robostride/*/metadata.yaml).
+static const rs_limits_t RS_LIMITS[RS_MODEL_COUNT] = RS_MODEL_LIMITS;
+
+#define MASTER_ID CONFIG_TWAI_MASTER_ID
+
+// ----- Scheduler --------------------------------------------------------------
+// A 1 kHz esp_timer tick. Each motor is commanded once every CMD_PERIOD_TICKS
+// ticks, in its own tick of the period, so its type-2 reply has the bus to
+// itself instead of racing the other motors in arbitration.
+#define MAX_MOTORS        16
+#define TICK_US           1000
+#define CMD_PERIOD_TICKS  CONFIG_TWAI_CMD_PERIOD_MS
+#define REPORT_PERIOD_MS  1000
+#define FEEDBACK_SUMMARY  CONFIG_TWAI_FEEDBACK_SUMMARY
+
+// The motors on the bus, from the "Motors" menu. Kconfig defines all
+// MAX_MOTORS entries; the first MOTOR_COUNT are used.
+#define MOTOR_COUNT CONFIG_TWAI_MOTOR_COUNT
+#define MOTOR_ROW(n) \
+    { CONFIG_TWAI_MOTOR##n##_ID, &RS_LIMITS[RS_MODEL_RS02 + CONFIG_TWAI_MOTOR##n##_MODEL - 2] }
+
+static const struct {
+    uint8_t id;
+    const rs_limits_t *lim;
+} MOTOR_TABLE[MAX_MOTORS] = {
+    MOTOR_ROW(1),  MOTOR_ROW(2),  MOTOR_ROW(3),  MOTOR_ROW(4),
+    MOTOR_ROW(5),  MOTOR_ROW(6),  MOTOR_ROW(7),  MOTOR_ROW(8),
+    MOTOR_ROW(9),  MOTOR_ROW(10), MOTOR_ROW(11), MOTOR_ROW(12),
+    MOTOR_ROW(13), MOTOR_ROW(14), MOTOR_ROW(15), MOTOR_ROW(16),
+};
+
+_Static_assert(MOTOR_COUNT <= MAX_MOTORS, "too many motors");
+_Static_assert(MOTOR_COUNT <= CMD_PERIOD_TICKS, "each motor needs its own tick in the period");
+
+// Cycle timing per motor, written by the scheduler only
+struct motor {
+    int64_t last_us;
+    uint32_t cycles;
+    uint64_t jitter_sum_us;     // sum of |cycle time - period|
+    uint32_t jitter_max_us;     // since the last report
+    uint32_t tx_fail;
+};
+
+static struct motor motors[MOTOR_COUNT];
+
+// The batch the scheduler packs once per period: motor i is motor_ids[i] with
+// motor_lims[i], commanded with setpoints[i] (written before the scheduler starts)
+static uint8_t motor_ids[MOTOR_COUNT];
+static const rs_limits_t *motor_lims[MOTOR_COUNT];
+#if !CONFIG_TWAI_PLAYBACK
+static rs_command_t setpoints[MOTOR_COUNT];
+#endif
+static rs_frame_t frames[MOTOR_COUNT];
+static const rs_frame_t *cycle_frames = frames;  // the frames sent this period
+static int8_t slot_motor[CMD_PERIOD_TICKS];  // tick in the period -> motor, or -1
+static uint32_t sched_ticks;
+
+#if CONFIG_TWAI_PLAYBACK
+// Playback: each period sends the next row of the mapped table instead of packing setpoints
+static traj_t traj;
+static uint32_t traj_cycle;     // row sent next
+static uint32_t traj_passes;    // times the table played to its end
+#endif
+
+// ----- Feedback ---------------------------------------------------------------
+// Decoded type-2 feedback, one entry per motor. The feedback sink is the only writer;
+// readers take a consistent copy with motor_state_read() and never block it.
+struct motor_state {
+    float pos;          // rad
+    float vel;          // rad/s
+    float torque;       // N·m
+    float temp;         // °C
+    uint8_t fault;      // ID bits 16..21: under-voltage, over-current, over-temp, encoder, HALL, uncalibrated
+    uint8_t mode;       // ID bits 22..23: 0 reset, 1 calibration, 2 run
+    int64_t stamp_us;   // esp_timer time the frame was received
+    uint32_t frames;
+};
+
+// Seqlock: odd while an update is in progress
+struct motor_feedback {
+    uint32_t seq;
+    struct motor_state s;
+};
+
+static struct motor_feedback feedback[MOTOR_COUNT];
+static int8_t motor_index[256];     // motor CAN ID -> motor, or -1
+static uint32_t rx_other;           // frames that are not feedback from a known motor
+
+// ---- CAN / TWAI initialization ----------------------------------------------
+
+// TX = GPIO 20, RX = GPIO 21, 1 Mbit/s by default: the "Triton TWAI" menu. The RX ring
+// (CONFIG_TRITON_TWAI_RX_QUEUE_LEN) holds one reply per motor per period, plus room for the
+// logger to fall behind.
+static void can_init(void)
 {
-    float span = x_max - x_min;
-    float offset = x_min;
+    triton_twai_config_t config = TRITON_TWAI_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(triton_twai_start(&config));
+}
 
-    if (x > x_max) x = x_max;
-    else if (x < x_min) x = x_min;
+// ---- RS02 command helpers ----------------------------------------------------
 
-    return (int)((x - offset) * ((float)((1 << bits) - 1)) / span);
+/**
+ * Send communication type 3: "Motor enabled to run"
+ * (Data bytes are all zero.)
+ */
+static esp_err_t rs02_send_enable(uint8_t motor_id)
+{
+    static const uint8_t zeros[8] = {0};
+    uint32_t id = rs_build_ext_id(motor_id, MASTER_ID, RS_TYPE_ENABLE) | TRITON_TWAI_FLAG_EXT;
+
+    esp_err_t err = triton_twai_transmit(id, 8, zeros, pdMS_TO_TICKS(100));
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Sent ENABLE (type 3) to motor %u", motor_id);
+    } else {
+        ESP_LOGE(TAG, "Failed to send ENABLE to motor %u: %s", motor_id, esp_err_to_name(err));
+    }
+    return err;
 }
 
 /**
- * Build extended 29-bit identifier in the same layout as the GD32 example:
- *   bits  0..7   : motor CAN_ID
- *   bits  8..23  : master_id (host CAN_ID)
- *   bits 24..28  : communication type (mode)
- *   bits 29..31  : reserved (0)
+ * Communication type 1: operation control mode motor command, from a frame
+ * packed by rs_pack_op_control_batch(). The feed-forward torque rides in the
+ * ID "data" field (bits 8..23), as in the manual's reference code; P, V, Kp,
+ * Kd follow as 16-bit big-endian values.
  *
- * This matches the IDs you see like 0x3000101 for type=3, master=1, motor=1.
+ * Note: on a fresh motor, it's already in operation-control mode after power-on.
  */
-static uint32_t build_ext_id(uint8_t motor_id, uint16_t master_id, uint8_t type)
+static esp_err_t rs02_send_op_control(const rs_frame_t *f)
 {
-    uint32_t id = 0;
-    id |= (uint32_t)motor_id;
-    id |= ((uint32_t)master_id << 8);
-    id |= ((uint32_t)type << 24);
-    return id;
+    return triton_twai_transmit(f->id | TRITON_TWAI_FLAG_EXT, 8, f->data, 0);
 }
 
-// ---- CAN / TWAI initialization ----------------------------------------------
+// ---- Feedback -----------------------------------------------------------------
 
-static void can_init(void)
+static void motor_state_publish(struct motor_feedback *fb, const struct motor_state *s)
 {
-    // TX = GPIO 20, RX = GPIO 21, normal mode
-    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(
-            GPIO_NUM_20, GPIO_NUM_21, TWAI_MODE_NORMAL);
+    uint32_t seq = fb->seq;
+    __atomic_store_n(&fb->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    fb->s = *s;
+    __atomic_store_n(&fb->seq, seq + 2, __ATOMIC_RELEASE);
+}
 
-    // 1 Mbit/s timing (built-in macro)
-    twai_timing_config_t t_config = TWAI_TIMING_CONFIG_1MBITS();
+/**
+ * Copy motor idx's latest feedback. Lock-free: retries if the feedback sink
+ * published in the middle of the copy, which is rare at these rates.
+ */
+static void motor_state_read(size_t idx, struct motor_state *out)
+{
+    const struct motor_feedback *fb = &feedback[idx];
+    uint32_t seq;
+    do {
+        seq = __atomic_load_n(&fb->seq, __ATOMIC_ACQUIRE);
+        *out = fb->s;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&fb->seq, __ATOMIC_RELAXED));
+}
 
-    // Accept all frames
-    twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+/**
+ * Decode type-2 feedback into the motor's state entry. ID bits 8..15 carry
+ * the motor's CAN ID; rs_decode_feedback() scales the payload to the model's
+ * ranges. A triton_twai sink, so it runs in the driver's RX task.
+ */
+static void feedback_sink(const triton_twai_frame_t *f, void *ctx)
+{
+    (void)ctx;
+    uint32_t id = f->id & TRITON_TWAI_ID_MASK;
+    int8_t idx = motor_index[(id >> 8) & 0xFF];
+    if ((f->id & (TRITON_TWAI_FLAG_EXT | TRITON_TWAI_FLAG_RTR)) != TRITON_TWAI_FLAG_EXT ||
+        rs_ext_id_type(id) != RS_TYPE_FEEDBACK || f->dlc < 8 || idx < 0) {
+        rx_other++;
+        return;
+    }
 
-    ESP_ERROR_CHECK(twai_driver_install(&g_config, &t_config, &f_config));
-    ESP_ERROR_CHECK(twai_start());
-    ESP_LOGI(TAG, "TWAI (CAN) started at 1 Mbps on TX=20, RX=21");
+    rs_feedback_t d;
+    rs_decode_feedback(motor_lims[idx], id, f->data, &d);
+    struct motor_feedback *fb = &feedback[idx];
+    struct motor_state s = {
+        .pos = d.pos,
+        .vel = d.vel,
+        .torque = d.torque,
+        .temp = d.temp,
+        .fault = d.fault,
+        .mode = d.mode,
+        .stamp_us = f->time_us,
+        .frames = fb->s.frames + 1,
+    };
+    motor_state_publish(fb, &s);
 }
 
-// ---- RS02 command helpers ----------------------------------------------------
+// ---- Scheduler ---------------------------------------------------------------
 
 /**
- * Send communication type 3: "Motor enabled to run"
- * (Data bytes are all zero.)
+ * Timer callback, once per tick. The first tick of each period packs every
+ * motor's frame in one batch, or with playback moves on to the table's next
+ * row; motor 0 owns that tick, so its frame is ready in time. Then the motor that owns this tick, if any, gets its frame sent,
+ * and how far its cycle strayed from the period is recorded. Runs in the
+ * esp_timer task, so it must not block: a full TX queue is counted, not
+ * waited on.
  */
-static esp_err_t rs02_send_enable(void)
+static void sched_tick(void *arg)
 {
-    twai_message_t msg = {0};
-    msg.extd = 1;                      // extended frame
-    msg.rtr = 0;
-    msg.identifier = build_ext_id(RS02_MOTOR_ID, RS02_MASTER_ID, 3);
-    msg.data_length_code = 8;
-    memset(msg.data, 0, 8);
-
-    esp_err_t err = twai_transmit(&msg, pdMS_TO_TICKS(100));
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Sent ENABLE (type 3)");
-    } else {
-        ESP_LOGE(TAG, "Failed to send ENABLE: %s", esp_err_to_name(err));
+    (void)arg;
+    uint32_t phase = sched_ticks++ % CMD_PERIOD_TICKS;
+    if (phase == 0) {
+#if CONFIG_TWAI_PLAYBACK
+        cycle_frames = &traj.rows[(size_t)traj_cycle * MOTOR_COUNT];
+        if (++traj_cycle == traj.cycles) {
+            traj_passes++;
+            traj_cycle = traj.loop ? 0 : traj.cycles - 1;
+        }
+#else
+        rs_pack_op_control_batch(MOTOR_COUNT, motor_lims, motor_ids, setpoints, frames);
+#endif
     }
-    return err;
+    int8_t idx = slot_motor[phase];
+    if (idx < 0) {
+        return;
+    }
+
+    struct motor *m = &motors[idx];
+    int64_t now = esp_timer_get_time();
+    if (rs02_send_op_control(&cycle_frames[idx]) != ESP_OK) {
+        m->tx_fail++;
+    }
+
+    if (m->last_us) {
+        int64_t err = (now - m->last_us) - (int64_t)CMD_PERIOD_TICKS * TICK_US;
+        uint32_t jitter = (uint32_t)(err < 0 ? -err : err);
+        m->jitter_sum_us += jitter;
+        if (jitter > m->jitter_max_us) {
+            m->jitter_max_us = jitter;
+        }
+        m->cycles++;
+    }
+    m->last_us = now;
 }
 
 /**
- * Send communication type 1: operation control mode motor command
- *
- * Parameters:
- *   torque_ff : feed-forward torque (N·m)
- *   pos       : target position (rad)  – we keep this at 0.0
- *   vel       : target speed (rad/s)
- *   kp, kd    : gains
- *
- * Note: on a fresh motor, it's already in operation-control mode after power-on.
+ * Spread the motors evenly over the period: motor i owns tick
+ * i * CMD_PERIOD_TICKS / MOTOR_COUNT, so neighbouring slots are as far apart
+ * as the period allows.
  */
-static esp_err_t rs02_send_op_control(float torque_ff,
-                                      float pos,
-                                      float vel,
-                                      float kp,
-                                      float kd)
+static void sched_init(void)
 {
-    twai_message_t msg = {0};
-    msg.extd = 1;
-    msg.rtr = 0;
-    msg.identifier = build_ext_id(RS02_MOTOR_ID, RS02_MASTER_ID, 1);
-    msg.data_length_code = 8;
-
-    uint16_t pos_u = (uint16_t)float_to_uint(pos,   P_MIN,  P_MAX, 16);
-    uint16_t vel_u = (uint16_t)float_to_uint(vel,   V_MIN,  V_MAX, 16);
-    uint16_t kp_u  = (uint16_t)float_to_uint(kp,    KP_MIN, KP_MAX,16);
-    uint16_t kd_u  = (uint16_t)float_to_uint(kd,    KD_MIN, KD_MAX,16);
-
-    // Byte layout per the manual example: t_ff in ID "data" field, then P, V, Kp, Kd as 16-bit big-endian.
-    uint16_t torque_u = (uint16_t)float_to_uint(torque_ff, T_MIN, T_MAX, 16);
-
-    // However, in the reference code torque is carried in the ID "data" field:
-    // txCanIdEx.data = float_to_uint(torque, T_MIN, T_MAX, 16);
-    // For simplicity we just keep torque_ff small (0) and ignore it here.
-    (void)torque_u; // not used – keep compiler happy
-
-    msg.data[0] = (uint8_t)(pos_u >> 8);
-    msg.data[1] = (uint8_t)(pos_u & 0xFF);
-    msg.data[2] = (uint8_t)(vel_u >> 8);
-    msg.data[3] = (uint8_t)(vel_u & 0xFF);
-    msg.data[4] = (uint8_t)(kp_u  >> 8);
-    msg.data[5] = (uint8_t)(kp_u  & 0xFF);
-    msg.data[6] = (uint8_t)(kd_u  >> 8);
-    msg.data[7] = (uint8_t)(kd_u  & 0xFF);
-
-    esp_err_t err = twai_transmit(&msg, pdMS_TO_TICKS(100));
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send op-control cmd: %s", esp_err_to_name(err));
+    memset(slot_motor, -1, sizeof(slot_motor));
+    memset(motor_index, -1, sizeof(motor_index));
+    for (size_t i = 0; i < MOTOR_COUNT; i++) {
+        uint8_t id = MOTOR_TABLE[i].id;
+        if (motor_index[id] >= 0) {
+            ESP_LOGE(TAG, "Motors %d and %u both use CAN ID %u; check the Motors menu",
+                     motor_index[id] + 1, (unsigned)i + 1, id);
+            abort();
+        }
+        motor_ids[i] = id;
+        motor_lims[i] = MOTOR_TABLE[i].lim;
+        motor_index[id] = (int8_t)i;
+        slot_motor[i * CMD_PERIOD_TICKS / MOTOR_COUNT] = (int8_t)i;
     }
-    return err;
 }
 
-// Optional: simple RX logger (feedback / fault frames)
-static void can_rx_task(void *arg)
+static void sched_start(void)
 {
-    twai_message_t rx_msg;
-    while (1) {
-        if (twai_receive(&rx_msg, portMAX_DELAY) == ESP_OK) {
-            if (rx_msg.extd) {
-                printf("RX: ID=0x%08lx DLC=%d Data:", (unsigned long)rx_msg.identifier,
-                       rx_msg.data_length_code);
-            } else {
-                printf("RX: STD ID=0x%03lx DLC=%d Data:", (unsigned long)rx_msg.identifier,
-                       rx_msg.data_length_code);
-            }
-            for (int i = 0; i < rx_msg.data_length_code; i++) {
-                printf(" %02X", rx_msg.data[i]);
-            }
-            printf("\n");
+    const esp_timer_create_args_t args = {
+        .callback = sched_tick,
+        .name = "motor_sched",
+    };
+    esp_timer_handle_t timer;
+    ESP_ERROR_CHECK(esp_timer_create(&args, &timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(timer, TICK_US));
+    ESP_LOGI(TAG, "Scheduler: %u motor(s), %u Hz each, %u us tick",
+             (unsigned)MOTOR_COUNT, (unsigned)(1000000 / (CMD_PERIOD_TICKS * TICK_US)),
+             (unsigned)TICK_US);
+}
+
+/**
+ * Print each motor's cycle jitter over the last report period, and with
+ * FEEDBACK_SUMMARY its latest feedback. The counters
+ * are read without a lock; a cycle that lands during the read shows up in
+ * this report or the next.
+ */
+static void sched_report(void)
+{
+    static uint32_t last_cycles[MOTOR_COUNT];
+    static uint64_t last_sum[MOTOR_COUNT];
+
+    for (size_t i = 0; i < MOTOR_COUNT; i++) {
+        struct motor *m = &motors[i];
+        uint32_t cycles = m->cycles;
+        uint64_t sum = m->jitter_sum_us;
+        uint32_t max = m->jitter_max_us;
+        m->jitter_max_us = 0;
+
+        uint32_t n = cycles - last_cycles[i];
+        ESP_LOGI(TAG, "motor %u: %lu cycles, jitter avg %lu us max %lu us, %lu TX failures",
+                 motor_ids[i], (unsigned long)n,
+                 (unsigned long)(n ? (sum - last_sum[i]) / n : 0),
+                 (unsigned long)max, (unsigned long)m->tx_fail);
+        last_cycles[i] = cycles;
+        last_sum[i] = sum;
+
+#if FEEDBACK_SUMMARY
+        struct motor_state st;
+        motor_state_read(i, &st);
+        if (st.frames) {
+            ESP_LOGI(TAG, "motor %u: pos %.3f rad, vel %.3f rad/s, torque %.2f N·m, %.1f °C, "
+                     "fault 0x%02x, mode %u, %lu feedback frames, last %lld us ago",
+                     motor_ids[i], st.pos, st.vel, st.torque, st.temp, st.fault, st.mode,
+                     (unsigned long)st.frames, (long long)(esp_timer_get_time() - st.stamp_us));
+        } else {
+            ESP_LOGW(TAG, "motor %u: no feedback yet", motor_ids[i]);
         }
+#endif
     }
+#if FEEDBACK_SUMMARY
+    ESP_LOGI(TAG, "%lu other frames received", (unsigned long)rx_other);
+#endif
+#if CONFIG_TWAI_PLAYBACK
+    ESP_LOGI(TAG, "Playback: cycle %lu of %lu, %lu pass(es) done%s", (unsigned long)traj_cycle,
+             (unsigned long)traj.cycles, (unsigned long)traj_passes,
+             !traj.loop && traj_passes ? ", holding the last cycle" : "");
+#endif
 }
 
 // ---- app_main ---------------------------------------------------------------
 
 void app_main(void)
 {
+    // Motor table and ID lookup first: the feedback sink uses it from its first frame
+    sched_init();
+#if CONFIG_TWAI_PLAYBACK
+    // Before any motor is enabled: without a table that fits these motors, nothing moves
+    if (traj_open(MOTOR_COUNT, motor_ids, CMD_PERIOD_TICKS, &traj) != ESP_OK) {
+        return;
+    }
+#endif
+    ESP_ERROR_CHECK(triton_twai_add_sink(&(triton_twai_sink_t){ .on_frame = feedback_sink }));
     can_init();
 
-    // Optional: start RX logger
-    xTaskCreate(can_rx_task, "can_rx", 4096, NULL, 5, NULL);
-
     vTaskDelay(pdMS_TO_TICKS(500));  // small delay after power-up
 
-    // 1) Enable the motor (communication type 3)
-    rs02_send_enable();
+    // 1) Enable the motors (communication type 3)
+    for (size_t i = 0; i < MOTOR_COUNT; i++) {
+        rs02_send_enable(motor_ids[i]);
+    }
 
     vTaskDelay(pdMS_TO_TICKS(500));
 
+#if CONFIG_TWAI_PLAYBACK
+    ESP_LOGI(TAG, "Playing the trajectory table");
+#else
     ESP_LOGI(TAG, "Starting basic motion test");
 
-    // 2) Repeatedly send a small positive speed command.
+    // 2) Command a small positive speed on every motor.
     //
     //    Operation-control mode suggestion from manual:
     //      t_ff = 0
@@ -197,16 +377,21 @@ void app_main(void)
     //      Kp   = 0
     //      Kd   = 1
     //
-    //    This should make the motor spin slowly in one direction with light damping.
+    //    This should make the motors spin slowly in one direction with light damping.
+    for (size_t i = 0; i < MOTOR_COUNT; i++) {
+        setpoints[i] = (rs_command_t){
+            .torque = 0.0f,
+            .pos = 0.0f,
+            .vel = 1.0f,    // keep small
+            .kp = 0.0f,
+            .kd = 1.0f,
+        };
+    }
+#endif
+    sched_start();
+
     while (1) {
-        rs02_send_op_control(
-            0.0f,   // torque_ff
-            0.0f,   // position setpoint (rad)
-            1.0f,   // velocity setpoint (rad/s) – keep small
-            0.0f,   // Kp
-            1.0f    // Kd
-        );
-
-        vTaskDelay(pdMS_TO_TICKS(20));  // 50 Hz command rate is plenty for a simple test
+        vTaskDelay(pdMS_TO_TICKS(REPORT_PERIOD_MS));
+        sched_report();
     }
 }
@@ -0,0 +1,56 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "traj.h"
+
+static const char *TAG = "TRAJ";
+
+esp_err_t traj_open(size_t motors, const uint8_t ids[], uint32_t period_ms, traj_t *out)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "traj");
+    if (part == NULL) {
+        ESP_LOGE(TAG, "No \"traj\" partition; flash with partitions.csv");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Mapped once and never unmapped: the scheduler reads the rows for as long as it runs
+    const void *map;
+    esp_partition_mmap_handle_t handle;
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &map, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Mapping \"traj\" failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    const struct traj_header *h = map;
+    if (h->magic != TRAJ_MAGIC || h->version != TRAJ_VERSION) {
+        ESP_LOGE(TAG, "No trajectory table in \"traj\"; write one from tools/traj_compile.py");
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (h->motors != motors || memcmp(h->ids, ids, motors) != 0) {
+        ESP_LOGE(TAG, "The table was packed for %u other motor(s); check the Motors menu", h->motors);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (h->period_ms != period_ms) {
+        ESP_LOGE(TAG, "The table has a %u ms period, the scheduler %lu ms", h->period_ms,
+                 (unsigned long)period_ms);
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t size = (size_t)h->cycles * motors * sizeof(rs_frame_t);
+    if (h->cycles == 0 || size > part->size - sizeof(*h)) {
+        ESP_LOGE(TAG, "The table's %lu cycles do not fit the partition", (unsigned long)h->cycles);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const rs_frame_t *rows = (const rs_frame_t *)(h + 1);
+    if (esp_rom_crc32_le(0, (const uint8_t *)rows, size) != h->crc) {
+        ESP_LOGE(TAG, "The table's CRC does not match; write it again");
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    *out = (traj_t){ .rows = rows, .cycles = h->cycles, .loop = h->flags & TRAJ_FLAG_LOOP };
+    ESP_LOGI(TAG, "%lu cycles (%lu.%02lu s)%s", (unsigned long)h->cycles,
+             (unsigned long)(h->cycles * period_ms / 1000), (unsigned long)(h->cycles * period_ms % 1000 / 10),
+             out->loop ? ", looping" : "");
+    return ESP_OK;
+}
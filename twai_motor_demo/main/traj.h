@@ -0,0 +1,53 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "robostride.h"
+
+/**
+ * Pre-packed trajectory table for playback. tools/traj_compile.py packs every
+ * cycle's type-1 frames on the host and the table is written to the "traj"
+ * flash partition, which the demo maps into its address space. The scheduler
+ * then sends each row as it is, so a cycle costs no packing and a motion
+ * replays identically on every run.
+ *
+ * Layout, all fields little-endian:
+ *   header: magic u32, version u16, motors u16, period_ms u16, flags u16,
+ *           cycles u32, crc u32, ids u8[16]
+ *   rows:   cycles * motors rs_frame_t (id u32, data[8]), one cycle after
+ *           another, motors in header order
+ *
+ * ids are the motor CAN IDs the frames were packed for, and must match the
+ * Motors menu. period_ms must match TWAI_CMD_PERIOD_MS. crc is the CRC-32
+ * (zlib) of the rows. With TRAJ_FLAG_LOOP the table restarts after its last
+ * cycle; otherwise the last cycle is repeated, so the motors hold its setpoint.
+ */
+
+#define TRAJ_MAGIC      0x4A415254 // "TRAJ"
+#define TRAJ_VERSION    1
+#define TRAJ_FLAG_LOOP  (1u << 0)
+#define TRAJ_MAX_MOTORS 16
+
+struct traj_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t motors;
+    uint16_t period_ms;
+    uint16_t flags;
+    uint32_t cycles;
+    uint32_t crc;
+    uint8_t ids[TRAJ_MAX_MOTORS];
+};
+
+_Static_assert(sizeof(struct traj_header) == 36, "traj_compile.py writes a 36-byte header");
+_Static_assert(sizeof(rs_frame_t) == 12, "traj_compile.py writes 12-byte rows");
+
+typedef struct {
+    const rs_frame_t *rows;  // in mapped flash
+    uint32_t cycles;
+    bool loop;
+} traj_t;
+
+// Maps the "traj" partition and checks its header and CRC against the motors and period
+esp_err_t traj_open(size_t motors, const uint8_t ids[], uint32_t period_ms, traj_t *out);
@@ -0,0 +1,104 @@
+import argparse
+import csv
+import math
+import os
+import struct
+import sys
+import zlib
+
+# Compiles a motion into the trajectory table the demo plays with TWAI_PLAYBACK (main/traj.h):
+# every cycle's type-1 frames packed here, with the firmware's own codec (nativeCAN/robostride.py),
+# so the chip only copies them onto the bus. Write the result with
+#   parttool.py --port PORT write_partition --partition-name traj --input traj.bin
+# The motors and period must be the ones in menuconfig, in the order of the Motors menu.
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'nativeCAN'))
+import robostride
+
+MAGIC = 0x4A415254
+VERSION = 1
+FLAG_LOOP = 1
+MAX_MOTORS = 16
+HEADER = struct.Struct('<IHHHHII16s')
+ROW = struct.Struct('<I8s')
+PARTITION_SIZE = 0x190000  # partitions.csv
+
+def parse_motor(text):
+    """'1:RS02' -> (1, 'RS02')."""
+    ident, _, model = text.partition(':')
+    model = (model or 'RS02').upper()
+    if model not in robostride.MODELS:
+        raise argparse.ArgumentTypeError(f"unknown model '{model}', expected one of {', '.join(robostride.MODELS)}")
+    return int(ident, 0), model
+
+def swing(args, n):
+    """swing_test.py's motion on every motor: a sine of --amp degrees at --freq Hz, with its
+    derivative as feed-forward velocity."""
+    amp, w = math.radians(args.amp), 2 * math.pi * args.freq
+    cycles = round(args.seconds * 1000 / args.period_ms)
+    for c in range(cycles):
+        t = c * args.period_ms / 1000
+        cmd = (amp * math.sin(w * t), amp * w * math.cos(w * t), 0.0, args.kp, args.kd)
+        yield [cmd] * n
+
+def from_csv(args, n):
+    """One row per cycle: pos, vel, torque, kp, kd for each motor in turn. A header row and
+    '#' comments are skipped."""
+    with open(args.file, newline='') as f:
+        for line, row in enumerate(csv.reader(f), 1):
+            if not row or row[0].lstrip().startswith('#'):
+                continue
+            try:
+                values = [float(v) for v in row]
+            except ValueError:
+                if line == 1:
+                    continue
+                raise SystemExit(f"{args.file}:{line}: not a number")
+            if len(values) != 5 * n:
+                raise SystemExit(f"{args.file}:{line}: {len(values)} values, expected {5 * n} for {n} motor(s)")
+            yield [tuple(values[5 * i:5 * i + 5]) for i in range(n)]
+
+def compile_table(motors, period_ms, cycles, loop):
+    """The partition image: header and rows."""
+    ids = [m for m, _ in motors]
+    lims = [robostride.limits(model) for _, model in motors]
+    rows = bytearray()
+    count = 0
+    for cmds in cycles:
+        for can_id, data in robostride.pack_op_control_batch(lims, ids, cmds):
+            rows += ROW.pack(can_id, data)
+        count += 1
+    if not count:
+        raise SystemExit("the motion has no cycles")
+    header = HEADER.pack(MAGIC, VERSION, len(motors), period_ms, FLAG_LOOP if loop else 0, count,
+                         zlib.crc32(rows), bytes(ids))
+    return header + rows, count
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Compile a motion into a trajectory table")
+    parser.add_argument('-m', '--motor', type=parse_motor, action='append', required=True, metavar='ID[:MODEL]',
+                        help="a motor, in Motors menu order; repeat for each (model RS02 by default)")
+    parser.add_argument('--period-ms', type=int, default=10, help="TWAI_CMD_PERIOD_MS (default 10)")
+    parser.add_argument('--loop', action='store_true', help="restart after the last cycle instead of holding it")
+    parser.add_argument('-o', '--output', default='traj.bin')
+    sub = parser.add_subparsers(dest='motion', required=True)
+    p = sub.add_parser('swing', help="a sine swing, as MotorTest/swing_test.py")
+    p.add_argument('--amp', type=float, default=90.0, help="amplitude in degrees")
+    p.add_argument('--freq', type=float, default=0.5, help="Hz")
+    p.add_argument('--seconds', type=float, default=2.0, help="length; whole periods make a smooth loop")
+    p.add_argument('--kp', type=float, default=40.0)
+    p.add_argument('--kd', type=float, default=1.5)
+    p = sub.add_parser('csv', help="setpoints from a CSV file, one row per cycle")
+    p.add_argument('file')
+    args = parser.parse_args()
+
+    if len(args.motor) > MAX_MOTORS:
+        sys.exit(f"at most {MAX_MOTORS} motors")
+    n = len(args.motor)
+    cycles = swing(args, n) if args.motion == 'swing' else from_csv(args, n)
+    image, count = compile_table(args.motor, args.period_ms, cycles, args.loop)
+    if len(image) > PARTITION_SIZE:
+        sys.exit(f"{len(image)} bytes do not fit the {PARTITION_SIZE}-byte traj partition")
+    with open(args.output, 'wb') as f:
+        f.write(image)
+    print(f"{count} cycles ({count * args.period_ms / 1000:g} s) for {n} motor(s), {len(image)} bytes -> {args.output}")
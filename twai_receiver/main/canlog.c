@@ -0,0 +1,191 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "canlog.h"
+
+static const char *TAG = "CANLOG";
+
+#define RING_BLOCKS   (CONFIG_TWAI_LOG_RING_KB * 1024 / CANLOG_BLOCK_SIZE)
+#define ERASE_SIZE    65536   // erased a 64 KB block at a time: much faster per byte than sectors
+#define HDR_SIZE      20
+#define REC_HDR_SIZE  9
+
+_Static_assert(RING_BLOCKS >= 4, "the RAM ring needs a few blocks to ride out an erase");
+
+/**
+ * One RAM block. The RX task appends records and publishes fill; once it
+ * moves on to the next block it sets closed, and fill is final. Only the RX
+ * task resets a block, when it reopens it after the writer has moved tail
+ * past it.
+ */
+struct ram_block {
+    uint8_t *buf;
+    uint32_t fill;
+    bool closed;
+};
+
+static struct ram_block ring[RING_BLOCKS];
+static uint32_t head;       // block the RX task fills; free-running, written by the RX task
+static uint32_t tail;       // oldest block not yet in flash; free-running, written by the writer
+static uint32_t seq_base;   // seq of ring block 0
+static const esp_partition_t *part;
+static uint32_t part_sectors;
+static uint32_t first_sector;
+static TaskHandle_t writer_task;
+static struct canlog_stats stats;
+
+static void block_open(struct ram_block *b, int64_t now)
+{
+    uint32_t hdr[5] = { CANLOG_MAGIC, seq_base + head, (uint32_t)now, (uint32_t)((uint64_t)now >> 32),
+                        stats.dropped };
+    memcpy(b->buf, hdr, HDR_SIZE);
+    b->closed = false;
+    __atomic_store_n(&b->fill, HDR_SIZE, __ATOMIC_RELEASE);
+}
+
+void canlog_add(uint32_t can_id, uint8_t dlc, const uint8_t *data, int64_t time_us)
+{
+    struct ram_block *b = &ring[head % RING_BLOCKS];
+    uint32_t fill = b->fill;
+    if (b->closed || fill + REC_HDR_SIZE + dlc > CANLOG_BLOCK_SIZE) {
+        if (!b->closed) {
+            __atomic_store_n(&b->closed, true, __ATOMIC_RELEASE);
+            xTaskNotifyGive(writer_task);
+        }
+        uint32_t waiting = head + 1 - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+        if (waiting >= RING_BLOCKS) {
+            stats.dropped++; // the writer is behind; the closed block stays until it catches up
+            return;
+        }
+        if (waiting > stats.ring_hwm) stats.ring_hwm = waiting;
+        __atomic_store_n(&head, head + 1, __ATOMIC_RELEASE);
+        b = &ring[head % RING_BLOCKS];
+        block_open(b, time_us);
+        fill = HDR_SIZE;
+    }
+
+    uint8_t *p = b->buf + fill;
+    uint32_t ts = (uint32_t)time_us;
+    p[0] = dlc;
+    memcpy(p + 1, &ts, 4);
+    memcpy(p + 5, &can_id, 4);
+    memcpy(p + REC_HDR_SIZE, data, dlc);
+    __atomic_store_n(&b->fill, fill + REC_HDR_SIZE + dlc, __ATOMIC_RELEASE);
+    stats.frames++;
+}
+
+/**
+ * Copies RAM blocks into the partition, oldest first. A closed block is
+ * written out as soon as the RX task signals it; the block being filled is
+ * written up to its current fill only when the wait times out, so a quiet
+ * bus still reaches flash within CONFIG_TWAI_LOG_FLUSH_MS while a busy one
+ * is written in whole sectors. Appending to a partly written sector is fine
+ * on NOR flash as long as the bytes are still erased.
+ */
+static void canlog_writer_task(void *arg)
+{
+    (void)arg;
+    uint32_t sector = first_sector;
+    uint32_t flushed = 0; // bytes of ring[tail] already in flash
+
+    while (true) {
+        bool timed_out = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_TWAI_LOG_FLUSH_MS)) == 0;
+        while (true) {
+            struct ram_block *b = &ring[tail % RING_BLOCKS];
+            bool closed = __atomic_load_n(&b->closed, __ATOMIC_ACQUIRE);
+            uint32_t fill = __atomic_load_n(&b->fill, __ATOMIC_ACQUIRE);
+            if (!closed && !timed_out) break;
+
+            size_t offset = (size_t)(sector % part_sectors) * CANLOG_BLOCK_SIZE;
+            if (fill > flushed) {
+                esp_err_t err = ESP_OK;
+                if (flushed == 0 && offset % ERASE_SIZE == 0) {
+                    err = esp_partition_erase_range(part, offset, ERASE_SIZE);
+                }
+                if (err == ESP_OK) {
+                    err = esp_partition_write(part, offset + flushed, b->buf + flushed, fill - flushed);
+                }
+                if (err != ESP_OK) {
+                    stats.flash_errors++;
+                    ESP_LOGE(TAG, "Flash write at 0x%x failed: %s", (unsigned)offset, esp_err_to_name(err));
+                }
+                flushed = fill;
+            }
+            if (!closed) break;
+
+            __atomic_store_n(&tail, tail + 1, __ATOMIC_RELEASE);
+            flushed = 0;
+            sector++;
+            stats.blocks++;
+        }
+    }
+}
+
+/**
+ * Resumes after the newest block in the partition, on the next 64 KB
+ * boundary so the writer erases before it writes. An empty or foreign
+ * partition starts at sector 0 with seq 0.
+ */
+static void canlog_find_start(void)
+{
+    bool found = false;
+    uint32_t newest_seq = 0, newest_sector = 0;
+    for (uint32_t s = 0; s < part_sectors; s++) {
+        uint32_t hdr[2];
+        if (esp_partition_read(part, (size_t)s * CANLOG_BLOCK_SIZE, hdr, sizeof(hdr)) != ESP_OK) continue;
+        if (hdr[0] != CANLOG_MAGIC) continue;
+        if (!found || (int32_t)(hdr[1] - newest_seq) > 0) {
+            newest_seq = hdr[1];
+            newest_sector = s;
+            found = true;
+        }
+    }
+    uint32_t per_erase = ERASE_SIZE / CANLOG_BLOCK_SIZE;
+    first_sector = found ? (newest_sector / per_erase + 1) * per_erase % part_sectors : 0;
+    seq_base = found ? newest_seq + 1 : 0;
+    ESP_LOGI(TAG, "Partition %lu KB, resuming at sector %lu with block %lu",
+             (unsigned long)(part->size / 1024), (unsigned long)first_sector, (unsigned long)seq_base);
+}
+
+esp_err_t canlog_start(void)
+{
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "canlog");
+    if (part == NULL) {
+        ESP_LOGE(TAG, "No \"canlog\" partition; flash with partitions.csv");
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (part->size % ERASE_SIZE != 0 || part->size < 2 * ERASE_SIZE) {
+        ESP_LOGE(TAG, "\"canlog\" must be a multiple of 64 KB, at least 128 KB");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    part_sectors = part->size / CANLOG_BLOCK_SIZE;
+    canlog_find_start();
+
+    // PSRAM when there is any: only tasks touch the ring, never the cache-safe ISR
+    size_t size = (size_t)RING_BLOCKS * CANLOG_BLOCK_SIZE;
+    uint8_t *mem = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (mem == NULL) mem = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (mem == NULL) {
+        ESP_LOGE(TAG, "No memory for a %u KB ring", (unsigned)(size / 1024));
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < RING_BLOCKS; i++) ring[i].buf = mem + (size_t)i * CANLOG_BLOCK_SIZE;
+    block_open(&ring[0], esp_timer_get_time());
+
+    if (xTaskCreate(canlog_writer_task, "canlog_wr", 4096, NULL, 5, &writer_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Recording: %d KB RAM ring, flush every %d ms", CONFIG_TWAI_LOG_RING_KB,
+             CONFIG_TWAI_LOG_FLUSH_MS);
+    return ESP_OK;
+}
+
+void canlog_get_stats(struct canlog_stats *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * Binary bus recorder. Frames are appended to RAM blocks (PSRAM when the
+ * chip has it) by the RX task and a writer task copies the blocks into the
+ * "canlog" flash partition, which it uses as a ring: the oldest 64 KB are
+ * erased once the partition is full, so the partition always holds the most
+ * recent part of the bus traffic. tools/canlog_export.py turns a partition
+ * dump into candump or ASC text.
+ *
+ * Flash layout, one block per 4 KB sector, all fields little-endian:
+ *   block header: magic u32, seq u32, base_us u64, dropped u32
+ *   records:      dlc u8, ts_us u32, can_id u32, data[dlc]
+ *
+ * seq counts blocks since the partition was first used and orders them
+ * across the wrap. base_us is the 64-bit esp_timer time the block was
+ * opened; a record's ts_us holds the low 32 bits of its time, so its full
+ * time is base_us + (uint32_t)(ts_us - base_us). can_id uses the SocketCAN
+ * flags (bit 31 extended, bit 30 RTR); bit 29 marks a frame that matched a
+ * trigger rule when only triggered windows are logged (cantrigger.h). dropped is the number of frames lost
+ * to a full RAM ring since boot, as of the block's opening. The records end
+ * at the first dlc byte of 0xFF (erased flash) or at the end of the sector.
+ */
+
+#define CANLOG_BLOCK_SIZE   4096
+#define CANLOG_MAGIC        0x474C4E43 // "CNLG"
+#define CANLOG_FLAG_EXT     0x80000000u
+#define CANLOG_FLAG_RTR     0x40000000u
+#define CANLOG_FLAG_TRIGGER 0x20000000u
+
+struct canlog_stats {
+    uint32_t frames;        // records added
+    uint32_t dropped;       // frames lost to a full RAM ring
+    uint32_t blocks;        // blocks completed in flash
+    uint32_t flash_errors;
+    uint32_t ring_hwm;      // most RAM blocks waiting for the writer
+};
+
+// Finds the partition, resumes after the newest block in it and starts the writer task
+esp_err_t canlog_start(void);
+
+// Called from the single RX task only
+void canlog_add(uint32_t can_id, uint8_t dlc, const uint8_t *data, int64_t time_us);
+
+void canlog_get_stats(struct canlog_stats *out);
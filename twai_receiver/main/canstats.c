@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "canstats.h"
+
+static const char *TAG = "STATS";
+
+#define SLOTS_BITS  9
+#define SLOTS       (1 << SLOTS_BITS)  // open addressing, kept under half full
+#define MAX_IDS     (SLOTS / 2)
+
+struct id_stats {
+    uint32_t can_id;      // SocketCAN flags; 0 with used == false is an empty slot
+    bool used;
+    uint8_t dlc;          // last seen
+    int64_t last_us;
+    uint32_t total;
+    // Window since the last report
+    uint32_t count;
+    uint32_t periods;     // periods measured in the window (a new ID has none yet)
+    uint64_t period_sum_us;
+    uint32_t period_min_us, period_max_us;
+};
+
+static struct id_stats table[SLOTS];
+static uint32_t ids, untracked;
+static uint32_t bitrate;
+static uint64_t window_bits;
+static uint32_t window_frames;
+static int64_t window_start_us;
+static triton_twai_stats_t last_bus;
+
+static inline uint32_t slot_of(uint32_t can_id)
+{
+    return (can_id * 0x9E3779B1u) >> (32 - SLOTS_BITS);
+}
+
+static struct id_stats *lookup(uint32_t can_id)
+{
+    for (uint32_t i = slot_of(can_id);; i = (i + 1) & (SLOTS - 1)) {
+        struct id_stats *s = &table[i];
+        if (s->used && s->can_id == can_id) return s;
+        if (!s->used) {
+            if (ids >= MAX_IDS) return NULL;
+            ids++;
+            s->used = true;
+            s->can_id = can_id;
+            return s;
+        }
+    }
+}
+
+// The stuffed part of a frame, SOF through CRC: the CRC covers the bits up to it, and a stuff
+// bit follows every five equal bits, stuff bits included in the count
+struct wire {
+    uint32_t bits;
+    uint16_t crc;
+    uint8_t last;
+    uint8_t run;
+};
+
+static inline void put_bit(struct wire *w, unsigned b, bool crc)
+{
+    if (crc) {
+        unsigned next = b ^ (w->crc >> 14 & 1);
+        w->crc = (uint16_t)(w->crc << 1 & 0x7FFF);
+        if (next) w->crc ^= 0x4599;
+    }
+    w->bits++;
+    if (b == w->last) {
+        if (++w->run == 5) {
+            w->bits++;
+            w->last = !b;
+            w->run = 1;
+        }
+    } else {
+        w->last = (uint8_t)b;
+        w->run = 1;
+    }
+}
+
+static inline void put_bits(struct wire *w, uint32_t v, int n)
+{
+    while (n--) put_bit(w, v >> n & 1, true);
+}
+
+uint32_t canstats_frame_bits(uint32_t can_id, uint8_t dlc, const uint8_t *data)
+{
+    struct wire w = { .last = 2 };
+    bool rtr = can_id & TRITON_TWAI_FLAG_RTR;
+    put_bit(&w, 0, true); // SOF
+    if (can_id & TRITON_TWAI_FLAG_EXT) {
+        uint32_t id = can_id & 0x1FFFFFFF;
+        put_bits(&w, id >> 18, 11);
+        put_bits(&w, 0x3, 2); // SRR, IDE
+        put_bits(&w, id & 0x3FFFF, 18);
+        put_bits(&w, rtr, 1);
+        put_bits(&w, 0, 2);   // r1, r0
+    } else {
+        put_bits(&w, can_id & 0x7FF, 11);
+        put_bits(&w, rtr, 1);
+        put_bits(&w, 0, 2);   // IDE, r0
+    }
+    put_bits(&w, dlc, 4);
+    if (!rtr) {
+        for (int i = 0; i < dlc && i < 8; i++) put_bits(&w, data[i], 8);
+    }
+    uint16_t crc = w.crc;
+    for (int i = 14; i >= 0; i--) put_bit(&w, crc >> i & 1, false);
+    return w.bits + 13; // CRC delimiter, ACK slot and delimiter, EOF, intermission
+}
+
+void canstats_init(uint32_t rate)
+{
+    bitrate = rate;
+}
+
+void canstats_add(uint32_t can_id, uint8_t dlc, const uint8_t *data, int64_t time_us)
+{
+    window_bits += canstats_frame_bits(can_id, dlc, data);
+    window_frames++;
+
+    struct id_stats *s = lookup(can_id);
+    if (s == NULL) {
+        untracked++;
+        return;
+    }
+    if (s->total++) {
+        uint32_t period = (uint32_t)(time_us - s->last_us);
+        if (s->periods++ == 0 || period < s->period_min_us) s->period_min_us = period;
+        if (period > s->period_max_us) s->period_max_us = period;
+        s->period_sum_us += period;
+    }
+    s->last_us = time_us;
+    s->dlc = dlc;
+    s->count++;
+}
+
+static const char *state_name(uint32_t state)
+{
+    static const char *names[] = { "error-active", "error-warning", "error-passive", "bus-off" };
+    return state < 4 ? names[state] : "?";
+}
+
+static void print_ms(char *buf, size_t len, uint32_t us)
+{
+    snprintf(buf, len, "%lu.%03lu", (unsigned long)(us / 1000), (unsigned long)(us % 1000));
+}
+
+void canstats_report(int64_t now_us, const triton_twai_stats_t *e)
+{
+    int64_t span_us = now_us - window_start_us;
+    if (span_us <= 0) return;
+
+    // Load in 0.1 % steps
+    uint32_t load = (uint32_t)(window_bits * 1000000ull * 1000 / ((uint64_t)bitrate * (uint64_t)span_us));
+    uint32_t fps = (uint32_t)(window_frames * 1000000ull / (uint64_t)span_us);
+    ESP_LOGI(TAG, "load %lu.%lu %%, %lu frames/s, %lu IDs%s, %s",
+             (unsigned long)(load / 10), (unsigned long)(load % 10), (unsigned long)fps, (unsigned long)ids,
+             untracked ? " (table full)" : "", state_name(e->state));
+    ESP_LOGI(TAG, "errors: bit %lu stuff %lu form %lu ack %lu arb-lost %lu",
+             (unsigned long)(e->bit_errors - last_bus.bit_errors),
+             (unsigned long)(e->stuff_errors - last_bus.stuff_errors),
+             (unsigned long)(e->form_errors - last_bus.form_errors),
+             (unsigned long)(e->ack_errors - last_bus.ack_errors), (unsigned long)(e->arb_lost - last_bus.arb_lost));
+    last_bus = *e;
+
+    // The busiest IDs of the window, by insertion into a short sorted list
+    struct id_stats *top[CONFIG_TWAI_STATS_TOP_N];
+    int n = 0;
+    for (int i = 0; i < SLOTS; i++) {
+        struct id_stats *s = &table[i];
+        if (!s->used || s->count == 0) continue;
+        if (n == CONFIG_TWAI_STATS_TOP_N && s->count <= top[n - 1]->count) continue;
+        int j = n < CONFIG_TWAI_STATS_TOP_N ? n++ : n - 1;
+        while (j > 0 && top[j - 1]->count < s->count) {
+            top[j] = top[j - 1];
+            j--;
+        }
+        top[j] = s;
+    }
+    if (n) ESP_LOGI(TAG, "        ID    frames/s  mean ms   min ms   max ms  dlc");
+    for (int i = 0; i < n; i++) {
+        struct id_stats *s = top[i];
+        char mean[16] = "-", min[16] = "-", max[16] = "-";
+        if (s->periods) {
+            print_ms(mean, sizeof(mean), (uint32_t)(s->period_sum_us / s->periods));
+            print_ms(min, sizeof(min), s->period_min_us);
+            print_ms(max, sizeof(max), s->period_max_us);
+        }
+        bool ext = s->can_id & TRITON_TWAI_FLAG_EXT;
+        ESP_LOGI(TAG, "%10lX%s %9lu %8s %8s %8s  %u%s", (unsigned long)(s->can_id & 0x1FFFFFFF), ext ? "x" : " ",
+                 (unsigned long)(s->count * 1000000ull / (uint64_t)span_us), mean, min, max, s->dlc,
+                 s->can_id & TRITON_TWAI_FLAG_RTR ? " rtr" : "");
+    }
+
+    for (int i = 0; i < SLOTS; i++) {
+        struct id_stats *s = &table[i];
+        s->count = s->periods = 0;
+        s->period_sum_us = 0;
+        s->period_max_us = 0;
+    }
+    window_bits = 0;
+    window_frames = 0;
+    window_start_us = now_us;
+}
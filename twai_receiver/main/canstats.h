@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "triton_twai.h"
+
+/**
+ * Bus statistics for the receiver: load from the exact length of every
+ * frame on the wire (stuff bits included, computed from the frame's own
+ * CRC), and per-ID count, period and DLC in a fixed hash table. A report
+ * prints the load and the busiest IDs of the window and starts a new one.
+ * All calls come from the RX task.
+ */
+
+void canstats_init(uint32_t bitrate);
+
+void canstats_add(uint32_t can_id, uint8_t dlc, const uint8_t *data, int64_t time_us);
+
+// Bits the frame occupies on the bus, from SOF through the interframe space
+uint32_t canstats_frame_bits(uint32_t can_id, uint8_t dlc, const uint8_t *data);
+
+// bus: the node's counters, for its error counts and state
+void canstats_report(int64_t now_us, const triton_twai_stats_t *bus);
@@ -0,0 +1,183 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "canlog.h"
+#include "cantrigger.h"
+
+static const char *TAG = "TRIGGER";
+
+#define MAX_RULES   16
+#define PRE_FRAMES  CONFIG_TWAI_TRIGGER_PRE_FRAMES
+
+// A window's ring reaches canlog in one go: it has to fit the log's RAM ring with room to spare
+// (a record is at most 17 bytes)
+_Static_assert(PRE_FRAMES * 17 <= CONFIG_TWAI_LOG_RING_KB * 1024 / 2,
+               "the pre-trigger frames need a log RAM ring at least twice their size");
+
+struct rule {
+    uint32_t id, mask, any;
+    bool ext;
+    uint8_t len;            // payload bytes compared
+    uint8_t data[8], dmask[8];
+};
+
+struct frame {
+    int64_t time_us;
+    uint32_t can_id;
+    uint8_t dlc;
+    uint8_t data[8];
+};
+
+static struct rule rules[MAX_RULES];
+static int n_rules;
+static struct frame *ring;  // the last PRE_FRAMES frames outside a window
+static uint32_t ring_head, ring_count;
+static bool in_window;
+static int64_t window_end_us;
+static struct cantrigger_stats stats;
+
+// Up to 8 hex bytes, byte 0 first; how many were read
+static int parse_bytes(const char *s, const char **end, uint8_t *out)
+{
+    int n = 0;
+    while (n < 8 && isxdigit((unsigned char)s[0]) && isxdigit((unsigned char)s[1])) {
+        char byte[3] = { s[0], s[1], 0 };
+        out[n++] = (uint8_t)strtoul(byte, NULL, 16);
+        s += 2;
+    }
+    *end = s;
+    return n;
+}
+
+static bool parse_rule(const char *s, const char **end, struct rule *r)
+{
+    char *p;
+    memset(r, 0, sizeof(*r));
+    r->ext = *s == 'x' || *s == 'X';
+    if (r->ext) s++;
+    const uint32_t width = r->ext ? 0x1FFFFFFF : 0x7FF;
+    r->id = strtoul(s, &p, 16);
+    if (p == s || r->id > width) return false;
+    r->mask = width;
+    if (*p == '/') {
+        s = p + 1;
+        r->mask = strtoul(s, &p, 16);
+        if (p == s || r->mask > width) return false;
+    }
+    if (*p == '&') {
+        s = p + 1;
+        r->any = strtoul(s, &p, 16);
+        if (p == s || r->any == 0 || r->any > width) return false;
+    }
+    r->id &= r->mask;
+    if (*p == ':') {
+        const char *q;
+        int n = parse_bytes(p + 1, &q, r->data);
+        if (n <= 0) return false;
+        r->len = (uint8_t)n;
+        memset(r->dmask, 0xFF, sizeof(r->dmask));
+        if (*q == '/' && parse_bytes(q + 1, &q, r->dmask) != n) return false;
+        for (int i = 0; i < n; i++) r->data[i] &= r->dmask[i];
+        p = (char *)q;
+    }
+    *end = p;
+    return *p == '\0' || *p == ' ';
+}
+
+static bool matches(const struct rule *r, uint32_t can_id, uint8_t dlc, const uint8_t *data)
+{
+    if (((can_id & CANLOG_FLAG_EXT) != 0) != r->ext) return false;
+    uint32_t id = can_id & (r->ext ? 0x1FFFFFFF : 0x7FF);
+    if ((id & r->mask) != r->id) return false;
+    if (r->any && !(id & r->any)) return false;
+    if (r->len) {
+        if ((can_id & CANLOG_FLAG_RTR) || dlc < r->len) return false;
+        for (int i = 0; i < r->len; i++) {
+            if ((data[i] & r->dmask[i]) != r->data[i]) return false;
+        }
+    }
+    return true;
+}
+
+void cantrigger_add(uint32_t can_id, uint8_t dlc, const uint8_t *data, int64_t time_us)
+{
+    bool hit = false;
+    for (int i = 0; i < n_rules && !hit; i++) hit = matches(&rules[i], can_id, dlc, data);
+
+    if (hit) {
+        stats.triggers++;
+        window_end_us = time_us + CONFIG_TWAI_TRIGGER_POST_MS * 1000LL;
+        if (!in_window) {
+            // The frames before the trigger, oldest first
+            in_window = true;
+            stats.windows++;
+            uint32_t first = (ring_head + PRE_FRAMES - ring_count) % PRE_FRAMES;
+            for (uint32_t i = 0; i < ring_count; i++) {
+                const struct frame *f = &ring[(first + i) % PRE_FRAMES];
+                canlog_add(f->can_id, f->dlc, f->data, f->time_us);
+            }
+            ring_count = 0;
+        }
+        canlog_add(can_id | CANLOG_FLAG_TRIGGER, dlc, data, time_us);
+        return;
+    }
+    if (in_window && time_us <= window_end_us) {
+        canlog_add(can_id, dlc, data, time_us);
+        return;
+    }
+    in_window = false;
+
+    struct frame *f = &ring[ring_head];
+    if (ring_count == PRE_FRAMES) {
+        stats.skipped++;
+    } else {
+        ring_count++;
+    }
+    f->time_us = time_us;
+    f->can_id = can_id;
+    f->dlc = dlc;
+    memcpy(f->data, data, dlc);
+    ring_head = (ring_head + 1) % PRE_FRAMES;
+}
+
+esp_err_t cantrigger_start(void)
+{
+    const char *s = CONFIG_TWAI_TRIGGER_RULES;
+    while (*s) {
+        if (*s == ' ') {
+            s++;
+            continue;
+        }
+        const char *end;
+        if (n_rules == MAX_RULES || !parse_rule(s, &end, &rules[n_rules])) {
+            ESP_LOGE(TAG, "Bad trigger rule at \"%s\" (at most %d rules)", s, MAX_RULES);
+            return ESP_ERR_INVALID_ARG;
+        }
+        n_rules++;
+        s = end;
+    }
+    if (n_rules == 0) {
+        ESP_LOGE(TAG, "No trigger rules: nothing would be logged");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // PSRAM when there is any, as for the log's own ring
+    size_t size = (size_t)PRE_FRAMES * sizeof(struct frame);
+    ring = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (ring == NULL) ring = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (ring == NULL) {
+        ESP_LOGE(TAG, "No memory for %d pre-trigger frames", PRE_FRAMES);
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "%d rule(s), %d frames before a trigger, %d ms after", n_rules, PRE_FRAMES,
+             CONFIG_TWAI_TRIGGER_POST_MS);
+    return ESP_OK;
+}
+
+void cantrigger_get_stats(struct cantrigger_stats *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * Triggered recording for the log mode: frames wait in a RAM ring of the
+ * last CONFIG_TWAI_TRIGGER_PRE_FRAMES (PSRAM when the chip has it) and only
+ * reach canlog when a frame matches one of the trigger rules. The ring goes
+ * to the log first, then every frame until CONFIG_TWAI_TRIGGER_POST_MS after
+ * the last matching frame, so a trigger inside a window extends it. Frames
+ * outside a window are never written, which keeps flash writes and wear to
+ * the windows themselves.
+ *
+ * Rules, CONFIG_TWAI_TRIGGER_RULES, separated by spaces; a frame that
+ * matches any of them triggers:
+ *   [x]ID[/MASK][&ANY][:DATA[/DMASK]]
+ * all in hex. x takes extended frames only, no x standard frames only.
+ * (id & MASK) == ID, MASK defaulting to every bit of the ID. &ANY also
+ * wants at least one of the ID bits ANY set. DATA and DMASK are payload
+ * bytes, byte 0 first, up to 8 of them: the frame must carry that many and
+ * match under DMASK (default all ones). Examples, for RobStride motors:
+ *   x15000000/1F000000          any fault report (communication type 21)
+ *   x02000000/1F000000&3F0000   feedback (type 2) with a fault bit set
+ *
+ * The matching frame is logged with CANLOG_FLAG_TRIGGER in its ID.
+ * All calls come from the RX task.
+ */
+
+struct cantrigger_stats {
+    uint32_t triggers;      // frames that matched a rule
+    uint32_t windows;       // windows opened
+    uint32_t skipped;       // frames that aged out of the ring unlogged
+};
+
+// Parses the rules and takes the ring; canlog_start first
+esp_err_t cantrigger_start(void);
+
+void cantrigger_add(uint32_t can_id, uint8_t dlc, const uint8_t *data, int64_t time_us);
+
+void cantrigger_get_stats(struct cantrigger_stats *out);
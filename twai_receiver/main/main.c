@@ -1,57 +1,123 @@
 #include <stdio.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "driver/twai.h"
 #include "esp_log.h"
+#include "sdkconfig.h"
+#include "triton_twai.h"
+#include "canlog.h"
+#include "cantrigger.h"
+#include "canstats.h"
 
 static const char *TAG = "TWAI_RX";
 
-// Configure CAN pins & bitrate
-#define CAN_TX_PIN   GPIO_NUM_20    // (if dual-board you might swap TX/RX)
-#define CAN_RX_PIN   GPIO_NUM_21
-#define CAN_BITRATE  TWAI_TIMING_CONFIG_1MBITS()  // match your bus
+// Pins and bitrate: the "Triton TWAI" menu (GPIO 20/21 on the C3 boards)
 
-static void init_twai_listener(void)
+#define REPORT_PERIOD_MS 5000
+
+// The log stores frame IDs with the same flags
+_Static_assert(CANLOG_FLAG_EXT == TRITON_TWAI_FLAG_EXT && CANLOG_FLAG_RTR == TRITON_TWAI_FLAG_RTR,
+               "log and driver ID flags differ");
+
+// Each mode is a sink on the RX task, the only caller of canlog_add, cantrigger_add and
+// canstats_add, so none of them needs a lock
+
+#if CONFIG_TWAI_RX_MODE_PRINT
+static void print_frame(const triton_twai_frame_t *f, void *ctx)
+{
+    // Worst case: extended ID, 8 data bytes
+    char buf[96];
+    int pos = snprintf(buf, sizeof(buf), "ID=0x%03lX DLC=%u Data: ",
+                       (unsigned long)(f->id & TRITON_TWAI_ID_MASK), f->dlc);
+
+    for (int i = 0; i < f->dlc; i++) {
+        pos += snprintf(buf + pos, sizeof(buf) - pos, "%02X ", f->data[i]);
+    }
+
+    ESP_LOGI(TAG, "%s", buf);
+}
+#endif
+
+#if CONFIG_TWAI_RX_MODE_LOG
+static void log_frame(const triton_twai_frame_t *f, void *ctx)
+{
+#if CONFIG_TWAI_LOG_TRIGGER
+    cantrigger_add(f->id, f->dlc, f->data, f->time_us);
+#else
+    canlog_add(f->id, f->dlc, f->data, f->time_us);
+#endif
+}
+#endif
+
+#if CONFIG_TWAI_STATS
+static int64_t next_report;
+
+static void stats_frame(const triton_twai_frame_t *f, void *ctx)
 {
-    twai_general_config_t g_config =
-        TWAI_GENERAL_CONFIG_DEFAULT(CAN_TX_PIN, CAN_RX_PIN, TWAI_MODE_NORMAL);
-    twai_timing_config_t  t_config = CAN_BITRATE;
-    twai_filter_config_t  f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+    canstats_add(f->id, f->dlc, f->data, f->time_us);
+}
+
+static void stats_tick(int64_t now, void *ctx)
+{
+    const int64_t period_us = CONFIG_TWAI_STATS_PERIOD_MS * 1000LL;
+    if (next_report == 0) next_report = now + period_us;
+    if (now < next_report) return;
 
-    esp_err_t err = twai_driver_install(&g_config, &t_config, &f_config);
+    triton_twai_stats_t bus;
+    triton_twai_get_stats(&bus);
+    canstats_report(now, &bus);
+    next_report += period_us;
+    if (next_report <= now) next_report = now + period_us;
+}
+#endif
+
+void app_main(void)
+{
+#if CONFIG_TWAI_RX_MODE_LOG
+    esp_err_t err = canlog_start();
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to install TWAI driver: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to start the log: %s", esp_err_to_name(err));
         abort();
     }
-    err = twai_start();
+#if CONFIG_TWAI_LOG_TRIGGER
+    err = cantrigger_start();
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start TWAI driver: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to start the trigger: %s", esp_err_to_name(err));
         abort();
     }
+#endif
+    ESP_ERROR_CHECK(triton_twai_add_sink(&(triton_twai_sink_t){ .on_frame = log_frame }));
+#else
+    ESP_ERROR_CHECK(triton_twai_add_sink(&(triton_twai_sink_t){ .on_frame = print_frame }));
+#endif
+#if CONFIG_TWAI_STATS
+    canstats_init(CONFIG_TRITON_TWAI_BITRATE);
+    ESP_ERROR_CHECK(triton_twai_add_sink(&(triton_twai_sink_t){ .on_frame = stats_frame, .on_tick = stats_tick }));
+#endif
 
+    triton_twai_config_t config = TRITON_TWAI_CONFIG_DEFAULT();
+    if (triton_twai_start(&config) != ESP_OK) {
+        abort();
+    }
     ESP_LOGI(TAG, "TWAI listener started");
-}
-
-void app_main(void)
-{
-    init_twai_listener();
 
     while (true) {
-        twai_message_t msg;
-        esp_err_t err = twai_receive(&msg, pdMS_TO_TICKS(1000));
-        if (err == ESP_OK) {
-            // Print out the frame
-            char buf[64];
-            int pos = snprintf(buf, sizeof(buf), "ID=0x%03lX DLC=%u Data: ",
-                            (unsigned long)msg.identifier,
-                            msg.data_length_code);
-
-            for (int i = 0; i < msg.data_length_code; i++) {
-                pos += snprintf(buf + pos, sizeof(buf) - pos, "%02X ", msg.data[i]);
-            }
-
-            ESP_LOGI(TAG, "%s", buf);
-        }
-        // else if timeout, just loop again
+        vTaskDelay(pdMS_TO_TICKS(REPORT_PERIOD_MS));
+        triton_twai_stats_t bus;
+        triton_twai_get_stats(&bus);
+#if CONFIG_TWAI_RX_MODE_LOG
+        struct canlog_stats s;
+        canlog_get_stats(&s);
+        ESP_LOGI(TAG, "log: %lu frames, %lu blocks, ring hwm %lu, dropped %lu ring / %lu queue, %lu flash errors",
+                 (unsigned long)s.frames, (unsigned long)s.blocks, (unsigned long)s.ring_hwm,
+                 (unsigned long)s.dropped, (unsigned long)bus.rx_overruns, (unsigned long)s.flash_errors);
+#if CONFIG_TWAI_LOG_TRIGGER
+        struct cantrigger_stats t;
+        cantrigger_get_stats(&t);
+        ESP_LOGI(TAG, "trigger: %lu windows, %lu triggers, %lu frames skipped",
+                 (unsigned long)t.windows, (unsigned long)t.triggers, (unsigned long)t.skipped);
+#endif
+#else
+        if (bus.rx_overruns) ESP_LOGW(TAG, "%lu frames lost to a full RX queue", (unsigned long)bus.rx_overruns);
+#endif
     }
 }
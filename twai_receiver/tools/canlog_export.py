@@ -0,0 +1,98 @@
+import argparse
+import struct
+import sys
+
+# Converts a dump of the receiver's "canlog" partition (main/canlog.h) to candump -l or Vector
+# ASC text. Dump the partition with
+#   parttool.py --port PORT read_partition --partition-name canlog --output canlog.bin
+# Times are seconds since the receiver booted, plus --start if given (e.g. the epoch time of the
+# boot, for tools that want wall-clock candump logs).
+
+BLOCK_SIZE = 4096
+MAGIC = 0x474C4E43
+HEADER = struct.Struct('<IIQI')
+RECORD = struct.Struct('<BII')
+FLAG_EXT = 0x80000000
+FLAG_RTR = 0x40000000
+FLAG_TRIGGER = 0x20000000  # matched a trigger rule (triggered windows only)
+
+def read_blocks(image):
+    """(seq, base_us, dropped, sector data) for every sector that holds a block, oldest first."""
+    blocks = []
+    for off in range(0, len(image) - BLOCK_SIZE + 1, BLOCK_SIZE):
+        magic, seq, base_us, dropped = HEADER.unpack_from(image, off)
+        if magic == MAGIC:
+            blocks.append((seq, base_us, dropped, image[off:off + BLOCK_SIZE]))
+    blocks.sort(key=lambda b: b[0])
+    return blocks
+
+def frames(blocks):
+    """(time_us, can_id, data) in log order, one list per boot."""
+    boots, cur, last_us = [], [], None
+    for seq, base_us, dropped, sector in blocks:
+        if last_us is not None and base_us < last_us:
+            boots.append(cur)
+            cur = []
+        pos = HEADER.size
+        while pos + RECORD.size <= BLOCK_SIZE:
+            dlc, ts, can_id = RECORD.unpack_from(sector, pos)
+            if dlc > 8:
+                break  # 0xFF: erased flash, the end of the block
+            data = sector[pos + RECORD.size:pos + RECORD.size + dlc]
+            t = base_us + ((ts - base_us) & 0xFFFFFFFF)
+            cur.append((t, can_id, data))
+            last_us = t
+            pos += RECORD.size + dlc
+        last_us = max(last_us or 0, base_us)
+    boots.append(cur)
+    return [b for b in boots if b]
+
+def candump_line(t, can_id, data, iface, start):
+    ext = can_id & FLAG_EXT
+    ident = f"{can_id & 0x1FFFFFFF:08X}" if ext else f"{can_id & 0x7FF:03X}"
+    payload = 'R' if can_id & FLAG_RTR else data.hex().upper()
+    return f"({start + t / 1e6:.6f}) {iface} {ident}#{payload}"
+
+def asc_line(t, can_id, data, start):
+    ident = f"{can_id & 0x1FFFFFFF:X}x" if can_id & FLAG_EXT else f"{can_id & 0x7FF:X}"
+    if can_id & FLAG_RTR:
+        return f"{start + t / 1e6:11.6f} 1  {ident:<15s} Rx   r"
+    body = ' '.join(f"{b:02X}" for b in data)
+    return f"{start + t / 1e6:11.6f} 1  {ident:<15s} Rx   d {len(data)} {body}".rstrip()
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Export a canlog partition dump")
+    parser.add_argument('dump', help="partition image read with parttool.py")
+    parser.add_argument('-f', '--format', choices=('candump', 'asc'), default='candump')
+    parser.add_argument('-o', '--output', help="output file (default: stdout)")
+    parser.add_argument('-i', '--iface', default='can0', help="candump interface name")
+    parser.add_argument('--start', type=float, default=0.0, help="seconds added to every timestamp")
+    parser.add_argument('--all-boots', action='store_true',
+                        help="export every boot found in the log, not only the last one")
+    args = parser.parse_args()
+
+    with open(args.dump, 'rb') as f:
+        image = f.read()
+    blocks = read_blocks(image)
+    if not blocks:
+        sys.exit("no log blocks in the dump")
+    boots = frames(blocks)
+    lost = blocks[-1][2]
+    sel = boots if args.all_boots else boots[-1:]
+    triggers = sum(1 for boot in sel for _, can_id, _ in boot if can_id & FLAG_TRIGGER)
+    print(f"{len(blocks)} blocks, {len(boots)} boot(s), {sum(len(b) for b in sel)} frames exported, "
+          f"{lost} dropped in the last boot so far", file=sys.stderr)
+    if triggers:
+        print(f"{triggers} trigger frame(s): the log holds triggered windows only", file=sys.stderr)
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    if args.format == 'asc':
+        out.write("date Thu Jan 1 00:00:00.000 1970\nbase hex  timestamps absolute\nno internal events logged\n")
+    for boot in sel:
+        for t, can_id, data in boot:
+            if args.format == 'asc':
+                out.write(asc_line(t, can_id, data, args.start) + "\n")
+            else:
+                out.write(candump_line(t, can_id, data, args.iface, args.start) + "\n")
+    if args.format == 'asc':
+        out.write("End TriggerBlock\n")
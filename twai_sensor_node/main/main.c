@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "driver/uart.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "triton_twai.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "FOOT";
+
+// Foot force sensor node. The ADC samples the load cell amplifier by DMA at CONFIG_FOOT_SAMPLE_HZ;
+// a CIC filter decimates that to CONFIG_FOOT_TX_HZ FootForce frames (schemas/sensors.dbc):
+//   bytes 0..1 : forceN, whole newtons, little-endian
+//   byte  2    : sequence, counting every frame sent since boot, wrapping at 256
+//   byte  3    : bit 0 clipped (the ADC hit either end of its range in the period),
+//                bit 1 overrun (samples were lost before this frame, the filter restarted)
+//   bytes 4..7 : esp_timer time the force is for, in µs, low 32 bits, little-endian
+// The time is the middle of the filter's window, so the filter's delay is not in it and frames of
+// several nodes line up.
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#error "twai_sensor_node reads the TYPE2 DMA format of the ESP32-C3/S3 and later"
+#endif
+
+#if CONFIG_FOOT_SAMPLE_HZ % CONFIG_FOOT_TX_HZ
+#error "CONFIG_FOOT_SAMPLE_HZ must be a multiple of CONFIG_FOOT_TX_HZ"
+#endif
+
+#define DECIMATION    (CONFIG_FOOT_SAMPLE_HZ / CONFIG_FOOT_TX_HZ)
+#define ORDER         CONFIG_FOOT_CIC_ORDER
+#define ADC_CHANNEL   CONFIG_FOOT_ADC_CHANNEL
+#define ADC_ATTEN     ADC_ATTEN_DB_12
+#define ADC_MAX       ((1 << SOC_ADC_DIGI_MAX_BITWIDTH) - 1)
+// Full scale at 12 dB when the chip has no calibration in eFuse, so readings are approximate
+#define UNCALIBRATED_MV 2500
+
+#if DECIMATION < 2
+#error "CONFIG_FOOT_SAMPLE_HZ must be at least twice CONFIG_FOOT_TX_HZ"
+#endif
+
+// One DMA frame per output period while that is short, so each frame is sent as soon as its last
+// sample is in. Longer periods span several frames.
+#define FRAME_SAMPLES (DECIMATION < 256 ? DECIMATION : 256)
+#define FRAME_BYTES   (FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES)
+#define POOL_FRAMES   8
+
+#define REPORT_PERIOD_MS 1000
+#define FLAG_CLIPPED     0x01
+#define FLAG_OVERRUN     0x02
+
+static adc_continuous_handle_t adc;
+static adc_cali_handle_t cali;
+static QueueHandle_t frame_times;   // esp_timer time each DMA frame completed, in frame order
+static volatile bool pool_overflow;
+static volatile bool tare_requested;
+
+// CIC state. The integrators wrap at 64 bits; the combs' differences come out right anyway, as
+// long as the true output, up to ADC_MAX * DECIMATION^ORDER, fits.
+struct cic {
+    uint64_t integ[ORDER];
+    uint64_t comb[ORDER];
+    uint32_t phase;
+    uint32_t warmup;        // outputs still to skip while the combs fill
+    uint16_t lo, hi;        // sample range over the current output period
+};
+
+struct node_stats {
+    uint32_t sent;
+    uint32_t queue_full;
+    uint32_t overruns;
+    uint32_t foreign;       // DMA results of another unit or channel
+    uint16_t last_force;
+};
+
+static struct cic cic;
+static struct node_stats stats;
+static uint64_t gain;       // DECIMATION^ORDER
+static int64_t zero_uv = CONFIG_FOOT_ZERO_MV * 1000;
+static uint8_t seq;
+static uint8_t pending_flags;
+
+static bool IRAM_ATTR on_conv_done(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata,
+                                   void *user_data)
+{
+    (void)handle;
+    (void)edata;
+    (void)user_data;
+    int64_t now = esp_timer_get_time();
+    BaseType_t woken = pdFALSE;
+    if (xQueueSendFromISR(frame_times, &now, &woken) != pdTRUE) {
+        pool_overflow = true;
+    }
+    return woken == pdTRUE;
+}
+
+static bool IRAM_ATTR on_pool_ovf(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata,
+                                  void *user_data)
+{
+    (void)handle;
+    (void)edata;
+    (void)user_data;
+    pool_overflow = true;
+    return false;
+}
+
+static void cic_reset(void)
+{
+    memset(&cic, 0, sizeof(cic));
+    cic.warmup = ORDER;
+    cic.lo = ADC_MAX;
+}
+
+// Feeds one sample. Returns true with the filter output in *out at the end of each output period.
+static bool cic_push(uint16_t raw, uint64_t *out)
+{
+    if (raw < cic.lo) cic.lo = raw;
+    if (raw > cic.hi) cic.hi = raw;
+    uint64_t v = raw;
+    for (int k = 0; k < ORDER; k++) {
+        cic.integ[k] += v;
+        v = cic.integ[k];
+    }
+    if (++cic.phase < DECIMATION) return false;
+    cic.phase = 0;
+    for (int k = 0; k < ORDER; k++) {
+        uint64_t d = v - cic.comb[k];
+        cic.comb[k] = v;
+        v = d;
+    }
+    *out = v;
+    return true;
+}
+
+static int raw_to_mv(int raw)
+{
+    int mv;
+    if (cali && adc_cali_raw_to_voltage(cali, raw, &mv) == ESP_OK) return mv;
+    return raw * UNCALIBRATED_MV / ADC_MAX;
+}
+
+// Filter output to µV. Its fraction of an LSB is kept by interpolating between the calibrated
+// voltages of the two codes either side.
+static int64_t output_to_uv(uint64_t out)
+{
+    int raw = (int)(out / gain);
+    uint64_t rem = out % gain;
+    int64_t mv0 = raw_to_mv(raw);
+    int64_t mv1 = raw < ADC_MAX ? raw_to_mv(raw + 1) : mv0;
+    return mv0 * 1000 + (int64_t)((mv1 - mv0) * 1000 * (int64_t)rem / (int64_t)gain);
+}
+
+static void send_force(uint64_t out, int64_t last_sample_us)
+{
+    uint8_t flags = pending_flags;
+    if (cic.lo == 0 || cic.hi == ADC_MAX) flags |= FLAG_CLIPPED;
+    cic.lo = ADC_MAX;
+    cic.hi = 0;
+    if (cic.warmup) {
+        cic.warmup--;
+        return;
+    }
+    pending_flags = 0;
+
+    int64_t uv = output_to_uv(out);
+    if (tare_requested) {
+        tare_requested = false;
+        zero_uv = uv;
+        ESP_LOGI(TAG, "tare: zero at %lld µV", (long long)uv);
+    }
+    int64_t force = ((uv - zero_uv) * CONFIG_FOOT_N_PER_V + 500000) / 1000000;
+    if (force < 0) force = 0;
+    if (force > 0xFFFF) force = 0xFFFF;
+
+    // The window ends at the last sample; its middle is the filter's group delay before that
+    const int64_t delay_us = (int64_t)ORDER * (DECIMATION - 1) * 500000 / CONFIG_FOOT_SAMPLE_HZ;
+    uint32_t stamp = (uint32_t)(last_sample_us - delay_us);
+    uint16_t force_n = (uint16_t)force;
+    uint8_t data[8];
+    memcpy(&data[0], &force_n, 2);
+    data[2] = seq;
+    data[3] = flags;
+    memcpy(&data[4], &stamp, 4);
+    if (triton_twai_transmit(CONFIG_FOOT_CAN_ID, 8, data, 0) != ESP_OK) {
+        stats.queue_full++;
+        pending_flags |= flags & FLAG_OVERRUN;  // don't lose the news with the frame
+        return;
+    }
+    seq++;
+    stats.sent++;
+    stats.last_force = force_n;
+}
+
+// Samples were dropped, so the frame times no longer pair with the pool's frames. Restarting the
+// ADC empties both; the frame after the restart says so.
+static void restart_adc(void)
+{
+    adc_continuous_stop(adc);
+    pool_overflow = false;
+    xQueueReset(frame_times);
+    adc_continuous_flush_pool(adc);
+    cic_reset();
+    stats.overruns++;
+    pending_flags |= FLAG_OVERRUN;
+    ESP_ERROR_CHECK(adc_continuous_start(adc));
+}
+
+static void report(void)
+{
+    struct node_stats s = stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.last_force = s.last_force;
+    ESP_LOGI(TAG, "%lu frames/s, force %u N, queue full %lu, ADC overruns %lu, seq %u",
+             (unsigned long)(s.sent * 1000 / REPORT_PERIOD_MS), s.last_force, (unsigned long)s.queue_full,
+             (unsigned long)s.overruns, seq);
+    if (s.foreign) {
+        ESP_LOGW(TAG, "%lu DMA results not from ADC1 channel %d", (unsigned long)s.foreign, ADC_CHANNEL);
+    }
+
+    triton_twai_stats_t bus;
+    triton_twai_get_stats(&bus);
+    if (bus.tx_failed || bus.bus_off) {
+        ESP_LOGW(TAG, "%lu frames failed, %lu bus-offs since boot", (unsigned long)bus.tx_failed,
+                 (unsigned long)bus.bus_off);
+    }
+}
+
+/**
+ * Takes each DMA frame as it completes and runs its samples through the
+ * filter. A frame's samples are timed back from the moment the frame
+ * completed, one sample period apart, so the frame times carry no
+ * scheduling jitter of this task. The CPU only runs per frame; the ADC and
+ * DMA do the per-sample work.
+ */
+static void sample_task(void *arg)
+{
+    (void)arg;
+    static uint8_t buf[FRAME_BYTES];
+    int64_t last_report = esp_timer_get_time();
+
+    while (true) {
+        int64_t end_us;
+        bool got_frame = xQueueReceive(frame_times, &end_us, pdMS_TO_TICKS(100)) == pdTRUE;
+        if (pool_overflow) {
+            restart_adc();
+            continue;
+        }
+        uint32_t len = 0;
+        if (got_frame && adc_continuous_read(adc, buf, FRAME_BYTES, &len, 0) == ESP_OK) {
+            uint32_t n = len / SOC_ADC_DIGI_RESULT_BYTES;
+            for (uint32_t i = 0; i < n; i++) {
+                const adc_digi_output_data_t *p = (const adc_digi_output_data_t *)&buf[i * SOC_ADC_DIGI_RESULT_BYTES];
+                if (p->type2.unit != ADC_UNIT_1 || p->type2.channel != ADC_CHANNEL) {
+                    stats.foreign++;
+                    continue;
+                }
+                uint64_t out;
+                if (cic_push(p->type2.data, &out)) {
+                    send_force(out, end_us - (int64_t)(n - 1 - i) * 1000000 / CONFIG_FOOT_SAMPLE_HZ);
+                }
+            }
+        } else if (!got_frame) {
+            ESP_LOGW(TAG, "no ADC data for 100 ms");
+        }
+        int64_t now = esp_timer_get_time();
+        if (now - last_report >= REPORT_PERIOD_MS * 1000) {
+            report();
+            last_report = now;
+        }
+    }
+}
+
+// "tare" lines on the console UART take the current reading as zero force
+static void console_task(void *arg)
+{
+    (void)arg;
+    const uart_port_t port = CONFIG_ESP_CONSOLE_UART_NUM;
+    if (uart_driver_install(port, 256, 0, 0, NULL, 0) != ESP_OK) {
+        ESP_LOGE(TAG, "console UART%d: driver install failed, zero stays at %d mV", port, CONFIG_FOOT_ZERO_MV);
+        vTaskDelete(NULL);
+    }
+    char line[32];
+    size_t len = 0;
+    while (true) {
+        uint8_t c;
+        if (uart_read_bytes(port, &c, 1, portMAX_DELAY) != 1) continue;
+        if (c != '\n' && c != '\r') {
+            if (len < sizeof(line) - 1) line[len++] = (char)c;
+            continue;
+        }
+        line[len] = '\0';
+        len = 0;
+        if (strcmp(line, "tare") == 0) {
+            tare_requested = true;
+        } else if (line[0]) {
+            ESP_LOGW(TAG, "unknown command '%s', expected: tare", line);
+        }
+    }
+}
+
+static void start_adc(void)
+{
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_curve_fitting_config_t cali_config = {
+        .unit_id = ADC_UNIT_1,
+        .chan = ADC_CHANNEL,
+        .atten = ADC_ATTEN,
+        .bitwidth = SOC_ADC_DIGI_MAX_BITWIDTH,
+    };
+    if (adc_cali_create_scheme_curve_fitting(&cali_config, &cali) != ESP_OK) cali = NULL;
+#endif
+    if (!cali) {
+        ESP_LOGW(TAG, "no ADC calibration in eFuse, voltages are approximate");
+    }
+
+    adc_continuous_handle_cfg_t handle_config = {
+        .max_store_buf_size = FRAME_BYTES * POOL_FRAMES,
+        .conv_frame_size = FRAME_BYTES,
+    };
+    ESP_ERROR_CHECK(adc_continuous_new_handle(&handle_config, &adc));
+    adc_digi_pattern_config_t pattern = {
+        .atten = ADC_ATTEN,
+        .channel = ADC_CHANNEL,
+        .unit = ADC_UNIT_1,
+        .bit_width = SOC_ADC_DIGI_MAX_BITWIDTH,
+    };
+    adc_continuous_config_t config = {
+        .pattern_num = 1,
+        .adc_pattern = &pattern,
+        .sample_freq_hz = CONFIG_FOOT_SAMPLE_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE2,
+    };
+    ESP_ERROR_CHECK(adc_continuous_config(adc, &config));
+    adc_continuous_evt_cbs_t callbacks = {
+        .on_conv_done = on_conv_done,
+        .on_pool_ovf = on_pool_ovf,
+    };
+    ESP_ERROR_CHECK(adc_continuous_register_event_callbacks(adc, &callbacks, NULL));
+    ESP_ERROR_CHECK(adc_continuous_start(adc));
+}
+
+void app_main(void)
+{
+    triton_twai_config_t config = TRITON_TWAI_CONFIG_DEFAULT();
+    if (triton_twai_start(&config) != ESP_OK) {
+        abort();
+    }
+
+    gain = 1;
+    for (int k = 0; k < ORDER; k++) gain *= DECIMATION;
+    cic_reset();
+    frame_times = xQueueCreate(POOL_FRAMES, sizeof(int64_t));
+    start_adc();
+
+    ESP_LOGI(TAG, "foot sensor node started: ADC1 channel %d at %d Hz, order %d CIC to %d Hz, FootForce on 0x%X",
+             ADC_CHANNEL, CONFIG_FOOT_SAMPLE_HZ, ORDER, CONFIG_FOOT_TX_HZ, CONFIG_FOOT_CAN_ID);
+
+    xTaskCreate(sample_task, "foot_adc", 4096, NULL, 10, NULL);
+    xTaskCreate(console_task, "console", 3072, NULL, 5, NULL);
+}
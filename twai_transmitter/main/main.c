@@ -2,54 +2,222 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "driver/twai.h"
+#include "driver/uart.h"
+#include "triton_twai.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
 
 static const char *TAG = "TWAI_TX";
 
-static void init_twai(void)
+// Traffic generator. Every frame's payload starts with a sequence number and the time it was
+// queued, so a receiver can count lost frames and measure latency:
+//   bytes 0..3 : sequence number, little-endian, counting every frame sent since boot
+//   bytes 4..7 : esp_timer time when queued, in µs, low 32 bits, little-endian
+// Frames shorter than 8 bytes carry the leading part.
+
+// Pins and bitrate: the "Triton TWAI" menu. CONFIG_TRITON_TWAI_TX_QUEUE_LEN should hold more
+// than one tick of back-to-back frames (about 9 at 1 Mbit/s).
+#define BITRATE          CONFIG_TRITON_TWAI_BITRATE
+#define REPORT_PERIOD_MS 1000
+
+#if CONFIG_TWAI_TX_EXTENDED
+#define TX_EXTENDED 1
+#else
+#define TX_EXTENDED 0
+#endif
+
+#if CONFIG_TWAI_TX_DLC_MIN > CONFIG_TWAI_TX_DLC_MAX
+#error "CONFIG_TWAI_TX_DLC_MIN must not exceed CONFIG_TWAI_TX_DLC_MAX"
+#endif
+
+// Target load in percent. Starts at CONFIG_TWAI_TX_LOAD_PERCENT; "load <percent>" on the console
+// UART changes it at run time, so nativeCAN/hil_bench.py can step it without reflashing.
+static volatile uint32_t target_load = CONFIG_TWAI_TX_LOAD_PERCENT;
+
+static uint32_t rng_state = 0x2545F491;
+static uint32_t seq;
+#if CONFIG_TWAI_TX_ID_SEQUENTIAL
+static uint32_t id_cursor;
+#endif
+
+struct tx_stats {
+    uint32_t sent;
+    uint32_t queue_full;
+    uint64_t bits;
+};
+
+static struct tx_stats stats;
+
+// xorshift32: cheap, and the same sequence on every run
+static uint32_t rng_next(void)
 {
-    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(GPIO_NUM_20, GPIO_NUM_21, TWAI_MODE_NORMAL);
-    twai_timing_config_t t_config = TWAI_TIMING_CONFIG_500KBITS();
-    twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+    uint32_t x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return rng_state = x;
+}
 
-    esp_err_t err = twai_driver_install(&g_config, &t_config, &f_config);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to install TWAI driver: %s", esp_err_to_name(err));
-        abort();
-    }
+static uint32_t next_id(void)
+{
+#if CONFIG_TWAI_TX_ID_FIXED
+    uint32_t offset = 0;
+#elif CONFIG_TWAI_TX_ID_SEQUENTIAL
+    uint32_t offset = id_cursor;
+    id_cursor = (id_cursor + 1) % CONFIG_TWAI_TX_ID_COUNT;
+#elif CONFIG_TWAI_TX_ID_RANDOM
+    uint32_t offset = rng_next() % CONFIG_TWAI_TX_ID_COUNT;
+#else // priority mix: offset k with probability 2^-(k+1), the rest on the last ID
+    uint32_t r = rng_next();
+    uint32_t offset = r ? (uint32_t)__builtin_ctz(r) : 31;
+    if (offset >= CONFIG_TWAI_TX_ID_COUNT) offset = CONFIG_TWAI_TX_ID_COUNT - 1;
+#endif
+    uint32_t mask = TX_EXTENDED ? 0x1FFFFFFF : 0x7FF;
+    return (CONFIG_TWAI_TX_ID_BASE + offset) & mask;
+}
 
-    err = twai_start();
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start TWAI driver: %s", esp_err_to_name(err));
-        abort();
+static uint8_t next_dlc(void)
+{
+    const uint32_t span = CONFIG_TWAI_TX_DLC_MAX - CONFIG_TWAI_TX_DLC_MIN + 1;
+    return (uint8_t)(CONFIG_TWAI_TX_DLC_MIN + (span > 1 ? rng_next() % span : 0));
+}
+
+// Unstuffed length, SOF through the interframe space
+static uint32_t frame_bits(uint8_t dlc)
+{
+    return (TX_EXTENDED ? 67 : 47) + 8u * dlc;
+}
+
+// Builds and queues one frame. Returns its bus time in bits, or 0 when the TX queue is full and
+// the frame was not sent.
+static uint32_t send_frame(void)
+{
+    uint32_t id = next_id() | (TX_EXTENDED ? TRITON_TWAI_FLAG_EXT : 0);
+    uint8_t dlc = next_dlc();
+    uint8_t data[8];
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    memcpy(&data[0], &seq, 4);
+    memcpy(&data[4], &now, 4);
+    if (triton_twai_transmit(id, dlc, data, 0) != ESP_OK) {
+        stats.queue_full++;
+        return 0;
     }
+    uint32_t bits = frame_bits(dlc);
+    seq++;
+    stats.sent++;
+    stats.bits += bits;
+    return bits;
 }
 
-void app_main(void)
+static void report(int64_t span_us, uint32_t target)
 {
-    init_twai();
+    struct tx_stats s = stats;
+    memset(&stats, 0, sizeof(stats));
+    uint32_t load = (uint32_t)(s.bits * 1000000ull * 1000 / ((uint64_t)BITRATE * (uint64_t)span_us));
+    ESP_LOGI(TAG, "%lu frames/s, load %lu.%lu %% (unstuffed, target %lu %%), queue full %lu, seq %lu",
+             (unsigned long)(s.sent * 1000000ull / (uint64_t)span_us), (unsigned long)(load / 10),
+             (unsigned long)(load % 10), (unsigned long)target, (unsigned long)s.queue_full, (unsigned long)seq);
 
-    ESP_LOGI(TAG, "TWAI transmitter started");
+    triton_twai_stats_t bus;
+    triton_twai_get_stats(&bus);
+    if (bus.tx_failed || bus.bus_off) {
+        ESP_LOGW(TAG, "%lu frames failed, %lu bus-offs since boot", (unsigned long)bus.tx_failed,
+                 (unsigned long)bus.bus_off);
+    }
+}
 
-    const char *hello_str = "Hello";
+/**
+ * Paces frames against the clock. Each frame moves the next send time on by
+ * its bus time divided by the target load, so the average load is right
+ * whatever the DLC mix. Each tick queues every frame that has come due; the
+ * TX queue smooths them onto the bus. With bursts, credit builds up during
+ * the pause and a burst spends it back to back. A new target starts from
+ * the current time, with no credit carried over.
+ */
+static void generator_task(void *arg)
+{
+    (void)arg;
+    uint32_t load = 0;
+    uint64_t ns_per_bit = 0;
+    int64_t next_ns = 0;
+    int64_t last_report = esp_timer_get_time();
+    uint32_t in_burst = 0;
 
     while (true) {
-        twai_message_t message = {
-            .identifier = 0x123,
-            .data_length_code = 3,
-            .data = {0}
-        };
-
-        memcpy(message.data, hello_str, message.data_length_code);
-
-        esp_err_t err = twai_transmit(&message, pdMS_TO_TICKS(1000));
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to transmit message: %s", esp_err_to_name(err));
-        } else {
-            ESP_LOGI(TAG, "Sent message: %.*s", message.data_length_code, hello_str);
+        int64_t now_us = esp_timer_get_time();
+        if (target_load != load) {
+            load = target_load;
+            ns_per_bit = load ? 1000000000ull * 100 / ((uint64_t)BITRATE * load) : 0;
+            next_ns = now_us * 1000;
+            in_burst = 0;
+        }
+        bool pause = false;
+        while (load && next_ns <= now_us * 1000) {
+            uint32_t bits = send_frame();
+            if (bits == 0) {
+                // Queue full: the bus is slower than the target (stuffing, arbitration, errors), so
+                // don't build up a backlog to send later
+                next_ns = now_us * 1000;
+                break;
+            }
+            next_ns += (int64_t)(bits * ns_per_bit);
+            if (CONFIG_TWAI_TX_BURST_PAUSE_MS && ++in_burst >= CONFIG_TWAI_TX_BURST_LEN) {
+                in_burst = 0;
+                pause = true;
+                break;
+            }
+        }
+        if (now_us - last_report >= REPORT_PERIOD_MS * 1000) {
+            report(now_us - last_report, load);
+            last_report = now_us;
         }
+        vTaskDelay(pause ? pdMS_TO_TICKS(CONFIG_TWAI_TX_BURST_PAUSE_MS) : 1);
+    }
+}
 
-        vTaskDelay(pdMS_TO_TICKS(2000));
+// "load <0..100>" lines on the console UART set the target load
+static void console_task(void *arg)
+{
+    (void)arg;
+    const uart_port_t port = CONFIG_ESP_CONSOLE_UART_NUM;
+    if (uart_driver_install(port, 256, 0, 0, NULL, 0) != ESP_OK) {
+        ESP_LOGE(TAG, "console UART%d: driver install failed, the load stays at %d %%", port,
+                 CONFIG_TWAI_TX_LOAD_PERCENT);
+        vTaskDelete(NULL);
     }
+    char line[32];
+    size_t len = 0;
+    while (true) {
+        uint8_t c;
+        if (uart_read_bytes(port, &c, 1, portMAX_DELAY) != 1) continue;
+        if (c != '\n' && c != '\r') {
+            if (len < sizeof(line) - 1) line[len++] = (char)c;
+            continue;
+        }
+        line[len] = '\0';
+        len = 0;
+        unsigned percent;
+        if (sscanf(line, "load %u", &percent) == 1 && percent <= 100) {
+            target_load = percent;
+            ESP_LOGI(TAG, "target load %u %%", percent);
+        } else if (line[0]) {
+            ESP_LOGW(TAG, "unknown command '%s', expected: load <0..100>", line);
+        }
+    }
+}
+
+void app_main(void)
+{
+    triton_twai_config_t config = TRITON_TWAI_CONFIG_DEFAULT();
+    if (triton_twai_start(&config) != ESP_OK) {
+        abort();
+    }
+
+    ESP_LOGI(TAG, "TWAI traffic generator started: %d bit/s, %d %% load, %s IDs from 0x%X (%d), DLC %d..%d",
+             BITRATE, CONFIG_TWAI_TX_LOAD_PERCENT, TX_EXTENDED ? "extended" : "standard",
+             CONFIG_TWAI_TX_ID_BASE, CONFIG_TWAI_TX_ID_COUNT, CONFIG_TWAI_TX_DLC_MIN, CONFIG_TWAI_TX_DLC_MAX);
+
+    xTaskCreate(generator_task, "twai_gen", 4096, NULL, 10, NULL);
+    xTaskCreate(console_task, "console", 3072, NULL, 5, NULL);
 }
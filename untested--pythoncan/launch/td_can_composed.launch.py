@@ -0,0 +1,26 @@
+from launch import LaunchDescription
+from launch.actions import DeclareLaunchArgument, OpaqueFunction
+from launch.substitutions import LaunchConfiguration
+from ament_index_python.packages import get_package_share_directory
+import os
+
+
+def _container(context):
+    # Every bus of the config as a td_can_bridge_cpp component, and the consumers next to them, in
+    # one process: same-host pipelines pass messages intra-process and never reach DDS
+    from td_can_bridges.composition import bridge_components, consumer_components, container
+
+    cfg = LaunchConfiguration('config').perform(context)
+    nodes = bridge_components(cfg) + consumer_components(LaunchConfiguration('consumers').perform(context))
+    return [container(nodes)]
+
+
+def generate_launch_description():
+    share = get_package_share_directory('td_can_bridges')
+    return LaunchDescription([
+        DeclareLaunchArgument('config', default_value=os.path.join(share, 'config', 'example_multibus.yaml')),
+        DeclareLaunchArgument('consumers', default_value='',
+                              description='YAML list of {package, plugin, name, parameters} components to load '
+                                          'into td_can_container with the bridges.'),
+        OpaqueFunction(function=_container),
+    ])
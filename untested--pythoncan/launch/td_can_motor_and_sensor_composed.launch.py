@@ -0,0 +1,28 @@
+from launch import LaunchDescription
+from launch.actions import DeclareLaunchArgument, OpaqueFunction
+from launch.substitutions import LaunchConfiguration
+from ament_index_python.packages import get_package_share_directory
+import os
+
+
+def _container(context):
+    # td_can_motor_and_sensor_split.launch.py with both bridges as components of one container
+    from td_can_bridges.composition import bridge_components, consumer_components, container
+
+    nodes = (bridge_components(LaunchConfiguration('motor_config').perform(context), prefix='motor_can_bridge_')
+             + bridge_components(LaunchConfiguration('sensor_config').perform(context), prefix='sensor_can_bridge_')
+             + consumer_components(LaunchConfiguration('consumers').perform(context)))
+    return [container(nodes)]
+
+
+def generate_launch_description():
+    share = get_package_share_directory('td_can_bridges')
+    cfg = os.path.join(share, 'config', 'example_singlebus.yaml')  # duplicate or provide another file
+    return LaunchDescription([
+        DeclareLaunchArgument('motor_config', default_value=cfg),
+        DeclareLaunchArgument('sensor_config', default_value=cfg),
+        DeclareLaunchArgument('consumers', default_value='',
+                              description='YAML list of {package, plugin, name, parameters} components to load '
+                                          'into td_can_container with the bridges.'),
+        OpaqueFunction(function=_container),
+    ])
@@ -1,18 +1,77 @@
-
 from launch import LaunchDescription
+from launch.actions import DeclareLaunchArgument, OpaqueFunction
+from launch.substitutions import LaunchConfiguration
 from launch_ros.actions import Node
 from ament_index_python.packages import get_package_share_directory
 import os
 
-def generate_launch_description():
-    share = get_package_share_directory('td_can_bridges')
-    cfg = os.path.join(share, 'config', 'example_multibus.yaml')
-    return LaunchDescription([
+
+def _bridges(context):
+    cfg = LaunchConfiguration('config').perform(context)
+    cpp_buses = [b.strip() for b in LaunchConfiguration('cpp_buses').perform(context).split(',') if b.strip()]
+    if cpp_buses:
+        loaned = LaunchConfiguration('loaned_messages').perform(context).lower() in ('true', '1', 'yes')
+        return _with_cpp(cfg, cpp_buses, loaned)
+    if LaunchConfiguration('process_per_bus').perform(context).lower() not in ('true', '1', 'yes'):
+        return [
+            Node(
+                package='td_can_bridges',
+                executable='td_can_bridge',
+                name='td_can_bridge',
+                output='screen',
+                parameters=[{'config': cfg}],
+            )
+        ]
+    # One process per bus, each with its own GIL; latest values are shared through the signal stores
+    from td_can_bridges.service import load_bridge_config
+
+    return [
         Node(
             package='td_can_bridges',
             executable='td_can_bridge',
-            name='td_can_bridge',
+            name=f'td_can_bridge_{bus.name}',
             output='screen',
-            parameters=[{'config': cfg}],
+            parameters=[{'config': cfg, 'bus': bus.name, 'share_signals': True}],
         )
+        for bus in load_bridge_config(cfg).buses
+    ]
+
+
+def _with_cpp(cfg, cpp_buses, loaned=False):
+    # The named buses run as td_can_bridge_cpp components in one container, where controllers loaded
+    # next to them get the messages intra-process; every other bus keeps a Python process of its own
+    from td_can_bridges.composition import bridge_components, container
+    from td_can_bridges.service import load_bridge_config
+
+    buses = [bus.name for bus in load_bridge_config(cfg).buses]
+    unknown = sorted(set(cpp_buses) - set(buses))
+    if unknown:
+        raise RuntimeError(f"cpp_buses names buses {unknown} that {cfg} does not have")
+    actions = [container(bridge_components(cfg, cpp_buses, loaned))]
+    actions += [
+        Node(
+            package='td_can_bridges',
+            executable='td_can_bridge',
+            name=f'td_can_bridge_{name}',
+            output='screen',
+            parameters=[{'config': cfg, 'bus': name, 'share_signals': True}],
+        )
+        for name in buses if name not in cpp_buses
+    ]
+    return actions
+
+
+def generate_launch_description():
+    share = get_package_share_directory('td_can_bridges')
+    return LaunchDescription([
+        DeclareLaunchArgument('config', default_value=os.path.join(share, 'config', 'example_multibus.yaml')),
+        DeclareLaunchArgument('process_per_bus', default_value='false',
+                              description='Run every bus of the config in a td_can_bridge process of its own.'),
+        DeclareLaunchArgument('cpp_buses', default_value='',
+                              description='Comma-separated buses to run as td_can_bridge_cpp components in '
+                                          'td_can_container; the others run one process each.'),
+        DeclareLaunchArgument('loaned_messages', default_value='false',
+                              description='cpp_buses publish loaned messages (shared memory under Cyclone DDS '
+                                          'with iceoryx) instead of intra-process.'),
+        OpaqueFunction(function=_bridges),
     ])
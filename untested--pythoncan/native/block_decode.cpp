@@ -0,0 +1,200 @@
+#include "block_decode.hpp"
+
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TD_CAN_AVX2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define TD_CAN_NEON 1
+#endif
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "the payload gather assumes a little-endian host");
+
+namespace td_can {
+namespace {
+
+using Kernel = void (*)(const SignalSpec &, const uint64_t *, size_t, void *);
+
+uint64_t mask_of(uint8_t length)
+{
+    return length >= 64 ? ~0ull : (1ull << length) - 1;
+}
+
+// The vector kernels convert through the mantissa, which holds 52 bits; as_int needs no conversion
+bool vectorised(const SignalSpec &s)
+{
+    return !s.is_float && (s.as_int || s.length <= 52);
+}
+
+// One signal over a column of words, as RxCore::decode does it per frame
+void column_scalar(const SignalSpec &s, const uint64_t *words, size_t n, void *out)
+{
+    const uint64_t mask = mask_of(s.length);
+    const uint64_t sign = s.is_signed && s.length < 64 ? 1ull << (s.length - 1) : 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t raw = (words[i] >> s.shift) & mask;
+        if (s.is_float) {
+            double f;
+            if (s.length == 32) {
+                float f32;
+                uint32_t bits = uint32_t(raw);
+                std::memcpy(&f32, &bits, sizeof(f32));
+                f = f32;
+            } else {
+                std::memcpy(&f, &raw, sizeof(f));
+            }
+            // Unscaled floats pass as they are, so -0.0 stays -0.0 like in the NumPy decoder
+            static_cast<double *>(out)[i] = s.scale == 1.0 && s.offset == 0.0 ? f : f * s.scale + s.offset;
+            continue;
+        }
+        if (sign) raw = (raw ^ sign) - sign;
+        if (s.as_int) {
+            static_cast<uint64_t *>(out)[i] = raw;
+        } else {
+            double v = s.is_signed ? double(int64_t(raw)) : double(raw);
+            static_cast<double *>(out)[i] = v * s.scale + s.offset;
+        }
+    }
+}
+
+#ifdef TD_CAN_AVX2
+// 0x4330... is 2^52 and 0x4338... 1.5 * 2^52: an integer added to their mantissa converts exactly
+__attribute__((target("avx2"))) void column_avx2(const SignalSpec &s, const uint64_t *words, size_t n, void *out)
+{
+    const __m128i shift = _mm_cvtsi32_si128(s.shift);
+    const __m256i mask = _mm256_set1_epi64x(int64_t(mask_of(s.length)));
+    const bool extend = s.is_signed && s.length < 64;
+    const __m256i sign = _mm256_set1_epi64x(extend ? int64_t(1ull << (s.length - 1)) : 0);
+    size_t i = 0;
+    if (s.as_int) {
+        auto *dst = static_cast<uint64_t *>(out);
+        for (; i + 4 <= n; i += 4) {
+            __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words + i));
+            __m256i raw = _mm256_and_si256(_mm256_srl_epi64(w, shift), mask);
+            if (extend) raw = _mm256_sub_epi64(_mm256_xor_si256(raw, sign), sign);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), raw);
+        }
+        column_scalar(s, words + i, n - i, dst + i);
+        return;
+    }
+    const __m256i magic = _mm256_set1_epi64x(s.is_signed ? 0x4338000000000000ll : 0x4330000000000000ll);
+    const __m256d magic_d = _mm256_castsi256_pd(magic);
+    const __m256d scale = _mm256_set1_pd(s.scale), offset = _mm256_set1_pd(s.offset);
+    auto *dst = static_cast<double *>(out);
+    for (; i + 4 <= n; i += 4) {
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words + i));
+        __m256i raw = _mm256_and_si256(_mm256_srl_epi64(w, shift), mask);
+        __m256i bits;
+        if (s.is_signed) {
+            bits = _mm256_add_epi64(_mm256_sub_epi64(_mm256_xor_si256(raw, sign), sign), magic);
+        } else {
+            bits = _mm256_or_si256(raw, magic);
+        }
+        __m256d v = _mm256_sub_pd(_mm256_castsi256_pd(bits), magic_d);
+        _mm256_storeu_pd(dst + i, _mm256_add_pd(_mm256_mul_pd(v, scale), offset));
+    }
+    column_scalar(s, words + i, n - i, dst + i);
+}
+#endif
+
+#ifdef TD_CAN_NEON
+void column_neon(const SignalSpec &s, const uint64_t *words, size_t n, void *out)
+{
+    const int64x2_t right = vdupq_n_s64(-int64_t(s.shift));
+    const uint64x2_t mask = vdupq_n_u64(mask_of(s.length));
+    // Sign extension: the signal's top bit to bit 63, then an arithmetic shift back
+    const int64x2_t up = vdupq_n_s64(64 - s.length), down = vdupq_n_s64(-(64 - int64_t(s.length)));
+    size_t i = 0;
+    auto *ints = static_cast<uint64_t *>(out);
+    auto *dst = static_cast<double *>(out);
+    const float64x2_t scale = vdupq_n_f64(s.scale), offset = vdupq_n_f64(s.offset);
+    for (; i + 2 <= n; i += 2) {
+        uint64x2_t raw = vandq_u64(vshlq_u64(vld1q_u64(words + i), right), mask);
+        if (s.is_signed) {
+            int64x2_t v = vshlq_s64(vreinterpretq_s64_u64(vshlq_u64(raw, up)), down);
+            if (s.as_int) {
+                vst1q_u64(ints + i, vreinterpretq_u64_s64(v));
+            } else {
+                vst1q_f64(dst + i, vaddq_f64(vmulq_f64(vcvtq_f64_s64(v), scale), offset));
+            }
+        } else if (s.as_int) {
+            vst1q_u64(ints + i, raw);
+        } else {
+            vst1q_f64(dst + i, vaddq_f64(vmulq_f64(vcvtq_f64_u64(raw), scale), offset));
+        }
+    }
+    column_scalar(s, words + i, n - i, ints + i);
+}
+#endif
+
+std::pair<Kernel, const char *> pick()
+{
+#ifdef TD_CAN_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return {column_avx2, "avx2"};
+#endif
+#ifdef TD_CAN_NEON
+    return {column_neon, "neon"};  // part of every aarch64 CPU
+#endif
+    return {column_scalar, "scalar"};
+}
+
+const std::pair<Kernel, const char *> &kernel()
+{
+    static const std::pair<Kernel, const char *> k = pick();
+    return k;
+}
+
+// One word per frame and byte order, read as RxCore::decode reads a payload; le or be is null
+// when no signal needs it
+template <unsigned N>
+void gather(const uint8_t *payloads, size_t n, size_t stride, uint64_t *le, uint64_t *be)
+{
+    for (size_t i = 0; i < n; i++) {
+        uint64_t w = 0;
+        std::memcpy(&w, payloads + i * stride, N);
+        if (le) le[i] = w;
+        if (be) be[i] = __builtin_bswap64(w) >> (8 * (8 - N));
+    }
+}
+
+} // namespace
+
+BlockDecoder::BlockDecoder(uint8_t length, std::vector<SignalSpec> signals)
+    : length_(length), signals_(std::move(signals))
+{
+    for (const SignalSpec &s : signals_) (s.big_endian ? big_ : little_) = true;
+}
+
+const char *BlockDecoder::isa()
+{
+    return kernel().second;
+}
+
+void BlockDecoder::decode(const uint8_t *payloads, size_t n, size_t stride, void *const *columns) const
+{
+    std::vector<uint64_t> le_words(little_ ? n : 0), be_words(big_ ? n : 0);
+    uint64_t *le = little_ ? le_words.data() : nullptr, *be = big_ ? be_words.data() : nullptr;
+    switch (length_) {
+    case 1: gather<1>(payloads, n, stride, le, be); break;
+    case 2: gather<2>(payloads, n, stride, le, be); break;
+    case 3: gather<3>(payloads, n, stride, le, be); break;
+    case 4: gather<4>(payloads, n, stride, le, be); break;
+    case 5: gather<5>(payloads, n, stride, le, be); break;
+    case 6: gather<6>(payloads, n, stride, le, be); break;
+    case 7: gather<7>(payloads, n, stride, le, be); break;
+    default: gather<8>(payloads, n, stride, le, be); break;
+    }
+
+    const Kernel vector = kernel().first;
+    for (size_t k = 0; k < signals_.size(); k++) {
+        const SignalSpec &s = signals_[k];
+        const uint64_t *words = s.big_endian ? be : le;
+        (vectorised(s) ? vector : column_scalar)(s, words, n, columns[k]);
+    }
+}
+
+} // namespace td_can
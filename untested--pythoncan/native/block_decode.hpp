@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "rx_core.hpp"
+
+// Column-wise decoding of a block of same-ID payloads, for td_can_bridges.batch.BatchDecoder.
+// The payloads are gathered once into one little- and one big-endian 64-bit word per frame
+// (structure of arrays); each signal is then a shift, a mask, a sign extension and a
+// multiply-add over a whole column. Those run on AVX2 when the CPU has it (picked at run time)
+// or NEON on aarch64, four or two frames per instruction. Float signals, and scaled integers of
+// over 52 bits, take the scalar path. Every path gives the values of the NumPy decoder.
+
+namespace td_can {
+
+class BlockDecoder {
+public:
+    // length is the DBC message length (1..8); the signals as RxCore takes them
+    BlockDecoder(uint8_t length, std::vector<SignalSpec> signals);
+
+    // n payloads, row i at payloads + i * stride (stride >= length). columns[k] receives signal k:
+    // n doubles, or n int64_t / uint64_t when the signal is as_int. Safe from several threads.
+    void decode(const uint8_t *payloads, size_t n, size_t stride, void *const *columns) const;
+
+    uint8_t length() const { return length_; }
+    const std::vector<SignalSpec> &signals() const { return signals_; }
+
+    // "avx2", "neon" or "scalar": the kernel decode() runs on this CPU
+    static const char *isa();
+
+private:
+    uint8_t length_;
+    bool little_ = false, big_ = false;  // which words the signals need
+    std::vector<SignalSpec> signals_;
+};
+
+} // namespace td_can
@@ -0,0 +1,80 @@
+#include "busy_poll.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cerrno>
+
+namespace td_can {
+
+BusyPoller::BusyPoller(int cpu) : cpu_(cpu), thread_(&BusyPoller::run, this) {}
+
+BusyPoller::~BusyPoller()
+{
+    changes_.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changes_.fetch_sub(1);
+    changed_.notify_all();
+    thread_.join();
+}
+
+void BusyPoller::add(RxCore &core)
+{
+    changes_.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (std::find(cores_.begin(), cores_.end(), &core) == cores_.end()) cores_.push_back(&core);
+    }
+    changes_.fetch_sub(1);
+    changed_.notify_all();
+}
+
+void BusyPoller::remove(RxCore &core)
+{
+    changes_.fetch_add(1);
+    {
+        // The thread sweeps under mutex_: once we hold it, no sweep is using core
+        std::lock_guard<std::mutex> lock(mutex_);
+        cores_.erase(std::remove(cores_.begin(), cores_.end(), &core), cores_.end());
+    }
+    changes_.fetch_sub(1);
+}
+
+size_t BusyPoller::cores() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cores_.size();
+}
+
+void BusyPoller::run()
+{
+    if (cpu_ >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu_, &set);
+        int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (error) thread_error_.store(error, std::memory_order_relaxed);
+    }
+    for (;;) {
+        // A waiting add()/remove() gets the mutex: std::mutex is not fair to it otherwise
+        while (changes_.load(std::memory_order_acquire)) cpu_relax();
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this] { return stopping_ || !cores_.empty(); });
+        if (stopping_) return;
+        uint64_t read = 0;
+        for (RxCore *core : cores_) {
+            int n = core->pump();
+            if (n > 0) read += uint64_t(n);
+        }
+        lock.unlock();
+        if (read) frames_.fetch_add(read, std::memory_order_relaxed);
+        sweeps_.fetch_add(1, std::memory_order_relaxed);
+        if (!read) cpu_relax();
+    }
+}
+
+} // namespace td_can
@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rx_core.hpp"
+
+// Busy-poll receive for the latency-critical buses. One BusyPoller thread, pinned to a CPU that
+// should be isolated from the scheduler (isolcpus= / nohz_full=), spins on non-blocking recvmmsg
+// over the sockets of every RxCore added to it and never sleeps while it has one. Each core was
+// put in busy mode first (RxCore::set_busy): its frames go through a single-producer,
+// single-consumer FrameRing to the core's own poll(), which spins on the ring before it sleeps.
+// So a frame reaches its consumer without the socket wakeup a blocking poll() pays on a shared
+// core; the price is one core at 100% however quiet the buses are.
+
+namespace td_can {
+
+// What a spin loop runs between checks: a pause hint to the core, no syscall
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+class BusyPoller {
+public:
+    // Starts the thread; cpu < 0 leaves it unpinned (for tests). A failed pin is kept in
+    // thread_error() and the thread spins unpinned.
+    explicit BusyPoller(int cpu);
+    // Joins the thread; the cores must be removed by then
+    ~BusyPoller();
+    BusyPoller(const BusyPoller &) = delete;
+    BusyPoller &operator=(const BusyPoller &) = delete;
+
+    // core must be in busy mode. The poller reads its socket until remove(); a read that fails
+    // (the interface went down) is handed to the core's poll() and the socket is not read again.
+    void add(RxCore &core);
+    // Returns once the thread no longer touches core
+    void remove(RxCore &core);
+
+    int cpu() const { return cpu_; }
+    size_t cores() const;
+    uint64_t sweeps() const { return sweeps_.load(std::memory_order_relaxed); }  // passes over every socket
+    uint64_t frames() const { return frames_.load(std::memory_order_relaxed); }  // frames read
+    int thread_error() const { return thread_error_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+
+    int cpu_;
+    mutable std::mutex mutex_;           // held by the thread for a sweep
+    std::condition_variable changed_;    // cores_ gained one, or stopping_
+    std::vector<RxCore *> cores_;
+    std::atomic<int> changes_{0};        // add()/remove() waiting for mutex_: the thread stands back
+    bool stopping_ = false;              // under mutex_
+    std::atomic<uint64_t> sweeps_{0};
+    std::atomic<uint64_t> frames_{0};
+    std::atomic<int> thread_error_{0};
+    std::thread thread_;
+};
+
+} // namespace td_can
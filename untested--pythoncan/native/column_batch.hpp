@@ -0,0 +1,140 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// The frames of one RxCore::poll() in fixed-layout columns, for consumers that read them without
+// building an object per frame; the module wrapper hands each column to Python as a NumPy view.
+// All columns are carved out of one arena, each on its own 64-byte boundary. BatchPool recycles
+// the arenas, so an RX loop that releases its batches allocates nothing once warm.
+
+namespace td_can {
+
+class ColumnBatch {
+public:
+    static constexpr size_t kDataLen = 64;  // bytes per row of data, CANFD_MAX_DLEN
+
+    ColumnBatch(size_t frames, size_t values) { reserve(frames, values); }
+    ColumnBatch(const ColumnBatch &) = delete;
+    ColumnBatch &operator=(const ColumnBatch &) = delete;
+
+    // Room for frames rows and values decoded values; a larger request replaces the arena and
+    // drops what the batch held
+    void reserve(size_t frames, size_t values)
+    {
+        if (arena_ && frames <= frames_ && values <= values_) return;
+        frames = std::max(frames, frames_);
+        values = std::max(values, values_);
+        size_t offset = 0;
+        auto carve = [&](size_t bytes) {
+            size_t at = offset;
+            offset += (bytes + 63) & ~size_t(63);
+            return at;
+        };
+        const size_t id_at = carve(frames * sizeof(uint32_t)), timestamp_at = carve(frames * sizeof(double)),
+                     first_at = carve(frames * sizeof(uint32_t)), count_at = carve(frames * sizeof(uint16_t)),
+                     length_at = carve(frames), raw_at = carve(frames), data_at = carve(frames * kDataLen),
+                     values_at = carve(values * sizeof(uint64_t)), kind_at = carve(values);
+        void *arena = std::aligned_alloc(64, offset ? offset : 64);
+        if (arena == nullptr) throw std::bad_alloc();
+        arena_.reset(static_cast<uint8_t *>(arena));
+        uint8_t *base = arena_.get();
+        id = reinterpret_cast<uint32_t *>(base + id_at);
+        timestamp = reinterpret_cast<double *>(base + timestamp_at);
+        first = reinterpret_cast<uint32_t *>(base + first_at);
+        count = reinterpret_cast<uint16_t *>(base + count_at);
+        length = base + length_at;
+        raw = base + raw_at;
+        data = base + data_at;
+        value = reinterpret_cast<uint64_t *>(base + values_at);
+        kind = base + kind_at;
+        frames_ = frames;
+        values_ = values;
+        clear();
+    }
+
+    void clear()
+    {
+        size = 0;
+        value_count = 0;
+    }
+
+    size_t frame_capacity() const { return frames_; }
+    size_t value_capacity() const { return values_; }
+
+    // Row i of the frame columns, for i < size, as RxCore::poll fills a Decoded
+    uint32_t *id = nullptr;        // arbitration ID without flags; error frames keep CAN_ERR_FLAG
+    double *timestamp = nullptr;   // seconds, 0 when the socket gave none
+    uint32_t *first = nullptr;     // index of the frame's first value
+    uint16_t *count = nullptr;     // values decoded, 0 for a raw frame
+    uint8_t *length = nullptr;     // payload bytes
+    uint8_t *raw = nullptr;        // 1: decoded in Python, only data holds it
+    uint8_t *data = nullptr;       // kDataLen bytes per row, zero past length
+    // Value k, for k < value_count: the bits of a double, an int64_t or a uint64_t as kind[k]
+    // (a Value::Kind) says
+    uint64_t *value = nullptr;
+    uint8_t *kind = nullptr;
+    size_t size = 0;
+    size_t value_count = 0;
+
+private:
+    struct Free {
+        void operator()(uint8_t *p) const { std::free(p); }
+    };
+    std::unique_ptr<uint8_t, Free> arena_;
+    size_t frames_ = 0, values_ = 0;
+};
+
+// Idle batches ready for reuse; acquire() and release() from any thread
+class BatchPool {
+public:
+    explicit BatchPool(size_t keep = 8) : keep_(keep) {}
+
+    std::unique_ptr<ColumnBatch> acquire(size_t frames, size_t values)
+    {
+        std::unique_ptr<ColumnBatch> batch;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!idle_.empty()) {
+                batch = std::move(idle_.back());
+                idle_.pop_back();
+            }
+        }
+        if (!batch) {
+            allocated_++;
+            return std::make_unique<ColumnBatch>(frames, values);
+        }
+        batch->reserve(frames, values);
+        batch->clear();
+        return batch;
+    }
+
+    // Keeps up to keep batches; frees the rest
+    void release(std::unique_ptr<ColumnBatch> batch)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.size() < keep_) idle_.push_back(std::move(batch));
+    }
+
+    size_t idle() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return idle_.size();
+    }
+    // Arenas allocated so far: stays flat while consumers release their batches
+    uint64_t allocated() const { return allocated_.load(std::memory_order_relaxed); }
+
+private:
+    size_t keep_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ColumnBatch>> idle_;
+    std::atomic<uint64_t> allocated_{0};
+};
+
+} // namespace td_can
@@ -0,0 +1,76 @@
+#pragma once
+#include <linux/can.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Single-producer, single-consumer ring of raw received frames for the recorder. The RX loop
+// pushes every frame it reads (a copy and two atomic stores, no lock, no allocation); the
+// recorder's writer thread pops them in bulk. A full ring drops the new frame and counts it, so
+// a slow disk never stalls reception.
+
+namespace td_can {
+
+struct RecordedFrame {
+    double timestamp;   // receive time in seconds, 0 when the socket gave none
+    uint32_t size;      // CAN_MTU or CANFD_MTU: which struct frame holds
+    uint32_t reserved;
+    canfd_frame frame;  // as read from the socket, flags included
+};
+
+class FrameRing {
+public:
+    // capacity is rounded up to a power of two
+    explicit FrameRing(size_t capacity)
+    {
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        slots_.resize(n);
+        mask_ = n - 1;
+    }
+    FrameRing(const FrameRing &) = delete;
+    FrameRing &operator=(const FrameRing &) = delete;
+
+    // Producer side
+    void push(const void *frame, uint32_t size, double timestamp)
+    {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) > mask_) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        RecordedFrame &slot = slots_[head & mask_];
+        slot.timestamp = timestamp;
+        slot.size = size;
+        std::memcpy(&slot.frame, frame, size);
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    // Consumer side: moves up to max frames to out and returns how many
+    size_t pop(std::vector<RecordedFrame> &out, size_t max)
+    {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        uint64_t head = head_.load(std::memory_order_acquire);
+        size_t n = size_t(head - tail) < max ? size_t(head - tail) : max;
+        for (size_t i = 0; i < n; i++) out.push_back(slots_[(tail + i) & mask_]);
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    size_t capacity() const { return slots_.size(); }
+    size_t size() const { return size_t(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire)); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<RecordedFrame> slots_;
+    size_t mask_ = 0;
+    // On separate cache lines: the RX thread writes head_, the writer thread tail_
+    alignas(64) std::atomic<uint64_t> head_{0};
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    alignas(64) std::atomic<uint64_t> dropped_{0};
+};
+
+} // namespace td_can
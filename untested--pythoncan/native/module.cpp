@@ -0,0 +1,486 @@
+// td_can_bridges._can_core: Python face of RxCore. run() waits with the GIL released and hands
+// each batch to the callback (poll() returns one instead) as one list of (arbitration_id, values, timestamp) where values is a
+// tuple in the order the signals were given to set_message, or the payload bytes when the message
+// is decoded in Python, and timestamp is the receive time in seconds (0.0 when unknown). A failed
+// socket call raises OSError with its errno, as the Python receive loop's would. BlockDecoder
+// decodes a NumPy block of same-ID payloads into one NumPy array per signal. TxQueue is the
+// transmit queue of td_can_bridges.tx_scheduler.NativeTxScheduler. ColumnBatch is a poll() batch
+// in pooled fixed-layout columns, read from Python through NumPy views without an object per frame.
+// BusyPoller is the spinning reader thread of rx_busy_poll, shared by the cores added to it.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include "block_decode.hpp"
+#include "busy_poll.hpp"
+#include "column_batch.hpp"
+#include "rx_core.hpp"
+#include "tx_queue.hpp"
+
+namespace py = pybind11;
+
+namespace {
+
+using SignalTuple = std::tuple<int, int, bool, bool, bool, bool, double, double>;
+
+td_can::MessageSpec make_spec(int length, bool raw, const std::vector<SignalTuple> &signals)
+{
+    if (length < 0 || length > 64) throw py::value_error("message length must be 0..64");
+    td_can::MessageSpec spec;
+    spec.length = uint8_t(length);
+    spec.raw = raw || length > 8;
+    for (const auto &t : signals) {
+        td_can::SignalSpec s;
+        int shift = std::get<0>(t), bits = std::get<1>(t);
+        if (bits < 1 || bits > 64 || shift < 0 || shift + bits > 64) {
+            throw py::value_error("signal does not fit a 64-bit payload");
+        }
+        s.shift = uint8_t(shift);
+        s.length = uint8_t(bits);
+        s.big_endian = std::get<2>(t);
+        s.is_signed = std::get<3>(t);
+        s.is_float = std::get<4>(t);
+        s.as_int = std::get<5>(t);
+        s.scale = std::get<6>(t);
+        s.offset = std::get<7>(t);
+        if (s.is_float && bits != 32 && bits != 64) throw py::value_error("float signals are 32 or 64 bits");
+        spec.signals.push_back(s);
+    }
+    return spec;
+}
+
+py::list to_python(const td_can::Batch &batch)
+{
+    py::list out(batch.frames.size());
+    for (size_t f = 0; f < batch.frames.size(); f++) {
+        const td_can::Decoded &d = batch.frames[f];
+        py::object values;
+        if (d.raw) {
+            values = py::bytes(reinterpret_cast<const char *>(d.data), d.len);
+        } else {
+            py::tuple t(d.count);
+            for (size_t i = 0; i < d.count; i++) {
+                const td_can::Value &v = batch.values[d.first_value + i];
+                switch (v.kind) {
+                case td_can::Value::Int: t[i] = py::int_(v.i); break;
+                case td_can::Value::UInt: t[i] = py::int_(v.u); break;
+                default: t[i] = py::float_(v.d); break;
+                }
+            }
+            values = std::move(t);
+        }
+        out[f] = py::make_tuple(d.id, std::move(values), d.timestamp);
+    }
+    return out;
+}
+
+// A ColumnBatch taken from its core's pool; back to the pool when the last owner lets go
+struct Lease {
+    std::shared_ptr<td_can::BatchPool> pool;
+    std::unique_ptr<td_can::ColumnBatch> batch;
+    int views = 0;  // NumPy views alive; under the GIL
+    ~Lease()
+    {
+        if (batch) pool->release(std::move(batch));
+    }
+};
+
+// Python face of a Lease. Each column property is a NumPy view whose base keeps the lease alive,
+// so a view outliving the batch object stays valid; release() returns the arena early and refuses
+// (BufferError, as bytearray does) while views exist.
+class ColumnBatchView {
+public:
+    explicit ColumnBatchView(std::shared_ptr<Lease> lease) : lease_(std::move(lease)) {}
+
+    const td_can::ColumnBatch &batch() const
+    {
+        if (!lease_->batch) throw py::value_error("ColumnBatch used after release()");
+        return *lease_->batch;
+    }
+
+    template <class T>
+    py::array view(const T *data, std::vector<py::ssize_t> shape) const
+    {
+        auto *owner = new std::shared_ptr<Lease>(lease_);
+        lease_->views++;
+        py::capsule base(owner, [](void *p) {
+            auto *lease = static_cast<std::shared_ptr<Lease> *>(p);
+            (*lease)->views--;
+            delete lease;
+        });
+        return py::array_t<T>(shape, data, base);
+    }
+    // A frame column, a value column
+    template <class T>
+    py::array rows(const T *data) const
+    {
+        return view(data, {py::ssize_t(batch().size)});
+    }
+    template <class T>
+    py::array slots(const T *data) const
+    {
+        return view(data, {py::ssize_t(batch().value_count)});
+    }
+
+    void release()
+    {
+        if (!lease_->batch) return;
+        if (lease_->views) {
+            PyErr_Format(PyExc_BufferError, "release() with %d NumPy view(s) of the batch alive", lease_->views);
+            throw py::error_already_set();
+        }
+        lease_->pool->release(std::move(lease_->batch));
+    }
+
+    // After a callback: back to the pool unless views still hold it
+    void finish()
+    {
+        if (lease_->batch && !lease_->views) lease_->pool->release(std::move(lease_->batch));
+    }
+
+    bool released() const { return !lease_->batch; }
+
+private:
+    std::shared_ptr<Lease> lease_;
+};
+
+// The list RxCore.poll() gives, from columns
+py::list to_python(const td_can::ColumnBatch &batch)
+{
+    py::list out(batch.size);
+    for (size_t f = 0; f < batch.size; f++) {
+        py::object values;
+        if (batch.raw[f]) {
+            values = py::bytes(reinterpret_cast<const char *>(batch.data + f * td_can::ColumnBatch::kDataLen),
+                               batch.length[f]);
+        } else {
+            py::tuple t(batch.count[f]);
+            for (size_t i = 0; i < batch.count[f]; i++) {
+                const size_t k = batch.first[f] + i;
+                uint64_t bits = batch.value[k];
+                switch (batch.kind[k]) {
+                case td_can::Value::Int: t[i] = py::int_(int64_t(bits)); break;
+                case td_can::Value::UInt: t[i] = py::int_(bits); break;
+                default: {
+                    double d;
+                    std::memcpy(&d, &bits, sizeof(d));
+                    t[i] = py::float_(d);
+                    break;
+                }
+                }
+            }
+            values = std::move(t);
+        }
+        out[f] = py::make_tuple(batch.id[f], std::move(values), batch.timestamp[f]);
+    }
+    return out;
+}
+
+// One wait into a batch from the pool; none after stop()
+std::unique_ptr<ColumnBatchView> poll_columns(td_can::RxCore &core, int timeout_ms)
+{
+    auto lease = std::make_shared<Lease>();
+    lease->pool = core.pool();
+    lease->batch = lease->pool->acquire(0, 0);
+    bool running;
+    {
+        py::gil_scoped_release release;
+        running = core.poll(timeout_ms, *lease->batch);
+    }
+    if (!running) return nullptr;
+    return std::make_unique<ColumnBatchView>(std::move(lease));
+}
+
+py::list drain(td_can::FrameRing &ring, size_t max)
+{
+    std::vector<td_can::RecordedFrame> frames;
+    {
+        py::gil_scoped_release release;
+        frames.reserve(std::min(max, ring.size()));
+        ring.pop(frames, max);
+    }
+    py::list out(frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+        const td_can::RecordedFrame &f = frames[i];
+        out[i] = py::make_tuple(f.timestamp, py::bytes(reinterpret_cast<const char *>(&f.frame), f.size));
+    }
+    return out;
+}
+
+py::list decode_block(const td_can::BlockDecoder &decoder, const py::array_t<uint8_t> &payloads)
+{
+    const size_t length = decoder.length();
+    if (payloads.ndim() != 2 || size_t(payloads.shape(1)) < length || payloads.strides(1) != 1 ||
+        payloads.strides(0) < 0) {
+        throw py::value_error("payloads must be a uint8 array of shape (n, length or more), rows contiguous");
+    }
+    const size_t n = payloads.shape(0);
+    std::vector<py::array> arrays;
+    std::vector<void *> columns;
+    for (const td_can::SignalSpec &s : decoder.signals()) {
+        py::array a;
+        if (s.as_int && s.is_signed) {
+            a = py::array_t<int64_t>(n);
+        } else if (s.as_int) {
+            a = py::array_t<uint64_t>(n);
+        } else {
+            a = py::array_t<double>(n);
+        }
+        columns.push_back(a.mutable_data());
+        arrays.push_back(std::move(a));
+    }
+    {
+        py::gil_scoped_release release;
+        decoder.decode(payloads.data(), n, payloads.strides(0), columns.data());
+    }
+    py::list out(arrays.size());
+    for (size_t k = 0; k < arrays.size(); k++) out[k] = std::move(arrays[k]);
+    return out;
+}
+
+using LaneTuple = std::tuple<size_t, double, unsigned, std::string>;
+
+std::unique_ptr<td_can::TxQueue> make_tx_queue(int fd, const std::vector<LaneTuple> &lanes, size_t batch)
+{
+    if (lanes.empty()) throw py::value_error("a TX queue needs at least one lane");
+    std::vector<td_can::TxLaneSpec> specs;
+    for (const auto &t : lanes) {
+        td_can::TxLaneSpec spec;
+        spec.capacity = std::max<size_t>(1, std::get<0>(t));
+        spec.rate_hz = std::max(0.0, std::get<1>(t));
+        spec.burst = std::get<2>(t);
+        const std::string &overflow = std::get<3>(t);
+        if (overflow == "block") {
+            spec.overflow = td_can::TxOverflow::Block;
+        } else if (overflow == "latest") {
+            spec.overflow = td_can::TxOverflow::Latest;
+        } else if (overflow == "error") {
+            spec.overflow = td_can::TxOverflow::Error;
+        } else {
+            throw py::value_error("overflow must be block, latest or error");
+        }
+        specs.push_back(spec);
+    }
+    return std::make_unique<td_can::TxQueue>(fd, specs, batch);
+}
+
+bool tx_push(td_can::TxQueue &queue, size_t lane, const py::bytes &frame, bool block, double timeout)
+{
+    if (lane >= queue.lanes()) throw py::index_error("no such TX lane");
+    const std::string data = frame;
+    if (data.size() != CAN_MTU && data.size() != CANFD_MTU) {
+        throw py::value_error("frames are struct can_frame or canfd_frame bytes");
+    }
+    td_can::TxQueue::Result r;
+    if (block) {
+        py::gil_scoped_release release;
+        r = queue.push_wait(lane, data.data(), uint32_t(data.size()), timeout);
+    } else {
+        r = queue.push(lane, data.data(), uint32_t(data.size()));
+    }
+    switch (r) {
+    case td_can::TxQueue::Queued: return true;
+    case td_can::TxQueue::Dropped: return false;
+    case td_can::TxQueue::Full: throw std::system_error(ENOBUFS, std::generic_category(), "TX lane full");
+    default: throw std::runtime_error("TX queue stopped");
+    }
+}
+
+py::list tx_stats(const td_can::TxQueue &queue)
+{
+    py::list out(queue.lanes());
+    for (size_t i = 0; i < queue.lanes(); i++) {
+        td_can::TxLaneStats s = queue.stats(i);
+        py::dict d;
+        d["depth"] = s.depth;
+        d["max_depth"] = s.max_depth;
+        d["sent"] = s.sent;
+        d["dropped"] = s.dropped;
+        d["errors"] = s.errors;
+        d["wait_ns_sum"] = s.wait_ns_sum;
+        d["wait_ns_max"] = s.wait_ns_max;
+        out[i] = std::move(d);
+    }
+    return out;
+}
+
+} // namespace
+
+PYBIND11_MODULE(_can_core, m)
+{
+    m.doc() = "Native receive loop for td_can_bridges.service.CanBusService";
+
+    py::register_exception_translator([](std::exception_ptr p) {
+        try {
+            if (p) std::rethrow_exception(p);
+        } catch (const std::system_error &e) {
+            // OSError(errno, text) picks the subclass, so the service can tell ENETDOWN apart
+            py::object error = py::reinterpret_borrow<py::object>(PyExc_OSError)(e.code().value(), e.what());
+            PyErr_SetObject(PyExc_OSError, error.ptr());
+        }
+    });
+
+    py::class_<td_can::FrameRing, std::shared_ptr<td_can::FrameRing>>(m, "FrameRing")
+        .def(py::init<size_t>(), py::arg("capacity"))
+        .def("drain", &drain, py::arg("max") = 4096,
+             "Up to max recorded frames as a list of (timestamp, raw can_frame or canfd_frame bytes).")
+        .def_property_readonly("capacity", &td_can::FrameRing::capacity)
+        .def_property_readonly("dropped", &td_can::FrameRing::dropped)
+        .def("__len__", &td_can::FrameRing::size);
+
+    py::class_<td_can::BlockDecoder>(m, "BlockDecoder")
+        .def(py::init([](int length, const std::vector<SignalTuple> &signals) {
+                 if (length < 1 || length > 8) throw py::value_error("block decoding takes messages of 1..8 bytes");
+                 return td_can::BlockDecoder(uint8_t(length), make_spec(length, false, signals).signals);
+             }),
+             py::arg("length"), py::arg("signals"), "Signals as RxCore.set_message takes them.")
+        .def("decode", &decode_block, py::arg("payloads"),
+             "One array per signal (float64, or int64/uint64 for as_int signals) from an (n, length) uint8 array.");
+    m.attr("simd") = td_can::BlockDecoder::isa();
+
+    py::class_<td_can::TxQueue>(m, "TxQueue")
+        .def(py::init(&make_tx_queue), py::arg("fd"), py::arg("lanes"), py::arg("batch") = 64,
+             "Lanes highest first, as (capacity, rate_hz (0: uncapped), burst, overflow); starts the TX thread.")
+        .def("push", &tx_push, py::arg("lane"), py::arg("frame"), py::arg("block") = true, py::arg("timeout") = -1.0,
+             "Queue can_frame or canfd_frame bytes: True, or False when an error lane dropped it. A full block "
+             "lane waits up to timeout seconds (< 0: no limit), then raises OSError(ENOBUFS).")
+        .def("stop", &td_can::TxQueue::stop, py::arg("drain") = 0.1, py::call_guard<py::gil_scoped_release>(),
+             "Send what is queued for up to drain seconds and stop; the number of frames not sent.")
+        .def("set_fd", &td_can::TxQueue::set_fd, py::arg("fd"))
+        .def("stats", &tx_stats, "One dict per lane.")
+        .def_property_readonly("last_errno", &td_can::TxQueue::last_errno);
+
+    using View = ColumnBatchView;
+    py::class_<View>(m, "ColumnBatch",
+                     "Decoded frames of one RxCore wait as NumPy views over a pooled arena: row i of id, "
+                     "timestamp, first, count, length, raw and data is frame i; its count values are "
+                     "values[first[i]:first[i] + count[i]] (ints and uints: the same slots as int64 / uint64).")
+        .def("__len__", [](const View &v) { return v.batch().size; })
+        .def_property_readonly("id", [](const View &v) { return v.rows(v.batch().id); })
+        .def_property_readonly("timestamp", [](const View &v) { return v.rows(v.batch().timestamp); })
+        .def_property_readonly("first", [](const View &v) { return v.rows(v.batch().first); })
+        .def_property_readonly("count", [](const View &v) { return v.rows(v.batch().count); })
+        .def_property_readonly("length", [](const View &v) { return v.rows(v.batch().length); })
+        .def_property_readonly("raw", [](const View &v) { return v.rows(v.batch().raw); })
+        .def_property_readonly("data", [](const View &v) {
+            return v.view(v.batch().data, {py::ssize_t(v.batch().size), py::ssize_t(td_can::ColumnBatch::kDataLen)});
+        })
+        .def_property_readonly("values",
+                               [](const View &v) { return v.slots(reinterpret_cast<const double *>(v.batch().value)); })
+        .def_property_readonly("ints",
+                               [](const View &v) { return v.slots(reinterpret_cast<const int64_t *>(v.batch().value)); })
+        .def_property_readonly("uints", [](const View &v) { return v.slots(v.batch().value); })
+        .def_property_readonly("kind", [](const View &v) { return v.slots(v.batch().kind); })
+        .def("to_list", [](const View &v) { return to_python(v.batch()); }, "The list RxCore.poll() would have given.")
+        .def("release", &View::release, "Return the arena to the pool now; BufferError while views exist.")
+        .def_property_readonly("released", &View::released)
+        .def("__enter__", [](View &v) -> View & { return v; }, py::return_value_policy::reference)
+        .def("__exit__", [](View &v, const py::args &) { v.finish(); });
+    m.attr("VALUE_FLOAT") = int(td_can::Value::Float);
+    m.attr("VALUE_INT") = int(td_can::Value::Int);
+    m.attr("VALUE_UINT") = int(td_can::Value::UInt);
+
+    py::class_<td_can::RxCore>(m, "RxCore")
+        .def(py::init<int, size_t>(), py::arg("fd"), py::arg("batch") = 64)
+        .def(
+            "set_message",
+            [](td_can::RxCore &core, uint32_t id, bool extended, int length, bool raw,
+               const std::vector<SignalTuple> &signals, uint32_t mask) {
+                core.set_message(id, extended, make_spec(length, raw, signals), mask);
+            },
+            py::arg("id"), py::arg("extended"), py::arg("length"), py::arg("raw"), py::arg("signals"),
+            py::arg("mask") = CAN_EFF_MASK,
+            "Signals are (shift, length, big_endian, is_signed, is_float, as_int, scale, offset); "
+            "mask selects the ID bits that must match.")
+        .def("remove_message", &td_can::RxCore::remove_message, py::arg("id"), py::arg("extended"),
+             py::arg("mask") = CAN_EFF_MASK)
+        .def("clear", &td_can::RxCore::clear)
+        .def("set_recorder", &td_can::RxCore::set_recorder, py::arg("ring"),
+             "Push every frame read to ring (a FrameRing, None to stop).")
+        .def(
+            "run",
+            [](td_can::RxCore &core, const py::function &callback) {
+                td_can::Batch batch;
+                while (true) {
+                    bool running;
+                    {
+                        py::gil_scoped_release release;
+                        running = core.poll(-1, batch);
+                    }
+                    if (!running) break;
+                    if (!batch.frames.empty()) callback(to_python(batch));
+                }
+            },
+            py::arg("callback"), "Receive until stop(); callback(list) per batch of known frames.")
+        .def(
+            "poll",
+            [](td_can::RxCore &core, int timeout_ms) -> py::object {
+                td_can::Batch batch;
+                bool running;
+                {
+                    py::gil_scoped_release release;
+                    running = core.poll(timeout_ms, batch);
+                }
+                if (!running) return py::none();
+                return to_python(batch);
+            },
+            py::arg("timeout_ms") = 0,
+            "One wait of up to timeout_ms (0: only what is queued); the batch as a list, None after stop(). "
+            "For callers that wait on the socket themselves, such as an asyncio reader.")
+        .def("poll_columns", &poll_columns, py::arg("timeout_ms") = 0,
+             "As poll(), as a ColumnBatch; release() it (or use it as a context manager) to recycle its arena.")
+        .def(
+            "run_columns",
+            [](td_can::RxCore &core, const py::function &callback) {
+                while (true) {
+                    std::unique_ptr<View> batch = poll_columns(core, -1);
+                    if (!batch) break;
+                    if (!batch->batch().size) {
+                        batch->finish();
+                        continue;
+                    }
+                    py::object handle = py::cast(batch.release(), py::return_value_policy::take_ownership);
+                    callback(handle);
+                    handle.cast<View &>().finish();
+                }
+            },
+            py::arg("callback"),
+            "Receive until stop(); callback(ColumnBatch) per non-empty batch, valid during the call. It "
+            "goes back to the pool after the callback unless NumPy views of it are kept.")
+        .def_property_readonly("pool_allocated", [](const td_can::RxCore &core) { return core.pool()->allocated(); })
+        .def("stop", &td_can::RxCore::stop, py::call_guard<py::gil_scoped_release>())
+        .def("set_busy", &td_can::RxCore::set_busy, py::arg("ring") = 4096, py::arg("spin_us") = 100,
+             "Busy-poll mode: a BusyPoller reads the socket, poll() spins spin_us (-1: always) on the "
+             "ring it fills before it sleeps. Before BusyPoller.add().")
+        .def_property_readonly("busy", &td_can::RxCore::busy)
+        .def_property_readonly("busy_dropped", &td_can::RxCore::busy_dropped)
+        .def_property_readonly("frames", &td_can::RxCore::frames)
+        .def_property_readonly("unknown", &td_can::RxCore::unknown)
+        .def_property_readonly("dropped", &td_can::RxCore::dropped);
+
+    py::class_<td_can::BusyPoller>(m, "BusyPoller")
+        .def(py::init<int>(), py::arg("cpu"), "Starts the spinning thread on cpu (-1: unpinned).")
+        .def(
+            "add",
+            [](td_can::BusyPoller &poller, td_can::RxCore &core) {
+                if (!core.busy()) throw py::value_error("set_busy() the core first");
+                poller.add(core);
+            },
+            py::arg("core"), "Read core's socket from now on; remove() it before the core goes.")
+        .def("remove", &td_can::BusyPoller::remove, py::arg("core"), py::call_guard<py::gil_scoped_release>())
+        .def_property_readonly("cpu", &td_can::BusyPoller::cpu)
+        .def_property_readonly("cores", &td_can::BusyPoller::cores)
+        .def_property_readonly("sweeps", &td_can::BusyPoller::sweeps)
+        .def_property_readonly("frames", &td_can::BusyPoller::frames)
+        .def_property_readonly("thread_error", &td_can::BusyPoller::thread_error,
+                               "errno of a failed pin to cpu, 0 when pinned");
+}
@@ -0,0 +1,404 @@
+#include "rx_core.hpp"
+
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <time.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include "busy_poll.hpp"
+
+namespace td_can {
+namespace {
+
+// The payload read once as a little- and a big-endian integer
+void load_words(uint8_t length, const uint8_t *data, uint64_t &le, uint64_t &be)
+{
+    le = 0;
+    be = 0;
+    for (int i = 0; i < length; i++) {
+        le |= uint64_t(data[i]) << (8 * i);
+        be = (be << 8) | data[i];
+    }
+}
+
+Value decode_signal(const SignalSpec &s, uint64_t le, uint64_t be)
+{
+    uint64_t mask = s.length >= 64 ? ~0ull : (1ull << s.length) - 1;
+    uint64_t raw = ((s.big_endian ? be : le) >> s.shift) & mask;
+    Value v;
+    if (s.is_float) {
+        double f;
+        if (s.length == 32) {
+            float f32;
+            uint32_t bits = uint32_t(raw);
+            std::memcpy(&f32, &bits, sizeof(f32));
+            f = f32;
+        } else {
+            std::memcpy(&f, &raw, sizeof(f));
+        }
+        v.kind = Value::Float;
+        v.d = f * s.scale + s.offset;
+    } else {
+        int64_t i;
+        if (s.is_signed && s.length < 64 && raw >> (s.length - 1)) {
+            i = int64_t(raw | ~mask);
+        } else {
+            i = int64_t(raw);
+        }
+        if (s.as_int && s.is_signed) {
+            v.kind = Value::Int;
+            v.i = i;
+        } else if (s.as_int) {
+            v.kind = Value::UInt;
+            v.u = raw;
+        } else {
+            v.kind = Value::Float;
+            v.d = (s.is_signed ? double(i) : double(raw)) * s.scale + s.offset;
+        }
+    }
+    return v;
+}
+
+} // namespace
+
+RxCore::RxCore(int fd, size_t batch)
+    : fd_(fd), wake_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), batch_(batch ? batch : 1),
+      buf_(batch_ * CANFD_MTU), control_(batch_ * kControlLen), iov_(batch_), hdrs_(batch_)
+{
+    if (wake_fd_ < 0) throw std::system_error(errno, std::generic_category(), "eventfd");
+    for (size_t i = 0; i < batch_; i++) {
+        iov_[i] = {buf_.data() + i * CANFD_MTU, CANFD_MTU};
+        hdrs_[i] = {};
+        hdrs_[i].msg_hdr.msg_iov = &iov_[i];
+        hdrs_[i].msg_hdr.msg_iovlen = 1;
+        hdrs_[i].msg_hdr.msg_control = control_.data() + i * kControlLen;
+    }
+}
+
+RxCore::~RxCore()
+{
+    close(wake_fd_);
+    if (ready_fd_ >= 0) close(ready_fd_);
+}
+
+uint32_t RxCore::key(uint32_t id, bool extended)
+{
+    return extended ? (id & CAN_EFF_MASK) | CAN_EFF_FLAG : id & CAN_SFF_MASK;
+}
+
+void RxCore::set_message(uint32_t id, bool extended, MessageSpec spec, uint32_t mask)
+{
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    max_signals_ = std::max(max_signals_, spec.signals.size());
+    mask &= extended ? CAN_EFF_MASK : CAN_SFF_MASK;
+    if (mask == (extended ? CAN_EFF_MASK : CAN_SFF_MASK)) {
+        table_[key(id, extended)] = std::move(spec);
+        return;
+    }
+    auto it = std::find_if(masked_.begin(), masked_.end(), [mask](const MaskedTable &m) { return m.mask == mask; });
+    if (it == masked_.end()) {
+        masked_.push_back({mask, {}});
+        std::stable_sort(masked_.begin(), masked_.end(), [](const MaskedTable &a, const MaskedTable &b) {
+            return __builtin_popcount(a.mask) > __builtin_popcount(b.mask);
+        });
+        it = std::find_if(masked_.begin(), masked_.end(), [mask](const MaskedTable &m) { return m.mask == mask; });
+    }
+    it->table[key(id & mask, extended)] = std::move(spec);
+}
+
+void RxCore::remove_message(uint32_t id, bool extended, uint32_t mask)
+{
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    mask &= extended ? CAN_EFF_MASK : CAN_SFF_MASK;
+    if (mask == (extended ? CAN_EFF_MASK : CAN_SFF_MASK)) {
+        table_.erase(key(id, extended));
+        return;
+    }
+    auto it = std::find_if(masked_.begin(), masked_.end(), [mask](const MaskedTable &m) { return m.mask == mask; });
+    if (it == masked_.end()) return;
+    it->table.erase(key(id & mask, extended));
+    if (it->table.empty()) masked_.erase(it);
+}
+
+void RxCore::clear()
+{
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    table_.clear();
+    masked_.clear();
+}
+
+void RxCore::set_recorder(std::shared_ptr<FrameRing> ring)
+{
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    ring_ = std::move(ring);
+}
+
+const MessageSpec *RxCore::find(uint32_t can_id) const
+{
+    bool extended = can_id & CAN_EFF_FLAG;
+    auto it = table_.find(key(can_id, extended));
+    if (it != table_.end()) return &it->second;
+    for (const MaskedTable &m : masked_) {
+        auto hit = m.table.find(key(can_id & m.mask, extended));
+        if (hit != m.table.end()) return &hit->second;
+    }
+    return nullptr;
+}
+
+void RxCore::reserve(Batch &out)
+{
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    if (out.frames.capacity() < batch_) out.frames.reserve(batch_);
+    if (out.values.capacity() < batch_ * max_signals_) out.values.reserve(batch_ * max_signals_);
+}
+
+void RxCore::stop()
+{
+    stopping_.store(true);
+    uint64_t one = 1;
+    (void)!write(wake_fd_, &one, sizeof(one));
+}
+
+void RxCore::set_busy(size_t ring_frames, int spin_us)
+{
+    if (ready_fd_ < 0) {
+        ready_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (ready_fd_ < 0) throw std::system_error(errno, std::generic_category(), "eventfd");
+    }
+    handoff_ = std::make_unique<FrameRing>(std::max(ring_frames, batch_));
+    spin_ns_ = spin_us < 0 ? -1 : int64_t(spin_us) * 1000;
+    taken_.reserve(batch_);
+}
+
+int RxCore::pump()
+{
+    if (error_.load(std::memory_order_relaxed)) return -1;
+    for (auto &h : hdrs_) h.msg_hdr.msg_controllen = kControlLen;
+    int count = recvmmsg(fd_, hdrs_.data(), (unsigned)batch_, MSG_DONTWAIT, nullptr);
+    if (count <= 0) {
+        if (count == 0 || errno == EAGAIN || errno == EINTR) return 0;
+        error_.store(errno);
+    } else {
+        for (int i = 0; i < count; i++) {
+            if (hdrs_[i].msg_len != CAN_MTU && hdrs_[i].msg_len != CANFD_MTU) continue;
+            handoff_->push(buf_.data() + i * CANFD_MTU, hdrs_[i].msg_len, stamp(hdrs_[i].msg_hdr));
+        }
+    }
+    // The frames (or the error) before sleeping_, and the other way round in take(): either the
+    // consumer sees them or this sees it asleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed)) {
+        uint64_t one = 1;
+        (void)!write(ready_fd_, &one, sizeof(one));
+    }
+    return count < 0 ? -1 : count;
+}
+
+bool RxCore::take(int timeout_ms)
+{
+    taken_.clear();
+    if (handoff_->pop(taken_, batch_)) return true;
+    if (spin_ns_ != 0) {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        const int64_t start = int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+        for (uint32_t n = 1;; n++) {
+            if (handoff_->pop(taken_, batch_)) return true;
+            if (stopping_.load(std::memory_order_relaxed) || error_.load(std::memory_order_relaxed)) break;
+            // The clock every 64 turns: the loop is for the next frame, not for the time
+            if (spin_ns_ > 0 && n % 64 == 0) {
+                clock_gettime(CLOCK_MONOTONIC, &ts);
+                if (int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec - start >= spin_ns_) break;
+            }
+            cpu_relax();
+        }
+    }
+    sleeping_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!handoff_->size() && !error_.load(std::memory_order_relaxed)) {
+        pollfd fds[2] = {{ready_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+        int n = ::poll(fds, 2, timeout_ms);
+        if (n < 0 && errno != EINTR) {
+            sleeping_.store(false, std::memory_order_relaxed);
+            throw std::system_error(errno, std::generic_category(), "poll");
+        }
+        uint64_t value;
+        if (n > 0 && (fds[0].revents & POLLIN)) (void)!read(ready_fd_, &value, sizeof(value));
+    }
+    sleeping_.store(false, std::memory_order_relaxed);
+    if (stopping_.load()) {
+        stopped_ = true;
+        return false;
+    }
+    if (!handoff_->pop(taken_, batch_) && error_.load()) {
+        throw std::system_error(error_.load(), std::generic_category(), "recvmmsg");
+    }
+    return true;
+}
+
+template <class Stamp, class Emit>
+void RxCore::deliver(const canfd_frame *frame, uint32_t size, FrameRing *ring, Stamp &&stamp, Emit &emit)
+{
+    frames_.fetch_add(1, std::memory_order_relaxed);
+    double timestamp = -1.0;  // taken once, for the ring or the decoded frame
+    if (ring != nullptr) {
+        timestamp = stamp();
+        ring->push(frame, size, timestamp);
+    }
+    if (frame->can_id & CAN_RTR_FLAG) return;
+    bool error = frame->can_id & CAN_ERR_FLAG;
+    bool extended = frame->can_id & CAN_EFF_FLAG;
+    const MessageSpec *spec = error ? nullptr : find(frame->can_id);
+    if (spec == nullptr && !error) {
+        unknown_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Decoded d;
+    // Error frames go back raw with CAN_ERR_FLAG kept, for the service's error monitor
+    d.id = error ? frame->can_id & (CAN_ERR_FLAG | CAN_ERR_MASK)
+                 : frame->can_id & (extended ? CAN_EFF_MASK : CAN_SFF_MASK);
+    d.len = frame->len > CANFD_MAX_DLEN ? CANFD_MAX_DLEN : frame->len;
+    d.timestamp = timestamp >= 0.0 ? timestamp : stamp();
+    d.raw = error || spec->raw || d.len < spec->length;
+    emit(frame, d, spec);
+}
+
+template <class Emit>
+bool RxCore::receive(int timeout_ms, Emit &&emit)
+{
+    if (stopped_) return false;
+
+    if (handoff_) {
+        // Busy mode: the poller read and stamped the frames already
+        if (!take(timeout_ms)) return false;
+        std::lock_guard<std::mutex> lock(table_mutex_);
+        emit(nullptr, Decoded{}, nullptr);
+        FrameRing *ring = ring_.get();
+        for (const RecordedFrame &f : taken_) {
+            deliver(&f.frame, f.size, ring, [&f] { return f.timestamp; }, emit);
+        }
+        return true;
+    }
+
+    pollfd fds[2] = {{fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+    int n = ::poll(fds, 2, timeout_ms);
+    if (n < 0) {
+        if (errno == EINTR) return true;
+        throw std::system_error(errno, std::generic_category(), "poll");
+    }
+    if (fds[1].revents & POLLIN) {
+        stopped_ = true;
+        return false;
+    }
+    // POLLERR alone is a pending socket error (ENETDOWN when the interface went down): recvmmsg reports it
+    if (!(fds[0].revents & (POLLIN | POLLERR))) return true;
+
+    // recvmmsg writes msg_len, msg_flags and msg_controllen; the rest stays as set up
+    for (auto &h : hdrs_) h.msg_hdr.msg_controllen = kControlLen;
+    int count = recvmmsg(fd_, hdrs_.data(), (unsigned)batch_, MSG_DONTWAIT, nullptr);
+    if (count < 0) {
+        if (errno == EAGAIN || errno == EINTR) return true;
+        throw std::system_error(errno, std::generic_category(), "recvmmsg");
+    }
+
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    emit(nullptr, Decoded{}, nullptr);  // sizes the output for this table
+    FrameRing *ring = ring_.get();
+    for (int i = 0; i < count; i++) {
+        if (hdrs_[i].msg_len != CAN_MTU && hdrs_[i].msg_len != CANFD_MTU) continue;
+        // can_frame and canfd_frame share the id, len and data offsets
+        const auto *frame = reinterpret_cast<const canfd_frame *>(buf_.data() + i * CANFD_MTU);
+        deliver(frame, hdrs_[i].msg_len, ring, [this, i] { return stamp(hdrs_[i].msg_hdr); }, emit);
+    }
+    return true;
+}
+
+bool RxCore::poll(int timeout_ms, Batch &out)
+{
+    out.clear();
+    return receive(timeout_ms, [&](const canfd_frame *frame, Decoded d, const MessageSpec *spec) {
+        if (frame == nullptr) {
+            // Without allocating while the table is unchanged: batch_ frames of at most max_signals_ values
+            if (out.frames.capacity() < batch_) out.frames.reserve(batch_);
+            if (out.values.capacity() < batch_ * max_signals_) out.values.reserve(batch_ * max_signals_);
+            return;
+        }
+        std::memcpy(d.data, frame->data, d.len);
+        if (!d.raw) decode(*spec, d, out);
+        out.frames.push_back(d);
+    });
+}
+
+bool RxCore::poll(int timeout_ms, ColumnBatch &out)
+{
+    out.clear();
+    return receive(timeout_ms, [&](const canfd_frame *frame, const Decoded &d, const MessageSpec *spec) {
+        if (frame == nullptr) {
+            out.reserve(batch_, batch_ * max_signals_);
+            return;
+        }
+        const size_t row = out.size++;
+        out.id[row] = d.id;
+        out.timestamp[row] = d.timestamp;
+        out.length[row] = d.len;
+        out.raw[row] = d.raw;
+        uint8_t *data = out.data + row * ColumnBatch::kDataLen;
+        std::memcpy(data, frame->data, d.len);
+        std::memset(data + d.len, 0, ColumnBatch::kDataLen - d.len);
+        out.first[row] = uint32_t(out.value_count);
+        out.count[row] = 0;
+        if (d.raw) return;
+        uint64_t le, be;
+        load_words(spec->length, frame->data, le, be);
+        for (const SignalSpec &s : spec->signals) {
+            Value v = decode_signal(s, le, be);
+            out.kind[out.value_count] = v.kind;
+            std::memcpy(&out.value[out.value_count++], &v.u, sizeof(uint64_t));
+        }
+        out.count[row] = uint16_t(spec->signals.size());
+    });
+}
+
+double RxCore::stamp(msghdr &hdr)
+{
+    // Adapter time from SCM_TIMESTAMPING when it has one, else the kernel's receive time
+    double kernel = 0.0, hardware = 0.0;
+    for (cmsghdr *c = CMSG_FIRSTHDR(&hdr); c != nullptr; c = CMSG_NXTHDR(&hdr, c)) {
+        if (c->cmsg_level != SOL_SOCKET) continue;
+        if (c->cmsg_type == SCM_TIMESTAMPING) {
+            scm_timestamping ts;
+            std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            if (ts.ts[2].tv_sec || ts.ts[2].tv_nsec) hardware = ts.ts[2].tv_sec + ts.ts[2].tv_nsec * 1e-9;
+            else if (!kernel) kernel = ts.ts[0].tv_sec + ts.ts[0].tv_nsec * 1e-9;
+        } else if (c->cmsg_type == SCM_TIMESTAMPNS) {
+            timespec ts;
+            std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            kernel = ts.tv_sec + ts.tv_nsec * 1e-9;
+        } else if (c->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t dropped;
+            std::memcpy(&dropped, CMSG_DATA(c), sizeof(dropped));
+            dropped_.store(dropped, std::memory_order_relaxed);
+        }
+    }
+    return hardware ? hardware : kernel;
+}
+
+void RxCore::decode(const MessageSpec &spec, Decoded &d, Batch &out)
+{
+    uint64_t le, be;
+    load_words(spec.length, d.data, le, be);
+    d.first_value = out.values.size();
+    d.count = spec.signals.size();
+    for (const SignalSpec &s : spec.signals) out.values.push_back(decode_signal(s, le, be));
+}
+
+} // namespace td_can
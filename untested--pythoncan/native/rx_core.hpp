@@ -0,0 +1,182 @@
+#pragma once
+#include <linux/can.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "column_batch.hpp"
+#include "frame_ring.hpp"
+
+// Receive hot path of CanBusService: reads a bound CAN_RAW socket with recvmmsg, looks each
+// frame up in the dispatch table and decodes the signals the RX bindings read. Timestamps come
+// from the SO_TIMESTAMPNS / SO_TIMESTAMPING control messages the Python side enabled. Nothing here
+// touches Python; the module wrapper waits in poll() with the GIL released and converts a whole
+// batch at once.
+
+namespace td_can {
+
+// One signal, laid out by td_can_bridges.decoders.native_layout
+struct SignalSpec {
+    uint8_t shift = 0;       // LSB position in the payload read as one little- or big-endian integer
+    uint8_t length = 0;      // bits, 1..64
+    bool big_endian = false;
+    bool is_signed = false;
+    bool is_float = false;   // IEEE 754 of 32 or 64 bits
+    bool as_int = false;     // scale 1 and offset 0 on an integer signal: pass the raw value
+    double scale = 1.0;
+    double offset = 0.0;
+};
+
+struct MessageSpec {
+    uint8_t length = 0;             // DBC length; shorter payloads go to Python undecoded
+    bool raw = false;               // decoded in Python (multiplexed, choices, over 8 bytes)
+    std::vector<SignalSpec> signals;
+};
+
+// A decoded signal. It carries its own kind so a Batch stays readable after set_message()
+// replaced the spec it was decoded with.
+struct Value {
+    enum Kind : uint8_t { Float, Int, UInt };
+    Kind kind;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+    };
+};
+
+struct Decoded {
+    uint32_t id = 0;                // arbitration ID without flags; error frames keep CAN_ERR_FLAG
+    bool raw = false;               // data holds the payload, values are not filled in
+    uint8_t len = 0;
+    double timestamp = 0.0;         // receive time in seconds, 0 when the socket gave none
+    uint8_t data[64];
+    size_t first_value = 0;         // into Batch::values
+    size_t count = 0;               // values decoded
+};
+
+struct Batch {
+    std::vector<Decoded> frames;
+    std::vector<Value> values;
+    void clear()
+    {
+        frames.clear();
+        values.clear();
+    }
+};
+
+class RxCore {
+public:
+    static constexpr size_t kControlLen = 128;  // SCM_TIMESTAMPNS, SCM_TIMESTAMPING and SO_RXQ_OVFL
+
+    // fd is a bound CAN_RAW socket owned by the caller; batch is the most frames per recvmmsg
+    RxCore(int fd, size_t batch);
+    ~RxCore();
+    RxCore(const RxCore &) = delete;
+    RxCore &operator=(const RxCore &) = delete;
+
+    // Replaces the entry for the frame ID; safe against a concurrent poll(). With a mask narrower
+    // than CAN_EFF_MASK the entry matches every ID whose masked bits equal id's. Exact IDs are
+    // looked up first, then the masks from the most specific down.
+    void set_message(uint32_t id, bool extended, MessageSpec spec, uint32_t mask = CAN_EFF_MASK);
+    // Drops the entry set_message made for the same id and mask; frames of it count as unknown again
+    void remove_message(uint32_t id, bool extended, uint32_t mask = CAN_EFF_MASK);
+    void clear();
+
+    // Every frame read from now on, of any ID, is also pushed to ring (nullptr: none); for the
+    // recorder. Safe against a concurrent poll().
+    void set_recorder(std::shared_ptr<FrameRing> ring);
+
+    // Waits up to timeout_ms (-1 forever) and decodes every queued frame of a known ID into out.
+    // Returns false once stop() was called.
+    bool poll(int timeout_ms, Batch &out);
+    // ... into columns instead: out grows to a full batch of the widest message set, then stays
+    bool poll(int timeout_ms, ColumnBatch &out);
+    // Recycles the ColumnBatch arenas of this core; shared, as Python views may outlive the core
+    const std::shared_ptr<BatchPool> &pool() const { return pool_; }
+
+    // Makes a blocked poll() return false; callable from any thread
+    void stop();
+
+    // Busy-poll mode (busy_poll.hpp), set before the core is added to a BusyPoller: from then on
+    // the poller reads the socket and poll() takes the frames from a ring of ring_frames. poll()
+    // spins on an empty ring for spin_us (-1: until a frame or stop()) before it sleeps until the
+    // poller has more. A read error of the poller's is thrown by poll() once the ring is empty.
+    void set_busy(size_t ring_frames, int spin_us);
+    bool busy() const { return handoff_ != nullptr; }
+    // BusyPoller side: one non-blocking read into the ring. The frames read, 0 when none was
+    // queued, -1 once a read failed.
+    int pump();
+    // Frames pump() read while the ring was full, lost
+    uint64_t busy_dropped() const { return handoff_ ? handoff_->dropped() : 0; }
+
+    // Sizes out for a full batch of the widest message set so far, so poll() does not allocate.
+    // poll() calls it too; a set_message() with more signals than before grows out once more.
+    void reserve(Batch &out);
+
+    uint64_t frames() const { return frames_.load(std::memory_order_relaxed); }
+    uint64_t unknown() const { return unknown_.load(std::memory_order_relaxed); }
+    // Last SO_RXQ_OVFL count: frames the kernel dropped on a full socket buffer (0 unless enabled)
+    uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // Decodes d.data with spec, appending the values to out; what poll() runs for each known frame.
+    // Also for readers of their own sockets (tritoncan_top): d.len must be at least spec.length.
+    static void decode(const MessageSpec &spec, Decoded &d, Batch &out);
+
+private:
+    // Waits, reads a batch and calls emit(frame, d, spec) for every frame of a known ID, d without
+    // values and spec nullptr for error frames, under table_mutex_; false once stopped
+    template <class Emit>
+    bool receive(int timeout_ms, Emit &&emit);
+    // One received frame: counts, records and looks it up, then emit()s it; stamp() gives its time
+    template <class Stamp, class Emit>
+    void deliver(const canfd_frame *frame, uint32_t size, FrameRing *ring, Stamp &&stamp, Emit &emit);
+    // Busy mode: waits up to timeout_ms for the ring and moves what it holds to taken_; false
+    // once stopped
+    bool take(int timeout_ms);
+
+    static uint32_t key(uint32_t id, bool extended);
+    const MessageSpec *find(uint32_t can_id) const;
+
+    struct MaskedTable {
+        uint32_t mask;                                   // without the EFF flag
+        std::unordered_map<uint32_t, MessageSpec> table; // key(id & mask, extended)
+    };
+    // Receive time of one frame; also records an SO_RXQ_OVFL count found next to it
+    double stamp(msghdr &hdr);
+
+    int fd_;
+    int wake_fd_;
+    size_t batch_;
+    bool stopped_ = false;
+    std::vector<uint8_t> buf_;       // batch_ slots of CANFD_MTU
+    std::vector<uint8_t> control_;   // batch_ slots of kControlLen for the timestamps
+    std::vector<iovec> iov_;
+    std::vector<mmsghdr> hdrs_;
+    std::mutex table_mutex_;    // held by poll() while it decodes
+    std::unordered_map<uint32_t, MessageSpec> table_;
+    std::vector<MaskedTable> masked_;   // most bits set first
+    std::shared_ptr<FrameRing> ring_;   // under table_mutex_
+    size_t max_signals_ = 0;            // most signals of any entry, under table_mutex_
+    std::atomic<uint64_t> frames_{0};   // frames received
+    std::atomic<uint64_t> unknown_{0};  // of which no table entry matched
+    std::atomic<uint32_t> dropped_{0};
+    std::shared_ptr<BatchPool> pool_ = std::make_shared<BatchPool>();
+
+    // Busy mode
+    std::unique_ptr<FrameRing> handoff_;  // filled by pump() on the poller's thread
+    int64_t spin_ns_ = 0;
+    int ready_fd_ = -1;                   // eventfd pump() writes when poll() sleeps
+    std::atomic<bool> sleeping_{false};
+    std::atomic<bool> stopping_{false};   // stop() for a spinning poll()
+    std::atomic<int> error_{0};           // errno of the poller's failed read
+    std::vector<RecordedFrame> taken_;
+};
+
+} // namespace td_can
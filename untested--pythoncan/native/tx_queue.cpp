@@ -0,0 +1,324 @@
+#include "tx_queue.hpp"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+namespace td_can {
+namespace {
+
+constexpr int64_t kRetryNs = 500'000;   // kernel queue full (ENOBUFS): retry after, as TxScheduler does
+constexpr int64_t kBlockStepNs = 50'000;
+
+int64_t now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+void sleep_ns(int64_t ns)
+{
+    timespec ts{time_t(ns / 1'000'000'000), long(ns % 1'000'000'000)};
+    nanosleep(&ts, nullptr);
+}
+
+void store_max(std::atomic<uint64_t> &target, uint64_t value)
+{
+    uint64_t seen = target.load(std::memory_order_relaxed);
+    while (value > seen && !target.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+struct TxQueue::Lane {
+    struct Cell {
+        std::atomic<uint64_t> seq;
+        TxFrame f;
+    };
+
+    Lane(const TxLaneSpec &s, size_t batch) : spec(s), staged(new TxFrame[batch])
+    {
+        size_t n = 1;
+        while (n < s.capacity) n <<= 1;
+        cells.reset(new Cell[n]);
+        mask = n - 1;
+        for (size_t i = 0; i < n; i++) cells[i].seq.store(i, std::memory_order_relaxed);
+        tokens = double(std::max(1u, s.burst));
+    }
+
+    // Any thread. A cell is free for position pos when its seq is pos, and holds the frame of
+    // pos once it is pos + 1; a pop hands it to position pos + capacity.
+    bool try_push(const void *frame, uint32_t size, int64_t now)
+    {
+        uint64_t pos = enq.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &c = cells[pos & mask];
+            int64_t dif = int64_t(c.seq.load(std::memory_order_acquire) - pos);
+            if (dif == 0) {
+                if (enq.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    std::memcpy(&c.f.frame, frame, size);
+                    c.f.size = size;
+                    c.f.queued_ns = now;
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false;  // full
+            } else {
+                pos = enq.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // The TX thread, and producers dropping the oldest frame of a Latest lane
+    bool try_pop(TxFrame &out)
+    {
+        uint64_t pos = deq.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &c = cells[pos & mask];
+            int64_t dif = int64_t(c.seq.load(std::memory_order_acquire) - (pos + 1));
+            if (dif == 0) {
+                if (deq.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    out = c.f;
+                    c.seq.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false;  // empty, or the next frame is still being copied in
+            } else {
+                pos = deq.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    uint64_t queued() const
+    {
+        uint64_t d = deq.load(std::memory_order_acquire);
+        uint64_t e = enq.load(std::memory_order_acquire);
+        return e > d ? e - d : 0;
+    }
+
+    // Refill the bucket; ns until a frame may go, 0 when one may go now
+    int64_t wait_for_token(int64_t now)
+    {
+        if (spec.rate_hz <= 0) return 0;
+        double burst = double(std::max(1u, spec.burst));
+        if (refilled_ns) tokens = std::min(burst, tokens + double(now - refilled_ns) * 1e-9 * spec.rate_hz);
+        refilled_ns = now;
+        return tokens >= 1.0 ? 0 : int64_t((1.0 - tokens) / spec.rate_hz * 1e9) + 1;
+    }
+
+    TxLaneSpec spec;
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    // Written by every producer, by the TX thread, and by both: on separate cache lines
+    alignas(64) std::atomic<uint64_t> enq{0};
+    alignas(64) std::atomic<uint64_t> deq{0};
+    alignas(64) std::atomic<uint64_t> max_depth{0};
+    std::atomic<uint64_t> dropped{0};
+    // TX thread only; the atomics are read by stats()
+    alignas(64) std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> wait_sum{0};
+    std::atomic<uint64_t> wait_max{0};
+    std::atomic<uint64_t> staged_depth{0};
+    // Frames taken off the ring and not yet accepted by the kernel, oldest at staged_head
+    std::unique_ptr<TxFrame[]> staged;
+    size_t staged_head = 0;
+    size_t staged_count = 0;
+    double tokens = 1.0;
+    int64_t refilled_ns = 0;
+};
+
+TxQueue::TxQueue(int fd, const std::vector<TxLaneSpec> &lanes, size_t batch)
+    : fd_(fd), batch_(std::max<size_t>(1, batch))
+{
+    for (const TxLaneSpec &spec : lanes) lanes_.push_back(std::make_unique<Lane>(spec, batch_));
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd_ < 0) throw std::system_error(errno, std::generic_category(), "eventfd");
+    thread_ = std::thread(&TxQueue::run, this);
+}
+
+TxQueue::~TxQueue()
+{
+    stop(0.0);
+    close(event_fd_);
+}
+
+TxQueue::Result TxQueue::push(size_t lane, const void *frame, uint32_t size)
+{
+    if (stopping_.load(std::memory_order_acquire)) return Stopped;
+    Lane &l = *lanes_[lane];
+    const int64_t now = now_ns();
+    while (!l.try_push(frame, size, now)) {
+        if (l.spec.overflow == TxOverflow::Block) return Full;
+        l.dropped.fetch_add(1, std::memory_order_relaxed);
+        if (l.spec.overflow == TxOverflow::Error) return Dropped;
+        TxFrame oldest;
+        if (!l.try_pop(oldest)) l.dropped.fetch_sub(1, std::memory_order_relaxed);  // the TX thread took it
+    }
+    store_max(l.max_depth, l.queued());
+    wake();
+    return Queued;
+}
+
+TxQueue::Result TxQueue::push_wait(size_t lane, const void *frame, uint32_t size, double timeout_s)
+{
+    const int64_t deadline = timeout_s < 0 ? INT64_MAX : now_ns() + int64_t(timeout_s * 1e9);
+    while (true) {
+        Result r = push(lane, frame, size);
+        if (r != Full || now_ns() >= deadline) return r;
+        sleep_ns(kBlockStepNs);
+    }
+}
+
+void TxQueue::wake()
+{
+    // Pairs with the fence in sleep(): either the TX thread sees the frame or this sees it asleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed) && sleeping_.exchange(false, std::memory_order_acq_rel)) {
+        uint64_t one = 1;
+        (void)!write(event_fd_, &one, sizeof(one));
+    }
+}
+
+void TxQueue::sleep(int64_t timeout_ns)
+{
+    sleeping_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (pending() && timeout_ns < 0) timeout_ns = kBlockStepNs;  // a push still copying its frame in
+    if (!stopping_.load(std::memory_order_acquire)) {
+        timespec ts{time_t(timeout_ns / 1'000'000'000), long(timeout_ns % 1'000'000'000)};
+        pollfd p{event_fd_, POLLIN, 0};
+        ppoll(&p, 1, timeout_ns < 0 ? nullptr : &ts, nullptr);
+        uint64_t count;
+        (void)!read(event_fd_, &count, sizeof(count));
+    }
+    sleeping_.store(false, std::memory_order_relaxed);
+}
+
+size_t TxQueue::pending() const
+{
+    size_t n = 0;
+    for (const auto &l : lanes_) n += l->queued() + l->staged_depth.load(std::memory_order_relaxed);
+    return n;
+}
+
+void TxQueue::run()
+{
+    std::vector<mmsghdr> msgs(batch_);
+    std::vector<iovec> iov(batch_);
+    std::vector<size_t> lane_of(batch_);
+    for (size_t i = 0; i < batch_; i++) {
+        std::memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (true) {
+        const int64_t now = now_ns();
+        int64_t wait_ns = -1;  // until the next capped lane may send; -1: no cap holds a frame back
+        size_t n = 0;
+        auto add = [&](TxFrame &f, size_t lane) {
+            iov[n].iov_base = &f.frame;
+            iov[n].iov_len = f.size;
+            lane_of[n++] = lane;
+        };
+        // Highest lane first: what the kernel refused last round, then new frames under the cap
+        for (size_t li = 0; li < lanes_.size(); li++) {
+            Lane &l = *lanes_[li];
+            for (size_t i = 0; i < l.staged_count && n < batch_; i++) add(l.staged[(l.staged_head + i) % batch_], li);
+            while (n < batch_ && l.staged_count < batch_ && l.queued()) {
+                int64_t delay = l.wait_for_token(now);
+                if (delay) {
+                    wait_ns = wait_ns < 0 ? delay : std::min(wait_ns, delay);
+                    break;
+                }
+                TxFrame &slot = l.staged[(l.staged_head + l.staged_count) % batch_];
+                if (!l.try_pop(slot)) break;
+                if (l.spec.rate_hz > 0) l.tokens -= 1.0;
+                l.staged_count++;
+                add(slot, li);
+            }
+            l.staged_depth.store(l.staged_count, std::memory_order_relaxed);
+        }
+
+        const bool stopping = stopping_.load(std::memory_order_acquire);
+        const int64_t drain_until = drain_until_ns_.load(std::memory_order_relaxed);
+        if (n == 0) {
+            if (stopping && (now >= drain_until || !pending())) return;
+            if (stopping) wait_ns = wait_ns < 0 ? drain_until - now : std::min(wait_ns, drain_until - now);
+            sleep(wait_ns);
+            continue;
+        }
+
+        int sent = sendmmsg(fd_.load(std::memory_order_acquire), msgs.data(), unsigned(n), MSG_DONTWAIT);
+        if (sent < 0) {
+            int err = errno;
+            if (err == EINTR) continue;
+            if (err == ENOBUFS || err == EAGAIN) {
+                if (stopping && now >= drain_until) return;
+                sleep_ns(kRetryNs);
+                continue;
+            }
+            // Any other error fails the first frame only; drop it, as TxScheduler logs and drops
+            last_errno_.store(err, std::memory_order_relaxed);
+            Lane &l = *lanes_[lane_of[0]];
+            l.errors.fetch_add(1, std::memory_order_relaxed);
+            l.staged_head = (l.staged_head + 1) % batch_;
+            l.staged_count--;
+            l.staged_depth.store(l.staged_count, std::memory_order_relaxed);
+            continue;
+        }
+
+        const int64_t done = now_ns();
+        for (int i = 0; i < sent; i++) {
+            Lane &l = *lanes_[lane_of[i]];
+            const TxFrame &f = l.staged[l.staged_head];
+            uint64_t wait = uint64_t(std::max<int64_t>(0, done - f.queued_ns));
+            l.wait_sum.fetch_add(wait, std::memory_order_relaxed);
+            store_max(l.wait_max, wait);
+            l.sent.fetch_add(1, std::memory_order_relaxed);
+            l.staged_head = (l.staged_head + 1) % batch_;
+            l.staged_count--;
+        }
+        for (auto &l : lanes_) l->staged_depth.store(l->staged_count, std::memory_order_relaxed);
+    }
+}
+
+size_t TxQueue::stop(double drain_s)
+{
+    if (thread_.joinable()) {
+        drain_until_ns_.store(now_ns() + int64_t(std::max(0.0, drain_s) * 1e9), std::memory_order_relaxed);
+        stopping_.store(true, std::memory_order_release);
+        uint64_t one = 1;
+        (void)!write(event_fd_, &one, sizeof(one));
+        thread_.join();
+    }
+    return pending();
+}
+
+TxLaneStats TxQueue::stats(size_t lane) const
+{
+    const Lane &l = *lanes_[lane];
+    TxLaneStats s;
+    s.depth = l.queued() + l.staged_depth.load(std::memory_order_relaxed);
+    s.max_depth = l.max_depth.load(std::memory_order_relaxed);
+    s.sent = l.sent.load(std::memory_order_relaxed);
+    s.dropped = l.dropped.load(std::memory_order_relaxed);
+    s.errors = l.errors.load(std::memory_order_relaxed);
+    s.wait_ns_sum = l.wait_sum.load(std::memory_order_relaxed);
+    s.wait_ns_max = l.wait_max.load(std::memory_order_relaxed);
+    return s;
+}
+
+} // namespace td_can
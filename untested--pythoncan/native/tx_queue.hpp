@@ -0,0 +1,90 @@
+#pragma once
+#include <linux/can.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Transmit side of the native core: one queue per bus that any number of threads push frames to,
+// and one TX thread that drains them into sendmmsg. Each priority lane is a bounded lock-free
+// ring (Vyukov's: a sequence number per cell, one CAS per push), so a producer never takes a
+// lock and never waits on the socket; it copies its frame into a cell and, when the TX thread is
+// asleep, writes an eventfd. The TX thread takes up to a batch of frames per round, highest lane
+// first, and keeps what the kernel refused (ENOBUFS) at the front of its lane. A frame queued
+// later in a higher lane still goes ahead of them. Lanes may cap their rate with a token bucket.
+
+namespace td_can {
+
+// What push() does with a frame for a full lane, as the Python TX classes' overflow policies
+enum class TxOverflow : uint8_t {
+    Block,   // the caller waits for room (push_wait), or gets Full
+    Latest,  // the oldest queued frame is dropped to make room
+    Error,   // the new frame is dropped
+};
+
+struct TxLaneSpec {
+    size_t capacity = 256;  // rounded up to a power of two
+    double rate_hz = 0.0;   // frames per second, 0: uncapped
+    unsigned burst = 8;     // frames the cap lets through back to back
+    TxOverflow overflow = TxOverflow::Block;
+};
+
+struct TxFrame {
+    canfd_frame frame;   // classic frames use the can_frame prefix
+    uint32_t size = 0;   // CAN_MTU or CANFD_MTU
+    int64_t queued_ns;   // CLOCK_MONOTONIC at push
+};
+
+struct TxLaneStats {
+    uint64_t depth, max_depth, sent, dropped, errors;
+    uint64_t wait_ns_sum, wait_ns_max;  // from push to sendmmsg, of the frames sent
+};
+
+class TxQueue {
+public:
+    enum Result { Queued, Full, Dropped, Stopped };
+
+    // fd is a bound CAN_RAW socket owned by the caller; lanes in priority order, highest first;
+    // batch is the most frames per sendmmsg. Starts the TX thread.
+    TxQueue(int fd, const std::vector<TxLaneSpec> &lanes, size_t batch);
+    ~TxQueue();
+    TxQueue(const TxQueue &) = delete;
+    TxQueue &operator=(const TxQueue &) = delete;
+
+    // Any thread: copy the frame (size CAN_MTU or CANFD_MTU) into its lane
+    Result push(size_t lane, const void *frame, uint32_t size);
+    // ... and for a Block lane wait in 50 us steps until there is room, up to timeout_s (< 0: no limit)
+    Result push_wait(size_t lane, const void *frame, uint32_t size, double timeout_s);
+
+    // Send what is queued for up to drain_s, then stop the TX thread; returns the frames not sent
+    size_t stop(double drain_s);
+    // Write to another socket (a reopened bus) from the next round on
+    void set_fd(int fd) { fd_.store(fd, std::memory_order_release); }
+
+    size_t lanes() const { return lanes_.size(); }
+    TxLaneStats stats(size_t lane) const;
+    int last_errno() const { return last_errno_.load(std::memory_order_relaxed); }
+
+private:
+    struct Lane;
+
+    void run();
+    void wake();
+    void sleep(int64_t timeout_ns);
+    size_t pending() const;
+
+    std::atomic<int> fd_;
+    size_t batch_;
+    std::vector<std::unique_ptr<Lane>> lanes_;
+    int event_fd_ = -1;
+    alignas(64) std::atomic<bool> sleeping_{false};  // the TX thread waits on event_fd_
+    std::atomic<bool> stopping_{false};
+    std::atomic<int64_t> drain_until_ns_{0};
+    std::atomic<int> last_errno_{0};
+    std::thread thread_;
+};
+
+} // namespace td_can
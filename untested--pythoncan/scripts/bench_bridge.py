@@ -0,0 +1,371 @@
+#!/usr/bin/env python3
+"""End-to-end bridge benchmark on vcan, written as JSON to diff across commits.
+
+A child process generates FootForce frames on the interface through
+``td_can_bridges.replay`` at each rate of ``--rates`` while this process
+receives them, and four measurements are made:
+
+* ``rx``: CanBusService per RX mode: frames received and lost, receive rate,
+  CPU milliseconds per 1000 frames (all threads of this process) and the
+  time from the kernel's receive timestamp to the handler. ``sustained_fps``
+  is the highest receive rate with no frame lost.
+* ``ros``: the same stream through the bridge's BusWorker and RxBinding to a
+  stamped ``sensor_msgs/Temperature`` topic; latency runs from the kernel's
+  receive timestamp (the message's header stamp) to the subscriber's
+  callback. Skipped without rclpy.
+* ``tx``: time from ``send()`` (and, with rclpy, from publishing on the TX
+  topic) until the frame is on the interface, taken from the kernel
+  timestamp of a second socket, one frame at a time.
+* ``replay``: with ``--log``, a recorded log replayed at ``--speed`` and
+  counted by a raw handler.
+
+    sudo python3 scripts/bench_bridge.py --setup-vcan --interface vcan0 --output bench.json
+    python3 scripts/bench_bridge.py --interface vcan0 --rates 1000 10000 0 --modes direct native
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import multiprocessing
+import os
+import platform
+import socket
+import struct
+import subprocess
+import sys
+import threading
+import time
+from pathlib import Path
+from typing import Any, Callable, Dict, List, Optional
+
+from td_can_bridges.replay import LogFrame, Replayer, read_log
+from td_can_bridges.service import BusConfig, CanBusService, RX_MODES, RxBindingConfig, TxBindingConfig
+from td_can_bridges.socketcan_rx import BatchReceiver, enable_timestamps
+
+ROOT = Path(__file__).resolve().parents[1]
+DBC = ROOT / "td_can_bridges" / "schemas" / "sensors.dbc"
+RX_ID = 512  # FootForce: forceN carries the sequence number
+TX_ID = 513  # Sensors_Calib: mode carries the sequence number
+MAX_RATE_FRAMES = 100_000  # frames sent at rate 0 (as fast as possible)
+
+
+def percentiles(values: List[float], points=(50, 90, 99, 99.9)) -> Dict[str, float]:
+    if not values:
+        return {}
+    ordered = sorted(values)
+    out = {f"p{p:g}": ordered[min(len(ordered) - 1, int(len(ordered) * p / 100.0))] for p in points}
+    out["max"] = ordered[-1]
+    return out
+
+
+def setup_vcan(interface: str) -> None:
+    """Create and bring up ``interface`` as a vcan device unless it exists."""
+
+    if (Path("/sys/class/net") / interface).exists():
+        return
+    sudo = [] if os.geteuid() == 0 else ["sudo"]
+    subprocess.run(sudo + ["ip", "link", "add", "dev", interface, "type", "vcan"], check=True)
+    subprocess.run(sudo + ["ip", "link", "set", interface, "up"], check=True)
+
+
+def _generate(interface: str, rate: float, frames: int, start, result) -> None:
+    stream = (
+        LogFrame(i / rate if rate > 0 else 0.0, "", RX_ID, struct.pack("<H6x", i & 0xFFFF))
+        for i in range(frames)
+    )
+    with Replayer(interface=interface, speed=1.0 if rate > 0 else 0.0) as replayer:
+        start.wait()
+        stats = replayer.run(stream)
+    result.put({
+        "sent": stats.frames,
+        "tx_fps": stats.achieved_rate,
+        "lateness_us": percentiles(stats.lateness_us),
+    })
+
+
+def drive(interface: str, rate: float, seconds: float, count: Callable[[], int]) -> Dict[str, Any]:
+    """Send a stream at ``rate`` from a child process; returns its stats and the CPU used here meanwhile."""
+
+    frames = int(rate * seconds) if rate > 0 else MAX_RATE_FRAMES
+    start = multiprocessing.Event()
+    result = multiprocessing.Queue()
+    child = multiprocessing.Process(target=_generate, args=(interface, rate, frames, start, result))
+    child.start()
+    time.sleep(0.1)  # the child's socket is bound before the clock starts
+    begin = count()
+    cpu0 = time.process_time()
+    start.set()
+    sent = result.get()
+    child.join()
+    # Let the receiver drain what is still queued
+    idle_since, seen = time.perf_counter(), -1
+    while time.perf_counter() - idle_since < 0.5:
+        time.sleep(0.05)
+        if count() != seen:
+            seen = count()
+            idle_since = time.perf_counter()
+    sent["requested_fps"] = rate or None
+    sent["frames"] = frames
+    sent["cpu_s"] = time.process_time() - cpu0
+    sent["received"] = count() - begin
+    return sent
+
+
+def _row(sent: Dict[str, Any], latencies: List[float], first: float, last: float) -> Dict[str, Any]:
+    received = sent["received"]
+    span = last - first
+    return {
+        "requested_fps": sent["requested_fps"],
+        "sent": sent["sent"],
+        "tx_fps": round(sent["tx_fps"], 1),
+        "received": received,
+        "lost": sent["sent"] - received,
+        "rx_fps": round(received / span, 1) if span > 0 else 0.0,
+        "cpu_ms_per_1k": round(sent["cpu_s"] * 1e6 / received, 3) if received else None,
+        "latency_us": {k: round(v * 1e6, 1) for k, v in percentiles(latencies).items()},
+        "generator_lateness_us": {k: round(v, 1) for k, v in sent["lateness_us"].items()},
+    }
+
+
+def _sustained(rows: List[Dict[str, Any]]) -> Optional[float]:
+    lossless = [row["rx_fps"] for row in rows if row["lost"] == 0 and row["received"]]
+    return max(lossless) if lossless else None
+
+
+class _Probe:
+    """Counts frames and collects latencies from the handler thread."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.count = 0
+        self.first = self.last = 0.0
+        self.latencies: List[float] = []
+
+    def reset(self) -> None:
+        with self.lock:
+            self.first = self.last = 0.0
+            self.latencies = []
+
+    def hit(self, latency: float) -> None:
+        now = time.perf_counter()
+        with self.lock:
+            if not self.first:
+                self.first = now
+            self.last = now
+            self.count += 1
+            self.latencies.append(latency)
+
+    def total(self) -> int:
+        return self.count
+
+
+def bench_rx(args, mode: str) -> Dict[str, Any]:
+    binding = RxBindingConfig(key="force", message="FootForce", fields={"forceN": "data"})
+    cfg = BusConfig(name=f"bench-{mode}", interface=args.interface, dbc_file=DBC, rx_mode=mode,
+                    rx_batch=args.batch, rx_bindings={"force": binding})
+    service = CanBusService(cfg)
+    probe = _Probe()
+    service.register_rx_binding(binding, lambda payload, b, timestamp: probe.hit(time.time() - timestamp))
+    service.start()
+    time.sleep(0.2)
+    rows = []
+    try:
+        for rate in args.rates:
+            probe.reset()
+            sent = drive(args.interface, rate, args.seconds, probe.total)
+            rows.append(_row(sent, probe.latencies, probe.first, probe.last))
+            print(f"  rx {mode:<8} {rate or 'max':>8}: {rows[-1]['received']:>8} received, {rows[-1]['lost']:>6} lost, "
+                  f"{rows[-1]['rx_fps']:>10.0f} fps, {rows[-1]['cpu_ms_per_1k']} ms CPU/1k")
+    finally:
+        service.shutdown()
+    return {"rates": rows, "sustained_fps": _sustained(rows)}
+
+
+def _wire_latency(interface: str, send: Callable[[int], None], count: int, period: float) -> Dict[str, Any]:
+    """Call ``send(seq)`` ``count`` times and time each until its frame reaches a second socket."""
+
+    sock = socket.socket(socket.AF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+    sock.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_FILTER, struct.pack("=II", TX_ID, 0x7FF))
+    sock.bind((interface,))
+    enable_timestamps(sock)
+    receiver = BatchReceiver(sock, 8)
+    latencies, lost = [], 0
+    try:
+        for i in range(count):
+            seq = i & 0x7F
+            began = time.time()
+            send(seq)
+            deadline = time.monotonic() + 0.1
+            while time.monotonic() < deadline:
+                hits = [stamp for can_id, data, stamp in receiver.recv(0.01) if data[:1] == bytes((seq,))]
+                if hits:
+                    latencies.append(hits[0] - began)
+                    break
+            else:
+                lost += 1
+            time.sleep(period)
+    finally:
+        receiver.close()
+        sock.close()
+    return {"sent": count, "lost": lost, "latency_us": {k: round(v * 1e6, 1) for k, v in percentiles(latencies).items()}}
+
+
+def bench_tx(args) -> Dict[str, Any]:
+    binding = TxBindingConfig(key="calib", message="Sensors_Calib", fields={"data": "mode"})
+    cfg = BusConfig(name="bench-tx", interface=args.interface, dbc_file=DBC, tx_bindings={"calib": binding})
+    service = CanBusService(cfg)
+    service.register_tx_binding(binding)
+    try:
+        result = _wire_latency(args.interface, lambda seq: service.send("calib", {"data": seq}),
+                               args.tx_count, 1.0 / args.tx_rate)
+    finally:
+        service.shutdown()
+    print(f"  tx send()->wire: {result['latency_us']}")
+    return result
+
+
+def bench_ros(args) -> Dict[str, Any]:
+    try:
+        import rclpy
+        from rclpy.executors import MultiThreadedExecutor
+        from sensor_msgs.msg import Temperature
+        from std_msgs.msg import Float32
+    except ImportError as exc:
+        return {"skipped": f"rclpy not available: {exc}"}
+    from td_can_bridges.bus_worker import BusWorker
+
+    rx = RxBindingConfig(key="force", message="FootForce", fields={"forceN": "temperature"},
+                         metadata={"topic": "/bench/force", "type": "sensor_msgs/msg/Temperature"})
+    tx = TxBindingConfig(key="calib", message="Sensors_Calib", fields={"data": "mode"},
+                         metadata={"topic": "/bench/calib"})
+    cfg = BusConfig(name="bench-ros", interface=args.interface, dbc_file=DBC, rx_mode=args.modes[0],
+                    rx_batch=args.batch, rx_bindings={"force": rx}, tx_bindings={"calib": tx})
+    rclpy.init()
+    node = rclpy.create_node("td_can_bench")
+    probe = _Probe()
+
+    def on_force(msg):
+        stamp = msg.header.stamp.sec + msg.header.stamp.nanosec * 1e-9
+        probe.hit(time.time() - stamp)
+
+    worker = BusWorker(node, cfg, {"sensor": {"depth": 1000}})
+    node.create_subscription(Temperature, "/bench/force", on_force, 1000)
+    publisher = node.create_publisher(Float32, "/bench/calib", 10)
+    executor = MultiThreadedExecutor()
+    executor.add_node(node)
+    spinner = threading.Thread(target=executor.spin, daemon=True)
+    spinner.start()
+    rows = []
+    try:
+        deadline = time.monotonic() + 5.0
+        while publisher.get_subscription_count() == 0 and time.monotonic() < deadline:
+            time.sleep(0.05)
+        for rate in args.rates:
+            probe.reset()
+            sent = drive(args.interface, rate, args.seconds, probe.total)
+            rows.append(_row(sent, probe.latencies, probe.first, probe.last))
+            print(f"  ros {rate or 'max':>8}: {rows[-1]['received']:>8} published, latency {rows[-1]['latency_us']}")
+        tx_result = _wire_latency(args.interface, lambda seq: publisher.publish(Float32(data=float(seq))),
+                                  args.tx_count, 1.0 / args.tx_rate)
+        print(f"  ros callback->wire: {tx_result['latency_us']}")
+    finally:
+        executor.shutdown()
+        worker.shutdown()
+        node.destroy_node()
+        rclpy.shutdown()
+    return {"rates": rows, "sustained_fps": _sustained(rows), "tx": tx_result}
+
+
+def bench_replay(args) -> Dict[str, Any]:
+    cfg = BusConfig(name="bench-replay", interface=args.interface, dbc_file=DBC, rx_mode=args.modes[0],
+                    rx_batch=args.batch)
+    service = CanBusService(cfg)
+    probe = _Probe()
+    service.register_raw_handler("count", 0, lambda can_id, data, timestamp: probe.hit(time.time() - timestamp), 0)
+    service.start()
+    time.sleep(0.2)
+    try:
+        with Replayer(interface=args.interface, speed=args.speed) as replayer:
+            cpu0 = time.process_time()
+            stats = replayer.run(read_log(args.log))
+            time.sleep(0.5)
+            cpu = time.process_time() - cpu0
+    finally:
+        service.shutdown()
+    result = {
+        "log": str(args.log),
+        "speed": args.speed,
+        "sent": stats.frames,
+        "received": probe.count,
+        "lost": stats.frames - probe.count,
+        "requested_fps": None if stats.requested_rate == float("inf") else round(stats.requested_rate, 1),
+        "tx_fps": round(stats.achieved_rate, 1),
+        "cpu_ms_per_1k": round(cpu * 1e6 / probe.count, 3) if probe.count else None,
+        "latency_us": {k: round(v * 1e6, 1) for k, v in percentiles(probe.latencies).items()},
+        "generator_lateness_us": {k: round(v, 1) for k, v in stats.lateness_percentiles().items()},
+    }
+    print(f"  replay: {stats.summary()}, {probe.count} received")
+    return result
+
+
+def _commit() -> Optional[str]:
+    try:
+        out = subprocess.run(["git", "rev-parse", "HEAD"], cwd=ROOT, capture_output=True, text=True, check=True)
+    except (OSError, subprocess.CalledProcessError):
+        return None
+    return out.stdout.strip()
+
+
+def build_arg_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="End-to-end CanBusService and td_can_bridge benchmark on vcan")
+    parser.add_argument("--interface", default="vcan0", help="vcan interface to run on.")
+    parser.add_argument("--setup-vcan", action="store_true", help="Create the interface first if it is missing.")
+    parser.add_argument("--rates", nargs="+", type=float, default=[1000, 5000, 10000, 20000, 50000, 0],
+                        help="Frames per second to sweep, 0 for as fast as possible.")
+    parser.add_argument("--seconds", type=float, default=2.0, help="Length of each rate step.")
+    parser.add_argument("--modes", nargs="+", choices=RX_MODES, default=["direct", "native"])
+    parser.add_argument("--batch", type=int, default=64, help="rx_batch.")
+    parser.add_argument("--tx-count", type=int, default=1000, help="Frames timed for the TX latency.")
+    parser.add_argument("--tx-rate", type=float, default=200.0, help="TX latency frames per second.")
+    parser.add_argument("--log", type=Path, help="Also replay this log and count what the service receives.")
+    parser.add_argument("--speed", type=float, default=1.0, help="Replay speed of --log, 0 for maximum.")
+    parser.add_argument("--skip", nargs="*", default=[], choices=["rx", "tx", "ros"], help="Sections to leave out.")
+    parser.add_argument("--output", type=Path, help="JSON results file; printed to stdout when not given.")
+    return parser
+
+
+def main(argv: list[str] | None = None) -> int:
+    args = build_arg_parser().parse_args(argv)
+    if args.setup_vcan:
+        setup_vcan(args.interface)
+    results: Dict[str, Any] = {
+        "commit": _commit(),
+        "host": platform.node(),
+        "python": platform.python_version(),
+        "kernel": platform.release(),
+        "interface": args.interface,
+        "seconds_per_rate": args.seconds,
+        "batch": args.batch,
+        "time": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+    }
+    if "rx" not in args.skip:
+        results["rx"] = {mode: bench_rx(args, mode) for mode in args.modes}
+    if "tx" not in args.skip:
+        results["tx"] = bench_tx(args)
+    if "ros" not in args.skip:
+        results["ros"] = bench_ros(args)
+    if args.log:
+        results["replay"] = bench_replay(args)
+
+    text = json.dumps(results, indent=2, sort_keys=True)
+    if args.output:
+        args.output.write_text(text + "\n")
+        print(f"results written to {args.output}")
+    else:
+        print(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,207 @@
+#!/usr/bin/env python3
+"""Compare cantools decoding with the C++ decoders of scripts/dbc_to_cpp.py.
+
+Generates the header of a DBC into a temporary directory with a small driver,
+builds it with ``--cxx`` (the bridge's flags: ``-O2 -ffp-contract=off``) and
+runs it on random payloads. Every value the C++ struct decodes from the
+first ``--check`` payloads is checked against ``msg_def.decode`` first. Then
+both are timed per frame: cantools on one payload, C++ over a block of
+``--block`` frames decoded ``--rounds`` times.
+
+    python3 scripts/bench_dbc_cpp.py --dbc td_can_bridges/schemas/motors.dbc
+"""
+
+from __future__ import annotations
+
+import argparse
+import math
+import os
+import shlex
+import subprocess
+import sys
+import tempfile
+import timeit
+from pathlib import Path
+
+import cantools
+
+from td_can_bridges.cpp_decoders import cpp_type, namespace_name, render_header, unsupported
+from td_can_bridges.ros_msgs import field_name, type_name
+
+ROOT = Path(__file__).resolve().parents[1]
+DEFAULT_DBC = ROOT / "td_can_bridges" / "schemas" / "motors.dbc"
+DEFAULT_INCLUDE = ROOT.parent / "td_can_bridge_cpp" / "include"
+
+_DRIVER_HEAD = """#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "generated.hpp"
+
+template <class T>
+static inline void keep(const T &value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+// ns per frame of M::decode over n payloads of M::length bytes, best of 5
+template <class M>
+static double bench(const std::vector<uint8_t> &block, size_t n, size_t rounds)
+{
+    double best = 0.0;
+    for (int run = 0; run < 5; run++) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < rounds; r++) {
+            const uint8_t *p = block.data();
+            for (size_t i = 0; i < n; i++, p += M::length) {
+                M m = M::decode(p);
+                keep(m);
+            }
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        ns /= double(n * rounds);
+        if (run == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+static std::vector<uint8_t> read_block(FILE *in, size_t bytes)
+{
+    std::vector<uint8_t> block(bytes);
+    if (fread(block.data(), 1, bytes, in) != bytes) {
+        fprintf(stderr, "short payload file\\n");
+        exit(2);
+    }
+    return block;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 5) return 2;
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) return 2;
+    const size_t n = strtoull(argv[2], nullptr, 0);
+    const size_t rounds = strtoull(argv[3], nullptr, 0);
+    const size_t check = strtoull(argv[4], nullptr, 0);
+"""
+
+
+def _print_field(signal) -> str:
+    name = field_name(signal.name)
+    kind = cpp_type(signal)
+    if kind == "double":
+        return f'printf(" %.17g", m.{name});'
+    if kind.startswith("u"):
+        return f'printf(" %" PRIu64, uint64_t(m.{name}));'
+    return f'printf(" %" PRId64, int64_t(m.{name}));'
+
+
+def render_driver(messages, namespace: str) -> str:
+    body = [_DRIVER_HEAD]
+    for msg in messages:
+        cls = f"td_can_bridge::{namespace}::{type_name(msg.name)}"
+        prints = " ".join(_print_field(s) for s in msg.signals)
+        body.append(f"""    {{
+        using M = {cls};
+        std::vector<uint8_t> block = read_block(in, n * M::length);
+        for (size_t i = 0; i < check; i++) {{
+            M m = M::decode(block.data() + i * M::length);
+            printf("value {msg.name} %zu", i);
+            {prints}
+            printf("\\n");
+        }}
+        printf("time {msg.name} %.3f\\n", bench<M>(block, n, rounds));
+    }}
+""")
+    body.append("    fclose(in);\n    return 0;\n}\n")
+    return "".join(body)
+
+
+def _same(a, b) -> bool:
+    if isinstance(a, float) or isinstance(b, float):
+        a, b = float(a), float(b)
+        return math.isclose(a, b, rel_tol=1e-12, abs_tol=1e-12) or (math.isnan(a) and math.isnan(b))
+    return a == b
+
+
+def _payloads(msg, count: int) -> list[bytes]:
+    """Random payloads of ``msg``; float signals get NaN and infinity patterns too."""
+
+    return [os.urandom(msg.length) for _ in range(count)]
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="DBC decode benchmark: cantools vs generated C++")
+    parser.add_argument("--dbc", type=Path, default=DEFAULT_DBC)
+    parser.add_argument("--cxx", default=os.environ.get("CXX", "c++"), help="C++17 compiler (default $CXX or c++).")
+    parser.add_argument("--cxxflags", default="-O2 -ffp-contract=off", help="Flags of the bridge's targets.")
+    parser.add_argument("--include", type=Path, default=DEFAULT_INCLUDE, help="Directory of td_can_bridge_cpp/.")
+    parser.add_argument("--number", type=int, default=20_000, help="cantools decodes per timing run.")
+    parser.add_argument("--block", type=int, default=4096, help="Payloads per C++ block.")
+    parser.add_argument("--rounds", type=int, default=200, help="Passes over the block per C++ timing run.")
+    parser.add_argument("--check", type=int, default=200, help="Payloads checked against cantools.")
+    args = parser.parse_args(argv)
+
+    db = cantools.database.load_file(str(args.dbc))
+    namespace = namespace_name(args.dbc.stem)
+    messages = [m for m in db.messages if unsupported(m) is None]
+    for msg in db.messages:
+        if msg not in messages:
+            print(f"{msg.name}: skipped, {unsupported(msg)}")
+    if not messages:
+        print("no message has a C++ decoder")
+        return 1
+    check = min(args.check, args.block)
+
+    with tempfile.TemporaryDirectory(prefix="td_can_dbc_") as tmp:
+        tmp = Path(tmp)
+        (tmp / "generated.hpp").write_text(render_header(messages, namespace, args.dbc.name))
+        (tmp / "driver.cpp").write_text(render_driver(messages, namespace))
+        blocks = {m.name: _payloads(m, args.block) for m in messages}
+        with open(tmp / "payloads.bin", "wb") as out:
+            for msg in messages:
+                out.write(b"".join(blocks[msg.name]))
+        exe = tmp / "driver"
+        cmd = [args.cxx, "-std=c++17", *shlex.split(args.cxxflags), f"-I{args.include}", f"-I{tmp}",
+               str(tmp / "driver.cpp"), "-o", str(exe)]
+        subprocess.run(cmd, check=True)
+        run = subprocess.run([str(exe), str(tmp / "payloads.bin"), str(args.block), str(args.rounds), str(check)],
+                             check=True, capture_output=True, text=True)
+
+    by_name = {m.name: m for m in messages}
+    cpp_ns = {}
+    checked = 0
+    for line in run.stdout.splitlines():
+        kind, name, *rest = line.split()
+        msg = by_name[name]
+        if kind == "time":
+            cpp_ns[name] = float(rest[0])
+            continue
+        row, values = int(rest[0]), rest[1:]
+        try:
+            expected = msg.decode(blocks[name][row], decode_choices=False)
+        except Exception:
+            continue  # cantools rejects it (a range or choice check); nothing to compare
+        for signal, text in zip(msg.signals, values):
+            got = float(text) if cpp_type(signal) == "double" else int(text)
+            if not _same(expected[signal.name], got):
+                raise AssertionError(f"{name}.{signal.name} row {row}: cantools {expected[signal.name]!r}, "
+                                     f"C++ {got!r}")
+        checked += 1
+    print(f"{checked} payloads agree with cantools\n")
+
+    print(f"{'message':<24}{'signals':>9}{'cantools ns':>13}{'C++ ns':>10}{'speed-up':>10}")
+    for msg in messages:
+        data = blocks[msg.name][0]
+        seconds = min(timeit.repeat(lambda: msg.decode(data, decode_choices=False), number=args.number, repeat=5))
+        ct = seconds * 1e9 / args.number
+        cpp = cpp_ns[msg.name]
+        speedup = f"{ct / cpp:>9.0f}x" if cpp > 0 else f"{'-':>10}"
+        print(f"{msg.name:<24}{len(msg.signals):>9}{ct:>13.1f}{cpp:>10.2f}{speedup}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Compare cantools decoding with the compiled decoders of td_can_bridges.decoders.
+
+For every message of a DBC, times the RX dispatch work per frame both ways:
+``msg_def.decode`` followed by the per-binding projection, and the compiled
+decoder followed by the same projection. Each compiled result is checked
+against cantools on random payloads first. With NumPy installed it also
+times td_can_bridges.batch.BatchDecoder on a block of ``--block`` frames, on the
+native core's SIMD kernel when it is built.
+
+    python3 scripts/bench_decode.py --dbc td_can_bridges/schemas/motors.dbc
+"""
+
+from __future__ import annotations
+
+import argparse
+import math
+import os
+import sys
+import timeit
+from pathlib import Path
+
+import cantools
+
+from td_can_bridges.decoders import compile_decoder
+
+DEFAULT_DBC = Path(__file__).resolve().parents[1] / "td_can_bridges" / "schemas" / "motors.dbc"
+
+
+def _same(a, b) -> bool:
+    if isinstance(a, float) and isinstance(b, float):
+        return math.isclose(a, b, rel_tol=1e-12, abs_tol=1e-12) or (math.isnan(a) and math.isnan(b))
+    return a == b
+
+
+def _payload(msg) -> tuple[bytes, dict]:
+    """A random payload cantools decodes; a multiplexed one needs a multiplexer value the DBC lists."""
+
+    for _ in range(10_000):
+        data = os.urandom(msg.length)
+        try:
+            return data, msg.decode(data)
+        except Exception:
+            continue
+    raise AssertionError(f"{msg.name}: no random payload decodes")
+
+
+def bench_message(msg, fields, number: int) -> tuple[float, float]:
+    decoder = compile_decoder(msg, fields or None)
+    for _ in range(200):
+        data, expected = _payload(msg)
+        got = decoder(data)
+        for name, value in got.items():
+            if not _same(expected[name], value):
+                raise AssertionError(f"{msg.name}.{name}: cantools {expected[name]!r}, compiled {value!r}")
+
+    data, _ = _payload(msg)
+    project = (lambda d: {f: d.get(f) for f in fields}) if fields else dict
+    cantools_s = min(timeit.repeat(lambda: project(msg.decode(data)), number=number, repeat=5))
+    compiled_s = min(timeit.repeat(lambda: project(decoder(data)), number=number, repeat=5))
+    return cantools_s * 1e6 / number, compiled_s * 1e6 / number
+
+
+def bench_block(msg, block: int) -> float:
+    import numpy as np
+
+    from td_can_bridges.batch import BatchDecoder
+
+    decoder = BatchDecoder(msg)
+    payloads = np.frombuffer(os.urandom(block * msg.length), dtype=np.uint8).reshape(block, msg.length)
+    columns = decoder.decode(payloads[:200])
+    for row in range(200):
+        expected = msg.decode(bytes(payloads[row]), decode_choices=False)
+        for name, values in columns.items():
+            if not _same(float(expected[name]), float(values[row])):
+                raise AssertionError(f"{msg.name}.{name} row {row}: cantools {expected[name]!r}, batch {values[row]!r}")
+    seconds = min(timeit.repeat(lambda: decoder.decode(payloads), number=1, repeat=5))
+    return seconds * 1e6 / block
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="DBC decode benchmark: cantools vs compiled")
+    parser.add_argument("--dbc", type=Path, default=DEFAULT_DBC)
+    parser.add_argument("--number", type=int, default=20_000, help="Decodes per timing run.")
+    parser.add_argument("--block", type=int, default=100_000, help="Frames per BatchDecoder block.")
+    args = parser.parse_args(argv)
+
+    db = cantools.database.load_file(str(args.dbc))
+    print(f"{'message':<24}{'signals':>9}{'cantools us':>13}{'compiled us':>13}{'speed-up':>10}")
+    for msg in db.messages:
+        compiled = compile_decoder(msg) is not msg.decode
+        # All signals, then a single-signal binding as in the example configs
+        for fields in ([], [msg.signals[0].name]):
+            c, f = bench_message(msg, fields, args.number)
+            label = msg.name if not fields else f"  {fields[0]}"
+            note = "" if compiled else " (cantools fallback)"
+            print(f"{label:<24}{len(fields) or len(msg.signals):>9}{c:>13.2f}{f:>13.2f}{c / f:>9.1f}x{note}")
+
+    try:
+        import numpy  # noqa: F401
+    except ImportError:
+        print("NumPy not installed; skipping the batch decoder")
+        return 0
+    from td_can_bridges.batch import _can_core
+
+    kernel = f"native {_can_core.simd}" if _can_core is not None else "NumPy"
+    print(f"\n{'message':<24}{'batch us/frame':>16}  ({args.block} frames per block, all signals, {kernel})")
+    for msg in db.messages:
+        if msg.is_multiplexed():
+            print(f"{msg.name:<24}{'-':>16}  (multiplexed: decoded per frame)")
+            continue
+        print(f"{msg.name:<24}{bench_block(msg, args.block):>16.3f}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+"""Launch-file comparison on vcan: per-bus Python processes against one component container.
+
+Each variant starts the bridge for a one-bus config on the interface, plus a
+consumer, ``td_can_bridge::LatencyProbe`` of ``td_can_bridge_cpp``. This
+process then sends FootForce frames at ``--rate``, with a sequence number in
+``forceN``:
+
+* ``process``: ``td_can_multibus.launch.py process_per_bus:=true``, with the
+  probe as a process of its own (``latency_probe``). Every message crosses
+  DDS.
+* ``composed``: ``td_can_composed.launch.py``, with the probe loaded into
+  ``td_can_container`` through ``consumers``. Messages pass intra-process.
+
+The probe stamps each message with CLOCK_MONOTONIC when its callback runs,
+and this process stamps each frame with the same clock just before sending
+it. ``latency_us`` therefore runs from the frame's send to the consumer.
+``cpu_ms_per_1k`` adds up user and system time of every process the variant
+started, from /proc, over the run.
+
+    sudo python3 scripts/bench_launch.py --setup-vcan --interface vcan0 --output launch.json
+    python3 scripts/bench_launch.py --rate 2000 --seconds 10 --variants composed
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import os
+import platform
+import signal
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+from pathlib import Path
+from typing import Any, Dict, List, Optional
+
+import yaml
+
+from bench_bridge import DBC, RX_ID, percentiles, setup_vcan, _commit
+
+TOPIC = "/bench/foot_force"
+VARIANTS = ("process", "composed")
+CLK_TCK = os.sysconf("SC_CLK_TCK")
+
+
+def write_config(directory: Path, interface: str) -> Path:
+    cfg = {
+        "buses": [{
+            "name": "bench_bus",
+            "interface": interface,
+            "dbc_file": str(DBC),
+            "rx_frames": {"FootForce": {"topic": TOPIC, "type": "std_msgs/msg/Float32", "fields": {"forceN": "data"}}},
+        }],
+        "qos": {"sensor": {"reliability": "best_effort", "depth": 1000}},
+    }
+    path = directory / "bench_launch.yaml"
+    path.write_text(yaml.safe_dump(cfg))
+    return path
+
+
+def _commands(variant: str, cfg: Path, samples: Path, directory: Path) -> List[List[str]]:
+    probe = {"topic": TOPIC, "output": str(samples)}
+    if variant == "process":
+        return [
+            ["ros2", "launch", "td_can_bridges", "td_can_multibus.launch.py", f"config:={cfg}", "process_per_bus:=true"],
+            ["ros2", "run", "td_can_bridge_cpp", "latency_probe", "--ros-args"]
+            + [arg for key, value in probe.items() for arg in ("-p", f"{key}:={value}")],
+        ]
+    consumers = directory / "bench_consumers.yaml"
+    consumers.write_text(yaml.safe_dump([{
+        "package": "td_can_bridge_cpp", "plugin": "td_can_bridge::LatencyProbe", "name": "latency_probe",
+        "parameters": probe,
+    }]))
+    return [["ros2", "launch", "td_can_bridges", "td_can_composed.launch.py", f"config:={cfg}",
+             f"consumers:={consumers}"]]
+
+
+def _tree(roots: List[int]) -> List[int]:
+    """``roots`` and every process descended from them."""
+
+    children: Dict[int, List[int]] = {}
+    for entry in Path("/proc").iterdir():
+        if not entry.name.isdigit():
+            continue
+        try:
+            stat = (entry / "stat").read_text()
+        except OSError:
+            continue
+        ppid = int(stat.rsplit(")", 1)[1].split()[1])
+        children.setdefault(ppid, []).append(int(entry.name))
+    out, todo = [], list(roots)
+    while todo:
+        pid = todo.pop()
+        out.append(pid)
+        todo.extend(children.get(pid, []))
+    return out
+
+
+def _cpu_s(pids: List[int]) -> Dict[int, float]:
+    out = {}
+    for pid in pids:
+        try:
+            fields = Path(f"/proc/{pid}/stat").read_text().rsplit(")", 1)[1].split()
+        except OSError:
+            continue
+        out[pid] = (int(fields[11]) + int(fields[12])) / CLK_TCK  # utime, stime
+    return out
+
+
+def _read_samples(path: Path) -> Dict[int, int]:
+    out = {}
+    if path.exists():
+        for line in path.read_text().splitlines():
+            seq, ns = line.split()
+            out.setdefault(int(seq), int(ns))
+    return out
+
+
+def _frame(seq: int) -> bytes:
+    return struct.pack("=IB3x8s", RX_ID, 8, struct.pack("<H6x", seq & 0xFFFF))
+
+
+def bench_variant(args, variant: str, directory: Path) -> Dict[str, Any]:
+    cfg = write_config(directory, args.interface)
+    samples = directory / f"samples_{variant}.txt"
+    samples.unlink(missing_ok=True)
+    procs = [subprocess.Popen(cmd, start_new_session=True, stdout=subprocess.DEVNULL, stderr=subprocess.STDOUT)
+             for cmd in _commands(variant, cfg, samples, directory)]
+    tx = socket.socket(socket.AF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+    tx.bind((args.interface,))
+    try:
+        # Sequence 0 until the probe has one: the whole pipeline is up
+        deadline = time.monotonic() + args.startup
+        while not _read_samples(samples):
+            if time.monotonic() > deadline:
+                raise RuntimeError(f"{variant}: no message reached the probe within {args.startup:g} s")
+            tx.send(_frame(0))
+            time.sleep(0.1)
+        time.sleep(0.5)
+
+        frames = min(int(args.rate * args.seconds), 0xFFFF)
+        period_ns = int(1e9 / args.rate)
+        sent: Dict[int, int] = {}
+        pids = _tree([p.pid for p in procs])
+        cpu0 = _cpu_s(pids)
+        start = time.monotonic_ns()
+        for seq in range(1, frames + 1):
+            due = start + seq * period_ns
+            while time.monotonic_ns() < due:
+                pass
+            sent[seq] = time.monotonic_ns()
+            tx.send(_frame(seq))
+        cpu1 = _cpu_s(pids)
+        span = (time.monotonic_ns() - start) / 1e9
+        time.sleep(1.5)  # the probe flushes once a second
+    finally:
+        tx.close()
+        for p in procs:
+            os.killpg(p.pid, signal.SIGINT)
+        for p in procs:
+            try:
+                p.wait(timeout=10)
+            except subprocess.TimeoutExpired:
+                os.killpg(p.pid, signal.SIGKILL)
+
+    received = {seq: ns for seq, ns in _read_samples(samples).items() if seq in sent}
+    latencies = [(ns - sent[seq]) / 1e3 for seq, ns in received.items()]
+    cpu = sum(cpu1.get(pid, 0.0) - cpu0.get(pid, 0.0) for pid in cpu1)
+    result = {
+        "sent": len(sent),
+        "received": len(received),
+        "lost": len(sent) - len(received),
+        "tx_fps": round(len(sent) / span, 1) if span > 0 else 0.0,
+        "cpu_ms_per_1k": round(cpu * 1e6 / len(received), 3) if received else None,
+        "cpu_percent": round(100.0 * cpu / span, 1) if span > 0 else None,
+        "processes": len(cpu1),
+        "latency_us": {k: round(v, 1) for k, v in percentiles(latencies).items()},
+    }
+    lat = result["latency_us"]
+    print(f"  {variant}: {result['received']}/{result['sent']} received, p50 {lat.get('p50')} us, "
+          f"p99 {lat.get('p99')} us, {result['cpu_percent']}% CPU over {result['processes']} processes")
+    return result
+
+
+def build_arg_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Per-bus processes against one component container, on vcan")
+    parser.add_argument("--interface", default="vcan0", help="vcan interface to run on.")
+    parser.add_argument("--setup-vcan", action="store_true", help="Create the interface first if it is missing.")
+    parser.add_argument("--rate", type=float, default=1000.0, help="Frames per second.")
+    parser.add_argument("--seconds", type=float, default=10.0, help="Length of each run (at most 65535 frames).")
+    parser.add_argument("--startup", type=float, default=30.0, help="Seconds to wait for a variant to come up.")
+    parser.add_argument("--variants", nargs="+", choices=VARIANTS, default=list(VARIANTS))
+    parser.add_argument("--output", type=Path, help="JSON results file; printed to stdout when not given.")
+    return parser
+
+
+def main(argv: Optional[List[str]] = None) -> int:
+    args = build_arg_parser().parse_args(argv)
+    if args.setup_vcan:
+        setup_vcan(args.interface)
+    results: Dict[str, Any] = {
+        "commit": _commit(),
+        "host": platform.node(),
+        "kernel": platform.release(),
+        "rmw": os.environ.get("RMW_IMPLEMENTATION"),
+        "interface": args.interface,
+        "rate": args.rate,
+        "seconds": args.seconds,
+        "time": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+    }
+    with tempfile.TemporaryDirectory() as tmp:
+        results["variants"] = {variant: bench_variant(args, variant, Path(tmp)) for variant in args.variants}
+
+    text = json.dumps(results, indent=2, sort_keys=True)
+    if args.output:
+        args.output.write_text(text + "\n")
+        print(f"results written to {args.output}")
+    else:
+        print(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""Measure CanBusService receive throughput and cost per frame on a vcan bus.
+
+A child process floods the interface with RS02_Status1 frames over a raw
+socket while this process receives them through CanBusService with the four
+RS02_Status1 bindings of example_singlebus.yaml. Each RX mode is run in turn
+and reported as frames/s, receiver CPU microseconds per frame (all of this
+process's threads, so the notifier mode pays for its extra thread) and the
+mean and worst time from the kernel's receive timestamp to the handler.
+
+    sudo ip link add dev vcan0 type vcan && sudo ip link set vcan0 up
+    python3 scripts/bench_rx.py --interface vcan0
+
+``--sim`` runs the direct and notifier modes on an in-process bus
+(``td_can_bridges.sim_bus``) instead, with no interface and no kernel: the
+Python path alone, in seconds and without root. Timestamps are then virtual,
+so no latency is reported.
+"""
+
+from __future__ import annotations
+
+import argparse
+import multiprocessing
+import socket
+import struct
+import sys
+import threading
+import time
+from pathlib import Path
+from typing import Any, Dict
+
+from td_can_bridges.service import BusConfig, CanBusService, RxBindingConfig, RX_MODES
+
+DBC = Path(__file__).resolve().parents[1] / "td_can_bridges" / "schemas" / "motors.dbc"
+FRAME_ID = 528  # RS02_Status1
+SIGNALS = ("mech_angle_deg", "mech_velocity_rads", "phase_current_A", "dc_bus_V")
+
+
+def _sender(interface: str, frames: int, rate: float, start) -> None:
+    sock = socket.socket(socket.AF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+    sock.bind((interface,))
+    start.wait()
+    period = 1.0 / rate if rate > 0 else 0.0
+    t_next = time.perf_counter()
+    for seq in range(frames):
+        frame = struct.pack("=IB3x8s", FRAME_ID, 8, struct.pack("<HHHH", seq & 0xFFFF, 100, 200, 2400))
+        while True:
+            try:
+                sock.send(frame)
+                break
+            except OSError:  # ENOBUFS: the interface queue is full, back off briefly
+                time.sleep(0.0001)
+        if period:
+            t_next += period
+            delay = t_next - time.perf_counter()
+            if delay > 0:
+                time.sleep(delay)
+    sock.close()
+
+
+def _sim_schedule(network, frames: int, rate: float) -> None:
+    """The frames of ``_sender``, queued on the virtual clock."""
+
+    import can
+
+    t0 = network.clock.now()
+    for seq in range(frames):
+        data = struct.pack("<HHHH", seq & 0xFFFF, 100, 200, 2400)
+        network.schedule(t0 + (seq / rate if rate > 0 else 0.0),
+                         can.Message(arbitration_id=FRAME_ID, is_extended_id=False, data=data))
+
+
+def run_mode(mode: str, args: argparse.Namespace) -> Dict[str, float]:
+    bindings = {
+        signal: RxBindingConfig(key=signal, message="RS02_Status1", fields={signal: "data"})
+        for signal in SIGNALS
+    }
+    cfg = BusConfig(
+        name=f"bench-{mode}",
+        interface=args.interface,
+        dbc_file=DBC,
+        rx_mode=mode,
+        rx_batch=args.batch,
+        rx_bindings=bindings,
+        source="sim" if args.sim else "socketcan",
+    )
+    service = CanBusService(cfg)
+
+    lock = threading.Lock()
+    state = {"frames": 0, "first": 0.0, "last": 0.0, "latency": 0.0, "worst": 0.0}
+
+    def _handle(payload: Dict[str, Any], binding: RxBindingConfig, timestamp: float) -> None:
+        if binding.key != SIGNALS[0]:
+            return
+        now = time.perf_counter()
+        latency = 0.0 if args.sim else time.time() - timestamp
+        with lock:
+            state["latency"] += latency
+            state["worst"] = max(state["worst"], latency)
+            if state["frames"] == 0:
+                state["first"] = now
+            state["frames"] += 1
+            state["last"] = now
+
+    for binding in bindings.values():
+        service.register_rx_binding(binding, _handle)
+    service.start()
+    time.sleep(0.2)
+
+    if args.sim:
+        from td_can_bridges.sim_bus import SimNetwork
+
+        network = SimNetwork.get(args.interface)
+        _sim_schedule(network, args.frames, args.rate)
+        cpu0 = time.process_time()
+        network.run(settle=False)  # as fast as the events are handed out; the receiver drains below
+    else:
+        start = multiprocessing.Event()
+        sender = multiprocessing.Process(target=_sender, args=(args.interface, args.frames, args.rate, start))
+        sender.start()
+        cpu0 = time.process_time()
+        start.set()
+        sender.join()
+
+    # Let the receiver drain what is still queued
+    idle_since = time.perf_counter()
+    seen = -1
+    while time.perf_counter() - idle_since < 0.5:
+        time.sleep(0.05)
+        with lock:
+            if state["frames"] != seen:
+                seen = state["frames"]
+                idle_since = time.perf_counter()
+    cpu = time.process_time() - cpu0
+    t_stop = time.perf_counter()
+    service.shutdown()
+    stop_ms = (time.perf_counter() - t_stop) * 1000.0
+
+    frames = state["frames"]
+    span = state["last"] - state["first"]
+    return {
+        "frames": frames,
+        "lost": args.frames - frames,
+        "fps": frames / span if span > 0 else 0.0,
+        "cpu_us": cpu * 1e6 / frames if frames else 0.0,
+        "stop_ms": stop_ms,
+        "latency_us": state["latency"] * 1e6 / frames if frames else 0.0,
+        "worst_us": state["worst"] * 1e6,
+    }
+
+
+def build_arg_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="CanBusService RX benchmark on a vcan interface")
+    parser.add_argument("--interface", default="vcan0", help="SocketCAN interface to flood.")
+    parser.add_argument("--frames", type=int, default=200_000, help="Frames sent per mode.")
+    parser.add_argument("--rate", type=float, default=0.0, help="Frames per second, 0 for flat out.")
+    parser.add_argument("--batch", type=int, default=64, help="rx_batch for the direct mode.")
+    parser.add_argument("--modes", nargs="+", choices=RX_MODES, default=list(RX_MODES))
+    parser.add_argument("--sim", action="store_true", help="In-process bus instead of the interface (no native mode).")
+    return parser
+
+
+def main(argv: list[str] | None = None) -> int:
+    args = build_arg_parser().parse_args(argv)
+    if args.sim:
+        args.modes = [m for m in args.modes if m != "native"]  # the RX core reads a socket
+    print(f"{args.frames} frames on {args.interface}, rate {'max' if args.rate <= 0 else args.rate}, "
+          f"{len(SIGNALS)} bindings")
+    print(f"{'mode':<10}{'received':>10}{'lost':>8}{'frames/s':>12}{'cpu us/frame':>14}{'shutdown ms':>13}"
+          f"{'latency us':>12}{'worst us':>10}")
+    for mode in args.modes:
+        r = run_mode(mode, args)
+        print(f"{mode:<10}{r['frames']:>10}{r['lost']:>8}{r['fps']:>12.0f}{r['cpu_us']:>14.1f}{r['stop_ms']:>13.1f}"
+              f"{r['latency_us']:>12.1f}{r['worst_us']:>10.1f}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
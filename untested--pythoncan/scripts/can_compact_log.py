@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+"""Inspect, query, convert and index TritonCAN compact logs (``.tdlog``).
+
+``info`` summarises a compact log and ``ids`` lists its IDs with their frame
+counts, both from the file's index alone. ``query`` prints frames as candump
+lines: only the chunks the index says hold a selected ``--id`` (``ID`` or
+``ID/MASK``) in the ``--time`` window are read, and ``--where`` keeps the
+frames whose decoded signals match. ``convert`` writes any log ``read_log``
+takes (candump ``.log``, ``.blf``, ``.asc``) as a ``.tdlog``, or a
+``.tdlog`` as a candump ``.log``. ``index`` rebuilds the index of a file
+whose writer was killed. ``record`` writes every frame of one or more CAN
+interfaces into a ``.tdlog`` through their memory-mapped packet rings
+(:mod:`td_can_bridges.packet_capture`, needs ``CAP_NET_RAW``), each
+interface its own channel, until Ctrl-C or ``--seconds``.
+
+    python3 scripts/can_compact_log.py convert field.blf field.tdlog
+    sudo python3 scripts/can_compact_log.py record can0 can1 -o field.tdlog --max-bytes 268435456
+    python3 scripts/can_compact_log.py ids field.tdlog
+    python3 scripts/can_compact_log.py query field.tdlog --id 0x95000000/0x9F000000 --time +3600..+7200
+    python3 scripts/can_compact_log.py query field.tdlog --dbc motors.dbc --where "RS02_Status2.motor_temp_C>80" --count
+"""
+
+from __future__ import annotations
+
+import argparse
+import os
+import sys
+import time
+from typing import Iterable, TextIO
+
+from td_can_bridges.compact_log import FLAG_FD, SUFFIX, CompactLogReader, CompactLogWriter, build_index, signal_filter
+from td_can_bridges.packet_capture import PacketCapture
+from td_can_bridges.replay import LogFrame, read_log
+from td_can_bridges.socketcan_rx import CAN_EFF_FLAG, CAN_EFF_MASK, CAN_ERR_FLAG, CAN_RTR_FLAG, CAN_SFF_MASK
+
+
+def candump_line(frame: LogFrame) -> str:
+    """``candump -l`` line of one frame."""
+
+    if frame.can_id & (CAN_EFF_FLAG | CAN_ERR_FLAG):
+        ident = f"{frame.can_id & (CAN_EFF_MASK | CAN_ERR_FLAG):08X}"
+    else:
+        ident = f"{frame.can_id & CAN_SFF_MASK:03X}"
+    if frame.fd:
+        body = f"#{frame.flags:X}{frame.data.hex().upper()}"
+    elif frame.can_id & CAN_RTR_FLAG:
+        body = f"R{len(frame.data) or ''}"
+    else:
+        body = frame.data.hex().upper()
+    return f"({frame.timestamp:.6f}) {frame.channel or 'can0'} {ident}#{body}\n"
+
+
+def write_candump(frames: Iterable[LogFrame], out: TextIO) -> int:
+    count = 0
+    for frame in frames:
+        out.write(candump_line(frame))
+        count += 1
+    return count
+
+
+def parse_id(text: str):
+    """``ID`` or ``ID/MASK``, with CAN_EFF_FLAG for 29-bit IDs."""
+
+    ident, sep, mask = text.partition("/")
+    return (int(ident, 0), int(mask, 0)) if sep else int(ident, 0)
+
+
+def parse_time(text: str, log: CompactLogReader):
+    """``T0..T1`` in seconds as logged, either side empty; ``+S`` is S seconds after the log's start."""
+
+    first, _ = log.time_range()
+    lo, sep, hi = text.partition("..")
+    if not sep:
+        raise SystemExit(f"--time must be T0..T1, got '{text}'")
+
+    def bound(value: str):
+        if not value:
+            return None
+        return first + float(value[1:]) if value.startswith("+") else float(value)
+
+    return bound(lo), bound(hi)
+
+
+def cmd_info(args) -> int:
+    with CompactLogReader(args.log) as log:
+        first, last = log.time_range()
+        frames = sum(log.ids().values())
+        size = os.path.getsize(args.log)
+        print(f"{args.log}: {frames} frames of {len(log.ids())} IDs in {len(log.chunk_table())} chunks, "
+              f"{first:.6f} .. {last:.6f} ({last - first:.1f} s), "
+              f"{size} bytes ({size / max(frames, 1):.2f} per frame), {log.resolution_ns} ns ticks, "
+              f"{'indexed' if log.indexed else 'no index (run index)'}")
+    return 0
+
+
+def cmd_ids(args) -> int:
+    with CompactLogReader(args.log) as log:
+        for (channel, can_id), count in sorted(log.ids().items()):
+            print(f"{channel or '-':8} 0x{can_id:08X}  {count}")
+    return 0
+
+
+def cmd_query(args) -> int:
+    selectors = None if args.ids is None else [parse_id(i) for i in args.ids]
+    test = None
+    if args.where:
+        import cantools
+
+        if not args.dbc:
+            raise SystemExit("--where needs --dbc")
+        db = cantools.database.load_file(args.dbc[0])
+        for path in args.dbc[1:]:
+            db.add_dbc_file(path)
+        ids, test = signal_filter(db, args.where)
+        if selectors is None:
+            selectors = ids
+    with CompactLogReader(args.log) as log:
+        start, end = parse_time(args.time, log) if args.time else (None, None)
+        frames = log.frames(ids=selectors, channels=args.channels, start=start, end=end)
+        if test is not None:
+            frames = filter(test, frames)
+        if args.count:
+            print(sum(1 for _ in frames))
+        else:
+            write_candump(frames, sys.stdout)
+    return 0
+
+
+def cmd_convert(args) -> int:
+    if args.input.lower().endswith(SUFFIX):
+        with CompactLogReader(args.input) as log, open(args.output, "w") as out:
+            count = write_candump(log.frames(), out)
+    else:
+        with CompactLogWriter(args.output, compression_level=args.level, resolution_ns=args.resolution_ns) as log:
+            count = 0
+            for frame in read_log(args.input):
+                log.add(frame.timestamp, frame.can_id, frame.data, (frame.flags | FLAG_FD) if frame.fd else 0,
+                        frame.channel)
+                count += 1
+    print(f"{count} frames: {os.path.getsize(args.input)} -> {os.path.getsize(args.output)} bytes")
+    return 0
+
+
+def cmd_index(args) -> int:
+    print(f"{args.log}: indexed {build_index(args.log)} chunks")
+    return 0
+
+
+def cmd_record(args) -> int:
+    capture = PacketCapture(args.interfaces, block_kb=args.block_kb, blocks=args.blocks)
+    count = 0
+    end = time.monotonic() + args.seconds if args.seconds else None
+    try:
+        with CompactLogWriter(args.output, compression_level=args.level, max_bytes=args.max_bytes) as log:
+            try:
+                while end is None or time.monotonic() < end:
+                    capture.wait(0.2)
+                    while True:
+                        frames = capture.read(4096)
+                        for index, timestamp, frame in frames:
+                            log.add_raw(timestamp, frame, args.interfaces[index])
+                        count += len(frames)
+                        if len(frames) < 4096:
+                            break
+                    log.flush_stale()
+            except KeyboardInterrupt:
+                pass
+    finally:
+        dropped = capture.dropped
+        capture.close()
+    print(f"{count} frames, {dropped} dropped by the kernel -> {args.output}")
+    return 0
+
+
+def build_arg_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Inspect, query, convert and index TritonCAN compact logs")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    info = commands.add_parser("info", help="Frames, time range and size of a .tdlog")
+    info.add_argument("log")
+    info.set_defaults(run=cmd_info)
+
+    ids = commands.add_parser("ids", help="IDs and frame counts of a .tdlog")
+    ids.add_argument("log")
+    ids.set_defaults(run=cmd_ids)
+
+    query = commands.add_parser("query", help="Frames of a .tdlog as candump lines")
+    query.add_argument("log")
+    query.add_argument("--id", action="append", dest="ids", metavar="ID[/MASK]",
+                       help="CAN ID with CAN_EFF_FLAG for 29-bit IDs, e.g. 0x201 or 0x95000000/0x9F000000; "
+                            "repeatable.")
+    query.add_argument("--channel", action="append", dest="channels", help="Channel name; repeatable.")
+    query.add_argument("--time", metavar="T0..T1",
+                       help="Time window in seconds as logged, or +S from the log's start; either side may be empty.")
+    query.add_argument("--where", action="append", metavar="SIGNAL<OP>VALUE",
+                       help="Signal predicate (== != < <= > >=), e.g. RS02_Status2.motor_temp_C>80; "
+                            "repeatable, all must hold.")
+    query.add_argument("--dbc", action="append", help="DBC file for --where; repeatable.")
+    query.add_argument("--count", action="store_true", help="Print the number of matching frames only.")
+    query.set_defaults(run=cmd_query)
+
+    convert = commands.add_parser("convert", help="Any log to .tdlog, or .tdlog to candump .log")
+    convert.add_argument("input")
+    convert.add_argument("output")
+    convert.add_argument("--level", type=int, default=6, help="zlib level of the .tdlog (default 6).")
+    convert.add_argument("--resolution-ns", type=int, default=1000, help="Timestamp tick (default 1000 ns).")
+    convert.set_defaults(run=cmd_convert)
+
+    index = commands.add_parser("index", help="Rebuild the index of a .tdlog whose writer was killed")
+    index.add_argument("log")
+    index.set_defaults(run=cmd_index)
+
+    record = commands.add_parser("record", help="Every frame of CAN interfaces into a .tdlog, from packet rings")
+    record.add_argument("interfaces", nargs="+")
+    record.add_argument("-o", "--output", required=True)
+    record.add_argument("--seconds", type=float, default=0, help="Stop after this long (default: at Ctrl-C).")
+    record.add_argument("--max-bytes", type=int, default=0, help="Rotate after this many bytes (default 0: one file).")
+    record.add_argument("--level", type=int, default=6, help="zlib level (default 6).")
+    record.add_argument("--block-kb", type=int, default=1024, help="Ring block size per interface (default 1024).")
+    record.add_argument("--blocks", type=int, default=16, help="Ring blocks per interface (default 16).")
+    record.set_defaults(run=cmd_record)
+    return parser
+
+
+def main(argv: list[str] | None = None) -> int:
+    args = build_arg_parser().parse_args(argv)
+    try:
+        return args.run(args)
+    except BrokenPipeError:
+        return 0
+    except KeyboardInterrupt:
+        return 130
+
+
+if __name__ == "__main__":
+    sys.exit(main())
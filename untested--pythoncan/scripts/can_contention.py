@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+"""Arbitration delay per ID from a recording, what caused it, and changes that would cut it.
+
+The log must hold every frame on the bus with timestamps close to the wire:
+hardware timestamps (``rx_timestamps: hardware`` recordings, ``candump -l
+-H``), ideally taken on a second interface so your own frames are in it too.
+See :mod:`td_can_bridges.bus_contention` for the method.
+
+    python3 scripts/can_contention.py bench.log --bitrate 1000000 --dbc td_can_bridges/schemas/robostride.dbc
+    python3 scripts/can_contention.py bench.blf --config config.yaml --bus motor_bus --json contention.json
+    python3 scripts/can_contention.py bench.log --bitrate 500000 --ours 0x101 --ours 0x102 --horizon 2
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import statistics
+import sys
+from pathlib import Path
+from typing import Any, Dict, List, Mapping, Optional
+
+from td_can_bridges.bus_contention import (
+    STAMPS,
+    attribute,
+    estimate_streams,
+    id_text,
+    occupancy,
+    simulate,
+    suggest_offsets,
+    suggest_priorities,
+    traffic,
+    worst,
+)
+from td_can_bridges.replay import read_log
+from td_can_bridges.socketcan_rx import CAN_EFF_FLAG
+
+
+def _int(text: str) -> int:
+    return int(text, 0)
+
+
+def _key(msg) -> int:
+    return msg.frame_id | (CAN_EFF_FLAG if msg.is_extended_frame else 0)
+
+
+def _from_config(args) -> Dict[int, str]:
+    """Bitrate and DBC of ``--bus``, and its TX bindings by CAN ID."""
+
+    from td_can_bridges.cache import load_dbc
+    from td_can_bridges.service import load_bridge_config
+
+    bus = load_bridge_config(args.config).get_bus(args.bus)
+    if bus is None:
+        raise SystemExit(f"{args.config} has no bus named '{args.bus}'")
+    args.bitrate = args.bitrate or bus.bitrate
+    args.dbitrate = args.dbitrate or bus.dbitrate
+    args.dbc = args.dbc or [str(bus.dbc_file)]
+    db = load_dbc(bus.dbc_file)
+    return {_key(db.get_message_by_name(binding.message)): key for key, binding in bus.tx_bindings.items()}
+
+
+def _names(paths: List[str]) -> Dict[int, str]:
+    if not paths:
+        return {}
+    import cantools
+
+    names = {}
+    for path in paths:
+        for msg in cantools.database.load_file(path).messages:
+            names[_key(msg)] = msg.name
+    return names
+
+
+def _share(delays: Mapping[int, float], streams) -> Dict[int, float]:
+    return {key: value / streams[key].period for key, value in delays.items()}
+
+
+def build_arg_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Arbitration delay and bus contention from a CAN recording")
+    parser.add_argument("log", help="candump .log, .blf, .tdlog or any other format python-can reads.")
+    parser.add_argument("--bitrate", type=int, help="Nominal bitrate (default: the --bus's).")
+    parser.add_argument("--dbitrate", type=int, help="CAN FD data bitrate.")
+    parser.add_argument("--stamp", choices=STAMPS, default="end", help="Where in the frame the timestamps are.")
+    parser.add_argument("--channel", help="Only frames of this channel of a multi-channel log.")
+    parser.add_argument("--dbc", action="append", default=[], help="DBC for message names; repeatable.")
+    parser.add_argument("--config", type=Path, help="Bridge YAML: --bus gives the bitrate, DBC and our TX IDs.")
+    parser.add_argument("--bus", help="Bus of --config.")
+    parser.add_argument("--ours", action="append", type=_int, default=[], metavar="ID",
+                        help="An ID this host sends (add 0x80000000 for 29-bit); repeatable. Default with "
+                             "--config: the bus's TX bindings; otherwise every periodic ID.")
+    parser.add_argument("--window-ms", type=float, default=10.0, help="Window of the bus load figures.")
+    parser.add_argument("--horizon", type=float, default=1.0, help="Seconds of the log the model replays.")
+    parser.add_argument("--step-us", type=float, default=50.0, help="Offset step of the phase search.")
+    parser.add_argument("--top", type=int, default=20, help="Streams in the table, most delayed first.")
+    parser.add_argument("--json", type=Path, help="Also write the results here.")
+    return parser
+
+
+def main(argv: Optional[List[str]] = None) -> int:
+    args = build_arg_parser().parse_args(argv)
+    bindings: Dict[int, str] = {}
+    if args.config:
+        if not args.bus:
+            raise SystemExit("--config needs --bus")
+        bindings = _from_config(args)
+    if not args.bitrate:
+        raise SystemExit("give --bitrate, or --config and --bus")
+    names = _names(args.dbc)
+
+    timeline = occupancy(read_log(args.log), args.bitrate, args.dbitrate, args.stamp, args.channel)
+    if not timeline.frames:
+        raise SystemExit(f"no frames in {args.log}")
+    span = timeline.frames[-1].end - timeline.frames[0].sof
+    load = timeline.load(args.window_ms / 1e3)
+    streams = estimate_streams(timeline)
+    stats = attribute(timeline, streams)
+    results: Dict[str, Any] = {
+        "log": str(args.log),
+        "bitrate": args.bitrate,
+        "frames": len(timeline.frames),
+        "seconds": round(span, 3),
+        "load_mean": round(statistics.fmean(load), 4),
+        "load_peak": round(max(load), 4),
+        "window_ms": args.window_ms,
+        "timestamp_conflicts": timeline.conflicts,
+        "error_frames": timeline.error_frames,
+        "streams": {},
+    }
+    print(f"{len(timeline.frames)} frames over {span:.1f} s at {args.bitrate} bit/s: load {results['load_mean']:.1%} "
+          f"mean, {results['load_peak']:.1%} in the busiest {args.window_ms:g} ms")
+    if timeline.conflicts > 0.05 * len(timeline.frames):
+        print(f"  warning: {timeline.conflicts} frames overlap the one before; the timestamps are too coarse "
+              f"(use hardware timestamps) or --bitrate/--stamp is wrong")
+
+    def label(key: int) -> str:
+        name = names.get(key) or bindings.get(key)
+        return f"{id_text(key)} {name}" if name else id_text(key)
+
+    rows = sorted(stats.values(), key=lambda s: max(s.delays, default=0.0), reverse=True)
+    print(f"\n{'stream':34} {'period us':>10} {'frames':>7} {'p50 us':>8} {'p99 us':>8} {'max us':>8}  "
+          f"waited on (us in total)")
+    for n, s in enumerate(rows):
+        summary = results["streams"][id_text(s.key)] = s.summary()
+        d = summary["delay_us"]
+        spent = summary["spent_us"]
+        top = sorted(s.blockers.items(), key=lambda kv: kv[1], reverse=True)[:3]
+        blockers = ", ".join(f"{label(key)} {seconds * 1e6:.0f}" for key, seconds in top)
+        if n < args.top:
+            print(f"{label(s.key):34} {summary['period_us']:10.1f} {summary['frames']:7d} {d['p50']:8.1f} "
+                  f"{d['p99']:8.1f} {d['max']:8.1f}  higher {spent['higher']:.0f}, on bus {spent['in_progress']:.0f}, "
+                  f"inversion {spent['inversion']:.0f}, idle {spent['idle']:.0f}")
+            if blockers:
+                print(f"{'':34}   top blockers: {blockers}")
+            if s.inversions:
+                print(f"{'':34}   {s.inversions} frames passed by lower-priority ones: a host or adapter queue "
+                      f"held them")
+
+    if not streams:
+        print("no periodic IDs to model")
+        return _finish(args, results)
+    ours = [key for key in (args.ours or list(bindings) or list(streams)) if key in streams]
+    model = traffic(timeline, streams, args.horizon)
+    before = worst(simulate(model))
+    results["model_worst_us"] = {id_text(k): round(v * 1e6, 1) for k, v in before.items()}
+    print(f"\nModel of the first {args.horizon:g} s (each ID at its median length, non-preemptive, recorded phases):")
+    for key in sorted(ours, key=lambda k: before[k] / streams[k].period, reverse=True)[:args.top]:
+        observed = max(stats[key].delays, default=0.0)
+        print(f"  {label(key):34} worst {before[key] * 1e6:8.1f} us ({before[key] / streams[key].period:.0%} of the"
+              f" period), recorded {observed * 1e6:.1f} us")
+
+    remap = suggest_priorities(model, ours)
+    if remap:
+        after = worst(simulate(model, keys=remap))
+        results["priorities"] = {id_text(k): id_text(v) for k, v in remap.items()}
+        print("\nRate-monotonic IDs (shortest period on the highest priority), worst delay before -> after:")
+        for key, new in sorted(remap.items(), key=lambda kv: streams[kv[0]].period):
+            print(f"  {label(key):34} -> {id_text(new):10}  {before[key] * 1e6:8.1f} -> {after[key] * 1e6:8.1f} us")
+        print(f"  worst share of a period over all streams: {max(_share(before, streams).values()):.0%} -> "
+              f"{max(_share(after, streams).values()):.0%}")
+    else:
+        print("\nThe IDs already follow their periods (rate-monotonic): no reassignment to suggest.")
+
+    offsets = suggest_offsets(model, ours, args.step_us / 1e6)
+    after = worst(simulate(model, {**{k: s.origin - model.start for k, s in streams.items()}, **offsets}))
+    reference = min(offsets, key=lambda k: offsets[k]) if offsets else None
+    if reference is not None:
+        relative = {key: (offset - offsets[reference]) % streams[key].period for key, offset in offsets.items()}
+        results["offsets_us"] = {id_text(k): round(v * 1e6) for k, v in relative.items()}
+        print(f"\nPhase offsets from {label(reference)}, each within its period, worst delay before -> after:")
+        for key in sorted(relative, key=lambda k: relative[k]):
+            print(f"  {label(key):34} +{relative[key] * 1e6:8.0f} us  {before[key] * 1e6:8.1f} -> "
+                  f"{after[key] * 1e6:8.1f} us")
+        print(f"  worst share of a period over all streams: {max(_share(before, streams).values()):.0%} -> "
+              f"{max(_share(after, streams).values()):.0%}")
+        periods = {round(streams[key].period * 1e6) for key in relative}
+        if bindings and len(periods) == 1 and all(key in bindings for key in relative):
+            print(f"\n  as a tx_schedule of {args.bus}:\n    tx_schedule:\n      cycle_us: {periods.pop()}\n      slots:")
+            for key in sorted(relative, key=lambda k: relative[k]):
+                print(f"        - {{binding: \"{bindings[key]}\", offset_us: {round(relative[key] * 1e6)}}}")
+    return _finish(args, results)
+
+
+def _finish(args, results: Dict[str, Any]) -> int:
+    if args.json:
+        args.json.write_text(json.dumps(results, indent=2, sort_keys=True) + "\n")
+        print(f"\nresults written to {args.json}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
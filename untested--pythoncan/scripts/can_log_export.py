@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+"""Decode a CAN log into one Parquet (or Arrow) table per DBC message.
+
+Reads a candump ``.log``, the recorder's ``.blf`` or ``.tdlog`` or anything
+else python-can reads, and writes ``OUT/<message>.parquet`` with a typed
+column per signal plus ``timestamp``, ``channel`` and ``dlc``, for pandas,
+polars or DuckDB.
+Decoding is column-wise with NumPy (td_can_bridges.batch). ``--stream`` keeps
+memory bounded for logs larger than RAM.
+
+    python3 scripts/can_log_export.py session.blf --dbc td_can_bridges/schemas/motors.dbc
+    python3 scripts/can_log_export.py field.log --dbc motors.dbc --dbc sensors.dbc -o field/ --stream
+"""
+
+from __future__ import annotations
+
+import argparse
+import sys
+import time
+from pathlib import Path
+
+import cantools
+
+from td_can_bridges.log_export import DEFAULT_BLOCK_ROWS, FORMATS, export_log
+
+
+def build_arg_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Export a CAN log as one Parquet or Arrow table per DBC message")
+    parser.add_argument("log", help="candump .log, .blf, .asc, .tdlog or any other format python-can reads.")
+    parser.add_argument("--dbc", action="append", required=True, help="DBC file; repeatable.")
+    parser.add_argument("-o", "--out", help="Output directory (default: the log's name without suffix).")
+    parser.add_argument("--format", choices=FORMATS, default="parquet")
+    parser.add_argument("--compression", help="Parquet codec (default zstd), or lz4/zstd for Arrow files.")
+    parser.add_argument("--message", action="append", dest="messages", metavar="NAME",
+                        help="Export only this message; repeatable.")
+    parser.add_argument("--stream", action="store_true",
+                        help="Write each block as it fills: bounded memory, rows in time order per channel.")
+    parser.add_argument("--block-rows", type=int, default=DEFAULT_BLOCK_ROWS,
+                        help="Frames decoded at a time per channel and message (and row group size with --stream).")
+    return parser
+
+
+def main(argv: list[str] | None = None) -> int:
+    args = build_arg_parser().parse_args(argv)
+    db = cantools.database.load_file(args.dbc[0])
+    for path in args.dbc[1:]:
+        db.add_dbc_file(path)
+    out = Path(args.out) if args.out else Path(args.log).with_suffix("")
+    start = time.monotonic()
+    try:
+        stats = export_log(args.log, db, out, fmt=args.format, stream=args.stream, block_rows=args.block_rows,
+                           compression=args.compression, messages=args.messages)
+    except KeyboardInterrupt:
+        return 130
+    elapsed = time.monotonic() - start
+    print(f"{stats.summary()} in {elapsed:.1f} s")
+    for path in stats.files:
+        print(f"  {path}  {stats.rows[path.stem]} rows")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Replay a candump, BLF or ASC log onto SocketCAN interfaces at N times real time.
+
+Run a bridge on the vcan interfaces to reproduce a field issue, or replay at
+``--speed 0`` to benchmark it. Prints the frame rate achieved against the one
+requested and how late frames left against their deadlines.
+
+    sudo ip link add dev vcan0 type vcan && sudo ip link set vcan0 up
+    python3 scripts/can_replay.py field.blf --interface vcan0 --speed 10
+    python3 scripts/can_replay.py field.log --map can0=vcan0 --map can1=vcan1 --remap vcan1:0x201=0x301
+"""
+
+from __future__ import annotations
+
+import argparse
+import sys
+from typing import Dict, Tuple
+
+from td_can_bridges.replay import Replayer, read_log
+
+
+def _pair(text: str) -> Tuple[str, str]:
+    key, sep, value = text.partition("=")
+    if not sep or not key or not value:
+        raise argparse.ArgumentTypeError(f"expected KEY=VALUE, got '{text}'")
+    return key, value
+
+
+def build_arg_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Replay a CAN log onto SocketCAN interfaces")
+    parser.add_argument("log", help="candump .log, .blf, .asc, .tdlog or any other format python-can reads.")
+    parser.add_argument("--interface", help="Interface for frames of channels without a --map.")
+    parser.add_argument("--map", type=_pair, action="append", default=[], metavar="CHANNEL=IFACE",
+                        help="Send the log channel's frames to IFACE; repeatable.")
+    parser.add_argument("--remap", action="append", default=[], metavar="[IFACE:]OLD=NEW",
+                        help="Send ID OLD as NEW, on IFACE only or on every interface; repeatable.")
+    parser.add_argument("--speed", type=float, default=1.0, help="Multiple of real time, 0 for maximum speed.")
+    parser.add_argument("--limit", type=int, help="Stop after this many frames.")
+    return parser
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = build_arg_parser()
+    args = parser.parse_args(argv)
+    channels = dict(args.map)
+    if not channels and not args.interface:
+        parser.error("give --interface or at least one --map")
+    targets = set(channels.values()) | ({args.interface} if args.interface else set())
+    remap: Dict[str, Dict[int, int]] = {}
+    for entry in args.remap:
+        scope, _, ids = entry.rpartition(":")
+        old, new = _pair(ids)
+        for target in [scope] if scope else targets:
+            remap.setdefault(target, {})[int(old, 0)] = int(new, 0)
+
+    with Replayer(channels, args.interface, remap, args.speed) as replayer:
+        try:
+            stats = replayer.run(read_log(args.log), args.limit)
+        except KeyboardInterrupt:
+            return 130
+    print(stats.summary())
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Generate C++ headers with a specialised decoder per DBC message.
+
+Each DBC file becomes one header, ``motors.dbc`` -> ``motors.hpp`` with the
+structs in ``td_can_bridge::motors``. ``RS02_Status1`` becomes
+``RS02Status1`` with one field per signal and an inline ``decode()``. The
+messages of masked device classes (RoboStride feedback) also get their ID
+mask and ID fields. The headers include ``td_can_bridge_cpp/dbc_decode.hpp``:
+
+    python3 scripts/dbc_to_cpp.py td_can_bridges/schemas/*.dbc --out ../td_can_bridge_cpp/include/td_can_dbc
+
+    #include "td_can_dbc/motors.hpp"
+    auto fb = td_can_bridge::motors::RS02Feedback::decode(frame.data);
+
+``scripts/bench_dbc_cpp.py`` checks the generated code against cantools.
+"""
+
+from __future__ import annotations
+
+import argparse
+import sys
+from pathlib import Path
+
+import cantools
+
+from td_can_bridges.cpp_decoders import render_headers, unsupported
+from td_can_bridges.ros_msgs import type_name
+
+
+def build_arg_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Generate C++ decoders from DBC messages")
+    parser.add_argument("dbc", nargs="+", help="DBC files; each becomes one header.")
+    parser.add_argument("--out", required=True, help="Directory the headers are written to.")
+    parser.add_argument("--message", action="append", default=[], metavar="NAME",
+                        help="Only generate this DBC message; repeatable.")
+    return parser
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = build_arg_parser()
+    args = parser.parse_args(argv)
+    databases, found = [], set()
+    for path in args.dbc:
+        messages = [m for m in cantools.database.load_file(path).messages
+                    if not args.message or m.name in args.message]
+        seen = {}
+        for msg in messages:
+            name = type_name(msg.name)
+            if name in seen:
+                parser.error(f"{msg.name} and {seen[name]} in {path} both become {name}")
+            seen[name] = msg.name
+        found.update(m.name for m in messages)
+        databases.append((path, messages))
+    missing = set(args.message) - found
+    if missing:
+        parser.error(f"no DBC messages {sorted(missing)}")
+
+    try:
+        files = render_headers(databases)
+    except ValueError as exc:
+        parser.error(str(exc))
+    if len(files) < len(databases):
+        parser.error("two DBC files map to the same header name")
+    out = Path(args.out).expanduser()
+    out.mkdir(parents=True, exist_ok=True)
+    for (path, messages), (name, text) in zip(databases, files.items()):
+        (out / name).write_text(text)
+        print(f"{out / name}: from {path}")
+        for msg in messages:
+            why = unsupported(msg)
+            print(f"  {msg.name} -> {type_name(msg.name)}" if why is None else f"  {msg.name}: skipped, {why}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
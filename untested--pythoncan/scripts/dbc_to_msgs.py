@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""Generate a ROS interface package with one message type per DBC message.
+
+An RX binding with ``publish: frame`` then publishes each received frame as
+one message holding all of its signals, instead of one std_msgs topic per
+signal. Build the package next to td_can_bridges:
+
+    python3 scripts/dbc_to_msgs.py td_can_bridges/schemas/motors.dbc --out ~/ros2_ws/src
+    cd ~/ros2_ws && colcon build --packages-select td_can_msgs
+
+``RS02_Status1`` becomes ``td_can_msgs/msg/RS02Status1`` with a header and
+one field per signal (``phase_current_A`` -> ``phase_current_a``).
+"""
+
+from __future__ import annotations
+
+import argparse
+import sys
+from pathlib import Path
+
+import cantools
+
+from td_can_bridges.ros_msgs import DEFAULT_PACKAGE, render_package, type_name
+
+
+def build_arg_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Generate ROS messages from DBC messages")
+    parser.add_argument("dbc", nargs="+", help="DBC files; every message of each gets a type.")
+    parser.add_argument("--out", required=True, help="Directory the package directory is created in.")
+    parser.add_argument("--package", default=DEFAULT_PACKAGE, help=f"Package name (default {DEFAULT_PACKAGE}).")
+    parser.add_argument("--message", action="append", default=[], metavar="NAME",
+                        help="Only generate this DBC message; repeatable.")
+    return parser
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = build_arg_parser()
+    args = parser.parse_args(argv)
+    messages, seen = [], {}
+    for path in args.dbc:
+        for msg in cantools.database.load_file(path).messages:
+            if args.message and msg.name not in args.message:
+                continue
+            name = type_name(msg.name)
+            if name in seen:
+                parser.error(f"{msg.name} in {path} and {seen[name]} both become {name}")
+            seen[name] = f"{msg.name} in {path}"
+            messages.append(msg)
+    missing = set(args.message) - {m.name for m in messages}
+    if missing:
+        parser.error(f"no DBC messages {sorted(missing)}")
+
+    root = Path(args.out).expanduser() / args.package
+    for relative, text in render_package(messages, args.package).items():
+        target = root / relative
+        target.parent.mkdir(parents=True, exist_ok=True)
+        target.write_text(text)
+    print(f"{root}: {len(messages)} message types")
+    for msg in messages:
+        print(f"  {msg.name} -> {args.package}/msg/{type_name(msg.name)}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Dump every parameter of a set of RoboStride motors to YAML, or restore them from it.
+
+All motors are read (and written) concurrently through one ParameterClient.
+Restoring writes only the parameters whose value differs from the motor's,
+then with ``--save`` issues a type 22 save on each motor that changed.
+
+    python3 scripts/robostride_params.py --config config/example_singlebus.yaml --bus motor_bus \\
+        dump --motors 1-6 --output arm.yaml
+    python3 scripts/robostride_params.py --config config/example_singlebus.yaml --bus motor_bus \\
+        restore arm.yaml --save
+"""
+
+from __future__ import annotations
+
+import argparse
+import logging
+import sys
+from pathlib import Path
+from typing import List
+
+from td_can_bridges.robostride_params import ParameterClient
+from td_can_bridges.robostride_snapshot import dump, load_snapshot, restore, save_snapshot
+from td_can_bridges.service import CanBusService, load_bridge_config
+
+
+def _motor_ids(text: str) -> List[int]:
+    """``1,3,5-8`` -> [1, 3, 5, 6, 7, 8]."""
+
+    ids: List[int] = []
+    for part in text.split(","):
+        first, sep, last = part.partition("-")
+        try:
+            ids.extend(range(int(first, 0), int(last, 0) + 1) if sep else [int(first, 0)])
+        except ValueError:
+            raise argparse.ArgumentTypeError(f"expected motor IDs like 1,3,5-8, got '{text}'") from None
+    return ids
+
+
+def build_arg_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Bulk RoboStride parameter dump and restore")
+    parser.add_argument("--config", type=Path, required=True, help="Bridge YAML config with the motor bus.")
+    parser.add_argument("--bus", required=True, help="Bus name from the config.")
+    parser.add_argument("--host-id", type=lambda s: int(s, 0), default=0xFD, help="Host ID the motors answer to.")
+    parser.add_argument("--window", type=int, default=4, help="Requests in flight per motor.")
+    parser.add_argument("--timeout", type=float, default=0.1, help="Seconds before a request is sent again.")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    dump_cmd = commands.add_parser("dump", help="Read every parameter into a snapshot.")
+    dump_cmd.add_argument("--motors", type=_motor_ids, required=True, help="Motor IDs, e.g. 1,3,5-8.")
+    dump_cmd.add_argument("--output", type=Path, required=True, help="Snapshot YAML to write.")
+
+    restore_cmd = commands.add_parser("restore", help="Write the parameters that differ from a snapshot.")
+    restore_cmd.add_argument("snapshot", type=Path)
+    restore_cmd.add_argument("--motors", type=_motor_ids, help="Only these motors of the snapshot.")
+    restore_cmd.add_argument("--save", action="store_true", help="Type 22 save on every motor written.")
+    restore_cmd.add_argument("--include-runtime", action="store_true",
+                             help="Also write run_mode and the iq/spd/loc targets (moves the motor).")
+    restore_cmd.add_argument("--dry-run", action="store_true", help="Print the differences, write nothing.")
+    return parser
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = build_arg_parser()
+    args = parser.parse_args(argv)
+    logging.basicConfig(level=logging.INFO)
+
+    snapshot = None
+    if args.command == "restore":
+        try:
+            snapshot = load_snapshot(args.snapshot)
+        except (OSError, ValueError) as exc:
+            parser.error(str(exc))
+    bus_cfg = load_bridge_config(args.config).get_bus(args.bus)
+    if bus_cfg is None:
+        parser.error(f"Bus '{args.bus}' not found in {args.config}")
+
+    service = CanBusService(bus_cfg)
+    service.start()
+    client = ParameterClient(service, host_id=args.host_id, window=args.window, timeout=args.timeout)
+    try:
+        if args.command == "dump":
+            snapshot = dump(client, args.motors)
+            save_snapshot(snapshot, args.output)
+            count = sum(len(params) for params in snapshot["motors"].values())
+            unread = sum(len(params) for params in snapshot.get("unread", {}).values())
+            print(f"{count} parameter(s) of {len(args.motors)} motor(s) read in {snapshot['seconds']:.2f} s, "
+                  f"{unread} unanswered; written to {args.output}")
+            return 1 if unread else 0
+
+        result = restore(client, snapshot, motors=args.motors, save=args.save,
+                         include_runtime=args.include_runtime, dry_run=args.dry_run)
+        for motor, written in sorted(result.written.items()):
+            for name, (old, new) in written.items():
+                print(f"  motor {motor}: {name} {old!r} -> {new!r}")
+        for motor, names in sorted(result.failed.items()):
+            print(f"  motor {motor}: no answer for {', '.join(names)}")
+        print(("dry run: " if args.dry_run else "") + result.summary())
+        return 1 if result.failed else 0
+    finally:
+        client.close()
+        service.shutdown()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
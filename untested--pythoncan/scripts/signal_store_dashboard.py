@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+"""Serve a live browser dashboard of one or more signal stores.
+
+The buses need ``signal_store`` in their YAML entries, with ``history`` so
+no update between two ticks is missed. Open ``http://<robot>:8765/``; every
+viewer gets the same binary update ``--rate`` times a second, min/max folded
+per signal on the server (:mod:`td_can_bridges.dashboard`).
+
+    python3 scripts/signal_store_dashboard.py --bus motor_bus --bus sensor_bus
+    python3 scripts/signal_store_dashboard.py --path /dev/shm/td_can_swing_test --rate 20
+"""
+
+from __future__ import annotations
+
+import argparse
+import asyncio
+import logging
+import sys
+from pathlib import Path
+
+from td_can_bridges.dashboard import DEFAULT_PORT, DEFAULT_RATE_HZ, DashboardServer
+from td_can_bridges.signal_store import default_path
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Browser dashboard of td_can_bridges signal stores")
+    parser.add_argument("--bus", action="append", default=[], help="Bus name; the store is /dev/shm/td_can_<bus>.")
+    parser.add_argument("--path", action="append", type=Path, default=[], help="Store file, when signal_store.path was set.")
+    parser.add_argument("--filter", default="", help="Only signals whose name contains this text.")
+    parser.add_argument("--host", default="", help="Address to listen on (default: all).")
+    parser.add_argument("--port", type=int, default=DEFAULT_PORT)
+    parser.add_argument("--rate", type=float, default=DEFAULT_RATE_HZ, help="Updates per second to every viewer.")
+    args = parser.parse_args(argv)
+
+    paths = [default_path(bus) for bus in args.bus] + args.path
+    if not paths:
+        parser.error("give at least one --bus or --path")
+    logging.basicConfig(level=logging.INFO, format="%(message)s")
+    server = DashboardServer(paths, args.host, args.port, args.rate, args.filter)
+    try:
+        asyncio.run(server.serve())
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
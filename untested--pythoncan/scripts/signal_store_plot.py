@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""Plot signals live from a signal store's history rings, in a process of its own.
+
+The store needs ``history`` (``signal_store: {history: 4096}`` in the bus's
+YAML entry, or the ``--telemetry`` option of MotorTest/swing_test.py). The
+writer's only cost is one ring entry per signal update. This process copies
+the new entries at ``--fps``, folds them into min/max columns (two points per
+pixel column of the window, whatever the sample rate) and redraws, so neither
+the CAN RX thread nor a control loop ever waits on the plot.
+
+    python3 scripts/signal_store_plot.py --bus motor_bus --filter RS02_Status1
+    python3 scripts/signal_store_plot.py --path /dev/shm/td_can_swing_test --window 5
+"""
+
+from __future__ import annotations
+
+import argparse
+import sys
+import time
+from collections import deque
+from pathlib import Path
+from typing import Deque, List, Tuple
+
+from td_can_bridges.signal_store import SignalStoreReader, default_path
+
+
+class MinMaxTrace:
+    """A signal folded into ``columns`` time buckets spanning ``window`` seconds.
+
+    Each bucket keeps its first sample's time, the minimum and the maximum, so
+    a spike shorter than a pixel still shows. Adding a sample is O(1).
+    """
+
+    def __init__(self, window: float, columns: int):
+        self.width = window / max(1, columns)
+        self.buckets: Deque[List[float]] = deque(maxlen=max(1, columns))  # [t, vmin, tmin, vmax, tmax]
+
+    def add(self, t: float, value: float) -> None:
+        if self.buckets and t < self.buckets[-1][0] + self.width:
+            bucket = self.buckets[-1]
+            if value < bucket[1]:
+                bucket[1], bucket[2] = value, t
+            if value > bucket[3]:
+                bucket[3], bucket[4] = value, t
+        else:
+            self.buckets.append([t, value, t, value, t])
+
+    def points(self) -> Tuple[List[float], List[float]]:
+        """Two points per bucket, min and max in the order they happened."""
+
+        xs: List[float] = []
+        ys: List[float] = []
+        for _, vmin, tmin, vmax, tmax in self.buckets:
+            if tmin <= tmax:
+                xs += (tmin, tmax)
+                ys += (vmin, vmax)
+            else:
+                xs += (tmax, tmin)
+                ys += (vmax, vmin)
+        return xs, ys
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Live plot of a td_can_bridges signal store")
+    parser.add_argument("--bus", default="motor_bus", help="Bus name; the store is /dev/shm/td_can_<bus>.")
+    parser.add_argument("--path", type=Path, help="Store file, when signal_store.path was set.")
+    parser.add_argument("--filter", default="", help="Only signals whose name contains this text.")
+    parser.add_argument("--window", type=float, default=10.0, help="Seconds of history on screen.")
+    parser.add_argument("--fps", type=float, default=30.0, help="Redraws per second.")
+    parser.add_argument("--columns", type=int, default=800, help="Min/max columns across the window.")
+    args = parser.parse_args(argv)
+
+    import matplotlib.pyplot as plt
+
+    path = args.path or default_path(args.bus)
+    reader = SignalStoreReader(path)
+    if not reader.depth:
+        parser.error(f"{path} has no history rings; set signal_store.history on the bus")
+    names = [name for name in reader.signals if args.filter in name]
+    if not names:
+        parser.error(f"no signal of {path} matches '{args.filter}'")
+
+    fig, axes = plt.subplots(len(names), 1, sharex=True, squeeze=False, figsize=(10, 1.8 * len(names) + 1))
+    fig.canvas.manager.set_window_title(f"{reader.bus}: {path}")
+    lines = []
+    for ax, name in zip(axes[:, 0], names):
+        lines.append(ax.plot([], [], linewidth=0.8)[0])
+        ax.set_ylabel(name.split(".", 1)[-1], fontsize=8)
+        ax.grid(True, alpha=0.3)
+    axes[0, 0].set_title(f"{reader.bus} ({args.window:g} s)")
+    axes[-1, 0].set_xlabel("s")
+    plt.show(block=False)
+
+    traces = [MinMaxTrace(args.window, args.columns) for _ in names]
+    cursors = [0] * len(names)
+    origin = None
+    period = 1.0 / args.fps
+    try:
+        while plt.fignum_exists(fig.number):
+            frame_start = time.monotonic()
+            if reader.replaced():
+                # The writer restarted: follow the new file once it is there
+                try:
+                    fresh = SignalStoreReader(path)
+                except (FileNotFoundError, ValueError):
+                    fresh = None
+                if fresh is not None and all(name in fresh.signals for name in names):
+                    reader.close()
+                    reader = fresh
+                    cursors = [0] * len(names)
+                elif fresh is not None:
+                    fresh.close()
+            latest = None
+            for i, name in enumerate(names):
+                samples, cursors[i] = reader.history(name, cursors[i])
+                for stamp, value in samples:
+                    if origin is None:
+                        origin = stamp
+                    traces[i].add(stamp - origin, value)
+                if samples:
+                    latest = samples[-1][0] if latest is None else max(latest, samples[-1][0])
+            if latest is not None:
+                right = latest - origin
+                for ax, line, trace in zip(axes[:, 0], lines, traces):
+                    line.set_data(*trace.points())
+                    ax.relim()
+                    ax.autoscale_view(scalex=False)
+                axes[-1, 0].set_xlim(right - args.window, right)
+                fig.canvas.draw_idle()
+            fig.canvas.flush_events()
+            time.sleep(max(0.0, period - (time.monotonic() - frame_start)))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        reader.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
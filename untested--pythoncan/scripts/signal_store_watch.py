@@ -0,0 +1,50 @@
+#!/usr/bin/env python3
+"""Print the latest signal values a running bridge keeps in its shared-memory store.
+
+The bus needs ``signal_store`` in its YAML entry. Nothing here touches the
+CAN socket; the values are read from the store the bridge writes.
+
+    python3 scripts/signal_store_watch.py --bus motor_bus --filter RS02_Status1
+"""
+
+from __future__ import annotations
+
+import argparse
+import sys
+import time
+from pathlib import Path
+
+from td_can_bridges.signal_store import SignalStoreReader, default_path
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Watch a td_can_bridges signal store")
+    parser.add_argument("--bus", default="motor_bus", help="Bus name; the store is /dev/shm/td_can_<bus>.")
+    parser.add_argument("--path", type=Path, help="Store file, when signal_store.path was set.")
+    parser.add_argument("--filter", default="", help="Only signals whose name contains this text.")
+    parser.add_argument("--interval", type=float, default=0.5, help="Seconds between prints, 0 to print once.")
+    args = parser.parse_args(argv)
+
+    path = args.path or default_path(args.bus)
+    reader = SignalStoreReader(path)
+    try:
+        while True:
+            if reader.replaced():
+                reader.close()
+                reader = SignalStoreReader(path)
+            now = time.time()
+            for name, (value, stamp, updates) in reader.snapshot().items():
+                if args.filter in name:
+                    print(f"{name:<40}{value:>14.4f}{(now - stamp) * 1e3:>10.1f} ms ago{updates:>10}")
+            if args.interval <= 0:
+                return 0
+            print()
+            time.sleep(args.interval)
+    except KeyboardInterrupt:
+        return 0
+    finally:
+        reader.close()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
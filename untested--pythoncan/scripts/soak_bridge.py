@@ -0,0 +1,539 @@
+#!/usr/bin/env python3
+"""Soak test of ``td_can_bridge`` for hours: fails on a trend in memory, latency or loss.
+
+The run starts three things on the interface and drives them for ``--hours``:
+
+* ``robostride_sim`` of ``td_can_bridge_cpp`` with ``--motors`` RS02 motors.
+  The bridge turns their active reporting on (``robostride_reporting``), so
+  every motor streams feedback every ``--report-ms`` to an RX binding.
+* ``td_can_bridge`` with that bus, a FootForce RX binding and
+  ``metrics.prometheus_port``.
+* ``td_can_bridge::LatencyProbe`` on the FootForce topic. It writes its
+  samples to a FIFO that this process reads, so nothing grows on disk.
+
+This process sends FootForce frames at ``--rate``, with a 16-bit sequence
+number in ``forceN``. With ``--send-interface`` the frames and the motors
+go out on a second interface (a second adapter on the same bus), so
+everything crosses the wire and the adapter into the bridge.
+
+Every ``--interval`` seconds one sample is appended to ``--output``
+(JSONL), with:
+
+* ``rss_mb``: resident memory of the bridge and its child processes;
+* ``rx_fps`` and ``tx_fps`` from the bridge's counters;
+* ``latency_us``: percentiles from this process's send to the probe;
+* ``sent``, ``received`` and ``lost`` FootForce frames, and the bridge's
+  drops (``SO_RXQ_OVFL``, full RX and TX queues, lost periodic frames);
+* ``queues``: depth and deepest depth of the RX and TX queues;
+* ``sim``: the simulator's own kernel drops, which would make it the
+  bottleneck;
+* ``adapter`` with ``--adapter``: free heap, its lowest ever, the free
+  stack of every FreeRTOS task and the drop counters, read through EP0 as
+  ``nativeCAN/triton_stats.py`` does (needs pyusb).
+
+At the end, and with ``--analyse`` on an earlier file, every series after
+``--warmup-min`` is fitted with a Theil-Sen line, which the odd GC pause
+or burst does not move. The run fails when a fitted change over the run
+passes its limit: RSS growth, firmware heap falling, p99 latency growth,
+receive rate decay or loss growth. A task stack under ``--min-stack-free``
+bytes fails it too, and so does a bridge that exits.
+
+    sudo python3 scripts/soak_bridge.py --setup-vcan --interface vcan0 --hours 24 --output soak.jsonl
+    sudo python3 scripts/soak_bridge.py --interface can0 --send-interface can1 --adapter --rate 2000
+    python3 scripts/soak_bridge.py --analyse soak.jsonl
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import os
+import platform
+import re
+import signal
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import urllib.request
+from collections import deque
+from pathlib import Path
+from statistics import median
+from typing import Any, Dict, List, Optional, Tuple
+
+import yaml
+
+from bench_bridge import DBC, ROOT, RX_ID, percentiles, setup_vcan, _commit
+from bench_launch import _tree
+
+MOTORS_DBC = ROOT / "td_can_bridges" / "schemas" / "robostride.dbc"
+FOOT_TOPIC = "/soak/foot_force"
+MOTOR_TOPIC = "/soak/rs02/feedback"
+IN_FLIGHT_S = 2.0  # frames younger than this are not yet counted as lost
+MAX_FIT_POINTS = 400  # Theil-Sen is quadratic: longer series are thinned evenly first
+
+# 12 motors: rx 1210/s, tx 1200/s; replies ... ; 0 kernel RX drops, 0 TX waits, ...
+SIM_RE = re.compile(r"motors: rx (\d+)/s, tx (\d+)/s; .* (\d+) kernel RX drops, (\d+) TX waits")
+
+
+def write_config(directory: Path, args) -> Path:
+    motors = {motor: args.report_ms for motor in range(1, args.motors + 1)}
+    cfg = {
+        "metrics": {"prometheus_port": args.port},
+        "qos": {"sensor": {"reliability": "best_effort", "depth": 1000}},
+        "buses": [
+            {
+                "name": "soak_sensors",
+                "interface": args.interface,
+                "dbc_file": str(DBC),
+                "rx_frames": {"FootForce": {"topic": FOOT_TOPIC, "type": "std_msgs/msg/Float32",
+                                            "fields": {"forceN": "data"}}},
+            },
+            {
+                "name": "soak_motors",
+                "interface": args.interface,
+                "dbc_file": str(MOTORS_DBC),
+                "robostride_reporting": {"motors": motors},
+                "rx_frames": {"RS02_Feedback": {"topic": MOTOR_TOPIC, "type": "std_msgs/msg/Float32",
+                                                "fields": {"position_rad": "data"}, "id_mask": 0x1F000000,
+                                                "id_fields": {"motor_id": [8, 15]}}},
+            },
+        ],
+    }
+    path = directory / "soak.yaml"
+    path.write_text(yaml.safe_dump(cfg))
+    return path
+
+
+class Sender(threading.Thread):
+    """FootForce frames at ``rate`` with the send time of every sequence number kept."""
+
+    def __init__(self, interface: str, rate: float):
+        super().__init__(daemon=True)
+        self.sock = socket.socket(socket.AF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+        self.sock.bind((interface,))
+        self.sock.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_RECV_OWN_MSGS, 0)
+        self.rate = rate
+        self.sent_ns = [0] * 0x10000
+        self.sent = 0
+        self.send_errors = 0
+        self.history: deque = deque(maxlen=64)  # (monotonic, sent), for the count IN_FLIGHT_S ago
+        self.stop = threading.Event()
+
+    def run(self) -> None:
+        period_ns = int(1e9 / self.rate)
+        start = time.monotonic_ns()
+        seq = 0
+        noted = 0.0
+        while not self.stop.is_set():
+            ahead = start + seq * period_ns - time.monotonic_ns()
+            if ahead > 0:
+                time.sleep(ahead / 1e9)
+            frame = struct.pack("=IB3x8s", RX_ID, 8, struct.pack("<H6x", seq & 0xFFFF))
+            self.sent_ns[seq & 0xFFFF] = time.monotonic_ns()
+            try:
+                self.sock.send(frame)
+                self.sent += 1
+            except OSError:  # ENOBUFS on a full TX queue
+                self.send_errors += 1
+            seq += 1
+            if time.monotonic() - noted >= 0.25:
+                noted = time.monotonic()
+                self.history.append((noted, self.sent))
+        self.sock.close()
+
+    def sent_before(self, age_s: float) -> int:
+        """Frames sent until ``age_s`` seconds ago."""
+
+        cutoff = time.monotonic() - age_s
+        older = [count for when, count in self.history if when <= cutoff]
+        return older[-1] if older else 0
+
+
+class ProbeReader(threading.Thread):
+    """Reads the probe's ``seq ns`` lines from a FIFO into per-sample latencies."""
+
+    def __init__(self, fifo: Path, sender: Sender):
+        super().__init__(daemon=True)
+        self.fifo = fifo
+        self.sender = sender
+        self.received = 0
+        self.lock = threading.Lock()
+        self.latencies: List[float] = []
+
+    def run(self) -> None:
+        with open(self.fifo) as f:  # blocks until the probe opens it
+            for line in f:
+                seq, ns = (int(v) for v in line.split())
+                latency = ns - self.sender.sent_ns[seq & 0xFFFF]
+                if not 0 <= latency < 10e9:  # before the sender started, or a wrapped sequence
+                    continue
+                with self.lock:
+                    self.received += 1
+                    self.latencies.append(latency / 1e3)
+
+    def take(self) -> Tuple[int, List[float]]:
+        with self.lock:
+            latencies, self.latencies = self.latencies, []
+            return self.received, latencies
+
+
+class SimReader(threading.Thread):
+    """Sums the kernel drops and TX waits of ``robostride_sim``'s stats lines."""
+
+    def __init__(self, proc: subprocess.Popen):
+        super().__init__(daemon=True)
+        self.proc = proc
+        self.rx_fps = self.tx_fps = 0
+        self.drops = self.tx_waits = 0
+
+    def run(self) -> None:
+        for line in self.proc.stderr:
+            match = SIM_RE.search(line)
+            if match:
+                rx, tx, drops, waits = (int(v) for v in match.groups())
+                self.rx_fps, self.tx_fps = rx, tx
+                self.drops += drops
+                self.tx_waits += waits
+
+
+class Adapter:
+    """Heap, task stacks and drop counters through EP0; None when pyusb or the device is not there."""
+
+    def __init__(self, channel: int):
+        self.channel = channel
+        self.dev = None
+        try:
+            sys.path.insert(0, str(ROOT.parent / "nativeCAN"))
+            import usb.core
+            import triton_stats
+            self.stats = triton_stats
+            self.dev = usb.core.find(idVendor=triton_stats.USB_VID, idProduct=triton_stats.USB_PID)
+        except ImportError:
+            pass
+        if self.dev is None:
+            print("  (adapter statistics unavailable: no pyusb or no device)")
+
+    def read(self) -> Optional[Dict[str, Any]]:
+        if self.dev is None:
+            return None
+        try:
+            tasks = self.stats.read_tasks(self.dev)
+            counters = self.stats.read_stats(self.dev, self.channel)
+        except Exception as e:  # usb.core.USBError, permissions
+            print(f"  (adapter statistics: {e})")
+            self.dev = None
+            return None
+        out: Dict[str, Any] = {k: counters[k] for k in ("rx_dropped", "rx_evicted", "rx_missed", "rx_overrun")}
+        if tasks["memory"]:
+            _, _, out["heap_free"], out["heap_min_free"] = tasks["memory"]
+        out["stack_free"] = {name: task[1] for name, task in tasks["tasks"].items()}
+        return out
+
+
+def scrape(port: int) -> Dict[str, float]:
+    """``/metrics`` of the bridge, each metric summed over its labels."""
+
+    with urllib.request.urlopen(f"http://127.0.0.1:{port}/metrics", timeout=5) as response:
+        text = response.read().decode()
+    out: Dict[str, float] = {}
+    for line in text.splitlines():
+        if not line or line.startswith("#"):
+            continue
+        name, _, value = line.rpartition(" ")
+        name = name.split("{", 1)[0]
+        out[name] = out.get(name, 0.0) + float(value)
+    return out
+
+
+def rss_mb(root: int) -> float:
+    total = 0
+    for pid in _tree([root]):
+        try:
+            for line in Path(f"/proc/{pid}/status").read_text().splitlines():
+                if line.startswith("VmRSS:"):
+                    total += int(line.split()[1])
+        except OSError:
+            continue
+    return total / 1024.0
+
+
+DROPS = {
+    "rx_overflow": "td_can_rx_overflow_drops_total",
+    "rx_queue": "td_can_rx_queue_dropped_total",
+    "tx_queue": "td_can_tx_queue_dropped_total",
+    "rx_lost": "td_can_rx_lost_frames_total",
+}
+QUEUES = {
+    "rx_depth": "td_can_rx_queue_depth",
+    "rx_max_depth": "td_can_rx_queue_max_depth",
+    "tx_depth": "td_can_tx_queue_depth",
+    "tx_max_depth": "td_can_tx_queue_max_depth",
+}
+
+
+def _fit_slope(points: List[Tuple[float, float]]) -> float:
+    """Theil-Sen slope: the median of the slopes between every two points."""
+
+    if len(points) > MAX_FIT_POINTS:
+        step = len(points) / MAX_FIT_POINTS
+        points = [points[int(i * step)] for i in range(MAX_FIT_POINTS)]
+    slopes = [(y2 - y1) / (x2 - x1) for i, (x1, y1) in enumerate(points) for x2, y2 in points[i + 1:] if x2 != x1]
+    return median(slopes) if slopes else 0.0
+
+
+def _series(samples: List[Dict[str, Any]], value) -> List[Tuple[float, float]]:
+    out = []
+    for s in samples:
+        try:
+            v = value(s)
+        except (KeyError, TypeError):
+            continue
+        if v is not None:
+            out.append((s["t_h"], float(v)))
+    return out
+
+
+def _loss_ratio(s: Dict[str, Any]) -> Optional[float]:
+    sent = s["sent"]
+    return (s["lost"] + sum(s["drops"].values())) / sent if sent else None
+
+
+def analyse(samples: List[Dict[str, Any]], limits: Dict[str, float]) -> Dict[str, Any]:
+    """Fitted changes over the run after the warm-up, and the limits they broke."""
+
+    settled = [s for s in samples if s["t_h"] * 60.0 >= limits["warmup_min"]]
+    verdict: Dict[str, Any] = {"samples": len(samples), "settled": len(settled), "failures": [], "trends": {}}
+    if len(settled) < 10:
+        verdict["failures"].append(f"only {len(settled)} samples after the warm-up: too short to judge")
+        return verdict
+    span_h = settled[-1]["t_h"] - settled[0]["t_h"]
+    verdict["hours"] = round(span_h, 2)
+
+    def change(name: str, value, relative: bool = False) -> Optional[float]:
+        points = _series(settled, value)
+        if len(points) < 10:
+            return None
+        delta = _fit_slope(points) * span_h
+        if relative:
+            base = median(v for _, v in points[:max(1, len(points) // 10)])
+            delta = delta / base if base else 0.0
+        verdict["trends"][name] = round(delta, 6)
+        return delta
+
+    checks = [
+        ("rss_mb", lambda s: s["rss_mb"], False, lambda d: d > limits["max_rss_growth_mb"],
+         "bridge RSS grew {:.1f} MB"),
+        ("rx_fps", lambda s: s["rx_fps"], True, lambda d: d < -limits["max_fps_decay"],
+         "receive rate changed {:+.1%}"),
+        ("latency_p99", lambda s: s["latency_us"]["p99"], True, lambda d: d > limits["max_latency_growth"],
+         "p99 latency grew {:.1%}"),
+        ("loss_ratio", _loss_ratio, False, lambda d: d > limits["max_loss_growth"],
+         "loss ratio grew {:.2e}"),
+        ("heap_free", lambda s: s["adapter"]["heap_free"], False, lambda d: d < -limits["max_heap_loss"],
+         "adapter heap fell {:.0f} B"),
+    ]
+    for name, value, relative, broken, text in checks:
+        delta = change(name, value, relative)
+        if delta is not None and broken(delta):
+            verdict["failures"].append(text.format(-delta if name == "heap_free" else delta))
+
+    stacks: Dict[str, int] = {}
+    for s in settled:
+        for task, free in ((s.get("adapter") or {}).get("stack_free") or {}).items():
+            stacks[task] = min(free, stacks.get(task, free))
+    verdict["stack_free_min"] = stacks
+    for task, free in sorted(stacks.items()):
+        if free < limits["min_stack_free"]:
+            verdict["failures"].append(f"task {task} has {free} B of stack left")
+    exits = [s["bridge_exit"] for s in samples if s.get("bridge_exit") is not None]
+    if exits:
+        verdict["failures"].append(f"the bridge exited with status {exits[0]}")
+    return verdict
+
+
+def _limits(args) -> Dict[str, float]:
+    return {key: getattr(args, key) for key in (
+        "warmup_min", "max_rss_growth_mb", "max_fps_decay", "max_latency_growth", "max_loss_growth",
+        "max_heap_loss", "min_stack_free")}
+
+
+def report(verdict: Dict[str, Any]) -> int:
+    for name, delta in sorted(verdict["trends"].items()):
+        print(f"  {name:12} fitted change over the run {delta:+.6g}")
+    for task, free in sorted(verdict.get("stack_free_min", {}).items()):
+        print(f"  stack {task:16} {free} B free at least")
+    if verdict["failures"]:
+        for failure in verdict["failures"]:
+            print(f"FAIL: {failure}")
+        return 1
+    print(f"PASS: no trend over {verdict.get('hours')} h")
+    return 0
+
+
+def _stop(procs: List[subprocess.Popen]) -> None:
+    for p in procs:
+        if p.poll() is None:
+            os.killpg(p.pid, signal.SIGINT)
+    for p in procs:
+        try:
+            p.wait(timeout=10)
+        except subprocess.TimeoutExpired:
+            os.killpg(p.pid, signal.SIGKILL)
+
+
+def soak(args, directory: Path, out) -> List[Dict[str, Any]]:
+    cfg = write_config(directory, args)
+    fifo = directory / "probe.fifo"
+    os.mkfifo(fifo)
+    send_interface = args.send_interface or args.interface
+
+    sim = subprocess.Popen(
+        ["ros2", "run", "td_can_bridge_cpp", "robostride_sim", "--interface", send_interface,
+         "--motors", f"1-{args.motors}:RS02", "--stats-s", "10"],
+        start_new_session=True, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+    bridge = subprocess.Popen(
+        ["ros2", "run", "td_can_bridges", "td_can_bridge", "--ros-args", "-p", f"config:={cfg}"],
+        start_new_session=True, stdout=subprocess.DEVNULL, stderr=subprocess.STDOUT)
+    probe = subprocess.Popen(
+        ["ros2", "run", "td_can_bridge_cpp", "latency_probe", "--ros-args",
+         "-p", f"topic:={FOOT_TOPIC}", "-p", f"output:={fifo}"],
+        start_new_session=True, stdout=subprocess.DEVNULL, stderr=subprocess.STDOUT)
+    procs = [probe, bridge, sim]
+    sender = Sender(send_interface, args.rate)
+    reader = ProbeReader(fifo, sender)
+    sim_reader = SimReader(sim)
+    adapter = Adapter(args.channel) if args.adapter else None
+    samples: List[Dict[str, Any]] = []
+    try:
+        reader.start()
+        sim_reader.start()
+        deadline = time.monotonic() + args.startup
+        while True:
+            try:
+                prev = scrape(args.port)
+                break
+            except OSError:
+                if time.monotonic() > deadline or bridge.poll() is not None:
+                    raise RuntimeError(f"the bridge's /metrics did not come up within {args.startup:g} s")
+                time.sleep(0.5)
+        sender.start()
+        begin = prev_t = time.monotonic()
+        prev_lagged = prev_received = 0
+        prev_sim_drops = 0
+        prev_adapter = adapter.read() if adapter else None
+        end = begin + args.hours * 3600.0
+        while time.monotonic() < end:
+            time.sleep(max(0.0, prev_t + args.interval - time.monotonic()))
+            now = time.monotonic()
+            sample: Dict[str, Any] = {"t_h": round((now - begin) / 3600.0, 4)}
+            if bridge.poll() is not None:
+                sample["bridge_exit"] = bridge.returncode
+                samples.append(sample)
+                out.write(json.dumps({"sample": sample}, sort_keys=True) + "\n")
+                break
+            metrics = scrape(args.port)
+            dt = now - prev_t
+            received, latencies = reader.take()
+            lagged = sender.sent_before(IN_FLIGHT_S)
+            sample.update({
+                "rss_mb": round(rss_mb(bridge.pid), 2),
+                "rx_fps": round((metrics.get("td_can_rx_frames_total", 0) - prev.get("td_can_rx_frames_total", 0)) / dt, 1),
+                "tx_fps": round((metrics.get("td_can_tx_frames_total", 0) - prev.get("td_can_tx_frames_total", 0)) / dt, 1),
+                "latency_us": {k: round(v, 1) for k, v in percentiles(latencies).items()},
+                "sent": lagged - prev_lagged,
+                "received": received - prev_received,
+                "lost": max(0, (lagged - prev_lagged) - (received - prev_received)),
+                "send_errors": sender.send_errors,
+                "drops": {key: int(metrics.get(name, 0) - prev.get(name, 0)) for key, name in DROPS.items()},
+                "queues": {key: int(metrics.get(name, 0)) for key, name in QUEUES.items()},
+                "sim": {"rx_fps": sim_reader.rx_fps, "tx_fps": sim_reader.tx_fps,
+                        "drops": sim_reader.drops - prev_sim_drops, "tx_waits": sim_reader.tx_waits},
+            })
+            if adapter:
+                stats = adapter.read()
+                if stats:
+                    sample["adapter"] = dict(stats)
+                    if prev_adapter:
+                        for key in ("rx_dropped", "rx_evicted", "rx_missed", "rx_overrun"):
+                            sample["adapter"][key] = (stats[key] - prev_adapter[key]) & 0xFFFFFFFF
+                    prev_adapter = stats
+            samples.append(sample)
+            out.write(json.dumps({"sample": sample}, sort_keys=True) + "\n")
+            out.flush()
+            lat = sample["latency_us"]
+            print(f"  {sample['t_h'] * 60:6.0f} min: {sample['rss_mb']:.1f} MB, {sample['rx_fps']:.0f} fps, "
+                  f"p99 {lat.get('p99')} us, lost {sample['lost']}, drops {sum(sample['drops'].values())}")
+            prev, prev_t = metrics, now
+            prev_lagged, prev_received, prev_sim_drops = lagged, received, sim_reader.drops
+    except KeyboardInterrupt:
+        print("  stopped; judging the samples so far")
+    finally:
+        sender.stop.set()
+        _stop(procs)
+    return samples
+
+
+def build_arg_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Hours-long td_can_bridge soak that fails on a trend")
+    parser.add_argument("--interface", default="vcan0", help="Interface the bridge runs on.")
+    parser.add_argument("--send-interface", help="Interface for the frames and the motors (default: --interface).")
+    parser.add_argument("--setup-vcan", action="store_true", help="Create the interface first if it is missing.")
+    parser.add_argument("--hours", type=float, default=24.0, help="Length of the run.")
+    parser.add_argument("--interval", type=float, default=60.0, help="Seconds between samples.")
+    parser.add_argument("--rate", type=float, default=1000.0, help="FootForce frames per second.")
+    parser.add_argument("--motors", type=int, default=12, help="Simulated RS02 motors, IDs 1 up.")
+    parser.add_argument("--report-ms", type=float, default=10.0, help="Active reporting interval of every motor.")
+    parser.add_argument("--port", type=int, default=9118, help="The bridge's prometheus_port.")
+    parser.add_argument("--startup", type=float, default=30.0, help="Seconds to wait for the bridge to come up.")
+    parser.add_argument("--adapter", action="store_true", help="Also sample the TritonCAN adapter's heap and stacks.")
+    parser.add_argument("--channel", type=int, default=0, help="Adapter channel of the drop counters.")
+    parser.add_argument("--output", type=Path, default=Path("soak.jsonl"), help="JSONL samples file.")
+    parser.add_argument("--analyse", type=Path, help="Judge an earlier --output file instead of running.")
+    limits = parser.add_argument_group("limits (fitted change over the run after the warm-up)")
+    limits.add_argument("--warmup-min", type=float, default=10.0, help="Minutes left out of the fits.")
+    limits.add_argument("--max-rss-growth-mb", type=float, default=8.0)
+    limits.add_argument("--max-fps-decay", type=float, default=0.02, help="Share of the receive rate.")
+    limits.add_argument("--max-latency-growth", type=float, default=0.25, help="Share of the early p99.")
+    limits.add_argument("--max-loss-growth", type=float, default=1e-4, help="Lost and dropped frames per frame sent.")
+    limits.add_argument("--max-heap-loss", type=float, default=1024.0, help="Bytes of adapter heap.")
+    limits.add_argument("--min-stack-free", type=int, default=256, help="Bytes every adapter task keeps free.")
+    return parser
+
+
+def main(argv: Optional[List[str]] = None) -> int:
+    args = build_arg_parser().parse_args(argv)
+    if args.analyse:
+        samples = [json.loads(line)["sample"] for line in args.analyse.read_text().splitlines()
+                   if line.strip() and "sample" in json.loads(line)]
+        return report(analyse(samples, _limits(args)))
+
+    if args.setup_vcan:
+        setup_vcan(args.interface)
+    run = {
+        "commit": _commit(),
+        "host": platform.node(),
+        "kernel": platform.release(),
+        "rmw": os.environ.get("RMW_IMPLEMENTATION"),
+        "interface": args.interface,
+        "send_interface": args.send_interface,
+        "rate": args.rate,
+        "motors": args.motors,
+        "report_ms": args.report_ms,
+        "interval_s": args.interval,
+        "time": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+    }
+    with open(args.output, "w") as out, tempfile.TemporaryDirectory() as tmp:
+        out.write(json.dumps({"run": run}, sort_keys=True) + "\n")
+        samples = soak(args, Path(tmp), out)
+        verdict = analyse(samples, _limits(args))
+        out.write(json.dumps({"verdict": verdict}, sort_keys=True) + "\n")
+    print(f"samples written to {args.output}")
+    return report(verdict)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,68 +1,96 @@
 
 #!/usr/bin/env python3
+"""Register CAN devices in a td_can_bridges config.
+
+By default a device gets one ``publish: frame`` binding per frame it sends
+(td_can_bridges.devices); ``--per-signal`` keeps the older one binding per
+signal. ``--bulk GROUP`` registers a whole ID range as one ``devices`` group,
+which the bridge expands when it loads the file:
+
+    python3 scripts/td_can_register.py --bus motor_bus --class motor_rs02 --ids 0x210,0x211 --topic-prefix /td/rs02/1
+    python3 scripts/td_can_register.py --bus motor_bus --class motor_rs02 --bulk legs --first-id 0x210 --count 40
+
+Values not given as options are asked for.
+"""
 import argparse, sys, yaml, os
 from pathlib import Path
 
+from td_can_bridges.devices import DEVICE_CLASSES, device_bindings, group_ids
+
 DEVICE_TEMPLATES = {
-    # Each template returns a list of rx_frame entries to add for this device.
+    # --per-signal: each template returns a list of rx_frame entries to add for this device.
     # Each entry: (key_name, spec_dict)
     'motor_rs02': lambda topic_prefix, id1, id2: [
         (f"RS02_Status1@{id1}", {
             'topic': f"{topic_prefix}/angle_deg",
             'type': 'std_msgs/msg/Float32',
             'fields': {'mech_angle_deg': 'data'},
-            'frame_id': int(id1, 16)
+            'can_id': int(id1, 16)
         }),
         (f"RS02_Status1__vel@{id1}", {
             'topic': f"{topic_prefix}/velocity_rad_s",
             'type': 'std_msgs/msg/Float32',
             'fields': {'mech_velocity_rads': 'data'},
-            'frame_id': int(id1, 16)
+            'can_id': int(id1, 16)
         }),
         (f"RS02_Status1__current@{id1}", {
             'topic': f"{topic_prefix}/phase_current_a",
             'type': 'std_msgs/msg/Float32',
             'fields': {'phase_current_A': 'data'},
-            'frame_id': int(id1, 16)
+            'can_id': int(id1, 16)
         }),
         (f"RS02_Status1__busv@{id1}", {
             'topic': f"{topic_prefix}/bus_voltage_v",
             'type': 'std_msgs/msg/Float32',
             'fields': {'dc_bus_V': 'data'},
-            'frame_id': int(id1, 16)
+            'can_id': int(id1, 16)
         }),
         (f"RS02_Status2__mtemp@{id2}", {
             'topic': f"{topic_prefix}/motor_temp_c",
             'type': 'std_msgs/msg/Float32',
             'fields': {'motor_temp_C': 'data'},
-            'frame_id': int(id2, 16)
+            'can_id': int(id2, 16)
         }),
         (f"RS02_Status2__dtemp@{id2}", {
             'topic': f"{topic_prefix}/driver_temp_c",
             'type': 'std_msgs/msg/Float32',
             'fields': {'driver_temp_C': 'data'},
-            'frame_id': int(id2, 16)
+            'can_id': int(id2, 16)
         }),
         (f"RS02_Status2__faults@{id2}", {
             'topic': f"{topic_prefix}/fault_bits",
             'type': 'std_msgs/msg/UInt32',
             'fields': {'fault_bits': 'data'},
-            'frame_id': int(id2, 16)
+            'can_id': int(id2, 16)
         }),
         (f"RS02_Status2__status@{id2}", {
             'topic': f"{topic_prefix}/status_bits",
             'type': 'std_msgs/msg/UInt32',
             'fields': {'status_bits': 'data'},
-            'frame_id': int(id2, 16)
+            'can_id': int(id2, 16)
         }),
     ],
+    # Every RobStride motor on the bus at once: one masked binding per signal, the motor ID
+    # comes from bits 8-15 of the comm type 2 feedback ID and picks the topic
+    'robostride': lambda topic_prefix: [
+        (f"RS02_Feedback__{name}", {
+            'dbc_message': 'RS02_Feedback',
+            'id_mask': 0x1F000000,
+            'id_fields': {'motor_id': [8, 15]},
+            'topic': f"{topic_prefix}/{{motor_id}}/{name}",
+            'type': 'std_msgs/msg/Float32',
+            'fields': {signal: 'data'},
+        })
+        for name, signal in (('position_rad', 'position_rad'), ('velocity_rad_s', 'velocity_rads'),
+                             ('torque_nm', 'torque_Nm'), ('temperature_c', 'temperature_C'))
+    ],
     # Simple one-frame devices, customize as needed:
     'foot_sensor': lambda topic_prefix, id_hex: [
         (f"FootForce@{id_hex}", {
             'topic': f"{topic_prefix}/force_n",
             'type': 'std_msgs/msg/Float32',
             'fields': {'forceN': 'data'},
-            'frame_id': int(id_hex, 16)
+            'can_id': int(id_hex, 16)
         })
     ],
     'imu': lambda topic_prefix, id_hex: [
@@ -70,7 +98,7 @@ DEVICE_TEMPLATES = {
             'topic': f"{topic_prefix}/temp_c",
             'type': 'std_msgs/msg/Float32',
             'fields': {'temp_C': 'data'},
-            'frame_id': int(id_hex, 16)
+            'can_id': int(id_hex, 16)
         })
     ],
     'pdb': lambda topic_prefix, id_hex: [
@@ -78,7 +106,7 @@ DEVICE_TEMPLATES = {
             'topic': f"{topic_prefix}/bus_voltage_v",
             'type': 'std_msgs/msg/Float32',
             'fields': {'bus_V': 'data'},
-            'frame_id': int(id_hex, 16)
+            'can_id': int(id_hex, 16)
         })
     ],
 }
@@ -89,10 +117,89 @@ def pick_bus(buses, interface):
             return b
     raise SystemExit(f"No bus matches interface/name: {interface}. Available: {[b.get('interface') for b in buses]}")
 
+def ask(value, prompt, default=None):
+    if value is not None:
+        return value
+    return input(prompt).strip() or default
+
+
+def parse_ids(text):
+    return [int(part, 16) if not part.strip().lower().startswith('0x') else int(part, 0)
+            for part in text.split(',') if part.strip()]
+
+
+def per_signal_entries(dtype, topic_prefix, args):
+    if dtype == 'motor_rs02':
+        ids = parse_ids(args.ids) if args.ids else []
+        id1 = hex(ids[0]) if ids else input("Enter CAN ID (hex) for RS02_Status1 (e.g., 0x210): ").strip()
+        id2 = hex(ids[1]) if len(ids) > 1 else input("Enter CAN ID (hex) for RS02_Status2 (e.g., 0x211): ").strip()
+        entries = DEVICE_TEMPLATES[dtype](topic_prefix, id1, id2)
+    elif dtype == 'robostride':
+        entries = DEVICE_TEMPLATES[dtype](topic_prefix)
+    else:
+        idx = hex(parse_ids(args.ids)[0]) if args.ids else input("Enter CAN ID (hex) for device (e.g., 0x300): ").strip()
+        entries = DEVICE_TEMPLATES[dtype](topic_prefix, idx)
+
+    for key, spec in entries:
+        # Key names must reference existing DBC message names used in mapping;
+        # the key itself is just a label, but we will store a field 'dbc_msg' for clarity.
+        # For compatibility with our parser, the key should be the DBC message name or any label.
+        # We'll ensure DBC messages exist in motors.dbc / sensors.dbc.
+        # Here we embed 'dbc_message' so future tooling can read it (not required by runtime).
+        if 'RS02_Status1' in key:
+            spec['dbc_message'] = 'RS02_Status1'
+        elif 'RS02_Status2' in key:
+            spec['dbc_message'] = 'RS02_Status2'
+        elif 'FootForce' in key:
+            spec['dbc_message'] = 'FootForce'
+        elif 'IMU_Data' in key:
+            spec['dbc_message'] = 'IMU_Data'
+        elif 'PDB_Status' in key:
+            spec['dbc_message'] = 'PDB_Status'
+    return entries
+
+
+def device_entries(dtype, topic_prefix, args):
+    cls = DEVICE_CLASSES[dtype]
+    ids = []
+    if not cls.masked:
+        text = ask(args.ids, f"CAN IDs (hex) of {', '.join(cls.messages)} (e.g., 0x210,0x211): ", '')
+        ids = parse_ids(text)
+        if len(ids) == 1 and len(cls.messages) > 1:
+            ids = [ids[0] + i for i in range(len(cls.messages))]  # consecutive from the first
+    key = args.name or topic_prefix.strip('/').replace('/', '_') or dtype
+    return list(device_bindings(dtype, key, topic_prefix, ids).items())
+
+
+def bulk_group(dtype, group, args):
+    cls = DEVICE_CLASSES[dtype]
+    topic = args.topic_prefix or f"/td/{group}"
+    if not cls.masked and '{index}' not in topic and '{can_id}' not in topic:
+        topic += '/{index}'  # a topic per device
+    spec = {'class': dtype, 'topic': topic}
+    if not cls.masked:
+        spec['first_id'] = int(ask(args.first_id, "First CAN ID (hex) of device 0 (e.g., 0x210): "), 16)
+        spec['count'] = int(ask(args.count, "Number of devices: "))
+        if args.id_stride is not None:
+            spec['id_stride'] = int(args.id_stride, 0)
+        group_ids(spec, len(cls.messages), f"devices.{group}")  # reject a bad range before writing
+    return spec
+
+
 def main():
-    ap = argparse.ArgumentParser(description='Register a CAN node in td_can_bridges config by prompting for ID and device type.')
+    ap = argparse.ArgumentParser(description='Register CAN nodes in a td_can_bridges config.')
     ap.add_argument('--config', default=str(Path(__file__).resolve().parents[1] / 'config' / 'example_multibus.yaml'),
                     help='Path to td_can_bridges YAML config to modify.')
+    ap.add_argument('--bus', help='Bus name or interface to register on.')
+    ap.add_argument('--class', dest='dtype', help=f"Device class: {' | '.join(DEVICE_TEMPLATES)}.")
+    ap.add_argument('--topic-prefix', help='Topic prefix (bulk: may use {index} and {can_id}).')
+    ap.add_argument('--name', help='Entry key of a single device (default: from the topic prefix).')
+    ap.add_argument('--ids', help='CAN IDs of one device, one per frame, e.g. 0x210,0x211.')
+    ap.add_argument('--per-signal', action='store_true', help='One binding per signal, as before device bindings.')
+    ap.add_argument('--bulk', metavar='GROUP', help='Register an ID range as the devices group GROUP.')
+    ap.add_argument('--first-id', help='--bulk: first CAN ID (hex) of device 0.')
+    ap.add_argument('--count', help='--bulk: number of devices.')
+    ap.add_argument('--id-stride', help='--bulk: CAN IDs between devices (default: frames per device).')
     args = ap.parse_args()
 
     cfg_path = Path(args.config)
@@ -105,10 +212,12 @@ def main():
         sys.exit("No 'buses' in config.")
 
     print("=== td_can_register ===")
-    print("Available buses:")
-    for b in buses:
-        print(f" - name={b.get('name')} interface={b.get('interface')}")
-    interface = input("Enter bus name or interface to register on (e.g., 'motor_bus' or 'can0'): ").strip()
+    interface = args.bus
+    if interface is None:
+        print("Available buses:")
+        for b in buses:
+            print(f" - name={b.get('name')} interface={b.get('interface')}")
+        interface = input("Enter bus name or interface to register on (e.g., 'motor_bus' or 'can0'): ").strip()
     bus = None
     for b in buses:
         if b.get('name') == interface or b.get('interface') == interface:
@@ -117,37 +226,30 @@ def main():
     if bus is None:
         sys.exit("No matching bus found.")
 
-    dtype = input("Device type [motor_rs02 | foot_sensor | imu | pdb]: ").strip().lower()
+    dtype = ask(args.dtype, f"Device type [{' | '.join(DEVICE_TEMPLATES)}]: ", '').lower()
     if dtype not in DEVICE_TEMPLATES:
         sys.exit(f"Unsupported device type: {dtype}")
 
-    topic_prefix = input("Topic prefix (e.g., /td/rs02/1): ").strip() or "/td/device"
+    try:
+        if args.bulk:
+            spec = bulk_group(dtype, args.bulk, args)
+            bus.setdefault('devices', {})[args.bulk] = spec
+            cfg_path.write_text(yaml.safe_dump(cfg, sort_keys=False))
+            count = spec.get('count', 'every')
+            print(f"Updated {cfg_path}")
+            print(f"Added devices group '{args.bulk}': {count} {dtype} device(s) -> {spec['topic']}")
+            return
 
-    if dtype == 'motor_rs02':
-        id1 = input("Enter CAN ID (hex) for RS02_Status1 (e.g., 0x210): ").strip()
-        id2 = input("Enter CAN ID (hex) for RS02_Status2 (e.g., 0x211): ").strip()
-        entries = DEVICE_TEMPLATES[dtype](topic_prefix, id1, id2)
-    else:
-        idx = input("Enter CAN ID (hex) for device (e.g., 0x300): ").strip()
-        entries = DEVICE_TEMPLATES[dtype](topic_prefix, idx)
+        topic_prefix = ask(args.topic_prefix, "Topic prefix (e.g., /td/rs02/1): ", "/td/device")
+        if args.per_signal:
+            entries = per_signal_entries(dtype, topic_prefix, args)
+        else:
+            entries = device_entries(dtype, topic_prefix, args)
+    except ValueError as exc:
+        sys.exit(str(exc))
 
     rx_frames = bus.setdefault('rx_frames', {})
     for key, spec in entries:
-        # Key names must reference existing DBC message names used in mapping;
-        # the key itself is just a label, but we will store a field 'dbc_msg' for clarity.
-        # For compatibility with our parser, the key should be the DBC message name or any label.
-        # We'll ensure DBC messages exist in motors.dbc / sensors.dbc.
-        # Here we embed 'dbc_message' so future tooling can read it (not required by runtime).
-        if 'RS02_Status1' in key:
-            spec['dbc_message'] = 'RS02_Status1'
-        elif 'RS02_Status2' in key:
-            spec['dbc_message'] = 'RS02_Status2'
-        elif 'FootForce' in key:
-            spec['dbc_message'] = 'FootForce'
-        elif 'IMU_Data' in key:
-            spec['dbc_message'] = 'IMU_Data'
-        elif 'PDB_Status' in key:
-            spec['dbc_message'] = 'PDB_Status'
         rx_frames[key] = spec
 
     cfg_path.write_text(yaml.safe_dump(cfg, sort_keys=False))
@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+"""Base-station end of the telemetry uplink: write the robot's chunks to a compact log.
+
+The robot's bus needs an ``uplink`` entry pointing at this host
+(:mod:`td_can_bridges.uplink`). Stop with Ctrl-C; the log is indexed then,
+and replays like any recording:
+
+    python3 scripts/uplink_receiver.py --port 47000 -o field.tdlog
+    python3 scripts/can_log_export.py field.tdlog --dbc motors.dbc -o field/
+"""
+
+from __future__ import annotations
+
+import argparse
+import logging
+import sys
+from pathlib import Path
+
+from td_can_bridges.uplink import UplinkReceiver
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Receive a td_can_bridges telemetry uplink into a .tdlog file")
+    parser.add_argument("-o", "--output", type=Path, required=True, help="Log to write (.tdlog).")
+    parser.add_argument("--port", type=int, default=47000)
+    parser.add_argument("--host", default="", help="Address to listen on (default: all).")
+    parser.add_argument("--reorder", type=float, default=1.0, help="Seconds to wait for a late chunk.")
+    args = parser.parse_args(argv)
+
+    logging.basicConfig(level=logging.INFO, format="%(message)s")
+    receiver = UplinkReceiver(args.output, args.port, args.host, args.reorder)
+    try:
+        receiver.serve()
+    except KeyboardInterrupt:
+        pass
+    stats = receiver.stats()
+    print(f"{args.output}: {stats['chunks']} chunks, {stats['lost_chunks']} lost, {stats['late_chunks']} late, "
+          f"{stats['bad_datagrams']} bad datagrams, {stats['sessions']} session(s)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -95,7 +95,7 @@ def main(argv: list[str] | None = None) -> int:
     if rx_binding is None:
         parser.error(f"RX binding '{role['rx']}' missing from config {args.config}")
 
-    def _handle_rx(payload: Dict[str, Any], binding: RxBindingConfig) -> None:
+    def _handle_rx(payload: Dict[str, Any], binding: RxBindingConfig, timestamp: float) -> None:
         raw_blink = payload.get("blink", 0)
         raw_seq = payload.get("seq", 0)
         try:
@@ -3,19 +3,45 @@ from setuptools import setup
 
 package_name = 'td_can_bridges'
 
+# Optional C++ core (native/), used by rx_mode: native and tx_mode: native. Without pybind11 the package
+# installs without it and CanBusService falls back to the Python loops.
+try:
+    from pybind11.setup_helpers import Pybind11Extension, build_ext
+except ImportError:
+    ext_modules, cmdclass = [], {}
+else:
+    ext_modules = [
+        Pybind11Extension(
+            package_name + '._can_core',
+            ['native/rx_core.cpp', 'native/busy_poll.cpp', 'native/block_decode.cpp', 'native/tx_queue.cpp',
+             'native/module.cpp'],
+            include_dirs=['native'],
+            cxx_std=17,
+            # scale/offset must round like Python's float arithmetic: no fused multiply-add
+            extra_compile_args=['-O2', '-ffp-contract=off'],
+        ),
+    ]
+    cmdclass = {'build_ext': build_ext}
+
 setup(
     name=package_name,
     version='0.1.0',
     packages=[package_name],
+    ext_modules=ext_modules,
+    cmdclass=cmdclass,
     data_files=[
         ('share/ament_index/resource_index/packages', ['resource/' + package_name]),
         ('share/' + package_name, ['package.xml']),
-        ('share/' + package_name + '/config', ['config/example_multibus.yaml', 'config/example_singlebus.yaml']),
-        ('share/' + package_name + '/launch', ['launch/td_can_multibus.launch.py', 'launch/td_can_motor_and_sensor_split.launch.py']),
-        ('share/' + package_name + '/schemas', ['td_can_bridges/schemas/motors.dbc', 'td_can_bridges/schemas/sensors.dbc']),
+        ('share/' + package_name + '/config', ['config/example_multibus.yaml', 'config/example_singlebus.yaml',
+                                               'config/example_topology.yaml']),
+        ('share/' + package_name + '/launch', ['launch/td_can_multibus.launch.py', 'launch/td_can_motor_and_sensor_split.launch.py',
+                                               'launch/td_can_composed.launch.py',
+                                               'launch/td_can_motor_and_sensor_composed.launch.py']),
+        ('share/' + package_name + '/schemas', ['td_can_bridges/schemas/motors.dbc', 'td_can_bridges/schemas/sensors.dbc',
+                                                'td_can_bridges/schemas/robostride.dbc']),
     ],
     install_requires=['setuptools'],
-    zip_safe=True,
+    zip_safe=False,
     maintainer='td',
     maintainer_email='td@example.com',
     description='Multi-bus ROS 2 <-> SocketCAN bridges with DBC mapping',
@@ -25,5 +51,10 @@ setup(
         'console_scripts': [
             'td_can_bridge = td_can_bridges.bridge_node:main',
         ],
+        # can.Bus(interface="tritoncand", channel=...) for any python-can program; td_sim for tests
+        'can.interface': [
+            'tritoncand = td_can_bridges.tritoncand_bus:TritoncandBus',
+            'td_sim = td_can_bridges.sim_bus:SimBus',
+        ],
     },
 )
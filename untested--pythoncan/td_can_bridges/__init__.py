@@ -1,5 +1,7 @@
 """Public API for the Triton Devices CAN bridge package."""
 
+from .async_service import AsyncCanBusService, RxFrame
+from .robostride_params import ParameterClient
 from .service import (
     BridgeConfig,
     BusConfig,
@@ -10,10 +12,13 @@ from .service import (
 )
 
 __all__ = [
+    "AsyncCanBusService",
     "BridgeConfig",
     "BusConfig",
     "CanBusService",
+    "ParameterClient",
     "RxBindingConfig",
+    "RxFrame",
     "TxBindingConfig",
     "load_bridge_config",
 ]
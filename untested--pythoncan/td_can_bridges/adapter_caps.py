@@ -0,0 +1,123 @@
+"""What a TritonCAN adapter behind a SocketCAN interface supports.
+
+The firmware answers ``GS_USB_BREQ_TRITON_CAPS`` (``struct gs_triton_caps``
+in ``nativeCAN/USB_CAN_esp32s3/main/gs_usb.h``) with a feature bitmap plus
+its buffer sizes and limits. It is an EP0 vendor request, so it works while
+the gs_usb kernel driver has the device. The interface is mapped to its USB
+device through sysfs, as ``nativeCAN/triton_discover.py`` does.
+
+:func:`read_adapter_caps` returns None for anything that is not a TritonCAN
+adapter, without pyusb or permission on the device node, and for firmware
+from before the request. Callers then assume plain gs_usb.
+"""
+
+from __future__ import annotations
+
+import os
+import struct
+from dataclasses import dataclass, field
+from typing import FrozenSet, Optional
+
+USB_VID = 0x1D50
+USB_PID = 0x606F
+GS_USB_BREQ_TRITON_CAPS = 0x53
+REQ_IN_VENDOR_DEVICE = 0xC0
+SYS_NET = "/sys/class/net"
+
+# GS_TRITON_CAP_* bit -> name
+FEATURES = (
+    "usb_batch", "usb_batch_adaptive", "packed", "echo_ep", "clock", "tx_deadline", "filter", "rx_policy",
+    "decimate", "mailbox", "cyclic", "gateway", "servo", "motor_cmd", "selftest", "autostart", "tasks",
+    "trace", "stage_profiling", "rx_spill", "log_cdc", "spi_link",
+)
+# struct gs_triton_caps (version 1) after version, size and features
+LIMITS = (
+    "channels", "fd_channels", "usb_in_fifo", "usb_out_fifo", "usb_ep_size", "usb_batch_max_frames",
+    "packed_block_max", "spi_block", "rx_ring_len", "rx_spill_frames", "tx_queue_len", "sw_filters",
+    "cyclic_slots", "decimate_rules", "gateway_rules", "tx_deadline_rules", "mailbox_ids", "servo_motors",
+    "motor_cmd_max", "stats_version",
+)
+CAPS_SIZE = 4 * (3 + len(LIMITS))
+
+
+@dataclass(frozen=True)
+class AdapterCaps:
+    """One adapter's ``gs_triton_caps``; limits an older firmware does not report are 0."""
+
+    version: int
+    features: FrozenSet[str]
+    limits: dict = field(default_factory=dict)
+    channel: int = 0  # the interface's channel on the adapter (dev_port)
+
+    def has(self, feature: str) -> bool:
+        return feature in self.features
+
+    @property
+    def fd(self) -> bool:
+        """The interface's channel is a CAN FD channel."""
+
+        return bool(self.limits.get("fd_channels", 0) >> self.channel & 1)
+
+    def summary(self) -> str:
+        return (f"caps v{self.version}, channel {self.channel}{' FD' if self.fd else ''}, "
+                f"{', '.join(sorted(self.features)) or 'no extensions'}")
+
+
+def parse_caps(raw: bytes, channel: int = 0) -> Optional[AdapterCaps]:
+    """Decode a reply; None when it is shorter than its own header."""
+
+    if len(raw) < 12:
+        return None
+    version, size, bits = struct.unpack_from("<3I", raw)
+    n = min(len(raw), size) // 4
+    values = struct.unpack_from(f"<{n}I", raw)
+    limits = {name: values[3 + i] if 3 + i < n else 0 for i, name in enumerate(LIMITS)}
+    features = frozenset(name for i, name in enumerate(FEATURES) if bits >> i & 1)
+    return AdapterCaps(version, features, limits, channel)
+
+
+def _read(path: str, default: str = "") -> str:
+    try:
+        with open(path) as f:
+            return f.read().strip()
+    except OSError:
+        return default
+
+
+def usb_device_of(interface: str) -> Optional[tuple]:
+    """(bus, address, channel) of the TritonCAN adapter behind ``interface``, or None."""
+
+    net = os.path.join(SYS_NET, interface)
+    path = os.path.realpath(os.path.join(net, "device"))
+    # device is the USB interface (…/1-2:1.0); its parent directory is the USB device
+    while path and path != "/":
+        if os.path.exists(os.path.join(path, "idVendor")):
+            if int(_read(os.path.join(path, "idVendor"), "0"), 16) != USB_VID:
+                return None
+            if int(_read(os.path.join(path, "idProduct"), "0"), 16) != USB_PID:
+                return None
+            return (int(_read(os.path.join(path, "busnum"), "0")), int(_read(os.path.join(path, "devnum"), "0")),
+                    int(_read(os.path.join(net, "dev_port"), "0"), 0))
+        path = os.path.dirname(path)
+    return None
+
+
+def read_adapter_caps(interface: str) -> Optional[AdapterCaps]:
+    """The capabilities of the adapter behind ``interface``; None when they cannot be read."""
+
+    where = usb_device_of(interface)
+    if where is None:
+        return None
+    try:
+        import usb.core
+    except ImportError:
+        return None
+    bus, address, channel = where
+    try:
+        dev = usb.core.find(idVendor=USB_VID, idProduct=USB_PID, bus=bus, address=address)
+        if dev is None:
+            return None
+        raw = bytes(dev.ctrl_transfer(REQ_IN_VENDOR_DEVICE, GS_USB_BREQ_TRITON_CAPS, 0, 0, CAPS_SIZE))
+    except Exception:  # usb.core.USBError: a stall from older firmware, or no permission
+        return None
+    return parse_caps(raw, channel)
@@ -0,0 +1,255 @@
+"""asyncio front end of :class:`td_can_bridges.service.CanBusService`.
+
+:class:`AsyncCanBusService` has no RX thread: the raw CAN socket is
+registered with ``loop.add_reader`` and every wakeup drains the queued
+frames into the same dispatch tables, decoders and signal store the threaded
+service uses. Subscribers get the decoded frames of a binding through an
+async iterator, and ``await send(...)`` writes without blocking the loop, so
+one event loop can drive many motors on many buses.
+
+::
+
+    async with AsyncCanBusService(cfg.get_bus("motor_bus")) as service:
+        async for frame in service.subscribe("RS02_Status1"):
+            print(frame.timestamp, frame.payload)
+            await service.send("/td/rs02/command_velocity", {"data": 1.0})
+
+Everything runs on the loop's thread; ``start()``, ``shutdown()`` and the
+iterators must be used from it. ``rx_workers`` does not apply (handlers are
+the subscription queues) and ``rx_mode: notifier`` reads like ``direct``;
+``native`` polls the C++ core from the reader. The bus is not reopened after
+an interface failure (``recovery``): reading resumes when the interface comes
+back up, but not after it was removed.
+"""
+
+from __future__ import annotations
+
+import asyncio
+import errno
+import logging
+from dataclasses import replace
+from typing import Any, AsyncIterator, Dict, Iterable, List, Mapping, NamedTuple, Optional
+
+from .service import BusConfig, CanBusService, RxBindingConfig, _can_core
+from .socketcan_rx import MSG_DONTWAIT, BatchReceiver
+
+LOG = logging.getLogger(__name__)
+
+# Pause between attempts while the interface's TX queue is full (ENOBUFS)
+_TX_RETRY_S = 0.0005
+
+
+class RxFrame(NamedTuple):
+    key: str                  # RX binding key
+    payload: Dict[str, Any]   # aliased fields, as RX handlers get them
+    timestamp: float          # receive time in seconds, see BusConfig.rx_timestamps
+
+
+def _offer(queue: asyncio.Queue, item: Optional[RxFrame]) -> None:
+    """put_nowait, dropping the oldest entry of a full queue: a slow reader sees fresh values."""
+
+    if queue.full():
+        queue.get_nowait()
+    queue.put_nowait(item)
+
+
+class AsyncCanBusService(CanBusService):
+    """:class:`CanBusService` driven by the running asyncio loop instead of a thread."""
+
+    def __init__(self, cfg: BusConfig):
+        if cfg.rx_workers:
+            LOG.warning("[%s] rx_workers does not apply to AsyncCanBusService; ignored", cfg.name)
+            cfg = replace(cfg, rx_workers=0)
+        super().__init__(cfg)
+        self._loop: Optional[asyncio.AbstractEventLoop] = None
+        self._fd = -1
+        self._subscriptions: Dict[str, List[asyncio.Queue]] = {}
+
+    async def __aenter__(self) -> "AsyncCanBusService":
+        self.start()
+        return self
+
+    async def __aexit__(self, *exc) -> None:
+        self.shutdown()
+
+    @property
+    def running(self) -> bool:
+        return self._loop is not None
+
+    def start(self) -> None:
+        """Register the socket with the running loop; call from a coroutine."""
+
+        if self._loop is not None:
+            return
+        sock = self._tx_sock
+        if sock is None:
+            raise RuntimeError(f"[{self.cfg.name}] AsyncCanBusService needs a SocketCAN bus")
+        loop = asyncio.get_running_loop()
+        self._stop.clear()
+        self._prepare_socket(sock)
+        if self.cfg.rx_mode == "native" and _can_core is not None:
+            self._core = _can_core.RxCore(sock.fileno(), self.cfg.rx_batch)
+            self._fill_core()
+            reader = self._read_native
+            self._start_recorder()
+        else:
+            if self.cfg.rx_mode == "native":
+                LOG.warning("[%s] rx_mode native needs the _can_core extension; using direct", self.cfg.name)
+            self._receiver = BatchReceiver(sock, self.cfg.rx_batch)
+            self._start_recorder()
+            self._receiver.ring = self._recorder_ring
+            self._receiver.on_error = self.errors.on_frame
+            reader = self._read_direct
+        self._fd = sock.fileno()
+        loop.add_reader(self._fd, reader)
+        self._loop = loop
+        LOG.info("[%s] RX reader started (asyncio, %s)", self.cfg.name, "native" if self._core else "direct")
+
+    def shutdown(self) -> None:
+        """Stop reading, end every subscription's iterator and close the bus."""
+
+        if self._loop is not None:
+            self._loop.remove_reader(self._fd)
+            self._loop = None
+        for queues in self._subscriptions.values():
+            for queue in queues:
+                _offer(queue, None)
+        if self._receiver is not None:
+            self._receiver.close()
+            self._receiver = None
+        self._core = None
+        super().shutdown()
+
+    async def subscribe(self, key: str, maxsize: int = 64) -> AsyncIterator[RxFrame]:
+        """Yield the frames of the RX binding ``key`` of the bus config until shutdown.
+
+        The binding is registered when the first subscriber starts iterating
+        and removed when the last one stops. Each subscriber has its own
+        queue of ``maxsize`` frames; a subscriber that falls behind loses its
+        oldest frames, never the other subscribers' or the reader's time.
+        """
+
+        binding = self.cfg.rx_bindings.get(key)
+        if binding is None:
+            raise KeyError(f"Unknown RX binding '{key}'")
+        queue: asyncio.Queue = asyncio.Queue(max(1, maxsize))
+        queues = self._subscriptions.get(key)
+        if queues is None:
+            queues = self._subscriptions[key] = []
+            self.register_rx_binding(binding, self._fan_out(queues))
+        queues.append(queue)
+        try:
+            while True:
+                frame = await queue.get()
+                if frame is None:
+                    return
+                yield frame
+        finally:
+            queues.remove(queue)
+            if not queues and self._subscriptions.get(key) is queues:
+                del self._subscriptions[key]
+                if self._loop is not None:  # after shutdown() there is nothing left to update
+                    self.unregister_rx_binding(key)
+
+    async def send(self, key: str, payload: Mapping[str, Any], timeout: float = 1.0) -> None:
+        """Encode and send one frame, waiting up to ``timeout`` s for room in the TX queue.
+
+        Keys of ``cfg.tx_bindings`` are registered on first use. With a TX
+        queue (``tx_classes``) it waits for room in the binding's class instead.
+        """
+
+        encoder = self._encoder(key)
+        if encoder.binding.period_ms:
+            self._update_periodic(encoder, payload)
+            return
+        loop = asyncio.get_running_loop()
+        if self._tx is not None:
+            frame = self._frame(encoder, payload)
+            deadline = loop.time() + timeout
+            while True:
+                try:
+                    self._tx.submit(encoder.binding.tx_class, frame, block=False)
+                    return
+                except OSError as exc:
+                    if loop.time() >= deadline:
+                        raise TimeoutError(f"[{self.cfg.name}] TX class full for {timeout} s sending {key}") from exc
+                    await asyncio.sleep(_TX_RETRY_S)
+        with self._tx_lock:
+            frame = bytes(encoder.pack(payload))
+        deadline = loop.time() + timeout
+        while True:
+            try:
+                self._tx_sock.send(frame, MSG_DONTWAIT)
+                break
+            except OSError as exc:
+                if exc.errno not in (errno.ENOBUFS, errno.EAGAIN):
+                    raise
+                if loop.time() >= deadline:
+                    raise TimeoutError(f"[{self.cfg.name}] TX queue full for {timeout} s sending {key}") from exc
+                await asyncio.sleep(_TX_RETRY_S)
+        if self.metrics is not None:
+            self.metrics.tx_frames += 1
+
+    async def send_many(self, frames: Iterable[tuple[str, Mapping[str, Any]]]) -> None:
+        """:meth:`CanBusService.send_many` for the loop: one sendmmsg per 64 frames.
+
+        It does not wait for room: a full TX queue raises ``OSError`` (ENOBUFS),
+        and a full ``block`` class of the bus's TX queue blocks the loop.
+        """
+
+        frames = list(frames)
+        for key, _ in frames:
+            self._encoder(key)
+        super().send_many(frames)
+
+    def _encoder(self, key: str):
+        encoder = self._tx_bindings.get(key)
+        if encoder is None:
+            binding = self.cfg.tx_bindings.get(key)
+            if binding is None:
+                raise KeyError(f"Unknown TX binding '{key}'")
+            self.register_tx_binding(binding)
+            encoder = self._tx_bindings[key]
+        return encoder
+
+    @staticmethod
+    def _fan_out(queues: List[asyncio.Queue]):
+        def handler(payload: Dict[str, Any], binding: RxBindingConfig, timestamp: float) -> None:
+            for i, queue in enumerate(queues):
+                # Subscribers past the first get a copy; they may change what they receive
+                _offer(queue, RxFrame(binding.key, payload if i == 0 else dict(payload), timestamp))
+
+        return handler
+
+    def _read_direct(self) -> None:
+        try:
+            frames = self._receiver.read()
+        except OSError as exc:
+            self._lost(exc)
+            return
+        if frames and self.errors.state == "down":
+            self.errors.set_state("error_active")
+        if self._priority_handlers:
+            self._run_priority(frames)
+        for arbitration_id, data, timestamp in frames:
+            self._dispatch(arbitration_id, data, timestamp)
+
+    def _read_native(self) -> None:
+        try:
+            batch = self._core.poll(0)
+        except OSError as exc:
+            self._lost(exc)
+            return
+        if batch and self.errors.state == "down":
+            self.errors.set_state("error_active")
+        if batch:
+            self._on_native_batch(batch)
+
+    def _lost(self, exc: OSError) -> None:
+        # The socket keeps its binding while the interface is down and reads again once it is up
+        if self.errors.state != "down":
+            LOG.warning("[%s] lost %s: %s", self.cfg.name, self.cfg.interface, exc)
+        self.errors.set_state("down")
+
+
+__all__ = ["AsyncCanBusService", "RxFrame"]
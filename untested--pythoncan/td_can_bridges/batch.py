@@ -0,0 +1,168 @@
+"""Column-wise decoding of many frames of one DBC message with NumPy.
+
+:class:`BatchDecoder` turns an ``(n, length)`` array of payloads into one
+array per signal: the payloads are widened to 64-bit words once and every
+signal is a shift, a mask and a multiply-add across the whole block, with the
+same bit layout :mod:`td_can_bridges.decoders` uses per frame. It works on
+any block of payloads, live or read back from a log. With the native core
+built, the block goes to ``_can_core.BlockDecoder`` instead. It does the
+same in C++ with AVX2 (chosen at run time) or NEON, writing the columns
+straight into new NumPy arrays. ``_can_core.simd`` names the instruction
+set in use. The arrays wrap into Arrow buffers without a copy
+(``pyarrow.array``).
+
+:class:`BlockRecorder` is the live side: ``CanBusService.register_rx_batch``
+appends each received frame to a preallocated block of timestamps and
+payloads and hands the decoded columns to the handler once the block fills.
+
+Signals with choices come out as their raw integers; multiplexed messages
+and messages over 8 bytes are decoded frame by frame with ``cantools`` into
+object arrays.
+"""
+
+from __future__ import annotations
+
+import struct
+import time
+from typing import Callable, Dict, Iterable, List, Optional
+
+import numpy as np
+
+from .decoders import _FLOAT_CODES, _Unsupported, _shift
+
+try:
+    from . import _can_core  # native/; its BlockDecoder decodes the same columns with SIMD
+except ImportError:  # pragma: no cover - depends on the build
+    _can_core = None
+
+Columns = Dict[str, np.ndarray]
+BatchHandler = Callable[[Columns], None]
+
+
+class BatchDecoder:
+    """Decode blocks of ``msg_def`` payloads into per-signal columns."""
+
+    def __init__(self, msg_def, signal_names: Optional[Iterable[str]] = None):
+        self.msg_def = msg_def
+        self.length = msg_def.length
+        wanted = None if signal_names is None else set(signal_names)
+        self.signals = [s for s in msg_def.signals if wanted is None or s.name in wanted]
+        self.vectorised = not msg_def.is_multiplexed() and self.length <= 8
+        self._shifts: List[int] = []
+        if self.vectorised:
+            try:
+                for signal in self.signals:
+                    if signal.is_float and signal.length not in _FLOAT_CODES:
+                        raise _Unsupported(f"float signal {signal.name} of {signal.length} bits")
+                    self._shifts.append(_shift(signal, self.length))
+            except _Unsupported:
+                self.vectorised = False
+        self._native = None
+        if self.vectorised and self.signals and _can_core is not None:
+            self._native = _can_core.BlockDecoder(self.length, [
+                (shift, s.length, s.byte_order != "little_endian", bool(s.is_signed), bool(s.is_float),
+                 not s.is_float and s.scale == 1 and s.offset == 0, float(s.scale), float(s.offset))
+                for s, shift in zip(self.signals, self._shifts)
+            ])
+
+    def decode(self, payloads: np.ndarray) -> Columns:
+        """``payloads`` is a uint8 array of shape (n, length) or wider."""
+
+        payloads = np.asarray(payloads, dtype=np.uint8)
+        if not self.vectorised:
+            return self._decode_each(payloads)
+        if self._native is not None and payloads.ndim == 2 and payloads.shape[1] >= self.length:
+            if payloads.strides[1] != 1 or payloads.strides[0] < 0:
+                payloads = np.ascontiguousarray(payloads)
+            return dict(zip((s.name for s in self.signals), self._native.decode(payloads)))
+
+        n, length = payloads.shape[0], self.length
+        words: Dict[bool, np.ndarray] = {}
+        columns: Columns = {}
+        for signal, shift in zip(self.signals, self._shifts):
+            big = signal.byte_order != "little_endian"
+            if big not in words:
+                padded = np.zeros((n, 8), dtype=np.uint8)
+                if big:
+                    padded[:, 8 - length:] = payloads[:, :length]
+                    words[big] = padded.view(">u8").ravel()
+                else:
+                    padded[:, :length] = payloads[:, :length]
+                    words[big] = padded.view("<u8").ravel()
+            mask = np.uint64((1 << signal.length) - 1)
+            raw = (words[big] >> np.uint64(shift)) & mask
+
+            if signal.is_float:
+                if signal.length == 32:
+                    values = raw.astype(np.uint32).view(np.float32).astype(np.float64)
+                else:
+                    values = raw.view(np.float64)
+            elif signal.is_signed:
+                if signal.length == 64:
+                    values = raw.view(np.int64)
+                else:
+                    sign = np.int64(1 << (signal.length - 1))
+                    values = (raw.astype(np.int64) ^ sign) - sign
+            else:
+                values = raw
+
+            if not (signal.scale == 1 and signal.offset == 0):
+                values = values * float(signal.scale) + float(signal.offset)
+            columns[signal.name] = values
+        return columns
+
+    def _decode_each(self, payloads: np.ndarray) -> Columns:
+        rows = [self.msg_def.decode(bytes(row[:self.length]), decode_choices=False) for row in payloads]
+        return {
+            signal.name: np.array([row.get(signal.name) for row in rows], dtype=object)
+            for signal in self.signals
+        }
+
+
+class BlockRecorder:
+    """Preallocated block of (timestamp, dlc, payload) records for one frame ID.
+
+    Records are packed into one bytearray and viewed as a NumPy structured
+    array when the block is handed over, so :meth:`add` is a single
+    ``struct.pack_into``. The handler gets the decoded columns plus
+    ``timestamp`` (seconds, as given to :meth:`add`) and ``dlc``; rows whose
+    dlc is below the DBC length were zero-padded before decoding.
+    """
+
+    def __init__(self, decoder: BatchDecoder, handler: BatchHandler, block_size: int = 4096,
+                 flush_ms: Optional[float] = None):
+        width = decoder.length
+        self.decoder = decoder
+        self.handler = handler
+        self.block_size = block_size
+        self.flush_s = None if flush_ms is None else flush_ms / 1000.0
+        self.dtype = np.dtype([("timestamp", "<f8"), ("dlc", "u1"), ("data", "u1", (width,))])
+        self._record = struct.Struct(f"<dB{width}s")
+        self._buf = bytearray(self.dtype.itemsize * block_size)
+        self._count = 0
+        self._opened = 0.0
+
+    def add(self, timestamp: float, data: bytes) -> None:
+        if self._count == 0:
+            self._opened = time.monotonic()
+        self._record.pack_into(self._buf, self._count * self._record.size, timestamp, len(data), data)
+        self._count += 1
+        if self._count == self.block_size or (
+            self.flush_s is not None and time.monotonic() - self._opened >= self.flush_s
+        ):
+            self.flush()
+
+    def flush(self) -> None:
+        """Decode and hand over whatever the block holds."""
+
+        if self._count == 0:
+            return
+        block = np.frombuffer(self._buf, dtype=self.dtype, count=self._count)
+        columns = self.decoder.decode(block["data"])
+        columns["timestamp"] = block["timestamp"].copy()
+        columns["dlc"] = block["dlc"].copy()
+        self._count = 0
+        self.handler(columns)
+
+
+__all__ = ["BatchDecoder", "BatchHandler", "BlockRecorder", "Columns"]
@@ -1,17 +1,67 @@
+import os
+import time
 import rclpy
+from concurrent.futures import ThreadPoolExecutor, as_completed
+from dataclasses import replace
 from pathlib import Path
+from diagnostic_msgs.msg import DiagnosticArray
+from rclpy.executors import MultiThreadedExecutor, SingleThreadedExecutor
 from rclpy.node import Node
+from std_srvs.srv import Trigger
 
-from .bus_worker import BusWorker
+from .binding_profile import render_report
+from .bus_worker import BusWorker, make_qos, open_service
+from .fleet import MotorFleet
+from .metrics import MetricsServer
+from .parameter_services import ParameterServices
 from .service import load_bridge_config
 
+EXECUTORS = ('single_threaded', 'multi_threaded')
+BRING_UP = ('together', 'degraded')
+
 
 class TDCANBridge(Node):
-    """Single ROS 2 node that can manage one or multiple SocketCAN interfaces."""
+    """Single ROS 2 node that can manage one or multiple SocketCAN interfaces.
+
+    With the ``bus`` parameter the node runs only that bus of the config, so
+    a launch file can give every bus a process (and a GIL) of its own; see
+    ``td_can_multibus.launch.py``. ``share_signals`` turns on the bus's
+    shared-memory signal store, where the other processes read its latest
+    values.
+
+    ``executor`` picks what :func:`main` spins the node with. With
+    ``multi_threaded`` (``executor_threads`` threads, 0 for one per CPU) the
+    buses' TX callbacks run in parallel, one callback group per bus (see
+    :class:`BusWorker`), so a burst on one bus's ``tx_topics`` no longer
+    delays commands to another.
+
+    Each ``topology`` of the config whose buses all run in this node gets a
+    :class:`MotorFleet`: one JointState and command topic over its buses.
+    With ``bus`` set, a topology of several buses cannot keep their cycles
+    together and is skipped.
+
+    Once a bus has ``robostride_params``, the node serves RoboStride
+    parameter reads and writes of many motors per request; see
+    :mod:`td_can_bridges.parameter_services`.
+
+    The buses are opened in parallel at startup, see :meth:`_bring_up`.
+    ``bring_up`` ``together`` (the default) starts them once all are ready;
+    ``degraded`` starts each bus as soon as it is ready and leaves out the
+    ones that fail.
+    """
 
     def __init__(self):
         super().__init__('td_can_bridge')
         cfg_path = self.declare_parameter('config', '').get_parameter_value().string_value
+        self.bus_name = self.declare_parameter('bus', '').get_parameter_value().string_value
+        self.share_signals = self.declare_parameter('share_signals', False).get_parameter_value().bool_value
+        self.executor_kind = self.declare_parameter('executor', 'single_threaded').get_parameter_value().string_value
+        self.executor_threads = self.declare_parameter('executor_threads', 0).get_parameter_value().integer_value
+        self.bring_up = self.declare_parameter('bring_up', 'together').get_parameter_value().string_value
+        if self.executor_kind not in EXECUTORS:
+            raise RuntimeError(f"parameter 'executor' must be one of {list(EXECUTORS)}, got '{self.executor_kind}'")
+        if self.bring_up not in BRING_UP:
+            raise RuntimeError(f"parameter 'bring_up' must be one of {list(BRING_UP)}, got '{self.bring_up}'")
         if not cfg_path:
             raise RuntimeError("parameter 'config' is required (path to YAML config).")
 
@@ -19,8 +69,170 @@ class TDCANBridge(Node):
         if not cfg_file.exists():
             raise FileNotFoundError(f"Config file not found: {cfg_file}")
 
+        self.cfg_file = cfg_file
         self.bridge_cfg = load_bridge_config(cfg_file)
+        self._apply_logging()
+
+        self.workers = []
+
+        buses = self._buses(self.bridge_cfg)
+        if self.bus_name and buses[0].cpu_affinity:
+            # Before any worker starts: every thread of the process inherits the set
+            try:
+                os.sched_setaffinity(0, buses[0].cpu_affinity)
+            except (AttributeError, OSError) as exc:
+                self.get_logger().warning(f"cpu_affinity {list(buses[0].cpu_affinity)} not applied: {exc}")
+
+        self.workers = self._bring_up(buses)
+
+        self.fleets = []
+        self._start_fleets()
+
+        self.get_logger().info(f"td_can_bridge started with {len(self.workers)} bus(es).")
+        self.create_service(Trigger, '~/reload_config', self._on_reload)
+        self.create_service(Trigger, '~/profile_report', self._on_profile_report)
+        self.parameter_services = None
+        self._start_parameter_services()
+
+        # Exporters of the per-bus metrics (the buses count once ``metrics`` is in the config)
+        metrics_cfg = self.bridge_cfg.metrics
+        self.metrics_server = None
+        if metrics_cfg.get('prometheus_port') is not None:
+            self.metrics_server = MetricsServer(
+                int(metrics_cfg['prometheus_port']),
+                lambda: {worker.name: worker.metrics_snapshot() for worker in list(self.workers)},
+            )
+        self.diagnostics_pub = None
+        period = float(metrics_cfg.get('diagnostics_period', 1.0)) if metrics_cfg else 0.0
+        if period > 0:
+            self.diagnostics_pub = self.create_publisher(DiagnosticArray, '/diagnostics', 10)
+            self.create_timer(period, self._publish_diagnostics)
+
+    def make_executor(self):
+        """The executor the ``executor`` parameter names."""
+
+        if self.executor_kind == 'multi_threaded':
+            return MultiThreadedExecutor(num_threads=self.executor_threads or None)
+        return SingleThreadedExecutor()
+
+    def _buses(self, bridge_cfg):
+        """The buses this node runs: all of them, or the one named by the ``bus`` parameter."""
 
+        buses = bridge_cfg.buses
+        if self.bus_name:
+            buses = [bus for bus in buses if bus.name == self.bus_name]
+            if not buses:
+                raise RuntimeError(f"Config has no bus named '{self.bus_name}'.")
+        if not buses:
+            raise RuntimeError("Config has no 'buses' entries.")
+        if self.share_signals:
+            buses = [bus if bus.signal_store is not None else replace(bus, signal_store={}) for bus in buses]
+        return buses
+
+    def _bring_up(self, buses):
+        """Open every bus at once, then build their bindings and start them.
+
+        Parsing the DBC and opening the interface are what take time, and they
+        do not touch ROS, so they run on a thread per bus (:func:`open_service`).
+        Buses of the same DBC file parse it once. Each bus's publishers and
+        subscriptions are then made on this thread, in the order the buses
+        finish opening. With ``together`` no bus receives until every bus is
+        built, and a bus that fails closes the others and fails the node. With
+        ``degraded`` each bus starts as soon as it is built, and one that fails
+        is logged and left out; ``~/reload_config`` retries it. Logs how long
+        each step took per bus.
+        """
+
+        started = time.monotonic()
+        workers, failed = [], []
+        handled = set()  # services a worker owns or that were shut down
+        together = self.bring_up == 'together'
+        with ThreadPoolExecutor(max_workers=len(buses), thread_name_prefix='bring-up') as pool:
+            futures = {pool.submit(open_service, bus_cfg): bus_cfg for bus_cfg in buses}
+            try:
+                for future in as_completed(futures):
+                    bus_cfg = futures[future]
+                    worker = None
+                    try:
+                        service, timings = future.result()
+                        handled.add(id(service))
+                        try:
+                            worker = BusWorker(self, bus_cfg, self.bridge_cfg.qos, service, timings, start=False)
+                        except BaseException:
+                            service.shutdown()
+                            raise
+                        if not together:
+                            worker.start()
+                        workers.append(worker)
+                    except Exception as exc:
+                        if worker is not None:
+                            worker.shutdown()
+                        if together:
+                            raise
+                        self.get_logger().error(f"[{bus_cfg.name}] not started: {exc}")
+                        failed.append(bus_cfg.name)
+                if together:
+                    for worker in workers:
+                        worker.start()
+            except BaseException:
+                # Buses still opening are shut down as they finish
+                for future in futures:
+                    if future.exception() is None and id(future.result()[0]) not in handled:
+                        future.result()[0].shutdown()
+                for worker in workers:
+                    worker.shutdown()
+                raise
+        if not workers:
+            raise RuntimeError("No bus could be started: " + ", ".join(failed))
+        order = {bus_cfg.name: idx for idx, bus_cfg in enumerate(buses)}
+        workers.sort(key=lambda worker: order[worker.name])
+        steps = ('dbc', 'open', 'bindings', 'start')
+        parts = [f"{worker.name} " + " ".join(f"{step} {worker.timings.get(step, 0.0) * 1e3:.0f}" for step in steps)
+                 for worker in workers]
+        serial = sum(sum(worker.timings.values()) for worker in workers)
+        self.get_logger().info(
+            f"bring-up ({self.bring_up}) took {time.monotonic() - started:.3f} s for {len(workers)} bus(es), "
+            f"{serial:.3f} s one after another; ms per bus: " + "; ".join(parts)
+            + (f"; not started: {', '.join(failed)}" if failed else "")
+        )
+        return workers
+
+    def _start_fleets(self):
+        services = {worker.name: worker.service for worker in self.workers}
+        qos = self.bridge_cfg.qos
+        for topology in self.bridge_cfg.topologies:
+            if not set(topology.buses) <= set(services):
+                if set(topology.buses) & set(services):
+                    self.get_logger().warning(f"topology {topology.name}: not all of its buses run in this node, "
+                                              f"no fleet")
+                continue
+            fleet = MotorFleet(self, topology, services, make_qos(qos.get('sensor', {}), default_depth=20),
+                               make_qos(qos.get('command', {}), default_depth=10))
+            fleet.start()
+            self.fleets.append(fleet)
+
+    def _stop_fleets(self):
+        for fleet in self.fleets:
+            fleet.shutdown()
+        self.fleets = []
+
+    def _start_parameter_services(self):
+        if self.parameter_services is not None:
+            return
+        if any(worker.cfg.robostride_params for worker in self.workers):
+            self.parameter_services = ParameterServices(
+                self,
+                lambda: {worker.name: worker.service for worker in list(self.workers)},
+                lambda: {j.name: (j.bus, j.motor) for t in self.bridge_cfg.topologies for j in t.joints},
+            )
+
+    def _publish_diagnostics(self):
+        msg = DiagnosticArray()
+        msg.header.stamp = self.get_clock().now().to_msg()
+        msg.status = [worker.diagnostic_status() for worker in self.workers]
+        self.diagnostics_pub.publish(msg)
+
+    def _apply_logging(self):
         # Optional global logging level
         log_cfg = self.bridge_cfg.logging
         if log_cfg.get('level'):
@@ -28,19 +240,74 @@ class TDCANBridge(Node):
             level = getattr(rclpy.logging.LoggingSeverity, level_name, rclpy.logging.LoggingSeverity.INFO)
             self.get_logger().set_level(level)
 
-        self.workers = []
+    def _on_reload(self, request, response):
+        try:
+            response.message = self.reload()
+            response.success = True
+        except Exception as exc:
+            self.get_logger().error(f"config reload failed: {exc}")
+            response.message = str(exc)
+        return response
 
-        buses = self.bridge_cfg.buses
-        if not buses:
-            raise RuntimeError("Config has no 'buses' entries.")
+    def _on_profile_report(self, request, response):
+        stats = {worker.name: worker.service.profile_stats() for worker in list(self.workers)}
+        stats = {bus: stages for bus, stages in stats.items() if stages}
+        response.success = bool(stats)
+        response.message = render_report(stats) if stats else "no bus has 'profile' set"
+        return response
 
-        for bus_cfg in buses:
-            worker = BusWorker(self, bus_cfg, self.bridge_cfg.qos)
-            self.workers.append(worker)
+    def reload(self):
+        """Re-read the YAML and apply it bus by bus.
 
-        self.get_logger().info(f"td_can_bridge started with {len(self.workers)} bus(es).")
+        Buses whose bindings or filters changed are updated in place and
+        keep their socket; a bus whose interface, bitrate, DBC or RX options
+        changed is restarted, and buses added to or removed from the file
+        are started or shut down. A config that fails to parse changes
+        nothing. The fleets are stopped first and started again over the
+        reloaded buses.
+        """
+
+        new_cfg = load_bridge_config(self.cfg_file)
+        buses = self._buses(new_cfg)
+        self.bridge_cfg = new_cfg
+        self._apply_logging()
+
+        self._stop_fleets()
+        running = {worker.name: worker for worker in self.workers}
+        workers = []
+        summary = []
+        try:
+            for bus_cfg in buses:
+                worker = running.pop(bus_cfg.name, None)
+                if worker is not None and worker.reload(bus_cfg, new_cfg.qos):
+                    summary.append(f"{bus_cfg.name} updated")
+                else:
+                    restarted = worker is not None
+                    if restarted:
+                        worker.shutdown()
+                    worker = BusWorker(self, bus_cfg, new_cfg.qos)
+                    summary.append(f"{bus_cfg.name} {'restarted' if restarted else 'started'}")
+                workers.append(worker)
+            for name, worker in running.items():
+                worker.shutdown()
+                summary.append(f"{name} stopped")
+            running = {}
+        finally:
+            # A bus that failed part way keeps whatever workers are still up
+            self.workers = workers + list(running.values())
+        self._start_fleets()
+        self._start_parameter_services()
+        message = ", ".join(summary)
+        self.get_logger().info(f"config reloaded: {message}")
+        return message
 
     def destroy_node(self):
+        if self.metrics_server is not None:
+            self.metrics_server.close()
+        self._stop_fleets()
+        if self.parameter_services is not None:
+            self.parameter_services.shutdown()
+            self.parameter_services = None
         for worker in self.workers:
             worker.shutdown()
         super().destroy_node()
@@ -49,9 +316,12 @@ class TDCANBridge(Node):
 def main():
     rclpy.init()
     node = TDCANBridge()
+    executor = node.make_executor()
+    executor.add_node(node)
     try:
-        rclpy.spin(node)
+        executor.spin()
     finally:
+        executor.shutdown()
         node.destroy_node()
         rclpy.shutdown()
 
@@ -0,0 +1,457 @@
+"""Arbitration delay and bus contention, reconstructed from a recording.
+
+A log of every frame on the bus, timestamped by the receiver, shows how the
+bus was occupied. Each classic frame's length is counted with its actual
+stuff bits and CRC, so ``bits / bitrate`` before its timestamp is where its
+start of frame was (:func:`occupancy`). CAN FD frames are costed at
+:func:`~td_can_bridges.bus_load.frame_bits`' worst case.
+
+A frame waits while the bus is busy, and loses arbitration to every
+higher-priority frame pending with it. To measure the wait, each periodic ID
+gets a release time per frame (:func:`estimate_streams`): a line of its
+period under all of its starts, touching the least delayed ones. No frame
+starts before it is released, and the least delayed ones waited about
+zero. For each frame, :func:`attribute` then splits the time from
+release to start of frame into:
+
+* ``higher``: frames of higher-priority IDs, which won arbitration;
+* ``in_progress``: the frame already on the bus at the release (CAN does
+  not preempt);
+* ``inversion``: lower-priority frames that went first. The frame was not
+  ready in the controller yet, so a host or adapter queue held it;
+* ``idle``: the bus was free. This is the sender's own jitter.
+
+Event-driven IDs are not given releases, but they still count as blockers.
+
+:func:`simulate` replays the streams on a model bus: non-preemptive,
+lowest arbitration field first, and each ID at its median length. The
+event-driven frames go in at their recorded starts. On that model,
+:func:`suggest_priorities` tries the rate-monotonic order of the IDs
+(shortest period highest priority). :func:`suggest_offsets` places the
+streams' phases one by one, each at the offset that gives the lowest worst
+delay. Both report the worst delay per ID before and after the change.
+
+Timestamps must be close to the wire for any of this. Hardware timestamps
+(``rx_timestamps: hardware``, ``candump -H``) work; software ones are
+usually tens of microseconds late. :attr:`Timeline.conflicts` counts the
+frames whose timestamps overlap the previous frame, and a high count means
+the log is not good enough. The recorder leaves out the frames this host
+sends. To see your own frames, record with ``candump -l -H`` on the same
+host (the kernel loops them back) or on a second interface.
+"""
+
+from __future__ import annotations
+
+import bisect
+import heapq
+import statistics
+from dataclasses import dataclass, field
+from functools import lru_cache
+from typing import Any, Dict, Iterable, List, Mapping, NamedTuple, Optional, Sequence, Tuple
+
+from .bus_load import frame_bits
+from .replay import LogFrame
+from .socketcan_rx import CAN_EFF_FLAG, CAN_EFF_MASK, CAN_ERR_FLAG
+
+CAN_RTR_FLAG = 0x40000000
+_CAN_SFF_MASK = 0x7FF
+_CRC15_POLY = 0x4599
+_TRAILER = 13  # CRC delimiter, ACK slot and delimiter, EOF, interframe space
+_IFS = 3
+_SLACK_BITS = 10      # a frame that starts this soon after an estimated release was already on the bus
+MIN_FRAMES = 20       # a stream needs this many frames to get releases
+MAX_JITTER = 0.25     # ... and inter-arrival times within this share of the period
+STAMPS = ("end", "start")
+
+
+def _crc15(bits: Sequence[int]) -> int:
+    crc = 0
+    for bit in bits:
+        top = bit ^ ((crc >> 14) & 1)
+        crc = (crc << 1) & 0x7FFF
+        if top:
+            crc ^= _CRC15_POLY
+    return crc
+
+
+@lru_cache(maxsize=65536)
+def classic_frame_bits(can_id: int, data: bytes, extended: bool, remote: bool = False) -> int:
+    """Bits of one classic frame on the wire, stuff bits and the interframe space included."""
+
+    def put(value: int, width: int) -> None:
+        bits.extend((value >> i) & 1 for i in range(width - 1, -1, -1))
+
+    bits: List[int] = [0]  # SOF
+    if extended:
+        put(can_id >> 18, 11)
+        bits.extend((1, 1))  # SRR, IDE
+        put(can_id & 0x3FFFF, 18)
+        bits.extend((int(remote), 0, 0))  # RTR, r1, r0
+    else:
+        put(can_id, 11)
+        bits.extend((int(remote), 0, 0))  # RTR, IDE, r0
+    put(min(len(data), 8), 4)
+    if not remote:
+        for byte in data[:8]:
+            put(byte, 8)
+    put(_crc15(bits), 15)
+    stuffed, previous, run = 0, -1, 0
+    for bit in bits:
+        if bit == previous:
+            run += 1
+        else:
+            previous, run = bit, 1
+        if run == 5:
+            stuffed += 1
+            previous, run = 1 - bit, 1
+    return len(bits) + stuffed + _TRAILER
+
+
+def priority(key: int) -> Tuple[int, int, int]:
+    """Sort key of the arbitration field: lower wins. A standard frame beats an extended one of the same base ID."""
+
+    if key & CAN_EFF_FLAG:
+        can_id = key & CAN_EFF_MASK
+        return can_id >> 18, 1, can_id & 0x3FFFF
+    return key & _CAN_SFF_MASK, 0, 0
+
+
+def id_text(key: int) -> str:
+    return f"0x{key & CAN_EFF_MASK:08X}" if key & CAN_EFF_FLAG else f"0x{key & _CAN_SFF_MASK:03X}"
+
+
+class BusFrame(NamedTuple):
+    sof: float   # start of frame, seconds
+    end: float   # end of its interframe space: the next frame can start here
+    key: int     # CAN ID with CAN_EFF_FLAG for 29-bit IDs
+
+
+@dataclass
+class Timeline:
+    """Frames on the bus in order, each from its start of frame to the end of its interframe space."""
+
+    bitrate: int
+    frames: List[BusFrame] = field(default_factory=list)
+    conflicts: int = 0     # frames whose timestamp put them on top of the previous one
+    error_frames: int = 0  # left out: their length is not in the log
+
+    @property
+    def starts(self) -> List[float]:
+        return [f.sof for f in self.frames]
+
+    def load(self, window_s: float) -> List[float]:
+        """Busy share of the bus per window of ``window_s``, from the first frame."""
+
+        if not self.frames:
+            return []
+        origin = self.frames[0].sof
+        busy = [0.0] * (int((self.frames[-1].end - origin) / window_s) + 1)
+        for frame in self.frames:
+            start, end = frame.sof - origin, frame.end - origin
+            index = int(start / window_s)
+            while start < end:
+                edge = min(end, (index + 1) * window_s)
+                busy[index] += max(0.0, edge - start)
+                start = edge
+                index += 1
+        return [value / window_s for value in busy]
+
+
+def occupancy(frames: Iterable[LogFrame], bitrate: int, dbitrate: Optional[int] = None, stamp: str = "end",
+              channel: Optional[str] = None) -> Timeline:
+    """Rebuild the bus's occupancy from a log; ``stamp`` says whether timestamps are at the end or the start of frame."""
+
+    if stamp not in STAMPS:
+        raise ValueError(f"stamp must be one of {list(STAMPS)}, got {stamp!r}")
+    timeline = Timeline(bitrate)
+    ratio = bitrate / dbitrate if dbitrate else 1.0
+    spans = []
+    for frame in frames:
+        if channel is not None and str(frame.channel) != channel:
+            continue
+        if frame.can_id & CAN_ERR_FLAG:
+            timeline.error_frames += 1
+            continue
+        extended = bool(frame.can_id & CAN_EFF_FLAG)
+        can_id = frame.can_id & (CAN_EFF_MASK if extended else _CAN_SFF_MASK)
+        if frame.fd:
+            bits = frame_bits(len(frame.data), extended, True, ratio)
+        else:
+            bits = classic_frame_bits(can_id, bytes(frame.data), extended, bool(frame.can_id & CAN_RTR_FLAG))
+        duration = bits / bitrate
+        sof = frame.timestamp - (bits - _IFS) / bitrate if stamp == "end" else frame.timestamp
+        spans.append((sof, duration, can_id | (CAN_EFF_FLAG if extended else 0)))
+    spans.sort()
+    tolerance = 1.0 / bitrate
+    previous_end = float("-inf")
+    for sof, duration, key in spans:
+        if sof < previous_end - tolerance:
+            timeline.conflicts += 1
+        sof = max(sof, previous_end)
+        previous_end = sof + duration
+        timeline.frames.append(BusFrame(sof, previous_end, key))
+    return timeline
+
+
+@dataclass
+class Stream:
+    """A periodic ID: the release time of each of its frames in the timeline."""
+
+    key: int
+    period: float
+    origin: float               # release of the first frame
+    duration: float             # median time on the bus, interframe space included
+    frames: List[int] = field(default_factory=list)      # indices into Timeline.frames
+    releases: List[float] = field(default_factory=list)
+
+
+def estimate_streams(timeline: Timeline, min_frames: int = MIN_FRAMES,
+                     max_jitter: float = MAX_JITTER) -> Dict[int, Stream]:
+    """Periodic IDs of the timeline, each with a release per frame from a lower-envelope line."""
+
+    by_key: Dict[int, List[int]] = {}
+    for index, frame in enumerate(timeline.frames):
+        by_key.setdefault(frame.key, []).append(index)
+    streams = {}
+    for key, indices in by_key.items():
+        if len(indices) < min_frames:
+            continue
+        starts = [timeline.frames[i].sof for i in indices]
+        gaps = [b - a for a, b in zip(starts, starts[1:])]
+        period = statistics.median(gaps)
+        if period <= 0:
+            continue
+        spread = statistics.median(abs(gap - period) for gap in gaps)
+        if spread > max_jitter * period:
+            continue
+        # Cycle numbers from the gaps, or one per frame. The gaps miscount
+        # once the delay swings by half a period; one per frame is wrong
+        # after a lost frame. The numbering with the smaller spread of
+        # delays is kept.
+        cycles = [0]
+        for gap in gaps:
+            cycles.append(cycles[-1] + max(1, round(gap / period)))
+        slope, origin, spread = _envelope(cycles, starts)
+        if cycles[-1] != len(starts) - 1:
+            counted = list(range(len(starts)))
+            line = _envelope(counted, starts)
+            if line[2] < spread:
+                cycles, (slope, origin, spread) = counted, line
+        releases = [origin + slope * k for k in cycles]
+        durations = [timeline.frames[i].end - timeline.frames[i].sof for i in indices]
+        streams[key] = Stream(key, slope, releases[0], statistics.median(durations), indices, releases)
+    return streams
+
+
+def _envelope(cycles: Sequence[int], starts: Sequence[float]) -> Tuple[float, float, float]:
+    """Slope and intercept of the release line under ``starts``, and the largest delay above it.
+
+    The line is the edge of the lower convex hull over the middle cycle:
+    of the lines under every start, the one closest to them in total. Its
+    slope follows the drift between the sender's and the logger's clocks.
+    """
+
+    hull: List[Tuple[int, float]] = []
+    for point in zip(cycles, starts):
+        while len(hull) >= 2 and _cross(hull[-2], hull[-1], point) <= 0:
+            hull.pop()
+        hull.append(point)
+    if len(hull) < 2:
+        return 0.0, starts[0], 0.0
+    middle = (cycles[0] + cycles[-1]) / 2
+    edge = next((n for n in range(1, len(hull)) if hull[n][0] >= middle), len(hull) - 1)
+    (k0, t0), (k1, t1) = hull[edge - 1], hull[edge]
+    slope = (t1 - t0) / (k1 - k0)
+    origin = t0 - slope * k0
+    return slope, origin, max(start - (origin + slope * k) for k, start in zip(cycles, starts))
+
+
+def _cross(a: Tuple[int, float], b: Tuple[int, float], c: Tuple[int, float]) -> float:
+    return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0])
+
+
+@dataclass
+class DelayStats:
+    """Arbitration delay of one stream and what it was spent on."""
+
+    key: int
+    period: float
+    delays: List[float] = field(default_factory=list)
+    higher: float = 0.0
+    in_progress: float = 0.0
+    inversion: float = 0.0
+    idle: float = 0.0
+    inversions: int = 0                                         # frames a lower-priority frame went before
+    blockers: Dict[int, float] = field(default_factory=dict)    # key -> seconds it held this stream back
+
+    def summary(self) -> Dict[str, Any]:
+        ordered = sorted(self.delays)
+
+        def at(q: float) -> float:
+            return ordered[min(len(ordered) - 1, int(q * len(ordered)))] * 1e6 if ordered else 0.0
+
+        top = sorted(self.blockers.items(), key=lambda kv: kv[1], reverse=True)[:3]
+        return {
+            "id": id_text(self.key),
+            "frames": len(self.delays),
+            "period_us": round(self.period * 1e6, 1),
+            "delay_us": {"p50": round(at(0.5), 1), "p99": round(at(0.99), 1), "max": round(at(1.0), 1)},
+            "spent_us": {name: round(getattr(self, name) * 1e6, 1)
+                         for name in ("higher", "in_progress", "inversion", "idle")},
+            "inversions": self.inversions,
+            "blockers": {id_text(key): round(seconds * 1e6, 1) for key, seconds in top},
+        }
+
+
+def attribute(timeline: Timeline, streams: Mapping[int, Stream]) -> Dict[int, DelayStats]:
+    """Each stream frame's delay from release to start of frame, split by what held the bus."""
+
+    starts = timeline.starts
+    slack = _SLACK_BITS / timeline.bitrate
+    out = {}
+    for key, stream in streams.items():
+        stats = out[key] = DelayStats(key, stream.period)
+        mine = priority(key)
+        for index, release in zip(stream.frames, stream.releases):
+            frame = timeline.frames[index]
+            delay = frame.sof - release
+            stats.delays.append(delay)
+            if delay <= 0:
+                continue
+            busy = 0.0
+            inverted = False
+            # Frames that ended after the release and started before this one
+            first = max(0, bisect.bisect_right(starts, release) - 1)
+            for other in timeline.frames[first:index]:
+                overlap = min(other.end, frame.sof) - max(other.sof, release)
+                if overlap <= 0:
+                    continue
+                busy += overlap
+                if other.sof <= release + slack:
+                    stats.in_progress += overlap
+                elif priority(other.key) < mine:
+                    stats.higher += overlap
+                else:
+                    stats.inversion += overlap
+                    inverted = True
+                stats.blockers[other.key] = stats.blockers.get(other.key, 0.0) + overlap
+            stats.idle += max(0.0, delay - busy)
+            stats.inversions += inverted
+    return out
+
+
+# ----------------------------------------------------------------------
+# Model bus
+
+
+class Traffic(NamedTuple):
+    """What :func:`simulate` replays: the streams' periods and lengths, and the other frames as recorded."""
+
+    streams: Dict[int, Stream]
+    sporadic: List[Tuple[float, int, float]]  # (start, key, duration)
+    start: float
+    seconds: float
+
+
+def traffic(timeline: Timeline, streams: Dict[int, Stream], seconds: float) -> Traffic:
+    """The first ``seconds`` of the timeline as model input."""
+
+    start = timeline.frames[0].sof if timeline.frames else 0.0
+    sporadic = [(f.sof, f.key, f.end - f.sof) for f in timeline.frames
+                if f.key not in streams and f.sof < start + seconds]
+    return Traffic(streams, sporadic, start, seconds)
+
+
+def simulate(model: Traffic, phases: Optional[Mapping[int, float]] = None,
+             keys: Optional[Mapping[int, int]] = None) -> Dict[int, List[float]]:
+    """Delays per stream on a non-preemptive fixed-priority bus.
+
+    ``phases`` moves a stream's first release from where it was recorded
+    (seconds from the start), ``keys`` gives it another arbitration ID.
+    """
+
+    phases = phases or {}
+    keys = keys or {}
+    events: List[Tuple[float, int, int, float]] = []  # (release, arbitration key, stream key or -1, duration)
+    end = model.start + model.seconds
+    for key, stream in model.streams.items():
+        release = model.start + phases[key] if key in phases else stream.origin
+        while release < end:
+            if release >= model.start:
+                events.append((release, keys.get(key, key), key, stream.duration))
+            release += stream.period
+    events.extend((start, key, -1, duration) for start, key, duration in model.sporadic)
+    events.sort()
+    delays: Dict[int, List[float]] = {key: [] for key in model.streams}
+    pending: List[Tuple[Tuple[int, int, int], float, int, float]] = []
+    free = float("-inf")
+    i = 0
+    while i < len(events) or pending:
+        now = free if pending else max(free, events[i][0])
+        while i < len(events) and events[i][0] <= now:
+            release, arbitration, key, duration = events[i]
+            heapq.heappush(pending, (priority(arbitration), release, key, duration))
+            i += 1
+        _, release, key, duration = heapq.heappop(pending)
+        if key >= 0:
+            delays[key].append(now - release)
+        free = now + duration
+    return delays
+
+
+def worst(delays: Mapping[int, List[float]]) -> Dict[int, float]:
+    return {key: max(values) if values else 0.0 for key, values in delays.items()}
+
+
+def _cost(delays: Mapping[int, List[float]], streams: Mapping[int, Stream]) -> float:
+    """Worst delay of any stream as a share of its period: what the search minimises."""
+
+    return max((max(values) / streams[key].period for key, values in delays.items() if values), default=0.0)
+
+
+def suggest_priorities(model: Traffic, ours: Iterable[int]) -> Dict[int, int]:
+    """Rate-monotonic IDs for ``ours``: the same set of IDs, shortest period on the highest priority.
+
+    Standard and extended IDs are only traded within their kind. Returns
+    ``{key: new key}`` for the IDs that change; empty when the order
+    already follows the periods.
+    """
+
+    out = {}
+    for extended in (False, True):
+        mine = [key for key in ours if key in model.streams and bool(key & CAN_EFF_FLAG) == extended]
+        by_period = sorted(mine, key=lambda key: (model.streams[key].period, priority(key)))
+        by_priority = sorted(mine, key=priority)
+        out.update({key: new for key, new in zip(by_period, by_priority) if key != new})
+    return out
+
+
+def suggest_offsets(model: Traffic, ours: Iterable[int], step: float) -> Dict[int, float]:
+    """A first-release offset (seconds from the start) per stream of ``ours``, placed greedily.
+
+    The streams are placed highest priority first. Each one tries offsets
+    ``step`` apart over its period. It keeps the one whose simulation has
+    the lowest worst delay as a share of the period, over every stream.
+    """
+
+    phases = {key: stream.origin - model.start for key, stream in model.streams.items()}
+    mine = sorted((key for key in ours if key in model.streams), key=priority)
+    for key in mine:
+        period = model.streams[key].period
+        candidates = max(1, min(100, int(period / step)))
+        best = None
+        for n in range(candidates):
+            trial = dict(phases)
+            trial[key] = n * period / candidates
+            cost = _cost(simulate(model, trial), model.streams)
+            if best is None or cost < best[0] - 1e-12:
+                best = (cost, trial[key])
+        phases[key] = best[1]
+    return {key: phases[key] for key in mine}
+
+
+__all__ = [
+    "BusFrame", "DelayStats", "STAMPS", "Stream", "Timeline", "Traffic", "attribute", "classic_frame_bits",
+    "estimate_streams", "id_text", "occupancy", "priority", "simulate", "suggest_offsets", "suggest_priorities",
+    "traffic", "worst",
+]
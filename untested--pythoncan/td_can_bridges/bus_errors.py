@@ -0,0 +1,161 @@
+"""Controller state of a bus, tracked from SocketCAN error frames.
+
+With ``CAN_RAW_ERR_FILTER`` set (:func:`enable_error_frames`) the CAN driver
+reports bus errors and controller state changes as frames with
+``CAN_ERR_FLAG`` in the ID. The error class is in the ID bits, the details in
+the payload (``linux/can/error.h``): ``data[1]`` the controller status,
+``data[6]``/``data[7]`` the transmit and receive error counters when the
+class includes ``CAN_ERR_CNT``.
+
+:class:`BusErrorMonitor` counts each class and follows the state the frames
+report: ``error_active``, ``error_warning`` (a counter reached 96),
+``error_passive`` (128), ``bus_off``, plus ``down`` while the service has
+lost the interface. It sums the seconds spent in each state, so a scrape
+shows how long a bus has been degraded, not only that it was.
+"""
+
+from __future__ import annotations
+
+import socket
+import struct
+import threading
+import time
+from typing import Dict, Mapping, Optional
+
+# linux/can/raw.h
+SOL_CAN_RAW = 101
+CAN_RAW_ERR_FILTER = 2
+CAN_ERR_MASK = 0x1FFFFFFF
+
+# linux/can/error.h: error class, in the frame ID
+CAN_ERR_TX_TIMEOUT = 0x001
+CAN_ERR_LOSTARB = 0x002
+CAN_ERR_CRTL = 0x004
+CAN_ERR_PROT = 0x008
+CAN_ERR_TRX = 0x010
+CAN_ERR_ACK = 0x020
+CAN_ERR_BUSOFF = 0x040
+CAN_ERR_BUSERROR = 0x080
+CAN_ERR_RESTARTED = 0x100
+CAN_ERR_CNT = 0x200
+
+# data[1] with CAN_ERR_CRTL
+CAN_ERR_CRTL_RX_OVERFLOW = 0x01
+CAN_ERR_CRTL_TX_OVERFLOW = 0x02
+CAN_ERR_CRTL_RX_WARNING = 0x04
+CAN_ERR_CRTL_TX_WARNING = 0x08
+CAN_ERR_CRTL_RX_PASSIVE = 0x10
+CAN_ERR_CRTL_TX_PASSIVE = 0x20
+CAN_ERR_CRTL_ACTIVE = 0x40
+
+STATES = ("error_active", "error_warning", "error_passive", "bus_off", "down")
+
+# Counter name per error class bit, as exported
+ERROR_CLASSES = (
+    (CAN_ERR_TX_TIMEOUT, "tx_timeout"),
+    (CAN_ERR_LOSTARB, "lost_arbitration"),
+    (CAN_ERR_CRTL, "controller"),
+    (CAN_ERR_PROT, "protocol"),
+    (CAN_ERR_TRX, "transceiver"),
+    (CAN_ERR_ACK, "no_ack"),
+    (CAN_ERR_BUSOFF, "bus_off"),
+    (CAN_ERR_BUSERROR, "bus_error"),
+    (CAN_ERR_RESTARTED, "restarted"),
+)
+
+_COUNTERS = struct.Struct("=BB")
+
+
+def enable_error_frames(sock: socket.socket, mask: int = CAN_ERR_MASK) -> None:
+    """Have the socket receive the error frames of the classes in ``mask`` (default: all)."""
+
+    sock.setsockopt(SOL_CAN_RAW, CAN_RAW_ERR_FILTER, struct.pack("=I", mask))
+
+
+def _state_of(flags: int) -> Optional[str]:
+    """State a ``CAN_ERR_CRTL`` status byte reports; None when it reports none."""
+
+    if flags & (CAN_ERR_CRTL_RX_PASSIVE | CAN_ERR_CRTL_TX_PASSIVE):
+        return "error_passive"
+    if flags & (CAN_ERR_CRTL_RX_WARNING | CAN_ERR_CRTL_TX_WARNING):
+        return "error_warning"
+    if flags & CAN_ERR_CRTL_ACTIVE:
+        return "error_active"
+    return None
+
+
+class BusErrorMonitor:
+    """Error counters and controller state of one bus.
+
+    :meth:`on_frame` runs on the RX thread, :meth:`set_state` on whichever
+    thread notices the interface go or come back; :meth:`stats` may be read
+    from any thread.
+    """
+
+    def __init__(self, name: str):
+        self.name = name
+        self.state = "error_active"
+        self.counts: Dict[str, int] = {label: 0 for _, label in ERROR_CLASSES}
+        self.counts["rx_overflow"] = 0  # the controller's, not the socket's
+        self.counts["tx_overflow"] = 0
+        self.tx_error_counter = 0
+        self.rx_error_counter = 0
+        self.recoveries = 0  # times the service reopened the interface
+        self.last_error = 0.0  # receive time of the latest error frame
+        self._lock = threading.Lock()
+        self._since = time.monotonic()
+        self._seconds: Dict[str, float] = {state: 0.0 for state in STATES}
+
+    def on_frame(self, err_class: int, data: bytes, timestamp: float) -> None:
+        """Count one error frame; ``err_class`` is its ID without ``CAN_ERR_FLAG``."""
+
+        self.last_error = timestamp
+        for bit, label in ERROR_CLASSES:
+            if err_class & bit:
+                self.counts[label] += 1
+        state = None
+        if err_class & CAN_ERR_CRTL and len(data) > 1:
+            flags = data[1]
+            if flags & CAN_ERR_CRTL_RX_OVERFLOW:
+                self.counts["rx_overflow"] += 1
+            if flags & CAN_ERR_CRTL_TX_OVERFLOW:
+                self.counts["tx_overflow"] += 1
+            state = _state_of(flags)
+        if err_class & CAN_ERR_CNT and len(data) >= 8:
+            self.tx_error_counter, self.rx_error_counter = _COUNTERS.unpack_from(data, 6)
+        if err_class & CAN_ERR_RESTARTED:
+            state = "error_active"
+        if err_class & CAN_ERR_BUSOFF:
+            state = "bus_off"
+        if state is not None:
+            self.set_state(state)
+
+    def set_state(self, state: str) -> None:
+        with self._lock:
+            if state == self.state:
+                return
+            now = time.monotonic()
+            self._seconds[self.state] += now - self._since
+            self._since = now
+            self.state = state
+
+    def time_in_state(self) -> Dict[str, float]:
+        """Seconds spent in each state since the monitor was made, the current one included."""
+
+        with self._lock:
+            seconds = dict(self._seconds)
+            seconds[self.state] += time.monotonic() - self._since
+        return seconds
+
+    def stats(self) -> Mapping[str, object]:
+        return {
+            "state": self.state,
+            "errors": dict(self.counts),
+            "tx_error_counter": self.tx_error_counter,
+            "rx_error_counter": self.rx_error_counter,
+            "time_in_state": self.time_in_state(),
+            "recoveries": self.recoveries,
+        }
+
+
+__all__ = ["BusErrorMonitor", "ERROR_CLASSES", "STATES", "enable_error_frames"]
@@ -0,0 +1,149 @@
+"""Bus load planning from the config, and measured load from the interface counters.
+
+:func:`plan_bus` adds up the traffic a bus config declares: every
+``period_ms`` TX binding, every TX or RX binding with a ``rate_hz`` (the
+most frames per second it sends, or expects from the devices) and the motors
+of ``robostride_reporting`` at their report intervals, and the commands and
+replies of the bus's share of a ``topology``. Each frame is
+costed at its worst-case length on the wire, :func:`frame_bits`, with every
+possible stuff bit and the interframe space, from the DBC message's length
+and ID type. :func:`check_bus_load` runs on every :func:`load_bridge_config`
+and warns about, or with ``bus_load.action: reject`` refuses, a schedule over
+``bus_load.limit`` of the bitrate: past that, low-priority frames (usually
+the feedback) lose arbitration for long stretches.
+
+At runtime :func:`interface_bits` turns the kernel's per-interface packet
+and byte counters into the same worst-case bit count. They include every
+frame the controller saw on the bus, filtered or not, and the host's own.
+"""
+
+from __future__ import annotations
+
+import logging
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import List, Optional, Tuple
+
+LOG = logging.getLogger(__name__)
+
+LOAD_ACTIONS = ("warn", "reject")
+
+# Bits covered by stuffing before the data field: SOF, ID, control bits and CRC (Davis et al., 2007)
+_STUFFED_HEADER = {False: 34, True: 54}
+# CRC delimiter, ACK slot and delimiter, end of frame, interframe space: never stuffed
+_TRAILER = 13
+
+
+def frame_bits(length: int, extended: bool, fd: bool = False, data_ratio: float = 1.0) -> float:
+    """Worst-case length of one data frame of ``length`` bytes, in nominal bit times.
+
+    Classic CAN: ``g + 8n + 13 + floor((g + 8n - 1) / 4)`` with ``g`` 34 for
+    11-bit and 54 for 29-bit IDs. CAN FD is estimated the same way with the
+    FD CRC (17/21 bits, fixed stuff bits) and the stuff count; the part after
+    the bit rate switch is scaled by ``data_ratio`` (nominal / data bitrate).
+    """
+
+    if not fd:
+        g = _STUFFED_HEADER[extended]
+        return g + 8 * length + _TRAILER + (g + 8 * length - 1) // 4
+    arbitration = 1 + (31 if extended else 12) + 2 + 1     # SOF, ID (+SRR, IDE), FDF, res, BRS
+    crc = 17 if length <= 16 else 21
+    data_phase = 1 + 4 + 8 * length + 4 + crc + (crc + 4 + 3) // 4  # ESI, DLC, data, stuff count, CRC
+    dynamic_stuff = (arbitration + 5 + 8 * length - 1) // 4
+    # The stuff bits fall on both sides of the switch; count them at the nominal rate to stay worst-case
+    return arbitration + dynamic_stuff + data_phase * data_ratio + _TRAILER
+
+
+@dataclass
+class BusLoadPlan:
+    bus: str
+    bitrate: int
+    load: float = 0.0  # fraction of the bitrate, worst case
+    entries: List[Tuple[str, float, float]] = field(default_factory=list)  # (what, frames/s, bits/s)
+
+    def summary(self, top: int = 5) -> str:
+        worst = sorted(self.entries, key=lambda e: -e[2])[:top]
+        return ", ".join(f"{what} {rate:g}/s = {bits / self.bitrate:.1%}" for what, rate, bits in worst)
+
+
+def plan_bus(bus, dbc) -> BusLoadPlan:
+    """Worst-case load the TX and RX bindings of ``bus`` (a :class:`BusConfig`) declare."""
+
+    plan = BusLoadPlan(bus.name, bus.bitrate)
+    data_ratio = bus.bitrate / bus.dbitrate if bus.fd and bus.dbitrate else 1.0
+    declared = []
+    schedule = bus.tx_schedule
+    for binding in bus.tx_bindings.values():
+        rate = 1000.0 / binding.period_ms if binding.period_ms else binding.rate_hz
+        if schedule is not None and binding.key in {slot.binding for slot in schedule.slots}:
+            rate = schedule.frames_per_s(binding.key)  # its slots, whatever rate_hz says
+        declared.append((f"TX {binding.key}", binding.message, rate))
+    for binding in bus.rx_bindings.values():
+        declared.append((f"RX {binding.key}", binding.message, binding.rate_hz))
+    for what, message, rate in declared:
+        if not rate:
+            continue
+        try:
+            msg = dbc.get_message_by_name(message)
+        except KeyError:
+            continue  # reported when the binding is registered
+        bits = frame_bits(msg.length, msg.is_extended_frame, bool(bus.fd), data_ratio) * rate
+        plan.entries.append((what, rate, bits))
+    reporting = bus.robostride_reporting
+    if reporting and reporting.motors:
+        # Type 2 frames: 8 bytes with a 29-bit ID, whatever the DBC calls them
+        rate = reporting.frames_per_s
+        plan.entries.append((f"RX {len(reporting.motors)} motors reporting", rate, frame_bits(8, True) * rate))
+    share = bus.topology
+    if share and share.motors:
+        # A type 1 command and its type 2 reply per motor and cycle
+        rate = share.frames_per_s
+        plan.entries.append((f"TX/RX {len(share.motors)} motors of topology {share.topology}", rate,
+                             frame_bits(8, True) * rate))
+    plan.load = sum(bits for _, _, bits in plan.entries) / bus.bitrate if bus.bitrate else 0.0
+    return plan
+
+
+def declares_traffic(bus) -> bool:
+    """True when some binding of ``bus`` has a period or a declared rate."""
+
+    return (any(b.period_ms or b.rate_hz for b in bus.tx_bindings.values())
+            or bus.tx_schedule is not None
+            or any(b.rate_hz for b in bus.rx_bindings.values())
+            or bool(bus.robostride_reporting)
+            or bool(bus.topology and bus.topology.motors))
+
+
+def check_bus_load(bus, dbc) -> BusLoadPlan:
+    """:func:`plan_bus`, logging a warning or raising ``ValueError`` per ``bus.load_action``."""
+
+    plan = plan_bus(bus, dbc)
+    if plan.load > bus.load_limit:
+        text = (f"[{bus.name}] declared traffic needs {plan.load:.0%} of {bus.bitrate} bit/s worst case, "
+                f"over the {bus.load_limit:.0%} limit: {plan.summary()}")
+        if bus.load_action == "reject":
+            raise ValueError(text)
+        LOG.warning(text)
+    elif plan.entries:
+        LOG.debug("[%s] declared traffic %.1f%% of the bus worst case", bus.name, plan.load * 100)
+    return plan
+
+
+def interface_bits(interface: str, extended: bool) -> Optional[float]:
+    """Worst-case bits of every frame the interface has received and sent, from sysfs; None if unreadable.
+
+    Only totals are known, so each frame is costed as classic with the
+    given ID type and the bytes are spread over them.
+    """
+
+    stats = Path("/sys/class/net") / interface / "statistics"
+    try:
+        packets = sum(int((stats / name).read_text()) for name in ("rx_packets", "tx_packets"))
+        data = sum(int((stats / name).read_text()) for name in ("rx_bytes", "tx_bytes"))
+    except (OSError, ValueError):
+        return None
+    g = _STUFFED_HEADER[extended]
+    return packets * (g + _TRAILER) + 8 * data + (packets * (g - 1) + 8 * data) / 4
+
+
+__all__ = ["BusLoadPlan", "LOAD_ACTIONS", "check_bus_load", "declares_traffic", "frame_bits", "interface_bits", "plan_bus"]
@@ -1,9 +1,25 @@
 
+import time
+from dataclasses import fields
+
+from diagnostic_msgs.msg import DiagnosticArray, DiagnosticStatus, KeyValue
+from rclpy.callback_groups import MutuallyExclusiveCallbackGroup
+from rclpy.clock import Clock, ClockType
 from rclpy.qos import QoSProfile, ReliabilityPolicy, DurabilityPolicy, HistoryPolicy
 
+from .cache import load_dbc
+from .joint_states import JointStateBinding
 from .mapping import TopicTxBinding, RxBinding
+from .metrics import Histogram
 from .service import BusConfig, CanBusService
 
+# BusConfig fields a reload can apply to the open socket; any other change reopens the bus
+RELOADABLE = {'filters', 'auto_filters', 'tx_bindings', 'rx_bindings', 'metadata'}
+
+# Seconds between runs of the timer that measures how late the bus's callback group is served
+EXECUTOR_PROBE_PERIOD = 0.1
+
+
 def make_qos(profile_dict, default_depth=10):
     q = QoSProfile(depth=profile_dict.get('depth', default_depth))
     rel = profile_dict.get('reliability', 'reliable').upper()
@@ -13,39 +29,336 @@ def make_qos(profile_dict, default_depth=10):
     q.history = HistoryPolicy.KEEP_LAST
     return q
 
+
+def needs_restart(old: BusConfig, new: BusConfig) -> bool:
+    """True when ``new`` differs from ``old`` in more than bindings and filters, or the DBC changed."""
+
+    for f in fields(BusConfig):
+        if f.name not in RELOADABLE and getattr(old, f.name) != getattr(new, f.name):
+            return True
+    # Same path, edited file: the cache hands back a different database
+    return load_dbc(old.dbc_file) is not load_dbc(new.dbc_file)
+
+
+def open_service(cfg: BusConfig):
+    """``CanBusService(cfg)`` and how long its parts took: ``(service, {'dbc': s, 'open': s})``.
+
+    The ROS-free part of bringing a bus up, so the bridge runs it on a
+    thread per bus. ``dbc`` is the parse (or cache load) of the DBC, shared
+    with the other buses of the file; ``open`` is the rest of the service,
+    mostly the interface and its socket.
+    """
+
+    start = time.monotonic()
+    load_dbc(cfg.dbc_file)
+    parsed = time.monotonic()
+    service = CanBusService(cfg)
+    return service, {'dbc': parsed - start, 'open': time.monotonic() - parsed}
+
+
 class BusWorker:
-    """Owns one SocketCAN channel, bidirectional ROS<->CAN mapping, and health."""
+    """Owns one SocketCAN channel, bidirectional ROS<->CAN mapping, and health.
+
+    The bus's TX subscriptions share a mutually exclusive callback group of
+    their own. On a ``MultiThreadedExecutor`` (the bridge's ``executor``
+    parameter) the buses' callbacks then run in parallel while each bus
+    still sends its commands one at a time, in order. With metrics on, a
+    timer in the group records how late the executor runs it, the wait a TX
+    callback of the bus sees before it starts.
 
-    def __init__(self, node, cfg: BusConfig, qos_defaults):
+    ``service`` is a bus :func:`open_service` opened already. With ``start``
+    false the bindings exist but nothing is received until :meth:`start`.
+    ``timings`` holds the seconds each step of the bring-up took.
+    """
+
+    def __init__(self, node, cfg: BusConfig, qos_defaults, service=None, timings=None, start=True):
         self.node = node
         self.cfg = cfg
         self.name = cfg.name
+        self.qos_defaults = qos_defaults
+        self.callback_group = MutuallyExclusiveCallbackGroup()
 
-        self.service = CanBusService(cfg)
+        if service is None:
+            service, timings = open_service(cfg)
+        self.service = service
+        self.timings = dict(timings or {})
+        built = time.monotonic()
 
         # Build TX bindings (ROS -> CAN)
-        self.tx_bindings = []
+        self.tx_bindings = {}
         for key, binding in cfg.tx_bindings.items():
-            metadata = dict(binding.metadata)
-            qos_name = metadata.get('qos', 'command')
-            qos = make_qos(qos_defaults.get(qos_name, {}), default_depth=10)
-            self.tx_bindings.append(TopicTxBinding(self.node, self.service, binding, qos))
+            self.tx_bindings[key] = self._make_tx(binding)
 
         # Build RX bindings (CAN -> ROS)
-        self.rx_bindings = []
+        self.rx_bindings = {}
         for key, binding in cfg.rx_bindings.items():
-            qos = make_qos(qos_defaults.get('sensor', {}), default_depth=20)
-            self.rx_bindings.append(RxBinding(self.node, self.service, binding, qos))
+            self.rx_bindings[key] = self._make_rx(binding)
+
+        # RoboStride faults: one DiagnosticArray per change, published from the RX thread
+        self._faults_pub = None
+        if self.service.faults is not None:
+            topic = cfg.robostride_faults.topic or f"/td/{self.name}/faults"
+            self._faults_pub = node.create_publisher(DiagnosticArray, topic,
+                                                     make_qos(qos_defaults.get('command', {}), default_depth=10))
+            self.service.faults.subscribe(self._on_fault)
 
+        self.executor_latency = None
+        self._probe = None
+        if self.service.metrics is not None:
+            self.executor_latency = Histogram()
+            self._probe_due = time.monotonic() + EXECUTOR_PROBE_PERIOD
+            self._probe = node.create_timer(EXECUTOR_PROBE_PERIOD, self._on_probe, callback_group=self.callback_group,
+                                            clock=Clock(clock_type=ClockType.STEADY_TIME))
+        self.timings['bindings'] = time.monotonic() - built
+        if start:
+            self.start()
+
+    def start(self):
+        """Start receiving: from here on the RX bindings publish."""
+
+        started = time.monotonic()
         self.service.start()
+        self.timings['start'] = time.monotonic() - started
+        self._last_diag = (time.monotonic(), self.metrics_snapshot())
         self.node.get_logger().info(
             f"[{self.name}] up on {self.cfg.interface}, bitrate={self.cfg.bitrate}, "
             f"fd={self.cfg.fd}, dbitrate={self.cfg.dbitrate}"
         )
 
+    @staticmethod
+    def _tx_qos(binding, qos_defaults):
+        qos_name = dict(binding.metadata).get('qos', 'command')
+        return qos_defaults.get(qos_name, {})
+
+    def _make_tx(self, binding):
+        qos = make_qos(self._tx_qos(binding, self.qos_defaults), default_depth=10)
+        return TopicTxBinding(self.node, self.service, binding, qos, callback_group=self.callback_group)
+
+    def _make_rx(self, binding):
+        qos = make_qos(self.qos_defaults.get('sensor', {}), default_depth=20)
+        if dict(binding.metadata).get('publish') == 'joint_states':
+            return JointStateBinding(self.node, self.service, binding, qos, callback_group=self.callback_group)
+        return RxBinding(self.node, self.service, binding, qos)
+
+    def reload(self, cfg: BusConfig, qos_defaults) -> bool:
+        """Apply ``cfg`` to the running bus without closing its socket.
+
+        Bindings that were removed, added or changed (including their QoS
+        profile) are torn down and rebuilt one by one while the RX thread
+        keeps receiving; unchanged ones are left alone. Returns False, having
+        changed nothing, when ``cfg`` needs the bus reopened (see
+        :func:`needs_restart`).
+        """
+
+        if needs_restart(self.cfg, cfg):
+            return False
+        old_cfg, old_qos = self.cfg, self.qos_defaults
+        self.qos_defaults = qos_defaults
+        sensor_changed = old_qos.get('sensor', {}) != qos_defaults.get('sensor', {})
+
+        with self.service.reconfigure():
+            for key in list(self.tx_bindings):
+                binding = cfg.tx_bindings.get(key)
+                if (binding == old_cfg.tx_bindings[key]
+                        and self._tx_qos(binding, old_qos) == self._tx_qos(binding, qos_defaults)):
+                    continue
+                self.tx_bindings.pop(key).shutdown()
+                self.service.unregister_tx_binding(key)
+            for key in list(self.rx_bindings):
+                if cfg.rx_bindings.get(key) == old_cfg.rx_bindings[key] and not sensor_changed:
+                    continue
+                self.rx_bindings.pop(key).shutdown()
+                self.service.unregister_rx_binding(key)
+
+            if (cfg.filters, cfg.auto_filters) != (old_cfg.filters, old_cfg.auto_filters):
+                self.service.set_filters(cfg.filters, cfg.auto_filters)
+            for key, binding in cfg.tx_bindings.items():
+                if key not in self.tx_bindings:
+                    self.tx_bindings[key] = self._make_tx(binding)
+            for key, binding in cfg.rx_bindings.items():
+                if key not in self.rx_bindings:
+                    self.rx_bindings[key] = self._make_rx(binding)
+
+        self.cfg = cfg
+        self.node.get_logger().info(
+            f"[{self.name}] reloaded: {len(self.tx_bindings)} TX, {len(self.rx_bindings)} RX binding(s)"
+        )
+        return True
+
+    def _on_fault(self, event):
+        status = DiagnosticStatus(name=f"{self.name}: motor {event.motor}", hardware_id=self.cfg.interface)
+        if event.faults:
+            status.level, status.message = DiagnosticStatus.ERROR, ", ".join(event.faults)
+        else:
+            status.level, status.message = DiagnosticStatus.OK, "cleared"
+        status.values = [KeyValue(key='word', value=f"0x{event.word:08X}"),
+                         KeyValue(key='warnings', value=", ".join(event.warnings) or "none"),
+                         KeyValue(key='source', value=event.source)]
+        msg = DiagnosticArray(status=[status])
+        msg.header.stamp = self.node.get_clock().now().to_msg()
+        self._faults_pub.publish(msg)
+
+    def _on_probe(self):
+        now = time.monotonic()
+        self.executor_latency.observe(max(0.0, now - self._probe_due))
+        # A timer served later than a whole period skips the calls it missed
+        self._probe_due += EXECUTOR_PROBE_PERIOD
+        if self._probe_due <= now:
+            self._probe_due += ((now - self._probe_due) // EXECUTOR_PROBE_PERIOD + 1) * EXECUTOR_PROBE_PERIOD
+
+    def metrics_snapshot(self):
+        """The service's snapshot plus what the ROS side measures.
+
+        ``executor_latency_seconds`` is the histogram of the probe timer's
+        lateness, ``publish_suppressed`` the :meth:`RxBinding.stats` of each
+        binding with a rate limit or change filter, ``joint_states`` the
+        :meth:`JointStateBinding.stats` of each aggregator.
+        """
+
+        snap = self.service.metrics_snapshot()
+        if snap and self.executor_latency is not None:
+            snap['executor_latency_seconds'] = self.executor_latency.snapshot()
+        if snap:
+            bindings = list(self.rx_bindings.items())
+            snap['publish_suppressed'] = {key: b.stats() for key, b in bindings if isinstance(b, RxBinding)
+                                          and (b.min_interval is not None or b.on_change)}
+            snap['joint_states'] = {key: b.stats() for key, b in bindings if isinstance(b, JointStateBinding)}
+        return snap
+
+    def diagnostic_status(self):
+        """DiagnosticStatus of the bus since the previous call: rates, errors, mean timings.
+
+        WARN when the kernel or a handler queue dropped frames, a binding
+        with ``loss`` missed frames, a handler raised, error frames arrived or the measured bus load passed
+        ``load_limit`` in that interval, the controller is error warning
+        or error passive, or RX bindings are being shed;
+        ERROR when the RX thread is not running, the bus is off or its
+        interface is lost.
+        """
+
+        now, snap = time.monotonic(), self.metrics_snapshot()
+        then, prev = self._last_diag
+        self._last_diag = (now, snap)
+        status = DiagnosticStatus(name=f"td_can_bridge: {self.name}", hardware_id=self.cfg.interface)
+        if not snap:
+            status.level = DiagnosticStatus.OK
+            status.message = "metrics disabled"
+            return status
+
+        elapsed = max(now - then, 1e-9)
+        delta = {k: snap[k] - prev.get(k, 0) for k in ('rx_frames', 'tx_frames', 'rx_overflow', 'decode_errors',
+                                                       'handler_errors')}
+        queue_drops = sum(q['dropped'] for q in snap['queues'].values()) - sum(
+            q['dropped'] for q in prev.get('queues', {}).values())
+        measured = None
+        if 'bus_bits' in snap and 'bus_bits' in prev:
+            measured = (snap['bus_bits'] - prev['bus_bits']) / elapsed / snap['bitrate']
+        values = {
+            'rx_fps': f"{delta['rx_frames'] / elapsed:.1f}",
+            'tx_fps': f"{delta['tx_frames'] / elapsed:.1f}",
+            'rx_overflow_drops': str(snap['rx_overflow']),
+            'queue_drops': str(sum(q['dropped'] for q in snap['queues'].values())),
+            'decode_errors': str(snap['decode_errors']),
+            'handler_errors': str(snap['handler_errors']),
+            'bus_load_projected': f"{snap['bus_load_projected']:.1%}",
+        }
+        if measured is not None:
+            values['bus_load_measured'] = f"{measured:.1%}"
+        errors = snap['bus_errors']
+        error_frames = sum(errors['errors'].values())
+        new_errors = error_frames - sum(prev.get('bus_errors', {}).get('errors', {}).values())
+        values['bus_state'] = errors['state']
+        values['error_frames'] = str(error_frames)
+        values['error_counters'] = f"tx {errors['tx_error_counter']} rx {errors['rx_error_counter']}"
+        values['recoveries'] = str(errors['recoveries'])
+        for key, stats in snap['queues'].items():
+            values[f"queue_depth {key}"] = f"{stats['depth']} (max {stats['max_depth']})"
+        for key, stats in snap['publish_suppressed'].items():
+            values[f"publish_suppressed {key}"] = f"{stats['rate']} rate, {stats['unchanged']} unchanged"
+        for key, stats in snap['joint_states'].items():
+            values[f"joint_states {key}"] = (f"{stats['published']} published, {stats['stale_publishes']} with stale "
+                                             f"joints; stale now: {', '.join(stats['stale']) or 'none'}")
+        lost = {}
+        for key, stats in snap.get('frame_loss', {}).items():
+            stages = ", ".join(f"{stage} {count}" for stage, count in stats['stages'].items() if count)
+            values[f"frame_loss {key}"] = f"{stats['lost']} lost ({stats['loss_rate']:.2%}){': ' + stages if stages else ''}"
+            new = stats['lost'] - prev.get('frame_loss', {}).get(key, {}).get('lost', 0)
+            if new > 0:
+                lost[key] = new
+        gateway_dropped, gateway_missing = {}, []
+        for route, stats in snap.get('gateway', {}).items():
+            values[f"gateway {route}"] = f"{stats['handled']} forwarded, {stats['dropped']} dropped, {stats['deleted']} deleted"
+            if not stats['installed']:
+                gateway_missing.append(route)
+            new = stats['dropped'] - prev.get('gateway', {}).get(route, {}).get('dropped', 0)
+            if new > 0:
+                gateway_dropped[route] = new
+        for name, stats in snap['tx_classes'].items():
+            values[f"tx_queue_depth {name}"] = f"{stats['depth']} (max {stats['max_depth']}, {stats['dropped']} dropped)"
+        for kind, hists in (('decode', snap['decode_seconds']), ('handler', snap['handler_seconds']),
+                            ('tx_queue', snap['tx_queue_seconds'])):
+            for name, hist in hists.items():
+                if hist['count']:
+                    values[f"{kind}_us_mean {name}"] = f"{hist['sum'] / hist['count'] * 1e6:.1f}"
+        profiled = [(stats['cpu_s'], f"{stage} {key}") for stage, keys in snap.get('profile', {}).items()
+                    for key, stats in keys.items()]
+        for cpu_s, name in sorted(profiled, reverse=True)[:3]:  # full table: the ~/profile_report service
+            values[f"profile_cpu_s {name}"] = f"{cpu_s:.3f}"
+        shedding = snap.get('shedding')
+        if shedding:
+            values['rx_lag_ms'] = f"{shedding['lag_ms']:.1f} (max {shedding['max_lag_ms']:.1f})"
+            values['shedding'] = ("none" if shedding['floor'] is None else
+                                  f"priority <= {shedding['floor']} for {shedding['seconds_at_level']:.0f} s")
+        if snap.get('idle_bindings'):
+            values['idle_bindings'] = ", ".join(snap['idle_bindings'])  # lazy, without subscribers
+        latency, before = snap.get('executor_latency_seconds'), prev.get('executor_latency_seconds')
+        if latency and before and latency['count'] > before['count']:
+            mean = (latency['sum'] - before['sum']) / (latency['count'] - before['count'])
+            values['executor_latency_us_mean'] = f"{mean * 1e6:.1f}"
+        status.values = [KeyValue(key=k, value=v) for k, v in values.items()]
+
+        problems = []
+        if delta['rx_overflow'] > 0:
+            problems.append(f"kernel dropped {delta['rx_overflow']} frames")
+        if queue_drops > 0:
+            problems.append(f"handler queues dropped {queue_drops} frames")
+        if lost:
+            problems.append("lost frames: " + ", ".join(f"{key} {count}" for key, count in lost.items()))
+        if shedding and shedding['floor'] is not None:
+            problems.append(f"behind by {shedding['lag_ms']:.0f} ms, shedding RX priority <= {shedding['floor']}")
+        if gateway_missing:
+            problems.append("gateway rules gone: " + ", ".join(gateway_missing))
+        if gateway_dropped:
+            problems.append("gateway dropped: " + ", ".join(f"{route} {count}" for route, count in gateway_dropped.items()))
+        if measured is not None and measured > self.cfg.load_limit:
+            problems.append(f"bus load {measured:.0%} over the {self.cfg.load_limit:.0%} limit")
+        if delta['decode_errors'] or delta['handler_errors']:
+            problems.append(f"{delta['decode_errors']} decode / {delta['handler_errors']} handler errors")
+        if new_errors > 0:
+            problems.append(f"{new_errors} error frames")
+        if errors['state'] in ('error_warning', 'error_passive'):
+            problems.append(errors['state'].replace('_', ' '))
+        if not self.service.running:
+            status.level, status.message = DiagnosticStatus.ERROR, "RX thread not running"
+        elif errors['state'] == 'down':
+            status.level, status.message = DiagnosticStatus.ERROR, f"{self.cfg.interface} lost, reopening"
+        elif errors['state'] == 'bus_off':
+            status.level, status.message = DiagnosticStatus.ERROR, "bus off"
+        elif problems:
+            status.level, status.message = DiagnosticStatus.WARN, "; ".join(problems)
+        else:
+            status.level, status.message = DiagnosticStatus.OK, "ok"
+        return status
+
     def shutdown(self):
-        for binding in self.rx_bindings:
+        if self._probe is not None:
+            self.node.destroy_timer(self._probe)
+            self._probe = None
+        for binding in self.rx_bindings.values():
             binding.shutdown()
-        for binding in self.tx_bindings:
+        for binding in self.tx_bindings.values():
             binding.shutdown()
         self.service.shutdown()
+        if self._faults_pub is not None:
+            self.node.destroy_publisher(self._faults_pub)
+            self._faults_pub = None
@@ -0,0 +1,115 @@
+"""On-disk cache of parsed DBC databases and bridge configs.
+
+``cantools`` parses a large DBC in seconds, and every bridge start (or
+restart after a crash) used to pay that per bus. :func:`load_dbc` and
+:func:`cached` pickle the parsed result under a key made of the source
+bytes, the path and the Python/cantools versions, so an unchanged file
+loads in milliseconds and any edit is picked up on the next start. Entries
+for an older version of the same file are removed when a new one is written.
+
+The cache lives in ``$TD_CAN_CACHE_DIR``, else
+``$XDG_CACHE_HOME/td_can_bridges`` (``~/.cache/td_can_bridges``); set
+``TD_CAN_CACHE=0`` to disable it. Entries are pickles, so the directory is
+created private to the user. A damaged or unreadable entry is rebuilt.
+"""
+
+from __future__ import annotations
+
+import hashlib
+import logging
+import os
+import pickle
+import sys
+import threading
+from pathlib import Path
+from typing import Any, Callable, Dict, Iterable, Optional, TypeVar
+
+import cantools
+
+LOG = logging.getLogger(__name__)
+
+CACHE_VERSION = 5  # bump when the cached dataclasses change
+T = TypeVar("T")
+
+# Within one process every bus of the same DBC shares a single parsed database
+_memory: Dict[str, Any] = {}
+# One lock per key, so buses opened in parallel parse a shared DBC once and the others wait for it
+_building: Dict[str, threading.Lock] = {}
+_building_guard = threading.Lock()
+
+
+def cache_dir() -> Optional[Path]:
+    if os.environ.get("TD_CAN_CACHE", "1").lower() in ("0", "off", "false", "no"):
+        return None
+    root = os.environ.get("TD_CAN_CACHE_DIR")
+    if root:
+        return Path(root)
+    return Path(os.environ.get("XDG_CACHE_HOME") or Path.home() / ".cache") / "td_can_bridges"
+
+
+def cached(kind: str, source: Path, parts: Iterable[bytes], build: Callable[[], T]) -> T:
+    """Return ``build()``, reusing the pickled result while ``parts`` are unchanged."""
+
+    digest = hashlib.sha256()
+    for part in (kind.encode(), str(CACHE_VERSION).encode(), sys.version.encode(),
+                 getattr(cantools, "__version__", "").encode(), str(source).encode(), *parts):
+        digest.update(len(part).to_bytes(8, "little"))
+        digest.update(part)
+    key = digest.hexdigest()
+    if key in _memory:
+        return _memory[key]
+    with _building_guard:
+        lock = _building.setdefault(key, threading.Lock())
+    with lock:
+        if key in _memory:
+            return _memory[key]
+        return _load(kind, source, key, build)
+
+
+def _load(kind: str, source: Path, key: str, build: Callable[[], T]) -> T:
+    root = cache_dir()
+    prefix = f"{kind}-{hashlib.sha256(str(source).encode()).hexdigest()[:16]}-"
+    entry = root / f"{prefix}{key[:32]}.pickle" if root is not None else None
+    if entry is not None:
+        try:
+            with entry.open("rb") as stream:
+                value = pickle.load(stream)
+            LOG.debug("%s: loaded from cache %s", source, entry)
+            _memory[key] = value
+            return value
+        except FileNotFoundError:
+            pass
+        except Exception as exc:  # truncated file, or pickled by incompatible code
+            LOG.debug("%s: ignoring cache entry %s (%s)", source, entry, exc)
+
+    value = build()
+    _memory[key] = value
+    if entry is not None:
+        _store(entry, prefix, value)
+    return value
+
+
+def _store(entry: Path, prefix: str, value: Any) -> None:
+    tmp = entry.with_name(f"{entry.name}.{os.getpid()}.tmp")
+    try:
+        entry.parent.mkdir(mode=0o700, parents=True, exist_ok=True)
+        with tmp.open("wb") as stream:
+            pickle.dump(value, stream, protocol=pickle.HIGHEST_PROTOCOL)
+        os.replace(tmp, entry)
+        for old in entry.parent.glob(f"{prefix}*.pickle"):
+            if old != entry:
+                old.unlink(missing_ok=True)
+    except Exception as exc:  # read-only home, unpicklable object: run uncached
+        LOG.debug("cannot write cache entry %s: %s", entry, exc)
+        tmp.unlink(missing_ok=True)
+
+
+def load_dbc(path: Path | str):
+    """``cantools.database.load_file(path)`` through the cache."""
+
+    path = Path(path)
+    data = path.read_bytes()
+    return cached("dbc", path.resolve(), [data], lambda: cantools.database.load_file(str(path)))
+
+
+__all__ = ["cache_dir", "cached", "load_dbc"]
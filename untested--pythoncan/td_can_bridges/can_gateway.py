@@ -0,0 +1,317 @@
+"""Kernel CAN gateway (``can-gw``) rules for plain forwarding between interfaces.
+
+A bus with ``gateway`` forwards frames of its interface to others in the
+kernel, so they never reach Python::
+
+    - name: sensor_bus
+      interface: can1
+      gateway:
+        - name: feet_to_motors
+          to: can0
+          filter: {can_id: 0x200, can_mask: 0x7F0}   # FootForce and its neighbours
+        - to: can0
+          filter: {can_id: 0x210, can_mask: 0x7FF, extended: false}
+          modify:
+            set: {id: 0x310}
+
+* ``to``: the interface the frames are sent on. It must not be the bus's own.
+* ``filter``: ``can_id`` / ``can_mask`` as in ``filters``, with
+  ``extended`` true or false to match one frame format only. Without
+  ``filter``, every frame is forwarded.
+* ``modify``: ``and``, ``or``, ``xor`` and ``set``, each with any of
+  ``id``, ``dlc`` and ``data``. The kernel applies them in that order, to
+  classic frames only. ``data`` is a list or a hex string; shorter than 8
+  bytes, ``and``, ``or`` and ``xor`` leave the rest of the payload as it
+  is, and ``set`` clears it.
+* ``echo``: also deliver the sent frames to the sockets of ``to``, as a
+  local send would (default false). ``source_timestamp``: keep the received
+  frame's timestamp. ``hops``: the most gateways a frame may pass, for
+  routes that could loop.
+
+``CanBusService.start()`` installs the rules over rtnetlink and
+``shutdown()`` removes them. That needs ``CAP_NET_ADMIN`` and the ``can-gw``
+module (``modprobe can-gw``). Each rule carries an ID made from the bus and
+route names, so rules a crashed process left behind are replaced at the
+next start, and other tools' rules are never touched. ``cangw -L`` lists
+them. ``service.gateway_stats()`` and ``metrics_snapshot()["gateway"]``
+have the kernel's frames forwarded, dropped (the send failed) and deleted
+(over ``hops``) per route.
+"""
+
+from __future__ import annotations
+
+import errno
+import logging
+import socket
+import struct
+import threading
+import zlib
+from dataclasses import dataclass, field
+from typing import Any, Dict, List, Mapping, Optional, Tuple
+
+from .netlink import Netlink, attr, attrs
+
+LOG = logging.getLogger(__name__)
+
+AF_CAN = 29
+RTM_NEWROUTE, RTM_DELROUTE, RTM_GETROUTE = 24, 25, 26
+CGW_TYPE_CAN_CAN = 1
+
+# Netlink attributes of linux/can/gw.h
+CGW_MOD_AND, CGW_MOD_OR, CGW_MOD_XOR, CGW_MOD_SET = 1, 2, 3, 4
+CGW_HANDLED, CGW_DROPPED = 7, 8
+CGW_SRC_IF, CGW_DST_IF, CGW_FILTER, CGW_DELETED, CGW_LIM_HOPS, CGW_MOD_UID = 9, 10, 11, 12, 13, 14
+CGW_FLAGS_CAN_ECHO, CGW_FLAGS_CAN_SRC_TSTAMP = 0x1, 0x2
+MOD_ID, MOD_DLC, MOD_DATA = 0x1, 0x2, 0x4
+COUNTERS = {CGW_HANDLED: "handled", CGW_DROPPED: "dropped", CGW_DELETED: "deleted"}
+
+CAN_EFF_FLAG, CAN_FLAGS = 0x80000000, 0xE0000000
+MOD_OPS = {"and": CGW_MOD_AND, "or": CGW_MOD_OR, "xor": CGW_MOD_XOR, "set": CGW_MOD_SET}
+
+_RTCANMSG = struct.Struct("=BBH")
+_FRAME_MOD = struct.Struct("=IB3x8sB")  # struct cgw_frame_mod: a can_frame and the fields it sets
+
+
+@dataclass(frozen=True)
+class FrameMod:
+    """One ``modify`` operation; None leaves a field out of it."""
+
+    can_id: Optional[int] = None
+    dlc: Optional[int] = None
+    data: Optional[bytes] = None
+
+
+@dataclass(frozen=True)
+class GatewayRoute:
+    """One ``gateway`` entry of a bus."""
+
+    name: str
+    to: str
+    can_id: int = 0
+    can_mask: int = 0  # 0 forwards every frame
+    modify: Mapping[str, FrameMod] = field(default_factory=dict)  # "and", "or", "xor", "set"
+    echo: bool = False
+    source_timestamp: bool = False
+    hops: Optional[int] = None
+
+
+def _int(value: Any) -> int:
+    return int(value, 0) if isinstance(value, str) else int(value)
+
+
+def _mod_entry(op: str, value: Any, context: str) -> FrameMod:
+    if not isinstance(value, Mapping):
+        raise ValueError(f"{context}.modify.{op} must be a mapping with id, dlc and/or data")
+    unknown = sorted(set(value) - {"id", "dlc", "data"})
+    if unknown:
+        raise ValueError(f"{context}.modify.{op}: unknown key(s) {unknown}")
+    data = value.get("data")
+    if data is not None:
+        data = bytes.fromhex(data) if isinstance(data, str) else bytes(_int(b) for b in data)
+        if len(data) > 8:
+            raise ValueError(f"{context}.modify.{op}.data has {len(data)} bytes, at most 8")
+    dlc = value.get("dlc")
+    if dlc is not None and not 0 <= _int(dlc) <= 8:
+        raise ValueError(f"{context}.modify.{op}.dlc must be 0 to 8, got {dlc}")
+    return FrameMod(
+        can_id=_int(value["id"]) if value.get("id") is not None else None,
+        dlc=_int(dlc) if dlc is not None else None,
+        data=data,
+    )
+
+
+def gateway_entry(value: Any, source: str, context: str) -> Tuple[GatewayRoute, ...]:
+    """Parse a bus's ``gateway`` list; ``source`` is the bus's interface."""
+
+    if not value:
+        return ()
+    if not isinstance(value, list):
+        raise ValueError(f"{context}.gateway must be a list of routes")
+    routes: List[GatewayRoute] = []
+    for i, spec in enumerate(value):
+        where = f"{context}.gateway[{i}]"
+        if not isinstance(spec, Mapping) or not spec.get("to"):
+            raise ValueError(f"{where} must be a mapping with 'to'")
+        unknown = sorted(set(spec) - {"name", "to", "filter", "modify", "echo", "source_timestamp", "hops"})
+        if unknown:
+            raise ValueError(f"{where}: unknown key(s) {unknown}")
+        to = str(spec["to"])
+        if to == source:
+            raise ValueError(f"{where}.to is the bus's own interface '{source}'")
+        flt = spec.get("filter") or {}
+        if not isinstance(flt, Mapping):
+            raise ValueError(f"{where}.filter must be a mapping with can_id and can_mask")
+        can_id, can_mask = _int(flt.get("can_id", 0)), _int(flt.get("can_mask", 0))
+        if "extended" in flt:
+            can_mask |= CAN_EFF_FLAG
+            can_id = can_id | CAN_EFF_FLAG if flt["extended"] else can_id & ~CAN_EFF_FLAG
+        extended = bool(can_id & CAN_EFF_FLAG) or can_id > 0x7FF
+        modify = {}
+        for op, mod in (spec.get("modify") or {}).items():
+            if op not in MOD_OPS:
+                raise ValueError(f"{where}.modify: unknown operation '{op}', expected one of {list(MOD_OPS)}")
+            mod = _mod_entry(op, mod, where)
+            if mod.can_id is not None:
+                # The kernel writes the whole can_id, format flags included
+                if op == "and":
+                    mod = FrameMod(mod.can_id | CAN_FLAGS, mod.dlc, mod.data)
+                elif op == "set" and (extended or mod.can_id > 0x7FF):
+                    mod = FrameMod(mod.can_id | CAN_EFF_FLAG, mod.dlc, mod.data)
+            modify[op] = mod
+        hops = spec.get("hops")
+        if hops is not None and not 1 <= int(hops) <= 255:
+            raise ValueError(f"{where}.hops must be 1 to 255, got {hops}")
+        name = str(spec.get("name") or f"{to}#{i}")
+        if any(r.name == name for r in routes):
+            raise ValueError(f"{where}: route name '{name}' is used twice")
+        routes.append(GatewayRoute(
+            name=name, to=to, can_id=can_id, can_mask=can_mask, modify=modify,
+            echo=bool(spec.get("echo", False)), source_timestamp=bool(spec.get("source_timestamp", False)),
+            hops=int(hops) if hops is not None else None,
+        ))
+    return tuple(routes)
+
+
+def _mod_attr(op: str, mod: FrameMod) -> bytes:
+    fill = 0xFF if op == "and" else 0x00  # the bytes past a short ``data`` stay as they are
+    data = (mod.data or b"") + bytes([fill]) * (8 - len(mod.data or b""))
+    modtype = (MOD_ID if mod.can_id is not None else 0) | (MOD_DLC if mod.dlc is not None else 0) \
+        | (MOD_DATA if mod.data is not None else 0)
+    return attr(MOD_OPS[op], _FRAME_MOD.pack(mod.can_id or 0, mod.dlc or 0, data, modtype))
+
+
+def _dump_rules(nl: Netlink) -> List[Tuple[int, Dict[int, bytes]]]:
+    """Every can-gw rule, as its ``rtcanmsg`` flags and attributes."""
+
+    rules = []
+    for kind, body in nl.dump(RTM_GETROUTE, _RTCANMSG.pack(AF_CAN, 0, 0)):
+        if kind != RTM_NEWROUTE or len(body) < _RTCANMSG.size:
+            continue
+        _, gwtype, flags = _RTCANMSG.unpack_from(body)
+        if gwtype == CGW_TYPE_CAN_CAN:
+            rules.append((flags, dict(attrs(body[_RTCANMSG.size:]))))
+    return rules
+
+
+def _uid_of(rule: Mapping[int, bytes]) -> Optional[int]:
+    raw = rule.get(CGW_MOD_UID)
+    return struct.unpack("=I", raw[:4])[0] if raw and len(raw) >= 4 else None
+
+
+class CanGateway:
+    """The can-gw rules of one bus's ``gateway`` routes, from :meth:`install` to :meth:`remove`."""
+
+    def __init__(self, bus: str, interface: str, routes: Tuple[GatewayRoute, ...]):
+        self.bus = bus
+        self.interface = interface
+        self.routes = routes
+        # A fixed, non-zero ID per route: finds its rule in the kernel's list and in a later run
+        self.uids = {r.name: (zlib.crc32(f"td_can/{bus}/{r.name}".encode()) or 1) for r in routes}
+        self.installed = False
+        self._lock = threading.Lock()
+
+    def _message(self, route: GatewayRoute) -> bytes:
+        flags = (CGW_FLAGS_CAN_ECHO if route.echo else 0) | (CGW_FLAGS_CAN_SRC_TSTAMP if route.source_timestamp else 0)
+        body = _RTCANMSG.pack(AF_CAN, CGW_TYPE_CAN_CAN, flags)
+        for op in ("and", "or", "xor", "set"):
+            if op in route.modify:
+                body += _mod_attr(op, route.modify[op])
+        body += attr(CGW_SRC_IF, struct.pack("=I", socket.if_nametoindex(self.interface)))
+        body += attr(CGW_DST_IF, struct.pack("=I", socket.if_nametoindex(route.to)))
+        body += attr(CGW_FILTER, struct.pack("=II", route.can_id, route.can_mask))
+        if route.hops is not None:
+            body += attr(CGW_LIM_HOPS, struct.pack("=B", route.hops))
+        return body + attr(CGW_MOD_UID, struct.pack("=I", self.uids[route.name]))
+
+    def _remove_ours(self, nl: Netlink) -> int:
+        """Delete every rule with one of our IDs, as the kernel lists it; returns how many."""
+
+        ours = set(self.uids.values())
+        removed = 0
+        for flags, rule in _dump_rules(nl):
+            if _uid_of(rule) not in ours or not rule.get(CGW_SRC_IF) or not rule.get(CGW_DST_IF):
+                continue  # both interfaces unset would delete every rule
+            body = _RTCANMSG.pack(AF_CAN, CGW_TYPE_CAN_CAN, flags)
+            body += b"".join(attr(kind, raw) for kind, raw in rule.items() if kind not in COUNTERS)
+            try:
+                nl.request(RTM_DELROUTE, 0, body)
+                removed += 1
+            except OSError as exc:
+                LOG.warning("[%s] can-gw: removing a rule failed: %s", self.bus, exc)
+        return removed
+
+    def install(self) -> None:
+        """Replace our rules in the kernel with the configured ones; raises RuntimeError."""
+
+        with self._lock:
+            if self.installed:
+                return
+            try:
+                nl = Netlink()
+            except OSError as exc:
+                raise RuntimeError(f"bus '{self.bus}': no rtnetlink socket for the gateway: {exc}") from exc
+            try:
+                stale = self._remove_ours(nl)
+                if stale:
+                    LOG.info("[%s] can-gw: replaced %d rule(s) left by an earlier run", self.bus, stale)
+                for route in self.routes:
+                    try:
+                        nl.request(RTM_NEWROUTE, 0, self._message(route))
+                    except OSError as exc:
+                        self._remove_ours(nl)
+                        hint = {errno.EPERM: " (needs CAP_NET_ADMIN)",
+                                errno.EOPNOTSUPP: " (modprobe can-gw)",
+                                errno.ENODEV: " (no such interface)"}.get(exc.errno, "")
+                        raise RuntimeError(f"bus '{self.bus}': gateway route '{route.name}' to {route.to}: "
+                                           f"{exc.strerror or exc}{hint}") from exc
+                    LOG.info("[%s] can-gw: %s -> %s, id 0x%X mask 0x%X", self.bus, self.interface, route.to,
+                             route.can_id, route.can_mask)
+                self.installed = True
+            finally:
+                nl.close()
+
+    def remove(self) -> None:
+        with self._lock:
+            if not self.installed:
+                return
+            self.installed = False
+            try:
+                nl = Netlink()
+            except OSError as exc:
+                LOG.warning("[%s] can-gw: rules left installed: %s", self.bus, exc)
+                return
+            try:
+                self._remove_ours(nl)
+            finally:
+                nl.close()
+
+    def stats(self) -> Dict[str, Dict[str, Any]]:
+        """Per route: ``installed`` (its rule is in the kernel's list) and the kernel's counters."""
+
+        out = {r.name: {"installed": False, "handled": 0, "dropped": 0, "deleted": 0} for r in self.routes}
+        if not self.installed:
+            return out
+        names = {uid: name for name, uid in self.uids.items()}
+        with self._lock:
+            try:
+                nl = Netlink()
+                try:
+                    rules = _dump_rules(nl)
+                finally:
+                    nl.close()
+            except OSError as exc:
+                LOG.debug("[%s] can-gw: listing rules failed: %s", self.bus, exc)
+                return out
+        for _, rule in rules:
+            name = names.get(_uid_of(rule))
+            if name is None:
+                continue
+            entry = out[name]
+            entry["installed"] = True
+            for kind, key in COUNTERS.items():
+                if kind in rule:
+                    entry[key] = struct.unpack("=I", rule[kind][:4])[0]
+        return out
+
+
+__all__ = ["CanGateway", "FrameMod", "GatewayRoute", "gateway_entry"]
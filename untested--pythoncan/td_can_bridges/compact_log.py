@@ -0,0 +1,736 @@
+"""Compact CAN log for long recordings: per-ID streams, delta-of-delta timestamps, XOR'd payloads.
+
+A day of RS02 feedback is mostly the same frames at the same period with a
+few position and temperature bits moving. :class:`CompactLogWriter` buffers
+a chunk of frames (``chunk_frames``, or ``chunk_s`` seconds of wall time)
+split into one stream per (channel, CAN ID), and writes each stream as:
+
+* timestamps in ticks of ``resolution_ns`` (default 1 us), stored as deltas
+  of deltas in the narrowest of 1, 2, 4 or 8 bytes that holds the stream's
+  largest one: a periodic ID's are its jitter, mostly one or two bytes;
+* one length and one flags byte per frame;
+* each payload XOR'd with the stream's previous one, so unchanged bytes are
+  zeros;
+
+then zlib-compresses each stream on its own. The chunk's directory (the
+channels and, per stream, the ID, frame count, first and last tick and
+compressed size) is left uncompressed in front of the streams, so
+:class:`CompactLogReader` lists a file's IDs and reads one ID's frames by
+seeking past everything else, without inflating it.
+
+File layout (little-endian)::
+
+    header     magic "TDCANLG1", version u32, resolution_ns u32
+    chunk      "TDCH", directory length u32, body length u32
+      directory  channel count u16, per channel: length u8 + UTF-8 name;
+                 stream count u32, per stream: channel u16, can_id u32,
+                 frames u32, first tick i64, last tick i64,
+                 compressed length u32, timestamp width u8
+      body       the streams' zlib blobs in directory order, each inflating to
+                 deltas of deltas ((frames - 1) x width, t1 - t0 first), lengths
+                 (frames), flags (frames), XOR'd payloads (sum of lengths)
+    chunk      ...
+    index      "TDIN", chunk count u32, ID count u32, bitmap bytes u32;
+               channel count u16 + names as above; per ID: channel u16,
+               can_id u32, frames u64; per chunk: offset u64, first tick
+               i64, last tick i64, frames u32; per chunk: bitmap of the IDs
+               it holds (bit n: ID n)
+    trailer    index offset u64, index length u32, "TDIX"
+
+``can_id`` carries ``CAN_EFF_FLAG``, ``CAN_RTR_FLAG`` and ``CAN_ERR_FLAG`` as
+on the socket; flags are ``canfd_frame.flags`` with ``FLAG_FD`` (0x80) for
+CAN FD frames. Timestamps are rounded to the resolution, which is lossless
+for microsecond socket timestamps. A chunk is complete once its body is
+written, so a writer that is killed loses its last chunk at most; the index
+is written when the file is closed, and :func:`build_index` adds it to a file
+whose writer was killed.
+
+The reader maps the file and, from the index, goes straight to the chunks
+that hold a selected ID in the selected time range: finding one fault ID in
+a six-hour log reads the index, those chunks' directories and the fault
+streams, nothing else.
+
+The recorder writes this format for a ``.tdlog`` path, and
+:func:`td_can_bridges.replay.read_log` reads it, so replay and
+:mod:`td_can_bridges.log_export` take it like a BLF file::
+
+    with CompactLogReader("day.tdlog") as log:
+        print(log.ids())                       # {(channel, can_id): frames}
+        for frame in log.frames(ids={0x201}):  # LogFrames of one ID
+            ...
+        faults = log.frames(ids=[(0x95000000, 0x9F000000)], start=t0, end=t1)  # RS02 type 21
+
+Standard library only; :func:`signal_filter` takes a cantools database.
+"""
+
+from __future__ import annotations
+
+import heapq
+import mmap
+import operator
+import re
+import struct
+import sys
+import time
+import zlib
+from array import array
+from itertools import accumulate
+from pathlib import Path
+from typing import Any, Callable, Dict, Iterable, Iterator, List, Mapping, NamedTuple, Optional, Tuple, Union
+
+from .replay import LogFrame
+from .socketcan_rx import CAN_EFF_FLAG, CAN_ERR_FLAG, CAN_MTU, CAN_RTR_FLAG
+
+MAGIC = b"TDCANLG1"
+VERSION = 1
+SUFFIX = ".tdlog"
+FLAG_FD = 0x80
+DEFAULT_RESOLUTION_NS = 1000
+DEFAULT_CHUNK_FRAMES = 262144
+DEFAULT_CHUNK_S = 10.0
+
+_HEADER = struct.Struct("<8sII")
+_CHUNK = struct.Struct("<4sII")
+_CHUNK_MAGIC = b"TDCH"
+_STREAM = struct.Struct("<HIIqqIB")
+_COUNT16 = struct.Struct("<H")
+_COUNT32 = struct.Struct("<I")
+_INDEX = struct.Struct("<4sIII")
+_INDEX_MAGIC = b"TDIN"
+_INDEX_ID = struct.Struct("<HIQ")
+_INDEX_CHUNK = struct.Struct("<QqqI")
+_TRAILER = struct.Struct("<QI4s")
+_TRAILER_MAGIC = b"TDIX"
+_FRAME_HEAD = struct.Struct("=IBB")  # struct can_frame / canfd_frame: can_id, len, flags
+# width in bytes -> array typecode
+_TYPECODES = {1: "b", 2: "h", 4: "i", 8: "q"}
+_SWAP = sys.byteorder != "little"
+
+
+class StreamInfo(NamedTuple):
+    channel: str
+    can_id: int
+    frames: int
+    first: float   # timestamp of the first frame, seconds
+    last: float
+    offset: int    # of the compressed stream in the file
+    size: int
+    width: int
+    first_tick: int
+    last_tick: int
+
+
+class _Stream:
+    __slots__ = ("ticks", "data", "flags")
+
+    def __init__(self):
+        self.ticks: List[int] = []
+        self.data: List[bytes] = []
+        self.flags = bytearray()
+
+
+def _encode(stream: _Stream, level: int) -> Tuple[bytes, int]:
+    """zlib blob and timestamp width of one stream."""
+
+    ticks = stream.ticks
+    deltas = [b - a for a, b in zip(ticks, ticks[1:])]
+    dods = [b - a for a, b in zip([0] + deltas, deltas)]
+    peak = max(max(dods), -min(dods)) if dods else 0
+    width = next(w for w in (1, 2, 4, 8) if peak < 1 << (8 * w - 1))
+    packed = array(_TYPECODES[width], dods)
+    if _SWAP:
+        packed.byteswap()
+    lengths = bytes(len(d) for d in stream.data)
+    xored = []
+    prev = b""
+    for data in stream.data:
+        n = len(data)
+        if len(prev) != n:
+            prev = prev[:n].ljust(n, b"\0")
+        xored.append((int.from_bytes(data, "little") ^ int.from_bytes(prev, "little")).to_bytes(n, "little"))
+        prev = data
+    blob = b"".join((packed.tobytes(), lengths, bytes(stream.flags), b"".join(xored)))
+    return zlib.compress(blob, level), width
+
+
+def _decode(blob: bytes, frames: int, width: int, first: int) -> Tuple[List[int], List[bytes], bytes]:
+    """Ticks, payloads and flags of one stream."""
+
+    raw = zlib.decompress(blob)
+    split = (frames - 1) * width
+    dods = array(_TYPECODES[width])
+    dods.frombytes(raw[:split])
+    if _SWAP:
+        dods.byteswap()
+    ticks = list(accumulate(accumulate(dods), initial=first))
+    lengths = raw[split:split + frames]
+    flags = raw[split + frames:split + 2 * frames]
+    pos = split + 2 * frames
+    data = []
+    prev = b""
+    for n in lengths:
+        if len(prev) != n:
+            prev = prev[:n].ljust(n, b"\0")
+        prev = (int.from_bytes(raw[pos:pos + n], "little") ^ int.from_bytes(prev, "little")).to_bytes(n, "little")
+        data.append(prev)
+        pos += n
+    return ticks, data, flags
+
+
+def encode_chunk(streams: Mapping[Tuple[str, int], _Stream], level: int) -> bytes:
+    """One chunk of ``streams``, header, directory and body, as it goes in a file."""
+
+    channels: Dict[str, int] = {}
+    entries = []
+    blobs = []
+    for (channel, can_id), stream in streams.items():
+        blob, width = _encode(stream, level)
+        index = channels.setdefault(channel, len(channels))
+        entries.append(_STREAM.pack(index, can_id, len(stream.ticks), stream.ticks[0], stream.ticks[-1],
+                                    len(blob), width))
+        blobs.append(blob)
+    names = [name.encode() for name in channels]
+    directory = b"".join([_COUNT16.pack(len(names))] + [bytes((len(n),)) + n for n in names]
+                         + [_COUNT32.pack(len(entries))] + entries)
+    body = b"".join(blobs)
+    return _CHUNK.pack(_CHUNK_MAGIC, len(directory), len(body)) + directory + body
+
+
+def file_header(resolution_ns: int = DEFAULT_RESOLUTION_NS) -> bytes:
+    """The start of a ``.tdlog`` file; chunks follow, and :func:`build_index` adds the index."""
+
+    return _HEADER.pack(MAGIC, VERSION, resolution_ns)
+
+
+class ChunkBuilder:
+    """Frames of one chunk in memory, for chunks that go somewhere other than a file.
+
+    :meth:`encode` gives the chunk as :class:`CompactLogWriter` writes it,
+    so a file of :func:`file_header` and such chunks, indexed by
+    :func:`build_index`, is a compact log (:mod:`td_can_bridges.uplink`).
+    """
+
+    def __init__(self, resolution_ns: int = DEFAULT_RESOLUTION_NS):
+        self.resolution_ns = int(resolution_ns)
+        self._rate = 1e9 / self.resolution_ns
+        self._streams: Dict[Tuple[str, int], _Stream] = {}
+        self.frames = 0
+
+    def add(self, timestamp: float, can_id: int, data: bytes, flags: int = 0, channel: str = "") -> None:
+        """Append one frame, as :meth:`CompactLogWriter.add`."""
+
+        stream = self._streams.get((channel, can_id))
+        if stream is None:
+            stream = self._streams[(channel, can_id)] = _Stream()
+        stream.ticks.append(round(timestamp * self._rate))
+        stream.data.append(bytes(data))
+        stream.flags.append(flags)
+        self.frames += 1
+
+    def encode(self, level: int = 6) -> bytes:
+        """The chunk of every frame added since the last call, then start an empty one; b"" when empty."""
+
+        if not self.frames:
+            return b""
+        chunk = encode_chunk(self._streams, level)
+        self._streams = {}
+        self.frames = 0
+        return chunk
+
+
+class CompactLogWriter:
+    """Writes frames to a ``.tdlog`` file, one chunk per ``chunk_frames`` frames.
+
+    :meth:`add` and :meth:`add_raw` only append to the open chunk's lists;
+    the encoding and compression happen once per chunk, and the index once
+    per file. ``max_bytes`` rotates to ``<stem>_#001.tdlog``, ``_#002``, ...
+    after the chunk that crosses it. ``channel`` is the name of frames added without one.
+    """
+
+    def __init__(self, path: Path | str, channel: str = "", resolution_ns: int = DEFAULT_RESOLUTION_NS,
+                 chunk_frames: int = DEFAULT_CHUNK_FRAMES, chunk_s: float = DEFAULT_CHUNK_S,
+                 compression_level: int = 6, max_bytes: int = 0):
+        self.path = Path(path)
+        self.channel = channel
+        self.resolution_ns = int(resolution_ns)
+        self.chunk_frames = int(chunk_frames)
+        self.chunk_s = float(chunk_s)
+        self.compression_level = int(compression_level)
+        self.max_bytes = int(max_bytes)
+        self.rollover_count = 0
+        self.frames = 0        # written to the file, over all rotations
+        self.bytes_written = 0
+        self._rate = 1e9 / self.resolution_ns  # ticks per second
+        self._streams: Dict[Tuple[str, int], _Stream] = {}
+        self._pending = 0
+        self._opened = 0.0     # monotonic time of the open chunk's first frame
+        self._file = self._open(self.path)
+
+    def add(self, timestamp: float, can_id: int, data: bytes, flags: int = 0, channel: Optional[str] = None) -> None:
+        """Append one frame; ``flags`` as ``canfd_frame.flags`` plus :data:`FLAG_FD`."""
+
+        key = (self.channel if channel is None else channel, can_id)
+        stream = self._streams.get(key)
+        if stream is None:
+            stream = self._streams[key] = _Stream()
+        stream.ticks.append(round(timestamp * self._rate))
+        stream.data.append(bytes(data))
+        stream.flags.append(flags)
+        if not self._pending:
+            self._opened = time.monotonic()
+        self._pending += 1
+        if self._pending >= self.chunk_frames:
+            self.flush()
+
+    def add_raw(self, timestamp: float, frame: Any, channel: Optional[str] = None) -> None:
+        """Append a recorder ring entry: ``struct can_frame``/``canfd_frame`` bytes or a ``can.Message``."""
+
+        if not isinstance(frame, (bytes, bytearray, memoryview)):
+            self.on_message_received(frame)
+            return
+        can_id, length, flags = _FRAME_HEAD.unpack_from(frame)
+        fd = len(frame) > CAN_MTU
+        if can_id & CAN_RTR_FLAG:
+            data = bytes(length)
+        else:
+            data = frame[8:8 + length]
+        self.add(timestamp, can_id, data, (flags | FLAG_FD) if fd else 0, channel)
+
+    def on_message_received(self, msg) -> None:
+        """python-can ``Listener`` interface."""
+
+        if msg.is_error_frame:
+            can_id = CAN_ERR_FLAG | msg.arbitration_id
+        else:
+            can_id = msg.arbitration_id | (CAN_EFF_FLAG if msg.is_extended_id else 0)
+        data = msg.data
+        if msg.is_remote_frame:
+            can_id |= CAN_RTR_FLAG
+            data = bytes(msg.dlc)
+        flags = 0
+        if msg.is_fd:
+            flags = FLAG_FD | (0x01 if msg.bitrate_switch else 0) | (0x02 if msg.error_state_indicator else 0)
+        self.add(msg.timestamp, can_id, data, flags, None if msg.channel is None else str(msg.channel))
+
+    def flush_stale(self) -> None:
+        """Write the open chunk if its first frame came more than ``chunk_s`` seconds ago."""
+
+        if self._pending and time.monotonic() - self._opened >= self.chunk_s:
+            self.flush()
+
+    def flush(self) -> None:
+        """Write the open chunk, then rotate if the file has reached ``max_bytes``."""
+
+        if not self._pending:
+            return
+        chunk = encode_chunk(self._streams, self.compression_level)
+        self._index.add_chunk(self._file.tell(), [(key, len(s.ticks), s.ticks[0], s.ticks[-1])
+                                                  for key, s in self._streams.items()])
+        self._file.write(chunk)
+        self._file.flush()
+        self.bytes_written += len(chunk)
+        self.frames += self._pending
+        self._streams = {}
+        self._pending = 0
+        if self.max_bytes and self._file.tell() >= self.max_bytes:
+            self._close_file()
+            self.rollover_count += 1
+            name = f"{self.path.stem}_#{self.rollover_count:03}{self.path.suffix}"
+            self._file = self._open(self.path.with_name(name))
+
+    def stop(self) -> None:
+        """Write the open chunk and the index, and close the file (python-can ``Listener`` name)."""
+
+        if self._file.closed:
+            return
+        try:
+            self.flush()
+        finally:
+            self._close_file()
+
+    close = stop
+
+    def __enter__(self) -> "CompactLogWriter":
+        return self
+
+    def __exit__(self, *exc) -> None:
+        self.stop()
+
+    def _open(self, path: Path):
+        handle = open(path, "wb")
+        handle.write(file_header(self.resolution_ns))
+        self.bytes_written += _HEADER.size
+        self._index = _Index()
+        return handle
+
+    def _close_file(self) -> None:
+        try:
+            index = self._index.pack(self._file.tell())
+            self._file.write(index)
+            self.bytes_written += len(index)
+        finally:
+            self._file.close()
+
+
+class ChunkEntry(NamedTuple):
+    offset: int   # of the chunk header in the file
+    first: int    # ticks
+    last: int
+    frames: int
+
+
+class _Index:
+    """The (channel, can_id) table and per-chunk time ranges and ID bitmaps of one file."""
+
+    def __init__(self):
+        self.keys: Dict[Tuple[str, int], int] = {}  # -> position in the ID table
+        self.counts: List[int] = []
+        self.chunks: List[ChunkEntry] = []
+        self.bitmaps: List[int] = []  # bit n: the chunk has a stream of ID table entry n
+
+    def add_chunk(self, offset: int, streams: Iterable[Tuple[Tuple[str, int], int, int, int]]) -> None:
+        bitmap = 0
+        frames = 0
+        first = last = None
+        for key, count, lo, hi in streams:
+            slot = self.keys.get(key)
+            if slot is None:
+                slot = self.keys[key] = len(self.counts)
+                self.counts.append(0)
+            self.counts[slot] += count
+            bitmap |= 1 << slot
+            frames += count
+            first = lo if first is None else min(first, lo)
+            last = hi if last is None else max(last, hi)
+        self.chunks.append(ChunkEntry(offset, first, last, frames))
+        self.bitmaps.append(bitmap)
+
+    def pack(self, offset: int) -> bytes:
+        """Index section and trailer, to be written at ``offset``."""
+
+        channels: Dict[str, int] = {}
+        for channel, _ in self.keys:
+            channels.setdefault(channel, len(channels))
+        names = [name.encode() for name in channels]
+        width = (len(self.keys) + 7) // 8
+        parts = [_INDEX.pack(_INDEX_MAGIC, len(self.chunks), len(self.keys), width), _COUNT16.pack(len(names))]
+        parts += [bytes((len(n),)) + n for n in names]
+        parts += [_INDEX_ID.pack(channels[channel], can_id, self.counts[slot])
+                  for (channel, can_id), slot in self.keys.items()]
+        parts += [_INDEX_CHUNK.pack(*c) for c in self.chunks]
+        parts += [bitmap.to_bytes(width, "little") for bitmap in self.bitmaps]
+        body = b"".join(parts)
+        return body + _TRAILER.pack(offset, len(body), _TRAILER_MAGIC)
+
+
+def build_index(path: Path | str) -> int:
+    """Rewrite the index of a ``.tdlog`` whose writer died: drop any partial chunk, append the index.
+
+    Returns the number of chunks indexed.
+    """
+
+    with CompactLogReader(path, use_index=False) as log:
+        chunks = log.chunk_table()
+        streams = [[((s.channel, s.can_id), s.frames, s.first_tick, s.last_tick) for s in log.directory(c)]
+                   for c in chunks]
+        end = log._end
+    index = _Index()
+    for chunk, entries in zip(chunks, streams):
+        index.add_chunk(chunk.offset, entries)
+    with open(path, "r+b") as handle:
+        handle.truncate(end)
+        handle.seek(end)
+        handle.write(index.pack(end))
+    return len(chunks)
+
+
+Selector = Union[int, Tuple[int, int]]
+
+
+class CompactLogReader:
+    """Reads a ``.tdlog`` file written by :class:`CompactLogWriter`, through ``mmap``.
+
+    A file the writer closed ends with an index: the (channel, can_id) table
+    with frame counts, each chunk's offset and time range, and one bitmap per
+    chunk of the IDs it holds. :meth:`frames` then reads the directories and
+    streams of the chunks that have a selected ID in the time window only.
+    Without an index (the writer was killed; :func:`build_index` adds it) the
+    reader hops from chunk header to chunk header once instead.
+    """
+
+    def __init__(self, path: Path | str, use_index: bool = True):
+        self.path = Path(path)
+        with open(self.path, "rb") as handle:
+            head = handle.read(_HEADER.size)
+            if len(head) < _HEADER.size or _HEADER.unpack(head)[:2] != (MAGIC, VERSION):
+                raise ValueError(f"{self.path} is not a version {VERSION} TritonCAN compact log")
+            self._map = mmap.mmap(handle.fileno(), 0, access=mmap.ACCESS_READ)
+        self.resolution_ns = _HEADER.unpack_from(self._map)[2]
+        self._rate = 1e9 / self.resolution_ns
+        self._chunks: Optional[List[ChunkEntry]] = None
+        self._bitmaps: Optional[List[int]] = None
+        self._keys: Optional[List[Tuple[str, int]]] = None
+        self._counts: List[int] = []
+        self._directories: Dict[int, List[StreamInfo]] = {}
+        self._end = _HEADER.size  # end of the last complete chunk
+        self.indexed = use_index and self._read_index()
+
+    def chunk_table(self) -> List[ChunkEntry]:
+        """Offset, tick range and frame count of every chunk."""
+
+        if self._chunks is None:
+            self._scan()
+        return self._chunks
+
+    def directory(self, chunk: ChunkEntry) -> List[StreamInfo]:
+        """Streams of one chunk."""
+
+        infos = self._directories.get(chunk.offset)
+        if infos is None:
+            _, dir_len, _ = _CHUNK.unpack_from(self._map, chunk.offset)
+            start = chunk.offset + _CHUNK.size
+            infos = self._directories[chunk.offset] = self._directory(self._map[start:start + dir_len],
+                                                                      start + dir_len)
+        return infos
+
+    def chunks(self) -> List[List[StreamInfo]]:
+        """Directory of every chunk."""
+
+        return [self.directory(chunk) for chunk in self.chunk_table()]
+
+    def ids(self) -> Dict[Tuple[str, int], int]:
+        """Frames per (channel, can_id): from the index, or the directories of an unindexed file."""
+
+        if self._keys is None:
+            self._scan()
+        return dict(zip(self._keys, self._counts))
+
+    def time_range(self) -> Tuple[float, float]:
+        """First and last timestamp of the file, seconds."""
+
+        chunks = self.chunk_table()
+        if not chunks:
+            return 0.0, 0.0
+        return min(c.first for c in chunks) / self._rate, max(c.last for c in chunks) / self._rate
+
+    def frames(self, ids: Optional[Iterable[Selector]] = None, channels: Optional[Iterable[str]] = None,
+               start: Optional[float] = None, end: Optional[float] = None) -> Iterator[LogFrame]:
+        """Frames in timestamp order within each chunk, of selected IDs and channels in a time window.
+
+        An ``ids`` entry is a ``can_id`` or an ``(can_id, mask)`` pair that
+        matches every ID with the same bits under ``mask``. Only the streams
+        that match are read and inflated.
+        """
+
+        keys = self._select(ids, channels)
+        chunks = self.chunk_table()
+        if keys is None:
+            wanted = None
+            candidates = range(len(chunks))
+        else:
+            wanted = set(keys)
+            if not wanted:
+                return
+            mask = 0
+            for slot, key in enumerate(self._keys):
+                if key in wanted:
+                    mask |= 1 << slot
+            candidates = [i for i, bitmap in enumerate(self._bitmaps) if bitmap & mask]
+        lo = None if start is None else start * self._rate
+        hi = None if end is None else end * self._rate
+        for i in candidates:
+            chunk = chunks[i]
+            if (lo is not None and chunk.last < lo) or (hi is not None and chunk.first > hi):
+                continue
+            selected = [info for info in self.directory(chunk)
+                        if (wanted is None or (info.channel, info.can_id) in wanted)
+                        and (lo is None or info.last_tick >= lo) and (hi is None or info.first_tick <= hi)]
+            if not selected:
+                continue
+            streams = [self._frames(info) for info in selected]
+            merged = streams[0] if len(streams) == 1 else heapq.merge(*streams, key=lambda f: f.timestamp)
+            for frame in merged:
+                if (start is None or frame.timestamp >= start) and (end is None or frame.timestamp <= end):
+                    yield frame
+
+    def close(self) -> None:
+        self._map.close()
+
+    def __enter__(self) -> "CompactLogReader":
+        return self
+
+    def __exit__(self, *exc) -> None:
+        self.close()
+
+    def __iter__(self) -> Iterator[LogFrame]:
+        return self.frames()
+
+    def _select(self, ids: Optional[Iterable[Selector]], channels: Optional[Iterable[str]]):
+        """(channel, can_id) keys of the ID table that match, None for all of them."""
+
+        if ids is None and channels is None:
+            return None
+        if self._keys is None:
+            self._scan()
+        exact = set()
+        masked = []
+        for selector in ids or ():
+            if isinstance(selector, tuple):
+                masked.append((selector[0] & selector[1], selector[1]))
+            else:
+                exact.add(selector)
+        wanted_channels = None if channels is None else set(channels)
+        return [key for key in self._keys
+                if (wanted_channels is None or key[0] in wanted_channels)
+                and (ids is None or key[1] in exact or any(key[1] & m == v for v, m in masked))]
+
+    def _read_index(self) -> bool:
+        size = len(self._map)
+        if size < _HEADER.size + _TRAILER.size:
+            return False
+        offset, length, magic = _TRAILER.unpack_from(self._map, size - _TRAILER.size)
+        if magic != _TRAILER_MAGIC or offset + length + _TRAILER.size != size or length < _INDEX.size:
+            return False
+        magic, n_chunks, n_ids, width = _INDEX.unpack_from(self._map, offset)
+        if magic != _INDEX_MAGIC:
+            return False
+        pos = offset + _INDEX.size
+        (n_channels,) = _COUNT16.unpack_from(self._map, pos)
+        pos += _COUNT16.size
+        names = []
+        for _ in range(n_channels):
+            n = self._map[pos]
+            names.append(self._map[pos + 1:pos + 1 + n].decode())
+            pos += 1 + n
+        self._keys = []
+        self._counts = []
+        for channel, can_id, count in _INDEX_ID.iter_unpack(self._map[pos:pos + n_ids * _INDEX_ID.size]):
+            self._keys.append((names[channel], can_id))
+            self._counts.append(count)
+        pos += n_ids * _INDEX_ID.size
+        self._chunks = [ChunkEntry(*c) for c in _INDEX_CHUNK.iter_unpack(
+            self._map[pos:pos + n_chunks * _INDEX_CHUNK.size])]
+        pos += n_chunks * _INDEX_CHUNK.size
+        self._bitmaps = [int.from_bytes(self._map[p:p + width], "little")
+                         for p in range(pos, pos + n_chunks * width, width)]
+        self._end = offset
+        return True
+
+    def _scan(self) -> None:
+        """Chunk table, ID table and bitmaps by hopping from chunk header to chunk header."""
+
+        index = _Index()
+        size = len(self._map)
+        offset = _HEADER.size
+        while offset + _CHUNK.size <= size:
+            magic, dir_len, body_len = _CHUNK.unpack_from(self._map, offset)
+            body = offset + _CHUNK.size + dir_len
+            if magic != _CHUNK_MAGIC or body + body_len > size:
+                break  # the index, or cut short by a crash: everything before it is intact
+            infos = self._directories[offset] = self._directory(self._map[offset + _CHUNK.size:body], body)
+            index.add_chunk(offset, [((s.channel, s.can_id), s.frames, s.first_tick, s.last_tick) for s in infos])
+            offset = body + body_len
+        self._end = offset
+        self._chunks = index.chunks
+        self._bitmaps = index.bitmaps
+        self._keys = list(index.keys)
+        self._counts = index.counts
+
+    def _directory(self, raw: bytes, body: int) -> List[StreamInfo]:
+        (n_channels,) = _COUNT16.unpack_from(raw, 0)
+        pos = _COUNT16.size
+        names = []
+        for _ in range(n_channels):
+            n = raw[pos]
+            names.append(raw[pos + 1:pos + 1 + n].decode())
+            pos += 1 + n
+        (n_streams,) = _COUNT32.unpack_from(raw, pos)
+        pos += _COUNT32.size
+        infos = []
+        for channel, can_id, frames, first, last, size, width in _STREAM.iter_unpack(
+                raw[pos:pos + n_streams * _STREAM.size]):
+            infos.append(StreamInfo(names[channel], can_id, frames, first / self._rate, last / self._rate,
+                                    body, size, width, first, last))
+            body += size
+        return infos
+
+    def _frames(self, info: StreamInfo) -> Iterator[LogFrame]:
+        ticks, data, flags = _decode(self._map[info.offset:info.offset + info.size], info.frames, info.width,
+                                     info.first_tick)
+        rate = self._rate
+        channel = info.channel
+        can_id = info.can_id
+        for tick, payload, flag in zip(ticks, data, flags):
+            yield LogFrame(tick / rate, channel, can_id, payload, bool(flag & FLAG_FD), flag & ~FLAG_FD)
+
+
+_PREDICATE = re.compile(r"^\s*([\w.]+)\s*(==|!=|<=|>=|<|>)\s*(\S+)\s*$")
+
+
+def signal_filter(db, expressions: Iterable[str]) -> Tuple[List[int], Callable[[LogFrame], bool]]:
+    """IDs and frame test of ``Signal op value`` predicates, all of which must hold.
+
+    ``db`` is a cantools database; a signal is ``name`` or ``Message.name``
+    and ``op`` one of ``== != < <= > >=``. The IDs are those of the messages
+    that have every signal, for :meth:`CompactLogReader.frames`. A value
+    that is not a number compares with the signal's choice name.
+    """
+
+    predicates = []
+    for text in expressions:
+        match = _PREDICATE.match(text)
+        if match is None:
+            raise ValueError(f"predicate must be 'signal op value', got '{text}'")
+        name, op, value = match.groups()
+        message, _, signal = name.rpartition(".")
+        try:
+            number: Any = float(value)
+        except ValueError:
+            number = None
+        predicates.append((message, signal, _OPS[op], value if number is None else number))
+    candidates = {}
+    for msg in db.messages:
+        signals = {s.name for s in msg.signals}
+        if all(signal in signals and message in ("", msg.name) for message, signal, _, _ in predicates):
+            candidates[msg.frame_id | (CAN_EFF_FLAG if msg.is_extended_frame else 0)] = msg
+    if not candidates:
+        raise ValueError(f"no DBC message has every signal of {list(expressions)}")
+
+    def test(frame: LogFrame) -> bool:
+        msg = candidates.get(frame.can_id)
+        if msg is None:
+            return False
+        try:
+            values = msg.decode(frame.data, decode_choices=True, allow_truncated=True)
+        except Exception:
+            return False
+        for _, signal, op, value in predicates:
+            decoded = values.get(signal)
+            if decoded is None:  # multiplexed out of this frame
+                return False
+            if isinstance(value, float):
+                decoded = getattr(decoded, "value", decoded)
+                if isinstance(decoded, str) or not op(decoded, value):
+                    return False
+            elif not op(str(decoded), value):
+                return False
+        return True
+
+    return list(candidates), test
+
+
+_OPS: Dict[str, Callable[[Any, Any], bool]] = {
+    "==": operator.eq, "!=": operator.ne, "<": operator.lt, "<=": operator.le, ">": operator.gt, ">=": operator.ge,
+}
+
+
+def read_compact(path: Path | str) -> Iterator[LogFrame]:
+    """Every frame of a ``.tdlog`` file, in timestamp order per chunk."""
+
+    with CompactLogReader(path) as log:
+        yield from log.frames()
+
+
+__all__ = ["ChunkBuilder", "ChunkEntry", "CompactLogReader", "CompactLogWriter", "DEFAULT_CHUNK_FRAMES",
+           "DEFAULT_CHUNK_S", "DEFAULT_RESOLUTION_NS", "FLAG_FD", "MAGIC", "SUFFIX", "StreamInfo", "VERSION",
+           "build_index", "encode_chunk", "file_header", "read_compact", "signal_filter"]
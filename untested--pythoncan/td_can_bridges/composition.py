@@ -0,0 +1,96 @@
+"""Launch descriptions of the C++ bridge as components, for the launch files.
+
+:func:`bridge_components` describes one ``td_can_bridge::BridgeComponent``
+per bus of a config, and :func:`consumer_components` the nodes to load next
+to them, from a YAML list::
+
+    - package: my_controllers
+      plugin: my_controllers::Controller
+      name: controller            # optional, the plugin's node name otherwise
+      parameters: { gain: 2.0 }   # optional
+
+:func:`container` puts them all in one ``component_container_mt``. Every
+component gets ``use_intra_process_comms``, so messages between nodes of the
+container pass as pointers without going through DDS.
+"""
+
+from __future__ import annotations
+
+from pathlib import Path
+from typing import Iterable, List, Optional
+
+import yaml
+
+from .service import load_bridge_config
+
+CONTAINER_NAME = "td_can_container"
+
+
+def _intra(on: bool = True):
+    return [{"use_intra_process_comms": on}]
+
+
+def bridge_components(cfg: str, buses: Optional[Iterable[str]] = None, loaned: bool = False,
+                      prefix: str = "td_can_bridge_"):
+    """A ``BridgeComponent`` per bus of ``cfg`` (all of them without ``buses``), named ``<prefix><bus>``."""
+
+    from launch_ros.descriptions import ComposableNode
+
+    names = [bus.name for bus in load_bridge_config(cfg).buses]
+    if buses is not None:
+        buses = list(buses)
+        unknown = sorted(set(buses) - set(names))
+        if unknown:
+            raise RuntimeError(f"buses {unknown} are not in {cfg}")
+        names = buses
+    return [
+        ComposableNode(
+            package="td_can_bridge_cpp",
+            plugin="td_can_bridge::BridgeComponent",
+            name=f"{prefix}{name}",
+            parameters=[{"config": cfg, "bus": name, "loaned_messages": loaned}],
+            # A loaned message skips intra-process delivery, so the two are exclusive
+            extra_arguments=_intra(not loaned),
+        )
+        for name in names
+    ]
+
+
+def consumer_components(path: str) -> List:
+    """The components listed in the YAML file ``path``; none for an empty path."""
+
+    from launch_ros.descriptions import ComposableNode
+
+    if not path:
+        return []
+    entries = yaml.safe_load(Path(path).read_text()) or []
+    if not isinstance(entries, list):
+        raise RuntimeError(f"{path} must hold a list of {{package, plugin}} entries")
+    nodes = []
+    for i, entry in enumerate(entries):
+        missing = [key for key in ("package", "plugin") if key not in entry]
+        if missing:
+            raise RuntimeError(f"{path}[{i}] is missing {missing}")
+        extra = {"name": entry["name"]} if entry.get("name") else {}
+        nodes.append(ComposableNode(package=entry["package"], plugin=entry["plugin"],
+                                    parameters=[entry.get("parameters") or {}],
+                                    extra_arguments=_intra(), **extra))
+    return nodes
+
+
+def container(nodes: List, name: str = CONTAINER_NAME):
+    """A multi-threaded component container loading ``nodes``."""
+
+    from launch_ros.actions import ComposableNodeContainer
+
+    return ComposableNodeContainer(
+        package="rclcpp_components",
+        executable="component_container_mt",
+        name=name,
+        namespace="",
+        output="screen",
+        composable_node_descriptions=nodes,
+    )
+
+
+__all__ = ["CONTAINER_NAME", "bridge_components", "consumer_components", "container"]
@@ -0,0 +1,195 @@
+"""C++ headers with one compile-time specialised decoder per DBC message.
+
+The C++ bridge and the ros2_control plugin decode through ``RxCore``, which
+walks a table of signal specs per frame. :func:`render_header` writes the same
+layout (:func:`td_can_bridges.decoders.native_layout`) as code instead: one
+struct per DBC message, named by :func:`ros_msgs.type_name`, with a field per
+signal and an inline ``decode(const uint8_t *)``. Each signal is one call of
+the templates in ``td_can_bridge_cpp/dbc_decode.hpp`` with its shift and
+length as template arguments, so the compiler sees constants throughout. The
+generated code allocates nothing and has no virtual calls.
+
+Field types follow the Python decoders (:func:`ros_msgs.is_integer`): the raw
+integer for unscaled integer signals, a double otherwise. Signals with choices
+decode to their numbers and get a constant per choice. Messages that
+:func:`native_layout` would hand back raw (multiplexed, over 8 bytes, odd
+float widths) are listed in a comment and get no struct.
+
+A message of a masked device class (:data:`devices.DEVICE_CLASSES`) also gets
+the class's ``id_mask``, ``matches()`` against it and one accessor per ID
+field, so RoboStride feedback yields its motor ID without a lookup. See
+``scripts/dbc_to_cpp.py``.
+"""
+
+from __future__ import annotations
+
+import re
+from typing import Any, Dict, Iterable, List, Mapping, Optional, Tuple
+
+from .decoders import _FLOAT_CODES, _Unsupported, _shift
+from .devices import DEVICE_CLASSES, DeviceClass
+from .ros_msgs import _INT_WIDTHS, field_name, is_integer, type_name, value_constants
+
+INCLUDE = "td_can_bridge_cpp/dbc_decode.hpp"
+
+_MEMBERS = ("frame_id", "extended", "length", "id_mask", "matches", "decode")
+
+
+def namespace_name(text: str) -> str:
+    """C++ namespace of a DBC file: ``motors.dbc`` -> ``motors``."""
+
+    name = re.sub(r"[^0-9a-z]+", "_", text.lower()).strip("_")
+    return name if name and name[0].isalpha() else "dbc_" + name
+
+
+def cpp_type(signal) -> str:
+    """C++ type of the decoded value of ``signal``."""
+
+    if not is_integer(signal):
+        return "double"
+    width = next((w for w in _INT_WIDTHS if signal.length <= w), 64)
+    return f"int{width}_t" if signal.is_signed else f"uint{width}_t"
+
+
+def _literal(value: float) -> str:
+    text = repr(float(value))  # shortest round trip: the C++ parser reads back the same double
+    return text if any(c in text for c in ".en") else text + ".0"
+
+
+def unsupported(msg_def) -> Optional[str]:
+    """Why ``msg_def`` gets no struct, or None."""
+
+    if msg_def.is_multiplexed():
+        return "multiplexed"
+    if msg_def.length > 8:
+        return f"{msg_def.length} bytes"
+    for signal in msg_def.signals:
+        if signal.is_float and signal.length not in _FLOAT_CODES:
+            return f"{signal.name} is a {signal.length}-bit float"
+        try:
+            shift = _shift(signal, msg_def.length)
+        except _Unsupported as exc:
+            return str(exc)
+        if shift + signal.length > 8 * msg_def.length:
+            return f"signal {signal.name} runs past the payload"
+    return None
+
+
+def _device(msg_def, devices: Mapping[str, DeviceClass]) -> Optional[Tuple[str, DeviceClass]]:
+    for name, cls in devices.items():
+        if cls.masked and msg_def.name in cls.messages:
+            return name, cls
+    return None
+
+
+def render_struct(msg_def, devices: Mapping[str, DeviceClass] = DEVICE_CLASSES) -> str:
+    """C++ struct of one supported DBC message."""
+
+    name = type_name(msg_def.name)
+    length = msg_def.length
+    device = _device(msg_def, devices)
+    taken = set(_MEMBERS) | ({field_name(n) for n in device[1].id_fields} if device else set())
+    for signal in msg_def.signals:
+        if field_name(signal.name) in taken:
+            raise ValueError(f"{msg_def.name}.{signal.name}: field {field_name(signal.name)} clashes "
+                             f"with a member of the generated struct")
+    flag = "extended" if msg_def.is_extended_frame else "standard"
+    lines = [f"// {msg_def.name}: 0x{msg_def.frame_id:X} ({flag}), {length} bytes",
+             f"struct {name} {{",
+             f"    static constexpr uint32_t frame_id = 0x{msg_def.frame_id:X};",
+             f"    static constexpr bool extended = {'true' if msg_def.is_extended_frame else 'false'};",
+             f"    static constexpr uint8_t length = {length};"]
+    if device is not None:
+        cls_name, cls = device
+        lines += [f"    static constexpr uint32_t id_mask = 0x{cls.id_mask:X};  // device class {cls_name}",
+                  "",
+                  "    static constexpr bool matches(uint32_t can_id) noexcept",
+                  "    {",
+                  "        return (can_id & id_mask) == (frame_id & id_mask);",
+                  "    }"]
+        for id_name, (low, high) in cls.id_fields.items():
+            lines += [f"    static constexpr uint32_t {field_name(id_name)}(uint32_t can_id) noexcept",
+                      "    {",
+                      f"        return dbc::id_field<{int(low)}, {int(high)}>(can_id);",
+                      "    }"]
+    else:
+        lines += ["",
+                  "    static constexpr bool matches(uint32_t can_id) noexcept { return can_id == frame_id; }"]
+    lines.append("")
+
+    for signal in msg_def.signals:
+        kind = cpp_type(signal)
+        if is_integer(signal):
+            for constant, value in value_constants(signal):
+                lines.append(f"    static constexpr {kind} {field_name(signal.name).upper()}_{constant} = {value};")
+        unit = f"  // {signal.unit}" if getattr(signal, "unit", None) else ""
+        lines.append(f"    {kind} {field_name(signal.name)};{unit}")
+    lines.append("")
+
+    orders = {s.byte_order for s in msg_def.signals}
+    lines += [f"    static {name} decode(const uint8_t *data) noexcept",
+              "    {"]
+    if "little_endian" in orders:
+        lines.append(f"        const uint64_t le = dbc::load_le<{length}>(data);")
+    if "big_endian" in orders:
+        lines.append(f"        const uint64_t be = dbc::load_be<{length}>(data);")
+    if not orders:
+        lines.append("        (void)data;")
+    lines.append(f"        {name} m{{}};")
+    for signal in msg_def.signals:
+        word = "le" if signal.byte_order == "little_endian" else "be"
+        pos = f"{_shift(signal, length)}, {signal.length}"
+        target = f"m.{field_name(signal.name)}"
+        if signal.is_float:
+            value = f"dbc::ieee<{pos}>({word}, {_literal(signal.scale)}, {_literal(signal.offset)})"
+        elif is_integer(signal):
+            value = (f"{cpp_type(signal)}(dbc::sbits<{pos}>({word}))" if signal.is_signed
+                     else f"{cpp_type(signal)}(dbc::bits<{pos}>({word}))")
+        else:
+            signed = "true" if signal.is_signed else "false"
+            value = f"dbc::scaled<{pos}, {signed}>({word}, {_literal(signal.scale)}, {_literal(signal.offset)})"
+        lines.append(f"        {target} = {value};")
+    lines += ["        return m;",
+              "    }",
+              "};"]
+    return "\n".join(lines) + "\n"
+
+
+def render_header(messages: Iterable[Any], namespace: str, source: str,
+                  devices: Mapping[str, DeviceClass] = DEVICE_CLASSES) -> str:
+    """Header text for ``messages``, in ``td_can_bridge::<namespace>``."""
+
+    structs: List[str] = []
+    skipped: List[str] = []
+    for msg_def in messages:
+        why = unsupported(msg_def)
+        if why is None:
+            structs.append(render_struct(msg_def, devices))
+        else:
+            skipped.append(f"//   {msg_def.name}: {why}")
+    head = [f"// Generated by scripts/dbc_to_cpp.py from {source}; do not edit.",
+            "#pragma once",
+            "#include <cstdint>",
+            "",
+            f'#include "{INCLUDE}"',
+            ""]
+    if skipped:
+        head += ["// Not generated (decode these with RxCore or the Python bridge):"] + skipped + [""]
+    head += [f"namespace td_can_bridge::{namespace} {{", ""]
+    return "\n".join(head) + "\n" + "\n".join(structs) + f"\n}} // namespace td_can_bridge::{namespace}\n"
+
+
+def render_headers(databases: Iterable[Tuple[str, Iterable[Any]]],
+                   devices: Mapping[str, DeviceClass] = DEVICE_CLASSES) -> Dict[str, str]:
+    """File name -> header text, one header per ``(DBC path, messages)``."""
+
+    files: Dict[str, str] = {}
+    for path, messages in databases:
+        stem = re.split(r"[\\/]", str(path))[-1].rsplit(".", 1)[0]
+        namespace = namespace_name(stem)
+        files[f"{namespace}.hpp"] = render_header(messages, namespace, stem + ".dbc", devices)
+    return files
+
+
+__all__ = ["INCLUDE", "cpp_type", "namespace_name", "render_header", "render_headers", "render_struct",
+           "unsupported"]
@@ -0,0 +1,362 @@
+"""Live browser dashboard of signal stores, pushed as binary columns over a WebSocket.
+
+:class:`DashboardServer` reads one or more :mod:`td_can_bridges.signal_store`
+files in a process of its own and serves a page that plots every signal.
+``rate_hz`` times a second it folds what each signal did since the last tick
+into one min/max bucket, then packs all the buckets into one binary frame.
+Every viewer is sent the same bytes, so the cost per tick is the store reads
+and one encode, whatever the number of viewers or the signals' rates.
+
+* With ``history`` rings (``signal_store: {history: 4096}``) the bucket
+  covers every update of the tick, so a spike between two ticks still shows.
+  Without, it holds the value read at the tick.
+* A text frame of JSON, ``{"signals": [...], "rate_hz": ...}``, opens each
+  connection and follows any change of the signal list (a store that
+  was replaced, or appeared). Names are ``<bus>/<Message.signal>``.
+* Binary frames, little-endian: ``u32 tick, f64 time, u32 count``, then
+  ``count`` values each of ``f32 min``, ``f32 max``, ``f32 last`` and
+  ``u16 updates``, one column after another. min and max are NaN for a signal
+  that had no update in the tick. last is NaN before its first update.
+* A viewer whose socket still holds ``max_buffer`` bytes skips ticks rather
+  than letting the server queue them for it; the skips are counted.
+
+It needs nothing outside the standard library, and only serves ``GET /``
+(the page) and ``GET /ws`` (the stream)::
+
+    server = DashboardServer([default_path("motor_bus")], port=8765, rate_hz=10)
+    asyncio.run(server.serve())
+"""
+
+from __future__ import annotations
+
+import array
+import asyncio
+import base64
+import hashlib
+import json
+import logging
+import math
+import struct
+import time
+from pathlib import Path
+from typing import Dict, Iterable, List, Optional, Set, Tuple
+
+from .signal_store import SignalStoreReader
+
+LOG = logging.getLogger(__name__)
+
+DEFAULT_PORT = 8765
+DEFAULT_RATE_HZ = 10.0
+DEFAULT_MAX_BUFFER = 1 << 20
+_WS_GUID = b"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+_TICK = struct.Struct("<IdI")
+_OP_TEXT, _OP_BINARY, _OP_CLOSE, _OP_PING, _OP_PONG = 0x1, 0x2, 0x8, 0x9, 0xA
+
+NAN = math.nan
+
+
+class _Source:
+    """One store file, reopened when the service replaces it."""
+
+    def __init__(self, path: Path, match: str):
+        self.path = Path(path)
+        self.match = match
+        self.reader: Optional[SignalStoreReader] = None
+        self.names: List[str] = []
+        self.cursors: List[int] = []
+        self.updates: List[int] = []
+
+    def open(self) -> bool:
+        """Open or reopen the file if needed; True when the signal list changed."""
+
+        if self.reader is not None and not self.reader.replaced():
+            return False
+        if self.reader is not None:
+            self.reader.close()
+            self.reader = None
+        try:
+            reader = SignalStoreReader(self.path)
+        except (FileNotFoundError, ValueError):
+            changed = bool(self.names)
+            self.names = []
+            return changed
+        self.reader = reader
+        self.names = [name for name in reader.signals if self.match in name]
+        self.cursors = [0] * len(self.names)
+        self.updates = [0] * len(self.names)
+        return True
+
+    def fold(self, lows, highs, lasts, counts) -> None:
+        """Append this tick's bucket of every signal to the columns."""
+
+        reader = self.reader
+        for i, name in enumerate(self.names):
+            if reader.depth:
+                samples, cursor = reader.history(name, self.cursors[i])
+                count = cursor - self.cursors[i]
+                self.cursors[i] = cursor
+                if samples:
+                    values = [value for _, value in samples]
+                    lows.append(min(values))
+                    highs.append(max(values))
+                    lasts.append(values[-1])
+                    counts.append(min(count, 0xFFFF))
+                    continue
+            entry = reader.read(name)
+            value, updates = (NAN, 0) if entry is None else (entry[0], entry[2])
+            # Without a ring, a bucket is the value read now, if it changed since the last tick
+            count = 0 if reader.depth else updates - self.updates[i]
+            self.updates[i] = updates
+            lows.append(value if count > 0 else NAN)
+            highs.append(value if count > 0 else NAN)
+            lasts.append(value)
+            counts.append(min(count, 0xFFFF))
+
+    def close(self) -> None:
+        if self.reader is not None:
+            self.reader.close()
+            self.reader = None
+
+
+class _Viewer:
+    __slots__ = ("writer", "skipped")
+
+    def __init__(self, writer: asyncio.StreamWriter):
+        self.writer = writer
+        self.skipped = 0
+
+
+class DashboardServer:
+    """Serves the dashboard page and one shared tick stream over every store in ``paths``."""
+
+    def __init__(self, paths: Iterable[Path], host: str = "", port: int = DEFAULT_PORT,
+                 rate_hz: float = DEFAULT_RATE_HZ, match: str = "", max_buffer: int = DEFAULT_MAX_BUFFER):
+        if rate_hz <= 0:
+            raise ValueError("rate_hz must be positive")
+        self.host = host
+        self.port = port
+        self.rate_hz = rate_hz
+        self.max_buffer = max_buffer
+        self._sources = [_Source(path, match) for path in paths]
+        self._viewers: Set[_Viewer] = set()
+        self._schema = b""
+        self.ticks = 0
+        self.skipped = 0      # ticks not sent to a slow viewer
+        self.encode_us = 0.0  # mean time of the store reads and the encode per tick
+
+    async def serve(self) -> None:
+        server = await asyncio.start_server(self._client, self.host or None, self.port)
+        LOG.info("dashboard on http://%s:%d/ at %g Hz", self.host or "0.0.0.0", self.port, self.rate_hz)
+        async with server:
+            await self._ticks()
+
+    def stats(self) -> Dict[str, float]:
+        return {"viewers": len(self._viewers), "ticks": self.ticks, "skipped": self.skipped,
+                "encode_us_mean": self.encode_us}
+
+    # ------------------------------------------------------------------
+    # Ticks
+
+    def tick(self) -> bytes:
+        """Read every store and encode one binary update; refreshes the schema first if needed."""
+
+        changed = False
+        for source in self._sources:
+            changed |= source.open()
+        if changed or not self._schema:
+            names = [f"{s.reader.bus}/{name}" for s in self._sources if s.reader is not None for name in s.names]
+            self._schema = _frame(_OP_TEXT, json.dumps({"signals": names, "rate_hz": self.rate_hz}).encode())
+            self._broadcast(self._schema, always=True)
+        lows, highs, lasts = array.array("f"), array.array("f"), array.array("f")
+        counts = array.array("H")
+        for source in self._sources:
+            if source.reader is not None:
+                source.fold(lows, highs, lasts, counts)
+        self.ticks += 1
+        payload = b"".join((_TICK.pack(self.ticks, time.time(), len(lasts)), lows.tobytes(), highs.tobytes(),
+                            lasts.tobytes(), counts.tobytes()))
+        return _frame(_OP_BINARY, payload)
+
+    async def _ticks(self) -> None:
+        period = 1.0 / self.rate_hz
+        deadline = time.monotonic()
+        spent = 0.0
+        try:
+            while True:
+                start = time.monotonic()
+                frame = self.tick()
+                spent += time.monotonic() - start
+                self.encode_us = spent / self.ticks * 1e6
+                self._broadcast(frame)
+                deadline = max(deadline + period, time.monotonic())
+                await asyncio.sleep(deadline - time.monotonic())
+        finally:
+            for source in self._sources:
+                source.close()
+
+    def _broadcast(self, frame: bytes, always: bool = False) -> None:
+        """Write ``frame`` to every viewer; ``always`` for the schema, which no viewer may miss."""
+
+        for viewer in list(self._viewers):
+            transport = viewer.writer.transport
+            if transport.is_closing():
+                self._viewers.discard(viewer)
+            elif not always and transport.get_write_buffer_size() > self.max_buffer:
+                viewer.skipped += 1
+                self.skipped += 1
+            else:
+                viewer.writer.write(frame)
+
+    # ------------------------------------------------------------------
+    # HTTP and WebSocket
+
+    async def _client(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter) -> None:
+        try:
+            head = await reader.readuntil(b"\r\n\r\n")
+            lines = head.decode("latin-1").split("\r\n")
+            method, path = (lines[0].split(" ") + ["", ""])[:2]
+            headers = {k.strip().lower(): v.strip() for k, _, v in (line.partition(":") for line in lines[1:] if line)}
+            if method != "GET":
+                writer.write(b"HTTP/1.1 405 Method Not Allowed\r\nContent-Length: 0\r\n\r\n")
+            elif path == "/ws" and "websocket" in headers.get("upgrade", "").lower():
+                await self._stream(reader, writer, headers.get("sec-websocket-key", ""))
+                return
+            elif path in ("/", "/index.html"):
+                body = PAGE.encode()
+                writer.write(b"HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\n"
+                             + f"Content-Length: {len(body)}\r\nCache-Control: no-store\r\n\r\n".encode() + body)
+            else:
+                writer.write(b"HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n")
+            await writer.drain()
+        except (asyncio.IncompleteReadError, asyncio.LimitOverrunError, ConnectionError):
+            pass
+        finally:
+            writer.close()
+
+    async def _stream(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter, key: str) -> None:
+        accept = base64.b64encode(hashlib.sha1(key.encode() + _WS_GUID).digest()).decode()
+        writer.write(("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                      f"Sec-WebSocket-Accept: {accept}\r\n\r\n").encode())
+        if self._schema:
+            writer.write(self._schema)
+        viewer = _Viewer(writer)
+        self._viewers.add(viewer)
+        LOG.info("dashboard viewer %s connected (%d)", writer.get_extra_info("peername"), len(self._viewers))
+        try:
+            while True:
+                opcode, data = await _read_frame(reader)
+                if opcode == _OP_CLOSE:
+                    writer.write(_frame(_OP_CLOSE, data[:2]))
+                    break
+                if opcode == _OP_PING:
+                    writer.write(_frame(_OP_PONG, data))
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        finally:
+            self._viewers.discard(viewer)
+            LOG.info("dashboard viewer left, %d skipped tick(s)", viewer.skipped)
+
+
+def _frame(opcode: int, payload: bytes) -> bytes:
+    """An unmasked, unfragmented server frame."""
+
+    length = len(payload)
+    if length < 126:
+        head = struct.pack("!BB", 0x80 | opcode, length)
+    elif length < 1 << 16:
+        head = struct.pack("!BBH", 0x80 | opcode, 126, length)
+    else:
+        head = struct.pack("!BBQ", 0x80 | opcode, 127, length)
+    return head + payload
+
+
+async def _read_frame(reader: asyncio.StreamReader) -> Tuple[int, bytes]:
+    """One client frame, unmasked; clients only send control frames here."""
+
+    first, second = await reader.readexactly(2)
+    length = second & 0x7F
+    if length == 126:
+        length = struct.unpack("!H", await reader.readexactly(2))[0]
+    elif length == 127:
+        length = struct.unpack("!Q", await reader.readexactly(8))[0]
+    if length > 1 << 16:
+        raise ConnectionError("client frame too large")
+    mask = await reader.readexactly(4) if second & 0x80 else b"\0\0\0\0"
+    data = await reader.readexactly(length)
+    return first & 0x0F, bytes(b ^ mask[i % 4] for i, b in enumerate(data))
+
+
+PAGE = """<!doctype html>
+<html><head><meta charset="utf-8"><title>td_can dashboard</title>
+<style>
+body { font: 12px sans-serif; margin: 8px; background: #111; color: #ddd; }
+#status { margin-bottom: 6px; color: #8a8; }
+.cell { display: inline-block; width: 320px; margin: 3px; background: #1b1b1b; }
+.cell div { padding: 2px 4px; white-space: nowrap; overflow: hidden; }
+.cell span { float: right; color: #fc6; }
+canvas { display: block; width: 320px; height: 70px; }
+</style></head>
+<body><div id="status">connecting</div><div id="grid"></div>
+<script>
+const SPAN = 600;                       // buckets kept per signal
+let names = [], traces = [], cells = [], rate = 10, dirty = false;
+function layout(list) {
+  names = list; gridEl.innerHTML = ''; cells = []; traces = [];
+  for (const name of names) {
+    const cell = document.createElement('div'); cell.className = 'cell';
+    cell.innerHTML = '<div><span></span></div><canvas width="320" height="70"></canvas>';
+    cell.firstChild.prepend(name); gridEl.appendChild(cell);
+    cells.push({value: cell.querySelector('span'), ctx: cell.querySelector('canvas').getContext('2d')});
+    traces.push({lo: new Float32Array(SPAN).fill(NaN), hi: new Float32Array(SPAN).fill(NaN), head: 0, last: NaN, hz: 0});
+  }
+}
+function onTick(buf) {
+  const view = new DataView(buf), n = view.getUint32(12, true);
+  if (n !== names.length) return;
+  const lo = new Float32Array(buf, 16, n), hi = new Float32Array(buf, 16 + 4 * n, n);
+  const last = new Float32Array(buf, 16 + 8 * n, n), count = new Uint16Array(buf.slice(16 + 12 * n));
+  for (let i = 0; i < n; i++) {
+    const t = traces[i];
+    t.lo[t.head] = lo[i]; t.hi[t.head] = hi[i]; t.head = (t.head + 1) % SPAN;
+    t.last = last[i]; t.hz = 0.8 * t.hz + 0.2 * count[i] * rate;
+  }
+  dirty = true;
+}
+function draw() {
+  requestAnimationFrame(draw);
+  if (!dirty) return;
+  dirty = false;
+  traces.forEach((t, i) => {
+    const {ctx, value} = cells[i], w = 320, h = 70;
+    let min = Infinity, max = -Infinity;
+    for (let k = 0; k < SPAN; k++) { if (t.lo[k] < min) min = t.lo[k]; if (t.hi[k] > max) max = t.hi[k]; }
+    value.textContent = (isNaN(t.last) ? '-' : t.last.toPrecision(5)) + '  ' + t.hz.toFixed(0) + ' Hz';
+    ctx.clearRect(0, 0, w, h);
+    if (!(max >= min)) return;
+    const scale = max > min ? (h - 4) / (max - min) : 0;
+    ctx.fillStyle = '#6cf';
+    for (let x = 0; x < w; x++) {
+      const k = (t.head + Math.floor(x * SPAN / w)) % SPAN;
+      if (isNaN(t.lo[k])) continue;
+      const top = h - 2 - (t.hi[k] - min) * scale, bottom = h - 2 - (t.lo[k] - min) * scale;
+      ctx.fillRect(x, top, 1, Math.max(1, bottom - top));
+    }
+  });
+}
+function connect() {
+  const ws = new WebSocket((location.protocol === 'https:' ? 'wss://' : 'ws://') + location.host + '/ws');
+  ws.binaryType = 'arraybuffer';
+  ws.onmessage = (e) => {
+    if (typeof e.data === 'string') { const s = JSON.parse(e.data); rate = s.rate_hz; layout(s.signals); }
+    else onTick(e.data);
+  };
+  ws.onopen = () => { statusLine.textContent = 'live'; };
+  ws.onclose = () => { statusLine.textContent = 'disconnected, retrying'; setTimeout(connect, 1000); };
+}
+const gridEl = document.getElementById('grid'), statusLine = document.getElementById('status');
+connect(); requestAnimationFrame(draw);
+</script></body></html>
+"""
+
+
+__all__ = ["DEFAULT_PORT", "DEFAULT_RATE_HZ", "DashboardServer"]
@@ -0,0 +1,257 @@
+"""Specialised DBC message decoders generated at load time.
+
+``cantools`` decodes by walking every signal of a message through a generic
+bit-field interpreter. A receive binding only ever needs a few named signals
+of one fixed layout, so :func:`compile_decoder` writes a small Python
+function for exactly those signals: byte-aligned fields come out of a single
+``struct.Struct`` unpack, the rest out of shifts and masks on the payload as
+one integer, each followed by the signal's constant scale and offset. The
+result is a dict keyed by signal name, the same values ``cantools`` returns
+(choices included).
+
+A multiplexed message gets one such function per multiplexer value, for
+the plain signals and that value's group, and a dispatcher that reads the
+multiplexer and calls the group's function. A value the DBC does not list
+goes to ``msg_def.decode``, as do nested multiplexers, unaligned float
+signals and payloads shorter than the DBC length.
+"""
+
+from __future__ import annotations
+
+import logging
+import struct
+from typing import Any, Callable, Dict, Iterable, List, Optional
+
+LOG = logging.getLogger(__name__)
+
+Decoder = Callable[[bytes], Dict[str, Any]]
+
+_STRUCT_CODES = {8: "b", 16: "h", 32: "i", 64: "q"}
+_FLOAT_CODES = {32: "f", 64: "d"}
+
+
+class _Unsupported(Exception):
+    pass
+
+
+def _byte_span(signal, length: int) -> Optional[tuple[int, int]]:
+    """First byte and byte count when ``signal`` sits on whole bytes."""
+
+    if signal.length not in _STRUCT_CODES:
+        return None
+    if signal.byte_order == "little_endian":
+        if signal.start % 8:
+            return None
+        first = signal.start // 8
+    else:
+        if signal.start % 8 != 7:
+            return None
+        first = signal.start // 8
+    count = signal.length // 8
+    if first + count > length:
+        return None
+    return first, count
+
+
+def _struct_code(signal) -> str:
+    if signal.is_float:
+        return _FLOAT_CODES[signal.length]
+    code = _STRUCT_CODES[signal.length]
+    return code if signal.is_signed else code.upper()
+
+
+def _shift(signal, length: int) -> int:
+    """Right shift that brings the signal's LSB to bit 0 of the payload integer.
+
+    Little-endian payloads are read with ``int.from_bytes(..., "little")``
+    and big-endian (Motorola) ones with ``"big"``; a Motorola start bit names
+    the signal's MSB in the DBC's sawtooth numbering.
+    """
+
+    if signal.byte_order == "little_endian":
+        return signal.start
+    msb = (length - 1 - signal.start // 8) * 8 + signal.start % 8
+    shift = msb - signal.length + 1
+    if shift < 0:
+        raise _Unsupported(f"signal {signal.name} runs past the payload")
+    return shift
+
+
+def _generate(msg_def, signals: List[Any], check_length: bool = True) -> Decoder:
+    length = msg_def.length
+    env: Dict[str, Any] = {"_fallback": msg_def.decode, "_from_bytes": int.from_bytes}
+    body: List[str] = []
+    values: Dict[str, str] = {}
+
+    # One struct for the byte-aligned fields in the majority byte order
+    aligned = [(s, _byte_span(s, length)) for s in signals]
+    aligned = [(s, span) for s, span in aligned if span is not None]
+    little = [a for a in aligned if a[0].byte_order == "little_endian"]
+    big = [a for a in aligned if a[0].byte_order != "little_endian"]
+    group, order = (little, "<") if len(little) >= len(big) else (big, ">")
+    group.sort(key=lambda a: a[1][0])
+    in_struct = []
+    fmt, pos = order, 0
+    for signal, (first, count) in group:
+        if first < pos:
+            continue  # overlaps a field already placed; extract with shifts
+        fmt += "x" * (first - pos) + _struct_code(signal)
+        pos = first + count
+        in_struct.append(signal)
+    if in_struct:
+        env["_unpack"] = struct.Struct(fmt).unpack_from
+        names = [f"v{signals.index(s)}" for s in in_struct]
+        body.append(f"    {', '.join(names)}, = _unpack(data)")
+        for signal, name in zip(in_struct, names):
+            values[signal.name] = name
+
+    words = set()
+    for i, signal in enumerate(signals):
+        if signal.name in values:
+            continue
+        if signal.is_float:
+            raise _Unsupported(f"float signal {signal.name} is not byte-aligned")
+        byteorder = "little" if signal.byte_order == "little_endian" else "big"
+        word = f"_{byteorder}"
+        if byteorder not in words:
+            words.add(byteorder)
+            body.append(f"    {word} = _from_bytes(data[:{length}], {byteorder!r})")
+        name = f"v{i}"
+        body.append(f"    {name} = ({word} >> {_shift(signal, length)}) & {(1 << signal.length) - 1:#x}")
+        if signal.is_signed:
+            body.append(f"    if {name} & {1 << (signal.length - 1):#x}:")
+            body.append(f"        {name} -= {1 << signal.length:#x}")
+        values[signal.name] = name
+
+    items = []
+    for i, signal in enumerate(signals):
+        raw = values[signal.name]
+        if signal.scale == 1 and signal.offset == 0:
+            scaled = raw
+        else:
+            env[f"_scale{i}"] = signal.scale
+            env[f"_offset{i}"] = signal.offset
+            scaled = f"{raw} * _scale{i} + _offset{i}"
+        if signal.choices:
+            env[f"_choices{i}"] = signal.choices
+            scaled = f"(_choices{i}[{raw}] if {raw} in _choices{i} else {scaled})"
+        items.append(f"{signal.name!r}: {scaled}")
+
+    guard = [f"    if len(data) < {length}:", "        return _fallback(data)"] if check_length else []
+    source = "\n".join(
+        ["def decode(data):"] + guard
+        + body
+        + ["    return {" + ", ".join(items) + "}"]
+    )
+    exec(compile(source, f"<decoder {msg_def.name}>", "exec"), env)
+    decode = env["decode"]
+    decode.source = source
+    return decode
+
+
+def _generate_multiplexed(msg_def, wanted: Optional[set]) -> Decoder:
+    """A dispatcher on the multiplexer's raw value to a decoder per group."""
+
+    muxes = [s for s in msg_def.signals if s.is_multiplexer]
+    if len(muxes) != 1 or muxes[0].multiplexer_ids or muxes[0].is_float:
+        raise _Unsupported("nested or float multiplexer")
+    mux = muxes[0]
+    plain, groups = [], {}
+    for signal in msg_def.signals:
+        if signal is mux:
+            continue
+        if not signal.multiplexer_ids:
+            plain.append(signal)
+            continue
+        if signal.multiplexer_signal != mux.name:
+            raise _Unsupported(f"signal {signal.name} is multiplexed by {signal.multiplexer_signal}")
+        for value in signal.multiplexer_ids:
+            groups.setdefault(value, []).append(signal)
+
+    decoders = {}
+    for value, members in groups.items():
+        # The group's signals in DBC order, as cantools returns them
+        ids = {id(s) for s in [mux, *plain, *members] if wanted is None or s.name in wanted}
+        decoders[value] = _generate(msg_def, [s for s in msg_def.signals if id(s) in ids], check_length=False)
+    length = msg_def.length
+    byteorder = "little" if mux.byte_order == "little_endian" else "big"
+    lines = [
+        "def decode(data):",
+        f"    if len(data) < {length}:",
+        "        return _fallback(data)",
+        f"    mux = (_from_bytes(data[:{length}], {byteorder!r}) >> {_shift(mux, length)}) & {(1 << mux.length) - 1:#x}",
+    ]
+    if mux.is_signed:
+        lines += [f"    if mux & {1 << (mux.length - 1):#x}:", f"        mux -= {1 << mux.length:#x}"]
+    lines += [
+        "    group = _groups.get(mux)",
+        "    return _fallback(data) if group is None else group(data)",
+    ]
+    source = "\n".join(lines)
+    env: Dict[str, Any] = {"_fallback": msg_def.decode, "_from_bytes": int.from_bytes, "_groups": decoders}
+    exec(compile(source, f"<decoder {msg_def.name}>", "exec"), env)
+    decode = env["decode"]
+    decode.source = source + "".join(f"\n\n# {mux.name} == {value}\n{d.source}" for value, d in decoders.items())
+    return decode
+
+
+def compile_decoder(msg_def, signal_names: Optional[Iterable[str]] = None) -> Decoder:
+    """Return a decoder for ``signal_names`` of ``msg_def`` (every signal when None).
+
+    Names that are not in the message are left out of the result, so callers
+    reading it with ``dict.get`` see ``None`` exactly as with ``cantools``.
+    Falls back to ``msg_def.decode`` for layouts the generator does not
+    handle. For a multiplexed message only the wanted signals of the
+    active group are decoded; the others are absent, as with ``cantools``.
+    """
+
+    wanted = None if signal_names is None else set(signal_names)
+    signals = [s for s in msg_def.signals if wanted is None or s.name in wanted]
+    try:
+        if msg_def.is_multiplexed():
+            return _generate_multiplexed(msg_def, wanted)
+        return _generate(msg_def, signals)
+    except _Unsupported as exc:
+        LOG.debug("%s: using cantools (%s)", msg_def.name, exc)
+        return msg_def.decode
+
+
+
+def native_layout(msg_def, signal_names: Optional[Iterable[str]] = None):
+    """Signal names and RxCore specs (native/rx_core.hpp) for ``msg_def``.
+
+    Each spec is ``(shift, length, big_endian, is_signed, is_float, as_int,
+    scale, offset)`` against the payload read as one integer, as in
+    :func:`compile_decoder`. Returns None for messages the native core hands
+    back undecoded: multiplexed, longer than 8 bytes, or with choices.
+    """
+
+    if msg_def.is_multiplexed() or msg_def.length > 8:
+        return None
+    wanted = None if signal_names is None else set(signal_names)
+    names, specs = [], []
+    for signal in msg_def.signals:
+        if wanted is not None and signal.name not in wanted:
+            continue
+        if signal.choices or (signal.is_float and signal.length not in _FLOAT_CODES):
+            return None
+        try:
+            shift = _shift(signal, msg_def.length)
+        except _Unsupported:
+            return None
+        as_int = not signal.is_float and signal.scale == 1 and signal.offset == 0
+        names.append(signal.name)
+        specs.append((
+            shift,
+            signal.length,
+            signal.byte_order != "little_endian",
+            bool(signal.is_signed),
+            bool(signal.is_float),
+            as_int,
+            float(signal.scale),
+            float(signal.offset),
+        ))
+    return names, specs
+
+
+__all__ = ["Decoder", "compile_decoder", "native_layout"]
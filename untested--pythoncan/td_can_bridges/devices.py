@@ -0,0 +1,160 @@
+"""Device-level RX bindings: one binding per frame of a device, not one per signal.
+
+A device class lists the DBC messages a device sends, in the order of their
+CAN IDs. :func:`device_bindings` turns one device into one ``publish: frame``
+``rx_frames`` entry per message, so an RS02 costs two decodes and two
+publishes per status pair instead of eight. Classes with ``masked`` set cover
+every device on the bus with a single entry, the device ID taken from the
+frame ID (RobStride feedback).
+
+A bus's ``devices`` entry registers a whole ID range of a class in a few
+lines, and the loader expands it with :func:`expand_devices`::
+
+    devices:
+      legs:                      # device n is legs[n]
+        class: motor_rs02
+        first_id: 0x210          # IDs of device 0, one per frame
+        count: 12
+        id_stride: 2             # between devices (default: frames per device)
+        topic: /td/legs/{index}  # {index} and {can_id} of the device
+      pdbs:
+        class: pdb
+        ids: [0x203, 0x213]      # or the first ID of each device
+      feedback:
+        class: robostride        # masked: no IDs, one entry for every motor
+        topic: /td/rs02
+
+Every other key of a group (``publish_rate_hz``, ``on_change``, ``rate_hz``,
+``queue_size``, ...) is copied to each entry it expands to.
+``scripts/td_can_register.py --bulk`` writes such a group.
+"""
+
+from __future__ import annotations
+
+from dataclasses import dataclass, field
+from typing import Any, Dict, List, Mapping, Optional, Sequence, Tuple
+
+from .ros_msgs import field_name
+
+
+@dataclass(frozen=True)
+class DeviceClass:
+    """The frames one device sends. ``masked`` classes bind every device with one entry per frame."""
+
+    messages: Tuple[str, ...]
+    id_mask: Optional[int] = None
+    id_fields: Mapping[str, Tuple[int, int]] = field(default_factory=dict)
+
+    @property
+    def masked(self) -> bool:
+        return self.id_mask is not None
+
+
+DEVICE_CLASSES: Dict[str, DeviceClass] = {
+    "motor_rs02": DeviceClass(("RS02_Status1", "RS02_Status2")),
+    # Comm type 2 in bits 24-28, motor ID in bits 8-15
+    "robostride": DeviceClass(("RS02_Feedback",), id_mask=0x1F000000, id_fields={"motor_id": (8, 15)}),
+    "foot_sensor": DeviceClass(("FootForce",)),
+    "imu": DeviceClass(("IMU_Data",)),
+    "pdb": DeviceClass(("PDB_Status",)),
+}
+
+_GROUP_KEYS = {"class", "topic", "ids", "first_id", "count", "id_stride"}
+
+
+def _int(value: Any) -> int:
+    return int(value, 0) if isinstance(value, str) else int(value)
+
+
+def device_class(name: str, context: str = "device") -> DeviceClass:
+    if name not in DEVICE_CLASSES:
+        raise ValueError(f"{context}: unknown device class '{name}', expected one of {sorted(DEVICE_CLASSES)}")
+    return DEVICE_CLASSES[name]
+
+
+def device_bindings(
+    class_name: str,
+    key: str,
+    topic_prefix: str,
+    can_ids: Sequence[int] = (),
+    extra: Optional[Mapping[str, Any]] = None,
+) -> Dict[str, Dict[str, Any]]:
+    """``rx_frames`` entries of one device: ``{"<key>.<message>": spec}``, one per frame.
+
+    ``can_ids`` holds one ID per message of the class, and is empty for a
+    masked class. The topic of each frame is ``<topic_prefix>/<message in
+    lower case>``; a masked class puts its ID fields in the topic, as in
+    ``/td/rs02/{motor_id}/rs02_feedback``.
+    """
+
+    cls = device_class(class_name, key)
+    if cls.masked:
+        if can_ids:
+            raise ValueError(f"{key}: class '{class_name}' covers every device, it takes no CAN IDs")
+    elif len(can_ids) != len(cls.messages):
+        raise ValueError(f"{key}: class '{class_name}' sends {len(cls.messages)} frame(s) "
+                         f"({', '.join(cls.messages)}), got {len(can_ids)} CAN ID(s)")
+    prefix = topic_prefix.rstrip("/")
+    if cls.masked:
+        prefix += "".join(f"/{{{name}}}" for name in cls.id_fields)
+    entries: Dict[str, Dict[str, Any]] = {}
+    for i, message in enumerate(cls.messages):
+        spec: Dict[str, Any] = {"dbc_message": message, "topic": f"{prefix}/{field_name(message)}",
+                                "publish": "frame"}
+        if cls.masked:
+            spec["id_mask"] = cls.id_mask
+            spec["id_fields"] = {name: list(bits) for name, bits in cls.id_fields.items()}
+        else:
+            spec["can_id"] = can_ids[i]
+        spec.update(extra or {})
+        entries[f"{key}.{message}"] = spec
+    return entries
+
+
+def group_ids(spec: Mapping[str, Any], frames: int, context: str) -> List[int]:
+    """First CAN ID of each device of a ``devices`` group: ``ids``, or ``first_id`` + ``count``."""
+
+    if "ids" in spec:
+        if "first_id" in spec or "count" in spec:
+            raise ValueError(f"{context}: give either ids or first_id and count, not both")
+        return [_int(i) for i in spec["ids"] or []]
+    if "first_id" not in spec or "count" not in spec:
+        raise ValueError(f"{context}: needs ids, or first_id and count")
+    first, count = _int(spec["first_id"]), int(spec["count"])
+    stride = _int(spec.get("id_stride", frames))
+    if count < 0 or stride < frames:
+        raise ValueError(f"{context}: count must be >= 0 and id_stride >= {frames} (the class's frames), "
+                         f"got {count} and {stride}")
+    return [first + n * stride for n in range(count)]
+
+
+def expand_devices(devices: Any, context: str) -> Dict[str, Dict[str, Any]]:
+    """``rx_frames`` entries of a bus's ``devices`` mapping, in group then device order."""
+
+    if not devices:
+        return {}
+    if not isinstance(devices, Mapping):
+        raise ValueError(f"{context}.devices must be a mapping of group name to {{class: ..., ...}}")
+    entries: Dict[str, Dict[str, Any]] = {}
+    for group, spec in devices.items():
+        where = f"{context}.devices.{group}"
+        if not isinstance(spec, Mapping) or "class" not in spec:
+            raise ValueError(f"{where} must be a mapping with a class")
+        cls = device_class(spec["class"], where)
+        topic = str(spec.get("topic", f"/td/{group}" if cls.masked else f"/td/{group}/{{index}}"))
+        extra = {k: v for k, v in spec.items() if k not in _GROUP_KEYS}
+        if cls.masked:
+            if (_GROUP_KEYS - {"class", "topic"}) & set(spec):
+                raise ValueError(f"{where}: class '{spec['class']}' covers every device, it takes no IDs or count")
+            entries.update(device_bindings(spec["class"], str(group), topic, (), extra))
+            continue
+        frames = len(cls.messages)
+        for index, base in enumerate(group_ids(spec, frames, where)):
+            entries.update(device_bindings(
+                spec["class"], f"{group}[{index}]", topic.format(index=index, can_id=base),
+                [base + i for i in range(frames)], extra,
+            ))
+    return entries
+
+
+__all__ = ["DEVICE_CLASSES", "DeviceClass", "device_bindings", "device_class", "expand_devices", "group_ids"]
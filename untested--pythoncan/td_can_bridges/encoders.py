@@ -0,0 +1,148 @@
+"""Specialised DBC message packers generated at load time.
+
+The transmit counterpart of :mod:`td_can_bridges.decoders`. For a TX binding
+:func:`compile_packer` writes a Python function that reads the payload by
+the binding's aliases, range-checks each value against the DBC limits,
+scales it and writes the whole payload into a caller-owned buffer with one
+``struct.pack_into`` (byte-aligned fields) or one integer built from shifts
+and masks. A second variant reads the fields as attributes of a ROS message,
+so the bridge packs messages without copying them into a dict first. Together with a preallocated ``struct can_frame`` per binding
+this sends without building a values dict or a ``can.Message``.
+
+Multiplexed messages, signals with choices and unaligned float signals keep
+using ``msg_def.encode``. CAN FD payloads up to 64 bytes are packed the
+same way as classic ones.
+"""
+
+from __future__ import annotations
+
+import logging
+import struct
+from typing import Any, Callable, Dict, List, Mapping, Optional
+
+from .decoders import _Unsupported, _byte_span, _shift, _struct_code
+
+LOG = logging.getLogger(__name__)
+
+# Writes the payload for ``payload`` into ``buf`` at ``offset``
+Packer = Callable[[bytearray, int, Mapping[str, Any]], None]
+
+
+def _generate(msg_def, alias_to_signal: Mapping[str, str], binding_key: str, attributes: bool = False) -> Packer:
+    length = msg_def.length
+    by_name = {s.name: s for s in msg_def.signals}
+    signal_to_alias = {signal: alias for alias, signal in alias_to_signal.items()}
+    signals = list(msg_def.signals)
+    for signal in signals:
+        if signal.choices:
+            raise _Unsupported(f"signal {signal.name} has choices")
+        if signal.name not in signal_to_alias and alias_to_signal:
+            raise _Unsupported(f"signal {signal.name} has no field; cantools reports it")
+    unknown = [s for s in alias_to_signal.values() if s not in by_name]
+    if unknown:
+        raise _Unsupported(f"no signals {unknown}")
+
+    env: Dict[str, Any] = {"_pack_f": struct.Struct("<f").pack, "_pack_d": struct.Struct("<d").pack,
+                           "_from_bytes": int.from_bytes, "_missing": _missing(binding_key),
+                           "_struct_error": struct.error}
+    body: List[str] = ["    try:"]
+    for i, signal in enumerate(signals):
+        name = signal_to_alias.get(signal.name, signal.name)
+        if not attributes:
+            body.append(f"        v{i} = payload[{name!r}]")
+        elif all(part.isidentifier() for part in name.split(".")):
+            body.append(f"        v{i} = payload.{name}")
+        else:
+            raise _Unsupported(f"field {name!r} is not an attribute path")
+    body += [f"    except {'AttributeError' if attributes else 'KeyError'} as exc:", "        raise _missing(exc) from None"]
+
+    for i, signal in enumerate(signals):
+        if signal.minimum is not None or signal.maximum is not None:
+            lo = "-_inf" if signal.minimum is None else repr(float(signal.minimum))
+            hi = "_inf" if signal.maximum is None else repr(float(signal.maximum))
+            env["_inf"] = float("inf")
+            body.append(f"    if not {lo} <= v{i} <= {hi}:")
+            body.append(f"        raise ValueError(f\"{signal.name}={{v{i}!r}} is outside [{lo}, {hi}]\")")
+        scaled = f"v{i}" if signal.scale == 1 and signal.offset == 0 else \
+            f"(v{i} - {float(signal.offset)!r}) / {float(signal.scale)!r}"
+        if signal.is_float:
+            body.append(f"    r{i} = {scaled}")
+        else:
+            body.append(f"    r{i} = round({scaled})")
+
+    spans = [_byte_span(s, length) for s in signals]
+    orders = {s.byte_order for s in signals}
+    covered = sorted(((span, s) for span, s in zip(spans, signals) if span is not None), key=lambda c: c[0])
+    overlap = any(a[0][0] + a[0][1] > b[0][0] for a, b in zip(covered, covered[1:]))
+    if signals and None not in spans and len(orders) == 1 and not overlap:
+        # Every field sits on whole bytes: one struct covers the payload, pads written as zeros
+        order = "<" if orders == {"little_endian"} else ">"
+        fmt, pos, args = order, 0, []
+        for (first, count), signal in covered:
+            fmt += "x" * (first - pos) + _struct_code(signal)
+            pos = first + count
+            args.append(f"r{signals.index(signal)}")
+        fmt += "x" * (length - pos)
+        env["_pack_into"] = struct.Struct(fmt).pack_into
+        body += [
+            "    try:",
+            f"        _pack_into(buf, offset, {', '.join(args)})",
+            "    except _struct_error as exc:",
+            "        raise ValueError(f\"{exc} in " + msg_def.name + "\") from None",
+        ]
+    else:
+        le_terms, be_terms = [], []
+        for i, signal in enumerate(signals):
+            mask = (1 << signal.length) - 1
+            if signal.is_float:
+                if signal.length not in (32, 64):
+                    raise _Unsupported(f"float signal {signal.name} of {signal.length} bits")
+                pack = "_pack_f" if signal.length == 32 else "_pack_d"
+                body.append(f"    r{i} = _from_bytes({pack}(r{i}), 'little')")
+            else:
+                lo = -(1 << (signal.length - 1)) if signal.is_signed else 0
+                hi = (1 << (signal.length - 1)) - 1 if signal.is_signed else mask
+                body.append(f"    if not {lo} <= r{i} <= {hi}:")
+                body.append(f"        raise ValueError(f\"{signal.name} raw value {{r{i}}} does not fit {signal.length} bits\")")
+            term = f"((r{i} & {mask:#x}) << {_shift(signal, length)})"
+            (le_terms if signal.byte_order == "little_endian" else be_terms).append(term)
+        if be_terms:
+            body.append(f"    be = {' | '.join(be_terms)}")
+            le_terms.append(f"_from_bytes(be.to_bytes({length}, 'big'), 'little')")
+        body.append(f"    buf[offset:offset + {length}] = ({' | '.join(le_terms) or '0'}).to_bytes({length}, 'little')")
+
+    source = "\n".join(["def pack(buf, offset, payload):"] + body)
+    exec(compile(source, f"<packer {msg_def.name}>", "exec"), env)
+    pack = env["pack"]
+    pack.source = source
+    return pack
+
+
+def _missing(binding_key: str):
+    def make(exc: Exception) -> KeyError:
+        name = getattr(exc, "name", None) or exc.args[0]  # AttributeError.name is the missing attribute
+        return KeyError(f"Missing field '{name}' for binding '{binding_key}'")
+    return make
+
+
+def compile_packer(
+    msg_def, alias_to_signal: Mapping[str, str], binding_key: str, attributes: bool = False
+) -> Optional[Packer]:
+    """Return a packer for ``msg_def``, or None where ``msg_def.encode`` must be used.
+
+    ``alias_to_signal`` is the binding's ``fields``; when empty the payload
+    is keyed by signal names. With ``attributes`` the payload is an object
+    (a ROS message) and the fields are read as its attributes, dotted paths
+    such as ``vector.x`` included.
+    """
+
+    if msg_def.is_multiplexed() or msg_def.length > 64:
+        return None
+    try:
+        return _generate(msg_def, alias_to_signal, binding_key, attributes)
+    except _Unsupported as exc:
+        LOG.debug("%s: encoding with cantools (%s)", msg_def.name, exc)
+        return None
+
+
+__all__ = ["Packer", "compile_packer"]
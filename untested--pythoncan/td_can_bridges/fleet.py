@@ -0,0 +1,262 @@
+"""One JointState namespace and one command cycle over the buses of a ``topology``.
+
+:class:`MotorFleet` runs a :class:`td_can_bridges.topology.TopologyConfig`
+on the services of its buses. It is the bridge's counterpart of the
+``RobostrideSystem`` ros2_control hardware, for motors on several adapters:
+
+* ``commands`` (``sensor_msgs/JointState``): the latest position, velocity and
+  effort per joint name. A field left empty or NaN is not commanded. Without
+  a position the frame carries zero ``kp``, as in ``RobostrideSystem``.
+* One thread sends every joint of every bus a type 1 frame each
+  ``1 / rate_hz`` seconds, all buses in the same pass, so a cycle's commands
+  leave within microseconds of each other. Missed deadlines are skipped, as
+  in :class:`td_can_bridges.trajectory.TrajectoryStreamer`.
+* ``joint_states`` (``sensor_msgs/JointState``): the replies to one cycle,
+  stamped with the time it was sent. The message goes out once every joint
+  has replied, or at the next cycle without the missing ones. In that case
+  they hold their last values, and ``<joint_states>/stale``
+  (``std_msgs/UInt8MultiArray``, in joint order) flags them with 1.
+
+``start()`` enables the motors (type 3) and ``shutdown()`` stops them
+(type 4). ``topic_based_ros2_control`` and similar hardware plugins can use
+the two topics as their command and state interfaces.
+"""
+
+from __future__ import annotations
+
+import logging
+import math
+import threading
+import time
+from typing import Any, Dict, Mapping
+
+from .robostride_models import MODELS
+from .service import CanBusService
+from .topology import TopologyConfig
+from .trajectory import op_control_frame
+
+LOG = logging.getLogger(__name__)
+
+TYPE_FEEDBACK = 2
+TYPE_ENABLE = 3
+TYPE_STOP = 4
+ANSWER_MASK = 0x1F0000FF        # type and host ID: every motor
+
+
+def _value(code: int, lo: float, hi: float) -> float:
+    return lo + code * (hi - lo) / 65535.0
+
+
+class _Joint:
+    __slots__ = ("cfg", "service", "cmd", "position", "velocity", "effort")
+
+    def __init__(self, cfg, service: CanBusService):
+        self.cfg = cfg
+        self.service = service
+        self.cmd = (math.nan, math.nan, math.nan)   # position, velocity, effort
+        self.position = self.velocity = self.effort = math.nan
+
+
+class MotorFleet:
+    """The joints of a topology on ``services`` (bus name -> service), commanded and published per cycle."""
+
+    def __init__(self, node, topology: TopologyConfig, services: Mapping[str, CanBusService],
+                 state_qos, command_qos, callback_group=None):
+        from sensor_msgs.msg import JointState
+        from std_msgs.msg import UInt8MultiArray
+
+        self.node = node
+        self.topology = topology
+        self._msg_type = JointState
+        self._flags_type = UInt8MultiArray
+        missing = sorted(set(topology.buses) - set(services))
+        if missing:
+            raise ValueError(f"topology {topology.name}: bus(es) {missing} are not running in this node")
+        self._joints = [_Joint(j, services[j.bus]) for j in topology.joints]
+        self._by_name = {j.cfg.name: i for i, j in enumerate(self._joints)}
+        self._services = {bus: services[bus] for bus in topology.buses}
+        self.period_ns = int(1e9 / topology.rate_hz)
+
+        count = len(self._joints)
+        self._lock = threading.Lock()
+        self._fresh = [False] * count   # replied to the current cycle
+        self._pending = False           # the current cycle's message is still to be published
+        self._stamp = 0.0               # wall time the current cycle was sent
+        self._sent_ns = 0
+        self.cycles = self.overruns = self.skipped = self.dropped = 0
+        self.complete = self.incomplete = self.unknown_ids = 0
+        self.reply_ns_max = 0           # cycle sent -> last reply, over the complete cycles
+        self._reply_ns_sum = 0
+
+        self._keys = []
+        for bus, service in self._services.items():
+            where = {j.cfg.motor: i for i, j in enumerate(self._joints) if j.cfg.bus == bus}
+            key = f"fleet/{topology.name}"
+            service.register_raw_handler(key, TYPE_FEEDBACK << 24 | topology.host_id, self._handler(where),
+                                         id_mask=ANSWER_MASK)
+            self._keys.append((service, key))
+
+        self.pub = node.create_publisher(JointState, topology.state_topic, state_qos)
+        self.stale_pub = node.create_publisher(UInt8MultiArray, topology.state_topic + "/stale", state_qos)
+        self.sub = node.create_subscription(JointState, topology.command_topic, self._on_command, command_qos,
+                                            callback_group=callback_group)
+        self._running = False
+        self._thread = None
+        node.get_logger().info(
+            f"topology {topology.name}: {count} joint(s) at {topology.rate_hz:g} Hz on "
+            + ", ".join(f"{bus} ({sum(j.cfg.bus == bus for j in self._joints)}, {topology.loads[bus]:.0%})"
+                        for bus in topology.buses)
+        )
+
+    def _handler(self, where: Dict[int, int]):
+        def handler(arbitration_id: int, data, timestamp: float) -> None:
+            i = where.get((arbitration_id >> 8) & 0xFF)
+            if i is None:
+                self.unknown_ids += 1
+                return
+            if data is None or len(data) < 6:
+                return
+            self._on_feedback(i, data)
+
+        return handler
+
+    def _on_feedback(self, i: int, data: bytes) -> None:
+        joint = self._joints[i]
+        p, v, t = MODELS[joint.cfg.model][:3]
+        position = _value(data[0] << 8 | data[1], *p)
+        velocity = _value(data[2] << 8 | data[3], *v)
+        effort = _value(data[4] << 8 | data[5], *t)
+        with self._lock:
+            joint.position, joint.velocity, joint.effort = position, velocity, effort
+            self._fresh[i] = True
+            done = self._pending and all(self._fresh)
+            if done:
+                self._pending = False
+                elapsed = time.monotonic_ns() - self._sent_ns
+                self.reply_ns_max = max(self.reply_ns_max, elapsed)
+                self._reply_ns_sum += elapsed
+                self.complete += 1
+                message = self._snapshot()
+        if done:
+            self._publish(*message)
+
+    def _on_command(self, msg) -> None:
+        with self._lock:
+            for k, name in enumerate(msg.name):
+                i = self._by_name.get(name)
+                if i is None:
+                    continue
+                self._joints[i].cmd = tuple(
+                    values[k] if k < len(values) else math.nan
+                    for values in (msg.position, msg.velocity, msg.effort))
+
+    def _snapshot(self):
+        # Under the lock
+        return ([j.position for j in self._joints], [j.velocity for j in self._joints],
+                [j.effort for j in self._joints], [int(not f) for f in self._fresh], self._stamp)
+
+    def _publish(self, position, velocity, effort, stale, stamp) -> None:
+        msg = self._msg_type()
+        sec = int(stamp)
+        msg.header.stamp.sec = sec
+        msg.header.stamp.nanosec = int((stamp - sec) * 1e9)
+        msg.name = [j.cfg.name for j in self._joints]
+        msg.position, msg.velocity, msg.effort = position, velocity, effort
+        flags = self._flags_type()
+        flags.data = stale
+        pub, stale_pub = self.pub, self.stale_pub
+        if pub is not None:
+            pub.publish(msg)
+            stale_pub.publish(flags)
+
+    def _frames(self):
+        frames = []
+        with self._lock:
+            for joint in self._joints:
+                pos, vel, torque = joint.cmd
+                hold = math.isfinite(pos)
+                frames.append((joint.service, op_control_frame(
+                    joint.cfg.model, joint.cfg.motor, pos if hold else 0.0, vel if math.isfinite(vel) else 0.0,
+                    torque if math.isfinite(torque) else 0.0, joint.cfg.kp if hold else 0.0, joint.cfg.kd)))
+        return frames
+
+    def _cycle(self) -> None:
+        frames = self._frames()
+        with self._lock:
+            message = None
+            if self._pending:  # the last cycle is still missing replies: publish what came
+                self.incomplete += 1
+                message = self._snapshot()
+            self._fresh = [False] * len(self._fresh)
+            self._pending = True
+            self._stamp = time.time()
+            self._sent_ns = time.monotonic_ns()
+        if message is not None:
+            self._publish(*message)
+        for service, (arbitration_id, data) in frames:
+            try:
+                service.send_raw(arbitration_id, data)
+            except OSError as exc:
+                self.dropped += 1
+                LOG.debug("[%s] fleet frame 0x%X not sent: %s", service.cfg.name, arbitration_id, exc)
+
+    def _send_all(self, comm_type: int) -> None:
+        for joint in self._joints:
+            arbitration_id = comm_type << 24 | self.topology.host_id << 8 | joint.cfg.motor
+            try:
+                joint.service.send_raw(arbitration_id, bytes(8))
+            except OSError as exc:
+                LOG.warning("[%s] type %d to motor %d not sent: %s", joint.service.cfg.name, comm_type,
+                            joint.cfg.motor, exc)
+
+    def start(self) -> None:
+        if self._thread is not None:
+            return
+        self._send_all(TYPE_ENABLE)
+        self._running = True
+        self._thread = threading.Thread(target=self._run, name=f"{self.topology.name}-fleet", daemon=True)
+        self._thread.start()
+
+    def _run(self) -> None:
+        period = self.period_ns
+        deadline = time.monotonic_ns() + period
+        while self._running:
+            remaining = deadline - time.monotonic_ns()
+            if remaining > 0:
+                time.sleep(remaining / 1e9)
+            self._cycle()
+            self.cycles += 1
+            deadline += period
+            late = time.monotonic_ns() - deadline
+            if late > 0:
+                self.overruns += 1
+                # Resume on the first deadline still ahead, keeping the phase
+                missed = late // period + 1
+                self.skipped += missed
+                deadline += missed * period
+
+    def stats(self) -> Dict[str, Any]:
+        mean = self._reply_ns_sum / self.complete / 1e3 if self.complete else 0.0
+        return {"rate_hz": self.topology.rate_hz, "cycles": self.cycles, "overruns": self.overruns,
+                "skipped": self.skipped, "dropped": self.dropped, "complete": self.complete,
+                "incomplete": self.incomplete, "unknown_ids": self.unknown_ids,
+                "reply_us_mean": mean, "reply_us_max": self.reply_ns_max / 1e3}
+
+    def shutdown(self) -> None:
+        self._running = False
+        if self._thread is not None:
+            self._thread.join(timeout=1.0)
+            self._thread = None
+            self._send_all(TYPE_STOP)
+        for service, key in self._keys:
+            service.unregister_raw_handler(key)
+        self._keys = []
+        if self.sub is not None:
+            self.node.destroy_subscription(self.sub)
+        for pub in (self.pub, self.stale_pub):
+            if pub is not None:
+                self.node.destroy_publisher(pub)
+        self.sub = self.pub = self.stale_pub = None
+
+
+__all__ = ["MotorFleet"]
@@ -0,0 +1,204 @@
+"""Lost frames of periodic telemetry, counted per RX binding and put down to the stage that dropped them.
+
+An ``rx_frames`` entry with ``loss`` watches its frames for gaps::
+
+    rx_frames:
+      "RS02_Status1":
+        topic: /td/rs02/status1
+        loss: {period_ms: 10}          # the device sends every 10 ms
+      device_a_inbox:
+        dbc_message: BlinkFromB
+        loss: {sequence: sequence}     # a counter signal of the message
+
+* ``period_ms``: a frame that comes more than ``tolerance`` periods
+  (default 1.5) after the previous one of its ID means
+  ``round(gap / period) - 1`` lost frames.
+* ``sequence``: a counter signal, raw value, wrapping at its bit length.
+  A jump of ``n`` means ``n - 1`` lost frames, exact where the period is
+  only an estimate. Without the key, a signal named ``sequence`` or
+  ``counter`` is used if the message has one. ``sequence: false`` turns
+  that off. A device that restarts its counter reads as a gap. The
+  sequence is read from the payload, so in ``native`` mode (no payload in
+  Python) only the period is watched.
+* ``loss: true`` watches the sequence alone.
+
+A binding with ``id_mask`` tracks every ID it matches on its own. Each gap
+is put down to a stage, whichever lost frames since the previous gap of the
+bus, checked in the order the frame passes them:
+
+``adapter``
+    The adapter's overflow flag: the interface's ``rx_over_errors`` and
+    ``rx_fifo_errors``, or the controller overflow error frames where sysfs
+    has no counters. ``nativeCAN/triton_stats.py`` has the adapter's own
+    finer counters.
+``driver``
+    The interface's ``rx_dropped``: frames the driver or the network stack
+    could not queue.
+``socket``
+    The socket's ``SO_RXQ_OVFL`` count: a full receive buffer.
+``unknown``
+    None of them moved: the device did not send, or the frame was lost on
+    the wire.
+
+Frames dropped after the binding received them, by a full ``rx_workers``
+queue, count as ``queue``. ``metrics_snapshot()["frame_loss"]`` has the
+counts per binding, and the Prometheus export has
+``td_can_rx_lost_frames_total`` per binding and stage.
+"""
+
+from __future__ import annotations
+
+import threading
+from dataclasses import dataclass
+from pathlib import Path
+from typing import Any, Callable, Dict, Mapping, Optional
+
+from .decoders import compile_decoder
+
+STAGES = ("adapter", "driver", "socket", "unknown")
+SEQUENCE_NAMES = ("sequence", "counter")
+DEFAULT_TOLERANCE = 1.5
+
+# Cumulative count per stage, of the whole bus
+StageCounters = Callable[[], Mapping[str, int]]
+
+
+@dataclass(frozen=True)
+class LossConfig:
+    """``loss`` of an RX binding; ``sequence`` None picks a counter signal by name, "" turns it off."""
+
+    period_ms: Optional[float] = None
+    sequence: Optional[str] = None
+    tolerance: float = DEFAULT_TOLERANCE
+
+
+def loss_entry(value: Any, context: str) -> Optional[LossConfig]:
+    """Parse a binding's ``loss``: a mapping, or true for the sequence alone; None when absent."""
+
+    if not value:
+        return None
+    if value is True:
+        return LossConfig()
+    if not isinstance(value, Mapping):
+        raise ValueError(f"{context}.loss must be true or a mapping with period_ms and/or sequence")
+    unknown = sorted(set(value) - {"period_ms", "sequence", "tolerance"})
+    if unknown:
+        raise ValueError(f"{context}.loss: unknown key(s) {unknown}")
+    period = value.get("period_ms")
+    if period is not None and float(period) <= 0:
+        raise ValueError(f"{context}.loss.period_ms must be positive, got {period}")
+    tolerance = float(value.get("tolerance", DEFAULT_TOLERANCE))
+    if tolerance <= 1.0:
+        raise ValueError(f"{context}.loss.tolerance must be over 1 period, got {tolerance:g}")
+    sequence = value.get("sequence")
+    return LossConfig(
+        period_ms=float(period) if period is not None else None,
+        sequence="" if sequence is False else (str(sequence) if sequence else None),
+        tolerance=tolerance,
+    )
+
+
+def interface_drops(interface: str) -> Optional[Dict[str, int]]:
+    """The interface's ``adapter`` and ``driver`` counts from sysfs; None if unreadable."""
+
+    stats = Path("/sys/class/net") / interface / "statistics"
+    try:
+        read = {name: int((stats / name).read_text()) for name in ("rx_over_errors", "rx_fifo_errors", "rx_dropped")}
+    except (OSError, ValueError):
+        return None
+    return {"adapter": read["rx_over_errors"] + read["rx_fifo_errors"], "driver": read["rx_dropped"]}
+
+
+class _Stream:
+    __slots__ = ("timestamp", "sequence")
+
+    def __init__(self, timestamp: float, sequence: Optional[int]):
+        self.timestamp = timestamp
+        self.sequence = sequence
+
+
+class LossTracker:
+    """Gaps in the frames of one RX binding; :meth:`on_frame` runs as a raw handler on the RX thread."""
+
+    def __init__(self, key: str, msg_def, cfg: LossConfig, stages: "StageAttribution"):
+        self.key = key
+        self.cfg = cfg
+        self.stages = stages
+        self.period = cfg.period_ms / 1000.0 if cfg.period_ms else None
+        signal = None
+        if cfg.sequence:
+            names = [s.name for s in msg_def.signals]
+            if cfg.sequence not in names:
+                raise ValueError(f"RX binding '{key}': loss.sequence '{cfg.sequence}' is not a signal of "
+                                 f"{msg_def.name}")
+            signal = cfg.sequence
+        elif cfg.sequence is None:
+            signal = next((s.name for s in msg_def.signals if s.name.lower() in SEQUENCE_NAMES), None)
+        self.sequence = signal
+        if signal is None and self.period is None:
+            raise ValueError(f"RX binding '{key}': loss needs period_ms, or a sequence signal in {msg_def.name}")
+        if signal is not None:
+            self._modulus = 1 << next(s for s in msg_def.signals if s.name == signal).length
+            self._decode = compile_decoder(msg_def, [signal])
+        self._streams: Dict[int, _Stream] = {}
+        self.received = 0
+        self.lost = 0
+        self.by_stage: Dict[str, int] = {stage: 0 for stage in STAGES}
+
+    def on_frame(self, arbitration_id: int, data: Optional[bytes], timestamp: float) -> None:
+        self.received += 1
+        sequence = None
+        if self.sequence is not None and data is not None:
+            try:
+                sequence = int(self._decode(data).get(self.sequence))
+            except Exception:
+                sequence = None  # counted by the binding's own decode
+        stream = self._streams.get(arbitration_id)
+        if stream is None:
+            self._streams[arbitration_id] = _Stream(timestamp, sequence)
+            return
+        lost = 0
+        if sequence is not None and stream.sequence is not None:
+            lost = (sequence - stream.sequence - 1) % self._modulus
+        elif self.period is not None:
+            gap = timestamp - stream.timestamp
+            if gap > self.cfg.tolerance * self.period:
+                lost = max(int(round(gap / self.period)) - 1, 1)
+        stream.timestamp, stream.sequence = timestamp, sequence
+        if lost:
+            self.lost += lost
+            self.by_stage[self.stages.blame()] += lost
+
+    def stats(self, queue_dropped: int = 0) -> Dict[str, Any]:
+        lost = self.lost + queue_dropped
+        expected = self.received + self.lost
+        return {"received": self.received, "lost": lost,
+                "loss_rate": lost / expected if expected else 0.0,
+                "stages": dict(self.by_stage, queue=queue_dropped)}
+
+
+class StageAttribution:
+    """The bus's stage counters, and which moved since the last gap of any binding."""
+
+    def __init__(self, counters: StageCounters):
+        self._counters = counters
+        self._lock = threading.Lock()
+        self._last: Optional[Mapping[str, int]] = None
+
+    def prime(self) -> None:
+        with self._lock:
+            self._last = dict(self._counters())
+
+    def blame(self) -> str:
+        with self._lock:
+            now = dict(self._counters())
+            last, self._last = self._last, now
+        if last is None:
+            return "unknown"
+        for stage in STAGES[:-1]:
+            if now.get(stage, 0) > last.get(stage, 0):
+                return stage
+        return "unknown"
+
+
+__all__ = ["LossConfig", "LossTracker", "STAGES", "StageAttribution", "interface_drops", "loss_entry"]
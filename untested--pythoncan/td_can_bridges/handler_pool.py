@@ -0,0 +1,218 @@
+"""Bounded per-binding handler queues served by a small worker pool.
+
+With ``rx_workers`` set, the RX thread no longer runs handlers itself: each
+RX binding gets a :class:`BindingQueue` whose ``put`` stands in for the
+handler, and :class:`HandlerPool` threads run the real handlers. A slow
+subscriber (a ROS publish blocked on a reliable QoS) then only fills its own
+queue while decoding and every other binding carry on.
+
+A binding is served by at most one worker at a time, so its handler sees
+frames in order and never runs concurrently with itself. Workers take one
+frame per turn from the ready bindings of the highest ``priority`` first.
+
+When a queue is full its ``overflow`` policy decides:
+
+* ``latest`` – drop the oldest queued frame (telemetry: only fresh values matter)
+* ``block`` – the RX thread waits for room (commands that must not be lost)
+* ``error`` – drop the new frame and log an error
+"""
+
+from __future__ import annotations
+
+import logging
+import threading
+import time
+from collections import deque
+from typing import Any, Callable, Dict, List, Optional
+
+LOG = logging.getLogger(__name__)
+
+OVERFLOW_POLICIES = ("latest", "block", "error")
+
+
+class BindingQueue:
+    """The bounded queue of one RX binding; ``put`` has the RxHandler signature."""
+
+    def __init__(self, pool: "HandlerPool", binding, handler: Callable, size: int, overflow: str, priority: int = 0):
+        if overflow not in OVERFLOW_POLICIES:
+            raise ValueError(f"overflow must be one of {list(OVERFLOW_POLICIES)}, got '{overflow}'")
+        self.pool = pool
+        self.binding = binding
+        self.handler = handler
+        self.size = max(1, size)
+        self.overflow = overflow
+        self.priority = priority
+        self.items: deque = deque()
+        self.scheduled = False  # in the pool's ready list or being handled
+        self.overflowing = False  # an ``error`` drop was logged since the last accepted frame
+        # Metrics, updated under the pool lock
+        self.enqueued = 0
+        self.handled = 0
+        self.dropped = 0
+        self.failed = 0
+        self.max_depth = 0
+        self.wait_total = 0.0   # enqueue -> handler start
+        self.wait_max = 0.0
+        self.latency_total = 0.0  # frame timestamp -> handler done
+        self.latency_max = 0.0
+
+    def put(self, payload: Dict[str, Any], binding, timestamp: float) -> None:
+        self.pool.submit(self, (payload, timestamp, time.monotonic()))
+
+    def stats(self) -> Dict[str, float]:
+        with self.pool.lock:
+            handled = self.handled or 1
+            return {
+                "depth": len(self.items),
+                "max_depth": self.max_depth,
+                "enqueued": self.enqueued,
+                "handled": self.handled,
+                "dropped": self.dropped,
+                "failed": self.failed,
+                "wait_ms_mean": self.wait_total * 1e3 / handled,
+                "wait_ms_max": self.wait_max * 1e3,
+                "latency_ms_mean": self.latency_total * 1e3 / handled,
+                "latency_ms_max": self.latency_max * 1e3,
+            }
+
+
+class HandlerPool:
+    """``workers`` threads running the handlers of every :class:`BindingQueue` of a bus."""
+
+    def __init__(self, workers: int, name: str, metrics=None, profile=None):
+        self.workers = max(1, workers)
+        self.name = name
+        self.metrics = metrics  # metrics.BusMetrics, fed the handler times
+        self.profile = profile  # binding_profile.BindingProfiler, fed sampled handler costs
+        self.lock = threading.Lock()
+        self._ready_cond = threading.Condition(self.lock)
+        self._space_cond = threading.Condition(self.lock)
+        self._ready: Dict[int, deque] = {}
+        self._levels: List[int] = []  # priorities, highest first
+        self._queues: List[BindingQueue] = []
+        self._threads: List[threading.Thread] = []
+        self._running = False
+
+    def queue(self, binding, handler: Callable, size: int, overflow: str, priority: int = 0) -> BindingQueue:
+        queue = BindingQueue(self, binding, handler, size, overflow, priority)
+        with self.lock:
+            self._queues.append(queue)
+            if priority not in self._ready:
+                self._ready[priority] = deque()
+                self._levels = sorted(self._ready, reverse=True)
+        return queue
+
+    def remove(self, queue: BindingQueue) -> None:
+        """Stop reporting ``queue``; frames it already holds are still handled."""
+
+        with self.lock:
+            if queue in self._queues:
+                self._queues.remove(queue)
+
+    def start(self) -> None:
+        with self.lock:
+            if self._running:
+                return
+            self._running = True
+        self._threads = [
+            threading.Thread(target=self._work, name=f"{self.name}-rx-worker{i}", daemon=True)
+            for i in range(self.workers)
+        ]
+        for thread in self._threads:
+            thread.start()
+
+    def stop(self, timeout: float = 1.0) -> None:
+        """Let the workers finish what is queued, then end them; releases blocked producers."""
+
+        with self.lock:
+            self._running = False
+            self._ready_cond.notify_all()
+            self._space_cond.notify_all()
+        deadline = time.monotonic() + timeout
+        for thread in self._threads:
+            thread.join(timeout=max(0.0, deadline - time.monotonic()))
+        self._threads = []
+
+    def submit(self, queue: BindingQueue, item: tuple) -> None:
+        with self.lock:
+            if len(queue.items) >= queue.size:
+                if queue.overflow == "latest":
+                    queue.items.popleft()
+                    queue.dropped += 1
+                elif queue.overflow == "error":
+                    queue.dropped += 1
+                    if not queue.overflowing:
+                        queue.overflowing = True
+                        LOG.error("[%s] RX queue of %s full (%d); dropping frames",
+                                  self.name, queue.binding.key, queue.size)
+                    return
+                else:
+                    while len(queue.items) >= queue.size and self._running:
+                        self._space_cond.wait()
+                    if len(queue.items) >= queue.size:
+                        queue.dropped += 1  # stopped while waiting
+                        return
+            queue.items.append(item)
+            queue.overflowing = False
+            queue.enqueued += 1
+            if len(queue.items) > queue.max_depth:
+                queue.max_depth = len(queue.items)
+            if not queue.scheduled:
+                queue.scheduled = True
+                self._ready[queue.priority].append(queue)
+                self._ready_cond.notify()
+
+    def stats(self) -> Dict[str, Dict[str, float]]:
+        return {queue.binding.key: queue.stats() for queue in self._queues}
+
+    def _next(self) -> Optional[BindingQueue]:
+        for level in self._levels:
+            ready = self._ready[level]
+            if ready:
+                return ready.popleft()
+        return None
+
+    def _work(self) -> None:
+        while True:
+            with self.lock:
+                queue = self._next()
+                while queue is None:
+                    if not self._running:
+                        return
+                    self._ready_cond.wait()
+                    queue = self._next()
+                payload, timestamp, enqueued = queue.items.popleft()
+                if queue.overflow == "block":
+                    self._space_cond.notify_all()
+
+            started = time.monotonic()
+            failed = False
+            profiled = self.profile.begin("rx", queue.binding.key) if self.profile is not None else None
+            try:
+                queue.handler(payload, queue.binding, timestamp)
+            except Exception:
+                failed = True
+                LOG.exception("[%s] RX handler for %s failed", self.name, queue.binding.key)
+            if profiled is not None:
+                self.profile.end(profiled)
+            latency = time.time() - timestamp
+
+            with self.lock:
+                if self.metrics is not None:
+                    self.metrics.handler_histogram(queue.binding.key).observe(time.monotonic() - started)
+                    self.metrics.handler_errors += failed
+                wait = started - enqueued
+                queue.handled += 1
+                queue.failed += failed
+                queue.wait_total += wait
+                queue.wait_max = max(queue.wait_max, wait)
+                queue.latency_total += latency
+                queue.latency_max = max(queue.latency_max, latency)
+                if queue.items:
+                    self._ready[queue.priority].append(queue)
+                    self._ready_cond.notify()
+                else:
+                    queue.scheduled = False
+
+
+__all__ = ["BindingQueue", "HandlerPool", "OVERFLOW_POLICIES"]
@@ -0,0 +1,154 @@
+"""One ``sensor_msgs/JointState`` for a set of motors.
+
+An ``rx_frames`` entry with ``publish: joint_states`` covers the feedback
+frames of many motors: a masked binding whose ``id_fields`` give the motor
+ID (RobStride comm type 2, ``RS02_Feedback``). Its ``fields`` map the DBC
+signals to ``position``, ``velocity`` and ``effort``, and ``joints`` maps
+each motor ID to a joint name, fixing the order of the joint vector.
+
+:class:`JointStateBinding` keeps the latest sample of every joint and
+publishes them together: every ``1 / publish_rate_hz`` seconds, or without a
+rate as soon as every joint has a sample newer than the last message. A joint
+with no sample for ``stale_ms`` is stale and is not waited for. The message
+still holds its last values, and ``<topic>/stale``
+(``std_msgs/UInt8MultiArray``, in joint order) flags it with 1, so
+controllers can tell a held value from a fresh one without re-synchronising
+per-motor topics.
+"""
+
+from __future__ import annotations
+
+import math
+import threading
+import time
+from typing import Any, Dict, List
+
+from .service import CanBusService, RxBindingConfig
+
+JOINT_FIELDS = ("position", "velocity", "effort")
+DEFAULT_STALE_MS = 50.0
+
+
+def _joint_id(value: Any) -> int:
+    return int(value, 0) if isinstance(value, str) else int(value)
+
+
+class JointStateBinding:
+    """CAN → ROS: the latest position, velocity and effort of each configured joint in one message."""
+
+    def __init__(self, node, service: CanBusService, binding: RxBindingConfig, qos_profile, callback_group=None):
+        from sensor_msgs.msg import JointState
+        from std_msgs.msg import UInt8MultiArray
+
+        self.node = node
+        self.binding = binding
+        self._msg_type = JointState
+        self._flags_type = UInt8MultiArray
+        metadata = dict(binding.metadata)
+        key = binding.key
+
+        self.id_field = metadata.get("joint_field")
+        if self.id_field is None and len(binding.id_fields) == 1:
+            self.id_field = next(iter(binding.id_fields))
+        if self.id_field not in binding.id_fields:
+            raise ValueError(f"RX binding '{key}': publish: joint_states needs the motor ID in id_fields "
+                             f"(or joint_field naming one of them), got {sorted(binding.id_fields)}")
+        joints = metadata.get("joints") or {}
+        if not joints:
+            raise ValueError(f"RX binding '{key}': publish: joint_states needs joints: {{<motor id>: <joint name>}}")
+        self.names: List[str] = [str(name) for name in joints.values()]
+        self.index: Dict[int, int] = {_joint_id(motor): i for i, motor in enumerate(joints)}
+        unknown = sorted(set(binding.fields.values()) - set(JOINT_FIELDS))
+        if not binding.fields or unknown:
+            raise ValueError(f"RX binding '{key}': fields must map DBC signals to {list(JOINT_FIELDS)}, got {unknown}")
+        self.fields = [f for f in JOINT_FIELDS if f in binding.fields.values()]
+        self.stale_after = float(metadata.get("stale_ms", DEFAULT_STALE_MS)) / 1000.0
+        rate = metadata.get("publish_rate_hz")
+        if rate is not None and float(rate) <= 0:
+            raise ValueError(f"RX binding '{key}': publish_rate_hz must be positive, got {rate}")
+
+        count = len(self.names)
+        self._lock = threading.Lock()
+        self._values = {f: [math.nan] * count for f in self.fields}
+        self._seen = [0.0] * count      # monotonic time of each joint's latest sample, 0 before the first
+        self._fresh = [False] * count   # a sample arrived since the last message
+        self.published = 0
+        self.stale_publishes = 0        # messages with at least one stale joint
+        self.unknown_ids = 0            # frames of motors not in joints
+
+        self.topic = metadata.get("topic", key)
+        self.header_frame_id = metadata.get("frame_id", "")
+        self.pub = node.create_publisher(JointState, self.topic, qos_profile)
+        self.stale_pub = node.create_publisher(UInt8MultiArray, self.topic + "/stale", qos_profile)
+        self.timer = None
+        if rate is not None:
+            self.timer = node.create_timer(1.0 / float(rate), self._on_timer, callback_group=callback_group)
+
+        service.register_rx_binding(binding, self._handle_frame)
+        node.get_logger().info(
+            f"RX bind: DBC:{binding.message} -> {self.topic} (JointState of {', '.join(self.names)}, "
+            + (f"{float(rate):g} Hz)" if rate is not None else "when complete)")
+        )
+
+    def _handle_frame(self, payload: Dict[str, Any], binding: RxBindingConfig, timestamp: float):
+        i = self.index.get(payload.get(self.id_field))
+        if i is None:
+            self.unknown_ids += 1
+            return
+        with self._lock:
+            for field in self.fields:
+                self._values[field][i] = float(getattr(payload[field], "value", payload[field]))
+            now = self._seen[i] = time.monotonic()
+            self._fresh[i] = True
+            # A stale joint does not hold the others back; the message flags it
+            complete = self.timer is None and all(
+                fresh or not seen or now - seen > self.stale_after for fresh, seen in zip(self._fresh, self._seen))
+        if complete:
+            self._publish(timestamp)
+
+    def _on_timer(self):
+        self._publish(None)
+
+    def _publish(self, timestamp):
+        now = time.monotonic()
+        with self._lock:
+            values = {field: list(v) for field, v in self._values.items()}
+            stale = [int(not seen or now - seen > self.stale_after) for seen in self._seen]
+            self._fresh = [False] * len(self._fresh)
+        msg = self._msg_type()
+        if timestamp:  # the frame that completed the set
+            sec = int(timestamp)
+            msg.header.stamp.sec = sec
+            msg.header.stamp.nanosec = int((timestamp - sec) * 1e9)
+        else:
+            msg.header.stamp = self.node.get_clock().now().to_msg()
+        msg.header.frame_id = self.header_frame_id
+        msg.name = list(self.names)
+        for field, v in values.items():
+            setattr(msg, field, v)
+        flags = self._flags_type()
+        flags.data = stale
+        self.pub.publish(msg)
+        self.stale_pub.publish(flags)
+        self.published += 1
+        if any(stale):
+            self.stale_publishes += 1
+
+    def stats(self) -> Dict[str, Any]:
+        now = time.monotonic()
+        with self._lock:
+            stale = [name for name, seen in zip(self.names, self._seen) if not seen or now - seen > self.stale_after]
+        return {"published": self.published, "stale_publishes": self.stale_publishes,
+                "unknown_ids": self.unknown_ids, "stale": stale}
+
+    def shutdown(self):
+        if self.timer is not None:
+            self.node.destroy_timer(self.timer)
+            self.timer = None
+        for pub in (self.pub, self.stale_pub):
+            if pub is not None:
+                self.node.destroy_publisher(pub)
+        self.pub = self.stale_pub = None
+
+
+__all__ = ["DEFAULT_STALE_MS", "JOINT_FIELDS", "JointStateBinding"]
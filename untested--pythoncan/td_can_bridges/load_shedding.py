@@ -0,0 +1,188 @@
+"""Shed low-priority RX bindings while the bus falls behind its frames.
+
+A bus with ``shedding`` measures its lag: how long after its kernel receive
+timestamp each frame reaches its bindings. It is averaged over every
+``window`` seconds. Under CPU pressure the lag grows for every frame alike,
+so commands, faults and 1 Hz telemetry would arrive late together. Instead,
+once the lag stays above ``lag_ms`` for ``shed_after_s``, the bindings of
+the lowest ``priority`` class deliver only one frame in ``decimate`` (0:
+none). While the lag stays up, the next class follows at every further
+``shed_after_s``. Once it stays under ``restore_ms`` for ``restore_after_s``,
+the classes come back one at a time, the last one shed first::
+
+    shedding:
+      lag_ms: 20          # default
+      restore_ms: 5
+      shed_after_s: 0.2
+      restore_after_s: 2.0
+      decimate: 10        # a shed binding keeps every 10th frame; 0 drops them all
+      protect: 1          # bindings with priority >= 1 are never shed
+
+The classes are the ``priority`` values of the bus's RX bindings below
+``protect``. With every binding at the default 0 there is one class. Give 1
+Hz topics a negative priority and commands a positive one. Raw handlers
+(faults, parameter answers) and the signal store are never shed. A frame
+that every binding of its message would skip is not decoded either.
+
+The lag compares the frame's timestamp with the system clock, so it needs
+the kernel's software timestamps (``rx_timestamps: software``).
+"""
+
+from __future__ import annotations
+
+import logging
+import time
+from dataclasses import dataclass
+from typing import Any, Callable, Dict, Iterable, List, Mapping, Optional
+
+LOG = logging.getLogger(__name__)
+
+_KEYS = ("lag_ms", "restore_ms", "shed_after_s", "restore_after_s", "decimate", "protect", "window")
+
+
+@dataclass(frozen=True)
+class SheddingConfig:
+    """``shedding`` of a bus."""
+
+    lag_ms: float = 20.0           # mean lag that sheds the next class
+    restore_ms: float = 5.0        # mean lag under which the last class shed comes back
+    shed_after_s: float = 0.2      # the lag stays over lag_ms this long before each step down
+    restore_after_s: float = 2.0   # ... under restore_ms this long before each step back
+    decimate: int = 10             # a shed binding delivers one frame in this many; 0: none
+    protect: int = 1               # bindings with at least this priority are never shed
+    window: float = 0.1            # seconds of frames per lag average
+
+
+def shedding_entry(value: Any, context: str) -> Optional[SheddingConfig]:
+    """``shedding``: true for the defaults, or a mapping of :class:`SheddingConfig` fields."""
+
+    if value is None or value is False:
+        return None
+    if value is True:
+        return SheddingConfig()
+    if not isinstance(value, Mapping):
+        raise ValueError(f"{context}.shedding must be true or a mapping, got {value!r}")
+    unknown = set(value) - set(_KEYS)
+    if unknown:
+        raise ValueError(f"{context}.shedding has unknown keys {sorted(unknown)}")
+    cfg = SheddingConfig(
+        lag_ms=float(value.get("lag_ms", 20.0)),
+        restore_ms=float(value.get("restore_ms", 5.0)),
+        shed_after_s=float(value.get("shed_after_s", 0.2)),
+        restore_after_s=float(value.get("restore_after_s", 2.0)),
+        decimate=int(value.get("decimate", 10)),
+        protect=int(value.get("protect", 1)),
+        window=float(value.get("window", 0.1)),
+    )
+    if not 0 <= cfg.restore_ms < cfg.lag_ms:
+        raise ValueError(f"{context}.shedding: restore_ms must be at least 0 and below lag_ms "
+                         f"({cfg.restore_ms:g} / {cfg.lag_ms:g})")
+    if cfg.decimate < 0 or cfg.window <= 0 or cfg.shed_after_s < 0 or cfg.restore_after_s < 0:
+        raise ValueError(f"{context}.shedding: decimate, window and the hold times must not be negative")
+    return cfg
+
+
+class LoadShedder:
+    """The lag detector and shedding state of one bus, run on its RX thread.
+
+    ``priorities`` returns the priorities of the bus's RX bindings; it is
+    read at each step, so bindings registered later are classed too.
+    """
+
+    def __init__(self, name: str, cfg: SheddingConfig, priorities: Callable[[], Iterable[int]]):
+        self.name = name
+        self.cfg = cfg
+        self._priorities = priorities
+        self.level = 0                   # classes shed, lowest first
+        self.floor: Optional[int] = None  # bindings with priority <= floor are shed
+        self.lag = 0.0                   # mean lag (s) of the last window
+        self.max_lag = 0.0
+        self.steps = 0                   # level changes either way
+        self.shed: Dict[str, int] = {}   # binding key -> frames skipped
+        self._seen: Dict[str, int] = {}  # binding key -> frames while shed, for decimate
+        self._sum = 0.0
+        self._count = 0
+        self._window_end = 0.0
+        self._over_since: Optional[float] = None
+        self._under_since: Optional[float] = None
+        self._since = time.monotonic()
+
+    def admit(self, subscribers: List[tuple], timestamp: float) -> List[tuple]:
+        """The subscribers that get this frame; the same list when nothing is shed."""
+
+        now = time.time()
+        lag = now - timestamp
+        if lag > 0:
+            self._sum += lag
+        self._count += 1
+        if now >= self._window_end:
+            self._step(now)
+        floor = self.floor
+        if floor is None:
+            return subscribers
+        decimate = self.cfg.decimate
+        kept = []
+        for sub in subscribers:
+            binding = sub[1]
+            if binding.priority > floor:
+                kept.append(sub)
+                continue
+            seen = self._seen.get(binding.key, 0)
+            self._seen[binding.key] = seen + 1
+            if decimate and seen % decimate == 0:
+                kept.append(sub)
+            else:
+                self.shed[binding.key] = self.shed.get(binding.key, 0) + 1
+        return kept
+
+    def _step(self, now: float) -> None:
+        cfg = self.cfg
+        self.lag = self._sum / self._count if self._count else 0.0
+        self.max_lag = max(self.max_lag, self.lag)
+        self._sum, self._count = 0.0, 0
+        self._window_end = now + cfg.window
+        classes = sorted({p for p in self._priorities() if p < cfg.protect})
+        level = min(self.level, len(classes))
+        lag_ms = self.lag * 1000.0
+        if lag_ms > cfg.lag_ms:
+            self._under_since = None
+            if self._over_since is None:
+                self._over_since = now
+            elif now - self._over_since >= cfg.shed_after_s and level < len(classes):
+                level += 1
+                self._over_since = now
+                LOG.warning("[%s] RX %.1f ms behind: shedding RX bindings with priority <= %d",
+                            self.name, lag_ms, classes[level - 1])
+        elif lag_ms < cfg.restore_ms:
+            self._over_since = None
+            if self._under_since is None:
+                self._under_since = now
+            elif now - self._under_since >= cfg.restore_after_s and level > 0:
+                level -= 1
+                self._under_since = now
+                LOG.info("[%s] RX caught up (%.1f ms): %s", self.name, lag_ms,
+                         f"shedding priority <= {classes[level - 1]}" if level else "shedding nothing")
+        else:
+            self._over_since = self._under_since = None
+        if level != self.level:
+            self.steps += 1
+            self._since = time.monotonic()
+            self._seen.clear()
+        self.level = level
+        self.floor = classes[level - 1] if level else None
+
+    def stats(self) -> Dict[str, Any]:
+        """``level``, the shed ``floor`` priority (None: nothing shed), lags and frames skipped per binding."""
+
+        return {
+            "level": self.level,
+            "floor": self.floor,
+            "lag_ms": self.lag * 1000.0,
+            "max_lag_ms": self.max_lag * 1000.0,
+            "steps": self.steps,
+            "seconds_at_level": time.monotonic() - self._since,
+            "shed_frames": dict(self.shed),
+        }
+
+
+__all__ = ["LoadShedder", "SheddingConfig", "shedding_entry"]
@@ -0,0 +1,226 @@
+"""Decoded CAN logs as columnar tables: one Parquet or Arrow file per DBC message.
+
+:func:`export_log` reads a log with :func:`td_can_bridges.replay.read_log`
+(candump ``.log``, the recorder's ``.blf`` or ``.tdlog``, ``.asc``, ...). It
+gathers the frames of each DBC message, per channel, in a
+:class:`~td_can_bridges.batch.BlockRecorder` and decodes every full block
+column-wise with :class:`~td_can_bridges.batch.BatchDecoder`. Message ``M``
+becomes ``<out_dir>/M.parquet`` (or ``M.arrow``, an Arrow IPC file) with
+``timestamp`` (seconds, as logged), ``channel``, ``dlc`` and one typed column
+per signal: the narrowest integer type for an unscaled integer signal,
+``float32`` for an unscaled 32-bit float and ``float64`` for the rest. The
+types come from the DBC, so every block of a message has the same schema.
+Frames of IDs the DBC does not have, error frames and remote frames are
+counted and skipped.
+
+By default each message's blocks are kept in memory and written as one table,
+sorted by timestamp, at the end. With ``stream=True`` every block is written
+as soon as it fills (one Parquet row group or Arrow record batch), so memory
+stays at ``block_rows`` frames per channel and message however large the log
+is; rows are then in time order per channel only.
+
+    db = cantools.database.load_file("td_can_bridges/schemas/motors.dbc")
+    stats = export_log("session.blf", db, "session/", stream=True)
+    print(stats.summary())
+
+Needs NumPy and pyarrow, imported only here.
+"""
+
+from __future__ import annotations
+
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Dict, Iterable, List, Optional, Tuple
+
+import numpy as np
+import pyarrow as pa
+
+from .batch import BatchDecoder, BlockRecorder, Columns
+from .compact_log import SUFFIX, CompactLogReader
+from .replay import LogFrame, read_log
+from .socketcan_rx import CAN_EFF_FLAG, CAN_ERR_FLAG, CAN_RTR_FLAG
+
+FORMATS = ("parquet", "arrow")
+DEFAULT_BLOCK_ROWS = 65536
+# (signed, bits) of an unscaled integer signal
+_INT_TYPES = {
+    (True, 8): pa.int8(), (True, 16): pa.int16(), (True, 32): pa.int32(), (True, 64): pa.int64(),
+    (False, 8): pa.uint8(), (False, 16): pa.uint16(), (False, 32): pa.uint32(), (False, 64): pa.uint64(),
+}
+
+
+def signal_type(signal) -> pa.DataType:
+    """Arrow type of a decoded cantools signal, as the columns of :class:`BatchDecoder` hold it."""
+
+    unscaled = signal.scale == 1 and signal.offset == 0
+    if signal.is_float:
+        return pa.float32() if unscaled and signal.length == 32 else pa.float64()
+    if not unscaled:
+        return pa.float64()
+    bits = next(b for b in (8, 16, 32, 64) if signal.length <= b)
+    return _INT_TYPES[(bool(signal.is_signed), bits)]
+
+
+def message_schema(signals) -> pa.Schema:
+    fields = [pa.field("timestamp", pa.float64(), nullable=False), pa.field("channel", pa.string()),
+              pa.field("dlc", pa.uint8(), nullable=False)]
+    # Multiplexed signals are absent from the frames of the other multiplexer values: null there
+    fields += [pa.field(s.name, signal_type(s)) for s in signals]
+    return pa.schema(fields)
+
+
+@dataclass
+class ExportStats:
+    frames: int = 0
+    unknown: int = 0   # no DBC message has the ID
+    skipped: int = 0   # error and remote frames
+    rows: Dict[str, int] = field(default_factory=dict)  # per message written
+    files: List[Path] = field(default_factory=list)
+
+    def summary(self) -> str:
+        decoded = sum(self.rows.values())
+        return (f"{self.frames} frames: {decoded} decoded into {len(self.files)} tables, "
+                f"{self.unknown} of unknown IDs, {self.skipped} error/remote frames skipped")
+
+
+class _Table:
+    """Output file of one DBC message."""
+
+    def __init__(self, msg_def, path: Path, fmt: str, compression: Optional[str], stream: bool):
+        self.decoder = BatchDecoder(msg_def)
+        self.schema = message_schema(self.decoder.signals)
+        self.path = path
+        self.fmt = fmt
+        self.compression = compression
+        self.stream = stream
+        self.rows = 0
+        self._batches: List[pa.RecordBatch] = []
+        self._writer = None
+
+    def add(self, channel: str, columns: Columns) -> None:
+        n = len(columns["timestamp"])
+        arrays = [pa.array(columns["timestamp"], pa.float64()),
+                  pa.array(np.full(n, channel, dtype=object), pa.string()),
+                  pa.array(columns["dlc"], pa.uint8())]
+        for f in self.schema[3:]:
+            values = columns[f.name]
+            if values.dtype == object:
+                # The frame-by-frame fallback, with None where a multiplexed signal is absent
+                arrays.append(pa.array(values, f.type, from_pandas=True))
+            else:
+                # Fits by construction: the raw bits of an unscaled signal, or a float32 widened
+                arrays.append(pa.array(values.astype(f.type.to_pandas_dtype(), copy=False), f.type))
+        batch = pa.RecordBatch.from_arrays(arrays, schema=self.schema)
+        self.rows += n
+        if self.stream:
+            self._write(pa.Table.from_batches([batch], self.schema))
+        else:
+            self._batches.append(batch)
+
+    def close(self) -> None:
+        if self._batches:
+            table = pa.Table.from_batches(self._batches, self.schema)
+            self._batches = []
+            self._write(table.sort_by("timestamp"))
+        if self._writer is not None:
+            self._writer.close()
+            self._writer = None
+
+    def _write(self, table: pa.Table) -> None:
+        if self._writer is None:
+            if self.fmt == "parquet":
+                import pyarrow.parquet as pq
+
+                self._writer = pq.ParquetWriter(str(self.path), self.schema, compression=self.compression or "zstd")
+            else:
+                options = pa.ipc.IpcWriteOptions(compression=self.compression) if self.compression else None
+                self._writer = pa.ipc.new_file(str(self.path), self.schema, options=options)
+        self._writer.write_table(table)
+
+
+def export_frames(frames: Iterable[LogFrame], db, out_dir: Path | str, fmt: str = "parquet",
+                  stream: bool = False, block_rows: int = DEFAULT_BLOCK_ROWS,
+                  compression: Optional[str] = None, messages: Optional[Iterable[str]] = None) -> ExportStats:
+    """Decode ``frames`` with the cantools database ``db`` into one table per message in ``out_dir``.
+
+    ``messages`` limits the export to those message names. ``compression`` is
+    a Parquet codec (default zstd) or, for Arrow files, ``lz4`` or ``zstd``
+    (default none).
+    """
+
+    if fmt not in FORMATS:
+        raise ValueError(f"format must be one of {FORMATS}, got '{fmt}'")
+    out = Path(out_dir)
+    out.mkdir(parents=True, exist_ok=True)
+    wanted = None if messages is None else set(messages)
+    by_id = {m.frame_id | (CAN_EFF_FLAG if m.is_extended_frame else 0): m
+             for m in db.messages if wanted is None or m.name in wanted}
+    if wanted is not None and len(by_id) != len(wanted):
+        missing = wanted - {m.name for m in by_id.values()}
+        raise ValueError(f"not in the DBC: {sorted(missing)}")
+
+    tables: Dict[str, _Table] = {}
+    blocks: Dict[Tuple[str, int], Optional[BlockRecorder]] = {}
+    stats = ExportStats()
+    try:
+        for frame in frames:
+            stats.frames += 1
+            key = (frame.channel, frame.can_id)
+            if key in blocks:
+                block = blocks[key]
+            else:
+                block = blocks[key] = _open_block(frame, by_id, tables, out, fmt, compression, stream, block_rows)
+            if block is None:
+                if frame.can_id & (CAN_ERR_FLAG | CAN_RTR_FLAG):
+                    stats.skipped += 1
+                else:
+                    stats.unknown += 1
+                continue
+            block.add(frame.timestamp, frame.data)
+        for block in blocks.values():
+            if block is not None:
+                block.flush()
+    finally:
+        for table in tables.values():
+            table.close()
+    for name, table in sorted(tables.items()):
+        if table.rows:
+            stats.rows[name] = table.rows
+            stats.files.append(table.path)
+    return stats
+
+
+def _open_block(frame: LogFrame, by_id, tables: Dict[str, _Table], out: Path, fmt: str,
+                compression: Optional[str], stream: bool, block_rows: int) -> Optional[BlockRecorder]:
+    """Block of the frame's (channel, ID), None for frames that are not exported."""
+
+    if frame.can_id & (CAN_ERR_FLAG | CAN_RTR_FLAG):
+        return None
+    msg_def = by_id.get(frame.can_id)
+    if msg_def is None:
+        return None
+    table = tables.get(msg_def.name)
+    if table is None:
+        table = tables[msg_def.name] = _Table(msg_def, out / f"{msg_def.name}.{fmt}", fmt, compression, stream)
+    channel = frame.channel
+    return BlockRecorder(table.decoder, lambda columns: table.add(channel, columns), block_size=block_rows)
+
+
+def export_log(path: Path | str, db, out_dir: Path | str, **kwargs) -> ExportStats:
+    """:func:`export_frames` over :func:`read_log` of ``path``.
+
+    From a compact ``.tdlog`` with ``messages``, only those messages' streams
+    are read.
+    """
+
+    messages = kwargs.get("messages")
+    if messages is not None and Path(path).suffix.lower() == SUFFIX:
+        names = set(messages)
+        ids = {m.frame_id | (CAN_EFF_FLAG if m.is_extended_frame else 0) for m in db.messages if m.name in names}
+        with CompactLogReader(path) as log:
+            return export_frames(log.frames(ids=ids), db, out_dir, **kwargs)
+    return export_frames(read_log(path), db, out_dir, **kwargs)
+
+
+__all__ = ["DEFAULT_BLOCK_ROWS", "ExportStats", "FORMATS", "export_frames", "export_log", "message_schema",
+           "signal_type"]
@@ -1,10 +1,17 @@
 
+import time
 from importlib import import_module
-from typing import Any, Dict
+from numbers import Real
+from operator import attrgetter
+from typing import Any, Dict, Mapping
 
 from rclpy.qos import QoSProfile
 
-from .service import CanBusService, TxBindingConfig, RxBindingConfig
+from .ros_msgs import DEFAULT_PACKAGE, frame_fields, type_name
+from .service import CanBusService, TxBindingConfig, RxBindingConfig, missing_attributes
+
+# Seconds between subscriber counts of a lazy binding where rclpy has no matched events (Humble)
+LAZY_POLL_PERIOD = 1.0
 
 
 def resolve_ros_type(ros_type_str, default='std_msgs/msg/Float32'):
@@ -23,43 +30,29 @@ def resolve_ros_type(ros_type_str, default='std_msgs/msg/Float32'):
 class TopicTxBinding:
     """ROS → CAN: subscribe to a ROS topic and pack to a DBC frame."""
 
-    def __init__(self, node, service: CanBusService, binding: TxBindingConfig, qos_profile: QoSProfile):
+    def __init__(self, node, service: CanBusService, binding: TxBindingConfig, qos_profile: QoSProfile,
+                 callback_group=None):
         self.node = node
         self.service = service
         self.binding = binding
-        self.service.register_tx_binding(binding)
-        self.msg_def = service.dbc.get_message_by_name(binding.message)
-
         metadata = dict(binding.metadata)
         self.topic = metadata.get('topic', binding.key)
         msg_type = resolve_ros_type(metadata.get('type', 'std_msgs/msg/Float32'))
+        # A sample message checks the fields and compiles the attribute packer before any message arrives
+        self.service.register_tx_binding(binding, sample=msg_type())
+        self.msg_def = service.dbc.get_message_by_name(binding.message)
 
-        self.subscription = node.create_subscription(msg_type, self.topic, self._cb, qos_profile)
+        self.subscription = node.create_subscription(msg_type, self.topic, self._cb, qos_profile,
+                                                     callback_group=callback_group)
         node.get_logger().info(
             f"TX bind: {self.topic} -> DBC:{self.msg_def.name} (id=0x{self.msg_def.frame_id:X})"
         )
 
     def _cb(self, ros_msg):
-        payload: Dict[str, Any] = {}
-        if self.binding.fields:
-            for ros_field in self.binding.fields.keys():
-                if not hasattr(ros_msg, ros_field):
-                    self.node.get_logger().error(
-                        f"Message on {self.topic} missing field '{ros_field}'",
-                        throttle_duration_sec=5.0,
-                    )
-                    return
-                payload[ros_field] = getattr(ros_msg, ros_field)
-        elif hasattr(ros_msg, '__slots__'):
-            payload = {slot: getattr(ros_msg, slot) for slot in ros_msg.__slots__ if not slot.startswith('_')}
-        elif hasattr(ros_msg, '__dict__'):
-            payload = dict(ros_msg.__dict__)
-
-        if not payload and hasattr(ros_msg, 'data'):
-            payload['data'] = getattr(ros_msg, 'data')
-
+        # The service packs straight from the message's attributes (CanBusService.send_message);
+        # they were checked against the type at construction, so what is left here are value errors
         try:
-            self.service.send(self.binding.key, payload)
+            self.service.send_message(self.binding.key, ros_msg)
         except Exception as exc:
             self.node.get_logger().error(
                 f"Failed to send CAN frame for topic {self.topic}: {exc}",
@@ -72,8 +65,62 @@ class TopicTxBinding:
             self.subscription = None
 
 
+def _deadband(value, key):
+    """``deadband``: None, a number for every field or a ``{field: number}`` mapping."""
+
+    if value is None:
+        return None
+    if isinstance(value, Mapping):
+        return {name: float(band) for name, band in value.items()}
+    if isinstance(value, Real) and not isinstance(value, bool):
+        return float(value)
+    raise ValueError(f"RX binding '{key}': deadband must be a number or a mapping of field to number, got {value!r}")
+
+
+def _setter(path):
+    """``setter(msg, value)`` for ``path`` (``temperature`` or ``vector.x``), checked by the caller."""
+
+    parent, _, leaf = path.rpartition('.')
+    if not parent:
+        return lambda msg, value: setattr(msg, leaf, value)
+    get = attrgetter(parent)
+    return lambda msg, value: setattr(get(msg), leaf, value)
+
+
 class RxBinding:
-    """CAN → ROS: decode a DBC frame and publish to a ROS topic."""
+    """CAN → ROS: decode a DBC frame and publish to a ROS topic.
+
+    When the ROS type has a ``header`` (``sensor_msgs/msg/Temperature``,
+    ``geometry_msgs/msg/Vector3Stamped``, ...) its stamp is the frame's
+    receive timestamp and its ``frame_id`` the binding's ``frame_id``
+    metadata, so subscribers can see how old a value is when it arrives.
+    Field names may be dotted paths into the message, e.g. ``vector.x``;
+    a field the type lacks is a ValueError here rather than a silent skip.
+
+    With ``id_fields`` (masked bindings) the topic may name them, as in
+    ``/td/rs02/{motor_id}/velocity``: one publisher is created per distinct
+    value the first time a frame of it arrives. ID fields the message type
+    has are set on it as well.
+
+    ``publish: frame`` publishes every signal of the frame in one message of
+    the type ``scripts/dbc_to_msgs.py`` generates for the DBC message
+    (``td_can_msgs/msg/RS02Status1`` unless ``type`` or ``msg_package``
+    says otherwise), rather than one topic per signal.
+
+    ``publish_rate_hz`` publishes at most that often, ``on_change`` only
+    when a value differs from the one last published, and ``deadband``
+    (a number, or one per field) only when a number moved by more than
+    that; a deadband implies ``on_change``. They apply per topic, before a
+    message is allocated, and :meth:`stats` counts the frames each dropped.
+
+    ``lazy: true`` publishes only while the topic has subscribers. The
+    count is cached and refreshed on the publisher's matched events (every
+    ``LAZY_POLL_PERIOD`` seconds on rclpy without them). While it is zero
+    the binding is idle in the service, so its frames are not decoded for
+    it and, once every binding of the frame is idle, not received at all
+    with ``auto_filters``. A lazy topic cannot name ID fields, since their
+    publishers only exist once frames arrive.
+    """
 
     def __init__(self, node, service: CanBusService, binding: RxBindingConfig, qos_profile: QoSProfile):
         self.node = node
@@ -82,28 +129,175 @@ class RxBinding:
 
         metadata = dict(binding.metadata)
         self.topic = metadata.get('topic', binding.key)
-        msg_type = resolve_ros_type(metadata.get('type', 'std_msgs/msg/Float32'))
+        self.msg_def = service.dbc.get_message_by_name(binding.message)
+        # (signal, field, convert) of a publish: frame binding; None maps the payload by field name
+        self.frame_fields = None
+        default_type = 'std_msgs/msg/Float32'
+        if metadata.get('publish') == 'frame':
+            if binding.fields:
+                raise ValueError(f"RX binding '{binding.key}': publish: frame takes every signal, drop 'fields'")
+            self.frame_fields = frame_fields(self.msg_def)
+            default_type = f"{metadata.get('msg_package', DEFAULT_PACKAGE)}/msg/{type_name(self.msg_def.name)}"
+        msg_type = resolve_ros_type(metadata.get('type', default_type))
         self.msg_type = msg_type
-        self.pub = node.create_publisher(msg_type, self.topic, qos_profile)
+        self.stamped = hasattr(msg_type(), 'header')
+        self.header_frame_id = metadata.get('frame_id', '')
+        self.qos_profile = qos_profile
+        self.id_fields = tuple(binding.id_fields)
+        self.min_interval = None
+        if metadata.get('publish_rate_hz') is not None:
+            rate = float(metadata['publish_rate_hz'])
+            if rate <= 0:
+                raise ValueError(f"RX binding '{binding.key}': publish_rate_hz must be positive, got {rate}")
+            self.min_interval = 1.0 / rate
+        self.deadband = _deadband(metadata.get('deadband'), binding.key)
+        self.on_change = bool(metadata.get('on_change', False)) or self.deadband is not None
+        self.suppressed = {'rate': 0, 'unchanged': 0}
+        self._published: Dict[tuple, tuple[float, Dict[str, Any]]] = {}  # per ID fields: (time, payload)
+        self.pubs: Dict[str, Any] = {}
+        self.pub = None
+        self.lazy = bool(metadata.get('lazy', False))
+        self.idle = False
+        self._poll = None
+        if self.lazy and '{' in self.topic:
+            raise ValueError(f"RX binding '{binding.key}': lazy needs a topic without ID fields, got {self.topic}")
+        if self.lazy:
+            self.pub = self._lazy_publisher()
+        elif '{' not in self.topic:
+            self.pub = node.create_publisher(msg_type, self.topic, qos_profile)
+
+        # Field paths are resolved against a sample once, so publishing only runs the setters
+        sample = msg_type()
+        self._id_setters = tuple((name, _setter(name)) for name in self.id_fields
+                                 if not missing_attributes(sample, [name]))
+        self._data = False  # one value, published in the type's data
+        self._setters = {}
+        if self.frame_fields is not None:
+            missing = [f for _, f, _ in self.frame_fields if not hasattr(sample, f)]
+            if missing:
+                raise ValueError(f"RX binding '{binding.key}': {metadata.get('type', default_type)} has no "
+                                 f"fields {missing}; regenerate it with scripts/dbc_to_msgs.py")
+        else:
+            names = list(binding.fields.values()) or [s.name for s in self.msg_def.signals]
+            self._data = hasattr(sample, 'data') and len(names) == 1
+            if not self._data:
+                missing = missing_attributes(sample, names)
+                if missing:
+                    raise ValueError(f"RX binding '{binding.key}': {metadata.get('type', default_type)} has no "
+                                     f"fields {missing}")
+                self._setters = {name: _setter(name) for name in names}
 
         service.register_rx_binding(binding, self._handle_frame)
-        self.msg_def = service.dbc.get_message_by_name(binding.message)
         self.frame_id = self.msg_def.frame_id
         node.get_logger().info(
             f"RX bind: DBC:{self.msg_def.name} (id=0x{self.frame_id:X}) -> {self.topic}"
+            + (" (stamped)" if self.stamped else "") + (" (lazy)" if self.lazy else "")
         )
+        if self.lazy:
+            self._set_subscribers(self.pub.get_subscription_count())
+
+    def _lazy_publisher(self):
+        """The topic's publisher, with a matched event callback where rclpy and the RMW have one."""
+
+        try:
+            from rclpy.event_handler import PublisherEventCallbacks
+            callbacks = PublisherEventCallbacks(matched=self._on_matched)
+            return self.node.create_publisher(self.msg_type, self.topic, self.qos_profile, event_callbacks=callbacks)
+        except Exception:  # no rclpy.event_handler, no matched field, or the RMW lacks the event
+            pub = self.node.create_publisher(self.msg_type, self.topic, self.qos_profile)
+            self._poll = self.node.create_timer(LAZY_POLL_PERIOD, self._on_poll)
+            return pub
+
+    def _on_matched(self, info):
+        self._set_subscribers(info.current_count)
 
-    def _handle_frame(self, payload: Dict[str, Any], binding: RxBindingConfig):
+    def _on_poll(self):
+        if self.pub is not None:
+            self._set_subscribers(self.pub.get_subscription_count())
+
+    def _set_subscribers(self, count: int):
+        idle = count == 0
+        if idle == self.idle:
+            return
+        self.idle = idle
+        if not idle:
+            self._published.clear()  # on_change: a new subscriber gets the current values
+        self.service.set_rx_idle(self.binding.key, idle)
+        self.node.get_logger().debug(f"RX bind {self.topic}: {'no subscribers, idle' if idle else f'{count} subscribers'}")
+
+    def _handle_frame(self, payload: Dict[str, Any], binding: RxBindingConfig, timestamp: float):
+        ids = {name: payload.pop(name) for name in self.id_fields}
+        if (self.min_interval is not None or self.on_change) and not self._due(tuple(ids.values()), payload):
+            return
+        pub = self.pub or self._publisher(ids)
         msg = self.msg_type()
-        if hasattr(msg, 'data') and len(payload) == 1:
+        for field, setter in self._id_setters:
+            setter(msg, ids[field])
+        if self.stamped:
+            sec = int(timestamp)
+            msg.header.stamp.sec = sec
+            msg.header.stamp.nanosec = int((timestamp - sec) * 1e9)
+            msg.header.frame_id = self.header_frame_id
+        if self.frame_fields is not None:
+            for signal, field, convert in self.frame_fields:
+                value = payload.get(signal)
+                if value is not None:  # a multiplexed signal absent from this frame
+                    setattr(msg, field, convert(value))
+        elif self._data:
             msg.data = next(iter(payload.values()))
         else:
+            setters = self._setters
             for field, value in payload.items():
-                if hasattr(msg, field):
-                    setattr(msg, field, value)
-        self.pub.publish(msg)
+                setters[field](msg, value)
+        pub.publish(msg)
+
+    def _due(self, key: tuple, payload: Dict[str, Any]) -> bool:
+        """Whether ``payload`` passes the rate limit and change filter of its topic; records it if so."""
+
+        now = time.monotonic()
+        last = self._published.get(key)
+        if last is not None:
+            if self.on_change and not self._changed(last[1], payload):
+                self.suppressed['unchanged'] += 1
+                return False
+            if self.min_interval is not None and now - last[0] < self.min_interval:
+                self.suppressed['rate'] += 1
+                return False
+        self._published[key] = (now, dict(payload))
+        return True
+
+    def _changed(self, old: Dict[str, Any], new: Dict[str, Any]) -> bool:
+        for name, value in new.items():
+            before = old.get(name)
+            if (self.deadband is not None and isinstance(value, Real) and isinstance(before, Real)
+                    and not isinstance(value, bool)):
+                band = self.deadband.get(name, 0.0) if isinstance(self.deadband, Mapping) else self.deadband
+                if abs(value - before) > band:
+                    return True
+            elif value != before:
+                return True
+        return False
+
+    def stats(self) -> Dict[str, int]:
+        """Frames not published because of ``publish_rate_hz`` (``rate``) or ``on_change`` (``unchanged``)."""
+
+        return dict(self.suppressed)
+
+    def _publisher(self, ids: Dict[str, Any]):
+        topic = self.topic.format(**ids)
+        pub = self.pubs.get(topic)
+        if pub is None:
+            pub = self.pubs[topic] = self.node.create_publisher(self.msg_type, topic, self.qos_profile)
+            self.node.get_logger().info(f"RX bind: DBC:{self.msg_def.name} (id=0x{self.frame_id:X}) -> {topic}")
+        return pub
 
     def shutdown(self):
+        if self._poll is not None:
+            self.node.destroy_timer(self._poll)
+            self._poll = None
         if self.pub:
             self.node.destroy_publisher(self.pub)
             self.pub = None
+        for pub in self.pubs.values():
+            self.node.destroy_publisher(pub)
+        self.pubs = {}
@@ -0,0 +1,227 @@
+"""Frames of several buses merged into one stream in timestamp order, and per-cycle snapshots of it.
+
+Each :class:`CanBusService` runs its handlers on its own RX thread, so
+joint feedback on one bus and foot forces on another reach a controller in
+no common order. :class:`StreamMerger` registers an RX binding per source
+on any number of services and hands the decoded frames on from one thread
+of its own, in receive-timestamp order::
+
+    merger = StreamMerger(max_delay=0.002, period=0.001, on_snapshot=controller.step)
+    merger.add(motor_bus, "motors", "RS02_Feedback", id_mask=0x1F000000, id_fields={"motor_id": (8, 15)})
+    merger.add(sensor_bus, "foot", "FootForce")
+    merger.start()
+
+* A bus's socket delivers its frames in timestamp order, so the newest
+  timestamp of every bus is its watermark. A frame is released once every
+  bus has passed its timestamp. A frame that has waited ``max_delay``
+  seconds is released anyway, so a quiet bus cannot hold the others back:
+  ``max_delay`` bounds the latency the merge adds. A frame older than one
+  already released is dropped and counted as ``late``.
+* ``on_frame(key, payload, timestamp)`` gets every released frame.
+* With ``period`` the stream is cut into cycles on a grid of that many
+  seconds. Once the stream passes the end of a cycle, ``on_snapshot``
+  receives a :class:`Snapshot` of the latest payload of every source at
+  that time. A gap of several cycles yields one snapshot, of the last one,
+  and the cycles skipped are counted.
+
+The timestamps must share a clock. Use the same ``rx_timestamps`` on every
+bus: ``software`` everywhere, or ``hardware`` on adapters whose driver puts
+the hardware time on the system clock. Callbacks run on the merger's
+thread, one at a time.
+"""
+
+from __future__ import annotations
+
+import heapq
+import itertools
+import logging
+import math
+import threading
+import time
+from dataclasses import dataclass
+from typing import Any, Callable, Dict, List, Mapping, Optional, Tuple
+
+from .service import CanBusService, RxBindingConfig
+
+LOG = logging.getLogger(__name__)
+
+DEFAULT_MAX_DELAY = 0.005
+
+
+@dataclass(frozen=True)
+class Snapshot:
+    """Latest state of every source at ``time``.
+
+    ``values[key]`` is the payload, or for a source with ``id_fields`` a
+    mapping of device ID to payload. ``stamps`` has the same shape, with
+    the payloads' timestamps.
+    """
+
+    time: float
+    values: Mapping[str, Any]
+    stamps: Mapping[str, Any]
+
+
+class _Bus:
+    __slots__ = ("service", "watermark")
+
+    def __init__(self, service: CanBusService):
+        self.service = service
+        self.watermark = -math.inf   # newest timestamp received
+
+
+class StreamMerger:
+    """Time-ordered frames of several buses, released by watermark or after ``max_delay``."""
+
+    def __init__(
+        self,
+        max_delay: float = DEFAULT_MAX_DELAY,
+        period: Optional[float] = None,
+        on_frame: Optional[Callable[[str, Dict[str, Any], float], None]] = None,
+        on_snapshot: Optional[Callable[[Snapshot], None]] = None,
+    ):
+        if max_delay <= 0 or (period is not None and period <= 0):
+            raise ValueError("max_delay and period must be positive")
+        self.max_delay = max_delay
+        self.period = period
+        self.on_frame = on_frame
+        self.on_snapshot = on_snapshot
+        self._buses: Dict[str, _Bus] = {}
+        self._sources: List[Tuple[CanBusService, str]] = []
+        self._ids: Dict[str, Optional[Tuple[str, ...]]] = {}   # key -> ID fields of the source
+        self._heap: List[tuple] = []   # (timestamp, seq, key, payload, arrival)
+        self._seq = itertools.count()
+        self._cond = threading.Condition()
+        self._running = False
+        self._thread: Optional[threading.Thread] = None
+        # Merger thread only
+        self._released = -math.inf
+        self._cycle_end: Optional[float] = None
+        self._values: Dict[str, Any] = {}
+        self._stamps: Dict[str, Any] = {}
+        self.frames = self.late = self.forced = self.snapshots = self.skipped = 0
+        self.delay_max = 0.0            # seconds a frame waited in the merge, worst seen
+
+    def add(self, service: CanBusService, key: str, message: str, fields: Optional[Mapping[str, str]] = None,
+            can_id: Optional[int] = None, id_mask: Optional[int] = None,
+            id_fields: Optional[Mapping[str, Tuple[int, int]]] = None) -> None:
+        """Merge ``message`` of ``service`` as source ``key``; fields as in an ``rx_frames`` entry."""
+
+        if key in self._ids:
+            raise ValueError(f"merge source '{key}' is already added")
+        binding = RxBindingConfig(key=f"merge/{key}", message=message, fields=dict(fields or {}), can_id=can_id,
+                                  id_mask=id_mask, id_fields=dict(id_fields or {}))
+        bus = self._buses.setdefault(service.cfg.name, _Bus(service))
+        self._ids[key] = tuple(binding.id_fields) or None
+        service.register_rx_binding(binding, self._handler(bus, key))
+        self._sources.append((service, binding.key))
+
+    def _handler(self, bus: _Bus, key: str):
+        def handler(payload: Dict[str, Any], binding: RxBindingConfig, timestamp: float) -> None:
+            with self._cond:
+                heapq.heappush(self._heap, (timestamp, next(self._seq), key, payload, time.monotonic()))
+                if timestamp > bus.watermark:
+                    bus.watermark = timestamp
+                self._cond.notify()
+
+        return handler
+
+    def start(self) -> None:
+        if self._thread is not None:
+            return
+        self._running = True
+        self._thread = threading.Thread(target=self._run, name="stream-merger", daemon=True)
+        self._thread.start()
+
+    def stop(self) -> None:
+        with self._cond:
+            self._running = False
+            self._cond.notify()
+        if self._thread is not None:
+            self._thread.join(timeout=1.0)
+            self._thread = None
+        for service, binding_key in self._sources:
+            service.unregister_rx_binding(binding_key)
+        self._sources = []
+
+    def stats(self) -> Dict[str, Any]:
+        return {"frames": self.frames, "late": self.late, "forced": self.forced, "snapshots": self.snapshots,
+                "skipped_cycles": self.skipped, "queued": len(self._heap), "delay_ms_max": self.delay_max * 1e3}
+
+    def _take(self) -> Tuple[List[tuple], float, Optional[float]]:
+        """Under the lock: the frames due, the watermark, and when the next one is due by age."""
+
+        watermark = min((bus.watermark for bus in self._buses.values()), default=-math.inf)
+        oldest = time.monotonic() - self.max_delay
+        due = []
+        heap = self._heap
+        while heap and (heap[0][0] <= watermark or heap[0][4] <= oldest):
+            entry = heapq.heappop(heap)
+            if entry[0] > watermark:
+                self.forced += 1
+            due.append(entry)
+        wake = heap[0][4] + self.max_delay if heap else None
+        return due, watermark, wake
+
+    def _run(self) -> None:
+        while True:
+            with self._cond:
+                due, watermark, wake = self._take()
+                while self._running and not due:
+                    self._cond.wait(None if wake is None else max(wake - time.monotonic(), 0.0))
+                    due, watermark, wake = self._take()
+                if not self._running:
+                    return
+            now = time.monotonic()
+            for timestamp, _, key, payload, arrival in due:
+                self._release(timestamp, key, payload)
+                self.delay_max = max(self.delay_max, now - arrival)
+            if self.period is not None:
+                self._close_cycles(watermark)
+
+    def _release(self, timestamp: float, key: str, payload: Dict[str, Any]) -> None:
+        if timestamp < self._released:
+            self.late += 1
+            return
+        if self.period is not None:
+            self._close_cycles(timestamp)
+        self._released = timestamp
+        ids = self._ids[key]
+        if ids is None:
+            self._values[key], self._stamps[key] = payload, timestamp
+        else:
+            ident = payload.get(ids[0]) if len(ids) == 1 else tuple(payload.get(name) for name in ids)
+            self._values.setdefault(key, {})[ident] = payload
+            self._stamps.setdefault(key, {})[ident] = timestamp
+        self.frames += 1
+        if self.on_frame is not None:
+            try:
+                self.on_frame(key, payload, timestamp)
+            except Exception:
+                LOG.exception("merge frame callback failed")
+
+    def _close_cycles(self, through: float) -> None:
+        """The snapshot of the cycles that end at or before ``through``; nothing older can still come."""
+
+        if through == -math.inf:
+            return
+        if self._cycle_end is None:
+            self._cycle_end = (math.floor(through / self.period) + 1) * self.period
+            return
+        ended = math.floor((through - self._cycle_end) / self.period) + 1
+        if ended <= 0:
+            return
+        self.skipped += ended - 1
+        end = self._cycle_end + (ended - 1) * self.period
+        self._cycle_end = end + self.period
+        values = {k: dict(v) if self._ids[k] else v for k, v in self._values.items()}
+        stamps = {k: dict(v) if self._ids[k] else v for k, v in self._stamps.items()}
+        self.snapshots += 1
+        if self.on_snapshot is not None:
+            try:
+                self.on_snapshot(Snapshot(end, values, stamps))
+            except Exception:
+                LOG.exception("merge snapshot callback failed")
+
+
+__all__ = ["DEFAULT_MAX_DELAY", "Snapshot", "StreamMerger"]
@@ -0,0 +1,341 @@
+"""Per-bus performance counters and their Prometheus export.
+
+A bus with ``metrics`` enabled gives its ``CanBusService`` a
+:class:`BusMetrics`: frame counters, decode and handler errors, and
+histograms of decode time per DBC message, handler time per RX binding and
+TX queueing delay per TX class.
+:meth:`CanBusService.metrics_snapshot` adds what is read from live objects
+at that moment: handler queue depths, the kernel's ``SO_RXQ_OVFL`` count
+of frames dropped because the socket buffer was full, and the controller
+state and error frame counts of :mod:`td_can_bridges.bus_errors`.
+
+:class:`MetricsServer` serves the snapshots of a set of services in the
+Prometheus text format; the ROS bridge also publishes them as
+``diagnostic_msgs/DiagnosticArray``. Only the standard library is used.
+
+Counters are plain integers bumped by the thread that does the work, and
+read without locking; a scrape may see one bus a frame ahead of another.
+"""
+
+from __future__ import annotations
+
+import logging
+import threading
+from bisect import bisect_left
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from typing import Any, Callable, Dict, List, Mapping, Tuple
+
+from .bus_errors import STATES
+
+LOG = logging.getLogger(__name__)
+
+# Upper bounds in seconds, from a compiled decoder (a few µs) to a ROS publish blocked on QoS
+DEFAULT_BUCKETS = (5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3, 1e-2, 5e-2, 0.1)
+
+
+class Histogram:
+    """Counts of observations per bucket, plus their sum."""
+
+    __slots__ = ("bounds", "counts", "total", "count")
+
+    def __init__(self, bounds: Tuple[float, ...] = DEFAULT_BUCKETS):
+        self.bounds = bounds
+        self.counts = [0] * (len(bounds) + 1)  # the last one is +Inf
+        self.total = 0.0
+        self.count = 0
+
+    def observe(self, value: float) -> None:
+        self.counts[bisect_left(self.bounds, value)] += 1
+        self.total += value
+        self.count += 1
+
+    def snapshot(self) -> Dict[str, Any]:
+        cumulative, running = [], 0
+        for count in self.counts:
+            running += count
+            cumulative.append(running)
+        return {"buckets": list(zip(self.bounds + (float("inf"),), cumulative)),
+                "sum": self.total, "count": self.count}
+
+
+class BusMetrics:
+    """Counters and histograms of one bus, updated by the service's threads."""
+
+    def __init__(self, name: str):
+        self.name = name
+        self.rx_frames = 0       # frames read from the socket
+        self.tx_frames = 0       # frames written by send()/send_many(); BCM cycles are the kernel's
+        self.decode_errors = 0
+        self.handler_errors = 0
+        self.decode: Dict[str, Histogram] = {}   # DBC message -> seconds per decode
+        self.handler: Dict[str, Histogram] = {}  # RX binding key -> seconds per handler call
+        self.tx_queue: Dict[str, Histogram] = {}  # TX class -> seconds from send() to the socket
+
+    def decode_histogram(self, message: str) -> Histogram:
+        hist = self.decode.get(message)
+        if hist is None:
+            hist = self.decode[message] = Histogram()
+        return hist
+
+    def handler_histogram(self, key: str) -> Histogram:
+        hist = self.handler.get(key)
+        if hist is None:
+            hist = self.handler[key] = Histogram()
+        return hist
+
+    def tx_queue_histogram(self, tx_class: str) -> Histogram:
+        hist = self.tx_queue.get(tx_class)
+        if hist is None:
+            hist = self.tx_queue[tx_class] = Histogram()
+        return hist
+
+    def snapshot(self) -> Dict[str, Any]:
+        return {
+            "rx_frames": self.rx_frames,
+            "tx_frames": self.tx_frames,
+            "decode_errors": self.decode_errors,
+            "handler_errors": self.handler_errors,
+            "decode_seconds": {name: h.snapshot() for name, h in list(self.decode.items())},
+            "handler_seconds": {key: h.snapshot() for key, h in list(self.handler.items())},
+            "tx_queue_seconds": {name: h.snapshot() for name, h in list(self.tx_queue.items())},
+        }
+
+
+def _labels(**labels: str) -> str:
+    def escape(value: str) -> str:
+        return str(value).replace("\\", "\\\\").replace('"', '\\"').replace("\n", "\\n")
+
+    return "{" + ",".join(f'{k}="{escape(v)}"' for k, v in labels.items()) + "}"
+
+
+def _bound(value: float) -> str:
+    return "+Inf" if value == float("inf") else repr(value)
+
+
+_COUNTERS = (
+    ("rx_frames", "td_can_rx_frames_total", "Frames read from the CAN socket."),
+    ("tx_frames", "td_can_tx_frames_total", "Frames written to the CAN socket by send() and send_many()."),
+    ("rx_overflow", "td_can_rx_overflow_drops_total", "Frames the kernel dropped on a full socket buffer (SO_RXQ_OVFL)."),
+    ("decode_errors", "td_can_decode_errors_total", "Frames that failed to decode."),
+    ("handler_errors", "td_can_handler_errors_total", "RX handler calls that raised."),
+    ("bus_bits", "td_can_bus_bits_total", "Worst-case bits of every frame on the interface, from its kernel counters."),
+)
+
+
+def render_prometheus(snapshots: Mapping[str, Mapping[str, Any]]) -> str:
+    """Prometheus text exposition of ``{bus name: CanBusService.metrics_snapshot()}``."""
+
+    out: List[str] = []
+    for field_name, metric, help_text in _COUNTERS:
+        out.append(f"# HELP {metric} {help_text}")
+        out.append(f"# TYPE {metric} counter")
+        for bus, snap in snapshots.items():
+            if field_name in snap:  # bus_bits is missing where sysfs has no counters
+                out.append(f"{metric}{_labels(bus=bus)} {snap[field_name]}")
+
+    for field_name, metric, help_text in (
+        ("bitrate", "td_can_bitrate", "Nominal bitrate of the bus."),
+        ("bus_load_projected", "td_can_bus_load_projected", "Worst-case share of the bitrate the config declares."),
+    ):
+        out.append(f"# HELP {metric} {help_text}")
+        out.append(f"# TYPE {metric} gauge")
+        for bus, snap in snapshots.items():
+            if field_name in snap:
+                out.append(f"{metric}{_labels(bus=bus)} {snap[field_name]!r}")
+
+    for field_name, metric, label, help_text in (
+        ("decode_seconds", "td_can_decode_seconds", "message", "Time to decode one frame, per DBC message."),
+        ("handler_seconds", "td_can_handler_seconds", "binding", "Time in one RX handler call, per binding."),
+        ("tx_queue_seconds", "td_can_tx_queue_seconds", "class", "Time a frame waited in the TX queue, per class."),
+    ):
+        out.append(f"# HELP {metric} {help_text}")
+        out.append(f"# TYPE {metric} histogram")
+        for bus, snap in snapshots.items():
+            for name, hist in snap.get(field_name, {}).items():
+                for bound, count in hist["buckets"]:
+                    out.append(f"{metric}_bucket{_labels(bus=bus, **{label: name}, le=_bound(bound))} {count}")
+                out.append(f"{metric}_sum{_labels(bus=bus, **{label: name})} {hist['sum']!r}")
+                out.append(f"{metric}_count{_labels(bus=bus, **{label: name})} {hist['count']}")
+
+    out.append("# HELP td_can_executor_latency_seconds How late the executor ran a timer of the bus's callback group.")
+    out.append("# TYPE td_can_executor_latency_seconds histogram")
+    for bus, snap in snapshots.items():
+        hist = snap.get("executor_latency_seconds")  # set by the ROS bridge's BusWorker
+        if hist is not None:
+            for bound, count in hist["buckets"]:
+                out.append(f"td_can_executor_latency_seconds_bucket{_labels(bus=bus, le=_bound(bound))} {count}")
+            out.append(f"td_can_executor_latency_seconds_sum{_labels(bus=bus)} {hist['sum']!r}")
+            out.append(f"td_can_executor_latency_seconds_count{_labels(bus=bus)} {hist['count']}")
+
+    for field_name, metric, kind, help_text in (
+        ("depth", "td_can_rx_queue_depth", "gauge", "Frames waiting in a binding's handler queue."),
+        ("max_depth", "td_can_rx_queue_max_depth", "gauge", "Deepest the binding's handler queue has been."),
+        ("dropped", "td_can_rx_queue_dropped_total", "counter", "Frames dropped by a full handler queue."),
+    ):
+        out.append(f"# HELP {metric} {help_text}")
+        out.append(f"# TYPE {metric} {kind}")
+        for bus, snap in snapshots.items():
+            for key, stats in snap.get("queues", {}).items():
+                out.append(f"{metric}{_labels(bus=bus, binding=key)} {stats[field_name]}")
+
+    out.append("# HELP td_can_rx_publish_suppressed_total Frames an RX binding did not publish, per reason.")
+    out.append("# TYPE td_can_rx_publish_suppressed_total counter")
+    for bus, snap in snapshots.items():
+        for key, stats in snap.get("publish_suppressed", {}).items():  # set by the ROS bridge's BusWorker
+            for reason, count in stats.items():
+                out.append(f"td_can_rx_publish_suppressed_total{_labels(bus=bus, binding=key, reason=reason)} {count}")
+
+    losses = {bus: snap["frame_loss"] for bus, snap in snapshots.items() if snap.get("frame_loss")}
+    out.append("# HELP td_can_rx_lost_frames_total Periodic frames of an RX binding that never arrived, per stage.")
+    out.append("# TYPE td_can_rx_lost_frames_total counter")
+    for bus, bindings in losses.items():
+        for key, stats in bindings.items():
+            for stage, count in stats["stages"].items():
+                out.append(f"td_can_rx_lost_frames_total{_labels(bus=bus, binding=key, stage=stage)} {count}")
+    out.append("# HELP td_can_rx_loss_ratio Share of an RX binding's expected frames that were lost.")
+    out.append("# TYPE td_can_rx_loss_ratio gauge")
+    for bus, bindings in losses.items():
+        for key, stats in bindings.items():
+            out.append(f"td_can_rx_loss_ratio{_labels(bus=bus, binding=key)} {stats['loss_rate']!r}")
+
+    uplinks = {bus: snap["uplink"] for bus, snap in snapshots.items() if snap.get("uplink")}
+    for field_name, metric, kind, help_text in (
+        ("sent_frames", "td_can_uplink_frames_total", "counter", "Frames the uplink sent to the base station."),
+        ("thinned_frames", "td_can_uplink_thinned_frames_total", "counter", "Frames the uplink left out to stay in budget."),
+        ("dropped_chunks", "td_can_uplink_dropped_chunks_total", "counter", "Uplink chunks over budget or not sent."),
+        ("bytes", "td_can_uplink_bytes_total", "counter", "Bytes the uplink sent, IP and UDP headers included."),
+        ("thinning", "td_can_uplink_thinning", "gauge", "The uplink keeps one frame in this many of each thinned ID."),
+    ):
+        out.append(f"# HELP {metric} {help_text}")
+        out.append(f"# TYPE {metric} {kind}")
+        for bus, stats in uplinks.items():
+            out.append(f"{metric}{_labels(bus=bus)} {stats[field_name]}")
+
+    out.append("# HELP td_can_gateway_frames_total Frames of a can-gw route: forwarded (handled), dropped, deleted.")
+    out.append("# TYPE td_can_gateway_frames_total counter")
+    for bus, snap in snapshots.items():
+        for route, stats in snap.get("gateway", {}).items():
+            for result in ("handled", "dropped", "deleted"):
+                out.append(f"td_can_gateway_frames_total{_labels(bus=bus, route=route, result=result)} {stats[result]}")
+
+    for field_name, metric, kind, help_text in (
+        ("calls", "td_can_profile_calls_total", "counter", "Calls of a binding's stage, profiled or not."),
+        ("cpu_s", "td_can_profile_cpu_seconds_total", "counter", "CPU time of a binding's stage, scaled from the samples."),
+        ("wall_s", "td_can_profile_wall_seconds_total", "counter", "Wall time of a binding's stage, scaled from the samples."),
+        ("alloc_bytes", "td_can_profile_alloc_bytes", "gauge", "Bytes a traced call still held when it returned, mean."),
+        ("alloc_peak_bytes", "td_can_profile_alloc_peak_bytes", "gauge", "Most bytes a traced call held at once, mean."),
+    ):
+        out.append(f"# HELP {metric} {help_text}")
+        out.append(f"# TYPE {metric} {kind}")
+        for bus, snap in snapshots.items():
+            for stage, keys in snap.get("profile", {}).items():
+                for key, stats in keys.items():
+                    if field_name in stats:
+                        out.append(f"{metric}{_labels(bus=bus, stage=stage, key=key)} {stats[field_name]!r}")
+
+    shedding = {bus: snap["shedding"] for bus, snap in snapshots.items() if snap.get("shedding")}
+    for field_name, metric, help_text in (
+        ("level", "td_can_rx_shed_level", "Priority classes of RX bindings shed because the bus fell behind."),
+        ("lag_ms", "td_can_rx_lag_ms", "Mean time from a frame's kernel timestamp to its bindings, last window."),
+    ):
+        out.append(f"# HELP {metric} {help_text}")
+        out.append(f"# TYPE {metric} gauge")
+        for bus, stats in shedding.items():
+            out.append(f"{metric}{_labels(bus=bus)} {stats[field_name]!r}")
+    out.append("# HELP td_can_rx_shed_frames_total Frames an RX binding skipped while shed.")
+    out.append("# TYPE td_can_rx_shed_frames_total counter")
+    for bus, stats in shedding.items():
+        for key, count in stats["shed_frames"].items():
+            out.append(f"td_can_rx_shed_frames_total{_labels(bus=bus, binding=key)} {count}")
+
+    for field_name, metric, kind, help_text in (
+        ("depth", "td_can_tx_queue_depth", "gauge", "Frames waiting in a TX class."),
+        ("max_depth", "td_can_tx_queue_max_depth", "gauge", "Deepest the TX class has been."),
+        ("dropped", "td_can_tx_queue_dropped_total", "counter", "Frames dropped by a full TX class."),
+    ):
+        out.append(f"# HELP {metric} {help_text}")
+        out.append(f"# TYPE {metric} {kind}")
+        for bus, snap in snapshots.items():
+            for name, stats in snap.get("tx_classes", {}).items():
+                out.append(f"{metric}{_labels(bus=bus, **{'class': name})} {stats[field_name]}")
+
+    for field_name, metric, help_text in (
+        ("frames", "td_can_recorder_frames_total", "Frames the recorder wrote to its file."),
+        ("dropped", "td_can_recorder_dropped_total", "Frames the recorder dropped on a full ring."),
+    ):
+        out.append(f"# HELP {metric} {help_text}")
+        out.append(f"# TYPE {metric} counter")
+        for bus, snap in snapshots.items():
+            if "recorder" in snap:
+                out.append(f"{metric}{_labels(bus=bus)} {snap['recorder'][field_name]}")
+
+    errors = {bus: snap["bus_errors"] for bus, snap in snapshots.items() if "bus_errors" in snap}
+    out.append("# HELP td_can_bus_state 1 for the controller state the bus is in, from its error frames.")
+    out.append("# TYPE td_can_bus_state gauge")
+    for bus, stats in errors.items():
+        for state in STATES:
+            out.append(f"td_can_bus_state{_labels(bus=bus, state=state)} {int(stats['state'] == state)}")
+    out.append("# HELP td_can_bus_state_seconds_total Seconds the bus spent in each controller state.")
+    out.append("# TYPE td_can_bus_state_seconds_total counter")
+    for bus, stats in errors.items():
+        for state, seconds in stats["time_in_state"].items():
+            out.append(f"td_can_bus_state_seconds_total{_labels(bus=bus, state=state)} {seconds!r}")
+    out.append("# HELP td_can_error_frames_total Error frames received, per error class.")
+    out.append("# TYPE td_can_error_frames_total counter")
+    for bus, stats in errors.items():
+        for name, count in stats["errors"].items():
+            out.append(f"td_can_error_frames_total{_labels(bus=bus, **{'class': name})} {count}")
+    for field_name, metric, kind, help_text in (
+        ("tx_error_counter", "td_can_tx_error_counter", "gauge", "Controller's transmit error counter, last reported."),
+        ("rx_error_counter", "td_can_rx_error_counter", "gauge", "Controller's receive error counter, last reported."),
+        ("recoveries", "td_can_bus_recoveries_total", "counter", "Times the bus was reopened after losing its interface."),
+    ):
+        out.append(f"# HELP {metric} {help_text}")
+        out.append(f"# TYPE {metric} {kind}")
+        for bus, stats in errors.items():
+            out.append(f"{metric}{_labels(bus=bus)} {stats[field_name]}")
+    return "\n".join(out) + "\n"
+
+
+class MetricsServer:
+    """``GET /metrics`` on ``port`` returns :func:`render_prometheus` of ``snapshots()``.
+
+    ``snapshots`` is called per scrape, so buses added or restarted by a
+    config reload show up without restarting the server.
+    """
+
+    def __init__(self, port: int, snapshots: Callable[[], Mapping[str, Mapping[str, Any]]], host: str = ""):
+        class Handler(BaseHTTPRequestHandler):
+            def do_GET(self):  # noqa: N802 - http.server naming
+                if self.path.split("?")[0] not in ("/", "/metrics"):
+                    self.send_error(404)
+                    return
+                try:
+                    body = render_prometheus(snapshots()).encode()
+                except Exception:
+                    LOG.exception("metrics snapshot failed")
+                    self.send_error(500)
+                    return
+                self.send_response(200)
+                self.send_header("Content-Type", "text/plain; version=0.0.4; charset=utf-8")
+                self.send_header("Content-Length", str(len(body)))
+                self.end_headers()
+                self.wfile.write(body)
+
+            def log_message(self, format, *args):  # scrapes every few seconds would flood the log
+                LOG.debug("metrics: " + format, *args)
+
+        self._server = ThreadingHTTPServer((host, port), Handler)
+        self._server.daemon_threads = True
+        self.port = self._server.server_address[1]
+        self._thread = threading.Thread(target=self._server.serve_forever, name="td-can-metrics", daemon=True)
+        self._thread.start()
+        LOG.info("Prometheus metrics on port %d", self.port)
+
+    def close(self) -> None:
+        self._server.shutdown()
+        self._server.server_close()
+        self._thread.join(timeout=1.0)
+
+
+__all__ = ["BusMetrics", "DEFAULT_BUCKETS", "Histogram", "MetricsServer", "render_prometheus"]
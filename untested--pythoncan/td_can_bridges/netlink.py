@@ -0,0 +1,89 @@
+"""Minimal rtnetlink client: requests with the kernel's acknowledgement, dumps and attributes.
+
+Shared by :mod:`td_can_bridges.can_gateway` (``can-gw`` rules) and
+:mod:`td_can_bridges.socket_buffers` (``txqueuelen``). Standard library
+only; most requests need ``CAP_NET_ADMIN``.
+"""
+
+from __future__ import annotations
+
+import os
+import socket
+import struct
+from typing import Iterator, List, Tuple
+
+NLM_F_REQUEST, NLM_F_ACK, NLM_F_DUMP = 0x1, 0x4, 0x300
+NLMSG_ERROR, NLMSG_DONE = 2, 3
+
+_NLMSG = struct.Struct("=IHHII")
+_NLATTR = struct.Struct("=HH")
+
+
+def attr(kind: int, payload: bytes) -> bytes:
+    """One netlink attribute, padded to 4 bytes."""
+
+    size = _NLATTR.size + len(payload)
+    return _NLATTR.pack(size, kind) + payload + b"\0" * (-size % 4)
+
+
+def attrs(data: bytes) -> List[Tuple[int, bytes]]:
+    """The ``(kind, payload)`` attributes packed in ``data``, nesting flags cleared."""
+
+    out, offset = [], 0
+    while offset + _NLATTR.size <= len(data):
+        size, kind = _NLATTR.unpack_from(data, offset)
+        if size < _NLATTR.size:
+            break
+        out.append((kind & 0x3FFF, data[offset + _NLATTR.size:offset + size]))
+        offset += (size + 3) & ~3
+    return out
+
+
+class Netlink:
+    """One rtnetlink socket, for a few requests."""
+
+    def __init__(self):
+        self.sock = socket.socket(socket.AF_NETLINK, socket.SOCK_RAW, socket.NETLINK_ROUTE)
+        self.sock.bind((0, 0))
+        self.seq = 0
+
+    def close(self) -> None:
+        self.sock.close()
+
+    def _send(self, kind: int, flags: int, body: bytes) -> int:
+        self.seq += 1
+        self.sock.send(_NLMSG.pack(_NLMSG.size + len(body), kind, flags, self.seq, 0) + body)
+        return self.seq
+
+    def _replies(self, seq: int) -> Iterator[Tuple[int, bytes]]:
+        while True:
+            data = self.sock.recv(65536)
+            offset = 0
+            while offset + _NLMSG.size <= len(data):
+                size, kind, _, reply_seq, _ = _NLMSG.unpack_from(data, offset)
+                body = data[offset + _NLMSG.size:offset + size]
+                offset += (size + 3) & ~3
+                if reply_seq != seq:
+                    continue
+                if kind == NLMSG_DONE:
+                    return
+                if kind == NLMSG_ERROR:
+                    code = -struct.unpack_from("=i", body)[0]
+                    if code:
+                        raise OSError(code, os.strerror(code))
+                    return
+                yield kind, body
+
+    def request(self, kind: int, flags: int, body: bytes) -> None:
+        """Send and wait for the kernel's acknowledgement; raises OSError on its error."""
+
+        for _ in self._replies(self._send(kind, flags | NLM_F_REQUEST | NLM_F_ACK, body)):
+            pass
+
+    def dump(self, kind: int, body: bytes) -> List[Tuple[int, bytes]]:
+        """Every ``(message type, body)`` the kernel returns for a dump request."""
+
+        return list(self._replies(self._send(kind, NLM_F_REQUEST | NLM_F_DUMP, body)))
+
+
+__all__ = ["NLM_F_ACK", "NLM_F_DUMP", "NLM_F_REQUEST", "NLMSG_DONE", "NLMSG_ERROR", "Netlink", "attr", "attrs"]
@@ -0,0 +1,244 @@
+"""Capture of every frame on CAN interfaces through a memory-mapped AF_PACKET ring (TPACKET_V3).
+
+A raw CAN socket costs a system call per wakeup and a trip through the
+interpreter per frame before the recorder sees it. An ``AF_PACKET`` socket
+with a ``TPACKET_V3`` receive ring instead has the kernel write each frame,
+with its receive timestamp, straight into blocks of memory shared with this
+process. A block is handed over when it is full or ``retire_ms`` after its
+first frame, and :meth:`PacketCapture.read` walks it in place: no system
+call per frame, one slice per frame for the writer, and the block goes back
+to the kernel once it is read. Nothing waits on the bus's RX loop either.
+
+The ring sees what ``candump`` sees: every frame of the interface, error
+frames included and no ``CAN_RAW`` filters, plus the frames any socket on
+this host sends (their loopback echo, once: the outgoing copy is skipped).
+A full ring drops frames in the kernel, counted in ``dropped``.
+
+A recorder with ``capture`` reads its bus through one of these, and
+``scripts/can_compact_log.py record`` writes several interfaces into one
+compact log::
+
+    recorder:
+      path: /var/log/td_can/{bus}.tdlog
+      capture: packet                                  # or {block_kb: 1024, blocks: 16, retire_ms: 10}
+
+Needs ``CAP_NET_RAW``. Timestamps are the kernel's receive time
+(``CLOCK_REALTIME``, as the sockets' software stamps). Standard library
+only.
+"""
+
+from __future__ import annotations
+
+import mmap
+import select
+import socket
+import struct
+from pathlib import Path
+from typing import Any, Dict, List, Mapping, Optional, Sequence, Tuple
+
+from .socketcan_rx import CAN_MTU, CANFD_MTU
+
+SOL_PACKET = getattr(socket, "SOL_PACKET", 263)
+PACKET_RX_RING = 5
+PACKET_STATISTICS = 6
+PACKET_VERSION = 10
+PACKET_IGNORE_OUTGOING = 23  # Linux 4.20; before it the outgoing copies are skipped here
+TPACKET_V3 = 2
+TP_STATUS_KERNEL = 0
+TP_STATUS_USER = 1
+TP_STATUS_LOSING = 1 << 2
+PACKET_OUTGOING = 4
+ETH_P_ALL = 0x0003
+ARPHRD_CAN = 280
+
+_REQ3 = struct.Struct("=7I")           # struct tpacket_req3
+_BLOCK = struct.Struct("=III")         # tpacket_hdr_v1: block_status, num_pkts, offset_to_first_pkt
+_BLOCK_OFFSET = 8                      # after tpacket_block_desc's version and offset_to_priv
+_PKT = struct.Struct("=IIIIIIH")       # tpacket3_hdr: next_offset, sec, nsec, snaplen, len, status, mac
+_PKTTYPE = 48 + 10                     # sockaddr_ll.sll_pkttype, after the aligned tpacket3_hdr
+_STATS = struct.Struct("=III")         # tpacket_stats_v3: packets, drops, freeze_q_cnt
+_U32 = struct.Struct("=I")
+
+FRAME_SIZE = 2048                      # the ring's nominal frame slot; V3 packs frames back to back
+SLOT_BYTES = 112                       # what a classic frame takes of a block
+_KEYS = ("block_kb", "blocks", "retire_ms")
+
+
+def capture_entry(value: Any, context: str) -> Optional[Dict[str, int]]:
+    """A recorder's ``capture``: ``packet`` / true for the defaults, or a mapping of :class:`PacketCapture` options."""
+
+    if value is None or value is False:
+        return None
+    if value is True or value == "packet":
+        return {}
+    if not isinstance(value, Mapping):
+        raise ValueError(f"{context}.recorder.capture must be 'packet' or a mapping, got {value!r}")
+    unknown = set(value) - set(_KEYS)
+    if unknown:
+        raise ValueError(f"{context}.recorder.capture has unknown keys {sorted(unknown)}")
+    options = {key: int(value[key]) for key in _KEYS if key in value}
+    if any(v <= 0 for v in options.values()) or (options.get("block_kb", 4) * 1024) % mmap.PAGESIZE:
+        raise ValueError(f"{context}.recorder.capture needs positive values and block_kb a multiple of the page size")
+    return options
+
+
+class _Ring:
+    """One interface's socket and mapped ring, with the read position in the current block."""
+
+    def __init__(self, interface: str, block_size: int, blocks: int, retire_ms: int):
+        try:
+            kind = int((Path("/sys/class/net") / interface / "type").read_text())
+        except (OSError, ValueError):
+            raise OSError(f"{interface}: no such interface") from None
+        if kind != ARPHRD_CAN:
+            raise OSError(f"{interface}: not a CAN interface")
+        self.interface = interface
+        self.block_size = block_size
+        self.blocks = blocks
+        # Protocol 0: nothing is queued until the ring is in place and bind() names ETH_P_ALL
+        self.sock = socket.socket(socket.AF_PACKET, socket.SOCK_RAW, 0)
+        try:
+            self.sock.setsockopt(SOL_PACKET, PACKET_VERSION, TPACKET_V3)
+            try:
+                self.sock.setsockopt(SOL_PACKET, PACKET_IGNORE_OUTGOING, 1)
+            except OSError:
+                pass
+            frames = block_size // FRAME_SIZE * blocks
+            self.sock.setsockopt(SOL_PACKET, PACKET_RX_RING,
+                                 _REQ3.pack(block_size, blocks, FRAME_SIZE, frames, retire_ms, 0, 0))
+            self.map = mmap.mmap(self.sock.fileno(), block_size * blocks, mmap.MAP_SHARED,
+                                 mmap.PROT_READ | mmap.PROT_WRITE)
+            self.sock.bind((interface, ETH_P_ALL))
+            self.sock.setblocking(False)
+        except BaseException:
+            self.sock.close()
+            raise
+        self.next = 0       # the block read now, or handed over next
+        self.left = 0       # frames of that block not read yet
+        self.offset = 0     # of the next one
+        self.dropped = 0
+
+    def block(self, index: int) -> Tuple[int, int, int]:
+        base = index * self.block_size
+        status, count, first = _BLOCK.unpack_from(self.map, base + _BLOCK_OFFSET)
+        return status, count, base + first
+
+    def take_block(self) -> bool:
+        """Start on the next block if the kernel handed it over."""
+
+        status, count, first = self.block(self.next)
+        if not status & TP_STATUS_USER:
+            return False
+        if status & TP_STATUS_LOSING:
+            # Reading the counters resets them, which clears TP_STATUS_LOSING on later blocks
+            self.dropped += _STATS.unpack(self.sock.getsockopt(SOL_PACKET, PACKET_STATISTICS, _STATS.size))[1]
+        self.left, self.offset = count, first
+        return True
+
+    def release(self) -> None:
+        # The frames are copied out as they are read, so the kernel may refill the block now
+        _U32.pack_into(self.map, self.next * self.block_size + _BLOCK_OFFSET, TP_STATUS_KERNEL)
+        self.next = (self.next + 1) % self.blocks
+
+    def queued(self) -> int:
+        """Frames handed over and not read yet."""
+
+        total, index = self.left, self.next
+        if self.left:
+            index = (index + 1) % self.blocks
+        for _ in range(self.blocks):
+            status, count, _ = self.block(index)
+            if not status & TP_STATUS_USER:
+                break
+            total += count
+            index = (index + 1) % self.blocks
+        return total
+
+    def close(self) -> None:
+        self.map.close()
+        self.sock.close()
+
+
+class PacketCapture:
+    """Every frame of ``interfaces``, read from one TPACKET_V3 ring per interface.
+
+    ``block_kb`` and ``blocks`` size each ring (a classic frame takes 112
+    bytes of a block, so the default 16 MiB holds about 150000 frames), and
+    ``retire_ms`` bounds how long a frame waits in a block that is not full.
+    One reader thread: :meth:`drain` is the recorder ring interface.
+    """
+
+    def __init__(self, interfaces: Sequence[str], block_kb: int = 1024, blocks: int = 16, retire_ms: int = 10):
+        self.interfaces = list(interfaces)
+        self._rings: List[_Ring] = []
+        try:
+            for name in self.interfaces:
+                self._rings.append(_Ring(name, block_kb * 1024, blocks, retire_ms))
+        except BaseException:
+            self.close()
+            raise
+        self._poll = select.poll()
+        for ring in self._rings:
+            self._poll.register(ring.sock.fileno(), select.POLLIN)
+        self.capacity = block_kb * 1024 * blocks // SLOT_BYTES
+
+    @property
+    def dropped(self) -> int:
+        """Frames the kernel dropped on a full ring, as reported by the blocks read so far."""
+
+        return sum(ring.dropped for ring in self._rings)
+
+    def __len__(self) -> int:
+        return sum(ring.queued() for ring in self._rings)
+
+    def wait(self, timeout: Optional[float] = None) -> bool:
+        """Whether a block was handed over within ``timeout`` seconds (None: forever)."""
+
+        return bool(self._poll.poll(None if timeout is None else int(timeout * 1000)))
+
+    def read(self, max: int = 4096) -> List[Tuple[int, float, bytes]]:  # noqa: A002 - as FrameRing.drain
+        """Up to ``max`` frames as ``(interface index, timestamp, struct can_frame/canfd_frame bytes)``.
+
+        Each interface's frames come in order; without a wait, so an empty
+        list means nothing was handed over.
+        """
+
+        out: List[Tuple[int, float, bytes]] = []
+        unpack = _PKT.unpack_from
+        for index, ring in enumerate(self._rings):
+            view = ring.map
+            while len(out) < max:
+                if not ring.left:
+                    if not ring.take_block():
+                        break
+                    if not ring.left:
+                        ring.release()
+                        continue
+                offset = ring.offset
+                while ring.left and len(out) < max:
+                    next_offset, sec, nsec, snaplen, _, _, mac = unpack(view, offset)
+                    if view[offset + _PKTTYPE] != PACKET_OUTGOING and snaplen in (CAN_MTU, CANFD_MTU):
+                        start = offset + mac
+                        out.append((index, sec + nsec * 1e-9, view[start:start + snaplen]))
+                    offset += next_offset
+                    ring.left -= 1
+                ring.offset = offset
+                if not ring.left:
+                    ring.release()
+        return out
+
+    def drain(self, max: int = 4096) -> List[Tuple[float, bytes]]:  # noqa: A002 - same name as the C++ ring
+        """Up to ``max`` ``(timestamp, frame)`` of every interface, as :class:`~td_can_bridges.recorder.FrameRing`."""
+
+        return [(timestamp, frame) for _, timestamp, frame in self.read(max)]
+
+    def stats(self) -> Dict[str, int]:
+        return {"dropped": self.dropped, "depth": len(self)}
+
+    def close(self) -> None:
+        for ring in self._rings:
+            ring.close()
+        self._rings = []
+
+
+__all__ = ["PacketCapture", "capture_entry"]
@@ -0,0 +1,211 @@
+"""ROS services for RoboStride parameter reads, writes and saves, many motors per request.
+
+The bridge offers them once a bus has ``robostride_params``. They reuse the
+standard parameter service types, so ``ros2 service call`` and any UI that
+speaks them need no new interfaces:
+
+``~/robostride/get_parameters`` (``rcl_interfaces/GetParameters``)
+    ``names`` are ``<bus>/<motor>/<parameter>`` or, for a motor of a
+    ``topology``, ``<joint>/<parameter>``; see
+    :data:`td_can_bridges.robostride_params.PARAMETERS`. ``values`` come back
+    in the same order: ``double`` for float parameters, ``integer`` for the
+    rest, and not set for a name that failed.
+``~/robostride/set_parameters`` (``rcl_interfaces/SetParameters``)
+    The same names, each with a double or integer value. ``<...>/save`` with
+    any value sends a type 22 save; it starts after that motor's writes
+    listed before it. ``results`` has ``successful`` and a ``reason`` per
+    entry.
+``~/robostride/parameter_progress`` (``diagnostic_msgs/DiagnosticStatus``)
+    While a request runs, at most every 100 ms: ``done/total`` and the
+    failures so far, with the entries finished since the previous message.
+
+Every entry of a request goes to the bus's
+:class:`td_can_bridges.robostride_params.ParameterClient` at once. Motors
+are worked in parallel, up to ``window`` requests each, so a request costs
+about one motor's round trips, not the sum. The callback waits for the
+answers. With the default single-threaded executor the node does nothing
+else meanwhile. Set the node's ``executor`` parameter to
+``multi_threaded``: the services have a reentrant callback group of their
+own.
+"""
+
+from __future__ import annotations
+
+import struct
+import time
+from concurrent.futures import FIRST_COMPLETED, Future, wait
+from typing import Callable, Dict, List, Mapping, Optional, Tuple
+
+from diagnostic_msgs.msg import DiagnosticStatus, KeyValue
+from rcl_interfaces.msg import ParameterType, ParameterValue, SetParametersResult
+from rcl_interfaces.srv import GetParameters, SetParameters
+from rclpy.callback_groups import ReentrantCallbackGroup
+
+from .robostride_params import PARAMETERS
+from .service import CanBusService
+
+PROGRESS_PERIOD = 0.1
+SAVE = "save"
+
+
+class ParameterServices:
+    """The parameter services of a bridge node over the ``params`` clients of its buses.
+
+    ``services()`` and ``joints()`` are called per request, so the buses and
+    topologies of a reloaded config are used from then on. ``joints()``
+    maps a joint name to its ``(bus, motor)``.
+    """
+
+    def __init__(self, node, services: Callable[[], Mapping[str, CanBusService]],
+                 joints: Callable[[], Mapping[str, Tuple[str, int]]]):
+        self.node = node
+        self._services = services
+        self._joints = joints
+        self._group = ReentrantCallbackGroup()
+        self._requests = 0
+        self.get_srv = node.create_service(GetParameters, '~/robostride/get_parameters', self._on_get,
+                                           callback_group=self._group)
+        self.set_srv = node.create_service(SetParameters, '~/robostride/set_parameters', self._on_set,
+                                           callback_group=self._group)
+        self.progress_pub = node.create_publisher(DiagnosticStatus, '~/robostride/parameter_progress', 10)
+
+    def _resolve(self, name: str):
+        """``(client, motor, parameter)`` of an entry; raises ValueError with the reason."""
+
+        parts = name.split('/')
+        if len(parts) == 3:
+            bus, motor, parameter = parts
+            try:
+                motor = int(motor, 0)
+            except ValueError:
+                raise ValueError(f"'{motor}' is not a motor ID") from None
+        elif len(parts) == 2:
+            joint, parameter = parts
+            where = self._joints().get(joint)
+            if where is None:
+                raise ValueError(f"no topology has a joint '{joint}'")
+            bus, motor = where
+        else:
+            raise ValueError("expected <bus>/<motor>/<parameter> or <joint>/<parameter>")
+        service = self._services().get(bus)
+        if service is None:
+            raise ValueError(f"no bus '{bus}' runs in this node")
+        if service.params is None:
+            raise ValueError(f"bus '{bus}' has no robostride_params")
+        if parameter != SAVE and parameter not in PARAMETERS:
+            raise ValueError(f"unknown parameter '{parameter}'")
+        return service.params, motor, parameter
+
+    def _on_get(self, request, response):
+        futures = []
+        for name in request.names:
+            try:
+                client, motor, parameter = self._resolve(name)
+                if parameter == SAVE:
+                    raise ValueError("save is a set_parameters entry")
+                futures.append(client.read(motor, parameter))
+            except (ValueError, RuntimeError, struct.error) as exc:
+                futures.append(_failed(exc))
+        outcomes = self._wait('get_parameters', list(request.names), futures)
+        response.values = [_value(result) for result, error in outcomes]
+        return response
+
+    def _on_set(self, request, response):
+        names = [p.name for p in request.parameters]
+        futures = []
+        for param in request.parameters:
+            try:
+                client, motor, parameter = self._resolve(param.name)
+                if parameter == SAVE:
+                    futures.append(client.save(motor))
+                    continue
+                futures.append(client.write(motor, parameter, _number(param.value, PARAMETERS[parameter][1])))
+            except (ValueError, RuntimeError, struct.error) as exc:
+                futures.append(_failed(exc))
+        outcomes = self._wait('set_parameters', names, futures)
+        response.results = [SetParametersResult(successful=error is None, reason=error or "")
+                            for _, error in outcomes]
+        return response
+
+    def _wait(self, kind: str, names: List[str], futures: List[Future]) -> List[Tuple[object, Optional[str]]]:
+        """Every entry's ``(result, error)``, publishing progress until the last one finished."""
+
+        self._requests += 1
+        label = f"{kind} #{self._requests}"
+        index: Dict[int, List[int]] = {}  # a read already pending shares its future
+        for i, future in enumerate(futures):
+            index.setdefault(id(future), []).append(i)
+        outcomes: List[Optional[Tuple[object, Optional[str]]]] = [None] * len(futures)
+        pending = set(futures)
+        finished: List[int] = []
+        failed = 0
+        last = time.monotonic()
+        while pending:
+            done, pending = wait(pending, timeout=PROGRESS_PERIOD, return_when=FIRST_COMPLETED)
+            for future in done:
+                exc = future.exception()
+                for i in index[id(future)]:
+                    outcomes[i] = (None, str(exc)) if exc is not None else (future.result(), None)
+                    failed += exc is not None
+                    finished.append(i)
+            now = time.monotonic()
+            if pending and now - last >= PROGRESS_PERIOD:
+                self._progress(label, names, outcomes, finished, failed)
+                finished, last = [], now
+        self._progress(label, names, outcomes, finished, failed)
+        if failed:
+            self.node.get_logger().warning(f"{label}: {failed} of {len(futures)} entries failed")
+        return outcomes
+
+    def _progress(self, label, names, outcomes, finished, failed) -> None:
+        done = sum(o is not None for o in outcomes)
+        status = DiagnosticStatus(name=f"td_can_bridge: {label}")
+        status.level = DiagnosticStatus.WARN if failed else DiagnosticStatus.OK
+        status.message = f"{done}/{len(outcomes)} done, {failed} failed"
+        status.values = [KeyValue(key=names[i], value=outcomes[i][1] or _text(outcomes[i][0]))
+                         for i in finished]
+        self.progress_pub.publish(status)
+
+    def shutdown(self) -> None:
+        self.node.destroy_service(self.get_srv)
+        self.node.destroy_service(self.set_srv)
+        self.node.destroy_publisher(self.progress_pub)
+
+
+def _failed(exc: Exception) -> Future:
+    future: Future = Future()
+    future.set_exception(exc)
+    return future
+
+
+def _number(value, fmt: str):
+    """A ParameterValue as the parameter's type; raises ValueError."""
+
+    if value.type == ParameterType.PARAMETER_DOUBLE:
+        number = value.double_value
+    elif value.type == ParameterType.PARAMETER_INTEGER:
+        number = value.integer_value
+    elif value.type == ParameterType.PARAMETER_BOOL:
+        number = int(value.bool_value)
+    else:
+        raise ValueError("the value must be a double, integer or bool")
+    if fmt == "f":
+        return float(number)
+    if float(number) != int(number):
+        raise ValueError(f"the parameter is an integer, got {number}")
+    return int(number)
+
+
+def _value(result) -> ParameterValue:
+    if isinstance(result, float):
+        return ParameterValue(type=ParameterType.PARAMETER_DOUBLE, double_value=result)
+    if isinstance(result, int):
+        return ParameterValue(type=ParameterType.PARAMETER_INTEGER, integer_value=result)
+    return ParameterValue()  # failed: not set
+
+
+def _text(result) -> str:
+    return "ok" if result is None else f"{result:g}" if isinstance(result, float) else str(result)
+
+
+__all__ = ["ParameterServices"]
@@ -0,0 +1,150 @@
+"""Sampled per-frame spans of the host bridge, for a trace across adapter and host.
+
+A bus with ``trace`` set times every ``every``-th frame it receives through the
+service:
+
+* ``socket`` runs from the frame's receive timestamp to the RX loop picking
+  it up.
+* ``decode`` covers the raw handlers, the lookup, the batch recorders and the
+  decode.
+* ``store`` is the signal store write.
+* ``handler <key>`` covers one binding's handler. For a bridge binding, that
+  is the ROS message's conversion and publish. With ``rx_workers`` it is only
+  the queue put.
+
+Every ``every``-th send gets one ``send <key>`` span, from ``send()`` to the
+socket write or to the hand-off to the TX scheduler.
+
+Span times are CLOCK_MONOTONIC. The receive timestamp is the socket's
+(``rx_timestamps``) moved from CLOCK_REALTIME by the offset between the two
+clocks at that moment. In ``native`` mode, frames the C++ core decodes
+itself are not traced.
+
+The spans are kept in memory, at most ``max_frames`` frames. Later frames
+are counted as dropped. At shutdown they are written as Chrome trace-event
+JSON, which Perfetto opens as it is. ``nativeCAN/triton_trace.py merge``
+joins the file with the adapter's trace: both share the monotonic clock the
+adapter's timestamps are mapped to, and frames are matched by CAN ID and
+time.
+
+    trace: {path: /tmp/can0-host.json, every: 10}
+"""
+
+from __future__ import annotations
+
+import json
+import logging
+import os
+import time
+from typing import Any, List, Mapping, Tuple
+
+LOG = logging.getLogger(__name__)
+
+DEFAULT_EVERY = 100
+DEFAULT_MAX_FRAMES = 100_000
+RX_TID = 1
+TX_TID = 2
+
+
+class FrameSpan:
+    """Spans of one traced frame: each :meth:`mark` closes one from the previous mark."""
+
+    __slots__ = ("can_id", "tid", "last", "spans")
+
+    def __init__(self, can_id: int, tid: int, start_ns: int):
+        self.can_id = can_id
+        self.tid = tid
+        self.last = start_ns
+        self.spans: List[Tuple[str, int, int]] = []
+
+    def mark(self, name: str) -> None:
+        now = time.monotonic_ns()
+        self.spans.append((name, self.last, now))
+        self.last = now
+
+
+class PipelineTracer:
+    """Samples frames for :class:`FrameSpan` records and writes them as a trace."""
+
+    def __init__(self, bus: str, spec: Mapping[str, Any]):
+        self.bus = bus
+        self.path = str(spec["path"])
+        self.every = max(1, int(spec.get("every", DEFAULT_EVERY)))
+        self.max_frames = int(spec.get("max_frames", DEFAULT_MAX_FRAMES))
+        self.dropped = 0
+        self._rx_left = self.every
+        self._tx_left = self.every
+        self._frames: List[FrameSpan] = []
+
+    def sample(self) -> bool:
+        """True for every ``every``-th received frame."""
+
+        self._rx_left -= 1
+        if self._rx_left:
+            return False
+        self._rx_left = self.every
+        return True
+
+    def sample_tx(self) -> bool:
+        """True for every ``every``-th sent frame. Senders race on the count, which only moves the sample."""
+
+        self._tx_left -= 1
+        if self._tx_left > 0:
+            return False
+        self._tx_left = self.every
+        return True
+
+    def begin(self, can_id: int, timestamp: float) -> FrameSpan:
+        """Span of a received frame, opened with its ``socket`` span."""
+
+        now = time.monotonic_ns()
+        received = now
+        if timestamp > 0:
+            received = min(now, int(timestamp * 1e9) - (time.time_ns() - now))
+        span = FrameSpan(can_id, RX_TID, received)
+        span.mark("socket")
+        return span
+
+    def begin_tx(self, can_id: int) -> FrameSpan:
+        return FrameSpan(can_id, TX_TID, time.monotonic_ns())
+
+    def commit(self, span: FrameSpan) -> None:
+        if len(self._frames) < self.max_frames:
+            self._frames.append(span)
+        else:
+            self.dropped += 1
+
+    def events(self) -> List[dict]:
+        """Chrome trace events of the committed frames, ``ts`` and ``dur`` in µs."""
+
+        pid = os.getpid()
+        events = [
+            {"ph": "M", "name": "process_name", "pid": pid, "args": {"name": f"host {self.bus}"}},
+            {"ph": "M", "name": "thread_name", "pid": pid, "tid": RX_TID, "args": {"name": f"{self.bus} RX"}},
+            {"ph": "M", "name": "thread_name", "pid": pid, "tid": TX_TID, "args": {"name": f"{self.bus} TX"}},
+        ]
+        for seq, frame in enumerate(self._frames):
+            args = {"can_id": frame.can_id, "frame": seq}
+            for name, start, end in frame.spans:
+                events.append({"ph": "X", "cat": "host", "name": name, "pid": pid, "tid": frame.tid,
+                               "ts": start / 1000, "dur": (end - start) / 1000, "args": args})
+        return events
+
+    def write(self) -> None:
+        trace = {
+            "traceEvents": self.events(),
+            "displayTimeUnit": "ns",
+            "otherData": {"clock": "CLOCK_MONOTONIC", "source": "td_can_bridges", "bus": self.bus,
+                          "every": self.every, "frames": len(self._frames), "dropped": self.dropped},
+        }
+        try:
+            with open(self.path, "w") as out:
+                json.dump(trace, out)
+        except OSError as exc:
+            LOG.warning("[%s] cannot write the trace to %s: %s", self.bus, self.path, exc)
+            return
+        LOG.info("[%s] wrote %d traced frames to %s (%d dropped)", self.bus, len(self._frames), self.path,
+                 self.dropped)
+
+
+__all__ = ["DEFAULT_EVERY", "DEFAULT_MAX_FRAMES", "FrameSpan", "PipelineTracer"]
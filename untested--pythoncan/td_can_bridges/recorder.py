@@ -0,0 +1,209 @@
+"""Continuous recording of received frames to rotating BLF, MF4 or compact logs.
+
+A bus with ``recorder`` set keeps a copy of every frame its socket reads, of
+any ID and before decoding, in a preallocated single-producer ring: the C++
+core's ``_can_core.FrameRing`` in ``native`` mode (a memcpy and two atomic
+stores per frame), :class:`FrameRing` in the Python loops (two list stores).
+Neither side takes a lock, and a full ring drops the frame and counts it
+rather than stall reception. :class:`FrameRecorder`'s thread drains the ring
+every ``flush_s`` seconds and hands the frames to a python-can writer chosen
+by the file suffix: ``.blf`` writes zlib-compressed containers, ``.mf4``
+needs ``asammdf``, and the text formats python-can knows work too. With
+``max_bytes`` files rotate through ``can.SizedRotatingLogger``. A ``.tdlog``
+path writes the compact per-ID log of :mod:`td_can_bridges.compact_log`
+straight from the ring's raw frames, which also rotates at ``max_bytes``.
+
+Frames keep the socket's receive timestamp (see ``BusConfig.rx_timestamps``).
+The kernel filters apply: with ``auto_filters`` only the bound IDs reach the
+socket, and frames this host sends are not recorded. With ``capture`` the
+ring is a :class:`~td_can_bridges.packet_capture.PacketCapture` of the
+interface instead: the kernel fills it, every frame on the interface is
+recorded, the ones this host sends included, and the RX loop does nothing
+for the recording.
+"""
+
+from __future__ import annotations
+
+import logging
+import struct
+import threading
+from typing import Any, List, Mapping, Optional, Tuple
+
+import can
+
+from .compact_log import SUFFIX, CompactLogWriter
+from .socketcan_rx import CAN_EFF_FLAG, CAN_EFF_MASK, CAN_MTU
+
+LOG = logging.getLogger(__name__)
+
+DEFAULT_RING_FRAMES = 65536
+DEFAULT_MAX_BYTES = 256 * 1024 * 1024
+
+_CAN_RTR_FLAG = 0x40000000
+_CAN_ERR_FLAG = 0x20000000
+_CAN_ERR_MASK = 0x1FFFFFFF
+_CAN_SFF_MASK = 0x7FF
+_CANFD_BRS = 0x01
+_CANFD_ESI = 0x02
+_HEAD = struct.Struct("=IBB")
+
+
+class FrameRing:
+    """The Python loops' ring: ``(timestamp, frame)`` slots, one producer and one consumer thread.
+
+    Each side only advances its own index and reads the other's; under the
+    GIL every such access is atomic, so neither locks. ``frame`` is the raw
+    ``struct can_frame``/``canfd_frame`` bytes, or a ``can.Message`` from a
+    loop that only has those.
+    """
+
+    __slots__ = ("_stamps", "_frames", "_mask", "_head", "_tail", "dropped")
+
+    def __init__(self, capacity: int):
+        size = 1
+        while size < capacity:
+            size <<= 1
+        self._stamps: List[float] = [0.0] * size
+        self._frames: List[Any] = [None] * size
+        self._mask = size - 1
+        self._head = 0  # written by the producer only
+        self._tail = 0  # written by the consumer only
+        self.dropped = 0
+
+    @property
+    def capacity(self) -> int:
+        return self._mask + 1
+
+    def __len__(self) -> int:
+        return self._head - self._tail
+
+    def push(self, timestamp: float, frame: Any) -> None:
+        head = self._head
+        if head - self._tail > self._mask:
+            self.dropped += 1
+            return
+        slot = head & self._mask
+        self._stamps[slot] = timestamp
+        self._frames[slot] = frame
+        self._head = head + 1
+
+    def drain(self, max: int = 4096) -> List[Tuple[float, Any]]:  # noqa: A002 - same name as the C++ ring
+        tail = self._tail
+        count = min(self._head - tail, max)
+        out = []
+        for i in range(tail, tail + count):
+            slot = i & self._mask
+            out.append((self._stamps[slot], self._frames[slot]))
+            self._frames[slot] = None
+        self._tail = tail + count
+        return out
+
+
+def to_message(timestamp: float, frame: Any, channel: Optional[str] = None) -> can.Message:
+    """``can.Message`` of one ring entry."""
+
+    if isinstance(frame, can.Message):
+        return frame
+    can_id, length, flags = _HEAD.unpack_from(frame)
+    extended = bool(can_id & CAN_EFF_FLAG)
+    error = bool(can_id & _CAN_ERR_FLAG)
+    fd = len(frame) > CAN_MTU
+    if error:
+        arbitration_id = can_id & _CAN_ERR_MASK
+    else:
+        arbitration_id = can_id & (CAN_EFF_MASK if extended else _CAN_SFF_MASK)
+    return can.Message(
+        timestamp=timestamp,
+        arbitration_id=arbitration_id,
+        is_extended_id=extended,
+        is_remote_frame=bool(can_id & _CAN_RTR_FLAG),
+        is_error_frame=error,
+        is_fd=fd,
+        bitrate_switch=fd and bool(flags & _CANFD_BRS),
+        error_state_indicator=fd and bool(flags & _CANFD_ESI),
+        dlc=length,
+        data=frame[8:8 + length],
+        channel=channel,
+    )
+
+
+class FrameRecorder:
+    """Writer thread draining a ring into a python-can log writer.
+
+    ``spec`` is the bus's ``recorder`` entry: ``path`` (``{bus}`` is
+    replaced by the bus name), ``max_bytes`` per file before rotating (0: one
+    file), ``flush_s`` and ``options``, extra keyword arguments for the
+    writer such as ``compression_level`` of the BLF writer. A ring with
+    ``close`` (a ``PacketCapture``) is closed when the recorder stops.
+    """
+
+    def __init__(self, ring, spec: Mapping[str, Any], name: str, channel: Optional[str] = None):
+        self.ring = ring
+        self.name = name
+        self.channel = channel
+        self.path = str(spec["path"]).format(bus=name)
+        self.flush_s = float(spec.get("flush_s", 1.0))
+        self.frames = 0  # written to the writer
+        max_bytes = int(spec.get("max_bytes", DEFAULT_MAX_BYTES))
+        options = dict(spec.get("options") or {})
+        self._compact = self.path.lower().endswith(SUFFIX)
+        if self._compact:
+            # The TritonCAN compact log takes the ring's raw frames, without a can.Message each
+            self._writer = CompactLogWriter(self.path, channel=channel or "", max_bytes=max_bytes, **options)
+        elif max_bytes:
+            self._writer = can.SizedRotatingLogger(base_filename=self.path, max_bytes=max_bytes, **options)
+        else:
+            self._writer = can.Logger(self.path, **options)
+        self._stop = threading.Event()
+        self._thread = threading.Thread(target=self._run, name=f"{name}-recorder", daemon=True)
+        self._thread.start()
+        LOG.info("[%s] recording to %s (%d-frame ring)", name, self.path, ring.capacity)
+
+    def stop(self) -> None:
+        """Write what is left in the ring and close the file."""
+
+        self._stop.set()
+        self._thread.join(timeout=5.0)
+        close = getattr(self.ring, "close", None)
+        if close is not None and not self._thread.is_alive():
+            close()
+
+    def stats(self) -> Mapping[str, int]:
+        return {"frames": self.frames, "dropped": self.ring.dropped, "depth": len(self.ring)}
+
+    def _drain(self) -> int:
+        batch = self.ring.drain(4096)
+        if self._compact:
+            add = self._writer.add_raw
+            for timestamp, frame in batch:
+                add(timestamp, frame)
+        else:
+            for timestamp, frame in batch:
+                self._writer.on_message_received(to_message(timestamp, frame, self.channel))
+        self.frames += len(batch)
+        return len(batch)
+
+    def _run(self) -> None:
+        try:
+            while True:
+                stopping = self._stop.is_set()
+                try:
+                    while self._drain() == 4096:
+                        pass
+                    if self._compact:
+                        self._writer.flush_stale()
+                except Exception:
+                    LOG.exception("[%s] recorder write failed", self.name)
+                if stopping:
+                    break
+                self._stop.wait(self.flush_s)
+        finally:
+            try:
+                self._writer.stop()
+            except Exception:
+                LOG.exception("[%s] closing %s failed", self.name, self.path)
+            if self.ring.dropped:
+                LOG.warning("[%s] recorder ring dropped %d frames", self.name, self.ring.dropped)
+
+
+__all__ = ["DEFAULT_MAX_BYTES", "DEFAULT_RING_FRAMES", "FrameRecorder", "FrameRing", "to_message"]
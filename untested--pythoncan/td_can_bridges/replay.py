@@ -0,0 +1,306 @@
+"""Replay recorded CAN traffic onto SocketCAN interfaces at its original timing.
+
+:func:`read_log` yields the frames of a candump ``.log``, a ``.blf`` (both
+read through ``mmap``), an ``.asc`` file or a compact ``.tdlog``, in file
+order (a ``.tdlog`` in timestamp order per chunk). :class:`Replayer`
+writes them to raw sockets: frame ``i`` is due at ``start + (t_i - t_0) /
+speed`` and the thread sleeps until that absolute deadline with
+``clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME)``, so the error of one
+sleep never accumulates into the next. ``speed`` 0 sends as fast as the
+interface queue takes frames. Each frame's log channel picks the output
+interface, and each interface can rename IDs, so a two-bus field log can be
+played onto ``vcan0``/``vcan1`` with the IDs a test setup uses.
+
+    replayer = Replayer({"can0": "vcan0", "can1": "vcan1"}, speed=10.0)
+    stats = replayer.run(read_log("field.blf"))
+    print(stats.summary())
+
+Error frames are not replayed; they are counted in ``skipped`` with frames
+of unmapped channels.
+"""
+
+from __future__ import annotations
+
+import ctypes
+import ctypes.util
+import errno
+import mmap
+import socket
+import struct
+import time
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Dict, Iterable, Iterator, List, Mapping, NamedTuple, Optional
+
+from .socketcan_rx import CAN_EFF_FLAG, CAN_EFF_MASK, CAN_ERR_FLAG, CAN_RTR_FLAG, CAN_SFF_MASK
+
+_CLASSIC = struct.Struct("=IB3x8s")
+_FD = struct.Struct("=IBB2x64s")
+_CANFD_BRS = 0x01
+_CANFD_ESI = 0x02
+# linux/can/raw.h
+_SOL_CAN_RAW = 101
+_CAN_RAW_FD_FRAMES = 5
+# linux/time.h
+_CLOCK_MONOTONIC = 1
+_TIMER_ABSTIME = 1
+
+
+class LogFrame(NamedTuple):
+    timestamp: float  # seconds, as logged
+    channel: str      # interface name (candump) or channel number (BLF, ASC)
+    can_id: int       # with CAN_EFF_FLAG, CAN_RTR_FLAG and CAN_ERR_FLAG as on the socket
+    data: bytes
+    fd: bool = False
+    flags: int = 0    # canfd_frame.flags: BRS, ESI
+
+
+# ----------------------------------------------------------------------
+# Log readers
+
+
+def read_candump(path: Path | str) -> Iterator[LogFrame]:
+    """Frames of a ``candump -l`` log: ``(1436509052.249713) vcan0 123#11223344``."""
+
+    with open(path, "rb") as handle, mmap.mmap(handle.fileno(), 0, access=mmap.ACCESS_READ) as mm:
+        for line in iter(mm.readline, b""):
+            parts = line.split()
+            if len(parts) < 3 or not parts[0].startswith(b"("):
+                continue
+            frame = _parse_candump(float(parts[0][1:-1]), parts[1].decode(), parts[2])
+            if frame is not None:
+                yield frame
+
+
+def _parse_candump(timestamp: float, channel: str, text: bytes) -> Optional[LogFrame]:
+    ident, sep, body = text.partition(b"#")
+    if not sep:
+        return None
+    can_id = int(ident, 16)
+    if len(ident) > 3 and not can_id & CAN_ERR_FLAG:
+        can_id |= CAN_EFF_FLAG
+    if body.startswith(b"#"):  # CAN FD: ID##<flags nibble><data>
+        return LogFrame(timestamp, channel, can_id, bytes.fromhex(body[2:].decode()), True, int(body[1:2], 16))
+    if body.startswith((b"R", b"r")):
+        return LogFrame(timestamp, channel, can_id | CAN_RTR_FLAG, bytes(int(body[1:2] or b"0", 16)))
+    return LogFrame(timestamp, channel, can_id, bytes.fromhex(body.split(b"_")[0].decode()))
+
+
+def read_python_can(path: Path | str) -> Iterator[LogFrame]:
+    """Frames of any format python-can reads; BLF files are memory-mapped."""
+
+    import can
+
+    path = Path(path)
+    if path.suffix.lower() == ".blf":
+        with open(path, "rb") as handle, mmap.mmap(handle.fileno(), 0, access=mmap.ACCESS_READ) as mm:
+            yield from _from_messages(can.BLFReader(mm))
+        return
+    yield from _from_messages(can.LogReader(str(path)))
+
+
+def _from_messages(messages) -> Iterator[LogFrame]:
+    for msg in messages:
+        if msg.is_error_frame:
+            can_id = CAN_ERR_FLAG | msg.arbitration_id
+        else:
+            can_id = msg.arbitration_id | (CAN_EFF_FLAG if msg.is_extended_id else 0)
+        data = bytes(msg.data)
+        if msg.is_remote_frame:
+            can_id |= CAN_RTR_FLAG
+            data = bytes(msg.dlc)
+        flags = (_CANFD_BRS if msg.bitrate_switch else 0) | (_CANFD_ESI if msg.error_state_indicator else 0)
+        channel = "" if msg.channel is None else str(msg.channel)
+        yield LogFrame(msg.timestamp, channel, can_id, data, bool(msg.is_fd), flags)
+
+
+def read_log(path: Path | str) -> Iterator[LogFrame]:
+    """:func:`read_candump` for ``.log``, :func:`~td_can_bridges.compact_log.read_compact` for ``.tdlog``
+    and :func:`read_python_can` for the rest."""
+
+    suffix = Path(path).suffix.lower()
+    if suffix == ".log":
+        return read_candump(path)
+    if suffix == ".tdlog":
+        from .compact_log import read_compact
+
+        return read_compact(path)
+    return read_python_can(path)
+
+
+# ----------------------------------------------------------------------
+# Scheduling
+
+
+class _Timespec(ctypes.Structure):
+    _fields_ = [("tv_sec", ctypes.c_long), ("tv_nsec", ctypes.c_long)]
+
+
+def _load_clock_nanosleep():
+    try:
+        libc = ctypes.CDLL(ctypes.util.find_library("c") or None, use_errno=True)
+        fn = libc.clock_nanosleep
+    except (OSError, AttributeError):
+        return None
+    fn.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.POINTER(_Timespec), ctypes.POINTER(_Timespec)]
+    fn.restype = ctypes.c_int
+    return fn
+
+
+_clock_nanosleep = _load_clock_nanosleep()
+
+
+def sleep_until(deadline_ns: int) -> None:
+    """Sleep until ``time.monotonic_ns()`` reaches ``deadline_ns``."""
+
+    if _clock_nanosleep is None:
+        delay = deadline_ns - time.monotonic_ns()
+        if delay > 0:
+            time.sleep(delay / 1e9)
+        return
+    ts = _Timespec(deadline_ns // 1_000_000_000, deadline_ns % 1_000_000_000)
+    # Returns the error number itself; EINTR restarts with the same absolute deadline
+    while _clock_nanosleep(_CLOCK_MONOTONIC, _TIMER_ABSTIME, ctypes.byref(ts), None) == errno.EINTR:
+        pass
+
+
+@dataclass
+class ReplayStats:
+    frames: int = 0            # written to an interface
+    skipped: int = 0           # error frames and frames of unmapped channels
+    span_s: float = 0.0        # log time from the first to the last frame sent
+    elapsed_s: float = 0.0     # wall time of the replay
+    speed: float = 1.0
+    lateness_us: List[float] = field(default_factory=list, repr=False)  # send time past each deadline
+
+    @property
+    def requested_rate(self) -> float:
+        """Frames per second the log asked for at ``speed``; inf at maximum speed."""
+
+        if self.speed <= 0 or self.span_s <= 0:
+            return float("inf")
+        return self.frames * self.speed / self.span_s
+
+    @property
+    def achieved_rate(self) -> float:
+        return self.frames / self.elapsed_s if self.elapsed_s > 0 else 0.0
+
+    def lateness_percentiles(self, points=(50.0, 90.0, 99.0, 99.9, 100.0)) -> Dict[float, float]:
+        ordered = sorted(self.lateness_us)
+        if not ordered:
+            return {}
+        return {p: ordered[min(len(ordered) - 1, int(len(ordered) * p / 100.0))] for p in points}
+
+    def summary(self) -> str:
+        requested = "max" if self.requested_rate == float("inf") else f"{self.requested_rate:.0f}"
+        text = (f"{self.frames} frames ({self.skipped} skipped) in {self.elapsed_s:.3f} s: "
+                f"{self.achieved_rate:.0f} frames/s, requested {requested}")
+        percentiles = self.lateness_percentiles()
+        if percentiles:
+            text += ", lateness " + " ".join(
+                f"p{p:g}={value:.1f}us" if p < 100 else f"max={value:.1f}us" for p, value in percentiles.items())
+        return text
+
+
+class Replayer:
+    """Write logged frames to SocketCAN interfaces, paced by their timestamps.
+
+    ``channels`` maps log channels to interfaces; frames of other channels go
+    to ``interface``, or are skipped when it is None. ``remap`` maps an
+    interface to ``{logged ID: sent ID}`` (IDs without the flag bits; the ID
+    type is kept). ``speed`` is the multiple of real time, 0 for maximum.
+    """
+
+    def __init__(
+        self,
+        channels: Optional[Mapping[str, str]] = None,
+        interface: Optional[str] = None,
+        remap: Optional[Mapping[str, Mapping[int, int]]] = None,
+        speed: float = 1.0,
+    ):
+        self.channels = dict(channels or {})
+        self.interface = interface
+        self.remap = {name: dict(ids) for name, ids in (remap or {}).items()}
+        self.speed = speed
+        self._sockets: Dict[str, socket.socket] = {}
+
+    def run(self, frames: Iterable[LogFrame], limit: Optional[int] = None) -> ReplayStats:
+        stats = ReplayStats(speed=self.speed)
+        paced = self.speed > 0
+        scale = 1e9 / self.speed if paced else 0.0
+        first = last = None
+        start_ns = time.monotonic_ns()
+        try:
+            for frame in frames:
+                if limit is not None and stats.frames >= limit:
+                    break
+                target = self.channels.get(frame.channel, self.interface)
+                if target is None or frame.can_id & CAN_ERR_FLAG:
+                    stats.skipped += 1
+                    continue
+                if first is None:
+                    first = frame.timestamp
+                    start_ns = time.monotonic_ns()
+                last = frame.timestamp
+                packed = self._pack(frame, self.remap.get(target))
+                sock = self._socket(target)
+                if paced:
+                    deadline = start_ns + int((frame.timestamp - first) * scale)
+                    sleep_until(deadline)
+                self._send(sock, packed)
+                if paced:
+                    stats.lateness_us.append((time.monotonic_ns() - deadline) / 1e3)
+                stats.frames += 1
+        finally:
+            stats.elapsed_s = (time.monotonic_ns() - start_ns) / 1e9
+            stats.span_s = (last - first) if first is not None else 0.0
+        return stats
+
+    def close(self) -> None:
+        for sock in self._sockets.values():
+            sock.close()
+        self._sockets.clear()
+
+    def __enter__(self) -> "Replayer":
+        return self
+
+    def __exit__(self, *exc) -> None:
+        self.close()
+
+    def _socket(self, interface: str) -> socket.socket:
+        sock = self._sockets.get(interface)
+        if sock is None:
+            sock = socket.socket(socket.AF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+            try:
+                sock.setsockopt(_SOL_CAN_RAW, _CAN_RAW_FD_FRAMES, 1)
+            except OSError:
+                pass  # classic-only kernel; FD frames then fail to send
+            sock.bind((interface,))
+            self._sockets[interface] = sock
+        return sock
+
+    @staticmethod
+    def _pack(frame: LogFrame, remap: Optional[Mapping[int, int]]) -> bytes:
+        can_id = frame.can_id
+        if remap:
+            mask = CAN_EFF_MASK if can_id & CAN_EFF_FLAG else CAN_SFF_MASK
+            new = remap.get(can_id & mask)
+            if new is not None:
+                can_id = (can_id & ~mask) | (new & mask)
+        if frame.fd:
+            return _FD.pack(can_id, len(frame.data), frame.flags, frame.data)
+        return _CLASSIC.pack(can_id, len(frame.data), frame.data)
+
+    @staticmethod
+    def _send(sock: socket.socket, packed: bytes) -> None:
+        while True:
+            try:
+                sock.send(packed)
+                return
+            except OSError as exc:
+                if exc.errno != errno.ENOBUFS:
+                    raise
+                time.sleep(0.0001)  # the interface queue is full, back off briefly
+
+
+__all__ = ["LogFrame", "ReplayStats", "Replayer", "read_candump", "read_log", "read_python_can", "sleep_until"]
@@ -0,0 +1,238 @@
+"""RoboStride faults (type 21 and the type 2 fault bits), decoded and raised ahead of the telemetry.
+
+A bus entry with ``robostride_faults`` watches its motors' faults::
+
+    robostride_faults:
+      host_id: 0xFD        # where the fault frames are addressed (default)
+      feedback: true       # also the fault bits of type 2 feedback (default)
+      topic: /td/rs02/faults   # the bridge's DiagnosticArray topic (default /td/<bus>/faults)
+
+A motor sends a type 21 frame when a fault is raised: the fault word of
+parameter 0x3022 in bytes 0-3 and the warning word in bytes 4-7, both little
+endian. Every type 2 feedback frame also carries six fault bits in ID bits
+16-21. :class:`FaultMonitor` registers both as priority raw handlers of
+the service. So they run for a whole receive batch before any frame of it
+is decoded, and a fault never waits behind the telemetry read with it.
+Each handler is one mask compare and, for feedback, one dict lookup. Only
+a change of a motor's faults makes a :class:`FaultEvent`, which goes to the
+subscribers at once, on the RX thread. The bridge publishes one
+``diagnostic_msgs/DiagnosticArray`` per event.
+
+The 0x3022 bits are named from the generated tables
+(:mod:`td_can_bridges.robostride_models`); bits without a name show as
+``bit<n>``. Type 2 only has room for the six bits of ``FEEDBACK_FAULTS``.
+A fault seen only in feedback is therefore named from those six, and
+feedback without fault bits clears it. A fault from a type 21 frame ends
+with a type 21 frame without it, or after :meth:`FaultMonitor.clear`. That
+sends the type 4 fault clear, and the motor's type 2 reply confirms it.
+"""
+
+from __future__ import annotations
+
+import logging
+import struct
+import threading
+from dataclasses import dataclass
+from typing import Any, Callable, Dict, List, Mapping, Optional, Tuple
+
+from .robostride_models import FAULTS
+
+LOG = logging.getLogger(__name__)
+
+TYPE_FEEDBACK = 2
+TYPE_STOP = 4
+TYPE_FAULT = 21
+ANSWER_MASK = 0x1F0000FF        # type and host ID: every motor
+FEEDBACK_FAULT_SHIFT = 16
+
+# Type 2 ID bits 16-21, from the RS02 manual's feedback frame
+FEEDBACK_FAULTS = (
+    (1 << 0, "under_voltage"),
+    (1 << 1, "iq_overload"),
+    (1 << 2, "motor_over_temperature"),
+    (1 << 3, "magnetic_encoder_fault"),
+    (1 << 4, "hall_encoder_fault"),
+    (1 << 5, "encoder_not_calibrated"),
+)
+# Type 21 warning word
+WARNINGS = {"motor_over_temperature": 1 << 0}
+
+_WORDS = struct.Struct("<II")
+
+
+def fault_names(word: int, table: Dict[str, int] = FAULTS) -> Tuple[str, ...]:
+    """Names of the bits set in ``word``; bits no table entry names are ``bit<n>``."""
+
+    names = [name for name, mask in table.items() if word & mask]
+    known = 0
+    for mask in table.values():
+        known |= mask
+    rest = word & ~known
+    names += [f"bit{n}" for n in range(rest.bit_length()) if rest >> n & 1]
+    return tuple(names)
+
+
+@dataclass(frozen=True)
+class FaultConfig:
+    """``robostride_faults`` of a bus."""
+
+    host_id: int = 0xFD
+    feedback: bool = True
+    topic: Optional[str] = None
+
+
+def faults_entry(value: Any, context: str) -> Optional[FaultConfig]:
+    """Parse ``robostride_faults``: a mapping, or true for the defaults; None when absent."""
+
+    if not value:
+        return None
+    if value is True:
+        return FaultConfig()
+    if not isinstance(value, Mapping):
+        raise ValueError(f"{context}.robostride_faults must be true or a mapping")
+    host_id = value.get("host_id", 0xFD)
+    topic = value.get("topic")
+    return FaultConfig(
+        host_id=(int(host_id, 0) if isinstance(host_id, str) else int(host_id)) & 0xFF,
+        feedback=bool(value.get("feedback", True)),
+        topic=str(topic) if topic else None,
+    )
+
+
+@dataclass(frozen=True)
+class FaultEvent:
+    """A change of one motor's faults; ``faults`` empty means they cleared."""
+
+    motor: int
+    faults: Tuple[str, ...]
+    warnings: Tuple[str, ...] = ()
+    word: int = 0              # 0x3022 fault word (type 21), or the six feedback bits
+    source: str = "type21"     # or "feedback"
+    timestamp: float = 0.0
+
+
+@dataclass
+class _MotorFaults:
+    word: int = 0
+    warning: int = 0
+    feedback: int = 0          # fault bits of the last type 2 frame
+    clearing: bool = False     # clear() sent: the next type 2 frame tells
+    events: int = 0
+    last: Optional[FaultEvent] = None
+
+
+class FaultMonitor:
+    """Per-motor fault state from type 21 and type 2 frames; calls ``subscribe``\\ d callbacks on changes."""
+
+    def __init__(self, service, cfg: FaultConfig = FaultConfig()):
+        self.service = service
+        self.cfg = cfg
+        self._motors: Dict[int, _MotorFaults] = {}
+        self._subscribers: List[Callable[[FaultEvent], None]] = []
+        self._lock = threading.Lock()
+        host = cfg.host_id & 0xFF
+        self._keys = [f"robostride_faults/{TYPE_FAULT}"]
+        service.register_raw_handler(self._keys[0], TYPE_FAULT << 24 | host, self._on_fault,
+                                     id_mask=ANSWER_MASK, priority=True)
+        if cfg.feedback:
+            self._keys.append(f"robostride_faults/{TYPE_FEEDBACK}")
+            service.register_raw_handler(self._keys[1], TYPE_FEEDBACK << 24 | host, self._on_feedback,
+                                         id_mask=ANSWER_MASK, priority=True)
+
+    def subscribe(self, callback: Callable[[FaultEvent], None]) -> None:
+        """``callback(event)`` runs on the RX thread for every change: keep it short, or hand it off."""
+
+        self._subscribers = self._subscribers + [callback]
+
+    def close(self) -> None:
+        for key in self._keys:
+            self.service.unregister_raw_handler(key)
+
+    def clear(self, motor: int) -> None:
+        """Sends the motor a type 4 fault clear; its type 2 reply clears the faults if they are gone."""
+
+        with self._lock:
+            self._state(motor).clearing = True
+        arbitration_id = TYPE_STOP << 24 | (self.cfg.host_id & 0xFF) << 8 | (motor & 0xFF)
+        self.service.send_raw(arbitration_id, bytes([1, 0, 0, 0, 0, 0, 0, 0]))
+
+    def faults(self, motor: int) -> Tuple[str, ...]:
+        """The motor's current faults."""
+
+        state = self._motors.get(motor)
+        return () if state is None or state.last is None else state.last.faults
+
+    def stats(self) -> Dict[int, Dict[str, Any]]:
+        with self._lock:
+            return {motor: {"faults": list(s.last.faults) if s.last else [],
+                            "warnings": list(s.last.warnings) if s.last else [],
+                            "word": s.word, "events": s.events}
+                    for motor, s in self._motors.items()}
+
+    def _state(self, motor: int) -> _MotorFaults:
+        state = self._motors.get(motor)
+        if state is None:
+            state = self._motors[motor] = _MotorFaults()
+        return state
+
+    def _on_fault(self, arbitration_id: int, data: Optional[bytes], timestamp: float) -> None:
+        if data is None or len(data) < 8:
+            return
+        motor = (arbitration_id >> 8) & 0xFF
+        word, warning = _WORDS.unpack_from(data)
+        with self._lock:
+            state = self._state(motor)
+            if (word, warning) == (state.word, state.warning) and state.last is not None:
+                return
+            state.word, state.warning = word, warning
+            event = FaultEvent(motor, fault_names(word), fault_names(warning, WARNINGS), word, "type21", timestamp)
+            self._record(state, event)
+        self._emit(event)
+
+    def _on_feedback(self, arbitration_id: int, data: Optional[bytes], timestamp: float) -> None:
+        bits = (arbitration_id >> FEEDBACK_FAULT_SHIFT) & 0x3F
+        motor = (arbitration_id >> 8) & 0xFF
+        state = self._motors.get(motor)
+        if state is None:
+            if not bits:
+                return  # the common case: a healthy motor's telemetry
+        elif bits == state.feedback and not state.clearing:
+            return
+        with self._lock:
+            state = self._state(motor)
+            state.feedback = bits
+            clearing, state.clearing = state.clearing, False
+            if bits:
+                if state.word:
+                    return  # a type 21 frame named these faults already
+                names = tuple(name for mask, name in FEEDBACK_FAULTS if bits & mask)
+            else:
+                if state.last is None or not state.last.faults:
+                    return
+                if state.word and not clearing:
+                    return  # type 2 cannot show every type 21 fault: only a clear or a type 21 ends them
+                names = ()
+                state.word = state.warning = 0
+            event = FaultEvent(motor, names, (), bits, "feedback", timestamp)
+            self._record(state, event)
+        self._emit(event)
+
+    def _record(self, state: _MotorFaults, event: FaultEvent) -> None:
+        state.last = event
+        state.events += 1
+
+    def _emit(self, event: FaultEvent) -> None:
+        if event.faults:
+            LOG.warning("[%s] motor %d fault: %s", self.service.cfg.name, event.motor, ", ".join(event.faults))
+        else:
+            LOG.info("[%s] motor %d faults cleared", self.service.cfg.name, event.motor)
+        for callback in self._subscribers:
+            try:
+                callback(event)
+            except Exception:
+                LOG.exception("[%s] fault subscriber failed", self.service.cfg.name)
+
+
+__all__ = [
+    "FEEDBACK_FAULTS", "FaultConfig", "FaultEvent", "FaultMonitor", "WARNINGS", "fault_names", "faults_entry",
+]
@@ -0,0 +1,525 @@
+"""Pipelined RoboStride parameter reads and writes over a :class:`CanBusService`.
+
+A RoboStride motor answers a type 17 read with a type 17 frame carrying the
+parameter index and value, and a type 18 write or a type 22 save with its
+type 2 feedback frame. :class:`ParameterClient` keeps up to ``window``
+requests in flight per motor, matches every answer to its request by (motor
+ID, parameter index) and resolves a ``concurrent.futures.Future``; a request
+left unanswered for ``timeout`` seconds is sent again, up to ``retries``
+times. Reading every parameter of a dozen motors then costs about one
+motor's round trips instead of the sum of all of them::
+
+    client = ParameterClient(service)
+    futures = client.read_all(range(1, 13))
+    values = {key: f.result() for key, f in futures.items()}
+
+From asyncio, ``await asyncio.wrap_future(client.read(motor, "loc_kp"))``.
+A bus with ``robostride_params`` has a client as ``service.params`` from
+``start()`` to ``shutdown()``, which the bridge's parameter services use
+(:mod:`td_can_bridges.parameter_services`).
+
+Requests to one motor start in the order they were made, so a read queued
+behind a write of the same parameter sees the written value, and a second
+read of a parameter already pending shares the first one's future. A write's
+type 2 answer carries no parameter index: a motor has at most one write in
+flight, and any type 2 frame of that motor completes it. With active
+reporting (type 24) on, the next report acknowledges a write whether or not
+the motor applied it; read the value back where that matters.
+
+Reads of ``static`` parameters (:data:`VOLATILITY`: limits, gains, the run
+mode, ``canTimeout``) are answered from the bus's :class:`ParameterCache`
+once a value is known, with no frame on the bus. A write or save through any
+client of the bus drops the motor's cached values when it is submitted, and
+so does one seen from another host. ``measured`` parameters (positions,
+currents, the targets a controller streams) always go to the motor.
+``prefetch(motors)`` fills the cache at discovery time; ``read(...,
+fresh=True)`` skips it.
+"""
+
+from __future__ import annotations
+
+import logging
+import struct
+import threading
+import time
+from collections import deque
+from concurrent.futures import Future
+from dataclasses import dataclass
+from typing import Any, Deque, Dict, Iterable, Mapping, Optional, Tuple, Union
+
+LOG = logging.getLogger(__name__)
+
+TYPE_FEEDBACK = 2
+TYPE_READ = 17
+TYPE_WRITE = 18
+TYPE_SAVE = 22
+_SAVE_PAYLOAD = bytes(range(1, 9))  # the fixed data of a type 22 frame
+_SAVE_INDEX = -1                     # stands in for the parameter index of a save request
+_TYPE_MASK = 0x1F000000
+
+# Answers are addressed to the host: type in bits 24-28, motor in 8-15, host in 0-7
+_ANSWER_MASK = 0x1F0000FF
+
+# name -> (index, struct code of the value in bytes 4-7), from the RS02 parameter list
+PARAMETERS: Dict[str, Tuple[int, str]] = {
+    "run_mode": (0x7005, "B"),
+    "iq_ref": (0x7006, "f"),
+    "spd_ref": (0x700A, "f"),
+    "limit_torque": (0x700B, "f"),
+    "cur_kp": (0x7010, "f"),
+    "cur_ki": (0x7011, "f"),
+    "cur_filt_gain": (0x7014, "f"),
+    "loc_ref": (0x7016, "f"),
+    "limit_spd": (0x7017, "f"),
+    "limit_cur": (0x7018, "f"),
+    "mechPos": (0x7019, "f"),
+    "iqf": (0x701A, "f"),
+    "mechVel": (0x701B, "f"),
+    "VBUS": (0x701C, "f"),
+    "loc_kp": (0x701E, "f"),
+    "spd_kp": (0x701F, "f"),
+    "spd_ki": (0x7020, "f"),
+    "spd_filt_gain": (0x7021, "f"),
+    "acc_rad": (0x7022, "f"),
+    "vel_max": (0x7024, "f"),
+    "acc_set": (0x7025, "f"),
+    "EPScan_time": (0x7026, "H"),
+    "canTimeout": (0x7028, "I"),
+    "zero_sta": (0x7029, "B"),
+}
+
+Parameter = Union[str, Tuple[int, str]]  # a PARAMETERS name, or (index, struct code)
+
+STATIC = "static"      # changes only when written: cached until a write or save
+MEASURED = "measured"  # changes on its own or through motion commands: never cached
+
+# Every PARAMETERS name not listed here is STATIC. An (index, code) parameter outside PARAMETERS
+# is MEASURED.
+VOLATILITY: Dict[str, str] = {
+    name: MEASURED for name in ("iq_ref", "spd_ref", "loc_ref", "mechPos", "iqf", "mechVel", "VBUS")
+}
+_STATIC_INDEXES = frozenset(index for name, (index, _) in PARAMETERS.items()
+                            if VOLATILITY.get(name, STATIC) == STATIC)
+
+
+def volatility(index: int) -> str:
+    """The class of a parameter index."""
+
+    return STATIC if index in _STATIC_INDEXES else MEASURED
+
+
+@dataclass(frozen=True)
+class ParamsConfig:
+    """``robostride_params`` of a bus: the :class:`ParameterClient` arguments."""
+
+    host_id: int = 0xFD
+    window: int = 4
+    timeout: float = 0.1
+    retries: int = 2
+    cache: bool = True
+    max_age: Optional[float] = None  # seconds a cached value is trusted; None: until a write or save
+    prefetch: Union[bool, Tuple[int, ...]] = ()  # motors read at start; True: the bus's topology and reporting motors
+
+
+def params_entry(value: Any, context: str) -> Optional[ParamsConfig]:
+    """Parse ``robostride_params``: a mapping, or true for the defaults; None when absent."""
+
+    if not value:
+        return None
+    if value is True:
+        return ParamsConfig()
+    if not isinstance(value, Mapping):
+        raise ValueError(f"{context}.robostride_params must be true or a mapping")
+    unknown = sorted(set(value) - {"host_id", "window", "timeout", "retries", "cache", "max_age", "prefetch"})
+    if unknown:
+        raise ValueError(f"{context}.robostride_params: unknown key(s) {unknown}")
+    host_id = value.get("host_id", 0xFD)
+    timeout = float(value.get("timeout", 0.1))
+    if timeout <= 0:
+        raise ValueError(f"{context}.robostride_params.timeout must be positive, got {timeout:g}")
+    max_age = value.get("max_age")
+    if max_age is not None and float(max_age) <= 0:
+        raise ValueError(f"{context}.robostride_params.max_age must be positive, got {float(max_age):g}")
+    prefetch = value.get("prefetch", ())
+    if prefetch is not True:
+        if prefetch is False or prefetch is None:
+            prefetch = ()
+        elif not isinstance(prefetch, (list, tuple)):
+            raise ValueError(f"{context}.robostride_params.prefetch must be true or a list of motor IDs")
+        prefetch = tuple(int(m, 0) if isinstance(m, str) else int(m) for m in prefetch)
+    return ParamsConfig(
+        host_id=(int(host_id, 0) if isinstance(host_id, str) else int(host_id)) & 0xFF,
+        window=int(value.get("window", 4)),
+        timeout=timeout,
+        retries=int(value.get("retries", 2)),
+        cache=bool(value.get("cache", True)),
+        max_age=None if max_age is None else float(max_age),
+        prefetch=prefetch,
+    )
+
+
+class ParameterCache:
+    """Last known raw values of the STATIC parameters of one bus's motors.
+
+    Shared by every :class:`ParameterClient` of the bus (``service.param_cache``),
+    so a write through one client is seen by the reads of all. Values are the
+    answer's bytes 4-7, decoded with the format the reader asks for. Thread-safe.
+    """
+
+    def __init__(self, max_age: Optional[float] = None):
+        self.max_age = max_age
+        self.hits = 0
+        self.misses = 0
+        self._lock = threading.Lock()
+        self._values: Dict[Tuple[int, int], Tuple[bytes, float]] = {}  # (motor, index) -> (raw, read at)
+        self._gen: Dict[Tuple[int, int], int] = {}  # bumped by invalidate, so a read older than it is not kept
+        self._motor_gen: Dict[int, int] = {}
+
+    def get(self, motor: int, index: int) -> Optional[bytes]:
+        with self._lock:
+            entry = self._values.get((motor, index))
+            if entry is not None and self.max_age is not None and time.monotonic() - entry[1] > self.max_age:
+                del self._values[(motor, index)]
+                entry = None
+            if entry is None:
+                self.misses += 1
+                return None
+            self.hits += 1
+            return entry[0]
+
+    def token(self, motor: int, index: int) -> Tuple[int, int]:
+        """Taken when a read is sent; :meth:`put` keeps the answer only if nothing invalidated it since."""
+
+        with self._lock:
+            return self._gen.get((motor, index), 0), self._motor_gen.get(motor, 0)
+
+    def put(self, motor: int, index: int, raw: bytes, token: Tuple[int, int]) -> bool:
+        if volatility(index) != STATIC:
+            return False
+        with self._lock:
+            if token != (self._gen.get((motor, index), 0), self._motor_gen.get(motor, 0)):
+                return False
+            self._values[(motor, index)] = (bytes(raw), time.monotonic())
+            return True
+
+    def invalidate(self, motor: Optional[int] = None, index: Optional[int] = None) -> None:
+        """Drop one parameter of a motor, every parameter of a motor, or everything."""
+
+        with self._lock:
+            if motor is None:
+                for m in {m for m, _ in self._values} | set(self._motor_gen):
+                    self._motor_gen[m] = self._motor_gen.get(m, 0) + 1
+                self._values.clear()
+            elif index is None:
+                self._motor_gen[motor] = self._motor_gen.get(motor, 0) + 1
+                for key in [k for k in self._values if k[0] == motor]:
+                    del self._values[key]
+            else:
+                self._gen[(motor, index)] = self._gen.get((motor, index), 0) + 1
+                self._values.pop((motor, index), None)
+
+    def __len__(self) -> int:
+        return len(self._values)
+
+
+class _Request:
+    __slots__ = ("motor", "index", "fmt", "write", "frame", "future", "deadline", "attempts", "token")
+
+    def __init__(self, motor: int, index: int, fmt: str, write: bool, frame: Tuple[int, bytes]):
+        self.motor = motor
+        self.index = index
+        self.fmt = fmt
+        self.write = write
+        self.frame = frame  # (arbitration_id, data), resent as is on retry
+        self.future: Future = Future()
+        self.deadline = 0.0
+        self.attempts = 0
+        self.token: Optional[Tuple[int, int]] = None  # ParameterCache.token of a cacheable read
+
+
+class ParameterClient:
+    """Type 17/18 parameter access to the RoboStride motors on one bus.
+
+    ``host_id`` is the ID the motors answer to (0xFD is the RoboStride
+    default). Thread-safe; answers are matched on the service's RX thread and
+    timeouts on a thread of the client's own. ``cache`` defaults to the
+    service's ``param_cache``, else one of the client's own; False reads
+    every value from the motor.
+    """
+
+    def __init__(self, service, host_id: int = 0xFD, window: int = 4, timeout: float = 0.1, retries: int = 2,
+                 cache: Union[ParameterCache, bool, None] = None):
+        self.service = service
+        self.host_id = host_id & 0xFF
+        self.window = max(1, window)
+        self.timeout = timeout
+        self.retries = max(0, retries)
+        self._cond = threading.Condition()
+        self._queued: Dict[int, Deque[_Request]] = {}     # motor -> requests not sent yet
+        self._in_flight: Dict[int, int] = {}               # motor -> requests sent, not answered
+        self._reads: Dict[Tuple[int, int], _Request] = {}  # (motor, index) -> read in flight
+        self._writes: Dict[int, _Request] = {}             # motor -> write in flight
+        self._latest: Dict[Tuple[int, int], _Request] = {}  # newest pending request per parameter
+        self._closed = False
+        if cache is None or cache is True:
+            # The service's None: its config turned the cache off
+            cache = service.param_cache if hasattr(service, "param_cache") else ParameterCache()
+        self.cache: Optional[ParameterCache] = cache if isinstance(cache, ParameterCache) else None
+        # Keyed per client: two clients with one host ID (the bus's and active reporting's) both get answers
+        prefix = f"robostride_params_{self.host_id:02X}_{id(self):x}"
+        self._keys = (f"{prefix}_read", f"{prefix}_ack", f"{prefix}_write", f"{prefix}_save")
+        service.register_raw_handler(self._keys[0], TYPE_READ << 24 | self.host_id, self._on_read, _ANSWER_MASK)
+        service.register_raw_handler(self._keys[1], TYPE_FEEDBACK << 24 | self.host_id, self._on_feedback,
+                                     _ANSWER_MASK)
+        if self.cache is not None:
+            # Writes and saves of other hosts on the bus
+            service.register_raw_handler(self._keys[2], TYPE_WRITE << 24, self._on_foreign, _TYPE_MASK)
+            service.register_raw_handler(self._keys[3], TYPE_SAVE << 24, self._on_foreign, _TYPE_MASK)
+        self._thread = threading.Thread(target=self._expire_loop, name=f"{service.cfg.name}-params", daemon=True)
+        self._thread.start()
+
+    def read(self, motor: int, parameter: Parameter, fresh: bool = False) -> Future:
+        """Future of the parameter's value: float for ``f`` parameters, else int.
+
+        A cached STATIC value comes back as a future that is already done.
+        ``fresh`` asks the motor in any case and caches the answer.
+        """
+
+        index, fmt = self._resolve(parameter)
+        cacheable = self.cache is not None and volatility(index) == STATIC
+        with self._cond:
+            pending = self._latest.get((motor, index))
+            if pending is not None and not pending.write and not pending.future.done():
+                return pending.future
+            if cacheable and not fresh and pending is None:
+                raw = self.cache.get(motor, index)
+                if raw is not None:
+                    future: Future = Future()
+                    future.set_result(struct.unpack_from("<" + fmt, raw)[0])
+                    return future
+        data = struct.pack("<H6x", index)
+        request = _Request(motor, index, fmt, False, (self._request_id(TYPE_READ, motor), data))
+        if cacheable:
+            request.token = self.cache.token(motor, index)
+        return self._submit(request)
+
+    def write(self, motor: int, parameter: Parameter, value: Union[int, float]) -> Future:
+        """Future resolved (to None) when the motor acknowledges the volatile write.
+
+        Persist written values with a type 22 save; they are lost at power-off.
+        """
+
+        index, fmt = self._resolve(parameter)
+        data = struct.pack("<H2x", index) + struct.pack("<" + fmt, value).ljust(4, b"\0")
+        if self.cache is not None:
+            self.cache.invalidate(motor, index)
+        return self._submit(_Request(motor, index, fmt, True, (self._request_id(TYPE_WRITE, motor), data)))
+
+    def save(self, motor: int) -> Future:
+        """Future resolved (to None) when the motor acknowledges a type 22 save of its parameters.
+
+        A save waits for the motor's writes queued before it, and is acknowledged like one.
+        """
+
+        frame = (self._request_id(TYPE_SAVE, motor), _SAVE_PAYLOAD)
+        if self.cache is not None:
+            self.cache.invalidate(motor)
+        return self._submit(_Request(motor, _SAVE_INDEX, "", True, frame))
+
+    def read_all(
+        self, motors: Iterable[int], parameters: Optional[Iterable[str]] = None, fresh: bool = False
+    ) -> Dict[Tuple[int, str], Future]:
+        """``read`` of every parameter (all of :data:`PARAMETERS` by default) of every motor."""
+
+        names = list(PARAMETERS if parameters is None else parameters)
+        return {(motor, name): self.read(motor, name, fresh) for motor in motors for name in names}
+
+    def prefetch(self, motors: Iterable[int]) -> Dict[Tuple[int, str], Future]:
+        """Fresh reads of every STATIC parameter of ``motors``, filling the cache; does not wait."""
+
+        names = [name for name in PARAMETERS if VOLATILITY.get(name, STATIC) == STATIC]
+        return self.read_all(motors, names, fresh=True)
+
+    def close(self) -> None:
+        """Stop matching answers; requests still pending fail with ``RuntimeError``."""
+
+        with self._cond:
+            if self._closed:
+                return
+            self._closed = True
+            pending = [r for q in self._queued.values() for r in q]
+            pending += list(self._reads.values()) + list(self._writes.values())
+            self._queued.clear()
+            self._reads.clear()
+            self._writes.clear()
+            self._in_flight.clear()
+            self._latest.clear()
+            self._cond.notify_all()
+        for key in self._keys:
+            self.service.unregister_raw_handler(key)
+        self._thread.join(timeout=1.0)
+        for request in pending:
+            if not request.future.cancel():
+                request.future.set_exception(RuntimeError("ParameterClient closed"))
+
+    # ------------------------------------------------------------------
+    # Internal helpers
+
+    @staticmethod
+    def _resolve(parameter: Parameter) -> Tuple[int, str]:
+        if isinstance(parameter, str):
+            try:
+                return PARAMETERS[parameter]
+            except KeyError:
+                raise KeyError(f"Unknown RoboStride parameter '{parameter}'") from None
+        index, fmt = parameter
+        if struct.calcsize("<" + fmt) > 4:
+            raise ValueError(f"parameter 0x{index:04X}: values are at most 4 bytes, got '{fmt}'")
+        return index, fmt
+
+    def _request_id(self, comm_type: int, motor: int) -> int:
+        return (comm_type & 0x1F) << 24 | self.host_id << 8 | (motor & 0xFF)
+
+    def _submit(self, request: _Request) -> Future:
+        out = []
+        with self._cond:
+            if self._closed:
+                raise RuntimeError("ParameterClient closed")
+            self._queued.setdefault(request.motor, deque()).append(request)
+            self._latest[(request.motor, request.index)] = request
+            self._pump(request.motor, out)
+        self._send(out)
+        return request.future
+
+    def _pump(self, motor: int, out: list) -> None:
+        """Start the motor's queued requests while its window has room (under the lock)."""
+
+        queue = self._queued.get(motor)
+        while queue and self._in_flight.get(motor, 0) < self.window:
+            request = queue[0]
+            write = self._writes.get(motor)
+            if request.write:
+                if write is not None or (motor, request.index) in self._reads:
+                    break
+            elif (motor, request.index) in self._reads or (write is not None and write.index == request.index):
+                break
+            queue.popleft()
+            if not request.future.set_running_or_notify_cancel():
+                self._forget(request)
+                continue
+            if request.write:
+                self._writes[motor] = request
+            else:
+                self._reads[(motor, request.index)] = request
+            self._in_flight[motor] = self._in_flight.get(motor, 0) + 1
+            request.attempts = 1
+            request.deadline = time.monotonic() + self.timeout
+            out.append(request.frame)
+        if not queue:
+            self._queued.pop(motor, None)
+        self._cond.notify()
+
+    def _forget(self, request: _Request) -> None:
+        key = (request.motor, request.index)
+        if self._latest.get(key) is request:
+            del self._latest[key]
+
+    def _finish(self, request: _Request, out: list) -> None:
+        """Free the request's slot and start what it held back (under the lock)."""
+
+        if request.write:
+            del self._writes[request.motor]
+        else:
+            del self._reads[(request.motor, request.index)]
+        self._in_flight[request.motor] -= 1
+        self._forget(request)
+        self._pump(request.motor, out)
+
+    def _send(self, frames) -> None:
+        for arbitration_id, data in frames:
+            try:
+                self.service.send_raw(arbitration_id, data, tx_class="parameter")
+            except OSError as exc:  # a full TX queue: the timeout sends it again
+                LOG.debug("[%s] parameter request 0x%X not sent: %s", self.service.cfg.name, arbitration_id, exc)
+
+    def _on_read(self, arbitration_id: int, data: Optional[bytes], timestamp: float) -> None:
+        if data is None or len(data) < 8:
+            return
+        motor = (arbitration_id >> 8) & 0xFF
+        index = data[0] | data[1] << 8
+        out = []
+        with self._cond:
+            request = self._reads.get((motor, index))
+            if request is None:  # a late answer to a request already retried and answered
+                return
+            self._finish(request, out)
+        self._send(out)
+        try:
+            value = struct.unpack_from("<" + request.fmt, data, 4)[0]
+        except struct.error as exc:
+            request.future.set_exception(exc)
+            return
+        if request.token is not None:
+            self.cache.put(motor, index, data[4:8], request.token)
+        request.future.set_result(value)
+
+    def _on_feedback(self, arbitration_id: int, data: Optional[bytes], timestamp: float) -> None:
+        motor = (arbitration_id >> 8) & 0xFF
+        out = []
+        with self._cond:
+            request = self._writes.get(motor)
+            if request is None:
+                return
+            self._finish(request, out)
+        self._send(out)
+        request.future.set_result(None)
+
+    def _on_foreign(self, arbitration_id: int, data: Optional[bytes], timestamp: float) -> None:
+        """A write or save addressed to a motor by any host: its cached values are no longer known."""
+
+        motor = arbitration_id & 0xFF
+        if (arbitration_id >> 24) & 0x1F == TYPE_SAVE or data is None or len(data) < 2:
+            self.cache.invalidate(motor)
+        else:
+            self.cache.invalidate(motor, data[0] | data[1] << 8)
+
+    def _expire_loop(self) -> None:
+        while True:
+            resend, failed, out = [], [], []
+            with self._cond:
+                if self._closed:
+                    return
+                now = time.monotonic()
+                for request in list(self._reads.values()) + list(self._writes.values()):
+                    if request.deadline > now:
+                        continue
+                    if request.attempts <= self.retries:
+                        request.attempts += 1
+                        request.deadline = now + self.timeout
+                        resend.append(request.frame)
+                    else:
+                        self._finish(request, out)
+                        failed.append(request)
+                if not (resend or failed):
+                    deadlines = [r.deadline for r in self._reads.values()] + [r.deadline for r in self._writes.values()]
+                    self._cond.wait(min(deadlines) - now if deadlines else None)
+                    continue
+            if resend:
+                LOG.debug("[%s] resending %d parameter request(s)", self.service.cfg.name, len(resend))
+            self._send(resend + out)
+            for request in failed:
+                if self.cache is not None:  # gone quiet: it may come back rebooted, without its volatile writes
+                    self.cache.invalidate(request.motor)
+                if request.index == _SAVE_INDEX:
+                    what = "the save"
+                else:
+                    what = f"the {'write' if request.write else 'read'} of 0x{request.index:04X}"
+                request.future.set_exception(TimeoutError(
+                    f"[{self.service.cfg.name}] motor {request.motor} did not answer {what} "
+                    f"after {request.attempts} attempt(s)"))
+
+
+__all__ = [
+    "MEASURED", "PARAMETERS", "STATIC", "VOLATILITY", "ParameterCache", "ParameterClient", "ParamsConfig",
+    "TYPE_SAVE", "params_entry", "volatility",
+]
@@ -0,0 +1,175 @@
+"""Whole-configuration backups of RoboStride motors: dump to YAML, restore only what differs.
+
+:func:`dump` reads every :data:`~.robostride_params.PARAMETERS` entry of
+every motor through one :class:`~.robostride_params.ParameterClient`, past
+its cache, so the motors answer concurrently. The snapshot is a plain mapping, written by
+:func:`save_snapshot` as versioned YAML::
+
+    format: td_can_robostride_params
+    version: 1
+    taken: '2026-10-14T09:30:00+0000'
+    interface: can0
+    host_id: 253
+    motors:
+      1: {loc_kp: 30.0, limit_spd: 10.0, ...}
+    unread:                      # parameters that timed out, per motor
+      2: [canTimeout]
+
+:func:`restore` reads the motors' current values first and writes only the
+parameters that differ. Floats are compared as the 32-bit values the motor
+stores. Measurements (``mechPos``, ``VBUS``, ...) are never written.
+Targets and the run mode (``loc_ref``, ``run_mode``, ...) are only written
+with ``include_runtime``, because writing them moves the motor. With
+``save`` a type 22 save follows the writes of each motor that changed.
+"""
+
+from __future__ import annotations
+
+import struct
+import time
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Any, Dict, Iterable, List, Optional, Tuple
+
+import yaml
+
+from .robostride_params import PARAMETERS, ParameterClient
+
+SNAPSHOT_FORMAT = "td_can_robostride_params"
+SNAPSHOT_VERSION = 1
+
+# Read-only measurements
+MEASUREMENTS = frozenset({"mechPos", "iqf", "mechVel", "VBUS"})
+# Writable, but writing them commands motion or changes the control mode
+RUNTIME = frozenset({"run_mode", "iq_ref", "spd_ref", "loc_ref"})
+
+
+def _same(fmt: str, a: Any, b: Any) -> bool:
+    # A float survives a 32-bit round trip only approximately: compare what the motor would store
+    if fmt == "f":
+        return struct.pack("<f", float(a)) == struct.pack("<f", float(b))
+    return int(a) == int(b)
+
+
+def _gather(futures: Dict[Tuple[int, str], Any]) -> Tuple[Dict[int, Dict[str, Any]], Dict[int, List[str]]]:
+    values: Dict[int, Dict[str, Any]] = {}
+    failed: Dict[int, List[str]] = {}
+    for (motor, name), future in futures.items():
+        try:
+            values.setdefault(motor, {})[name] = future.result()
+        except (TimeoutError, RuntimeError):
+            values.setdefault(motor, {})
+            failed.setdefault(motor, []).append(name)
+    return values, failed
+
+
+def dump(client: ParameterClient, motors: Iterable[int], parameters: Optional[Iterable[str]] = None) -> Dict[str, Any]:
+    """Snapshot of the parameters (all of them by default) of every motor; ``seconds`` is the time taken."""
+
+    start = time.perf_counter()
+    values, failed = _gather(client.read_all(list(motors), parameters, fresh=True))
+    snapshot: Dict[str, Any] = {
+        "format": SNAPSHOT_FORMAT,
+        "version": SNAPSHOT_VERSION,
+        "taken": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+        "interface": client.service.cfg.interface,
+        "host_id": client.host_id,
+        "motors": values,
+    }
+    if failed:
+        snapshot["unread"] = failed
+    snapshot["seconds"] = round(time.perf_counter() - start, 3)
+    return snapshot
+
+
+def save_snapshot(snapshot: Dict[str, Any], path) -> None:
+    Path(path).write_text(yaml.safe_dump(snapshot, sort_keys=False))
+
+
+def load_snapshot(path) -> Dict[str, Any]:
+    """The snapshot in ``path``; ValueError when it is not one, or of a newer version."""
+
+    snapshot = yaml.safe_load(Path(path).read_text()) or {}
+    if not isinstance(snapshot, dict) or snapshot.get("format") != SNAPSHOT_FORMAT:
+        raise ValueError(f"{path} is not a RoboStride parameter snapshot")
+    version = snapshot.get("version")
+    if not isinstance(version, int) or version > SNAPSHOT_VERSION:
+        raise ValueError(f"{path}: snapshot version {version!r}, this tool reads up to {SNAPSHOT_VERSION}")
+    unknown = sorted({name for params in snapshot.get("motors", {}).values() for name in params} - set(PARAMETERS))
+    if unknown:
+        raise ValueError(f"{path}: unknown parameters {unknown}")
+    return snapshot
+
+
+@dataclass
+class RestoreResult:
+    written: Dict[int, Dict[str, Tuple[Any, Any]]] = field(default_factory=dict)  # motor -> name -> (old, new)
+    unchanged: int = 0
+    failed: Dict[int, List[str]] = field(default_factory=dict)   # reads or writes that timed out
+    saved: List[int] = field(default_factory=list)
+    seconds: float = 0.0
+
+    def summary(self) -> str:
+        writes = sum(len(v) for v in self.written.values())
+        failures = sum(len(v) for v in self.failed.values())
+        return (f"{writes} parameter(s) written on {len(self.written)} motor(s), {self.unchanged} unchanged, "
+                f"{failures} failed, {len(self.saved)} saved in {self.seconds:.2f} s")
+
+
+def restore(
+    client: ParameterClient,
+    snapshot: Dict[str, Any],
+    motors: Optional[Iterable[int]] = None,
+    save: bool = False,
+    include_runtime: bool = False,
+    dry_run: bool = False,
+) -> RestoreResult:
+    """Writes the snapshot's values that differ from the motors' current ones."""
+
+    start = time.perf_counter()
+    wanted = {int(m): params for m, params in snapshot.get("motors", {}).items()}
+    # Only the given motors of the snapshot, all of them by default
+    targets = wanted if motors is None else {m: wanted[m] for m in motors if m in wanted}
+    skip = MEASUREMENTS if include_runtime else MEASUREMENTS | RUNTIME
+    names = {m: [n for n in params if n not in skip] for m, params in targets.items()}
+
+    result = RestoreResult()
+    current, failed = _gather({(m, n): client.read(m, n, fresh=True) for m, ns in names.items() for n in ns})
+    for motor, params in failed.items():
+        result.failed.setdefault(motor, []).extend(params)
+
+    writes: Dict[Tuple[int, str], Any] = {}
+    for motor, ns in names.items():
+        for name in ns:
+            if name not in current.get(motor, {}):
+                continue
+            old, new = current[motor][name], targets[motor][name]
+            if _same(PARAMETERS[name][1], old, new):
+                result.unchanged += 1
+                continue
+            result.written.setdefault(motor, {})[name] = (old, new)
+            if not dry_run:
+                writes[(motor, name)] = client.write(motor, name, new)
+    saves = {m: client.save(m) for m in result.written} if save and not dry_run else {}
+
+    for (motor, name), future in writes.items():
+        try:
+            future.result()
+        except (TimeoutError, RuntimeError):
+            del result.written[motor][name]
+            result.failed.setdefault(motor, []).append(name)
+    for motor, future in saves.items():
+        try:
+            future.result()
+            result.saved.append(motor)
+        except (TimeoutError, RuntimeError):
+            result.failed.setdefault(motor, []).append("save")
+    result.written = {m: w for m, w in result.written.items() if w}
+    result.seconds = time.perf_counter() - start
+    return result
+
+
+__all__ = [
+    "MEASUREMENTS", "RUNTIME", "RestoreResult", "SNAPSHOT_FORMAT", "SNAPSHOT_VERSION",
+    "dump", "load_snapshot", "restore", "save_snapshot",
+]
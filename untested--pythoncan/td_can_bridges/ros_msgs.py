@@ -0,0 +1,170 @@
+"""ROS message definitions generated from DBC messages.
+
+One ROS message per DBC message lets an RX binding publish a whole decoded
+frame at once (``publish: frame``, see :class:`td_can_bridges.mapping.RxBinding`)
+instead of one ``std_msgs`` topic per signal. :func:`render_msg` writes the
+``.msg`` text: a ``std_msgs/Header`` stamped with the frame's receive time,
+then one field per signal, named by :func:`field_name` and typed like the
+value the service decodes (an integer for unscaled integer signals, a float
+otherwise). Signals with choices get a constant per choice.
+:func:`render_package` adds the ``package.xml`` and ``CMakeLists.txt`` of an
+interface package that ``colcon build`` turns into importable types; see
+``scripts/dbc_to_msgs.py``.
+
+The naming is shared with the bridge, so a binding finds the fields of a
+generated type without any configuration.
+"""
+
+from __future__ import annotations
+
+import re
+from typing import Any, Callable, Dict, Iterable, List, Tuple
+
+DEFAULT_PACKAGE = "td_can_msgs"
+
+_INT_WIDTHS = (8, 16, 32, 64)
+
+
+def type_name(message_name: str) -> str:
+    """ROS type name of a DBC message: ``RS02_Status1`` -> ``RS02Status1``."""
+
+    parts = [p for p in re.split(r"[^0-9A-Za-z]+", message_name) if p]
+    name = "".join(p[0].upper() + p[1:] for p in parts)
+    if not name or not name[0].isalpha():
+        name = "M" + name
+    return name
+
+
+def field_name(signal_name: str) -> str:
+    """ROS field name of a DBC signal: lower case, ``phase_current_A`` -> ``phase_current_a``."""
+
+    name = re.sub(r"[^0-9a-z]+", "_", signal_name.lower()).strip("_")
+    if not name or not name[0].isalpha():
+        name = "s_" + name
+    return name
+
+
+def _constant_name(text: str, value: int) -> str:
+    """A ``.msg`` constant name for a value label; ``V_<value>`` when nothing of the label is left."""
+
+    name = re.sub(r"[^0-9A-Z]+", "_", str(text).upper()).strip("_")
+    if not name:
+        return "V_" + _value_suffix(value)
+    return name if name[0].isalpha() else "V_" + name
+
+
+def _value_suffix(value: int) -> str:
+    return str(value) if value >= 0 else f"MINUS_{-value}"
+
+
+def value_constants(signal) -> List[Tuple[str, int]]:
+    """``(name, value)`` of the signal's value labels, by value; one name per constant."""
+
+    out, used = [], set()
+    for value, label in sorted((signal.choices or {}).items()):
+        name = _constant_name(label, int(value))
+        if name in used:
+            # Labels that sanitize alike get their value appended: each constant is declared once
+            name = f"{name}_{_value_suffix(int(value))}"
+        used.add(name)
+        out.append((name, int(value)))
+    return out
+
+
+def is_integer(signal) -> bool:
+    """True when the service decodes ``signal`` to an int; matches the compiled decoders."""
+
+    return not signal.is_float and signal.scale == 1 and signal.offset == 0
+
+
+def field_type(signal) -> str:
+    """ROS primitive holding the decoded value of ``signal``."""
+
+    if not is_integer(signal):
+        return "float32" if signal.is_float and signal.length == 32 else "float64"
+    width = next((w for w in _INT_WIDTHS if signal.length <= w), 64)
+    return f"int{width}" if signal.is_signed else f"uint{width}"
+
+
+def render_msg(msg_def) -> str:
+    """``.msg`` text for one DBC message."""
+
+    lines = [f"# DBC message {msg_def.name} (0x{msg_def.frame_id:X}), generated by scripts/dbc_to_msgs.py",
+             "std_msgs/Header header  # stamp: receive time of the frame"]
+    for signal in msg_def.signals:
+        kind = field_type(signal)
+        if is_integer(signal):
+            for name, value in value_constants(signal):
+                lines.append(f"{kind} {field_name(signal.name).upper()}_{name}={value}")
+        comment = f"  # {signal.unit}" if getattr(signal, "unit", None) else ""
+        lines.append(f"{kind} {field_name(signal.name)}{comment}")
+    return "\n".join(lines) + "\n"
+
+
+def render_package(messages: Iterable[Any], package: str = DEFAULT_PACKAGE) -> Dict[str, str]:
+    """Relative path -> text of an interface package with one message per DBC message."""
+
+    files = {f"msg/{type_name(m.name)}.msg": render_msg(m) for m in messages}
+    names = " ".join(f'"{path}"' for path in sorted(files))
+    files["CMakeLists.txt"] = f"""cmake_minimum_required(VERSION 3.8)
+project({package})
+
+find_package(ament_cmake REQUIRED)
+find_package(std_msgs REQUIRED)
+find_package(rosidl_default_generators REQUIRED)
+
+rosidl_generate_interfaces(${{PROJECT_NAME}} {names} DEPENDENCIES std_msgs)
+
+ament_export_dependencies(rosidl_default_runtime)
+ament_package()
+"""
+    files["package.xml"] = f"""<?xml version="1.0"?>
+<package format="3">
+  <name>{package}</name>
+  <version>0.1.0</version>
+  <description>ROS messages of DBC frames, generated by td_can_bridges scripts/dbc_to_msgs.py.</description>
+  <maintainer email="td@example.com">td</maintainer>
+  <license>MIT</license>
+
+  <buildtool_depend>ament_cmake</buildtool_depend>
+  <buildtool_depend>rosidl_default_generators</buildtool_depend>
+  <depend>std_msgs</depend>
+  <exec_depend>rosidl_default_runtime</exec_depend>
+  <member_of_group>rosidl_interface_packages</member_of_group>
+
+  <export>
+    <build_type>ament_cmake</build_type>
+  </export>
+</package>
+"""
+    return files
+
+
+def _to_int(value: Any) -> int:
+    return int(getattr(value, "value", value))  # cantools NamedSignalValue for a choice
+
+
+def _to_float(value: Any) -> float:
+    return float(getattr(value, "value", value))
+
+
+def frame_fields(msg_def) -> List[tuple[str, str, Callable[[Any], Any]]]:
+    """``(signal, field, convert)`` for each signal of ``msg_def`` in its generated type.
+
+    ``convert`` turns the decoded value into what the field accepts: rclpy
+    rejects a float in an integer field and a choice name in either.
+    """
+
+    return [(s.name, field_name(s.name), _to_int if is_integer(s) else _to_float) for s in msg_def.signals]
+
+
+__all__ = [
+    "DEFAULT_PACKAGE",
+    "field_name",
+    "field_type",
+    "frame_fields",
+    "render_msg",
+    "render_package",
+    "type_name",
+    "value_constants",
+]
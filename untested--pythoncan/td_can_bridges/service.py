@@ -11,18 +11,80 @@ teams can build on the same infrastructure without pulling in rclpy.
 from __future__ import annotations
 
 import logging
+import operator
+import os
+import struct
 import threading
-from dataclasses import dataclass, field
+import time
+from contextlib import contextmanager
+from dataclasses import dataclass, field, replace
 from pathlib import Path
-from typing import Any, Callable, Dict, Iterable, List, Mapping, MutableMapping, Optional
+from typing import Any, Callable, Dict, Iterable, List, Mapping, MutableMapping, Optional, Tuple
 
 import can
-import cantools
 import yaml
 
+from .adapter_caps import AdapterCaps, read_adapter_caps
+from .bus_errors import CAN_ERR_MASK, BusErrorMonitor, enable_error_frames
+from .bus_load import LOAD_ACTIONS, check_bus_load, declares_traffic, interface_bits, plan_bus
+from .binding_profile import BindingProfiler, ProfileConfig, profile_entry
+from .cache import cached, load_dbc
+from .can_gateway import CanGateway, GatewayRoute, gateway_entry
+from .decoders import Decoder, compile_decoder, native_layout
+from .devices import expand_devices
+from .encoders import compile_packer
+from .frame_loss import LossConfig, LossTracker, StageAttribution, interface_drops, loss_entry
+from .handler_pool import OVERFLOW_POLICIES, HandlerPool
+from .load_shedding import LoadShedder, SheddingConfig, shedding_entry
+from .metrics import BusMetrics
+from .packet_capture import PacketCapture, capture_entry
+from .pipeline_trace import FrameSpan, PipelineTracer
+from .recorder import DEFAULT_RING_FRAMES, FrameRecorder, FrameRing
+from .signal_store import SignalStore, default_path
+from .socket_buffers import SocketBufferConfig, SocketBufferTuner, plan_socket_buffers, socket_buffers_entry
+from .socketcan_rx import (
+    CAN_EFF_FLAG,
+    CAN_EFF_MASK,
+    CAN_ERR_FLAG,
+    CAN_MTU,
+    CANFD_BRS,
+    CANFD_MTU,
+    MSG_DONTWAIT,
+    BatchReceiver,
+    build_can_filters,
+    enable_overflow_count,
+    enable_timestamps,
+)
+from .socketcan_tx import BatchSender
+from .robostride_faults import FaultConfig, FaultMonitor, faults_entry
+from .robostride_params import ParameterCache, ParameterClient, ParamsConfig, params_entry
+from .robostride_reporting import FEEDBACK_MASK, MOTOR_ID_BITS, ActiveReporting, ReportingConfig, reporting_entry
+from .topology import BusShare, TopologyConfig, expand_topology
+from .tx_coalesce import COALESCE_MODES, TxCoalescer
+from .tx_schedule import ScheduleConfig, TxSchedule, schedule_entry
+from .tx_scheduler import DEFAULT_TX_CLASS, NativeTxScheduler, TxClassConfig, TxScheduler, merge_classes
+from .uplink import TelemetryUplink, UplinkConfig, uplink_entry
+
+try:
+    from . import _can_core  # native/; built by setup.py when pybind11 is available
+except ImportError:  # pragma: no cover - depends on the build
+    _can_core = None
+
 
 LOG = logging.getLogger(__name__)
 
+# cpu -> the _can_core.BusyPoller thread spinning there, shared by every bus with rx_busy_poll on it
+_BUSY_POLLERS: Dict[int, Any] = {}
+_BUSY_POLLERS_LOCK = threading.Lock()
+
+RX_MODES = ("direct", "native", "notifier")
+# native: the TX queue runs in _can_core, see NativeTxScheduler
+TX_MODES = ("python", "native")
+RX_TIMESTAMPS = ("software", "hardware")
+# tritoncand: a client of the shared-memory daemon, see tritoncand_bus; sim: an in-process bus, see sim_bus
+BUS_SOURCES = ("socketcan", "tritoncand", "auto", "sim")
+_FD_LENGTHS = (0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64)
+
 
 # ---------------------------------------------------------------------------
 # Configuration dataclasses
@@ -36,12 +98,28 @@ class TxBindingConfig:
     dictionary keys) to DBC signal names. Additional metadata from the YAML
     file is stored in ``metadata`` and left uninterpreted so higher layers can
     attach their own meaning (topic name, QoS profile, etc.).
+
+    With ``period_ms`` the frame is sent by the SocketCAN broadcast manager
+    at that period and :meth:`CanBusService.send` only replaces its payload.
+    ``hold_ms`` stops the cyclic frame when no payload arrived for that long.
+
+    ``tx_class`` picks the bus's TX queue class (``BusConfig.tx_classes``);
+    see :mod:`td_can_bridges.tx_scheduler`. ``rate_hz`` declares the most
+    frames per second a binding without ``period_ms`` sends, for the bus load
+    check (:mod:`td_can_bridges.bus_load`). ``coalesce="latest"`` keeps only
+    the newest unsent frame and writes it at most ``rate_hz`` times a second;
+    see :mod:`td_can_bridges.tx_coalesce`.
     """
 
     key: str
     message: str
     fields: Mapping[str, str] = field(default_factory=dict)
     metadata: Mapping[str, Any] = field(default_factory=dict)
+    period_ms: Optional[float] = None
+    hold_ms: Optional[float] = None
+    tx_class: str = DEFAULT_TX_CLASS
+    rate_hz: Optional[float] = None
+    coalesce: Optional[str] = None  # "latest"
 
 
 @dataclass(frozen=True)
@@ -51,12 +129,45 @@ class RxBindingConfig:
     ``fields`` maps DBC signal names to user-friendly keys. As with
     :class:`TxBindingConfig`, any additional metadata is retained for the
     consumer.
+
+    ``queue_size`` and ``overflow`` only apply when the bus runs handlers
+    on workers (``BusConfig.rx_workers``); see
+    :mod:`td_can_bridges.handler_pool`. ``priority`` orders those workers,
+    and decides which bindings a bus with ``shedding`` sheds first (lowest;
+    :mod:`td_can_bridges.load_shedding`).
+
+    ``can_id`` overrides the DBC frame ID. With ``id_mask`` only the masked
+    bits of ``can_id`` must match, so one binding covers a family of IDs
+    (RoboStride feedback: comm type 2, any motor). ``id_fields`` names
+    inclusive ``(low, high)`` bit ranges of the received ID that are added
+    to the payload, e.g. ``{"motor_id": (8, 15)}``.
+
+    ``rate_hz`` declares how many frames per second the devices send, for
+    the bus load check. ``loss`` counts the frames that never arrived
+    (:mod:`td_can_bridges.frame_loss`).
     """
 
     key: str
     message: str
     fields: Mapping[str, str] = field(default_factory=dict)
     metadata: Mapping[str, Any] = field(default_factory=dict)
+    queue_size: int = 16
+    overflow: str = "latest"
+    priority: int = 0
+    can_id: Optional[int] = None
+    id_mask: Optional[int] = None
+    id_fields: Mapping[str, tuple[int, int]] = field(default_factory=dict)
+    rate_hz: Optional[float] = None
+    loss: Optional[LossConfig] = None
+
+
+@dataclass(frozen=True)
+class BusyPollConfig:
+    """``rx_busy_poll``: a thread spinning on ``cpu`` reads the bus (``native/busy_poll.hpp``)."""
+
+    cpu: int
+    spin_us: int = 100  # the RX thread spins this long on an empty ring before it sleeps; -1: always
+    ring: int = 4096    # frames between the spinning thread and the RX thread
 
 
 @dataclass(frozen=True)
@@ -66,10 +177,39 @@ class BusConfig:
     name: str
     interface: str
     dbc_file: Path
+    # Or "tritoncand": attach to the daemon that owns the interface; "auto": see pick_source;
+    # "sim": an in-process SimBus on the network named by interface, see td_can_bridges.sim_bus
+    source: str = "socketcan"
     bitrate: int = 500_000
     fd: bool = False
     dbitrate: Optional[int] = None
     filters: Optional[Iterable[MutableMapping[str, int]]] = None
+    auto_filters: bool = False
+    rx_mode: str = "direct"
+    rx_batch: int = 64
+    rx_timestamps: str = "software"
+    rx_workers: int = 0  # 0 runs handlers on the RX thread
+    rx_busy_poll: Optional[BusyPollConfig] = None  # rx_mode native only
+    cpu_affinity: Optional[Tuple[int, ...]] = None  # CPUs the RX thread (per-bus process: all threads) runs on
+    signal_store: Optional[Mapping[str, Any]] = None  # {"path": ..., "messages": [...]} or None
+    recorder: Optional[Mapping[str, Any]] = None  # {"path": ..., "max_bytes": ...}, see td_can_bridges.recorder
+    trace: Optional[Mapping[str, Any]] = None  # {"path": ..., "every": ...}, see td_can_bridges.pipeline_trace
+    profile: Optional[ProfileConfig] = None  # sampled cost per binding, see td_can_bridges.binding_profile
+    shedding: Optional[SheddingConfig] = None  # low-priority RX shed under lag, see td_can_bridges.load_shedding
+    socket_buffers: Optional[SocketBufferConfig] = None  # rcvbuf and txqueuelen from the load plan, see td_can_bridges.socket_buffers
+    recovery: Optional[Tuple[float, float]] = (0.1, 5.0)  # first and longest wait (s) before reopening; None: give up
+    metrics: bool = False  # counters and timing histograms, see td_can_bridges.metrics
+    tx_classes: Optional[Mapping[str, TxClassConfig]] = None  # None: send() writes to the socket itself
+    tx_mode: str = "python"  # or "native": the tx_classes queue in _can_core, lock-free for many senders
+    tx_schedule: Optional[ScheduleConfig] = None  # slots per cycle, see td_can_bridges.tx_schedule
+    load_limit: float = 0.8     # declared worst-case traffic allowed, as a fraction of bitrate
+    load_action: str = "warn"   # or "reject": load_bridge_config raises over load_limit
+    robostride_reporting: Optional[ReportingConfig] = None  # type 24 reports, see td_can_bridges.robostride_reporting
+    robostride_faults: Optional[FaultConfig] = None  # type 21 / type 2 faults, see td_can_bridges.robostride_faults
+    robostride_params: Optional[ParamsConfig] = None  # CanBusService.params, see td_can_bridges.robostride_params
+    gateway: Tuple[GatewayRoute, ...] = ()  # can-gw forwarding rules, see td_can_bridges.can_gateway
+    uplink: Optional[UplinkConfig] = None  # chunks of selected messages to a base station, see td_can_bridges.uplink
+    topology: Optional[BusShare] = None  # this bus's motors of a top-level topology, see td_can_bridges.topology
     tx_bindings: Mapping[str, TxBindingConfig] = field(default_factory=dict)
     rx_bindings: Mapping[str, RxBindingConfig] = field(default_factory=dict)
     metadata: Mapping[str, Any] = field(default_factory=dict)
@@ -83,6 +223,8 @@ class BridgeConfig:
     buses: List[BusConfig]
     logging: Mapping[str, Any] = field(default_factory=dict)
     qos: Mapping[str, Any] = field(default_factory=dict)
+    metrics: Mapping[str, Any] = field(default_factory=dict)  # exporters: prometheus_port, diagnostics_period
+    topologies: List[TopologyConfig] = field(default_factory=list)  # their buses are in ``buses``
 
     def get_bus(self, name: str) -> Optional[BusConfig]:
         for bus in self.buses:
@@ -97,22 +239,206 @@ def _require_keys(data: Mapping[str, Any], required: Iterable[str], context: str
         raise ValueError(f"Missing required key(s) {missing} in {context}")
 
 
+def _optional_int(value: Any) -> Optional[int]:
+    """YAML ints, or strings such as ``"0x02000000"``."""
+
+    if value is None:
+        return None
+    return int(value, 0) if isinstance(value, str) else int(value)
+
+
+def _optional_float(value: Any) -> Optional[float]:
+    return None if value is None else float(value)
+
+
+def _signal_store_entry(value: Any, context: str) -> Optional[Mapping[str, Any]]:
+    """``signal_store: true``, a path string or a ``{path, messages, history}`` mapping."""
+
+    if value is None or value is False:
+        return None
+    if value is True:
+        return {}
+    if isinstance(value, str):
+        return {"path": value}
+    if isinstance(value, Mapping):
+        return dict(value)
+    raise ValueError(f"{context}.signal_store must be true, a path or a mapping, got {value!r}")
+
+
+def _cpu_list(value: Any, context: str) -> Optional[Tuple[int, ...]]:
+    """``cpu_affinity``: a list of CPU numbers or a string such as ``"2-3,6"``."""
+
+    if value is None:
+        return None
+    if isinstance(value, int):
+        return (value,)
+    if isinstance(value, str):
+        cpus = []
+        for part in value.split(","):
+            low, _, high = part.strip().partition("-")
+            cpus.extend(range(int(low), int(high or low) + 1))
+        return tuple(cpus)
+    if isinstance(value, (list, tuple)) and value:
+        return tuple(int(cpu) for cpu in value)
+    raise ValueError(f"{context}.cpu_affinity must be a CPU list such as [2, 3] or \"2-3\", got {value!r}")
+
+
+def _recovery_entry(value: Any, context: str) -> Optional[Tuple[float, float]]:
+    """``recovery``: false, or a mapping with ``backoff_s`` and ``max_backoff_s``."""
+
+    if value is False:
+        return None
+    if value is None or value is True:
+        return BusConfig.recovery
+    if isinstance(value, Mapping):
+        first = float(value.get("backoff_s", BusConfig.recovery[0]))
+        longest = float(value.get("max_backoff_s", BusConfig.recovery[1]))
+        if 0 < first <= longest:
+            return (first, longest)
+    raise ValueError(f"{context}.recovery must be false or a mapping with 0 < backoff_s <= max_backoff_s, got {value!r}")
+
+
+def _busy_poll_entry(value: Any, rx_mode: str, context: str) -> Optional[BusyPollConfig]:
+    """``rx_busy_poll``: a CPU number, or a mapping with ``cpu`` and optionally ``spin_us`` and ``ring``."""
+
+    if value is None or value is False:
+        return None
+    if isinstance(value, int) and not isinstance(value, bool):
+        value = {"cpu": value}
+    if not isinstance(value, Mapping) or not isinstance(value.get("cpu"), int) or value["cpu"] < 0:
+        raise ValueError(f"{context}.rx_busy_poll must be a CPU number or a mapping with 'cpu', got {value!r}")
+    if rx_mode != "native":
+        raise ValueError(f"{context}.rx_busy_poll needs rx_mode: native, got '{rx_mode}'")
+    spin_us = int(value.get("spin_us", BusyPollConfig.spin_us))
+    ring = int(value.get("ring", BusyPollConfig.ring))
+    if spin_us < -1 or ring < 1:
+        raise ValueError(f"{context}.rx_busy_poll needs spin_us >= -1 and ring >= 1, got {value!r}")
+    return BusyPollConfig(cpu=value["cpu"], spin_us=spin_us, ring=ring)
+
+
+def _recorder_entry(value: Any, context: str) -> Optional[Mapping[str, Any]]:
+    """``recorder``: a path string or a mapping with ``path``."""
+
+    if value is None or value is False:
+        return None
+    if isinstance(value, str):
+        return {"path": value}
+    if isinstance(value, Mapping) and "path" in value:
+        spec = dict(value)
+        spec["capture"] = capture_entry(spec.get("capture"), context)
+        return spec
+    raise ValueError(f"{context}.recorder must be a path or a mapping with 'path', got {value!r}")
+
+
+def _check_coalesce(binding: TxBindingConfig, schedule: Optional[ScheduleConfig], context: str) -> None:
+    """``coalesce`` needs a rate to write at; cyclic and scheduled bindings are latest-only already."""
+
+    if binding.coalesce is None:
+        return
+    if binding.coalesce not in COALESCE_MODES:
+        raise ValueError(f"{context}.coalesce must be one of {list(COALESCE_MODES)}, got {binding.coalesce!r}")
+    if binding.period_ms or (schedule is not None and schedule.frames_per_s(binding.key)):
+        return
+    if not binding.rate_hz or binding.rate_hz <= 0:
+        raise ValueError(f"{context}.coalesce needs rate_hz > 0, the most frames per second it writes")
+
+
+def check_bindings(bus: BusConfig, dbc) -> None:
+    """Check the bindings of ``bus`` against its DBC, so a typo fails here rather than per frame.
+
+    Every binding's message must exist and its ``fields`` must name signals
+    of it. A TX binding with ``fields`` must cover every signal of a plain
+    message, as the encoders need them all; an RX binding's ``id_fields``
+    must not reuse a field name.
+    """
+
+    messages = {m.name: m for m in dbc.messages}
+    for kind, bindings in (("tx_topics", bus.tx_bindings), ("rx_frames", bus.rx_bindings)):
+        for key, binding in bindings.items():
+            context = f"{bus.name}.{kind}['{key}']"
+            msg_def = messages.get(binding.message)
+            if msg_def is None:
+                raise ValueError(f"{context}: no message '{binding.message}' in {bus.dbc_file.name}")
+            signals = {s.name for s in msg_def.signals}
+            named = set(binding.fields.values() if kind == "tx_topics" else binding.fields)
+            unknown = sorted(named - signals)
+            if unknown:
+                raise ValueError(f"{context}: {msg_def.name} has no signals {unknown}")
+            if kind == "tx_topics":
+                missing = sorted(signals - named)
+                if binding.fields and missing and not msg_def.is_multiplexed():
+                    raise ValueError(f"{context}: fields must set every signal of {msg_def.name}, missing {missing}")
+            else:
+                clash = sorted(set(binding.id_fields) & set(binding.fields.values()))
+                if clash:
+                    raise ValueError(f"{context}: {clash} are both id_fields and fields")
+
+
+def missing_attributes(sample: Any, paths: Iterable[str]) -> List[str]:
+    """The attribute paths (``data``, ``vector.x``) of ``paths`` that ``sample`` lacks."""
+
+    missing = []
+    for path in paths:
+        obj = sample
+        for name in path.split("."):
+            if not name.isidentifier() or not hasattr(obj, name):
+                missing.append(path)
+                break
+            obj = getattr(obj, name)
+    return missing
+
+
+def _trace_entry(value: Any, context: str) -> Optional[Mapping[str, Any]]:
+    """``trace``: a path string or a mapping with ``path``."""
+
+    if value is None or value is False:
+        return None
+    if isinstance(value, str):
+        return {"path": value}
+    if isinstance(value, Mapping) and "path" in value:
+        return dict(value)
+    raise ValueError(f"{context}.trace must be a path or a mapping with 'path', got {value!r}")
+
+
 def load_bridge_config(path: Path | str) -> BridgeConfig:
     """Parse a YAML configuration file and return a :class:`BridgeConfig`.
 
-    Relative DBC paths are resolved relative to the YAML file location.
+    Relative DBC paths are resolved relative to the YAML file location. The
+    result is cached by the file's content, see :mod:`td_can_bridges.cache`.
+    Every bus's bindings are checked against its DBC (:func:`check_bindings`).
+    Buses that declare periodic or rated traffic get the bus load check of
+    :func:`td_can_bridges.bus_load.check_bus_load`.
     """
 
     cfg_path = Path(path).expanduser().resolve()
     if not cfg_path.exists():
         raise FileNotFoundError(cfg_path)
 
-    with cfg_path.open("r", encoding="utf-8") as stream:
-        raw = yaml.safe_load(stream) or {}
+    text = cfg_path.read_bytes()
+    cfg = cached("config", cfg_path, [text], lambda: _parse_bridge_config(cfg_path, text))
+    # Outside the cache: the result depends on the DBC files too, and warnings must show every time
+    for bus in cfg.buses:
+        if not (bus.tx_bindings or bus.rx_bindings or declares_traffic(bus)):
+            continue
+        dbc = load_dbc(bus.dbc_file)
+        check_bindings(bus, dbc)
+        if declares_traffic(bus):
+            check_bus_load(bus, dbc)
+    return cfg
+
+
+def _parse_bridge_config(cfg_path: Path, text: bytes) -> BridgeConfig:
+    raw = yaml.safe_load(text.decode("utf-8")) or {}
+
+    bus_entries = [(f"buses[{idx}]", entry, None) for idx, entry in enumerate(raw.get("buses", []))]
+    topologies: List[TopologyConfig] = []
+    for name, spec in (raw.get("topology") or {}).items():
+        topology, entries = expand_topology(str(name), spec, f"topology.{name}")
+        topologies.append(topology)
+        bus_entries += [(f"topology.{name}[{entry['interface']}]", entry, share) for entry, share in entries]
 
     buses_cfg: List[BusConfig] = []
-    for idx, bus_entry in enumerate(raw.get("buses", [])):
-        context = f"buses[{idx}]"
+    for context, bus_entry, share in bus_entries:
         _require_keys(bus_entry, ["name", "interface", "dbc_file"], context)
 
         dbc_path = Path(bus_entry["dbc_file"])
@@ -123,36 +449,128 @@ def load_bridge_config(path: Path | str) -> BridgeConfig:
         for key, spec in (bus_entry.get("tx_topics") or {}).items():
             _require_keys(spec, ["dbc_message"], f"{context}.tx_topics['{key}']")
             fields = spec.get("fields", {}) or {}
-            metadata = {k: v for k, v in spec.items() if k not in {"dbc_message", "fields"}}
+            metadata = {k: v for k, v in spec.items() if k not in {
+                "dbc_message", "fields", "period_ms", "hold_ms", "tx_class", "rate_hz", "coalesce"
+            }}
             tx_bindings[key] = TxBindingConfig(
                 key=key,
                 message=spec["dbc_message"],
                 fields=fields,
                 metadata=metadata,
+                period_ms=spec.get("period_ms"),
+                hold_ms=spec.get("hold_ms"),
+                tx_class=spec.get("tx_class", DEFAULT_TX_CLASS),
+                rate_hz=_optional_float(spec.get("rate_hz")),
+                coalesce=spec.get("coalesce"),
             )
 
+        tx_mode = bus_entry.get("tx_mode", "python")
+        if tx_mode not in TX_MODES:
+            raise ValueError(f"{context}.tx_mode must be one of {list(TX_MODES)}, got '{tx_mode}'")
+        # Present, even empty, turns the TX queue on with the default classes; so does tx_mode native
+        tx_classes = (merge_classes(bus_entry.get("tx_classes"), context)
+                      if "tx_classes" in bus_entry or tx_mode == "native" else None)
+        for key, binding in tx_bindings.items():
+            if tx_classes is not None and binding.tx_class not in tx_classes:
+                raise ValueError(
+                    f"{context}.tx_topics['{key}'].tx_class must be one of {list(tx_classes)}, got '{binding.tx_class}'"
+                )
+
+        tx_schedule = schedule_entry(bus_entry.get("tx_schedule"), context, tx_bindings)
+        for key, binding in tx_bindings.items():
+            _check_coalesce(binding, tx_schedule, f"{context}.tx_topics['{key}']")
+
+        rx_specs = dict(bus_entry.get("rx_frames") or {})
+        for key, spec in expand_devices(bus_entry.get("devices"), context).items():
+            if key in rx_specs:
+                raise ValueError(f"{context}.devices: entry '{key}' is also in rx_frames")
+            rx_specs[key] = spec
+
         rx_bindings: Dict[str, RxBindingConfig] = {}
-        for key, spec in (bus_entry.get("rx_frames") or {}).items():
+        for key, spec in rx_specs.items():
             message_name = spec.get("dbc_message", key)
-            metadata = {k: v for k, v in spec.items() if k not in {"fields", "dbc_message"}}
+            metadata = {k: v for k, v in spec.items() if k not in {
+                "fields", "dbc_message", "queue_size", "overflow", "priority", "can_id", "id_mask", "id_fields",
+                "rate_hz", "loss",
+            }}
             fields = spec.get("fields", {}) or {}
+            overflow = spec.get("overflow", "latest")
+            if overflow not in OVERFLOW_POLICIES:
+                raise ValueError(
+                    f"{context}.rx_frames.{key}.overflow must be one of {list(OVERFLOW_POLICIES)}, got '{overflow}'"
+                )
             rx_bindings[key] = RxBindingConfig(
                 key=key,
                 message=message_name,
                 fields=fields,
                 metadata=metadata,
+                queue_size=int(spec.get("queue_size", 16)),
+                overflow=overflow,
+                priority=int(spec.get("priority", 0)),
+                can_id=_optional_int(spec.get("can_id")),
+                id_mask=_optional_int(spec.get("id_mask")),
+                id_fields={
+                    name: (int(bits[0]), int(bits[1])) for name, bits in (spec.get("id_fields") or {}).items()
+                },
+                rate_hz=_optional_float(spec.get("rate_hz")),
+                loss=loss_entry(spec.get("loss"), f"{context}.rx_frames.{key}"),
+            )
+
+        rx_mode = bus_entry.get("rx_mode", "direct")
+        if rx_mode not in RX_MODES:
+            raise ValueError(f"{context}.rx_mode must be one of {list(RX_MODES)}, got '{rx_mode}'")
+        rx_timestamps = bus_entry.get("rx_timestamps", "software")
+        if rx_timestamps not in RX_TIMESTAMPS:
+            raise ValueError(
+                f"{context}.rx_timestamps must be one of {list(RX_TIMESTAMPS)}, got '{rx_timestamps}'"
             )
 
+        source = bus_entry.get("source", "socketcan")
+        if source not in BUS_SOURCES:
+            raise ValueError(f"{context}.source must be one of {list(BUS_SOURCES)}, got '{source}'")
+
+        bus_load = dict(bus_entry.get("bus_load") or {})
+        load_action = bus_load.get("action", "warn")
+        if load_action not in LOAD_ACTIONS:
+            raise ValueError(f"{context}.bus_load.action must be one of {list(LOAD_ACTIONS)}, got '{load_action}'")
+
         metadata = {k: v for k, v in bus_entry.items() if k not in {
             "name",
             "interface",
             "dbc_file",
+            "source",
             "bitrate",
             "fd",
             "dbitrate",
             "filters",
+            "auto_filters",
+            "rx_mode",
+            "rx_batch",
+            "rx_timestamps",
+            "rx_workers",
+            "rx_busy_poll",
+            "cpu_affinity",
+            "signal_store",
+            "recorder",
+            "trace",
+            "profile",
+            "shedding",
+            "socket_buffers",
+            "recovery",
+            "metrics",
+            "tx_classes",
+            "tx_mode",
+            "tx_schedule",
+            "bus_load",
+            "robostride_reporting",
+            "robostride_faults",
+            "robostride_params",
+            "gateway",
+            "uplink",
             "tx_topics",
             "rx_frames",
+            "devices",
+            "realtime",  # td_can_bridge_cpp only
         }}
 
         buses_cfg.append(
@@ -160,21 +578,57 @@ def load_bridge_config(path: Path | str) -> BridgeConfig:
                 name=bus_entry["name"],
                 interface=bus_entry["interface"],
                 dbc_file=dbc_path,
+                source=source,
                 bitrate=bus_entry.get("bitrate", 500_000),
                 fd=bus_entry.get("fd", False),
                 dbitrate=bus_entry.get("dbitrate"),
                 filters=bus_entry.get("filters"),
+                auto_filters=bool(bus_entry.get("auto_filters", False)),
+                rx_mode=rx_mode,
+                rx_batch=int(bus_entry.get("rx_batch", 64)),
+                rx_timestamps=rx_timestamps,
+                rx_workers=int(bus_entry.get("rx_workers", 0)),
+                rx_busy_poll=_busy_poll_entry(bus_entry.get("rx_busy_poll"), rx_mode, context),
+                cpu_affinity=_cpu_list(bus_entry.get("cpu_affinity"), context),
+                signal_store=_signal_store_entry(bus_entry.get("signal_store"), context),
+                recorder=_recorder_entry(bus_entry.get("recorder"), context),
+                trace=_trace_entry(bus_entry.get("trace"), context),
+                profile=profile_entry(bus_entry.get("profile"), context),
+                shedding=shedding_entry(bus_entry.get("shedding"), context),
+                socket_buffers=socket_buffers_entry(bus_entry.get("socket_buffers"), context),
+                recovery=_recovery_entry(bus_entry.get("recovery"), context),
+                # On for every bus once the file has a top-level ``metrics`` section
+                metrics=bool(bus_entry.get("metrics", bool(raw.get("metrics")))),
+                tx_classes=tx_classes,
+                tx_mode=tx_mode,
+                tx_schedule=tx_schedule,
+                load_limit=float(bus_load.get("limit", 0.8)),
+                load_action=load_action,
+                robostride_reporting=reporting_entry(bus_entry.get("robostride_reporting"), context),
+                robostride_faults=faults_entry(bus_entry.get("robostride_faults"), context),
+                robostride_params=params_entry(bus_entry.get("robostride_params"), context),
+                gateway=gateway_entry(bus_entry.get("gateway"), bus_entry["interface"], context),
+                uplink=uplink_entry(bus_entry.get("uplink"), context),
+                topology=share,
                 tx_bindings=tx_bindings,
                 rx_bindings=rx_bindings,
                 metadata=metadata,
             )
         )
 
+    seen: Dict[str, str] = {}
+    for (context, _, _), bus in zip(bus_entries, buses_cfg):
+        if bus.name in seen:
+            raise ValueError(f"{context}: bus name '{bus.name}' is also {seen[bus.name]}")
+        seen[bus.name] = context
+
     return BridgeConfig(
         path=cfg_path,
         buses=buses_cfg,
         logging=raw.get("logging", {}),
         qos=raw.get("qos", {}),
+        metrics=raw.get("metrics") or {},
+        topologies=topologies,
     )
 
 
@@ -182,34 +636,106 @@ def load_bridge_config(path: Path | str) -> BridgeConfig:
 # Runtime service implementation
 
 
+def fd_length(length: int) -> int:
+    """The CAN FD payload length ``length`` bytes are sent in: 0-8, 12, 16, 20, 24, 32, 48 or 64."""
+
+    for size in _FD_LENGTHS:
+        if size >= length:
+            return size
+    raise ValueError(f"{length} bytes do not fit a CAN FD frame (64 at most)")
+
+
 class FrameEncoder:
-    """Encode named payloads to CAN frames using a DBC."""
+    """Encode named payloads to CAN frames using a DBC.
+
+    The payload is written straight into a ``struct can_frame`` (8 bytes or
+    less) or ``struct canfd_frame`` (up to 64 bytes, ``fd`` buses only) by a
+    packer compiled for the binding (:mod:`td_can_bridges.encoders`):
+    :attr:`frame` is preallocated with the ID, length and FD flags in place
+    and :meth:`pack` only rewrites the payload. FD frames are padded with
+    zeros to the next valid FD length and carry the bit rate switch when the
+    bus has a ``dbitrate``.
+
+    With ``attributes`` the payload is an object, normally a ROS message,
+    whose attributes are the fields (:meth:`CanBusService.send_message`).
+    """
 
-    def __init__(self, dbc, binding: TxBindingConfig):
+    def __init__(self, dbc, binding: TxBindingConfig, fd: bool = False, brs: bool = False, attributes: bool = False):
         self.binding = binding
         self.msg_def = dbc.get_message_by_name(binding.message)
         self.alias_to_signal = dict(binding.fields)
+        self.attributes = attributes
+        length = self.msg_def.length
+        if length > 8 and not fd:
+            raise ValueError(f"TX binding '{binding.key}': {self.msg_def.name} is {length} bytes; "
+                             f"frames over 8 bytes need a bus with fd: true")
+        self.fd = length > 8
+        self.brs = self.fd and brs
+        self.classic = not self.fd
+        self._pack = compile_packer(self.msg_def, self.alias_to_signal, binding.key, attributes)
+        if attributes and self._pack is None:
+            # cantools encodes it; read every field with one attrgetter call
+            fields = self.alias_to_signal or {s.name: s.name for s in self.msg_def.signals}
+            self._signals = tuple(fields.values())
+            getter = operator.attrgetter(*fields) if fields else (lambda obj: ())
+            self._get = (lambda obj: (getter(obj),)) if len(fields) == 1 else getter
+        can_id = self.msg_def.frame_id | (CAN_EFF_FLAG if self.msg_def.is_extended_frame else 0)
+        if self.fd:
+            self._header = struct.pack("=IBB2x", can_id, fd_length(length), CANFD_BRS if self.brs else 0)
+            self.size = CANFD_MTU
+        else:
+            self._header = struct.pack("=IB3x", can_id, length)
+            self.size = CAN_MTU
+        self.frame = bytearray(self._header + bytes(self.size - len(self._header)))
 
-    def encode(self, payload: Mapping[str, Any]) -> can.Message:
-        if not isinstance(payload, Mapping):
-            raise TypeError("payload must be a mapping of field -> value")
-
-        values: Dict[str, Any] = {}
-        if self.alias_to_signal:
-            for alias, signal in self.alias_to_signal.items():
-                if alias not in payload:
-                    raise KeyError(f"Missing field '{alias}' for binding '{self.binding.key}'")
-                values[signal] = payload[alias]
+    def write(self, buf, offset: int, payload: Mapping[str, Any]) -> None:
+        """Write a whole frame of :attr:`size` bytes for ``payload`` into ``buf`` at ``offset``."""
+
+        buf[offset:offset + 8] = self._header
+        if self._pack is not None:
+            self._pack(buf, offset + 8, payload)
+        else:
+            data = self.msg_def.encode(self._values(payload))
+            buf[offset + 8:offset + 8 + len(data)] = data
+
+    def pack(self, payload: Mapping[str, Any]) -> bytearray:
+        """Rewrite :attr:`frame` for ``payload`` and return it."""
+
+        if self._pack is not None:
+            self._pack(self.frame, 8, payload)
         else:
-            values = dict(payload)
+            self.write(self.frame, 0, payload)
+        return self.frame
 
-        data = self.msg_def.encode(values)
+    def encode(self, payload: Mapping[str, Any]) -> can.Message:
+        if self._pack is not None:
+            data = bytes(self.pack(payload)[8:8 + self.msg_def.length])
+        else:
+            data = self.msg_def.encode(self._values(payload))
+        if self.fd:
+            data = data.ljust(fd_length(len(data)), b"\0")
         return can.Message(
             arbitration_id=self.msg_def.frame_id,
             data=data,
             is_extended_id=self.msg_def.is_extended_frame,
+            is_fd=self.fd,
+            bitrate_switch=self.brs,
         )
 
+    def _values(self, payload: Mapping[str, Any]) -> Dict[str, Any]:
+        if self.attributes:
+            try:
+                return dict(zip(self._signals, self._get(payload)))
+            except AttributeError as exc:
+                raise KeyError(f"Missing field '{exc.name}' for binding '{self.binding.key}'") from None
+        if not self.alias_to_signal:
+            return dict(payload)
+        # The aliases were checked against the DBC at load (check_bindings): only the payload can miss one
+        try:
+            return {signal: payload[alias] for alias, signal in self.alias_to_signal.items()}
+        except KeyError as exc:
+            raise KeyError(f"Missing field '{exc.args[0]}' for binding '{self.binding.key}'") from None
+
 
 class FrameDecoder:
     """Decode CAN frames to user-friendly dictionaries."""
@@ -218,19 +744,117 @@ class FrameDecoder:
         self.binding = binding
         self.msg_def = dbc.get_message_by_name(binding.message)
         self.signal_to_alias = dict(binding.fields)
+        self.id_fields = [(name, lo, (1 << (hi - lo + 1)) - 1) for name, (lo, hi) in binding.id_fields.items()]
 
     @property
     def frame_id(self) -> int:
-        return self.msg_def.frame_id
+        return self.msg_def.frame_id if self.binding.can_id is None else self.binding.can_id
+
+    @property
+    def id_mask(self) -> Optional[int]:
+        """Bits of :attr:`frame_id` a frame must match; None for an exact ID."""
+
+        return self.binding.id_mask
+
+    def decode(self, raw_bytes: bytes, arbitration_id: int = 0) -> Dict[str, Any]:
+        return self.project(self.msg_def.decode(raw_bytes), arbitration_id)
+
+    def project(self, decoded: Mapping[str, Any], arbitration_id: int = 0) -> Dict[str, Any]:
+        """Pick this binding's aliased fields out of an already decoded message."""
 
-    def decode(self, raw_bytes: bytes) -> Dict[str, Any]:
-        decoded = self.msg_def.decode(raw_bytes)
         if self.signal_to_alias:
-            return {alias: decoded.get(signal) for signal, alias in self.signal_to_alias.items()}
-        return dict(decoded)
+            out = {alias: decoded.get(signal) for signal, alias in self.signal_to_alias.items()}
+        else:
+            out = dict(decoded)
+        for name, shift, mask in self.id_fields:
+            out[name] = (arbitration_id >> shift) & mask
+        return out
+
+
+# handler(payload, binding, timestamp): timestamp is the frame's receive time in seconds,
+# taken by the kernel (see BusConfig.rx_timestamps) where the socket allows it
+RxHandler = Callable[[Dict[str, Any], RxBindingConfig, float], None]
+
+# handler(arbitration_id, data, timestamp) of register_raw_handler; data is None for
+# a frame the native core decoded for an RX binding
+RawHandler = Callable[[int, Optional[bytes], float], None]
+
+
+class RxDispatch:
+    """Every RX binding of one frame ID.
+
+    Several bindings often project different signals of the same DBC message
+    (one ROS topic per signal). The frame is decoded once and each subscriber
+    takes its fields from the shared result, so the cost grows with the
+    number of frames rather than the number of bindings. ``decode`` is
+    compiled for just the signals the subscribers read (all of them once the
+    message feeds the signal store); ``native`` is the same selection laid
+    out for the C++ core, or None when the core hands the frame back for
+    ``decode``.
+
+    Subscribers marked idle (:meth:`CanBusService.set_rx_idle`) stay
+    registered but are left out of ``live``, the list frames are decoded
+    and delivered for; a dispatch with no live subscriber, recorder or
+    store is not decoded at all.
+    """
+
+    def __init__(self, msg_def, can_id: Optional[int] = None, id_mask: Optional[int] = None):
+        self.msg_def = msg_def
+        self.can_id = msg_def.frame_id if can_id is None else can_id
+        self.id_mask = id_mask  # None: exact ID
+        self.subscribers: List[tuple[FrameDecoder, RxBindingConfig, RxHandler]] = []
+        self.idle: frozenset = frozenset()  # keys of subscribers nothing consumes right now
+        self.live: List[tuple[FrameDecoder, RxBindingConfig, RxHandler]] = []
+        self.decode: Decoder = msg_def.decode
+        self.native: Optional[tuple[List[str], List[tuple]]] = None
+        self.recorders: List[Any] = []  # batch.BlockRecorder, fed the raw payloads
+        self.store: Optional[Callable[[Mapping[str, Any], float, int], None]] = None  # SignalStore writer
+
+    def add(self, decoder: FrameDecoder, binding: RxBindingConfig, handler: RxHandler) -> None:
+        # A new list rather than append/remove, so the RX thread iterating the old one is undisturbed
+        self.subscribers = self.subscribers + [(decoder, binding, handler)]
+        self._compile()
+
+    def remove(self, key: str) -> bool:
+        kept = [sub for sub in self.subscribers if sub[1].key != key]
+        if len(kept) == len(self.subscribers):
+            return False
+        self.subscribers = kept
+        self.idle = self.idle - {key}
+        self._compile()
+        return True
+
+    def set_idle(self, key: str, idle: bool) -> bool:
+        """True when ``key`` is a subscriber here and its idle state changed."""
+
+        if (key in self.idle) == idle or not any(sub[1].key == key for sub in self.subscribers):
+            return False
+        self.idle = self.idle | {key} if idle else self.idle - {key}
+        self._compile()
+        return True
+
+    @property
+    def consumed(self) -> bool:
+        """Whether anything reads this frame: a live subscriber, a recorder or the signal store."""
 
+        return bool(self.live or self.recorders or self.store is not None)
 
-RxHandler = Callable[[Dict[str, Any], RxBindingConfig], None]
+    def set_store(self, write: Callable[[Mapping[str, Any], float, int], None]) -> None:
+        self.store = write
+        self._compile()
+
+    def _compile(self) -> None:
+        self.live = [sub for sub in self.subscribers if sub[1].key not in self.idle] if self.idle else self.subscribers
+        signals: Optional[set] = None if self.store is not None else set()
+        for sub, _, _ in self.live:
+            if signals is None:
+                break
+            if not sub.signal_to_alias:
+                signals = None  # a binding without ``fields`` gets every signal
+                break
+            signals.update(sub.signal_to_alias)
+        self.decode = compile_decoder(self.msg_def, signals)
+        self.native = native_layout(self.msg_def, signals)
 
 
 class CanBusService:
@@ -238,35 +862,439 @@ class CanBusService:
 
     def __init__(self, cfg: BusConfig):
         self.cfg = cfg
-        self.dbc = cantools.database.load_file(str(cfg.dbc_file))
+        self.dbc = load_dbc(cfg.dbc_file)
         self.bus = self._open_bus(cfg)
+        # None: not a TritonCAN adapter, no pyusb, or firmware without GS_USB_BREQ_TRITON_CAPS
+        self.adapter_caps: Optional[AdapterCaps] = read_adapter_caps(cfg.interface)
+        if self.adapter_caps is not None:
+            LOG.info("[%s] %s: TritonCAN %s", cfg.name, cfg.interface, self.adapter_caps.summary())
+            if cfg.fd and not self.adapter_caps.fd:
+                LOG.warning("[%s] fd is set but %s is not a CAN FD channel: frames over 8 bytes will fail",
+                            cfg.name, cfg.interface)
         self._tx_bindings: Dict[str, FrameEncoder] = {}
-        self._rx_bindings: Dict[int, tuple[FrameDecoder, RxBindingConfig, RxHandler]] = {}
+        self._tx_objects: Dict[str, FrameEncoder] = {}  # send_message() encoders, made on first use
+        self._rx_bindings: Dict[int, RxDispatch] = {}
+        # Masked bindings: id_mask -> (frame ID & id_mask) -> dispatch, tried after the exact IDs
+        self._rx_masked: Dict[int, Dict[int, RxDispatch]] = {}
+        self._mask_order: List[tuple[int, Dict[int, RxDispatch]]] = []
         self._stop = threading.Event()
         self._rx_thread: Optional[threading.Thread] = None
+        self._receiver: Optional[BatchReceiver] = None
+        self._core = None  # _can_core.RxCore while the native RX loop runs
+        self._busy = None  # the _can_core.BusyPoller reading it, with rx_busy_poll
+        # The raw socket under python-can, written directly by send() and send_many()
+        self._tx_sock = getattr(self.bus, "socket", None)
+        self._tx_lock = threading.Lock()
+        self._sender = BatchSender(self._tx_sock) if self._tx_sock is not None else None
+        # Broadcast manager tasks of the period_ms bindings, started by their first send()
+        self._periodic: Dict[str, Any] = {}
+        self._periodic_updated: Dict[str, float] = {}
+        self._hold_thread: Optional[threading.Thread] = None
+        self.metrics = BusMetrics(cfg.name) if cfg.metrics else None
+        self.errors = BusErrorMonitor(cfg.name)  # controller state from error frames, and interface losses
+        # Sampled wall time, CPU and allocations per binding
+        self._profile = BindingProfiler(cfg.name, cfg.profile) if cfg.profile else None
+        self._shedding: Optional[LoadShedder] = None
+        if cfg.shedding is not None and cfg.rx_timestamps == "hardware":
+            LOG.warning("[%s] shedding needs system-clock receive timestamps (rx_timestamps: software); off",
+                        cfg.name)
+        elif cfg.shedding is not None:
+            self._shedding = LoadShedder(
+                cfg.name, cfg.shedding, lambda: [sub[1].priority for d in self._dispatches() for sub in d.subscribers]
+            )
+        # Runs the RX handlers off the RX thread when rx_workers is set
+        self._pool = (HandlerPool(cfg.rx_workers, cfg.name, self.metrics, self._profile)
+                      if cfg.rx_workers > 0 else None)
+        # Writes every non-periodic frame when the bus has tx_classes
+        self._tx = self._tx_scheduler(cfg) if cfg.tx_classes else None
+        # Sends the tx_schedule bindings in their slots; send() on them only posts the frame
+        self._schedule: Optional[TxSchedule] = None
+        if cfg.tx_schedule is not None:
+            holds = {key: b.hold_ms for key, b in cfg.tx_bindings.items()}
+            self._schedule = TxSchedule(cfg.tx_schedule, self._write_scheduled, cfg.name, holds)
+        # Writes the newest frame of the coalesce bindings; made by the first one registered
+        self._coalesce: Optional[TxCoalescer] = None
+        # Worst-case share of the bitrate the bindings declare, and the ID type measured frames are costed as
+        plan = plan_bus(cfg, self.dbc)
+        self.projected_load = plan.load
+        # Sizes each socket it opens, and the interface's TX queue, for the same plan
+        self._buffers: Optional[SocketBufferTuner] = None
+        if cfg.socket_buffers is not None:
+            self._buffers = SocketBufferTuner(cfg.name, cfg.interface, plan_socket_buffers(plan, cfg.socket_buffers),
+                                              cfg.socket_buffers)
+        extended = sum(1 for m in self.dbc.messages if m.is_extended_frame)
+        self._mostly_extended = extended * 2 > len(self.dbc.messages)
+        self._store: Optional[SignalStore] = None
+        self._reporting: Optional[ActiveReporting] = None  # between start() and shutdown()
+        self._recorder: Optional[FrameRecorder] = None  # open between start() and shutdown()
+        # Sampled per-frame spans, written at shutdown
+        self._trace: Optional[PipelineTracer] = PipelineTracer(cfg.name, cfg.trace) if cfg.trace else None
+        self._rx_overflow = 0  # last SO_RXQ_OVFL count, kept across RX loop restarts
+        self._store_messages: set = set()  # signal_store.messages, decoded without bindings
+        self._rx_queues: Dict[str, Any] = {}  # binding key -> BindingQueue, with rx_workers
+        self._filters_held = 0  # inside reconfigure(): auto filters are applied once at the end
+        self._filters_stale = False
+        # register_raw_handler: (key, can_id, id_mask, extended, handler), seen before the DBC lookup
+        self._raw_handlers: List[tuple[str, int, int, bool, RawHandler]] = []
+        # ... with priority=True: run over each receive batch before any frame of it is dispatched
+        self._priority_handlers: List[tuple[str, int, int, bool, RawHandler]] = []
+        # register_column_handler: (key, handler), given each native ColumnBatch before dispatch
+        self._column_handlers: List[tuple[str, Callable[[Any], None]]] = []
+        # Bindings with ``loss``: binding key -> tracker, run as raw handler loss/<key>
+        self._losses: Dict[str, LossTracker] = {}
+        self._loss_stages = StageAttribution(self._loss_counts)
 
         if cfg.filters:
-            try:
-                self.bus.set_filters(list(cfg.filters))
-            except Exception:  # pragma: no cover - depends on driver support
-                LOG.warning("[%s] failed to apply CAN filters", cfg.name, exc_info=True)
+            self._set_filters(list(cfg.filters))
+        if cfg.signal_store is not None:
+            self._open_store(cfg.signal_store)
+        self.params: Optional[ParameterClient] = None  # with robostride_params, between start() and shutdown()
+        # Static RoboStride parameters, shared by every ParameterClient of the bus
+        params_cfg = cfg.robostride_params
+        self.param_cache: Optional[ParameterCache] = (
+            ParameterCache(params_cfg.max_age if params_cfg else None)
+            if params_cfg is None or params_cfg.cache else None
+        )
+        self._gateway = CanGateway(cfg.name, cfg.interface, cfg.gateway) if cfg.gateway else None
+        self._uplink: Optional[TelemetryUplink] = None  # between start() and shutdown()
+        self.faults: Optional[FaultMonitor] = None
+        if cfg.robostride_faults is not None:
+            self.faults = FaultMonitor(self, cfg.robostride_faults)
 
     # ------------------------------------------------------------------
     # Configuration helpers
 
-    def register_tx_binding(self, binding: TxBindingConfig) -> None:
+    def register_tx_binding(self, binding: TxBindingConfig, sample: Any = None) -> None:
+        """Add a TX binding.
+
+        ``sample`` is an instance of the type :meth:`send_message` will get
+        for it, e.g. a fresh ROS message: its fields are checked against the
+        binding now (ValueError naming the missing ones) and the attribute
+        packer is compiled here instead of on the first message.
+        """
+
         LOG.debug("[%s] register TX binding %s -> %s", self.cfg.name, binding.key, binding.message)
-        self._tx_bindings[binding.key] = FrameEncoder(self.dbc, binding)
+        encoder = FrameEncoder(self.dbc, binding, self.cfg.fd, bool(self.cfg.dbitrate))
+        objects = None
+        if sample is not None:
+            missing = missing_attributes(sample, binding.fields or [s.name for s in encoder.msg_def.signals])
+            if missing:
+                raise ValueError(f"TX binding '{binding.key}': {type(sample).__name__} has no fields {missing}")
+            objects = FrameEncoder(self.dbc, binding, self.cfg.fd, bool(self.cfg.dbitrate), attributes=True)
+        self._tx_bindings[binding.key] = encoder
+        self._tx_objects.pop(binding.key, None)
+        if objects is not None:
+            self._tx_objects[binding.key] = objects
+        scheduled = self._schedule is not None and binding.key in self._schedule.bindings
+        if binding.coalesce and binding.rate_hz and not binding.period_ms and not scheduled:
+            if self._coalesce is None:
+                self._coalesce = TxCoalescer(self._write_coalesced, self.cfg.name)
+            self._coalesce.set_rate(binding.key, binding.rate_hz)
+        elif self._coalesce is not None:
+            self._coalesce.set_rate(binding.key, None)
 
     def register_rx_binding(self, binding: RxBindingConfig, handler: RxHandler) -> None:
         decoder = FrameDecoder(self.dbc, binding)
+        if decoder.msg_def.length > 8 and not self.cfg.fd:
+            LOG.warning("[%s] RX binding %s: %s is %d bytes but the bus has no fd: true; it will not be received",
+                        self.cfg.name, binding.key, decoder.msg_def.name, decoder.msg_def.length)
         LOG.debug(
             "[%s] register RX binding %s (0x%X)",
             self.cfg.name,
             binding.message,
             decoder.frame_id,
         )
-        self._rx_bindings[decoder.frame_id] = (decoder, binding, handler)
+        if self._pool is not None:
+            # The queue's put() stands in for the handler; a worker runs the handler itself
+            queue = self._pool.queue(binding, handler, binding.queue_size, binding.overflow, binding.priority)
+            self._rx_queues[binding.key] = queue
+            handler = queue.put
+        dispatch = self._dispatch_for(decoder.msg_def, decoder.frame_id, decoder.id_mask)
+        dispatch.add(decoder, binding, handler)
+        if self._core is not None:
+            self._load_core(dispatch)
+        if binding.loss is not None:
+            self._watch_loss(decoder, binding)
+        if self.cfg.auto_filters:
+            self._apply_auto_filters()
+
+    def _watch_loss(self, decoder: FrameDecoder, binding: RxBindingConfig) -> None:
+        tracker = LossTracker(binding.key, decoder.msg_def, binding.loss, self._loss_stages)
+        if not self._losses:
+            self._loss_stages.prime()
+        self._losses[binding.key] = tracker
+        id_mask = CAN_EFF_MASK if decoder.id_mask is None else decoder.id_mask
+        self.register_raw_handler(f"loss/{binding.key}", decoder.frame_id, tracker.on_frame, id_mask=id_mask,
+                                  extended=decoder.msg_def.is_extended_frame)
+
+    def _loss_counts(self) -> Dict[str, int]:
+        """Cumulative drops per stage of :mod:`td_can_bridges.frame_loss`, for the whole bus."""
+
+        counts = interface_drops(self.cfg.interface) or {}
+        source = self._core if self._core is not None else self._receiver
+        socket = source.dropped if source is not None else self._rx_overflow
+        return {"adapter": counts.get("adapter", 0) + self.errors.counts["rx_overflow"],
+                "driver": counts.get("driver", 0), "socket": socket}
+
+    def unregister_tx_binding(self, key: str) -> None:
+        """Forget a TX binding; its cyclic frame, if any, is stopped."""
+
+        self.stop_periodic(key)
+        if self._coalesce is not None:
+            self._coalesce.set_rate(key, None)
+        self._tx_objects.pop(key, None)
+        if self._tx_bindings.pop(key, None) is not None:
+            LOG.debug("[%s] unregister TX binding %s", self.cfg.name, key)
+
+    def unregister_rx_binding(self, key: str) -> None:
+        """Remove an RX binding while the RX loop keeps running.
+
+        The frame's decoder shrinks to the signals still read, and a frame
+        ID nothing reads any more leaves the ID table and, with
+        ``auto_filters``, the kernel filters. Frames already queued for the
+        binding's worker are still handled.
+        """
+
+        for dispatch in self._dispatches():
+            if dispatch.remove(key):
+                break
+        else:
+            return
+        LOG.debug("[%s] unregister RX binding %s", self.cfg.name, key)
+        if self._losses.pop(key, None) is not None:
+            self.unregister_raw_handler(f"loss/{key}")
+        queue = self._rx_queues.pop(key, None)
+        if queue is not None:
+            self._pool.remove(queue)
+        if not dispatch.subscribers and not dispatch.recorders and dispatch.msg_def.name not in self._store_messages:
+            self._drop_dispatch(dispatch)
+        elif self._core is not None:
+            self._load_core(dispatch)
+        if self.cfg.auto_filters:
+            self._apply_auto_filters()
+
+    def set_rx_idle(self, key: str, idle: bool = True) -> None:
+        """Mark an RX binding idle, or active again, while the RX loop keeps running.
+
+        An idle binding's handler is not called. The frame's decoder shrinks
+        to the signals the active bindings read, and a frame nothing else
+        reads (no recorder, no signal store) is not decoded; with
+        ``auto_filters`` it also leaves the kernel filters, unless a raw
+        handler still wants its ID.
+        """
+
+        for dispatch in self._dispatches():
+            if dispatch.set_idle(key, idle):
+                break
+        else:
+            return
+        LOG.debug("[%s] RX binding %s %s", self.cfg.name, key, "idle" if idle else "active")
+        if self._core is not None:
+            self._load_core(dispatch)
+        if self.cfg.auto_filters:
+            self._apply_auto_filters()
+
+    def idle_bindings(self) -> List[str]:
+        """Keys of the RX bindings marked idle."""
+
+        return sorted(key for dispatch in self._dispatches() for key in dispatch.idle)
+
+    def set_filters(self, filters: Optional[Iterable[MutableMapping[str, int]]], auto_filters: bool) -> None:
+        """Replace the bus's static ``filters`` and ``auto_filters`` on the open socket."""
+
+        self.cfg = replace(self.cfg, filters=filters, auto_filters=auto_filters)
+        if auto_filters:
+            self._apply_auto_filters()
+        else:
+            self._set_filters(list(filters) if filters else None)
+
+    @contextmanager
+    def reconfigure(self):
+        """Group binding changes so the kernel filters are rewritten once, after all of them.
+
+        Replacing a binding is an unregister followed by a register; without
+        this the filters could briefly drop its frame ID, and frames of other
+        bindings on that ID with it.
+        """
+
+        self._filters_held += 1
+        try:
+            yield self
+        finally:
+            self._filters_held -= 1
+            if not self._filters_held and self._filters_stale:
+                self._filters_stale = False
+                if self.cfg.auto_filters:
+                    self._apply_auto_filters()
+
+    def register_raw_handler(
+        self, key: str, can_id: int, handler: RawHandler, id_mask: int = CAN_EFF_MASK, extended: bool = True,
+        priority: bool = False,
+    ) -> None:
+        """Call ``handler`` for every frame whose ID matches ``can_id`` under ``id_mask``.
+
+        For protocols a DBC cannot describe, such as request/response
+        exchanges keyed by payload bytes. Handlers run on the RX thread before
+        the frame's RX bindings, whether or not any binding decodes it, so
+        they must be quick. With ``auto_filters`` the kernel passes the IDs.
+        A ``priority`` handler runs over a whole receive batch before any
+        frame of it is dispatched, so its frames never wait behind the
+        decoding of the frames read with them (fault frames, see
+        :mod:`td_can_bridges.robostride_faults`).
+        """
+
+        self.unregister_raw_handler(key)
+        can_id &= id_mask
+        LOG.debug("[%s] register raw handler %s (0x%X/0x%X)", self.cfg.name, key, can_id, id_mask)
+        entry = (key, can_id, id_mask, extended, handler)
+        if priority:
+            self._priority_handlers = self._priority_handlers + [entry]
+        else:
+            self._raw_handlers = self._raw_handlers + [entry]
+        if self._core is not None:
+            self._load_raw_core(can_id, id_mask, extended)
+        if self.cfg.auto_filters:
+            self._apply_auto_filters()
+
+    def register_column_handler(self, key: str, handler: Callable[[Any], None]) -> None:
+        """Give ``handler`` each receive batch of the native core as a ``_can_core.ColumnBatch``.
+
+        Only with ``rx_mode: native``. The batch holds the frames the core
+        decodes for this bus's bindings as NumPy views of fixed-layout
+        columns, with no Python object per frame; :meth:`native_signals`
+        names the values of an ID. It runs on the RX thread before the
+        batch is dispatched and is recycled after it: copy what must outlive
+        the call.
+        """
+
+        self.unregister_column_handler(key)
+        LOG.debug("[%s] register column handler %s", self.cfg.name, key)
+        self._column_handlers = self._column_handlers + [(key, handler)]
+
+    def unregister_column_handler(self, key: str) -> None:
+        self._column_handlers = [h for h in self._column_handlers if h[0] != key]
+
+    def native_signals(self, arbitration_id: int) -> Optional[tuple[str, ...]]:
+        """The signals the native core decodes for ``arbitration_id``, in value order; None when it does not."""
+
+        dispatch = self._lookup(arbitration_id)
+        if dispatch is None or not dispatch.native:
+            return None
+        return tuple(dispatch.native[0])
+
+    def unregister_raw_handler(self, key: str) -> None:
+        gone = next((h for h in self._raw_entries() if h[0] == key), None)
+        if gone is None:
+            return
+        self._raw_handlers = [h for h in self._raw_handlers if h[0] != key]
+        self._priority_handlers = [h for h in self._priority_handlers if h[0] != key]
+        LOG.debug("[%s] unregister raw handler %s", self.cfg.name, key)
+        _, can_id, id_mask, extended, _ = gone
+        if self._core is not None and not self._raw_core_taken(can_id, id_mask, extended):
+            self._core.remove_message(can_id, extended, id_mask)
+        if self.cfg.auto_filters:
+            self._apply_auto_filters()
+
+    def register_rx_batch(
+        self,
+        message: str,
+        handler: Callable[[Dict[str, Any]], None],
+        signals: Optional[Iterable[str]] = None,
+        block_size: int = 4096,
+        flush_ms: Optional[float] = None,
+    ) -> None:
+        """Collect frames of ``message`` into blocks decoded column-wise with NumPy.
+
+        ``handler`` receives a dict of NumPy arrays, one per signal (all of
+        them when ``signals`` is None) plus ``timestamp`` and ``dlc``, every
+        ``block_size`` frames, after ``flush_ms`` since the block's first
+        frame, and at shutdown. See :mod:`td_can_bridges.batch`.
+        """
+
+        from .batch import BatchDecoder, BlockRecorder  # NumPy is only needed here
+
+        msg_def = self.dbc.get_message_by_name(message)
+        recorder = BlockRecorder(BatchDecoder(msg_def, signals), handler, block_size, flush_ms)
+        LOG.debug("[%s] register RX batch %s (0x%X), %d frames per block",
+                  self.cfg.name, message, msg_def.frame_id, block_size)
+        dispatch = self._dispatch_for(msg_def)
+        dispatch.recorders.append(recorder)
+        if self._core is not None:
+            self._load_core(dispatch)
+        if self.cfg.auto_filters:
+            self._apply_auto_filters()
+
+    def _dispatch_for(self, msg_def, can_id: Optional[int] = None, id_mask: Optional[int] = None) -> RxDispatch:
+        can_id = msg_def.frame_id if can_id is None else can_id
+        if id_mask is None:
+            table = self._rx_bindings
+        else:
+            can_id &= id_mask
+            table = self._rx_masked.get(id_mask)
+            if table is None:
+                table = self._rx_masked[id_mask] = {}
+                # Most specific mask first, so a narrower binding wins over a broader one
+                self._mask_order = sorted(self._rx_masked.items(), key=lambda m: -bin(m[0]).count("1"))
+        dispatch = table.get(can_id)
+        if dispatch is None:
+            dispatch = table[can_id] = RxDispatch(msg_def, can_id, id_mask)
+            if self._store is not None:
+                dispatch.set_store(self._store.writer(msg_def.name))
+        return dispatch
+
+    def _drop_dispatch(self, dispatch: RxDispatch) -> None:
+        if dispatch.id_mask is None:
+            self._rx_bindings.pop(dispatch.can_id, None)
+        else:
+            table = self._rx_masked.get(dispatch.id_mask, {})
+            table.pop(dispatch.can_id, None)
+            if not table:
+                self._rx_masked.pop(dispatch.id_mask, None)
+                self._mask_order = [m for m in self._mask_order if m[0] != dispatch.id_mask]
+        if self._core is not None:
+            mask = CAN_EFF_MASK if dispatch.id_mask is None else dispatch.id_mask
+            self._core.remove_message(dispatch.can_id, dispatch.msg_def.is_extended_frame, mask)
+            if any(h[1:3] == (dispatch.can_id, mask) for h in self._raw_entries()):
+                self._load_raw_core(dispatch.can_id, mask, dispatch.msg_def.is_extended_frame)
+
+    def _dispatches(self) -> List[RxDispatch]:
+        return list(self._rx_bindings.values()) + [d for _, t in self._mask_order for d in t.values()]
+
+    def _lookup(self, arbitration_id: int) -> Optional[RxDispatch]:
+        """The dispatch of an exact ID, else of the most specific matching mask."""
+
+        dispatch = self._rx_bindings.get(arbitration_id)
+        if dispatch is None:
+            for mask, table in self._mask_order:
+                dispatch = table.get(arbitration_id & mask)
+                if dispatch is not None:
+                    break
+        return dispatch
+
+    def _open_store(self, spec: Mapping[str, Any]) -> None:
+        path = Path(spec.get("path") or default_path(self.cfg.name))
+        reporting = self.cfg.robostride_reporting
+        # Reports share one masked message; each reporting motor gets slots of its own
+        split = {reporting.message: (MOTOR_ID_BITS, list(reporting.motors))} if reporting else None
+        self._store = SignalStore(path, self.cfg.name, self.dbc.messages, history=int(spec.get("history") or 0),
+                                  split=split)
+        # Listed messages are decoded for the store even without RX bindings
+        for name in spec.get("messages") or []:
+            self._store_messages.add(name)
+            self._dispatch_for(self.dbc.get_message_by_name(name))
+        if reporting:
+            self._store_messages.add(reporting.message)
+            self._dispatch_for(self.dbc.get_message_by_name(reporting.message), id_mask=FEEDBACK_MASK)
+        if self.cfg.auto_filters and self._rx_bindings:
+            self._apply_auto_filters()
+        LOG.info("[%s] signal store at %s", self.cfg.name, path)
+
+    def flush_batches(self) -> None:
+        """Hand every partly filled RX batch to its handler now."""
+
+        for dispatch in self._dispatches():
+            for recorder in dispatch.recorders:
+                recorder.flush()
 
     # ------------------------------------------------------------------
     # Runtime operations
@@ -274,68 +1302,991 @@ class CanBusService:
     def start(self) -> None:
         if self._rx_thread and self._rx_thread.is_alive():
             return
+        if self._gateway is not None:
+            self._gateway.install()  # first: a route that can't be installed fails the start
         self._stop.clear()
-        self._rx_thread = threading.Thread(target=self._rx_loop, name=f"{self.cfg.name}-rx", daemon=True)
+        if self._pool is not None:
+            self._pool.start()
+        loop = self._rx_loop_notifier if self.cfg.rx_mode == "notifier" else self._rx_loop_direct
+        sock = getattr(self.bus, "socket", None)
+        if sock is not None:
+            self._prepare_socket(sock)
+        if self.cfg.rx_mode == "native":
+            if _can_core is None or sock is None:
+                LOG.warning(
+                    "[%s] rx_mode native needs the _can_core extension and a SocketCAN bus; using direct",
+                    self.cfg.name,
+                )
+            else:
+                self._core = _can_core.RxCore(sock.fileno(), self.cfg.rx_batch)
+                self._fill_core()
+                self._attach_busy_poll()
+                loop = self._rx_loop_native
+        self._start_recorder()
+        self._rx_thread = threading.Thread(target=self._rx_main, args=(loop,), name=f"{self.cfg.name}-rx", daemon=True)
         self._rx_thread.start()
+        if self.cfg.robostride_reporting and self._reporting is None:
+            # After the RX thread: the interval writes are acknowledged through it
+            self._reporting = ActiveReporting(self, self.cfg.robostride_reporting)
+            self._reporting.start()
+        if self.cfg.robostride_params and self.params is None:
+            params = self.cfg.robostride_params
+            self.params = ParameterClient(self, params.host_id, params.window, params.timeout, params.retries)
+            motors = params.prefetch
+            if motors is True:
+                motors = set(self.cfg.topology.motors if self.cfg.topology else ())
+                motors |= set(self.cfg.robostride_reporting.motors if self.cfg.robostride_reporting else ())
+            if motors and self.param_cache is not None:
+                futures = self.params.prefetch(sorted(motors))
+                LOG.info("[%s] prefetching %d static parameter(s) of motor(s) %s",
+                         self.cfg.name, len(futures), ", ".join(str(m) for m in sorted(motors)))
+        if self.cfg.uplink and self._uplink is None:
+            self._uplink = TelemetryUplink(self, self.cfg.uplink)
+            self._uplink.start()
 
     def shutdown(self) -> None:
+        if self._uplink is not None:
+            self._uplink.stop()  # while frames still arrive, so its last chunk is complete
+            self._uplink = None
+        if self.params is not None:
+            self.params.close()
+            self.params = None
+        if self.param_cache is not None:
+            self.param_cache.invalidate()  # the motors may be power-cycled before the next start()
+        if self._reporting is not None:
+            self._reporting.stop()
+            self._reporting = None
         self._stop.set()
+        if self._receiver:
+            self._receiver.wake()
+        if self._core is not None:
+            self._core.stop()
+        if self._pool is not None:
+            # Before the join: an RX thread waiting on a full ``block`` queue is released
+            self._pool.stop()
         if self._rx_thread:
             self._rx_thread.join(timeout=1.0)
             self._rx_thread = None
+        self.socket_buffer_stats()  # logs drops not reported yet
+        self.flush_batches()
+        if self._recorder is not None:
+            self._recorder.stop()
+            self._recorder = None
+        if self._trace is not None:
+            self._trace.write()
+        for key in list(self._periodic):
+            self.stop_periodic(key)
+        if self._tx is not None:
+            self._tx.stop()
+        if self._schedule is not None:
+            self._schedule.stop()
+        if self._coalesce is not None:
+            self._coalesce.stop()
+        if self._store is not None:
+            self._store.close()
+            self._store = None
+        if self._gateway is not None:
+            self._gateway.remove()
         try:
             self.bus.shutdown()
         except Exception:  # pragma: no cover - depends on driver support
             LOG.debug("[%s] error during bus shutdown", self.cfg.name, exc_info=True)
 
+    @property
+    def running(self) -> bool:
+        """True while the RX loop runs."""
+
+        return self._rx_thread is not None and self._rx_thread.is_alive()
+
+    def rx_stats(self) -> Dict[str, Dict[str, float]]:
+        """Queue depth, drops and latency per RX binding; empty unless rx_workers is set.
+
+        ``wait_ms_*`` is the time frames spent queued, ``latency_ms_*`` the
+        time from the frame's receive timestamp until its handler returned.
+        """
+
+        return self._pool.stats() if self._pool is not None else {}
+
+    def metrics_snapshot(self) -> Dict[str, Any]:
+        """Counters, timing histograms and queue stats of this bus; empty unless ``metrics`` is on.
+
+        ``rx_overflow`` is the kernel's count of frames dropped because the
+        socket buffer was full (direct and native modes). ``tx_classes`` has
+        the TX queue's depth and drops per class. ``bus_bits`` is the
+        worst-case bit count of every frame on the interface so far, from its
+        kernel counters; a rate of it over ``bitrate`` is the measured load,
+        to compare with ``bus_load_projected``. ``recorder`` has the frames
+        written and dropped while a recording is open. ``bus_errors`` is the
+        controller state, error frame counts per class and seconds per state
+        (:mod:`td_can_bridges.bus_errors`). ``robostride_faults`` has each
+        motor's current faults and fault event count. ``frame_loss`` has the
+        frames received and lost per binding with ``loss``, by stage.
+        ``gateway`` has the kernel's counters per ``gateway`` route,
+        ``uplink`` the frames and chunks sent to the base station,
+        ``profile`` the sampled cost per binding (:meth:`profile_stats`), and
+        ``shedding`` the lag and shed bindings (:meth:`shedding_stats`).
+        ``idle_bindings`` lists the RX bindings marked idle
+        (:meth:`set_rx_idle`). ``busy_poll`` has the ``rx_busy_poll``
+        thread's sweeps and frames (every bus on its CPU) and the frames
+        this bus lost on a full ring. ``socket_buffers`` has the planned and
+        granted buffer sizes (:meth:`socket_buffer_stats`).
+        """
+
+        if self.metrics is None:
+            return {}
+        snap = self.metrics.snapshot()
+        source = self._core if self._core is not None else self._receiver
+        if source is not None:
+            self._rx_overflow = source.dropped
+        snap["rx_overflow"] = self._rx_overflow
+        if self._buffers is not None:
+            snap["socket_buffers"] = self.socket_buffer_stats()
+        busy, core = self._busy, self._core
+        if busy is not None and core is not None:
+            snap["busy_poll"] = {"cpu": busy.cpu, "sweeps": busy.sweeps, "frames": busy.frames,
+                                 "ring_dropped": core.busy_dropped}
+        snap["queues"] = self.rx_stats()
+        snap["tx_classes"] = self._tx.stats() if self._tx is not None else {}
+        if self._schedule is not None:
+            snap["tx_schedule"] = self._schedule.stats()
+        if self._coalesce is not None:
+            snap["tx_coalesce"] = self._coalesce.stats()
+        snap["bitrate"] = self.cfg.bitrate
+        snap["bus_load_projected"] = self.projected_load
+        bits = interface_bits(self.cfg.interface, self._mostly_extended)
+        if bits is not None:
+            snap["bus_bits"] = bits
+        if self._recorder is not None:
+            snap["recorder"] = self._recorder.stats()
+        snap["bus_errors"] = self.errors.stats()
+        if self.faults is not None:
+            snap["robostride_faults"] = self.faults.stats()
+        if self._losses:
+            snap["frame_loss"] = self.loss_stats()
+        if self._gateway is not None:
+            snap["gateway"] = self.gateway_stats()
+        if self._uplink is not None:
+            snap["uplink"] = self._uplink.stats()
+        if self._profile is not None:
+            snap["profile"] = self._profile.stats()
+        if self._shedding is not None:
+            snap["shedding"] = self._shedding.stats()
+        snap["idle_bindings"] = self.idle_bindings()
+        return snap
+
+    def socket_buffer_stats(self) -> Dict[str, Any]:
+        """With ``socket_buffers``: the planned and granted sizes and the kernel's drops, which it
+        checks against the plan (td_can_bridges.socket_buffers); else empty."""
+
+        if self._buffers is None:
+            return {}
+        source = self._core if self._core is not None else self._receiver
+        if source is not None:
+            self._buffers.verify(source.dropped)
+        return self._buffers.stats()
+
+    def shedding_stats(self) -> Dict[str, Any]:
+        """Lag and shedding state with ``shedding``, see td_can_bridges.load_shedding; else empty."""
+
+        return self._shedding.stats() if self._shedding is not None else {}
+
+    def profile_stats(self) -> Dict[str, Dict[str, Dict[str, Any]]]:
+        """Sampled cost per ``rx``/``decode``/``tx`` stage and key with ``profile``, see td_can_bridges.binding_profile."""
+
+        return self._profile.stats() if self._profile is not None else {}
+
+    def profile_reset(self) -> None:
+        """Start the ``profile`` sums again, e.g. before changing a binding."""
+
+        if self._profile is not None:
+            self._profile.reset()
+
+    def gateway_stats(self) -> Dict[str, Dict[str, Any]]:
+        """Frames the kernel forwarded (``handled``), dropped and deleted per ``gateway`` route."""
+
+        return self._gateway.stats() if self._gateway is not None else {}
+
+    def loss_stats(self) -> Dict[str, Dict[str, Any]]:
+        """Frames received and lost per binding with ``loss``; frames its full handler queue dropped count as lost."""
+
+        out = {}
+        for key, tracker in list(self._losses.items()):
+            queue = self._rx_queues.get(key)
+            out[key] = tracker.stats(queue.dropped if queue is not None else 0)
+        return out
+
     def send(self, key: str, payload: Mapping[str, Any]) -> None:
-        if key not in self._tx_bindings:
+        encoder = self._tx_bindings.get(key)
+        if encoder is None:
             raise KeyError(f"Unknown TX binding '{key}'")
-        frame = self._tx_bindings[key].encode(payload)
-        LOG.debug(
-            "[%s] TX 0x%X (%s) %s",
-            self.cfg.name,
-            frame.arbitration_id,
-            self._tx_bindings[key].msg_def.name,
-            payload,
-        )
-        self.bus.send(frame)
+        self._send(encoder, payload)
+
+    def send_message(self, key: str, msg: Any) -> None:
+        """:meth:`send` with the fields read as attributes of ``msg``, e.g. a ROS message.
+
+        The binding's ``fields`` keys are attribute names (or dotted paths
+        such as ``vector.x``); without ``fields`` they are the signal names.
+        The first call compiles a packer that reads them off ``msg`` in
+        signal order, so no payload dict is built per message.
+        """
+
+        encoder = self._tx_objects.get(key)
+        if encoder is None:
+            base = self._tx_bindings.get(key)
+            if base is None:
+                raise KeyError(f"Unknown TX binding '{key}'")
+            encoder = FrameEncoder(self.dbc, base.binding, self.cfg.fd, bool(self.cfg.dbitrate), attributes=True)
+            self._tx_objects[key] = encoder
+        self._send(encoder, msg)
+
+    def _send(self, encoder: FrameEncoder, payload: Any) -> None:
+        profile = self._profile
+        if profile is not None:
+            profiled = profile.begin("tx", encoder.binding.key)
+            if profiled is not None:
+                try:
+                    self._send_traced(encoder, payload)
+                finally:
+                    profile.end(profiled)
+                return
+        self._send_traced(encoder, payload)
+
+    def _send_traced(self, encoder: FrameEncoder, payload: Any) -> None:
+        trace = self._trace
+        if trace is not None and trace.sample_tx():
+            span = trace.begin_tx(encoder.msg_def.frame_id)
+            try:
+                self._send_frame(encoder, payload)
+            finally:
+                span.mark("send " + encoder.binding.key)
+                trace.commit(span)
+            return
+        self._send_frame(encoder, payload)
+
+    def _send_frame(self, encoder: FrameEncoder, payload: Any) -> None:
+        if LOG.isEnabledFor(logging.DEBUG):
+            LOG.debug("[%s] TX 0x%X (%s) %s", self.cfg.name, encoder.msg_def.frame_id, encoder.msg_def.name, payload)
+        if encoder.binding.period_ms:
+            self._update_periodic(encoder, payload)
+            return
+        if self._schedule is not None and encoder.binding.key in self._schedule.bindings:
+            self._schedule.post(encoder.binding.key, self._frame(encoder, payload))
+            return
+        if self._coalesce is not None and encoder.binding.key in self._coalesce:
+            self._coalesce.post(encoder.binding.key, self._frame(encoder, payload))
+            return
+        if self._tx is not None:
+            self._tx.submit(encoder.binding.tx_class, self._frame(encoder, payload))
+            return
+        if self._tx_sock is None:
+            self.bus.send(encoder.encode(payload))
+        else:
+            with self._tx_lock:
+                self._tx_sock.send(encoder.pack(payload))
+        if self.metrics is not None:
+            self.metrics.tx_frames += 1
+
+    def send_raw(
+        self, arbitration_id: int, data: bytes, extended: bool = True, tx_class: str = DEFAULT_TX_CLASS
+    ) -> None:
+        """Send one frame built by the caller, outside any TX binding.
+
+        ``data`` over 8 bytes goes out as a CAN FD frame (``fd`` buses only),
+        padded to the next FD length. ``tx_class`` applies when the bus has a
+        TX queue.
+        """
+
+        fd = len(data) > 8
+        if fd:
+            if not self.cfg.fd:
+                raise ValueError(f"[{self.cfg.name}] {len(data)}-byte frame on a bus without fd: true")
+            data = bytes(data).ljust(fd_length(len(data)), b"\0")
+        brs = fd and bool(self.cfg.dbitrate)
+        if self._tx_sock is None:
+            message = can.Message(arbitration_id=arbitration_id, data=data, is_extended_id=extended,
+                                  is_fd=fd, bitrate_switch=brs)
+            if self._tx is not None:
+                self._tx.submit(tx_class, message)
+                return
+            self.bus.send(message)
+        else:
+            can_id = arbitration_id | (CAN_EFF_FLAG if extended else 0)
+            if fd:
+                frame = struct.pack("=IBB2x64s", can_id, len(data), CANFD_BRS if brs else 0, data)
+            else:
+                frame = struct.pack("=IB3x8s", can_id, len(data), data)
+            if self._tx is not None:
+                self._tx.submit(tx_class, frame)
+                return
+            with self._tx_lock:
+                self._tx_sock.send(frame)
+        if self.metrics is not None:
+            self.metrics.tx_frames += 1
+
+    def stop_periodic(self, key: str) -> None:
+        """Stop the cyclic frame of a ``period_ms`` binding; the next send() restarts it."""
+
+        with self._tx_lock:
+            task = self._periodic.pop(key, None)
+            self._periodic_updated.pop(key, None)
+        if task is not None:
+            task.stop()
+            LOG.info("[%s] periodic TX %s stopped", self.cfg.name, key)
+
+    def send_many(self, frames: Iterable[tuple[str, Mapping[str, Any]]]) -> None:
+        """Send several ``(key, payload)`` frames in order, with one sendmmsg per 64.
+
+        Every payload is encoded before anything is sent, so a bad payload
+        raises without sending any frame of the batch.
+        """
+
+        frames = list(frames)
+        encoders = []
+        for key, payload in frames:
+            encoder = self._tx_bindings.get(key)
+            if encoder is None:
+                raise KeyError(f"Unknown TX binding '{key}'")
+            encoders.append(encoder)
+        scheduled = self._schedule.bindings if self._schedule is not None else frozenset()
+        coalesced = self._coalesce if self._coalesce is not None else frozenset()
+        held = [e.binding.period_ms or e.binding.key in scheduled or e.binding.key in coalesced for e in encoders]
+        if any(held):
+            # Cyclic, scheduled and coalesced bindings only get their frame swapped, the rest go out now
+            for encoder, (_, payload) in zip(encoders, frames):
+                if encoder.binding.period_ms:
+                    self._update_periodic(encoder, payload)
+                elif encoder.binding.key in scheduled:
+                    self._schedule.post(encoder.binding.key, self._frame(encoder, payload))
+                elif encoder.binding.key in coalesced:
+                    self._coalesce.post(encoder.binding.key, self._frame(encoder, payload))
+            kept = [(e, f) for e, f, h in zip(encoders, frames, held) if not h]
+            encoders, frames = [e for e, _ in kept], [f for _, f in kept]
+            if not frames:
+                return
+        if LOG.isEnabledFor(logging.DEBUG):
+            LOG.debug("[%s] TX batch of %d: %s", self.cfg.name, len(frames), [key for key, _ in frames])
+        if self._tx is not None:
+            queued = [(e.binding.tx_class, self._frame(e, payload)) for e, (_, payload) in zip(encoders, frames)]
+            for tx_class, frame in queued:
+                self._tx.submit(tx_class, frame)
+            return
+        if self.metrics is not None:
+            self.metrics.tx_frames += len(frames)
+        if self._sender is None or not all(e.classic for e in encoders):
+            messages = [e.encode(payload) for e, (_, payload) in zip(encoders, frames)]
+            for message in messages:
+                self.bus.send(message)
+            return
+
+        with self._tx_lock:
+            sender = self._sender
+            slots = []
+            count = 0
+            for encoder, (_, payload) in zip(encoders, frames):
+                if count == sender.capacity:
+                    slots.append(bytes(sender.buffer[:count * CAN_MTU]))
+                    count = 0
+                encoder.write(sender.buffer, count * CAN_MTU, payload)
+                count += 1
+            if not slots:
+                sender.send(count)
+                return
+            # More than one sendmmsg: every chunk was encoded first, now send them in order
+            tail = bytes(sender.buffer[:count * CAN_MTU])
+            for chunk in slots + [tail]:
+                sender.buffer[:len(chunk)] = chunk
+                sender.send(len(chunk) // CAN_MTU)
 
     # ------------------------------------------------------------------
     # Internal helpers
 
+    def _write_scheduled(self, frame: Any) -> None:
+        """One frame of the TX schedule, now or not at all: ENOBUFS is the schedule's to count."""
+
+        sock = self._tx_sock
+        if isinstance(frame, (bytes, bytearray)) and sock is not None:
+            sock.send(frame, MSG_DONTWAIT)
+        else:
+            self.bus.send(frame, timeout=0)
+        if self.metrics is not None:
+            self.metrics.tx_frames += 1
+
+    def _write_coalesced(self, key: str, frame: Any) -> None:
+        """A coalesce binding's frame, through its TX class or straight to the socket, never blocking."""
+
+        encoder = self._tx_bindings.get(key)
+        if self._tx is not None and encoder is not None:
+            self._tx.submit(encoder.binding.tx_class, frame, block=False)
+            return
+        self._write_scheduled(frame)
+
+    def _frame(self, encoder: FrameEncoder, payload: Mapping[str, Any]) -> Any:
+        """A frame the TX queue can hold: a copy of the packed can_frame, or a can.Message."""
+
+        if self._tx_sock is None:
+            return encoder.encode(payload)
+        if isinstance(self._tx, NativeTxScheduler):
+            # Packed into a buffer of its own: senders on other threads take no lock
+            buf = bytearray(encoder.size)
+            encoder.write(buf, 0, payload)
+            return bytes(buf)
+        with self._tx_lock:
+            return bytes(encoder.pack(payload))
+
+    def _tx_scheduler(self, cfg: BusConfig):
+        """The TX queue of ``cfg.tx_classes``: in the native core with ``tx_mode: native`` where it can run."""
+
+        if cfg.tx_mode == "native":
+            if _can_core is not None and hasattr(_can_core, "TxQueue") and self._tx_sock is not None:
+                return NativeTxScheduler(_can_core, self._tx_sock, cfg.tx_classes, cfg.name, self.metrics)
+            LOG.warning("[%s] tx_mode native needs the _can_core extension and a SocketCAN bus; using python",
+                        cfg.name)
+        return TxScheduler(self._tx_sock, self.bus, cfg.tx_classes, cfg.name, self.metrics)
+
+    @staticmethod
+    def pick_source(cfg: BusConfig) -> str:
+        """The source ``cfg`` opens: ``auto`` takes the daemon when one is serving the interface.
+
+        Only where the bus needs nothing a raw socket alone gives: kernel
+        filters, hardware timestamps or the native RX core.
+        """
+
+        if cfg.source != "auto":
+            return cfg.source
+        if (cfg.filters or cfg.auto_filters or cfg.rx_timestamps == "hardware" or cfg.rx_mode == "native"
+                or cfg.tx_mode == "native"):
+            return "socketcan"
+        from .tritoncand_bus import daemon_serving
+
+        return "tritoncand" if daemon_serving(cfg.interface) else "socketcan"
+
     @staticmethod
     def _open_bus(cfg: BusConfig) -> can.BusABC:
+        source = CanBusService.pick_source(cfg)
+        if source != cfg.source:
+            LOG.info("[%s] source auto: %s", cfg.name, source)
+        if source == "tritoncand":
+            # No raw socket: RX goes through bus.recv and TX through bus.send, on the daemon's rings
+            from .tritoncand_bus import TritoncandBus
+
+            return TritoncandBus(cfg.interface, client_name=cfg.name)
+        if source == "sim":
+            from .sim_bus import SimBus
+
+            return SimBus(cfg.interface)
         kwargs = dict(interface="socketcan", channel=cfg.interface, bitrate=cfg.bitrate, fd=cfg.fd)
         if cfg.fd and cfg.dbitrate:
             kwargs["data_bitrate"] = cfg.dbitrate
         return can.Bus(**kwargs)
 
-    def _rx_loop(self) -> None:
+    def _update_periodic(self, encoder: FrameEncoder, payload: Mapping[str, Any]) -> None:
+        """Start the binding's broadcast manager task, or swap its payload.
+
+        python-can's SocketCAN ``modify_data`` rewrites the BCM frame without
+        resetting its timer, so the kernel keeps the period while callbacks
+        update the content at whatever rate they run.
+        """
+
+        key = encoder.binding.key
+        with self._tx_lock:
+            message = encoder.encode(payload)
+            self._periodic_updated[key] = time.monotonic()
+            task = self._periodic.get(key)
+            if task is not None:
+                task.modify_data(message)
+                return
+            self._periodic[key] = self.bus.send_periodic(message, encoder.binding.period_ms / 1000.0)
+            if encoder.binding.hold_ms and self._hold_thread is None:
+                self._hold_thread = threading.Thread(
+                    target=self._hold_loop, name=f"{self.cfg.name}-tx-hold", daemon=True
+                )
+                self._hold_thread.start()
+        LOG.info("[%s] periodic TX %s every %s ms", self.cfg.name, key, encoder.binding.period_ms)
+
+    def _hold_loop(self) -> None:
+        """Stop cyclic frames whose payload has not been refreshed within their hold_ms."""
+
+        while True:
+            # Recomputed every turn: bindings come and go with a config reload
+            holds = [e.binding.hold_ms for e in list(self._tx_bindings.values()) if e.binding.hold_ms]
+            if not holds or self._stop.wait(min(holds) / 4000.0):
+                break
+            now = time.monotonic()
+            for key, updated in list(self._periodic_updated.items()):
+                encoder = self._tx_bindings.get(key)
+                hold_ms = encoder.binding.hold_ms if encoder else None
+                if hold_ms and now - updated > hold_ms / 1000.0:
+                    LOG.warning("[%s] periodic TX %s not refreshed for %s ms", self.cfg.name, key, hold_ms)
+                    self.stop_periodic(key)
+        self._hold_thread = None
+
+    def _set_filters(self, filters: Optional[List[MutableMapping[str, Any]]]) -> None:
+        try:
+            self.bus.set_filters(filters)
+        except Exception:  # pragma: no cover - depends on driver support
+            LOG.warning("[%s] failed to apply CAN filters", self.cfg.name, exc_info=True)
+
+    def _apply_auto_filters(self) -> None:
+        """Let the kernel pass only frames some RX binding decodes, plus the static ``filters``."""
+
+        if self._filters_held:
+            self._filters_stale = True
+            return
+
+        standard = [i for i, d in self._rx_bindings.items() if d.consumed and not d.msg_def.is_extended_frame]
+        extended = [i for i, d in self._rx_bindings.items() if d.consumed and d.msg_def.is_extended_frame]
+        masked = [(d.can_id, d.id_mask, d.msg_def.is_extended_frame)
+                  for _, t in self._mask_order for d in t.values() if d.consumed]
+        masked += [(can_id, mask, extended) for _, can_id, mask, extended, _ in self._raw_entries()]
+        auto = build_can_filters(standard, extended, masked)
+        if auto is None:
+            LOG.warning("[%s] RX bindings need too many CAN filters; receiving everything", self.cfg.name)
+            self._set_filters(None)
+            return
+        LOG.debug("[%s] CAN filters for %d frame IDs and %d masks: %s",
+                  self.cfg.name, len(standard) + len(extended), len(masked), auto)
+        self._set_filters(list(self.cfg.filters or []) + auto)
+
+    def _prepare_socket(self, sock) -> None:
+        self._enable_timestamps(sock)
+        try:
+            enable_error_frames(sock)
+        except OSError as exc:
+            LOG.warning("[%s] cannot receive error frames: %s", self.cfg.name, exc)
+        if (self.metrics is not None or self._buffers is not None) and self.cfg.rx_mode != "notifier":
+            try:
+                enable_overflow_count(sock)
+            except OSError as exc:
+                LOG.warning("[%s] cannot count socket overruns: %s", self.cfg.name, exc)
+        if self._buffers is not None:
+            self._buffers.apply(sock)
+
+    def _enable_timestamps(self, sock) -> None:
+        hardware = self.cfg.rx_timestamps == "hardware"
+        if hardware and self.cfg.rx_mode == "notifier":
+            LOG.warning("[%s] rx_timestamps hardware needs rx_mode direct or native", self.cfg.name)
+            hardware = False
+        try:
+            enabled = enable_timestamps(sock, hardware)
+        except OSError as exc:
+            LOG.warning("[%s] cannot enable RX timestamps: %s", self.cfg.name, exc)
+            return
+        if hardware and not enabled:
+            LOG.warning("[%s] %s has no hardware timestamping; using kernel time", self.cfg.name, self.cfg.interface)
+
+    def _dispatch(
+        self, arbitration_id: int, data: bytes, timestamp: float, counted: bool = False,
+        span: Optional[FrameSpan] = None,
+    ) -> None:
+        if self._trace is not None and span is None and self._trace.sample():
+            self._dispatch_traced(arbitration_id, data, timestamp, counted)
+            return
+        metrics = self.metrics
+        if metrics is not None and not counted:
+            metrics.rx_frames += 1
+        if self._raw_handlers:
+            self._run_raw_handlers(arbitration_id, data, timestamp)
+        dispatch = self._lookup(arbitration_id)
+        if not dispatch:
+            return
+        for recorder in dispatch.recorders:
+            try:
+                recorder.add(timestamp, data)
+            except Exception:
+                LOG.exception("[%s] RX batch handler for 0x%X failed", self.cfg.name, arbitration_id)
+        if not dispatch.live and dispatch.store is None:
+            return  # no binding, or every one idle: not even decoded
+        subscribers = dispatch.live
+        if self._shedding is not None:
+            subscribers = self._shedding.admit(subscribers, timestamp)
+            if not subscribers and dispatch.store is None:
+                return  # every binding sheds this frame: not even decoded
+        profiled = self._profile.begin("decode", dispatch.msg_def.name) if self._profile is not None else None
+        try:
+            if metrics is None:
+                decoded = dispatch.decode(data)
+            else:
+                start = time.perf_counter()
+                decoded = dispatch.decode(data)
+                metrics.decode_histogram(dispatch.msg_def.name).observe(time.perf_counter() - start)
+        except Exception:
+            if metrics is not None:
+                metrics.decode_errors += 1
+            LOG.exception("[%s] Failed to decode frame 0x%X", self.cfg.name, arbitration_id)
+            return
+        finally:
+            if profiled is not None:
+                self._profile.end(profiled)
+        if span is not None:
+            span.mark("decode")
+        self._deliver(dispatch, arbitration_id, decoded, timestamp, span, subscribers)
+
+    def _dispatch_traced(self, arbitration_id: int, data: bytes, timestamp: float, counted: bool) -> None:
+        span = self._trace.begin(arbitration_id, timestamp)
+        try:
+            self._dispatch(arbitration_id, data, timestamp, counted, span)
+        finally:
+            self._trace.commit(span)
+
+    def _deliver(
+        self, dispatch: RxDispatch, arbitration_id: int, decoded: Mapping[str, Any], timestamp: float,
+        span: Optional[FrameSpan] = None, subscribers: Optional[List[tuple]] = None,
+    ) -> None:
+        if dispatch.store is not None:
+            dispatch.store(decoded, timestamp, arbitration_id)
+            if span is not None:
+                span.mark("store")
+        LOG.debug(
+            "[%s] RX 0x%X (%s) %s",
+            self.cfg.name,
+            arbitration_id,
+            dispatch.msg_def.name,
+            decoded,
+        )
+        # With a pool the handlers are queue.put; the workers time the real ones
+        metrics = self.metrics if self._pool is None else None
+        profile = self._profile if self._pool is None else None
+        for decoder, binding, handler in dispatch.live if subscribers is None else subscribers:
+            start = time.perf_counter() if metrics is not None else 0.0
+            profiled = profile.begin("rx", binding.key) if profile is not None else None
+            try:
+                handler(decoder.project(decoded, arbitration_id), binding, timestamp)
+            except Exception:
+                if metrics is not None:
+                    metrics.handler_errors += 1
+                LOG.exception("[%s] RX handler for %s failed", self.cfg.name, binding.key)
+            if profiled is not None:
+                profile.end(profiled)
+            if metrics is not None:
+                metrics.handler_histogram(binding.key).observe(time.perf_counter() - start)
+            if span is not None:
+                span.mark("handler " + binding.key)
+
+    def _start_recorder(self) -> None:
+        """Open this run's recording when the bus has a ``recorder``; call after the core is made."""
+
+        spec = self.cfg.recorder
+        if spec is None:
+            return
+        if spec.get("capture") is not None:
+            # The recorder reads the interface's own packet ring; the RX loop copies nothing for it
+            ring = PacketCapture([self.cfg.interface], **spec["capture"])
+            self._recorder = FrameRecorder(ring, spec, self.cfg.name, self.cfg.interface)
+            return
+        frames = int(spec.get("ring_frames", DEFAULT_RING_FRAMES))
+        # The native core pushes from C++ with the GIL released, so it needs its own ring
+        ring = _can_core.FrameRing(frames) if self._core is not None else FrameRing(frames)
+        self._recorder = FrameRecorder(ring, spec, self.cfg.name, self.cfg.interface)
+        if self._core is not None:
+            self._core.set_recorder(ring)
+
+    @property
+    def _recorder_ring(self):
+        """The ring the RX loop copies frames into; None without a recorder or with its own capture."""
+
+        if self._recorder is None or self.cfg.recorder.get("capture") is not None:
+            return None
+        return self._recorder.ring
+
+    def _pin_thread(self) -> None:
+        """Move the calling (RX) thread onto ``cpu_affinity``."""
+
+        if not self.cfg.cpu_affinity:
+            return
+        try:
+            os.sched_setaffinity(0, self.cfg.cpu_affinity)
+        except (AttributeError, OSError) as exc:
+            LOG.warning("[%s] cpu_affinity %s not applied: %s", self.cfg.name, list(self.cfg.cpu_affinity), exc)
+
+    def _rx_main(self, loop: Callable[[], None]) -> None:
+        """RX thread: run ``loop``; when the interface fails under it, reopen the bus and run it again.
+
+        Reopen attempts wait ``recovery[0]`` seconds, doubling up to
+        ``recovery[1]``; a loop that ran longer than that before failing
+        starts over at the shortest wait. The notifier loop reads through
+        python-can's own thread and is not recovered.
+        """
+
+        if self.cfg.recovery is None:
+            try:
+                loop()
+            except OSError:
+                self.errors.set_state("down")
+                LOG.exception("[%s] RX loop failed", self.cfg.name)
+            return
+        first, longest = self.cfg.recovery
+        delay = first
+        while True:
+            started = time.monotonic()
+            try:
+                loop()
+                return
+            except OSError as exc:
+                if self._stop.is_set():
+                    return
+                LOG.warning("[%s] lost %s: %s; reopening", self.cfg.name, self.cfg.interface, exc)
+            self.errors.set_state("down")
+            if time.monotonic() - started > longest:
+                delay = first
+            while True:
+                if self._stop.wait(delay):
+                    return
+                delay = min(delay * 2, longest)
+                try:
+                    loop = self._reopen()
+                    break
+                except (OSError, can.CanError) as exc:
+                    LOG.debug("[%s] reopening %s failed: %s", self.cfg.name, self.cfg.interface, exc)
+            self.errors.recoveries += 1
+            self.errors.set_state("error_active")  # until error frames say otherwise
+            LOG.info("[%s] %s reopened", self.cfg.name, self.cfg.interface)
+
+    def _reopen(self) -> Callable[[], None]:
+        """Replace the bus and its sockets after an interface failure; returns the RX loop to run on them.
+
+        A raw socket outlives its interface going down and up again, but not
+        the interface being removed (a USB adapter unplugged), so the bus is
+        always opened anew. Periodic frames restart on their next send().
+        """
+
+        bus = self._open_bus(self.cfg)
+        for key in list(self._periodic):
+            self.stop_periodic(key)
+        old = self.bus
+        with self._tx_lock:
+            self.bus = bus
+            self._tx_sock = getattr(bus, "socket", None)
+            self._sender = BatchSender(self._tx_sock) if self._tx_sock is not None else None
+            if self._tx is not None:
+                self._tx.rebind(self._tx_sock, bus)
+        try:
+            old.shutdown()
+        except Exception:  # pragma: no cover - the old interface may be gone
+            LOG.debug("[%s] error closing the failed bus", self.cfg.name, exc_info=True)
+        if self.cfg.auto_filters:
+            self._apply_auto_filters()
+        elif self.cfg.filters:
+            self._set_filters(list(self.cfg.filters))
+        sock = self._tx_sock
+        if sock is None:
+            return self._rx_loop_direct
+        self._prepare_socket(sock)
+        if self.cfg.rx_mode != "native" or _can_core is None:
+            return self._rx_loop_direct
+        self._core = _can_core.RxCore(sock.fileno(), self.cfg.rx_batch)
+        self._fill_core()
+        if self._recorder_ring is not None:
+            self._core.set_recorder(self._recorder_ring)
+        self._attach_busy_poll()
+        return self._rx_loop_native
+
+    def _rx_loop_direct(self) -> None:
+        """Read the socket in this thread, every queued frame per wakeup.
+
+        Falls back to ``bus.recv`` when the bus exposes no raw socket (a
+        non-SocketCAN python-can interface).
+        """
+
+        self._pin_thread()
+        sock = getattr(self.bus, "socket", None)
+        if sock is not None:
+            self._receiver = BatchReceiver(sock, self.cfg.rx_batch)
+            self._receiver.ring = self._recorder_ring
+            self._receiver.on_error = self.errors.on_frame
+        LOG.info(
+            "[%s] RX loop started (direct, %s)",
+            self.cfg.name,
+            "recvmmsg" if self._receiver and self._receiver.batched
+            else "recv per frame" if self._receiver else "bus.recv",
+        )
+        try:
+            if self._receiver is None:
+                ring = self._recorder_ring
+                while not self._stop.is_set():
+                    msg = self.bus.recv(timeout=0.1)
+                    if msg is not None and ring is not None:
+                        ring.push(msg.timestamp, msg)
+                    if msg is not None and msg.is_error_frame:
+                        self.errors.on_frame(msg.arbitration_id, bytes(msg.data), msg.timestamp)
+                    elif msg is not None and not msg.is_remote_frame:
+                        if self._priority_handlers:
+                            self._run_priority(((msg.arbitration_id, bytes(msg.data), msg.timestamp),))
+                        self._dispatch(msg.arbitration_id, bytes(msg.data), msg.timestamp)
+                return
+            while not self._stop.is_set():
+                frames = self._receiver.recv(timeout=None)
+                if self._priority_handlers:
+                    self._run_priority(frames)
+                for arbitration_id, data, timestamp in frames:
+                    self._dispatch(arbitration_id, data, timestamp)
+        finally:
+            if self._receiver:
+                self._receiver.close()
+                self._receiver = None
+            LOG.info("[%s] RX loop stopped", self.cfg.name)
+
+    def _load_core(self, dispatch: RxDispatch) -> None:
+        msg = dispatch.msg_def
+        specs = dispatch.native[1] if dispatch.native else []
+        raw = dispatch.native is None or bool(dispatch.recorders)
+        mask = CAN_EFF_MASK if dispatch.id_mask is None else dispatch.id_mask
+        if not dispatch.consumed:
+            # Every binding idle: the core drops the frame, or hands it back undecoded for a raw handler
+            self._core.remove_message(dispatch.can_id, msg.is_extended_frame, mask)
+            if any(h[1:4] == (dispatch.can_id, mask, msg.is_extended_frame) for h in self._raw_entries()):
+                self._core.set_message(dispatch.can_id, msg.is_extended_frame, 0, True, [], mask)
+            return
+        self._core.set_message(dispatch.can_id, msg.is_extended_frame, msg.length, raw, specs, mask)
+
+    def _fill_core(self) -> None:
+        for dispatch in self._dispatches():
+            self._load_core(dispatch)
+        for _, can_id, id_mask, extended, _ in self._raw_entries():
+            self._load_raw_core(can_id, id_mask, extended)
+
+    def _raw_core_taken(self, can_id: int, id_mask: int, extended: bool) -> bool:
+        """True when an RX dispatch or another raw handler holds the core's entry for (can_id, id_mask)."""
+
+        table = self._rx_bindings if id_mask == CAN_EFF_MASK else self._rx_masked.get(id_mask, {})
+        dispatch = table.get(can_id)
+        if dispatch is not None and dispatch.msg_def.is_extended_frame == extended:
+            return True
+        return any(h[1:4] == (can_id, id_mask, extended) for h in self._raw_entries())
+
+    def _load_raw_core(self, can_id: int, id_mask: int, extended: bool) -> None:
+        # Hand matching frames back undecoded; an RX dispatch on the same entry keeps its spec
+        table = self._rx_bindings if id_mask == CAN_EFF_MASK else self._rx_masked.get(id_mask, {})
+        if can_id not in table:
+            self._core.set_message(can_id, extended, 0, True, [], id_mask)
+
+    def _raw_entries(self) -> List[tuple[str, int, int, bool, RawHandler]]:
+        return self._raw_handlers + self._priority_handlers
+
+    def _run_priority(self, frames) -> None:
+        """The priority raw handlers over a batch of ``(arbitration_id, data, timestamp)``, in order."""
+
+        handlers = self._priority_handlers
+        for arbitration_id, data, timestamp in frames:
+            for key, can_id, id_mask, _, handler in handlers:
+                if arbitration_id & id_mask != can_id:
+                    continue
+                try:
+                    handler(arbitration_id, data if isinstance(data, bytes) else None, timestamp)
+                except Exception:
+                    LOG.exception("[%s] raw handler %s failed", self.cfg.name, key)
+
+    def _run_raw_handlers(self, arbitration_id: int, data: Optional[bytes], timestamp: float) -> None:
+        for key, can_id, id_mask, _, handler in self._raw_handlers:
+            if arbitration_id & id_mask != can_id:
+                continue
+            try:
+                handler(arbitration_id, data, timestamp)
+            except Exception:
+                LOG.exception("[%s] raw handler %s failed", self.cfg.name, key)
+
+    def _on_native_batch(self, batch: List[tuple[int, Any, float]]) -> None:
+        if self.metrics is not None and self._core is not None:
+            self.metrics.rx_frames = self._core.frames  # the core also counts frames no binding reads
+        if self._priority_handlers:
+            # Error frames carry CAN_ERR_FLAG, which no handler's ID has
+            self._run_priority(batch)
+        now = 0.0
+        for arbitration_id, values, timestamp in batch:
+            if not timestamp:
+                timestamp = now = now or time.time()
+            if isinstance(values, bytes):
+                if arbitration_id & CAN_ERR_FLAG:
+                    self.errors.on_frame(arbitration_id & CAN_ERR_MASK, values, timestamp)
+                    continue
+                self._dispatch(arbitration_id, values, timestamp, counted=True)
+                continue
+            if self._raw_handlers:
+                self._run_raw_handlers(arbitration_id, None, timestamp)
+            dispatch = self._lookup(arbitration_id)
+            # A binding registered mid-batch grows the signal set; those few frames are skipped
+            if dispatch and dispatch.native and len(values) == len(dispatch.native[0]):
+                subscribers = dispatch.live
+                if self._shedding is not None:
+                    subscribers = self._shedding.admit(subscribers, timestamp)
+                self._deliver(dispatch, arbitration_id, dict(zip(dispatch.native[0], values)), timestamp,
+                              subscribers=subscribers)
+
+    def _on_native_columns(self, batch) -> None:
+        for key, handler in self._column_handlers:
+            try:
+                handler(batch)
+            except Exception:
+                LOG.exception("[%s] column handler %s failed", self.cfg.name, key)
+        self._on_native_batch(batch.to_list())
+
+    def _rx_loop_native(self) -> None:
+        """The C++ core reads, filters and decodes with the GIL released; Python only runs handlers."""
+
+        core = self._core
+        self._pin_thread()
+        LOG.info("[%s] RX loop started (native)", self.cfg.name)
+        try:
+            if hasattr(core, "run_columns"):
+                core.run_columns(self._on_native_columns)
+            else:
+                core.run(self._on_native_batch)
+        except OSError:
+            raise  # the interface failed; _rx_main reopens it
+        except Exception:
+            LOG.exception("[%s] native RX loop failed", self.cfg.name)
+        finally:
+            if self._busy is not None:
+                self._busy.remove(core)  # before the core goes: the poller holds it by pointer
+                if core.busy_dropped:
+                    LOG.warning("[%s] rx_busy_poll: %d frames lost on a full ring", self.cfg.name, core.busy_dropped)
+            self._core = None
+            LOG.info("[%s] RX loop stopped after %d frames", self.cfg.name, core.frames)
+
+    def _attach_busy_poll(self) -> None:
+        """Hand the socket of the new core to the ``rx_busy_poll`` thread of its CPU."""
+
+        cfg = self.cfg.rx_busy_poll
+        self._busy = None
+        if cfg is None:
+            return
+        if not hasattr(_can_core, "BusyPoller"):
+            LOG.warning("[%s] rx_busy_poll needs a _can_core with BusyPoller; rebuild it. Waiting on the socket",
+                        self.cfg.name)
+            return
+        with _BUSY_POLLERS_LOCK:
+            poller = _BUSY_POLLERS.get(cfg.cpu)
+            if poller is None:
+                poller = _BUSY_POLLERS[cfg.cpu] = _can_core.BusyPoller(cfg.cpu)
+                if poller.thread_error:
+                    LOG.warning("[%s] rx_busy_poll thread not pinned to CPU %d: %s", self.cfg.name, cfg.cpu,
+                                os.strerror(poller.thread_error))
+        self._core.set_busy(cfg.ring, cfg.spin_us)
+        poller.add(self._core)
+        self._busy = poller
+        LOG.info("[%s] RX busy-polled on CPU %d (spin %s us)", self.cfg.name, cfg.cpu,
+                 "always" if cfg.spin_us < 0 else cfg.spin_us)
+
+    def _rx_loop_notifier(self) -> None:
+        """python-can Notifier feeding a BufferedReader: two threads and a queue per frame."""
+
+        self._pin_thread()
         reader = can.BufferedReader()
         notifier = can.Notifier(self.bus, [reader], timeout=0.01)
-        LOG.info("[%s] RX loop started", self.cfg.name)
+        LOG.info("[%s] RX loop started (notifier)", self.cfg.name)
+        ring = self._recorder_ring
         try:
             while not self._stop.is_set():
                 msg = reader.get_message(timeout=0.1)
                 if msg is None:
                     continue
-                binding_entry = self._rx_bindings.get(msg.arbitration_id)
-                if not binding_entry:
+                if ring is not None:
+                    ring.push(msg.timestamp, msg)
+                if msg.is_error_frame:
+                    self.errors.on_frame(msg.arbitration_id, bytes(msg.data), msg.timestamp)
                     continue
-                decoder, binding, handler = binding_entry
-                try:
-                    payload = decoder.decode(bytes(msg.data))
-                    LOG.debug(
-                        "[%s] RX 0x%X (%s) %s",
-                        self.cfg.name,
-                        msg.arbitration_id,
-                        decoder.msg_def.name,
-                        payload,
-                    )
-                    handler(payload, binding)
-                except Exception:
-                    LOG.exception("[%s] Failed to decode frame 0x%X", self.cfg.name, msg.arbitration_id)
+                if self._priority_handlers:
+                    self._run_priority(((msg.arbitration_id, bytes(msg.data), msg.timestamp),))
+                self._dispatch(msg.arbitration_id, bytes(msg.data), msg.timestamp)
         finally:
             notifier.stop()
             LOG.info("[%s] RX loop stopped", self.cfg.name)
@@ -344,9 +2295,13 @@ class CanBusService:
 __all__ = [
     "BridgeConfig",
     "BusConfig",
+    "BusyPollConfig",
     "CanBusService",
+    "RawHandler",
     "RxBindingConfig",
     "TxBindingConfig",
+    "check_bindings",
     "load_bridge_config",
+    "missing_attributes",
 ]
 
@@ -0,0 +1,274 @@
+"""Latest value of every decoded signal in shared memory.
+
+:class:`SignalStore` is written by ``CanBusService`` (bus key
+``signal_store``): a file under ``/dev/shm`` holding one slot per DBC signal
+with the last value, its receive timestamp and a sequence number. Any
+process on the machine opens it with :class:`SignalStoreReader` and reads the
+current motor state straight from the mapping, with no socket, no decoding
+and no ROS round trip.
+
+File layout (little-endian)::
+
+    header   magic "TDCANSS1", version, slot count, slot size,
+             directory offset and length
+    slots    slot_count x 32 bytes: seq u64, value f64, timestamp f64, seq u64
+    rings    slot_count x history x 16 bytes: value f64, timestamp f64
+    directory  JSON {"bus": ..., "signals": {"Message.signal": slot index},
+               "history": samples per ring, "rings": offset of the rings}
+
+Each slot is a seqlock. The writer makes ``seq`` odd, stores value and
+timestamp, then stores the even ``seq`` at both ends of the slot; a reader
+retries until it sees the same even ``seq`` before and after copying the
+slot. ``seq // 2`` is the number of updates. The protocol relies on stores
+becoming visible in program order, as on x86-64; with a single writer per
+file there is no other locking. Values are float64, which holds every
+integer signal up to 53 bits exactly.
+
+With ``history`` the store also keeps the last ``history`` updates of every
+signal in a ring, for plotting and other consumers that must not miss a
+sample. Update ``n`` (zero-based) goes to entry ``n % history`` while the
+slot's ``seq`` is odd, so the slot counter doubles as the ring's head and
+the writer does one more store per signal, still without a lock.
+:meth:`SignalStoreReader.history` copies the new entries and then drops any
+the writer may have overwritten during the copy.
+"""
+
+from __future__ import annotations
+
+import json
+import mmap
+import os
+import struct
+from pathlib import Path
+from types import SimpleNamespace
+from typing import Any, Dict, Iterable, List, Mapping, Optional, Tuple
+
+MAGIC = b"TDCANSS1"
+VERSION = 1
+SLOT_SIZE = 32
+_HEADER = struct.Struct("<8sIIIII")
+_HEADER_SIZE = 64
+_SEQ = struct.Struct("<Q")
+_BODY = struct.Struct("<dd")
+_SLOT = struct.Struct("<QddQ")
+_SAMPLE_SIZE = _BODY.size
+_READ_TRIES = 10_000
+
+DEFAULT_DIR = Path("/dev/shm")
+
+
+def default_path(bus_name: str) -> Path:
+    return DEFAULT_DIR / f"td_can_{bus_name}"
+
+
+class SignalStore:
+    """Writer side: one slot for every signal of ``messages`` (cantools Message objects).
+
+    ``history`` > 0 adds a ring of that many samples per signal. ``split``
+    maps a message received under an ID mask to ``((low, high), ids)``: the
+    bits of the frame ID that tell its senders apart, and the senders to keep.
+    Each gets slots of its own, ``Message[id].signal``, and frames of other
+    senders are not stored (RoboStride feedback: motor ID in bits 8-15).
+    """
+
+    def __init__(self, path: Path, bus_name: str, messages: Iterable[Any], history: int = 0,
+                 split: Optional[Mapping[str, Tuple[Tuple[int, int], Iterable[int]]]] = None):
+        self.path = Path(path)
+        self.depth = max(0, int(history))
+        self._slots: Dict[str, int] = {}
+        self._offsets: Dict[str, List[Tuple[str, int, int]]] = {}  # group -> (signal, offset, slot)
+        self._split: Dict[str, Tuple[int, int, List[int]]] = {}    # message -> (shift, mask, ids)
+        for msg in messages:
+            groups = [msg.name]
+            if split and msg.name in split:
+                (low, high), ids = split[msg.name]
+                self._split[msg.name] = (low, (1 << (high - low + 1)) - 1, list(ids))
+                groups = [f"{msg.name}[{i}]" for i in self._split[msg.name][2]]
+            for group in groups:
+                offsets = self._offsets.setdefault(group, [])
+                for signal in msg.signals:
+                    name = f"{group}.{signal.name}"
+                    if name not in self._slots:
+                        slot = self._slots[name] = len(self._slots)
+                        offsets.append((signal.name, _HEADER_SIZE + slot * SLOT_SIZE, slot))
+
+        rings = _HEADER_SIZE + len(self._slots) * SLOT_SIZE
+        self._rings = rings
+        directory = json.dumps({"bus": bus_name, "signals": self._slots, "history": self.depth,
+                                "rings": rings}).encode()
+        dir_offset = rings + len(self._slots) * self.depth * _SAMPLE_SIZE
+        size = dir_offset + len(directory)
+
+        # Built under a temporary name and renamed, so a reader never maps a half-written file
+        tmp = self.path.with_name(self.path.name + ".tmp")
+        fd = os.open(tmp, os.O_RDWR | os.O_CREAT | os.O_TRUNC, 0o644)
+        try:
+            os.ftruncate(fd, size)
+            self._map = mmap.mmap(fd, size)
+        finally:
+            os.close(fd)
+        _HEADER.pack_into(self._map, 0, MAGIC, VERSION, len(self._slots), SLOT_SIZE, dir_offset, len(directory))
+        self._map[dir_offset:size] = directory
+        os.replace(tmp, self.path)
+        self._seq = [0] * len(self._slots)
+
+    @classmethod
+    def for_signals(cls, path: Path, bus_name: str, messages: Mapping[str, Iterable[str]],
+                    history: int = 0) -> "SignalStore":
+        """A store for values that come from no DBC, such as a test loop's: ``{message: [signal, ...]}``."""
+
+        return cls(path, bus_name, [SimpleNamespace(name=name, signals=[SimpleNamespace(name=s) for s in signals])
+                                    for name, signals in messages.items()], history)
+
+    def writer(self, message: str):
+        """Return ``write(decoded, timestamp, arbitration_id=0)`` for one message, or None if it has no slots.
+
+        The frame ID only matters for a ``split`` message.
+        """
+
+        if message in self._split:
+            shift, mask, ids = self._split[message]
+            by_id = {i: self._writer(self._offsets[f"{message}[{i}]"]) for i in ids}
+            if not any(by_id.values()):
+                return None
+
+            def write_split(decoded: Mapping[str, Any], timestamp: float, arbitration_id: int = 0) -> None:
+                write = by_id.get((arbitration_id >> shift) & mask)
+                if write is not None:
+                    write(decoded, timestamp)
+
+            return write_split
+        return self._writer(self._offsets.get(message))
+
+    def _writer(self, offsets):
+        if not offsets:
+            return None
+        buf, seqs = self._map, self._seq
+        pack_seq, pack_body = _SEQ.pack_into, _BODY.pack_into
+        history = self.depth
+        rings = [self._rings + slot * history * _SAMPLE_SIZE for _, _, slot in offsets]
+
+        def write(decoded: Mapping[str, Any], timestamp: float, arbitration_id: int = 0) -> None:
+            for (signal, offset, slot), ring in zip(offsets, rings):
+                value = decoded.get(signal)
+                if value is None:
+                    continue
+                seq = seqs[slot] + 1
+                pack_seq(buf, offset, seq)
+                value = float(getattr(value, "value", value))
+                pack_body(buf, offset + 8, value, timestamp)
+                if history:
+                    pack_body(buf, ring + (seq // 2) % history * _SAMPLE_SIZE, value, timestamp)
+                seq += 1
+                pack_seq(buf, offset + 24, seq)
+                pack_seq(buf, offset, seq)
+                seqs[slot] = seq
+
+        return write
+
+    def close(self, unlink: bool = True) -> None:
+        self._map.close()
+        if unlink:
+            try:
+                os.unlink(self.path)
+            except FileNotFoundError:
+                pass
+
+
+class SignalStoreReader:
+    """Read-only view of a :class:`SignalStore` file, usable from any process."""
+
+    def __init__(self, path: Path):
+        self.path = Path(path)
+        fd = os.open(self.path, os.O_RDONLY)
+        try:
+            self._inode = os.fstat(fd).st_ino
+            self._map = mmap.mmap(fd, 0, prot=mmap.PROT_READ)
+        finally:
+            os.close(fd)
+        magic, version, count, slot_size, dir_offset, dir_length = _HEADER.unpack_from(self._map, 0)
+        if magic != MAGIC or version != VERSION or slot_size != SLOT_SIZE:
+            self._map.close()
+            raise ValueError(f"{self.path} is not a version {VERSION} signal store")
+        directory = json.loads(bytes(self._map[dir_offset:dir_offset + dir_length]))
+        self.bus: str = directory["bus"]
+        self._slots: Dict[str, int] = directory["signals"]
+        self.depth: int = directory.get("history", 0)  # samples per ring, 0 without
+        self._rings: int = directory.get("rings", 0)
+
+    @property
+    def signals(self) -> List[str]:
+        """``Message.signal`` names, in slot order."""
+
+        return list(self._slots)
+
+    def read(self, name: str) -> Optional[Tuple[float, float, int]]:
+        """``(value, timestamp, updates)`` of ``Message.signal``.
+
+        None before its first frame, or if the writer died in the middle of
+        an update and the slot never became consistent.
+        """
+
+        offset = _HEADER_SIZE + self._slots[name] * SLOT_SIZE
+        for _ in range(_READ_TRIES):
+            seq, value, timestamp, end = _SLOT.unpack_from(self._map, offset)
+            if seq & 1 or seq != end:
+                continue  # a write is in progress
+            if _SEQ.unpack_from(self._map, offset)[0] == seq:
+                return None if seq == 0 else (value, timestamp, seq // 2)
+        return None
+
+    def history(self, name: str, cursor: int = 0) -> Tuple[List[Tuple[float, float]], int]:
+        """``([(timestamp, value), ...], cursor)``: the updates of ``Message.signal`` since ``cursor``.
+
+        Pass the returned cursor to the next call. Updates that have left
+        the ring since (the reader fell more than ``history`` behind) are
+        skipped; ``cursor`` counts them too. Empty without a ring.
+        """
+
+        history = self.depth
+        if not history:
+            return [], cursor
+        slot = self._slots[name]
+        offset = _HEADER_SIZE + slot * SLOT_SIZE
+        ring = self._rings + slot * history * _SAMPLE_SIZE
+        done = _SEQ.unpack_from(self._map, offset)[0] // 2
+        # The update in progress (if any) is overwriting the oldest entry
+        start = max(cursor, done - history + 1)
+        if start >= done:
+            return [], max(cursor, done)
+        first, last = start % history, (done - 1) % history + 1
+        if first < last:
+            raw = self._map[ring + first * _SAMPLE_SIZE:ring + last * _SAMPLE_SIZE]
+        else:
+            raw = (self._map[ring + first * _SAMPLE_SIZE:ring + history * _SAMPLE_SIZE]
+                   + self._map[ring:ring + last * _SAMPLE_SIZE])
+        # Entries the writer reached while we copied are no longer the ones we wanted
+        started = (_SEQ.unpack_from(self._map, offset)[0] + 1) // 2
+        skip = max(0, started - history - start)
+        samples = [(timestamp, value) for value, timestamp in _BODY.iter_unpack(raw)]
+        return samples[skip:], done
+
+    def snapshot(self) -> Dict[str, Tuple[float, float, int]]:
+        """Every signal received so far; each slot is consistent on its own."""
+
+        out = {}
+        for name in self._slots:
+            entry = self.read(name)
+            if entry is not None:
+                out[name] = entry
+        return out
+
+    def replaced(self) -> bool:
+        """True when the service restarted and created a new file at ``path``; reopen then."""
+
+        try:
+            return os.stat(self.path).st_ino != self._inode
+        except FileNotFoundError:
+            return True
+
+    def close(self) -> None:
+        self._map.close()
+
+
+__all__ = ["SignalStore", "SignalStoreReader", "default_path"]
@@ -0,0 +1,279 @@
+"""In-process CAN buses on a virtual clock, for tests and benchmarks without an interface.
+
+A bus config with ``source: sim`` opens a :class:`SimBus` on the
+:class:`SimNetwork` named by its ``interface``. Every bus on a network gets
+the frames the others send, as the same ``can.Message`` object: nothing is
+copied or serialised on the way, so readers must not modify what they
+receive. Outside the service, ``can.Bus(interface="td_sim", channel="sim0")``
+opens one once the package is installed.
+
+Frames are stamped with the network's :class:`VirtualClock`, which only
+moves when the test drives it. ``schedule(t, ...)`` queues a frame (or a
+call, for a simulated device) at a virtual time, and :meth:`SimNetwork.run`
+jumps from one event to the next. After each event it waits until every
+reader has taken its frames and is blocked in ``recv`` again, so replies
+sent from handlers land before the next event and a run is the same every
+time. A recorded log plays in the time it takes to dispatch it::
+
+    net = SimNetwork.get("sim0")
+    service = CanBusService(replace(cfg, interface="sim0", source="sim"))
+    service.start()
+    net.play(read_log("field.blf"))
+    net.run()
+
+The service's own timers (``ParameterClient`` timeouts, ``hold_ms``,
+periodic TX) still run on the wall clock.
+"""
+
+from __future__ import annotations
+
+import collections
+import heapq
+import itertools
+import threading
+import time
+from typing import Any, Callable, ClassVar, Deque, Dict, Iterable, List, Optional, Tuple, Union
+
+import can
+
+from .socketcan_rx import CAN_EFF_FLAG, CAN_EFF_MASK, CAN_ERR_FLAG, CAN_RTR_FLAG
+
+SETTLE_TIMEOUT = 1.0  # seconds run() waits for the readers after each event
+
+
+class VirtualClock:
+    """Seconds since the network was created, moved only by :meth:`advance_to`."""
+
+    def __init__(self, start: float = 0.0):
+        self._now = start
+
+    def now(self) -> float:
+        return self._now
+
+    def advance_to(self, t: float) -> None:
+        if t > self._now:
+            self._now = t
+
+
+Event = Union[can.Message, Callable[[], None]]
+
+
+class SimNetwork:
+    """The buses sharing one channel name, with their clock and scheduled events."""
+
+    _networks: ClassVar[Dict[str, "SimNetwork"]] = {}
+    _registry_lock: ClassVar[threading.Lock] = threading.Lock()
+
+    def __init__(self, channel: str, clock: Optional[VirtualClock] = None):
+        self.channel = channel
+        self.clock = clock or VirtualClock()
+        self.frames = 0  # frames sent on the network
+        self._cond = threading.Condition()
+        self._buses: List["SimBus"] = []
+        self._events: List[Tuple[float, int, Event]] = []
+        self._seq = itertools.count()
+
+    @classmethod
+    def get(cls, channel: str) -> "SimNetwork":
+        """The network of ``channel``, created on first use."""
+
+        with cls._registry_lock:
+            net = cls._networks.get(channel)
+            if net is None:
+                net = cls._networks[channel] = cls(channel)
+            return net
+
+    @classmethod
+    def reset(cls, channel: Optional[str] = None) -> None:
+        """Forget one network, or all of them; buses still open keep theirs."""
+
+        with cls._registry_lock:
+            if channel is None:
+                cls._networks.clear()
+            else:
+                cls._networks.pop(channel, None)
+
+    # ------------------------------------------------------------------
+    # Traffic
+
+    def send(self, msg: can.Message, sender: Optional["SimBus"] = None) -> None:
+        """Deliver ``msg`` now to every bus but its sender (and to it with ``receive_own_messages``)."""
+
+        msg.timestamp = self.clock.now()
+        if msg.channel is None:
+            msg.channel = self.channel
+        with self._cond:
+            for bus in self._buses:
+                if bus is not sender or bus.receive_own_messages:
+                    bus._queue.append(msg)
+            self.frames += 1
+            self._cond.notify_all()
+
+    def schedule(self, t: float, event: Event) -> None:
+        """Send a frame, or make a call, when the clock reaches ``t``."""
+
+        with self._cond:
+            heapq.heappush(self._events, (t, next(self._seq), event))
+
+    def play(self, frames: Iterable[Any], offset: Optional[float] = None) -> int:
+        """Schedule :class:`~.replay.LogFrame` entries at their log times, shifted to start now.
+
+        Error frames are skipped, as the replayer skips them. Returns the frames scheduled.
+        """
+
+        count = 0
+        for frame in frames:
+            if frame.can_id & CAN_ERR_FLAG:
+                continue
+            if offset is None:
+                offset = self.clock.now() - frame.timestamp
+            msg = can.Message(
+                arbitration_id=frame.can_id & CAN_EFF_MASK,
+                is_extended_id=bool(frame.can_id & CAN_EFF_FLAG),
+                is_remote_frame=bool(frame.can_id & CAN_RTR_FLAG),
+                is_fd=frame.fd,
+                bitrate_switch=bool(frame.flags & 0x01),
+                data=frame.data,
+            )
+            self.schedule(frame.timestamp + offset, msg)
+            count += 1
+        return count
+
+    def every(self, period: float, fn: Callable[[], None], start: Optional[float] = None) -> None:
+        """Call ``fn`` every ``period`` virtual seconds, from ``start`` (default: one period from now).
+
+        The calls never run out, so drive the network with ``run(until=...)``.
+        """
+
+        def tick(t: float) -> None:
+            fn()
+            self.schedule(t + period, lambda: tick(t + period))
+
+        first = self.clock.now() + period if start is None else start
+        self.schedule(first, lambda: tick(first))
+
+    # ------------------------------------------------------------------
+    # Driving the clock
+
+    def step(self) -> bool:
+        """Move the clock to the next event and run it; False when none is left."""
+
+        with self._cond:
+            if not self._events:
+                return False
+            t, _, event = heapq.heappop(self._events)
+        self.clock.advance_to(t)
+        if isinstance(event, can.Message):
+            self.send(event)
+        else:
+            event()
+        return True
+
+    def run(self, until: Optional[float] = None, settle: bool = True) -> int:
+        """Run events up to virtual time ``until`` (all of them by default); returns how many ran.
+
+        ``settle`` waits for the readers after each event, see :meth:`settle`.
+        """
+
+        count = 0
+        while True:
+            with self._cond:
+                if not self._events or (until is not None and self._events[0][0] > until):
+                    break
+            self.step()
+            count += 1
+            if settle:
+                self.settle()
+        if until is not None:
+            self.clock.advance_to(until)
+        return count
+
+    def advance(self, dt: float, settle: bool = True) -> int:
+        return self.run(self.clock.now() + dt, settle)
+
+    def settle(self, timeout: float = SETTLE_TIMEOUT) -> bool:
+        """Wait until every bus that reads has an empty queue and is back in ``recv``.
+
+        A reader is back in ``recv`` once it handled the frame before, so this
+        is the point where everything queued so far was dispatched. False on
+        timeout, for a reader that is stuck or was never started.
+        """
+
+        deadline = time.monotonic() + timeout
+        with self._cond:
+            while not all(bus._idle() for bus in self._buses):
+                left = deadline - time.monotonic()
+                if left <= 0:
+                    return False
+                self._cond.wait(left)
+            return True
+
+    def _attach(self, bus: "SimBus") -> None:
+        with self._cond:
+            self._buses.append(bus)
+
+    def _detach(self, bus: "SimBus") -> None:
+        with self._cond:
+            if bus in self._buses:
+                self._buses.remove(bus)
+            self._cond.notify_all()
+
+
+class SimBus(can.BusABC):
+    """A python-can bus on a :class:`SimNetwork`; bitrates and ``fd`` are accepted and ignored."""
+
+    def __init__(
+        self,
+        channel: str = "sim0",
+        network: Optional[SimNetwork] = None,
+        receive_own_messages: bool = False,
+        **kwargs: Any,
+    ):
+        self.network = network or SimNetwork.get(str(channel))
+        self.channel_info = f"sim {self.network.channel}"
+        self.receive_own_messages = receive_own_messages
+        self._queue: Deque[can.Message] = collections.deque()
+        self._reader = False   # has called recv: settle() waits for it
+        self._waiting = False  # blocked in recv with nothing queued
+        self._closed = False
+        kwargs.pop("bitrate", None)
+        kwargs.pop("data_bitrate", None)
+        kwargs.pop("fd", None)
+        super().__init__(channel=channel, **kwargs)
+        self.network._attach(self)
+
+    def _idle(self) -> bool:
+        return not self._reader or (self._waiting and not self._queue)
+
+    def _recv_internal(self, timeout: Optional[float]) -> Tuple[Optional[can.Message], bool]:
+        cond = self.network._cond
+        with cond:
+            self._reader = True
+            deadline = None if timeout is None else time.monotonic() + timeout
+            while not self._queue and not self._closed:
+                left = None if deadline is None else deadline - time.monotonic()
+                if left is not None and left <= 0:
+                    return None, False
+                if not self._waiting:
+                    self._waiting = True
+                    cond.notify_all()  # settle() may be waiting for this reader
+                cond.wait(left)
+            self._waiting = False
+            if not self._queue:
+                return None, False
+            return self._queue.popleft(), False
+
+    def send(self, msg: can.Message, timeout: Optional[float] = None) -> None:
+        if self._closed:
+            raise can.CanOperationError("SimBus is shut down")
+        self.network.send(msg, sender=self)
+
+    def shutdown(self) -> None:
+        if self._closed:
+            return
+        self._closed = True
+        self.network._detach(self)
+        super().shutdown()
+
+
+__all__ = ["SimBus", "SimNetwork", "VirtualClock"]
@@ -0,0 +1,239 @@
+"""Socket receive buffer and interface TX queue sized from the bus's load plan.
+
+A SocketCAN socket starts with the system's default receive buffer
+(``net.core.rmem_default``, a few hundred frames) and a CAN interface with a
+``txqueuelen`` of 10. A burst, or the RX thread held off the CPU for a few
+tens of milliseconds, overruns them: the kernel drops received frames well
+before Python is saturated, and ``send`` fails with ENOBUFS. A bus with
+``socket_buffers`` sizes both from the traffic its bindings declare (the
+:func:`td_can_bridges.bus_load.plan_bus` plan that admission control checks)::
+
+    socket_buffers:
+      stall_ms: 100     # default: the longest gap the buffers ride out
+      headroom: 2.0     # default: bursts above the declared rates
+      rcvbuf: 1048576   # bytes, instead of the planned size
+      txqueuelen: 500   # frames, instead of the planned length; 0 leaves the interface alone
+
+``true`` takes the defaults. The receive buffer holds the declared RX
+frames (RX bindings, motor reports, topology replies) of ``stall_ms`` times
+``headroom``, each charged as the kernel charges a frame against the
+buffer. The TX queue holds the declared TX frames of the same time. Both
+are only ever raised from what they already are.
+
+They are applied whenever the bus opens its socket. The receive buffer is
+set with ``SO_RCVBUFFORCE``, which is not capped by ``net.core.rmem_max``
+but needs ``CAP_NET_ADMIN``, and falls back to ``SO_RCVBUF`` within the
+cap. ``txqueuelen`` is set over rtnetlink and also needs
+``CAP_NET_ADMIN``. What the kernel actually granted is logged when it is
+less than the plan. The bus counts the kernel's drops (``SO_RXQ_OVFL``);
+when some turn up despite the plan, it logs them with the sizes they
+overran, since the declared rates or ``stall_ms`` are then too low.
+"""
+
+from __future__ import annotations
+
+import errno
+import logging
+import math
+import socket
+import struct
+import time
+from dataclasses import dataclass
+from pathlib import Path
+from typing import Any, Dict, Mapping, Optional
+
+from .netlink import Netlink, attr
+
+LOG = logging.getLogger(__name__)
+
+_KEYS = ("stall_ms", "headroom", "rcvbuf", "txqueuelen")
+
+SO_RCVBUFFORCE = getattr(socket, "SO_RCVBUFFORCE", 33)
+RTM_SETLINK = 19
+IFLA_TXQLEN = 13
+_IFINFOMSG = struct.Struct("=BxHiII")
+
+# What the kernel charges a received CAN frame against the receive buffer (the skb's truesize),
+# rounded up from classic and FD frames on 64-bit kernels
+FRAME_BYTES = 1024
+RCVBUF_MAX = 64 << 20
+TXQUEUELEN_MAX = 10000
+WARN_EVERY_S = 10.0
+
+
+@dataclass(frozen=True)
+class SocketBufferConfig:
+    """``socket_buffers`` of a bus."""
+
+    stall_ms: float = 100.0              # the buffers hold the declared frames of this long
+    headroom: float = 2.0                # times the declared rates, for bursts
+    rcvbuf: Optional[int] = None         # bytes; None: from the plan
+    txqueuelen: Optional[int] = None     # frames; None: from the plan, 0: left alone
+
+
+def socket_buffers_entry(value: Any, context: str) -> Optional[SocketBufferConfig]:
+    """``socket_buffers``: true for the defaults, or a mapping of :class:`SocketBufferConfig` fields."""
+
+    if value is None or value is False:
+        return None
+    if value is True:
+        return SocketBufferConfig()
+    if not isinstance(value, Mapping):
+        raise ValueError(f"{context}.socket_buffers must be true or a mapping, got {value!r}")
+    unknown = set(value) - set(_KEYS)
+    if unknown:
+        raise ValueError(f"{context}.socket_buffers has unknown keys {sorted(unknown)}")
+    rcvbuf, txqueuelen = value.get("rcvbuf"), value.get("txqueuelen")
+    cfg = SocketBufferConfig(
+        stall_ms=float(value.get("stall_ms", 100.0)),
+        headroom=float(value.get("headroom", 2.0)),
+        rcvbuf=None if rcvbuf is None else int(rcvbuf),
+        txqueuelen=None if txqueuelen is None else int(txqueuelen),
+    )
+    if cfg.stall_ms <= 0 or cfg.headroom < 1:
+        raise ValueError(f"{context}.socket_buffers needs stall_ms > 0 and headroom >= 1")
+    if (cfg.rcvbuf is not None and cfg.rcvbuf <= 0) or (cfg.txqueuelen is not None and cfg.txqueuelen < 0):
+        raise ValueError(f"{context}.socket_buffers needs rcvbuf > 0 and txqueuelen >= 0")
+    return cfg
+
+
+@dataclass(frozen=True)
+class SocketBufferPlan:
+    rx_hz: float           # declared frames per second into the socket
+    tx_hz: float           # ... and out of it
+    rcvbuf: int            # bytes of kernel accounting, as SO_RCVBUF reads back; 0: left alone
+    txqueuelen: int        # frames; 0: left alone
+
+
+def plan_socket_buffers(plan, cfg: SocketBufferConfig) -> SocketBufferPlan:
+    """Sizes for the declared traffic of ``plan`` (a :class:`~td_can_bridges.bus_load.BusLoadPlan`).
+
+    A topology's entry is a command and a reply per motor, counted whole on
+    both sides.
+    """
+
+    rx_hz = sum(rate for what, rate, _ in plan.entries if what.startswith(("RX ", "TX/RX ")))
+    tx_hz = sum(rate for what, rate, _ in plan.entries if what.startswith(("TX ", "TX/RX ")))
+    span = cfg.stall_ms / 1000.0 * cfg.headroom
+    rcvbuf = cfg.rcvbuf if cfg.rcvbuf is not None else math.ceil(rx_hz * span) * FRAME_BYTES
+    txqueuelen = cfg.txqueuelen if cfg.txqueuelen is not None else math.ceil(tx_hz * span)
+    return SocketBufferPlan(rx_hz, tx_hz, min(rcvbuf, RCVBUF_MAX), min(txqueuelen, TXQUEUELEN_MAX))
+
+
+def set_rcvbuf(sock: socket.socket, size: int) -> int:
+    """Raises the socket's receive buffer to ``size`` bytes of kernel accounting; what it has after.
+
+    The kernel doubles the value set for its bookkeeping and reads back the
+    doubled one, so ``size`` is what getsockopt reports.
+    """
+
+    current = sock.getsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF)
+    if size <= current:
+        return current
+    try:
+        sock.setsockopt(socket.SOL_SOCKET, SO_RCVBUFFORCE, (size + 1) // 2)
+    except OSError as exc:
+        if exc.errno != errno.EPERM:
+            raise
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, (size + 1) // 2)  # capped by rmem_max
+    return sock.getsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF)
+
+
+def txqueuelen(interface: str) -> Optional[int]:
+    """The interface's TX queue length from sysfs; None if unreadable."""
+
+    try:
+        return int((Path("/sys/class/net") / interface / "tx_queue_len").read_text())
+    except (OSError, ValueError):
+        return None
+
+
+def set_txqueuelen(interface: str, frames: int) -> None:
+    """``ip link set <interface> txqueuelen <frames>`` over rtnetlink; raises OSError (EPERM without CAP_NET_ADMIN)."""
+
+    netlink = Netlink()
+    try:
+        body = _IFINFOMSG.pack(socket.AF_UNSPEC, 0, socket.if_nametoindex(interface), 0, 0)
+        netlink.request(RTM_SETLINK, 0, body + attr(IFLA_TXQLEN, struct.pack("=I", frames)))
+    finally:
+        netlink.close()
+
+
+class SocketBufferTuner:
+    """Applies a bus's :class:`SocketBufferPlan` to each socket it opens and checks it against the drops."""
+
+    def __init__(self, name: str, interface: str, plan: SocketBufferPlan, cfg: SocketBufferConfig):
+        self.name = name
+        self.interface = interface
+        self.plan = plan
+        self.cfg = cfg
+        self.rcvbuf: Optional[int] = None      # as the kernel granted, on the current socket
+        self.txqueuelen: Optional[int] = None  # the interface's, after the last apply
+        self.dropped = 0                       # SO_RXQ_OVFL frames seen over every socket
+        self._last = 0                         # count of the current socket at the last check
+        self._unreported = 0                   # drops since the last warning
+        self._warned = -WARN_EVERY_S
+        if not plan.rx_hz and cfg.rcvbuf is None:
+            LOG.info("[%s] socket_buffers: no RX rates declared; the receive buffer stays as it is", name)
+
+    def apply(self, sock: socket.socket) -> None:
+        """Sizes the new socket, and the interface's queue; called on every (re)open."""
+
+        self._last = 0
+        if self.plan.rcvbuf:
+            try:
+                self.rcvbuf = set_rcvbuf(sock, self.plan.rcvbuf)
+            except OSError as exc:
+                LOG.warning("[%s] cannot set the receive buffer: %s", self.name, exc)
+            else:
+                if self.rcvbuf < self.plan.rcvbuf:
+                    LOG.warning("[%s] receive buffer %d bytes, %d planned: net.core.rmem_max caps it "
+                                "without CAP_NET_ADMIN", self.name, self.rcvbuf, self.plan.rcvbuf)
+        if self.plan.txqueuelen:
+            current = txqueuelen(self.interface)
+            if current is not None and current < self.plan.txqueuelen:
+                try:
+                    set_txqueuelen(self.interface, self.plan.txqueuelen)
+                    current = self.plan.txqueuelen
+                except OSError as exc:
+                    LOG.warning("[%s] cannot raise txqueuelen of %s from %d to %d: %s",
+                                self.name, self.interface, current, self.plan.txqueuelen, exc)
+            self.txqueuelen = current
+        LOG.info("[%s] socket buffers for %g RX / %g TX frames/s: rcvbuf %s bytes, txqueuelen %s",
+                 self.name, self.plan.rx_hz, self.plan.tx_hz, self.rcvbuf, self.txqueuelen)
+
+    def verify(self, count: int) -> int:
+        """Takes the socket's ``SO_RXQ_OVFL`` count; logs drops new since the last check, returns them."""
+
+        new = count - self._last if count >= self._last else count  # lower: a new socket
+        self._last = count
+        self.dropped += new
+        self._unreported += new
+        now = time.monotonic()
+        if self._unreported and now - self._warned >= WARN_EVERY_S:
+            LOG.warning("[%s] kernel dropped %d frame(s) on a full receive buffer (%s bytes, planned for %g "
+                        "frames/s over %g ms x %g): declare the RX rates or raise socket_buffers.stall_ms",
+                        self.name, self._unreported, self.rcvbuf, self.plan.rx_hz, self.cfg.stall_ms,
+                        self.cfg.headroom)
+            self._unreported = 0
+            self._warned = now
+        return new
+
+    def stats(self) -> Dict[str, Any]:
+        """The plan, what was granted and the drops seen."""
+
+        return {
+            "rx_hz": self.plan.rx_hz,
+            "tx_hz": self.plan.tx_hz,
+            "rcvbuf_planned": self.plan.rcvbuf,
+            "rcvbuf": self.rcvbuf,
+            "txqueuelen_planned": self.plan.txqueuelen,
+            "txqueuelen": self.txqueuelen,
+            "dropped": self.dropped,
+        }
+
+
+__all__ = [
+    "SocketBufferConfig", "SocketBufferPlan", "SocketBufferTuner", "plan_socket_buffers", "set_rcvbuf",
+    "set_txqueuelen", "socket_buffers_entry", "txqueuelen",
+]
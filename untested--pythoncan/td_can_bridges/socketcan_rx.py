@@ -0,0 +1,361 @@
+"""Batched reads from a raw SocketCAN socket.
+
+``recvmmsg(2)`` returns every frame already queued on the socket in one
+system call, where ``socket.recv`` costs one call (and one trip through the
+interpreter) per frame. The standard library does not wrap it, so it is
+called through ctypes; without it (non-Linux libc) each wakeup falls back to
+draining the socket one ``recvmsg_into`` at a time.
+
+Each frame carries the kernel's receive timestamp from the ancillary data
+(``SO_TIMESTAMPNS``, or the adapter's clock with ``SO_TIMESTAMPING`` once
+:func:`enable_timestamps` asked for hardware stamps). With
+:func:`enable_overflow_count` the kernel also reports how many frames it
+dropped on a full socket buffer (:attr:`BatchReceiver.dropped`).
+"""
+
+from __future__ import annotations
+
+import ctypes
+import ctypes.util
+import errno
+import os
+import select
+import socket
+import struct
+import time
+from typing import Any, Dict, Iterable, List, Optional, Tuple
+
+CAN_EFF_FLAG = 0x80000000
+CAN_RTR_FLAG = 0x40000000
+CAN_ERR_FLAG = 0x20000000
+CAN_EFF_MASK = 0x1FFFFFFF
+CAN_SFF_MASK = 0x000007FF
+
+# struct can_frame and struct canfd_frame share the first 8 bytes: can_id,
+# len, then three flag/padding bytes; the payload starts at byte 8
+CAN_MTU = 16
+CANFD_MTU = 72
+CANFD_BRS = 0x01  # canfd_frame.flags: bit rate switch
+CANFD_ESI = 0x02  # canfd_frame.flags: error state indicator
+_HEAD = struct.Struct("=IB")
+_DATA_OFFSET = 8
+
+MSG_DONTWAIT = getattr(socket, "MSG_DONTWAIT", 0x40)
+
+# asm-generic/socket.h, linux/net_tstamp.h; SCM_* equal the SO_* values
+SO_TIMESTAMPNS = 35
+SO_TIMESTAMPING = 37
+SO_RXQ_OVFL = 40
+SOF_TIMESTAMPING_RX_HARDWARE = 1 << 2
+SOF_TIMESTAMPING_RX_SOFTWARE = 1 << 3
+SOF_TIMESTAMPING_SOFTWARE = 1 << 4
+SOF_TIMESTAMPING_RAW_HARDWARE = 1 << 6
+
+# Room for an SCM_TIMESTAMPNS, an SCM_TIMESTAMPING and an SO_RXQ_OVFL message per frame
+_CONTROL_LEN = 128
+_CMSG_HDR = struct.Struct("@Nii")  # struct cmsghdr: cmsg_len, cmsg_level, cmsg_type
+_CMSG_ALIGN = ctypes.sizeof(ctypes.c_size_t)
+_TIMESPEC = struct.Struct("@ll")
+_U32 = struct.Struct("=I")
+
+
+class _IoVec(ctypes.Structure):
+    _fields_ = [("iov_base", ctypes.c_void_p), ("iov_len", ctypes.c_size_t)]
+
+
+class _MsgHdr(ctypes.Structure):
+    _fields_ = [
+        ("msg_name", ctypes.c_void_p),
+        ("msg_namelen", ctypes.c_uint32),
+        ("msg_iov", ctypes.POINTER(_IoVec)),
+        ("msg_iovlen", ctypes.c_size_t),
+        ("msg_control", ctypes.c_void_p),
+        ("msg_controllen", ctypes.c_size_t),
+        ("msg_flags", ctypes.c_int),
+    ]
+
+
+class _MMsgHdr(ctypes.Structure):
+    _fields_ = [("msg_hdr", _MsgHdr), ("msg_len", ctypes.c_uint)]
+
+
+def _load_recvmmsg():
+    try:
+        libc = ctypes.CDLL(ctypes.util.find_library("c") or None, use_errno=True)
+        fn = libc.recvmmsg
+    except (OSError, AttributeError):
+        return None
+    fn.argtypes = [ctypes.c_int, ctypes.POINTER(_MMsgHdr), ctypes.c_uint, ctypes.c_int, ctypes.c_void_p]
+    fn.restype = ctypes.c_int
+    return fn
+
+
+_recvmmsg = _load_recvmmsg()
+
+Frame = Tuple[int, bytes, float]
+
+
+def enable_timestamps(sock: socket.socket, hardware: bool = False) -> bool:
+    """Ask the kernel to stamp every received frame; True if hardware stamps were enabled.
+
+    ``SO_TIMESTAMPNS`` (system clock, set when the frame entered the stack)
+    is always on; python-can enables it on its sockets too. ``hardware`` adds
+    ``SO_TIMESTAMPING`` for adapters that stamp frames themselves. Those
+    stamps are in the adapter's clock, and python-can's own ``bus.recv``
+    rejects the extra control message, so only the direct and native receive
+    loops may use it.
+    """
+
+    sock.setsockopt(socket.SOL_SOCKET, SO_TIMESTAMPNS, 1)
+    if not hardware:
+        return False
+    flags = (SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE
+             | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE)
+    try:
+        sock.setsockopt(socket.SOL_SOCKET, SO_TIMESTAMPING, flags)
+    except OSError:
+        return False
+    return True
+
+
+def enable_overflow_count(sock: socket.socket) -> None:
+    """Attach the socket's drop counter (``SO_RXQ_OVFL``) to every received frame.
+
+    Like hardware timestamps this adds a control message python-can's own
+    ``bus.recv`` does not expect, so only the direct and native loops use it.
+    """
+
+    sock.setsockopt(socket.SOL_SOCKET, SO_RXQ_OVFL, 1)
+
+
+def _stamp(level: int, kind: int, data, offset: int = 0) -> float:
+    """Seconds from one SCM_TIMESTAMPNS/SCM_TIMESTAMPING payload; 0.0 when it holds none."""
+
+    if level != socket.SOL_SOCKET:
+        return 0.0
+    if kind == SO_TIMESTAMPING:
+        # struct scm_timestamping: software, deprecated, raw hardware
+        sec, nsec = _TIMESPEC.unpack_from(data, offset + 2 * _TIMESPEC.size)
+        if not sec and not nsec:
+            sec, nsec = _TIMESPEC.unpack_from(data, offset)
+    elif kind == SO_TIMESTAMPNS:
+        sec, nsec = _TIMESPEC.unpack_from(data, offset)
+    else:
+        return 0.0
+    return sec + nsec * 1e-9
+
+
+class BatchReceiver:
+    """Read frames from a bound CAN_RAW socket, many per wakeup.
+
+    :meth:`recv` waits up to ``timeout`` seconds for the socket to become
+    readable, then returns every queued frame (up to ``batch``) as
+    ``(arbitration_id, data, timestamp)`` tuples. Error and remote frames are
+    skipped and the extended flag is stripped, matching
+    ``can.Message.arbitration_id``. ``timestamp`` is the kernel's receive time
+    in seconds (hardware time when the adapter provides it), or the time of
+    the read when the socket has no timestamping enabled.
+    :meth:`wake` makes a blocked :meth:`recv` return early so shutdown does
+    not wait for the timeout. :attr:`dropped` is the last ``SO_RXQ_OVFL``
+    count seen, the frames the kernel dropped since the socket was opened.
+    With :attr:`ring` set (a :class:`~td_can_bridges.recorder.FrameRing`)
+    every frame read, error and remote frames included, is also pushed to it
+    as raw bytes for the recorder. :attr:`on_error`, when set, is called
+    with ``(error class, data, timestamp)`` for each error frame.
+    """
+
+    def __init__(self, sock: socket.socket, batch: int = 64):
+        self._sock = sock
+        self._fd = sock.fileno()
+        self._batch = batch
+        self._buf = ctypes.create_string_buffer(batch * CANFD_MTU)
+        self._view = memoryview(self._buf).cast("B")
+        self._control = ctypes.create_string_buffer(batch * _CONTROL_LEN)
+        self._used = batch  # slots whose msg_controllen the last recvmmsg overwrote
+        self.dropped = 0
+        self.ring = None
+        self.on_error = None
+        self._wake_r, self._wake_w = os.pipe()
+        os.set_blocking(self._wake_r, False)
+
+        base = ctypes.addressof(self._buf)
+        control = ctypes.addressof(self._control)
+        self._iov = (_IoVec * batch)()
+        self._hdrs = (_MMsgHdr * batch)()
+        for i in range(batch):
+            self._iov[i].iov_base = base + i * CANFD_MTU
+            self._iov[i].iov_len = CANFD_MTU
+            self._hdrs[i].msg_hdr.msg_iov = ctypes.pointer(self._iov[i])
+            self._hdrs[i].msg_hdr.msg_iovlen = 1
+            self._hdrs[i].msg_hdr.msg_control = control + i * _CONTROL_LEN
+
+    @property
+    def batched(self) -> bool:
+        return _recvmmsg is not None
+
+    def recv(self, timeout: Optional[float]) -> List[Frame]:
+        readable, _, _ = select.select([self._fd, self._wake_r], [], [], timeout)
+        if self._wake_r in readable:
+            try:
+                os.read(self._wake_r, 64)
+            except BlockingIOError:
+                pass
+        if self._fd not in readable:
+            return []
+        return self.read()
+
+    def read(self) -> List[Frame]:
+        """The frames already queued (up to ``batch``), without waiting; for an event loop's reader."""
+
+        if _recvmmsg is not None:
+            return self._recv_batch()
+        return self._recv_each()
+
+    def wake(self) -> None:
+        try:
+            os.write(self._wake_w, b"\0")
+        except OSError:
+            pass  # already closed by the RX thread
+
+    def close(self) -> None:
+        os.close(self._wake_r)
+        os.close(self._wake_w)
+
+    def _recv_batch(self) -> List[Frame]:
+        for i in range(self._used):
+            self._hdrs[i].msg_hdr.msg_controllen = _CONTROL_LEN
+        count = _recvmmsg(self._fd, self._hdrs, self._batch, MSG_DONTWAIT, None)
+        if count < 0:
+            self._used = 0
+            err = ctypes.get_errno()
+            if err in (errno.EAGAIN, errno.EINTR):
+                return []
+            raise OSError(err, os.strerror(err))
+        self._used = count
+        now = 0.0
+        frames: List[Frame] = []
+        for i in range(count):
+            stamp = self._control_stamp(i * _CONTROL_LEN, self._hdrs[i].msg_hdr.msg_controllen)
+            if not stamp:
+                stamp = now = now or time.time()
+            frame = self._parse(i * CANFD_MTU, self._hdrs[i].msg_len, stamp)
+            if frame is not None:
+                frames.append(frame)
+        return frames
+
+    def _recv_each(self) -> List[Frame]:
+        frames: List[Frame] = []
+        for _ in range(self._batch):
+            try:
+                size, ancillary, _, _ = self._sock.recvmsg_into(
+                    [self._view[:CANFD_MTU]], _CONTROL_LEN, MSG_DONTWAIT
+                )
+            except (BlockingIOError, InterruptedError):
+                break
+            stamp = 0.0
+            for level, kind, data in ancillary:
+                if kind == SO_RXQ_OVFL and level == socket.SOL_SOCKET:
+                    self.dropped = _U32.unpack_from(data)[0]
+                    continue
+                stamp = _stamp(level, kind, data) or stamp
+            frame = self._parse(0, size, stamp or time.time())
+            if frame is not None:
+                frames.append(frame)
+        return frames
+
+    def _control_stamp(self, offset: int, length: int) -> float:
+        """Walk the control messages of one slot, preferring SCM_TIMESTAMPING."""
+
+        stamp, end = 0.0, offset + length
+        while offset + _CMSG_HDR.size <= end:
+            cmsg_len, level, kind = _CMSG_HDR.unpack_from(self._control, offset)
+            if cmsg_len < _CMSG_HDR.size:
+                break
+            if kind == SO_RXQ_OVFL and level == socket.SOL_SOCKET:
+                self.dropped = _U32.unpack_from(self._control, offset + _CMSG_HDR.size)[0]
+            value = _stamp(level, kind, self._control, offset + _CMSG_HDR.size)
+            if value and (kind == SO_TIMESTAMPING or not stamp):
+                stamp = value
+            offset += (cmsg_len + _CMSG_ALIGN - 1) & ~(_CMSG_ALIGN - 1)
+        return stamp
+
+    def _parse(self, offset: int, size: int, stamp: float) -> Optional[Frame]:
+        if size != CAN_MTU and size != CANFD_MTU:
+            return None
+        if self.ring is not None:
+            self.ring.push(stamp, bytes(self._view[offset:offset + size]))
+        can_id, length = _HEAD.unpack_from(self._buf, offset)
+        if can_id & (CAN_ERR_FLAG | CAN_RTR_FLAG):
+            if can_id & CAN_ERR_FLAG and self.on_error is not None:
+                start = offset + _DATA_OFFSET
+                self.on_error(can_id & CAN_EFF_MASK, bytes(self._view[start:start + length]), stamp)
+            return None
+        can_id &= CAN_EFF_MASK if can_id & CAN_EFF_FLAG else CAN_SFF_MASK
+        start = offset + _DATA_OFFSET
+        return can_id, bytes(self._view[start:start + length]), stamp
+
+
+
+# CAN_RAW_FILTER_MAX in linux/can/raw.h
+CAN_RAW_FILTER_MAX = 512
+
+
+def _exact_cover(ids: Iterable[int], width: int) -> List[Tuple[int, int]]:
+    """Fewest (id, mask) pairs matching exactly ``ids`` among ``width``-bit IDs.
+
+    Quine-McCluskey: terms that differ in one cared-for bit merge into one
+    term that ignores it, until nothing merges; the resulting prime terms
+    never match an ID outside the set. A greedy cover then picks among them.
+    """
+
+    wanted = set(ids)
+    terms = {(i, (1 << width) - 1) for i in wanted}
+    primes = set()
+    while terms:
+        by_mask: Dict[int, set] = {}
+        for value, mask in terms:
+            by_mask.setdefault(mask, set()).add(value)
+        merged, used = set(), set()
+        for mask, values in by_mask.items():
+            for value in values:
+                for b in range(width):
+                    bit = 1 << b
+                    if mask & bit and not value & bit and value | bit in values:
+                        merged.add((value, mask & ~bit))
+                        used.add((value, mask))
+                        used.add((value | bit, mask))
+        primes |= terms - used
+        terms = merged
+
+    cover = []
+    while wanted:
+        best = max(primes, key=lambda t: sum(1 for i in wanted if i & t[1] == t[0]))
+        cover.append(best)
+        wanted = {i for i in wanted if i & best[1] != best[0]}
+    return sorted(cover)
+
+
+def build_can_filters(
+    standard: Iterable[int],
+    extended: Iterable[int],
+    masked: Iterable[Tuple[int, int, bool]] = (),
+) -> Optional[List[Dict[str, Any]]]:
+    """python-can ``set_filters`` entries that pass exactly the given IDs.
+
+    ``masked`` adds ``(can_id, mask, extended)`` entries as they are. Returns
+    None (accept everything) when the set would need more than
+    CAN_RAW_FILTER_MAX entries.
+    """
+
+    filters = [
+        {"can_id": can_id, "can_mask": mask, "extended": is_ext}
+        for ids, width, is_ext in ((standard, 11, False), (extended, 29, True))
+        for can_id, mask in _exact_cover(ids, width)
+    ]
+    filters += [{"can_id": can_id, "can_mask": mask, "extended": is_ext} for can_id, mask, is_ext in masked]
+    if len(filters) > CAN_RAW_FILTER_MAX:
+        return None
+    return filters
+
+
+__all__ = ["BatchReceiver", "build_can_filters", "enable_overflow_count", "enable_timestamps"]
@@ -0,0 +1,77 @@
+"""Batched writes to a raw SocketCAN socket.
+
+:class:`BatchSender` owns one buffer of ``struct can_frame`` slots that
+callers fill in place (``FrameEncoder.write``) and sends the filled slots
+with one ``sendmmsg(2)`` call, the transmit twin of
+:class:`td_can_bridges.socketcan_rx.BatchReceiver`. Without ``sendmmsg`` in
+libc the slots go out one ``send`` at a time.
+"""
+
+from __future__ import annotations
+
+import ctypes
+import ctypes.util
+import errno
+import os
+import socket
+
+from .socketcan_rx import CAN_MTU, _IoVec, _MMsgHdr
+
+
+def _load_sendmmsg():
+    try:
+        libc = ctypes.CDLL(ctypes.util.find_library("c") or None, use_errno=True)
+        fn = libc.sendmmsg
+    except (OSError, AttributeError):
+        return None
+    fn.argtypes = [ctypes.c_int, ctypes.POINTER(_MMsgHdr), ctypes.c_uint, ctypes.c_int]
+    fn.restype = ctypes.c_int
+    return fn
+
+
+_sendmmsg = _load_sendmmsg()
+
+
+class BatchSender:
+    """``capacity`` classic CAN frame slots sent together.
+
+    Fill slot ``i`` at byte offset ``i * CAN_MTU`` of :attr:`buffer`, then
+    call :meth:`send` with the number of slots used. Not thread-safe; the
+    service serialises callers.
+    """
+
+    def __init__(self, sock: socket.socket, capacity: int = 64):
+        self._sock = sock
+        self._fd = sock.fileno()
+        self.capacity = capacity
+        self._buf = ctypes.create_string_buffer(capacity * CAN_MTU)
+        self.buffer = memoryview(self._buf).cast("B")
+
+        base = ctypes.addressof(self._buf)
+        self._iov = (_IoVec * capacity)()
+        self._hdrs = (_MMsgHdr * capacity)()
+        for i in range(capacity):
+            self._iov[i].iov_base = base + i * CAN_MTU
+            self._iov[i].iov_len = CAN_MTU
+            self._hdrs[i].msg_hdr.msg_iov = ctypes.pointer(self._iov[i])
+            self._hdrs[i].msg_hdr.msg_iovlen = 1
+
+    def send(self, count: int) -> None:
+        """Send slots 0..count-1 in order; raises OSError if the socket refuses one."""
+
+        if _sendmmsg is None:
+            for i in range(count):
+                self._sock.send(self.buffer[i * CAN_MTU:(i + 1) * CAN_MTU])
+            return
+        sent = 0
+        while sent < count:
+            n = _sendmmsg(self._fd, ctypes.byref(self._hdrs[sent]), count - sent, 0)
+            if n < 0:
+                err = ctypes.get_errno()
+                if err == errno.EINTR:
+                    continue
+                raise OSError(err, f"sendmmsg after {sent} of {count} frames: {os.strerror(err)}")
+            sent += n
+
+
+__all__ = ["BatchSender"]
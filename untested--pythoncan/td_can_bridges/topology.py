@@ -0,0 +1,227 @@
+"""A RoboStride motor fleet spread over several adapters, planned from the config.
+
+A motor commanded at 1 kHz takes 320 kbit/s worst case, so a 1 Mbit/s bus
+at the default 80% load limit carries two. A top-level ``topology`` section
+names the adapters and the motor groups, and the loader places the groups
+on the adapters and writes one bus per adapter::
+
+    topology:
+      legs:
+        dbc_file: ../td_can_bridges/schemas/motors.dbc   # and any other bus key, for every bus
+        bitrate: 1000000
+        rate_hz: 500                   # commands per motor per second
+        adapters: [can0, can1, {interface: can2, rx_mode: native}]
+        groups:
+          left_leg:  {model: RS03, kp: 40, kd: 1.5, joints: {1: l_hip, 2: l_thigh, 3: l_knee}}
+          right_leg: {model: RS03, kp: 40, kd: 1.5, joints: {1: r_hip, 2: r_thigh, 3: r_knee}}
+          arms:      {joints: {4: l_shoulder, 5: r_shoulder}}
+          waist:     {joints: {7: waist}, adapter: can2}     # pinned
+        joint_states: /legs/joint_states      # default /td/<topology>/joint_states
+        commands: /legs/joint_commands        # default /td/<topology>/joint_commands
+
+A group is a set of motors wired to one bus, so it is never split. Each
+cycle a motor costs a type 1 command and its type 2 reply, 2 x 160 bits
+worst case (:func:`td_can_bridges.bus_load.frame_bits`). :func:`plan_groups`
+places the largest group first, on the adapter left least loaded as a
+fraction of its bitrate. An adapter that already carries one of the group's
+motor IDs, or would pass its ``bus_load.limit`` (default 0.8), is skipped.
+A group that fits nowhere fails the load. The buses are named
+``<topology>_<interface>`` and carry their share as ``BusConfig.topology``,
+so the bus load check counts it.
+
+The joints form one namespace in declaration order, whatever bus they
+landed on. :class:`td_can_bridges.fleet.MotorFleet` runs it in the bridge:
+one thread commands every bus in the same cycle, and one JointState holds
+that cycle's replies.
+"""
+
+from __future__ import annotations
+
+from dataclasses import dataclass
+from typing import Any, Dict, List, Mapping, Optional, Sequence, Tuple
+
+from .bus_load import frame_bits
+
+DEFAULT_RATE_HZ = 1000.0
+DEFAULT_LOAD_LIMIT = 0.8
+DEFAULT_BITRATE = 500_000      # as a bus entry's
+FRAME_BITS = frame_bits(8, True)  # a type 1 command or type 2 reply, worst case
+MODELS = ("RS02", "RS03", "RS04")
+
+# Keys of a topology that are not bus keys
+_TOPOLOGY_KEYS = {"adapters", "groups", "rate_hz", "host_id", "joint_states", "commands"}
+_GROUP_KEYS = {"joints", "model", "kp", "kd", "adapter"}
+
+
+def _int(value: Any) -> int:
+    return int(value, 0) if isinstance(value, str) else int(value)
+
+
+@dataclass(frozen=True)
+class BusShare:
+    """The motors of a topology one bus carries; ``BusConfig.topology``."""
+
+    topology: str
+    motors: Tuple[int, ...]
+    rate_hz: float
+
+    @property
+    def frames_per_s(self) -> float:
+        return 2.0 * len(self.motors) * self.rate_hz  # command and reply
+
+
+@dataclass(frozen=True)
+class FleetJoint:
+    name: str
+    bus: str
+    motor: int
+    model: str = "RS02"
+    kp: float = 0.0
+    kd: float = 0.0
+
+
+@dataclass(frozen=True)
+class TopologyConfig:
+    """One ``topology`` entry after planning; ``joints`` in declaration order."""
+
+    name: str
+    joints: Tuple[FleetJoint, ...]
+    buses: Tuple[str, ...]
+    loads: Mapping[str, float]          # bus -> projected load of its share, fraction of the bitrate
+    rate_hz: float = DEFAULT_RATE_HZ
+    host_id: int = 0xFD
+    state_topic: str = ""
+    command_topic: str = ""
+
+
+@dataclass(frozen=True)
+class _Adapter:
+    bus: str
+    interface: str
+    bitrate: int
+    limit: float
+    keys: Mapping[str, Any]
+
+
+@dataclass(frozen=True)
+class _Group:
+    name: str
+    joints: Tuple[FleetJoint, ...]   # bus left empty until placed
+    adapter: Optional[str]
+
+
+def group_bits(motors: int, rate_hz: float) -> float:
+    """Worst-case bits per second of ``motors`` commanded at ``rate_hz``, replies included."""
+
+    return 2.0 * motors * rate_hz * FRAME_BITS
+
+
+def plan_groups(groups: Sequence[_Group], adapters: Sequence[_Adapter], rate_hz: float,
+                context: str) -> Dict[str, str]:
+    """Group name -> bus: largest group first, onto the least loaded adapter it fits."""
+
+    load = {a.bus: 0.0 for a in adapters}
+    motors: Dict[str, set] = {a.bus: set() for a in adapters}
+    placed: Dict[str, str] = {}
+    by_interface = {a.interface: a for a in adapters}
+    # Pinned groups first, so the balancing sees their load
+    order = sorted(groups, key=lambda g: (g.adapter is None, -len(g.joints)))
+    for group in order:
+        ids = {j.motor for j in group.joints}
+        bits = group_bits(len(ids), rate_hz)
+        candidates = adapters
+        if group.adapter is not None:
+            if group.adapter not in by_interface:
+                raise ValueError(f"{context}.groups.{group.name}: adapter '{group.adapter}' "
+                                 f"is not one of {sorted(by_interface)}")
+            candidates = [by_interface[group.adapter]]
+        fits = [a for a in candidates
+                if not ids & motors[a.bus] and (load[a.bus] + bits) / a.bitrate <= a.limit]
+        if not fits:
+            state = ", ".join(f"{a.interface} {load[a.bus] / a.bitrate:.0%}" for a in candidates)
+            raise ValueError(f"{context}.groups.{group.name}: {len(ids)} motor(s) at {rate_hz:g} Hz need "
+                             f"{bits / 1e3:.0f} kbit/s worst case and fit on no adapter (loaded {state}; "
+                             f"a motor ID may also be taken there)")
+        best = min(fits, key=lambda a: ((load[a.bus] + bits) / a.bitrate, a.interface))
+        load[best.bus] += bits
+        motors[best.bus] |= ids
+        placed[group.name] = best.bus
+    return placed
+
+
+def expand_topology(name: str, spec: Any, context: str) -> Tuple[TopologyConfig, List[Tuple[Dict[str, Any], BusShare]]]:
+    """A ``topology`` entry's plan and bus entries, each with the share of the fleet it carries."""
+
+    if not isinstance(spec, Mapping):
+        raise ValueError(f"{context} must be a mapping with adapters and groups")
+    adapters_spec = spec.get("adapters") or []
+    groups_spec = spec.get("groups") or {}
+    if not adapters_spec or not isinstance(groups_spec, Mapping) or not groups_spec:
+        raise ValueError(f"{context} needs adapters: [<interface>, ...] and groups: {{<name>: {{joints: ...}}}}")
+    rate_hz = float(spec.get("rate_hz", DEFAULT_RATE_HZ))
+    if rate_hz <= 0:
+        raise ValueError(f"{context}.rate_hz must be positive, got {rate_hz:g}")
+    shared = {k: v for k, v in spec.items() if k not in _TOPOLOGY_KEYS}
+
+    adapters: List[_Adapter] = []
+    for i, entry in enumerate(adapters_spec):
+        keys = dict(shared)
+        keys.update({"interface": entry} if isinstance(entry, str) else dict(entry or {}))
+        if "interface" not in keys:
+            raise ValueError(f"{context}.adapters[{i}] needs an interface")
+        interface = str(keys["interface"])
+        if any(a.interface == interface for a in adapters):
+            raise ValueError(f"{context}.adapters[{i}]: {interface} is listed twice")
+        limit = float(dict(keys.get("bus_load") or {}).get("limit", DEFAULT_LOAD_LIMIT))
+        keys["name"] = str(keys.get("name", f"{name}_{interface}"))
+        adapters.append(_Adapter(keys["name"], interface, int(keys.get("bitrate", DEFAULT_BITRATE)), limit, keys))
+
+    groups: List[_Group] = []
+    names: Dict[str, str] = {}
+    for group, gspec in groups_spec.items():
+        where = f"{context}.groups.{group}"
+        if not isinstance(gspec, Mapping) or not isinstance(gspec.get("joints"), Mapping) or not gspec["joints"]:
+            raise ValueError(f"{where} must be a mapping with joints: {{<motor id>: <joint name>}}")
+        unknown = sorted(set(gspec) - _GROUP_KEYS)
+        if unknown:
+            raise ValueError(f"{where}: unknown key(s) {unknown}, expected {sorted(_GROUP_KEYS)}")
+        model = str(gspec.get("model", "RS02"))
+        if model not in MODELS:
+            raise ValueError(f"{where}.model must be one of {list(MODELS)}, got '{model}'")
+        joints = []
+        for motor, joint in gspec["joints"].items():
+            motor_id, joint = _int(motor), str(joint)
+            if not 0 < motor_id < 0x100:
+                raise ValueError(f"{where}: motor ID {motor_id} must be 1-255")
+            if joint in names:
+                raise ValueError(f"{where}: joint '{joint}' is also in group {names[joint]}")
+            names[joint] = str(group)
+            joints.append(FleetJoint(joint, "", motor_id, model, float(gspec.get("kp", 0.0)),
+                                     float(gspec.get("kd", 0.0))))
+        adapter = gspec.get("adapter")
+        groups.append(_Group(str(group), tuple(joints), str(adapter) if adapter is not None else None))
+
+    placed = plan_groups(groups, adapters, rate_hz, context)
+    by_group = {g.name: g for g in groups}
+    joints = tuple(FleetJoint(j.name, placed[g], j.motor, j.model, j.kp, j.kd)
+                   for g in by_group for j in by_group[g].joints)
+    entries: List[Tuple[Dict[str, Any], BusShare]] = []
+    loads: Dict[str, float] = {}
+    for adapter in adapters:
+        motors = tuple(j.motor for j in joints if j.bus == adapter.bus)
+        entries.append((dict(adapter.keys), BusShare(name, motors, rate_hz)))
+        loads[adapter.bus] = group_bits(len(motors), rate_hz) / adapter.bitrate
+    topology = TopologyConfig(
+        name=name,
+        joints=joints,
+        buses=tuple(a.bus for a in adapters),
+        loads=loads,
+        rate_hz=rate_hz,
+        host_id=_int(spec.get("host_id", 0xFD)) & 0xFF,
+        state_topic=str(spec.get("joint_states") or f"/td/{name}/joint_states"),
+        command_topic=str(spec.get("commands") or f"/td/{name}/joint_commands"),
+    )
+    return topology, entries
+
+
+__all__ = ["BusShare", "FleetJoint", "TopologyConfig", "expand_topology", "group_bits", "plan_groups"]
@@ -0,0 +1,296 @@
+"""RoboStride operation-control setpoints at a high rate from sparse, timestamped waypoints.
+
+A planner that emits waypoints at 50-100 Hz gives the motors a step every
+10-20 ms. :class:`TrajectoryStreamer` takes those waypoints per joint. It
+has a thread that evaluates a spline through them every ``1 / rate_hz``
+seconds and sends each motor one type 1 (operation control) frame. The
+frame carries the spline's position and velocity, the waypoints' torque
+feedforward interpolated linearly, and the joint's ``kp`` and ``kd``::
+
+    streamer = TrajectoryStreamer(service, {1: "RS02", 2: "RS02"}, rate_hz=1000, kp=40, kd=1.5)
+    streamer.start()
+    streamer.add(time.monotonic() + 0.01, {1: 0.30, 2: -0.12})   # every planner cycle
+
+* ``interpolation="cubic"`` joins the waypoints with cubic Hermite
+  segments; position and velocity are continuous. ``"quintic"`` uses
+  quintic Hermite segments, which also keeps acceleration continuous.
+* A waypoint may give its velocity (and, for quintic, acceleration).
+  Otherwise it gets the central difference of its neighbours, or the slope
+  from the previous waypoint while the next one is not known yet. A stream's
+  first waypoint starts from rest. A waypoint's estimate is fixed the first
+  time a segment uses it, so the next segment starts where the last one
+  ended.
+* Waypoint times are ``time.monotonic()`` seconds. The thread plays the
+  trajectory ``delay`` seconds behind the clock (default 20 ms, two 100 Hz
+  planner cycles), so the waypoint after the current one has usually
+  arrived.
+* Once a joint is past its last waypoint, it holds that position at zero
+  velocity, and each such cycle counts as ``starved``. The next waypoint
+  starts a new segment from the held position at the current time. Until a
+  joint gets its first waypoint, it is sent nothing.
+
+Frames go out through :meth:`CanBusService.send_raw` in ``tx_class`` (default
+``command``). A full TX queue drops that cycle's frame, and the next cycle
+sends a fresh one. Missed deadlines are skipped, not run back to back, as in
+``MotorTest/rt_loop.py``. ``priority`` runs the thread under ``SCHED_FIFO``,
+which needs ``CAP_SYS_NICE``. At 1 Mbit/s, a type 1 frame and the motor's
+reply take about 0.25 ms, so one bus carries four motors at 1 kHz.
+"""
+
+from __future__ import annotations
+
+import logging
+import os
+import struct
+import threading
+import time
+from collections import deque
+from typing import Any, Deque, Dict, Mapping, Optional, Tuple
+
+from .robostride_models import MODELS
+
+LOG = logging.getLogger(__name__)
+
+TYPE_OP_CONTROL = 1
+INTERPOLATIONS = ("cubic", "quintic")
+DEFAULT_RATE_HZ = 1000.0
+DEFAULT_DELAY = 0.02
+
+
+def _code(value: float, lo: float, hi: float) -> int:
+    u = (value - lo) * 65535.0 / (hi - lo)
+    return 0 if u <= 0.0 else 65535 if u >= 65535.0 else int(u)
+
+
+def op_control_frame(model: str, motor: int, pos: float, vel: float, torque: float, kp: float,
+                     kd: float) -> Tuple[int, bytes]:
+    """Type 1 frame: (29-bit ID with the torque in bits 8-23, payload of position, velocity, kp, kd)."""
+
+    p, v, t, k, d = MODELS[model][:5]
+    data = struct.pack(">4H", _code(pos, *p), _code(vel, *v), _code(kp, *k), _code(kd, *d))
+    return TYPE_OP_CONTROL << 24 | _code(torque, *t) << 8 | (motor & 0xFF), data
+
+
+class _Waypoint:
+    __slots__ = ("t", "pos", "vel", "acc", "torque")
+
+    def __init__(self, t, pos, vel, acc, torque):
+        self.t, self.pos, self.vel, self.acc, self.torque = t, pos, vel, acc, torque
+
+
+def _slope(a: _Waypoint, b: _Waypoint) -> float:
+    return (b.pos - a.pos) / (b.t - a.t)
+
+
+def _estimate(prev: Optional[_Waypoint], wp: _Waypoint, nxt: Optional[_Waypoint]) -> None:
+    """Fills in the velocity and acceleration the planner left out (once; see the module doc)."""
+
+    if wp.vel is None:
+        if prev is None:
+            wp.vel = 0.0
+        elif nxt is None:
+            wp.vel = _slope(prev, wp)
+        else:
+            wp.vel = (nxt.pos - prev.pos) / (nxt.t - prev.t)
+    if wp.acc is None:
+        if prev is None or nxt is None:
+            wp.acc = 0.0
+        else:
+            wp.acc = 2.0 * (_slope(wp, nxt) - _slope(prev, wp)) / (nxt.t - prev.t)
+
+
+def _coefficients(a: _Waypoint, b: _Waypoint, quintic: bool) -> Tuple[float, ...]:
+    """Polynomial in the time since ``a`` through both waypoints' position, velocity (and acceleration)."""
+
+    h = b.t - a.t
+    dp = b.pos - a.pos
+    if not quintic:
+        return (a.pos, a.vel, (3.0 * dp / h - 2.0 * a.vel - b.vel) / h, (-2.0 * dp / h + a.vel + b.vel) / (h * h))
+    h2 = h * h
+    c3 = (20.0 * dp - (8.0 * b.vel + 12.0 * a.vel) * h - (3.0 * a.acc - b.acc) * h2) / (2.0 * h2 * h)
+    c4 = (-30.0 * dp + (14.0 * b.vel + 16.0 * a.vel) * h + (3.0 * a.acc - 2.0 * b.acc) * h2) / (2.0 * h2 * h2)
+    c5 = (12.0 * dp - 6.0 * (b.vel + a.vel) * h - (a.acc - b.acc) * h2) / (2.0 * h2 * h2 * h)
+    return (a.pos, a.vel, a.acc / 2.0, c3, c4, c5)
+
+
+class _Joint:
+    __slots__ = ("motor", "model", "kp", "kd", "waypoints", "segment", "holding")
+
+    def __init__(self, motor: int, model: str, kp: float, kd: float):
+        self.motor = motor
+        self.model = model
+        self.kp = kp
+        self.kd = kd
+        self.waypoints: Deque[_Waypoint] = deque()
+        self.segment: Optional[Tuple[_Waypoint, _Waypoint, Tuple[float, ...]]] = None
+        self.holding = False  # past the last waypoint
+
+
+class TrajectoryStreamer:
+    """Interpolates per-joint waypoints and sends type 1 frames at ``rate_hz`` from its own thread."""
+
+    def __init__(
+        self,
+        service,
+        motors: Mapping[int, str],
+        rate_hz: float = DEFAULT_RATE_HZ,
+        kp: float = 0.0,
+        kd: float = 0.0,
+        interpolation: str = "cubic",
+        delay: float = DEFAULT_DELAY,
+        tx_class: str = "command",
+        priority: Optional[int] = None,
+    ):
+        if interpolation not in INTERPOLATIONS:
+            raise ValueError(f"unknown interpolation '{interpolation}', expected one of {INTERPOLATIONS}")
+        for motor, model in motors.items():
+            if model not in MODELS:
+                raise ValueError(f"motor {motor}: unknown model '{model}', expected one of {sorted(MODELS)}")
+        self.service = service
+        self.period_ns = int(round(1e9 / rate_hz))
+        self.quintic = interpolation == "quintic"
+        self.delay = delay
+        self.tx_class = tx_class
+        self.priority = priority
+        self._joints: Dict[int, _Joint] = {m: _Joint(m, model, kp, kd) for m, model in motors.items()}
+        self._lock = threading.Lock()
+        self._thread: Optional[threading.Thread] = None
+        self._running = False
+        self.cycles = 0
+        self.overruns = 0   # cycles that ended after the next deadline
+        self.skipped = 0    # deadlines dropped to get back in phase
+        self.starved = 0    # joint-cycles past the joint's last waypoint
+        self.dropped = 0    # frames the TX queue refused
+
+    def set_gains(self, motor: int, kp: float, kd: float) -> None:
+        with self._lock:
+            joint = self._joints[motor]
+            joint.kp, joint.kd = kp, kd
+
+    def add_waypoint(self, motor: int, t: float, pos: float, vel: Optional[float] = None,
+                     acc: Optional[float] = None, torque: float = 0.0) -> None:
+        """Appends a waypoint at ``time.monotonic()`` time ``t``; times must increase per joint."""
+
+        with self._lock:
+            self._append(self._joints[motor], t, pos, vel, acc, torque)
+
+    def add(self, t: float, positions: Mapping[int, float], velocities: Optional[Mapping[int, float]] = None,
+            torques: Optional[Mapping[int, float]] = None) -> None:
+        """One planner sample: a waypoint at ``t`` for every motor in ``positions``."""
+
+        velocities = velocities or {}
+        torques = torques or {}
+        with self._lock:
+            for motor, pos in positions.items():
+                self._append(self._joints[motor], t, pos, velocities.get(motor), None, torques.get(motor, 0.0))
+
+    def clear(self, motor: Optional[int] = None) -> None:
+        """Drops the waypoints of ``motor`` (every motor by default); it is sent nothing until the next one."""
+
+        with self._lock:
+            for joint in self._joints.values() if motor is None else (self._joints[motor],):
+                joint.waypoints.clear()
+                joint.segment = None
+                joint.holding = False
+
+    def _append(self, joint: _Joint, t: float, pos, vel, acc, torque) -> None:
+        wps = joint.waypoints
+        if wps and t <= wps[-1].t:
+            raise ValueError(f"motor {joint.motor}: waypoint at {t:.6f} s is not after the last one "
+                             f"({wps[-1].t:.6f} s)")
+        if joint.holding:
+            # Resumes from the held position now, not from the past time it was reached
+            held = wps[-1]
+            held.t = min(t - 1e-6, max(held.t, time.monotonic() - self.delay))
+            held.vel = held.acc = 0.0
+            joint.segment = None
+            joint.holding = False
+        wps.append(_Waypoint(t, float(pos), vel, acc, float(torque)))
+
+    def _setpoint(self, joint: _Joint, t: float) -> Optional[Tuple[float, float, float]]:
+        """(position, velocity, torque) at ``t``; None before the joint's first waypoint."""
+
+        wps = joint.waypoints
+        if not wps or t < wps[0].t:
+            return None
+        passed = None
+        while len(wps) >= 2 and wps[1].t <= t:
+            passed = wps.popleft()
+            joint.segment = None
+        if len(wps) == 1:
+            joint.holding = True
+            self.starved += 1
+            wp = wps[0]
+            return wp.pos, 0.0, wp.torque
+        a, b = wps[0], wps[1]
+        if joint.segment is None:
+            _estimate(passed, a, b)  # a waypoint no segment ended at yet: the first, or one skipped
+            _estimate(a, b, wps[2] if len(wps) > 2 else None)
+            joint.segment = (a, b, _coefficients(a, b, self.quintic))
+        coeffs = joint.segment[2]
+        tau = t - a.t
+        pos = vel = 0.0
+        for power in range(len(coeffs) - 1, 0, -1):
+            pos = pos * tau + coeffs[power]
+            vel = vel * tau + power * coeffs[power]
+        pos = pos * tau + coeffs[0]
+        torque = a.torque + (b.torque - a.torque) * tau / (b.t - a.t)
+        return pos, vel, torque
+
+    def _frames(self, t: float):
+        frames = []
+        with self._lock:
+            for joint in self._joints.values():
+                point = self._setpoint(joint, t)
+                if point is not None:
+                    frames.append(op_control_frame(joint.model, joint.motor, *point, joint.kp, joint.kd))
+        return frames
+
+    def start(self) -> None:
+        if self._thread is not None:
+            return
+        self._running = True
+        self._thread = threading.Thread(target=self._run, name=f"{self.service.cfg.name}-trajectory", daemon=True)
+        self._thread.start()
+
+    def stop(self) -> None:
+        self._running = False
+        if self._thread is not None:
+            self._thread.join(timeout=1.0)
+            self._thread = None
+
+    def stats(self) -> Dict[str, Any]:
+        return {"rate_hz": 1e9 / self.period_ns, "cycles": self.cycles, "overruns": self.overruns,
+                "skipped": self.skipped, "starved": self.starved, "dropped": self.dropped}
+
+    def _run(self) -> None:
+        if self.priority is not None:
+            try:
+                os.sched_setscheduler(0, os.SCHED_FIFO, os.sched_param(self.priority))
+            except (AttributeError, OSError) as exc:
+                LOG.warning("[%s] trajectory thread without SCHED_FIFO %d: %s", self.service.cfg.name,
+                            self.priority, exc)
+        period = self.period_ns
+        deadline = time.monotonic_ns() + period
+        while self._running:
+            remaining = deadline - time.monotonic_ns()
+            if remaining > 0:
+                time.sleep(remaining / 1e9)  # clock_nanosleep on CLOCK_MONOTONIC from Python 3.11
+            for arbitration_id, data in self._frames(deadline / 1e9 - self.delay):
+                try:
+                    self.service.send_raw(arbitration_id, data, tx_class=self.tx_class)
+                except OSError as exc:
+                    self.dropped += 1
+                    LOG.debug("[%s] trajectory frame 0x%X not sent: %s", self.service.cfg.name, arbitration_id, exc)
+            self.cycles += 1
+            deadline += period
+            late = time.monotonic_ns() - deadline
+            if late > 0:
+                self.overruns += 1
+                # Resume on the first deadline still ahead, keeping the phase
+                missed = late // period + 1
+                self.skipped += missed
+                deadline += missed * period
+
+
+__all__ = ["INTERPOLATIONS", "TrajectoryStreamer", "op_control_frame"]
@@ -0,0 +1,318 @@
+"""python-can interface onto a running ``tritoncand``.
+
+``tritoncand`` (nativeCAN/libtritoncan/tools) owns each CAN interface once and
+publishes every frame into a shared-memory ring, ``/dev/shm/tritoncan.<iface>``,
+that any number of processes read in place, each at its own cursor. This bus is
+one such reader, and it queues its transmissions in its own TX ring for the
+daemon to send:
+
+    bus = can.Bus(interface="tritoncand", channel="can0")   # once the package is installed
+    bus = TritoncandBus("can0")                               # or directly
+
+The segment layout is ``tritoncan/shm.hpp``'s; keep the two in step. A client
+slot is claimed with an open file description (OFD) lock, which the kernel
+drops when this bus closes the segment or its process dies, and the daemon
+then frees the slot. Other buses in the same process keep theirs. A reader that falls a whole
+ring behind skips ahead and counts what it missed in ``lost``.
+
+Python cannot issue memory fences, so this reader relies on the slot sequence
+check alone: exact on x86, best effort on weakly ordered CPUs, where the C++
+``ShmClient`` is the one to use for anything that must not see a torn frame.
+"""
+
+from __future__ import annotations
+
+import collections
+import ctypes
+import fcntl
+import mmap
+import os
+import platform
+import struct
+import time
+from typing import Any, Deque, Optional, Tuple
+
+import can
+
+SHM_MAGIC = 0x48534354  # "TCSH"
+SHM_VERSION = 1
+SHM_WRITING = (1 << 64) - 1
+
+# ShmHeader
+_HEADER = struct.Struct("<IIIIIIIIQQQ16s")
+_WRITE_SEQ = 128
+_RX_FUTEX = 136
+_TX_FUTEX = 192
+_TX_SLEEPING = 196
+_STATS = struct.Struct("<QQQQ")  # rx_frames, rx_dropped, tx_frames, tx_busy
+_STATS_AT = 256
+# ShmClientSlot
+_CLIENT_SIZE = 64
+_OWNER, _WAITING, _CURSOR, _LOST, _TX_HEAD, _TX_TAIL, _TX_FULL, _NAME = 0, 4, 16, 24, 32, 40, 48, 56
+# ShmFrame: seq, host_time_ns, timestamp_us, can_id, len, flags; the payload follows at 32
+_FRAME = struct.Struct("<QqQIBB2x")
+_FRAME_SIZE = 96
+_DATA = 32
+
+CAN_EFF_FLAG = 0x80000000
+CAN_RTR_FLAG = 0x40000000
+CAN_ERR_FLAG = 0x20000000
+CAN_EFF_MASK = 0x1FFFFFFF
+FLAG_FD = 1 << 1
+FLAG_BRS = 1 << 2
+FLAG_ESI = 1 << 3
+
+READ_BATCH = 256
+
+_SYS_FUTEX = {"x86_64": 202, "aarch64": 98, "arm64": 98, "riscv64": 98, "armv7l": 240, "i686": 240}.get(
+    platform.machine()
+)
+_FUTEX_WAIT, _FUTEX_WAKE = 0, 1
+
+# OFD locks, as ShmClient takes them: they belong to this bus's open() of the segment, not the
+# process (Python 3.9 names the constant). struct flock: l_type, l_whence, l_start, l_len, l_pid
+F_OFD_SETLK = getattr(fcntl, "F_OFD_SETLK", 37)
+_FLOCK = struct.Struct("hhqqi4x")
+
+
+class DaemonGoneError(can.CanOperationError, ConnectionError):
+    """The daemon shut down. An OSError as well, as an interface going away is for SocketCAN."""
+
+
+class _Timespec(ctypes.Structure):
+    _fields_ = [("tv_sec", ctypes.c_long), ("tv_nsec", ctypes.c_long)]
+
+
+try:
+    _libc = ctypes.CDLL(None, use_errno=True) if _SYS_FUTEX is not None else None
+except OSError:  # pragma: no cover - no libc to call into
+    _libc = None
+
+
+class TritoncandBus(can.BusABC):
+    """One client slot of a ``tritoncand`` segment, as a python-can bus.
+
+    ``bitrate``, ``fd`` and the other SocketCAN options are the daemon's; they
+    are accepted so that configurations can switch ``interface`` alone.
+    """
+
+    def __init__(self, channel: str, can_filters=None, client_name: str = "python", **kwargs: Any) -> None:
+        self._mm: Optional[mmap.mmap] = None
+        path = f"/dev/shm/tritoncan.{channel}"
+        try:
+            fd = os.open(path, os.O_RDWR | os.O_CLOEXEC)
+        except FileNotFoundError as exc:
+            raise can.CanInitializationError(f"{path} not found: is tritoncand running for {channel}?") from exc
+        try:
+            self._mm = mmap.mmap(fd, os.fstat(fd).st_size)
+            (magic, version, self._slots, slot_size, self._max_clients, self._tx_slots, client_size, pid,
+             self._clients_at, self._rx_at, self._tx_at, _) = _HEADER.unpack_from(self._mm, 0)
+            if magic != SHM_MAGIC or version != SHM_VERSION or slot_size != _FRAME_SIZE or client_size != _CLIENT_SIZE:
+                raise can.CanInitializationError(f"{path}: layout version mismatch with this client")
+            if not _process_alive(pid):
+                raise can.CanInitializationError(f"{path}: its tritoncand has exited")
+            self._index = self._claim(fd)
+        except BaseException:
+            if self._mm is not None:
+                self._mm.close()
+                self._mm = None
+            os.close(fd)
+            raise
+        self._fd = fd
+        self._slot = self._clients_at + self._index * _CLIENT_SIZE
+        self._tx_ring = self._tx_at + self._index * self._tx_slots * _FRAME_SIZE
+        self._words = memoryview(self._mm).cast("Q")  # aligned 64-bit loads and stores
+        self._dwords = memoryview(self._mm).cast("I")
+        self._cursor = self._words[_WRITE_SEQ // 8]  # live traffic from now on, not the backlog
+        self._put64(_CURSOR, self._cursor)
+        self._put64(_LOST, 0)
+        self._put64(_TX_FULL, 0)
+        self._put64(_TX_HEAD, self._get64(_TX_TAIL))  # whatever a previous owner left queued is dropped
+        self._dwords[(self._slot + _WAITING) // 4] = 0
+        self._mm[self._slot + _NAME:self._slot + _NAME + 8] = client_name.encode()[:8].ljust(8, b"\0")
+        self._dwords[(self._slot + _OWNER) // 4] = os.getpid()
+        self._pending: Deque[can.Message] = collections.deque()
+        self._rx_futex = ctypes.c_uint32.from_buffer(self._mm, _RX_FUTEX) if _libc else None
+        self._tx_futex = ctypes.c_uint32.from_buffer(self._mm, _TX_FUTEX) if _libc else None
+        self.channel_info = f"tritoncand {channel} (client {self._index})"
+        super().__init__(channel=channel, can_filters=can_filters, **kwargs)
+
+    # ------------------------------------------------------------------
+    # Counters
+
+    @property
+    def lost(self) -> int:
+        """Frames the daemon overwrote before this bus read them."""
+
+        return self._get64(_LOST)
+
+    def daemon_stats(self) -> dict:
+        rx_frames, rx_dropped, tx_frames, tx_busy = _STATS.unpack_from(self._mm, _STATS_AT)
+        return {"rx_frames": rx_frames, "rx_dropped": rx_dropped, "tx_frames": tx_frames, "tx_busy": tx_busy}
+
+    def daemon_alive(self) -> bool:
+        return self._dwords[28 // 4] != 0
+
+    # ------------------------------------------------------------------
+    # python-can
+
+    def _recv_internal(self, timeout: Optional[float]) -> Tuple[Optional[can.Message], bool]:
+        if not self._pending:
+            deadline = None if timeout is None else time.monotonic() + timeout
+            while not self._read_batch():
+                if not self.daemon_alive():
+                    raise DaemonGoneError(f"tritoncand for {self.channel} has shut down")
+                remaining = None if deadline is None else deadline - time.monotonic()
+                if remaining is not None and remaining <= 0:
+                    return None, False
+                self._wait(remaining)
+        return self._pending.popleft(), False
+
+    def send(self, msg: can.Message, timeout: Optional[float] = None) -> None:
+        head = self._get64(_TX_HEAD)
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while head - self._get64(_TX_TAIL) >= self._tx_slots:
+            if deadline is not None and time.monotonic() >= deadline or not self.daemon_alive():
+                self._put64(_TX_FULL, self._get64(_TX_FULL) + 1)
+                raise can.CanOperationError(f"{self.channel_info}: TX ring full")
+            time.sleep(0.0005)
+        can_id = msg.arbitration_id | (CAN_EFF_FLAG if msg.is_extended_id else 0)
+        if msg.is_remote_frame:
+            can_id |= CAN_RTR_FLAG
+        flags = 0
+        if msg.is_fd:
+            flags = FLAG_FD | (FLAG_BRS if msg.bitrate_switch else 0) | (FLAG_ESI if msg.error_state_indicator else 0)
+        data = bytes(msg.data or b"")[:64]
+        at = self._tx_ring + (head & (self._tx_slots - 1)) * _FRAME_SIZE
+        _FRAME.pack_into(self._mm, at, 0, 0, 0, can_id, len(data), flags)
+        self._mm[at + _DATA:at + _DATA + len(data)] = data
+        self._put64(_TX_HEAD, head + 1)
+        # Not an atomic increment: a lost one only means the daemon wakes on its own timeout
+        self._dwords[_TX_FUTEX // 4] = (self._dwords[_TX_FUTEX // 4] + 1) & 0xFFFFFFFF
+        if self._dwords[_TX_SLEEPING // 4]:
+            self._futex(self._tx_futex, _FUTEX_WAKE, 1)
+
+    def shutdown(self) -> None:
+        if self._mm is None:
+            return
+        super().shutdown()
+        self._dwords[(self._slot + _OWNER) // 4] = 0
+        # The exported views have to go before the mapping can close
+        self._words.release()
+        self._dwords.release()
+        self._rx_futex = self._tx_futex = None
+        self._mm.close()
+        self._mm = None
+        os.close(self._fd)  # drops this bus's slot lock, and only that one
+
+    # ------------------------------------------------------------------
+    # Internals
+
+    def _claim(self, fd: int) -> int:
+        for i in range(self._max_clients):
+            lock = _FLOCK.pack(fcntl.F_WRLCK, os.SEEK_SET, self._clients_at + i * _CLIENT_SIZE, _CLIENT_SIZE, 0)
+            try:
+                fcntl.fcntl(fd, F_OFD_SETLK, lock)
+            except OSError:
+                continue
+            return i
+        raise can.CanInitializationError("all tritoncand client slots are in use")
+
+    def _get64(self, field: int) -> int:
+        return self._words[(self._slot + field) // 8]
+
+    def _put64(self, field: int, value: int) -> None:
+        self._words[(self._slot + field) // 8] = value
+
+    def _read_batch(self) -> int:
+        words, mm = self._words, self._mm
+        write = words[_WRITE_SEQ // 8]
+        cursor = self._cursor
+        lost = 0
+        if write - cursor > self._slots:
+            # Lapped: resume a quarter ring behind the writer, out of its way
+            resume = write - (self._slots - self._slots // 4)
+            lost += resume - cursor
+            cursor = resume
+        end = min(write, cursor + READ_BATCH)
+        mask = self._slots - 1
+        offset_s = (time.time_ns() - time.monotonic_ns()) / 1e9  # CLOCK_MONOTONIC -> epoch, as SocketCAN stamps
+        got = 0
+        for seq in range(cursor, end):
+            at = self._rx_at + (seq & mask) * _FRAME_SIZE
+            slot_seq, host_ns, _, can_id, length, flags = _FRAME.unpack_from(mm, at)
+            if slot_seq != seq:
+                lost += 1
+                continue
+            data = mm[at + _DATA:at + _DATA + min(length, 64)]
+            if words[at // 8] != seq:  # overwritten while copied
+                lost += 1
+                continue
+            self._pending.append(can.Message(
+                timestamp=host_ns / 1e9 + offset_s if host_ns else time.time(),
+                arbitration_id=can_id & CAN_EFF_MASK,
+                is_extended_id=bool(can_id & CAN_EFF_FLAG),
+                is_remote_frame=bool(can_id & CAN_RTR_FLAG),
+                is_error_frame=bool(can_id & CAN_ERR_FLAG),
+                is_fd=bool(flags & FLAG_FD),
+                bitrate_switch=bool(flags & FLAG_BRS),
+                error_state_indicator=bool(flags & FLAG_ESI),
+                dlc=len(data),
+                data=data,
+                channel=self.channel,
+            ))
+            got += 1
+        self._cursor = end
+        self._put64(_CURSOR, end)
+        if lost:
+            self._put64(_LOST, self._get64(_LOST) + lost)
+        return got
+
+    def _wait(self, timeout: Optional[float]) -> None:
+        waiting = (self._slot + _WAITING) // 4
+        self._dwords[waiting] = 1
+        seen = self._dwords[_RX_FUTEX // 4]
+        if self._words[_WRITE_SEQ // 8] == self._cursor and self.daemon_alive():
+            if self._rx_futex is None:
+                time.sleep(min(timeout, 0.001) if timeout is not None else 0.001)
+            else:
+                # At most 100 ms per wait, so that a daemon that died without waking anyone is noticed
+                slice_s = 0.1 if timeout is None else min(timeout, 0.1)
+                self._futex(self._rx_futex, _FUTEX_WAIT, seen, slice_s)
+        self._dwords[waiting] = 0
+
+    @staticmethod
+    def _futex(word: Optional[ctypes.c_uint32], op: int, value: int, timeout: Optional[float] = None) -> None:
+        if word is None:
+            return
+        ts = None
+        if timeout is not None:
+            ts = ctypes.byref(_Timespec(int(timeout), int((timeout % 1) * 1e9)))
+        _libc.syscall(_SYS_FUTEX, ctypes.byref(word), op, ctypes.c_uint32(value), ts, None, 0)
+
+
+def daemon_serving(channel: str) -> bool:
+    """A live ``tritoncand`` publishes ``channel`` in a segment this client can read."""
+
+    try:
+        with open(f"/dev/shm/tritoncan.{channel}", "rb") as f:
+            header = f.read(_HEADER.size)
+    except OSError:
+        return False
+    if len(header) < _HEADER.size:
+        return False
+    magic, version, _, slot_size, _, _, client_size, pid = _HEADER.unpack(header)[:8]
+    return (magic == SHM_MAGIC and version == SHM_VERSION and slot_size == _FRAME_SIZE
+            and client_size == _CLIENT_SIZE and _process_alive(pid))
+
+
+def _process_alive(pid: int) -> bool:
+    if pid == 0:
+        return False
+    try:
+        os.kill(pid, 0)
+    except ProcessLookupError:
+        return False
+    except PermissionError:
+        pass  # another user's daemon
+    return True
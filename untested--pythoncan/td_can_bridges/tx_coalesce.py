@@ -0,0 +1,153 @@
+"""Latest-only TX bindings: the newest pending setpoint, at most ``rate_hz``.
+
+A controller that publishes faster than the bus or the motor can use fills
+the interface queue with setpoints, each older than the one behind it, and
+the command latency grows with the backlog. A ``tx_topics`` entry with
+``coalesce: latest`` and ``rate_hz`` keeps one pending frame instead:
+
+.. code-block:: yaml
+
+    tx_topics:
+      "/td/rs02/1/cmd":
+        dbc_message: "RS02_Command"
+        coalesce: latest
+        rate_hz: 500
+
+:meth:`CanBusService.send` encodes the payload and replaces the binding's
+pending frame. The bus's coalesce thread writes it at once when the
+binding's last write is at least ``1 / rate_hz`` old, and otherwise when that
+period is up; sends in between only replace it. A command therefore waits at
+most one period, whatever the publish rate. Once
+sent, a frame is not repeated. A binding that must keep its frame on the bus
+uses ``period_ms`` (the kernel's broadcast manager already sends only the
+latest payload), and a ``tx_schedule`` slot is latest-only by design. With
+``tx_classes`` the frame goes to the binding's class queue. Otherwise it is
+written to the socket without blocking. A full queue keeps the frame pending
+for the next period unless a newer one replaces it.
+"""
+
+from __future__ import annotations
+
+import errno
+import logging
+import threading
+import time
+from typing import Any, Callable, Dict, Optional
+
+LOG = logging.getLogger(__name__)
+
+COALESCE_MODES = ("latest",)
+
+
+class _BindingStats:
+    __slots__ = ("sent", "coalesced", "failed")
+
+    def __init__(self):
+        self.sent = 0
+        self.coalesced = 0  # replaced by a newer send before they went out
+        self.failed = 0     # writes that failed; a full queue's are retried
+
+
+class TxCoalescer:
+    """The coalesce thread of one bus.
+
+    ``write(key, frame)`` puts one frame on the bus without blocking and raises
+    (``ENOBUFS``) when there is no room.
+    """
+
+    def __init__(self, write: Callable[[str, Any], None], name: str):
+        self.name = name
+        self._write = write
+        self._period: Dict[str, float] = {}   # binding -> seconds between writes
+        self._pending: Dict[str, Any] = {}    # binding -> newest unsent frame
+        self._due: Dict[str, float] = {}      # binding -> earliest monotonic time of its next write
+        self._stats: Dict[str, _BindingStats] = {}
+        self._cond = threading.Condition()
+        self._stopping = False
+        self._thread = threading.Thread(target=self._run, name=f"{name}-tx-coalesce", daemon=True)
+        self._thread.start()
+
+    def set_rate(self, binding: str, rate_hz: Optional[float]) -> None:
+        """Coalesce ``binding`` at ``rate_hz``; None drops it along with its pending frame."""
+
+        with self._cond:
+            if rate_hz is None:
+                self._period.pop(binding, None)
+                self._pending.pop(binding, None)
+                self._due.pop(binding, None)
+                self._stats.pop(binding, None)
+            else:
+                self._period[binding] = 1.0 / rate_hz
+                self._stats.setdefault(binding, _BindingStats())
+            self._cond.notify()
+
+    def __contains__(self, binding: str) -> bool:
+        return binding in self._period
+
+    def post(self, binding: str, frame: Any) -> None:
+        """Make ``frame`` the binding's pending frame, replacing an unsent one."""
+
+        with self._cond:
+            if binding in self._pending:
+                self._stats[binding].coalesced += 1
+            self._pending[binding] = frame
+            self._cond.notify()
+
+    def stop(self) -> None:
+        with self._cond:
+            self._stopping = True
+            self._cond.notify()
+        self._thread.join(timeout=1.0)
+
+    def stats(self) -> Dict[str, Any]:
+        with self._cond:
+            return {key: {"rate_hz": 1.0 / self._period[key], "sent": st.sent, "coalesced": st.coalesced,
+                          "failed": st.failed, "pending": key in self._pending}
+                    for key, st in self._stats.items()}
+
+    def _run(self) -> None:
+        clock = time.monotonic
+        with self._cond:
+            while not self._stopping:
+                now = clock()
+                ready = [key for key in self._pending if self._due.get(key, 0.0) <= now]
+                if not ready:
+                    # Without pending frames only a post, set_rate or stop wakes the thread
+                    due = min((self._due[key] for key in self._pending), default=None)
+                    self._cond.wait(None if due is None else due - now)
+                    continue
+                frames = [(key, self._pending.pop(key)) for key in ready]
+                for key in ready:
+                    self._due[key] = now + self._period[key]
+                # Written outside the lock, so senders never wait for the socket
+                self._cond.release()
+                try:
+                    results = [(key, frame, self._send(key, frame)) for key, frame in frames]
+                finally:
+                    self._cond.acquire()
+                for key, frame, error in results:
+                    st = self._stats.get(key)
+                    if st is None:
+                        continue  # dropped by set_rate meanwhile
+                    if error is None:
+                        st.sent += 1
+                        continue
+                    st.failed += 1
+                    if error in (errno.ENOBUFS, errno.EAGAIN):
+                        self._pending.setdefault(key, frame)
+
+    def _send(self, key: str, frame: Any) -> Optional[int]:
+        """None once written, else the errno (0 for other errors, which are logged)."""
+
+        try:
+            self._write(key, frame)
+        except Exception as exc:
+            code = getattr(exc, "errno", None)
+            if code in (errno.ENOBUFS, errno.EAGAIN):
+                return code
+            LOG.error("[%s] coalesced TX %s failed: %s", self.name, key, exc)
+            return 0
+        return None
+
+
+__all__ = ["COALESCE_MODES", "TxCoalescer"]
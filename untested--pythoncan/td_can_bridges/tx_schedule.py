@@ -0,0 +1,245 @@
+"""Time-triggered TX: a table of slots per cycle, sent by one real-time thread.
+
+With several motors commanded at 1 kHz, frames written whenever their
+callbacks run contend for the bus in a different order every cycle, and each
+motor's command-to-feedback timing wanders with it. ``tx_schedule`` on a bus
+fixes the order instead, in the manner of TTCAN's exclusive windows. The cycle
+is cut into slots ("this binding at this offset") and the thread writes each
+slot's frame at its offset, every cycle:
+
+.. code-block:: yaml
+
+    tx_schedule:
+      cycle_us: 1000
+      priority: 70            # SCHED_FIFO, needs CAP_SYS_NICE; taken best effort
+      slots:
+        - {binding: "/td/rs02/1/cmd", offset_us: 0}
+        - {binding: "/td/rs02/2/cmd", offset_us: 250}
+        - {binding: "/td/imu/trigger", offset_us: 500, every: 10}   # 100 Hz
+
+:meth:`CanBusService.send` on a scheduled binding only replaces the frame its
+slots send, like a mailbox; nothing goes out before the first ``send``. A
+binding's ``hold_ms`` stops its slots once no frame arrived for that long. A
+slot that cannot be written within ``late_us`` of its offset is skipped
+rather than sent late, so a stall costs whole slots and never shifts the
+others. ``stats()`` reports, per slot, how far each write was from its offset.
+
+The clock is ``CLOCK_MONOTONIC`` and the cycle starts on a multiple of
+``cycle_us``, so the schedules of several buses (or processes) on one host
+share their phase. The thread sleeps until ``spin_us`` before each slot and
+spins the rest of the way.
+"""
+
+from __future__ import annotations
+
+import errno
+import logging
+import os
+import threading
+import time
+from dataclasses import dataclass
+from typing import Any, Callable, Dict, List, Mapping, Optional, Tuple
+
+from .metrics import Histogram
+
+LOG = logging.getLogger(__name__)
+
+MIN_CYCLE_US = 100
+# Slot error buckets in seconds: from a spinning RT thread (a few µs) to a stalled one
+SLOT_ERROR_BUCKETS = (5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3)
+
+
+@dataclass(frozen=True)
+class ScheduleSlot:
+    binding: str
+    offset_us: int
+    every: int = 1  # in every n-th cycle only
+
+
+@dataclass(frozen=True)
+class ScheduleConfig:
+    cycle_us: int
+    slots: Tuple[ScheduleSlot, ...]  # by offset
+    priority: Optional[int] = None   # SCHED_FIFO priority of the thread
+    spin_us: int = 200
+    late_us: Optional[int] = None    # None: a quarter of the cycle
+
+    @property
+    def late_limit_us(self) -> int:
+        return self.late_us if self.late_us is not None else self.cycle_us // 4
+
+    def frames_per_s(self, binding: str) -> float:
+        return sum(1e6 / (self.cycle_us * slot.every) for slot in self.slots if slot.binding == binding)
+
+
+def schedule_entry(value: Any, context: str, tx_bindings: Mapping[str, Any]) -> Optional[ScheduleConfig]:
+    """Parse ``tx_schedule`` against the bus's ``tx_topics``; None when absent."""
+
+    if not value:
+        return None
+    if not isinstance(value, Mapping) or not value.get("slots"):
+        raise ValueError(f"{context}.tx_schedule must be a mapping with cycle_us and slots")
+    unknown = set(value) - {"cycle_us", "slots", "priority", "spin_us", "late_us"}
+    if unknown:
+        raise ValueError(f"{context}.tx_schedule: unknown keys {sorted(unknown)}")
+    cycle_us = int(value.get("cycle_us", 0))
+    if cycle_us < MIN_CYCLE_US:
+        raise ValueError(f"{context}.tx_schedule.cycle_us must be at least {MIN_CYCLE_US}, got {cycle_us}")
+    slots: List[ScheduleSlot] = []
+    for i, spec in enumerate(value["slots"]):
+        where = f"{context}.tx_schedule.slots[{i}]"
+        if not isinstance(spec, Mapping) or "binding" not in spec:
+            raise ValueError(f"{where} must be a mapping with binding and offset_us")
+        binding = tx_bindings.get(spec["binding"])
+        if binding is None:
+            raise ValueError(f"{where}.binding '{spec['binding']}' is not a tx_topics entry")
+        if binding.period_ms:
+            raise ValueError(f"{where}.binding '{spec['binding']}' has period_ms: the kernel sends it already")
+        offset = int(spec.get("offset_us", 0))
+        every = int(spec.get("every", 1))
+        if not 0 <= offset < cycle_us or every < 1:
+            raise ValueError(f"{where}: offset_us must be in [0, cycle_us) and every at least 1")
+        slots.append(ScheduleSlot(binding=str(spec["binding"]), offset_us=offset, every=every))
+    slots.sort(key=lambda s: s.offset_us)
+    priority = value.get("priority")
+    late_us = value.get("late_us")
+    return ScheduleConfig(
+        cycle_us=cycle_us,
+        slots=tuple(slots),
+        priority=int(priority) if priority is not None else None,
+        spin_us=int(value.get("spin_us", 200)),
+        late_us=int(late_us) if late_us is not None else None,
+    )
+
+
+class _SlotStats:
+    __slots__ = ("sent", "empty", "skipped", "failed", "max_error", "error")
+
+    def __init__(self):
+        self.sent = 0
+        self.empty = 0    # nothing posted yet, or older than hold_ms
+        self.skipped = 0  # over late_us
+        self.failed = 0   # the interface queue was full
+        self.max_error = 0.0
+        self.error = Histogram(SLOT_ERROR_BUCKETS)
+
+
+class TxSchedule:
+    """The schedule thread of one bus.
+
+    ``write(frame)`` puts one frame on the bus without blocking; it raises
+    (``ENOBUFS`` from a socket) when the interface queue is full. ``holds`` maps
+    binding keys to their ``hold_ms``.
+    """
+
+    def __init__(self, cfg: ScheduleConfig, write: Callable[[Any], None], name: str,
+                 holds: Optional[Mapping[str, Optional[float]]] = None):
+        self.cfg = cfg
+        self.name = name
+        self._write = write
+        self._holds = {key: ms / 1000.0 for key, ms in (holds or {}).items() if ms}
+        self._frames: Dict[str, Tuple[Any, float]] = {}  # binding -> (latest frame, posted at)
+        self._stats = [_SlotStats() for _ in cfg.slots]
+        self.cycles = 0
+        self.overruns = 0  # cycles given up whole because the thread fell a cycle behind
+        self._stop = threading.Event()
+        self._thread = threading.Thread(target=self._run, name=f"{name}-tx-schedule", daemon=True)
+        self._thread.start()
+
+    @property
+    def bindings(self) -> frozenset:
+        return frozenset(slot.binding for slot in self.cfg.slots)
+
+    def post(self, binding: str, frame: Any) -> None:
+        """Make ``frame`` what the slots of ``binding`` send from their next turn on."""
+
+        self._frames[binding] = (frame, time.monotonic())
+
+    def stop(self) -> None:
+        self._stop.set()
+        self._thread.join(timeout=1.0)
+
+    def stats(self) -> Dict[str, Any]:
+        """Per slot, ``binding@offset_us``: counts, and the error of the writes in µs."""
+
+        slots = {}
+        for slot, st in zip(self.cfg.slots, self._stats):
+            hist = st.error
+            slots[f"{slot.binding}@{slot.offset_us}"] = {
+                "sent": st.sent,
+                "empty": st.empty,
+                "skipped": st.skipped,
+                "failed": st.failed,
+                "error_us_mean": hist.total / hist.count * 1e6 if hist.count else 0.0,
+                "error_us_max": st.max_error * 1e6,
+                "error_seconds": hist.snapshot(),
+            }
+        return {"cycle_us": self.cfg.cycle_us, "cycles": self.cycles, "overruns": self.overruns, "slots": slots}
+
+    def _realtime(self) -> None:
+        if self.cfg.priority is None:
+            return
+        try:
+            # pid 0: this thread
+            os.sched_setscheduler(0, os.SCHED_FIFO, os.sched_param(self.cfg.priority))
+        except (AttributeError, OSError) as exc:
+            LOG.warning("[%s] TX schedule thread not real-time (SCHED_FIFO %d): %s",
+                        self.name, self.cfg.priority, exc)
+
+    def _run(self) -> None:
+        self._realtime()
+        cfg = self.cfg
+        cycle = cfg.cycle_us * 1000
+        spin = cfg.spin_us * 1000
+        late = cfg.late_limit_us * 1000
+        offsets = [slot.offset_us * 1000 for slot in cfg.slots]
+        clock = time.monotonic_ns
+        n = clock() // cycle + 1
+        LOG.info("[%s] TX schedule started: %d slots per %d us", self.name, len(cfg.slots), cfg.cycle_us)
+        while not self._stop.is_set():
+            start = n * cycle
+            now = clock()
+            if start - now > spin:
+                time.sleep((start - now - spin) / 1e9)  # also for cycles where every slot sits out
+            for slot, offset, st in zip(cfg.slots, offsets, self._stats):
+                if n % slot.every:
+                    continue
+                target = start + offset
+                now = clock()
+                if target - now > spin:
+                    time.sleep((target - now - spin) / 1e9)
+                while clock() < target:
+                    pass
+                now = clock()
+                if now - target > late:
+                    st.skipped += 1
+                    continue
+                entry = self._frames.get(slot.binding)
+                hold = self._holds.get(slot.binding)
+                if entry is None or (hold is not None and time.monotonic() - entry[1] > hold):
+                    st.empty += 1
+                    continue
+                try:
+                    self._write(entry[0])
+                except Exception as exc:
+                    # A full queue is expected under overload; anything else is logged once per slot
+                    if getattr(exc, "errno", None) not in (errno.ENOBUFS, errno.EAGAIN) and not st.failed:
+                        LOG.error("[%s] TX schedule write for %s failed: %s", self.name, slot.binding, exc)
+                    st.failed += 1
+                    continue
+                error = (now - target) / 1e9
+                st.sent += 1
+                st.error.observe(error)
+                if error > st.max_error:
+                    st.max_error = error
+            self.cycles += 1
+            n += 1
+            behind = (clock() - n * cycle) // cycle
+            if behind > 0:
+                # Whole cycles already gone: start again at the next one rather than racing through them
+                self.overruns += behind
+                n += behind
+        LOG.info("[%s] TX schedule stopped", self.name)
+
+
+__all__ = ["ScheduleConfig", "ScheduleSlot", "TxSchedule", "schedule_entry"]
@@ -0,0 +1,338 @@
+"""Userspace TX queue with priority classes and rate caps.
+
+Without it :meth:`CanBusService.send` writes straight to the CAN socket: once
+the interface's queue is full, a stop command waits behind whatever bulk
+traffic got there first, or ``send`` raises ``ENOBUFS``. With ``tx_classes``
+on the bus, ``send`` queues the frame in its binding's class and one TX
+thread writes to the socket, always from the highest-``priority`` class that
+has frames and is under its rate cap. A stop command then waits at most for
+the frame being written and the few the kernel already holds
+(``txqueuelen``), never for the rest of a bulk transfer.
+
+:data:`DEFAULT_CLASSES` are always defined; the bus's ``tx_classes`` entries
+override their fields or add classes:
+
+* ``command`` – priority 3, no cap; ``send`` blocks while the queue is full
+* ``telemetry`` – priority 2, no cap; a full queue drops its oldest frame
+* ``parameter`` – priority 1, 1000 frames/s (RoboStride type 17/18 traffic)
+* ``bulk`` – priority 0, 500 frames/s
+
+``overflow`` takes the policies of :mod:`td_can_bridges.handler_pool`.
+``rate_hz`` is a token bucket of ``burst`` frames. Periodic (``period_ms``)
+bindings are sent by the kernel's broadcast manager and skip the queue.
+
+:class:`TxScheduler` takes one lock per frame, which every sending thread
+contends for. With ``tx_mode: native`` the bus uses :class:`NativeTxScheduler`
+instead: the same classes as lock-free lanes of the native core's ``TxQueue``
+(``native/tx_queue.hpp``), drained by a C++ thread in ``sendmmsg`` batches.
+"""
+
+from __future__ import annotations
+
+import errno
+import logging
+import threading
+import time
+from collections import deque
+from dataclasses import dataclass
+from typing import Any, Dict, Mapping, Optional
+
+from .handler_pool import OVERFLOW_POLICIES
+from .socketcan_rx import MSG_DONTWAIT
+
+LOG = logging.getLogger(__name__)
+
+# Pause between attempts while the interface's TX queue is full (ENOBUFS)
+_RETRY_S = 0.0005
+
+
+@dataclass(frozen=True)
+class TxClassConfig:
+    """One priority class of the TX queue; a higher ``priority`` is sent first."""
+
+    name: str
+    priority: int = 0
+    rate_hz: Optional[float] = None  # frames per second, None: uncapped
+    burst: int = 8                   # frames the cap lets through back to back
+    queue_size: int = 256
+    overflow: str = "block"
+
+
+DEFAULT_CLASSES: Mapping[str, TxClassConfig] = {
+    "command": TxClassConfig("command", priority=3, queue_size=64),
+    "telemetry": TxClassConfig("telemetry", priority=2, queue_size=64, overflow="latest"),
+    "parameter": TxClassConfig("parameter", priority=1, rate_hz=1000.0, queue_size=256),
+    "bulk": TxClassConfig("bulk", priority=0, rate_hz=500.0, queue_size=1024),
+}
+
+DEFAULT_TX_CLASS = "command"
+
+
+class _TxClass:
+    __slots__ = ("cfg", "items", "tokens", "refilled", "sent", "dropped", "max_depth")
+
+    def __init__(self, cfg: TxClassConfig):
+        self.cfg = cfg
+        self.items: deque = deque()  # (frame, enqueue time)
+        self.tokens = float(max(1, cfg.burst))
+        self.refilled = time.monotonic()
+        self.sent = 0
+        self.dropped = 0
+        self.max_depth = 0
+
+    def wait_for_token(self, now: float) -> float:
+        """Refill the bucket; seconds until a frame may go, 0 when one may go now."""
+
+        rate = self.cfg.rate_hz
+        if not rate:
+            return 0.0
+        self.tokens = min(float(max(1, self.cfg.burst)), self.tokens + (now - self.refilled) * rate)
+        self.refilled = now
+        return 0.0 if self.tokens >= 1.0 else (1.0 - self.tokens) / rate
+
+
+class TxScheduler:
+    """The TX thread of one bus and its class queues.
+
+    Frames are ``struct can_frame`` bytes written to ``sock``, or
+    ``can.Message`` objects (CAN FD) handed to ``bus.send``.
+    """
+
+    def __init__(self, sock, bus, classes: Mapping[str, TxClassConfig], name: str, metrics=None):
+        for cfg in classes.values():
+            if cfg.overflow not in OVERFLOW_POLICIES:
+                raise ValueError(f"tx_classes.{cfg.name}.overflow must be one of {list(OVERFLOW_POLICIES)}")
+        self.sock = sock
+        self.bus = bus
+        self.name = name
+        self.metrics = metrics
+        self._classes = {n: _TxClass(cfg) for n, cfg in classes.items()}
+        self._order = sorted(self._classes.values(), key=lambda c: -c.cfg.priority)
+        self._cond = threading.Condition()
+        self._stopping = False
+        self._drain_until = 0.0
+        self._thread = threading.Thread(target=self._run, name=f"{name}-tx", daemon=True)
+        self._thread.start()
+
+    def submit(self, tx_class: str, frame: Any, block: bool = True) -> None:
+        """Queue ``frame``; a full ``block`` class waits for room, or raises ENOBUFS without ``block``."""
+
+        cls = self._classes.get(tx_class)
+        if cls is None:
+            raise KeyError(f"[{self.name}] unknown TX class '{tx_class}'")
+        with self._cond:
+            if self._stopping:
+                raise RuntimeError(f"[{self.name}] TX queue stopped")
+            if len(cls.items) >= cls.cfg.queue_size:
+                policy = cls.cfg.overflow
+                if policy == "latest":
+                    cls.items.popleft()
+                    cls.dropped += 1
+                elif policy == "error":
+                    cls.dropped += 1
+                    LOG.error("[%s] TX class %s full (%d), frame dropped", self.name, tx_class, cls.cfg.queue_size)
+                    return
+                elif not block:
+                    raise OSError(errno.ENOBUFS, f"TX class {tx_class} full")
+                else:
+                    while len(cls.items) >= cls.cfg.queue_size and not self._stopping:
+                        self._cond.wait()
+                    if self._stopping:
+                        raise RuntimeError(f"[{self.name}] TX queue stopped")
+            cls.items.append((frame, time.monotonic()))
+            if len(cls.items) > cls.max_depth:
+                cls.max_depth = len(cls.items)
+            self._cond.notify_all()
+
+    def stop(self, drain: float = 0.1) -> None:
+        """Stop the TX thread after sending what is queued, for ``drain`` seconds at most."""
+
+        with self._cond:
+            self._stopping = True
+            self._drain_until = time.monotonic() + drain
+            self._cond.notify_all()
+        self._thread.join(timeout=drain + 1.0)
+        left = sum(len(c.items) for c in self._classes.values())
+        if left:
+            LOG.warning("[%s] %d queued TX frame(s) not sent at shutdown", self.name, left)
+
+    def rebind(self, sock, bus) -> None:
+        """Write to a reopened bus from the next frame on."""
+
+        with self._cond:
+            self.sock = sock
+            self.bus = bus
+
+    def stats(self) -> Dict[str, Dict[str, int]]:
+        with self._cond:
+            return {
+                name: {"depth": len(c.items), "max_depth": c.max_depth, "sent": c.sent, "dropped": c.dropped}
+                for name, c in self._classes.items()
+            }
+
+    def _next(self):
+        """The next (class, frame, enqueue time) to send, waiting as the caps require; None to stop."""
+
+        with self._cond:
+            while True:
+                now = time.monotonic()
+                if self._stopping and (now >= self._drain_until or not any(c.items for c in self._order)):
+                    return None
+                wait: Optional[float] = None
+                for cls in self._order:
+                    if not cls.items:
+                        continue
+                    delay = cls.wait_for_token(now)
+                    if delay:
+                        wait = delay if wait is None else min(wait, delay)
+                        continue
+                    if cls.cfg.rate_hz:
+                        cls.tokens -= 1.0
+                    frame, queued = cls.items.popleft()
+                    if cls.cfg.overflow == "block":
+                        self._cond.notify_all()
+                    return cls, frame, queued
+                if self._stopping:
+                    wait = min(wait or 1.0, max(0.0, self._drain_until - now))
+                self._cond.wait(wait)
+
+    def _write(self, frame: Any) -> None:
+        if not isinstance(frame, (bytes, bytearray)):
+            self.bus.send(frame)
+            return
+        while True:
+            try:
+                self.sock.send(frame, MSG_DONTWAIT)
+                return
+            except OSError as exc:
+                if exc.errno not in (errno.ENOBUFS, errno.EAGAIN) or (
+                        self._stopping and time.monotonic() >= self._drain_until):
+                    raise
+                time.sleep(_RETRY_S)
+
+    def _run(self) -> None:
+        metrics = self.metrics
+        while True:
+            item = self._next()
+            if item is None:
+                return
+            cls, frame, queued = item
+            try:
+                self._write(frame)
+            except Exception:
+                LOG.exception("[%s] TX of a %s frame failed", self.name, cls.cfg.name)
+                continue
+            cls.sent += 1
+            if metrics is not None:
+                metrics.tx_frames += 1
+                metrics.tx_queue_histogram(cls.cfg.name).observe(time.monotonic() - queued)
+
+
+class NativeTxScheduler:
+    """:class:`TxScheduler` on the native core's ``TxQueue``, for a SocketCAN bus.
+
+    ``submit`` copies the frame into its class's lane without a lock. A full
+    ``block`` class waits with the GIL released. Frames are ``struct
+    can_frame`` or ``canfd_frame`` bytes only; the TX thread never calls into
+    Python. Queue wait times are in :meth:`stats`, not in the
+    ``tx_queue_seconds`` histogram.
+    """
+
+    def __init__(self, core, sock, classes: Mapping[str, TxClassConfig], name: str, metrics=None, batch: int = 64):
+        for cfg in classes.values():
+            if cfg.overflow not in OVERFLOW_POLICIES:
+                raise ValueError(f"tx_classes.{cfg.name}.overflow must be one of {list(OVERFLOW_POLICIES)}")
+        order = sorted(classes.values(), key=lambda c: -c.priority)
+        self.sock = sock
+        self.name = name
+        self.metrics = metrics
+        self._lanes = {cfg.name: i for i, cfg in enumerate(order)}
+        self._queue = core.TxQueue(
+            sock.fileno(),
+            [(cfg.queue_size, cfg.rate_hz or 0.0, cfg.burst, cfg.overflow) for cfg in order],
+            batch,
+        )
+        self._lock = threading.Lock()  # stats() only
+        self._counted = 0
+
+    def submit(self, tx_class: str, frame: Any, block: bool = True) -> None:
+        """Queue ``frame``; a full ``block`` class waits for room, or raises ENOBUFS without ``block``."""
+
+        lane = self._lanes.get(tx_class)
+        if lane is None:
+            raise KeyError(f"[{self.name}] unknown TX class '{tx_class}'")
+        if not self._queue.push(lane, frame, block):
+            LOG.error("[%s] TX class %s full, frame dropped", self.name, tx_class)
+
+    def stop(self, drain: float = 0.1) -> None:
+        """Stop the TX thread after sending what is queued, for ``drain`` seconds at most."""
+
+        left = self._queue.stop(drain)
+        self.stats()
+        if left:
+            LOG.warning("[%s] %d queued TX frame(s) not sent at shutdown", self.name, left)
+
+    def rebind(self, sock, bus) -> None:
+        """Write to a reopened bus from the next batch on."""
+
+        if sock is None:
+            LOG.error("[%s] reopened bus has no SocketCAN socket; native TX keeps the old one", self.name)
+            return
+        self.sock = sock
+        self._queue.set_fd(sock.fileno())
+
+    def stats(self) -> Dict[str, Dict[str, Any]]:
+        """Per class as :meth:`TxScheduler.stats`, with ``errors`` and the queue wait in ms.
+
+        Also adds the frames sent since the last call to ``metrics.tx_frames``.
+        """
+
+        lanes = self._queue.stats()
+        out = {}
+        for name, lane in self._lanes.items():
+            s = lanes[lane]
+            out[name] = {
+                "depth": s["depth"],
+                "max_depth": s["max_depth"],
+                "sent": s["sent"],
+                "dropped": s["dropped"],
+                "errors": s["errors"],
+                "wait_ms_mean": s["wait_ns_sum"] / s["sent"] / 1e6 if s["sent"] else 0.0,
+                "wait_ms_max": s["wait_ns_max"] / 1e6,
+            }
+        sent = sum(s["sent"] for s in lanes)
+        with self._lock:
+            if self.metrics is not None:
+                self.metrics.tx_frames += sent - self._counted
+            self._counted = sent
+        return out
+
+
+def merge_classes(entries: Optional[Mapping[str, Mapping[str, Any]]], context: str) -> Dict[str, TxClassConfig]:
+    """:data:`DEFAULT_CLASSES` with the YAML ``tx_classes`` entries applied."""
+
+    classes = dict(DEFAULT_CLASSES)
+    for name, spec in (entries or {}).items():
+        spec = dict(spec or {})
+        unknown = set(spec) - {"priority", "rate_hz", "burst", "queue_size", "overflow"}
+        if unknown:
+            raise ValueError(f"{context}.tx_classes.{name}: unknown keys {sorted(unknown)}")
+        base = classes.get(name, TxClassConfig(name))
+        overflow = spec.get("overflow", base.overflow)
+        if overflow not in OVERFLOW_POLICIES:
+            raise ValueError(
+                f"{context}.tx_classes.{name}.overflow must be one of {list(OVERFLOW_POLICIES)}, got '{overflow}'"
+            )
+        rate = spec.get("rate_hz", base.rate_hz)
+        classes[name] = TxClassConfig(
+            name=name,
+            priority=int(spec.get("priority", base.priority)),
+            rate_hz=float(rate) if rate else None,
+            burst=int(spec.get("burst", base.burst)),
+            queue_size=int(spec.get("queue_size", base.queue_size)),
+            overflow=overflow,
+        )
+    return classes
+
+
+__all__ = ["DEFAULT_CLASSES", "DEFAULT_TX_CLASS", "NativeTxScheduler", "TxClassConfig", "TxScheduler", "merge_classes"]
@@ -0,0 +1,399 @@
+"""Telemetry uplink: selected messages to a base station, as compact log chunks over UDP, under a bandwidth budget.
+
+A bus with ``uplink`` sends the frames of some of its DBC messages to a base
+station, batched rather than one ROS message each::
+
+    uplink:
+      to: base-station.local:47000
+      messages: [RS02_Status1, FootForce]
+      keep: [RS02_Fault]        # also sent, never thinned
+      budget_kbps: 200          # the default
+      period_s: 0.5             # one chunk per period (the default)
+
+Every ``period_s`` the frames received since the last chunk are encoded as
+one chunk of :mod:`td_can_bridges.compact_log`: per-ID streams, timestamps
+as deltas of deltas, payloads XOR'd with the previous one and then zlib.
+Periodic telemetry with a few moving bits shrinks to a few bytes a frame.
+The chunk goes out as UDP datagrams of at most ``max_datagram`` bytes
+(default 1200, under a Wi-Fi MTU), each with a 21-byte header::
+
+    magic "TDUP", version u8, session u32, resolution_ns u32,
+    chunk sequence u32, fragment u16, fragment count u16
+
+The frames are sent undecoded: they are smaller than their signals, and the
+base station gets a log it can replay and decode with the same DBC.
+
+**Budget.** A token bucket allows ``budget_kbps`` (IP and UDP headers
+counted) with up to one period of burst. Over budget, ``messages`` are
+thinned per ID, keeping every 2nd, 4th, ... up to every 64th frame. The
+thinning relaxes again once a chunk costs under a quarter of the budget;
+``keep`` messages are always sent whole. A chunk the bucket cannot pay for
+is dropped and counted.
+
+**Base station.** :class:`UplinkReceiver` (``scripts/uplink_receiver.py``)
+puts the chunks back together and writes them, in order, to a ``.tdlog``
+file. It waits up to ``reorder_s`` for a late chunk and then goes on
+without it. The file is indexed when the receiver closes. A receiver that is
+killed leaves a file that reads without the index, and
+:func:`td_can_bridges.compact_log.build_index` adds it. Replay and the log
+export take it like a recording.
+
+UDP only: QUIC would need a third-party stack. A lost fragment costs its
+chunk, which ``lost_chunks`` counts on the base station.
+"""
+
+from __future__ import annotations
+
+import logging
+import os
+import socket
+import struct
+import threading
+import time
+from collections import deque
+from dataclasses import dataclass
+from pathlib import Path
+from typing import Any, Deque, Dict, List, Mapping, Optional, Tuple
+
+from .compact_log import DEFAULT_RESOLUTION_NS, FLAG_FD, ChunkBuilder, build_index, file_header
+from .socketcan_rx import CAN_EFF_FLAG
+
+LOG = logging.getLogger(__name__)
+
+VERSION = 1
+MAGIC = b"TDUP"
+MAX_THINNING = 64
+UDP_OVERHEAD = 28  # IPv4 and UDP headers, per datagram
+QUEUE_FRAMES = 262144  # frames waiting for the next chunk; more are dropped
+
+_HEADER = struct.Struct("<4sBIIIHH")
+_CHUNK_HEAD = struct.Struct("<4sII")
+
+
+@dataclass(frozen=True)
+class UplinkConfig:
+    """``uplink`` of a bus."""
+
+    host: str
+    port: int
+    messages: Tuple[str, ...]
+    keep: Tuple[str, ...] = ()
+    budget_kbps: float = 200.0
+    period_s: float = 0.5
+    level: int = 6
+    max_datagram: int = 1200
+
+
+def uplink_entry(value: Any, context: str) -> Optional[UplinkConfig]:
+    """Parse a bus's ``uplink``; None when absent."""
+
+    if not value:
+        return None
+    if not isinstance(value, Mapping) or not value.get("to"):
+        raise ValueError(f"{context}.uplink must be a mapping with 'to: <host>:<port>'")
+    unknown = sorted(set(value) - {"to", "messages", "keep", "budget_kbps", "period_s", "level", "max_datagram"})
+    if unknown:
+        raise ValueError(f"{context}.uplink: unknown key(s) {unknown}")
+    host, _, port = str(value["to"]).rpartition(":")
+    if not host or not port.isdigit():
+        raise ValueError(f"{context}.uplink.to must be <host>:<port>, got '{value['to']}'")
+    messages = tuple(value.get("messages") or ())
+    keep = tuple(value.get("keep") or ())
+    if not messages and not keep:
+        raise ValueError(f"{context}.uplink needs messages or keep")
+    budget = float(value.get("budget_kbps", 200.0))
+    period = float(value.get("period_s", 0.5))
+    if budget <= 0 or period <= 0:
+        raise ValueError(f"{context}.uplink.budget_kbps and period_s must be positive")
+    max_datagram = int(value.get("max_datagram", 1200))
+    if not _HEADER.size < max_datagram <= 65507:
+        raise ValueError(f"{context}.uplink.max_datagram must be {_HEADER.size + 1} to 65507, got {max_datagram}")
+    return UplinkConfig(
+        host=host.strip("[]"), port=int(port), messages=messages, keep=keep, budget_kbps=budget,
+        period_s=period, level=int(value.get("level", 6)), max_datagram=max_datagram,
+    )
+
+
+class TelemetryUplink:
+    """Collects the frames of the configured messages on the RX thread and sends a chunk per period."""
+
+    def __init__(self, service, cfg: UplinkConfig):
+        self.service = service
+        self.cfg = cfg
+        self.channel = service.cfg.interface
+        self._ids: Dict[str, Tuple[int, bool]] = {}  # message -> (can_id with CAN_EFF_FLAG, thinned)
+        for name in cfg.messages + cfg.keep:
+            try:
+                msg = service.dbc.get_message_by_name(name)
+            except KeyError:
+                raise ValueError(f"bus '{service.cfg.name}': uplink message '{name}' is not in the DBC") from None
+            extended = msg.is_extended_frame
+            self._ids[name] = (msg.frame_id | (CAN_EFF_FLAG if extended else 0), name not in cfg.keep)
+        self._thinned = {can_id for can_id, thinned in self._ids.values() if thinned}
+        self._queue: Deque[Tuple[float, int, bytes]] = deque()
+        self._builder = ChunkBuilder(DEFAULT_RESOLUTION_NS)
+        self._counts: Dict[int, int] = {}
+        self._session = int.from_bytes(os.urandom(4), "little")
+        self._seq = 0
+        self._budget = cfg.budget_kbps * 1000 / 8 * cfg.period_s  # bytes per period
+        self._tokens = self._budget
+        self.thinning = 1
+        self.frames = self.sent_frames = self.thinned_frames = self.queue_dropped = 0
+        self.chunks = self.dropped_chunks = self.bytes = 0
+        self._sock: Optional[socket.socket] = None
+        self._address = None
+        self._stop = threading.Event()
+        self._thread: Optional[threading.Thread] = None
+
+    def start(self) -> None:
+        family, kind, proto, _, address = socket.getaddrinfo(self.cfg.host, self.cfg.port, type=socket.SOCK_DGRAM)[0]
+        self._sock = socket.socket(family, kind, proto)
+        self._address = address
+        for name, (can_id, _) in self._ids.items():
+            extended = bool(can_id & CAN_EFF_FLAG)
+            self.service.register_raw_handler(f"uplink/{name}", can_id & ~CAN_EFF_FLAG, self._handler(can_id),
+                                              extended=extended)
+        self._stop.clear()
+        self._thread = threading.Thread(target=self._run, name=f"{self.service.cfg.name}-uplink", daemon=True)
+        self._thread.start()
+        LOG.info("[%s] uplink to %s:%d, %d messages, %.0f kbit/s", self.service.cfg.name, self.cfg.host,
+                 self.cfg.port, len(self._ids), self.cfg.budget_kbps)
+
+    def stop(self) -> None:
+        """Send what is left as a last chunk and close the socket."""
+
+        for name in self._ids:
+            self.service.unregister_raw_handler(f"uplink/{name}")
+        self._stop.set()
+        if self._thread is not None:
+            self._thread.join(timeout=2.0)
+            self._thread = None
+        if self._sock is not None:
+            self._sock.close()
+            self._sock = None
+
+    def _handler(self, can_id: int):
+        queue = self._queue
+
+        def on_frame(arbitration_id: int, data: Optional[bytes], timestamp: float) -> None:
+            if data is None:
+                return
+            if len(queue) >= QUEUE_FRAMES:
+                self.queue_dropped += 1
+                return
+            queue.append((timestamp, can_id, bytes(data)))
+
+        return on_frame
+
+    def _run(self) -> None:
+        next_at = time.monotonic() + self.cfg.period_s
+        while True:
+            stopping = self._stop.wait(max(0.0, next_at - time.monotonic()))
+            next_at += self.cfg.period_s
+            try:
+                self._send_chunk()
+            except Exception:
+                LOG.exception("[%s] uplink chunk failed", self.service.cfg.name)
+            if stopping:
+                return
+
+    def _send_chunk(self) -> None:
+        builder = self._builder
+        counts = self._counts
+        thinning = self.thinning
+        taken = 0
+        for _ in range(len(self._queue)):
+            timestamp, can_id, data = self._queue.popleft()
+            taken += 1
+            if thinning > 1 and can_id in self._thinned:
+                n = counts.get(can_id, 0)
+                counts[can_id] = n + 1
+                if n % thinning:
+                    self.thinned_frames += 1
+                    continue
+            builder.add(timestamp, can_id, data, FLAG_FD if len(data) > 8 else 0, self.channel)
+        self.frames += taken
+        frames = builder.frames
+        self._tokens = min(self._tokens + self._budget, 2 * self._budget)
+        chunk = builder.encode(self.cfg.level)
+        if not chunk:
+            return
+        room = self.cfg.max_datagram - _HEADER.size
+        parts = [chunk[i:i + room] for i in range(0, len(chunk), room)]
+        cost = len(chunk) + len(parts) * (_HEADER.size + UDP_OVERHEAD)
+        if cost > self._budget:
+            self.thinning = min(thinning * 2, MAX_THINNING)
+        elif cost * 4 < self._budget and thinning > 1:
+            self.thinning = thinning // 2
+        if self.thinning != thinning:
+            LOG.info("[%s] uplink: thinning to every %d frame(s), chunk %d bytes, budget %d",
+                     self.service.cfg.name, self.thinning, cost, self._budget)
+        if cost > self._tokens or len(parts) > 0xFFFF:
+            self.dropped_chunks += 1
+            return
+        self._tokens -= cost
+        seq = self._seq
+        self._seq = (seq + 1) & 0xFFFFFFFF
+        for i, part in enumerate(parts):
+            head = _HEADER.pack(MAGIC, VERSION, self._session, DEFAULT_RESOLUTION_NS, seq, i, len(parts))
+            try:
+                self._sock.sendto(head + part, self._address)
+            except OSError as exc:  # no route while the Wi-Fi is down: the chunk is lost, the next may pass
+                LOG.debug("[%s] uplink send failed: %s", self.service.cfg.name, exc)
+                self.dropped_chunks += 1
+                return
+        self.chunks += 1
+        self.sent_frames += frames
+        self.bytes += cost
+
+    def stats(self) -> Dict[str, Any]:
+        return {"frames": self.frames, "sent_frames": self.sent_frames, "thinned_frames": self.thinned_frames,
+                "queue_dropped": self.queue_dropped, "chunks": self.chunks, "dropped_chunks": self.dropped_chunks,
+                "bytes": self.bytes, "thinning": self.thinning}
+
+
+class _Partial:
+    __slots__ = ("parts", "seen")
+
+    def __init__(self, count: int, seen: float):
+        self.parts: List[Optional[bytes]] = [None] * count
+        self.seen = seen
+
+
+class UplinkReceiver:
+    """The base station's end: reassembles chunks from UDP and appends them to a ``.tdlog`` in order.
+
+    :meth:`serve` runs until :meth:`close` (from another thread) or Ctrl-C.
+    A new session (the robot restarted the uplink) continues the same file.
+    """
+
+    def __init__(self, path: Path | str, port: int, host: str = "", reorder_s: float = 1.0):
+        self.path = Path(path)
+        self.reorder_s = float(reorder_s)
+        self.sock = socket.socket(socket.AF_INET6 if ":" in host else socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 * 1024 * 1024)
+        self.sock.bind((host, port))
+        self.sock.settimeout(0.1)
+        self._file = None
+        self._resolution: Optional[int] = None
+        self._session: Optional[int] = None
+        self._next: Optional[int] = None
+        self._partial: Dict[int, _Partial] = {}
+        self._ready: Dict[int, bytes] = {}
+        self._gap_since: Optional[float] = None
+        self._closed = threading.Event()
+        self.chunks = self.lost_chunks = self.late_chunks = self.bad_datagrams = self.sessions = 0
+
+    def serve(self) -> None:
+        try:
+            while not self._closed.is_set():
+                try:
+                    datagram = self.sock.recv(65535)
+                except socket.timeout:
+                    datagram = None
+                if datagram is not None:
+                    self._on_datagram(datagram)
+                self._write_ready(time.monotonic())
+        finally:
+            self._finish()
+
+    def close(self) -> None:
+        self._closed.set()
+
+    def _on_datagram(self, datagram: bytes) -> None:
+        if len(datagram) <= _HEADER.size:
+            self.bad_datagrams += 1
+            return
+        magic, version, session, resolution, seq, index, count = _HEADER.unpack_from(datagram)
+        if magic != MAGIC or version != VERSION or not index < count:
+            self.bad_datagrams += 1
+            return
+        if self._resolution is None:
+            self._resolution = resolution
+            self._file = open(self.path, "wb")
+            self._file.write(file_header(resolution))
+        elif resolution != self._resolution:
+            self.bad_datagrams += 1
+            return
+        if session != self._session:
+            self._flush_all()
+            self._session, self._next = session, None
+            self.sessions += 1
+            LOG.info("uplink session %08x", session)
+        if self._next is None:
+            self._next = seq  # a receiver started mid-session begins with the first chunk it hears of
+        elif (seq - self._next) & 0x80000000:
+            self.late_chunks += 1  # given up on already
+            return
+        partial = self._partial.get(seq)
+        if partial is None:
+            if seq in self._ready:
+                return
+            partial = self._partial[seq] = _Partial(count, time.monotonic())
+        if len(partial.parts) != count:
+            self.bad_datagrams += 1
+            return
+        partial.parts[index] = datagram[_HEADER.size:]
+        if all(p is not None for p in partial.parts):
+            del self._partial[seq]
+            chunk = b"".join(partial.parts)
+            magic, dir_len, body_len = _CHUNK_HEAD.unpack_from(chunk) if len(chunk) >= _CHUNK_HEAD.size else (b"", 0, 0)
+            if magic != b"TDCH" or _CHUNK_HEAD.size + dir_len + body_len != len(chunk):
+                self.bad_datagrams += 1
+                return
+            self._ready[seq] = chunk
+
+    def _write_ready(self, now: float) -> None:
+        while self._next is not None:
+            chunk = self._ready.pop(self._next, None)
+            if chunk is not None:
+                self._file.write(chunk)
+                self.chunks += 1
+                self._next = (self._next + 1) & 0xFFFFFFFF
+                self._gap_since = None
+                continue
+            if not self._ready and not self._partial:
+                return
+            if self._gap_since is None:
+                self._gap_since = now
+            if now - self._gap_since < self.reorder_s:
+                return
+            # Give up on the missing chunk: on to the oldest one after it that came
+            self._partial.pop(self._next, None)
+            ahead = [seq for seq in list(self._ready) + list(self._partial) if seq != self._next]
+            following = min(ahead, key=lambda seq: (seq - self._next) & 0xFFFFFFFF) if ahead \
+                else (self._next + 1) & 0xFFFFFFFF
+            self.lost_chunks += (following - self._next) & 0xFFFFFFFF
+            self._next = following
+            self._gap_since = None
+
+    def _flush_all(self) -> None:
+        """Write every complete chunk of the session in order, counting the rest as lost."""
+
+        if self._next is None:
+            return
+        for seq in sorted(self._ready, key=lambda s: (s - self._next) & 0xFFFFFFFF):
+            self.lost_chunks += (seq - self._next) & 0xFFFFFFFF
+            self._file.write(self._ready.pop(seq))
+            self.chunks += 1
+            self._next = (seq + 1) & 0xFFFFFFFF
+        # Incomplete chunks between the written ones are counted in the gaps already
+        self.lost_chunks += sum(1 for seq in self._partial if not (seq - self._next) & 0x80000000)
+        self._partial.clear()
+        self._gap_since = None
+
+    def _finish(self) -> None:
+        self.sock.close()
+        if self._file is None:
+            return
+        self._flush_all()
+        self._file.close()
+        self._file = None
+        build_index(self.path)
+
+    def stats(self) -> Dict[str, int]:
+        return {"chunks": self.chunks, "lost_chunks": self.lost_chunks, "late_chunks": self.late_chunks,
+                "bad_datagrams": self.bad_datagrams, "sessions": self.sessions}
+
+
+__all__ = ["TelemetryUplink", "UplinkConfig", "UplinkReceiver", "uplink_entry"]